@@ -129,6 +129,21 @@ asmlinkage void __div0(void)
 
 extern int do_decompress(u8 *input, int len, u8 *output, void (*error)(char *x));
 
+#ifdef arch_decomp_timer
+static void putdec(unsigned long n)
+{
+	char buf[11];
+	int i = sizeof(buf);
+
+	buf[--i] = '\0';
+	do {
+		buf[--i] = '0' + n % 10;
+		n /= 10;
+	} while (n);
+	putstr(buf + i);
+}
+#endif
+
 
 void
 decompress_kernel(unsigned long output_start, unsigned long free_mem_ptr_p,
@@ -136,6 +151,9 @@ decompress_kernel(unsigned long output_start, unsigned long free_mem_ptr_p,
 		int arch_id)
 {
 	int ret;
+#ifdef arch_decomp_timer
+	unsigned long start;
+#endif
 
 	output_data		= (unsigned char *)output_start;
 	free_mem_ptr		= free_mem_ptr_p;
@@ -145,10 +163,18 @@ decompress_kernel(unsigned long output_start, unsigned long free_mem_ptr_p,
 	arch_decomp_setup();
 
 	putstr("Uncompressing Linux...");
+#ifdef arch_decomp_timer
+	start = arch_decomp_timer();
+#endif
 	ret = do_decompress(input_data, input_data_end - input_data,
 			    output_data, error);
 	if (ret)
 		error("decompressor returned an error");
-	else
-		putstr(" done, booting the kernel.\n");
+#ifdef arch_decomp_timer
+	putstr(" done in ");
+	putdec((arch_decomp_timer() - start) * 1000 / arch_decomp_timer_hz);
+	putstr(" ms, booting the kernel.\n");
+#else
+	putstr(" done, booting the kernel.\n");
+#endif
 }
@@ -298,6 +298,10 @@ struct _pl330_req {
 	/* Number of bytes taken to setup MC for the req */
 	u32 mc_len;
 	struct pl330_req *r;
+	/* Req the MC in this slot was last built for, see mc_reuse */
+	struct pl330_req *mc_r;
+	u32 mc_r_len;
+	u8 mc_first;	/* first MC byte, overwritten by MARK_FREE */
 	/* Hook to attach to DMAC's list of reqs with due callback */
 	struct list_head rqd;
 };
@@ -1492,6 +1496,15 @@ int pl330_submit_req(void *ch_id, struct pl330_req *r)
 
 	idx = IS_FREE(&thrd->req[0]) ? 0 : 1;
 
+	/* Same req as last time in this slot: put its MC back */
+	if (r->mc_reuse && thrd->req[idx].mc_r == r) {
+		*(u8 *)thrd->req[idx].mc_cpu = thrd->req[idx].mc_first;
+		thrd->lstenq = idx;
+		thrd->req[idx].mc_len = thrd->req[idx].mc_r_len;
+		thrd->req[idx].r = r;
+		goto xfer_exit;
+	}
+
 	xs.ccr = ccr;
 	xs.r = r;
 
@@ -1513,6 +1526,10 @@ int pl330_submit_req(void *ch_id, struct pl330_req *r)
 	thrd->req[idx].mc_len = _setup_req(0, thrd, idx, &xs);
 	thrd->req[idx].r = r;
 
+	thrd->req[idx].mc_r = r;
+	thrd->req[idx].mc_r_len = thrd->req[idx].mc_len;
+	thrd->req[idx].mc_first = *(u8 *)thrd->req[idx].mc_cpu;
+
 	ret = 0;
 
 xfer_exit:
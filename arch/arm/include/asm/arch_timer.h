@@ -97,6 +97,10 @@ static inline void __cpuinit arch_counter_set_user_access(void)
 
 	/* disable user access to everything */
 	cntkctl &= ~((3 << 8) | (7 << 0));
+#ifdef CONFIG_KONA_ARCH_COUNTER_CLOCKSOURCE
+	/* except the virtual counter, the clocksource user space can read */
+	cntkctl |= 1 << 1;
+#endif
 
 	asm volatile("mcr p15, 0, %0, c14, c1, 0" : : "r" (cntkctl));
 }
@@ -144,6 +144,10 @@
 
 #define ETMR_TRACEIDR		0x200
 
+/* context ID comparators, "ETM Architecture", 3.3.15 */
+#define ETMR_CTXIDCOMP_VAL(x)	(0x1b0 + (x) * 4)
+#define ETMR_CTXIDCOMP_MASK	0x1bc
+
 /* ETM management registers, "ETM Architecture", 3.5.24 */
 #define ETMMR_OSLAR	0x300
 #define ETMMR_OSLSR	0x304
@@ -188,6 +192,8 @@ struct etb_platform_data {
 	char *pti_clk_name;
 	int (*config_funnels)(void);
 };
+
+void etm_trace_freeze(void);
 #endif
 
 #endif /* __ASM_HARDWARE_CORESIGHT_H */
@@ -176,6 +176,12 @@ struct pl330_req {
 	struct pl330_reqcfg *cfg;
 	/* Pointer to first xfer in the request. */
 	struct pl330_xfer *x;
+	/*
+	 * Set by the client if neither cfg nor the xfer list changed
+	 * since the req was last submitted, so the microcode built
+	 * for it then can be reused as is.
+	 */
+	bool mc_reuse;
 };
 
 /*
@@ -142,6 +142,15 @@ extern void __cpu_copy_user_highpage(struct page *to, struct page *from,
 #define clear_page(page)	memset((void *)(page), 0, PAGE_SIZE)
 extern void copy_page(void *to, const void *from);
 
+/* the same through NEON when the cpu has it and the context allows */
+#ifdef CONFIG_KERNEL_MODE_NEON
+extern void copy_page_neon(void *to, const void *from);
+extern void clear_page_neon(void *page);
+#else
+#define copy_page_neon(to, from)	copy_page(to, from)
+#define clear_page_neon(page)		clear_page(page)
+#endif
+
 #ifdef CONFIG_KUSER_HELPERS
 #define __HAVE_ARCH_GATE_AREA 1
 #endif
@@ -119,6 +119,7 @@ extern void iwmmxt_task_switch(struct thread_info *);
 
 extern void vfp_sync_hwstate(struct thread_info *);
 extern void vfp_flush_hwstate(struct thread_info *);
+extern bool vfp_release_hwstate(void);
 
 struct user_vfp;
 struct user_vfp_exc;
@@ -26,7 +26,9 @@
 #include <linux/vmalloc.h>
 #include <linux/mutex.h>
 #include <linux/module.h>
+#include <linux/debugfs.h>
 #include <asm/hardware/coresight.h>
+#include <asm/mmu.h>
 #include <asm/sections.h>
 
 MODULE_LICENSE("GPL");
@@ -50,6 +52,8 @@ struct tracectx {
 	unsigned long	data_range_start;
 	unsigned long	data_range_end;
 	bool		dump_initial_etb;
+	pid_t		pid;		/* trace only this process, if set */
+	unsigned long	frozen;		/* bit 0: ETB stopped by a trigger */
 	struct device	*dev;
 	struct clk	*emu_clk;
 #ifdef	ETM_BRCM_MOD
@@ -75,6 +79,10 @@ static int etm_setup_address_range(struct tracectx *t, int id, int n,
 	u32 flags = ETMAAT_ARM | ETMAAT_IGNCONTEXTID | ETMAAT_IGNSECURITY |
 		    ETMAAT_NOVALCMP;
 
+	/* instruction ranges match in the traced process only */
+	if (t->pid && !data)
+		flags |= ETMAAT_VALUE1;
+
 	if (n < 1 || n > t->ncmppairs)
 		return -EINVAL;
 
@@ -143,9 +151,19 @@ static int trace_start_etm(struct tracectx *t, int id)
 		return -EFAULT;
 	}
 
+#ifdef CONFIG_PID_IN_CONTEXTIDR
+	/* CONTEXTIDR holds the pid above the ASID */
+	if (t->pid) {
+		etm_writel(t, id, t->pid << ASID_BITS, ETMR_CTXIDCOMP_VAL(0));
+		etm_writel(t, id, (1 << ASID_BITS) - 1, ETMR_CTXIDCOMP_MASK);
+	}
+#endif
+
 	if (t->range_start || t->range_end)
 		etm_setup_address_range(t, id, 1,
 					t->range_start, t->range_end, 0, 0);
+	else if (t->pid)
+		etm_setup_address_range(t, id, 1, 0, ~0UL, 0, 0);
 	else
 		etm_writel(t, id, ETMTE_INCLEXCL, ETMR_TRACEENCTRL);
 
@@ -195,6 +213,7 @@ static int trace_start(struct tracectx *t)
 	etb_unlock(t);
 
 	t->dump_initial_etb = false;
+	clear_bit(0, &t->frozen);
 	etb_writel(t, 0, ETBR_WRITEADDR);
 	etb_writel(t, etb_fc, ETBR_FORMATTERCTRL);
 	etb_writel(t, 1, ETBR_CTRL);
@@ -266,21 +285,25 @@ static int trace_stop(struct tracectx *t)
 		trace_power_down_etm(t, id);
 
 	etb_unlock(t);
-	if (etb_fc) {
-		etb_fc |= ETBFF_STOPFL;
-		etb_writel(t, t->etb_fc, ETBR_FORMATTERCTRL);
-	}
-	etb_writel(t, etb_fc | ETBFF_MANUAL_FLUSH, ETBR_FORMATTERCTRL);
-
-	timeout = TRACER_TIMEOUT;
-	while (etb_readl(t, ETBR_FORMATTERCTRL) &
-			ETBFF_MANUAL_FLUSH && --timeout)
-		;
-	if (!timeout) {
-		dev_dbg(t->dev, "Waiting for formatter flush to commence "
-				"timed out\n");
-		etb_lock(t);
-		return -EFAULT;
+	/* a frozen ETB was flushed and stopped already */
+	if (!test_bit(0, &t->frozen)) {
+		if (etb_fc) {
+			etb_fc |= ETBFF_STOPFL;
+			etb_writel(t, t->etb_fc, ETBR_FORMATTERCTRL);
+		}
+		etb_writel(t, etb_fc | ETBFF_MANUAL_FLUSH,
+			   ETBR_FORMATTERCTRL);
+
+		timeout = TRACER_TIMEOUT;
+		while (etb_readl(t, ETBR_FORMATTERCTRL) &
+				ETBFF_MANUAL_FLUSH && --timeout)
+			;
+		if (!timeout) {
+			dev_dbg(t->dev, "Waiting for formatter flush to "
+					"commence timed out\n");
+			etb_lock(t);
+			return -EFAULT;
+		}
 	}
 
 	etb_writel(t, 0, ETBR_CTRL);
@@ -296,6 +319,28 @@ static int trace_stop(struct tracectx *t)
 	return 0;
 }
 
+#ifdef ETM_BRCM_MOD
+/*
+ * Stop the capture into the ETB, keeping the trace up to now, for a
+ * trigger on an event. Only flushes and stops the formatter, so it can
+ * be called from any context; the ETMs are stopped when the buffer is
+ * read.
+ */
+void etm_trace_freeze(void)
+{
+	struct tracectx *t = &tracer;
+
+	if (!trace_isrunning(t) || test_and_set_bit(0, &t->frozen))
+		return;
+
+	etb_unlock(t);
+	etb_writel(t, t->etb_fc | ETBFF_STOPFL | ETBFF_MANUAL_FLUSH,
+		   ETBR_FORMATTERCTRL);
+	etb_lock(t);
+}
+EXPORT_SYMBOL(etm_trace_freeze);
+#endif
+
 static int etb_getdatalen(struct tracectx *t)
 {
 	u32 v;
@@ -360,7 +405,6 @@ static struct sysrq_key_op sysrq_etm_op = {
 	.action_msg = "etm",
 };
 
-#ifndef ETM_BRCM_MOD
 static int etb_open(struct inode *inode, struct file *file)
 {
 	if (!tracer.etb_regs)
@@ -386,6 +430,9 @@ static ssize_t etb_read(struct file *file, char __user *data,
 
 	mutex_lock(&t->mutex);
 
+	/* a frozen trace is done, stop the ETMs for the read */
+	if (trace_isrunning(t) && test_bit(0, &t->frozen))
+		trace_stop(t);
 	if (trace_isrunning(t)) {
 		length = 0;
 		goto out;
@@ -448,6 +495,7 @@ static const struct file_operations etb_fops = {
 	.llseek = no_llseek,
 };
 
+#ifndef ETM_BRCM_MOD
 static struct miscdevice etb_miscdev = {
 	.name = "tracebuf",
 	.minor = 0,
@@ -523,6 +571,10 @@ static int etb_probe(struct amba_device *dev, const struct amba_id *id)
 	/* Get optional clock. Currently used to select clock source on omap3 */
 	t->emu_clk = clk_get(&dev->dev, "emu_src_ck");
 #else
+	/* the buffer is read from debugfs instead */
+	if (!debugfs_create_file("etb", S_IRUSR, NULL, t, &etb_fops))
+		dev_dbg(&dev->dev, "Failed to create etb in debugfs\n");
+
 	t->emu_clk = clk_get(&dev->dev, "etb_apb");
 #endif
 	if (IS_ERR(t->emu_clk))
@@ -861,6 +913,35 @@ static ssize_t trace_range_store(struct kobject *kobj,
 static struct kobj_attribute trace_range_attr =
 	__ATTR(trace_range, 0644, trace_range_show, trace_range_store);
 
+#ifdef CONFIG_PID_IN_CONTEXTIDR
+/* the thread id that CONTEXTIDR holds, 0 to trace all of them */
+static ssize_t trace_pid_show(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      char *buf)
+{
+	return sprintf(buf, "%d\n", tracer.pid);
+}
+
+static ssize_t trace_pid_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t n)
+{
+	int pid;
+
+	if (sscanf(buf, "%d", &pid) != 1 || pid < 0)
+		return -EINVAL;
+
+	mutex_lock(&tracer.mutex);
+	tracer.pid = pid;
+	mutex_unlock(&tracer.mutex);
+
+	return n;
+}
+
+static struct kobj_attribute trace_pid_attr =
+	__ATTR(trace_pid, 0644, trace_pid_show, trace_pid_store);
+#endif
+
 static ssize_t trace_data_range_show(struct kobject *kobj,
 				  struct kobj_attribute *attr,
 				  char *buf)
@@ -1006,6 +1087,12 @@ static int etm_probe(struct amba_device *dev, const struct amba_id *id)
 	if (ret)
 		dev_dbg(&dev->dev, "Failed to create trace_range in sysfs\n");
 
+#ifdef CONFIG_PID_IN_CONTEXTIDR
+	ret = sysfs_create_file(&dev->dev.kobj, &trace_pid_attr.attr);
+	if (ret)
+		dev_dbg(&dev->dev, "Failed to create trace_pid in sysfs\n");
+#endif
+
 	if (etm_version < ETMIDR_VERSION_PFT_1_0) {
 		ret = sysfs_create_file(&dev->dev.kobj,
 					&trace_data_range_attr.attr);
@@ -1049,6 +1136,9 @@ static int etm_remove(struct amba_device *dev)
 	sysfs_remove_file(&dev->dev.kobj, &trace_info_attr.attr);
 	sysfs_remove_file(&dev->dev.kobj, &trace_mode_attr.attr);
 	sysfs_remove_file(&dev->dev.kobj, &trace_range_attr.attr);
+#ifdef CONFIG_PID_IN_CONTEXTIDR
+	sysfs_remove_file(&dev->dev.kobj, &trace_pid_attr.attr);
+#endif
 	sysfs_remove_file(&dev->dev.kobj, &trace_data_range_attr.attr);
 
 	amba_set_drvdata(dev, NULL);
@@ -0,0 +1,55 @@
+/*
+ * linux/arch/arm/lib/page-neon.c
+ *
+ * Page copy and clear through NEON where it can be used, for the user
+ * page faults and buffer clears that move whole pages. Falls back to the
+ * ARM routines on cores without NEON and in interrupt context, where
+ * kernel_neon_begin() is not allowed.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/string.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+
+extern void __neon_copy_page(void *to, const void *from);
+extern void __neon_clear_page(void *page);
+
+static bool page_neon __read_mostly;
+
+void copy_page_neon(void *to, const void *from)
+{
+	if (!page_neon || in_interrupt()) {
+		copy_page(to, from);
+		return;
+	}
+	kernel_neon_begin();
+	__neon_copy_page(to, from);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(copy_page_neon);
+
+void clear_page_neon(void *page)
+{
+	if (!page_neon || in_interrupt()) {
+		clear_page(page);
+		return;
+	}
+	kernel_neon_begin();
+	__neon_clear_page(page);
+	kernel_neon_end();
+}
+EXPORT_SYMBOL(clear_page_neon);
+
+static int __init page_neon_init(void)
+{
+	page_neon = cpu_has_neon();
+	return 0;
+}
+early_initcall(page_neon_init);
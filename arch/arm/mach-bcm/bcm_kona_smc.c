@@ -15,12 +15,16 @@
 #include <linux/smp.h>
 #include <linux/io.h>
 #include <linux/ioport.h>
+#include <linux/sched.h>
 
 #include <asm/cacheflush.h>
 #include <linux/of_address.h>
 
 #include "bcm_kona_smc.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/kona_smc.h>
+
 struct secure_bridge_data {
 	void __iomem *bounce;		/* virtual address */
 	u32 __iomem buffer_addr;	/* physical address */
@@ -68,6 +72,7 @@ static void __bcm_kona_smc(void *info)
 	struct bcm_kona_smc_data *data = info;
 	u32 *args = bridge_data.bounce;
 	int rc = 0;
+	u64 start;
 
 	/* Must run on CPU 0 */
 	BUG_ON(smp_processor_id() != 0);
@@ -86,7 +91,9 @@ static void __bcm_kona_smc(void *info)
 		flush_cache_all();
 
 	/* Trap into Secure Monitor */
+	start = local_clock();
 	rc = bcm_kona_smc_asm(data->service_id, bridge_data.buffer_addr);
+	trace_kona_smc(data->service_id, rc, 1, local_clock() - start);
 
 	if (rc != SEC_ROM_RET_OK)
 		pr_err("Secure Monitor call failed (0x%x)!\n", rc);
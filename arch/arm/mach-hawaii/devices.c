@@ -47,6 +47,7 @@
 #include <mach/kona.h>
 #include <mach/pinmux.h>
 #include <mach/hawaii.h>
+#include <mach/atag_dt.h>
 #include <mach/rdb/brcm_rdb_uartb.h>
 #include <plat/chal/chal_trace.h>
 #ifdef CONFIG_KONA_AVS
@@ -1536,6 +1537,7 @@ static void mobicore_reserve_memory(void)
 
 void __init hawaii_reserve(void)
 {
+	kona_splash_reserve();
 
 #ifdef CONFIG_MOBICORE_DRIVER
 	mobicore_reserve_memory();
@@ -502,6 +502,9 @@ int enter_idle_state(struct kona_idle_state *state, u32 ctrl_params)
 
 	BUG_ON(!state);
 
+	/* the stop of the clocks gated off lately is still to be seen */
+	clk_gate_flush_all();
+
 	/*Clear all events except auto-clear & SW events*/
 	pwr_mgr_event_clear_events(LCDTE_EVENT, KEY_R7_EVENT);
 	pwr_mgr_event_clear_events(MISC_WKP_EVENT, BRIDGE_TO_MODEM_EVENT);
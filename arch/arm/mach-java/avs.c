@@ -34,6 +34,12 @@
 #include <linux/regulator/consumer.h>
 #include <plat/kona_pm.h>
 #include <linux/mfd/bcmpmu59xxx.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <plat/pwr_mgr.h>
+#include "pm_params.h"
 
 #ifdef CONFIG_KONA_TMON
 #include <linux/broadcom/kona_tmon.h>
@@ -65,6 +71,48 @@ struct avs_info avs_info = {
 
 static int debug_mask = AVS_LOG_ERR | AVS_LOG_WARN | AVS_LOG_INIT;
 
+/*
+ * Closed loop AVS. The handshake voltages are those the boot AVS picked
+ * for the silicon type, with the margin of the whole type. With
+ * closed_loop set, the voltage of each CSR OPP is lowered one PMU step at
+ * a time while the IR drop oscillator, read at the lower voltage, still
+ * counts cl_margin or more above the target of the OPP, down to
+ * cl_max_steps steps. The oscillators are read every cl_period_ms and
+ * when the ARM drops to ECONOMY, only while it runs there, so pinning it
+ * for the read costs nothing. An OPP whose margin is found negative, and
+ * every OPP when the temperature moves by cl_temp_hyst from the one the
+ * voltages were found at, goes back to the handshake voltage at once.
+ * The voltages are those of the pwr_mgr variable data table, so they
+ * apply from the next OPP change; debugfs avs/closed_loop has them and
+ * the dynamic power saved, as 1 - (V / V0)^2.
+ */
+struct avs_cl_opp {
+	u8 hs;			/* handshake voltage id */
+	u8 cur;			/* voltage id in use */
+	u16 vlt_mask;		/* var data entries that carry it */
+	int margin;		/* at the last read */
+	u32 steps;		/* down steps taken */
+	u32 backoffs;		/* negative margins */
+};
+
+static struct avs_cl_opp avs_cl[CSR_NUM_OPP];
+static DEFINE_MUTEX(avs_cl_lock);
+static struct delayed_work avs_cl_work;
+static unsigned long avs_cl_last;
+static long avs_cl_temp;
+static u32 avs_cl_resets;
+static bool avs_cl_ready;
+
+static bool closed_loop;
+static unsigned int cl_period_ms = 5000;
+module_param(cl_period_ms, uint, S_IRUGO | S_IWUSR);
+static unsigned int cl_margin = 2;
+module_param(cl_margin, uint, S_IRUGO | S_IWUSR);
+static unsigned int cl_max_steps = 4;
+module_param(cl_max_steps, uint, S_IRUGO | S_IWUSR);
+static unsigned int cl_temp_hyst = 5;
+module_param(cl_temp_hyst, uint, S_IRUGO | S_IWUSR);
+
 static int avs_print_opp_info(struct avs_info *avs_inf_ptr)
 {
 	int i;
@@ -206,7 +254,9 @@ static int read_osc_debounce(struct avs_info *avs_info_ptr)
 	return new;
 }
 
-static int avs_get_irdrop_osc_count(struct avs_info *avs_info_ptr)
+/* the osc count at uv, the regulator set to restore_uv after if not 0 */
+static int avs_get_osc_count_at(struct avs_info *avs_info_ptr, int uv,
+				int restore_uv)
 {
 	u32 min;
 	u32 max;
@@ -232,12 +282,13 @@ static int avs_get_irdrop_osc_count(struct avs_info *avs_info_ptr)
 	max = pi_get_dfs_lmt(pi->id, true /*get max limit*/);
 	pi_mgr_set_dfs_opp_limit(pi->id, PI_OPP_ECONOMY,
 				PI_OPP_ECONOMY);
-	if (regulator_set_voltage(regl, pdata->irdrop_vreq,
-		pdata->irdrop_vreq)) {
+	if (regulator_set_voltage(regl, uv, uv)) {
 		avs_dbg(AVS_LOG_ERR, "Unable to set voltage\n");
 		goto err;
 	}
 	osc_cnt = read_osc_debounce(avs_info_ptr);
+	if (restore_uv)
+		regulator_set_voltage(regl, restore_uv, restore_uv);
 err:
 	regulator_put(regl);
 	pi_mgr_set_dfs_opp_limit(pi->id, min, max);
@@ -246,6 +297,225 @@ err:
 	return osc_cnt;
 }
 
+static int avs_get_irdrop_osc_count(struct avs_info *avs_info_ptr)
+{
+	return avs_get_osc_count_at(avs_info_ptr,
+			avs_info_ptr->pdata->irdrop_vreq, 0);
+}
+
+static void avs_set_csr_volt(int uv)
+{
+	struct regulator *regl;
+
+	regl = regulator_get(NULL, avs_info.pdata->a7_regl_name);
+	if (IS_ERR_OR_NULL(regl))
+		return;
+	regulator_set_voltage(regl, uv, uv);
+	regulator_put(regl);
+}
+
+static void avs_cl_set(int i, u8 id)
+{
+	int inx;
+
+	for (inx = 0; inx < SR_VLT_LUT_SIZE; inx++)
+		if (avs_cl[i].vlt_mask & (1 << inx))
+			pwr_mgr_pm_i2c_var_data_modify(inx, id);
+	avs_cl[i].cur = id;
+}
+
+/* back to the handshake voltages, the one of the running OPP right away */
+static void avs_cl_reset(void)
+{
+	int i, opp;
+
+	for (i = 0; i < CSR_NUM_OPP; i++)
+		if (avs_cl[i].cur != avs_cl[i].hs)
+			avs_cl_set(i, avs_cl[i].hs);
+	opp = pi_get_active_opp(PI_MGR_PI_ID_ARM_CORE);
+	if (opp == PI_OPP_XTAL)
+		opp = PI_OPP_ECONOMY;
+	if (opp >= PI_OPP_ECONOMY && opp - PI_OPP_ECONOMY < CSR_NUM_OPP)
+		avs_set_csr_volt(bcmpmu_rgltr_get_volt_val(
+				avs_cl[opp - PI_OPP_ECONOMY].hs));
+	avs_cl_resets++;
+}
+
+static int avs_cl_read(int i, u8 id)
+{
+	int cnt;
+
+	cnt = avs_get_osc_count_at(&avs_info, bcmpmu_rgltr_get_volt_val(id),
+			bcmpmu_rgltr_get_volt_val(avs_cl[0].cur));
+	if (cnt < 0)
+		return INT_MIN;
+	return cnt - avs_info.avs_handshake->csr_targets[i];
+}
+
+/* one OPP: check its margin, then try a step down if there is room */
+static void avs_cl_sample(int i)
+{
+	struct avs_cl_opp *o = &avs_cl[i];
+	u8 floor = o->hs - min_t(u8, o->hs, cl_max_steps);
+	u8 down = o->cur - 1;
+	int margin;
+
+	margin = avs_cl_read(i, o->cur);
+	if (margin == INT_MIN)
+		return;
+	o->margin = margin;
+	if (margin < 0) {
+		if (o->cur != o->hs) {
+			avs_cl_set(i, o->hs);
+			o->backoffs++;
+		}
+		return;
+	}
+	if (o->cur <= floor || (i && down < avs_cl[i - 1].cur) ||
+	    bcmpmu_rgltr_get_volt_val(down) >=
+	    bcmpmu_rgltr_get_volt_val(o->cur))
+		return;
+	margin = avs_cl_read(i, down);
+	if (margin != INT_MIN && margin >= (int)cl_margin) {
+		avs_cl_set(i, down);
+		o->margin = margin;
+		o->steps++;
+	}
+}
+
+static void avs_cl_worker(struct work_struct *work)
+{
+	int i;
+#ifdef CONFIG_KONA_TMON
+	long temp;
+#endif
+
+	mutex_lock(&avs_cl_lock);
+	if (!closed_loop)
+		goto out;
+#ifdef CONFIG_KONA_TMON
+	temp = tmon_get_current_temp(true, false);
+	if (abs(temp - avs_cl_temp) > (long)cl_temp_hyst) {
+		avs_dbg(AVS_LOG_INFO, "%s: %ld C, was %ld C\n", __func__,
+				temp, avs_cl_temp);
+		avs_cl_reset();
+		avs_cl_temp = temp;
+	}
+#endif
+	if (pi_get_active_opp(PI_MGR_PI_ID_ARM_CORE) == PI_OPP_ECONOMY) {
+		for (i = 0; i < CSR_NUM_OPP; i++)
+			if (avs_cl[i].vlt_mask)
+				avs_cl_sample(i);
+		avs_cl_last = jiffies;
+	}
+	queue_delayed_work(system_power_efficient_wq, &avs_cl_work,
+			msecs_to_jiffies(cl_period_ms));
+out:
+	mutex_unlock(&avs_cl_lock);
+}
+
+static int avs_cl_dfs_notify(struct notifier_block *nb, unsigned long val,
+		void *data)
+{
+	struct pi_notify_param *p = data;
+
+	if (closed_loop && p->new_value == PI_OPP_ECONOMY &&
+	    time_after(jiffies, avs_cl_last + msecs_to_jiffies(cl_period_ms)))
+		mod_delayed_work(system_power_efficient_wq, &avs_cl_work, 0);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block avs_cl_dfs_nb = {
+	.notifier_call = avs_cl_dfs_notify,
+};
+
+#ifdef CONFIG_KONA_TMON
+/* a threshold crossed: look at the temperature now */
+static int avs_cl_tmon_notify(struct notifier_block *nb, unsigned long temp,
+		void *data)
+{
+	if (closed_loop)
+		mod_delayed_work(system_power_efficient_wq, &avs_cl_work, 0);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block avs_cl_tmon_nb = {
+	.notifier_call = avs_cl_tmon_notify,
+};
+#endif
+
+static int avs_cl_set_enabled(const char *val, struct kernel_param *kp)
+{
+	bool was = closed_loop;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || !avs_cl_ready || was == closed_loop)
+		return ret;
+
+	if (closed_loop) {
+#ifdef CONFIG_KONA_TMON
+		avs_cl_temp = tmon_get_current_temp(true, false);
+#endif
+		mod_delayed_work(system_power_efficient_wq, &avs_cl_work, 0);
+	} else {
+		cancel_delayed_work_sync(&avs_cl_work);
+		mutex_lock(&avs_cl_lock);
+		avs_cl_reset();
+		mutex_unlock(&avs_cl_lock);
+	}
+	return 0;
+}
+module_param_call(closed_loop, avs_cl_set_enabled, param_get_bool,
+		&closed_loop, S_IRUGO | S_IWUSR);
+
+/*
+ * The A9 entries of the variable data table that carry the handshake
+ * voltage of an OPP are that OPP's. An OPP that shares its voltage with
+ * another one is left alone, lowering it would lower the other too.
+ */
+static void avs_cl_init(void)
+{
+	static const u8 a9_vlt_ids[] = {
+		VLT_ID_A9_SYSPLL_WFI, VLT_ID_A9_ECO, VLT_ID_A9_NORMAL,
+		VLT_ID_A9_TURBO, VLT_ID_A9_SUPER_TURBO,
+	};
+	u8 tbl[SR_VLT_LUT_SIZE];
+	int i, j, n;
+
+	for (i = 0; i < CSR_NUM_OPP; i++)
+		avs_cl[i].hs = avs_cl[i].cur =
+			avs_info.avs_handshake->csr_opp[i];
+
+	n = pwr_mgr_pm_i2c_var_data_read(tbl);
+	if (n < SR_VLT_LUT_SIZE) {
+		avs_dbg(AVS_LOG_WARN, "%s: no voltage table\n", __func__);
+		return;
+	}
+	for (i = 0; i < CSR_NUM_OPP; i++) {
+		for (j = 0; j < CSR_NUM_OPP; j++)
+			if (j != i && avs_cl[j].hs == avs_cl[i].hs)
+				break;
+		if (j < CSR_NUM_OPP)
+			continue;
+		for (j = 0; j < ARRAY_SIZE(a9_vlt_ids); j++)
+			if (tbl[a9_vlt_ids[j]] == avs_cl[i].hs)
+				avs_cl[i].vlt_mask |= 1 << a9_vlt_ids[j];
+	}
+
+	INIT_DEFERRABLE_WORK(&avs_cl_work, avs_cl_worker);
+	pi_mgr_register_notifier(PI_MGR_PI_ID_ARM_CORE, &avs_cl_dfs_nb,
+			PI_NOTIFY_DFS_CHANGE_DEFERRED);
+#ifdef CONFIG_KONA_TMON
+	tmon_register_notifier(&avs_cl_tmon_nb);
+	avs_cl_temp = tmon_get_current_temp(true, false);
+#endif
+	avs_cl_ready = true;
+	if (closed_loop)
+		queue_delayed_work(system_power_efficient_wq, &avs_cl_work,
+				msecs_to_jiffies(cl_period_ms));
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int avs_debug_open(struct inode *inode, struct file *file)
 {
@@ -428,6 +698,44 @@ static const struct file_operations avs_read_osc_target_fops = {
 	.read = avs_debug_read_osc_targets,
 };
 
+static ssize_t avs_debug_read_closed_loop(struct file *file, char __user
+		*user_buf, size_t count, loff_t *ppos)
+{
+	char buf[1000];
+	u32 len = 0;
+	u32 hs, cur, saved;
+	int i;
+
+	mutex_lock(&avs_cl_lock);
+	len += snprintf(buf + len, sizeof(buf) - len,
+			"closed loop %s, %ld Celsius, resets %u\n",
+			closed_loop ? "on" : "off", avs_cl_temp,
+			avs_cl_resets);
+	len += snprintf(buf + len, sizeof(buf) - len,
+			"OPP  hs(mV) now(mV) margin steps backoffs saved\n");
+	for (i = 0; i < CSR_NUM_OPP; i++) {
+		hs = bcmpmu_rgltr_get_volt_val(avs_cl[i].hs) / 1000;
+		cur = bcmpmu_rgltr_get_volt_val(avs_cl[i].cur) / 1000;
+		/* dynamic power, per mille */
+		saved = hs ? 1000 - (u32)div_u64((u64)cur * cur * 1000,
+				hs * hs) : 0;
+		len += snprintf(buf + len, sizeof(buf) - len,
+				"%3u %7u %7u %6d %5u %8u %2u.%u%%%s\n",
+				i + 1, hs, cur, avs_cl[i].margin,
+				avs_cl[i].steps, avs_cl[i].backoffs,
+				saved / 10, saved % 10,
+				avs_cl[i].vlt_mask ? "" : " fixed");
+	}
+	mutex_unlock(&avs_cl_lock);
+
+	return simple_read_from_buffer(user_buf, count, ppos, buf, len);
+}
+
+static const struct file_operations avs_closed_loop_fops = {
+	.open = avs_debug_open,
+	.read = avs_debug_read_closed_loop,
+};
+
 static int avs_debug_init(void)
 {
 	struct dentry *dent_vlt_root_dir = debugfs_create_dir("avs", 0);
@@ -455,11 +763,33 @@ static int avs_debug_init(void)
 			dent_vlt_root_dir, NULL, &avs_read_osc_target_fops))
 		return -ENOMEM;
 
+	if (!debugfs_create_file("closed_loop", S_IRUGO,
+			dent_vlt_root_dir, NULL, &avs_closed_loop_fops))
+		return -ENOMEM;
+
 	pr_info("AVS Debug Init Successs\n");
 	return 0;
 }
 #endif
 
+/* VDDVAR voltage in uV that AVS chose for an ARM OPP, closed loop or not */
+int avs_get_opp_volt(int opp)
+{
+	int i;
+
+	if (!avs_info.avs_handshake)
+		return -ENODEV;
+	/* CSR OPP1..4 are ECONOMY..SUPER_TURBO, XTAL runs at ECONOMY */
+	if (opp == PI_OPP_XTAL)
+		opp = PI_OPP_ECONOMY;
+	if (opp < PI_OPP_ECONOMY || opp - PI_OPP_ECONOMY >= CSR_NUM_OPP)
+		return -EINVAL;
+	i = opp - PI_OPP_ECONOMY;
+	return bcmpmu_rgltr_get_volt_val(avs_cl_ready ? avs_cl[i].cur :
+			avs_info.avs_handshake->csr_opp[i]);
+}
+EXPORT_SYMBOL(avs_get_opp_volt);
+
 static int panic_event(struct notifier_block *this, unsigned long event,
 		void *ptr)
 {
@@ -506,6 +836,7 @@ static int avs_drv_probe(struct platform_device *pdev)
 
 	avs_print_opp_info(&avs_info);
 	atomic_notifier_chain_register(&panic_notifier_list, &panic_block);
+	avs_cl_init();
 
 #ifdef CONFIG_DEBUG_FS
 	avs_debug_init();
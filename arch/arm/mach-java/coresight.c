@@ -37,6 +37,9 @@
 #include <linux/err.h>
 #include <linux/dma-mapping.h>
 #include <linux/delay.h>
+#include <linux/debugfs.h>
+#include <linux/notifier.h>
+#include <linux/broadcom/frame_timeline.h>
 
 #include <mach/hardware.h>
 #include <asm/hardware/coresight.h>
@@ -104,6 +107,48 @@ static AMBA_APB_DEVICE(hawaii_etm0, "etm0", 0x102bb921,
 static AMBA_APB_DEVICE(hawaii_etm1, "etm1", 0x102bb950,
 			A9PTM1_BASE_ADDR, { }, NULL);
 
+#ifdef CONFIG_KONA_FRAME_TIMELINE
+/*
+ * Performance trace mode: with trigger_on_jank set, the ETB stops at
+ * the first frame that misses a vsync and keeps the branch trace that
+ * led up to it, for debugfs etb. Start the trace with trace_running
+ * of the etm devices, after trace_range and trace_pid if wanted.
+ */
+static u32 trigger_on_jank;
+static u32 jank_triggers;
+
+static int ptm_jank_notify(struct notifier_block *nb, unsigned long missed,
+			   void *frame)
+{
+	if (trigger_on_jank) {
+		trigger_on_jank = 0;
+		jank_triggers++;
+		etm_trace_freeze();
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block ptm_jank_nb = {
+	.notifier_call = ptm_jank_notify,
+};
+
+static void __init ptm_perf_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("coresight", NULL);
+	if (!dir)
+		return;
+	debugfs_create_u32("trigger_on_jank", 0644, dir, &trigger_on_jank);
+	debugfs_create_u32("jank_triggers", 0444, dir, &jank_triggers);
+	frame_tl_register_jank_notifier(&ptm_jank_nb);
+}
+#else
+static inline void ptm_perf_init(void)
+{
+}
+#endif
+
 static void *ddr_virt_addr;
 static	dma_addr_t ddr_dma_addr;
 
@@ -193,6 +238,7 @@ static int __init ptm_init(void)
 		pr_err("sysfs create group failed\n");
 		return ret;
 	}
+	ptm_perf_init();
 
 	ddr_virt_addr = dma_alloc_coherent(NULL, SZ_4K, &ddr_dma_addr, GFP_DMA);
 	if (ddr_virt_addr == NULL) {
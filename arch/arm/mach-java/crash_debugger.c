@@ -631,6 +631,10 @@ static int cdebugger_panic_handler(struct notifier_block *nb,
 
 		cdebugger_dump_stack();
 
+		/* with the dump on eMMC there is nothing to upload */
+		if (!cdebugger_ramdump_mmc())
+			cdebugger_set_upload_magic(0);
+
 		flush_cache_all();
 		outer_flush_all();
 		dmb();
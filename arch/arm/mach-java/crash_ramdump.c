@@ -0,0 +1,449 @@
+/*
+ * arch/arm/mach-java/crash_ramdump.c
+ *
+ * Compressed AP ramdump to eMMC, written from the panic handler of the
+ * crash debugger through the polled mmc stack.
+ *
+ * Upload mode sends the whole of the RAM uncompressed, which for 512MB
+ * to 1GB takes minutes. Here only the pages worth having go out: free
+ * pages, on the buddy and per cpu free lists, and pages that are all
+ * zero are left out, and the rest is LZ4 compressed CRD_CHUNK_PAGES at
+ * a time and written in CRD_FLUSH multi-block writes to the partition
+ * named by crash_ramdump.part= (e.g. mmcblk0p21 or PARTUUID=...).
+ * When the dump made it, the device restarts without upload mode.
+ *
+ * On the partition, sector 0 has a struct crd_header, written last; the
+ * frames follow from sector 1, each a struct crd_frame and its length
+ * bytes, up to a frame of no pages. Pages that are in no frame read as
+ * zero.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/blkdev.h>
+#include <linux/ctype.h>
+#include <linux/genhd.h>
+#include <linux/highmem.h>
+#include <linux/lz4.h>
+#include <linux/memblock.h>
+#include <linux/mm.h>
+#include <linux/mmc-poll/mmc_poll.h>
+#include <linux/mmc-poll/mmc_poll_stack.h>
+#include <linux/module.h>
+#include <linux/mount.h>
+#include <linux/nmi.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/workqueue.h>
+#include <asm/div64.h>
+#ifdef CONFIG_BRCM_SECURE_WATCHDOG
+#include <linux/broadcom/kona_sec_wd.h>
+#endif
+#include <mach/cdebugger.h>
+
+#define CRD_MAGIC		0x50445243	/* "CRDP" */
+#define CRD_VERSION		1
+
+struct crd_header {
+	u32 magic;
+	u32 version;
+	u32 flags;
+#define CRD_TRUNCATED		0x01	/* out of time or space */
+	u32 page_size;
+	u32 phys_start;
+	u32 pages;		/* from phys_start to the end of the RAM */
+	u32 pages_dumped;
+	u32 pages_zero;
+	u32 pages_free;
+	u32 pages_hole;		/* not in the memory map */
+	u32 dump_length;	/* bytes of frames, after the header */
+	u32 dump_ms;		/* panic to header written */
+};
+
+struct crd_frame {
+	u32 pfn;		/* of the first page */
+	u16 pages;		/* consecutive ones, 0 ends the dump */
+	u16 flags;
+#define CRD_FRAME_STORED	0x01	/* not compressed */
+	u32 length;
+};
+
+#define CRD_SECTOR		512
+#define CRD_CHUNK_PAGES		16	/* compressed at a time */
+#define CRD_CHUNK		(CRD_CHUNK_PAGES * PAGE_SIZE)
+#define CRD_FLUSH		(256 * 1024)	/* written at a time */
+
+/* stop in time for the watchdog, the dump is cut short */
+static unsigned int budget_ms = 60000;
+module_param(budget_ms, uint, S_IRUGO | S_IWUSR);
+
+static char part[64];
+
+static struct {
+	/* the partition, found once the eMMC is up */
+	bool ready;
+	int dev_num;
+	sector_t start;
+	sector_t nr_sects;
+	unsigned long base_pfn;
+	unsigned long pages;
+	unsigned long *free_map;
+	unsigned char *in;
+	unsigned char *cbuf;
+	unsigned char *out;	/* physically contiguous, for sdma */
+	void *wrkmem;
+} crd;
+
+/* the writer at panic time */
+static struct {
+	struct mmc *mmc;
+	int poll_dev;
+	sector_t blk;		/* next to write, from the partition start */
+	size_t out_len;
+	size_t in_pages;
+	unsigned long in_pfn;
+	u64 start_ns;
+	int err;
+	struct crd_header hdr;
+} w;
+
+static void crd_flush(bool all)
+{
+	unsigned long n;
+	size_t len;
+
+	if (all && w.out_len % CRD_SECTOR) {
+		len = CRD_SECTOR - w.out_len % CRD_SECTOR;
+		memset(crd.out + w.out_len, 0, len);
+		w.out_len += len;
+	}
+	n = w.out_len / CRD_SECTOR;
+	if (!n || w.err)
+		return;
+	if (w.blk + n > crd.nr_sects) {
+		w.err = -ENOSPC;
+		return;
+	}
+
+	if (w.mmc->block_dev.block_write(w.poll_dev, crd.start + w.blk, n,
+					 crd.out) != n) {
+		w.err = -EIO;
+		return;
+	}
+	w.blk += n;
+	len = n * CRD_SECTOR;
+	w.out_len -= len;
+	memmove(crd.out, crd.out + len, w.out_len);
+}
+
+static void crd_emit(const struct crd_frame *f, const void *data)
+{
+	memcpy(crd.out + w.out_len, f, sizeof(*f));
+	memcpy(crd.out + w.out_len + sizeof(*f), data, f->length);
+	w.out_len += sizeof(*f) + f->length;
+	w.hdr.dump_length += sizeof(*f) + f->length;
+	if (w.out_len >= CRD_FLUSH)
+		crd_flush(false);
+}
+
+static void crd_frame(void)
+{
+	size_t in_len = w.in_pages * PAGE_SIZE;
+	size_t clen = lz4_compressbound(CRD_CHUNK);
+	const unsigned char *src = crd.cbuf;
+	struct crd_frame f = {
+		.pfn = w.in_pfn,
+		.pages = w.in_pages,
+	};
+
+	if (lz4_compress(crd.in, in_len, crd.cbuf, &clen, crd.wrkmem) ||
+	    clen >= in_len) {
+		clen = in_len;
+		src = crd.in;
+		f.flags = CRD_FRAME_STORED;
+	}
+	f.length = clen;
+	crd_emit(&f, src);
+	w.hdr.pages_dumped += w.in_pages;
+	w.in_pages = 0;
+
+	touch_nmi_watchdog();
+#ifdef CONFIG_BRCM_SECURE_WATCHDOG
+	sec_wd_touch();
+#endif
+	if (!w.err && div_u64(local_clock() - w.start_ns, NSEC_PER_MSEC) >=
+	    budget_ms)
+		w.err = -ETIME;
+}
+
+static void crd_mark(struct page *page, unsigned int order)
+{
+	unsigned long pfn = page_to_pfn(page) - crd.base_pfn;
+	unsigned long n = 1UL << order;
+
+	if (pfn < crd.pages && n <= crd.pages - pfn)
+		bitmap_set(crd.free_map, pfn, n);
+}
+
+/*
+ * The other cores are stopped, but the lists may be what the crash
+ * left half updated: no more entries are taken from one than it
+ * should have, and none that is not a page.
+ */
+static void crd_mark_list(struct list_head *head, unsigned int order,
+			  unsigned long max)
+{
+	struct list_head *p;
+
+	for (p = head->next; p != head && max; p = p->next, max--) {
+		if (!virt_addr_valid(p))
+			break;
+		crd_mark(list_entry(p, struct page, lru), order);
+	}
+}
+
+static void crd_mark_free(void)
+{
+	struct per_cpu_pages *pcp;
+	struct free_area *area;
+	struct zone *zone;
+	unsigned int order, t;
+	int cpu;
+
+	bitmap_zero(crd.free_map, crd.pages);
+	for_each_populated_zone(zone) {
+		for (order = 0; order < MAX_ORDER; order++) {
+			area = &zone->free_area[order];
+			for (t = 0; t < MIGRATE_TYPES; t++)
+				crd_mark_list(&area->free_list[t], order,
+					      area->nr_free);
+		}
+		for_each_possible_cpu(cpu) {
+			pcp = &per_cpu_ptr(zone->pageset, cpu)->pcp;
+			for (t = 0; t < MIGRATE_PCPTYPES; t++)
+				crd_mark_list(&pcp->lists[t], 0, pcp->count);
+		}
+	}
+}
+
+static void crd_page(unsigned long i)
+{
+	unsigned long pfn = crd.base_pfn + i;
+	void *addr;
+	bool zero;
+
+	if (!pfn_valid(pfn)) {
+		w.hdr.pages_hole++;
+		return;
+	}
+	if (test_bit(i, crd.free_map)) {
+		w.hdr.pages_free++;
+		return;
+	}
+
+	addr = kmap_atomic(pfn_to_page(pfn));
+	zero = !memchr_inv(addr, 0, PAGE_SIZE);
+	if (!zero) {
+		if (w.in_pages && w.in_pfn + w.in_pages != pfn)
+			crd_frame();
+		if (!w.in_pages)
+			w.in_pfn = pfn;
+		memcpy(crd.in + w.in_pages * PAGE_SIZE, addr, PAGE_SIZE);
+		w.in_pages++;
+	}
+	kunmap_atomic(addr);
+
+	if (zero)
+		w.hdr.pages_zero++;
+	else if (w.in_pages == CRD_CHUNK_PAGES)
+		crd_frame();
+}
+
+/*
+ * From the crash debugger's panic handler, before the reset. Returns 0
+ * with the whole dump on the partition.
+ */
+int cdebugger_ramdump_mmc(void)
+{
+	static const struct crd_frame end;
+	struct crd_header *hdr = &w.hdr;
+	unsigned long i;
+
+	if (!crd.ready)
+		return -ENODEV;
+
+	memset(&w, 0, sizeof(w));
+	w.start_ns = local_clock();
+	if (mmc_poll_stack_init((void **)&w.mmc, crd.dev_num,
+				&w.poll_dev) < 0 ||
+	    w.mmc->write_bl_len != CRD_SECTOR) {
+		pr_emerg("crash_ramdump: no polled eMMC\n");
+		return -EIO;
+	}
+
+	/* no header until the dump is complete */
+	memset(crd.out, 0, CRD_SECTOR);
+	if (w.mmc->block_dev.block_write(w.poll_dev, crd.start, 1,
+					 crd.out) != 1) {
+		pr_emerg("crash_ramdump: eMMC write failed\n");
+		return -EIO;
+	}
+
+	pr_emerg("crash_ramdump: dumping %lu MB to %s\n",
+		 crd.pages >> (20 - PAGE_SHIFT), part);
+	hdr->pages = crd.pages;
+	crd_mark_free();
+	w.blk = 1;
+	for (i = 0; i < crd.pages && !w.err; i++)
+		crd_page(i);
+	if (w.in_pages && !w.err)
+		crd_frame();
+	if (!w.err)
+		crd_emit(&end, NULL);
+	crd_flush(true);
+	if (w.err) {
+		pr_emerg("crash_ramdump: dump cut short (%d)\n", w.err);
+		hdr->flags |= CRD_TRUNCATED;
+	}
+
+	hdr->magic = CRD_MAGIC;
+	hdr->version = CRD_VERSION;
+	hdr->page_size = PAGE_SIZE;
+	hdr->phys_start = PFN_PHYS(crd.base_pfn);
+	hdr->dump_ms = div_u64(local_clock() - w.start_ns, NSEC_PER_MSEC);
+	memset(crd.out, 0, CRD_SECTOR);
+	memcpy(crd.out, hdr, sizeof(*hdr));
+	if (w.mmc->block_dev.block_write(w.poll_dev, crd.start, 1,
+					 crd.out) != 1) {
+		pr_emerg("crash_ramdump: header write failed\n");
+		return -EIO;
+	}
+
+	pr_emerg("crash_ramdump: %u pages in %u KB, %u ms\n",
+		 hdr->pages_dumped, hdr->dump_length >> 10, hdr->dump_ms);
+	return w.err;
+}
+
+/* what the partition has from the last crash */
+static void crd_show_last(struct block_device *bdev)
+{
+	struct crd_header *hdr;
+	Sector sect;
+
+	hdr = (struct crd_header *)read_dev_sector(bdev, 0, &sect);
+	if (!hdr)
+		return;
+	if (hdr->magic == CRD_MAGIC && hdr->version == CRD_VERSION)
+		pr_info("crash_ramdump: %s has a dump, %u of %u pages "
+			"in %u KB, %u ms%s\n", part, hdr->pages_dumped,
+			hdr->pages, hdr->dump_length >> 10, hdr->dump_ms,
+			hdr->flags & CRD_TRUNCATED ? ", truncated" : "");
+	put_dev_sector(sect);
+}
+
+static int crd_find_part(void)
+{
+	struct block_device *bdev;
+	const char *name;
+	dev_t devt;
+
+	devt = name_to_dev_t(part);
+	if (!devt)
+		return -ENODEV;
+	bdev = blkdev_get_by_dev(devt, FMODE_READ, NULL);
+	if (IS_ERR(bdev))
+		return PTR_ERR(bdev);
+
+	/* the polled stack numbers the eMMCs as the disks, mmcblk<n> */
+	name = bdev->bd_disk->disk_name;
+	crd.dev_num = isdigit(name[strlen(name) - 1]) ?
+		      name[strlen(name) - 1] - '0' : 0;
+	crd.start = bdev->bd_part->start_sect;
+	crd.nr_sects = bdev->bd_part->nr_sects;
+	crd_show_last(bdev);
+	blkdev_put(bdev, FMODE_READ);
+
+	crd.ready = true;
+	pr_info("crash_ramdump: %s, %llu MB\n", part,
+		(unsigned long long)crd.nr_sects >> 11);
+	return 0;
+}
+
+/* the eMMC probes late and asynchronously, so look for a while */
+#define CRD_FIND_TRIES		30
+
+static struct delayed_work crd_find_work;
+static int crd_find_tries;
+
+static void crd_find(struct work_struct *work)
+{
+	if (!crd.in || !*part || crd.ready)
+		return;
+	if (!crd_find_part())
+		return;
+	if (++crd_find_tries < CRD_FIND_TRIES)
+		schedule_delayed_work(&crd_find_work, HZ);
+	else
+		pr_err("crash_ramdump: no partition %s\n", part);
+}
+
+static int crd_set_part(const char *val, const struct kernel_param *kp)
+{
+	int ret = param_set_copystring(val, kp);
+
+	if (ret)
+		return ret;
+	strim(part);
+	crd.ready = false;
+	crd_find_tries = 0;
+	if (crd.in)
+		mod_delayed_work(system_wq, &crd_find_work, 0);
+	return 0;
+}
+
+static struct kparam_string crd_part_str = {
+	.maxlen = sizeof(part),
+	.string = part,
+};
+
+static struct kernel_param_ops crd_part_ops = {
+	.set = crd_set_part,
+	.get = param_get_string,
+};
+module_param_cb(part, &crd_part_ops, &crd_part_str, 0644);
+
+static int __init crash_ramdump_init(void)
+{
+	phys_addr_t start = memblock_start_of_DRAM();
+
+	crd.base_pfn = PFN_DOWN(start);
+	crd.pages = PFN_DOWN(memblock_end_of_DRAM() - start);
+	crd.free_map = vzalloc(BITS_TO_LONGS(crd.pages) * sizeof(long));
+	crd.in = vmalloc(CRD_CHUNK);
+	crd.cbuf = vmalloc(lz4_compressbound(CRD_CHUNK));
+	crd.wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	/* a flush leaves less than a sector, then a frame and the padding */
+	crd.out = kmalloc(CRD_FLUSH + sizeof(struct crd_frame) +
+			  lz4_compressbound(CRD_CHUNK) + CRD_SECTOR,
+			  GFP_KERNEL);
+	if (!crd.free_map || !crd.in || !crd.cbuf || !crd.wrkmem ||
+	    !crd.out) {
+		pr_err("%s: failed to allocate the dump buffers\n", __func__);
+		vfree(crd.free_map);
+		vfree(crd.in);
+		vfree(crd.cbuf);
+		kfree(crd.wrkmem);
+		kfree(crd.out);
+		crd.in = NULL;
+		return -ENOMEM;
+	}
+
+	INIT_DELAYED_WORK(&crd_find_work, crd_find);
+	schedule_delayed_work(&crd_find_work, 0);
+	return 0;
+}
+late_initcall(crash_ramdump_init);
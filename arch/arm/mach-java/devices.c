@@ -47,6 +47,7 @@
 #include <mach/kona.h>
 #include <mach/pinmux.h>
 #include <mach/hawaii.h>
+#include <mach/atag_dt.h>
 #include <mach/rdb/brcm_rdb_uartb.h>
 #include <plat/chal/chal_trace.h>
 #ifdef CONFIG_KONA_AVS
@@ -500,6 +501,18 @@ struct platform_device hawaii_backlight_device = {
 };
 #endif
 
+#ifdef CONFIG_JAVA_PMU_CTI
+/* the overflow interrupts of all cores, through their CTIs */
+struct platform_device pmu_device = {
+	.name = "arm-pmu",
+	.id = -1,
+	.resource = java_pmu_resources,
+	.num_resources = JAVA_PMU_CTIS,
+	.dev = {
+		.platform_data = &java_pmu_platdata,
+	},
+};
+#else
 static struct resource hawaii_pmu_resource = {
 	.start = BCM_INT_ID_PMU_IRQ0,
 	.end = BCM_INT_ID_PMU_IRQ0,
@@ -512,6 +525,7 @@ struct platform_device pmu_device = {
 	.resource = &hawaii_pmu_resource,
 	.num_resources = 1,
 };
+#endif
 
 static struct resource hawaii_pwm_resource = {
 	.start = PWM_BASE_ADDR,
@@ -821,6 +835,9 @@ struct kona_cpufreq_drv_pdata kona_cpufreq_drv_pdata = {
 	.pi_id = PI_MGR_PI_ID_ARM_CORE,
 	.cpufreq_init = hawaii_cpufreq_init,
 	.flags = KONA_CPUFREQ_UPDATE_LPJ | KONA_CPUFREQ_TMON,
+#if defined(CONFIG_KONA_CPU_FREQ_ENERGY) && defined(CONFIG_KONA_AVS)
+	.get_opp_volt = avs_get_opp_volt,
+#endif
 };
 
 struct platform_device kona_cpufreq_device = {
@@ -1582,6 +1599,7 @@ static void reserve_secure_memory(void)
 
 void __init hawaii_reserve(void)
 {
+	kona_splash_reserve();
 #ifdef CONFIG_MOBICORE_DRIVER
 	mobicore_reserve_memory();
 #endif
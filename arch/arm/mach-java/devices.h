@@ -8,6 +8,11 @@ int configure_sdio_pullup(bool pull_up);
 extern struct platform_device hawaii_serial_device;
 extern struct platform_device hawaii_i2c_adap_devices[];
 extern struct platform_device pmu_device;
+#ifdef CONFIG_JAVA_PMU_CTI
+#define JAVA_PMU_CTIS	2
+extern struct resource java_pmu_resources[JAVA_PMU_CTIS];
+extern struct arm_pmu_platdata java_pmu_platdata;
+#endif
 extern struct platform_device hawaii_pwm_device;
 extern struct platform_device hawaii_ssp0_device;
 extern struct platform_device hawaii_ssp1_device;
@@ -20,6 +20,11 @@
 #include <asm/memory.h>
 #include <linux/dma-mapping.h>
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/tick.h>
+#include <linux/clockchips.h>
+#include <linux/pm_qos.h>
+#include <linux/irqchip/arm-gic.h>
 #include <asm/suspend.h>
 #include <mach/io_map.h>
 #include <mach/rdb/brcm_rdb_chipreg.h>
@@ -31,6 +36,7 @@
 #include <mach/rdb/brcm_rdb_swstm.h>
 #include <plat/pi_mgr.h>
 #include <plat/pwr_mgr.h>
+#include <plat/kona_pm.h>
 #include <mach/kona_timer.h>
 #include <mach/memory.h>
 #include <asm/hardware/cache-l2x0.h>
@@ -108,6 +114,19 @@ static DEFINE_PER_CPU(u32, cdm_failure_cene);
 static DEFINE_PER_CPU(u32, cdm_failure_misc);
 static DEFINE_PER_CPU(u32, cdm_attempts);
 
+/*
+ * Context that is only saved when it may have changed: the GIC
+ * priorities, targets and configuration are saved again only after
+ * gic_config_generation() moved, and the VFP registers not at all when
+ * they only mirror a state the VFP code already keeps in memory.
+ */
+static DEFINE_PER_CPU(u32, gic_private_gen);
+static DEFINE_PER_CPU(bool, vfp_saved);
+static DEFINE_PER_CPU(u32, ctx_vfp_skipped);
+static u32 gic_shared_gen;
+static u32 ctx_gic_full;
+static u32 ctx_gic_update;
+
 static u8 svc_req[DRMT_SVC_MAX];
 
 static u32 fdm_success;
@@ -131,6 +150,27 @@ static int pllarma_inx = -1;
 static u32 fdm_time;
 static u32 fdm_time_en;
 
+/*
+ * Coupled cluster dormant: unless cpl_en is cleared, the last core lets the
+ * cluster go as deep as the earliest local timer of the cores still in
+ * dormant allows, instead of the shallowest service voted for by the
+ * cores, each from its own idle prediction:
+ *
+ *	cluster idle < cpl_fdm_us	core dormant, cluster stays on
+ *	cluster idle < cpl_l2_off_us	full dormant, L2 retained
+ *	otherwise			full dormant, L2 off
+ *
+ * Full dormant is only taken if the cpu_dma_latency QoS allows its exit
+ * latency. Suspend and hotplug votes for L2 off are always kept.
+ */
+static u32 cpl_en = 1;
+static u32 cpl_fdm_us = TRGT_RESI_SUSPEND_DRMT;
+static u32 cpl_l2_off_us = 5 * TRGT_RESI_SUSPEND_DRMT;
+static u32 cpl_deeper;		/* cluster taken deeper than the votes */
+static u32 cpl_shallower;	/* and shallower */
+static ktime_t drmt_wake[CONFIG_NR_CPUS];	/* under drmt_lock */
+static struct cpumask drmt_cpus;
+
 /* Data for the entire cluster */
 static DEFINE_SPINLOCK(drmt_lock);
 
@@ -256,10 +296,16 @@ static int dormant_enter_continue(unsigned long svc);
 static void set_svc_req(u32 svc)
 {
 	unsigned long flgs;
+	struct clock_event_device *evt;
+	u32 cpu = smp_processor_id();
+
+	evt = tick_get_device(cpu)->evtdev;
 	spin_lock_irqsave(&drmt_lock, flgs);
 	BUG_ON(svc >= DRMT_SVC_MAX ||
 	svc_req[svc] > CONFIG_NR_CPUS);
 	svc_req[svc]++;
+	drmt_wake[cpu].tv64 = evt ? evt->next_event.tv64 : KTIME_MAX;
+	cpumask_set_cpu(cpu, &drmt_cpus);
 	spin_unlock_irqrestore(&drmt_lock, flgs);
 }
 
@@ -270,6 +316,7 @@ static void clr_svc_req(u32 svc)
 	BUG_ON(svc >= DRMT_SVC_MAX ||
 		svc_req[svc] == 0);
 	svc_req[svc]--;
+	cpumask_clear_cpu(smp_processor_id(), &drmt_cpus);
 	spin_unlock_irqrestore(&drmt_lock, flgs);
 }
 
@@ -286,6 +333,42 @@ static u32 get_svc(void)
 	return i;
 }
 
+/* service for the whole cluster, called by the last core with its vote */
+static u32 get_coupled_svc(u32 svc)
+{
+	unsigned long flgs;
+	ktime_t wake = { .tv64 = KTIME_MAX };
+	s64 idle_us;
+	u32 cpl_svc;
+	int i;
+
+	if (svc == FULL_DORMANT_L2_OFF)
+		return svc;
+
+	spin_lock_irqsave(&drmt_lock, flgs);
+	for_each_cpu(i, &drmt_cpus) {
+		/* a core on its way out of hotplug has no timer left */
+		if (cpu_online(i) && drmt_wake[i].tv64 < wake.tv64)
+			wake = drmt_wake[i];
+	}
+	spin_unlock_irqrestore(&drmt_lock, flgs);
+
+	idle_us = ktime_us_delta(wake, ktime_get());
+	if (idle_us < cpl_fdm_us ||
+		pm_qos_request(PM_QOS_CPU_DMA_LATENCY) < EXIT_LAT_SUSPEND_DRMT)
+		cpl_svc = CORE_DORMANT;
+	else if (idle_us < cpl_l2_off_us || !l2_off_en)
+		cpl_svc = FULL_DORMANT_L2_ON;
+	else
+		cpl_svc = FULL_DORMANT_L2_OFF;
+
+	if (cpl_svc > svc)
+		cpl_deeper++;
+	else if (cpl_svc < svc)
+		cpl_shallower++;
+	return cpl_svc;
+}
+
 
 /*  PWRCTL1_bypass & PWRCTL0_bypass in Periph Spare Control2
  * registers holds CPU power mode. Boot ROM reads this register
@@ -476,20 +559,64 @@ static void local_secure_api(unsigned service_id,
 }
 
 /* Save all the local data for this cpu */
+static void save_vfp_context(void)
+{
+#ifdef CONFIG_VFP
+	if (vfp_release_hwstate()) {
+		__get_cpu_var(vfp_saved) = false;
+		__get_cpu_var(ctx_vfp_skipped)++;
+		return;
+	}
+#endif
+	save_vfp((void *)__get_cpu_var(vfp_data));
+	__get_cpu_var(vfp_saved) = true;
+}
+
+static void save_gic_private_context(void)
+{
+	u32 gen = gic_config_generation();
+
+	if (__get_cpu_var(gic_private_gen) == gen) {
+		update_gic_distributor_private((void *)
+				__get_cpu_var(gic_dist_private_data),
+				(u32)KONA_GICDIST_VA, false);
+		return;
+	}
+	save_gic_distributor_private((void *)
+				     __get_cpu_var(gic_dist_private_data),
+				     (u32)KONA_GICDIST_VA, false);
+	__get_cpu_var(gic_private_gen) = gen;
+}
+
+/* last core in, under the CDC handshake */
+static void save_gic_shared_context(void)
+{
+	u32 gen = gic_config_generation();
+
+	if (gic_shared_gen == gen) {
+		update_gic_distributor_shared((void *)gic_dist_shared_data,
+					      (u32)KONA_GICDIST_VA, false);
+		ctx_gic_update++;
+		return;
+	}
+	save_gic_distributor_shared((void *)gic_dist_shared_data,
+				    (u32)KONA_GICDIST_VA, false);
+	gic_shared_gen = gen;
+	ctx_gic_full++;
+}
+
 static void save_arm_context(void)
 {
 	save_performance_monitors((void *)__get_cpu_var(pmu_data));
 
 	save_generic_timer((void *)__get_cpu_var(timer_data));
 
-	save_vfp((void *)__get_cpu_var(vfp_data));
+	save_vfp_context();
 
 	save_gic_interface((void *)__get_cpu_var(gic_interface_data),
 			   (u32)KONA_GICCPU_VA, false);
 
-	save_gic_distributor_private((void *)
-				     __get_cpu_var(gic_dist_private_data),
-				     (u32)KONA_GICDIST_VA, false);
+	save_gic_private_context();
 
 	save_banked_registers((void *)__get_cpu_var(banked_registers));
 
@@ -529,11 +656,14 @@ static void restore_arm_context(bool restore_gic)
 	restore_banked_registers((void *)
 				 __get_cpu_var(banked_registers));
 
-	restore_vfp((void *)__get_cpu_var(vfp_data));
+	if (__get_cpu_var(vfp_saved))
+		restore_vfp((void *)__get_cpu_var(vfp_data));
 
 	restore_generic_timer((void *)__get_cpu_var(timer_data));
 
 	restore_performance_monitors((void *)__get_cpu_var(pmu_data));
+
+	java_pmu_cti_restore();
 }
 
 /******************* Public Functions ***************/
@@ -577,6 +707,8 @@ void dormant_enter(u32 svc)
 
 	case CDC_STATUS_RFDLC:
 		svc_max = get_svc();
+		if (cpl_en)
+			svc_max = get_coupled_svc(svc_max);
 
 		if (fdm_en && (FULL_DORMANT_L2_ON == svc_max ||
 			FULL_DORMANT_L2_OFF == svc_max)) {
@@ -610,8 +742,7 @@ void dormant_enter(u32 svc)
 		cdc_set_override(IS_IDLE_OVERRIDE, 0x1C0);
 		save_proc_clk_regs();
 		save_addnl_regs();
-		save_gic_distributor_shared((void *)gic_dist_shared_data,
-					    (u32)KONA_GICDIST_VA, false);
+		save_gic_shared_context();
 		if (l2_off_en && svc_max == FULL_DORMANT_L2_OFF)
 			pwr_ctrl = CDC_PWR_DRMNT_L2_OFF;
 		else
@@ -635,6 +766,7 @@ void dormant_enter(u32 svc)
 		/*dormant_enter_continue will turn OFF L2 mem only if
 			 - svc_max == FULL_DORMANT_L2_OFF and
 			 - CDC status == FDCEOK (last core entering dormant)*/
+		kona_idle_adapt_stamp();
 		drmt_status = cpu_suspend(svc_max, dormant_enter_continue);
 		instrument_lpm(LPM_TRACE_DRMNT_WAKEUP, drmt_status);
 		break;
@@ -925,6 +1057,10 @@ static int __init dm_debug_init(void)
 			cpu_dir[cpu], (u32 *)&per_cpu(cdm_attempts, cpu)))
 			goto err;
 
+		if (!debugfs_create_u32("ctx_vfp_skipped", S_IRUGO,
+			cpu_dir[cpu], &per_cpu(ctx_vfp_skipped, cpu)))
+			goto err;
+
 	}
 	if (!debugfs_create_u32("l2_off_cnt", S_IRUGO,
 			dm_root_dir, &l2_off_cnt))
@@ -962,6 +1098,34 @@ static int __init dm_debug_init(void)
 			dm_root_dir, &dbg_log))
 		goto err;
 
+	if (!debugfs_create_u32("ctx_gic_full", S_IRUGO,
+			dm_root_dir, &ctx_gic_full))
+		goto err;
+
+	if (!debugfs_create_u32("ctx_gic_update", S_IRUGO,
+			dm_root_dir, &ctx_gic_update))
+		goto err;
+
+	if (!debugfs_create_u32("cpl_en", S_IRUGO | S_IWUSR,
+			dm_root_dir, &cpl_en))
+		goto err;
+
+	if (!debugfs_create_u32("cpl_fdm_us", S_IRUGO | S_IWUSR,
+			dm_root_dir, &cpl_fdm_us))
+		goto err;
+
+	if (!debugfs_create_u32("cpl_l2_off_us", S_IRUGO | S_IWUSR,
+			dm_root_dir, &cpl_l2_off_us))
+		goto err;
+
+	if (!debugfs_create_u32("cpl_deeper", S_IRUGO | S_IWUSR,
+			dm_root_dir, &cpl_deeper))
+		goto err;
+
+	if (!debugfs_create_u32("cpl_shallower", S_IRUGO | S_IWUSR,
+			dm_root_dir, &cpl_shallower))
+		goto err;
+
 	return 0;
 err:
 	debugfs_remove_recursive(dm_root_dir);
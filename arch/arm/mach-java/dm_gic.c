@@ -148,6 +148,24 @@ int save_gic_distributor_private(appf_u32 *pointer, unsigned gic_distributor_add
     }        
 }
 
+/*
+ * Refreshes the enable and pending words of a copy made earlier by
+ * save_gic_distributor_private, for when the priorities, targets and
+ * configuration have not been written since.
+ * Returns non-zero if an SGI/PPI interrupt is pending
+ */
+int update_gic_distributor_private(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure)
+{
+    interrupt_distributor *id = (interrupt_distributor *)gic_distributor_address;
+
+    pointer[0] = id->enable.set[0];
+    /* enable, 8 priority and 8 target words, security, configuration */
+    pointer += 1 + 8 + 8 + (is_secure ? 1 : 0) + 1;
+    *pointer = id->pending.set[0];
+
+    return *pointer ? -1 : 0;
+}
+
 /*
  * Saves the shared parts of the distributor.
  * Requires 1 word of memory, plus 20 words for each block of 32 SPIs (max 641 words)
@@ -196,6 +214,46 @@ int save_gic_distributor_shared(appf_u32 *pointer, unsigned gic_distributor_addr
     return retval;
 }
 
+/*
+ * Refreshes the enable, pending and control words of a copy made earlier
+ * by save_gic_distributor_shared, for when the priorities, targets and
+ * configuration have not been written since.
+ * Returns non-zero if an SPI interrupt is pending
+ */
+int update_gic_distributor_shared(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure)
+{
+    interrupt_distributor *id = (interrupt_distributor *)gic_distributor_address;
+    unsigned num_spis, *saved_pending;
+    int i, retval = 0;
+
+    num_spis = 32 * (id->controller_type & 0x1f);
+
+    if (num_spis)
+    {
+        copy_words(pointer, id->enable.set + 1, num_spis / 32);
+        pointer += num_spis / 32 + num_spis / 4 + num_spis / 4 + num_spis / 16;
+        if (is_secure)
+        {
+            pointer += num_spis / 32;
+        }
+        saved_pending = pointer;
+        pointer = copy_words(pointer, id->pending.set + 1, num_spis / 32);
+
+        for (i=0; i<num_spis/32; ++i)
+        {
+            if (saved_pending[i])
+            {
+                retval = -1;
+                break;
+            }
+        }
+    }
+
+    *pointer = id->control;
+
+    return retval;
+}
+
 void restore_gic_interface(appf_u32 *pointer, unsigned gic_interface_address, int is_secure)
 {
     cpu_interface *ci = (cpu_interface *)gic_interface_address;
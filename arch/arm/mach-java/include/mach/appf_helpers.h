@@ -113,6 +113,8 @@ extern int gic_distributor_set_enabled(int enabled, unsigned gic_distributor_add
 extern void save_gic_interface(appf_u32 *pointer, unsigned gic_interface_address, int is_secure);
 extern int save_gic_distributor_private(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure);
 extern int save_gic_distributor_shared(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure);
+extern int update_gic_distributor_private(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure);
+extern int update_gic_distributor_shared(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure);
 extern void restore_gic_interface(appf_u32 *pointer, unsigned gic_interface_address, int is_secure);
 extern void restore_gic_distributor_private(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure);
 extern void restore_gic_distributor_shared(appf_u32 *pointer, unsigned gic_distributor_address, int is_secure);
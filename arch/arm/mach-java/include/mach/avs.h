@@ -104,4 +104,6 @@ struct avs_pdata {
 	u32 pwrwdog_base;
 };
 
+int avs_get_opp_volt(int opp);
+
 #endif	  /*__KONA_AVS___*/
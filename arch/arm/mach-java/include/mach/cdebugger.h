@@ -88,4 +88,13 @@ static inline void cdebugger_set_upload_magic(unsigned magic)
 }
 #endif
 
+#ifdef CONFIG_CDEBUGGER_RAMDUMP_MMC
+extern int cdebugger_ramdump_mmc(void);
+#else
+static inline int cdebugger_ramdump_mmc(void)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif /* CDEBUGGER_H */
@@ -158,6 +158,12 @@ extern void instrument_lpm(u16 trace, u16 param);
 extern int get_force_sleep_state(void);
 extern int pm_is_forced_sleep(void);
 
+#ifdef CONFIG_JAVA_PMU_CTI
+extern void java_pmu_cti_restore(void);
+#else
+static inline void java_pmu_cti_restore(void) { }
+#endif
+
 #endif /* __ASSEMBLY__ */
 
 #endif /*__HAWAII_PM_H__*/
@@ -64,12 +64,26 @@ extern bool mobicore_sleep_ready(void);
 #define SMC_CMD_SLEEP		(-3)
 #endif
 
+/*
+ * One call of a secure_api_call_batch() list, ret is filled in with r0 of
+ * the secure monitor.
+ */
+struct sec_api_cmd {
+	unsigned service_id;
+	unsigned arg0;
+	unsigned arg1;
+	unsigned arg2;
+	unsigned arg3;
+	unsigned ret;
+};
+
 #ifdef CONFIG_KONA_SECURE_MONITOR_CALL
 extern void secure_api_call_init(void);
 
 extern int secure_api_call_local(unsigned long service_id);
 extern unsigned secure_api_call(unsigned service_id, unsigned arg0,
 	unsigned arg1, unsigned arg2, unsigned arg3);
+extern void secure_api_call_batch(struct sec_api_cmd *cmds, int nr);
 
 extern unsigned get_secure_buffer(void);
 
@@ -80,6 +94,9 @@ static inline void secure_api_call_init(void) { };
 static inline unsigned secure_api_call(unsigned service_id, unsigned arg0,
 	unsigned arg1, unsigned arg2, unsigned arg3) { return 0; };
 
+static inline void secure_api_call_batch(struct sec_api_cmd *cmds,
+	int nr) { };
+
 static inline unsigned get_secure_buffer(void) { return 0; }
 
 static inline unsigned get_secure_buffer_size(void) { return 0; }
@@ -254,6 +254,8 @@ static struct axitrace_source trace_sources[] = {
 		.masters	= mm_masters,
 		.slaves		= axitrace17_slaves,
 		.axi_id_mask	= 7,
+		.ddr_port	= 1,
+		.prof_name	= "MM",
 		.resource	= &axitrace17_resource,
 		.map		= trace17_funnel,
 	},
@@ -276,6 +278,8 @@ static struct axitrace_source trace_sources[] = {
 		.masters	= axitrace4_1_masters,
 		.slaves		= axitrace4_slaves,
 		.axi_id_mask	= 0,
+		.ddr_port	= 1,
+		.prof_name	= "ARM",
 		.resource	= &axitrace4_resource,
 		.map		= trace4_funnel,
 	},
@@ -298,6 +302,7 @@ static struct axitrace_source trace_sources[] = {
 		.masters	= axitrace2_masters,
 		.slaves		= axitrace_all_slaves,
 		.axi_id_mask	= 0xF,
+		.prof_name	= "DMA",
 		.resource	= &axitrace2_resource,
 		.map		= trace2_funnel,
 	},
@@ -354,6 +359,8 @@ static struct axitrace_source trace_sources[] = {
 		.masters	= axitrace20_masters,
 		.slaves		= axitrace_all_slaves,
 		.axi_id_mask	= 0x3,
+		.ddr_port	= 1,
+		.prof_name	= "MM2",
 		.resource	= &axitrace20_resource,
 		.map		= trace20_funnel,
 	},
@@ -0,0 +1,163 @@
+/*
+ * arch/arm/mach-java/java_pmu.c
+ *
+ * PMU overflow interrupts through the cross trigger interfaces.
+ *
+ * Only the PMU of CPU0 has a direct line to the GIC that perf can use, so
+ * on the other cores sampling events never interrupt. Each core's CTI
+ * takes the PMU overflow of its core on trigger input 1; mapped to
+ * trigger output 6 it raises the core's CTI interrupt, which perf then
+ * requests in place of the PMU lines, one per core. The interrupt is
+ * acked in the CTI after the PMU handler has cleared the overflow.
+ *
+ * The CTIs are set up while the PMU is in use, between its runtime
+ * resume and suspend, each by its own core. A core that comes back from
+ * hotplug or from dormant, its debug logic powered down, sets its CTI up
+ * again.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/clk.h>
+#include <linux/cpu.h>
+#include <linux/err.h>
+#include <linux/interrupt.h>
+#include <linux/io.h>
+#include <linux/platform_device.h>
+#include <linux/smp.h>
+#include <asm/cti.h>
+#include <asm/pmu.h>
+#include <mach/io_map.h>
+#include <mach/irqs.h>
+#include <mach/clock.h>
+#include <mach/pm.h>
+#include "devices.h"
+
+/* the core CTIs follow each other, as in the Cortex-A7 debug map */
+#define JAVA_CTI_STRIDE		SZ_4K
+#define JAVA_CTI_PMU_TRIG_IN	1	/* PMUIRQ */
+#define JAVA_CTI_IRQ_TRIG_OUT	6	/* CTIIRQ */
+#define JAVA_CTI_PMU_CHANNEL	2
+
+/* the CTI interrupts of the cores, in core order */
+struct resource java_pmu_resources[JAVA_PMU_CTIS] = {
+	{
+		.start	= BCM_INT_ID_CTI_IRQ0,
+		.end	= BCM_INT_ID_CTI_IRQ0,
+		.flags	= IORESOURCE_IRQ,
+	},
+	{
+		.start	= BCM_INT_ID_CTI_IRQ1,
+		.end	= BCM_INT_ID_CTI_IRQ1,
+		.flags	= IORESOURCE_IRQ,
+	},
+};
+
+static struct cti java_cti[JAVA_PMU_CTIS];
+static void __iomem *java_cti_base;
+static struct clk *java_cti_clk;
+static bool java_cti_on;
+
+static void java_cti_setup(void *unused)
+{
+	unsigned int cpu = smp_processor_id();
+	struct cti *cti;
+
+	if (cpu >= JAVA_PMU_CTIS || !java_cti[cpu].base)
+		return;
+	cti = &java_cti[cpu];
+	cti_unlock(cti);
+	cti_map_trigger(cti, JAVA_CTI_PMU_TRIG_IN, JAVA_CTI_IRQ_TRIG_OUT,
+			JAVA_CTI_PMU_CHANNEL);
+	cti_enable(cti);
+}
+
+static void java_cti_off(void *unused)
+{
+	unsigned int cpu = smp_processor_id();
+
+	if (cpu < JAVA_PMU_CTIS && java_cti[cpu].base)
+		cti_disable(&java_cti[cpu]);
+}
+
+/* after dormant, on the core that comes back */
+void java_pmu_cti_restore(void)
+{
+	if (java_cti_on)
+		java_cti_setup(NULL);
+}
+
+static irqreturn_t java_pmu_handle_irq(int irq, void *dev,
+				       irq_handler_t pmu_handler)
+{
+	unsigned int cpu = smp_processor_id();
+	irqreturn_t ret;
+
+	ret = pmu_handler(irq, dev);
+	if (cpu < JAVA_PMU_CTIS && java_cti[cpu].base)
+		cti_irq_ack(&java_cti[cpu]);
+	return ret;
+}
+
+static int java_pmu_runtime_resume(struct device *dev)
+{
+	if (!IS_ERR_OR_NULL(java_cti_clk))
+		clk_enable(java_cti_clk);
+	java_cti_on = true;
+	on_each_cpu(java_cti_setup, NULL, 1);
+	return 0;
+}
+
+static int java_pmu_runtime_suspend(struct device *dev)
+{
+	java_cti_on = false;
+	on_each_cpu(java_cti_off, NULL, 1);
+	if (!IS_ERR_OR_NULL(java_cti_clk))
+		clk_disable(java_cti_clk);
+	return 0;
+}
+
+struct arm_pmu_platdata java_pmu_platdata = {
+	.handle_irq		= java_pmu_handle_irq,
+	.runtime_resume		= java_pmu_runtime_resume,
+	.runtime_suspend	= java_pmu_runtime_suspend,
+};
+
+static int __cpuinit java_pmu_cpu_callback(struct notifier_block *nb,
+					   unsigned long action, void *hcpu)
+{
+	/* runs on the incoming core, interrupts still off */
+	if ((action & ~CPU_TASKS_FROZEN) == CPU_STARTING && java_cti_on)
+		java_cti_setup(NULL);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block __cpuinitdata java_pmu_cpu_notifier = {
+	.notifier_call = java_pmu_cpu_callback,
+};
+
+static int __init java_pmu_cti_init(void)
+{
+	int i;
+
+	java_cti_base = ioremap(A9CTI0_BASE_ADDR,
+				JAVA_PMU_CTIS * JAVA_CTI_STRIDE);
+	if (!java_cti_base) {
+		pr_err("%s: cannot map the CTIs\n", __func__);
+		return -ENOMEM;
+	}
+	for (i = 0; i < JAVA_PMU_CTIS; i++)
+		cti_init(&java_cti[i], java_cti_base + i * JAVA_CTI_STRIDE,
+			 java_pmu_resources[i].start, JAVA_CTI_IRQ_TRIG_OUT);
+
+	java_cti_clk = clk_get(NULL, CTI_APB_BUS_CLK_NAME_STR);
+	if (IS_ERR(java_cti_clk))
+		pr_warn("%s: no CTI clock\n", __func__);
+	register_hotcpu_notifier(&java_pmu_cpu_notifier);
+	return 0;
+}
+arch_initcall(java_pmu_cti_init);
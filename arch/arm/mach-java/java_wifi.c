@@ -54,7 +54,9 @@ static struct sdio_wifi_gpio_cfg devtreeWifiParms;
 #ifndef CONFIG_MMC_KONA_SDIO_WIFI
 /* Functions below imported from sdio-wifi.c */
 
-struct pin_config SdioPinCfgs;
+static const enum PIN_NAME sdio_pins[] = {
+	PN_MMC1CMD, PN_MMC1DAT0, PN_MMC1DAT1, PN_MMC1DAT2, PN_MMC1DAT3,
+};
 
 struct sdio_wifi_dev {
 	atomic_t dev_is_ready;
@@ -192,38 +194,8 @@ static int bcm_sdiowl_init(int onoff)
 
 /* Set the Pull of Sdio Lines first */
 
-	SdioPinCfgs.name = PN_MMC1CMD;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 0;
-	SdioPinCfgs.reg.b.pull_up = 1;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-
-	SdioPinCfgs.name = PN_MMC1DAT0;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 0;
-	SdioPinCfgs.reg.b.pull_up = 1;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-	SdioPinCfgs.name = PN_MMC1DAT1;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 0;
-	SdioPinCfgs.reg.b.pull_up = 1;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-
-	SdioPinCfgs.name = PN_MMC1DAT2;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 0;
-	SdioPinCfgs.reg.b.pull_up = 1;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-
-	SdioPinCfgs.name = PN_MMC1DAT3;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 0;
-	SdioPinCfgs.reg.b.pull_up = 1;
-	pinmux_set_pin_config(&SdioPinCfgs);
+	pinmux_update_pins(sdio_pins, ARRAY_SIZE(sdio_pins),
+			   PINMUX_PULL_UP | PINMUX_PULL_DN, PINMUX_PULL_UP);
 
 
 /* ----------------------------------- */
@@ -335,38 +307,8 @@ static void bcm_sdiowl_term(void)
  * 4334 bug requires us to Pull down on sdio lines on reset
  */
 
-	SdioPinCfgs.name = PN_MMC1CMD;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 1;
-	SdioPinCfgs.reg.b.pull_up = 0;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-
-	SdioPinCfgs.name = PN_MMC1DAT0;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 1;
-	SdioPinCfgs.reg.b.pull_up = 0;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-	SdioPinCfgs.name = PN_MMC1DAT1;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 1;
-	SdioPinCfgs.reg.b.pull_up = 0;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-
-	SdioPinCfgs.name = PN_MMC1DAT2;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 1;
-	SdioPinCfgs.reg.b.pull_up = 0;
-	pinmux_set_pin_config(&SdioPinCfgs);
-
-
-	SdioPinCfgs.name = PN_MMC1DAT3;
-	pinmux_get_pin_config(&SdioPinCfgs);
-	SdioPinCfgs.reg.b.pull_dn = 1;
-	SdioPinCfgs.reg.b.pull_up = 0;
-	pinmux_set_pin_config(&SdioPinCfgs);
+	pinmux_update_pins(sdio_pins, ARRAY_SIZE(sdio_pins),
+			   PINMUX_PULL_UP | PINMUX_PULL_DN, PINMUX_PULL_DN);
 
 
 /*----------------------------------- */
@@ -197,6 +197,7 @@ ret:
 
 int enter_wfi_state(struct kona_idle_state *state, u32 ctrl_params)
 {
+	kona_idle_adapt_stamp();
 	enter_wfi();
 	return -1;
 }
@@ -221,8 +222,10 @@ int __enter_drmt(u32 ctrl_params)
 		return 0;
 #endif
 		dormant_enter(svc);
-	} else
+	} else {
+		kona_idle_adapt_stamp();
 		enter_wfi();
+	}
 #endif /* CONFIG_DORMANT_MODE */
 	return 0;
 }
@@ -17,11 +17,15 @@
 #include <linux/smp.h>
 #include <linux/io.h>
 #include <linux/ioport.h>
+#include <linux/sched.h>
 #include <plat/clock.h>
 #include <mach/sram_config.h>
 
 #include <asm/cacheflush.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/kona_smc.h>
+
 #define SEC_EXIT_NORMAL 1
 #define SSAPI_RET_FROM_INT_SERV 4
 
@@ -41,6 +45,11 @@ struct sec_api_data {
 	unsigned arg3;
 };
 
+struct sec_api_batch {
+	struct sec_api_cmd *cmds;
+	int nr;
+};
+
 unsigned get_secure_buffer(void)
 {
 	return SEC_BUFFER_ADDR;
@@ -144,57 +153,89 @@ int secure_api_call_local(unsigned long service_id)
 /* This function exclusively runs on Core 0 with preemption disabled */
 static void secure_api_call_shim(void *info)
 {
-	struct sec_api_data *data = (struct sec_api_data *)info;
-#ifdef CONFIG_MOBICORE_DRIVER
-#else
+	struct sec_api_batch *batch = (struct sec_api_batch *)info;
+	struct sec_api_cmd *cmd;
+#ifndef CONFIG_MOBICORE_DRIVER
+	struct sec_api_data data;
+#endif
+	u64 start;
+	int i;
+
+#ifndef CONFIG_MOBICORE_DRIVER
 	/* Check map in the bounce area */
 	BUG_ON(!bridge_data.initialized);
-
-	/* Copy one 32 bit word into the bounce area */
-	bridge_data.bounce[0] = data->arg0;
-	bridge_data.bounce[1] = data->arg1;
-	bridge_data.bounce[2] = data->arg2;
-	bridge_data.bounce[3] = data->arg3;
 #endif
 
-	/* Flush caches for input data passed to Secure Monitor */
+	/*
+	 * Flush caches for input data passed to Secure Monitor, once for
+	 * the whole list as it was all written before the cross call.
+	 */
 	flush_cache_all();
 
-	/*printk(KERN_NOTICE "About to trap into Secure Monitor on CPU %d\n",
-		raw_smp_processor_id());*/
+	for (i = 0; i < batch->nr; i++) {
+		cmd = &batch->cmds[i];
+		start = local_clock();
 #ifdef CONFIG_MOBICORE_DRIVER
-	mobicore_smc(data->service_id, data->arg0, data->arg1, data->arg2);
+		cmd->ret = mobicore_smc(cmd->service_id, cmd->arg0, cmd->arg1,
+					cmd->arg2);
 #else
-	/* Trap into Secure Monitor */
-	smc(data);
+		/* Copy the arguments into the uncached bounce area */
+		bridge_data.bounce[0] = cmd->arg0;
+		bridge_data.bounce[1] = cmd->arg1;
+		bridge_data.bounce[2] = cmd->arg2;
+		bridge_data.bounce[3] = cmd->arg3;
+
+		/* Trap into Secure Monitor */
+		data.service_id = cmd->service_id;
+		cmd->ret = smc(&data);
 #endif
+		trace_kona_smc(cmd->service_id, cmd->ret, batch->nr,
+			       local_clock() - start);
+	}
 }
 
-unsigned secure_api_call(unsigned service_id, unsigned arg0, unsigned arg1,
-	unsigned arg2, unsigned arg3)
+/*
+ * Issue a list of secure monitor calls in order, with a single cross
+ * call to Core 0 and cache flush for all of them.
+ */
+void secure_api_call_batch(struct sec_api_cmd *cmds, int nr)
 {
-	struct sec_api_data data;
+	struct sec_api_batch batch = {
+		.cmds = cmds,
+		.nr = nr,
+	};
 	struct clk *spum_sec_clk = NULL;
+	int i;
 
-	if (service_id == SSAPI_ROW_AES) {
-		spum_sec_clk = clk_get(NULL, "spum_sec");
-		if (spum_sec_clk == NULL)
-			return 0;
+	for (i = 0; i < nr; i++) {
+		if (cmds[i].service_id == SSAPI_ROW_AES) {
+			spum_sec_clk = clk_get(NULL, "spum_sec");
+			if (spum_sec_clk == NULL)
+				return;
 
-		clk_enable(spum_sec_clk);
+			clk_enable(spum_sec_clk);
+			break;
+		}
 	}
 
-	data.service_id = service_id;
-	data.arg0 = arg0;
-	data.arg1 = arg1;
-	data.arg2 = arg2;
-	data.arg3 = arg3;
-
 	/* Request Secure Monitor Code Run from Core 0 */
-	smp_call_function_single(0, secure_api_call_shim, (void *)&data, 1);
+	smp_call_function_single(0, secure_api_call_shim, (void *)&batch, 1);
 
 	if (spum_sec_clk != NULL)
 		clk_disable(spum_sec_clk);
+}
 
+unsigned secure_api_call(unsigned service_id, unsigned arg0, unsigned arg1,
+	unsigned arg2, unsigned arg3)
+{
+	struct sec_api_cmd cmd = {
+		.service_id = service_id,
+		.arg0 = arg0,
+		.arg1 = arg1,
+		.arg2 = arg2,
+		.arg3 = arg3,
+	};
+
+	secure_api_call_batch(&cmd, 1);
 	return 0;
 }
@@ -37,7 +37,7 @@ static void v6_copy_user_highpage_nonaliasing(struct page *to,
 
 	kfrom = kmap_atomic(from);
 	kto = kmap_atomic(to);
-	copy_page(kto, kfrom);
+	copy_page_neon(kto, kfrom);
 	kunmap_atomic(kto);
 	kunmap_atomic(kfrom);
 }
@@ -49,7 +49,7 @@ static void v6_copy_user_highpage_nonaliasing(struct page *to,
 static void v6_clear_user_highpage_nonaliasing(struct page *page, unsigned long vaddr)
 {
 	void *kaddr = kmap_atomic(page);
-	clear_page(kaddr);
+	clear_page_neon(kaddr);
 	kunmap_atomic(kaddr);
 }
 
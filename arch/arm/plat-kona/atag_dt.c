@@ -25,6 +25,9 @@
 #include <linux/spinlock.h>
 #include <linux/io.h>
 #include <linux/module.h>
+#include <linux/memblock.h>
+#include <linux/mm.h>
+#include <linux/highmem.h>
 #include <asm/setup.h>
 
 #include <linux/of.h>
@@ -53,6 +56,85 @@ static int __init early_init_dt_scan_kona_root(unsigned long node, const char *u
 	return 1;
 }
 
+static struct kona_splash splash;
+static bool splash_reserved;
+static DEFINE_SPINLOCK(splash_lock);
+
+static int __init early_init_dt_scan_splash(unsigned long node,
+				const char *uname, int depth, void *data)
+{
+	const __be32 *reg;
+	const char *panel;
+	unsigned long size;
+
+	if (depth != 1 || strcmp(uname, "splash") != 0)
+		return 0;
+
+	reg = of_get_flat_dt_prop(node, "reg", &size);
+	panel = of_get_flat_dt_prop(node, "panel", NULL);
+	if (!reg || size < 2 * sizeof(*reg) || !panel) {
+		pr_err("splash: no reg or panel\n");
+		return 1;
+	}
+	splash.base = be32_to_cpup(reg);
+	splash.size = PAGE_ALIGN(be32_to_cpup(reg + 1));
+	strlcpy(splash.panel, panel, sizeof(splash.panel));
+	pr_info("splash: %s at 0x%x size 0x%x\n", splash.panel, splash.base,
+		splash.size);
+	return 1;
+}
+
+const struct kona_splash *kona_get_splash(void)
+{
+	return splash.size ? &splash : NULL;
+}
+EXPORT_SYMBOL(kona_get_splash);
+
+/* from the machine's reserve, so nothing is allocated over the frame */
+void __init kona_splash_reserve(void)
+{
+	if (!splash.size || !memblock_is_region_memory(splash.base,
+						       splash.size))
+		return;
+	if (memblock_reserve(splash.base, splash.size)) {
+		pr_err("splash: cannot reserve 0x%x\n", splash.base);
+		return;
+	}
+	splash_reserved = true;
+}
+
+/* the display has left the splash: give its memory to the kernel */
+void kona_splash_release(void)
+{
+	unsigned long pfn, end;
+	struct page *page;
+	bool reserved;
+	u32 size;
+
+	spin_lock(&splash_lock);
+	reserved = splash_reserved;
+	size = splash.size;
+	splash_reserved = false;
+	splash.size = 0;
+	spin_unlock(&splash_lock);
+	if (!reserved)
+		return;
+
+	end = PFN_DOWN(splash.base) + (size >> PAGE_SHIFT);
+	for (pfn = PFN_DOWN(splash.base); pfn < end; pfn++) {
+		page = pfn_to_page(pfn);
+#ifdef CONFIG_HIGHMEM
+		if (PageHighMem(page)) {
+			free_highmem_page(page);
+			continue;
+		}
+#endif
+		free_reserved_page(page);
+	}
+	pr_info("splash: freed %uK\n", size >> 10);
+}
+EXPORT_SYMBOL(kona_splash_release);
+
 static int __init parse_tag_dt(const struct tag *tag)
 {
 	unsigned long dt_root;
@@ -73,6 +155,9 @@ static int __init parse_tag_dt(const struct tag *tag)
 	/* Retrieve info from the /gpio node */
 	of_scan_flat_dt(early_init_dt_scan_gpio, NULL);
 
+	/* Retrieve the splash the bootloader left on the panel */
+	of_scan_flat_dt(early_init_dt_scan_splash, NULL);
+
 #ifdef CONFIG_KONA_DT_BCMPMU
 	of_scan_flat_dt(early_init_dt_scan_pmu, NULL);
 	of_scan_flat_dt(early_init_dt_scan_batt, NULL);
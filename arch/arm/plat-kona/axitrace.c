@@ -35,6 +35,16 @@
 #include <linux/slab.h>
 #include <linux/amba/bus.h>
 #include <linux/io.h>
+#include <linux/spinlock.h>
+#ifdef CONFIG_KONA_AXITRACE_PROF
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/timer.h>
+#include <linux/uaccess.h>
+#include <asm/div64.h>
+#endif
 #include <mach/axitrace.h>
 
 MODULE_LICENSE("GPL");
@@ -115,6 +125,9 @@ TRACE_CNTR(ATM_RDOUTS, "Read Outstanding Command Cycles", 0xffffffff,
 
 static struct complete_trace_src_info tracer;
 
+/* kernel users of the counters: DDR beats and the profiler */
+static DEFINE_SPINLOCK(axitrace_lock);
+
 static inline struct per_trace_info *
 trace_attrs_to_per_trace_info(void *trace_attr)
 {
@@ -389,6 +402,7 @@ static ssize_t cap_store(struct kobject *kobj, struct kobj_attribute *attr,
 	item -= 1;
 	item = 1 << item;
 
+	trace_info->sysfs_owned = true;
 	set_cap_state(item, enable, trace_info);
 	return count;
 }
@@ -523,6 +537,7 @@ static ssize_t control_store(struct kobject *kobj, struct kobj_attribute *attr,
 	 * 1 to stop the trace
 	 * 2 to start the trace
 	 */
+	trace_info->sysfs_owned = true;
 	switch (item) {
 	case TRACE_CNTR_START:
 		trace_start(trace_info);
@@ -565,6 +580,360 @@ static ssize_t counter_show(struct kobject *kobj, struct kobj_attribute *attr,
 	return retval;
 }
 
+/*
+ * Start an idle source counting AXITRACE_KERNEL_CAP for a kernel user
+ * needing cap. Once a source has been set up through sysfs its counters
+ * may be cleared under the kernel users, so -EBUSY is returned for it
+ * from then on. The kernel never clears a running source, its users
+ * work on differences. Called under axitrace_lock.
+ */
+static int axitrace_claim(struct per_trace_info *info, u32 cap)
+{
+	if (info->sysfs_owned)
+		return -EBUSY;
+	if (!get_trace_state(info)) {
+		info->state.cap_state = AXITRACE_KERNEL_CAP;
+		send_local_cmd(info, TRACE_CNTR_CLEAR);
+		trace_start(info);
+		set_trace_state(1, info);
+	}
+	if ((info->state.cap_state & cap) != cap)
+		return -EBUSY;
+	return 0;
+}
+
+/* under axitrace_lock: beats counted so far, and up to the last
+ * axitrace_get_ddr_beats() */
+static u64 axitrace_ddr_total;
+static u64 axitrace_ddr_last;
+
+/*
+ * Adds the data beats to and from DDR since the last sample, summed over
+ * the sources marked ddr_port, to axitrace_ddr_total. Sources not running
+ * are started counting; if one has been set up through sysfs, -EBUSY is
+ * returned. Called under axitrace_lock.
+ */
+static int axitrace_ddr_sample(void)
+{
+	struct complete_trace_src_info *t = &tracer;
+	struct per_trace_info *info;
+	u32 rd, wr, sum = 0;
+	int i, found = 0;
+
+	for (i = 0 ; i < t->trace_src_count ; i++) {
+		info = &t->per_trace[i];
+		if (!info->p_source_info->ddr_port)
+			continue;
+
+		if (axitrace_claim(info, BEATS_COUNTING))
+			return -EBUSY;
+
+		/* the counters wrap, the differences do not care */
+		rd = readl(info->trace_regs + ATM_RDBEATS);
+		wr = readl(info->trace_regs + ATM_WRBEATS);
+		sum += (rd - info->ddr_rdbeats) + (wr - info->ddr_wrbeats);
+		info->ddr_rdbeats = rd;
+		info->ddr_wrbeats = wr;
+		found++;
+	}
+	if (!found)
+		return -ENODEV;
+
+	axitrace_ddr_total += sum;
+	return 0;
+}
+
+/* DDR data beats since the last call, for the MEMC governor */
+int axitrace_get_ddr_beats(u32 *beats)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	ret = axitrace_ddr_sample();
+	if (!ret) {
+		*beats = axitrace_ddr_total - axitrace_ddr_last;
+		axitrace_ddr_last = axitrace_ddr_total;
+	}
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(axitrace_get_ddr_beats);
+
+/* DDR data beats since the counting started, for users that take
+ * differences without disturbing axitrace_get_ddr_beats() */
+int axitrace_get_ddr_beats_total(u64 *beats)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	ret = axitrace_ddr_sample();
+	if (!ret)
+		*beats = axitrace_ddr_total;
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(axitrace_get_ddr_beats_total);
+
+#ifdef CONFIG_KONA_AXITRACE_PROF
+/*
+ * Always-on profiler. The sources with a prof_name are kept counting
+ * AXITRACE_KERNEL_CAP, and every prof_period_ms a deferrable timer adds
+ * what they counted to prof_total and records it as one sample of the
+ * ring. gator reads the totals directly, through axitrace_prof_read().
+ */
+static const u32 prof_offsets[AXITRACE_PROF_CNTRS] = {
+	[AXITRACE_PROF_RDBEATS]	= ATM_RDBEATS,
+	[AXITRACE_PROF_WRBEATS]	= ATM_WRBEATS,
+	[AXITRACE_PROF_RDCMDS]	= ATM_RDCMDS,
+	[AXITRACE_PROF_WRCMDS]	= ATM_WRCMDS,
+	[AXITRACE_PROF_RDLAT]	= ATM_RDSUM,
+	[AXITRACE_PROF_WRLAT]	= ATM_WRSUM,
+};
+
+static struct per_trace_info *prof_src[AXITRACE_PROF_SOURCES];
+static int prof_count;
+static u32 prof_period_ms = AXITRACE_PROF_PERIOD_MS;
+static struct timer_list prof_timer;
+static struct axitrace_prof_sample prof_ring[AXITRACE_PROF_SAMPLES];
+static unsigned int prof_head;	/* next slot */
+static unsigned int prof_samples;
+static u64 prof_last_ns;
+
+/* fold the counters into the totals, under axitrace_lock */
+static void prof_update(struct per_trace_info *info)
+{
+	u32 val;
+	int i;
+
+	if (axitrace_claim(info, AXITRACE_KERNEL_CAP))
+		return;
+
+	/* the counters wrap, the differences do not care */
+	for (i = 0 ; i < AXITRACE_PROF_CNTRS ; i++) {
+		val = readl(info->trace_regs + prof_offsets[i]);
+		info->prof_total[i] += val - info->prof_last[i];
+		info->prof_last[i] = val;
+	}
+}
+
+static void prof_timer_fn(unsigned long data)
+{
+	struct axitrace_prof_sample *s;
+	struct per_trace_info *info;
+	unsigned long flags;
+	u64 now, us;
+	int i, j;
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	now = local_clock();
+	s = &prof_ring[prof_head];
+	s->time_ns = now;
+	us = now - prof_last_ns;
+	do_div(us, NSEC_PER_USEC);
+	s->period_us = (u32)us;
+	prof_last_ns = now;
+
+	for (i = 0 ; i < prof_count ; i++) {
+		info = prof_src[i];
+		prof_update(info);
+		for (j = 0 ; j < AXITRACE_PROF_CNTRS ; j++) {
+			s->cnt[i][j] = (u32)(info->prof_total[j] -
+					     info->prof_mark[j]);
+			info->prof_mark[j] = info->prof_total[j];
+		}
+	}
+	prof_head = (prof_head + 1) % AXITRACE_PROF_SAMPLES;
+	if (prof_samples < AXITRACE_PROF_SAMPLES)
+		prof_samples++;
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+
+	if (prof_period_ms)
+		mod_timer(&prof_timer,
+			  jiffies + msecs_to_jiffies(prof_period_ms));
+}
+
+/* names of the profiled sources, in the order of axitrace_prof_read() */
+int axitrace_prof_sources(const char **names, int max)
+{
+	int i;
+
+	for (i = 0 ; i < prof_count && i < max ; i++)
+		names[i] = prof_src[i]->p_source_info->prof_name;
+	return i;
+}
+EXPORT_SYMBOL(axitrace_prof_sources);
+
+/* totals since profiling began, up to date; safe from any context */
+int axitrace_prof_read(u64 (*totals)[AXITRACE_PROF_CNTRS], int max)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	for (i = 0 ; i < prof_count && i < max ; i++) {
+		prof_update(prof_src[i]);
+		memcpy(totals[i], prof_src[i]->prof_total,
+		       sizeof(totals[i]));
+	}
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+	return i;
+}
+EXPORT_SYMBOL(axitrace_prof_read);
+
+/* MB/s and average latency of one source in a sample */
+static int prof_print_src(char *buf, size_t size, const char *name,
+			  const u32 *cnt, u32 us)
+{
+	u32 bw[2], lat[2];
+	u64 b;
+	int i;
+
+	for (i = 0 ; i < 2 ; i++) {
+		b = (u64)cnt[AXITRACE_PROF_RDBEATS + i] * AXITRACE_BEAT_BYTES *
+			USEC_PER_SEC;
+		if (us)
+			do_div(b, us);
+		bw[i] = (u32)(b >> 20);
+		lat[i] = cnt[AXITRACE_PROF_RDCMDS + i] ?
+			cnt[AXITRACE_PROF_RDLAT + i] /
+			cnt[AXITRACE_PROF_RDCMDS + i] : 0;
+	}
+
+	return scnprintf(buf, size, " %s %u/%u MB/s %u/%u cyc", name,
+			 bw[0], bw[1], lat[0], lat[1]);
+}
+
+static ssize_t prof_samples_read(struct file *file, char __user *ubuf,
+				 size_t len, loff_t *ppos)
+{
+	struct axitrace_prof_sample *snap, *s;
+	unsigned int count, head, i;
+	unsigned long flags;
+	size_t size = AXITRACE_PROF_SAMPLES * 256;
+	char *buf;
+	int n = 0, j;
+	ssize_t ret;
+
+	snap = kmalloc(sizeof(prof_ring), GFP_KERNEL);
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!snap || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	memcpy(snap, prof_ring, sizeof(prof_ring));
+	count = prof_samples;
+	head = prof_head;
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+
+	n += scnprintf(buf + n, size - n,
+		       "time_us period_us, per source rd/wr bw, rd/wr latency\n");
+	/* oldest first */
+	for (i = 0 ; i < count ; i++) {
+		s = &snap[(head + AXITRACE_PROF_SAMPLES - count + i) %
+			  AXITRACE_PROF_SAMPLES];
+		n += scnprintf(buf + n, size - n, "%llu %u:",
+			(unsigned long long)div_u64(s->time_ns, NSEC_PER_USEC),
+			s->period_us);
+		for (j = 0 ; j < prof_count ; j++)
+			n += prof_print_src(buf + n, size - n,
+					    prof_src[j]->p_source_info->prof_name,
+					    s->cnt[j], s->period_us);
+		n += scnprintf(buf + n, size - n, "\n");
+	}
+
+	ret = simple_read_from_buffer(ubuf, len, ppos, buf, n);
+out:
+	kfree(buf);
+	kfree(snap);
+	return ret;
+}
+
+static ssize_t prof_samples_write(struct file *file, const char __user *ubuf,
+				  size_t len, loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	prof_samples = 0;
+	prof_head = 0;
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+	return len;
+}
+
+static const struct file_operations prof_samples_fops = {
+	.read = prof_samples_read,
+	.write = prof_samples_write,
+};
+
+static int prof_period_get(void *data, u64 *val)
+{
+	*val = prof_period_ms;
+	return 0;
+}
+
+/* 0 stops sampling; the sources keep counting for the other users */
+static int prof_period_set(void *data, u64 val)
+{
+	prof_period_ms = (u32)val;
+	if (prof_period_ms)
+		mod_timer(&prof_timer,
+			  jiffies + msecs_to_jiffies(prof_period_ms));
+	else
+		del_timer_sync(&prof_timer);
+	return 0;
+}
+DEFINE_SIMPLE_ATTRIBUTE(prof_period_fops, prof_period_get,
+			prof_period_set, "%llu\n");
+
+static void axitrace_prof_init(struct complete_trace_src_info *t)
+{
+	struct dentry *dir;
+	unsigned long flags;
+	int i;
+
+	for (i = 0 ; i < t->trace_src_count ; i++) {
+		if (!t->per_trace[i].p_source_info->prof_name)
+			continue;
+		if (prof_count == AXITRACE_PROF_SOURCES) {
+			dev_warn(t->dev, "only %d sources profiled\n",
+				 AXITRACE_PROF_SOURCES);
+			break;
+		}
+		prof_src[prof_count++] = &t->per_trace[i];
+	}
+	if (!prof_count)
+		return;
+
+	spin_lock_irqsave(&axitrace_lock, flags);
+	/* start from the counters as they are now */
+	for (i = 0 ; i < prof_count ; i++) {
+		prof_update(prof_src[i]);
+		memset(prof_src[i]->prof_total, 0,
+		       sizeof(prof_src[i]->prof_total));
+		memset(prof_src[i]->prof_mark, 0,
+		       sizeof(prof_src[i]->prof_mark));
+	}
+	prof_last_ns = local_clock();
+	spin_unlock_irqrestore(&axitrace_lock, flags);
+
+	init_timer_deferrable(&prof_timer);
+	prof_timer.function = prof_timer_fn;
+	mod_timer(&prof_timer, jiffies + msecs_to_jiffies(prof_period_ms));
+
+	dir = debugfs_create_dir("axitrace", NULL);
+	if (!dir)
+		return;
+	debugfs_create_file("prof_period_ms", S_IRUSR | S_IWUSR, dir, NULL,
+			    &prof_period_fops);
+	debugfs_create_file("prof_samples", S_IRUSR | S_IWUSR, dir, NULL,
+			    &prof_samples_fops);
+}
+#endif
+
 static ssize_t cur_config_show(struct kobject *kobj,
 			struct kobj_attribute *attr, char *buf)
 {
@@ -1170,6 +1539,9 @@ static int axitrace_probe(struct amba_device *dev,
 	}
 	t->trace_src_count = i;
 
+#ifdef CONFIG_KONA_AXITRACE_PROF
+	axitrace_prof_init(t);
+#endif
 	return 0;
 out2:
 	for ( ; i >= 0 ; i--) {
@@ -26,6 +26,7 @@
 #include <linux/delay.h>
 #include <linux/clk.h>
 #include <linux/spinlock.h>
+#include <linux/sched.h>
 #include <linux/io.h>
 #include <linux/clkdev.h>
 #include <asm/clkdev.h>
@@ -37,6 +38,10 @@
 #include <linux/smp.h>
 #endif
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/kona_clk.h>
+EXPORT_TRACEPOINT_SYMBOL_GPL(ccu_clk_enable);
+
 /* global spinlock for clock API */
 static DEFINE_SPINLOCK(clk_gen_lock);
 static DEFINE_SPINLOCK(gen_access_lock);
@@ -44,6 +49,9 @@ static DEFINE_SPINLOCK(gen_access_lock);
 int clk_debug = 0;
 u32 gen_lock_flag;
 
+static bool clk_gate_defer = true;
+module_param_named(gate_defer, clk_gate_defer, bool, S_IRUGO | S_IWUSR);
+
 /* Added for panic handler to know AP CCU information */
 struct ccu_clk *ccu_clk_list[MAX_CCU_COUNT];
 /* num_ccu is used because mach can override the max_ccu_count */
@@ -511,6 +519,40 @@ static int dep_clk_unlock(struct ccu_clk *ccu_clk, struct clk *dep_clk,
 	return 0;
 }
 
+#ifdef CONFIG_KONA_CLK_LOCK_STAT
+static u64 gen_lock_ts;
+
+static inline void clk_lock_stamp(struct ccu_clk *ccu_clk)
+{
+	if (ccu_clk)
+		ccu_clk->lock_ts = sched_clock();
+	else
+		gen_lock_ts = sched_clock();
+}
+
+/* called before the unlock */
+static void clk_lock_held(struct ccu_clk *ccu_clk)
+{
+	u64 ns = sched_clock() - (ccu_clk ? ccu_clk->lock_ts : gen_lock_ts);
+
+	trace_clk_lock_held(ccu_clk ? ccu_clk->clk.name : "gen", ns);
+	if (!ccu_clk)
+		return;
+	ccu_clk->lock_count++;
+	ccu_clk->lock_total_ns += ns;
+	if (ns > ccu_clk->lock_max_ns)
+		ccu_clk->lock_max_ns = ns;
+}
+#else
+static inline void clk_lock_stamp(struct ccu_clk *ccu_clk)
+{
+}
+
+static inline void clk_lock_held(struct ccu_clk *ccu_clk)
+{
+}
+#endif
+
 static int clk_lock(struct clk *clk, unsigned long *flags)
 {
 	struct ccu_clk *ccu_clk = get_ccu_clk(clk);
@@ -533,6 +575,7 @@ static int clk_lock(struct clk *clk, unsigned long *flags)
 		ccu_access_lock(ccu_clk, &access_flags);
 		ccu_clk->lock_flag |= cpu_id;
 		ccu_access_unlock(ccu_clk, &access_flags);
+		clk_lock_stamp(ccu_clk);
 	} else {
 		if (gen_lock_flag & cpu_id) {
 			printk(KERN_ALERT "same core getting lock again");
@@ -546,6 +589,7 @@ static int clk_lock(struct clk *clk, unsigned long *flags)
 		spin_lock_irqsave(&gen_access_lock, access_flags);
 		gen_lock_flag |= cpu_id;
 		spin_unlock_irqrestore(&gen_access_lock, access_flags);
+		clk_lock_stamp(NULL);
 	}
 	put_cpu();
 	return 0;
@@ -562,6 +606,7 @@ static int clk_unlock(struct clk *clk, unsigned long *flags)
 	cpu_id = 1 << get_cpu();
 	if (ccu_clk) {
 		if (ccu_clk->lock_flag & cpu_id) {
+			clk_lock_held(ccu_clk);
 			ccu_access_lock(ccu_clk, &access_flags);
 			ccu_clk->lock_flag &= ~cpu_id;
 			ccu_access_unlock(ccu_clk, &access_flags);
@@ -576,6 +621,7 @@ static int clk_unlock(struct clk *clk, unsigned long *flags)
 		}
 	} else {
 		if (gen_lock_flag & cpu_id) {
+			clk_lock_held(NULL);
 			spin_lock_irqsave(&gen_access_lock, access_flags);
 			gen_lock_flag &= ~cpu_id;
 			spin_unlock_irqrestore(&gen_access_lock, access_flags);
@@ -693,6 +739,7 @@ static int __ccu_clk_enable(struct clk *clk)
 		if (clk->ops && clk->ops->enable) {
 			ret = clk->ops->enable(clk, 1);
 		}
+		trace_ccu_clk_enable(clk->name, 1);
 	}
 	return ret;
 }
@@ -942,6 +989,47 @@ int __clk_enable(struct clk *clk)
 	return ret;
 }
 
+/*
+ * The clk_enable() holders of a clock share one use_cnt reference, which
+ * is only taken and dropped under the lock when fast_cnt goes from 0 to 1
+ * and back. The other enables and disables just count, without the lock
+ * or the register writes.
+ */
+static int clk_enable_locked(struct clk *clk)
+{
+	int ret = 0;
+
+	if (!atomic_inc_not_zero(&clk->fast_cnt)) {
+		ret = __clk_enable(clk);
+		if (!ret)
+			atomic_set(&clk->fast_cnt, 1);
+	}
+	return ret;
+}
+
+static void clk_disable_locked(struct clk *clk)
+{
+	/* clocks on from the boot or failed enables have no fast_cnt */
+	if (!atomic_read(&clk->fast_cnt) ||
+	    atomic_dec_and_test(&clk->fast_cnt))
+		__clk_disable(clk);
+}
+
+/* drops a reference if it is not the last one */
+static bool clk_disable_fast(struct clk *clk)
+{
+	int cnt = atomic_read(&clk->fast_cnt);
+	int old;
+
+	while (cnt > 1) {
+		old = atomic_cmpxchg(&clk->fast_cnt, cnt, cnt - 1);
+		if (old == cnt)
+			return true;
+		cnt = old;
+	}
+	return false;
+}
+
 int clk_enable(struct clk *clk)
 {
 	int ret;
@@ -950,8 +1038,10 @@ int clk_enable(struct clk *clk)
 	if (IS_ERR_OR_NULL(clk))
 		return -EINVAL;
 	 clk_dbg("%s - %s\n", __func__, clk->name);
+	if (atomic_inc_not_zero(&clk->fast_cnt))
+		return 0;
 	clk_lock(clk, &flags);
-	ret = __clk_enable(clk);
+	ret = clk_enable_locked(clk);
 	clk_unlock(clk, &flags);
 
 	return ret;
@@ -978,6 +1068,7 @@ static int __ccu_clk_disable(struct clk *clk)
 			ret = clk->ops->enable(clk, 0);
 #endif
 		}
+		trace_ccu_clk_enable(clk->name, 0);
 	}
 	/*disable PI */
 #ifdef CONFIG_KONA_PI_MGR
@@ -1273,13 +1364,96 @@ void clk_disable(struct clk *clk)
 	if (IS_ERR_OR_NULL(clk))
 		return;
 	 clk_dbg("%s - %s\n", __func__, clk->name);
+	if (clk_disable_fast(clk))
+		return;
 	clk_lock(clk, &flags);
-	__clk_disable(clk);
+	clk_disable_locked(clk);
 	clk_unlock(clk, &flags);
 }
 
 EXPORT_SYMBOL(clk_disable);
 
+/* the lock and write access of the CCU of clk, kept over a group */
+static void clk_group_lock(struct clk *clk, unsigned long *flags)
+{
+	struct ccu_clk *ccu_clk = get_ccu_clk(clk);
+
+	clk_lock(clk, flags);
+	if (ccu_clk) {
+		CCU_ACCESS_EN(ccu_clk, 1);
+		ccu_write_access_enable(ccu_clk, true);
+	}
+}
+
+static void clk_group_unlock(struct clk *clk, unsigned long *flags)
+{
+	struct ccu_clk *ccu_clk = get_ccu_clk(clk);
+
+	if (ccu_clk) {
+		ccu_write_access_enable(ccu_clk, false);
+		CCU_ACCESS_EN(ccu_clk, 0);
+	}
+	clk_unlock(clk, flags);
+}
+
+int clk_enable_group(struct clk **clks, int num)
+{
+	struct clk *held = NULL;
+	unsigned long flags;
+	int inx, ret = 0;
+
+	for (inx = 0; inx < num; inx++) {
+		struct clk *clk = clks[inx];
+
+		if (IS_ERR_OR_NULL(clk) || atomic_inc_not_zero(&clk->fast_cnt))
+			continue;
+		if (held && get_ccu_clk(held) != get_ccu_clk(clk)) {
+			clk_group_unlock(held, &flags);
+			held = NULL;
+		}
+		if (!held) {
+			held = clk;
+			clk_group_lock(held, &flags);
+		}
+		ret = clk_enable_locked(clk);
+		if (ret)
+			break;
+	}
+	if (held)
+		clk_group_unlock(held, &flags);
+
+	if (ret)
+		clk_disable_group(clks, inx);
+	return ret;
+}
+EXPORT_SYMBOL(clk_enable_group);
+
+void clk_disable_group(struct clk **clks, int num)
+{
+	struct clk *held = NULL;
+	unsigned long flags;
+	int inx;
+
+	for (inx = 0; inx < num; inx++) {
+		struct clk *clk = clks[inx];
+
+		if (IS_ERR_OR_NULL(clk) || clk_disable_fast(clk))
+			continue;
+		if (held && get_ccu_clk(held) != get_ccu_clk(clk)) {
+			clk_group_unlock(held, &flags);
+			held = NULL;
+		}
+		if (!held) {
+			held = clk;
+			clk_group_lock(held, &flags);
+		}
+		clk_disable_locked(clk);
+	}
+	if (held)
+		clk_group_unlock(held, &flags);
+}
+EXPORT_SYMBOL(clk_disable_group);
+
 static unsigned long __ccu_clk_get_rate(struct clk *clk)
 {
 	unsigned long rate = 0;
@@ -3152,13 +3326,22 @@ static int peri_clk_set_gating_ctrl(struct peri_clk *peri_clk, int gating_ctrl)
 int peri_clk_set_hw_gating_ctrl(struct clk *clk, int gating_ctrl)
 {
 	int ret = 0;
+	unsigned long flags;
 	struct peri_clk *peri_clk;
 	if (clk->clk_type != CLK_TYPE_PERI) {
 		BUG_ON(1);
 		return -EPERM;
 	}
 	peri_clk = to_peri_clk(clk);
+
+	/* callable from drivers, so taking the lock and CCU access here */
+	clk_lock(clk, &flags);
+	CCU_ACCESS_EN(peri_clk->ccu_clk, 1);
+	ccu_write_access_enable(peri_clk->ccu_clk, true);
 	ret = peri_clk_set_gating_ctrl(peri_clk, gating_ctrl);
+	ccu_write_access_enable(peri_clk->ccu_clk, false);
+	CCU_ACCESS_EN(peri_clk->ccu_clk, 0);
+	clk_unlock(clk, &flags);
 
 	return (ret);
 }
@@ -3294,6 +3477,65 @@ static int peri_clk_set_voltage_lvl(struct peri_clk *peri_clk, int voltage_lvl)
 	return 0;
 }
 
+/*
+ * A peri clock gated off is left to stop on its own, the wait for its
+ * stop status is deferred until the next enable in the CCU, the pending
+ * list filling up, or idle entry. Clocks gated off together then stop in
+ * parallel instead of one after the other. Called under clk_lock.
+ */
+static void ccu_gate_flush(struct ccu_clk *ccu_clk)
+{
+	struct peri_clk *peri_clk;
+	int insurance = 0;
+	u32 reg_val;
+
+	while (ccu_clk->gate_pend_cnt) {
+		peri_clk = ccu_clk->gate_pend[ccu_clk->gate_pend_cnt - 1];
+		reg_val = readl(CCU_REG_ADDR(ccu_clk,
+					     peri_clk->clk_gate_offset));
+		if (GET_BIT_USING_MASK(reg_val, peri_clk->stprsts_mask) &&
+		    insurance < CLK_EN_INS_COUNT) {
+			udelay(1);
+			insurance++;
+			continue;
+		}
+		ccu_clk->gate_pend_cnt--;
+	}
+	if (insurance >= CLK_EN_INS_COUNT)
+		__WARN();
+}
+
+static bool ccu_gate_defer(struct peri_clk *peri_clk)
+{
+	struct ccu_clk *ccu_clk = peri_clk->ccu_clk;
+
+	/* the registers may not be reachable once the access is dropped */
+	if (!clk_gate_defer || !peri_clk->stprsts_mask ||
+	    CLK_FLG_ENABLED(&ccu_clk->clk, CCU_ACCESS_ENABLE))
+		return false;
+	if (ccu_clk->gate_pend_cnt == CCU_GATE_PEND_MAX)
+		ccu_gate_flush(ccu_clk);
+	ccu_clk->gate_pend[ccu_clk->gate_pend_cnt++] = peri_clk;
+	return true;
+}
+
+void clk_gate_flush_all(void)
+{
+	struct ccu_clk *ccu_clk;
+	unsigned long flags;
+	int i;
+
+	for (i = 0; i < num_ccu; i++) {
+		ccu_clk = ccu_clk_list[i];
+		if (!ACCESS_ONCE(ccu_clk->gate_pend_cnt))
+			continue;
+		clk_lock(&ccu_clk->clk, &flags);
+		ccu_gate_flush(ccu_clk);
+		clk_unlock(&ccu_clk->clk, &flags);
+	}
+}
+EXPORT_SYMBOL(clk_gate_flush_all);
+
 static int peri_clk_enable(struct clk *clk, int enable)
 {
 	u32 reg_val;
@@ -3313,6 +3555,10 @@ static int peri_clk_enable(struct clk *clk, int enable)
 		goto err;
 	}
 
+	/* nothing gets enabled in the CCU while a stop is in progress */
+	if (enable)
+		ccu_gate_flush(peri_clk->ccu_clk);
+
 	/*enable write access */
 	ccu_write_access_enable(peri_clk->ccu_clk, true);
 
@@ -3328,6 +3574,11 @@ static int peri_clk_enable(struct clk *clk, int enable)
 	writel(reg_val,
 	       CCU_REG_ADDR(peri_clk->ccu_clk, peri_clk->clk_gate_offset));
 
+	if (!enable && ccu_gate_defer(peri_clk)) {
+		ccu_write_access_enable(peri_clk->ccu_clk, false);
+		goto err;
+	}
+
 	clk_dbg("%s:%s clk before stprsts start\n", __func__, clk->name);
 	insurance = 0;
 	if (enable) {
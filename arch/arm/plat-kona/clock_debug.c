@@ -9,6 +9,7 @@
 #include <linux/debugfs.h>
 #include <asm/uaccess.h>
 #include <asm/io.h>
+#include <asm/div64.h>
 #include <linux/seq_file.h>
 #include <plat/clock.h>
 #include <plat/pi_mgr.h>
@@ -573,6 +574,55 @@ static const struct file_operations ccu_clock_list_fops = {
 	.release = single_release,
 };
 
+#ifdef CONFIG_KONA_CLK_LOCK_STAT
+static int ccu_lock_stat_show(struct seq_file *seq, void *p)
+{
+	struct ccu_clk *ccu_clk = to_ccu_clk((struct clk *)seq->private);
+	unsigned long flags;
+	u64 total;
+	u32 count, max;
+
+	spin_lock_irqsave(&ccu_clk->clk_lock, flags);
+	total = ccu_clk->lock_total_ns;
+	count = ccu_clk->lock_count;
+	max = ccu_clk->lock_max_ns;
+	spin_unlock_irqrestore(&ccu_clk->clk_lock, flags);
+
+	do_div(total, NSEC_PER_USEC);
+	seq_printf(seq, "count %u total_us %llu max_ns %u\n", count, total,
+		   max);
+	return 0;
+}
+
+static int fops_ccu_lock_stat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ccu_lock_stat_show, inode->i_private);
+}
+
+static ssize_t ccu_lock_stat_clear(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct seq_file *seq = file->private_data;
+	struct ccu_clk *ccu_clk = to_ccu_clk((struct clk *)seq->private);
+	unsigned long flags;
+
+	spin_lock_irqsave(&ccu_clk->clk_lock, flags);
+	ccu_clk->lock_total_ns = 0;
+	ccu_clk->lock_count = 0;
+	ccu_clk->lock_max_ns = 0;
+	spin_unlock_irqrestore(&ccu_clk->clk_lock, flags);
+	return count;
+}
+
+static const struct file_operations ccu_lock_stat_fops = {
+	.open = fops_ccu_lock_stat_open,
+	.read = seq_read,
+	.write = ccu_lock_stat_clear,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int clk_parent_show(struct seq_file *seq, void *p)
 {
 	struct clk *clock = seq->private;
@@ -931,6 +981,12 @@ int __init clock_debug_add_ccu(struct clk *c, bool is_root_ccu)
 				 ccu_clk->dent_ccu_dir, c,
 				 &clk_mon_fops))
 		goto err;
+#ifdef CONFIG_KONA_CLK_LOCK_STAT
+	if (!debugfs_create_file("lock_stat", S_IWUSR|S_IRUGO,
+				 ccu_clk->dent_ccu_dir, c,
+				 &ccu_lock_stat_fops))
+		goto err;
+#endif
 
 	if (ccu_clk->freq_count) {
 		if (!debugfs_create_file("freq_id", S_IRUGO,
@@ -1129,18 +1129,18 @@ exit_err:
 
 /*
  *
- * Function Name:  CSL_DSI_SendPacket
+ * Function Name:  cslDsiSendPacket
  *
- * Description:    Send DSI Packet (non-pixel data) with an option to end it
- *                 with BTA.
- *                 If BTA is requested, command.reply MUST be valid
+ * Description:    Send DSI Packet with semaDsi held by the caller, or with
+ *                 the client lock. With poll the end of the packet is
+ *                 polled for on the status instead of waiting for the
+ *                 interrupt.
  *
  */
-CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE client,
-		pCSL_DSI_CMND command, Boolean isTE)
+static CSL_LCD_RES_T cslDsiSendPacket(DSI_CLIENT clientH,
+		pCSL_DSI_CMND command, Boolean isTE, Boolean poll)
 {
 	DSI_HANDLE dsiH;
-	DSI_CLIENT clientH;
 	CSL_LCD_RES_T res = CSL_LCD_OK;
 	CHAL_DSI_TX_CFG_t txPkt;
 	CHAL_DSI_RES_t chalRes;
@@ -1149,7 +1149,6 @@ CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE client,
 	UInt32 pfifo_len = 0;
 	int pkt_to_be_enabled;
 
-	clientH = (DSI_CLIENT) client;
 	dsiH = (DSI_HANDLE)clientH->lcdH;
 
 	if (command->msgLen > CHAL_DSI_TX_MSG_MAX) {
@@ -1165,17 +1164,6 @@ CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE client,
 		return CSL_LCD_API_ERR;
 	}
 
-	if (!clientH->hasLock) {
-		OSStatus_t osRes = OSSEMAPHORE_Obtain(dsiH->semaDsi,
-				TICKS_IN_MILLISECONDS(1000));
-		if (osRes != OSSTATUS_SUCCESS) {
-			LCD_DBG(LCD_DBG_ERR_ID,
-				"[CSL DSI][%d] %s: ERR, semaDsi timeout\n",
-				dsiH->bus, __func__);
-			return CSL_LCD_API_ERR;
-		}
-	}
-
 	if (dsiH->init != DSI_INITIALIZED) {
 		pr_err("%s:%d\n");
 		__WARN();
@@ -1186,8 +1174,6 @@ CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE client,
 		LCD_DBG(LCD_DBG_ERR_ID,
 			"[CSL DSI][%d] %s: ERR, VC[%d] Link Is In ULPS\n",
 					dsiH->bus, __func__, command->vc);
-		if (!clientH->hasLock)
-			OSSEMAPHORE_Release(dsiH->semaDsi);
 		return CSL_LCD_BAD_STATE;
 	}
 
@@ -1212,7 +1198,7 @@ CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE client,
 
 	chal_dsi_clr_status(dsiH->chalH, 0xFFFFFFFF);
 
-	if (!clientH->hasLock) {
+	if (!poll) {
 		u32 dsi_stat, dsi_i_stat;
 		if (txPkt.endWithBta) {
 			event = CHAL_DSI_ISTAT_PHY_RX_TRIG
@@ -1413,7 +1399,7 @@ start_tx:
 	}
 
 
-	if (!clientH->hasLock) {
+	if (!poll) {
 		res = cslDsiWaitForInt(dsiH, 100);
 		stat = chal_dsi_get_status(dsiH->chalH);
 	} else {
@@ -1432,7 +1418,7 @@ start_tx:
 			/* cslDsiBtaRecover(dsiH); */
 			while ((res == CSL_LCD_OS_TOUT) && --tries) {
 				pr_err("Trying once more with bta\n");
-				if (!clientH->hasLock)
+				if (!poll)
 					cslDsiEnaIntEvent(dsiH, event);
 				chal_dsi_tx_start(dsiH->chalH, TX_PKT_ENG_1,
 						FALSE);
@@ -1440,7 +1426,7 @@ start_tx:
 					chal_dsi_tx_start(dsiH->chalH,
 						TX_PKT_ENG_1, TRUE);
 				pkt_to_be_enabled = !txPkt.start;
-				if (!clientH->hasLock) {
+				if (!poll) {
 					cslDsiEnaIntEvent(dsiH, event);
 					res = cslDsiWaitForInt(dsiH, 100);
 					stat = chal_dsi_get_status(dsiH->chalH);
@@ -1479,7 +1465,7 @@ read_reply:
 			while ((res == CSL_LCD_OS_TOUT) && --tries) {
 				LCD_DBG(LCD_DBG_ERR_ID,
 					"Trying once more w/o BTA\n");
-				if (!clientH->hasLock)
+				if (!poll)
 					cslDsiEnaIntEvent(dsiH, event);
 				chal_dsi_tx_start(dsiH->chalH, TX_PKT_ENG_1,
 						FALSE);
@@ -1489,7 +1475,7 @@ read_reply:
 					chal_dsi_tx_start(dsiH->chalH,
 						TX_PKT_ENG_1, TRUE);
 				pkt_to_be_enabled = !txPkt.start;
-				if (!clientH->hasLock) {
+				if (!poll) {
 					cslDsiEnaIntEvent(dsiH, event);
 					res = cslDsiWaitForInt(dsiH, 100);
 					stat = chal_dsi_get_status(dsiH->chalH);
@@ -1521,6 +1507,75 @@ exit_ok:
 	if (pfifo_len > DE1_DEF_THRESHOLD_B)
 		chal_dsi_de1_set_dma_thresh(dsiH->chalH, DE1_DEF_THRESHOLD_W);
 
+	return res;
+}
+
+static CSL_LCD_RES_T cslDsiObtain(DSI_HANDLE dsiH)
+{
+	OSStatus_t osRes = OSSEMAPHORE_Obtain(dsiH->semaDsi,
+			TICKS_IN_MILLISECONDS(1000));
+
+	if (osRes != OSSTATUS_SUCCESS) {
+		LCD_DBG(LCD_DBG_ERR_ID,
+			"[CSL DSI][%d] %s: ERR, semaDsi timeout\n",
+			dsiH->bus, __func__);
+		return CSL_LCD_API_ERR;
+	}
+	return CSL_LCD_OK;
+}
+
+/*
+ *
+ * Function Name:  CSL_DSI_SendPacket
+ *
+ * Description:    Send DSI Packet (non-pixel data) with an option to end it
+ *                 with BTA.
+ *                 If BTA is requested, command.reply MUST be valid
+ *
+ */
+CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE client,
+		pCSL_DSI_CMND command, Boolean isTE)
+{
+	DSI_CLIENT clientH = (DSI_CLIENT) client;
+	DSI_HANDLE dsiH = (DSI_HANDLE)clientH->lcdH;
+	CSL_LCD_RES_T res;
+
+	if (clientH->hasLock)
+		return cslDsiSendPacket(clientH, command, isTE, TRUE);
+
+	res = cslDsiObtain(dsiH);
+	if (res != CSL_LCD_OK)
+		return res;
+	res = cslDsiSendPacket(clientH, command, isTE, FALSE);
+	OSSEMAPHORE_Release(dsiH->semaDsi);
+	return res;
+}
+
+/*
+ *
+ * Function Name:  CSL_DSI_SendPacketList
+ *
+ * Description:    Send count DSI Packets back to back, stopping at the
+ *                 first error. The interface is taken once for the list
+ *                 and the end of each packet is polled for, short command
+ *                 packets take less than the interrupt and the wakeup.
+ *
+ */
+CSL_LCD_RES_T CSL_DSI_SendPacketList(CSL_LCD_HANDLE client,
+		pCSL_DSI_CMND command, UInt32 count)
+{
+	DSI_CLIENT clientH = (DSI_CLIENT) client;
+	DSI_HANDLE dsiH = (DSI_HANDLE)clientH->lcdH;
+	CSL_LCD_RES_T res = CSL_LCD_OK;
+	UInt32 i;
+
+	if (!clientH->hasLock) {
+		res = cslDsiObtain(dsiH);
+		if (res != CSL_LCD_OK)
+			return res;
+	}
+	for (i = 0; i < count && res == CSL_LCD_OK; i++)
+		res = cslDsiSendPacket(clientH, &command[i], FALSE, TRUE);
 	if (!clientH->hasLock)
 		OSSEMAPHORE_Release(dsiH->semaDsi);
 	return res;
@@ -23,6 +23,9 @@
 #include <linux/broadcom/mobcom_types.h>
 #include <linux/broadcom/msconsts.h>
 #include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/completion.h>
 #include <plat/osabstract/ostypes.h>
 #include <plat/osabstract/ostask.h>
 #include <plat/osabstract/ossemaphore.h>
@@ -36,12 +39,31 @@
 #include <linux/platform_device.h>
 #include <plat/csl/csl_dma_vc4lite.h>
 
-static struct mutex lock;
+/*
+ * Only channel 0 of the engine completes through the hisr, so every
+ * user (the ioctl, kona_fb, ion and the dmaengine provider) runs its
+ * transfer under xfer_lock and sleeps on done until the callback.
+ */
+static DEFINE_MUTEX(xfer_lock);
+static DECLARE_COMPLETION(done);
+static DMA_VC4LITE_CALLBACK_STATUS done_status;
+
+/* copies at least this long are worth handing to the engine */
+unsigned int mmdma_offload_min = 64 * 1024;
+module_param(mmdma_offload_min, uint, S_IRUGO | S_IWUSR);
+EXPORT_SYMBOL(mmdma_offload_min);
 
 void mmdma_callback (DMA_VC4LITE_CALLBACK_STATUS status)
 {
 	pr_debug("MMDma Completed[%d] \n", status);
-	mutex_unlock(&lock);
+	done_status = status;
+	complete(&done);
+}
+
+static int mmdma_wait(void)
+{
+	wait_for_completion(&done);
+	return done_status == DMA_VC4LITE_CALLBACK_SUCCESS ? 0 : -EIO;
 }
 
 int mmdma_execute(unsigned int srcAddr, unsigned int dstAddr, unsigned int size)
@@ -52,10 +74,12 @@ int mmdma_execute(unsigned int srcAddr, unsigned int dstAddr, unsigned int size)
 	Int32 dmaCh;
 	int ret = 0;
 
+	mutex_lock(&xfer_lock);
 	/* Reserve Channel */
 	dmaCh = csl_dma_vc4lite_obtain_channel(DMA_VC4LITE_CLIENT_MEMORY, DMA_VC4LITE_CLIENT_MEMORY);
 	if (dmaCh == -1) {
 		pr_err("%s: ERR Reserving DMA Ch \n", __func__);
+		mutex_unlock(&xfer_lock);
 		return -ENODEV;
 	}
 	pr_debug("%s: Got DmaCh[%ld] \n",__func__, dmaCh);
@@ -104,15 +128,126 @@ int mmdma_execute(unsigned int srcAddr, unsigned int dstAddr, unsigned int size)
 	}
 	mb();
 
-	mutex_lock(&lock);
+	ret = mmdma_wait();
+	mutex_unlock(&xfer_lock);
 	return ret;
 
 release_channel:
 	csl_dma_vc4lite_release_channel(dmaCh);
+	mutex_unlock(&xfer_lock);
 	return ret;
 }
 EXPORT_SYMBOL(mmdma_execute);
 
+int mmdma_execute_2d(unsigned int srcAddr, unsigned int dstAddr,
+		unsigned int width, unsigned int height,
+		unsigned int srcStride, unsigned int dstStride)
+{
+	DMA_VC4LITE_CHANNEL_INFO_t dmaChInfo;
+	DMA_VC4LITE_XFER_2DDATA_t dmaData;
+	Int32 dmaCh;
+	int ret = 0;
+
+	if (!width || !height || (width > 0xffff) || (height > 0x10000) ||
+		(srcStride > 0xffff) || (dstStride > 0xffff))
+		return -EINVAL;
+
+	mutex_lock(&xfer_lock);
+	/* Reserve Channel */
+	dmaCh = csl_dma_vc4lite_obtain_channel(DMA_VC4LITE_CLIENT_MEMORY, DMA_VC4LITE_CLIENT_MEMORY);
+	if (dmaCh == -1) {
+		pr_err("%s: ERR Reserving DMA Ch \n", __func__);
+		mutex_unlock(&xfer_lock);
+		return -ENODEV;
+	}
+	pr_debug("%s: Got DmaCh[%ld] \n",__func__, dmaCh);
+
+	/* Configure Channel */
+	dmaChInfo.autoFreeChan = 1;
+	dmaChInfo.srcID = DMA_VC4LITE_CLIENT_MEMORY;
+	dmaChInfo.dstID = DMA_VC4LITE_CLIENT_MEMORY;
+	dmaChInfo.burstLen = DMA_VC4LITE_BURST_LENGTH_8;
+	dmaChInfo.xferMode = DMA_VC4LITE_XFER_MODE_2D;
+	dmaChInfo.dstStride = dstStride;
+	dmaChInfo.srcStride = srcStride;
+	dmaChInfo.waitResponse = 0;
+	dmaChInfo.callback = mmdma_callback;
+
+	if (csl_dma_vc4lite_config_channel(dmaCh, &dmaChInfo)
+	    != DMA_VC4LITE_STATUS_SUCCESS) {
+		pr_err("%s: ERR Configure DMA Ch \n", __func__);
+		ret = -EINVAL;
+		goto release_channel;
+	}
+
+	/* Add the DMA transfer data */
+#ifdef CONFIG_ARCH_HAWAII
+	dmaData.burstWriteEnable32 = 1;
+#else
+	dmaData.burstWriteEnable32 = 0;
+#endif
+	dmaData.srcAddr = srcAddr;
+	dmaData.dstAddr = dstAddr;
+	dmaData.xXferLength = width;
+	dmaData.yXferLength = height - 1;
+
+	if (csl_dma_vc4lite_add_data_ex(dmaCh, &dmaData)
+	    != DMA_VC4LITE_STATUS_SUCCESS) {
+		pr_err("%s: ERR add DMA transfer data \n", __func__);
+		ret = -EINVAL;
+		goto release_channel;
+	}
+
+	/* start DMA transfer */
+	if (csl_dma_vc4lite_start_transfer(dmaCh)
+	    != DMA_VC4LITE_STATUS_SUCCESS) {
+		pr_err("%s: ERR start DMA data transfer \n", __func__);
+		ret = -EINVAL;
+		goto release_channel;
+	}
+	mb();
+
+	ret = mmdma_wait();
+	mutex_unlock(&xfer_lock);
+	return ret;
+
+release_channel:
+	csl_dma_vc4lite_release_channel(dmaCh);
+	mutex_unlock(&xfer_lock);
+	return ret;
+}
+EXPORT_SYMBOL(mmdma_execute_2d);
+
+/*
+ * The engine has no fill mode: zero size bytes at dstAddr by copying the
+ * zero page over and over, as a 2D transfer whose source stride (signed
+ * 16 bits) steps back to the start of the page after every line.
+ */
+int mmdma_execute_zero(unsigned int dstAddr, unsigned int size)
+{
+	unsigned int zero = page_to_phys(ZERO_PAGE(0));
+	unsigned int lines, tail;
+	int ret = 0;
+
+	if ((dstAddr | size) & 3)
+		return -EINVAL;
+
+	for (lines = size / PAGE_SIZE; lines && !ret; ) {
+		/* YLENGTH is 14 bits wide */
+		unsigned int n = min(lines, 0x4000U);
+
+		ret = mmdma_execute_2d(zero, dstAddr, PAGE_SIZE, n,
+				0x10000 - PAGE_SIZE, 0);
+		dstAddr += n * PAGE_SIZE;
+		lines -= n;
+	}
+	tail = size % PAGE_SIZE;
+	if (!ret && tail)
+		ret = mmdma_execute(zero, dstAddr, tail);
+	return ret;
+}
+EXPORT_SYMBOL(mmdma_execute_zero);
+
 static __init int init_mmdma(void)
 {
 	pr_debug("init \n");
@@ -121,8 +256,6 @@ static __init int init_mmdma(void)
 		pr_err("csl_dma_vc4lite_init Failed \n");
 		return (-1);
 	}
-	mutex_init(&lock);
-	mutex_lock(&lock);
 	return 0;
 }
 
@@ -42,6 +42,14 @@
 #include <plat/pi_mgr.h>
 #endif
 
+/**
+ * struct pl330_period - One xfer item of a cyclic transfer, as a req.
+ */
+struct pl330_period {
+	struct pl330_req req;
+	struct pl330_xfer x;
+};
+
 /**
  * struct pl330_chan_desc - Peripheral channel descriptor.
  */
@@ -58,6 +66,11 @@ struct pl330_chan_desc {
 	void *client_cookie;	/* client data for callback fn */
 	bool in_use;		/* is DMA channel busy */
 	bool is_setup;		/* Is 'pl330_req' having valid transfer setup */
+	bool prepared;		/* keep 'pl330_req' across dma_stop_transfer */
+	bool cyclic;		/* resubmit 'pl330_req' each time it completes */
+	struct pl330_period *period;	/* cyclic over several xfer items */
+	unsigned int periods;	/* number of items in 'period' */
+	unsigned int next_period;	/* next one to resubmit */
 	struct pl330_req req;	/* A DMA request item */
 #ifdef CONFIG_KONA_PI_MGR
 	struct pi_mgr_dfs_node dfs_node;	/* dfs node for DMA */
@@ -108,6 +121,7 @@ static void _cleanup_req(struct pl330_req *rq)
 		return;
 
 	rq->rqtype = DEVTODEV;	/* Invalid type */
+	rq->mc_reuse = false;
 
 	if (rq->cfg) {
 		kfree(rq->cfg);
@@ -129,6 +143,56 @@ static void _cleanup_req(struct pl330_req *rq)
 	return;
 }
 
+static void _cleanup_cdesc_req(struct pl330_chan_desc *c)
+{
+	kfree(c->period);
+	c->period = NULL;
+	c->periods = 0;
+	_cleanup_req(&c->req);
+}
+
+/*
+ * Take the prepared/cyclic bits of a new setup. A cyclic list of
+ * several xfer items is split in one req per item, so that the client
+ * is called back after each of them. Called with the global lock held,
+ * drops the request on failure.
+ */
+static int _setup_mode(struct pl330_chan_desc *c, int cfg)
+{
+	struct pl330_xfer *x;
+	unsigned int n = 0, i;
+
+	c->prepared = (cfg & DMA_CFG_PREPARED) ? true : false;
+	c->cyclic = (cfg & DMA_CFG_CYCLIC) ? true : false;
+	c->req.mc_reuse = false;
+
+	if (!c->cyclic)
+		return 0;
+
+	for (x = c->req.x; x; x = x->next)
+		n++;
+	if (n < 2)
+		return 0;
+
+	c->period = kcalloc(n, sizeof(*c->period), GFP_ATOMIC);
+	if (!c->period) {
+		c->is_setup = false;
+		_cleanup_req(&c->req);
+		return -ENOMEM;
+	}
+
+	for (i = 0, x = c->req.x; x; x = x->next, i++) {
+		/* same cfg, callback and token as the whole request */
+		c->period[i].req = c->req;
+		c->period[i].x = *x;
+		c->period[i].x.next = NULL;
+		c->period[i].req.x = &c->period[i].x;
+	}
+	c->periods = n;
+
+	return 0;
+}
+
 static void _free_cdesc(struct pl330_chan_desc *cdesc)
 {
 	/* Deallocate all mapped peripherals */
@@ -153,6 +217,32 @@ static void pl330_req_callback(void *token, enum pl330_op_err err)
 	enum pl330_xfer_status stat;
 	struct pl330_chan_desc *c =
 	    container_of(r, struct pl330_chan_desc, req);
+	struct pl330_req *nr;
+	unsigned long flags;
+
+	/*
+	 * Cyclic: the other microcode slot is already running the next
+	 * period, queue the one after it.
+	 */
+	if (c && c->cyclic && err == PL330_ERR_NONE) {
+		spin_lock_irqsave(&lock, flags);
+		if (c->in_use) {
+			nr = &c->req;
+			if (c->periods) {
+				nr = &c->period[c->next_period].req;
+				c->next_period = (c->next_period + 1) %
+				    c->periods;
+			}
+			dmux_sema_protect();
+			if (pl330_submit_req(c->pl330_chan_id, nr) == 0) {
+				nr->mc_reuse = true;
+				pl330_chan_ctrl(c->pl330_chan_id,
+						PL330_OP_START);
+			}
+			dmux_sema_unprotect();
+		}
+		spin_unlock_irqrestore(&lock, flags);
+	}
 
 	//printk("--> pl330 drv callback\n");
 	if (c && c->xfer_callback) {
@@ -339,7 +429,7 @@ int dma_free_chan(unsigned int chan)
 		pr_debug("PL330: Failed to remove dfs node!\n");
 #endif
 
-	_cleanup_req(&cdesc->req);
+	_cleanup_cdesc_req(cdesc);
 
 	_free_cdesc(cdesc);
 
@@ -617,9 +707,11 @@ int dma_setup_transfer(unsigned int chan,
 	c->req.cfg = config;
 	/* attach xfer item */
 	c->req.x = xfer;
+	/* keep it for restarts / run it cyclic */
+	err = _setup_mode(c, cfg);
 
 	spin_unlock_irqrestore(&lock, flags);
-	return 0;
+	return err;
 
       err2:
 	kfree(config);
@@ -846,9 +938,11 @@ int dma_setup_transfer_sg(unsigned int chan,
 	c->req.cfg = config;
 	/* attach xfer item list */
 	c->req.x = xfer_front;
+	/* keep it for restarts / run it cyclic */
+	err = _setup_mode(c, cfg);
 
 	spin_unlock_irqrestore(&lock, flags);
-	return 0;
+	return err;
 
       err2:
 	/* Free all allocated xfer items */
@@ -1081,9 +1175,11 @@ int dma_setup_transfer_list(unsigned int chan, struct list_head *head,
 	/* attach xfer item list */
 	c->req.x = xfer_front;
 	c->is_setup = true;	/* Mark the xfer item as valid */
+	/* keep it for restarts / run it cyclic */
+	err = _setup_mode(c, cfg);
 
 	spin_unlock_irqrestore(&lock, flags);
-	return 0;
+	return err;
 
       err2:
 	/* Free all allocated xfer items */
@@ -1330,9 +1426,11 @@ int dma_setup_transfer_list_multi_sg(unsigned int chan,
 	/* attach xfer item list */
 	c->req.x = xfer_front;
 	c->is_setup = true;	/* Mark the xfer item as valid */
+	/* keep it for restarts / run it cyclic */
+	err = _setup_mode(c, cfg);
 
 	spin_unlock_irqrestore(&lock, flags);
-	return 0;
+	return err;
 
 err2:
 	/* Free all allocated xfer items */
@@ -1359,6 +1457,7 @@ int dma_start_transfer(unsigned int chan)
 {
 	unsigned long flags;
 	struct pl330_chan_desc *c;
+	struct pl330_req *r;
 	int ret;
 
 	spin_lock_irqsave(&lock, flags);
@@ -1387,8 +1486,20 @@ int dma_start_transfer(unsigned int chan)
 		goto err1;
 #endif
 
-	if (pl330_submit_req(c->pl330_chan_id, &c->req) != 0)
+	r = c->periods ? &c->period[0].req : &c->req;
+	if (pl330_submit_req(c->pl330_chan_id, r) != 0)
 		goto err2;
+	/* microcode stays valid until the next dma_setup_transfer* */
+	if (c->prepared || c->cyclic)
+		r->mc_reuse = true;
+	/* cyclic: queue a second period so there is no gap between them */
+	if (c->cyclic) {
+		r = c->periods ? &c->period[1].req : &c->req;
+		if (pl330_submit_req(c->pl330_chan_id, r) != 0)
+			goto err3;
+		r->mc_reuse = true;
+		c->next_period = c->periods ? 2 % c->periods : 0;
+	}
 
 	/*
 	 * Acquire DMUX semaphore while microcode loading
@@ -1409,6 +1520,8 @@ int dma_start_transfer(unsigned int chan)
 	spin_unlock_irqrestore(&lock, flags);
 
 	return 0;
+      err3:
+	pl330_chan_ctrl(c->pl330_chan_id, PL330_OP_FLUSH);
       err2:
 	dmux_sema_unprotect();
 #ifndef CONFIG_MACH_BCM_FPGA
@@ -1443,11 +1556,14 @@ int dma_stop_transfer(unsigned int chan)
 	pl330_chan_ctrl(c->pl330_chan_id, PL330_OP_FLUSH);
 	dmux_sema_unprotect();
 
-	/* Free the completed transfer req */
 	c->in_use = false;
-	c->is_setup = false;
-	/* free memory allocated for this request */
-	_cleanup_req(&c->req);
+	/* A prepared req stays set up for the next dma_start_transfer */
+	if (!c->prepared) {
+		/* Free the completed transfer req */
+		c->is_setup = false;
+		/* free memory allocated for this request */
+		_cleanup_cdesc_req(c);
+	}
 
 #ifndef CONFIG_MACH_BCM_FPGA
 	/* Disable clock after transfer */
@@ -1473,6 +1589,29 @@ int dma_stop_transfer(unsigned int chan)
 	return -1;
 }
 
+/* Drop a DMA_CFG_PREPARED request so that the channel can be set up again */
+int dma_release_transfer(unsigned int chan)
+{
+	unsigned long flags;
+	struct pl330_chan_desc *c;
+
+	spin_lock_irqsave(&lock, flags);
+
+	c = chan_id_to_cdesc(chan);
+	if (!c || c->in_use) {
+		spin_unlock_irqrestore(&lock, flags);
+		return -1;
+	}
+
+	c->prepared = false;
+	c->cyclic = false;
+	c->is_setup = false;
+	_cleanup_cdesc_req(c);
+
+	spin_unlock_irqrestore(&lock, flags);
+	return 0;
+}
+
 int dma_register_callback(unsigned int chan,
 			  pl330_xfer_callback_t callback, void *private_data)
 {
@@ -1656,7 +1795,7 @@ static int pl330_remove(struct platform_device *pdev)
 	/* Free all channel descriptors first */
 	list_for_each_entry_safe(cdesc, temp, &dmac->chan_list, node) {
 		/* free requests */
-		_cleanup_req(&cdesc->req);
+		_cleanup_cdesc_req(cdesc);
 		/* Free channel desc */
 		_free_cdesc(cdesc);
 	}
@@ -1714,6 +1853,7 @@ EXPORT_SYMBOL(dma_setup_transfer_list_multi_sg);
 EXPORT_SYMBOL(dma_setup_transfer_list);
 EXPORT_SYMBOL(dma_start_transfer);
 EXPORT_SYMBOL(dma_stop_transfer);
+EXPORT_SYMBOL(dma_release_transfer);
 EXPORT_SYMBOL(dma_register_callback);
 EXPORT_SYMBOL(dma_free_callback);
 #ifdef CONFIG_KONA_PI_MGR
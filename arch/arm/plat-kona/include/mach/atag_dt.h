@@ -26,12 +26,39 @@
 #ifndef __ATAGDT_H_
 #define __ATAGDT_H_
 
+#include <linux/types.h>
+
 /*
   This is a Broadcom Kona specific ATAG for DT-blob.
   Put it here instead of setup.h to avoid conflict when merging upstream.
 */
 #define ATAG_DTBLOB	0x54411122
 
+/*
+  The bootloader's splash, from the /splash node of the DT-blob:
+	reg = <base size>;	the frame the display still scans out
+	panel = "name";		the panel it initialised
+  The frame is kept reserved until kona_splash_release().
+*/
+struct kona_splash {
+	u32 base;
+	u32 size;
+	char panel[32];
+};
+
+#ifdef CONFIG_KONA_ATAG_DT
+extern const struct kona_splash *kona_get_splash(void);
+extern void kona_splash_reserve(void);
+extern void kona_splash_release(void);
+#else
+static inline const struct kona_splash *kona_get_splash(void)
+{
+	return NULL;
+}
+static inline void kona_splash_reserve(void) {}
+static inline void kona_splash_release(void) {}
+#endif
+
 extern int early_init_dt_scan_pinmux(unsigned long node, const
 				     char *uname, int depth, void *data);
 
@@ -67,6 +67,10 @@ struct axitrace_source {
 	unsigned long		axi_id_mask;
 	u8			all_masters_enabled;
 	u8			filters_enabled;
+	u8			ddr_port;	/* traffic to DDR, see
+						 * axitrace_get_ddr_beats() */
+	char			*prof_name;	/* profiled under this name
+						 * with KONA_AXITRACE_PROF */
 	struct resource		*resource;
 };
 
@@ -132,6 +136,30 @@ FIL_WRITE_ATTR,
 FIL_END_ATTR
 };
 
+/*
+ * Counters kept by the profiler, per source. The latency sums are in
+ * AXI clock cycles; divided by the commands they give the average.
+ */
+enum {
+AXITRACE_PROF_RDBEATS = 0,
+AXITRACE_PROF_WRBEATS,
+AXITRACE_PROF_RDCMDS,
+AXITRACE_PROF_WRCMDS,
+AXITRACE_PROF_RDLAT,
+AXITRACE_PROF_WRLAT,
+AXITRACE_PROF_CNTRS,
+};
+
+#define AXITRACE_PROF_SOURCES	4
+#define AXITRACE_PROF_SAMPLES	128
+#define AXITRACE_PROF_PERIOD_MS	100
+
+struct axitrace_prof_sample {
+	u64	time_ns;	/* local_clock() at the end of the sample */
+	u32	period_us;
+	u32	cnt[AXITRACE_PROF_SOURCES][AXITRACE_PROF_CNTRS];
+};
+
 struct per_trace_info {
 	struct axitrace_source	*p_source_info;
 	struct trace_state	state;
@@ -144,6 +172,14 @@ struct per_trace_info {
 	struct attribute_group	attr_group;
 	struct attribute_group	*filter_group;
 	u32	driver_cap;
+	bool	sysfs_owned;	/* set up through sysfs, the kernel keeps off */
+	u32	ddr_rdbeats;	/* counters at the last */
+	u32	ddr_wrbeats;	/* axitrace_get_ddr_beats() */
+#ifdef CONFIG_KONA_AXITRACE_PROF
+	u32	prof_last[AXITRACE_PROF_CNTRS];	/* counters at the last update */
+	u64	prof_total[AXITRACE_PROF_CNTRS];	/* since profiling began */
+	u64	prof_mark[AXITRACE_PROF_CNTRS];	/* totals at the last sample */
+#endif
 };
 
 struct complete_trace_src_info {
@@ -178,6 +214,12 @@ struct complete_trace_src_info {
 				RD_LATENCY_MODE | OUTS_COUNTING		|\
 				OUTS_FILTER)
 
+/* what the kernel users start idle sources counting */
+#define AXITRACE_KERNEL_CAP	(COMMANDS_COUNTING | BEATS_COUNTING |\
+				LATENCY_MEASUREMENT)
+
+#define AXITRACE_BEAT_BYTES	8	/* 64 bit AXI */
+
 #define	FILTER_READ		BIT(0)
 #define	FILTER_WRITE		BIT(1)
 #define	FILTER_LEN_MODE		BIT(2)
@@ -257,4 +299,11 @@ struct complete_trace_src_info {
 
 #define SHIFT(x)	(ffs(x) - 1)
 
+int axitrace_get_ddr_beats(u32 *beats);
+int axitrace_get_ddr_beats_total(u64 *beats);
+#ifdef CONFIG_KONA_AXITRACE_PROF
+int axitrace_prof_sources(const char **names, int max);
+int axitrace_prof_read(u64 (*totals)[AXITRACE_PROF_CNTRS], int max);
+#endif
+
 #endif /* __AXITRACE_H__ */
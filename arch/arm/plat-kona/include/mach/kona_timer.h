@@ -162,6 +162,14 @@ int kona_timer_set_match_start(struct kona_timer *kt, unsigned long load);
  * kt - Timer context to be freed.
  */
 unsigned int kona_timer_get_counter(struct kona_timer *kt);
+
+/*
+ * kona_timer_read_counter - Same as kona_timer_get_counter, without the
+ * checks and with interrupts left on, for the clocksource read paths
+ *
+ * kt - Timer context, must be valid.
+ */
+unsigned int kona_timer_read_counter(struct kona_timer *kt);
 /*
  * kona_timer_disable_and_clear - Disable the timer and clear the 
  * interrupt
@@ -96,6 +96,14 @@ union pinmux_reg {
 	} b;
 };
 
+/* bits of a non-BSC pad register, for pinmux_update_pins() */
+#define PINMUX_DRV_STH_MASK	0x07
+#define PINMUX_INPUT_DIS	(1 << 3)
+#define PINMUX_SLEW_RATE_CTRL	(1 << 4)
+#define PINMUX_PULL_UP		(1 << 5)
+#define PINMUX_PULL_DN		(1 << 6)
+#define PINMUX_HYS_EN		(1 << 7)
+
 /* board-level or use-case based configuration */
 struct pin_config {
 	enum PIN_NAME name;
@@ -126,6 +134,22 @@ int pinmux_get_pin_config(struct pin_config *config);
 */
 int pinmux_set_pin_config(struct pin_config *config);
 
+/*
+  set a group of pins in one call, as pinmux_set_pin_config() each;
+  nothing is written unless all of them are valid
+*/
+int pinmux_set_pin_configs(struct pin_config *configs, unsigned int n);
+
+/*
+  change the bits in mask to val on each pin of a group, keeping the rest
+  of its configuration
+*/
+int pinmux_update_pins(const enum PIN_NAME *names, unsigned int n,
+		       unsigned int mask, unsigned int val);
+
+/* forget the pad shadow after something that lost the pad state */
+void pinmux_shadow_invalidate(void);
+
 static inline int is_ball_valid(enum PIN_NAME name)
 {
 	return name < PN_MAX;
@@ -37,6 +37,9 @@
 #include <linux/io.h>
 #include <mach/io_map.h>
 #include <mach/rdb/brcm_rdb_uartb.h>
+#ifdef CONFIG_ARCH_JAVA
+#include <mach/rdb/brcm_rdb_kona_gptimer.h>
+#endif
 
 #if defined(CONFIG_MACH_HAWAII_SS_EVAL_REV00) \
 	|| defined(CONFIG_MACH_HAWAII_SS_LOGAN_REV00) \
@@ -89,4 +92,12 @@ static inline void flush(void)
 #define arch_decomp_setup()
 #define arch_decomp_wdog()
 
+#ifdef CONFIG_ARCH_JAVA
+/* the always on core timer, counting at 32kHz from reset */
+#define arch_decomp_timer()	(*(volatile unsigned long *) \
+				 (CORE_TIMER_BASE_ADDR + \
+				  KONA_GPTIMER_STCLO_OFFSET))
+#define arch_decomp_timer_hz	32768
+#endif
+
 #endif /* __ASM_ARCH_UNCOMPRESS_H */
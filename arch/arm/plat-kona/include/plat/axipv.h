@@ -51,9 +51,15 @@ typedef u32 axipv_async_buf_t;
 #define WATER_LVL2_INT	(1<<1)
 #define TE_INT	(1<<0)
 
-/* Once we change the Userspace Framebuffer.cpp to request for buffers
- * from display drivers, we can change this accordingly*/
-#define AXIPV_MAX_DISP_BUFF_SUPP 2
+/* Buffers held back in software while NXT_FRAME is still pending */
+#ifdef CONFIG_AXIPV_QUEUE_DEPTH
+#define AXIPV_QUEUE_DEPTH CONFIG_AXIPV_QUEUE_DEPTH
+#else
+#define AXIPV_QUEUE_DEPTH 1
+#endif
+
+/* Current and next frame owned by the hardware plus the software queue */
+#define AXIPV_MAX_DISP_BUFF_SUPP (AXIPV_QUEUE_DEPTH + 2)
 
 #if defined(CONFIG_HAVE_CLK) && !defined(CONFIG_MACH_BCM_FPGA)
 #define AXIPV_HAS_CLK
@@ -73,6 +79,7 @@ struct axipv_init_t {
 	char *clk_name;
 #endif
 	void (*irq_cb)(int err);
+	/* Called from atomic context as soon as free_buf is off the screen */
 	void (*release_cb)(u32 free_buf);
 	void (*vsync_cb)(void);
 };
@@ -133,6 +140,9 @@ int axipv_set_mode(struct axipv_config_t *config, u32 mode);
 
 int axipv_get_state(struct axipv_config_t *config);
 
+/* FIFO underflow interrupts since boot, they wrap */
+u32 axipv_get_underruns(void);
+
 int axipv_post(struct axipv_config_t *config);
 
 void axipv_release_pixdfifo_ownership(struct axipv_config_t *config);
@@ -13,6 +13,7 @@
 #define __ARM_ARCH_KONA_CLOCK_H
 
 #include <linux/errno.h>
+#include <linux/atomic.h>
 #include <linux/spinlock.h>
 #include <linux/init.h>
 #include <linux/clk.h>
@@ -123,6 +124,8 @@
 
 #define POLICY_RESUME_INS_COUNT	20000
 #define CLK_EN_INS_COUNT	1000
+/* peri clocks a CCU can have gated off and not yet seen stopped */
+#define CCU_GATE_PEND_MAX	8
 
 #define CCU_POLICY_MASK_ENABLE_ALL_MASK	0x7FFFFFFF
 
@@ -475,6 +478,8 @@ struct clk {
 	int id;
 	int init;
 	int use_cnt;
+	/* clk_enable() holders, sharing one use_cnt reference */
+	atomic_t fast_cnt;
 	u32 flags;
 	u32 rate;
 	int clk_type;
@@ -532,6 +537,16 @@ struct ccu_clk {
 	u32 policy_dbg_offset;
 	u32 policy_dbg_act_freq_shift;
 	u32 policy_dbg_act_policy_shift;
+	/* gated off, stop status not waited for yet, under clk_lock */
+	struct peri_clk *gate_pend[CCU_GATE_PEND_MAX];
+	u32 gate_pend_cnt;
+#ifdef CONFIG_KONA_CLK_LOCK_STAT
+	/* clk_lock hold times, under clk_lock */
+	u64 lock_ts;
+	u64 lock_total_ns;
+	u32 lock_max_ns;
+	u32 lock_count;
+#endif
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dent_ccu_dir;
 	u32 clk_mon_offset;
@@ -847,6 +862,16 @@ int clk_trace_init(unsigned int count);
 int __clk_enable(struct clk *clk);
 void __clk_disable(struct clk *clk);
 
+/*
+ * Enable or disable several clocks together, e.g. the bus and peripheral
+ * clocks of a block. Consecutive clocks of the same CCU are switched under
+ * a single lock and CCU write access. NULL entries are skipped.
+ */
+int clk_enable_group(struct clk **clks, int num);
+void clk_disable_group(struct clk **clks, int num);
+/* waits for the deferred peri clock stops of all CCUs, at idle entry */
+void clk_gate_flush_all(void);
+
 
 
 
@@ -211,6 +211,23 @@ extern "C" {
 	CSL_LCD_RES_T CSL_DSI_SendPacket(CSL_LCD_HANDLE clientH,
 					 pCSL_DSI_CMND cmnd, Boolean isTE);
 
+/**
+*
+*  @brief	Send DSI Commands back to back
+*
+*  @param	clientH		(in)  CSL DSI Client handle
+*  @param	cmnd		(in)  Array of command definitions
+*  @param	count		(in)  Number of commands
+*
+*  @return	CSL_LCD_RES_T  (out) result of the first failed command
+*
+*  @note	The interface is held across the list and each packet end
+*		is polled for, for panel command sequences
+*
+*****************************************************************************/
+	CSL_LCD_RES_T CSL_DSI_SendPacketList(CSL_LCD_HANDLE clientH,
+					     pCSL_DSI_CMND cmnd, UInt32 count);
+
 /**
 *
 *  @brief    Open (configure) Command Mode VC Display Interface
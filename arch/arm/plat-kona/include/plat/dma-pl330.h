@@ -102,6 +102,22 @@ enum dma_direction {
 #define DMA_PERI_REQ_ALWAYS_BURST_MASK 12
 #define DMA_PERI_REQ_ALWAYS_BURST      (0x1 << DMA_PERI_REQ_ALWAYS_BURST_MASK)
 
+/* Transfer reuse
+ *
+ * PREPARED: dma_stop_transfer keeps the request and its microcode, the
+ * same transfer is run again with just dma_start_transfer. The channel
+ * can only be set up again after dma_release_transfer.
+ *
+ * CYCLIC: the request is resubmitted each time it completes, calling
+ * the client callback once per pass, until dma_stop_transfer. Each
+ * xfer item of a list is a period of its own: the callback follows
+ * every item and the list wraps around after the last one.
+ */
+#define DMA_CFG_PREPARED_SHIFT		13
+#define DMA_CFG_PREPARED		(0x1 << DMA_CFG_PREPARED_SHIFT)
+#define DMA_CFG_CYCLIC_SHIFT		14
+#define DMA_CFG_CYCLIC			(0x1 << DMA_CFG_CYCLIC_SHIFT)
+
 
 enum pl330_xfer_status {
 	DMA_PL330_XFER_OK,
@@ -143,9 +159,16 @@ int dma_setup_transfer_list_multi_sg(unsigned int chan,
 			int control, int cfg);
 int dma_start_transfer(unsigned int chan);
 int dma_stop_transfer(unsigned int chan);
+int dma_release_transfer(unsigned int chan);
 int dma_shutdown_all_chan(void);
 int dma_register_callback(unsigned int chan,
 			  pl330_xfer_callback_t cb, void *pri);
 int dma_free_callback(unsigned int chan);
 
+#ifdef CONFIG_KONA_DMAENGINE
+struct dma_chan;
+/* dma_request_channel filter, param is the dmux peripheral name */
+bool kona_dma_filter_fn(struct dma_chan *chan, void *param);
+#endif
+
 #endif /* __PLAT_DMA_H */
@@ -57,6 +57,15 @@ struct kona_cpufreq_drv_pdata {
 
 	/*Init callback - can be NULL */
 	void (*cpufreq_init) (void);
+
+	/* Measured power, in uW, with the cpu busy at each freq_tbl entry
+	 * and resting in each C-state. Used by the energy aware OPP
+	 * selection; can be NULL */
+	u32 *opp_power;
+	u32 *cstate_power;
+	/* Voltage of an OPP in uV, eg from AVS. Used to estimate opp_power
+	 * when it is not given - can be NULL */
+	int (*get_opp_volt) (int opp);
 };
 
 struct cpufreq_lmt_node {
@@ -31,6 +31,7 @@
 
 #include <linux/plist.h>
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 
 enum {
 	KONA_MEMC_ENABLE_SELFREFRESH = 1,
@@ -124,7 +125,21 @@ struct kona_memc {
 	struct plist_head dfs_list;
 	struct list_head usr_dfs_list;
 	u32 active_dfs_opp;
+	u32 dfs_opp_lmt;
 	u32 pll_rate;
+	u64 opp_time_ns[MEMC_OPP_MAX];	/* residency per OPP */
+	u64 opp_since_ns;
+#endif
+#ifdef CONFIG_MEMC_DFS_GOV
+	struct kona_memc_node gov_node;
+	struct delayed_work gov_work;
+	u32 gov_enable;
+	u32 gov_period_ms;
+	u32 gov_target;			/* percent of the OPP bandwidth */
+	u32 gov_down;			/* low samples in a row */
+	u32 gov_bw_mbps;		/* last sample */
+	u32 opp_freq[MEMC_OPP_MAX];
+	ktime_t gov_last;
 #endif
 	spinlock_t memc_lock;
 	void __iomem *memc0_ns_base;
@@ -154,6 +169,8 @@ int memc_add_dfs_req(struct kona_memc_node *memc_node,
 		char *client_name, u32 opp);
 int memc_del_dfs_req(struct kona_memc_node *memc_node);
 int memc_update_dfs_req(struct kona_memc_node *memc_node, u32 opp);
+int memc_set_dfs_opp_limit(u32 opp);
+u32 memc_get_dfs_req(void);
 #else
 static inline int memc_add_dfs_req(struct kona_memc_node *memc_node,
 		char *client_name, u32 opp)
@@ -169,6 +186,16 @@ static inline int memc_update_dfs_req(struct kona_memc_node *memc_node, u32 opp)
 {
 	return -EINVAL;
 }
+
+static inline int memc_set_dfs_opp_limit(u32 opp)
+{
+	return -EINVAL;
+}
+
+static inline u32 memc_get_dfs_req(void)
+{
+	return 0;
+}
 #endif /*CONFIG_MEMC_DFS*/
 
 
@@ -12,6 +12,8 @@
 #ifndef __KONA_PM_H__
 #define __KONA_PM_H__
 
+#include <linux/ktime.h>
+
 /* Additional control parameters */
 #define CTRL_PARAMS_FLAG_XTAL_ON	(1 << 0)
 #define CTRL_PARAMS_ENTER_SUSPEND	(1 << 1)
@@ -63,4 +65,37 @@ int cstate_notifier_register(struct notifier_block *nb);
 int cstate_notifier_unregister(struct notifier_block *nb);
 int pm_is_forced_sleep(void);
 
+#ifdef CONFIG_KONA_PM_TIMELINE
+void kona_pm_timeline_enter(void);
+void kona_pm_timeline_exit(u32 sleep_ms);
+void kona_pm_timeline_seq(u64 ns);
+#else
+static inline void kona_pm_timeline_enter(void) {}
+static inline void kona_pm_timeline_exit(u32 sleep_ms) {}
+static inline void kona_pm_timeline_seq(u64 ns) {}
+#endif
+
+struct cpuidle_device;
+struct cpuidle_driver;
+
+#ifdef CONFIG_KONA_IDLE_ADAPTIVE
+int kona_idle_adapt_select(struct cpuidle_device *dev,
+			   struct cpuidle_driver *drv, int index);
+/* called by the mach enter handler right before the wfi */
+void kona_idle_adapt_stamp(void);
+void kona_idle_adapt_exit(struct cpuidle_driver *drv, int index,
+			  ktime_t start, ktime_t end);
+#else
+static inline int kona_idle_adapt_select(struct cpuidle_device *dev,
+					 struct cpuidle_driver *drv, int index)
+{
+	return index;
+}
+static inline void kona_idle_adapt_stamp(void) {}
+static inline void kona_idle_adapt_exit(struct cpuidle_driver *drv,
+					int index, ktime_t start, ktime_t end)
+{
+}
+#endif
+
 #endif /*__KONA_PM_H__*/
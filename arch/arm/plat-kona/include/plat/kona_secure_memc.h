@@ -72,6 +72,8 @@ enum region_parms {
 
 
 #define REGION_MEM_TYPE_SHIFT				1
+#define REGION_MEM_TYPE_MASK				0x06
+#define REGION_EN_MASK					0x01
 #define RGN_GID_SANDBOX_EN_SHIFT			16
 #define RGN_GID_SANDBOX_EN_MASK				0x00FF0000
 
@@ -181,9 +183,41 @@ struct kona_secure_memc {
 	char **masters;
 	u32 memc_state;
 	u32 handle;
+	/* region registers and shadow at run time, see kona_memc_txn */
+	spinlock_t lock;
+	u32 region_gen;
 	int (*init_static_config_memc)(struct kona_secure_memc *);
 };
 
+/*
+ * Run time region map changes. A transaction starts as a copy of the
+ * current map, regions are staged with kona_memc_txn_set() and
+ * kona_memc_txn_clear(), then kona_memc_txn_commit() validates the whole
+ * map and writes the regions that changed in one go. Commit fails with
+ * -EAGAIN if the map changed since kona_memc_txn_begin().
+ */
+struct kona_memc_region_cfg {
+	u32 start_address;
+	u32 end_address;
+	u32 mem_type;
+	u32 group_mask;
+};
+
+struct kona_memc_txn {
+	struct kona_secure_memc *memc_dev;
+	u32 gen;
+	u32 region_bitmap;
+	struct kona_memc_region_cfg region[NUM_OF_REGIONS];
+};
+
+u32 *get_secure_memc_handle(void);
+int kona_memc_txn_begin(u32 *memc_handle, struct kona_memc_txn *txn);
+int kona_memc_txn_find(struct kona_memc_txn *txn, u32 addr);
+int kona_memc_txn_set(struct kona_memc_txn *txn, u32 region_num,
+		      const struct kona_memc_region_cfg *cfg);
+void kona_memc_txn_clear(struct kona_memc_txn *txn, u32 region_num);
+int kona_memc_txn_commit(struct kona_memc_txn *txn);
+
 #endif /*__KONA_SECURE_MEMC_H__*/
 
 
@@ -248,6 +248,9 @@ enum {
 	PI_NOTIFY_DFS_CHANGE,
 	PI_NOTIFY_QOS_CHANGE,
 	PI_NOTIFY_POLICY_CHANGE,
+	/* DFS changes batched and reported from process context, once
+	 * the OPP settles: PI_POSTCHANGE only, first old to latest new */
+	PI_NOTIFY_DFS_CHANGE_DEFERRED,
 };
 
 struct pi_ops {
@@ -291,6 +294,7 @@ int pi_mgr_initialized(void);
 u32 pi_get_active_qos(int pi_id);
 u32 pi_get_active_opp(int pi_id);
 u32 pi_get_dfs_lmt(u32 pi_id, bool max);
+u32 pi_get_dfs_req(int pi_id);
 int pi_get_use_count(int pi_id);
 
 int __pi_enable(struct pi *pi);
@@ -18,6 +18,9 @@
 #ifndef _KONA_PROFILER_H
 #define _KONA_PROFILER_H
 
+#include <linux/ioctl.h>
+#include <linux/types.h>
+
 #define COUNTER_CLK_RATE		3250
 #define COUNTER_TO_MS(cnt)		(cnt/COUNTER_CLK_RATE)
 
@@ -60,8 +63,65 @@ enum profiler_type {
 	PROFILER_CPU,
 	PROFILER_MEMC,
 	PROFILER_L2C,
+	PROFILER_IDLE,
+};
+
+/**
+ * When the profilers are logged, in the order of the
+ * log_state strings of the debugfs interface
+ */
+enum profiler_log {
+	PROFILER_LOG_SUSPEND,
+	PROFILER_LOG_RESUME,
+	PROFILER_LOG_SUSP_RES,
+	PROFILER_LOG_IDLE,
+	PROFILER_LOG_PERIODIC,
+	/* sample event only: KONA_PROF_IOC_SNAPSHOT */
+	PROFILER_LOG_SNAPSHOT,
+};
+
+/**
+ * Entry of the profiler ring buffer, as read from
+ * /dev/kona_profiler. All the sources share the ktime_get()
+ * timebase; counter and overflow are those of the source's
+ * get_counter, since the previous entry of the source.
+ */
+struct profiler_sample {
+	__u64 time_ns;
+	__u32 source;		/* profiler id */
+	__u32 event;		/* enum profiler_log */
+	__u32 counter;
+	__u32 overflow;
+};
+
+struct profiler_source {
+	__u32 id;		/* in */
+	__u32 type;		/* enum profiler_type */
+	char name[PROF_NAME_MAX_LEN];
+};
+
+struct profiler_enable {
+	__u32 id;
+	__u32 enable;
+};
+
+struct profiler_start {
+	__u32 log_state;	/* enum profiler_log */
+	__u32 period_ms;	/* PROFILER_LOG_PERIODIC */
 };
 
+#define KONA_PROF_IOC_MAGIC		'P'
+/* -ENOENT past the last source */
+#define KONA_PROF_IOC_SOURCE		\
+	_IOWR(KONA_PROF_IOC_MAGIC, 0, struct profiler_source)
+#define KONA_PROF_IOC_ENABLE		\
+	_IOW(KONA_PROF_IOC_MAGIC, 1, struct profiler_enable)
+#define KONA_PROF_IOC_START		\
+	_IOW(KONA_PROF_IOC_MAGIC, 2, struct profiler_start)
+#define KONA_PROF_IOC_STOP		_IO(KONA_PROF_IOC_MAGIC, 3)
+/* log all the running sources now */
+#define KONA_PROF_IOC_SNAPSHOT		_IO(KONA_PROF_IOC_MAGIC, 4)
+
 struct profiler;
 
 struct prof_ops {
@@ -93,6 +153,7 @@ struct profiler {
 	unsigned long running_time;
 	int overflow;
 	enum profiler_type prof_type;
+	u32 id;		/* set by profiler_register */
 };
 
 /**
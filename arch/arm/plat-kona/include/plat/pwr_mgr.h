@@ -305,6 +305,8 @@ int pwr_mgr_set_v0x_specific_i2c_cmd_ptr(int v0x,
 					 *cmd_ptr);
 int pwr_mgr_pm_i2c_cmd_write(const struct i2c_cmd *i2c_cmd, u32 num_cmds);
 int pwr_mgr_pm_i2c_var_data_write(const u8 * var_data, int count);
+int pwr_mgr_pm_i2c_var_data_modify(u8 index, u8 val);
+int pwr_mgr_pm_i2c_var_data_read(u8 *data);
 
 int pwr_mgr_arm_core_dormant_enable(bool enable);
 int pwr_mgr_pi_retn_clamp_enable(int pi_id, bool enable);
@@ -29,6 +29,10 @@
 #include <asm/cpu.h>
 #include <asm/div64.h>
 #include <plat/kona_pm.h>
+#ifdef CONFIG_KONA_CPU_FREQ_ENERGY
+#include <linux/math64.h>
+#include <linux/of.h>
+#endif
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
 #include <asm/uaccess.h>
@@ -69,6 +73,12 @@ enum {
 	FREQ_LMT_NODE_UPDATE,
 };
 
+enum {
+	ENERGY_TBL_NONE,
+	ENERGY_TBL_MEASURED,	/* from DT or platform data, in uW */
+	ENERGY_TBL_ESTIMATED,	/* V^2 * f from get_opp_volt, no idle cost */
+};
+
 struct kona_cpufreq_stats {
 	int stats_en;
 	unsigned long long start_time;
@@ -104,6 +114,12 @@ struct kona_cpufreq {
 	struct delayed_work init_work;
 #endif
 	struct kona_cpufreq_stats stats;
+#ifdef CONFIG_KONA_CPU_FREQ_ENERGY
+	u32 *opp_power;
+	u32 *cstate_power;
+	int energy_tbl;
+	int energy_aware;
+#endif
 };
 
 static struct kona_cpufreq *kona_cpufreq;
@@ -441,6 +457,172 @@ static int kona_create_cpufreqs_table(struct cpufreq_policy *policy,
 	return 0;
 }
 
+#ifdef CONFIG_KONA_CPU_FREQ_ENERGY
+/* Power tables: DT first, then platform data. The estimate from OPP
+ * voltages is left to kona_cpufreq_energy_estimate(), as AVS may not
+ * have probed yet.
+ */
+static void kona_cpufreq_energy_init(struct platform_device *pdev)
+{
+	struct kona_cpufreq_drv_pdata *pdata = kona_cpufreq->pdata;
+	int n = kona_cpufreq->no_of_opps;
+	int c = kona_cpufreq->num_cstates;
+	bool cstates = false;
+
+	kona_cpufreq->opp_power = kzalloc((n + c) * sizeof(u32), GFP_KERNEL);
+	if (!kona_cpufreq->opp_power)
+		return;
+	kona_cpufreq->cstate_power = kona_cpufreq->opp_power + n;
+
+#ifdef CONFIG_OF
+	if (pdev->dev.of_node) {
+		struct device_node *np = pdev->dev.of_node;
+
+		if (!of_property_read_u32_array(np, "opp-power-uw",
+				kona_cpufreq->opp_power, n))
+			kona_cpufreq->energy_tbl = ENERGY_TBL_MEASURED;
+		if (c && !of_property_read_u32_array(np, "cstate-power-uw",
+				kona_cpufreq->cstate_power, c))
+			cstates = true;
+	}
+#endif
+	if (kona_cpufreq->energy_tbl == ENERGY_TBL_NONE && pdata->opp_power) {
+		memcpy(kona_cpufreq->opp_power, pdata->opp_power,
+		       n * sizeof(u32));
+		kona_cpufreq->energy_tbl = ENERGY_TBL_MEASURED;
+	}
+	if (!cstates && c && pdata->cstate_power)
+		memcpy(kona_cpufreq->cstate_power, pdata->cstate_power,
+		       c * sizeof(u32));
+}
+
+/* Relative busy power C * V^2 * f, with V in mV and f in MHz */
+static int kona_cpufreq_energy_estimate(void)
+{
+	struct kona_cpufreq_drv_pdata *pdata = kona_cpufreq->pdata;
+	u64 mv2;
+	int i, uv;
+
+	if (!pdata->get_opp_volt)
+		return -ENODEV;
+	for (i = 0; i < kona_cpufreq->no_of_opps; i++) {
+		uv = pdata->get_opp_volt(kona_cpufreq->freq_map[i].opp);
+		if (uv <= 0)
+			return -ENODEV;
+		mv2 = (u64)(uv / 1000) * (uv / 1000);
+		kona_cpufreq->opp_power[i] = (u32)div_u64(mv2 *
+				(kona_cpufreq->freq_map[i].cpu_freq / 1000),
+				1000);
+	}
+	kona_cpufreq->energy_tbl = ENERGY_TBL_ESTIMATED;
+	return 0;
+}
+
+/* Power of an idle cpu: each C-state weighted by the residency the
+ * stats have seen so far, or the shallowest one without stats.
+ */
+static u32 kona_cpufreq_idle_power(void)
+{
+	struct kona_cpufreq_stats *stats = &kona_cpufreq->stats;
+	int n = kona_cpufreq->no_of_opps;
+	u64 t, total = 0, energy = 0;
+	int cpu, i;
+
+	if (!kona_cpufreq->num_cstates ||
+	    kona_cpufreq->energy_tbl != ENERGY_TBL_MEASURED)
+		return 0;
+
+	if (stats->stats_en) {
+		spin_lock(&kona_cpufreq->kcf_lock);
+		for (i = 0; i < kona_cpufreq->num_cstates; i++) {
+			t = 0;
+			for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+				t += stats->stats[cpu][n + i];
+			total += t;
+			energy += t * kona_cpufreq->cstate_power[i];
+		}
+		spin_unlock(&kona_cpufreq->kcf_lock);
+	}
+	if (!total)
+		return kona_cpufreq->cstate_power[0];
+	return (u32)div64_u64(energy, total);
+}
+
+/* The governor asked for the OPP at index, the slowest one that gets
+ * the work it predicts done before its next sample. The same work at a
+ * faster OPP f(i) is done early and the cpu idles for the rest of the
+ * window, so per window
+ *	E(i) = P(i) * f / f(i) + P(idle) * (1 - f / f(i))
+ * Return the cheapest OPP from f up to the policy max.
+ */
+static int kona_cpufreq_energy_index(struct cpufreq_policy *policy,
+				     int index)
+{
+	struct cpufreq_frequency_table *t = kona_cpufreq->kona_freqs_table;
+	u32 f = t[index].frequency;
+	u32 p_idle = kona_cpufreq_idle_power();
+	u64 e, best_e = ULLONG_MAX;
+	int i, best = index;
+
+	for (i = 0; t[i].frequency != CPUFREQ_TABLE_END; i++) {
+		u32 fi = t[i].frequency;
+
+		if (fi < f || fi > policy->max)
+			continue;
+		e = div_u64((u64)kona_cpufreq->opp_power[i] * f +
+			    (u64)p_idle * (fi - f), fi);
+		if (e < best_e) {
+			best_e = e;
+			best = i;
+		}
+	}
+	if (best != index)
+		kcf_dbg("%s: %u -> %u kHz\n", __func__, f,
+			t[best].frequency);
+	return best;
+}
+
+static ssize_t show_energy_aware(struct cpufreq_policy *policy, char *buf)
+{
+	return sprintf(buf, "%d\n", kona_cpufreq->energy_aware);
+}
+
+static ssize_t store_energy_aware(struct cpufreq_policy *policy,
+				  const char *buf, size_t count)
+{
+	long val;
+
+	if (strict_strtol(buf, 10, &val))
+		return -EINVAL;
+	if (val && kona_cpufreq->energy_tbl == ENERGY_TBL_NONE &&
+	    (!kona_cpufreq->opp_power || kona_cpufreq_energy_estimate()))
+		return -ENODEV;
+	kona_cpufreq->energy_aware = !!val;
+	return count;
+}
+
+static ssize_t show_energy_table(struct cpufreq_policy *policy, char *buf)
+{
+	ssize_t count = 0;
+	int i;
+
+	if (kona_cpufreq->energy_tbl == ENERGY_TBL_NONE)
+		return sprintf(buf, "none\n");
+	for (i = 0; i < kona_cpufreq->no_of_opps; i++)
+		count += scnprintf(&buf[count], PAGE_SIZE - count, "%u %u\n",
+				kona_cpufreq->freq_map[i].cpu_freq,
+				kona_cpufreq->opp_power[i]);
+	count += scnprintf(&buf[count], PAGE_SIZE - count, "idle %u%s\n",
+			kona_cpufreq_idle_power(),
+			kona_cpufreq->energy_tbl == ENERGY_TBL_ESTIMATED ?
+			" (estimated)" : "");
+	return count;
+}
+
+cpufreq_freq_attr_rw(energy_aware);
+cpufreq_freq_attr_ro(energy_table);
+#endif /*CONFIG_KONA_CPU_FREQ_ENERGY*/
+
 /*********************************************************************
  *                       CPUFREQ CORE INTERFACE                      *
  *********************************************************************/
@@ -518,6 +700,10 @@ static int kona_cpufreq_set_speed(struct cpufreq_policy *policy,
 	     &index)) {
 		return -EINVAL;
 	}
+#ifdef CONFIG_KONA_CPU_FREQ_ENERGY
+	if (kona_cpufreq->energy_aware)
+		index = kona_cpufreq_energy_index(policy, index);
+#endif
 	freqs.old = kona_cpufreq_get_speed(policy->cpu);
 	freqs.new = kona_cpufreq->kona_freqs_table[index].frequency;
 	freqs.cpu = policy->cpu;
@@ -985,6 +1171,10 @@ static struct attribute_group _cpufreq_attr_group = {
 
 static struct freq_attr *kona_cpufreq_attr[] = {
 	&cpufreq_freq_attr_scaling_available_freqs,
+#ifdef CONFIG_KONA_CPU_FREQ_ENERGY
+	&energy_aware,
+	&energy_table,
+#endif
 	NULL,
 };
 
@@ -1097,6 +1287,9 @@ static int cpufreq_drv_probe(struct platform_device *pdev)
 	for (i = 0; i < CONFIG_NR_CPUS; i++)
 		stats->stats[i] = kzalloc(sizeof(u64) * ((pdata->num_freqs) +
 				kona_cpufreq->num_cstates), GFP_KERNEL);
+#ifdef CONFIG_KONA_CPU_FREQ_ENERGY
+	kona_cpufreq_energy_init(pdev);
+#endif
 
 	return ret;
 }
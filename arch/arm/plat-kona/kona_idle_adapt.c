@@ -0,0 +1,254 @@
+/*
+ * arch/arm/plat-kona/kona_idle_adapt.c
+ *
+ * Measured cpuidle state latencies and a wakeup hint for kona_pm.
+ *
+ * For each cpu and C state this keeps an exponentially smoothed
+ *
+ *	entry - from kona_pm taking the cpu to the state until the mach
+ *		code is about to wfi, which includes the pwr_mgr event
+ *		setup and the ARM, L2 and GIC context save of dormant
+ *	exit  - from the local timer event the cpu was waiting for until
+ *		it is back in kona_pm, including the dormant restore
+ *
+ * Exit is only known when the cpu was woken by its timer, so idle
+ * periods ended by another interrupt give no exit sample, and states
+ * left before the wfi give none at all. Once a state has enough samples
+ * on a cpu, the cpuidle state table gets the worst exit latency of all
+ * cpus and a target residency of twice the entry plus exit time, in
+ * place of the static values from the mach code.
+ *
+ * Before entering, the state the governor picked is demoted while its
+ * target residency is longer than the time to the next local timer
+ * event, or than the recent idle periods when the cpu keeps being woken
+ * early by interrupts.
+ *
+ * Everything runs on the idle cpu with interrupts off, the table is
+ * written without a lock as each field is a single word. The counters
+ * are in debugfs kona_idle_adapt, writing to it clears them.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpuidle.h>
+#include <linux/clockchips.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/tick.h>
+#include <plat/kona_pm.h>
+
+/* averages are kept scaled by 1 << IA_SHIFT, each sample weighs 1/8 */
+#define IA_SHIFT		3
+/* samples of a state on a cpu before the table uses them */
+#define IA_MIN_SAMPLES		16
+/* longer exits are an interrupt right after the timer, not latency */
+#define IA_MAX_EXIT_US		10000
+/* early wakeups in a row before they are used as the prediction */
+#define IA_EARLY_RUN		3
+
+struct ia_state {
+	u32 entry;		/* us << IA_SHIFT */
+	u32 exit;		/* us << IA_SHIFT */
+	u32 entry_samples;
+	u32 exit_samples;
+	u32 demoted;		/* picked by the governor, entered shallower */
+};
+
+struct ia_cpu {
+	ktime_t wfi;		/* from kona_idle_adapt_stamp, 0 if none */
+	ktime_t timer;		/* next local timer event at entry */
+	u32 early;		/* idle us << IA_SHIFT when woken early */
+	u32 early_run;
+	struct ia_state state[CPUIDLE_STATE_MAX];
+};
+
+static DEFINE_PER_CPU(struct ia_cpu, ia_cpu);
+
+static int ia_enable = 1;
+module_param_named(enable, ia_enable, int, S_IRUGO | S_IWUSR);
+
+static inline u32 ia_avg(u32 avg, u32 samples, u32 us)
+{
+	if (!samples)
+		return us << IA_SHIFT;
+	return avg - (avg >> IA_SHIFT) + us;
+}
+
+static ktime_t ia_next_timer(void)
+{
+	struct clock_event_device *evt;
+
+	evt = tick_get_device(smp_processor_id())->evtdev;
+	if (!evt)
+		return ktime_set(KTIME_SEC_MAX, 0);
+	return evt->next_event;
+}
+
+int kona_idle_adapt_select(struct cpuidle_device *dev,
+			   struct cpuidle_driver *drv, int index)
+{
+	struct ia_cpu *c = &__get_cpu_var(ia_cpu);
+	ktime_t now = ktime_get();
+	s64 predict;
+	int i = index;
+
+	c->wfi = ktime_set(0, 0);
+	c->timer = ia_next_timer();
+	if (!ia_enable)
+		return index;
+
+	predict = ktime_us_delta(c->timer, now);
+	if (c->early_run >= IA_EARLY_RUN)
+		predict = min_t(s64, predict, c->early >> IA_SHIFT);
+
+	while (i > drv->safe_state_index &&
+	       (drv->states[i].disabled || dev->states_usage[i].disable ||
+		drv->states[i].target_residency > predict))
+		i--;
+
+	if (i != index)
+		c->state[index].demoted++;
+	return i;
+}
+
+void kona_idle_adapt_stamp(void)
+{
+	__get_cpu_var(ia_cpu).wfi = ktime_get();
+}
+
+static void ia_update_table(struct cpuidle_driver *drv, int index)
+{
+	struct ia_state *s;
+	u32 entry = 0, exit = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		s = &per_cpu(ia_cpu, cpu).state[index];
+		if (s->entry_samples < IA_MIN_SAMPLES ||
+		    s->exit_samples < IA_MIN_SAMPLES)
+			continue;
+		entry = max(entry, s->entry >> IA_SHIFT);
+		exit = max(exit, s->exit >> IA_SHIFT);
+	}
+	if (!exit)
+		return;
+
+	drv->states[index].exit_latency = exit;
+	drv->states[index].target_residency = 2 * (entry + exit);
+}
+
+void kona_idle_adapt_exit(struct cpuidle_driver *drv, int index,
+			  ktime_t start, ktime_t end)
+{
+	struct ia_cpu *c = &__get_cpu_var(ia_cpu);
+	struct ia_state *s = &c->state[index];
+	s64 us;
+
+	/* the state gave up before the wfi, e.g. dormant was refused */
+	if (!c->wfi.tv64)
+		return;
+
+	us = ktime_us_delta(c->wfi, start);
+	s->entry = ia_avg(s->entry, s->entry_samples, us);
+	s->entry_samples++;
+
+	if (end.tv64 < c->timer.tv64) {
+		/* woken by something else than the timer */
+		us = ktime_us_delta(end, start);
+		c->early = ia_avg(c->early, c->early_run, us);
+		c->early_run++;
+		return;
+	}
+	c->early_run = 0;
+
+	/* the timer had already expired before the wfi */
+	if (c->timer.tv64 <= c->wfi.tv64)
+		return;
+	us = ktime_us_delta(end, c->timer);
+	if (us > IA_MAX_EXIT_US)
+		return;
+	s->exit = ia_avg(s->exit, s->exit_samples, us);
+	s->exit_samples++;
+
+	/* the safe state keeps its static values */
+	if (ia_enable && index != drv->safe_state_index)
+		ia_update_table(drv, index);
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+static int ia_show(struct seq_file *m, void *v)
+{
+	struct cpuidle_driver *drv = cpuidle_get_driver();
+	struct ia_cpu *c;
+	struct ia_state *s;
+	int cpu, i;
+
+	if (!drv)
+		return 0;
+
+	seq_puts(m, "state exit_latency target_residency\n");
+	for (i = 0; i < drv->state_count; i++)
+		seq_printf(m, "%-5s %12u %16u\n", drv->states[i].name,
+			   drv->states[i].exit_latency,
+			   drv->states[i].target_residency);
+
+	seq_puts(m, "\ncpu state entry_us samples exit_us samples demoted\n");
+	for_each_possible_cpu(cpu) {
+		c = &per_cpu(ia_cpu, cpu);
+		for (i = 0; i < drv->state_count; i++) {
+			s = &c->state[i];
+			seq_printf(m, "%3d %-5s %8u %7u %7u %7u %7u\n", cpu,
+				   drv->states[i].name, s->entry >> IA_SHIFT,
+				   s->entry_samples, s->exit >> IA_SHIFT,
+				   s->exit_samples, s->demoted);
+		}
+		seq_printf(m, "%3d early_us %u run %u\n", cpu,
+			   c->early >> IA_SHIFT, c->early_run);
+	}
+	return 0;
+}
+
+static int ia_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ia_show, NULL);
+}
+
+static ssize_t ia_write(struct file *file, const char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	/* the table keeps its values until new samples come in */
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(ia_cpu, cpu).state, 0,
+		       sizeof(per_cpu(ia_cpu, cpu).state));
+	return count;
+}
+
+static const struct file_operations ia_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ia_open,
+	.read		= seq_read,
+	.write		= ia_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init kona_idle_adapt_debug_init(void)
+{
+	if (!debugfs_create_file("kona_idle_adapt", S_IRUGO | S_IWUSR,
+				 NULL, NULL, &ia_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(kona_idle_adapt_debug_init);
+
+#endif
@@ -0,0 +1,292 @@
+/*
+ * arch/arm/plat-kona/kona_input_boost.c
+ *
+ * Input and frame deadline boost for the Kona cpufreq driver.
+ *
+ * A touch event raises the cpu to the frequency of boost_opp for
+ * boost_ms. The compositor can also write the time left until its next
+ * vsync deadline, in microseconds, to frame_deadline_us; the cpu then
+ * runs at the frequency of frame_opp until that deadline has passed.
+ *
+ * Both boosts are a min limit request (cpufreq_add_lmt_req), so they
+ * stay below any max limit tmon or user space has in force, and the
+ * governor (interactive or otherwise) picks up the new floor through
+ * its CPUFREQ_GOV_LIMITS event without waiting for its next sample.
+ *
+ * boost_count, frame_count and boost_time_ms report how many input and
+ * frame boosts were taken and how long the floor was raised in total.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpufreq.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <plat/kona_cpufreq_drv.h>
+#include <plat/pi_mgr.h>
+#include <asm/div64.h>
+
+static unsigned int boost_opp = PI_OPP_TURBO;
+module_param(boost_opp, uint, S_IRUGO | S_IWUSR);
+static unsigned int boost_ms = 100;
+module_param(boost_ms, uint, S_IRUGO | S_IWUSR);
+static unsigned int frame_opp = PI_OPP_NORMAL;
+module_param(frame_opp, uint, S_IRUGO | S_IWUSR);
+/* longest deadline taken from the compositor, two frames at 60Hz */
+static unsigned int frame_max_us = 33333;
+module_param(frame_max_us, uint, S_IRUGO | S_IWUSR);
+static bool enabled = true;
+module_param(enabled, bool, S_IRUGO | S_IWUSR);
+
+static struct cpufreq_lmt_node boost_node;
+static bool boost_node_added;
+static DEFINE_MUTEX(boost_lock);	/* serialises the limit updates */
+static DEFINE_SPINLOCK(boost_state_lock);
+
+static struct delayed_work boost_work;
+static unsigned long input_until, frame_until;
+static bool input_on, frame_on;
+
+/* statistics, under boost_state_lock */
+static unsigned long boost_count, frame_count;
+static u64 boost_time_ns;
+static ktime_t boost_start;
+static u32 boost_freq_cur;	/* written under both locks */
+
+static u32 boost_opp_freq(unsigned int opp)
+{
+	return opp < PI_OPP_MAX ? get_cpu_freq_from_opp(opp) : 0;
+}
+
+/*
+ * Work out the floor the pending boosts ask for, apply it if it changed
+ * and come back when the earliest of them runs out.
+ */
+static void boost_work_fn(struct work_struct *work)
+{
+	unsigned long now = jiffies, next = 0, flags;
+	u32 freq = 0;
+
+	spin_lock_irqsave(&boost_state_lock, flags);
+	if (input_on && time_before(now, input_until)) {
+		freq = max(freq, boost_opp_freq(boost_opp));
+		next = input_until;
+	} else {
+		input_on = false;
+	}
+	if (frame_on && time_before(now, frame_until)) {
+		freq = max(freq, boost_opp_freq(frame_opp));
+		if (!next || time_before(frame_until, next))
+			next = frame_until;
+	} else {
+		frame_on = false;
+	}
+	if (!enabled)
+		freq = 0;
+	spin_unlock_irqrestore(&boost_state_lock, flags);
+
+	mutex_lock(&boost_lock);
+	if (boost_node_added && freq != boost_freq_cur) {
+		ktime_t t = ktime_get();
+
+		cpufreq_update_lmt_req(&boost_node,
+				       freq ? freq : DEFAULT_LIMIT);
+
+		spin_lock_irqsave(&boost_state_lock, flags);
+		if (!boost_freq_cur)
+			boost_start = t;
+		else if (!freq)
+			boost_time_ns += ktime_to_ns(ktime_sub(t, boost_start));
+		boost_freq_cur = freq;
+		spin_unlock_irqrestore(&boost_state_lock, flags);
+	}
+	mutex_unlock(&boost_lock);
+
+	if (freq && next)
+		mod_delayed_work(system_freezable_wq, &boost_work,
+				 max_t(long, next - jiffies, 1));
+}
+
+static void boost_kick(void)
+{
+	mod_delayed_work(system_freezable_wq, &boost_work, 0);
+}
+
+static int boost_set_deadline(const char *val, struct kernel_param *kp)
+{
+	unsigned long flags;
+	unsigned int us;
+	int ret;
+
+	ret = kstrtouint(val, 0, &us);
+	if (ret)
+		return ret;
+	if (!enabled || !us)
+		return 0;
+
+	spin_lock_irqsave(&boost_state_lock, flags);
+	frame_until = jiffies + usecs_to_jiffies(min(us, frame_max_us));
+	frame_on = true;
+	frame_count++;
+	spin_unlock_irqrestore(&boost_state_lock, flags);
+
+	boost_kick();
+	return 0;
+}
+
+static int boost_get_zero(char *buf, const struct kernel_param *kp)
+{
+	return sprintf(buf, "0\n");
+}
+module_param_call(frame_deadline_us, boost_set_deadline, boost_get_zero,
+		  NULL, S_IWUSR | S_IWGRP);
+
+static int boost_get_count(char *buf, const struct kernel_param *kp)
+{
+	return sprintf(buf, "%lu\n", *(unsigned long *)kp->arg);
+}
+module_param_call(boost_count, NULL, boost_get_count, &boost_count, S_IRUGO);
+module_param_call(frame_count, NULL, boost_get_count, &frame_count, S_IRUGO);
+
+static int boost_get_time(char *buf, const struct kernel_param *kp)
+{
+	unsigned long flags;
+	u64 ns;
+
+	spin_lock_irqsave(&boost_state_lock, flags);
+	ns = boost_time_ns;
+	/* a boost still in force counts up to now */
+	if (boost_freq_cur)
+		ns += ktime_to_ns(ktime_sub(ktime_get(), boost_start));
+	spin_unlock_irqrestore(&boost_state_lock, flags);
+
+	do_div(ns, NSEC_PER_MSEC);
+	return sprintf(buf, "%llu\n", ns);
+}
+module_param_call(boost_time_ms, NULL, boost_get_time, NULL, S_IRUGO);
+
+static void boost_input_event(struct input_handle *handle, unsigned int type,
+			      unsigned int code, int value)
+{
+	unsigned long now = jiffies, flags;
+	bool kick;
+
+	if (!enabled || !boost_ms)
+		return;
+
+	spin_lock_irqsave(&boost_state_lock, flags);
+	/* already boosted for most of the window: just let it run */
+	if (input_on &&
+	    time_before(now + msecs_to_jiffies(boost_ms) / 2, input_until)) {
+		spin_unlock_irqrestore(&boost_state_lock, flags);
+		return;
+	}
+	kick = !input_on;
+	if (kick)
+		boost_count++;
+	input_until = now + msecs_to_jiffies(boost_ms);
+	input_on = true;
+	spin_unlock_irqrestore(&boost_state_lock, flags);
+
+	/* an extension is picked up when the pending work runs */
+	if (kick)
+		boost_kick();
+}
+
+static int boost_input_connect(struct input_handler *handler,
+			       struct input_dev *dev,
+			       const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int ret;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "kona_input_boost";
+
+	ret = input_register_handle(handle);
+	if (ret)
+		goto err_register;
+
+	ret = input_open_device(handle);
+	if (ret)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err_register:
+	kfree(handle);
+	return ret;
+}
+
+static void boost_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id boost_ids[] = {
+	{
+		/* multi-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		/* single-touch touchscreens and touchpads */
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler boost_input_handler = {
+	.event		= boost_input_event,
+	.connect	= boost_input_connect,
+	.disconnect	= boost_input_disconnect,
+	.name		= "kona_input_boost",
+	.id_table	= boost_ids,
+};
+
+static int __init kona_input_boost_init(void)
+{
+	int ret;
+
+	INIT_DELAYED_WORK(&boost_work, boost_work_fn);
+
+	ret = cpufreq_add_lmt_req(&boost_node, "input_boost", DEFAULT_LIMIT,
+				  MIN_LIMIT);
+	if (ret) {
+		pr_err("%s: min limit request failed: %d\n", __func__, ret);
+		return ret;
+	}
+	boost_node_added = true;
+
+	ret = input_register_handler(&boost_input_handler);
+	if (ret)
+		pr_err("%s: input handler registration failed\n", __func__);
+	return 0;
+}
+late_initcall(kona_input_boost_init);
@@ -0,0 +1,289 @@
+/*
+ * arch/arm/plat-kona/kona_irq_balance.c
+ *
+ * Spreads the busiest device interrupts over the online cores.
+ *
+ * The GIC sends an interrupt to the first online cpu of its affinity, so
+ * with the default mask every device interrupt lands on CPU0. Every
+ * period_ms the rate of each interrupt is taken from its kstat counts,
+ * and those above min_rate per second are placed, busiest first, on the
+ * online core with the least interrupt load. An interrupt stays where it
+ * is unless another core has less load by more than min_rate, so the
+ * placement does not flap.
+ *
+ * Left alone, and counted as load of the core they are on, are the
+ * interrupts that cannot be balanced (per cpu ones, IRQF_NOBALANCING),
+ * those whose affinity a driver or user space has set, and those whose
+ * action name starts with one of the comma separated words of 'pinned',
+ * by default the audio and display ones. A core coming up or going down
+ * is rebalanced right away. Writing N to enabled puts the moved
+ * interrupts back on the default affinity. debugfs kona_irq_balance has
+ * the rates and the placement.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/interrupt.h>
+#include <linux/irq.h>
+#include <linux/irqdesc.h>
+#include <linux/jiffies.h>
+#include <linux/kernel_stat.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+
+/* interrupts placed per run, the busiest ones */
+#define KIB_MAX			32
+
+static unsigned int period_ms = 1000;
+module_param(period_ms, uint, S_IRUGO | S_IWUSR);
+static unsigned int min_rate = 500;
+module_param(min_rate, uint, S_IRUGO | S_IWUSR);
+static char pinned[128] = "caph,axipv,pv,dsi,smi,audio";
+module_param_string(pinned, pinned, sizeof(pinned), S_IRUGO | S_IWUSR);
+
+struct kib_irq {
+	unsigned int last;	/* kstat_irqs at the last run */
+	unsigned int rate;	/* per second */
+	int cpu;		/* placed there by us, -1 if not */
+	bool managed;
+};
+
+static struct kib_irq *kib;
+static DEFINE_MUTEX(kib_lock);
+static struct delayed_work kib_work;
+static unsigned long kib_last;
+static unsigned int kib_moves;
+static bool enabled = true;
+
+static bool kib_pinned(const char *name)
+{
+	const char *p = pinned, *end;
+	size_t len;
+
+	if (!name)
+		return false;
+	while (*p) {
+		end = strchrnul(p, ',');
+		len = end - p;
+		if (len && !strnicmp(name, p, len))
+			return true;
+		p = *end ? end + 1 : end;
+	}
+	return false;
+}
+
+/* the core the interrupt goes to now, and whether it is ours to move */
+static unsigned int kib_state(unsigned int irq, struct irq_desc *desc,
+			      bool *managed)
+{
+	struct kib_irq *k = &kib[irq];
+	struct irq_data *d = &desc->irq_data;
+	unsigned long flags;
+	unsigned int cpu;
+
+	raw_spin_lock_irqsave(&desc->lock, flags);
+	cpu = cpumask_first_and(d->affinity, cpu_online_mask);
+	*managed = false;
+	if (desc->action && irqd_can_balance(d) &&
+	    !kib_pinned(desc->action->name)) {
+		if (k->cpu >= 0 && cpumask_weight(d->affinity) == 1 &&
+		    !cpumask_test_cpu(k->cpu, d->affinity))
+			k->cpu = -1;	/* someone else pinned it */
+		else if (k->cpu >= 0 ||
+			 cpumask_equal(d->affinity, irq_default_affinity))
+			*managed = true;
+	}
+	raw_spin_unlock_irqrestore(&desc->lock, flags);
+	return cpu;
+}
+
+static void kib_restore(void)
+{
+	unsigned int irq;
+
+	for (irq = 0; irq < nr_irqs; irq++) {
+		if (kib[irq].cpu < 0)
+			continue;
+		irq_set_affinity(irq, irq_default_affinity);
+		kib[irq].cpu = -1;
+	}
+}
+
+static void kib_balance(struct work_struct *work)
+{
+	unsigned long load[NR_CPUS] = { 0 };
+	unsigned int cand[KIB_MAX], curs[KIB_MAX];
+	unsigned int irq, cpu, cur, best, count, ms, n = 0, i, j;
+	struct irq_desc *desc;
+	struct kib_irq *k;
+	bool managed;
+
+	mutex_lock(&kib_lock);
+	if (!enabled)
+		goto out;
+
+	ms = jiffies_to_msecs(jiffies - kib_last) ? : 1;
+	kib_last = jiffies;
+	for_each_irq_desc(irq, desc) {
+		k = &kib[irq];
+		count = kstat_irqs(irq);
+		k->rate = div_u64((u64)(count - k->last) * MSEC_PER_SEC, ms);
+		k->last = count;
+		k->managed = false;
+		if (!k->rate)
+			continue;
+
+		cur = kib_state(irq, desc, &managed);
+		if (cur >= nr_cpu_ids)
+			continue;
+		k->managed = managed;
+		if (!managed || k->rate < min_rate || n == KIB_MAX) {
+			load[cur] += k->rate;
+			continue;
+		}
+
+		/* keep the candidates sorted, busiest first */
+		for (i = n++; i && kib[cand[i - 1]].rate < k->rate; i--) {
+			cand[i] = cand[i - 1];
+			curs[i] = curs[i - 1];
+		}
+		cand[i] = irq;
+		curs[i] = cur;
+	}
+
+	for (j = 0; j < n; j++) {
+		irq = cand[j];
+		cur = best = curs[j];
+		for_each_online_cpu(cpu)
+			if (load[cpu] < load[best])
+				best = cpu;
+		if (load[best] + min_rate >= load[cur])
+			best = cur;
+		load[best] += kib[irq].rate;
+
+		if (best == cur)
+			continue;
+		if (!irq_set_affinity(irq, cpumask_of(best))) {
+			kib[irq].cpu = best;
+			kib_moves++;
+		}
+	}
+
+	queue_delayed_work(system_power_efficient_wq, &kib_work,
+			   msecs_to_jiffies(period_ms));
+out:
+	mutex_unlock(&kib_lock);
+}
+
+static int kib_set_enabled(const char *val, struct kernel_param *kp)
+{
+	bool was = enabled;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || !kib || was == enabled)
+		return ret;
+
+	if (enabled) {
+		mod_delayed_work(system_power_efficient_wq, &kib_work, 0);
+	} else {
+		cancel_delayed_work_sync(&kib_work);
+		mutex_lock(&kib_lock);
+		kib_restore();
+		mutex_unlock(&kib_lock);
+	}
+	return 0;
+}
+module_param_call(enabled, kib_set_enabled, param_get_bool, &enabled,
+		  S_IRUGO | S_IWUSR);
+
+static int kib_cpu_callback(struct notifier_block *nb, unsigned long action,
+			    void *hcpu)
+{
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DEAD:
+		if (enabled)
+			mod_delayed_work(system_power_efficient_wq,
+					 &kib_work, 0);
+		break;
+	}
+	return NOTIFY_OK;
+}
+
+static struct notifier_block kib_cpu_notifier = {
+	.notifier_call = kib_cpu_callback,
+};
+
+#ifdef CONFIG_DEBUG_FS
+
+static int kib_show(struct seq_file *m, void *v)
+{
+	struct irq_desc *desc;
+	unsigned int irq;
+
+	seq_printf(m, "moves %u\n", kib_moves);
+	seq_puts(m, " irq     rate cpu placed  name\n");
+	mutex_lock(&kib_lock);
+	for_each_irq_desc(irq, desc) {
+		if (!kib[irq].rate || !desc->action)
+			continue;
+		seq_printf(m, "%4u %8u %3u %-7s %s\n", irq, kib[irq].rate,
+			   cpumask_first(desc->irq_data.affinity),
+			   kib[irq].cpu >= 0 ? "moved" :
+			   kib[irq].managed ? "default" : "fixed",
+			   desc->action->name ? : "");
+	}
+	mutex_unlock(&kib_lock);
+	return 0;
+}
+
+static int kib_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kib_show, NULL);
+}
+
+static const struct file_operations kib_fops = {
+	.open		= kib_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
+static int __init kona_irq_balance_init(void)
+{
+	unsigned int irq;
+
+	kib = kcalloc(nr_irqs, sizeof(*kib), GFP_KERNEL);
+	if (!kib)
+		return -ENOMEM;
+	for (irq = 0; irq < nr_irqs; irq++) {
+		kib[irq].cpu = -1;
+		kib[irq].last = kstat_irqs(irq);
+	}
+	kib_last = jiffies;
+
+	INIT_DEFERRABLE_WORK(&kib_work, kib_balance);
+	register_hotcpu_notifier(&kib_cpu_notifier);
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("kona_irq_balance", S_IRUGO, NULL, NULL,
+			    &kib_fops);
+#endif
+	if (enabled)
+		queue_delayed_work(system_power_efficient_wq, &kib_work,
+				   msecs_to_jiffies(period_ms));
+	return 0;
+}
+late_initcall(kona_irq_balance_init);
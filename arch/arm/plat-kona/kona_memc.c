@@ -39,6 +39,7 @@
 #include <mach/rdb/brcm_rdb_chipreg.h>
 #include <mach/rdb/brcm_rdb_aphy_csr.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
 #endif
@@ -52,6 +53,13 @@
 #include <linux/reboot.h>
 #include <linux/irq.h>
 #endif
+#ifdef CONFIG_MEMC_DFS_GOV
+#include <mach/axitrace.h>
+#endif
+#define CREATE_TRACE_POINTS
+#include <trace/events/kona_memc.h>
+EXPORT_TRACEPOINT_SYMBOL_GPL(memc_dfs_change);
+
 #define MEMC0_APHY_REG(kmemc, off) ((kmemc)->memc0_aphy_base + (off))
 #define MEMC0_NS_REG(kmemc, off) ((kmemc)->memc0_ns_base + (off))
 #define CHIPREG_REG(kmemc, off) ((kmemc)->chipreg_base + (off))
@@ -66,6 +74,7 @@ enum {
 	MEMC_NODE_ADD,
 	MEMC_NODE_DEL,
 	MEMC_NODE_UPDATE,
+	MEMC_NODE_RECALC,
 };
 
 enum {
@@ -329,6 +338,37 @@ int memc_update_min_pwr_req(struct kona_memc_node *memc_node, u32 min_pwr)
 }
 EXPORT_SYMBOL(memc_update_min_pwr_req);
 
+/* DDR clock for the DDR PLL register fields given */
+static unsigned long memc_ddr_freq(struct kona_memc *kmemc, u32 ndiv_int,
+	u32 ndiv_frac, u32 pdiv, u32 mdiv)
+{
+	u32 reg_val, phy_div, frac_div;
+	u64 temp;
+
+	frac_div = 0x100000;
+	reg_val = readl(MEMC0_NS_REG(kmemc,
+				CSR_MEMC_FREQ_STATE_MAPPING_OFFSET));
+	phy_div = (reg_val &
+		CSR_MEMC_FREQ_STATE_MAPPING_DDR_FREQ_DIVIDE_VAL_MASK)  >>
+		CSR_MEMC_FREQ_STATE_MAPPING_DDR_FREQ_DIVIDE_VAL_SHIFT;
+	phy_div = 2 * (phy_div + 1);
+
+	if (ndiv_int == 0)
+		ndiv_int = 1024;
+	if (pdiv == 0)
+		pdiv = 8;
+	mdiv = 2 << mdiv;
+
+	/*fddr = ddr_pll_fref / phy_div
+	  = (fref * (ndiv_int * 2^20 + ndiv_frac)) /
+	  (pdiv * 2^20 *mdiv * phy_div) */
+	temp = ((u64)(ndiv_int * frac_div + ndiv_frac) * FREF);
+
+	do_div(temp, pdiv * mdiv * phy_div * frac_div);
+
+	return (unsigned long)temp;
+}
+
 #ifdef CONFIG_MEMC_DFS
 
 static void memc_wait_for_state_change(struct kona_memc *kmemc)
@@ -447,13 +487,27 @@ static int memc_config_ddr_pll_freq(struct kona_memc *kmemc,
 
 
 
-static u32 memc_dfs_get_max_req(struct kona_memc *kmemc)
+static void memc_dfs_account(struct kona_memc *kmemc)
+{
+	u64 now = ktime_to_ns(ktime_get());
+
+	kmemc->opp_time_ns[kmemc->active_dfs_opp] +=
+		now - kmemc->opp_since_ns;
+	kmemc->opp_since_ns = now;
+}
+
+static u32 memc_dfs_get_req(struct kona_memc *kmemc)
 {
 	if (plist_head_empty(&kmemc->dfs_list))
 		return MEMC_OPP_NORMAL;
 	return plist_last(&kmemc->dfs_list)->prio;
 }
 
+static u32 memc_dfs_get_max_req(struct kona_memc *kmemc)
+{
+	return min(memc_dfs_get_req(kmemc), kmemc->dfs_opp_lmt);
+}
+
 
 static int memc_dfs_update(struct kona_memc *kmemc,
 		struct kona_memc_node *memc_node, int action)
@@ -476,6 +530,8 @@ static int memc_dfs_update(struct kona_memc *kmemc,
 		plist_node_init(&memc_node->node, memc_node->req);
 		plist_add(&memc_node->node, &kmemc->dfs_list);
 		break;
+	case MEMC_NODE_RECALC:
+		break;
 	default:
 		BUG();
 		return -EINVAL;
@@ -503,6 +559,8 @@ static int memc_dfs_update(struct kona_memc *kmemc,
 			BUG();
 			break;
 		}
+		memc_dfs_account(kmemc);
+		trace_memc_dfs_change(kmemc->active_dfs_opp, new_val);
 		kmemc->active_dfs_opp = new_val;
 	}
 	spin_unlock(&kmemc->memc_lock);
@@ -559,6 +617,32 @@ int memc_update_dfs_req(struct kona_memc_node *memc_node, u32 opp)
 }
 EXPORT_SYMBOL(memc_update_dfs_req);
 
+/* Highest OPP the requests may get, e.g. for thermal throttling */
+int memc_set_dfs_opp_limit(u32 opp)
+{
+	if (unlikely(opp >= MEMC_OPP_MAX))
+		return -EINVAL;
+
+	if (kona_memc.dfs_opp_lmt != opp) {
+		kona_memc.dfs_opp_lmt = opp;
+		return memc_dfs_update(&kona_memc, NULL, MEMC_NODE_RECALC);
+	}
+	return 0;
+}
+EXPORT_SYMBOL(memc_set_dfs_opp_limit);
+
+/* The OPP the requests ask for, before the limit */
+u32 memc_get_dfs_req(void)
+{
+	u32 opp;
+
+	spin_lock(&kona_memc.memc_lock);
+	opp = memc_dfs_get_req(&kona_memc);
+	spin_unlock(&kona_memc.memc_lock);
+	return opp;
+}
+EXPORT_SYMBOL(memc_get_dfs_req);
+
 struct usr_dfs_mode *memc_find_usr_dfs_mode(struct kona_memc *kmemc,
 	char *client_name)
 {
@@ -693,6 +777,101 @@ static struct attribute_group kmemc_attr_group = {
 	.attrs = kmemc_attr,
 };
 
+#ifdef CONFIG_MEMC_DFS_GOV
+/*
+ * Bandwidth governor. Every gov_period_ms the DDR data beats counted by
+ * the AXI trace sources give the bandwidth in use, and the governor
+ * requests the lowest OPP that carries it under gov_target percent of
+ * its peak. It is just one more DFS request, so the other requests are
+ * floors. OPPs go up at once and down after MEMC_GOV_DOWN_SAMPLES low
+ * samples in a row. Without counters it requests turbo.
+ */
+#define MEMC_GOV_PERIOD_MS	20
+#define MEMC_GOV_TARGET		70
+#define MEMC_GOV_DOWN_SAMPLES	5
+#define MEMC_GOV_CLK_BYTES	8	/* x32 DDR, both clock edges */
+#define MEMC_ECO_FREQ		156000000
+
+static void memc_gov_work(struct work_struct *work)
+{
+	struct kona_memc *kmemc = container_of(to_delayed_work(work),
+					struct kona_memc, gov_work);
+	ktime_t now = ktime_get();
+	s64 us = ktime_us_delta(now, kmemc->gov_last);
+	u32 beats, opp;
+	u64 bw;
+
+	kmemc->gov_last = now;
+	if (us <= 0 || axitrace_get_ddr_beats(&beats)) {
+		opp = MEMC_OPP_TURBO;
+	} else {
+		/* bytes per second */
+		bw = (u64)beats * AXITRACE_BEAT_BYTES * USEC_PER_SEC;
+		do_div(bw, (u32)us);
+		kmemc->gov_bw_mbps = (u32)(bw >> 20);
+		for (opp = MEMC_OPP_ECO; opp < MEMC_OPP_TURBO; opp++)
+			if (bw * 100 <= (u64)kmemc->opp_freq[opp] *
+				MEMC_GOV_CLK_BYTES * kmemc->gov_target)
+				break;
+	}
+
+	if (opp >= kmemc->gov_node.req)
+		kmemc->gov_down = 0;
+	else if (++kmemc->gov_down < MEMC_GOV_DOWN_SAMPLES)
+		opp = kmemc->gov_node.req;
+	else
+		kmemc->gov_down = 0;
+	memc_update_dfs_req(&kmemc->gov_node, opp);
+
+	if (kmemc->gov_enable)
+		queue_delayed_work(system_freezable_wq, &kmemc->gov_work,
+				msecs_to_jiffies(kmemc->gov_period_ms));
+}
+
+static void memc_gov_start(struct kona_memc *kmemc)
+{
+	u32 beats;
+	int i;
+
+	for (i = MEMC_OPP_ECO; i < MEMC_OPP_MAX; i++) {
+		struct memc_dfs_pll_freq *pll = &kmemc->pdata->pll_freq[i];
+
+		kmemc->opp_freq[i] = i == MEMC_OPP_ECO ? MEMC_ECO_FREQ :
+			memc_ddr_freq(kmemc, pll->ndiv, pll->ndiv_frac,
+				pll->pdiv, pll->mdiv);
+	}
+
+	kmemc->gov_enable = 1;
+	kmemc->gov_down = 0;
+	kmemc->gov_last = ktime_get();
+	axitrace_get_ddr_beats(&beats);
+	queue_delayed_work(system_freezable_wq, &kmemc->gov_work,
+			msecs_to_jiffies(kmemc->gov_period_ms));
+}
+
+static void memc_gov_stop(struct kona_memc *kmemc)
+{
+	kmemc->gov_enable = 0;
+	cancel_delayed_work_sync(&kmemc->gov_work);
+	/* leave the frequency to the other requests */
+	memc_update_dfs_req(&kmemc->gov_node, MEMC_OPP_ECO);
+}
+
+static int __init memc_gov_init(void)
+{
+	struct kona_memc *kmemc = &kona_memc;
+
+	if (!kmemc->pdata)
+		return 0;
+
+	/* after the axitrace sources have been probed */
+	memc_add_dfs_req(&kmemc->gov_node, "bw_gov", MEMC_OPP_TURBO);
+	memc_gov_start(kmemc);
+	return 0;
+}
+late_initcall(memc_gov_init);
+#endif /*CONFIG_MEMC_DFS_GOV*/
+
 
 
 #endif /*CONFIG_MEMC_DFS*/
@@ -830,23 +1009,12 @@ int memc_enable_thermal_mgmt(struct kona_memc *kmemc)
 unsigned long compute_ddr_clk_freq(struct kona_memc *kmemc)
 {
 	u32 reg_val = 0;
-	u32 mdiv, ndiv_int, ndiv_frac, pdiv, phy_div, frac_div;
-	u64 temp;
-
-	frac_div = 0x100000;
-	reg_val = readl(MEMC0_NS_REG(kmemc,
-				CSR_MEMC_FREQ_STATE_MAPPING_OFFSET));
-	phy_div = (reg_val &
-		CSR_MEMC_FREQ_STATE_MAPPING_DDR_FREQ_DIVIDE_VAL_MASK)  >>
-		CSR_MEMC_FREQ_STATE_MAPPING_DDR_FREQ_DIVIDE_VAL_SHIFT;
-	phy_div = 2 * (phy_div + 1);
+	u32 mdiv, ndiv_int, ndiv_frac, pdiv;
 
 	reg_val = readl(MEMC0_APHY_REG(kmemc,
 				APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL0_OFFSET));
 	ndiv_int = (reg_val & APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL0_NDIV_INT_MASK) >>
 		APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL0_NDIV_INT_SHIFT;
-	if (ndiv_int == 0)
-		ndiv_int = 1024;
 
 	reg_val = readl(MEMC0_APHY_REG(kmemc,
 				APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL1_OFFSET));
@@ -858,23 +1026,13 @@ unsigned long compute_ddr_clk_freq(struct kona_memc *kmemc)
 				APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL0_OFFSET));
 	pdiv = (reg_val & APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL0_PDIV_MASK) >>
 		APHY_CSR_DDR_PLL_VCO_FREQ_CNTRL0_PDIV_SHIFT;
-	if (pdiv == 0)
-		pdiv = 8;
 
 	reg_val = readl(MEMC0_APHY_REG(kmemc,
 				APHY_CSR_DDR_PLL_MDIV_VALUE_OFFSET));
 	mdiv = (reg_val & APHY_CSR_DDR_PLL_MDIV_VALUE_MDIV_MASK) >>
 		APHY_CSR_DDR_PLL_MDIV_VALUE_MDIV_SHIFT;
-	mdiv = 2 << mdiv;
-
-	/*fddr = ddr_pll_fref / phy_div
-	  = (fref * (ndiv_int * 2^20 + ndiv_frac)) /
-	  (pdiv * 2^20 *mdiv * phy_div) */
-	temp = ((u64)(ndiv_int * frac_div + ndiv_frac) * FREF);
-
-	do_div(temp, pdiv * mdiv * phy_div * frac_div);
 
-	return (unsigned long)temp;
+	return memc_ddr_freq(kmemc, ndiv_int, ndiv_frac, pdiv, mdiv);
 }
 
 static int memc_init(struct kona_memc *kmemc)
@@ -933,6 +1091,15 @@ static int kona_memc_probe(struct platform_device *pdev)
 #ifdef CONFIG_MEMC_DFS
 	kona_memc.active_dfs_opp = MEMC_OPP_NORMAL;
 	kona_memc.pll_rate = MEMC_OPP_ECO; /*init to min*/
+	kona_memc.dfs_opp_lmt = MEMC_OPP_MAX - 1;
+	kona_memc.opp_since_ns = ktime_to_ns(ktime_get());
+#endif
+#ifdef CONFIG_MEMC_DFS_GOV
+	INIT_DEFERRABLE_WORK(&kona_memc.gov_work, memc_gov_work);
+	kona_memc.gov_period_ms = MEMC_GOV_PERIOD_MS;
+	kona_memc.gov_target = MEMC_GOV_TARGET;
+#endif
+#ifdef CONFIG_MEMC_DFS
 	 INIT_LIST_HEAD(&kona_memc.usr_dfs_list);
 	 plist_head_init(&kona_memc.dfs_list);
 	ret = sysfs_create_group(power_kobj, &kmemc_attr_group);
@@ -1376,6 +1543,61 @@ static const struct file_operations dfs_req_fops = {
 	.read = kona_memc_dbg_get_dfs_req_list,
 };
 
+static ssize_t kona_memc_dbg_get_dfs_residency(struct file *file,
+					   char __user *user_buf, size_t count,
+					   loff_t *ppos)
+{
+	static const char * const opp_name[MEMC_OPP_MAX] = {
+		"eco", "normal", "turbo" };
+	struct kona_memc *kmemc = (struct kona_memc *)file->private_data;
+	u64 time_ns[MEMC_OPP_MAX];
+	u32 len = 0;
+	int i;
+
+	spin_lock(&kmemc->memc_lock);
+	memc_dfs_account(kmemc);
+	memcpy(time_ns, kmemc->opp_time_ns, sizeof(time_ns));
+	spin_unlock(&kmemc->memc_lock);
+
+	for (i = 0; i < MEMC_OPP_MAX; i++)
+		len += snprintf(dbg_fs_buf + len, sizeof(dbg_fs_buf) - len,
+			"%s:%llu ms\n", opp_name[i],
+			div_u64(time_ns[i], NSEC_PER_MSEC));
+	return simple_read_from_buffer(user_buf, count, ppos, dbg_fs_buf,
+				       len);
+}
+
+static const struct file_operations dfs_residency_fops = {
+	.open = kona_memc_debugfs_open,
+	.read = kona_memc_dbg_get_dfs_residency,
+};
+
+#ifdef CONFIG_MEMC_DFS_GOV
+static int memc_dbg_get_gov_enable(void *data, u64 *val)
+{
+	struct kona_memc *kmemc = (struct kona_memc *)data;
+	*val = kmemc->gov_enable;
+	return 0;
+}
+
+static int memc_dbg_set_gov_enable(void *data, u64 val)
+{
+	struct kona_memc *kmemc = (struct kona_memc *)data;
+
+	if (!val == !kmemc->gov_enable)
+		return 0;
+	if (val)
+		memc_gov_start(kmemc);
+	else
+		memc_gov_stop(kmemc);
+	return 0;
+}
+
+DEFINE_SIMPLE_ATTRIBUTE(memc_gov_enable_ops,
+	memc_dbg_get_gov_enable,
+	memc_dbg_set_gov_enable, "%llu\n");
+#endif /*CONFIG_MEMC_DFS_GOV*/
+
 #endif /*CONFIG_MEMC_DFS*/
 
 static struct dentry *dent_kona_memc_dir;
@@ -1434,6 +1656,25 @@ static int kona_menc_init_debugfs(void)
 				 dent_kona_memc_dir, &kona_memc,
 				 &dfs_req_fops))
 		return -ENOMEM;
+	if (!debugfs_create_file("dfs_residency", S_IRUGO,
+				 dent_kona_memc_dir, &kona_memc,
+				 &dfs_residency_fops))
+		return -ENOMEM;
+#endif
+#ifdef CONFIG_MEMC_DFS_GOV
+	if (!debugfs_create_file("gov_enable", S_IRUGO | S_IWUSR,
+				 dent_kona_memc_dir, &kona_memc,
+				 &memc_gov_enable_ops))
+		return -ENOMEM;
+	if (!debugfs_create_u32("gov_period_ms", S_IRUGO | S_IWUSR,
+				dent_kona_memc_dir, &kona_memc.gov_period_ms))
+		return -ENOMEM;
+	if (!debugfs_create_u32("gov_target", S_IRUGO | S_IWUSR,
+				dent_kona_memc_dir, &kona_memc.gov_target))
+		return -ENOMEM;
+	if (!debugfs_create_u32("gov_bw_mbps", S_IRUGO,
+				dent_kona_memc_dir, &kona_memc.gov_bw_mbps))
+		return -ENOMEM;
 
 #endif
 
@@ -0,0 +1,246 @@
+/*
+ * arch/arm/plat-kona/kona_phase.c
+ *
+ * Counter snapshots at the edges of workload phases.
+ *
+ * A replay harness writes the name of a phase to debugfs kona_phase/mark
+ * when the phase starts and "end" when it is over; a new name also ends
+ * the running phase. At each edge the counters below are read together,
+ * under one timestamp:
+ *
+ *	monotonic and boot time, so the time suspended too
+ *	suspends and wakeup events
+ *	interrupts and context switches
+ *	usage and residency of each C state of each cpu
+ *	frames, janky frames, missed vsyncs and drops of the frame timeline
+ *
+ * kona_phase/report has the change of each over the last KPH_PHASES
+ * finished phases, one "<phase>.<counter> <value>" line each, times in us.
+ * Writing "reset" to mark forgets them. Counters that have a home of
+ * their own in sysfs or procfs, cpufreq time in state, vmstat, the block
+ * stats, are left to the harness in tools/testing/kona-replay.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpuidle.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/kernel_stat.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/suspend.h>
+#include <linux/uaccess.h>
+#ifdef CONFIG_KONA_FRAME_TIMELINE
+#include <linux/broadcom/frame_timeline.h>
+#endif
+
+#define KPH_PHASES		16
+#define KPH_NAME_LEN		24
+#define KPH_CSTATES		8
+
+struct kph_snap {
+	u64 mono_ns;
+	u64 boot_ns;
+	u32 suspends;
+	u32 wakeups;
+	u64 irqs;
+	u64 ctxsw;
+	u64 cs_n[NR_CPUS][KPH_CSTATES];
+	u64 cs_us[NR_CPUS][KPH_CSTATES];
+	u32 frames;
+	u32 janky;
+	u32 missed;
+	u32 dropped;
+};
+
+struct kph_phase {
+	char name[KPH_NAME_LEN];
+	struct kph_snap begin;
+	struct kph_snap end;
+};
+
+static struct kph_phase *kph;
+static unsigned int kph_head;		/* phases finished so far */
+static bool kph_running;
+static int kph_cstates;
+static DEFINE_MUTEX(kph_lock);
+
+static void kph_take(struct kph_snap *s)
+{
+	struct cpuidle_device *dev;
+	unsigned int cpu, count;
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	s->mono_ns = ktime_to_ns(ktime_get());
+	s->boot_ns = ktime_to_ns(ktime_get_boottime());
+	s->suspends = suspend_stats.success;
+	if (pm_get_wakeup_count(&count, false))
+		s->wakeups = count;
+	s->ctxsw = nr_context_switches();
+	for_each_possible_cpu(cpu) {
+		s->irqs += kstat_cpu_irqs_sum(cpu);
+		dev = per_cpu(cpuidle_devices, cpu);
+		if (!dev)
+			continue;
+		for (i = 0; i < kph_cstates; i++) {
+			s->cs_n[cpu][i] = dev->states_usage[i].usage;
+			s->cs_us[cpu][i] = dev->states_usage[i].time;
+		}
+	}
+#ifdef CONFIG_KONA_FRAME_TIMELINE
+	{
+		struct frame_tl_hdr h;
+
+		if (!frame_tl_get_hdr(&h)) {
+			s->frames = h.frames;
+			s->janky = h.janky;
+			s->missed = h.missed;
+			s->dropped = h.dropped;
+		}
+	}
+#endif
+}
+
+static void kph_stop(void)
+{
+	if (!kph_running)
+		return;
+	kph_take(&kph[kph_head % KPH_PHASES].end);
+	kph_head++;
+	kph_running = false;
+}
+
+static ssize_t kph_mark_write(struct file *file, const char __user *ubuf,
+			      size_t count, loff_t *ppos)
+{
+	char buf[KPH_NAME_LEN], *name;
+	struct kph_phase *p;
+	size_t len = min(count, sizeof(buf) - 1);
+	int i;
+
+	if (copy_from_user(buf, ubuf, len))
+		return -EFAULT;
+	buf[len] = '\0';
+	name = strim(buf);
+	for (i = 0; name[i]; i++)
+		if (!isalnum(name[i]) && name[i] != '_' && name[i] != '-')
+			return -EINVAL;
+	if (!i)
+		return -EINVAL;
+
+	mutex_lock(&kph_lock);
+	if (!strcmp(name, "reset")) {
+		kph_head = 0;
+		kph_running = false;
+	} else {
+		kph_stop();
+		if (strcmp(name, "end")) {
+			p = &kph[kph_head % KPH_PHASES];
+			strlcpy(p->name, name, sizeof(p->name));
+			kph_take(&p->begin);
+			kph_running = true;
+		}
+	}
+	mutex_unlock(&kph_lock);
+	return count;
+}
+
+static const struct file_operations kph_mark_fops = {
+	.write		= kph_mark_write,
+	.llseek		= noop_llseek,
+};
+
+/* a reset of the counters in the phase leaves what came after it */
+static inline u64 kph_delta(u64 begin, u64 end)
+{
+	return end >= begin ? end - begin : end;
+}
+
+#define KPH_PUT(m, n, key, v) \
+	seq_printf(m, "%s." key " %llu\n", n, (unsigned long long)(v))
+
+static void kph_show_phase(struct seq_file *m, struct kph_phase *p)
+{
+	struct kph_snap *b = &p->begin, *e = &p->end;
+	u64 mono = kph_delta(b->mono_ns, e->mono_ns);
+	u64 boot = kph_delta(b->boot_ns, e->boot_ns);
+	unsigned int cpu;
+	int i;
+
+	KPH_PUT(m, p->name, "time_us", div_u64(boot, NSEC_PER_USEC));
+	KPH_PUT(m, p->name, "suspended_us",
+		div_u64(boot - min(mono, boot), NSEC_PER_USEC));
+	KPH_PUT(m, p->name, "suspends", kph_delta(b->suspends, e->suspends));
+	KPH_PUT(m, p->name, "wakeup_events",
+		kph_delta(b->wakeups, e->wakeups));
+	KPH_PUT(m, p->name, "irqs", kph_delta(b->irqs, e->irqs));
+	KPH_PUT(m, p->name, "ctxsw", kph_delta(b->ctxsw, e->ctxsw));
+	for_each_possible_cpu(cpu) {
+		if (!per_cpu(cpuidle_devices, cpu))
+			continue;
+		for (i = 0; i < kph_cstates; i++) {
+			seq_printf(m, "%s.cpu%u.c%d_n %llu\n", p->name, cpu, i,
+				   kph_delta(b->cs_n[cpu][i], e->cs_n[cpu][i]));
+			seq_printf(m, "%s.cpu%u.c%d_us %llu\n", p->name, cpu,
+				   i, kph_delta(b->cs_us[cpu][i],
+						e->cs_us[cpu][i]));
+		}
+	}
+	KPH_PUT(m, p->name, "frames", kph_delta(b->frames, e->frames));
+	KPH_PUT(m, p->name, "janky", kph_delta(b->janky, e->janky));
+	KPH_PUT(m, p->name, "missed_vsyncs", kph_delta(b->missed, e->missed));
+	KPH_PUT(m, p->name, "dropped", kph_delta(b->dropped, e->dropped));
+}
+
+static int kph_report_show(struct seq_file *m, void *v)
+{
+	unsigned int n;
+
+	mutex_lock(&kph_lock);
+	n = kph_head > KPH_PHASES ? kph_head - KPH_PHASES : 0;
+	for (; n < kph_head; n++)
+		kph_show_phase(m, &kph[n % KPH_PHASES]);
+	mutex_unlock(&kph_lock);
+	return 0;
+}
+
+static int kph_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, kph_report_show, NULL);
+}
+
+static const struct file_operations kph_report_fops = {
+	.open		= kph_report_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init kona_phase_init(void)
+{
+	struct cpuidle_driver *drv = cpuidle_get_driver();
+	struct dentry *dir;
+
+	kph = kcalloc(KPH_PHASES, sizeof(*kph), GFP_KERNEL);
+	if (!kph)
+		return -ENOMEM;
+	if (drv)
+		kph_cstates = min(drv->state_count, KPH_CSTATES);
+
+	dir = debugfs_create_dir("kona_phase", NULL);
+	if (!dir)
+		return -ENOMEM;
+	debugfs_create_file("mark", S_IWUSR, dir, NULL, &kph_mark_fops);
+	debugfs_create_file("report", S_IRUGO, dir, NULL, &kph_report_fops);
+	return 0;
+}
+late_initcall(kona_phase_init);
@@ -110,7 +110,6 @@ static int __kona_pm_enter_idle(struct cpuidle_device *dev,
 				      struct cpuidle_driver *drv, int index)
 {
 	ktime_t time_start, time_end;
-	s64 diff;
 	int mach_ret = -1;
 	struct kona_idle_state *kona_state = &pm_prms.states[index];
 
@@ -120,6 +119,8 @@ static int __kona_pm_enter_idle(struct cpuidle_device *dev,
 		BUG_ON(kona_state == NULL);
 		local_irq_disable();
 		local_fiq_disable();
+		index = kona_idle_adapt_select(dev, drv, index);
+		kona_state = &pm_prms.states[index];
 		time_start = ktime_get();
 		instrument_idle_entry();
 
@@ -150,6 +151,8 @@ static int __kona_pm_enter_idle(struct cpuidle_device *dev,
 			clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT,
 				&cpu_id);
 #endif
+		time_end = ktime_get();
+		kona_idle_adapt_exit(drv, index, time_start, time_end);
 		instrument_idle_exit();
 		atomic_notifier_call_chain(&pm_prms.cstate_nh, CSTATE_EXIT,
 				&index);
@@ -258,6 +261,7 @@ __weak int kona_mach_pm_enter(suspend_state_t state)
 
 			atomic_notifier_call_chain(&pm_prms.cstate_nh,
 					CSTATE_ENTER, &pm_prms.suspend_state);
+			kona_pm_timeline_enter();
 			suspend->enter(suspend,
 				suspend->params | CTRL_PARAMS_ENTER_SUSPEND);
 			atomic_notifier_call_chain(&pm_prms.cstate_nh,
@@ -268,6 +272,7 @@ __weak int kona_mach_pm_enter(suspend_state_t state)
 			pr_info(" Timer value when resume: %llu", time2);
 			time_susp = ((time2 - time1) * 1000)/CLOCK_TICK_RATE;
 			pr_info("Approx Suspend Time: %llums", time_susp);
+			kona_pm_timeline_exit((u32)time_susp);
 
 #ifdef CONFIG_KONA_PROFILER
 			if (!err) {
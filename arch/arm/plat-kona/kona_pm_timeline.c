@@ -0,0 +1,305 @@
+/*
+ * arch/arm/plat-kona/kona_pm_timeline.c
+ *
+ * Per cycle suspend/resume timeline.
+ *
+ * For each of the last TL_CYCLES suspend cycles this keeps when each
+ * stage started, relative to PM_SUSPEND_PREPARE:
+ *
+ *	suspend  - total and slowest device suspend callbacks
+ *	enter    - kona_pm handing the cpu to the suspend state
+ *	exit     - back from the suspend state, with the sleep time and the
+ *		   pwr_mgr events that were active on wakeup
+ *	resume   - total and slowest device resume callbacks, and the
+ *		   devices left runtime suspended over the cycle
+ *	done     - PM_POST_SUSPEND
+ *
+ * plus the time spent in PMU transactions on the sequencer during the
+ * cycle, and the device whose callback failed when a cycle was aborted.
+ * Everything is timed with local_clock(), which is safe to read after
+ * timekeeping has been suspended. The ring is in debugfs as
+ * kona_pm_timeline; writing to it clears it.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/math64.h>
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/pm.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/suspend.h>
+#include <linux/uaccess.h>
+#include <asm/div64.h>
+#include <mach/pwr_mgr.h>
+#include <plat/pwr_mgr.h>
+#include <plat/kona_pm.h>
+
+#define TL_CYCLES	16
+#define TL_TOP		4
+#define TL_NAME_LEN	24
+#define TL_EVENT_WORDS	DIV_ROUND_UP(PWR_MGR_NUM_EVENTS, 32)
+
+enum {
+	TL_SUSPEND,
+	TL_RESUME,
+	TL_DIRS,
+};
+
+struct tl_dev {
+	char name[TL_NAME_LEN];
+	u32 us;
+};
+
+struct tl_cycle {
+	u64 start;		/* local_clock() at PM_SUSPEND_PREPARE */
+	u32 enter_us;		/* these relative to start */
+	u32 exit_us;
+	u32 done_us;
+	u32 sleep_ms;
+	u32 seq_us;
+	u32 cb_us[TL_DIRS];
+	u32 cb_count[TL_DIRS];
+	u32 skipped;		/* direct_complete devices */
+	struct tl_dev top[TL_DIRS][TL_TOP];
+	char failed[TL_NAME_LEN];
+	int error;
+	u32 wake_events[TL_EVENT_WORDS];
+	bool entered;
+};
+
+static struct tl_cycle tl_ring[TL_CYCLES];
+static unsigned int tl_head;	/* next slot */
+static unsigned int tl_count;
+static struct tl_cycle *tl_cur;
+static DEFINE_SPINLOCK(tl_lock);
+
+static u32 tl_us_since(u64 start, u64 now)
+{
+	u64 ns = now - start;
+
+	do_div(ns, NSEC_PER_USEC);
+	return (u32)min_t(u64, ns, U32_MAX);
+}
+
+void pm_callback_timed(struct device *dev, pm_message_t state,
+		       const char *info, u64 ns, int error)
+{
+	struct tl_cycle *c;
+	struct tl_dev *top;
+	unsigned long flags;
+	int dir, i;
+	u32 us;
+
+	do_div(ns, NSEC_PER_USEC);
+	us = (u32)min_t(u64, ns, U32_MAX);
+	dir = state.event & (PM_EVENT_RESUME | PM_EVENT_THAW |
+			     PM_EVENT_RESTORE | PM_EVENT_RECOVER) ?
+		TL_RESUME : TL_SUSPEND;
+
+	spin_lock_irqsave(&tl_lock, flags);
+	c = tl_cur;
+	if (!c)
+		goto out;
+
+	c->cb_us[dir] += us;
+	c->cb_count[dir]++;
+	if (error && !c->error) {
+		c->error = error;
+		strlcpy(c->failed, dev_name(dev), TL_NAME_LEN);
+	}
+
+	/* keep the TL_TOP slowest, sorted */
+	top = c->top[dir];
+	if (us <= top[TL_TOP - 1].us)
+		goto out;
+	for (i = TL_TOP - 1; i > 0 && top[i - 1].us < us; i--)
+		top[i] = top[i - 1];
+	top[i].us = us;
+	strlcpy(top[i].name, dev_name(dev), TL_NAME_LEN);
+out:
+	spin_unlock_irqrestore(&tl_lock, flags);
+}
+
+void pm_callback_skipped(struct device *dev, pm_message_t state)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tl_lock, flags);
+	if (tl_cur)
+		tl_cur->skipped++;
+	spin_unlock_irqrestore(&tl_lock, flags);
+}
+
+void kona_pm_timeline_enter(void)
+{
+	struct tl_cycle *c = tl_cur;
+
+	if (c)
+		c->enter_us = tl_us_since(c->start, local_clock());
+}
+
+void kona_pm_timeline_exit(u32 sleep_ms)
+{
+	struct tl_cycle *c = tl_cur;
+	int i;
+
+	if (!c)
+		return;
+	c->exit_us = tl_us_since(c->start, local_clock());
+	c->sleep_ms = sleep_ms;
+	c->entered = true;
+	for (i = 0; i < PWR_MGR_NUM_EVENTS; i++)
+		if (pwr_mgr_is_event_active(i))
+			c->wake_events[i / 32] |= 1 << (i % 32);
+}
+
+void kona_pm_timeline_seq(u64 ns)
+{
+	struct tl_cycle *c = tl_cur;
+
+	if (c) {
+		do_div(ns, NSEC_PER_USEC);
+		c->seq_us += (u32)ns;
+	}
+}
+
+static int kona_pm_timeline_notify(struct notifier_block *nb,
+				   unsigned long event, void *unused)
+{
+	unsigned long flags;
+	struct tl_cycle *c;
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		spin_lock_irqsave(&tl_lock, flags);
+		c = &tl_ring[tl_head];
+		memset(c, 0, sizeof(*c));
+		c->start = local_clock();
+		tl_head = (tl_head + 1) % TL_CYCLES;
+		if (tl_count < TL_CYCLES)
+			tl_count++;
+		tl_cur = c;
+		spin_unlock_irqrestore(&tl_lock, flags);
+		break;
+	case PM_POST_SUSPEND:
+		spin_lock_irqsave(&tl_lock, flags);
+		c = tl_cur;
+		if (c)
+			c->done_us = tl_us_since(c->start, local_clock());
+		tl_cur = NULL;
+		spin_unlock_irqrestore(&tl_lock, flags);
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block kona_pm_timeline_nb = {
+	.notifier_call = kona_pm_timeline_notify,
+};
+
+static int tl_print_cycle(char *buf, size_t size, struct tl_cycle *c)
+{
+	int n = 0, dir, i;
+	static const char * const dir_name[TL_DIRS] = { "suspend", "resume" };
+
+	n += scnprintf(buf + n, size - n,
+		"@%llu us: %s, done %u us, enter %u us, exit %u us, slept %u ms, sequencer %u us\n",
+		(unsigned long long)div_u64(c->start, NSEC_PER_USEC),
+		c->entered ? "slept" : "aborted", c->done_us, c->enter_us,
+		c->exit_us, c->sleep_ms, c->seq_us);
+	for (dir = 0; dir < TL_DIRS; dir++) {
+		n += scnprintf(buf + n, size - n, "  %s: %u callbacks, %u us:",
+			       dir_name[dir], c->cb_count[dir], c->cb_us[dir]);
+		for (i = 0; i < TL_TOP && c->top[dir][i].us; i++)
+			n += scnprintf(buf + n, size - n, " %s=%u",
+				       c->top[dir][i].name, c->top[dir][i].us);
+		if (dir == TL_RESUME && c->skipped)
+			n += scnprintf(buf + n, size - n, " (%u skipped)",
+				       c->skipped);
+		n += scnprintf(buf + n, size - n, "\n");
+	}
+	if (c->error)
+		n += scnprintf(buf + n, size - n, "  failed: %s (%d)\n",
+			       c->failed, c->error);
+	if (c->entered) {
+		n += scnprintf(buf + n, size - n, "  wake events:");
+		for (i = 0; i < PWR_MGR_NUM_EVENTS; i++)
+			if (c->wake_events[i / 32] & (1 << (i % 32)))
+				n += scnprintf(buf + n, size - n, " %d", i);
+		n += scnprintf(buf + n, size - n, "\n");
+	}
+	return n;
+}
+
+static ssize_t kona_pm_timeline_read(struct file *file, char __user *ubuf,
+				     size_t len, loff_t *ppos)
+{
+	struct tl_cycle *snap;
+	unsigned int count, head, i;
+	unsigned long flags;
+	size_t size = TL_CYCLES * 512;
+	char *buf;
+	int n = 0;
+	ssize_t ret;
+
+	snap = kmalloc(sizeof(tl_ring), GFP_KERNEL);
+	buf = kmalloc(size, GFP_KERNEL);
+	if (!snap || !buf) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	spin_lock_irqsave(&tl_lock, flags);
+	memcpy(snap, tl_ring, sizeof(tl_ring));
+	count = tl_count;
+	head = tl_head;
+	spin_unlock_irqrestore(&tl_lock, flags);
+
+	/* oldest first */
+	for (i = 0; i < count; i++)
+		n += tl_print_cycle(buf + n, size - n,
+			&snap[(head + TL_CYCLES - count + i) % TL_CYCLES]);
+
+	ret = simple_read_from_buffer(ubuf, len, ppos, buf, n);
+out:
+	kfree(buf);
+	kfree(snap);
+	return ret;
+}
+
+static ssize_t kona_pm_timeline_write(struct file *file,
+				      const char __user *ubuf, size_t len,
+				      loff_t *ppos)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tl_lock, flags);
+	if (!tl_cur) {
+		tl_count = 0;
+		tl_head = 0;
+	}
+	spin_unlock_irqrestore(&tl_lock, flags);
+	return len;
+}
+
+static const struct file_operations kona_pm_timeline_fops = {
+	.read = kona_pm_timeline_read,
+	.write = kona_pm_timeline_write,
+};
+
+static int __init kona_pm_timeline_init(void)
+{
+	register_pm_notifier(&kona_pm_timeline_nb);
+	if (!debugfs_create_file("kona_pm_timeline", S_IRUSR | S_IWUSR, NULL,
+				 NULL, &kona_pm_timeline_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(kona_pm_timeline_init);
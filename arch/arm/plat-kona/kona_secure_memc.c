@@ -2238,6 +2238,7 @@ int do_grant_region_access(u32 *memc_handle, enum memc_masters to_who)
 	unsigned int group_mask = 0;
 	unsigned int addr = pdata->kona_s_memc_base;
 	unsigned int offset  = REGION_CTRL_OFFSET;
+	unsigned long flags;
 
 	if (ALL == to_who) {
 		group_mask = ALLOW_ALL_GID_MASK;
@@ -2266,6 +2267,7 @@ int do_grant_region_access(u32 *memc_handle, enum memc_masters to_who)
 
 write_memc_regions:
 
+	spin_lock_irqsave(&memc_dev->lock, flags);
 	/* Disable gid checking */
 	writel(0x00, pdata->kona_s_memc_base);
 
@@ -2278,6 +2280,7 @@ write_memc_regions:
 			writel(val, addr);
 		}
 	}
+	spin_unlock_irqrestore(&memc_dev->lock, flags);
 	return 0;
 
 wrong_parameter:
@@ -2301,6 +2304,7 @@ int do_revoke_region_access(u32 *memc_handle, enum memc_masters to_who)
 	struct kona_memc_port **port = memc_dev->port;
 	unsigned int addr = pdata->kona_s_memc_base;
 	unsigned int offset  = REGION_CTRL_OFFSET;
+	unsigned long flags;
 
 	if (FABRIC == to_who)
 		port_num = get_default_possible_port(MASTER_FABRIC);
@@ -2316,6 +2320,7 @@ int do_revoke_region_access(u32 *memc_handle, enum memc_masters to_who)
 	if (port_num < 0)
 		goto wrong_parameter;
 
+	spin_lock_irqsave(&memc_dev->lock, flags);
 	for (group_num = 0; group_num < pdata->num_of_groups;
 		group_num++) {
 		if (memc_bitmaps->port_map[port_num][group_num]) {
@@ -2340,6 +2345,7 @@ int do_revoke_region_access(u32 *memc_handle, enum memc_masters to_who)
 
 	/* enable gid checking. */
 	writel(0x10, pdata->kona_s_memc_base);
+	spin_unlock_irqrestore(&memc_dev->lock, flags);
 	return 0;
 
 wrong_parameter:
@@ -2348,6 +2354,215 @@ wrong_parameter:
 }
 EXPORT_SYMBOL(do_revoke_region_access);
 
+int kona_memc_txn_begin(u32 *memc_handle, struct kona_memc_txn *txn)
+{
+	struct kona_secure_memc *memc_dev =
+		container_of(memc_handle, struct kona_secure_memc, handle);
+	struct kona_memc_regions **region = memc_dev->region;
+	unsigned long flags;
+	u32 i;
+
+	memset(txn, 0, sizeof(*txn));
+	txn->memc_dev = memc_dev;
+	spin_lock_irqsave(&memc_dev->lock, flags);
+	txn->gen = memc_dev->region_gen;
+	txn->region_bitmap = memc_dev->memc_config_status.region_bitmap;
+	for (i = 0; i < memc_dev->pdata->num_of_regions; i++) {
+		txn->region[i].start_address = region[i]->start_address;
+		txn->region[i].end_address = region[i]->end_address;
+		txn->region[i].mem_type = region[i]->mem_type;
+		txn->region[i].group_mask = region[i]->group_mask;
+	}
+	spin_unlock_irqrestore(&memc_dev->lock, flags);
+	return 0;
+}
+EXPORT_SYMBOL(kona_memc_txn_begin);
+
+/* the staged region holding addr, or -1 */
+int kona_memc_txn_find(struct kona_memc_txn *txn, u32 addr)
+{
+	u32 i;
+
+	for (i = 0; i < txn->memc_dev->pdata->num_of_regions; i++)
+		if ((txn->region_bitmap & (0x1 << i)) &&
+			txn->region[i].start_address <= addr &&
+			addr <= txn->region[i].end_address)
+			return i;
+	return -1;
+}
+EXPORT_SYMBOL(kona_memc_txn_find);
+
+int kona_memc_txn_set(struct kona_memc_txn *txn, u32 region_num,
+		      const struct kona_memc_region_cfg *cfg)
+{
+	if (region_num >= txn->memc_dev->pdata->num_of_regions)
+		return -EINVAL;
+	txn->region[region_num] = *cfg;
+	txn->region_bitmap |= (0x1 << region_num);
+	return 0;
+}
+EXPORT_SYMBOL(kona_memc_txn_set);
+
+void kona_memc_txn_clear(struct kona_memc_txn *txn, u32 region_num)
+{
+	txn->region_bitmap &= ~(0x1 << region_num);
+}
+EXPORT_SYMBOL(kona_memc_txn_clear);
+
+/* the same checks as the sysfs stores and activate_memc, map wide */
+static int memc_txn_validate(struct kona_memc_txn *txn)
+{
+	struct kona_secure_memc_pdata *pdata = txn->memc_dev->pdata;
+	struct kona_memc_region_cfg *r, *o;
+	u32 i, j;
+
+	for (i = 0; i < pdata->num_of_regions; i++) {
+		if (!(txn->region_bitmap & (0x1 << i)))
+			continue;
+		r = &txn->region[i];
+		if (r->start_address < pdata->ddr_start ||
+			r->end_address > pdata->ddr_end ||
+			r->end_address <= r->start_address ||
+			(r->end_address & 0xFFF) != 0xFFF ||
+			r->mem_type > MEM_TYPE_USR || r->group_mask > 0xFF)
+			return -EINVAL;
+		for (j = i + 1; j < pdata->num_of_regions; j++) {
+			if (!(txn->region_bitmap & (0x1 << j)))
+				continue;
+			o = &txn->region[j];
+			if (r->start_address <= o->end_address &&
+				o->start_address <= r->end_address)
+				return -EINVAL;
+		}
+	}
+	return 0;
+}
+
+/* Write the changed regions. They are all disabled before any of them
+ * is reprogrammed, and enabled together at the end, so no access sees
+ * a half written region or two overlapping ones. */
+static void memc_txn_write(struct kona_secure_memc *memc_dev,
+			   struct kona_memc_txn *txn, u32 changed, u32 old_map)
+{
+	struct kona_secure_memc_pdata *pdata = memc_dev->pdata;
+	struct kona_memc_region_cfg *r;
+	u32 i, addr, ctrl;
+
+	for (i = 0; i < pdata->num_of_regions; i++) {
+		addr = pdata->kona_s_memc_base + REGION0_CTL_OFFSET +
+			(REGION0_CTL_OFFSET * i);
+		if ((changed & old_map) & (0x1 << i))
+			writel(readl(addr) & ~REGION_EN_MASK, addr);
+	}
+
+	for (i = 0; i < pdata->num_of_regions; i++) {
+		if (!((changed & txn->region_bitmap) & (0x1 << i)))
+			continue;
+		r = &txn->region[i];
+		addr = pdata->kona_s_memc_base + REGION0_CTL_OFFSET +
+			(REGION0_CTL_OFFSET * i);
+		writel(r->start_address, addr + REGION0_START_OFFSET);
+		writel(r->end_address, addr + REGION0_END_OFFSET);
+		ctrl = readl(addr) & ~(RGN_GID_SANDBOX_EN_MASK |
+			REGION_MEM_TYPE_MASK | REGION_EN_MASK);
+		ctrl |= (r->mem_type << REGION_MEM_TYPE_SHIFT) |
+			(r->group_mask << RGN_GID_SANDBOX_EN_SHIFT);
+		writel(ctrl, addr);
+	}
+
+	for (i = 0; i < pdata->num_of_regions; i++) {
+		addr = pdata->kona_s_memc_base + REGION0_CTL_OFFSET +
+			(REGION0_CTL_OFFSET * i);
+		if ((changed & txn->region_bitmap) & (0x1 << i))
+			writel(readl(addr) | REGION_EN_MASK, addr);
+	}
+}
+
+/* redo the region_access of enable_regions() for the changed regions */
+static void memc_txn_update_access(struct kona_secure_memc *memc_dev,
+				   u32 changed)
+{
+	struct kona_secure_memc_pdata *pdata = memc_dev->pdata;
+	struct kona_memc_bitmaps *memc_bitmaps = &memc_dev->memc_config_status;
+	struct kona_memc_regions **region = memc_dev->region;
+	u32 port_num, group_num, region_num, *access;
+
+	for (port_num = 0; port_num < pdata->num_of_memc_ports; port_num++) {
+		for (group_num = 0; group_num < pdata->num_of_groups;
+			group_num++) {
+			if (!memc_bitmaps->port_map[port_num][group_num])
+				continue;
+			access = &memc_dev->port[port_num]->group[group_num]
+				->access.region_access[port_num];
+			*access &= ~changed;
+			for (region_num = 0; region_num < pdata->num_of_regions;
+				region_num++)
+				if ((changed & memc_bitmaps->region_bitmap &
+					(0x1 << region_num)) &&
+					(region[region_num]->group_mask &
+					(0x1 << group_num)))
+					*access |= (0x1 << region_num);
+		}
+	}
+}
+
+int kona_memc_txn_commit(struct kona_memc_txn *txn)
+{
+	struct kona_secure_memc *memc_dev = txn->memc_dev;
+	struct kona_memc_regions **region = memc_dev->region;
+	struct kona_memc_bitmaps *memc_bitmaps = &memc_dev->memc_config_status;
+	struct kona_memc_region_cfg *r;
+	u32 i, changed = 0, old_map;
+	unsigned long flags;
+	char log_buf[48];
+	int ret;
+
+	ret = memc_txn_validate(txn);
+	if (ret)
+		return ret;
+
+	spin_lock_irqsave(&memc_dev->lock, flags);
+	if (txn->gen != memc_dev->region_gen) {
+		spin_unlock_irqrestore(&memc_dev->lock, flags);
+		return -EAGAIN;
+	}
+
+	old_map = memc_bitmaps->region_bitmap;
+	changed = old_map ^ txn->region_bitmap;
+	for (i = 0; i < memc_dev->pdata->num_of_regions; i++) {
+		r = &txn->region[i];
+		if ((txn->region_bitmap & (0x1 << i)) &&
+			(r->start_address != region[i]->start_address ||
+			r->end_address != region[i]->end_address ||
+			r->mem_type != region[i]->mem_type ||
+			r->group_mask != region[i]->group_mask))
+			changed |= (0x1 << i);
+	}
+
+	/* before activation the map is written by activate_memc() */
+	if (MEMC_IS_ACTIVATED == memc_bitmaps->is_memc_activated)
+		memc_txn_write(memc_dev, txn, changed, old_map);
+
+	for (i = 0; i < memc_dev->pdata->num_of_regions; i++) {
+		if (!(changed & (0x1 << i)))
+			continue;
+		region[i]->start_address = txn->region[i].start_address;
+		region[i]->end_address = txn->region[i].end_address;
+		region[i]->mem_type = txn->region[i].mem_type;
+		region[i]->group_mask = txn->region[i].group_mask;
+	}
+	memc_bitmaps->region_bitmap = txn->region_bitmap;
+	memc_txn_update_access(memc_dev, changed);
+	memc_dev->region_gen++;
+	spin_unlock_irqrestore(&memc_dev->lock, flags);
+
+	add_time_stamp(memc_dev->logging);
+	sprintf(log_buf, "region map committed, changed 0x%02x\n", changed);
+	log_this(memc_dev->logging, log_buf);
+	return 0;
+}
+EXPORT_SYMBOL(kona_memc_txn_commit);
+
 
 
 
@@ -2408,6 +2623,7 @@ static int kona_secure_memc_probe(struct platform_device *pdev)
 	memc_dev->dev = &pdev->dev;
 	memc_dev->memc_state = NOT_CONFIGURED;
 	memc_dev->init_static_config_memc = initialize_memc;
+	spin_lock_init(&memc_dev->lock);
 
 	memc_handle = &memc_dev->handle;
 	/* some magic number. */
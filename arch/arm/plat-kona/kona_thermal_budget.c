@@ -0,0 +1,443 @@
+/*
+ * arch/arm/plat-kona/kona_thermal_budget.c
+ *
+ * Thermal power budget shared by the cpu, MM and DDR clocks.
+ *
+ * Above switch_on_temp the tmon temperature is sampled every period_ms
+ * and a PI controller turns its distance to target_temp into a power
+ * budget around sustainable_mw: k_po (below target) or k_pu (above)
+ * mW per degree, plus k_i mW per accumulated degree. The budget is
+ * split between the three domains in proportion to the power they ask
+ * for times their weight, where the request is
+ *
+ *	cpu - the busy fraction of the online cpus at the current
+ *	      frequency, with the cpu_mw power of each cpufreq table entry
+ *	mm  - the mm_mw power of the OPP mm_dvfs requests, 0 while the MM
+ *	      island is off
+ *	ddr - the ddr_mw power of the OPP the memc DFS requests ask for
+ *
+ * so a long video call takes the headroom from a mostly idle cpu rather
+ * than sending it to the lowest OPP. A domain is not given more than it
+ * could use at its top OPP, what is left goes to the others. Each grant
+ * becomes the fastest OPP that fits in it: a cpufreq max limit, the MM
+ * PI DFS max limit and the memc DFS limit. Below switch_on_temp, or with
+ * enable cleared, the limits are lifted and the sampling slows down to
+ * idle_period_ms.
+ *
+ * The tmon step table of the cpufreq driver and the LPDDR and PMU die
+ * temperature shutdowns still apply on top, set above target_temp they
+ * only act if the budget cannot hold it.
+ *
+ * cpu_mw is per core and in cpufreq table order; left unset it is
+ * estimated as cpu_max_mw * (f / fmax)^2. debugfs kona_thermal_budget
+ * shows the last sample and the time each domain spent throttled,
+ * writing to it clears the counters.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/jiffies.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+#include <linux/broadcom/kona_tmon.h>
+#include <plat/kona_cpufreq_drv.h>
+#include <plat/kona_memc.h>
+#include <plat/pi_mgr.h>
+#include <asm/div64.h>
+
+#define TB_CPU_OPPS		8
+/* busy fractions are kept in 1/TB_LOAD_ONE of a cpu */
+#define TB_LOAD_ONE		1024
+
+enum {
+	TB_CPU,
+	TB_MM,
+	TB_DDR,
+	TB_ACTORS,
+};
+
+static const char * const tb_names[TB_ACTORS] = {
+	[TB_CPU]	= "cpu",
+	[TB_MM]		= "mm",
+	[TB_DDR]	= "ddr",
+};
+
+struct tb_actor {
+	u32 req_mw;
+	u32 max_mw;
+	u32 granted_mw;
+	int top;		/* fastest OPP or table index */
+	int lmt;		/* limit in force, top when none */
+	u64 throttled_ms;
+};
+
+static bool tb_enable = true;
+module_param_named(enable, tb_enable, bool, S_IRUGO | S_IWUSR);
+static int target_temp = 85;
+module_param(target_temp, int, S_IRUGO | S_IWUSR);
+static int switch_on_temp = 75;
+module_param(switch_on_temp, int, S_IRUGO | S_IWUSR);
+static unsigned int sustainable_mw = 1500;
+module_param(sustainable_mw, uint, S_IRUGO | S_IWUSR);
+static unsigned int k_po = 150;
+module_param(k_po, uint, S_IRUGO | S_IWUSR);
+static unsigned int k_pu = 300;
+module_param(k_pu, uint, S_IRUGO | S_IWUSR);
+static unsigned int k_i = 10;
+module_param(k_i, uint, S_IRUGO | S_IWUSR);
+static unsigned int period_ms = 100;
+module_param(period_ms, uint, S_IRUGO | S_IWUSR);
+static unsigned int idle_period_ms = 1000;
+module_param(idle_period_ms, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int tb_weight[TB_ACTORS] = { 256, 256, 256 };
+module_param_array_named(weight, tb_weight, uint, NULL, S_IRUGO | S_IWUSR);
+static unsigned int cpu_max_mw = 300;
+module_param(cpu_max_mw, uint, S_IRUGO | S_IWUSR);
+static unsigned int tb_cpu_mw[TB_CPU_OPPS];
+static int tb_cpu_mw_cnt;
+module_param_array_named(cpu_mw, tb_cpu_mw, uint, &tb_cpu_mw_cnt,
+			 S_IRUGO | S_IWUSR);
+static unsigned int tb_mm_mw[PI_OPP_MAX] = { 80, 150, 250, 350 };
+module_param_array_named(mm_mw, tb_mm_mw, uint, NULL, S_IRUGO | S_IWUSR);
+static unsigned int tb_ddr_mw[MEMC_OPP_MAX] = { 40, 80, 120 };
+module_param_array_named(ddr_mw, tb_ddr_mw, uint, NULL, S_IRUGO | S_IWUSR);
+
+static DEFINE_MUTEX(tb_lock);
+static struct delayed_work tb_work;
+static struct cpufreq_lmt_node tb_cpu_node;
+static bool tb_cpu_node_added;
+
+/* under tb_lock */
+static struct tb_actor tb_actors[TB_ACTORS];
+static struct cpufreq_frequency_table *tb_freqs;
+static int tb_nr_freqs;
+static u32 tb_cpu_load;
+static u64 tb_idle_us[NR_CPUS], tb_wall_us[NR_CPUS];
+static long tb_temp;
+static int tb_integral;
+static s32 tb_budget_mw;
+static bool tb_active;
+static unsigned long tb_last;
+
+/* cpufreq tables are sorted here, from the slowest entry */
+static void tb_cpu_init(void)
+{
+	struct cpufreq_frequency_table *t = cpufreq_frequency_get_table(0);
+	u64 fmax;
+	int i;
+
+	if (!t)
+		return;
+	for (i = 0; t[i].frequency != CPUFREQ_TABLE_END; i++)
+		;
+	tb_nr_freqs = min(i, TB_CPU_OPPS);
+	if (!tb_nr_freqs)
+		return;
+	tb_freqs = t;
+
+	fmax = t[tb_nr_freqs - 1].frequency;
+	if (!tb_cpu_mw_cnt)
+		for (i = 0; i < tb_nr_freqs; i++)
+			tb_cpu_mw[i] = div64_u64((u64)cpu_max_mw *
+					t[i].frequency * t[i].frequency,
+					fmax * fmax);
+	tb_actors[TB_CPU].top = tb_actors[TB_CPU].lmt = tb_nr_freqs - 1;
+}
+
+/* sum of the busy fractions of the online cpus since the last sample */
+static u32 tb_cpu_busy(void)
+{
+	u64 idle, wall, d_idle, d_wall;
+	u32 load = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		d_idle = idle - tb_idle_us[cpu];
+		d_wall = wall - tb_wall_us[cpu];
+		tb_idle_us[cpu] = idle;
+		tb_wall_us[cpu] = wall;
+		/* no NO_HZ idle accounting, or cpu just back online */
+		if (idle == -1ULL || !d_wall || d_idle > d_wall) {
+			load += TB_LOAD_ONE;
+			continue;
+		}
+		load += div64_u64((d_wall - d_idle) * TB_LOAD_ONE, d_wall);
+	}
+	return load;
+}
+
+static u32 tb_cpu_power(int i)
+{
+	return ((u64)tb_cpu_mw[i] * tb_cpu_load) / TB_LOAD_ONE;
+}
+
+static int tb_cpu_index(unsigned int freq)
+{
+	int i;
+
+	for (i = 0; i < tb_nr_freqs - 1; i++)
+		if (tb_freqs[i].frequency >= freq)
+			break;
+	return i;
+}
+
+static void tb_requests(void)
+{
+	struct tb_actor *a;
+	int opp;
+
+	a = &tb_actors[TB_CPU];
+	tb_cpu_load = tb_cpu_busy();
+	a->req_mw = tb_cpu_power(tb_cpu_index(cpufreq_quick_get(0)));
+	a->max_mw = tb_cpu_power(a->top);
+
+	a = &tb_actors[TB_MM];
+	if (pi_get_use_count(PI_MGR_PI_ID_MM) > 0) {
+		opp = min_t(int, pi_get_dfs_req(PI_MGR_PI_ID_MM), a->top);
+		a->req_mw = tb_mm_mw[opp];
+		a->max_mw = tb_mm_mw[a->top];
+	} else {
+		a->req_mw = a->max_mw = 0;
+	}
+
+	a = &tb_actors[TB_DDR];
+	a->req_mw = tb_ddr_mw[min_t(int, memc_get_dfs_req(), a->top)];
+	a->max_mw = tb_ddr_mw[a->top];
+}
+
+/*
+ * Shares of the budget in proportion to the weighted requests, each
+ * capped at what the domain can use; the excess of the capped ones goes
+ * to the others in proportion to their remaining headroom.
+ */
+static void tb_divide(u32 budget)
+{
+	struct tb_actor *a;
+	u64 total = 0, share;
+	u32 extra = 0, room = 0;
+	int i;
+
+	for (i = 0; i < TB_ACTORS; i++)
+		total += (u64)tb_actors[i].req_mw * tb_weight[i];
+
+	for (i = 0; i < TB_ACTORS; i++) {
+		a = &tb_actors[i];
+		share = (u64)a->req_mw * tb_weight[i];
+		a->granted_mw = total ? div64_u64(share * budget, total) : 0;
+		if (a->granted_mw > a->max_mw) {
+			extra += a->granted_mw - a->max_mw;
+			a->granted_mw = a->max_mw;
+		}
+		room += a->max_mw - a->granted_mw;
+	}
+
+	for (i = 0; i < TB_ACTORS && extra && room; i++) {
+		a = &tb_actors[i];
+		a->granted_mw += div_u64((u64)extra *
+				(a->max_mw - a->granted_mw), room);
+	}
+}
+
+/* fastest entry of a power table within the grant, at least the first */
+static int tb_fit(struct tb_actor *a, u32 (*power)(int))
+{
+	int i;
+
+	for (i = a->top; i > 0; i--)
+		if (power(i) <= a->granted_mw)
+			break;
+	return i;
+}
+
+static u32 tb_mm_power(int opp)
+{
+	return tb_mm_mw[opp];
+}
+
+static u32 tb_ddr_power(int opp)
+{
+	return tb_ddr_mw[opp];
+}
+
+static void tb_apply(int id, int lmt, unsigned int ms)
+{
+	struct tb_actor *a = &tb_actors[id];
+
+	if (lmt < a->top)
+		a->throttled_ms += ms;
+	if (lmt == a->lmt)
+		return;
+	a->lmt = lmt;
+
+	switch (id) {
+	case TB_CPU:
+		if (tb_cpu_node_added)
+			cpufreq_update_lmt_req(&tb_cpu_node, lmt == a->top ?
+					DEFAULT_LIMIT :
+					(int)tb_freqs[lmt].frequency);
+		break;
+	case TB_MM:
+		pi_mgr_set_dfs_opp_limit(PI_MGR_PI_ID_MM, -1, lmt);
+		break;
+	case TB_DDR:
+		memc_set_dfs_opp_limit(lmt);
+		break;
+	}
+}
+
+static void tb_release(void)
+{
+	int i;
+
+	tb_integral = 0;
+	tb_budget_mw = 0;
+	for (i = 0; i < TB_ACTORS; i++) {
+		tb_actors[i].granted_mw = 0;
+		tb_apply(i, tb_actors[i].top, 0);
+	}
+}
+
+/* budget in mW from the PI controller, integrating only while hot */
+static s32 tb_control(long temp)
+{
+	int err = target_temp - temp;
+	s64 p, i;
+
+	p = err > 0 ? (s64)k_po * err : (s64)k_pu * err;
+	if (err < 0 || tb_integral < 0) {
+		tb_integral += err;
+		if (k_i)
+			tb_integral = clamp_t(int, tb_integral,
+					-(int)(sustainable_mw / k_i), 0);
+	}
+	i = (s64)k_i * tb_integral;
+	return clamp_t(s64, (s64)sustainable_mw + p + i, 0, INT_MAX);
+}
+
+static void tb_work_fn(struct work_struct *work)
+{
+	unsigned int ms = jiffies_to_msecs(jiffies - tb_last);
+	unsigned int next = idle_period_ms;
+
+	mutex_lock(&tb_lock);
+	tb_last = jiffies;
+	if (!tb_freqs)
+		tb_cpu_init();
+	if (!tb_cpu_node_added && tb_freqs)
+		tb_cpu_node_added = !cpufreq_add_lmt_req(&tb_cpu_node,
+				"thermal_budget", DEFAULT_LIMIT, MAX_LIMIT);
+
+	tb_temp = tmon_get_current_temp(CELCIUS, true);
+	tb_active = tb_enable && tb_freqs && tb_temp >= switch_on_temp;
+	if (!tb_active) {
+		tb_release();
+		goto out;
+	}
+	next = period_ms;
+
+	tb_requests();
+	tb_budget_mw = tb_control(tb_temp);
+	tb_divide(tb_budget_mw);
+
+	tb_apply(TB_CPU, tb_fit(&tb_actors[TB_CPU], tb_cpu_power), ms);
+	/* an island that is off keeps its limit for when it comes back */
+	if (tb_actors[TB_MM].max_mw)
+		tb_apply(TB_MM, tb_fit(&tb_actors[TB_MM], tb_mm_power), ms);
+	tb_apply(TB_DDR, tb_fit(&tb_actors[TB_DDR], tb_ddr_power), ms);
+out:
+	mutex_unlock(&tb_lock);
+	queue_delayed_work(system_freezable_wq, &tb_work,
+			   msecs_to_jiffies(next));
+}
+
+#ifdef CONFIG_DEBUG_FS
+
+static int tb_show(struct seq_file *m, void *v)
+{
+	struct tb_actor *a;
+	int i;
+
+	mutex_lock(&tb_lock);
+	seq_printf(m, "temp %ld target %d %s\n", tb_temp, target_temp,
+		   tb_active ? "active" : "idle");
+	seq_printf(m, "budget_mw %d integral %d cpu_load %u%%\n",
+		   tb_budget_mw, tb_integral,
+		   tb_cpu_load * 100 / TB_LOAD_ONE);
+	seq_puts(m, "\nactor req_mw max_mw granted_mw lmt top throttled_ms\n");
+	for (i = 0; i < TB_ACTORS; i++) {
+		a = &tb_actors[i];
+		seq_printf(m, "%-5s %6u %6u %10u %3d %3d %12llu\n",
+			   tb_names[i], a->req_mw, a->max_mw, a->granted_mw,
+			   a->lmt, a->top, a->throttled_ms);
+	}
+	if (tb_freqs) {
+		seq_puts(m, "\ncpu_khz cpu_mw\n");
+		for (i = 0; i < tb_nr_freqs; i++)
+			seq_printf(m, "%7u %6u\n", tb_freqs[i].frequency,
+				   tb_cpu_mw[i]);
+	}
+	mutex_unlock(&tb_lock);
+	return 0;
+}
+
+static int tb_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, tb_show, NULL);
+}
+
+static ssize_t tb_write(struct file *file, const char __user *buf,
+			size_t count, loff_t *ppos)
+{
+	int i;
+
+	mutex_lock(&tb_lock);
+	for (i = 0; i < TB_ACTORS; i++)
+		tb_actors[i].throttled_ms = 0;
+	mutex_unlock(&tb_lock);
+	return count;
+}
+
+static const struct file_operations tb_fops = {
+	.owner		= THIS_MODULE,
+	.open		= tb_open,
+	.read		= seq_read,
+	.write		= tb_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
+static int __init kona_thermal_budget_init(void)
+{
+	struct tb_actor *a;
+
+	a = &tb_actors[TB_MM];
+	a->top = min_t(int, pi_get_dfs_lmt(PI_MGR_PI_ID_MM, true),
+		       PI_OPP_MAX - 1);
+	a->lmt = a->top;
+	a = &tb_actors[TB_DDR];
+	a->top = a->lmt = MEMC_OPP_MAX - 1;
+
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("kona_thermal_budget", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &tb_fops);
+#endif
+	tb_last = jiffies;
+	INIT_DEFERRABLE_WORK(&tb_work, tb_work_fn);
+	queue_delayed_work(system_freezable_wq, &tb_work,
+			   msecs_to_jiffies(idle_period_ms));
+	return 0;
+}
+late_initcall(kona_thermal_budget_init);
@@ -819,6 +819,18 @@ unsigned int notrace kona_timer_get_counter(struct kona_timer *kt)
 }
 EXPORT_SYMBOL(kona_timer_get_counter);
 
+/*
+ * kona_timer_read_counter - Read the counter register of the timer, for
+ * the clocksource and sched_clock read paths
+ *
+ * The reads in __get_counter are restarted when they are far apart, so
+ * this does not need to disable interrupts around them.
+ */
+unsigned int notrace kona_timer_read_counter(struct kona_timer *kt)
+{
+	return __get_counter(kt->ktm->reg_base);
+}
+
 /*
  * kona_timer_disable_and_clear - Disable the timer and clear the
  * interrupt
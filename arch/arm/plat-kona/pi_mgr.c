@@ -21,6 +21,7 @@
 #include <linux/clk.h>
 #include <linux/clkdev.h>
 #include <linux/ctype.h>
+#include <linux/workqueue.h>
 
 #include <plat/kona_pm_dbg.h>
 #include <plat/clock.h>
@@ -28,6 +29,9 @@
 #include <plat/pwr_mgr.h>
 #include <asm/cputime.h>
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/pi_mgr.h>
+
 #ifdef CONFIG_DEBUG_FS
 #include <linux/uaccess.h>
 #include <linux/debugfs.h>
@@ -102,6 +106,14 @@ struct pi_mgr_dfs_object {
 	u32 default_opp;
 	struct atomic_notifier_head notifiers;
 	struct plist_head requests;
+	/* listeners told about the settled OPP from a work item; the batch
+	 * fields are under pi->lock */
+	struct blocking_notifier_head deferred_notifiers;
+	struct work_struct deferred_work;
+	bool deferred_pending;
+	u32 deferred_old_opp;
+	u32 deferred_new_opp;
+	u32 deferred_batched;
 };
 
 struct pi_mgr_qos_object {
@@ -127,24 +139,70 @@ static int pi_change_notify(int pi_id, u32 type, u32 old_val,
 			    u32 new_val, u32 state)
 {
 	struct pi_notify_param param = { pi_id, old_val, new_val };
+	struct atomic_notifier_head *nh;
 
 	switch (type) {
 	case PI_NOTIFY_DFS_CHANGE:
-		return atomic_notifier_call_chain(&pi_mgr.dfs[pi_id].notifiers,
-						  state, &param);
-
+		nh = &pi_mgr.dfs[pi_id].notifiers;
+		break;
 	case PI_NOTIFY_QOS_CHANGE:
-		return atomic_notifier_call_chain(&pi_mgr.qos[pi_id].notifiers,
-						  state, &param);
-
+		nh = &pi_mgr.qos[pi_id].notifiers;
+		break;
 	case PI_NOTIFY_POLICY_CHANGE:
-		return atomic_notifier_call_chain(&pi_mgr.
-						  pol_chg_notifier[pi_id],
-						  state, &param);
+		nh = &pi_mgr.pol_chg_notifier[pi_id];
+		break;
 	default:
 		BUG();
+		return -EINVAL;
 	}
-	return -EINVAL;
+	/* most chains are empty, skip the rcu walk for them */
+	if (!rcu_access_pointer(nh->head))
+		return 0;
+	return atomic_notifier_call_chain(nh, state, &param);
+}
+
+static void pi_dfs_deferred_notify(struct work_struct *work)
+{
+	struct pi_mgr_dfs_object *dfs = container_of(work,
+			struct pi_mgr_dfs_object, deferred_work);
+	struct pi *pi = pi_mgr.pi_list[dfs->pi_id];
+	struct pi_notify_param param = { dfs->pi_id };
+	unsigned long flgs;
+	u32 batched;
+	u64 t;
+
+	spin_lock_irqsave(&pi->lock, flgs);
+	param.old_value = dfs->deferred_old_opp;
+	param.new_value = dfs->deferred_new_opp;
+	batched = dfs->deferred_batched;
+	dfs->deferred_pending = false;
+	dfs->deferred_batched = 0;
+	spin_unlock_irqrestore(&pi->lock, flgs);
+
+	/* the OPP went back to where it was: nothing to tell */
+	if (param.old_value == param.new_value)
+		return;
+
+	t = local_clock();
+	blocking_notifier_call_chain(&dfs->deferred_notifiers,
+				     PI_POSTCHANGE, &param);
+	trace_pi_dfs_deferred_notify(dfs->pi_id, param.old_value,
+			param.new_value, batched, local_clock() - t);
+}
+
+/* Called with pi->lock held, after a DFS transition */
+static void pi_dfs_defer_notify(struct pi_mgr_dfs_object *dfs,
+				u32 old_opp, u32 new_opp)
+{
+	if (!rcu_access_pointer(dfs->deferred_notifiers.head))
+		return;
+	if (!dfs->deferred_pending) {
+		dfs->deferred_pending = true;
+		dfs->deferred_old_opp = old_opp;
+		schedule_work(&dfs->deferred_work);
+	}
+	dfs->deferred_new_opp = new_opp;
+	dfs->deferred_batched++;
 }
 
 static int pi_save_state(struct pi *pi, int save)
@@ -766,6 +824,8 @@ static int pi_def_init(struct pi *pi)
 		       pi->opp_inx_act);
 		dfs = &pi_mgr.dfs[pi->id];
 		ATOMIC_INIT_NOTIFIER_HEAD(&dfs->notifiers);
+		BLOCKING_INIT_NOTIFIER_HEAD(&dfs->deferred_notifiers);
+		INIT_WORK(&dfs->deferred_work, pi_dfs_deferred_notify);
 		plist_head_init(&dfs->requests);
 		dfs->pi_id = pi->id;
 		dfs->default_opp = 0;
@@ -942,6 +1002,7 @@ static u32 pi_mgr_dfs_update(struct pi_mgr_dfs_node *node,
 	struct pi *pi = pi_mgr.pi_list[pi_id];
 	struct pi_opp *pi_opp = pi->pi_opp;
 	unsigned long flgs;
+	u64 t0, t1, t2;
 	spin_lock_irqsave(&pi->lock, flgs);
 
 	old_inx = pi->opp_inx_act;
@@ -984,8 +1045,10 @@ static u32 pi_mgr_dfs_update(struct pi_mgr_dfs_node *node,
 		new_opp = opp_inx_to_id(pi_opp, new_inx);
 		if (pi->init == PI_INIT_COMPLETE
 		    && ((pi->flags & NO_POLICY_CHANGE) == 0)) {
+			t0 = local_clock();
 			pi_change_notify(pi->id, PI_NOTIFY_DFS_CHANGE,
 				old_opp, new_opp, PI_PRECHANGE);
+			t1 = local_clock();
 			pi_dbg(pi->id, PI_LOG_OPP_CHANGE,
 				"%s:pi_id= %d old_opp = %d => new_opp = %d\n",
 				__func__, pi_id, old_opp, new_opp);
@@ -1014,8 +1077,12 @@ static u32 pi_mgr_dfs_update(struct pi_mgr_dfs_node *node,
 					state_policy, new_inx);
 
 #endif
+			t2 = local_clock();
 			pi_change_notify(pi->id, PI_NOTIFY_DFS_CHANGE,
 					 old_opp, new_opp, PI_POSTCHANGE);
+			pi_dfs_defer_notify(dfs, old_opp, new_opp);
+			trace_pi_dfs_change(pi->id, old_opp, new_opp, t1 - t0,
+					    t2 - t1, local_clock() - t2);
 		}
 		pi->opp_inx_act = new_inx;
 	}
@@ -1158,6 +1225,22 @@ int pi_state_allowed(int pi_id)
 }
 EXPORT_SYMBOL(pi_state_allowed);
 
+/* OPP the DFS requests ask for, before the min and max limits */
+u32 pi_get_dfs_req(int pi_id)
+{
+	struct pi *pi = pi_mgr_get(pi_id);
+	unsigned long flgs;
+	u32 opp_inx;
+
+	BUG_ON(pi == NULL);
+	BUG_ON(pi->pi_opp == NULL);
+	spin_lock_irqsave(&pi->lock, flgs);
+	opp_inx = pi_mgr_dfs_get_opp_inx(&pi_mgr.dfs[pi_id]);
+	spin_unlock_irqrestore(&pi->lock, flgs);
+	return opp_inx_to_id(pi->pi_opp, opp_inx);
+}
+EXPORT_SYMBOL(pi_get_dfs_req);
+
 int pi_get_use_count(int pi_id)
 {
 	int ret = -EINVAL;
@@ -1647,6 +1730,13 @@ int pi_mgr_register_notifier(u32 pi_id, struct notifier_block *notifier,
 		return atomic_notifier_chain_register(&pi_mgr.
 						      pol_chg_notifier[pi_id],
 						      notifier);
+
+	case PI_NOTIFY_DFS_CHANGE_DEFERRED:
+		if (pi_mgr.pi_list[pi_id]->flags & PI_NO_DFS)
+			return -EINVAL;
+		return blocking_notifier_chain_register(&pi_mgr.dfs[pi_id].
+							deferred_notifiers,
+							notifier);
 	}
 	return -EINVAL;
 }
@@ -1675,6 +1765,13 @@ int pi_mgr_unregister_notifier(u32 pi_id, struct notifier_block *notifier,
 		return atomic_notifier_chain_unregister(&pi_mgr.
 							pol_chg_notifier[pi_id],
 							notifier);
+
+	case PI_NOTIFY_DFS_CHANGE_DEFERRED:
+		if (pi_mgr.pi_list[pi_id]->flags & PI_NO_DFS)
+			return -EINVAL;
+		return blocking_notifier_chain_unregister(&pi_mgr.dfs[pi_id].
+							  deferred_notifiers,
+							  notifier);
 	}
 	return -EINVAL;
 }
@@ -24,10 +24,60 @@
 #include <linux/string.h>
 #include <linux/spinlock.h>
 #include <linux/io.h>
+#include <linux/bitmap.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <mach/pinmux.h>
 #include <mach/hardware.h>
 
+/*
+ * Shadow of the pad control registers, so that writes of the value a pad
+ * already has are skipped. The pads keep their state across deep sleep.
+ */
+static DEFINE_SPINLOCK(pinmux_lock);
+static uint32_t pinmux_shadow[PN_MAX];
+static DECLARE_BITMAP(pinmux_shadow_valid, PN_MAX);
+static unsigned long pinmux_writes, pinmux_skipped;
+
+/* called with pinmux_lock held */
+static void pinmux_write(enum PIN_NAME name, uint32_t val)
+{
+	void __iomem *base = g_chip_pin_desc.base;
+
+	if (test_bit(name, pinmux_shadow_valid) &&
+	    pinmux_shadow[name] == val) {
+		pinmux_skipped++;
+		return;
+	}
+	writel(val, base + g_chip_pin_desc.desc_tbl[name].reg_offset);
+	pinmux_shadow[name] = val;
+	set_bit(name, pinmux_shadow_valid);
+	pinmux_writes++;
+}
+
+/* called with pinmux_lock held */
+static uint32_t pinmux_read(enum PIN_NAME name)
+{
+	void __iomem *base = g_chip_pin_desc.base;
+
+	if (!test_bit(name, pinmux_shadow_valid)) {
+		pinmux_shadow[name] =
+		    readl(base + g_chip_pin_desc.desc_tbl[name].reg_offset);
+		set_bit(name, pinmux_shadow_valid);
+	}
+	return pinmux_shadow[name];
+}
+
+void pinmux_shadow_invalidate(void)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&pinmux_lock, flags);
+	bitmap_zero(pinmux_shadow_valid, PN_MAX);
+	spin_unlock_irqrestore(&pinmux_lock, flags);
+}
+
 #ifdef CONFIG_KONA_ATAG_DT
 #include <linux/of.h>
 #include <linux/of_fdt.h>
@@ -113,6 +163,11 @@ int __init pinmux_init()
 	gpio_cnt = 0;
 	for (i = 0; i < dt_pinmux_nr; i++) {
 		writel(dt_pinmux[i], base + i * 4);
+		/* the DT table is in register order */
+		if (g_chip_pin_desc.desc_tbl[i].reg_offset == i * 4) {
+			pinmux_shadow[i] = dt_pinmux[i];
+			set_bit(i, pinmux_shadow_valid);
+		}
 		/* printk(KERN_INFO "0x%08x  pad 0x%x\n", readl(base+i* 4), i* 4); */
 
 		sel = ((union pinmux_reg)dt_pinmux[i]).b.sel;
@@ -150,7 +205,7 @@ int __init pinmux_init()
 int pinmux_get_pin_config(struct pin_config *config)
 {
 	int ret = 0;
-	void __iomem *base = g_chip_pin_desc.base;
+	unsigned long flags;
 	enum PIN_NAME name;
 
 	if (!config)
@@ -159,8 +214,9 @@ int pinmux_get_pin_config(struct pin_config *config)
 	if (!is_ball_valid(name))
 		return -EINVAL;
 
-	config->reg.val =
-	    readl(base + g_chip_pin_desc.desc_tbl[name].reg_offset);
+	spin_lock_irqsave(&pinmux_lock, flags);
+	config->reg.val = pinmux_read(name);
+	spin_unlock_irqrestore(&pinmux_lock, flags);
 
 	/* populate func */
 	config->func = g_chip_pin_desc.desc_tbl[name].f_tbl[config->reg.b.sel];
@@ -172,15 +228,12 @@ int pinmux_get_pin_config(struct pin_config *config)
   set pin configuration at run time
   caller fills pin_configuration, except sel, which will derived from func in this routine.
 */
-int pinmux_set_pin_config(struct pin_config *config)
+/* fill in the sel bits from func */
+static int pinmux_resolve_sel(struct pin_config *config)
 {
-	int ret = 0, i;
-	void __iomem *base = g_chip_pin_desc.base;
-	enum PIN_NAME name;
+	enum PIN_NAME name = config->name;
+	int i;
 
-	if (!config)
-		return -EINVAL;
-	name = config->name;
 	if (!is_ball_valid(name))
 		return -EINVAL;
 
@@ -188,21 +241,63 @@ int pinmux_set_pin_config(struct pin_config *config)
 	for (i = 0; i < MAX_ALT_FUNC; i++) {
 		if (g_chip_pin_desc.desc_tbl[name].f_tbl[i] == config->func) {
 			config->reg.b.sel = i;
-			break;
+			return 0;
 		}
 	}
-	if (i == MAX_ALT_FUNC) {
-		printk(KERN_WARNING "%s no matching\n", __func__);
+	printk(KERN_WARNING "%s no matching\n", __func__);
+	return -EINVAL;
+}
+
+int pinmux_set_pin_config(struct pin_config *config)
+{
+	if (!config)
+		return -EINVAL;
+	return pinmux_set_pin_configs(config, 1);
+}
+
+int pinmux_set_pin_configs(struct pin_config *configs, unsigned int n)
+{
+	unsigned long flags;
+	unsigned int i;
+	int ret;
+
+	if (!configs)
 		return -EINVAL;
+	for (i = 0; i < n; i++) {
+		ret = pinmux_resolve_sel(&configs[i]);
+		if (ret)
+			return ret;
 	}
 
-	writel(config->reg.val,
-	       base + g_chip_pin_desc.desc_tbl[name].reg_offset);
+	spin_lock_irqsave(&pinmux_lock, flags);
+	for (i = 0; i < n; i++) {
+		pinmux_write(configs[i].name, configs[i].reg.val);
+		pr_debug("[PINMUX] - write value 0x%08x to register 0x%08x\n",
+			 configs[i].reg.val,
+			 g_chip_pin_desc.desc_tbl[configs[i].name].reg_offset);
+	}
+	spin_unlock_irqrestore(&pinmux_lock, flags);
 
-	pr_debug("[PINMUX] - write value 0x%08x to register 0x%08x\n",
-		 config->reg.val, g_chip_pin_desc.desc_tbl[name].reg_offset);
+	return 0;
+}
 
-	return ret;
+int pinmux_update_pins(const enum PIN_NAME *names, unsigned int n,
+		       unsigned int mask, unsigned int val)
+{
+	unsigned long flags;
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		if (!is_ball_valid(names[i]))
+			return -EINVAL;
+
+	spin_lock_irqsave(&pinmux_lock, flags);
+	for (i = 0; i < n; i++)
+		pinmux_write(names[i],
+			     (pinmux_read(names[i]) & ~mask) | (val & mask));
+	spin_unlock_irqrestore(&pinmux_lock, flags);
+
+	return 0;
 }
 
 int pinmux_find_gpio(enum PIN_NAME name, unsigned *gpio, enum PIN_FUNC *PF_gpio)
@@ -223,6 +318,35 @@ int pinmux_find_gpio(enum PIN_NAME name, unsigned *gpio, enum PIN_FUNC *PF_gpio)
 	return -ENOENT;
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int pinmux_shadow_show(struct seq_file *m, void *v)
+{
+	seq_printf(m, "writes %lu skipped %lu\n", pinmux_writes,
+		   pinmux_skipped);
+	return 0;
+}
+
+static int pinmux_shadow_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pinmux_shadow_show, NULL);
+}
+
+static const struct file_operations pinmux_shadow_fops = {
+	.open		= pinmux_shadow_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init pinmux_debug_init(void)
+{
+	debugfs_create_file("pinmux_shadow", S_IRUGO, NULL, NULL,
+			    &pinmux_shadow_fops);
+	return 0;
+}
+late_initcall(pinmux_debug_init);
+#endif
+
 #ifdef CONFIG_KONA_ATAG_DT
 uint32_t get_dts_pinmux_nr()
 {
@@ -30,6 +30,9 @@
 #include <asm/io.h>
 #include <linux/mutex.h>
 #include <linux/platform_device.h>
+#include <linux/miscdevice.h>
+#include <linux/fs.h>
+#include <linux/math64.h>
 #include <mach/profiler.h>
 #include <mach/kona_timer.h>
 #include <mach/timex.h>
@@ -61,8 +64,9 @@
 #define OUTPUT_CONSOLE			("console")
 
 #define PROF_CIRC_BUFF_SIZE		\
-	(sizeof(struct prof_buff) * PROF_CIRC_BUFF_MAX_ENTRIES)
+	(sizeof(struct profiler_sample) * PROF_CIRC_BUFF_MAX_ENTRIES)
 
+/* indexed by enum profiler_log */
 const char *log_states[] = {
 	LOG_AT_SUSPEND,
 	LOG_AT_RESUME,
@@ -72,27 +76,36 @@ const char *log_states[] = {
 	NULL,
 };
 
+static const char *log_events[] = {
+	LOG_AT_SUSPEND,
+	LOG_AT_RESUME,
+	LOG_AT_SUSP_RES,
+	LOG_AT_IDLE,
+	LOG_PERIODIC,
+	"snapshot",
+};
+
 const char *log_outputs[] = {
 	OUTPUT_MTT,
 	OUTPUT_CONSOLE,
 	NULL,
 };
 
-struct prof_buff {
-	unsigned long time;
-	struct profiler *profiler;
-	unsigned long counter;
-	int overflow;
-	char *log_state;
-};
-
 struct profiler_data {
 	struct list_head profiler_list;
 	struct mutex mutex;
 	struct dentry *dentry_root_dir;
 	struct delayed_work prof_periodic_work;
-	struct prof_buff *circ_buff;
-	int circ_idx;
+	struct miscdevice misc;
+	/**
+	 * Ring of samples, also written from the idle path.
+	 * The oldest entry is dropped when it is full.
+	 */
+	spinlock_t circ_lock;
+	struct profiler_sample *circ_buff;
+	int circ_head;
+	int circ_count;
+	u32 next_id;
 	unsigned long period;
 	const char *log_state;
 	const char *output_to;
@@ -114,6 +127,15 @@ static struct profiler *get_profiler(char *name)
 	return NULL;
 }
 
+static struct profiler *get_profiler_by_id(u32 id)
+{
+	struct profiler *profiler;
+	list_for_each_entry(profiler, &profiler_data->profiler_list, node)
+		if (profiler->id == id)
+			return profiler;
+	return NULL;
+}
+
 int start_profiler(char *name, void *data)
 {
 	struct profiler *profiler;
@@ -158,58 +180,75 @@ int stop_profiler(char *name)
 	return profiler->running_time/COUNTER_CLK_RATE;
 }
 
-static void log_counters(struct profiler_data *profiler_data,
-				      char *state)
+/* oldest first, called with circ_lock held */
+static struct profiler_sample *circ_buff_entry(
+		struct profiler_data *profiler_data, int idx)
+{
+	idx += profiler_data->circ_head - profiler_data->circ_count;
+	if (idx < 0)
+		idx += PROF_CIRC_BUFF_MAX_ENTRIES;
+	return &profiler_data->circ_buff[idx];
+}
+
+static void log_counters(struct profiler_data *profiler_data, int event)
 {
 	struct profiler *profiler;
+	struct profiler_sample *sample;
 	unsigned long counter;
-	int circ_idx;
+	unsigned long flags;
+	u64 now;
 	int overflow;
 	int err = 0;
 	if (!profiler_data->running)
 		return;
 
+	/* one timestamp for all the sources logged together */
+	now = ktime_to_ns(ktime_get());
+	spin_lock_irqsave(&profiler_data->circ_lock, flags);
 	list_for_each_entry(profiler, &profiler_data->profiler_list, node) {
 		if (!profiler->ops->status(profiler))
 			continue;
-		circ_idx = profiler_data->circ_idx;
-		if (circ_idx == PROF_CIRC_BUFF_MAX_ENTRIES)
-			profiler_data->circ_idx = 0;
-		profiler_data->circ_buff[circ_idx].profiler = profiler;
-		profiler_data->circ_buff[circ_idx].log_state = state;
-		profiler_data->circ_buff[circ_idx].time =
-					ktime_to_ms(ktime_get());
 		err = profiler->ops->get_counter(profiler, &counter, &overflow);
 		BUG_ON(err < 0);
-		profiler_data->circ_buff[circ_idx].counter = counter;
 		if (profiler->flags & PROFILER_OVERFLOW)
 			overflow = 0;
-		profiler_data->circ_buff[circ_idx].overflow = overflow;
-		profiler_data->circ_idx++;
+		sample = &profiler_data->circ_buff[profiler_data->circ_head];
+		sample->time_ns = now;
+		sample->source = profiler->id;
+		sample->event = event;
+		sample->counter = counter;
+		sample->overflow = overflow;
+		if (++profiler_data->circ_head == PROF_CIRC_BUFF_MAX_ENTRIES)
+			profiler_data->circ_head = 0;
+		if (profiler_data->circ_count < PROF_CIRC_BUFF_MAX_ENTRIES)
+			profiler_data->circ_count++;
 		profiler->ops->start(profiler, false);
 		profiler->ops->start(profiler, true);
 	}
+	spin_unlock_irqrestore(&profiler_data->circ_lock, flags);
 	pm_mgr_pi_count_clear(true);
 	pm_mgr_pi_count_clear(false);
 }
 
 static void flush_circ_buff(struct profiler_data *profiler_data)
 {
-	struct prof_buff *prof_buff;
+	struct profiler_sample *prof_buff;
 	struct profiler *profiler;
+	unsigned long time;
 	int idx;
 	u8 buffer[128];
 	int count = 0;
 
 	profiler_print("\t Name \t  Duration(ms)\t log_state" \
 			"    cnt_raw    cnt_ms\n");
-	for (idx = 0; idx < profiler_data->circ_idx; idx++) {
+	for (idx = 0; idx < profiler_data->circ_count; idx++) {
 		memset(buffer, 0, sizeof(buffer));
-		prof_buff = &profiler_data->circ_buff[idx];
-		profiler = prof_buff->profiler;
-		if ((prof_buff->time - strt_time) < profiler_data->period)
+		prof_buff = circ_buff_entry(profiler_data, idx);
+		profiler = get_profiler_by_id(prof_buff->source);
+		time = div_u64(prof_buff->time_ns, NSEC_PER_MSEC);
+		if ((time - strt_time) < profiler_data->period)
 			continue;
-		if (profiler->name)
+		if (profiler && profiler->name)
 			count = snprintf(buffer, PROF_NAME_MAX_LEN, "%-10s",
 					profiler->name);
 		else
@@ -218,20 +257,20 @@ static void flush_circ_buff(struct profiler_data *profiler_data)
 
 		count += snprintf(buffer + count, sizeof(buffer) - count,
 				" %10lu \t %s     ",
-				prof_buff->time - strt_time,
-				prof_buff->log_state);
+				time - strt_time,
+				log_events[prof_buff->event]);
 		/**
 		 * Append "*" to the counter and counter_ms if the counter
 		 * has overflowed (to indicate that counter has overflowed)
 		 */
 		if (prof_buff->overflow) {
 			snprintf(buffer + count, sizeof(buffer) - count,
-					"%10lu* %10lu*\n",
+					"%10u* %10u*\n",
 					prof_buff->counter,
 					COUNTER_TO_MS(prof_buff->counter));
 		} else {
 			snprintf(buffer + count, sizeof(buffer) - count,
-					"%-10lu %-10lu\n",
+					"%-10u %-10u\n",
 					prof_buff->counter,
 					COUNTER_TO_MS(prof_buff->counter));
 		}
@@ -240,8 +279,10 @@ static void flush_circ_buff(struct profiler_data *profiler_data)
 	/**
 	 * clear the circular buffer and reset the index
 	 */
-	memset(profiler_data->circ_buff, 0, PROF_CIRC_BUFF_SIZE);
-	profiler_data->circ_idx = 0;
+	spin_lock_irq(&profiler_data->circ_lock);
+	profiler_data->circ_head = 0;
+	profiler_data->circ_count = 0;
+	spin_unlock_irq(&profiler_data->circ_lock);
 }
 
 static void prof_periodic_work(struct work_struct *work)
@@ -250,7 +291,7 @@ static void prof_periodic_work(struct work_struct *work)
 		struct profiler_data, prof_periodic_work.work);
 
 	mutex_lock(&profiler_data->mutex);
-	log_counters(profiler_data, LOG_PERIODIC);
+	log_counters(profiler_data, PROFILER_LOG_PERIODIC);
 	if (profiler_data->period && profiler_data->running)
 		schedule_delayed_work(&profiler_data->prof_periodic_work,
 				msecs_to_jiffies(profiler_data->period));
@@ -433,50 +474,176 @@ static int get_prof_start(void *data, u64 *start)
 	return 0;
 }
 
+/* called with the mutex held */
+static int prof_start(struct profiler_data *profiler_data)
+{
+	if (profiler_data->running)
+		return 0;
+	if (strcmp(profiler_data->log_state, LOG_PERIODIC) == 0) {
+		if (!profiler_data->period) {
+			pr_err("Set the period first\n");
+			return -EINVAL;
+		}
+		BUG_ON(delayed_work_pending(
+				&profiler_data->prof_periodic_work));
+		strt_time = ktime_to_ms(ktime_get());
+		schedule_delayed_work(&profiler_data->prof_periodic_work,
+				msecs_to_jiffies(0));
+		pr_info("Profiling with period %lums\n",
+				profiler_data->period);
+	}
+	profiler_data->running = 1;
+	return 0;
+}
+
+/**
+ * The samples stay in the ring, for the flush or
+ * for reading them from /dev/kona_profiler
+ */
+static int prof_stop(struct profiler_data *profiler_data)
+{
+	mutex_lock(&profiler_data->mutex);
+	if (!profiler_data->running) {
+		mutex_unlock(&profiler_data->mutex);
+		return 0;
+	}
+	profiler_data->running = 0;
+	mutex_unlock(&profiler_data->mutex);
+	cancel_delayed_work_sync(&profiler_data->prof_periodic_work);
+	return 1;
+}
+
 static int set_prof_start(void *data, u64 start)
 {
 	struct profiler_data *profiler_data = data;
 	int err = 0;
-	mutex_lock(&profiler_data->mutex);
+
 	if (start == 1) {
-		if (profiler_data->running)
-			goto out_unlock;
-		if (strcmp(profiler_data->log_state, LOG_PERIODIC) == 0) {
-			if (!profiler_data->period) {
-				pr_err("Set the period first\n");
-				err = -EINVAL;
-				goto out_unlock;
-			}
-			BUG_ON(delayed_work_pending(
-					&profiler_data->prof_periodic_work));
-			strt_time = ktime_to_ms(ktime_get());
-			schedule_delayed_work(
-				&profiler_data->prof_periodic_work,
-				msecs_to_jiffies(0));
-			pr_info("Profiling with period %lums\n",
-					profiler_data->period);
+		mutex_lock(&profiler_data->mutex);
+		if (!profiler_data->running) {
+			err = prof_start(profiler_data);
+			if (!err)
+				pr_info("To flush the buffers: [echo 1 > flush]\n");
 		}
-		pr_info("To flush the buffers: [echo 1 > flush]\n");
-		profiler_data->running = 1;
-
-	} else if (start == 0) {
-		if (!profiler_data->running)
-			goto out_unlock;
-		profiler_data->running = 0;
 		mutex_unlock(&profiler_data->mutex);
-		cancel_delayed_work_sync(&profiler_data->prof_periodic_work);
-		flush_circ_buff(profiler_data);
-		pm_mgr_pi_count_clear(true);
-		return 0;
+	} else if (start == 0) {
+		if (prof_stop(profiler_data)) {
+			flush_circ_buff(profiler_data);
+			pm_mgr_pi_count_clear(true);
+		}
 	}
-out_unlock:
-	mutex_unlock(&profiler_data->mutex);
 	return err;
 }
 
 DEFINE_SIMPLE_ATTRIBUTE(prof_start_fops,
 	get_prof_start, set_prof_start, "%llu\n");
 
+/**
+ * /dev/kona_profiler: binary samples on read, oldest
+ * first, and the ioctls of plat/profiler.h
+ */
+static ssize_t prof_dev_read(struct file *file, char __user *buf,
+		size_t len, loff_t *ppos)
+{
+	struct profiler_sample sample;
+	ssize_t count = 0;
+
+	while (len - count >= sizeof(sample)) {
+		spin_lock_irq(&profiler_data->circ_lock);
+		if (!profiler_data->circ_count) {
+			spin_unlock_irq(&profiler_data->circ_lock);
+			break;
+		}
+		sample = *circ_buff_entry(profiler_data, 0);
+		profiler_data->circ_count--;
+		spin_unlock_irq(&profiler_data->circ_lock);
+
+		if (copy_to_user(buf + count, &sample, sizeof(sample)))
+			return -EFAULT;
+		count += sizeof(sample);
+	}
+	return count;
+}
+
+static long prof_dev_ioctl(struct file *file, unsigned int cmd,
+		unsigned long arg)
+{
+	void __user *argp = (void __user *)arg;
+	struct profiler *profiler;
+	struct profiler_source source;
+	struct profiler_enable enable;
+	struct profiler_start start;
+	int err = 0;
+
+	switch (cmd) {
+	case KONA_PROF_IOC_SOURCE:
+		if (copy_from_user(&source, argp, sizeof(source)))
+			return -EFAULT;
+		mutex_lock(&profiler_data->mutex);
+		profiler = get_profiler_by_id(source.id);
+		if (profiler) {
+			source.type = profiler->prof_type;
+			strlcpy(source.name, profiler->name ? : "unknown",
+					sizeof(source.name));
+		}
+		mutex_unlock(&profiler_data->mutex);
+		if (!profiler)
+			return -ENOENT;
+		if (copy_to_user(argp, &source, sizeof(source)))
+			return -EFAULT;
+		break;
+
+	case KONA_PROF_IOC_ENABLE:
+		if (copy_from_user(&enable, argp, sizeof(enable)))
+			return -EFAULT;
+		mutex_lock(&profiler_data->mutex);
+		profiler = get_profiler_by_id(enable.id);
+		if (profiler)
+			err = profiler->ops->start(profiler, !!enable.enable);
+		else
+			err = -ENOENT;
+		mutex_unlock(&profiler_data->mutex);
+		break;
+
+	case KONA_PROF_IOC_START:
+		if (copy_from_user(&start, argp, sizeof(start)))
+			return -EFAULT;
+		if (start.log_state >= PROFILER_LOG_SNAPSHOT)
+			return -EINVAL;
+		mutex_lock(&profiler_data->mutex);
+		if (profiler_data->running) {
+			err = -EBUSY;
+		} else {
+			profiler_data->log_state = log_states[start.log_state];
+			profiler_data->period = start.period_ms;
+			err = prof_start(profiler_data);
+		}
+		mutex_unlock(&profiler_data->mutex);
+		break;
+
+	case KONA_PROF_IOC_STOP:
+		prof_stop(profiler_data);
+		break;
+
+	case KONA_PROF_IOC_SNAPSHOT:
+		mutex_lock(&profiler_data->mutex);
+		log_counters(profiler_data, PROFILER_LOG_SNAPSHOT);
+		mutex_unlock(&profiler_data->mutex);
+		break;
+
+	default:
+		return -ENOTTY;
+	}
+	return err;
+}
+
+static const struct file_operations prof_dev_fops = {
+	.owner = THIS_MODULE,
+	.read = prof_dev_read,
+	.unlocked_ioctl = prof_dev_ioctl,
+	.llseek = noop_llseek,
+};
+
 int profiler_register(struct profiler *profiler)
 {
 	if (!profiler || !profiler->ops)
@@ -487,6 +654,7 @@ int profiler_register(struct profiler *profiler)
 	}
 	profiler_dbg("Adding profiler %s\n", profiler->name);
 	mutex_lock(&profiler_data->mutex);
+	profiler->id = profiler_data->next_id++;
 	list_add_tail(&profiler->node, &profiler_data->profiler_list);
 	mutex_unlock(&profiler_data->mutex);
 	return 0;
@@ -516,7 +684,7 @@ void profiler_idle_entry_cb(void)
 		if (profiler_data->initialized &&
 			(strnicmp(profiler_data->log_state, LOG_AT_IDLE,
 				LOG_PROFILER_MAX_LEN) == 0))
-			log_counters(profiler_data, LOG_AT_IDLE);
+			log_counters(profiler_data, PROFILER_LOG_IDLE);
 }
 EXPORT_SYMBOL(profiler_idle_entry_cb);
 
@@ -547,6 +715,7 @@ static int __init profiler_probe(struct platform_device *pdev)
 	}
 
 	mutex_init(&profiler_data->mutex);
+	spin_lock_init(&profiler_data->circ_lock);
 	INIT_LIST_HEAD(&profiler_data->profiler_list);
 	INIT_DELAYED_WORK(&profiler_data->prof_periodic_work,
 		prof_periodic_work);
@@ -590,6 +759,12 @@ static int __init profiler_probe(struct platform_device *pdev)
 	if (pi_profiler_init(profiler_data->dentry_root_dir) < 0)
 		goto clean_debugfs;
 
+	profiler_data->misc.minor = MISC_DYNAMIC_MINOR;
+	profiler_data->misc.name = "kona_profiler";
+	profiler_data->misc.fops = &prof_dev_fops;
+	if (misc_register(&profiler_data->misc) < 0)
+		goto clean_debugfs;
+
 	platform_set_drvdata(pdev, profiler_data);
 	/*
 	 * initialized successfully. Set the flag
@@ -618,7 +793,7 @@ static int profiler_resume(struct platform_device *pdev)
 	if (profiler_data->running &&
 		((strcmp(profiler_data->log_state, LOG_AT_RESUME) == 0) ||
 		(strcmp(profiler_data->log_state, LOG_AT_SUSP_RES) == 0)))
-		log_counters(profiler_data, LOG_AT_RESUME);
+		log_counters(profiler_data, PROFILER_LOG_RESUME);
 	mutex_unlock(&profiler_data->mutex);
 	return 0;
 }
@@ -630,7 +805,7 @@ static int profiler_suspend(struct platform_device *pdev, pm_message_t state)
 	if (profiler_data->running &&
 		((strcmp(profiler_data->log_state, LOG_AT_SUSPEND) == 0) ||
 		(strcmp(profiler_data->log_state, LOG_AT_SUSP_RES) == 0)))
-		log_counters(profiler_data, LOG_AT_SUSPEND);
+		log_counters(profiler_data, PROFILER_LOG_SUSPEND);
 	mutex_unlock(&profiler_data->mutex);
 	return 0;
 }
@@ -640,6 +815,7 @@ static int profiler_remove(struct platform_device *pdev)
 	struct profiler_data *profiler_data = platform_get_drvdata(pdev);
 	profiler_dbg("%s\n", __func__);
 	if (profiler_data) {
+		misc_deregister(&profiler_data->misc);
 		cancel_delayed_work_sync(&profiler_data->prof_periodic_work);
 		kfree(profiler_data->circ_buff);
 		if (profiler_data->dentry_root_dir)
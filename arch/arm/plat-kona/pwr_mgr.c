@@ -20,6 +20,8 @@
 #include <linux/clkdev.h>
 #include <asm/io.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
+#include <asm/div64.h>
 #include <plat/pi_mgr.h>
 #include <mach/pwr_mgr.h>
 #include <plat/pwr_mgr.h>
@@ -207,6 +209,48 @@ enum {
 static DEFINE_SPINLOCK(pwr_mgr_lock);
 static DEFINE_MUTEX(seq_mutex);
 
+/* a pwr_mgr_pmu_reg_write() waiting for the sequencer */
+struct pwr_mgr_seq_wr_req {
+	struct list_head node;
+	u8 reg_addr;
+	u8 slave_id;
+	u8 reg_val;
+	int ret;
+	bool done;
+};
+
+static LIST_HEAD(seq_wr_queue);
+static DEFINE_SPINLOCK(seq_wr_lock);
+static u32 seq_batch_window_us;
+
+/* PMU transaction latency, request to completion, in log2(us) buckets */
+#define SEQ_LAT_BUCKETS		12
+#define SEQ_BATCH_MAX		8
+enum {
+	SEQ_LAT_READ,
+	SEQ_LAT_WRITE,
+	SEQ_LAT_MAX,
+};
+static atomic_t seq_lat_hist[SEQ_LAT_MAX][SEQ_LAT_BUCKETS];
+static atomic_t seq_batch_hist[SEQ_BATCH_MAX];
+
+static void pwr_mgr_seq_lat_add(int type, u64 ns)
+{
+	int b;
+
+	kona_pm_timeline_seq(ns);
+	do_div(ns, NSEC_PER_USEC);
+	b = min_t(int, fls((u32)min_t(u64, ns, U32_MAX)),
+		  SEQ_LAT_BUCKETS - 1);
+	atomic_inc(&seq_lat_hist[type][b]);
+}
+
+static void pwr_mgr_seq_batch_add(u32 n)
+{
+	if (n)
+		atomic_inc(&seq_batch_hist[min_t(u32, n, SEQ_BATCH_MAX) - 1]);
+}
+
 struct pwr_mgr_event {
 	void (*pwr_mgr_event_cb) (u32 event_id, void *param);
 	void *param;
@@ -2282,6 +2326,7 @@ int pwr_mgr_pmu_reg_read(u8 reg_addr, u8 slave_id, u8 *reg_val)
 {
 	int ret;
 	u32 reg;
+	u64 t;
 #if defined(CONFIG_KONA_PWRMGR_REV2)
 	u32 bsc_isr;
 #endif
@@ -2293,6 +2338,7 @@ int pwr_mgr_pmu_reg_read(u8 reg_addr, u8 slave_id, u8 *reg_val)
 	}
 	if (!reg_val)
 		return -EINVAL;
+	t = local_clock();
 	mutex_lock(&seq_mutex);
 #if defined(CONFIG_KONA_CPU_PM_HANDLER)
 #if defined(CONFIG_ARCH_JAVA)
@@ -2370,34 +2416,20 @@ out_unlock:
 #endif
 #endif
 	mutex_unlock(&seq_mutex);
+	pwr_mgr_seq_lat_add(SEQ_LAT_READ, local_clock() - t);
 	pwr_dbg(PWR_LOG_SEQ, "%s : ret = %d\n", __func__, ret);
 	return ret;
 }
 
 EXPORT_SYMBOL(pwr_mgr_pmu_reg_read);
 
-int pwr_mgr_pmu_reg_write(u8 reg_addr, u8 slave_id, u8 reg_val)
+/* one sequencer write, called with seq_mutex held and dormant disabled */
+static int __pwr_mgr_pmu_reg_write(u8 reg_addr, u8 slave_id, u8 reg_val)
 {
 	int ret = 0;
 	u32 reg;
 	u8 i2c_data;
 
-	pwr_dbg(PWR_LOG_SEQ, "%s\n", __func__);
-	if (unlikely(!pwr_mgr.info)) {
-		pwr_dbg(PWR_LOG_ERR, "%s:ERROR - pwr mgr not initialized\n",
-			__func__);
-		return -EPERM;
-	}
-
-	mutex_lock(&seq_mutex);
-#if defined(CONFIG_KONA_CPU_PM_HANDLER)
-#if defined(CONFIG_ARCH_JAVA)
-		cdc_disable_cluster_dormant(1);
-#else
-		kona_pm_disable_idle_state(CSTATE_ALL, 1);
-#endif
-#endif
-
 	pwr_mgr_seq_log_buf_put(SEQ_LOG_WRITE_BYTE,
 			SEQ_LOG_PACK_U24(slave_id, reg_addr, reg_val));
 
@@ -2434,6 +2466,64 @@ int pwr_mgr_pmu_reg_write(u8 reg_addr, u8 slave_id, u8 reg_val)
 	}
 	pwr_mgr_seq_log_buf_put(SEQ_LOG_WRITE_BYTE,
 			SEQ_LOG_PACK_U24(slave_id, reg_addr, reg_val));
+	return ret;
+}
+
+/**
+ * Writers queue their request and then contend for seq_mutex. Whoever
+ * gets it runs every queued write back to back, under one dormant
+ * disable, so writes for different rails that arrive together (CPU,
+ * MM and HUB regulators) share one trip through the lock instead of
+ * each paying for it. A writer whose request was run by someone else
+ * just collects the result. seq_batch_window_us lets the first writer
+ * wait a little for others to join.
+ */
+int pwr_mgr_pmu_reg_write(u8 reg_addr, u8 slave_id, u8 reg_val)
+{
+	struct pwr_mgr_seq_wr_req req = {
+		.reg_addr = reg_addr,
+		.slave_id = slave_id,
+		.reg_val = reg_val,
+	};
+	struct pwr_mgr_seq_wr_req *r, *tmp;
+	LIST_HEAD(batch);
+	u64 t = local_clock();
+	u32 n = 0;
+
+	pwr_dbg(PWR_LOG_SEQ, "%s\n", __func__);
+	if (unlikely(!pwr_mgr.info)) {
+		pwr_dbg(PWR_LOG_ERR, "%s:ERROR - pwr mgr not initialized\n",
+			__func__);
+		return -EPERM;
+	}
+
+	spin_lock(&seq_wr_lock);
+	list_add_tail(&req.node, &seq_wr_queue);
+	spin_unlock(&seq_wr_lock);
+
+	mutex_lock(&seq_mutex);
+	if (req.done)
+		goto out;
+	if (seq_batch_window_us)
+		usleep_range(seq_batch_window_us, seq_batch_window_us * 2);
+#if defined(CONFIG_KONA_CPU_PM_HANDLER)
+#if defined(CONFIG_ARCH_JAVA)
+		cdc_disable_cluster_dormant(1);
+#else
+		kona_pm_disable_idle_state(CSTATE_ALL, 1);
+#endif
+#endif
+	spin_lock(&seq_wr_lock);
+	list_splice_init(&seq_wr_queue, &batch);
+	spin_unlock(&seq_wr_lock);
+
+	list_for_each_entry_safe(r, tmp, &batch, node) {
+		list_del(&r->node);
+		r->ret = __pwr_mgr_pmu_reg_write(r->reg_addr, r->slave_id,
+						 r->reg_val);
+		r->done = true;
+		n++;
+	}
 #if defined(CONFIG_KONA_CPU_PM_HANDLER)
 #if defined(CONFIG_ARCH_JAVA)
 		cdc_disable_cluster_dormant(0);
@@ -2441,12 +2531,15 @@ int pwr_mgr_pmu_reg_write(u8 reg_addr, u8 slave_id, u8 reg_val)
 		kona_pm_disable_idle_state(CSTATE_ALL, 0);
 #endif
 #endif
+	pwr_mgr_seq_batch_add(n);
+out:
 	mutex_unlock(&seq_mutex);
+	pwr_mgr_seq_lat_add(SEQ_LAT_WRITE, local_clock() - t);
 	pwr_dbg(PWR_LOG_SEQ,
 		"%s reg_addr:0x%0x; slave_id:%d; reg_val:0x%0x; ret_val:%d\n",
-		__func__, reg_addr, slave_id, reg_val, ret);
+		__func__, reg_addr, slave_id, reg_val, req.ret);
 
-	return ret;
+	return req.ret;
 }
 EXPORT_SYMBOL(pwr_mgr_pmu_reg_write);
 
@@ -2859,7 +2952,7 @@ int pwr_mgr_init(struct pwr_mgr_info *info)
 }
 EXPORT_SYMBOL(pwr_mgr_init);
 
-static int pwr_mgr_pm_i2c_var_data_modify(u8 index, u8 val)
+int pwr_mgr_pm_i2c_var_data_modify(u8 index, u8 val)
 {
 	u32 reg_inx;
 	u32 data_loc;
@@ -2941,8 +3034,9 @@ static int pwr_mgr_pm_i2c_var_data_modify(u8 index, u8 val)
 
 	return 0;
 }
+EXPORT_SYMBOL(pwr_mgr_pm_i2c_var_data_modify);
 
-static int pwr_mgr_pm_i2c_var_data_read(u8 *data)
+int pwr_mgr_pm_i2c_var_data_read(u8 *data)
 {
 	u32 reg_inx;
 	u32 data_loc = 0;
@@ -2987,6 +3081,7 @@ static int pwr_mgr_pm_i2c_var_data_read(u8 *data)
 
 	return data_loc;
 }
+EXPORT_SYMBOL(pwr_mgr_pm_i2c_var_data_read);
 
 
 #ifdef CONFIG_DEBUG_FS
@@ -3449,6 +3544,64 @@ static ssize_t pwr_mgr_pmu_volt_inx_tbl_update(struct file *file, char const __u
 }
 
 
+static ssize_t pwr_mgr_seq_lat_read(struct file *file, char __user *buf,
+				    size_t len, loff_t *offset)
+{
+	static const char * const name[SEQ_LAT_MAX] = { "read", "write" };
+	char *out;
+	int i, type, n = 0;
+	ssize_t ret;
+
+	out = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (!out)
+		return -ENOMEM;
+
+	n += scnprintf(out + n, PAGE_SIZE - n, "%-10s", "us <");
+	for (type = 0; type < SEQ_LAT_MAX; type++)
+		n += scnprintf(out + n, PAGE_SIZE - n, "%10s", name[type]);
+	n += scnprintf(out + n, PAGE_SIZE - n, "\n");
+	for (i = 0; i < SEQ_LAT_BUCKETS; i++) {
+		if (i < SEQ_LAT_BUCKETS - 1)
+			n += scnprintf(out + n, PAGE_SIZE - n, "%-10u", 1 << i);
+		else
+			n += scnprintf(out + n, PAGE_SIZE - n, "%-10s", "inf");
+		for (type = 0; type < SEQ_LAT_MAX; type++)
+			n += scnprintf(out + n, PAGE_SIZE - n, "%10d",
+				       atomic_read(&seq_lat_hist[type][i]));
+		n += scnprintf(out + n, PAGE_SIZE - n, "\n");
+	}
+	n += scnprintf(out + n, PAGE_SIZE - n, "writes per batch:");
+	for (i = 0; i < SEQ_BATCH_MAX; i++)
+		n += scnprintf(out + n, PAGE_SIZE - n, " %d%s:%d", i + 1,
+			       i == SEQ_BATCH_MAX - 1 ? "+" : "",
+			       atomic_read(&seq_batch_hist[i]));
+	n += scnprintf(out + n, PAGE_SIZE - n, "\n");
+
+	ret = simple_read_from_buffer(buf, len, offset, out, n);
+	kfree(out);
+	return ret;
+}
+
+static ssize_t pwr_mgr_seq_lat_write(struct file *file, char const __user *buf,
+				     size_t len, loff_t *offset)
+{
+	int i, type;
+
+	/* any write clears the histogram */
+	for (type = 0; type < SEQ_LAT_MAX; type++)
+		for (i = 0; i < SEQ_LAT_BUCKETS; i++)
+			atomic_set(&seq_lat_hist[type][i], 0);
+	for (i = 0; i < SEQ_BATCH_MAX; i++)
+		atomic_set(&seq_batch_hist[i], 0);
+	return len;
+}
+
+static const struct file_operations seq_lat_fops = {
+	.open = pwr_mgr_debugfs_open,
+	.read = pwr_mgr_seq_lat_read,
+	.write = pwr_mgr_seq_lat_write,
+};
+
 static struct file_operations set_pmu_volt_inx_tbl_fops = {
     .open = pwr_mgr_pmu_volt_inx_tbl_open,
     .write = pwr_mgr_pmu_volt_inx_tbl_update,
@@ -3519,6 +3672,16 @@ int __init pwr_mgr_debug_init(u32 bmdm_pwr_base)
 	     &set_pmu_volt_inx_tbl_fops))
 		return -ENOMEM;
 
+	if (!debugfs_create_file
+	    ("i2c_seq_latency", S_IRUGO | S_IWUSR, dent_pwr_root_dir, NULL,
+	     &seq_lat_fops))
+		return -ENOMEM;
+
+	if (!debugfs_create_u32
+	    ("i2c_batch_window_us", S_IWUSR | S_IRUSR, dent_pwr_root_dir,
+	     &seq_batch_window_us))
+		return -ENOMEM;
+
 	dent_event_tbl = debugfs_create_dir("event_table", dent_pwr_root_dir);
 	if (!dent_event_tbl)
 		return -ENOMEM;
@@ -0,0 +1,429 @@
+/*
+ * arch/arm/plat-kona/rq_hotplug.c
+ *
+ * CPU hotplug governor driven by the scheduler's runqueue averages.
+ *
+ * Every sample_ms the average nr_running and nr_iowait since the last
+ * sample (sched_get_nr_running_avg, in hundredths of a task) decide
+ * whether a secondary core is brought up or taken down:
+ *
+ *  - a core is onlined as soon as the average exceeds the online count
+ *    by up_slack, or after up_samples consecutive samples if that is
+ *    more than one;
+ *  - a core is offlined after down_samples consecutive samples in which
+ *    the average fits in one core less with down_slack to spare, unless
+ *    the iowait average is above iowait_hold;
+ *  - while a max frequency limit request (cpufreq_add_lmt_req) holds
+ *    the cpu below its maximum, at most throttle_cpus stay online;
+ *  - a touch event brings boost_cpus cores online right away and keeps
+ *    them for boost_ms;
+ *  - with follow_packing and the scheduler packing small tasks, no core
+ *    is onlined while the scheduler leaves some of the online ones out
+ *    of its packing set, and such samples count as quiet ones.
+ *
+ * Each sample also adds the wall, idle and offline time of every core
+ * to debugfs rq_hotplug_residency, split by whether task packing was on,
+ * so the residency of the two modes can be compared. Writing to it
+ * clears the numbers.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/input.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
+#include <linux/workqueue.h>
+#include <plat/kona_cpufreq_drv.h>
+
+static unsigned int sample_ms = 50;
+module_param(sample_ms, uint, S_IRUGO | S_IWUSR);
+static unsigned int min_cpus = 1;
+module_param(min_cpus, uint, S_IRUGO | S_IWUSR);
+static unsigned int max_cpus = NR_CPUS;
+module_param(max_cpus, uint, S_IRUGO | S_IWUSR);
+static unsigned int up_slack = 25;
+module_param(up_slack, uint, S_IRUGO | S_IWUSR);
+static unsigned int down_slack = 40;
+module_param(down_slack, uint, S_IRUGO | S_IWUSR);
+static unsigned int up_samples = 1;
+module_param(up_samples, uint, S_IRUGO | S_IWUSR);
+static unsigned int down_samples = 10;
+module_param(down_samples, uint, S_IRUGO | S_IWUSR);
+static unsigned int iowait_hold = 100;
+module_param(iowait_hold, uint, S_IRUGO | S_IWUSR);
+static unsigned int throttle_cpus = 1;
+module_param(throttle_cpus, uint, S_IRUGO | S_IWUSR);
+static unsigned int boost_cpus = 2;
+module_param(boost_cpus, uint, S_IRUGO | S_IWUSR);
+static unsigned int boost_ms = 1000;
+module_param(boost_ms, uint, S_IRUGO | S_IWUSR);
+static bool follow_packing = true;
+module_param(follow_packing, bool, S_IRUGO | S_IWUSR);
+
+static struct delayed_work rq_hotplug_work;
+static struct workqueue_struct *rq_hotplug_wq;
+static DEFINE_MUTEX(rq_hotplug_lock);
+static unsigned long boost_until;
+static unsigned int up_count, down_count;
+static bool enabled = true;
+
+/* per core, [0] with task packing off, [1] on; under rq_hotplug_lock */
+struct rq_residency {
+	u64 last_wall;
+	u64 last_idle;
+	bool valid;
+	u64 wall_us[2];
+	u64 idle_us[2];
+	u64 offline_us[2];
+};
+static struct rq_residency rq_residency[NR_CPUS];
+static u64 rq_residency_last;
+
+static void rq_hotplug_residency(void)
+{
+	int mode = sched_packing_active();
+	u64 now = ktime_to_us(ktime_get()), wall, idle;
+	struct rq_residency *r;
+	unsigned int cpu;
+
+	for_each_present_cpu(cpu) {
+		r = &rq_residency[cpu];
+		if (!cpu_online(cpu)) {
+			if (rq_residency_last)
+				r->offline_us[mode] += now - rq_residency_last;
+			r->valid = false;
+			continue;
+		}
+		idle = get_cpu_idle_time_us(cpu, &wall);
+		if (idle == -1ULL)
+			continue;
+		if (r->valid && wall > r->last_wall) {
+			r->wall_us[mode] += wall - r->last_wall;
+			r->idle_us[mode] += idle - r->last_idle;
+		}
+		r->last_wall = wall;
+		r->last_idle = idle;
+		r->valid = true;
+	}
+	rq_residency_last = now;
+}
+
+/* a max limit request below the cpu's top frequency is in force */
+static bool rq_hotplug_throttled(void)
+{
+	struct cpufreq_policy *policy;
+	unsigned int max;
+	bool throttled = false;
+
+	if (get_cpufreq_limit(&max, MAX_LIMIT))
+		return false;
+
+	policy = cpufreq_cpu_get(0);
+	if (policy) {
+		throttled = max < policy->cpuinfo.max_freq;
+		cpufreq_cpu_put(policy);
+	}
+	return throttled;
+}
+
+static void rq_hotplug_cpu_up(void)
+{
+	unsigned int cpu;
+
+	for_each_present_cpu(cpu) {
+		if (!cpu_online(cpu)) {
+			cpu_up(cpu);
+			return;
+		}
+	}
+}
+
+static void rq_hotplug_cpu_down(void)
+{
+	unsigned int cpu;
+
+	/* the highest numbered secondary goes first; cpu0 always stays */
+	for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--) {
+		if (cpu_online(cpu)) {
+			cpu_down(cpu);
+			return;
+		}
+	}
+}
+
+static void rq_hotplug_sample(struct work_struct *work)
+{
+	unsigned int online, packed, lo, hi;
+	int avg, iowait;
+
+	mutex_lock(&rq_hotplug_lock);
+	if (!enabled)
+		goto out;
+
+	rq_hotplug_residency();
+	sched_get_nr_running_avg(&avg, &iowait);
+	online = num_online_cpus();
+	/* cores the scheduler keeps idle for packing need no company */
+	packed = online;
+	if (follow_packing && sched_packing_active())
+		packed = min(sched_packing_cpus(), online);
+
+	hi = min_t(unsigned int, max_cpus, num_present_cpus());
+	if (rq_hotplug_throttled())
+		hi = min(hi, max(throttle_cpus, 1U));
+	lo = min_cpus;
+	if (time_before(jiffies, boost_until))
+		lo = max(lo, boost_cpus);
+	lo = clamp(lo, 1U, hi);
+
+	if (online < lo) {
+		/* boost or a raised floor: no waiting for samples */
+		for (; online < lo; online++)
+			rq_hotplug_cpu_up();
+		up_count = down_count = 0;
+		goto out;
+	}
+	if (online > hi) {
+		rq_hotplug_cpu_down();
+		up_count = down_count = 0;
+		goto out;
+	}
+
+	if (online < hi && packed == online &&
+	    avg > online * 100 + up_slack) {
+		down_count = 0;
+		if (++up_count >= up_samples) {
+			rq_hotplug_cpu_up();
+			up_count = 0;
+		}
+	} else if (online > lo && iowait <= iowait_hold &&
+		   (packed < online ||
+		    avg + down_slack < (online - 1) * 100)) {
+		up_count = 0;
+		if (++down_count >= down_samples) {
+			rq_hotplug_cpu_down();
+			down_count = 0;
+		}
+	} else {
+		up_count = down_count = 0;
+	}
+
+out:
+	if (enabled)
+		queue_delayed_work(rq_hotplug_wq, &rq_hotplug_work,
+				   msecs_to_jiffies(sample_ms));
+	mutex_unlock(&rq_hotplug_lock);
+}
+
+static int rq_hotplug_set_enabled(const char *val, struct kernel_param *kp)
+{
+	int ret;
+	bool was = enabled;
+
+	ret = param_set_bool(val, kp);
+	if (ret || !rq_hotplug_wq || was == enabled)
+		return ret;
+
+	if (enabled) {
+		int avg, iowait;
+
+		mutex_lock(&rq_hotplug_lock);
+		/* start the averages afresh */
+		sched_get_nr_running_avg(&avg, &iowait);
+		up_count = down_count = 0;
+		queue_delayed_work(rq_hotplug_wq, &rq_hotplug_work,
+				   msecs_to_jiffies(sample_ms));
+		mutex_unlock(&rq_hotplug_lock);
+	} else {
+		cancel_delayed_work_sync(&rq_hotplug_work);
+	}
+	return 0;
+}
+module_param_call(enabled, rq_hotplug_set_enabled, param_get_bool,
+		  &enabled, S_IRUGO | S_IWUSR);
+
+#ifdef CONFIG_DEBUG_FS
+
+static int rq_residency_show(struct seq_file *m, void *v)
+{
+	struct rq_residency *r;
+	unsigned int cpu;
+	int mode;
+
+	seq_puts(m, "cpu packing wall_ms idle_ms idle% offline_ms\n");
+	mutex_lock(&rq_hotplug_lock);
+	for_each_present_cpu(cpu) {
+		r = &rq_residency[cpu];
+		for (mode = 0; mode < 2; mode++)
+			seq_printf(m, "%3u %-7s %7llu %7llu %5llu %10llu\n",
+				   cpu, mode ? "on" : "off",
+				   div_u64(r->wall_us[mode], 1000),
+				   div_u64(r->idle_us[mode], 1000),
+				   r->wall_us[mode] ?
+				   div64_u64(r->idle_us[mode] * 100,
+					     r->wall_us[mode]) : 0,
+				   div_u64(r->offline_us[mode], 1000));
+	}
+	mutex_unlock(&rq_hotplug_lock);
+	return 0;
+}
+
+static int rq_residency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rq_residency_show, NULL);
+}
+
+static ssize_t rq_residency_write(struct file *file, const char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	unsigned int cpu;
+
+	mutex_lock(&rq_hotplug_lock);
+	for_each_present_cpu(cpu) {
+		memset(rq_residency[cpu].wall_us, 0,
+		       sizeof(rq_residency[cpu].wall_us));
+		memset(rq_residency[cpu].idle_us, 0,
+		       sizeof(rq_residency[cpu].idle_us));
+		memset(rq_residency[cpu].offline_us, 0,
+		       sizeof(rq_residency[cpu].offline_us));
+	}
+	mutex_unlock(&rq_hotplug_lock);
+	return count;
+}
+
+static const struct file_operations rq_residency_fops = {
+	.open		= rq_residency_open,
+	.read		= seq_read,
+	.write		= rq_residency_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
+/* touch boost */
+
+static void rq_hotplug_input_event(struct input_handle *handle,
+				   unsigned int type, unsigned int code,
+				   int value)
+{
+	unsigned long now = jiffies;
+
+	if (!enabled || !boost_ms)
+		return;
+
+	/* already boosted for most of the window: just let it run */
+	if (time_before(now + msecs_to_jiffies(boost_ms) / 2, boost_until))
+		return;
+
+	boost_until = now + msecs_to_jiffies(boost_ms);
+	if (num_online_cpus() < boost_cpus)
+		mod_delayed_work(rq_hotplug_wq, &rq_hotplug_work, 0);
+}
+
+static int rq_hotplug_input_connect(struct input_handler *handler,
+				    struct input_dev *dev,
+				    const struct input_device_id *id)
+{
+	struct input_handle *handle;
+	int ret;
+
+	handle = kzalloc(sizeof(*handle), GFP_KERNEL);
+	if (!handle)
+		return -ENOMEM;
+
+	handle->dev = dev;
+	handle->handler = handler;
+	handle->name = "rq_hotplug";
+
+	ret = input_register_handle(handle);
+	if (ret)
+		goto err_register;
+
+	ret = input_open_device(handle);
+	if (ret)
+		goto err_open;
+
+	return 0;
+
+err_open:
+	input_unregister_handle(handle);
+err_register:
+	kfree(handle);
+	return ret;
+}
+
+static void rq_hotplug_input_disconnect(struct input_handle *handle)
+{
+	input_close_device(handle);
+	input_unregister_handle(handle);
+	kfree(handle);
+}
+
+static const struct input_device_id rq_hotplug_ids[] = {
+	{
+		/* multi-touch touchscreens */
+		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.evbit = { BIT_MASK(EV_ABS) },
+		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
+			    BIT_MASK(ABS_MT_POSITION_X) |
+			    BIT_MASK(ABS_MT_POSITION_Y) },
+	},
+	{
+		/* single-touch touchscreens and touchpads */
+		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
+			 INPUT_DEVICE_ID_MATCH_ABSBIT,
+		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
+		.absbit = { [BIT_WORD(ABS_X)] =
+			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+	},
+	{ },
+};
+
+static struct input_handler rq_hotplug_input_handler = {
+	.event		= rq_hotplug_input_event,
+	.connect	= rq_hotplug_input_connect,
+	.disconnect	= rq_hotplug_input_disconnect,
+	.name		= "rq_hotplug",
+	.id_table	= rq_hotplug_ids,
+};
+
+static int __init rq_hotplug_init(void)
+{
+	int avg, iowait;
+
+	rq_hotplug_wq = alloc_workqueue("rq_hotplug",
+					WQ_FREEZABLE | WQ_POWER_EFFICIENT, 1);
+	if (!rq_hotplug_wq)
+		return -ENOMEM;
+	INIT_DELAYED_WORK(&rq_hotplug_work, rq_hotplug_sample);
+
+	if (input_register_handler(&rq_hotplug_input_handler))
+		pr_err("rq_hotplug: input handler registration failed\n");
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("rq_hotplug_residency", S_IRUGO | S_IWUSR, NULL,
+			    NULL, &rq_residency_fops);
+#endif
+
+	if (enabled) {
+		sched_get_nr_running_avg(&avg, &iowait);
+		queue_delayed_work(rq_hotplug_wq, &rq_hotplug_work,
+				   msecs_to_jiffies(sample_ms));
+	}
+	return 0;
+}
+late_initcall(rq_hotplug_init);
@@ -93,7 +93,7 @@ static cycle_t notrace gptimer_clksrc_read(struct clocksource *cs)
 {
 	cycle_t count = 0;
 
-	count = kona_timer_get_counter(gpt_src);
+	count = kona_timer_read_counter(gpt_src);
 	return count;
 }
 
@@ -145,6 +145,10 @@ static void __init gptimer_clockevents_init(void)
 
 static void __init gptimer_clocksource_init(void)
 {
+#ifdef CONFIG_KONA_ARCH_COUNTER_CLOCKSOURCE
+	/* only a fallback behind arch_sys_counter */
+	clksrc_gptimer.rating = 150;
+#endif
 	clksrc_gptimer.mult = clocksource_hz2mult(CLOCK_TICK_RATE,
 						  clksrc_gptimer.shift);
 	clocksource_register(&clksrc_gptimer);
@@ -209,7 +213,7 @@ static void __init timers_init(struct gp_timer_setup *gpt_setup)
 
 static u32 notrace kona_update_sched_clock(void)
 {
-	return kona_timer_get_counter(gpt_src);
+	return kona_timer_read_counter(gpt_src);
 }
 
 #ifdef CONFIG_HAVE_ARM_TWD
@@ -260,6 +264,10 @@ void __init gp_timer_init(struct gp_timer_setup *gpt_setup)
  *
  * We have done the same for sched_clock as well (though I'm not sure
  * whether sched clock too should keep running during C3 states.
+ *
+ * With CONFIG_KONA_ARCH_COUNTER_CLOCKSOURCE the firmware keeps the counter
+ * running through dormant, and it is both the clocksource and sched_clock.
+ * The hub timer is then left as the broadcast and wakeup event device.
  */
 #ifdef CONFIG_USE_ARCH_TIMER_AS_LOCAL_TIMER
 	/*
@@ -276,6 +284,11 @@ void __init gp_timer_init(struct gp_timer_setup *gpt_setup)
 */
 #endif
 	gptimer_clocksource_init();
+#ifdef CONFIG_KONA_ARCH_COUNTER_CLOCKSOURCE
+	if (arch_timer_arch_init() == 0)
+		return;
+	pr_info("Arch counter not usable for sched_clock\n");
+#endif
 	setup_sched_clock_needs_suspend(kona_update_sched_clock,
 			32, CLOCK_TICK_RATE);
 }
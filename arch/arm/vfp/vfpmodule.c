@@ -541,6 +541,26 @@ void vfp_flush_hwstate(struct thread_info *thread)
 	put_cpu();
 }
 
+/*
+ * Called before a power down that loses this CPU's VFP registers, with
+ * preemption disabled. On SMP, while the VFP is off, the registers only
+ * mirror a state already saved to its thread at the last context switch,
+ * so they are dropped and the next use reloads them. Returns false if
+ * the caller has to preserve the registers itself.
+ */
+bool vfp_release_hwstate(void)
+{
+#ifdef CONFIG_SMP
+	if (fmrx(FPEXC) & FPEXC_EN)
+		return false;
+
+	vfp_current_hw_state[smp_processor_id()] = NULL;
+	return true;
+#else
+	return false;
+#endif
+}
+
 /*
  * Save the current VFP state into the provided structures and prepare
  * for entry into a new function (signal handler).
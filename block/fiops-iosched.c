@@ -10,7 +10,10 @@
 #include <linux/jiffies.h>
 #include <linux/rbtree.h>
 #include <linux/ioprio.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 #include "blk.h"
+#include "blk-cgroup.h"
 
 #define VIOS_SCALE_SHIFT 10
 #define VIOS_SCALE (1 << VIOS_SCALE_SHIFT)
@@ -22,6 +25,33 @@
 
 #define VIOS_PRIO_SCALE (5)
 
+/*
+ * Foreground and background. A task is background when its ioprio class
+ * is idle or its blkio cgroup has a weight of at most bg_weight; reads
+ * from foreground tasks are served ahead of everything but RT, and
+ * while their latency is above fg_read_target_us, background async
+ * writes are held to bg_async_depth in flight.
+ */
+#define FIOPS_BG_WEIGHT		(250)
+#define FIOPS_FG_READ_TARGET_US	(20000)
+#define FIOPS_BG_ASYNC_DEPTH	(1)
+/* fg read latency older than this no longer throttles anything */
+#define FIOPS_FG_WINDOW_US	(200000)
+
+enum {
+	FIOPS_LAT_FG_READ,
+	FIOPS_LAT_FG_WRITE,
+	FIOPS_LAT_BG_READ,
+	FIOPS_LAT_BG_WRITE,
+	FIOPS_LAT_NR,
+};
+
+struct fiops_lat_stats {
+	u64 count;
+	u64 total_us;
+	u32 max_us;
+};
+
 struct fiops_rb_root {
 	struct rb_root rb;
 	struct rb_node *left;
@@ -34,7 +64,8 @@ struct fiops_rb_root {
 enum wl_prio_t {
 	IDLE_WORKLOAD = 0,
 	BE_WORKLOAD = 1,
-	RT_WORKLOAD = 2,
+	FG_READ_WORKLOAD = 2,	/* BE, foreground, sync read at fifo head */
+	RT_WORKLOAD = 3,
 	FIOPS_PRIO_NR,
 };
 
@@ -52,6 +83,16 @@ struct fiops_data {
 	unsigned int write_scale;
 	unsigned int sync_scale;
 	unsigned int async_scale;
+
+	unsigned int bg_weight;
+	unsigned int fg_read_target_us;
+	unsigned int bg_async_depth;
+	unsigned int bg_async_in_flight;
+
+	u32 fg_read_lat_us;	/* moving average */
+	unsigned long fg_read_last;
+
+	struct fiops_lat_stats lat[FIOPS_LAT_NR];
 };
 
 struct fiops_ioc {
@@ -71,10 +112,19 @@ struct fiops_ioc {
 	pid_t pid;
 	unsigned short ioprio;
 	enum wl_prio_t wl_type;
+	bool bg;
 };
 
-#define ioc_service_tree(ioc) (&((ioc)->fiopsd->service_tree[(ioc)->wl_type]))
 #define RQ_CIC(rq)		icq_to_cic((rq)->elv.icq)
+/* insertion time, and whether the rq counts in bg_async_in_flight */
+#define RQ_START(rq)		((unsigned long)(rq)->elv.priv[0])
+#define RQ_BG_ASYNC(rq)		((rq)->elv.priv[1])
+
+/* local_clock() in units of 1.024us, wrapping, for the latency stats */
+static inline unsigned long fiops_now_us(void)
+{
+	return (unsigned long)(local_clock() >> 10);
+}
 
 enum ioc_state_flags {
 	FIOPS_IOC_FLAG_on_rr = 0,	/* on round-robin busy list */
@@ -122,6 +172,23 @@ static inline struct fiops_ioc *fiops_cic_lookup(struct fiops_data *fiopsd,
 	return NULL;
 }
 
+/*
+ * A best effort foreground task whose next request is a sync read goes
+ * to the FG_READ tree, which is served before all but RT.
+ */
+static struct fiops_rb_root *ioc_service_tree(struct fiops_ioc *ioc)
+{
+	enum wl_prio_t type = ioc->wl_type;
+
+	if (type == BE_WORKLOAD && !ioc->bg && !list_empty(&ioc->fifo)) {
+		struct request *rq = rq_entry_fifo(ioc->fifo.next);
+
+		if (rq_data_dir(rq) == READ && rq_is_sync(rq))
+			type = FG_READ_WORKLOAD;
+	}
+	return &ioc->fiopsd->service_tree[type];
+}
+
 /*
  * The below is leftmost cache rbtree addon
  */
@@ -342,6 +409,10 @@ static u64 fiops_dispatch_request(struct fiops_data *fiopsd,
 
 	fiopsd->in_flight[rq_is_sync(rq)]++;
 	ioc->in_flight++;
+	if (ioc->bg && !rq_is_sync(rq)) {
+		RQ_BG_ASYNC(rq) = (void *)1;
+		fiopsd->bg_async_in_flight++;
+	}
 
 	return fiops_scaled_vios(fiopsd, ioc, rq);
 }
@@ -367,25 +438,53 @@ static int fiops_forced_dispatch(struct fiops_data *fiopsd)
 	return dispatched;
 }
 
+/*
+ * Foreground reads are waiting longer than fg_read_target_us; only
+ * recent ones count, so the throttle goes away with the foreground load.
+ */
+static bool fiops_bg_throttled(struct fiops_data *fiopsd)
+{
+	return fiopsd->fg_read_lat_us > fiopsd->fg_read_target_us &&
+		fiops_now_us() - fiopsd->fg_read_last < FIOPS_FG_WINDOW_US;
+}
+
+static bool fiops_ioc_throttled(struct fiops_data *fiopsd,
+	struct fiops_ioc *ioc)
+{
+	struct request *rq = rq_entry_fifo(ioc->fifo.next);
+
+	return ioc->bg && !rq_is_sync(rq) &&
+		fiopsd->bg_async_in_flight >= fiopsd->bg_async_depth &&
+		fiops_bg_throttled(fiopsd);
+}
+
 static struct fiops_ioc *fiops_select_ioc(struct fiops_data *fiopsd)
 {
-	struct fiops_ioc *ioc;
+	struct fiops_ioc *ioc = NULL;
 	struct fiops_rb_root *service_tree = NULL;
+	struct rb_node *n;
 	int i;
 	struct request *rq;
 
 	for (i = RT_WORKLOAD; i >= IDLE_WORKLOAD; i--) {
-		if (!RB_EMPTY_ROOT(&fiopsd->service_tree[i].rb)) {
-			service_tree = &fiopsd->service_tree[i];
-			break;
+		service_tree = &fiopsd->service_tree[i];
+		if (RB_EMPTY_ROOT(&service_tree->rb))
+			continue;
+
+		/* skip the throttled background writers */
+		for (ioc = fiops_rb_first(service_tree); ioc;
+		     ioc = n ? rb_entry(n, struct fiops_ioc, rb_node) : NULL) {
+			if (!fiops_ioc_throttled(fiopsd, ioc))
+				break;
+			n = rb_next(&ioc->rb_node);
 		}
+		if (ioc)
+			break;
 	}
 
-	if (!service_tree)
+	if (!ioc)
 		return NULL;
 
-	ioc = fiops_rb_first(service_tree);
-
 	rq = rq_entry_fifo(ioc->fifo.next);
 	/*
 	 * we are the only async task and sync requests are in flight, delay a
@@ -469,12 +568,46 @@ static void fiops_init_prio_data(struct fiops_ioc *cic)
 	fiops_clear_ioc_prio_changed(cic);
 }
 
+static bool fiops_rq_bg(struct fiops_data *fiopsd, struct fiops_ioc *ioc,
+	struct request *rq)
+{
+	bool bg = false;
+
+	if (ioc->wl_type == IDLE_WORKLOAD)
+		return true;
+
+#ifdef CONFIG_BLK_CGROUP
+	{
+		struct blkcg *blkcg;
+
+		rcu_read_lock();
+		blkcg = bio_blkcg(rq->bio);
+		bg = blkcg != &blkcg_root &&
+			blkcg->cfq_weight <= fiopsd->bg_weight;
+		rcu_read_unlock();
+	}
+#endif
+	return bg;
+}
+
 static void fiops_insert_request(struct request_queue *q, struct request *rq)
 {
+	struct fiops_data *fiopsd = q->elevator->elevator_data;
 	struct fiops_ioc *ioc = RQ_CIC(rq);
+	bool bg;
 
 	fiops_init_prio_data(ioc);
 
+	rq->elv.priv[0] = (void *)fiops_now_us();
+	RQ_BG_ASYNC(rq) = NULL;
+
+	/* a move between fg and bg puts the ioc on its new tree */
+	bg = fiops_rq_bg(fiopsd, ioc, rq);
+	if (bg != ioc->bg) {
+		ioc->bg = bg;
+		fiops_resort_rr_list(fiopsd, ioc);
+	}
+
 	list_add_tail(&rq->queuelist, &ioc->fifo);
 
 	fiops_add_rq_rb(rq);
@@ -490,6 +623,33 @@ static inline void fiops_schedule_dispatch(struct fiops_data *fiopsd)
 		kblockd_schedule_work(fiopsd->queue, &fiopsd->unplug_work);
 }
 
+static void fiops_account_latency(struct fiops_data *fiopsd,
+	struct fiops_ioc *ioc, struct request *rq)
+{
+	unsigned long now = fiops_now_us();
+	u32 lat = now - RQ_START(rq);
+	struct fiops_lat_stats *st;
+	int class;
+
+	if (rq_data_dir(rq) == READ)
+		class = ioc->bg ? FIOPS_LAT_BG_READ : FIOPS_LAT_FG_READ;
+	else
+		class = ioc->bg ? FIOPS_LAT_BG_WRITE : FIOPS_LAT_FG_WRITE;
+
+	st = &fiopsd->lat[class];
+	st->count++;
+	st->total_us += lat;
+	if (lat > st->max_us)
+		st->max_us = lat;
+
+	if (class == FIOPS_LAT_FG_READ) {
+		fiopsd->fg_read_lat_us = fiopsd->fg_read_lat_us ?
+			fiopsd->fg_read_lat_us - fiopsd->fg_read_lat_us / 8 +
+			lat / 8 : lat;
+		fiopsd->fg_read_last = now;
+	}
+}
+
 static void fiops_completed_request(struct request_queue *q, struct request *rq)
 {
 	struct fiops_data *fiopsd = q->elevator->elevator_data;
@@ -497,6 +657,10 @@ static void fiops_completed_request(struct request_queue *q, struct request *rq)
 
 	fiopsd->in_flight[rq_is_sync(rq)]--;
 	ioc->in_flight--;
+	if (RQ_BG_ASYNC(rq))
+		fiopsd->bg_async_in_flight--;
+
+	fiops_account_latency(fiopsd, ioc, rq);
 
 	if (fiopsd->in_flight[0] + fiopsd->in_flight[1] == 0)
 		fiops_schedule_dispatch(fiopsd);
@@ -560,6 +724,9 @@ fiops_merged_requests(struct request_queue *q, struct request *rq,
 	 */
 	if (fiops_ioc_on_rr(ioc) && RB_EMPTY_ROOT(&ioc->sort_list))
 		fiops_del_ioc_rr(fiopsd, ioc);
+	else
+		/* the fifo head may have changed kind */
+		fiops_resort_rr_list(fiopsd, ioc);
 }
 
 static int fiops_allow_merge(struct request_queue *q, struct request *rq,
@@ -629,6 +796,10 @@ static int fiops_init_queue(struct request_queue *q, struct elevator_type *e)
 	fiopsd->sync_scale = VIOS_SYNC_SCALE;
 	fiopsd->async_scale = VIOS_ASYNC_SCALE;
 
+	fiopsd->bg_weight = FIOPS_BG_WEIGHT;
+	fiopsd->fg_read_target_us = FIOPS_FG_READ_TARGET_US;
+	fiopsd->bg_async_depth = FIOPS_BG_ASYNC_DEPTH;
+
 	return 0;
 }
 
@@ -675,6 +846,9 @@ SHOW_FUNCTION(fiops_read_scale_show, fiopsd->read_scale);
 SHOW_FUNCTION(fiops_write_scale_show, fiopsd->write_scale);
 SHOW_FUNCTION(fiops_sync_scale_show, fiopsd->sync_scale);
 SHOW_FUNCTION(fiops_async_scale_show, fiopsd->async_scale);
+SHOW_FUNCTION(fiops_bg_weight_show, fiopsd->bg_weight);
+SHOW_FUNCTION(fiops_fg_read_target_us_show, fiopsd->fg_read_target_us);
+SHOW_FUNCTION(fiops_bg_async_depth_show, fiopsd->bg_async_depth);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)				\
@@ -694,8 +868,50 @@ STORE_FUNCTION(fiops_read_scale_store, &fiopsd->read_scale, 1, 100);
 STORE_FUNCTION(fiops_write_scale_store, &fiopsd->write_scale, 1, 100);
 STORE_FUNCTION(fiops_sync_scale_store, &fiopsd->sync_scale, 1, 100);
 STORE_FUNCTION(fiops_async_scale_store, &fiopsd->async_scale, 1, 100);
+STORE_FUNCTION(fiops_bg_weight_store, &fiopsd->bg_weight, 0, 1000);
+STORE_FUNCTION(fiops_fg_read_target_us_store, &fiopsd->fg_read_target_us,
+	1000, 1000000);
+STORE_FUNCTION(fiops_bg_async_depth_store, &fiopsd->bg_async_depth, 1, 128);
 #undef STORE_FUNCTION
 
+static ssize_t fiops_latency_show(struct elevator_queue *e, char *page)
+{
+	static const char * const name[FIOPS_LAT_NR] = {
+		"fg_read", "fg_write", "bg_read", "bg_write",
+	};
+	struct fiops_data *fiopsd = e->elevator_data;
+	struct fiops_lat_stats st[FIOPS_LAT_NR];
+	struct request_queue *q = fiopsd->queue;
+	int i, n = 0;
+
+	spin_lock_irq(q->queue_lock);
+	memcpy(st, fiopsd->lat, sizeof(st));
+	spin_unlock_irq(q->queue_lock);
+
+	/* count, average and max from insertion to completion, in us */
+	for (i = 0; i < FIOPS_LAT_NR; i++)
+		n += scnprintf(page + n, PAGE_SIZE - n, "%-8s %llu %llu %u\n",
+			name[i], st[i].count,
+			st[i].count ? div64_u64(st[i].total_us, st[i].count) : 0,
+			st[i].max_us);
+	n += scnprintf(page + n, PAGE_SIZE - n, "fg_read_avg %u%s\n",
+		fiopsd->fg_read_lat_us,
+		fiops_bg_throttled(fiopsd) ? " throttling" : "");
+	return n;
+}
+
+static ssize_t fiops_latency_store(struct elevator_queue *e, const char *page,
+	size_t count)
+{
+	struct fiops_data *fiopsd = e->elevator_data;
+	struct request_queue *q = fiopsd->queue;
+
+	spin_lock_irq(q->queue_lock);
+	memset(fiopsd->lat, 0, sizeof(fiopsd->lat));
+	spin_unlock_irq(q->queue_lock);
+	return count;
+}
+
 #define FIOPS_ATTR(name) \
 	__ATTR(name, S_IRUGO|S_IWUSR, fiops_##name##_show, fiops_##name##_store)
 
@@ -704,6 +920,10 @@ static struct elv_fs_entry fiops_attrs[] = {
 	FIOPS_ATTR(write_scale),
 	FIOPS_ATTR(sync_scale),
 	FIOPS_ATTR(async_scale),
+	FIOPS_ATTR(bg_weight),
+	FIOPS_ATTR(fg_read_target_us),
+	FIOPS_ATTR(bg_async_depth),
+	FIOPS_ATTR(latency),
 	__ATTR_NULL
 };
 
@@ -23,6 +23,7 @@
 #include <linux/kthread.h>
 #include <linux/wait.h>
 #include <linux/async.h>
+#include <linux/boot_time.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
 
@@ -47,12 +48,19 @@
  *
  * The deferred_probe_mutex must be held any time the deferred_probe_*_list
  * of the (struct device*)->p->deferred_probe pointers are manipulated
+ *
+ * Drivers with probe_type PROBE_AFTER_FIRST_FRAME are put on the pending list
+ * without probing until driver_first_frame_done() is called, or until
+ * first_frame_timeout seconds after late_initcall if there is no display.
  */
 static DEFINE_MUTEX(deferred_probe_mutex);
 static LIST_HEAD(deferred_probe_pending_list);
 static LIST_HEAD(deferred_probe_active_list);
 static struct workqueue_struct *deferred_wq;
 static atomic_t deferred_trigger_count = ATOMIC_INIT(0);
+static bool first_frame_done;
+static unsigned int first_frame_timeout = 10;
+module_param(first_frame_timeout, uint, 0644);
 
 /**
  * deferred_probe_work_func() - Retry probing devices in the active list.
@@ -171,6 +179,31 @@ static void driver_deferred_probe_trigger(void)
 	queue_work(deferred_wq, &deferred_probe_work);
 }
 
+/**
+ * driver_first_frame_done() - Let the PROBE_AFTER_FIRST_FRAME drivers probe
+ *
+ * Called by the display driver once the first frame from user space is on
+ * the panel. Only the first call does anything.
+ */
+void driver_first_frame_done(void)
+{
+	if (xchg(&first_frame_done, true))
+		return;
+	boot_time_mark("first frame");
+	driver_deferred_probe_trigger();
+}
+EXPORT_SYMBOL_GPL(driver_first_frame_done);
+
+static void first_frame_timeout_func(struct work_struct *work)
+{
+	if (!first_frame_done)
+		pr_info("No first frame after %us, probing late drivers\n",
+			first_frame_timeout);
+	driver_first_frame_done();
+}
+static DECLARE_DELAYED_WORK(first_frame_timeout_work,
+			    first_frame_timeout_func);
+
 /**
  * deferred_probe_initcall() - Enable probing of deferred devices
  *
@@ -188,6 +221,8 @@ static int deferred_probe_initcall(void)
 	driver_deferred_probe_trigger();
 	/* Sort as many dependencies as possible before exiting initcalls */
 	flush_workqueue(deferred_wq);
+	queue_delayed_work(deferred_wq, &first_frame_timeout_work,
+			   first_frame_timeout * HZ);
 	return 0;
 }
 late_initcall(deferred_probe_initcall);
@@ -279,6 +314,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
+	ktime_t calltime = ktime_set(0, 0);
 
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
@@ -298,15 +334,16 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		goto probe_failed;
 	}
 
-	if (dev->bus->probe) {
+	if (boot_time_recording())
+		calltime = ktime_get();
+	if (dev->bus->probe)
 		ret = dev->bus->probe(dev);
-		if (ret)
-			goto probe_failed;
-	} else if (drv->probe) {
+	else if (drv->probe)
 		ret = drv->probe(dev);
-		if (ret)
-			goto probe_failed;
-	}
+	if (calltime.tv64)
+		boot_time_probe(dev, drv, ret, calltime, ktime_get());
+	if (ret)
+		goto probe_failed;
 
 	driver_bound(dev);
 	ret = 1;
@@ -388,10 +425,21 @@ EXPORT_SYMBOL_GPL(wait_for_device_probe);
 int driver_probe_device(struct device_driver *drv, struct device *dev)
 {
 	int ret = 0;
+	int local_trigger_count = atomic_read(&deferred_trigger_count);
 
 	if (!device_is_registered(dev))
 		return -ENODEV;
 
+	if (drv->probe_type == PROBE_AFTER_FIRST_FRAME && !first_frame_done) {
+		dev_dbg(dev, "Driver %s probes after the first frame\n",
+			drv->name);
+		driver_deferred_probe_add(dev);
+		/* first_frame_done may have been set since the check */
+		if (local_trigger_count != atomic_read(&deferred_trigger_count))
+			driver_deferred_probe_trigger();
+		return 0;
+	}
+
 	pr_debug("bus: '%s': %s: matched device %s with driver %s\n",
 		 drv->bus->name, __func__, dev_name(dev), drv->name);
 
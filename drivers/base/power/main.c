@@ -30,6 +30,7 @@
 #include <linux/suspend.h>
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
+#include <trace/events/power.h>
 
 #include "../base.h"
 #include "power.h"
@@ -366,6 +367,7 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 
 	calltime = ktime_get();
 	usecs64 = ktime_to_ns(ktime_sub(calltime, starttime));
+	trace_device_pm_phase_time(info, state.event, usecs64);
 	do_div(usecs64, NSEC_PER_USEC);
 	usecs = usecs64;
 	if (usecs == 0)
@@ -375,10 +377,35 @@ static void dpm_show_time(ktime_t starttime, pm_message_t state, char *info)
 		usecs / USEC_PER_MSEC, usecs % USEC_PER_MSEC);
 }
 
+/**
+ * pm_callback_timed - Report how long a device PM callback took.
+ * @dev: Device the callback ran for.
+ * @state: PM transition of the system being carried out.
+ * @info: Phase of the transition, as passed to pm_dev_dbg().
+ * @ns: Duration of the callback in sched_clock nanoseconds.
+ * @error: Value the callback returned.
+ *
+ * Platforms that profile suspend and resume override this.
+ */
+void __weak pm_callback_timed(struct device *dev, pm_message_t state,
+			      const char *info, u64 ns, int error)
+{
+}
+
+/**
+ * pm_callback_skipped - Report a device left runtime suspended on resume.
+ * @dev: Device whose resume callbacks were skipped.
+ * @state: PM transition of the system being carried out.
+ */
+void __weak pm_callback_skipped(struct device *dev, pm_message_t state)
+{
+}
+
 static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
 	ktime_t calltime;
+	u64 t;
 	int error;
 
 	if (!cb)
@@ -387,7 +414,9 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 	calltime = initcall_debug_start(dev);
 
 	pm_dev_dbg(dev, state, info);
+	t = local_clock();
 	error = cb(dev);
+	pm_callback_timed(dev, state, info, local_clock() - t, error);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
@@ -464,7 +493,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
-	if (dev->power.syscore)
+	if (dev->power.syscore || dev->power.direct_complete)
 		goto Out;
 
 	if (dev->pm_domain) {
@@ -546,7 +575,7 @@ static int device_resume_early(struct device *dev, pm_message_t state)
 	TRACE_DEVICE(dev);
 	TRACE_RESUME(0);
 
-	if (dev->power.syscore)
+	if (dev->power.syscore || dev->power.direct_complete)
 		goto Out;
 
 	if (dev->pm_domain) {
@@ -639,6 +668,13 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	if (dev->power.syscore)
 		goto Complete;
 
+	if (dev->power.direct_complete) {
+		/* Match the pm_runtime_disable() in __device_suspend(). */
+		pm_runtime_enable(dev);
+		pm_callback_skipped(dev, state);
+		goto Complete;
+	}
+
 	dpm_wait(dev->parent, async);
 	device_lock(dev);
 
@@ -906,7 +942,7 @@ static int device_suspend_noirq(struct device *dev, pm_message_t state)
 	pm_callback_t callback = NULL;
 	char *info = NULL;
 
-	if (dev->power.syscore)
+	if (dev->power.syscore || dev->power.direct_complete)
 		return 0;
 
 	if (dev->pm_domain) {
@@ -994,7 +1030,7 @@ static int device_suspend_late(struct device *dev, pm_message_t state)
 
 	__pm_runtime_disable(dev, false);
 
-	if (dev->power.syscore)
+	if (dev->power.syscore || dev->power.direct_complete)
 		return 0;
 
 	if (dev->pm_domain) {
@@ -1095,10 +1131,13 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 {
 	int error;
 	ktime_t calltime;
+	u64 t;
 
 	calltime = initcall_debug_start(dev);
 
+	t = local_clock();
 	error = cb(dev, state);
+	pm_callback_timed(dev, state, "legacy ", local_clock() - t, error);
 	suspend_report_result(cb, error);
 
 	initcall_debug_report(dev, calltime, error);
@@ -1121,8 +1160,10 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 
 	dpm_wait_for_children(dev, async);
 
-	if (async_error)
+	if (async_error) {
+		dev->power.direct_complete = false;
 		goto Complete;
+	}
 
 	/*
 	 * If a device configured to wake up the system from sleep states
@@ -1134,13 +1175,25 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 		pm_wakeup_event(dev, 0);
 
 	if (pm_wakeup_pending()) {
+		dev->power.direct_complete = false;
 		async_error = -EBUSY;
 		goto Complete;
 	}
 
 	if (dev->power.syscore)
 		goto Complete;
-	
+
+	if (dev->power.direct_complete) {
+		if (pm_runtime_status_suspended(dev)) {
+			pm_runtime_disable(dev);
+			if (pm_runtime_status_suspended(dev))
+				goto Complete;
+
+			pm_runtime_enable(dev);
+		}
+		dev->power.direct_complete = false;
+	}
+
 	dpm_wd_set(&wd, dev);
 
 	device_lock(dev);
@@ -1190,10 +1243,20 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 
  End:
 	if (!error) {
+		struct device *parent = dev->parent;
+
 		dev->power.is_suspended = true;
-		if (dev->power.wakeup_path
-		    && dev->parent && !dev->parent->power.ignore_children)
-			dev->parent->power.wakeup_path = true;
+		if (parent) {
+			spin_lock_irq(&parent->power.lock);
+
+			/* a suspended child has to be resumed below it */
+			parent->power.direct_complete = false;
+			if (dev->power.wakeup_path
+			    && !parent->power.ignore_children)
+				parent->power.wakeup_path = true;
+
+			spin_unlock_irq(&parent->power.lock);
+		}
 	}
 
 	device_unlock(dev);
@@ -1282,6 +1345,18 @@ int dpm_suspend(pm_message_t state)
 	return error;
 }
 
+/* Nothing would run for the device over the whole transition. */
+static bool device_no_pm_callbacks(struct device *dev)
+{
+	return !dev->pm_domain && !(dev->type && dev->type->pm) &&
+		!(dev->class && (dev->class->pm || dev->class->suspend ||
+				 dev->class->resume)) &&
+		!(dev->bus && (dev->bus->pm || dev->bus->suspend ||
+			       dev->bus->resume)) &&
+		!(dev->driver && (dev->driver->pm || dev->driver->suspend ||
+				  dev->driver->resume));
+}
+
 /**
  * device_prepare - Prepare a device for system power transition.
  * @dev: Device to handle.
@@ -1330,14 +1405,28 @@ static int device_prepare(struct device *dev, pm_message_t state)
 		callback = dev->driver->pm->prepare;
 	}
 
-	if (callback) {
+	if (callback)
 		error = callback(dev);
+
+	device_unlock(dev);
+
+	if (error < 0) {
 		suspend_report_result(callback, error);
+		return error;
 	}
 
-	device_unlock(dev);
+	/*
+	 * A positive value means the device may be left runtime suspended,
+	 * if it and all of its descendants still are when they suspend, and
+	 * so may devices without callbacks, so as not to hold their parent.
+	 * Only for suspend, hibernation images need the devices quiesced.
+	 */
+	spin_lock_irq(&dev->power.lock);
+	dev->power.direct_complete = state.event == PM_EVENT_SUSPEND &&
+		(error > 0 || device_no_pm_callbacks(dev));
+	spin_unlock_irq(&dev->power.lock);
 
-	return error;
+	return 0;
 }
 
 /**
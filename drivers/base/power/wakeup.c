@@ -14,6 +14,7 @@
 #include <linux/suspend.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/wakelock_profile.h>
 #include <trace/events/power.h>
 
 #include "power.h"
@@ -393,6 +394,7 @@ static void wakeup_source_activate(struct wakeup_source *ws)
 	ws->last_time = ktime_get();
 	if (ws->autosleep_enabled)
 		ws->start_prevent_time = ws->last_time;
+	pm_wakelock_profile_activate(ws, ws->last_time);
 
 	/* Increment the counter of events in progress. */
 	cec = atomic_inc_return(&combined_event_count);
@@ -516,6 +518,7 @@ static void wakeup_source_deactivate(struct wakeup_source *ws)
 
 	if (ws->autosleep_enabled)
 		update_prevent_sleep_time(ws, now);
+	pm_wakelock_profile_deactivate(ws, now, duration);
 
 	/*
 	 * Increment the counter of registered wakeup events and decrement the
@@ -310,6 +310,17 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt)
 }
 EXPORT_SYMBOL(sync_fence_create);
 
+/*
+ * A pt that has signaled without error adds nothing to a merged fence,
+ * so it is not duplicated. Most fences merged by a compositor are
+ * release fences of earlier frames that have signaled already. A stale
+ * read of 0 only costs the dup, status never goes back from 1.
+ */
+static bool sync_pt_merge_skip(struct sync_pt *pt)
+{
+	return ACCESS_ONCE(pt->status) == 1;
+}
+
 static int sync_fence_copy_pts(struct sync_fence *dst, struct sync_fence *src)
 {
 	struct list_head *pos;
@@ -317,7 +328,11 @@ static int sync_fence_copy_pts(struct sync_fence *dst, struct sync_fence *src)
 	list_for_each(pos, &src->pt_list_head) {
 		struct sync_pt *orig_pt =
 			container_of(pos, struct sync_pt, pt_list);
-		struct sync_pt *new_pt = sync_pt_dup(orig_pt);
+		struct sync_pt *new_pt;
+
+		if (sync_pt_merge_skip(orig_pt))
+			continue;
+		new_pt = sync_pt_dup(orig_pt);
 
 		if (new_pt == NULL)
 			return -ENOMEM;
@@ -338,6 +353,9 @@ static int sync_fence_merge_pts(struct sync_fence *dst, struct sync_fence *src)
 			container_of(src_pos, struct sync_pt, pt_list);
 		bool collapsed = false;
 
+		if (sync_pt_merge_skip(src_pt))
+			continue;
+
 		list_for_each_safe(dst_pos, n, &dst->pt_list_head) {
 			struct sync_pt *dst_pt =
 				container_of(dst_pos, struct sync_pt, pt_list);
@@ -465,6 +483,18 @@ struct sync_fence *sync_fence_merge(const char *name,
 	if (err < 0)
 		goto err;
 
+	/* both signaled, one pt keeps the fence signaled */
+	if (list_empty(&fence->pt_list_head)) {
+		struct sync_pt *pt = sync_pt_dup(
+			list_first_entry(&a->pt_list_head, struct sync_pt,
+					 pt_list));
+
+		if (pt == NULL)
+			goto err;
+		pt->fence = fence;
+		list_add(&pt->pt_list, &fence->pt_list_head);
+	}
+
 	list_for_each(pos, &fence->pt_list_head) {
 		struct sync_pt *pt =
 			container_of(pos, struct sync_pt, pt_list);
@@ -591,6 +621,10 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 	int err = 0;
 	struct sync_pt *pt;
 
+	/* signaled already, nothing to trace or wait for */
+	if (sync_fence_check(fence))
+		goto done;
+
 	trace_sync_wait(fence, 1);
 	list_for_each_entry(pt, &fence->pt_list_head, pt_list)
 		trace_sync_pt(pt);
@@ -608,6 +642,7 @@ int sync_fence_wait(struct sync_fence *fence, long timeout)
 
 	if (err < 0)
 		return err;
+done:
 
 	if (fence->status < 0) {
 		pr_info("fence error %d on [%p]\n", fence->status, fence);
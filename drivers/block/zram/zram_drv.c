@@ -34,6 +34,16 @@
 #include <linux/vmalloc.h>
 #include <linux/ratelimit.h>
 #include <linux/err.h>
+#include <linux/memcontrol.h>
+#ifdef CONFIG_ZRAM_WRITEBACK
+#include <linux/fs.h>
+#include <linux/file.h>
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+#include <linux/hash.h>
+#include <linux/jhash.h>
+#endif
+#include <linux/zpolicy.h>
 
 #include "zram_drv.h"
 
@@ -117,6 +127,26 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return scnprintf(buf, PAGE_SIZE, "%llu\n", val << PAGE_SHIFT);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	unsigned long nr_migrated;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	nr_migrated = zs_compact(zram->meta->mem_pool);
+	atomic64_add(nr_migrated, &zram->stats.pages_compacted);
+	zram_zpolicy_sync(zram->meta);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
 static ssize_t max_comp_streams_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -153,12 +183,35 @@ static ssize_t max_comp_streams_store(struct device *dev,
 	}
 
 	zram->max_comp_streams = num;
+	workqueue_set_max_active(zram->wq, num);
 	ret = len;
 out:
 	up_write(&zram->init_lock);
 	return ret;
 }
 
+static ssize_t async_write_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)zram->async_write);
+}
+
+static ssize_t async_write_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	/* queued bios finish on their own, no need to wait for them */
+	zram->async_write = val;
+	return len;
+}
+
 static ssize_t comp_algorithm_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -187,6 +240,41 @@ static ssize_t comp_algorithm_store(struct device *dev,
 	return len;
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	bool val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->use_dedup;
+	up_read(&zram->init_lock);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
+}
+
+static ssize_t use_dedup_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	if (kstrtoint(buf, 10, &val) || (val != 0 && val != 1))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change dedup usage for initialized device\n");
+		return -EBUSY;
+	}
+	zram->use_dedup = val;
+	up_write(&zram->init_lock);
+	return len;
+}
+#endif
+
 /* flag operations needs meta->tb_lock */
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
@@ -219,11 +307,285 @@ static void zram_set_obj_size(struct zram_meta *meta,
 	meta->table[index].value = (flags << ZRAM_FLAG_SHIFT) | size;
 }
 
+#ifdef CONFIG_ZRAM_MEMCG
+/* a shared dedup object is charged in full to each of its slots */
+static void zram_memcg_charge(struct zram_meta *meta, u32 index,
+			      struct page *page, size_t clen)
+{
+	if (PageSwapCache(page))
+		meta->table[index].memcg_id =
+			mem_cgroup_zram_charge(page, clen);
+}
+
+static void zram_memcg_uncharge(struct zram_meta *meta, u32 index)
+{
+	if (meta->table[index].memcg_id) {
+		mem_cgroup_zram_uncharge(meta->table[index].memcg_id,
+					 zram_get_obj_size(meta, index));
+		meta->table[index].memcg_id = 0;
+	}
+}
+#else
+static inline void zram_memcg_charge(struct zram_meta *meta, u32 index,
+				     struct page *page, size_t clen)
+{
+}
+
+static inline void zram_memcg_uncharge(struct zram_meta *meta, u32 index)
+{
+}
+#endif
+
 static inline int is_partial_io(struct bio_vec *bvec)
 {
 	return bvec->bv_len != PAGE_SIZE;
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+/* Pages written back in one bio, on contiguous blocks when possible */
+#define ZRAM_WB_BATCH	32
+
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct file *file;
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	file = zram->backing_dev;
+	if (!file) {
+		up_read(&zram->init_lock);
+		return scnprintf(buf, PAGE_SIZE, "none\n");
+	}
+
+	p = d_path(&file->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	char *file_name;
+	size_t sz;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	struct block_device *bdev = NULL;
+	unsigned long nr_pages, *bitmap = NULL;
+	struct zram *zram = dev_to_zram(dev);
+	int err;
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	reset_bdev(zram);
+	zram->backing_dev = backing_dev;
+	zram->bdev = bdev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+	up_write(&zram->init_lock);
+	kfree(file_name);
+
+	return err;
+}
+
+/* Reserve nr contiguous blocks, returns the first one or 0 */
+static unsigned long alloc_block_bdev(struct zram *zram, unsigned int nr)
+{
+	unsigned long blk_idx;
+
+	spin_lock(&zram->bitmap_lock);
+	blk_idx = bitmap_find_next_zero_area(zram->bitmap, zram->nr_pages,
+						1, nr, 0);
+	if (blk_idx >= zram->nr_pages)
+		blk_idx = 0;
+	else
+		bitmap_set(zram->bitmap, blk_idx, nr);
+	spin_unlock(&zram->bitmap_lock);
+
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx,
+				unsigned int nr)
+{
+	spin_lock(&zram->bitmap_lock);
+	bitmap_clear(zram->bitmap, blk_idx, nr);
+	spin_unlock(&zram->bitmap_lock);
+}
+
+static int read_from_bdev_sync(struct zram *zram, unsigned long blk_idx,
+				void *buf)
+{
+	struct page *page;
+	struct bio *bio;
+	void *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio) {
+		__free_page(page);
+		return -ENOMEM;
+	}
+
+	bio->bi_bdev = zram->bdev;
+	bio->bi_sector = blk_idx << SECTORS_PER_PAGE_SHIFT;
+	bio_add_page(bio, page, PAGE_SIZE, 0);
+	atomic64_inc(&zram->stats.bd_reads);
+	ret = submit_bio_wait(READ, bio);
+	bio_put(bio);
+
+	if (!ret) {
+		src = kmap_atomic(page);
+		memcpy(buf, src, PAGE_SIZE);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+
+	return ret;
+}
+
+static void zram_bdev_read_endio(struct bio *bio, int err)
+{
+	struct bio *parent = bio->bi_private;
+
+	if (!err && !test_bit(BIO_UPTODATE, &bio->bi_flags))
+		err = -EIO;
+	bio_put(bio);
+
+	if (!err)
+		set_bit(BIO_UPTODATE, &parent->bi_flags);
+	bio_endio(parent, err);
+}
+
+/*
+ * Read the page of block blk_idx into bvec. A single page request is read
+ * straight into its page and completed from the backing device's endio,
+ * in that case 1 is returned.
+ */
+static int zram_bvec_read_bdev(struct zram *zram, struct bio_vec *bvec,
+			unsigned long blk_idx, int offset, struct bio *parent)
+{
+	unsigned char *user_mem, *buf;
+	struct bio *bio;
+	int ret;
+
+	if (!is_partial_io(bvec) && bio_segments(parent) == 1) {
+		bio = bio_alloc(GFP_NOIO, 1);
+		if (!bio)
+			return -ENOMEM;
+
+		bio->bi_bdev = zram->bdev;
+		bio->bi_sector = blk_idx << SECTORS_PER_PAGE_SHIFT;
+		bio_add_page(bio, bvec->bv_page, bvec->bv_len,
+				bvec->bv_offset);
+		bio->bi_end_io = zram_bdev_read_endio;
+		bio->bi_private = parent;
+		atomic64_inc(&zram->stats.bd_reads);
+		submit_bio(READ, bio);
+		return 1;
+	}
+
+	buf = kmalloc(PAGE_SIZE, GFP_NOIO);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = read_from_bdev_sync(zram, blk_idx, buf);
+	if (!ret) {
+		user_mem = kmap_atomic(bvec->bv_page);
+		memcpy(user_mem + bvec->bv_offset, buf + offset,
+				bvec->bv_len);
+		kunmap_atomic(user_mem);
+		flush_dcache_page(bvec->bv_page);
+	}
+	kfree(buf);
+
+	return ret;
+}
+#endif
+
 /*
  * Check if request is within bounds and aligned on zram logical blocks.
  */
@@ -248,14 +610,48 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 	return 1;
 }
 
+#ifdef CONFIG_ZPOLICY
+/*
+ * Bring the pageframes charged to the shared compressed memory budget
+ * in line with the pool. Pages freed by zs_free() or compaction are
+ * given back on the next call; returns false if the pool grew beyond
+ * the budget, in which case the growth is not charged.
+ */
+static bool zram_zpolicy_sync(struct zram_meta *meta)
+{
+	long cur = zs_get_total_pages(meta->mem_pool);
+	long delta = cur - atomic_long_xchg(&meta->zpolicy_pages, cur);
+
+	if (delta < 0) {
+		zpolicy_uncharge(ZPOLICY_ANON, -delta);
+	} else if (delta > 0 && !zpolicy_charge(ZPOLICY_ANON, delta)) {
+		atomic_long_sub(delta, &meta->zpolicy_pages);
+		return false;
+	}
+	return true;
+}
+#else
+static inline bool zram_zpolicy_sync(struct zram_meta *meta)
+{
+	return true;
+}
+#endif
+
 static void zram_meta_free(struct zram_meta *meta)
 {
+#ifdef CONFIG_ZPOLICY
+	zpolicy_uncharge(ZPOLICY_ANON, atomic_long_read(&meta->zpolicy_pages));
+#endif
 	zs_destroy_pool(meta->mem_pool);
+#ifdef CONFIG_ZRAM_DEDUP
+	vfree(meta->dedup_hash);
+#endif
 	vfree(meta->table);
 	kfree(meta);
 }
 
-static struct zram_meta *zram_meta_alloc(u64 disksize)
+static struct zram_meta *zram_meta_alloc(const char *pool_name, u64 disksize,
+					bool dedup)
 {
 	size_t num_pages;
 	struct zram_meta *meta = kmalloc(sizeof(*meta), GFP_KERNEL);
@@ -269,15 +665,35 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 		goto free_meta;
 	}
 
-	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM |
+	meta->mem_pool = zs_create_pool(pool_name, GFP_NOIO | __GFP_HIGHMEM |
 					__GFP_NOWARN);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
 		goto free_table;
 	}
+#ifdef CONFIG_ZPOLICY
+	atomic_long_set(&meta->zpolicy_pages, 0);
+#endif
+
+#ifdef CONFIG_ZRAM_DEDUP
+	spin_lock_init(&meta->dedup_lock);
+	meta->dedup_hash = NULL;
+	if (dedup) {
+		meta->dedup_hash = vzalloc(sizeof(struct hlist_head) <<
+						ZRAM_DEDUP_HASH_BITS);
+		if (!meta->dedup_hash) {
+			pr_err("Error allocating dedup hash table\n");
+			goto free_pool;
+		}
+	}
+#endif
 
 	return meta;
 
+#ifdef CONFIG_ZRAM_DEDUP
+free_pool:
+	zs_destroy_pool(meta->mem_pool);
+#endif
 free_table:
 	vfree(meta->table);
 free_meta:
@@ -294,28 +710,41 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
 
 	page = (unsigned long *)ptr;
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != page[0])
 			return 0;
 	}
 
+	*element = page[0];
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned int len, unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned int pos;
+
+	for (pos = 0; pos != len / sizeof(*page); pos++)
+		page[pos] = value;
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
-	if (is_partial_io(bvec))
+	if (element)
+		zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len,
+				element);
+	else if (is_partial_io(bvec))
 		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
 	else
 		clear_page(user_mem);
@@ -324,6 +753,95 @@ static void handle_zero_page(struct bio_vec *bvec)
 	flush_dcache_page(page);
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+/* Take a reference to a stored object with the same compressed data */
+static struct zram_dedup_entry *zram_dedup_find(struct zram *zram,
+				void *mem, size_t len, u32 checksum)
+{
+	struct zram_meta *meta = zram->meta;
+	struct hlist_head *head;
+	struct zram_dedup_entry *entry;
+	unsigned char *cmem;
+	int match;
+
+	head = &meta->dedup_hash[hash_32(checksum, ZRAM_DEDUP_HASH_BITS)];
+	spin_lock(&meta->dedup_lock);
+	hlist_for_each_entry(entry, head, node) {
+		if (entry->checksum != checksum || entry->len != len)
+			continue;
+
+		cmem = zs_map_object(meta->mem_pool, entry->handle, ZS_MM_RO);
+		match = !memcmp(cmem, mem, len);
+		zs_unmap_object(meta->mem_pool, entry->handle);
+		if (match) {
+			entry->refcount++;
+			spin_unlock(&meta->dedup_lock);
+			return entry;
+		}
+	}
+	spin_unlock(&meta->dedup_lock);
+
+	return NULL;
+}
+
+static struct zram_dedup_entry *zram_dedup_insert(struct zram *zram,
+				unsigned long handle, size_t len, u32 checksum)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_dedup_entry *entry;
+
+	/* the object is just not shared without an entry */
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return NULL;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+
+	spin_lock(&meta->dedup_lock);
+	hlist_add_head(&entry->node,
+		&meta->dedup_hash[hash_32(checksum, ZRAM_DEDUP_HASH_BITS)]);
+	spin_unlock(&meta->dedup_lock);
+
+	return entry;
+}
+
+/*
+ * Drop the slot's reference to its shared object, returns true when other
+ * slots still use it and it must not be freed.
+ */
+static bool zram_dedup_put(struct zram *zram, size_t index)
+{
+	struct zram_meta *meta = zram->meta;
+	struct zram_dedup_entry *entry = meta->table[index].dedup;
+	bool shared;
+
+	if (!entry)
+		return false;
+
+	meta->table[index].dedup = NULL;
+	spin_lock(&meta->dedup_lock);
+	shared = --entry->refcount > 0;
+	if (!shared)
+		hlist_del(&entry->node);
+	spin_unlock(&meta->dedup_lock);
+
+	if (shared)
+		atomic64_sub(entry->len, &zram->stats.dedup_saved_bytes);
+	else
+		kfree(entry);
+
+	return shared;
+}
+#else
+static inline bool zram_dedup_put(struct zram *zram, size_t index)
+{
+	return false;
+}
+#endif
+
 
 /*
  * To protect concurrent access to the same index entry,
@@ -335,6 +853,28 @@ static void zram_free_page(struct zram *zram, size_t index)
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+	/* tells a running writeback that this copy is stale */
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, handle, 1);
+		meta->table[index].handle = 0;
+		atomic64_dec(&zram->stats.bd_count);
+		atomic64_dec(&zram->stats.pages_stored);
+		return;
+	}
+#endif
+
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		meta->table[index].handle = 0;
+		atomic64_dec(&zram->stats.same_pages);
+		return;
+	}
+
 	if (unlikely(!handle)) {
 		/*
 		 * No memory is allocated for zero filled pages.
@@ -347,11 +887,13 @@ static void zram_free_page(struct zram *zram, size_t index)
 		return;
 	}
 
-	zs_free(meta->mem_pool, handle);
-
-	atomic64_sub(zram_get_obj_size(meta, index),
-			&zram->stats.compr_data_size);
+	if (!zram_dedup_put(zram, index)) {
+		zs_free(meta->mem_pool, handle);
+		atomic64_sub(zram_get_obj_size(meta, index),
+				&zram->stats.compr_data_size);
+	}
 	atomic64_dec(&zram->stats.pages_stored);
+	zram_memcg_uncharge(meta, index);
 
 	meta->table[index].handle = 0;
 	zram_set_obj_size(meta, index, 0);
@@ -366,9 +908,22 @@ static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
 	size_t size;
 
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* moved to the backing device, the caller has to read it there */
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return -EAGAIN;
+	}
+#endif
 	handle = meta->table[index].handle;
 	size = zram_get_obj_size(meta, index);
 
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		zram_fill_page(mem, PAGE_SIZE, handle);
+		return 0;
+	}
+
 	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 		clear_page(mem);
@@ -401,11 +956,30 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct zram_meta *meta = zram->meta;
 	page = bvec->bv_page;
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+retry:
+#endif
 	bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	zram_clear_flag(meta, index, ZRAM_IDLE);
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		unsigned long blk_idx = meta->table[index].handle;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		return zram_bvec_read_bdev(zram, bvec, blk_idx, offset, bio);
+	}
+#endif
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].handle;
+
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+		handle_same_page(bvec, element);
+		return 0;
+	}
 	if (unlikely(!meta->table[index].handle) ||
 			zram_test_flag(meta, index, ZRAM_ZERO)) {
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
-		handle_zero_page(bvec);
+		handle_same_page(bvec, 0);
 		return 0;
 	}
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
@@ -439,6 +1013,13 @@ out_cleanup:
 	kunmap_atomic(user_mem);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* written back since the check above */
+	if (ret == -EAGAIN) {
+		uncmem = NULL;
+		goto retry;
+	}
+#endif
 	return ret;
 }
 
@@ -454,6 +1035,12 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	static unsigned long zram_rs_time;
 	struct zcomp_strm *zstrm;
 	bool locked = false;
+	unsigned long element;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_dedup_entry *entry = NULL;
+	u32 checksum = 0;
+#endif
+	bool dup = false;
 
 	page = bvec->bv_page;
 	if (is_partial_io(bvec)) {
@@ -467,6 +1054,17 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			goto out;
 		}
 		ret = zram_decompress_page(zram, uncmem, index);
+#ifdef CONFIG_ZRAM_WRITEBACK
+		if (ret == -EAGAIN) {
+			unsigned long blk_idx;
+
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+			blk_idx = meta->table[index].handle;
+			bit_spin_unlock(ZRAM_ACCESS,
+					&meta->table[index].value);
+			ret = read_from_bdev_sync(zram, blk_idx, uncmem);
+		}
+#endif
 		if (ret)
 			goto out;
 	}
@@ -484,15 +1082,23 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
+	if (page_same_filled(uncmem, &element)) {
 		kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
 		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
 		zram_free_page(zram, index);
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		if (element) {
+			zram_set_flag(meta, index, ZRAM_SAME);
+			meta->table[index].handle = element;
+		} else {
+			zram_set_flag(meta, index, ZRAM_ZERO);
+		}
 		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
-		atomic64_inc(&zram->stats.zero_pages);
+		if (element)
+			atomic64_inc(&zram->stats.same_pages);
+		else
+			atomic64_inc(&zram->stats.zero_pages);
 		ret = 0;
 		goto out;
 	}
@@ -515,6 +1121,22 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			src = uncmem;
 	}
 
+#ifdef CONFIG_ZRAM_DEDUP
+	/* incompressible pages are stored straight from the page */
+	if (meta->dedup_hash && clen != PAGE_SIZE) {
+		checksum = jhash(src, clen, 0);
+		entry = zram_dedup_find(zram, src, clen, checksum);
+		if (entry) {
+			handle = entry->handle;
+			dup = true;
+			zcomp_strm_release(zram->comp, zstrm);
+			locked = false;
+			atomic64_add(clen, &zram->stats.dedup_saved_bytes);
+			goto store;
+		}
+	}
+#endif
+
 	handle = zs_malloc(meta->mem_pool, clen);
 	if (!handle) {
 		if (printk_timed_ratelimit(&zram_rs_time,
@@ -538,6 +1160,18 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 	locked = false;
 	zs_unmap_object(meta->mem_pool, handle);
 
+	/* the pool may not grow past the budget shared with zcache */
+	if (!zram_zpolicy_sync(meta)) {
+		zs_free(meta->mem_pool, handle);
+		ret = -ENOMEM;
+		goto out;
+	}
+
+#ifdef CONFIG_ZRAM_DEDUP
+	if (meta->dedup_hash && clen != PAGE_SIZE)
+		entry = zram_dedup_insert(zram, handle, clen, checksum);
+store:
+#endif
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
@@ -547,10 +1181,19 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 
 	meta->table[index].handle = handle;
 	zram_set_obj_size(meta, index, clen);
+#ifdef CONFIG_ZRAM_DEDUP
+	meta->table[index].dedup = entry;
+#endif
+	zram_memcg_charge(meta, index, page, clen);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	if (clen == PAGE_SIZE)
+		zram_set_flag(meta, index, ZRAM_HUGE);
+#endif
 	bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
 
 	/* Update stats */
-	atomic64_add(clen, &zram->stats.compr_data_size);
+	if (!dup)
+		atomic64_add(clen, &zram->stats.compr_data_size);
 	atomic64_inc(&zram->stats.pages_stored);
 out:
 	if (locked)
@@ -574,7 +1217,7 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 		ret = zram_bvec_write(zram, bvec, index, offset);
 	}
 
-	if (unlikely(ret)) {
+	if (unlikely(ret < 0)) {
 		if (rw == READ)
 			atomic64_inc(&zram->stats.failed_reads);
 		else
@@ -622,6 +1265,210 @@ static void zram_bio_discard(struct zram *zram, u32 index,
 	}
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	size_t index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[index].value);
+		if (meta->table[index].handle &&
+				!zram_test_flag(meta, index, ZRAM_WB) &&
+				!zram_test_flag(meta, index, ZRAM_SAME))
+			zram_set_flag(meta, index, ZRAM_IDLE);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[index].value);
+	}
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+/*
+ * Write the nr pages collected for slots index[] to the backing device and
+ * point the slots still holding the same data at them.
+ */
+static int zram_writeback_batch(struct zram *zram, struct page **pages,
+			u32 *index, unsigned int nr, bool idle)
+{
+	struct zram_meta *meta = zram->meta;
+	unsigned long blk_idx;
+	unsigned int done = 0, cnt, i;
+	struct bio *bio;
+	int ret = 0;
+
+	while (done < nr) {
+		blk_idx = 0;
+		for (cnt = nr - done; cnt; cnt /= 2) {
+			blk_idx = alloc_block_bdev(zram, cnt);
+			if (blk_idx)
+				break;
+		}
+		if (!blk_idx) {
+			ret = -ENOSPC;
+			break;
+		}
+
+		bio = bio_alloc(GFP_KERNEL, cnt);
+		if (!bio) {
+			free_block_bdev(zram, blk_idx, cnt);
+			ret = -ENOMEM;
+			break;
+		}
+		bio->bi_bdev = zram->bdev;
+		bio->bi_sector = blk_idx << SECTORS_PER_PAGE_SHIFT;
+		for (i = 0; i < cnt; i++)
+			if (bio_add_page(bio, pages[done + i], PAGE_SIZE, 0) !=
+					PAGE_SIZE)
+				break;
+		if (!i) {
+			bio_put(bio);
+			free_block_bdev(zram, blk_idx, cnt);
+			ret = -EIO;
+			break;
+		}
+		/* hit the queue limits, the rest goes into the next bio */
+		if (i < cnt) {
+			free_block_bdev(zram, blk_idx + i, cnt - i);
+			cnt = i;
+		}
+
+		ret = submit_bio_wait(WRITE, bio);
+		bio_put(bio);
+		if (ret) {
+			free_block_bdev(zram, blk_idx, cnt);
+			break;
+		}
+		atomic64_add(cnt, &zram->stats.bd_writes);
+
+		for (i = 0; i < cnt; i++, done++) {
+			u32 idx = index[done];
+
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[idx].value);
+			/* freed, rewritten or, for idle pages, read meanwhile */
+			if (!zram_test_flag(meta, idx, ZRAM_UNDER_WB) ||
+				(idle && !zram_test_flag(meta, idx, ZRAM_IDLE))) {
+				zram_clear_flag(meta, idx, ZRAM_UNDER_WB);
+				bit_spin_unlock(ZRAM_ACCESS,
+						&meta->table[idx].value);
+				free_block_bdev(zram, blk_idx + i, 1);
+				continue;
+			}
+
+			zram_free_page(zram, idx);
+			zram_set_flag(meta, idx, ZRAM_WB);
+			meta->table[idx].handle = blk_idx + i;
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[idx].value);
+			atomic64_inc(&zram->stats.pages_stored);
+			atomic64_inc(&zram->stats.bd_count);
+		}
+	}
+
+	/* pages left in memory when the backing device failed or filled up */
+	for (; done < nr; done++) {
+		u32 idx = index[done];
+
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[idx].value);
+		zram_clear_flag(meta, idx, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[idx].value);
+	}
+
+	return ret;
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	struct page *pages[ZRAM_WB_BATCH];
+	u32 index[ZRAM_WB_BATCH];
+	unsigned int nr = 0, i;
+	unsigned long nr_slots, idx;
+	enum zram_pageflags flag;
+	ssize_t ret = 0;
+
+	if (sysfs_streq(buf, "idle"))
+		flag = ZRAM_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		flag = ZRAM_HUGE;
+	else
+		return -EINVAL;
+
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			while (i)
+				__free_page(pages[--i]);
+			return -ENOMEM;
+		}
+	}
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	meta = zram->meta;
+	nr_slots = zram->disksize >> PAGE_SHIFT;
+	for (idx = 0; idx < nr_slots; idx++) {
+		bit_spin_lock(ZRAM_ACCESS, &meta->table[idx].value);
+		if (!meta->table[idx].handle ||
+			zram_test_flag(meta, idx, ZRAM_SAME) ||
+			zram_test_flag(meta, idx, ZRAM_WB) ||
+			zram_test_flag(meta, idx, ZRAM_UNDER_WB) ||
+			!zram_test_flag(meta, idx, flag)) {
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[idx].value);
+			continue;
+		}
+		zram_set_flag(meta, idx, ZRAM_UNDER_WB);
+		bit_spin_unlock(ZRAM_ACCESS, &meta->table[idx].value);
+
+		if (zram_decompress_page(zram, page_address(pages[nr]), idx)) {
+			bit_spin_lock(ZRAM_ACCESS, &meta->table[idx].value);
+			zram_clear_flag(meta, idx, ZRAM_UNDER_WB);
+			bit_spin_unlock(ZRAM_ACCESS, &meta->table[idx].value);
+			continue;
+		}
+		index[nr++] = idx;
+
+		if (nr == ZRAM_WB_BATCH) {
+			ret = zram_writeback_batch(zram, pages, index, nr,
+						flag == ZRAM_IDLE);
+			nr = 0;
+			if (ret)
+				break;
+		}
+	}
+	if (nr)
+		ret = zram_writeback_batch(zram, pages, index, nr,
+					flag == ZRAM_IDLE);
+out:
+	up_read(&zram->init_lock);
+	for (i = 0; i < ZRAM_WB_BATCH; i++)
+		__free_page(pages[i]);
+
+	return ret ? ret : len;
+}
+#endif
+
 static void zram_reset_device(struct zram *zram, bool reset_capacity)
 {
 	size_t index;
@@ -637,17 +1484,36 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+
+		zram_memcg_uncharge(meta, index);
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME))
+			continue;
+#ifdef CONFIG_ZRAM_WRITEBACK
+		/* handle is a backing device block */
+		if (zram_test_flag(meta, index, ZRAM_WB))
+			continue;
+#endif
+		/* shared objects are freed with their last slot */
+		if (zram_dedup_put(zram, index))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
 	}
 
+	/* bios queued before init_lock was taken still use meta */
+	if (zram->wq)
+		flush_workqueue(zram->wq);
+
 	zcomp_destroy(zram->comp);
 	zram->max_comp_streams = 1;
+	if (zram->wq)
+		workqueue_set_max_active(zram->wq, 1);
 
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	reset_bdev(zram);
+#endif
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
 
@@ -680,7 +1546,12 @@ static ssize_t disksize_store(struct device *dev,
 		return -EINVAL;
 
 	disksize = PAGE_ALIGN(disksize);
-	meta = zram_meta_alloc(disksize);
+#ifdef CONFIG_ZRAM_DEDUP
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize,
+				zram->use_dedup);
+#else
+	meta = zram_meta_alloc(zram->disk->disk_name, disksize, false);
+#endif
 	if (!meta)
 		return -ENOMEM;
 
@@ -780,6 +1651,7 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 
 	bio_for_each_segment(bvec, bio, i) {
 		int max_transfer_size = PAGE_SIZE - offset;
+		int ret;
 
 		if (bvec->bv_len > max_transfer_size) {
 			/*
@@ -799,9 +1671,14 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 			bv.bv_offset += max_transfer_size;
 			if (zram_bvec_rw(zram, &bv, index + 1, 0, bio) < 0)
 				goto out;
-		} else
-			if (zram_bvec_rw(zram, bvec, index, offset, bio) < 0)
+		} else {
+			ret = zram_bvec_rw(zram, bvec, index, offset, bio);
+			if (ret < 0)
 				goto out;
+			/* completed by the backing device read */
+			if (ret > 0)
+				return;
+		}
 
 		update_position(&index, &offset, bvec);
 	}
@@ -814,6 +1691,57 @@ out:
 	bio_io_error(bio);
 }
 
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	struct bio *bio;
+};
+
+static void zram_write_work(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+	struct zram *zram = zw->zram;
+
+	__zram_make_request(zram, zw->bio);
+	kfree(zw);
+	atomic_dec(&zram->async_pending);
+}
+
+/*
+ * Hand a write bio to a compression worker, so that the submitter, most
+ * often kswapd, is not bound to compression while other cores idle.
+ * Returns false when the bio has to be handled synchronously: queue full
+ * or no memory for the work item, which never waits so that reclaim
+ * always makes progress.
+ */
+static bool zram_queue_write(struct zram *zram, struct bio *bio)
+{
+	struct zram_work *zw;
+
+	if (!zram->async_write || (bio_data_dir(bio) != WRITE) ||
+			(bio->bi_rw & REQ_DISCARD))
+		return false;
+
+	if (atomic_inc_return(&zram->async_pending) >
+			zram->max_comp_streams * async_write_depth)
+		goto sync;
+
+	zw = kmalloc(sizeof(*zw), GFP_NOWAIT | __GFP_NOWARN);
+	if (!zw)
+		goto sync;
+
+	INIT_WORK(&zw->work, zram_write_work);
+	zw->zram = zram;
+	zw->bio = bio;
+	queue_work(zram->wq, &zw->work);
+	atomic64_inc(&zram->stats.async_writes);
+	return true;
+
+sync:
+	atomic_dec(&zram->async_pending);
+	return false;
+}
+
 /*
  * Handler function for all zram I/O requests.
  */
@@ -830,7 +1758,8 @@ static int zram_make_request(struct request_queue *queue, struct bio *bio)
 		goto error;
 	}
 
-	__zram_make_request(zram, bio);
+	if (!zram_queue_write(zram, bio))
+		__zram_make_request(zram, bio);
 	up_read(&zram->init_lock);
 
 	return 0;
@@ -868,10 +1797,23 @@ static DEVICE_ATTR(initstate, S_IRUGO, initstate_show, NULL);
 static DEVICE_ATTR(reset, S_IWUSR, NULL, reset_store);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
 static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
 		max_comp_streams_show, max_comp_streams_store);
 static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
 		comp_algorithm_show, comp_algorithm_store);
+static DEVICE_ATTR(async_write, S_IRUGO | S_IWUSR,
+		async_write_show, async_write_store);
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR(use_dedup, S_IRUGO | S_IWUSR,
+		use_dedup_show, use_dedup_store);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+#endif
 
 ZRAM_ATTR_RO(num_reads);
 ZRAM_ATTR_RO(num_writes);
@@ -881,6 +1823,17 @@ ZRAM_ATTR_RO(invalid_io);
 ZRAM_ATTR_RO(notify_free);
 ZRAM_ATTR_RO(zero_pages);
 ZRAM_ATTR_RO(compr_data_size);
+ZRAM_ATTR_RO(same_pages);
+ZRAM_ATTR_RO(async_writes);
+ZRAM_ATTR_RO(pages_compacted);
+#ifdef CONFIG_ZRAM_DEDUP
+ZRAM_ATTR_RO(dedup_saved_bytes);
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+ZRAM_ATTR_RO(bd_count);
+ZRAM_ATTR_RO(bd_reads);
+ZRAM_ATTR_RO(bd_writes);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -893,11 +1846,28 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_compact.attr,
+	&dev_attr_pages_compacted.attr,
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_dedup_saved_bytes.attr,
+	&dev_attr_use_dedup.attr,
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_bd_count.attr,
+	&dev_attr_bd_reads.attr,
+	&dev_attr_bd_writes.attr,
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+#endif
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+	&dev_attr_async_write.attr,
+	&dev_attr_async_writes.attr,
 	NULL,
 };
 
@@ -910,12 +1880,25 @@ static int create_device(struct zram *zram, int device_id)
 	int ret = -ENOMEM;
 
 	init_rwsem(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	spin_lock_init(&zram->bitmap_lock);
+#endif
+
+	/* compression workers backing async_write, max_comp_streams sized */
+	zram->wq = alloc_workqueue("zram%d", WQ_UNBOUND | WQ_MEM_RECLAIM, 1,
+					device_id);
+	if (!zram->wq) {
+		pr_err("Error allocating workqueue for device %d\n",
+			device_id);
+		goto out;
+	}
+	atomic_set(&zram->async_pending, 0);
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
 		pr_err("Error allocating disk queue for device %d\n",
 			device_id);
-		goto out;
+		goto out_destroy_wq;
 	}
 
 	blk_queue_make_request(zram->queue, zram_make_request);
@@ -983,6 +1966,9 @@ out_free_disk:
 	put_disk(zram->disk);
 out_free_queue:
 	blk_cleanup_queue(zram->queue);
+out_destroy_wq:
+	destroy_workqueue(zram->wq);
+	zram->wq = NULL;
 out:
 	return ret;
 }
@@ -996,6 +1982,9 @@ static void destroy_device(struct zram *zram)
 	put_disk(zram->disk);
 
 	blk_cleanup_queue(zram->queue);
+
+	destroy_workqueue(zram->wq);
+	zram->wq = NULL;
 }
 
 static int __init zram_init(void)
@@ -17,6 +17,7 @@
 #define _ZRAM_DRV_H_
 
 #include <linux/spinlock.h>
+#include <linux/workqueue.h>
 #include <linux/zsmalloc.h>
 
 #include "zcomp.h"
@@ -41,6 +42,12 @@ static const size_t max_zpage_size = PAGE_SIZE / 10 * 9;
  * always return failure.
  */
 
+/*
+ * Write bios queued to the compression workers per compression stream,
+ * more are compressed by the submitter.
+ */
+static const unsigned int async_write_depth = 4;
+
 /*-- End of configurable params */
 
 #define SECTOR_SHIFT		9
@@ -69,16 +76,42 @@ enum zram_pageflags {
 	/* Page consists entirely of zeros */
 	ZRAM_ZERO = ZRAM_FLAG_SHIFT + 1,
 	ZRAM_ACCESS,	/* page in now accessed */
+	ZRAM_SAME,	/* Page is one repeated word, kept in handle */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	ZRAM_WB,	/* page is on the backing device, handle is its block */
+	ZRAM_UNDER_WB,	/* page is being written back */
+	ZRAM_IDLE,	/* not accessed since the last idle marking */
+	ZRAM_HUGE,	/* incompressible page */
+#endif
 
 	__NR_ZRAM_PAGEFLAGS,
 };
 
 /*-- Data structures */
 
+#ifdef CONFIG_ZRAM_DEDUP
+#define ZRAM_DEDUP_HASH_BITS	12
+
+/* A compressed object shared by all slots with the same content */
+struct zram_dedup_entry {
+	struct hlist_node node;
+	unsigned long handle;
+	size_t len;
+	u32 checksum;
+	unsigned int refcount;	/* protected by meta->dedup_lock */
+};
+#endif
+
 /* Allocated for each disk page */
 struct zram_table_entry {
 	unsigned long handle;
 	unsigned long value;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct zram_dedup_entry *dedup;
+#endif
+#ifdef CONFIG_ZRAM_MEMCG
+	unsigned short memcg_id;	/* css id the size is charged to */
+#endif
 };
 
 struct zram_stats {
@@ -90,12 +123,30 @@ struct zram_stats {
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
 	atomic64_t zero_pages;		/* no. of zero filled pages */
+	atomic64_t same_pages;	/* no. of pages filled with a non-zero word */
+	atomic64_t async_writes;	/* no. of write bios compressed by workers */
+	atomic64_t pages_compacted;	/* no. of pages freed by compaction */
+#ifdef CONFIG_ZRAM_DEDUP
+	atomic64_t dedup_saved_bytes;	/* compressed bytes shared by slots */
+#endif
 	atomic64_t pages_stored;	/* no. of pages currently stored */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;	/* no. of pages in backing device */
+	atomic64_t bd_reads;	/* no. of page reads from backing device */
+	atomic64_t bd_writes;	/* no. of page writes to backing device */
+#endif
 };
 
 struct zram_meta {
 	struct zram_table_entry *table;
 	struct zs_pool *mem_pool;
+#ifdef CONFIG_ZRAM_DEDUP
+	struct hlist_head *dedup_hash;	/* NULL when dedup is off */
+	spinlock_t dedup_lock;
+#endif
+#ifdef CONFIG_ZPOLICY
+	atomic_long_t zpolicy_pages;	/* charged to the zpolicy budget */
+#endif
 };
 
 struct zram {
@@ -112,7 +163,23 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	int max_comp_streams;
+	/* write bios handed to compression workers, bounded by
+	 * max_comp_streams * async_write_depth */
+	bool async_write;
+	atomic_t async_pending;
+	struct workqueue_struct *wq;
 	struct zram_stats stats;
 	char compressor[10];
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+#endif
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	/* blocks of PAGE_SIZE in use on bdev, block 0 is never used */
+	unsigned long nr_pages;
+	unsigned long *bitmap;
+	spinlock_t bitmap_lock;
+#endif
 };
 #endif
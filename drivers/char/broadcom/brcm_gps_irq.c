@@ -36,6 +36,10 @@
 #include <linux/workqueue.h>
 #include <linux/unistd.h>
 #include <linux/kthread.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/pm_wakeup.h>
+#include <linux/mutex.h>
 
 /*#define CONFIG_NEW_GPSCHIP_I2C*/
 #define GPS_VERSION	"2.00"
@@ -54,6 +58,30 @@
 #define RX_BUFFER_LENGTH		16384
 #define UDELAY_AFTER_I2C_READ	30
 
+/*
+ * The chunks read from the chip on host request go to a byte ring, in
+ * whole I2C packets with the old protocol. The reader is woken, and poll
+ * reports data, only once IOW_GPS_IRQ_SET_BATCH's wake_bytes are buffered
+ * or the oldest byte waited wake_ms, or the ring is 3/4 full; read always
+ * returns what there is. When the ring has no room for another chunk the
+ * rest stays in the chip until the reader makes room.
+ *
+ * Without batching, unread data holds a wakeup source. With batching the
+ * AP may suspend with data buffered here or in the chip, which is drained
+ * on resume, so it sleeps between position fixes.
+ */
+#define RX_HIGH_WATER		(RX_BUFFER_LENGTH - RX_BUFFER_LENGTH / 4)
+/* for the reader to get to the data once woken in batching mode */
+#define RX_BATCH_WAKE_MS	200
+
+struct gps_irq_stats {
+	u64 bytes;
+	u32 chunks;
+	u32 wakeups;
+	u32 stalls;		/* ring full, data left in the chip */
+	u32 errors;
+};
+
 int hostwake_gpio;
 
 struct gps_irq {
@@ -69,14 +97,24 @@ struct gps_irq {
 	int wbuffer_wp;
 	int txlength[TX_SIZE];
 
-	unsigned char rd_buffer[RX_SIZE][I2C_PACKET_SIZE];
+	/* the read work's chunk, with the length byte of the new protocol */
+	unsigned char rd_chunk[I2C_MAX_SIZE + 1];
 	unsigned char tmp[RX_BUFFER_LENGTH];
-
-	int rbuffer_rp;
-	int rbuffer_wp;
-	int rxlength[RX_SIZE];
-	int rxlength_rp;
-	int rxlength_wp;
+	struct mutex read_lock;		/* for tmp */
+
+	spinlock_t rx_lock;
+	/* under rx_lock */
+	unsigned char rx_ring[RX_BUFFER_LENGTH];
+	unsigned int rx_head;
+	unsigned int rx_tail;
+	unsigned long rx_first;		/* jiffies, data arrived in empty ring */
+	bool rx_stalled;
+	struct gps_irq_batch cfg;
+	struct gps_irq_stats stats;
+
+	struct timer_list rx_timer;
+	struct wakeup_source *ws;
+	struct dentry *debugfs;
 	struct work_struct read_task;
 	struct work_struct write_task;
 };
@@ -103,40 +141,117 @@ void write_workqueue(struct work_struct *work)
 	}
 }
 
+/* under rx_lock */
+static bool gps_irq_rx_ready(struct gps_irq *ac_data)
+{
+	unsigned int n = ac_data->rx_head - ac_data->rx_tail;
+
+	if (!n)
+		return false;
+	if (n >= ac_data->cfg.wake_bytes || n >= RX_HIGH_WATER ||
+	    ac_data->rx_stalled)
+		return true;
+	return ac_data->cfg.wake_ms &&
+		time_after_eq(jiffies, ac_data->rx_first +
+			      msecs_to_jiffies(ac_data->cfg.wake_ms));
+}
+
+/* under rx_lock */
+static void gps_irq_rx_wake(struct gps_irq *ac_data)
+{
+	if (!gps_irq_rx_ready(ac_data))
+		return;
+	ac_data->stats.wakeups++;
+	if (ac_data->cfg.batch)
+		__pm_wakeup_event(ac_data->ws, RX_BATCH_WAKE_MS);
+	wake_up_interruptible(&ac_data->wait);
+}
+
+static void gps_irq_rx_timer(unsigned long data)
+{
+	struct gps_irq *ac_data = (struct gps_irq *)data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ac_data->rx_lock, flags);
+	gps_irq_rx_wake(ac_data);
+	spin_unlock_irqrestore(&ac_data->rx_lock, flags);
+}
+
+/* room for one more chunk, else the rest waits in the chip */
+static bool gps_irq_rx_room(struct gps_irq *ac_data)
+{
+	unsigned long flags;
+	bool room;
+
+	spin_lock_irqsave(&ac_data->rx_lock, flags);
+	room = RX_BUFFER_LENGTH - (ac_data->rx_head - ac_data->rx_tail) >=
+		I2C_MAX_SIZE;
+	if (!room && !ac_data->rx_stalled) {
+		ac_data->rx_stalled = true;
+		ac_data->stats.stalls++;
+		gps_irq_rx_wake(ac_data);
+	}
+	spin_unlock_irqrestore(&ac_data->rx_lock, flags);
+	return room;
+}
+
+static void gps_irq_rx_push(struct gps_irq *ac_data,
+			    const unsigned char *p, int len)
+{
+	unsigned int at, k;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ac_data->rx_lock, flags);
+	if (ac_data->rx_head == ac_data->rx_tail) {
+		ac_data->rx_first = jiffies;
+		if (ac_data->cfg.wake_ms)
+			mod_timer(&ac_data->rx_timer, ac_data->rx_first +
+				  msecs_to_jiffies(ac_data->cfg.wake_ms));
+		if (!ac_data->cfg.batch)
+			__pm_stay_awake(ac_data->ws);
+	}
+	at = ac_data->rx_head & (RX_BUFFER_LENGTH - 1);
+	k = min_t(unsigned int, len, RX_BUFFER_LENGTH - at);
+	memcpy(ac_data->rx_ring + at, p, k);
+	memcpy(ac_data->rx_ring, p + k, len - k);
+	ac_data->rx_head += len;
+	ac_data->stats.bytes += len;
+	ac_data->stats.chunks++;
+	gps_irq_rx_wake(ac_data);
+	spin_unlock_irqrestore(&ac_data->rx_lock, flags);
+}
+
 void read_new(struct gps_irq *ac_data)
 {
 	int ret;
-	int i;
 
 	unsigned char plen;	  /* packet length */
 
 
-	while (1) {
+	while (gps_irq_rx_room(ac_data)) {
 		ret = i2c_master_recv(ac_data->client,
-			(char *)&ac_data->rd_buffer[ac_data->rbuffer_wp],
+			(char *)ac_data->rd_chunk,
 			1); /*lets read 1 byte first */
+		if (ret != 1) {
+			ac_data->stats.errors++;
+			break;
+		}
 
-		plen = ac_data->rd_buffer[ac_data->rbuffer_wp][0];
+		plen = ac_data->rd_chunk[0];
 		if (plen == 0)
 			break;
 
 		/* printk(KERN_INFO "read %d %",plen); */
 
 		ret = i2c_master_recv(ac_data->client,
-			(char *)&ac_data->rd_buffer[ac_data->rbuffer_wp],
+			(char *)ac_data->rd_chunk,
 			plen+1);
-		/* now get rid of the length byte */
-		for (i = 0; i < plen; ++i)
-			ac_data->rd_buffer[ac_data->rbuffer_wp][i] =
-			ac_data->rd_buffer[ac_data->rbuffer_wp][i+1];
-
-		ac_data->rxlength[ac_data->rxlength_wp] = plen;
-		ac_data->rbuffer_wp = (ac_data->rbuffer_wp+1)
-				& (RX_SIZE-1);
-		ac_data->rxlength_wp = (ac_data->rxlength_wp+1)
-				& (RX_SIZE-1);
-
-		wake_up_interruptible(&ac_data->wait);
+		if (ret != plen + 1) {
+			ac_data->stats.errors++;
+			break;
+		}
+		/* without the length byte */
+		gps_irq_rx_push(ac_data, ac_data->rd_chunk + 1, plen);
 	}
 }
 
@@ -160,7 +275,7 @@ void read_workqueue(struct work_struct *work)
 {
 	/* printk(KERN_INFO "read_workqueue 1\n"); */
 	int i;
-	int counter, ret;
+	int ret;
 	int kk;
 
 	struct gps_irq *ac_data =
@@ -172,42 +287,34 @@ void read_workqueue(struct work_struct *work)
 #else
 
 	kk = 0;
-	counter = 0;
 	i = __gpio_get_value(ac_data->host_req_pin);
 	if (i == 0)
 		return;
 
 	do	{
+		if (!gps_irq_rx_room(ac_data))
+			break;
+
 		ret = i2c_master_recv(ac_data->client,
-			(char *)&ac_data->rd_buffer[ac_data->rbuffer_wp],
+			(char *)ac_data->rd_chunk,
 			I2C_PACKET_SIZE);
 
 		if (ret != I2C_PACKET_SIZE) {
 			printk(KERN_INFO "GPS read error\n");
+			ac_data->stats.errors++;
 			i = __gpio_get_value(ac_data->host_req_pin);
 			continue;
 		}
 
-		if (ac_data->rd_buffer[ac_data->rbuffer_wp][0] == 0) {
+		if (ac_data->rd_chunk[0] == 0) {
 			++zero_read;
 			i = __gpio_get_value(ac_data->host_req_pin);
 			continue;
 		}
 
-		if (counter < RX_SIZE)	{
-			ac_data->rbuffer_wp = (ac_data->rbuffer_wp+1)
-				& (RX_SIZE-1);
-
-			if (ac_data->rbuffer_wp == ac_data->rbuffer_rp)
-				printk(KERN_INFO "read_workqueue overrun error\n");
-
-			ac_data->rxlength_wp = (ac_data->rxlength_wp+1) & (RX_SIZE-1);
-
-			wake_up_interruptible(&ac_data->wait);
-		}
+		gps_irq_rx_push(ac_data, ac_data->rd_chunk, I2C_PACKET_SIZE);
 
 		udelay(UDELAY_AFTER_I2C_READ);
-		++counter;
 
 		i = __gpio_get_value(ac_data->host_req_pin);
 	}  while (i == 1);
@@ -235,10 +342,13 @@ static int gps_irq_open(struct inode *inode, struct file *filp)
 							   misc);
 
 	filp->private_data = ac_data;
-	ac_data->rbuffer_rp = 0;
-	ac_data->rbuffer_wp = 0;
-	ac_data->rxlength_rp = 0;
-	ac_data->rxlength_wp = 0;
+	spin_lock_irq(&ac_data->rx_lock);
+	ac_data->rx_head = 0;
+	ac_data->rx_tail = 0;
+	ac_data->rx_stalled = false;
+	memset(&ac_data->cfg, 0, sizeof(ac_data->cfg));
+	__pm_relax(ac_data->ws);
+	spin_unlock_irq(&ac_data->rx_lock);
 
 	ac_data->wbuffer_rp = 0;
 	ac_data->wbuffer_wp = 0;
@@ -260,6 +370,10 @@ static int gps_irq_open(struct inode *inode, struct file *filp)
 
 static int gps_irq_release(struct inode *inode, struct file *filp)
 {
+	struct gps_irq *ac_data = filp->private_data;
+
+	del_timer_sync(&ac_data->rx_timer);
+	__pm_relax(ac_data->ws);
 #ifdef POLLING
 	if ((int)poll_thread_task != -ENOMEM)
 		kthread_stop(poll_thread_task);
@@ -272,73 +386,87 @@ static int gps_irq_release(struct inode *inode, struct file *filp)
 static unsigned int gps_irq_poll(struct file *filp, poll_table * wait)
 {
 	struct gps_irq *ac_data = filp->private_data;
+	unsigned int mask = 0;
 
 	poll_wait(filp, &ac_data->wait, wait);
 
-	if (ac_data->rxlength_wp != ac_data->rxlength_rp)
-		return POLLIN | POLLRDNORM;
-	return 0;
+	spin_lock_irq(&ac_data->rx_lock);
+	if (gps_irq_rx_ready(ac_data))
+		mask = POLLIN | POLLRDNORM;
+	spin_unlock_irq(&ac_data->rx_lock);
+	return mask;
 }
 
 static ssize_t gps_irq_read(struct file *filp,
 			    char *buffer, size_t length, loff_t * offset)
 {
 	struct gps_irq *ac_data = filp->private_data;
+	unsigned int n, at, k;
+	bool stalled;
+
+	mutex_lock(&ac_data->read_lock);
+	spin_lock_irq(&ac_data->rx_lock);
+	n = min_t(size_t, length, ac_data->rx_head - ac_data->rx_tail);
+#if !defined(CONFIG_NEW_GPSCHIP_I2C)
+	/* whole packets to those who can take one */
+	if (n >= I2C_PACKET_SIZE)
+		n -= n % I2C_PACKET_SIZE;
+#endif
+	at = ac_data->rx_tail & (RX_BUFFER_LENGTH - 1);
+	k = min(n, RX_BUFFER_LENGTH - at);
+	memcpy(ac_data->tmp, ac_data->rx_ring + at, k);
+	memcpy(ac_data->tmp + k, ac_data->rx_ring, n - k);
+	ac_data->rx_tail += n;
+	if (ac_data->rx_head == ac_data->rx_tail)
+		__pm_relax(ac_data->ws);
+	stalled = ac_data->rx_stalled;
+	ac_data->rx_stalled = false;
+	spin_unlock_irq(&ac_data->rx_lock);
+
+	/* the chip still has what did not fit */
+	if (stalled)
+		schedule_work(&ac_data->read_task);
+
+	if (n && copy_to_user(buffer, ac_data->tmp, n))
+		n = 0;
+	mutex_unlock(&ac_data->read_lock);
+	return n;
+}
 
-	/* printk(KERN_INFO "irq read pointers %d %d",
-		ac_data->rxlength_wp,
-		ac_data->rxlength_rp); */
-
-#if defined(CONFIG_NEW_GPSCHIP_I2C)
-	int l = 0;
-	int i, j;
-	if (ac_data->rxlength_rp != ac_data->rxlength_wp) {
-		i = ac_data->rxlength[ac_data->rxlength_rp];
-		if (i>length)
-		{
-			memcpy(ac_data->tmp+l,
-					&ac_data->rd_buffer[ac_data->rbuffer_rp],
-						length);
-			for (j=0;j<(i-length);++j)
-				ac_data->rd_buffer[ac_data->rbuffer_rp][j]=ac_data->rd_buffer[ac_data->rbuffer_rp][j+length];
-			l=length;
-			ac_data->rxlength[ac_data->rxlength_rp]=i-length;
-		}
-		else
-		{
-			memcpy(ac_data->tmp+l,
-					&ac_data->rd_buffer[ac_data->rbuffer_rp],
-						i);
-			l = i;
-			ac_data->rbuffer_rp =
-				(ac_data->rbuffer_rp+1) & (RX_SIZE-1);
-			ac_data->rxlength_rp = (ac_data->rxlength_rp+1) & (RX_SIZE-1);
-		}
-		if (copy_to_user(buffer, ac_data->tmp, l) != 0)
-			return 0;
-		return l;
-	} else
+static long gps_irq_ioctl(struct file *filp, unsigned int cmd,
+			  unsigned long arg)
+{
+	struct gps_irq *ac_data = filp->private_data;
+	struct gps_irq_batch cfg;
+
+	switch (cmd) {
+	case IOW_GPS_IRQ_SET_BATCH:
+		if (copy_from_user(&cfg, (void __user *)arg, sizeof(cfg)))
+			return -EFAULT;
+		spin_lock_irq(&ac_data->rx_lock);
+		ac_data->cfg = cfg;
+		if (cfg.batch)
+			__pm_relax(ac_data->ws);
+		else if (ac_data->rx_head != ac_data->rx_tail)
+			__pm_stay_awake(ac_data->ws);
+		if (cfg.wake_ms && ac_data->rx_head != ac_data->rx_tail)
+			mod_timer(&ac_data->rx_timer, ac_data->rx_first +
+				  msecs_to_jiffies(cfg.wake_ms));
+		gps_irq_rx_wake(ac_data);
+		spin_unlock_irq(&ac_data->rx_lock);
 		return 0;
-#else
-	if (ac_data->rxlength_rp != ac_data->rxlength_wp) {
-		//i = ac_data->rxlength[ac_data->rxlength_rp];
 
-		memcpy(ac_data->tmp,
-			&ac_data->rd_buffer[ac_data->rbuffer_rp],
-			I2C_PACKET_SIZE);
-
-		ac_data->rbuffer_rp =
-			(ac_data->rbuffer_rp+1) & (RX_SIZE-1);
-		
-		ac_data->rxlength_rp = (ac_data->rxlength_rp+1) & (RX_SIZE-1);
-
-		if (copy_to_user(buffer, ac_data->tmp, I2C_PACKET_SIZE) != 0)
-			return 0;
-		//printk(KERN_INFO "read2 %d bytes %x",l,ac_data->tmp[0]);
-		return I2C_PACKET_SIZE;
-	} else
+	case IOR_GPS_IRQ_GET_BATCH:
+		spin_lock_irq(&ac_data->rx_lock);
+		cfg = ac_data->cfg;
+		spin_unlock_irq(&ac_data->rx_lock);
+		if (copy_to_user((void __user *)arg, &cfg, sizeof(cfg)))
+			return -EFAULT;
 		return 0;
-#endif			   
+
+	default:
+		return -ENOTTY;
+	}
 }
 
 static ssize_t gps_irq_write(struct file *filp, const char __user *buffer,
@@ -398,7 +526,62 @@ static const struct file_operations gps_irq_fops = {
 	.release = gps_irq_release,
 	.poll = gps_irq_poll,
 	.read = gps_irq_read,
-	.write = gps_irq_write
+	.write = gps_irq_write,
+	.unlocked_ioctl = gps_irq_ioctl,
+};
+
+static int gps_irq_stats_show(struct seq_file *m, void *v)
+{
+	struct gps_irq *ac_data = m->private;
+	struct gps_irq_stats s;
+	struct gps_irq_batch cfg;
+	unsigned int buffered;
+
+	spin_lock_irq(&ac_data->rx_lock);
+	s = ac_data->stats;
+	cfg = ac_data->cfg;
+	buffered = ac_data->rx_head - ac_data->rx_tail;
+	spin_unlock_irq(&ac_data->rx_lock);
+
+	seq_printf(m, "batch %u wake_bytes %u wake_ms %u\n",
+		   cfg.batch, cfg.wake_bytes, cfg.wake_ms);
+	seq_printf(m, "buffered %u\n", buffered);
+	seq_printf(m, "bytes %llu\n", s.bytes);
+	seq_printf(m, "chunks %u\n", s.chunks);
+	seq_printf(m, "wakeups %u\n", s.wakeups);
+	seq_printf(m, "bytes/wakeup %llu\n",
+		   s.wakeups ? div_u64(s.bytes, s.wakeups) : 0);
+	seq_printf(m, "stalls %u\n", s.stalls);
+	seq_printf(m, "errors %u\n", s.errors);
+	seq_printf(m, "zero_reads %d\n", zero_read);
+	return 0;
+}
+
+static int gps_irq_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, gps_irq_stats_show, inode->i_private);
+}
+
+static ssize_t gps_irq_stats_write(struct file *file,
+				   const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct gps_irq *ac_data =
+		((struct seq_file *)file->private_data)->private;
+
+	spin_lock_irq(&ac_data->rx_lock);
+	memset(&ac_data->stats, 0, sizeof(ac_data->stats));
+	spin_unlock_irq(&ac_data->rx_lock);
+	return count;
+}
+
+static const struct file_operations gps_irq_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = gps_irq_stats_open,
+	.read = seq_read,
+	.write = gps_irq_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
 };
 
 static int gps_hostwake_probe(struct i2c_client *client,
@@ -415,6 +598,10 @@ static int gps_hostwake_probe(struct i2c_client *client,
 	/* printk(KERN_INFO "GPS IRQ is %d\n", hostwake_gpio); */
 
 	init_waitqueue_head(&ac_data->wait);
+	mutex_init(&ac_data->read_lock);
+	spin_lock_init(&ac_data->rx_lock);
+	setup_timer(&ac_data->rx_timer, gps_irq_rx_timer,
+		    (unsigned long)ac_data);
 	gpio_request(hostwake_gpio, "gps_irq");
 	gpio_direction_input(hostwake_gpio);
 
@@ -435,10 +622,12 @@ static int gps_hostwake_probe(struct i2c_client *client,
 	ac_data->misc.name = "gps_irq";
 	ac_data->misc.fops = &gps_irq_fops;
 
-	ret = misc_register(&ac_data->misc);
+	ac_data->ws = wakeup_source_register("gps_irq");
+	ac_data->debugfs = debugfs_create_file("gps_irq", S_IRUGO | S_IWUSR,
+					       NULL, ac_data,
+					       &gps_irq_stats_fops);
 
-	ac_data->rbuffer_rp = 0;
-	ac_data->rbuffer_wp = 0;
+	ret = misc_register(&ac_data->misc);
 
 	/* request irq.  the irq is set whenever the chip has data available
 	 * for reading.  it is cleared when all data has been read.
@@ -460,10 +649,28 @@ static int gps_hostwake_remove(struct i2c_client *client)
 	ac_data = i2c_get_clientdata(client);
 	free_irq(ac_data->irq, ac_data);
 	misc_deregister(&ac_data->misc);
+	cancel_work_sync(&ac_data->read_task);
+	del_timer_sync(&ac_data->rx_timer);
+	debugfs_remove(ac_data->debugfs);
+	wakeup_source_unregister(ac_data->ws);
 	kfree(ac_data);
 	return 0;
 }
 
+#ifdef CONFIG_PM_SLEEP
+/* the host request edges during suspend were not seen */
+static int gps_hostwake_resume(struct device *dev)
+{
+	struct gps_irq *ac_data = i2c_get_clientdata(to_i2c_client(dev));
+
+	if (__gpio_get_value(ac_data->host_req_pin))
+		schedule_work(&ac_data->read_task);
+	return 0;
+}
+#endif
+
+static SIMPLE_DEV_PM_OPS(gps_hostwake_pm_ops, NULL, gps_hostwake_resume);
+
 static const struct i2c_device_id gpsi2c_id[] = {
 	{"gpsi2c", 0},
 	{}
@@ -476,6 +683,7 @@ static struct i2c_driver gps_driver = {
 	.driver = {
 		   .owner = THIS_MODULE,
 		   .name = "gps-i2c",
+		   .pm = &gps_hostwake_pm_ops,
 		   },
 };
 
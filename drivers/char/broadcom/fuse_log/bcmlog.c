@@ -62,6 +62,7 @@
 #include "bcmlog.h"
 #include "output.h"
 #include "config.h"
+#include "stage.h"
 
 /**
  *	Console message logging levels -- can be or'ed together
@@ -187,6 +188,9 @@ enum LogSignalCompress_t {
  *	Unlike signals, strings are always copied to a new MTT message buffer,
  *	so there is never a reason to 'keep' the original string.
  *	For this reason no inMemFree argument is passed to LogString_Internal()
+ *
+ *	The _Internal functions only stage the message (stage.h); the output
+ *	worker frames it with the _Output functions.
  */
 
 static void LogSignal_Internal(unsigned int inSigCode,
@@ -199,6 +203,16 @@ static void LogSignal_Internal(unsigned int inSigCode,
 static void LogString_Internal(const char *inLogString,
 			       unsigned short inSender);
 
+static void LogSignal_Output(unsigned int inSigCode,
+			     void *inSigBuf,
+			     unsigned int inSigBufSize,
+			     unsigned short inState,
+			     unsigned short inSender,
+			     enum LogSignalCompress_t inCompress);
+
+static void LogString_Output(const char *inLogString,
+			     unsigned short inSender);
+
 /**
  *	symbol to be defined for module debugging only
  **/
@@ -672,6 +686,11 @@ static int __init BCMLOG_ModuleInit(void)
 
 	spin_lock_init(&g_module.output_lock);
 
+	/* without the staging rings messages are output directly */
+	if (BCMLOG_StageInit())
+		BCMLOG_PRINTF(BCMLOG_CONSOLE_MSG_ERROR,
+			      "BCM Log Failed to allocate staging\n");
+
 	ret = register_chrdev(BCM_LOG_MAJOR, BCMLOG_MODULE_NAME,
 			      &g_file_operations);
 
@@ -732,13 +751,13 @@ static void __exit BCMLOG_ModuleExit(void)
 }
 
 /**
- *	Log null terminated string.
+ *	Frame and output null terminated string.
  *
  *	@param	inLogString		(in)	null terminated string to be logged
  *	@param	inSender		(in)	ID of sending task
  *
 **/
-static void LogString_Internal(const char *inLogString, unsigned short inSender)
+static void LogString_Output(const char *inLogString, unsigned short inSender)
 {
 	int logStrSize;
 	int mttFrameSize;
@@ -779,6 +798,30 @@ static void LogString_Internal(const char *inLogString, unsigned short inSender)
 	kfree(kbuf_mtt);
 }
 
+/**
+ *	Stage null terminated string, output it directly if it cannot be
+ *	staged.
+ *
+ *	@param	inLogString		(in)	null terminated string to be logged
+ *	@param	inSender		(in)	ID of sending task
+ *
+**/
+static void LogString_Internal(const char *inLogString, unsigned short inSender)
+{
+	unsigned long size = strlen(inLogString) + 1;
+	BCMLOG_StageRec_t *rec;
+
+	rec = BCMLOG_StageReserve(size);
+	if (!rec) {
+		LogString_Output(inLogString, inSender);
+		return;
+	}
+	rec->type = BCMLOG_STAGE_STRING;
+	rec->sender = inSender;
+	memcpy(rec->data, inLogString, size);
+	BCMLOG_StageCommit(rec);
+}
+
 /**
  *	Log null terminated string.
  *
@@ -854,16 +897,37 @@ void BCMLOG_LogString(const char *inLogString, unsigned short inSender)
 
 void BCMLOG_Printf(unsigned short inSender, char *fmt, ...)
 {
-	va_list ap;
+	va_list ap, aq;
+	BCMLOG_StageRec_t *rec;
 	char *tmpBuf;
+	int words;
 
 	if (!CpCrashDumpInProgress() && BCMLOG_LogIdIsEnabled(inSender)) {
 		va_start(ap, fmt);
+		/**
+		 * keep the raw arguments, %s strings copied, and leave
+		 * the formatting to the output worker; fmt itself must
+		 * stay valid, as the literals of the callers do
+		 **/
+		va_copy(aq, ap);
+		words = vbin_printf(NULL, 0, fmt, aq);
+		va_end(aq);
+		rec = BCMLOG_StageReserve(sizeof(u64) + words * sizeof(u32));
+		if (rec) {
+			rec->type = BCMLOG_STAGE_PRINTF;
+			rec->sender = inSender;
+			*(char **)rec->data = fmt;
+			vbin_printf((u32 *)(rec->data + sizeof(u64)), words,
+				    fmt, ap);
+			BCMLOG_StageCommit(rec);
+			va_end(ap);
+			return;
+		}
 		tmpBuf = kvasprintf(GFP_ATOMIC, fmt, ap);
 		va_end(ap);
 
 		if (tmpBuf) {
-			LogString_Internal(tmpBuf, inSender);
+			LogString_Output(tmpBuf, inSender);
 			kfree(tmpBuf);
 		}
 	}
@@ -896,7 +960,8 @@ void BCMLOG_LogSignal(unsigned int inSigCode,
 }
 
 /**
- *	Log binary signal (internal api)
+ *	Stage binary signal (internal api); during a CP crash dump, or if it
+ *	cannot be staged, it is output directly.
  *
  *	@param	inSigCode	(in)	signal code
  *	@param	inSigBuf	(in)	pointer to signal buffer
@@ -912,6 +977,43 @@ static void LogSignal_Internal(unsigned int inSigCode,
 			       unsigned short inState,
 			       unsigned short inSender,
 			       enum LogSignalCompress_t inCompress)
+{
+	BCMLOG_StageRec_t *rec = NULL;
+
+	if (!CpCrashDumpInProgress())
+		rec = BCMLOG_StageReserve(inSigBufSize);
+	if (!rec) {
+		LogSignal_Output(inSigCode, inSigBuf, inSigBufSize,
+				 inState, inSender, inCompress);
+		return;
+	}
+	rec->type = (LOGSIGNAL_NOCOMPRESS == inCompress) ?
+		BCMLOG_STAGE_SIGNAL_RAW : BCMLOG_STAGE_SIGNAL;
+	rec->code = inSigCode;
+	rec->state = inState;
+	rec->sender = inSender;
+	if (inSigBufSize)
+		memcpy(rec->data, inSigBuf, inSigBufSize);
+	BCMLOG_StageCommit(rec);
+}
+
+/**
+ *	Frame and output binary signal
+ *
+ *	@param	inSigCode	(in)	signal code
+ *	@param	inSigBuf	(in)	pointer to signal buffer
+ *	@param	inSigBufSize	(in)	size of signal buffer in bytes
+ *	@param	inState		(in)	receiving task's state information (optional)
+ *	@param	inSender	(in)	ID of sending task
+ *	@param	inCompress	(in)	if 0 send signal uncompressed, otherwise try to compress signal
+ *
+**/
+static void LogSignal_Output(unsigned int inSigCode,
+			     void *inSigBuf,
+			     unsigned int inSigBufSize,
+			     unsigned short inState,
+			     unsigned short inSender,
+			     enum LogSignalCompress_t inCompress)
 {
 	/**
 	 * NOTE: based on code in LOG_SignalToLoggingPort()
@@ -1098,12 +1200,78 @@ static void LogSignal_Internal(unsigned int inSigCode,
  **/
 void BCMLOG_HandleCpLogMsg(unsigned char *buf, int size)
 {
+	BCMLOG_StageRec_t *rec;
+
 	if (!CpCrashDumpInProgress()) {
-		unsigned long irql = AcquireOutputLock();
+		rec = BCMLOG_StageReserve(size);
+		if (rec) {
+			rec->type = BCMLOG_STAGE_CP;
+			memcpy(rec->data, buf, size);
+			BCMLOG_StageCommit(rec);
+		} else {
+			unsigned long irql = AcquireOutputLock();
 
-		BCMLOG_Output(buf, size, 1);
+			BCMLOG_Output(buf, size, 1);
 
-		ReleaseOutputLock(irql);
+			ReleaseOutputLock(irql);
+		}
+	}
+}
+
+/**
+ *	Frame and output a staged message, called by the output worker in
+ *	the order the messages were logged.
+ *
+ *	@param	rec		(in)	staged message
+ **/
+void BCMLOG_HandleStaged(BCMLOG_StageRec_t *rec)
+{
+	const char *fmt;
+	const u32 *bin;
+	char *tmpBuf;
+	int len;
+
+	/* logging requests are ignored during a CP crash dump */
+	if (CpCrashDumpInProgress())
+		return;
+
+	switch (rec->type) {
+	case BCMLOG_STAGE_STRING:
+		LogString_Output((const char *)rec->data, rec->sender);
+		break;
+
+	case BCMLOG_STAGE_PRINTF:
+		fmt = *(const char **)rec->data;
+		bin = (const u32 *)(rec->data + sizeof(u64));
+		len = bstr_printf(NULL, 0, fmt, bin) + 1;
+		tmpBuf = kmalloc(len, GFP_KERNEL);
+		if (tmpBuf) {
+			bstr_printf(tmpBuf, len, fmt, bin);
+			LogString_Output(tmpBuf, rec->sender);
+			kfree(tmpBuf);
+		}
+		break;
+
+	case BCMLOG_STAGE_SIGNAL:
+	case BCMLOG_STAGE_SIGNAL_RAW:
+		LogSignal_Output(rec->code, rec->data, rec->size, rec->state,
+				 rec->sender,
+				 (rec->type == BCMLOG_STAGE_SIGNAL) ?
+				 LOGSIGNAL_COMPRESS : LOGSIGNAL_NOCOMPRESS);
+		break;
+
+	case BCMLOG_STAGE_CP:
+		{
+			unsigned long irql = AcquireOutputLock();
+
+			BCMLOG_Output(rec->data, rec->size, 1);
+
+			ReleaseOutputLock(irql);
+		}
+		break;
+
+	default:
+		break;
 	}
 }
 
@@ -542,6 +542,54 @@ static ssize_t bcmlog_acm_dev_store(struct device *dev,
 	return -EINVAL;
 }
 
+static ssize_t bcmlog_compress_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", g_config.compress);
+}
+
+static ssize_t bcmlog_compress_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t size)
+{
+	int val;
+
+	if (kstrtoint(buf, 10, &val) < 0)
+		return -EINVAL;
+	g_config.compress = !!val;
+	return size;
+}
+
+static ssize_t bcmlog_flush_ms_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", g_config.flush_ms);
+}
+
+static ssize_t bcmlog_flush_ms_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t size)
+{
+	int val;
+
+	if (kstrtoint(buf, 10, &val) < 0 || val < 0)
+		return -EINVAL;
+	g_config.flush_ms = val;
+	return size;
+}
+
+static ssize_t bcmlog_wr_stats_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	u64 bytes;
+	unsigned long wakeups, per_hour;
+
+	BCMLOG_OutputGetStats(&bytes, &wakeups, &per_hour);
+	return snprintf(buf, PAGE_SIZE,
+			"bytes %llu wakeups %lu wakeups_per_hour %lu\n",
+			bytes, wakeups, per_hour);
+}
+
 static DEVICE_ATTR(log, S_IRUGO | S_IWUSR, bcmlog_log_show,
 					     bcmlog_log_store);
 
@@ -575,6 +623,15 @@ static DEVICE_ATTR(uart_dev, S_IRUGO | S_IWUSR, bcmlog_uart_dev_show,
 static DEVICE_ATTR(acm_dev, S_IRUGO | S_IWUSR, bcmlog_acm_dev_show,
 						 bcmlog_acm_dev_store);
 
+static DEVICE_ATTR(compress, S_IRUGO | S_IWUSR, bcmlog_compress_show,
+						 bcmlog_compress_store);
+
+static DEVICE_ATTR(flush_ms, S_IRUGO | S_IWUSR, bcmlog_flush_ms_show,
+						 bcmlog_flush_ms_store);
+
+static DEVICE_ATTR(wr_stats, S_IRUGO, bcmlog_wr_stats_show,
+						 NULL);
+
 char *BCMLOG_GetFileBase(void)
 {
 	return g_config.file_base;
@@ -590,6 +647,16 @@ char *BCMLOG_GetAcmDev(void)
 	return g_config.acm_dev;
 }
 
+int BCMLOG_GetCompress(void)
+{
+	return g_config.compress;
+}
+
+int BCMLOG_GetFlushMs(void)
+{
+	return g_config.flush_ms;
+}
+
 static int logcfg_proc_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, logcfg_proc_show, NULL);
@@ -681,6 +748,18 @@ void BCMLOG_InitConfig(void *h)
 	if (value < 0)
 		pr_err
 	    ("BCMLOG Init failed to create bcmlog acm_dev attribute\n");
+	value = device_create_file(dev, &dev_attr_compress);
+	if (value < 0)
+		pr_err
+	    ("BCMLOG Init failed to create bcmlog compress attribute\n");
+	value = device_create_file(dev, &dev_attr_flush_ms);
+	if (value < 0)
+		pr_err
+	    ("BCMLOG Init failed to create bcmlog flush_ms attribute\n");
+	value = device_create_file(dev, &dev_attr_wr_stats);
+	if (value < 0)
+		pr_err
+	    ("BCMLOG Init failed to create bcmlog wr_stats attribute\n");
 }
 
 int BCMLOG_GetRunlogDevice(void)
@@ -45,6 +45,8 @@ struct BCMLOG_Config_t {
 	char file_base[MAX_STR_NAME];
 	char uart_dev[MAX_STR_NAME];
 	char acm_dev[MAX_STR_NAME];
+	int compress;		/* LZ4 segments to SD card and ACM */
+	int flush_ms;		/* max delay of SD card and ACM writes */
 
 };
 
@@ -79,6 +81,8 @@ int BCMLOG_IsUSBLog(void);
 char *BCMLOG_GetFileBase(void);
 char *BCMLOG_GetUartDev(void);
 char *BCMLOG_GetAcmDev(void);
+int BCMLOG_GetCompress(void);
+int BCMLOG_GetFlushMs(void);
 
 
 #endif /* __BCMLOG_FIFO_H__ */
@@ -30,11 +30,15 @@
 #include <linux/vt_kern.h>
 #include <linux/statfs.h>
 #include <linux/namei.h>
+#include <linux/lz4.h>
+#include <linux/vmalloc.h>
+#include <linux/math64.h>
 #include "bcmlog.h"
 #include "fifo.h"
 #include "bcmmtt.h"
 #include "output.h"
 #include "config.h"
+#include "stage.h"
 
 #define BCMLOG_LATEST_LOGS
 
@@ -80,6 +84,24 @@ char g_last_log_fname[BCMLOG_OUTPUT_MAX_LOG_PATHNAME];
  **/
 static unsigned char g_frame_counter;
 
+/**
+ *	SD card and ACM write batching and compression
+ **/
+#define BCMLOG_SEG_BUF_SIZE	ALIGN(sizeof(struct BCMLOG_SegHdr_t) + \
+				lz4_compressbound(BCMLOG_SEG_RAW_MAX), \
+				BCMLOG_SEG_ALIGN)
+
+static struct {
+	struct delayed_work flush_work;
+	unsigned char *buf;		/* one segment */
+	void *wrkmem;
+	u32 seq;
+	unsigned long last_write;	/* jiffies */
+	unsigned long since;		/* jiffies, start of the stats */
+	u64 bytes;
+	unsigned long wakeups;
+} g_seg;
+
 /**
  *	ACM call backs
 **/
@@ -195,6 +217,83 @@ static void GetLogFileName(char *buf, char *rootdev, int size)
 
 #define MAX_FS_WRITE_SIZE 16384
 
+/*
+ *	Allocate the segment buffers on first use
+ */
+static int SegAlloc(void)
+{
+	if (!g_seg.buf)
+		g_seg.buf = vmalloc(BCMLOG_SEG_BUF_SIZE);
+	if (!g_seg.wrkmem)
+		g_seg.wrkmem = vmalloc(LZ4_MEM_COMPRESS);
+	return g_seg.buf && g_seg.wrkmem;
+}
+
+/*
+ *	Write the start of the FIFO to file: up to MAX_FS_WRITE_SIZE bytes
+ *	raw, or with compression one segment of up to BCMLOG_SEG_RAW_MAX
+ *	bytes, aligned to BCMLOG_SEG_ALIGN if align. Returns the number of
+ *	FIFO bytes written, 0 if the FIFO is empty, -EIO if the write was
+ *	short.
+ */
+static int WriteToLogDev_Chunk(struct file *file, int align)
+{
+	struct BCMLOG_SegHdr_t *hdr;
+	unsigned char *src;
+	size_t stored;
+	u32 nFifo, len;
+	int nWrite;
+
+	nFifo = BCMLOG_FifoGetNumContig(&g_fifo);
+	if (nFifo == 0)
+		return 0;
+	src = BCMLOG_FifoGetData(&g_fifo);
+
+	if (!BCMLOG_GetCompress() || !SegAlloc()) {
+		if (nFifo > MAX_FS_WRITE_SIZE)
+			nFifo = MAX_FS_WRITE_SIZE;
+		nWrite = file->f_op->write(file, src, nFifo, &file->f_pos);
+		if (nWrite > 0) {
+			BCMLOG_FifoRemove(&g_fifo, nWrite);
+			g_seg.bytes += nWrite;
+		}
+		return (nWrite < (int)nFifo) ? -EIO : nFifo;
+	}
+
+	if (nFifo > BCMLOG_SEG_RAW_MAX)
+		nFifo = BCMLOG_SEG_RAW_MAX;
+	hdr = (struct BCMLOG_SegHdr_t *)g_seg.buf;
+	stored = BCMLOG_SEG_BUF_SIZE - sizeof(*hdr);
+	if (lz4_compress(src, nFifo, g_seg.buf + sizeof(*hdr), &stored,
+			 g_seg.wrkmem) == 0 && stored < nFifo) {
+		hdr->flags = cpu_to_le16(BCMLOG_SEG_LZ4);
+	} else {
+		/* incompressible, stored as is */
+		memcpy(g_seg.buf + sizeof(*hdr), src, nFifo);
+		stored = nFifo;
+		hdr->flags = 0;
+	}
+	len = sizeof(*hdr) + stored;
+	if (align)
+		len = ALIGN(len, BCMLOG_SEG_ALIGN);
+	memset(g_seg.buf + sizeof(*hdr) + stored, 0,
+	       len - sizeof(*hdr) - stored);
+
+	hdr->magic = cpu_to_le32(BCMLOG_SEG_MAGIC);
+	hdr->hdr_len = cpu_to_le16(sizeof(*hdr));
+	hdr->seq = cpu_to_le32(g_seg.seq++);
+	hdr->raw_len = cpu_to_le32(nFifo);
+	hdr->stored_len = cpu_to_le32(stored);
+	hdr->pad_len = cpu_to_le32(len - sizeof(*hdr) - stored);
+
+	nWrite = file->f_op->write(file, g_seg.buf, len, &file->f_pos);
+	/* a partly written segment cannot be retried */
+	BCMLOG_FifoRemove(&g_fifo, nFifo);
+	if (nWrite > 0)
+		g_seg.bytes += nWrite;
+	return (nWrite < (int)len) ? -EIO : nFifo;
+}
+
 /*
  *	Return available SD card size (bytes)
  *	If over 2G, return 2G
@@ -274,29 +373,13 @@ static void WriteToLogDev_SDCARD(void)
 	 *      If log file open start logging to it
 	 */
 	if (g_devWrParms.file) {
-		u32 nFifo;
+		int nFifo;
 
 		do {
-			int nWrite;
-
-			nFifo = BCMLOG_FifoGetNumContig(&g_fifo);
-
-			if (nFifo > MAX_FS_WRITE_SIZE)
-				nFifo = MAX_FS_WRITE_SIZE;
+			nFifo = WriteToLogDev_Chunk(g_devWrParms.file, 1);
 
-			if (nFifo > 0) {
-				nWrite =
-				    g_devWrParms.file->f_op->write(g_devWrParms.
-						   file,
-						   BCMLOG_FifoGetData
-						   (&g_fifo),
-						   nFifo,
-						   &g_devWrParms.
-						   file->f_pos);
-				if (nWrite > 0)
-					BCMLOG_FifoRemove(&g_fifo, nWrite);
-
-				if ((nWrite < (int)nFifo)
+			if (nFifo != 0) {
+				if ((nFifo < 0)
 				    || ((Get_SDCARD_Available()) <
 					MTT_SD_RESERVED)) {
 					nFifo = 0;
@@ -549,32 +632,17 @@ void WriteToLogDev_ACM(void)
 	 */
 	if (g_devWrParms.file) {
 		if (g_acm_on) {
-			u32 nFifo;
+			int nFifo;
 
 			do {
-				int nWrite;
-
-				nFifo = BCMLOG_FifoGetNumContig(&g_fifo);
-
-				if (nFifo > MAX_FS_WRITE_SIZE)
-					nFifo = MAX_FS_WRITE_SIZE;
+				nFifo = WriteToLogDev_Chunk(g_devWrParms.file,
+							    0);
 
-				if (nFifo > 0) {
-					nWrite =
-					    g_devWrParms.file->f_op->
-					    write(g_devWrParms.file,
-						  BCMLOG_FifoGetData(&g_fifo),
-						  nFifo,
-						  &g_devWrParms.file->f_pos);
-
-					if (nWrite > 0)
-						BCMLOG_FifoRemove(&g_fifo,
-								  nWrite);
-
-					if (nWrite < (int)nFifo) {
+				if (nFifo != 0) {
+					if (nFifo < 0) {
 						pr_info
 				    ("ACM failed to write log error:%d\n",
-						     nWrite);
+						     nFifo);
 						nFifo = 0;
 						filp_close(g_devWrParms.file,
 							   NULL);
@@ -588,9 +656,36 @@ void WriteToLogDev_ACM(void)
 	set_fs(oldfs);
 }
 
+/*
+ *	With a flush interval, SD card and ACM writes wait for a full
+ *	segment or for the interval to pass, so that the storage is woken
+ *	up less often
+ */
+static int WriteToLogDev_Due(void)
+{
+	unsigned long flush = msecs_to_jiffies(BCMLOG_GetFlushMs());
+	unsigned long due = g_seg.last_write + flush;
+
+	if (!flush || BCMLOG_FifoGetDataSize(&g_fifo) >= BCMLOG_SEG_RAW_MAX)
+		return 1;
+	if (time_after_eq(jiffies, due))
+		return 1;
+	schedule_delayed_work(&g_seg.flush_work, due - jiffies);
+	return 0;
+}
+
+static void WriteToLogDev_Flush(struct work_struct *work)
+{
+	schedule_work(&g_devWrParms.wq);
+}
+
 static void WriteToLogDev(struct work_struct *work)
 {
 	unsigned long irql;
+	u64 bytes = g_seg.bytes;
+
+	/* frame the staged messages into the FIFO first */
+	BCMLOG_StageDrain();
 
 	if (g_devWrParms.prev_outdev != g_devWrParms.outdev) {
 		if (g_devWrParms.file) {
@@ -601,7 +696,8 @@ static void WriteToLogDev(struct work_struct *work)
 
 	switch (g_devWrParms.outdev) {
 	case BCMLOG_OUTDEV_SDCARD:
-		WriteToLogDev_SDCARD();
+		if (WriteToLogDev_Due())
+			WriteToLogDev_SDCARD();
 		break;
 
 	case BCMLOG_OUTDEV_RNDIS:
@@ -615,7 +711,8 @@ static void WriteToLogDev(struct work_struct *work)
 		break;
 
 	case BCMLOG_OUTDEV_ACM:
-		WriteToLogDev_ACM();
+		if (WriteToLogDev_Due())
+			WriteToLogDev_ACM();
 		break;
 
 #ifdef CONFIG_BCM_STM
@@ -630,6 +727,11 @@ static void WriteToLogDev(struct work_struct *work)
 		break;
 	}
 
+	if (g_seg.bytes != bytes) {
+		g_seg.wakeups++;
+		g_seg.last_write = jiffies;
+	}
+
 	g_devWrParms.busy = 0;
 
 }
@@ -720,6 +822,22 @@ void BCMLOG_Output(unsigned char *pBytes, unsigned long nBytes,
 	}
 }
 
+void BCMLOG_OutputGetStats(u64 *bytes, unsigned long *wakeups,
+			   unsigned long *per_hour)
+{
+	unsigned long secs = (jiffies - g_seg.since) / HZ;
+
+	*bytes = g_seg.bytes;
+	*wakeups = g_seg.wakeups;
+	*per_hour = secs ? (unsigned long)div_u64((u64)g_seg.wakeups * 3600,
+						  secs) : 0;
+}
+
+void BCMLOG_OutputKick(void)
+{
+	schedule_work(&g_devWrParms.wq);
+}
+
 /**
  *	Initialize output module
  **/
@@ -731,6 +849,8 @@ BCMLOG_Fifo_t *BCMLOG_OutputInit(unsigned char *buffer, int buffer_size)
 	g_devWrParms.file = 0;
 
 	INIT_WORK(&g_devWrParms.wq, WriteToLogDev);
+	INIT_DELAYED_WORK(&g_seg.flush_work, WriteToLogDev_Flush);
+	g_seg.since = g_seg.last_write = jiffies;
 #ifdef CONFIG_BRCM_NETCONSOLE
 
 	/*
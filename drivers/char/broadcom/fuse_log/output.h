@@ -17,6 +17,7 @@
 #ifndef __BCMLOG_OUTPUT_H__
 #define __BCMLOG_OUTPUT_H__
 
+#include <linux/types.h>
 #include "fifo.h"
 
 /*#define BCMLOG_DEBUG_FLAG 1 */
@@ -32,6 +33,29 @@
 
 #define FUSE_LOG_CHANNEL	8
 
+/**
+ *	Segments written to the SD card and ACM when compression is on.
+ *	Fields are little endian; stored_len bytes follow the header
+ *	(LZ4 data if BCMLOG_SEG_LZ4 is set, raw log otherwise), then
+ *	pad_len zero bytes, so that on the SD card every segment starts
+ *	on a BCMLOG_SEG_ALIGN boundary. The raw log of the segments
+ *	concatenated is the plain MTT stream.
+ **/
+#define BCMLOG_SEG_MAGIC	0x344c5a42	/* "BZL4" */
+#define BCMLOG_SEG_LZ4		0x0001
+#define BCMLOG_SEG_RAW_MAX	(64 * 1024)
+#define BCMLOG_SEG_ALIGN	4096
+
+struct BCMLOG_SegHdr_t {
+	u32 magic;
+	u16 flags;
+	u16 hdr_len;		/* sizeof(struct BCMLOG_SegHdr_t) */
+	u32 seq;
+	u32 raw_len;
+	u32 stored_len;
+	u32 pad_len;
+} __packed;
+
 /**
  *	Output bytes to host
  *	@param  pUserBuf			(in)	pointer to user buffer
@@ -43,6 +67,18 @@
 void BCMLOG_Output(unsigned char *pUserBuf, unsigned long userBufSz,
 		   unsigned int might_has_mtthead);
 
+/**
+ *	Schedule the output worker, which first drains the staged messages
+ **/
+void BCMLOG_OutputKick(void);
+
+/**
+ *	Bytes written to the SD card and ACM and write wakeups, total
+ *	and per hour since the module started
+ **/
+void BCMLOG_OutputGetStats(u64 *bytes, unsigned long *wakeups,
+			   unsigned long *per_hour);
+
 /**
  *	Initialize output module
  *	@return	int zero if success, nonzero if error
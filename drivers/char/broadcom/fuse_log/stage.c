@@ -0,0 +1,178 @@
+/****************************************************************************
+*
+*     Copyright (c) 2009 Broadcom Corporation
+*
+*   Unless you and Broadcom execute a separate written software license
+*   agreement governing use of this software, this software is licensed to you
+*   under the terms of the GNU General Public License version 2, available
+*    at http://www.gnu.org/licenses/old-licenses/gpl-2.0.html (the "GPL").
+*
+*   Notwithstanding the above, under no circumstances may you combine this
+*   software in any way with any other Broadcom software provided under
+*   a license other than the GPL, without Broadcom's express prior
+*   written consent.
+*
+****************************************************************************/
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/cpumask.h>
+#include <linux/err.h>
+#include <asm/local.h>
+
+#include "stage.h"
+#include "output.h"
+
+/**
+ *	Per-cpu ring. head and tail run free, the offset in buf is taken
+ *	modulo BCMLOG_STAGE_BYTES. Producers on the cpu, nested interrupts
+ *	included, reserve by moving head with local_cmpxchg; the output
+ *	worker is the only consumer and moves tail.
+ **/
+typedef struct {
+	local_t head;
+	unsigned long tail;
+	unsigned long overflows;	/* logged synchronously */
+	unsigned char *buf;
+} BCMLOG_Stage_t;
+
+static BCMLOG_Stage_t *g_stage[NR_CPUS];
+
+int BCMLOG_StageInit(void)
+{
+	BCMLOG_Stage_t *stage;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		stage = kzalloc(sizeof(*stage), GFP_KERNEL);
+		if (stage)
+			stage->buf = kzalloc(BCMLOG_STAGE_BYTES, GFP_KERNEL);
+		if (!stage || !stage->buf) {
+			kfree(stage);
+			return -ENOMEM;
+		}
+		local_set(&stage->head, 0);
+		g_stage[cpu] = stage;
+	}
+	return 0;
+}
+
+BCMLOG_StageRec_t *BCMLOG_StageReserve(unsigned long size)
+{
+	BCMLOG_Stage_t *stage;
+	BCMLOG_StageRec_t *rec;
+	unsigned long head, off, pad, len;
+
+	len = ALIGN(sizeof(*rec) + size, BCMLOG_STAGE_ALIGN);
+	if (len > BCMLOG_STAGE_MAX_REC)
+		return NULL;
+
+	preempt_disable();
+	stage = g_stage[smp_processor_id()];
+	if (!stage)
+		goto fail;
+
+	do {
+		head = local_read(&stage->head);
+		off = head & (BCMLOG_STAGE_BYTES - 1);
+		/* records do not wrap, pad to the end of the ring */
+		pad = (off + len > BCMLOG_STAGE_BYTES) ?
+			BCMLOG_STAGE_BYTES - off : 0;
+		if (head + pad + len - ACCESS_ONCE(stage->tail) >
+		    BCMLOG_STAGE_BYTES) {
+			stage->overflows++;
+			goto fail;
+		}
+	} while (local_cmpxchg(&stage->head, head, head + pad + len) != head);
+
+	if (pad) {
+		rec = (BCMLOG_StageRec_t *)(stage->buf + off);
+		rec->len = pad;
+		rec->type = BCMLOG_STAGE_PAD;
+		smp_wmb();
+		rec->ready = 1;
+		off = 0;
+	}
+
+	rec = (BCMLOG_StageRec_t *)(stage->buf + off);
+	rec->len = len;
+	rec->size = size;
+	rec->time = local_clock();
+	return rec;
+
+fail:
+	preempt_enable();
+	return NULL;
+}
+
+void BCMLOG_StageCommit(BCMLOG_StageRec_t *rec)
+{
+	smp_wmb();
+	rec->ready = 1;
+	preempt_enable();
+	BCMLOG_OutputKick();
+}
+
+static void stage_consume(BCMLOG_Stage_t *stage, BCMLOG_StageRec_t *rec)
+{
+	unsigned long len = rec->len;
+
+	/* free space always reads as not ready */
+	rec->ready = 0;
+	smp_mb();
+	stage->tail += len;
+}
+
+/**
+ *	Oldest record of a ring, NULL if it is empty, ERR_PTR(-EBUSY) if
+ *	its producer is still writing it
+ **/
+static BCMLOG_StageRec_t *stage_peek(BCMLOG_Stage_t *stage)
+{
+	BCMLOG_StageRec_t *rec;
+
+	for (;;) {
+		if (stage->tail == local_read(&stage->head))
+			return NULL;
+		rec = (BCMLOG_StageRec_t *)(stage->buf +
+			(stage->tail & (BCMLOG_STAGE_BYTES - 1)));
+		if (!ACCESS_ONCE(rec->ready))
+			return ERR_PTR(-EBUSY);
+		smp_rmb();
+		if (rec->type != BCMLOG_STAGE_PAD)
+			return rec;
+		stage_consume(stage, rec);
+	}
+}
+
+void BCMLOG_StageDrain(void)
+{
+	BCMLOG_StageRec_t *rec, *next;
+	BCMLOG_Stage_t *next_stage = NULL;
+	int cpu;
+
+	for (;;) {
+		next = NULL;
+		for_each_possible_cpu(cpu) {
+			if (!g_stage[cpu])
+				continue;
+			rec = stage_peek(g_stage[cpu]);
+			/**
+			 * the order cannot be known past a record being
+			 * written; its commit kicks the worker again
+			 **/
+			if (IS_ERR(rec))
+				return;
+			if (rec && (!next || (s64)(rec->time - next->time) < 0)) {
+				next = rec;
+				next_stage = g_stage[cpu];
+			}
+		}
+		if (!next)
+			return;
+
+		BCMLOG_HandleStaged(next);
+		stage_consume(next_stage, next);
+	}
+}
@@ -0,0 +1,91 @@
+/****************************************************************************
+*
+*     Copyright (c) 2009 Broadcom Corporation
+*
+*   Unless you and Broadcom execute a separate written software license
+*   agreement governing use of this software, this software is licensed to you
+*   under the terms of the GNU General Public License version 2, available
+*    at http://www.gnu.org/licenses/old-licenses/gpl-2.0.html (the "GPL").
+*
+*   Notwithstanding the above, under no circumstances may you combine this
+*   software in any way with any other Broadcom software provided under
+*   a license other than the GPL, without Broadcom's express prior
+*   written consent.
+*
+****************************************************************************/
+
+#ifndef __BCMLOG_STAGE_H__
+#define __BCMLOG_STAGE_H__
+
+#include <linux/types.h>
+
+/**
+ *	Producers stage log messages raw in a per-cpu ring, without a lock
+ *	and with interrupts left on; the output worker frames them and adds
+ *	them to the output FIFO in timestamp order.
+ **/
+#define BCMLOG_STAGE_BYTES	(16 * 1024)	/* per cpu, power of 2 */
+#define BCMLOG_STAGE_ALIGN	8
+/* larger messages bypass the staging */
+#define BCMLOG_STAGE_MAX_REC	(BCMLOG_STAGE_BYTES / 4)
+
+enum BCMLOG_StageType_t {
+	BCMLOG_STAGE_PAD = 0,		/* skip to the start of the ring */
+	BCMLOG_STAGE_STRING,		/* null terminated string */
+	BCMLOG_STAGE_PRINTF,		/* format pointer, vbin_printf args */
+	BCMLOG_STAGE_SIGNAL,		/* binary signal, compressed */
+	BCMLOG_STAGE_SIGNAL_RAW,	/* binary signal, not compressed */
+	BCMLOG_STAGE_CP,		/* CP log message, framed already */
+};
+
+/**
+ *	Staged message; len, type and ready come first as a padding record
+ *	can be as short as BCMLOG_STAGE_ALIGN bytes.
+ **/
+typedef struct {
+	u16 len;	/* whole record, multiple of BCMLOG_STAGE_ALIGN */
+	u8 type;	/* BCMLOG_StageType_t */
+	u8 ready;	/* set by the producer when it is written */
+	u16 sender;
+	u16 state;
+	u32 code;	/* signal code */
+	u32 size;	/* bytes of data[] */
+	u64 time;	/* local_clock() at reservation */
+	unsigned char data[0];
+} BCMLOG_StageRec_t;
+
+/**
+ *	Initialize the per-cpu rings; until then BCMLOG_StageReserve()
+ *	returns NULL
+ *	@return	int zero if success, nonzero if error
+ **/
+int BCMLOG_StageInit(void);
+
+/**
+ *	Reserve a record for size bytes of data on this cpu
+ *	@param	size			(in)	number of data bytes
+ *	@return	record with len, size and time set, NULL if the ring is full
+ *		or size is over BCMLOG_STAGE_MAX_REC; the caller then logs
+ *		synchronously
+ *	@note	Preemption stays disabled until BCMLOG_StageCommit()
+ **/
+BCMLOG_StageRec_t *BCMLOG_StageReserve(unsigned long size);
+
+/**
+ *	Publish a reserved record and kick the output worker
+ *	@param	rec			(in)	from BCMLOG_StageReserve()
+ **/
+void BCMLOG_StageCommit(BCMLOG_StageRec_t *rec);
+
+/**
+ *	Pass the staged records of all cpus in timestamp order to
+ *	BCMLOG_HandleStaged(); output worker only
+ **/
+void BCMLOG_StageDrain(void);
+
+/**
+ *	Frame and output one staged record (bcmlog.c)
+ **/
+void BCMLOG_HandleStaged(BCMLOG_StageRec_t *rec);
+
+#endif /* __BCMLOG_STAGE_H__ */
@@ -31,6 +31,11 @@
 #include <linux/sysctl.h>
 
 #include <mach/profile_timer.h>
+#ifdef CONFIG_KONA_PROFILER
+#include <linux/math64.h>
+#include <linux/tick.h>
+#include <plat/profiler.h>
+#endif
 
 DEFINE_PER_CPU(spinlock_t, idle_lock);
 DEFINE_PER_CPU(u32, idle_count);
@@ -773,3 +778,82 @@ static int get_idle_profile(idle_handle_t *handle, u32 *idle, u32 *total)
 	put_cpu_var(idle_lock);
 	return timer_get_tick_rate();
 }
+
+#ifdef CONFIG_KONA_PROFILER
+/*
+ * Idle time of each cpu as a source of the Kona profiler, so that it is
+ * sampled with the CCU and PI counters on the same timebase. idle_count
+ * is not fed by the idle loop on every platform, so the nohz idle time
+ * is used, reported in the COUNTER_CLK_RATE units of the other sources.
+ */
+typedef struct {
+	struct profiler profiler;
+	int cpu;
+	u64 start_us;
+	char name[PROF_NAME_MAX_LEN];
+} IDLE_PROF;
+
+static IDLE_PROF idle_prof[NR_CPUS];
+
+static int idle_prof_start(struct profiler *profiler, int start)
+{
+	IDLE_PROF *ip = container_of(profiler, IDLE_PROF, profiler);
+
+	if (start) {
+		ip->start_us = get_cpu_idle_time_us(ip->cpu, NULL);
+		profiler->flags |= PROFILER_RUNNING;
+	} else {
+		profiler->flags &= ~PROFILER_RUNNING;
+	}
+	return 0;
+}
+
+static int idle_prof_status(struct profiler *profiler)
+{
+	return profiler->flags & PROFILER_RUNNING;
+}
+
+static int idle_prof_get_counter(struct profiler *profiler,
+				 unsigned long *counter, int *overflow)
+{
+	IDLE_PROF *ip = container_of(profiler, IDLE_PROF, profiler);
+	u64 now = get_cpu_idle_time_us(ip->cpu, NULL);
+	u64 ticks = 0;
+
+	/* -1 without nohz, reported as no idle time */
+	if (now != -1ULL && now > ip->start_us)
+		ticks = div_u64((now - ip->start_us) * COUNTER_CLK_RATE,
+				USEC_PER_MSEC);
+	*overflow = ticks > ULONG_MAX;
+	*counter = (unsigned long)ticks;
+	return 0;
+}
+
+static struct prof_ops idle_prof_ops = {
+	.start = idle_prof_start,
+	.status = idle_prof_status,
+	.get_counter = idle_prof_get_counter,
+};
+
+/* after the Kona profiler core has probed */
+static int __init idle_prof_init(void)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		IDLE_PROF *ip = &idle_prof[cpu];
+
+		ip->cpu = cpu;
+		snprintf(ip->name, sizeof(ip->name), "cpu%d_idle", cpu);
+		ip->profiler.name = ip->name;
+		ip->profiler.owner = THIS_MODULE;
+		ip->profiler.ops = &idle_prof_ops;
+		ip->profiler.prof_type = PROFILER_IDLE;
+		if (profiler_register(&ip->profiler))
+			return -ENODEV;
+	}
+	return 0;
+}
+
+late_initcall(idle_prof_init);
+#endif
@@ -0,0 +1,342 @@
+/*******************************************************************************
+Copyright 2010 Broadcom Corporation.  All rights reserved.
+
+Unless you and Broadcom execute a separate written software license agreement
+governing use of this software, this software is licensed to you under the
+terms of the GNU General Public License version 2, available at
+http://www.gnu.org/copyleft/gpl.html (the "GPL").
+
+Notwithstanding the above, under no circumstances may you combine this software
+in any way with any other Broadcom software provided under a license other than
+the GPL, without Broadcom's express prior written consent.
+*******************************************************************************/
+
+/* Benchmark of the MM cores.
+ *
+ * Posts one job over and over to an MM device with mm_fmwk_post_job(),
+ * down the same scheduler, core and completion path as the jobs user
+ * space writes, and times it. debugfs mm_bench/job takes the job as one
+ * write() to the device would carry it, type and id first; a job
+ * captured from a real use case, with its buffers left in place, makes
+ * the runs repeatable. Writing
+ *
+ *	<device> <jobs> <depths> [<opps>]
+ *
+ * to mm_bench/run, e.g. "mm_h264 500 1,2,4 0,2", posts <jobs> jobs for
+ * each queue depth, the jobs in flight at a time, and each MM OPP floor
+ * of the comma separated lists. Reading run gives one line per run:
+ *
+ *	dev= size= depth= opp= jobs= errors= us= jobs_per_s=
+ *	p50_us= p90_us= p99_us= max_us= clk_on_us= cache_us=
+ *
+ * Latencies go from the post to the completion of a job. clk_on_us and
+ * cache_us are those of the device's cores over the run. The OPP is a
+ * floor, turn the device's dvfs/__on off to keep its governor from going
+ * higher. Job sizes are swept by writing another job.
+ */
+
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/ktime.h>
+#include <linux/sort.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/broadcom/mm_fw_hw_ifc.h>
+
+#define MMB_MAX_JOB		(64 * 1024)
+#define MMB_MAX_JOBS		4096
+#define MMB_MAX_DEPTH		64
+#define MMB_MAX_RESULTS		64
+#define MMB_MAX_CORES		16
+
+struct mmb_result {
+	char dev[32];
+	u32 size;
+	u32 depth;
+	int opp;
+	u32 jobs;
+	u32 errors;
+	u32 us;
+	u32 lat[4];		/* p50, p90, p99, max */
+	u32 clk_on_us;
+	u32 cache_us;
+};
+
+static DEFINE_MUTEX(mmb_mutex);
+static struct dentry *mmb_dir;
+static u8 *mmb_job;
+static size_t mmb_job_size;
+
+static ktime_t *mmb_t_post;
+static u32 *mmb_lat;
+static atomic_t mmb_inflight;
+static atomic_t mmb_errors;
+static DECLARE_WAIT_QUEUE_HEAD(mmb_wait);
+
+static struct mmb_result mmb_results[MMB_MAX_RESULTS];
+static int mmb_nr_results;
+static struct pi_mgr_dfs_node mmb_dfs;
+static mm_fmwk_core_stats_t mmb_stats[MMB_MAX_CORES];
+
+/* from the framework's work queue, may not sleep */
+static void mmb_done(void *priv, mm_job_status_e status)
+{
+	unsigned long i = (unsigned long)priv;
+
+	mmb_lat[i] = ktime_us_delta(ktime_get(), mmb_t_post[i]);
+	if (status != MM_JOB_STATUS_SUCCESS && status != MM_JOB_STATUS_SKIP)
+		atomic_inc(&mmb_errors);
+	atomic_dec(&mmb_inflight);
+	wake_up(&mmb_wait);
+}
+
+/* clock on and cache time of the cores of dev */
+static void mmb_core_times(const char *dev, u32 *clk_on_us, u32 *cache_us)
+{
+	size_t len = strlen(dev);
+	int i, n;
+
+	*clk_on_us = *cache_us = 0;
+	n = mm_fmwk_core_stats(mmb_stats, MMB_MAX_CORES);
+	for (i = 0; i < n; i++) {
+		if (strncmp(mmb_stats[i].name, dev, len) ||
+		    mmb_stats[i].name[len] != ':')
+			continue;
+		*clk_on_us += mmb_stats[i].clk_on_us;
+		*cache_us += mmb_stats[i].cache_us;
+	}
+}
+
+static int mmb_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void mmb_run_one(struct file *filp, const char *dev, u32 jobs,
+			u32 depth, int opp)
+{
+	struct mmb_result *r = &mmb_results[mmb_nr_results];
+	mm_job_type_e type = *(u32 *)mmb_job;
+	u32 id = *(u32 *)(mmb_job + 4);
+	u32 clk_on_us, cache_us;
+	unsigned long i;
+	ktime_t start;
+	int ret = 0;
+
+	pi_mgr_dfs_request_update(&mmb_dfs,
+				  opp < 0 ? PI_MGR_DFS_MIN_VALUE : opp);
+	atomic_set(&mmb_errors, 0);
+	mmb_core_times(dev, &clk_on_us, &cache_us);
+	start = ktime_get();
+
+	for (i = 0; i < jobs; i++) {
+		if (wait_event_killable(mmb_wait,
+				atomic_read(&mmb_inflight) < depth))
+			break;
+		atomic_inc(&mmb_inflight);
+		mmb_t_post[i] = ktime_get();
+		ret = mm_fmwk_post_job(filp, type, id, mmb_job + 8,
+				       mmb_job_size - 8, mmb_done, (void *)i);
+		if (ret) {
+			atomic_dec(&mmb_inflight);
+			break;
+		}
+	}
+	/* the done callbacks use the arrays, wait for all of them */
+	wait_event(mmb_wait, atomic_read(&mmb_inflight) == 0);
+
+	memset(r, 0, sizeof(*r));
+	r->us = ktime_us_delta(ktime_get(), start);
+	mmb_core_times(dev, &r->clk_on_us, &r->cache_us);
+	r->clk_on_us -= clk_on_us;
+	r->cache_us -= cache_us;
+	strlcpy(r->dev, dev, sizeof(r->dev));
+	r->size = mmb_job_size - 8;
+	r->depth = depth;
+	r->opp = opp;
+	r->jobs = i;
+	r->errors = atomic_read(&mmb_errors) + (ret != 0);
+	if (i) {
+		sort(mmb_lat, i, sizeof(*mmb_lat), mmb_cmp, NULL);
+		r->lat[0] = mmb_lat[(i - 1) * 50 / 100];
+		r->lat[1] = mmb_lat[(i - 1) * 90 / 100];
+		r->lat[2] = mmb_lat[(i - 1) * 99 / 100];
+		r->lat[3] = mmb_lat[i - 1];
+	}
+	mmb_nr_results++;
+}
+
+static int mmb_parse_list(char *s, int *vals, int max)
+{
+	char *tok;
+	int n = 0;
+
+	while ((tok = strsep(&s, ",")) != NULL && n < max)
+		if (kstrtoint(tok, 0, &vals[n++]))
+			return -EINVAL;
+	return n;
+}
+
+static int mmb_run(char *cmd)
+{
+	char dev[32], depth_s[64], opp_s[64] = "-1";
+	int depths[8], opps[8], nd, no, d, o;
+	struct file *filp;
+	u32 jobs;
+
+	if (sscanf(cmd, "%31s %u %63s %63s", dev, &jobs, depth_s, opp_s) < 3)
+		return -EINVAL;
+	nd = mmb_parse_list(depth_s, depths, ARRAY_SIZE(depths));
+	no = mmb_parse_list(opp_s, opps, ARRAY_SIZE(opps));
+	if (nd <= 0 || no <= 0 || !jobs || jobs > MMB_MAX_JOBS)
+		return -EINVAL;
+	for (d = 0; d < nd; d++)
+		if (depths[d] < 1 || depths[d] > MMB_MAX_DEPTH)
+			return -EINVAL;
+	for (o = 0; o < no; o++)
+		if (opps[o] < -1 || opps[o] >= PI_OPP_MAX)
+			return -EINVAL;
+	if (mmb_job_size <= 8)
+		return -ENODATA;
+
+	filp = mm_fmwk_open(dev);
+	if (IS_ERR(filp))
+		return PTR_ERR(filp);
+
+	mmb_nr_results = 0;
+	for (o = 0; o < no; o++)
+		for (d = 0; d < nd && mmb_nr_results < MMB_MAX_RESULTS; d++)
+			mmb_run_one(filp, dev, jobs, depths[d], opps[o]);
+	pi_mgr_dfs_request_update(&mmb_dfs, PI_MGR_DFS_MIN_VALUE);
+
+	filp_close(filp, NULL);
+	return 0;
+}
+
+static ssize_t mmb_run_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	char cmd[160];
+	int ret;
+
+	if (count >= sizeof(cmd))
+		return -EINVAL;
+	if (copy_from_user(cmd, buf, count))
+		return -EFAULT;
+	cmd[count] = '\0';
+
+	mutex_lock(&mmb_mutex);
+	ret = mmb_run(strim(cmd));
+	mutex_unlock(&mmb_mutex);
+	return ret ? ret : count;
+}
+
+static int mmb_run_show(struct seq_file *m, void *v)
+{
+	struct mmb_result *r;
+	int i;
+
+	mutex_lock(&mmb_mutex);
+	for (i = 0; i < mmb_nr_results; i++) {
+		r = &mmb_results[i];
+		seq_printf(m, "dev=%s size=%u depth=%u opp=%d jobs=%u",
+			   r->dev, r->size, r->depth, r->opp, r->jobs);
+		seq_printf(m, " errors=%u us=%u jobs_per_s=%llu", r->errors,
+			   r->us, div_u64((u64)r->jobs * USEC_PER_SEC,
+					  r->us ? : 1));
+		seq_printf(m, " p50_us=%u p90_us=%u p99_us=%u max_us=%u",
+			   r->lat[0], r->lat[1], r->lat[2], r->lat[3]);
+		seq_printf(m, " clk_on_us=%u cache_us=%u\n", r->clk_on_us,
+			   r->cache_us);
+	}
+	mutex_unlock(&mmb_mutex);
+	return 0;
+}
+
+static int mmb_run_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mmb_run_show, NULL);
+}
+
+static const struct file_operations mmb_run_fops = {
+	.open		= mmb_run_open,
+	.read		= seq_read,
+	.write		= mmb_run_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+/* one write() per job, as to the device */
+static ssize_t mmb_job_write(struct file *file, const char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	if (count <= 8 || count > MMB_MAX_JOB)
+		return -EINVAL;
+
+	mutex_lock(&mmb_mutex);
+	if (copy_from_user(mmb_job, buf, count)) {
+		mutex_unlock(&mmb_mutex);
+		return -EFAULT;
+	}
+	mmb_job_size = count;
+	mutex_unlock(&mmb_mutex);
+	return count;
+}
+
+static const struct file_operations mmb_job_fops = {
+	.write		= mmb_job_write,
+};
+
+static int __init mm_bench_init(void)
+{
+	int ret;
+
+	mmb_job = vmalloc(MMB_MAX_JOB);
+	mmb_t_post = vmalloc(MMB_MAX_JOBS * sizeof(*mmb_t_post));
+	mmb_lat = vmalloc(MMB_MAX_JOBS * sizeof(*mmb_lat));
+	if (!mmb_job || !mmb_t_post || !mmb_lat) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	ret = pi_mgr_dfs_add_request(&mmb_dfs, "mm_bench", PI_MGR_PI_ID_MM,
+				     PI_MGR_DFS_MIN_VALUE);
+	if (ret)
+		goto err;
+
+	mmb_dir = debugfs_create_dir("mm_bench", NULL);
+	if (!mmb_dir) {
+		ret = -ENOMEM;
+		goto err_dfs;
+	}
+	debugfs_create_file("job", S_IWUSR, mmb_dir, NULL, &mmb_job_fops);
+	debugfs_create_file("run", S_IRUSR | S_IWUSR, mmb_dir, NULL,
+			    &mmb_run_fops);
+	return 0;
+
+err_dfs:
+	pi_mgr_dfs_request_remove(&mmb_dfs);
+err:
+	vfree(mmb_lat);
+	vfree(mmb_t_post);
+	vfree(mmb_job);
+	return ret;
+}
+
+static void __exit mm_bench_exit(void)
+{
+	debugfs_remove_recursive(mmb_dir);
+	pi_mgr_dfs_request_remove(&mmb_dfs);
+	vfree(mmb_lat);
+	vfree(mmb_t_post);
+	vfree(mmb_job);
+}
+
+module_init(mm_bench_init);
+module_exit(mm_bench_exit);
+MODULE_DESCRIPTION("MM framework core benchmark");
+MODULE_LICENSE("GPL");
@@ -15,6 +15,8 @@ the GPL, without Broadcom's express prior written consent.
 				 __func__, __LINE__ \
 
 #include <linux/slab.h>
+#include <linux/dma-mapping.h>
+#include <linux/broadcom/bcm_ion.h>
 #include "mm_common.h"
 #include "mm_core.h"
 #include "mm_dvfs.h"
@@ -34,8 +36,14 @@ the GPL, without Broadcom's express prior written consent.
 DEFINE_MUTEX(mm_fmwk_mutex);
 LIST_HEAD(mm_dev_list);
 LIST_HEAD(mm_file_list);
-static struct workqueue_struct *single_wq;
 static char *single_wq_name = "mm_wq";
+#ifdef CONFIG_MM_PARALLEL_WQ
+DEFINE_MUTEX(mm_fmwk_job_mutex);
+#else
+static struct workqueue_struct *single_wq;
+#endif
+/* the jobs that do not fit the file's pool */
+static struct kmem_cache *mm_job_cachep;
 
 #define SCHEDULER_COMMON_WORK(common, work) \
 		queue_work_on(0, common->mm_common_ifc.single_wq, work)
@@ -66,6 +74,74 @@ void mm_common_cache_clean(void)
 
 	schedule_on_each_cpu(_mm_common_cache_clean);
 }
+
+static inline dma_addr_t mm_cache_range_dma(struct device *dev,
+				struct MM_CACHE_RANGE_T *range)
+{
+	return pfn_to_dma(dev, __phys_to_pfn(range->addr)) +
+				(range->addr & ~PAGE_MASK);
+}
+
+/* Clean/invalidate only the buffers the job declared. Returns false when
+ * the caller has to fall back to a full clean: no ranges were given, a
+ * range is not backed by struct pages, or the total exceeds max_size. */
+bool mm_common_cache_sync_ranges(struct mm_common *common,
+				struct dev_job_list *job,
+				unsigned int max_size)
+{
+	mm_cache_ranges_t *ranges = &job->cache_ranges;
+	struct device *dev = common->mdev.this_device;
+	unsigned int total = 0;
+	int i;
+
+	if (ranges->num_ranges == 0)
+		return false;
+
+	for (i = 0; i < ranges->num_ranges; i++) {
+		struct MM_CACHE_RANGE_T *range = &ranges->range[i];
+
+		if (range->size > max_size)
+			return false;
+		total += range->size;
+		if (!pfn_valid(__phys_to_pfn(range->addr)) ||
+		!pfn_valid(__phys_to_pfn(range->addr + range->size - 1)))
+			return false;
+	}
+	if (total > max_size)
+		return false;
+
+	for (i = 0; i < ranges->num_ranges; i++) {
+		struct MM_CACHE_RANGE_T *range = &ranges->range[i];
+
+		dma_sync_single_for_device(dev,
+				mm_cache_range_dma(dev, range), range->size,
+				(range->op == MM_CACHE_INVALIDATE) ?
+					DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	}
+	job->job.status = MM_JOB_STATUS_READY;
+	return true;
+}
+
+/* Drop lines speculatively fetched while the hardware was writing */
+void mm_common_cache_complete_ranges(struct mm_common *common,
+				struct dev_job_list *job)
+{
+	mm_cache_ranges_t *ranges = &job->cache_ranges;
+	struct device *dev = common->mdev.this_device;
+	int i;
+
+	for (i = 0; i < ranges->num_ranges; i++) {
+		struct MM_CACHE_RANGE_T *range = &ranges->range[i];
+
+		if (range->op == MM_CACHE_CLEAN)
+			continue;
+		if (!pfn_valid(__phys_to_pfn(range->addr)))
+			continue;
+		dma_sync_single_for_cpu(dev, mm_cache_range_dma(dev, range),
+					range->size, DMA_FROM_DEVICE);
+	}
+	ranges->num_ranges = 0;
+}
 void mm_common_enable_clock(struct mm_common *common)
 {
 	if (common->mm_common_ifc.mm_hw_is_on == 0) {
@@ -101,8 +177,19 @@ static struct dev_job_list *mm_common_alloc_job(\
 			struct file_private_data *private,\
 			void (*func)(struct work_struct *work))
 {
-	struct dev_job_list *job = kmalloc(sizeof(struct dev_job_list),\
-						GFP_KERNEL);
+	struct dev_job_list *job = NULL;
+
+	if (private->job_pool) {
+		spin_lock(&private->pool_lock);
+		if (!list_empty(&private->pool_head)) {
+			job = list_first_entry(&private->pool_head,
+					struct dev_job_list, file_list);
+			list_del(&job->file_list);
+		}
+		spin_unlock(&private->pool_lock);
+	}
+	if (!job)
+		job = kmem_cache_alloc(mm_job_cachep, GFP_KERNEL);
 	if (!job)
 		return NULL;
 
@@ -112,6 +199,9 @@ static struct dev_job_list *mm_common_alloc_job(\
 	job->notify = NULL;
 	job->successor = NULL;
 	job->predecessor = NULL;
+	job->dependent = NULL;
+	job->ordered = false;
+	job->held = false;
 	INIT_WORK(&(job->work), func);
 	INIT_LIST_HEAD(&job->file_list);
 	INIT_LIST_HEAD(&job->core_list);
@@ -119,6 +209,21 @@ static struct dev_job_list *mm_common_alloc_job(\
 	job->job.id = 0;
 	job->job.data = NULL;
 	job->job.size = 0;
+	job->cache_ranges.num_ranges = 0;
+	INIT_LIST_HEAD(&job->hint.node);
+	job->hint.valid = false;
+	job->hint.queued = false;
+	job->hint.cycles = 0;
+	job->t_add = 0;
+	job->t_start = 0;
+	job->t_run = 0;
+	job->done = NULL;
+	job->done_priv = NULL;
+#ifdef CONFIG_MM_SYNC
+	job->in_fence = NULL;
+	job->fenced = false;
+	job->out_sync = NULL;
+#endif
 #ifdef CONFIG_ARCH_JAVA
 	job->job.status = MM_JOB_STATUS_DIRTY;
 #else
@@ -127,6 +232,165 @@ static struct dev_job_list *mm_common_alloc_job(\
 	return job;
 }
 
+#ifdef CONFIG_MM_SYNC
+static void mm_common_fence_done(struct dev_job_list *job, int status)
+{
+	if (job->in_fence) {
+		sync_fence_put(job->in_fence);
+		job->in_fence = NULL;
+	}
+	if (job->out_sync) {
+		mm_sync_signal(job->out_sync, status);
+		job->out_sync = NULL;
+	}
+}
+
+static void mm_common_fence_job(struct work_struct *work)
+{
+	struct dev_job_list *job = container_of(work, struct dev_job_list,
+						fence_work);
+	struct file_private_data *filp = job->filp;
+	struct mm_common *common = filp->common;
+	struct dev_job_list *temp;
+	struct sync_fence *in_fence;
+	int core_id = (job->job.type & 0xFF0000) >> 16;
+
+	/* the job may complete as soon as it is on the core */
+	MM_FMWK_JOB_LOCK();
+	in_fence = job->in_fence;
+	job->in_fence = NULL;
+	job->fenced = false;
+	/* jobs behind a pending interlock go with the interlock */
+	list_for_each_entry(temp, &filp->write_head, file_list) {
+		if (temp->job.type == INTERLOCK_WAITING_JOB)
+			break;
+		if (temp == job) {
+			if (!job->held)
+				mm_core_add_job(job, common->mm_core[core_id]);
+			break;
+		}
+	}
+	MM_FMWK_JOB_UNLOCK();
+
+	sync_fence_put(in_fence);
+	if (atomic_dec_and_test(&filp->fence_waits))
+		wake_up(&filp->wait_queue);
+}
+
+/* may run in interrupt context, from whoever signals the fence */
+static void mm_common_fence_signaled(struct sync_fence *fence,
+				struct sync_fence_waiter *waiter)
+{
+	struct dev_job_list *job = container_of(waiter, struct dev_job_list,
+						fence_waiter);
+
+	SCHEDULER_COMMON_WORK(job->filp->common, &job->fence_work);
+}
+
+/* An in fence in error still lets the job run, its buffers are the
+ * caller's to check */
+static void mm_common_fence_arm(struct dev_job_list *job)
+{
+	struct file_private_data *filp = job->filp;
+
+	if (!job->in_fence)
+		return;
+	INIT_WORK(&job->fence_work, mm_common_fence_job);
+	sync_fence_waiter_init(&job->fence_waiter, mm_common_fence_signaled);
+	atomic_inc(&filp->fence_waits);
+	job->fenced = true;
+	if (sync_fence_wait_async(job->in_fence, &job->fence_waiter)) {
+		job->fenced = false;
+		atomic_dec(&filp->fence_waits);
+		sync_fence_put(job->in_fence);
+		job->in_fence = NULL;
+	}
+}
+
+static void mm_common_fence_clear(struct file_private_data *private)
+{
+	if (private->in_fence)
+		sync_fence_put(private->in_fence);
+	if (private->out_sync)
+		mm_sync_signal(private->out_sync, -ECANCELED);
+	private->in_fence = NULL;
+	private->out_sync = NULL;
+}
+
+/* Jobs still waiting for their in fence stop waiting, release
+ * drops them. Those whose fence is signalling already are waited
+ * for in mm_file_release(). */
+static void mm_common_release_fences(struct work_struct *work)
+{
+	struct file_private_data *filp = container_of(work,
+					struct file_private_data, work);
+	struct dev_job_list *job;
+
+	MM_FMWK_JOB_LOCK();
+	list_for_each_entry(job, &filp->write_head, file_list) {
+		if (!job->fenced ||
+			sync_fence_cancel_async(job->in_fence,
+						&job->fence_waiter))
+			continue;
+		job->fenced = false;
+		sync_fence_put(job->in_fence);
+		job->in_fence = NULL;
+		atomic_dec(&filp->fence_waits);
+	}
+	MM_FMWK_JOB_UNLOCK();
+	mm_common_fence_clear(filp);
+}
+
+static int mm_common_set_job_fence(struct file_private_data *private,
+				mm_job_fence_t *job_fence)
+{
+	struct mm_common *common = private->common;
+	struct sync_fence *in_fence = NULL;
+	struct mm_sync_timeline *out_sync;
+
+	mm_common_fence_clear(private);
+	if (job_fence->in_fence >= 0) {
+		in_fence = sync_fence_fdget(job_fence->in_fence);
+		if (!in_fence)
+			return -EINVAL;
+	}
+	out_sync = mm_sync_create(common->mm_common_ifc.mm_name,
+				&job_fence->out_fence);
+	if (IS_ERR(out_sync)) {
+		if (in_fence)
+			sync_fence_put(in_fence);
+		return PTR_ERR(out_sync);
+	}
+	private->in_fence = in_fence;
+	private->out_sync = out_sync;
+	return 0;
+}
+#endif
+
+void mm_common_free_job(struct dev_job_list *job)
+{
+	struct file_private_data *filp = job->filp;
+
+#ifdef CONFIG_MM_SYNC
+	/* never got to complete */
+	mm_common_fence_done(job, -ECANCELED);
+#endif
+	/* aborted before completion, drop it from the deadline set */
+	if (job->hint.queued)
+		raw_notifier_call_chain(
+			&filp->common->mm_common_ifc.notifier_head,
+			MM_FMWK_NOTIFY_DEADLINE_DONE, &job->hint);
+
+	if (filp->job_pool && (job >= filp->job_pool) &&
+		(job < filp->job_pool + MM_JOB_POOL_SIZE)) {
+		spin_lock(&filp->pool_lock);
+		list_add(&job->file_list, &filp->pool_head);
+		spin_unlock(&filp->pool_lock);
+	} else {
+		kmem_cache_free(mm_job_cachep, job);
+	}
+}
+
 void mm_common_add_job(struct work_struct *work)
 {
 	struct dev_job_list *job = container_of(work, \
@@ -139,12 +403,29 @@ void mm_common_add_job(struct work_struct *work)
 
 	core_dev = common->mm_core[core_id];
 
+	MM_FMWK_JOB_LOCK();
+	job->t_add = mm_prof_trace_time();
 	job->job.spl_data_ptr = filp->spl_data_ptr;
-	if (filp->interlock_count == 0)
+	if (job->ordered && !list_empty(&filp->write_head)) {
+		struct dev_job_list *prev = list_entry(filp->write_head.prev,
+						struct dev_job_list, file_list);
+		if (prev->job.type != INTERLOCK_WAITING_JOB) {
+			prev->dependent = job;
+			job->held = true;
+		}
+	}
+#ifdef CONFIG_MM_SYNC
+	mm_common_fence_arm(job);
+#endif
+	if ((filp->interlock_count == 0) && !job->held && !mm_job_fenced(job))
 		mm_core_add_job(job, core_dev);
 	list_add_tail(&(job->file_list), &(filp->write_head));
 	raw_notifier_call_chain(&common->mm_common_ifc.notifier_head, \
 				MM_FMWK_NOTIFY_JOB_ADD, NULL);
+	if (job->hint.valid)
+		raw_notifier_call_chain(&common->mm_common_ifc.notifier_head,
+				MM_FMWK_NOTIFY_DEADLINE_ADD, &job->hint);
+	MM_FMWK_JOB_UNLOCK();
 }
 
 void mm_common_interlock_job(struct work_struct *work)
@@ -155,6 +436,7 @@ void mm_common_interlock_job(struct work_struct *work)
 	struct dev_job_list *from = to->predecessor;
 	struct file_private_data *to_filp = to->filp;
 
+	MM_FMWK_JOB_LOCK();
 	if (from) {
 		struct file_private_data *from_filp = from->filp;
 		list_add_tail(&(from->file_list), &(from_filp->write_head));
@@ -174,6 +456,7 @@ void mm_common_interlock_job(struct work_struct *work)
 			struct dev_job_list, file_list) == from)
 			mm_common_interlock_completion(from);
 		}
+	MM_FMWK_JOB_UNLOCK();
 }
 
 struct job_read_work {
@@ -190,6 +473,7 @@ void mm_common_read_job(struct work_struct *work)
 	struct dev_job_list **job_list = read_job->job_list;
 	struct file_private_data *filp = read_job->filp;
 
+	MM_FMWK_JOB_LOCK();
 	if (filp->read_count > 0) {
 		struct dev_job_list *job =
 			list_first_entry(&(filp->read_head),\
@@ -198,6 +482,34 @@ void mm_common_read_job(struct work_struct *work)
 		*job_list = job;
 		filp->read_count--;
 		}
+	MM_FMWK_JOB_UNLOCK();
+}
+
+struct jobs_read_work {
+	struct work_struct work;
+	struct file_private_data *filp;
+	struct list_head head;
+	int max;
+};
+
+void mm_common_read_jobs(struct work_struct *work)
+{
+	struct jobs_read_work *read_jobs = container_of(work, \
+					struct jobs_read_work,\
+					work);
+	struct file_private_data *filp = read_jobs->filp;
+	int count = 0;
+
+	MM_FMWK_JOB_LOCK();
+	while ((filp->read_count > 0) && (count < read_jobs->max)) {
+		struct dev_job_list *job =
+			list_first_entry(&(filp->read_head),\
+				 struct dev_job_list, file_list);
+		list_move_tail(&job->file_list, &read_jobs->head);
+		filp->read_count--;
+		count++;
+		}
+	MM_FMWK_JOB_UNLOCK();
 }
 
 void mm_common_release_jobs(struct work_struct *work)
@@ -209,7 +521,7 @@ void mm_common_release_jobs(struct work_struct *work)
 	struct dev_job_list *job = NULL;
 	struct dev_job_list *temp = NULL;
 
-
+	MM_FMWK_JOB_LOCK();
 	list_for_each_entry_safe(job, temp, &(filp->write_head), file_list) {
 		pr_err("this  = %p[%x] next = %p, prev= %p", &job->file_list,\
 			 filp->prio, job->file_list.next, job->file_list.prev);
@@ -236,13 +548,14 @@ void mm_common_release_jobs(struct work_struct *work)
 	list_for_each_entry_safe(job, temp, &(filp->read_head), file_list) {
 		list_del_init(&job->file_list);
 		kfree(job->job.data);
-		kfree(job);
+		mm_common_free_job(job);
 		job = NULL;
 		}
 
 	list_del_init(&filp->file_head);
 
 	filp->read_count = -1;
+	MM_FMWK_JOB_UNLOCK();
 	pr_debug(" %p %d", filp, filp->read_count);
 	wake_up(&filp->read_queue);
 }
@@ -252,7 +565,9 @@ void mm_common_add_file(struct work_struct *work)
 	struct file_private_data *filp = container_of(work, \
 					struct file_private_data, \
 					work);
+	MM_FMWK_JOB_LOCK();
 	list_add_tail(&filp->file_head, &mm_file_list);
+	MM_FMWK_JOB_UNLOCK();
 }
 
 void mm_common_interlock_completion(struct dev_job_list *il_job)
@@ -298,12 +613,13 @@ void mm_common_interlock_completion(struct dev_job_list *il_job)
 					&(job->filp->write_head), file_list) {
 					int core_id = (wait_job->job.type & \
 								0xFF0000)>>16;
-					if (wait_job->job.type !=
+					if (wait_job->job.type ==
 						INTERLOCK_WAITING_JOB)
+						break;
+					if (!wait_job->held &&
+						!mm_job_fenced(wait_job))
 						mm_core_add_job(wait_job,
 						common->mm_core[core_id]);
-					else
-						break;
 					}
 				}
 			}
@@ -311,7 +627,7 @@ void mm_common_interlock_completion(struct dev_job_list *il_job)
 			*(job->notify) = true;
 			wake_up(&job->filp->wait_queue);
 			}
-		kfree(job);
+		mm_common_free_job(job);
 	}
 }
 
@@ -323,8 +639,47 @@ void mm_common_job_completion(struct dev_job_list *job, void *core)
 
 	list_del_init(&job->file_list);
 	mm_core_remove_job(job, core_dev);
+	core_dev->jobs_done++;
+	if (job->t_run) {
+		u32 run_us = div_u64(sched_clock() - job->t_run,
+				     NSEC_PER_USEC);
+
+		core_dev->busy_us += run_us;
+		raw_notifier_call_chain(&core_dev->mm_common_ifc.notifier_head,
+			MM_FMWK_NOTIFY_JOB_RUN, (void *)(unsigned long)run_us);
+	}
+	if (job->dependent) {
+		struct dev_job_list *dep = job->dependent;
+
+		dep->held = false;
+		job->dependent = NULL;
+		if ((filp->interlock_count == 0) && !mm_job_fenced(dep))
+			mm_core_add_job(dep,
+				common->mm_core[(dep->job.type & 0xFF0000) >> 16]);
+	}
+	mm_prof_trace_job(core_dev->mm_prof, job,
+		(core_dev->irq_time > job->t_start) ? core_dev->irq_time : 0,
+		core_dev->clk_on_ns);
+	core_dev->clk_on_ns = 0;
+	if (job->cache_ranges.num_ranges)
+		mm_common_cache_complete_ranges(common, job);
 	raw_notifier_call_chain(&common->mm_common_ifc.notifier_head, \
 	MM_FMWK_NOTIFY_JOB_COMPLETE, (void *) job->job.type);
+	if (job->hint.queued)
+		raw_notifier_call_chain(&common->mm_common_ifc.notifier_head,
+				MM_FMWK_NOTIFY_DEADLINE_DONE, &job->hint);
+#ifdef CONFIG_MM_SYNC
+	mm_common_fence_done(job,
+		((job->job.status == MM_JOB_STATUS_SUCCESS) ||
+		 (job->job.status == MM_JOB_STATUS_SKIP)) ? 1 : -EIO);
+#endif
+	if (job->done)
+		job->done(job->done_priv, job->job.status);
+	if (filp->t_open) {
+		common->start_us = div_u64(sched_clock() - filp->t_open,
+					NSEC_PER_USEC);
+		filp->t_open = 0;
+	}
 
 	if (filp->readable) {
 		filp->read_count++;
@@ -333,7 +688,7 @@ void mm_common_job_completion(struct dev_job_list *job, void *core)
 		}
 	else {
 		kfree(job->job.data);
-		kfree(job);
+		mm_common_free_job(job);
 		}
 
 	if (0 == list_empty(&filp->write_head)) {
@@ -355,6 +710,7 @@ static int mm_file_open(struct inode *inode, struct file *filp)
 					struct mm_common, mdev);
 	struct file_private_data *private = kzalloc( \
 			sizeof(struct file_private_data), GFP_KERNEL);
+	int i;
 
 	INIT_WORK(&(private->work), mm_common_add_file);
 	private->common = common;
@@ -365,6 +721,9 @@ static int mm_file_open(struct inode *inode, struct file *filp)
 	private->spl_data_ptr = NULL;
 	private->spl_data_size = 0;
 	private->device_locked = 0;
+	private->cache_ranges.num_ranges = 0;
+	private->job_hint.deadline_us = 0;
+	private->t_open = sched_clock();
 	atomic_set(&private->buffer_status, 0);
 	init_waitqueue_head(&private->wait_queue);
 	init_waitqueue_head(&private->read_queue);
@@ -372,6 +731,16 @@ static int mm_file_open(struct inode *inode, struct file *filp)
 	INIT_LIST_HEAD(&private->read_head);
 	INIT_LIST_HEAD(&private->write_head);
 	INIT_LIST_HEAD(&private->file_head);
+	INIT_LIST_HEAD(&private->pool_head);
+	spin_lock_init(&private->pool_lock);
+	/* the pool is only an optimisation, fall back to the cache without it */
+	private->job_pool = kmalloc(MM_JOB_POOL_SIZE *
+				sizeof(struct dev_job_list), GFP_KERNEL);
+	if (private->job_pool) {
+		for (i = 0; i < MM_JOB_POOL_SIZE; i++)
+			list_add_tail(&private->job_pool[i].file_list,
+					&private->pool_head);
+	}
 #ifdef CONFIG_MEMC_DFS
 	private->memc_init = 0;
 #endif
@@ -382,6 +751,9 @@ static int mm_file_open(struct inode *inode, struct file *filp)
 	/* Add file to global file list */
 	SCHEDULER_COMMON_WORK(common, &private->work);
 
+	/* buffers for the session get allocated next, get cma ready */
+	ion_cma_prefetch();
+
 	return 0;
 }
 
@@ -391,6 +763,12 @@ static int mm_file_release(struct inode *inode, struct file *filp)
 	struct mm_common *common = private->common;
 
 	flush_work_sync(&private->work);
+#ifdef CONFIG_MM_SYNC
+	INIT_WORK(&(private->work), mm_common_release_fences);
+	SCHEDULER_COMMON_WORK(common, &private->work);
+	flush_work_sync(&private->work);
+	wait_event(private->wait_queue, !atomic_read(&private->fence_waits));
+#endif
 	INIT_WORK(&(private->work), mm_common_release_jobs);
 	SCHEDULER_COMMON_WORK(common, &private->work);
 	flush_work_sync(&private->work);
@@ -409,70 +787,89 @@ static int mm_file_release(struct inode *inode, struct file *filp)
 			clk_disable(common->common_clk);
 		up(&common->device_sem);
 	}
+	kfree(private->job_pool);
 	kfree(private);
 	return 0;
 }
 
 static bool is_validate_file(struct file *filp);
 
-static loff_t mm_file_lseek(struct file *filp, loff_t offset, int ignore)
+static int mm_common_post_interlock_file(struct file_private_data *private,
+				struct file *input)
 {
-	struct file_private_data *private = filp->private_data;
 	struct mm_common *common = private->common;
 
-	struct file *input = fget(offset);
-
-	if (input == NULL)
-		return -EINVAL;
 	if (is_validate_file(input)) {
 		struct file_private_data *in_private = input->private_data;
+		struct workqueue_struct *in_wq =
+				in_private->common->mm_common_ifc.single_wq;
 		struct dev_job_list *to = mm_common_alloc_job(private,\
 						mm_common_interlock_job);
 		to->predecessor = mm_common_alloc_job(in_private,\
 						NULL);
 		to->predecessor->successor = to;
 
+		/* When the two files are served by different queues, the
+		 * interlock has to land after the jobs already written to
+		 * the input file and before any written after lseek */
+		if (in_wq != common->mm_common_ifc.single_wq)
+			flush_workqueue(in_wq);
 		SCHEDULER_COMMON_WORK(common, &to->work);
+		if (in_wq != common->mm_common_ifc.single_wq)
+			flush_workqueue(common->mm_common_ifc.single_wq);
 		}
 	else {
 		pr_err("unable to find file");
 		}
-	fput(input);
 	return 0;
 }
 
-static ssize_t mm_file_write(struct file *filp, const char __user *buf,
-			size_t size, loff_t *offset)
+static int mm_common_post_interlock(struct file_private_data *private,
+				unsigned int fd)
+{
+	struct file *input = fget(fd);
+	int ret;
+
+	if (input == NULL)
+		return -EINVAL;
+	ret = mm_common_post_interlock_file(private, input);
+	fput(input);
+	return ret;
+}
+
+static loff_t mm_file_lseek(struct file *filp, loff_t offset, int ignore)
 {
 	struct file_private_data *private = filp->private_data;
+
+	return mm_common_post_interlock(private, offset);
+}
+
+static int mm_common_post_job(struct file_private_data *private,
+			mm_job_type_e type, uint32_t id,
+			const void __user *buf, const void *kbuf, size_t size,
+			mm_fmwk_job_done_t done, void *priv)
+{
 	struct mm_common *common = private->common;
 	struct dev_job_list *mm_job_node = mm_common_alloc_job(private,\
 						mm_common_add_job);
 	int    core_id;
-	ssize_t ret;
+	int ret;
 	void *job_post;
 
 	if (!mm_job_node)
 		return -ENOMEM;
 
-	mm_job_node->job.size = size - 8;
-	if (size < 8) {
-		ret = -EINVAL;
-		goto out;
-	}
-
-	if (copy_from_user(&(mm_job_node->job.type), buf, \
-				sizeof(mm_job_node->job.type))) {
-		pr_err("copy_from_user failed for type");
-		ret = -EFAULT;
-		goto out;
-	}
-	size -= sizeof(mm_job_node->job.type);
-	buf += sizeof(mm_job_node->job.type);
+	mm_job_node->job.size = size;
+	mm_job_node->job.type = type & ~MM_ORDERED_JOB;
+	mm_job_node->ordered = !!(type & MM_ORDERED_JOB);
 #ifdef CONFIG_ARCH_JAVA
 	if (mm_job_node->job.type & MM_DIRTY_JOB) {
 		mm_job_node->job.type &= ~MM_DIRTY_JOB;
 		mm_job_node->job.status = MM_JOB_STATUS_DIRTY;
+		if (private->cache_ranges.num_ranges) {
+			mm_job_node->cache_ranges = private->cache_ranges;
+			private->cache_ranges.num_ranges = 0;
+		}
 	}
 	else
 		mm_job_node->job.status = MM_JOB_STATUS_READY;
@@ -481,15 +878,23 @@ static ssize_t mm_file_write(struct file *filp, const char __user *buf,
 	mm_job_node->job.status = MM_JOB_STATUS_READY;
 #endif
 
-	core_id = (mm_job_node->job.type & 0xFF0000) >> 16;
-	if (copy_from_user(&(mm_job_node->job.id), buf , \
-				sizeof(mm_job_node->job.id))) {
-		pr_err("copy_from_user failed for id");
-		ret = -EFAULT;
-		goto out;
+	if (private->job_hint.deadline_us) {
+		ktime_get_ts(&mm_job_node->hint.deadline);
+		timespec_add_ns(&mm_job_node->hint.deadline,
+			(u64)private->job_hint.deadline_us * NSEC_PER_USEC);
+		mm_job_node->hint.cycles = private->job_hint.cycles;
+		mm_job_node->hint.valid = true;
+		private->job_hint.deadline_us = 0;
 	}
-	size -= sizeof(mm_job_node->job.id);
-	buf += sizeof(mm_job_node->job.id);
+#ifdef CONFIG_MM_SYNC
+	mm_job_node->in_fence = private->in_fence;
+	mm_job_node->out_sync = private->out_sync;
+	private->in_fence = NULL;
+	private->out_sync = NULL;
+#endif
+
+	core_id = (mm_job_node->job.type & 0xFF0000) >> 16;
+	mm_job_node->job.id = id;
 	if (size > 0) {
 		uint8_t *ptr;
 		int i;
@@ -499,8 +904,12 @@ static ssize_t mm_file_write(struct file *filp, const char __user *buf,
 			goto out;
 		}
 		mm_job_node->job.data = job_post;
+		mm_job_node->done = done;
+		mm_job_node->done_priv = priv;
 		ptr = job_post;
-		if (copy_from_user(job_post, buf, size)) {
+		if (kbuf) {
+			memcpy(job_post, kbuf, size);
+		} else if (copy_from_user(job_post, buf, size)) {
 			pr_err("data copy_from_user failed");
 			ret = -EFAULT;
 			goto err_data;
@@ -510,7 +919,7 @@ static ssize_t mm_file_write(struct file *filp, const char __user *buf,
 			mm_job_node->job.size,
 			mm_job_node->job.type,
 			mm_job_node->job.id);
-		for (i = 0; i < min(size, 16); i++) {
+		for (i = 0; i < min(size, (size_t)16); i++) {
 			pr_debug("%02x", *ptr);
 			ptr++;
 		}
@@ -528,7 +937,119 @@ static ssize_t mm_file_write(struct file *filp, const char __user *buf,
 err_data:
 	kfree(job_post);
 out:
-	kfree(mm_job_node);
+	mm_common_free_job(mm_job_node);
+	return ret;
+}
+
+static ssize_t mm_file_write(struct file *filp, const char __user *buf,
+			size_t size, loff_t *offset)
+{
+	struct file_private_data *private = filp->private_data;
+	struct mm_common *common = private->common;
+	mm_job_type_e type;
+	uint32_t id;
+
+	if (size < 8)
+		return -EINVAL;
+
+	if (copy_from_user(&type, buf, sizeof(type))) {
+		pr_err("copy_from_user failed for type");
+		return -EFAULT;
+	}
+	size -= sizeof(type);
+	buf += sizeof(type);
+
+	if (copy_from_user(&id, buf, sizeof(id))) {
+		pr_err("copy_from_user failed for id");
+		return -EFAULT;
+	}
+	size -= sizeof(id);
+	buf += sizeof(id);
+
+	return mm_common_post_job(private, type, id, buf, NULL, size,
+				NULL, NULL);
+}
+
+static int mm_common_post_jobs(struct file_private_data *private,
+				mm_job_batch_t *batch)
+{
+	mm_job_desc_t desc;
+	int ret = 0;
+	int i;
+
+	if (batch->num_jobs > MM_MAX_BATCH_JOBS)
+		return -EINVAL;
+
+	for (i = 0; i < batch->num_jobs; i++) {
+		if (copy_from_user(&desc, &batch->jobs[i], sizeof(desc))) {
+			ret = -EFAULT;
+			break;
+		}
+		if (desc.type == INTERLOCK_WAITING_JOB)
+			ret = mm_common_post_interlock(private, desc.id);
+		else
+			ret = mm_common_post_job(private, desc.type, desc.id,
+						desc.data, NULL, desc.size,
+						NULL, NULL);
+		if (ret)
+			break;
+	}
+	batch->num_jobs = i;
+	return ret;
+}
+
+static int mm_common_reap_jobs(struct file_private_data *private,
+				mm_job_batch_t *batch)
+{
+	struct mm_common *common = private->common;
+	struct jobs_read_work read_jobs;
+	mm_job_desc_t desc;
+	int count = 0;
+	int ret = 0;
+
+	INIT_WORK(&(read_jobs.work), mm_common_read_jobs);
+	INIT_LIST_HEAD(&read_jobs.head);
+	read_jobs.filp = private;
+	read_jobs.max = min(batch->num_jobs, (uint32_t)MM_MAX_BATCH_JOBS);
+	batch->num_jobs = 0;
+
+	if (private->read_count <= 0)
+		return 0;
+
+	SCHEDULER_COMMON_WORK(common, &read_jobs.work);
+	flush_work_sync(&read_jobs.work);
+
+	while (!list_empty(&read_jobs.head)) {
+		struct dev_job_list *job = list_first_entry(&read_jobs.head,
+						struct dev_job_list, file_list);
+		list_del_init(&job->file_list);
+
+		if (job->job.id && (ret == 0)) {
+			if (copy_from_user(&desc, &batch->jobs[count],
+							sizeof(desc))) {
+				pr_err("copy_from_user failed");
+				ret = -EFAULT;
+				goto reap_free;
+			}
+			desc.type = job->job.type;
+			desc.id = job->job.id;
+			desc.status = job->job.status;
+			desc.size = min(desc.size, job->job.size);
+			if (copy_to_user(desc.data, job->job.data, desc.size) ||
+				copy_to_user(&batch->jobs[count], &desc,
+							sizeof(desc))) {
+				pr_err("copy_to_user failed");
+				ret = -EFAULT;
+				goto reap_free;
+			}
+			count++;
+		}
+reap_free:
+		kfree(job->job.data);
+		mm_common_free_job(job);
+	}
+
+	batch->num_jobs = count;
 	return ret;
 }
 
@@ -578,7 +1099,7 @@ static int mm_file_read(struct file *filp, \
 		bytes_read += job->job.size;
 		}
 	kfree(job->job.data);
-	kfree(job);
+	mm_common_free_job(job);
 	return bytes_read;
 mm_file_read_end:
 	return 0;
@@ -624,7 +1145,14 @@ static long mm_file_ioctl(struct file *filp, \
 	struct mm_common *common = private->common;
 	int size = 0;
 	int core = 0;
+	int i;
 	mm_dev_spl_data_t dev_spl_d;
+	mm_cache_ranges_t cache_ranges;
+	mm_job_batch_t batch;
+	mm_job_hint_t job_hint;
+#ifdef CONFIG_MM_SYNC
+	mm_job_fence_t job_fence;
+#endif
 #if defined(CONFIG_MM_SECURE_DRIVER)
 	int                core_id;
 	mm_secure_job_t    secure_job;
@@ -787,6 +1315,68 @@ static long mm_file_ioctl(struct file *filp, \
 		ret = copy_to_user((uint32_t *)arg, &flags, sizeof(int));
 	}
 	break;
+	case MM_IOCTL_SET_CACHE_RANGES:
+		if (copy_from_user(&cache_ranges, (void const *)arg,
+					sizeof(mm_cache_ranges_t))) {
+			pr_err("copy_from_user failed");
+			ret = -EINVAL;
+			break;
+		}
+		if (cache_ranges.num_ranges > MM_MAX_CACHE_RANGES) {
+			ret = -EINVAL;
+			break;
+		}
+		for (i = 0; i < cache_ranges.num_ranges; i++) {
+			if ((cache_ranges.range[i].size == 0) ||
+				(cache_ranges.range[i].op >= MM_CACHE_LAST)) {
+				ret = -EINVAL;
+				break;
+			}
+		}
+		if (ret == 0)
+			private->cache_ranges = cache_ranges;
+	break;
+	case MM_IOCTL_POST_JOBS:
+	case MM_IOCTL_READ_JOBS:
+		if (copy_from_user(&batch, (void const *)arg,
+					sizeof(mm_job_batch_t))) {
+			pr_err("copy_from_user failed");
+			ret = -EINVAL;
+			break;
+		}
+		if (cmd == MM_IOCTL_POST_JOBS)
+			ret = mm_common_post_jobs(private, &batch);
+		else
+			ret = mm_common_reap_jobs(private, &batch);
+		if (copy_to_user(&((mm_job_batch_t *)arg)->num_jobs,
+				&batch.num_jobs, sizeof(batch.num_jobs)))
+			ret = -EFAULT;
+	break;
+	case MM_IOCTL_SET_JOB_HINT:
+		if (copy_from_user(&job_hint, (void const *)arg,
+					sizeof(mm_job_hint_t))) {
+			pr_err("copy_from_user failed");
+			ret = -EINVAL;
+			break;
+		}
+		private->job_hint = job_hint;
+	break;
+#ifdef CONFIG_MM_SYNC
+	case MM_IOCTL_SET_JOB_FENCE:
+		if (copy_from_user(&job_fence, (void const *)arg,
+					sizeof(mm_job_fence_t))) {
+			pr_err("copy_from_user failed");
+			ret = -EINVAL;
+			break;
+		}
+		ret = mm_common_set_job_fence(private, &job_fence);
+		if ((ret == 0) && copy_to_user(
+				&((mm_job_fence_t *)arg)->out_fence,
+				&job_fence.out_fence,
+				sizeof(job_fence.out_fence)))
+			ret = -EFAULT;
+	break;
+#endif
 #ifdef CONFIG_MEMC_DFS
 	case MM_IOCTL_MEMC_SET:
 	{
@@ -799,7 +1389,12 @@ static long mm_file_ioctl(struct file *filp, \
 			private->set_freq = 0;
 		}
 
+#ifdef CONFIG_MEMC_DFS_GOV
+		/* a floor only, the governor goes to turbo on the traffic */
+		memc_update_dfs_req(&private->memc_node, MEMC_OPP_NORMAL);
+#else
 		memc_update_dfs_req(&private->memc_node, MEMC_OPP_TURBO);
+#endif
 		private->set_freq++ ;
 	}
 	break;
@@ -834,6 +1429,50 @@ static bool is_validate_file(struct file *filp)
 	return (filp->f_op == (&mm_fops));
 }
 
+struct file *mm_fmwk_fget(unsigned int fd)
+{
+	struct file *filp = fget(fd);
+
+	if (filp && !is_validate_file(filp)) {
+		fput(filp);
+		filp = NULL;
+	}
+	return filp;
+}
+EXPORT_SYMBOL(mm_fmwk_fget);
+
+struct file *mm_fmwk_open(const char *name)
+{
+	char path[48];
+	struct file *filp;
+
+	snprintf(path, sizeof(path), "/dev/%s", name);
+	filp = filp_open(path, O_RDWR, 0);
+	if (!IS_ERR(filp) && !is_validate_file(filp)) {
+		filp_close(filp, NULL);
+		filp = ERR_PTR(-ENODEV);
+	}
+	return filp;
+}
+EXPORT_SYMBOL(mm_fmwk_open);
+
+int mm_fmwk_post_job(struct file *filp, mm_job_type_e type, uint32_t id,
+			const void *data, size_t size,
+			mm_fmwk_job_done_t done, void *priv)
+{
+	if (!data)
+		return -EINVAL;
+	return mm_common_post_job(filp->private_data, type, id, NULL, data,
+				size, done, priv);
+}
+EXPORT_SYMBOL(mm_fmwk_post_job);
+
+int mm_fmwk_post_interlock(struct file *filp, struct file *input)
+{
+	return mm_common_post_interlock_file(filp->private_data, input);
+}
+EXPORT_SYMBOL(mm_fmwk_post_interlock);
+
 void *mm_fmwk_register(const char *name, const char *clk_name,
 						unsigned int count,
 						MM_CORE_HW_IFC *core_param,
@@ -891,8 +1530,27 @@ void *mm_fmwk_register(const char *name, const char *clk_name,
 					common->mm_common_ifc.mm_name);
 		goto err_register;
 	}
+	debugfs_create_u32("start_us", S_IRUSR | S_IRGRP,
+			common->mm_common_ifc.debugfs_dir, &common->start_us);
 
 	mutex_lock(&mm_fmwk_mutex);
+	if (mm_job_cachep == NULL) {
+		mm_job_cachep = kmem_cache_create("mm_job",
+				sizeof(struct dev_job_list), 0,
+				SLAB_HWCACHE_ALIGN, NULL);
+		if (mm_job_cachep == NULL) {
+			mutex_unlock(&mm_fmwk_mutex);
+			goto err_register;
+		}
+	}
+#ifdef CONFIG_MM_PARALLEL_WQ
+	common->mm_common_ifc.single_wq = alloc_ordered_workqueue("%s:%s", 0,
+			single_wq_name, common->mm_common_ifc.mm_name);
+	if (common->mm_common_ifc.single_wq == NULL) {
+		mutex_unlock(&mm_fmwk_mutex);
+		goto err_register;
+		}
+#else
 	if (single_wq == NULL) {
 		single_wq = alloc_workqueue(single_wq_name,
 				WQ_NON_REENTRANT, 1);
@@ -902,6 +1560,7 @@ void *mm_fmwk_register(const char *name, const char *clk_name,
 			}
 		}
 	common->mm_common_ifc.single_wq = single_wq;
+#endif
 	list_add_tail(&common->device_list, &mm_dev_list);
 	mutex_unlock(&mm_fmwk_mutex);
 
@@ -960,6 +1619,10 @@ void mm_fmwk_unregister(void *dev_name)
 
 	misc_deregister(&common->mdev);
 
+#ifdef CONFIG_MM_PARALLEL_WQ
+	if (common->mm_common_ifc.single_wq)
+		destroy_workqueue(common->mm_common_ifc.single_wq);
+#endif
 	common->mm_common_ifc.single_wq = NULL;
 		kfree(common->mm_common_ifc.mm_name);
 		kfree(common);
@@ -16,11 +16,25 @@ the GPL, without Broadcom's express prior written consent.
 
 #include <linux/broadcom/mm_fw_hw_ifc.h>
 #include <linux/broadcom/mm_fw_usr_ifc.h>
+#include "mm_sync.h"
 #ifdef CONFIG_MEMC_DFS
 #include <plat/kona_memc.h>
 #endif
+#define SUPER_TURBO_RATE 312
 #define TURBO_RATE 250
 #define NORMAL_RATE 166
+#ifdef CONFIG_MM_312M_SOURCE_CLK
+#define ECONOMY_RATE 100
+#else
+#define ECONOMY_RATE 83
+#endif
+
+/* Above this many bytes per job a full set/way clean is cheaper than
+ * walking the job's buffer ranges line by line */
+#define MM_CACHE_RANGE_MAX_SIZE (512 * 1024)
+
+/* Job descriptors preallocated per open file */
+#define MM_JOB_POOL_SIZE 16
 
 enum {
 	MM_FMWK_NOTIFY_INVALID = 0,
@@ -30,7 +44,23 @@ enum {
 	MM_FMWK_NOTIFY_CLK_ENABLE,
 	MM_FMWK_NOTIFY_CLK_DISABLE,
 
-	MM_FMWK_NOTIFY_DVFS_UPDATE
+	MM_FMWK_NOTIFY_DVFS_UPDATE,
+
+	/* data is the job's struct mm_job_hint */
+	MM_FMWK_NOTIFY_DEADLINE_ADD,
+	MM_FMWK_NOTIFY_DEADLINE_DONE,
+
+	/* on the core, data is the job's run time in microseconds */
+	MM_FMWK_NOTIFY_JOB_RUN
+};
+
+/* Deadline hint of a queued job, linked into mm_dvfs while queued */
+struct mm_job_hint {
+	struct list_head node;
+	struct timespec deadline;
+	u32 cycles;
+	bool valid;
+	bool queued;
 };
 
 struct _mm_common_ifc {
@@ -55,6 +85,8 @@ struct mm_common {
 	void *mm_core[MAX_ASYMMETRIC_PROC];
 	void *mm_dvfs;
 	void *mm_prof;
+	/* open to first completed job, of the latest session */
+	u32 start_us;
 
     /* Used for exporting per-device information to debugfs */
 	struct semaphore device_sem;
@@ -77,6 +109,22 @@ struct file_private_data {
 	int spl_data_size;
 	u8 device_locked;
 	atomic_t buffer_status;
+	mm_cache_ranges_t cache_ranges;
+	mm_job_hint_t job_hint;
+
+	struct dev_job_list *job_pool;
+	struct list_head pool_head;
+	spinlock_t pool_lock;
+	/* sched_clock() at open, 0 once a job has completed */
+	u64 t_open;
+
+#ifdef CONFIG_MM_SYNC
+	/* MM_IOCTL_SET_JOB_FENCE, for the next job written */
+	struct sync_fence *in_fence;
+	struct mm_sync_timeline *out_sync;
+	/* jobs waiting for their in fence, see mm_file_release() */
+	atomic_t fence_waits;
+#endif
 
 #ifdef CONFIG_MEMC_DFS
 	int memc_init;
@@ -98,10 +146,47 @@ struct dev_job_list {
 	struct dev_job_list *successor;
 	struct dev_job_list *predecessor;
 
+	/* MM_ORDERED_JOB: held off the core until its predecessor on
+	 * the file, whose dependent it is, completes */
+	struct dev_job_list *dependent;
+	bool ordered;
+	bool held;
+
 	mm_job_post_t job;
 	struct file_private_data *filp;
+	mm_cache_ranges_t cache_ranges;
+	struct mm_job_hint hint;
+
+	/* in-kernel poster, see mm_fmwk_post_job() */
+	mm_fmwk_job_done_t done;
+	void *done_priv;
+
+	/* job trace timestamps, see mm_prof_trace_job() */
+	u64 t_add;
+	u64 t_start;
+	/* sched_clock() at first start, for the core's run time */
+	u64 t_run;
+
+#ifdef CONFIG_MM_SYNC
+	/* held off the core until in_fence signals */
+	struct sync_fence *in_fence;
+	struct sync_fence_waiter fence_waiter;
+	struct work_struct fence_work;
+	bool fenced;
+	struct mm_sync_timeline *out_sync;
+#endif
 };
 
+/* waiting for its in fence, see MM_IOCTL_SET_JOB_FENCE */
+static inline bool mm_job_fenced(struct dev_job_list *job)
+{
+#ifdef CONFIG_MM_SYNC
+	return job->fenced;
+#else
+	return false;
+#endif
+}
+
 struct dev_status_list {
 	mm_job_status_t status;
 	struct list_head wait_list;
@@ -110,14 +195,32 @@ struct dev_status_list {
 
 extern void v7_clean_dcache_all(void);
 void mm_common_cache_clean(void);
+bool mm_common_cache_sync_ranges(struct mm_common *common,
+				struct dev_job_list *job,
+				unsigned int max_size);
+void mm_common_cache_complete_ranges(struct mm_common *common,
+				struct dev_job_list *job);
 void mm_common_interlock_completion(struct dev_job_list *job);
+void mm_common_free_job(struct dev_job_list *job);
 void mm_common_enable_clock(struct mm_common *common);
 void mm_common_disable_clock(struct mm_common *common);
 void mm_common_job_completion(struct dev_job_list *job, void *core);
 
 #define SCHEDULER_WORK(core, work) \
 		queue_work_on(0, core->mm_common->mm_common_ifc.single_wq, work)
-#define SET_IRQ_AFFINITY irq_set_affinity(hw_ifc->mm_irq, cpumask_of(0))
+#define SET_IRQ_AFFINITY irq_set_affinity(hw_ifc->mm_irq, \
+					cpumask_of(core_dev->mm_cpu))
+
+#ifdef CONFIG_MM_PARALLEL_WQ
+/* Work no longer runs on a single queue, so job and file lists need
+ * an explicit lock */
+extern struct mutex mm_fmwk_job_mutex;
+#define MM_FMWK_JOB_LOCK() mutex_lock(&mm_fmwk_job_mutex)
+#define MM_FMWK_JOB_UNLOCK() mutex_unlock(&mm_fmwk_job_mutex)
+#else
+#define MM_FMWK_JOB_LOCK() do { } while (0)
+#define MM_FMWK_JOB_UNLOCK() do { } while (0)
+#endif
 
 
 #endif
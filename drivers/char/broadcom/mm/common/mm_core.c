@@ -12,10 +12,58 @@ the GPL, without Broadcom's express prior written consent.
 *******************************************************************************/
 
 #include <linux/slab.h>
+#include <linux/module.h>
+#include <linux/spinlock.h>
 
 #define pr_fmt(fmt) "<%s> " fmt "\n", core_dev->mm_common->mm_common_ifc.mm_name
 
 #include "mm_core.h"
+
+#define MM_CORES_MAX 16
+
+/* registered cores, for mm_fmwk_core_stats() */
+static struct mm_core *mm_cores[MM_CORES_MAX];
+static DEFINE_SPINLOCK(mm_cores_lock);
+
+int mm_fmwk_core_stats(mm_fmwk_core_stats_t *stats, int max)
+{
+	unsigned long flags;
+	int i, n = 0;
+
+	spin_lock_irqsave(&mm_cores_lock, flags);
+	for (i = 0; i < MM_CORES_MAX && n < max; i++) {
+		if (mm_cores[i] == NULL)
+			continue;
+		stats[n].name = mm_cores[i]->mm_common_ifc.mm_name;
+		stats[n].queued = mm_cores[i]->queued;
+		stats[n].busy_us = mm_cores[i]->busy_us;
+		stats[n].jobs_done = mm_cores[i]->jobs_done;
+		stats[n].clk_on_us = mm_cores[i]->clk_on_us;
+		if (mm_cores[i]->mm_common_ifc.mm_hw_is_on)
+			stats[n].clk_on_us += div_u64(sched_clock() -
+					mm_cores[i]->t_clk_on, NSEC_PER_USEC);
+		stats[n].cache_us = mm_cores[i]->cache_us;
+		n++;
+	}
+	spin_unlock_irqrestore(&mm_cores_lock, flags);
+	return n;
+}
+EXPORT_SYMBOL(mm_fmwk_core_stats);
+
+static void mm_core_stats_register(struct mm_core *core_dev, bool add)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&mm_cores_lock, flags);
+	for (i = 0; i < MM_CORES_MAX; i++)
+		if (mm_cores[i] == (add ? NULL : core_dev)) {
+			mm_cores[i] = add ? core_dev : NULL;
+			break;
+		}
+	spin_unlock_irqrestore(&mm_cores_lock, flags);
+}
+
 void dev_timer_callback(unsigned long data)
 {
 	struct mm_core *core_dev = (struct mm_core *)data;
@@ -48,6 +96,11 @@ static irqreturn_t dev_isr(int irq, void *data)
 	case MM_ISR_ERROR:
 		pr_err("mm_isr %d", retval);
 	case MM_ISR_SUCCESS:
+		core_dev->irq_time = mm_prof_trace_time();
+#ifdef CONFIG_MM_IRQ_COMPLETION
+		if (core_dev->irq_thread_on)
+			return IRQ_WAKE_THREAD;
+#endif
 		SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
 	case MM_ISR_PROCESSED:
 		ret = 1;
@@ -59,12 +112,18 @@ static irqreturn_t dev_isr(int irq, void *data)
 	return IRQ_RETVAL(ret);
 }
 
+#ifdef CONFIG_MM_IRQ_COMPLETION
+static irqreturn_t dev_isr_thread(int irq, void *data);
+#endif
+
 static int mm_core_enable_clock(struct mm_core *core_dev)
 {
 	MM_CORE_HW_IFC *hw_ifc = &core_dev->mm_device;
 	int ret = 0;
 
 	if (core_dev->mm_common_ifc.mm_hw_is_on == 0) {
+		u64 t_on = mm_prof_trace_time();
+
 		mm_common_enable_clock(core_dev->mm_common);
 		pr_debug("dev turned on ");
 		hw_ifc->mm_init(hw_ifc->mm_device_id);
@@ -74,11 +133,21 @@ static int mm_core_enable_clock(struct mm_core *core_dev)
 
 		/* Request interrupt */
 		if (hw_ifc->mm_irq) {
+#ifdef CONFIG_MM_IRQ_COMPLETION
+			core_dev->irq_thread_on = (core_dev->irq_completion != 0);
+			ret = request_threaded_irq(hw_ifc->mm_irq, \
+						dev_isr, \
+				core_dev->irq_thread_on ? dev_isr_thread : NULL, \
+						IRQF_SHARED, \
+				core_dev->mm_common->mm_common_ifc.mm_name, \
+						core_dev);
+#else
 			ret = request_irq(hw_ifc->mm_irq, \
 						dev_isr, \
 						IRQF_SHARED, \
 				core_dev->mm_common->mm_common_ifc.mm_name, \
 						core_dev);
+#endif
 			if (ret)
 				pr_err("request_irq failed for %s ret = %d", \
 					core_dev->mm_common->
@@ -87,6 +156,8 @@ static int mm_core_enable_clock(struct mm_core *core_dev)
 			}
 
 		core_dev->mm_common_ifc.mm_hw_is_on = 1;
+		core_dev->clk_on_ns = mm_prof_trace_time() - t_on;
+		core_dev->t_clk_on = sched_clock();
 
 		init_timer(&(core_dev->dev_timer));
 		setup_timer(&(core_dev->dev_timer), \
@@ -110,6 +181,8 @@ static void mm_core_disable_clock(struct mm_core *core_dev)
 			free_irq(hw_ifc->mm_irq, core_dev);
 		hw_ifc->mm_deinit(hw_ifc->mm_device_id);
 		core_dev->mm_common_ifc.mm_hw_is_on = false;
+		core_dev->clk_on_us += div_u64(sched_clock() -
+					core_dev->t_clk_on, NSEC_PER_USEC);
 		pr_debug("dev turned off ");
 		mm_common_disable_clock(core_dev->mm_common);
 
@@ -118,40 +191,103 @@ static void mm_core_disable_clock(struct mm_core *core_dev)
 		}
 }
 
-static unsigned int dirty_cnt;
-static unsigned int clean_cnt;
-static void mm_fmwk_job_scheduler(struct work_struct *work)
+static void mm_core_cache_prepare(struct mm_core *core_dev,
+				struct dev_job_list *job)
+{
+	if (job->job.status == MM_JOB_STATUS_READY)
+			core_dev->clean_cnt++;
+
+	if (job->job.status == MM_JOB_STATUS_DIRTY) {
+		u64 t = sched_clock();
+
+		if (mm_common_cache_sync_ranges(core_dev->mm_common,
+				job, core_dev->cache_range_max))
+			core_dev->range_clean_cnt++;
+		else {
+			mm_common_cache_clean();
+			core_dev->full_clean_cnt++;
+		}
+		core_dev->cache_us += div_u64(sched_clock() - t, NSEC_PER_USEC);
+		core_dev->dirty_cnt++;
+		if ((core_dev->dirty_cnt % 1000) == 0)
+			pr_debug("mm jobs dirty=%d, clean=%d, range=%d, full=%d\n",
+			core_dev->dirty_cnt, core_dev->clean_cnt,
+			core_dev->range_clean_cnt, core_dev->full_clean_cnt);
+	}
+}
+
+/* Hand the job behind the running one to the core driver, so that it
+ * can be launched from the completion IRQ without waiting for us */
+static void mm_core_stage_next_job(struct mm_core *core_dev)
+{
+	MM_CORE_HW_IFC *hw_ifc = &core_dev->mm_device;
+	struct dev_job_list *head;
+	struct dev_job_list *next;
+
+	if ((hw_ifc->mm_prepare_job == NULL) || core_dev->staged_job)
+		return;
+
+	head = list_first_entry(&(core_dev->job_list),
+				struct dev_job_list, core_list);
+	if (list_is_last(&head->core_list, &core_dev->job_list))
+		return;
+	next = list_entry(head->core_list.next,
+				struct dev_job_list, core_list);
+	if (next->job.size == 0)
+		return;
+
+	mm_core_cache_prepare(core_dev, next);
+	if (next->job.status != MM_JOB_STATUS_READY)
+		return;
+	if (hw_ifc->mm_prepare_job(hw_ifc->mm_device_id, &next->job) == 0)
+		core_dev->staged_job = next;
+}
+
+static inline bool mm_core_staged_job_running(struct mm_core *core_dev)
+{
+	return core_dev->staged_job &&
+		(core_dev->staged_job->job.status == MM_JOB_STATUS_RUNNING);
+}
+
+static bool _mm_fmwk_job_scheduler(struct mm_core *core_dev)
 {
 	mm_job_status_e status = MM_JOB_STATUS_INVALID;
 	bool is_hw_busy = false;
 	struct dev_job_list *job_list_elem;
-
-	struct mm_core *core_dev = container_of(work, \
-					struct mm_core, \
-					job_scheduler);
 	MM_CORE_HW_IFC *hw_ifc = &core_dev->mm_device;
+	unsigned long timeout = hw_ifc->mm_timer;
 
 	if (list_empty(&core_dev->job_list))
-		return;
+		goto mm_fmwk_job_scheduler_done;
 
 	job_list_elem = list_first_entry(
 		&(core_dev->job_list), struct dev_job_list, core_list);
 
-	if (job_list_elem->job.status == MM_JOB_STATUS_READY)
-			clean_cnt++;
-
-	if (job_list_elem->job.status == MM_JOB_STATUS_DIRTY) {
-		mm_common_cache_clean();
-		dirty_cnt++;
-		if ((dirty_cnt % 1000) == 0)
-			pr_debug("mm jobs dirty=%d, clean=%d\n",
-			dirty_cnt, clean_cnt);
+	if (job_list_elem == core_dev->staged_job) {
+		/* the previous job is retired, take the staged one back; if
+		 * the driver already launched it, it only needs a deadline */
+		hw_ifc->mm_prepare_job(hw_ifc->mm_device_id, NULL);
+		core_dev->staged_job = NULL;
+		if (job_list_elem->job.status == MM_JOB_STATUS_RUNNING) {
+			/* launched from the previous job's IRQ */
+			job_list_elem->t_start = core_dev->irq_time;
+			job_list_elem->t_run = sched_clock();
+			getnstimeofday(&core_dev->sched_time);
+			timespec_add_ns(&core_dev->sched_time,
+				hw_ifc->mm_timeout * NSEC_PER_MSEC);
+			core_dev->mm_core_idle = false;
+		}
+	} else {
+		mm_core_cache_prepare(core_dev, job_list_elem);
 	}
 
 	if (mm_core_enable_clock(core_dev))
 		goto mm_fmwk_job_scheduler_done;
 
 	is_hw_busy = hw_ifc->mm_get_status(hw_ifc->mm_device_id);
+	/* busy with the staged job means the head job has finished */
+	if (is_hw_busy && mm_core_staged_job_running(core_dev))
+		is_hw_busy = false;
 	if (!is_hw_busy) {
 		if (job_list_elem->job.size) {
 
@@ -159,6 +295,11 @@ static void mm_fmwk_job_scheduler(struct work_struct *work)
 					hw_ifc->mm_device_id, \
 					&job_list_elem->job, 0);
 			if (status < MM_JOB_STATUS_SUCCESS) {
+				if (job_list_elem->t_start == 0)
+					job_list_elem->t_start =
+						mm_prof_trace_time();
+				if (job_list_elem->t_run == 0)
+					job_list_elem->t_run = sched_clock();
 				getnstimeofday(&core_dev->sched_time);
 				timespec_add_ns(\
 				&core_dev->sched_time, \
@@ -202,24 +343,157 @@ static void mm_fmwk_job_scheduler(struct work_struct *work)
 			pr_err("abort hw ");
 				hw_ifc->mm_abort(hw_ifc->mm_device_id, \
 				&job_list_elem->job);
+			mm_core_unstage_job(core_dev);
 			core_dev->mm_core_idle = true;
 			is_hw_busy = false;
 			SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
 			}
 		}
 
+	/* keep the clocks on for the staged job */
+	if (!is_hw_busy && mm_core_staged_job_running(core_dev))
+		is_hw_busy = true;
+
 	if (is_hw_busy) {
+		mm_core_stage_next_job(core_dev);
+#ifdef CONFIG_MM_IRQ_COMPLETION
+		/* completion comes from the IRQ thread, the timer is only
+		 * the watchdog for mm_timeout */
+		if (core_dev->irq_thread_on)
+			timeout = hw_ifc->mm_timeout + 1;
+#endif
 		mod_timer(&core_dev->dev_timer, \
-			jiffies + msecs_to_jiffies(hw_ifc->mm_timer));
+			jiffies + msecs_to_jiffies(timeout));
 		pr_debug("mod_timer  %lx %lx", \
 				jiffies, \
-				msecs_to_jiffies(hw_ifc->mm_timer));
-		return;
+				msecs_to_jiffies(timeout));
+		return true;
 		}
 
 mm_fmwk_job_scheduler_done:
+#ifdef CONFIG_MM_IRQ_COMPLETION
+	/* free_irq() cannot be called from the IRQ thread itself, leave
+	 * powering down to the scheduler work */
+	if (core_dev->in_irq_thread) {
+		SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
+		return false;
+	}
+#endif
 	mm_core_disable_clock(core_dev);
+	return false;
+}
+
+static void mm_fmwk_job_scheduler(struct work_struct *work)
+{
+	struct mm_core *core_dev = container_of(work, \
+					struct mm_core, \
+					job_scheduler);
+
+	MM_FMWK_JOB_LOCK();
+	_mm_fmwk_job_scheduler(core_dev);
+	MM_FMWK_JOB_UNLOCK();
+}
+
+#ifdef CONFIG_MM_IRQ_COMPLETION
+/* Retire the finished job and start the next queued ones straight from
+ * the IRQ thread, without a round trip through the work queue and
+ * without toggling the clocks between jobs */
+static irqreturn_t dev_isr_thread(int irq, void *data)
+{
+	struct mm_core *core_dev = (struct mm_core *)data;
+	int loops = 0;
+
+	/* the scheduler work may be waiting in free_irq() for us while
+	 * holding the lock, let it handle the completion instead */
+	if (!mutex_trylock(&mm_fmwk_job_mutex)) {
+		SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
+		return IRQ_HANDLED;
+	}
+
+	core_dev->in_irq_thread = true;
+	while (!_mm_fmwk_job_scheduler(core_dev) &&
+		!list_empty(&core_dev->job_list) &&
+		(++loops < MM_IRQ_THREAD_MAX_JOBS))
+		;
+	core_dev->in_irq_thread = false;
+	MM_FMWK_JOB_UNLOCK();
+
+	return IRQ_HANDLED;
+}
+#endif
+
+#ifdef CONFIG_MM_PARALLEL_WQ
+static ssize_t mm_core_cpu_show(struct kobject *kobj,
+			struct kobj_attribute *attr, char *buf)
+{
+	struct mm_core *core_dev = container_of(attr, struct mm_core,
+							cpu_attr);
+
+	return sprintf(buf, "%d\n", core_dev->mm_cpu);
+}
+
+static ssize_t mm_core_cpu_store(struct kobject *kobj,
+			struct kobj_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct mm_core *core_dev = container_of(attr, struct mm_core,
+							cpu_attr);
+	MM_CORE_HW_IFC *hw_ifc = &core_dev->mm_device;
+	unsigned long cpu;
+
+	if (kstrtoul(buf, 0, &cpu) || (cpu >= nr_cpu_ids) || !cpu_online(cpu))
+		return -EINVAL;
+
+	if (cpu != core_dev->mm_cpu) {
+		/* the scheduler work is a single work item, so draining it
+		 * from the old CPU is enough to keep job order */
+		core_dev->mm_cpu = cpu;
+		flush_workqueue(core_dev->mm_common_ifc.single_wq);
+		MM_FMWK_JOB_LOCK();
+		if (core_dev->mm_common_ifc.mm_hw_is_on && hw_ifc->mm_irq)
+			SET_IRQ_AFFINITY;
+		MM_FMWK_JOB_UNLOCK();
+	}
+	return count;
+}
+
+static int mm_core_sysfs_init(struct mm_core *core_dev,
+			MM_CORE_HW_IFC *core_params)
+{
+	struct device *dev = core_dev->mm_common->mdev.this_device;
+
+	core_dev->mm_common_ifc.single_wq = alloc_workqueue("%s",
+					WQ_NON_REENTRANT, 1,
+					core_dev->mm_common_ifc.mm_name);
+	if (core_dev->mm_common_ifc.single_wq == NULL)
+		return -ENOMEM;
+
+	if (dev == NULL)
+		return 0;
+	core_dev->kobj = kobject_create_and_add(core_params->core_name,
+						&dev->kobj);
+	if (core_dev->kobj == NULL)
+		return 0;
+	sysfs_attr_init(&core_dev->cpu_attr.attr);
+	core_dev->cpu_attr.attr.name = "cpu";
+	core_dev->cpu_attr.attr.mode = S_IWUSR | S_IRUGO;
+	core_dev->cpu_attr.show = mm_core_cpu_show;
+	core_dev->cpu_attr.store = mm_core_cpu_store;
+	if (sysfs_create_file(core_dev->kobj, &core_dev->cpu_attr.attr))
+		pr_err("failed to create cpu sysfs file");
+	return 0;
+}
+
+static void mm_core_sysfs_exit(struct mm_core *core_dev)
+{
+	if (core_dev->kobj) {
+		sysfs_remove_file(core_dev->kobj, &core_dev->cpu_attr.attr);
+		kobject_put(core_dev->kobj);
+	}
+	if (core_dev->mm_common_ifc.single_wq)
+		destroy_workqueue(core_dev->mm_common_ifc.single_wq);
 }
+#endif
 
 
 static int validate(MM_CORE_HW_IFC *core_params)
@@ -252,6 +526,10 @@ void *mm_core_init(struct mm_common *mm_common, \
 	INIT_LIST_HEAD(&(core_dev->job_list));
 	core_dev->device_job_id = 1;
 	core_dev->mm_core_idle = true;
+	core_dev->cache_range_max = MM_CACHE_RANGE_MAX_SIZE;
+#ifdef CONFIG_MM_IRQ_COMPLETION
+	core_dev->irq_completion = 1;
+#endif
 	core_dev->mm_common_ifc.mm_hw_is_on = false;
 
 	core_dev->mm_common = mm_common;
@@ -284,18 +562,44 @@ void *mm_core_init(struct mm_common *mm_common, \
 			&core_dev->mm_common->mm_common_ifc.notifier_head,
 						&core_dev->notifier_block);
 
-	core_dev->mm_common_ifc.single_wq = mm_common->mm_common_ifc.single_wq;
 	core_dev->mm_common_ifc.mm_name = kmalloc(sizeof(char)*32, GFP_KERNEL);
 	strncpy(core_dev->mm_common_ifc.mm_name,
 			mm_common->mm_common_ifc.mm_name,
 			strlen(mm_common->mm_common_ifc.mm_name)+1);
 	strcat(core_dev->mm_common_ifc.mm_name, ":");
 	strcat(core_dev->mm_common_ifc.mm_name, core_params->core_name);
+#ifdef CONFIG_MM_PARALLEL_WQ
+	if (mm_core_sysfs_init(core_dev, core_params))
+		goto err_register;
+#else
+	core_dev->mm_common_ifc.single_wq = mm_common->mm_common_ifc.single_wq;
+#endif
 	core_dev->mm_common_ifc.debugfs_dir =
 				debugfs_create_dir(core_params->core_name,
 					mm_common->mm_common_ifc.debugfs_dir);
+	if (core_dev->mm_common_ifc.debugfs_dir) {
+		struct dentry *dir = core_dev->mm_common_ifc.debugfs_dir;
+
+		debugfs_create_u32("dirty_cnt", S_IRUSR | S_IRGRP, dir,
+						&core_dev->dirty_cnt);
+		debugfs_create_u32("clean_cnt", S_IRUSR | S_IRGRP, dir,
+						&core_dev->clean_cnt);
+		debugfs_create_u32("range_clean_cnt", S_IRUSR | S_IRGRP, dir,
+						&core_dev->range_clean_cnt);
+		debugfs_create_u32("full_clean_cnt", S_IRUSR | S_IRGRP, dir,
+						&core_dev->full_clean_cnt);
+		debugfs_create_u32("cache_range_max",
+				S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP, dir,
+						&core_dev->cache_range_max);
+#ifdef CONFIG_MM_IRQ_COMPLETION
+		debugfs_create_u32("irq_completion",
+				S_IWUSR | S_IWGRP | S_IRUSR | S_IRGRP, dir,
+						&core_dev->irq_completion);
+#endif
+	}
 	core_dev->mm_prof = mm_prof_init(&(core_dev->mm_common_ifc),
 						core_params->core_name, NULL);
+	mm_core_stats_register(core_dev, true);
 	return core_dev;
 
 err_register:
@@ -309,11 +613,16 @@ err_register2:
 void mm_core_exit(void *dev_handle)
 {
 	struct mm_core *core_dev = (struct mm_core *)dev_handle;
+
+	mm_core_stats_register(core_dev, false);
 	raw_notifier_chain_unregister(
 			&core_dev->mm_common->mm_common_ifc.notifier_head,
 						&core_dev->notifier_block);
 	if (core_dev->mm_prof)
 		mm_prof_exit(core_dev->mm_prof);
+#ifdef CONFIG_MM_PARALLEL_WQ
+	mm_core_sysfs_exit(core_dev);
+#endif
 	kfree(core_dev->mm_common_ifc.mm_name);
 	if (core_dev->mm_common_ifc.debugfs_dir)
 		debugfs_remove_recursive(core_dev->mm_common_ifc.debugfs_dir);
@@ -19,8 +19,11 @@ the GPL, without Broadcom's express prior written consent.
 
 #undef SCHEDULER_WORK
 #define SCHEDULER_WORK(core, work)\
-		queue_work_on(0, core->mm_common_ifc.single_wq,\
+		queue_work_on(core->mm_cpu, core->mm_common_ifc.single_wq,\
 									work);
+/* Jobs the IRQ thread may retire and start back to back */
+#define MM_IRQ_THREAD_MAX_JOBS 8
+
 struct mm_core {
 	struct _mm_common_ifc mm_common_ifc;
 	struct _mm_prof *mm_prof;
@@ -37,6 +40,39 @@ struct mm_core {
 	struct list_head job_list;
 	uint32_t device_job_id;
 	struct notifier_block notifier_block;
+	/* job handed to mm_prepare_job, behind the head of job_list */
+	struct dev_job_list *staged_job;
+
+	/* cache maintenance statistics, exported in debugfs */
+	u32 dirty_cnt;
+	u32 clean_cnt;
+	u32 range_clean_cnt;
+	u32 full_clean_cnt;
+	u32 cache_range_max;
+
+	/* for the job trace: last completion IRQ and power up latency */
+	u64 irq_time;
+	u32 clk_on_ns;
+
+	/* see mm_fmwk_core_stats() */
+	u32 queued;
+	u32 busy_us;
+	u32 jobs_done;
+	u32 clk_on_us;
+	u32 cache_us;
+	u64 t_clk_on;
+
+	/* CPU running the job scheduler and the IRQ of this core */
+	int mm_cpu;
+#ifdef CONFIG_MM_PARALLEL_WQ
+	struct kobject *kobj;
+	struct kobj_attribute cpu_attr;
+#endif
+#ifdef CONFIG_MM_IRQ_COMPLETION
+	u32 irq_completion;	/* debugfs knob, sampled at power up */
+	bool irq_thread_on;
+	bool in_irq_thread;
+#endif
 };
 
 static inline void mm_core_add_job(
@@ -51,20 +87,38 @@ static inline void mm_core_add_job(
 		job->core_list.prev);*/
 	list_add_tail(&(job->core_list), &(core_dev->job_list));
 	job->added2core = true;
+	core_dev->queued++;
 	if (core_dev->mm_core_idle)
 		SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
 	raw_notifier_call_chain(&core_dev->mm_common_ifc.notifier_head,
 					MM_FMWK_NOTIFY_JOB_ADD, NULL);
 }
 
+/* Take back the staged job. Only called once the hardware is idle or
+ * reset, so a launched staged job has to be started again. */
+static inline void mm_core_unstage_job(struct mm_core *core_dev)
+{
+	MM_CORE_HW_IFC *hw_ifc = &core_dev->mm_device;
+
+	if (core_dev->staged_job == NULL)
+		return;
+	hw_ifc->mm_prepare_job(hw_ifc->mm_device_id, NULL);
+	if (core_dev->staged_job->job.status == MM_JOB_STATUS_RUNNING)
+		core_dev->staged_job->job.status = MM_JOB_STATUS_READY;
+	core_dev->staged_job = NULL;
+}
+
 static inline void mm_core_remove_job(
 			struct dev_job_list *job,
 			struct mm_core *core_dev)
 {
 	if (job->added2core == false)
 		return;
+	if (job == core_dev->staged_job)
+		mm_core_unstage_job(core_dev);
 	list_del_init(&job->core_list);
 	job->added2core = false;
+	core_dev->queued--;
 }
 
 static inline void mm_core_abort_job(
@@ -79,6 +133,7 @@ static inline void mm_core_abort_job(
 		pr_err("aborting hw in release for common %s\n",\
 				common->mm_common_ifc.mm_name);
 		hw_ifc->mm_abort(hw_ifc->mm_device_id, &job->job);
+		mm_core_unstage_job(core_dev);
 		core_dev->mm_core_idle = true;
 		SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
 	}
@@ -126,12 +181,14 @@ static inline void mm_core_secure_job_done(struct work_struct *p_work)
 
 	pr_debug("Signaling completion of secure job %s\n",
 			common->mm_common_ifc.mm_name);
+	MM_FMWK_JOB_LOCK();
 	if (hw_ifc->mm_secure_job_done)
 		ret = hw_ifc->mm_secure_job_done(
 				hw_ifc->mm_device_id, p_secure_job);
 	else
 		BUG();
 	SCHEDULER_WORK(core_dev, &core_dev->job_scheduler);
+	MM_FMWK_JOB_UNLOCK();
 
 	p_secure_work->ret = ret;
 }
@@ -16,6 +16,121 @@ the GPL, without Broadcom's express prior written consent.
 
 #include "mm_dvfs.h"
 
+/* MM clock in MHz (cycles per microsecond) at each OPP */
+static const unsigned int mm_dvfs_opp_rate[PI_OPP_MAX] = {
+	[ECONOMY] = ECONOMY_RATE,
+	[NORMAL] = NORMAL_RATE,
+	[TURBO] = TURBO_RATE,
+	[SUPER_TURBO] = SUPER_TURBO_RATE,
+};
+
+/* Lowest mode that finishes every queued hinted job by its deadline
+ * when the jobs run back to back in deadline order.
+ * Called with hint_lock held. */
+static dvfs_mode_e dvfs_deadline_mode(struct _mm_dvfs *mm_dvfs)
+{
+	struct mm_job_hint *hint;
+	struct timespec now, slack;
+	u64 cycles = 0;
+	u64 rate = 0;
+	s64 slack_us;
+	dvfs_mode_e mode;
+
+	ktime_get_ts(&now);
+	list_for_each_entry(hint, &mm_dvfs->hint_list, node) {
+		cycles += hint->cycles;
+		slack = timespec_sub(hint->deadline, now);
+		slack_us = div_s64(timespec_to_ns(&slack), NSEC_PER_USEC);
+		if (slack_us <= 0)
+			return MM_DVFS_MAX_MODE;
+		rate = max(rate, div64_u64(cycles + slack_us - 1, slack_us));
+	}
+
+	for (mode = ECONOMY; mode < MM_DVFS_MAX_MODE; mode++)
+		if (mm_dvfs_opp_rate[mode] >= rate)
+			break;
+	return mode;
+}
+
+static void dvfs_hint_add(struct _mm_dvfs *mm_dvfs, struct mm_job_hint *hint)
+{
+	struct mm_job_hint *pos;
+	dvfs_mode_e mode;
+
+	spin_lock(&mm_dvfs->hint_lock);
+	list_for_each_entry(pos, &mm_dvfs->hint_list, node)
+		if (timespec_compare(&hint->deadline, &pos->deadline) < 0)
+			break;
+	list_add_tail(&hint->node, &pos->node);
+	hint->queued = true;
+	mm_dvfs->hint_cnt++;
+	mode = dvfs_deadline_mode(mm_dvfs);
+	spin_unlock(&mm_dvfs->hint_lock);
+
+	/* don't wait for the next sampling window if a deadline is at risk */
+	if (mm_dvfs->dvfs.__on && (mode > mm_dvfs->requested_mode))
+		SCHEDULER_WORK(mm_dvfs, &(mm_dvfs->boost_work));
+}
+
+static void dvfs_hint_done(struct _mm_dvfs *mm_dvfs, struct mm_job_hint *hint)
+{
+	struct timespec now;
+
+	spin_lock(&mm_dvfs->hint_lock);
+	if (hint->queued) {
+		list_del_init(&hint->node);
+		hint->queued = false;
+		mm_dvfs->hint_cnt--;
+		ktime_get_ts(&now);
+		if (timespec_compare(&now, &hint->deadline) > 0)
+			mm_dvfs->deadline_miss++;
+		else
+			mm_dvfs->deadline_met++;
+	}
+	spin_unlock(&mm_dvfs->hint_lock);
+}
+
+static void dvfs_update_request(struct _mm_dvfs *mm_dvfs)
+{
+	struct timespec now, diff;
+
+	ktime_get_ts(&now);
+	diff = timespec_sub(now, mm_dvfs->residency_ts);
+	mm_dvfs->residency_ns[mm_dvfs->residency_mode] += timespec_to_ns(&diff);
+	mm_dvfs->residency_ts = now;
+	mm_dvfs->residency_mode = mm_dvfs->requested_mode;
+
+	raw_notifier_call_chain(&mm_dvfs->mm_common_ifc->notifier_head, \
+					MM_FMWK_NOTIFY_DVFS_UPDATE, \
+					(void *)mm_dvfs->requested_mode);
+	if (pi_mgr_dfs_request_update(&(mm_dvfs->dev_dfs_node), \
+			mm_dvfs->requested_mode)) {
+		pr_err("%s: failed to update dfs request\n", __func__);
+	}
+}
+
+static void dvfs_boost_work(struct work_struct *work)
+{
+	struct _mm_dvfs *mm_dvfs = container_of(work, \
+					struct _mm_dvfs, \
+					boost_work);
+	dvfs_mode_e mode;
+
+	if (mm_dvfs->dvfs.__on == false)
+		return;
+
+	spin_lock(&mm_dvfs->hint_lock);
+	mode = dvfs_deadline_mode(mm_dvfs);
+	spin_unlock(&mm_dvfs->hint_lock);
+
+	if (mode <= mm_dvfs->requested_mode)
+		return;
+	pr_debug("deadline boost to %d..", mode);
+	mm_dvfs->requested_mode = mode;
+	mm_dvfs->boost_cnt++;
+	dvfs_update_request(mm_dvfs);
+}
+
 int mm_dvfs_notification_handler(struct notifier_block *block, \
 				unsigned long param, \
 				void *data)
@@ -33,6 +148,12 @@ int mm_dvfs_notification_handler(struct notifier_block *block, \
 		mm_dvfs->jobs_done++;
 		mm_dvfs->jobs_pend--;
 		break;
+	case MM_FMWK_NOTIFY_DEADLINE_ADD:
+		dvfs_hint_add(mm_dvfs, (struct mm_job_hint *)data);
+		break;
+	case MM_FMWK_NOTIFY_DEADLINE_DONE:
+		dvfs_hint_done(mm_dvfs, (struct mm_job_hint *)data);
+		break;
 	case MM_FMWK_NOTIFY_CLK_ENABLE:
 		getnstimeofday(&mm_dvfs->ts1);
 		if (mm_dvfs->timer_state == false)
@@ -62,10 +183,9 @@ static void dvfs_start_timer(struct _mm_dvfs *mm_dvfs)
 {
 	mm_dvfs->jobs_done = 0;
 	mm_dvfs->hw_on_dur = 0;
-	init_timer(&(mm_dvfs->dvfs_timeout));
-	setup_timer(&(mm_dvfs->dvfs_timeout),  \
-			dvfs_timeout_callback, \
-			(unsigned long)mm_dvfs);
+	/* the sample period can stretch over an idle cpu's sleep */
+	__setup_timer(&(mm_dvfs->dvfs_timeout), dvfs_timeout_callback,
+			(unsigned long)mm_dvfs, TIMER_DEFERRABLE);
 	mod_timer(&mm_dvfs->dvfs_timeout,
 		jiffies+msecs_to_jiffies(mm_dvfs->dvfs.__ts));
 	mm_dvfs->timer_state = true;
@@ -267,19 +387,27 @@ static void dvfs_work(struct work_struct *work)
 #endif
 	}
 dvfs_work_end:
-	raw_notifier_call_chain(&mm_dvfs->mm_common_ifc->notifier_head, \
-					MM_FMWK_NOTIFY_DVFS_UPDATE, \
-					(void *)mm_dvfs->requested_mode);
-	if (pi_mgr_dfs_request_update(&(mm_dvfs->dev_dfs_node), \
-			mm_dvfs->requested_mode)) {
-		pr_err("%s: failed to update dfs request\n", __func__);
+	if (mm_dvfs->dvfs.__on) {
+		spin_lock(&mm_dvfs->hint_lock);
+		if (mm_dvfs->hint_cnt) {
+			dvfs_mode_e mode = dvfs_deadline_mode(mm_dvfs);
+			/* With every pending job hinted the deadlines alone
+			 * decide, otherwise they only raise the load based
+			 * choice */
+			if (mm_dvfs->hint_cnt >= mm_dvfs->jobs_pend)
+				mm_dvfs->requested_mode = mode;
+			else if (mode > mm_dvfs->requested_mode)
+				mm_dvfs->requested_mode = mode;
+		}
+		spin_unlock(&mm_dvfs->hint_lock);
 	}
-
+	dvfs_update_request(mm_dvfs);
 }
 
 static struct mm_dvfs_prof {
 	struct _mm_dvfs *mm_dvfs;
 	int read_pointer;
+	bool stats_read;
 	char cpy_buffer[512];
 };
 
@@ -291,6 +419,7 @@ static int mm_dvfs_prof_open(struct inode *i_node, struct file *filp)
 	if (private != NULL) {
 		private->mm_dvfs = (struct _mm_dvfs *)(i_node->i_private);
 		private->read_pointer = 0;
+		private->stats_read = false;
 		filp->private_data = private;
 	} else
 		return -ENOMEM;
@@ -335,6 +464,24 @@ static int mm_dvfs_prof_read(struct file *filp, char __user *buf,
 		private->read_pointer = read_pointer;
 		return numread;
 	}
+	if (!private->stats_read) {
+		sprintf(copy_buffer,
+		"%s residency(ms) ECO:%llu NOR:%llu TUR:%llu ST:%llu, "
+		"deadline met:%u miss:%u boost:%u\n",
+		mm_dvfs->mm_common_ifc->mm_name,
+		div_u64(mm_dvfs->residency_ns[ECONOMY], NSEC_PER_MSEC),
+		div_u64(mm_dvfs->residency_ns[NORMAL], NSEC_PER_MSEC),
+		div_u64(mm_dvfs->residency_ns[TURBO], NSEC_PER_MSEC),
+		div_u64(mm_dvfs->residency_ns[SUPER_TURBO], NSEC_PER_MSEC),
+		mm_dvfs->deadline_met, mm_dvfs->deadline_miss,
+		mm_dvfs->boost_cnt);
+		if (copy_to_user(buf, copy_buffer, strlen(copy_buffer))) {
+			pr_err("Copy to User failed");
+			goto read_end;
+		}
+		private->stats_read = true;
+		return strlen(copy_buffer);
+	}
 read_end:
 	return 0;
 }
@@ -383,6 +530,9 @@ void *mm_dvfs_init(struct _mm_common_ifc *mm_common_ifc, \
 
 	mm_dvfs->mm_common_ifc = mm_common_ifc;
 	INIT_WORK(&(mm_dvfs->dvfs_work), dvfs_work);
+	INIT_WORK(&(mm_dvfs->boost_work), dvfs_boost_work);
+	spin_lock_init(&mm_dvfs->hint_lock);
+	INIT_LIST_HEAD(&mm_dvfs->hint_list);
 
 	/* Init prof counters */
 	mm_dvfs->dvfs = *dvfs_params;
@@ -390,6 +540,8 @@ void *mm_dvfs_init(struct _mm_common_ifc *mm_common_ifc, \
 		mm_dvfs->requested_mode = ECONOMY;
 	else
 		mm_dvfs->requested_mode = mm_dvfs->dvfs.__mode;
+	mm_dvfs->residency_mode = mm_dvfs->requested_mode;
+	ktime_get_ts(&mm_dvfs->residency_ts);
 
 	mm_dvfs->mm_fmwk_notifier_blk.notifier_call \
 			= mm_dvfs_notification_handler;
@@ -459,6 +611,7 @@ void mm_dvfs_exit(void *dev_p)
 	raw_notifier_chain_unregister(\
 		&mm_dvfs->mm_common_ifc->notifier_head, \
 		&mm_dvfs->mm_fmwk_notifier_blk);
+	cancel_work_sync(&mm_dvfs->boost_work);
 	debugfs_remove_recursive(mm_dvfs->economy_dir);
 	debugfs_remove_recursive(mm_dvfs->normal_dir);
 	debugfs_remove_recursive(mm_dvfs->turbo_dir);
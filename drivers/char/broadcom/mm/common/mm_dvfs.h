@@ -24,6 +24,12 @@ express prior written consent.
 
 #define NUM_DVFS_PROF_SAMPLES 8
 
+#if defined(CONFIG_PI_MGR_MM_STURBO_ENABLE)
+#define MM_DVFS_MAX_MODE SUPER_TURBO
+#else
+#define MM_DVFS_MAX_MODE TURBO
+#endif
+
 struct dvfs_update {
 	struct work_struct work;
 	u64 param;
@@ -124,6 +130,20 @@ struct _mm_dvfs {
 	struct timer_list dvfs_timeout;
 	struct work_struct dvfs_work;
 
+	/* queued jobs with a deadline hint, earliest deadline first */
+	spinlock_t hint_lock;
+	struct list_head hint_list;
+	unsigned int hint_cnt;
+	struct work_struct boost_work;
+	unsigned int deadline_met;
+	unsigned int deadline_miss;
+	unsigned int boost_cnt;
+
+	/* time spent at each requested OPP */
+	u64 residency_ns[PI_OPP_MAX];
+	dvfs_mode_e residency_mode;
+	struct timespec residency_ts;
+
 	struct timespec ts1;
 	struct timespec dvfst1;
 
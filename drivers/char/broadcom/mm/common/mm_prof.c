@@ -11,6 +11,8 @@ in any way with any other Broadcom software provided under a license other than
 the GPL, without Broadcom's express prior written consent.
 *******************************************************************************/
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mm.h>
 #define pr_fmt(fmt) "<%s> %s:" fmt "\n", mm_prof->mm_common_ifc->mm_name,\
 								__func__
 
@@ -42,6 +44,9 @@ int mm_prof_notification_handler(struct notifier_block *block, \
 	case MM_FMWK_NOTIFY_DVFS_UPDATE:
 		mm_prof->current_mode = (dvfs_mode_e)data;
 		break;
+	case MM_FMWK_NOTIFY_JOB_RUN:
+		mm_prof->hw_run_us += (unsigned long)data;
+		break;
 	case MM_FMWK_NOTIFY_INVALID:
 	default:
 		break;
@@ -74,10 +79,11 @@ static int mm_prof_buffread(struct file *filp, char __user *buf, \
 	int read_pointer = private->read_pointer ;
 
 	if (read_pointer != *write_pointer) {
-		sprintf(copy_buffer, "%s usage:ON: %d%% [DVFS:%d]"\
+		sprintf(copy_buffer, "%s usage:ON: %d%% RUN: %d%% [DVFS:%d]"\
 				"JOBS: %d [%d , %d ,%d ,%d] in %d secs\n",
 			mm_prof->mm_common_ifc->mm_name,
 			mm_prof->buff[read_pointer].percent,
+			mm_prof->buff[read_pointer].run_percent,
 			mm_prof->buff[read_pointer].current_mode,
 			mm_prof->buff[read_pointer].jobs_done,
 			mm_prof->buff[read_pointer].jobs_done_type[0],
@@ -162,6 +168,7 @@ static void prof_work(struct work_struct *work)
 
 	if (mm_prof->timer_state == false) {
 		mm_prof->hw_on_dur = 0;
+		mm_prof->hw_run_us = 0;
 		mm_prof->jobs_done = 0;
 		mm_prof->jobs_done_type[0] = 0;
 		mm_prof->jobs_done_type[1] = 0;
@@ -173,10 +180,10 @@ static void prof_work(struct work_struct *work)
 				&mm_prof->mm_common_ifc->notifier_head, \
 				&mm_prof->mm_fmwk_notifier_blk);
 		getnstimeofday(&(mm_prof->proft1));
-		init_timer(&(mm_prof->prof_timeout));
-		setup_timer(&(mm_prof->prof_timeout), \
-			prof_timeout_callback, \
-			(unsigned long)mm_prof);
+		/* the period is measured, it may end late */
+		__setup_timer(&(mm_prof->prof_timeout),
+			prof_timeout_callback,
+			(unsigned long)mm_prof, TIMER_DEFERRABLE);
 		mod_timer(&mm_prof->prof_timeout, \
 			jiffies+msecs_to_jiffies(mm_prof->T1*1000));
 		mm_prof->timer_state = true;
@@ -210,12 +217,17 @@ static void prof_work(struct work_struct *work)
 	mm_prof->buff[write_ptr].jobs_done_type[3] = mm_prof->jobs_done_type[3];
 	mm_prof->buff[write_ptr].current_mode = mm_prof->current_mode;
 	mm_prof->buff[write_ptr].percent = percnt;
+	/* jobs can overlap the period boundaries */
+	mm_prof->buff[write_ptr].run_percent = min_t(u64, div64_u64(
+		(u64)mm_prof->hw_run_us * 100 * NSEC_PER_USEC,
+		timespec_to_ns(&diff) ? : 1), 100);
 
 	++(write_ptr) ;
 	write_ptr = write_ptr & (BUFFSIZE - 1);
 	mm_prof->write_ptr = write_ptr;
 
 	mm_prof->hw_on_dur = 0;
+	mm_prof->hw_run_us = 0;
 	mm_prof->jobs_done = 0;
 	mm_prof->jobs_done_type[0] = 0;
 	mm_prof->jobs_done_type[1] = 0;
@@ -263,6 +275,78 @@ void mm_prof_update_handler(struct work_struct *work)
 	}
 }
 
+#ifdef CONFIG_MM_JOB_TRACE
+/* Only called from the core's job scheduler, so there is a single writer
+ * per ring. Readers check seq and head to detect records that were
+ * overwritten while they copied them. */
+void mm_prof_trace_job(struct _mm_prof *mm_prof, struct dev_job_list *job,
+			u64 t_irq, u32 clk_on_ns)
+{
+	mm_trace_hdr_t *hdr;
+	mm_trace_rec_t *rec;
+	u32 seq;
+
+	if ((mm_prof == NULL) || (mm_prof->trace_hdr == NULL))
+		return;
+
+	hdr = mm_prof->trace_hdr;
+	seq = hdr->head;
+	rec = &mm_prof->trace_rec[seq & (hdr->num_recs - 1)];
+	rec->seq = 0;
+	smp_wmb();
+	rec->type = job->job.type;
+	rec->id = job->job.id;
+	rec->status = job->job.status;
+	rec->t_add = job->t_add;
+	rec->t_start = job->t_start;
+	rec->t_irq = t_irq;
+	rec->t_done = mm_prof_trace_time();
+	rec->clk_on_ns = clk_on_ns;
+	smp_wmb();
+	rec->seq = seq + 1;
+	hdr->head = seq + 1;
+}
+
+static int mm_prof_trace_mmap(struct file *filp, struct vm_area_struct *vma)
+{
+	struct _mm_prof *mm_prof = filp->private_data;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, mm_prof->trace_hdr, vma->vm_pgoff);
+}
+
+static const struct file_operations mm_prof_debugfs_TRACE = {
+	.owner = THIS_MODULE,
+	.open = simple_open,
+	.mmap = mm_prof_trace_mmap,
+};
+
+static void mm_prof_trace_init(struct _mm_prof *mm_prof)
+{
+	mm_trace_hdr_t *hdr = vmalloc_user(MM_TRACE_BUF_SIZE);
+	u32 offset = L1_CACHE_ALIGN(sizeof(mm_trace_hdr_t));
+
+	if (hdr == NULL) {
+		pr_err("no memory for the job trace ring");
+		return;
+	}
+	hdr->magic = MM_TRACE_MAGIC;
+	hdr->version = MM_TRACE_VERSION;
+	hdr->rec_size = sizeof(mm_trace_rec_t);
+	hdr->rec_offset = offset;
+	hdr->num_recs = rounddown_pow_of_two((MM_TRACE_BUF_SIZE - offset) /
+						sizeof(mm_trace_rec_t));
+	hdr->head = 0;
+	mm_prof->trace_rec = (mm_trace_rec_t *)((u8 *)hdr + offset);
+	mm_prof->trace_hdr = hdr;
+
+	mm_prof->TRACE = debugfs_create_file("trace", S_IRUSR | S_IRGRP,
+				mm_prof->prof_dir, mm_prof,
+				&mm_prof_debugfs_TRACE);
+}
+#endif
 
 DEFINE_DEBUGFS_HANDLER(TIME, MM_PROF_UPDATE_TIME);
 
@@ -293,6 +377,9 @@ MM_PROF_HW_IFC *prof_params)
 
 	CREATE_DEBUGFS_FILE(mm_prof, TIME, mm_prof->prof_dir);
 	CREATE_DEBUGFS_FILE(mm_prof, BUFFER, mm_prof->prof_dir);
+#ifdef CONFIG_MM_JOB_TRACE
+	mm_prof_trace_init(mm_prof);
+#endif
 
 	return mm_prof;
 }
@@ -306,5 +393,8 @@ void mm_prof_exit(void *dev_p)
 	if (mm_prof->prof_dir)
 		debugfs_remove_recursive(mm_prof->prof_dir);
 
+#ifdef CONFIG_MM_JOB_TRACE
+	vfree(mm_prof->trace_hdr);
+#endif
 	kfree(mm_prof);
 }
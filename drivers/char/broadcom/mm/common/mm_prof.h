@@ -17,6 +17,8 @@ the GPL, without Broadcom's express prior written consent.
 #include "mm_common.h"
 #include "mm_dvfs.h"
 #define BUFFSIZE 8
+/* job trace ring size, header included */
+#define MM_TRACE_BUF_SIZE (16 * PAGE_SIZE)
 enum mm_prof_update {
 	MM_PROF_UPDATE_UNKNOWN = 0,
 	MM_PROF_UPDATE_TIME,
@@ -85,6 +87,7 @@ void mm_prof_update_handler(struct work_struct *work);
 
 struct mm_buff {
 	int percent;
+	int run_percent;
 	unsigned int jobs_done;
 	unsigned int jobs_done_type[MAX_JOB_TYPE];
 	unsigned int T1;
@@ -119,12 +122,19 @@ struct _mm_prof {
 	struct timespec proft1;
 
 	s64 hw_on_dur;
+	/* sum of the jobs' run times, in microseconds */
+	u32 hw_run_us;
 	unsigned int jobs_done;
 	unsigned int jobs_done_type[MAX_JOB_TYPE];
 
 	struct mm_buff buff[BUFFSIZE];
 	int write_ptr;
 
+#ifdef CONFIG_MM_JOB_TRACE
+	struct dentry *TRACE;
+	mm_trace_hdr_t *trace_hdr;
+	mm_trace_rec_t *trace_rec;
+#endif
 };
 
 void *mm_prof_init(struct _mm_common_ifc *mm_common_ifc, \
@@ -132,5 +142,23 @@ void *mm_prof_init(struct _mm_common_ifc *mm_common_ifc, \
 		MM_PROF_HW_IFC *prof_params);
 void mm_prof_exit(void *mm_prof);
 
+#ifdef CONFIG_MM_JOB_TRACE
+static inline u64 mm_prof_trace_time(void)
+{
+	return sched_clock();
+}
+void mm_prof_trace_job(struct _mm_prof *mm_prof, struct dev_job_list *job,
+			u64 t_irq, u32 clk_on_ns);
+#else
+static inline u64 mm_prof_trace_time(void)
+{
+	return 0;
+}
+static inline void mm_prof_trace_job(struct _mm_prof *mm_prof,
+			struct dev_job_list *job, u64 t_irq, u32 clk_on_ns)
+{
+}
+#endif
+
 
 #endif
@@ -0,0 +1,119 @@
+/*******************************************************************************
+Copyright 2010 Broadcom Corporation.  All rights reserved.
+
+Unless you and Broadcom execute a separate written software license agreement
+governing use of this software, this software is licensed to you under the
+terms of the GNU General Public License version 2, available at
+http://www.gnu.org/copyleft/gpl.html (the "GPL").
+
+Notwithstanding the above, under no circumstances may you combine this software
+in any way with any other Broadcom software provided under a license other than
+the GPL, without Broadcom's express prior written consent.
+*******************************************************************************/
+
+/* Out fences of MM jobs.
+ *
+ * Jobs of one core do not complete in the order they were written: held
+ * MM_ORDERED_JOBs, interlocks and in fences let later jobs overtake, and
+ * release drops jobs of one file only. The sync framework collapses the
+ * points of a timeline on merge assuming they signal in order, so every
+ * fenced job gets a timeline of its own, named after its MM device, with
+ * a single point that signals when the job is done.
+ */
+
+#include <linux/err.h>
+#include <linux/file.h>
+#include <linux/kernel.h>
+#include "mm_sync.h"
+
+struct mm_sync_timeline {
+	struct sync_timeline obj;
+	/* 0 while the job is pending, under obj.active_list_lock */
+	int status;
+};
+
+static inline struct mm_sync_timeline *to_mm_sync(struct sync_timeline *obj)
+{
+	return container_of(obj, struct mm_sync_timeline, obj);
+}
+
+static struct sync_pt *mm_sync_pt_dup(struct sync_pt *pt)
+{
+	return sync_pt_create(pt->parent, sizeof(struct sync_pt));
+}
+
+static int mm_sync_pt_has_signaled(struct sync_pt *pt)
+{
+	return to_mm_sync(pt->parent)->status;
+}
+
+static int mm_sync_pt_compare(struct sync_pt *a, struct sync_pt *b)
+{
+	/* the one job of the timeline */
+	return 0;
+}
+
+static void mm_sync_timeline_value_str(struct sync_timeline *obj,
+				char *str, int size)
+{
+	snprintf(str, size, "%d", to_mm_sync(obj)->status);
+}
+
+static void mm_sync_pt_value_str(struct sync_pt *pt, char *str, int size)
+{
+	snprintf(str, size, "%d", to_mm_sync(pt->parent)->status);
+}
+
+static const struct sync_timeline_ops mm_sync_ops = {
+	.driver_name = "mm_fmwk",
+	.dup = mm_sync_pt_dup,
+	.has_signaled = mm_sync_pt_has_signaled,
+	.compare = mm_sync_pt_compare,
+	.timeline_value_str = mm_sync_timeline_value_str,
+	.pt_value_str = mm_sync_pt_value_str,
+};
+
+struct mm_sync_timeline *mm_sync_create(const char *name, int *fd)
+{
+	struct sync_timeline *obj;
+	struct sync_fence *fence;
+	struct sync_pt *pt;
+
+	*fd = get_unused_fd();
+	if (*fd < 0)
+		return ERR_PTR(*fd);
+
+	obj = sync_timeline_create(&mm_sync_ops,
+				sizeof(struct mm_sync_timeline), name);
+	if (!obj)
+		goto err_fd;
+	pt = sync_pt_create(obj, sizeof(struct sync_pt));
+	if (!pt)
+		goto err_obj;
+	fence = sync_fence_create(name, pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		goto err_obj;
+	}
+	sync_fence_install(fence, *fd);
+	return to_mm_sync(obj);
+
+err_obj:
+	sync_timeline_destroy(obj);
+err_fd:
+	put_unused_fd(*fd);
+	*fd = -1;
+	return ERR_PTR(-ENOMEM);
+}
+
+void mm_sync_signal(struct mm_sync_timeline *tl, int status)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&tl->obj.active_list_lock, flags);
+	tl->status = status;
+	spin_unlock_irqrestore(&tl->obj.active_list_lock, flags);
+	sync_timeline_signal(&tl->obj);
+	/* the fence keeps the timeline until it is closed */
+	sync_timeline_destroy(&tl->obj);
+}
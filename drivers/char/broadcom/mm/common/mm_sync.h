@@ -0,0 +1,28 @@
+/*******************************************************************************
+Copyright 2010 Broadcom Corporation.  All rights reserved.
+
+Unless you and Broadcom execute a separate written software license agreement
+governing use of this software, this software is licensed to you under the
+terms of the GNU General Public License version 2, available at
+http://www.gnu.org/copyleft/gpl.html (the "GPL").
+
+Notwithstanding the above, under no circumstances may you combine this software
+in any way with any other Broadcom software provided under a license other than
+the GPL, without Broadcom's express prior written consent.
+*******************************************************************************/
+
+#ifndef _MM_SYNC_H_
+#define _MM_SYNC_H_
+
+#ifdef CONFIG_MM_SYNC
+#include <linux/sync.h>
+
+struct mm_sync_timeline;
+
+/* Out fence of one job, installed in *fd */
+struct mm_sync_timeline *mm_sync_create(const char *name, int *fd);
+/* status is 1 for done, a negative errno for failed or dropped */
+void mm_sync_signal(struct mm_sync_timeline *tl, int status);
+#endif
+
+#endif
@@ -30,6 +30,9 @@ struct cme_device_t {
 	u32 cme_version;
 	void *vaddr;
 	void *clockaddr;
+	/* H264_CME_MULTI_EST_JOB in progress */
+	u32 autoctrl;
+	unsigned int cur_ref;
 };
 
 static inline void cme_write(struct cme_device_t *cme, u32 reg, u32 value)
@@ -204,32 +207,84 @@ bool get_cme_status(void *device_id)
 	return false;
 }
 
+/* Search the next reference of a multi reference job, the rest of the
+ * setup is kept from the previous one */
+static void cme_start_ref(struct cme_device_t *id, struct cme_ref_t *ref)
+{
+	cme_write(id, H264_CME_REFY_OFFSET, ref->ref_y_addr);
+	cme_write(id, H264_CME_REFC_OFFSET, ref->ref_c_addr);
+	cme_write(id, H264_CME_DUMPADDR_OFFSET, ref->vetctor_dump_addr);
+	cme_write(id, H264_CME_AUTOCTRL_OFFSET, id->autoctrl);
+	cme_write(id, H264_CME_INTCS_OFFSET, 0x8);
+}
+
+static mm_job_status_e cme_ref_done(struct cme_device_t *id,
+				struct cme_multi_job_t *mj)
+{
+	struct cme_ref_t *ref = &mj->ref[id->cur_ref];
+	unsigned int i;
+
+	ref->out_params = mj->job.out_params;
+	if (++id->cur_ref < mj->num_refs) {
+		cme_start_ref(id, &mj->ref[id->cur_ref]);
+		return MM_JOB_STATUS_RUNNING;
+	}
+
+	mj->best_ref = 0;
+	for (i = 1; i < mj->num_refs; i++)
+		if (mj->ref[i].out_params.totalsad <
+			mj->ref[mj->best_ref].out_params.totalsad)
+			mj->best_ref = i;
+	mj->job.out_params = mj->ref[mj->best_ref].out_params;
+	return MM_JOB_STATUS_SUCCESS;
+}
+
 mm_job_status_e cme_start_job(void *device_id,\
 			mm_job_post_t *job,\
 			unsigned int profmask)
 {
 	struct cme_device_t *id = (struct cme_device_t *)device_id;
 	struct cme_job_t *jp = (struct cme_job_t *)job->data;
+	struct cme_multi_job_t *mj = NULL;
 	u32 temp;
 	u32 var_pitch;
+	u32 ref_addr;
+	unsigned int i;
 
 	if (jp == NULL) {
 		pr_err("cme_start_job: jp is null\n");
 		return MM_JOB_STATUS_ERROR;
 	}
 
-	if (job->size != sizeof(struct cme_job_t)) {
-		pr_err("cme_start_job: job struct size mismatch\n");
-		return MM_JOB_STATUS_ERROR;
-	}
-
-	if (job->type != H264_CME_EST_JOB) {
+	if (job->type == H264_CME_MULTI_EST_JOB) {
+		mj = (struct cme_multi_job_t *)job->data;
+		if (job->size != sizeof(struct cme_multi_job_t) ||
+			mj->num_refs == 0 || mj->num_refs > CME_MAX_REFS) {
+			pr_err("cme_start_job: invalid multi ref job\n");
+			return MM_JOB_STATUS_ERROR;
+		}
+	} else if (job->type != H264_CME_EST_JOB) {
 		pr_err("cme_start_job: Invalid job type\n");
 		return MM_JOB_STATUS_ERROR;
+	} else if (job->size != sizeof(struct cme_job_t)) {
+		pr_err("cme_start_job: job struct size mismatch\n");
+		return MM_JOB_STATUS_ERROR;
 	}
 
 	switch (job->status) {
 	case MM_JOB_STATUS_READY:
+		if (mj) {
+			id->cur_ref = 0;
+			jp->ref_y_addr = mj->ref[0].ref_y_addr;
+			jp->ref_c_addr = mj->ref[0].ref_c_addr;
+			jp->vetctor_dump_addr = mj->ref[0].vetctor_dump_addr;
+		}
+		/* all references share the pitch mode of the job */
+		ref_addr = jp->ref_y_addr | jp->ref_c_addr;
+		for (i = 1; mj && i < mj->num_refs; i++)
+			ref_addr |= mj->ref[i].ref_y_addr |
+				mj->ref[i].ref_c_addr;
+
 		/*Bound checks*/
 		if (!(jp->hradius_mb >= 1 && jp->hradius_mb <= 6 &&
 				jp->vradius_mb >= 1 && jp->vradius_mb <= 4)) {
@@ -265,7 +320,7 @@ mm_job_status_e cme_start_job(void *device_id,\
 				(jp->img_pitch << 12) +
 				(jp->img_pitch >> 3) + 0);
 			var_pitch = (127 & (jp->cur_y_addr | jp->cur_c_addr |
-				jp->ref_y_addr | jp->ref_c_addr)) ? 1 : 0;
+				ref_addr)) ? 1 : 0;
 			break;
 		case CME_FORMAT_YUV_UV:
 			cme_write(id, H264_CME_PITCH_OFFSET, 128);
@@ -281,7 +336,7 @@ mm_job_status_e cme_start_job(void *device_id,\
 			/*We can accept planar YUV, but only when
 			* ignoring Chroma. Must be 32-byte aligned.*/
 			if (31 & (jp->img_pitch | jp->cur_y_addr |
-					jp->ref_y_addr)) {
+					ref_addr)) {
 				pr_err("Planar YUV without 32-byte aligned\n");
 				return MM_JOB_STATUS_ERROR;
 			}
@@ -308,6 +363,7 @@ mm_job_status_e cme_start_job(void *device_id,\
 			((jp->hradius_mb & 4) << 3) |
 			(jp->auto_ignorec << 4) | (var_pitch << 3) | 1;
 
+		id->autoctrl = temp;
 		cme_write(id, H264_CME_AUTOCTRL_OFFSET, temp);
 		job->status = MM_JOB_STATUS_RUNNING;
 		cme_write(id, H264_CME_INTCS_OFFSET, 0x8);
@@ -317,7 +373,8 @@ mm_job_status_e cme_start_job(void *device_id,\
 		jp->out_params.totalsad = cme_read(id, H264_CME_TOTSAD_OFFSET);
 		jp->out_params.progress = (cme_read(id,
 				H264_CME_AUTOSTATUS_OFFSET) >> 2) & 0x1F;
-		job->status = MM_JOB_STATUS_SUCCESS;
+		job->status = mj ? cme_ref_done(id, mj) :
+			MM_JOB_STATUS_SUCCESS;
 		return job->status;
 
 	case MM_JOB_STATUS_SUCCESS:
@@ -52,4 +52,25 @@ struct cme_job_t {
 	struct CME_OUT_PARAMS_T out_params;
 };
 
+#define CME_MAX_REFS 8
+
+struct cme_ref_t {
+	unsigned int ref_y_addr;
+	unsigned int ref_c_addr;
+	unsigned int vetctor_dump_addr;
+	struct CME_OUT_PARAMS_T out_params;
+};
+
+/* H264_CME_MULTI_EST_JOB: the search of job is run against each of the
+ * num_refs references in turn, each dumping its own vectors, as one
+ * job. The ref and dump addresses of job are not used. On completion
+ * best_ref is the reference with the lowest total SAD, and
+ * job.out_params holds its result. */
+struct cme_multi_job_t {
+	struct cme_job_t job;
+	unsigned int num_refs;
+	unsigned int best_ref;
+	struct cme_ref_t ref[CME_MAX_REFS];
+};
+
 #endif
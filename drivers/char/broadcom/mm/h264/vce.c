@@ -46,6 +46,9 @@ static int break_var;
 
 struct vce_device_t {
 	void *vaddr;
+	/* copy of the code last written above VCE_DMA_LIMIT */
+	u32 *code;
+	int code_words;
 };
 
 void h264_write(void *id, u32 reg, u32 value)
@@ -72,6 +75,36 @@ static u32 vce_read(struct vce_device_t *vce, u32 reg)
 			reg + (VCE_BASE - VIDEOCODEC_BASE_ADDRESS));
 }
 
+/*
+ * Copy the code beyond VCE_DMA_LIMIT, writing only the words that differ
+ * from what the previous job left there. The prerun code is loaded at
+ * the start of the region for every job, so that part is always written.
+ * If the last word kept does not read back the memory was lost while
+ * powered down, and everything is written again.
+ */
+static void vce_copy_code(struct vce_device_t *vce, const u32 *va, int words)
+{
+	int prerun_words = vce_launch_vce_prerun[3] / 4;
+	u32 offset = VCE_PROGRAM_MEM_OFFSET + VCE_DMA_LIMIT;
+	int i;
+
+	if (vce->code_words &&
+		vce_read(vce, offset + (vce->code_words - 1) * 4) !=
+		vce->code[vce->code_words - 1])
+		vce->code_words = 0;
+
+	for (i = 0; i < words; i++) {
+		if (vce->code && i >= prerun_words && i < vce->code_words &&
+			vce->code[i] == va[i])
+			continue;
+		vce_write(vce, offset + (i * 4), va[i]);
+		if (vce->code)
+			vce->code[i] = va[i];
+	}
+	if (vce->code)
+		vce->code_words = words;
+}
+
 /*static void print_job_struct(void *job)
 {
 	struct vce_launch_info_t *vce_info;
@@ -138,6 +171,7 @@ static int vce_abort(void *device_id, mm_job_post_t *job)
 	pr_info("vce_abort:\n");
 	print_regs(id);
 	vce_reset(id);
+	id->code_words = 0;
 
 	return 0;
 }
@@ -351,12 +385,7 @@ mm_job_status_e vce_start_job(void *device_id, mm_job_post_t *job,
 
 			lt_csize /= 4;
 			/*Copy Extra code(After VCE_DMA_LIMIT)*/
-			for (i = 0; i < lt_csize; i++) {
-				vce_write(id, (VCE_PROGRAM_MEM_OFFSET + \
-					ft_csize + (i*4)), (u32)* \
-					((u32 *)((u32 *) \
-					va + i)));
-			}
+			vce_copy_code(id, (u32 *)va, lt_csize);
 		}
 
 		/*Write the registers passed*/
@@ -499,6 +528,10 @@ int h264_vce_init(MM_CORE_HW_IFC *core_param)
 	}
 
 	vce_device->vaddr = NULL;
+	/* without the copy all the code is written for every job */
+	vce_device->code = kmalloc(VCE_PROGRAM_MEM_SIZE - VCE_DMA_LIMIT,
+				GFP_KERNEL);
+	vce_device->code_words = 0;
 
 	/*Do any device specific structure initialisation required.*/
 	core_param->mm_base_addr = VIDEOCODEC_BASE_ADDRESS;
@@ -528,5 +561,6 @@ err:
 
 void h264_vce_deinit(void)
 {
+	kfree(vce_device->code);
 	kfree(vce_device);
 }
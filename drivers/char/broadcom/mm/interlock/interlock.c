@@ -99,6 +99,7 @@ int __init interlock_init(void)
 	core_param.mm_get_regs = interlock_get_regs;
 	core_param.mm_update_virt_addr = interlock_virt_addr_update;
 	core_param.mm_version_init = NULL;
+	core_param.mm_prepare_job = NULL;
 	core_param.mm_device_id = (void *)interlock_device;
 	core_param.mm_virt_addr = NULL;
 	core_param.core_name = "INTERLOCK";
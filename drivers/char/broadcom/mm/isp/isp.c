@@ -37,8 +37,13 @@ the GPL, without Broadcom's express prior written consent.
 struct isp_device_t {
 	void *vaddr;
 	void *fmwk_handle;
+	spinlock_t staged_lock;
+	mm_job_post_t *staged_job;
 };
 
+int isp_program(struct isp_device_t *isp, struct isp_job_post_t *job_post);
+int isp_start(struct isp_device_t *isp);
+
 void printispregs(struct isp_device_t *isp)
 {
 	pr_info("ISP_CTRL = 0x%lx\n",
@@ -112,6 +117,39 @@ void printispregs(struct isp_device_t *isp)
 	return;
 }
 
+/* The ISP has no shadow register bank, so the staged job is programmed
+ * here instead of being fully preloaded. The head job has no results to
+ * read back, which makes it safe to start the next one right away. */
+static void isp_launch_staged_job(struct isp_device_t *isp)
+{
+	mm_job_post_t *job;
+	unsigned long flags;
+
+	spin_lock_irqsave(&isp->staged_lock, flags);
+	job = isp->staged_job;
+	isp->staged_job = NULL;
+	if (job && (job->status == MM_JOB_STATUS_READY)) {
+		if ((isp_program(isp, job->data) == 0) &&
+			(isp_start(isp) == 0))
+			job->status = MM_JOB_STATUS_RUNNING;
+	}
+	spin_unlock_irqrestore(&isp->staged_lock, flags);
+}
+
+static int isp_prepare_job(void *id, mm_job_post_t *job)
+{
+	struct isp_device_t *isp = (struct isp_device_t *)id;
+	unsigned long flags;
+
+	if (job && (job->data == NULL))
+		return -EINVAL;
+
+	spin_lock_irqsave(&isp->staged_lock, flags);
+	isp->staged_job = job;
+	spin_unlock_irqrestore(&isp->staged_lock, flags);
+	return 0;
+}
+
 static mm_isr_type_e  process_isp_irq(void *id)
 {
 	struct isp_device_t *isp = (struct isp_device_t *)id;
@@ -125,6 +163,7 @@ static mm_isr_type_e  process_isp_irq(void *id)
 		/* end of tile interrupt, disable control reg,
 		    as queue head job completed, schedule tasklet again*/
 		isp_clr_bit32(ISP_CTRL_OFFSET, ISP_CTRL_ENABLE_MASK);
+		isp_launch_staged_job(isp);
 		return MM_ISR_SUCCESS;
 	} else if (ispStatus & ISP_CTRL_ERROR_IMASK_MASK) {
 		printispregs(isp);
@@ -277,6 +316,8 @@ int __init mm_isp_init(void)
 	MM_PROF_HW_IFC prof_param;
 	isp_device = kmalloc(sizeof(struct isp_device_t), GFP_KERNEL);
 	isp_device->vaddr = NULL;
+	isp_device->staged_job = NULL;
+	spin_lock_init(&isp_device->staged_lock);
 	pr_debug("mm_isp_init: ISP driver Module Init");
 
 	core_param.mm_base_addr = ISP_BASE_ADDR;
@@ -297,6 +338,7 @@ int __init mm_isp_init(void)
 	core_param.mm_get_regs = NULL;
 	core_param.mm_update_virt_addr = mm_isp_update_virt_addr;
 	core_param.mm_version_init = NULL;
+	core_param.mm_prepare_job = isp_prepare_job;
 	core_param.mm_device_id = (void *)isp_device;
 	core_param.mm_virt_addr = NULL;
 	core_param.core_name = "ISP";
@@ -31,6 +31,7 @@ the GPL, without Broadcom's express prior written consent.
 #include <linux/mm.h>
 #include <linux/bootmem.h>
 #include <linux/dma-mapping.h>
+#include <linux/debugfs.h>
 
 #include "mm_isp2.h"
 #include <mach/rdb/brcm_rdb_sysmap.h>
@@ -46,6 +47,16 @@ the GPL, without Broadcom's express prior written consent.
 struct isp_device_t {
 	void *vaddr;
 	void *fmwk_handle;
+	/* ISP_MULTI_JOB in progress: next output and passes started */
+	unsigned int next_out;
+	unsigned int passes;
+	/* DDR traffic of the multi output jobs, from their declared sizes */
+	struct dentry *debugfs_dir;
+	u32 frames;
+	u32 frame_passes;
+	u32 frame_bytes;	/* of the last frame */
+	u64 ddr_bytes;
+	u64 saved_bytes;	/* input reads fused away */
 };
 
 #define isp_write(reg, value) mm_write_reg(isp->vaddr, reg, value)
@@ -206,6 +217,15 @@ int isp2_program(struct isp_device_t *isp, struct isp_job_post_t *job_post)
 	return ret;
 }
 
+static void isp2_write_output(struct isp_device_t *isp,
+				struct isp_output_t *out)
+{
+	int i;
+
+	for (i = 0; i < out->num_regs; i++)
+		isp_write(out->regs[i].offset, out->regs[i].value);
+}
+
 int isp2_start(struct isp_device_t *isp)
 {
 	int ret = 0;
@@ -217,12 +237,87 @@ int isp2_start(struct isp_device_t *isp)
 	return ret;
 }
 
+static bool isp_multi_valid(mm_job_post_t *job)
+{
+	struct isp_multi_job_t *m = (struct isp_multi_job_t *)job->data;
+	int i;
+
+	if ((job->size < sizeof(*m)) || (m->num_outputs == 0) ||
+		(m->num_outputs > ISP_MAX_OUTPUTS) ||
+		(m->common.num_regs > MAX_NUM_ISP_REGS))
+		return false;
+	for (i = 0; i < m->num_outputs; i++)
+		if (m->out[i].num_regs > ISP_MAX_OUTPUT_REGS)
+			return false;
+	return true;
+}
+
+static void isp_multi_account(struct isp_device_t *isp,
+				struct isp_multi_job_t *m)
+{
+	u32 bytes = isp->passes * m->in_bytes;
+	int i;
+
+	for (i = 0; i < m->num_outputs; i++)
+		bytes += m->out[i].bytes;
+	m->passes = isp->passes;
+	m->ddr_bytes = bytes;
+
+	isp->frames++;
+	isp->frame_passes = isp->passes;
+	isp->frame_bytes = bytes;
+	isp->ddr_bytes += bytes;
+	isp->saved_bytes += (u64)(m->num_outputs - isp->passes) *
+				m->in_bytes;
+}
+
+/* One pass per call: the front end is programmed for the first pass,
+ * the later ones only rewrite their output after the flush. */
+static mm_job_status_e isp_start_multi(struct isp_device_t *isp,
+					mm_job_post_t *job)
+{
+	struct isp_multi_job_t *m = (struct isp_multi_job_t *)job->data;
+	unsigned int n = 1;
+	int i;
+
+	if (job->status == MM_JOB_STATUS_READY) {
+		if (!isp_multi_valid(job) || isp2_program(isp, &m->common))
+			goto err;
+		isp->next_out = 0;
+		isp->passes = 0;
+	} else {
+		if (isp->next_out == m->num_outputs) {
+			isp_multi_account(isp, m);
+			job->status = MM_JOB_STATUS_SUCCESS;
+			return MM_JOB_STATUS_SUCCESS;
+		}
+		if (isp_reset(isp))
+			goto err;
+	}
+
+	if (m->flags & ISP_MULTI_FUSED)
+		n = m->num_outputs;
+	for (i = 0; i < n; i++)
+		isp2_write_output(isp, &m->out[isp->next_out++]);
+	isp->passes++;
+	if (isp2_start(isp))
+		goto err;
+	job->status = MM_JOB_STATUS_RUNNING;
+	return MM_JOB_STATUS_RUNNING;
+err:
+	pr_err("isp multi job failed at output %u\n", isp->next_out);
+	job->status = MM_JOB_STATUS_ERROR;
+	return MM_JOB_STATUS_ERROR;
+}
+
 static mm_job_status_e isp_start_job(void *id , mm_job_post_t *job,
 						unsigned int profmask)
 {
 	struct isp_device_t *isp = (struct isp_device_t *)id;
 	struct isp_job_post_t *job_params = (struct isp_job_post_t *)job->data;
 	mm_job_status_e ret = 0;
+	if (job->type == ISP_MULTI_JOB)
+		return isp_start_multi(isp, job);
 	switch (job->status) {
 	case MM_JOB_STATUS_READY:
 		{
@@ -268,8 +363,9 @@ int __init mm_isp2_init(void)
 	MM_CORE_HW_IFC core_param;
 	MM_DVFS_HW_IFC dvfs_param;
 	MM_PROF_HW_IFC prof_param;
-	isp_device = kmalloc(sizeof(struct isp_device_t), GFP_KERNEL);
-	isp_device->vaddr = NULL;
+	isp_device = kzalloc(sizeof(struct isp_device_t), GFP_KERNEL);
+	if (!isp_device)
+		return -ENOMEM;
 	pr_debug("ISP driver Module Init");
 
 	core_param.mm_base_addr = ISP2_BASE_ADDR;
@@ -288,6 +384,7 @@ int __init mm_isp2_init(void)
 	core_param.mm_get_regs = NULL;
 	core_param.mm_update_virt_addr = mm_isp_update_virt_addr;
 	core_param.mm_version_init = NULL;
+	core_param.mm_prepare_job = NULL;
 	core_param.mm_device_id = (void *)isp_device;
 	core_param.mm_virt_addr = NULL;
 	core_param.core_name = "ISP2";
@@ -319,6 +416,23 @@ int __init mm_isp2_init(void)
 		ret = -ENOMEM;
 		goto err;
 	}
+
+	isp_device->debugfs_dir = debugfs_create_dir("isp2_bw", NULL);
+	if (!IS_ERR_OR_NULL(isp_device->debugfs_dir)) {
+		struct dentry *dir = isp_device->debugfs_dir;
+		debugfs_create_u32("frames", S_IRUSR | S_IRGRP, dir,
+					&isp_device->frames);
+		debugfs_create_u32("frame_passes", S_IRUSR | S_IRGRP, dir,
+					&isp_device->frame_passes);
+		debugfs_create_u32("frame_bytes", S_IRUSR | S_IRGRP, dir,
+					&isp_device->frame_bytes);
+		debugfs_create_u64("ddr_bytes", S_IRUSR | S_IRGRP, dir,
+					&isp_device->ddr_bytes);
+		debugfs_create_u64("saved_bytes", S_IRUSR | S_IRGRP, dir,
+					&isp_device->saved_bytes);
+	} else {
+		isp_device->debugfs_dir = NULL;
+	}
 	pr_debug("ISP driver Module Init over");
 	return ret;
 
@@ -330,6 +444,7 @@ err:
 void __exit mm_isp2_exit(void)
 {
 	pr_debug("ISP driver Module Exit");
+	debugfs_remove_recursive(isp_device->debugfs_dir);
 	if (isp_device->fmwk_handle)
 		mm_fmwk_unregister(isp_device->fmwk_handle);
 	kfree(isp_device);
@@ -41,6 +41,37 @@ struct isp_job_post_t {
 	unsigned int num_regs;
 };
 
+#define ISP_MAX_OUTPUTS		3
+#define ISP_MAX_OUTPUT_REGS	24
+
+/* the outputs are produced together in one pass over the input */
+#define ISP_MULTI_FUSED		0x1
+
+struct isp_output_t {
+	struct regs_t regs[ISP_MAX_OUTPUT_REGS];
+	unsigned int num_regs;
+	unsigned int bytes;	/* written to DDR per frame */
+};
+
+/* ISP_MULTI_JOB: one input frame to num_outputs output branches, say
+ * preview and video. common programs the input and the front end.
+ * With ISP_MULTI_FUSED all the output registers are written before a
+ * single pass, for branches the hardware drives at once such as the
+ * high and low resolution outputs, and the input is read once.
+ * Otherwise each output is a pass of its own, back to back within the
+ * job, with only the output registers rewritten in between.
+ * in_bytes is the input read by a pass; passes and ddr_bytes are
+ * filled in when the job completes. */
+struct isp_multi_job_t {
+	struct isp_job_post_t common;
+	struct isp_output_t out[ISP_MAX_OUTPUTS];
+	unsigned int num_outputs;
+	unsigned int flags;
+	unsigned int in_bytes;
+	unsigned int passes;
+	unsigned int ddr_bytes;
+};
+
 enum {
 	ISP_CMD_WAIT_IRQ = 0x80,
 	ISP_CMD_CLK_RESET,
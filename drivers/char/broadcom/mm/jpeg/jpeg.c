@@ -75,112 +75,173 @@ static int jpeg_abort(void *id,  mm_job_post_t *job)
 	return ret;
 }
 
+static void jpeg_load_tables(struct jpeg_device_t *jpeg)
+{
+	u32 i, k, reg_value;
+	jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x200));
+	for (k = 0; k < 0x10; k++) {
+		jpeg_write(JP_HWDATA_OFFSET ,  \
+		((huffsize_Y_DC[k] << 16) | huffcode_Y_DC[k]));
+	}
+	reg_value = jpeg_read(JP_HADDR_OFFSET);
+	jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
+	jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x0));
+	for (k = 0; k < 0x100; k++) {
+		jpeg_write(JP_HWDATA_OFFSET , \
+	((huffsize_Y_AC[k] << 16) | huffcode_Y_AC[k]));
+	}
+	reg_value = jpeg_read(JP_HADDR_OFFSET);
+	jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
+	jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x210));
+	for (k = 0; k < 0x10; k++) {
+		jpeg_write(JP_HWDATA_OFFSET , \
+		((huffsize_C_DC[k] << 16) | huffcode_C_DC[k]));
+	}
+	reg_value = jpeg_read(JP_HADDR_OFFSET);
+	jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
+	jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x100));
+	for (k = 0; k < 0x100; k++) {
+		jpeg_write(JP_HWDATA_OFFSET , \
+		((huffsize_C_AC[k] << 16) | huffcode_C_AC[k]));
+	}
+	reg_value = jpeg_read(JP_HADDR_OFFSET);
+	jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
+	jpeg_write(JP_QADDR_OFFSET ,  (JQADDR_RAMACC | (0 * 64)));
+	for (i = 0; i < 64; i++)
+		jpeg_write(JP_QWDATA_OFFSET ,  (hw_quantf_t_Y[i]));
+	jpeg_write(JP_QADDR_OFFSET ,  (JQADDR_RAMACC | (1 * 64)));
+	for (i = 0; i < 64; i++)
+		jpeg_write(JP_QWDATA_OFFSET ,  (hw_quantf_t_C[i]));
+	jpeg_write(JP_QADDR_OFFSET ,  0);
+}
+
+/* Program one image and start it */
+static mm_job_status_e jpeg_start_image(struct jpeg_device_t *jpeg,
+	struct jpeg_value *jp)
+{
+	u32 reg_value;
+	int sumhv;
+	if (jp->out_size_p > jp->hardware_add_out_p)
+		return MM_JOB_STATUS_ERROR;
+	jpeg_write(JP_CTRL_OFFSET ,  (1 << 30) | JCTRL_RESET |
+	JCTRL_STUFF | JCTRL_DCTEN);
+	jpeg_write(JP_MCTRL_OFFSET ,  ((3 * JMCTRL_NUMCMP) |
+	((jp->h) * (jp->v) * JMCTRL_CMP(0) | 0*JMCTRL_DC_TAB(0) |
+	0 * JMCTRL_AC_TAB(0)) | (1 * JMCTRL_CMP(1) |
+	1 * JMCTRL_DC_TAB(1) | 1 * JMCTRL_AC_TAB(1)) |
+	(1 * JMCTRL_CMP(2) | 1 * JMCTRL_DC_TAB(2) |
+	1 * JMCTRL_AC_TAB(2))));
+	if (jp->h == 1 && jp->v == 1) {
+		reg_value = jpeg_read(JP_MCTRL_OFFSET);
+		jpeg_write(JP_MCTRL_OFFSET ,  reg_value |
+		JMCTRL_444_MODE);
+	} else if (jp->h == 2 && jp->v == 1) {
+		reg_value = jpeg_read(JP_MCTRL_OFFSET);
+		jpeg_write(JP_MCTRL_OFFSET ,  (reg_value |
+		JMCTRL_422_MODE));
+	} else if (jp->h == 2 && jp->v == 2) {
+		reg_value = jpeg_read(JP_MCTRL_OFFSET);
+		jpeg_write(JP_MCTRL_OFFSET ,  reg_value |
+		JMCTRL_420_MODE);
+	} else {
+		pr_err("Unsupported subsampling mode DCT hardware.");
+		return MM_JOB_STATUS_ERROR;
+	}
+	jpeg_load_tables(jpeg);
+	jpeg_write(JP_QCTRL_OFFSET ,  ((0 << 0) | (1 << 2) | (1 << 4)));
+	jpeg_write(JP_SDA_OFFSET ,  ((jp->hardware_add_out_p) & ~0xF));
+	jpeg_write(JP_SBO_OFFSET ,  (8 * (jp->p & 0xF)));
+	jpeg_write(JP_NSB_OFFSET ,  jp->jnsb);
+	sumhv = (jp->h)*(jp->v) + 2;
+	jpeg_write(JP_NCB_OFFSET , (64 * (sumhv) * (jp->xmcus) *\
+	(jp->ymcus)));
+	jpeg_write(JP_CBA_OFFSET ,  (~0));
+	jpeg_write(JP_C0BA_OFFSET ,  ((jp->hardware_add_Y)));
+	jpeg_write(JP_C1BA_OFFSET ,  ((jp->hardware_add_U)));
+	jpeg_write(JP_C2BA_OFFSET ,  ((jp->hardware_add_V)));
+	jpeg_write(JP_C0S_OFFSET ,  (jp->stride_0));
+	jpeg_write(JP_C1S_OFFSET ,  (jp->stride_1));
+	jpeg_write(JP_C2S_OFFSET ,  (jp->stride_2));
+	jpeg_write(JP_C0W_OFFSET ,  jp->jc0w);
+	jpeg_write(JP_C1W_OFFSET ,  jp->jc1w);
+	jpeg_write(JP_C2W_OFFSET ,  jp->jc2w);
+	jpeg_write(JP_ICST_OFFSET ,  (JICST_INTCD | JICST_INTSD |
+	JICST_INTE));
+	reg_value = jpeg_read(JP_CTRL_OFFSET);
+	jpeg_write(JP_CTRL_OFFSET ,  (reg_value | JCTRL_START));
+	while (jpeg_read(JP_CTRL_OFFSET) & (JCTRL_START | JCTRL_WOUT))
+		;
+	return MM_JOB_STATUS_RUNNING1;
+}
+
+static void jpeg_flush(struct jpeg_device_t *jpeg)
+{
+	u32 reg_value;
+	reg_value = jpeg_read(JP_CTRL_OFFSET);
+	jpeg_write(JP_CTRL_OFFSET ,  (reg_value | JCTRL_FLUSH));
+	while ((jpeg_read(JP_CTRL_OFFSET)) &
+		(JCTRL_FLUSH | JCTRL_WOUT))
+		;
+}
+
+/* Up to JPEG_BATCH_CHUNK images per call, so the scheduler work does
+ * not spin on the core for the whole batch. The job stays on the core
+ * in between, which keeps its clocks and DVFS request. */
+static mm_job_status_e jpeg_start_batch(struct jpeg_device_t *jpeg,
+	mm_job_post_t *job)
+{
+	struct jpeg_batch *b = (struct jpeg_batch *)job->data;
+	struct jpeg_value *jp;
+	int n;
+	if (job->status == MM_JOB_STATUS_READY) {
+		if ((job->size < sizeof(*b)) || (b->count == 0) ||
+		(b->count > JPEG_BATCH_MAX) || (job->size <
+		sizeof(*b) + b->count * sizeof(struct jpeg_value))) {
+			job->status = MM_JOB_STATUS_ERROR;
+			return MM_JOB_STATUS_ERROR;
+		}
+		b->done = 0;
+	}
+	for (n = 0; n < JPEG_BATCH_CHUNK; n++) {
+		jp = &b->img[b->done];
+		if (jpeg_start_image(jpeg, jp) !=
+			MM_JOB_STATUS_RUNNING1) {
+			job->status = MM_JOB_STATUS_ERROR;
+			return MM_JOB_STATUS_ERROR;
+		}
+		jpeg_flush(jpeg);
+		jp->jnsb_callback_value = jpeg_read(JP_NSB_OFFSET);
+		if (++b->done == b->count) {
+			job->status = MM_JOB_STATUS_SUCCESS;
+			return MM_JOB_STATUS_SUCCESS;
+		}
+	}
+	job->status = MM_JOB_STATUS_RUNNING1;
+	return MM_JOB_STATUS_RUNNING1;
+}
+
 static mm_job_status_e jpeg_start_job(void *id ,  mm_job_post_t *job, \
 	unsigned int profmask)
 {
 	struct jpeg_device_t *jpeg = (struct jpeg_device_t *)id;
 	struct jpeg_value *jp = (struct jpeg_value *)job->data;
-	u32 i, j, k, jicst, reg_value, jpegStatus;
+	u32 reg_value;
+	if (job->type == JPEG_ENC_BATCH_JOB)
+		return jpeg_start_batch(jpeg, job);
 	switch (job->status) {
 	case MM_JOB_STATUS_READY:
 		{
-		if (jp->out_size_p > jp->hardware_add_out_p) {
+		if (jpeg_start_image(jpeg, jp) != MM_JOB_STATUS_RUNNING1) {
 			job->status = MM_JOB_STATUS_ERROR;
 			return MM_JOB_STATUS_ERROR;
 			}
-		jpeg_write(JP_CTRL_OFFSET ,  (1 << 30) | JCTRL_RESET |
-		JCTRL_STUFF | JCTRL_DCTEN);
-		jpeg_write(JP_MCTRL_OFFSET ,  ((3 * JMCTRL_NUMCMP) |
-		((jp->h) * (jp->v) * JMCTRL_CMP(0) | 0*JMCTRL_DC_TAB(0) |
-		0 * JMCTRL_AC_TAB(0)) | (1 * JMCTRL_CMP(1) |
-		1 * JMCTRL_DC_TAB(1) | 1 * JMCTRL_AC_TAB(1)) |
-		(1 * JMCTRL_CMP(2) | 1 * JMCTRL_DC_TAB(2) |
-		1 * JMCTRL_AC_TAB(2))));
-		if (jp->h == 1 && jp->v == 1) {
-			reg_value = jpeg_read(JP_MCTRL_OFFSET);
-			jpeg_write(JP_MCTRL_OFFSET ,  reg_value |
-			JMCTRL_444_MODE);
-		} else if (jp->h == 2 && jp->v == 1) {
-			reg_value = jpeg_read(JP_MCTRL_OFFSET);
-			jpeg_write(JP_MCTRL_OFFSET ,  (reg_value |
-			JMCTRL_422_MODE));
-		} else if (jp->h == 2 && jp->v == 2) {
-			reg_value = jpeg_read(JP_MCTRL_OFFSET);
-			jpeg_write(JP_MCTRL_OFFSET ,  reg_value |
-			JMCTRL_420_MODE);
-		} else {
-			pr_err("Unsupported subsampling mode DCT hardware.");
-			return MM_JOB_STATUS_ERROR;
-		}
-		jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x200));
-		for (k = 0; k < 0x10; k++) {
-			jpeg_write(JP_HWDATA_OFFSET ,  \
-			((huffsize_Y_DC[k] << 16) | huffcode_Y_DC[k]));
-		}
-		reg_value = jpeg_read(JP_HADDR_OFFSET);
-		jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
-		jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x0));
-		for (k = 0; k < 0x100; k++) {
-			jpeg_write(JP_HWDATA_OFFSET , \
-		((huffsize_Y_AC[k] << 16) | huffcode_Y_AC[k]));
-		}
-		reg_value = jpeg_read(JP_HADDR_OFFSET);
-		jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
-		jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x210));
-		for (k = 0; k < 0x10; k++) {
-			jpeg_write(JP_HWDATA_OFFSET , \
-			((huffsize_C_DC[k] << 16) | huffcode_C_DC[k]));
-		}
-		reg_value = jpeg_read(JP_HADDR_OFFSET);
-		jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
-		jpeg_write(JP_HADDR_OFFSET ,  (JHADDR_TABLEF | 0x100));
-		for (k = 0; k < 0x100; k++) {
-			jpeg_write(JP_HWDATA_OFFSET , \
-			((huffsize_C_AC[k] << 16) | huffcode_C_AC[k]));
-		}
-		reg_value = jpeg_read(JP_HADDR_OFFSET);
-		jpeg_write(JP_HADDR_OFFSET ,  (reg_value & (~JHADDR_TABLEF)));
-		jpeg_write(JP_QADDR_OFFSET ,  (JQADDR_RAMACC | (0 * 64)));
-		for (i = 0; i < 64; i++)
-			jpeg_write(JP_QWDATA_OFFSET ,  (hw_quantf_t_Y[i]));
-		jpeg_write(JP_QADDR_OFFSET ,  (JQADDR_RAMACC | (1 * 64)));
-		for (i = 0; i < 64; i++)
-			jpeg_write(JP_QWDATA_OFFSET ,  (hw_quantf_t_C[i]));
-		jpeg_write(JP_QADDR_OFFSET ,  0);
-		jpeg_write(JP_QCTRL_OFFSET ,  ((0 << 0) | (1 << 2) | (1 << 4)));
-		jpeg_write(JP_SDA_OFFSET ,  ((jp->hardware_add_out_p) & ~0xF));
-		jpeg_write(JP_SBO_OFFSET ,  (8 * (jp->p & 0xF)));
-		jpeg_write(JP_NSB_OFFSET ,  jp->jnsb);
-		int sumhv = (jp->h)*(jp->v) + 2;
-		jpeg_write(JP_NCB_OFFSET , (64 * (sumhv) * (jp->xmcus) *\
-		(jp->ymcus)));
-		jpeg_write(JP_CBA_OFFSET ,  (~0));
-		jpeg_write(JP_C0BA_OFFSET ,  ((jp->hardware_add_Y)));
-		jpeg_write(JP_C1BA_OFFSET ,  ((jp->hardware_add_U)));
-		jpeg_write(JP_C2BA_OFFSET ,  ((jp->hardware_add_V)));
-		jpeg_write(JP_C0S_OFFSET ,  (jp->stride_0));
-		jpeg_write(JP_C1S_OFFSET ,  (jp->stride_1));
-		jpeg_write(JP_C2S_OFFSET ,  (jp->stride_2));
-		jpeg_write(JP_C0W_OFFSET ,  jp->jc0w);
-		jpeg_write(JP_C1W_OFFSET ,  jp->jc1w);
-		jpeg_write(JP_C2W_OFFSET ,  jp->jc2w);
-		jpeg_write(JP_ICST_OFFSET ,  (JICST_INTCD | JICST_INTSD |
-		JICST_INTE));
-		reg_value = jpeg_read(JP_CTRL_OFFSET);
-		jpeg_write(JP_CTRL_OFFSET ,  (reg_value | JCTRL_START));
-		while (jpeg_read(JP_CTRL_OFFSET) & (JCTRL_START | JCTRL_WOUT))
-			;
 		job->status = MM_JOB_STATUS_RUNNING1;
 		return MM_JOB_STATUS_RUNNING1;
 		}
 		break;
 	case MM_JOB_STATUS_RUNNING1:
 		{	pr_err("in side kernel\n");
-			reg_value = jpeg_read(JP_CTRL_OFFSET);
-			jpeg_write(JP_CTRL_OFFSET ,  (reg_value | JCTRL_FLUSH));
-			while ((jpeg_read(JP_CTRL_OFFSET)) &
-				(JCTRL_FLUSH | JCTRL_WOUT))
-				;
+			jpeg_flush(jpeg);
 			job->status = MM_JOB_STATUS_RUNNING;
 			return MM_JOB_STATUS_RUNNING;
 		}
@@ -226,6 +287,7 @@ int __init mm_jpeg_init(void)
 	core_param.mm_get_regs = NULL;
 	core_param.mm_update_virt_addr = mm_jpeg_update_virt_addr;
 	core_param.mm_version_init = NULL;
+	core_param.mm_prepare_job = NULL;
 	core_param.mm_device_id = (void *)jpeg_device;
 	core_param.mm_virt_addr = NULL;
 	core_param.core_name = "JPEG";
@@ -34,4 +34,16 @@ struct jpeg_value {
 	unsigned int jnsb;
 	unsigned int jnsb_callback_value;
 };
+
+#define JPEG_BATCH_MAX		256
+#define JPEG_BATCH_CHUNK	8
+
+/* JPEG_ENC_BATCH_JOB: count images encoded back to back as one job.
+ * done is the number encoded when the job completes, each image's
+ * jnsb_callback_value is filled in as for JPEG_ENC_JOB. */
+struct jpeg_batch {
+	unsigned int count;
+	unsigned int done;
+	struct jpeg_value img[0];
+};
 #endif /*_JPEG_H_*/
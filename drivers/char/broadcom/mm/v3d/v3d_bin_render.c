@@ -32,6 +32,10 @@ the GPL, without Broadcom's express prior written consent.
 #include <linux/mm.h>
 #include <linux/bootmem.h>
 #include <linux/dma-mapping.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/shrinker.h>
+#include <linux/debugfs.h>
 
 #include "v3d_bin_render.h"
 #include <mach/rdb/brcm_rdb_sysmap.h>
@@ -42,6 +46,7 @@ the GPL, without Broadcom's express prior written consent.
 #include <linux/broadcom/mm_fw_usr_ifc.h>
 #ifdef CONFIG_ION
 #include <linux/broadcom/bcm_ion.h>
+#include <linux/broadcom/frame_timeline.h>
 #endif
 
 #define V3D_HW_SIZE (1024*4)
@@ -49,6 +54,15 @@ the GPL, without Broadcom's express prior written consent.
 #define IRQ_V3D	BCM_INT_ID_RESERVED148
 #define V3D_BIN_OOM_SIZE (1024*1024)
 
+/* Overflow blocks handed to the binner come from a pool of two size
+ * classes. The first overflow of a job gets a small block, any further
+ * overflow of the same job a large one */
+#define V3D_BOOM_CLASSES 2
+#define V3D_BOOM_POOL_MAX 4
+static const int v3d_boom_size[V3D_BOOM_CLASSES] = {
+	256*1024, V3D_BIN_OOM_SIZE };
+/* Refill target of each class */
+static const int v3d_boom_low[V3D_BOOM_CLASSES] = { 2, 1 };
 
 #define v3d_boom_t struct _v3d_boom_t
 
@@ -58,6 +72,7 @@ struct _v3d_boom_t {
 	struct ion_handle *v3d_bin_oom_handle;
 	int v3d_bin_oom_block;
 	int v3d_bin_oom_size ;
+	int cls;
 };
 
 unsigned int *job_va;
@@ -68,9 +83,25 @@ struct _v3d_bin_render_device_t {
 	struct ion_client *v3d_bin_oom_client;
 	v3d_boom_t *mem_block;
 	v3d_boom_t *client_block;
+	/* Blocks fed to the binner since the last reset */
 	struct list_head mem_head;
+
+	spinlock_t pool_lock; /* pool, pool_cnt, mem_head, job_oom_cnt */
+	struct list_head pool[V3D_BOOM_CLASSES];
+	int pool_cnt[V3D_BOOM_CLASSES];
+	int job_oom_cnt;
+	struct work_struct refill_work;
+	struct shrinker shrinker;
+	struct dentry *debugfs_dir;
+	u32 pool_hit;
+	u32 pool_miss;
+	u32 pool_refill;
+	u32 pool_shrink;
 #endif
 	void __iomem *vaddr;
+	/* perf counter generation programmed for the running job */
+	u32 perf_gen;
+	bool perf_on;
 };
 
 
@@ -88,7 +119,7 @@ static inline unsigned int v3d_read(v3d_bin_render_device_t *v3d,
 	return mm_read_reg((void *)v3d->vaddr, reg);
 }
 
-static v3d_boom_t *v3d_alloc_boom(void *device_id)
+static v3d_boom_t *v3d_alloc_boom(void *device_id, int cls)
 {
 	v3d_bin_render_device_t *id = (v3d_bin_render_device_t *)device_id;
 	v3d_boom_t *block = kzalloc(sizeof(v3d_boom_t),
@@ -100,21 +131,25 @@ static v3d_boom_t *v3d_alloc_boom(void *device_id)
 
 	heap_mask = bcm_ion_get_heapmask(ION_FLAG_256M | ION_FLAG_FAST_ALLOC);
 	block->v3d_bin_oom_handle = ion_alloc(id->v3d_bin_oom_client,
-				V3D_BIN_OOM_SIZE, 0, heap_mask, 0);
+				v3d_boom_size[cls], 0, heap_mask, 0);
+	if (IS_ERR_OR_NULL(block->v3d_bin_oom_handle)) {
+		block->v3d_bin_oom_handle = NULL;
+		goto err;
+	}
 	block->v3d_bin_oom_block = bcm_ion_map_dma(
 			id->v3d_bin_oom_client,
 			block->v3d_bin_oom_handle);
 	if (block->v3d_bin_oom_block == 0) {
 		pr_err("ion alloc failed for v3d oom block size[0x%x] client[%p] handle[%p]\n",
-			V3D_BIN_OOM_SIZE,
+			v3d_boom_size[cls],
 			id->v3d_bin_oom_client,
 			block->v3d_bin_oom_handle);
 			goto err;
 			}
-	block->v3d_bin_oom_size = V3D_BIN_OOM_SIZE ;
+	block->v3d_bin_oom_size = v3d_boom_size[cls];
+	block->cls = cls;
 
 	INIT_LIST_HEAD(&block->node);
-	list_add_tail(&block->node, &id->mem_head);
 
 	pr_debug("v3d_alloc_boom %x %x\n",
 		block->v3d_bin_oom_block, block->v3d_bin_oom_size);
@@ -142,11 +177,209 @@ static void v3d_free_boom(void *device_id, v3d_boom_t *block)
 		}
 }
 
-static int v3d_bin_render_reset(void *device_id)
+/* Takes a pre-allocated block for the binner, safe from the isr */
+static v3d_boom_t *v3d_boom_get(v3d_bin_render_device_t *id)
 {
-	v3d_bin_render_device_t *id = (v3d_bin_render_device_t *)device_id;
+	v3d_boom_t *block = NULL;
+	unsigned long flags;
+	int i, cls;
+
+	spin_lock_irqsave(&id->pool_lock, flags);
+	cls = id->job_oom_cnt ? V3D_BOOM_CLASSES - 1 : 0;
+	for (i = 0; i < V3D_BOOM_CLASSES; i++) {
+		int c = (cls + i) % V3D_BOOM_CLASSES;
+		if (!list_empty(&id->pool[c])) {
+			block = list_first_entry(&id->pool[c],
+						v3d_boom_t, node);
+			list_move_tail(&block->node, &id->mem_head);
+			id->pool_cnt[c]--;
+			break;
+		}
+	}
+	id->job_oom_cnt++;
+	if (block)
+		id->pool_hit++;
+	else
+		id->pool_miss++;
+	spin_unlock_irqrestore(&id->pool_lock, flags);
+
+	schedule_work(&id->refill_work);
+	return block;
+}
+
+/* Gives the blocks fed to the binner back to the pool, freeing what
+ * is beyond V3D_BOOM_POOL_MAX */
+static void v3d_boom_put_all(v3d_bin_render_device_t *id)
+{
+	v3d_boom_t *mem = NULL;
+	v3d_boom_t *temp_mem = NULL;
+	unsigned long flags;
+	LIST_HEAD(excess);
+
+	spin_lock_irqsave(&id->pool_lock, flags);
+	list_for_each_entry_safe(mem, temp_mem, &(id->mem_head), node) {
+		if (id->pool_cnt[mem->cls] < V3D_BOOM_POOL_MAX) {
+			list_move_tail(&mem->node, &id->pool[mem->cls]);
+			id->pool_cnt[mem->cls]++;
+		} else {
+			list_move_tail(&mem->node, &excess);
+		}
+	}
+	id->job_oom_cnt = 0;
+	spin_unlock_irqrestore(&id->pool_lock, flags);
+
+	list_for_each_entry_safe(mem, temp_mem, &excess, node)
+		v3d_free_boom(id, mem);
+}
+
+static void v3d_boom_refill(struct work_struct *work)
+{
+	v3d_bin_render_device_t *id = container_of(work,
+				v3d_bin_render_device_t, refill_work);
+	unsigned long flags;
+	int cls;
+
+	for (cls = 0; cls < V3D_BOOM_CLASSES; cls++) {
+		for (;;) {
+			v3d_boom_t *block;
+
+			spin_lock_irqsave(&id->pool_lock, flags);
+			if (id->pool_cnt[cls] >= v3d_boom_low[cls]) {
+				spin_unlock_irqrestore(&id->pool_lock, flags);
+				break;
+			}
+			spin_unlock_irqrestore(&id->pool_lock, flags);
+
+			block = v3d_alloc_boom(id, cls);
+			if (!block)
+				break;
+
+			spin_lock_irqsave(&id->pool_lock, flags);
+			list_add_tail(&block->node, &id->pool[cls]);
+			id->pool_cnt[cls]++;
+			id->pool_refill++;
+			spin_unlock_irqrestore(&id->pool_lock, flags);
+		}
+	}
+}
+
+/* Under memory pressure the idle pool goes back to CMA, it is refilled
+ * on the next overflow */
+static int v3d_boom_shrink(struct shrinker *shrinker,
+				struct shrink_control *sc)
+{
+	v3d_bin_render_device_t *id = container_of(shrinker,
+				v3d_bin_render_device_t, shrinker);
 	v3d_boom_t *mem = NULL;
 	v3d_boom_t *temp_mem = NULL;
+	unsigned long flags;
+	int cls, nr = sc->nr_to_scan, left = 0;
+	LIST_HEAD(release);
+
+	if (nr && !(sc->gfp_mask & __GFP_WAIT))
+		return -1;
+
+	spin_lock_irqsave(&id->pool_lock, flags);
+	for (cls = V3D_BOOM_CLASSES - 1; cls >= 0; cls--) {
+		while (nr > 0 && !list_empty(&id->pool[cls])) {
+			list_move_tail(id->pool[cls].next, &release);
+			id->pool_cnt[cls]--;
+			id->pool_shrink++;
+			nr--;
+		}
+		left += id->pool_cnt[cls];
+	}
+	spin_unlock_irqrestore(&id->pool_lock, flags);
+
+	list_for_each_entry_safe(mem, temp_mem, &release, node)
+		v3d_free_boom(id, mem);
+	return left;
+}
+
+/* Perf counter setup asked for by v3d_perf_start(), under v3d_perf_lock */
+static DEFINE_SPINLOCK(v3d_perf_lock);
+static u32 v3d_perf_events[V3D_PERF_COUNTERS];
+static int v3d_perf_n;
+static u32 v3d_perf_gen;
+static u64 v3d_perf_totals[V3D_PERF_COUNTERS];
+
+int v3d_perf_start(const u32 *events, int n)
+{
+	unsigned long flags;
+
+	if (n < 0 || n > V3D_PERF_COUNTERS)
+		return -EINVAL;
+
+	spin_lock_irqsave(&v3d_perf_lock, flags);
+	memcpy(v3d_perf_events, events, n * sizeof(*events));
+	memset(v3d_perf_totals, 0, sizeof(v3d_perf_totals));
+	v3d_perf_n = n;
+	v3d_perf_gen++;
+	spin_unlock_irqrestore(&v3d_perf_lock, flags);
+	return 0;
+}
+EXPORT_SYMBOL(v3d_perf_start);
+
+void v3d_perf_stop(void)
+{
+	v3d_perf_start(NULL, 0);
+}
+EXPORT_SYMBOL(v3d_perf_stop);
+
+int v3d_perf_read(u64 *totals, int n)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&v3d_perf_lock, flags);
+	n = min(n, v3d_perf_n);
+	memcpy(totals, v3d_perf_totals, n * sizeof(*totals));
+	spin_unlock_irqrestore(&v3d_perf_lock, flags);
+	return n;
+}
+EXPORT_SYMBOL(v3d_perf_read);
+
+/* The block may have been powered down since the last job, so the
+ * counters are programmed again for every job */
+static void v3d_perf_job_start(v3d_bin_render_device_t *id)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&v3d_perf_lock, flags);
+	id->perf_gen = v3d_perf_gen;
+	if (v3d_perf_n) {
+		for (i = 0; i < v3d_perf_n; i++)
+			v3d_write(id, V3D_PCTRS0_OFFSET +
+				(V3D_PCTRS1_OFFSET - V3D_PCTRS0_OFFSET) * i,
+				v3d_perf_events[i]);
+		v3d_write(id, V3D_PCTRC_OFFSET, 0xffff);
+		v3d_write(id, V3D_PCTRE_OFFSET,
+				(1U << 31) | ((1U << v3d_perf_n) - 1));
+		id->perf_on = true;
+	} else if (id->perf_on) {
+		v3d_write(id, V3D_PCTRE_OFFSET, 0);
+		id->perf_on = false;
+	}
+	spin_unlock_irqrestore(&v3d_perf_lock, flags);
+}
+
+static void v3d_perf_job_done(v3d_bin_render_device_t *id)
+{
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&v3d_perf_lock, flags);
+	/* counters set up for other events are dropped */
+	if (id->perf_on && id->perf_gen == v3d_perf_gen)
+		for (i = 0; i < v3d_perf_n; i++)
+			v3d_perf_totals[i] +=
+				v3d_read(id, V3D_PCTR0_OFFSET + 4 * i);
+	spin_unlock_irqrestore(&v3d_perf_lock, flags);
+}
+
+static int v3d_bin_render_reset(void *device_id)
+{
+	v3d_bin_render_device_t *id = (v3d_bin_render_device_t *)device_id;
 	v3d_write(id, V3D_CT0CS_OFFSET, 0x8000);
 	v3d_write(id, V3D_CT1CS_OFFSET, 0x8000);
 
@@ -166,9 +399,7 @@ static int v3d_bin_render_reset(void *device_id)
 	v3d_write(id, V3D_INTCTL_OFFSET, 0xF);
 	v3d_write(id, V3D_INTENA_OFFSET, 0x7);
 
-	list_for_each_entry_safe(mem, temp_mem, &(id->mem_head), node) {
-		v3d_free_boom(id, mem);
-		}
+	v3d_boom_put_all(id);
 	return 0;
 }
 
@@ -228,9 +459,24 @@ static mm_isr_type_e process_v3d_bin_render_irq(void *device_id)
 
 	/* Handle oom case */
 	if (flags & (1 << 2)) {
-		irq_retval = MM_ISR_SUCCESS;
-		v3d_write(id, V3D_INTDIS_OFFSET, 1 << 2);
-		pr_debug("request boom from isr\n");
+		v3d_boom_t *block = v3d_boom_get(id);
+		if (block) {
+			/* Keep the binner going without leaving the isr */
+			v3d_write(id, V3D_BPOA_OFFSET,
+				block->v3d_bin_oom_block);
+			v3d_write(id, V3D_BPOS_OFFSET,
+				block->v3d_bin_oom_size);
+			v3d_write(id, V3D_INTCTL_OFFSET, 1 << 2);
+			pr_debug("supply boom from isr %x %x\n",
+					block->v3d_bin_oom_block,
+					block->v3d_bin_oom_size);
+			if (irq_retval == MM_ISR_UNKNOWN)
+				irq_retval = MM_ISR_PROCESSED;
+		} else {
+			irq_retval = MM_ISR_SUCCESS;
+			v3d_write(id, V3D_INTDIS_OFFSET, 1 << 2);
+			pr_debug("request boom from isr\n");
+		}
 	}
 	return irq_retval;
 }
@@ -245,8 +491,17 @@ bool get_v3d_bin_render_status(void *device_id)
 
 	/* Handle oom case */
 	if (flags & (1 << 2)) {
-		v3d_boom_t *block =
-		v3d_alloc_boom(id);
+		v3d_boom_t *block = v3d_boom_get(id);
+		if (!block) {
+			unsigned long lock_flags;
+			block = v3d_alloc_boom(id, V3D_BOOM_CLASSES - 1);
+			if (block) {
+				spin_lock_irqsave(&id->pool_lock, lock_flags);
+				list_add_tail(&block->node, &id->mem_head);
+				spin_unlock_irqrestore(&id->pool_lock,
+							lock_flags);
+			}
+		}
 		if (block) {
 			v3d_write(id, V3D_BPOA_OFFSET,
 			block->v3d_bin_oom_block);
@@ -286,6 +541,7 @@ mm_job_status_e v3d_bin_render_start_job(void *device_id,
 	case MM_JOB_STATUS_READY:
 		{
 			v3d_bin_render_reset(id);
+			v3d_perf_job_start(id);
 			job_va[0] = job->type;
 			job_va[1] = job_params->v3d_ct0ca;
 			job_va[2] = job_params->v3d_ct0ea;
@@ -354,6 +610,8 @@ mm_job_status_e v3d_bin_render_start_job(void *device_id,
 				v3d_read(id, V3D_BPOS_OFFSET),
 				v3d_read(id, V3D_PCS_OFFSET));
 				}
+			v3d_perf_job_done(id);
+			frame_tl_stamp(FRAME_TL_V3D_DONE);
 			job->status = MM_JOB_STATUS_SUCCESS;
 			return MM_JOB_STATUS_SUCCESS;
 		}
@@ -379,6 +637,22 @@ void v3d_bin_render_deinit(void)
 {
 	pr_debug("V3D bin_render driver Module Exit");
 #ifdef CONFIG_ION
+	{
+		v3d_boom_t *mem = NULL;
+		v3d_boom_t *temp_mem = NULL;
+		int cls;
+
+		debugfs_remove_recursive(v3d_device->debugfs_dir);
+		unregister_shrinker(&v3d_device->shrinker);
+		cancel_work_sync(&v3d_device->refill_work);
+		list_for_each_entry_safe(mem, temp_mem,
+					&v3d_device->mem_head, node)
+			v3d_free_boom(v3d_device, mem);
+		for (cls = 0; cls < V3D_BOOM_CLASSES; cls++)
+			list_for_each_entry_safe(mem, temp_mem,
+					&v3d_device->pool[cls], node)
+				v3d_free_boom(v3d_device, mem);
+	}
 	if (v3d_device->mem_block)
 		v3d_free_boom(v3d_device, v3d_device->mem_block);
 	if (v3d_device->client_block)
@@ -429,6 +703,7 @@ int v3d_bin_render_version_init(void *device_id, void *vaddr,
 int v3d_bin_render_init(MM_CORE_HW_IFC *core_param)
 {
 	int ret = 0;
+	int i;
 
 	v3d_device = kmalloc(sizeof(v3d_bin_render_device_t), GFP_KERNEL);
 	if (v3d_device == NULL) {
@@ -438,6 +713,8 @@ int v3d_bin_render_init(MM_CORE_HW_IFC *core_param)
 	}
 
 	v3d_device->vaddr = NULL;
+	v3d_device->perf_gen = 0;
+	v3d_device->perf_on = false;
 	pr_debug("v3d_bin_render_init: -->\n");
 
 #ifdef CONFIG_ION
@@ -449,11 +726,42 @@ int v3d_bin_render_init(MM_CORE_HW_IFC *core_param)
 	}
 	INIT_LIST_HEAD(&v3d_device->mem_head);
 
-	v3d_device->mem_block = v3d_alloc_boom(v3d_device);
-	list_del_init(&v3d_device->mem_block->node);
+	v3d_device->mem_block = v3d_alloc_boom(v3d_device,
+						V3D_BOOM_CLASSES - 1);
+	v3d_device->client_block = v3d_alloc_boom(v3d_device,
+						V3D_BOOM_CLASSES - 1);
 
-	v3d_device->client_block = v3d_alloc_boom(v3d_device);
-	list_del_init(&v3d_device->client_block->node);
+	spin_lock_init(&v3d_device->pool_lock);
+	for (i = 0; i < V3D_BOOM_CLASSES; i++) {
+		INIT_LIST_HEAD(&v3d_device->pool[i]);
+		v3d_device->pool_cnt[i] = 0;
+	}
+	v3d_device->job_oom_cnt = 0;
+	v3d_device->pool_hit = 0;
+	v3d_device->pool_miss = 0;
+	v3d_device->pool_refill = 0;
+	v3d_device->pool_shrink = 0;
+	INIT_WORK(&v3d_device->refill_work, v3d_boom_refill);
+	v3d_boom_refill(&v3d_device->refill_work);
+
+	v3d_device->shrinker.shrink = v3d_boom_shrink;
+	v3d_device->shrinker.seeks = DEFAULT_SEEKS;
+	register_shrinker(&v3d_device->shrinker);
+
+	v3d_device->debugfs_dir = debugfs_create_dir("v3d_boom", NULL);
+	if (!IS_ERR_OR_NULL(v3d_device->debugfs_dir)) {
+		struct dentry *dir = v3d_device->debugfs_dir;
+		debugfs_create_u32("hit", S_IRUSR | S_IRGRP, dir,
+					&v3d_device->pool_hit);
+		debugfs_create_u32("miss", S_IRUSR | S_IRGRP, dir,
+					&v3d_device->pool_miss);
+		debugfs_create_u32("refill", S_IRUSR | S_IRGRP, dir,
+					&v3d_device->pool_refill);
+		debugfs_create_u32("shrink", S_IRUSR | S_IRGRP, dir,
+					&v3d_device->pool_shrink);
+	} else {
+		v3d_device->debugfs_dir = NULL;
+	}
 
 #else
 #error "V3D Driver Cannot work without ION"
@@ -476,6 +784,7 @@ int v3d_bin_render_init(MM_CORE_HW_IFC *core_param)
 	core_param->mm_device_id = (void *)v3d_device;
 	core_param->mm_virt_addr = NULL;
 	core_param->mm_version_init = v3d_bin_render_version_init;
+	core_param->mm_prepare_job = NULL;
 	core_param->mm_update_virt_addr = v3d_bin_render_update_virt;
 	job_va = (unsigned int *)dma_alloc_coherent(NULL, 32, &job_pa, GFP_DMA);
 	pr_err("v3d_init job va = %p job pa = %x", job_va, job_pa);
@@ -14,6 +14,7 @@
 #include <linux/module.h>
 #include <linux/stddef.h>
 #include <linux/slab.h>
+#include <linux/sched.h>
 #include <linux/broadcom/csl_types.h>
 #include <linux/broadcom/ipcinterface.h>
 #include <linux/broadcom/ipcproperties.h>
@@ -53,10 +54,39 @@ extern UInt32 TIMER_GetValue(void);
  */
 #define IPC_POOLFreeQ(Pool) (Pool + OFFSETOF(IPC_BufferPool_T, FreeBufferQ))
 
+#ifdef UNDER_LINUX
+/**
+ * On the AP the Lock field of a pool points to its IPC_PoolLocal_T, which
+ * holds the OS lock and the lock statistics in local memory. The field is
+ * only ever used by the CPU owning the pool, so the shared memory layout
+ * seen by the CP is unchanged.
+ */
+#define IPC_PoolLocal(PoolPtr) ((IPC_PoolLocal_T *) (PoolPtr)->Lock)
+#define POOL_LOCK(PoolPtr) IPC_PoolLock(PoolPtr)
+#define POOL_UNLOCK(PoolPtr) IPC_PoolUnlock(PoolPtr)
+#else
+#define POOL_LOCK(PoolPtr) CRITICAL_REIGON_ENTER((PoolPtr)->Lock)
+#define POOL_UNLOCK(PoolPtr) CRITICAL_REIGON_LEAVE((PoolPtr)->Lock)
+#endif /* UNDER_LINUX */
+
 /*============================================================
 * Types
 *===========================================================*/
 
+#ifdef UNDER_LINUX
+/* AP local part of a Buffer Pool: every field is under Lock */
+typedef struct IPC_PoolLocal_S {
+	void *Lock;
+	IPC_Boolean Busy;	/* Lock is held */
+	unsigned long long HoldStart;
+	IPC_U32 Acquires;
+	IPC_U32 Contended;	/* found Lock held by another context */
+	IPC_U32 WaitTotalUs;
+	IPC_U32 WaitMaxNs;
+	IPC_U32 HoldMaxNs;
+} IPC_PoolLocal_T;
+#endif /* UNDER_LINUX */
+
 /*============================================================
 * Variables
 *===========================================================*/
@@ -74,6 +104,43 @@ IPC_PoolList_T PoolList[IPC_EndpointId_Count];
 * Functions
 *===========================================================*/
 
+#ifdef UNDER_LINUX
+/**************************************************/
+static void IPC_PoolLock(IPC_BufferPool_T *PoolPtr)
+{
+	IPC_PoolLocal_T *Local = IPC_PoolLocal(PoolPtr);
+	/* racy peek, only to count how often the lock is fought over */
+	IPC_Boolean Contended = Local->Busy;
+	unsigned long long Start = sched_clock();
+	IPC_U32 Wait;
+
+	CRITICAL_REIGON_ENTER(Local->Lock);
+	Local->HoldStart = sched_clock();
+	Local->Busy = IPC_TRUE;
+
+	Wait = (IPC_U32) (Local->HoldStart - Start);
+	Local->Acquires++;
+	if (Contended) {
+		Local->Contended++;
+		Local->WaitTotalUs += Wait / NSEC_PER_USEC;
+	}
+	if (Wait > Local->WaitMaxNs)
+		Local->WaitMaxNs = Wait;
+}
+
+/**************************************************/
+static void IPC_PoolUnlock(IPC_BufferPool_T *PoolPtr)
+{
+	IPC_PoolLocal_T *Local = IPC_PoolLocal(PoolPtr);
+	IPC_U32 Hold = (IPC_U32) (sched_clock() - Local->HoldStart);
+
+	if (Hold > Local->HoldMaxNs)
+		Local->HoldMaxNs = Hold;
+	Local->Busy = IPC_FALSE;
+	CRITICAL_REIGON_LEAVE(Local->Lock);
+}
+#endif /* UNDER_LINUX */
+
 /**************************************************/
 IPC_BufferPool IPC_CreateBufferPoolWithDescriptor(
 	IPC_EndpointId_T SourceEndpointId,
@@ -185,7 +252,21 @@ IPC_BufferPool IPC_CreateBufferPoolWithDescriptor(
 	PoolPtr->FlowStartCalls = 0;
 
 	PoolPtr->EmptyEvent = IPC_EVENT_CREATE;
+#ifdef UNDER_LINUX
+	{
+		IPC_PoolLocal_T *Local = kzalloc(sizeof(*Local), GFP_KERNEL);
+
+		if (!Local) {
+			IPC_TRACE(IPC_Channel_Error, "IPC_CreateBufferPool",
+				  "Pool local data alloc Failed", 0, 0, 0, 0);
+			return 0;
+		}
+		Local->Lock = CRITICAL_REIGON_CREATE();
+		PoolPtr->Lock = Local;
+	}
+#else
 	PoolPtr->Lock = CRITICAL_REIGON_CREATE();
+#endif /* UNDER_LINUX */
 
 	IPC_QInitialise(IPC_SmOffset(&PoolPtr->FreeBufferQ), Pool);
 	IPC_QInitialise(IPC_SmOffset(&PoolPtr->AllocatedBufferQ), Pool);
@@ -397,7 +478,13 @@ void IPC_PoolDelete(IPC_BufferPool Pool)
 {
 	IPC_BufferPool_T *PoolPtr = IPC_PoolToPtr(Pool);
 	IPC_EVENT_DELETE(PoolPtr->EmptyEvent);
+#ifdef UNDER_LINUX
+	CRITICAL_REIGON_DELETE(IPC_PoolLocal(PoolPtr)->Lock);
+	kfree(IPC_PoolLocal(PoolPtr));
+	PoolPtr->Lock = 0;
+#else
 	CRITICAL_REIGON_DELETE(PoolPtr->Lock);
+#endif /* UNDER_LINUX */
 }
 
 /**************************************************/
@@ -414,14 +501,14 @@ void IPC_ReportFlowControlEvent(IPC_BufferPool_T *PoolPtr,
 		return;
 	}
 
-	CRITICAL_REIGON_ENTER(PoolPtr->Lock);
+	POOL_LOCK(PoolPtr);
 	if (Event != PoolPtr->FlowControlState) {
 		/* State has already changed back - do not report change */
 		PoolPtr->FlowControlCallPending = IPC_FALSE;
-		CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+		POOL_UNLOCK(PoolPtr);
 		return;
 	}
-	CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+	POOL_UNLOCK(PoolPtr);
 
 	ReportedFlowControlState = Event;
 
@@ -454,7 +541,7 @@ void IPC_ReportFlowControlEvent(IPC_BufferPool_T *PoolPtr,
 #ifndef UNDER_LINUX
 		(*SourceEp->FlowControlFunction) (Pool,
 						  ReportedFlowControlState);
-		CRITICAL_REIGON_ENTER(PoolPtr->Lock);
+		POOL_LOCK(PoolPtr);
 #else
 		/*
 		   Linux Issue:
@@ -467,20 +554,20 @@ void IPC_ReportFlowControlEvent(IPC_BufferPool_T *PoolPtr,
 		   ==> Enter Critical region before calling cbk ( IPC_FLOW_START ). The critical region disables Net IRQ
 		   ==> PoolPtr->FlowControlCallPending is set to FALSE and then the Critical region exits which then triggers Net IRQ.
 		 */
-		CRITICAL_REIGON_ENTER(PoolPtr->Lock);
+		POOL_LOCK(PoolPtr);
 		    (*SourceEp->FlowControlFunction) (Pool,
 						      ReportedFlowControlState);
 #endif
 
 		if (ReportedFlowControlState == PoolPtr->FlowControlState) {
 			PoolPtr->FlowControlCallPending = IPC_FALSE;
-			CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+			POOL_UNLOCK(PoolPtr);
 			return;
 		}
 
 		ReportedFlowControlState = PoolPtr->FlowControlState;
 
-	CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+	POOL_UNLOCK(PoolPtr);
 	}
 }
 
@@ -499,14 +586,14 @@ IPC_Buffer IPC_AllocateBuffer(IPC_BufferPool Pool)
 		return 0;
 	}
 
-	CRITICAL_REIGON_ENTER(PoolPtr->Lock);
+	POOL_LOCK(PoolPtr);
 
 	QElement = IPC_QGetFirst(IPC_POOLFreeQ(Pool));
 
 	if (!QElement) {
 		PoolPtr->FlowControlState = IPC_FLOW_STOP;
 		PoolPtr->AllocationFailures++;
-		CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+		POOL_UNLOCK(PoolPtr);
 		    if (PoolPtr->DestinationEndpointId != IPC_EP_LogApps) {
 			IPC_TRACE(IPC_Channel_FlowControl,
 				  "IPC_ReportFlowControlEvent",
@@ -525,7 +612,7 @@ IPC_Buffer IPC_AllocateBuffer(IPC_BufferPool Pool)
 	if (BufferCount == PoolPtr->FlowStopLimit)
 		CHECK_FLOW_STATE(PoolPtr, IPC_FLOW_STOP, FlowControlCallNeeded)
 
-	CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+	POOL_UNLOCK(PoolPtr);
 	if (FlowControlCallNeeded)
 		IPC_ReportFlowControlEvent(PoolPtr, IPC_FLOW_STOP);
 
@@ -654,7 +741,7 @@ void IPC_BufferReturnToPool(IPC_Buffer Buffer, IPC_BufferPool Pool)
 		      "Buffer %d (%08X), now %d in pool", IPC_BufferId(Buffer),
 		      Buffer, PoolPtr->FreeBuffers + 1, 0);
 
-	CRITICAL_REIGON_ENTER(PoolPtr->Lock);
+	POOL_LOCK(PoolPtr);
 	BufferCount = ++PoolPtr->FreeBuffers;
 
 #ifdef IPC_DEBUG
@@ -668,7 +755,7 @@ void IPC_BufferReturnToPool(IPC_Buffer Buffer, IPC_BufferPool Pool)
 		CHECK_FLOW_STATE(PoolPtr, IPC_FLOW_START, FlowControlCallNeeded)
 	}
 
-	CRITICAL_REIGON_LEAVE(PoolPtr->Lock);
+	POOL_UNLOCK(PoolPtr);
 	if (FlowControlCallNeeded) {
 		IPC_ReportFlowControlEvent(PoolPtr, IPC_FLOW_START);
 	}
@@ -732,6 +819,21 @@ void IPC_PoolDumpStats(IPC_BufferPool Pool)
 		  "Sent %d, FreeBufs %d, LowWaterMark %d, FcState %d",
 		  PoolPtr->BytesSent, PoolPtr->FreeBuffers,
 		  PoolPtr->LowWaterMark, PoolPtr->FlowControlState);
+
+#ifdef UNDER_LINUX
+	if (IPC_PoolLocal(PoolPtr)) {
+		IPC_PoolLocal_T *Local = IPC_PoolLocal(PoolPtr);
+
+		IPC_TRACE(IPC_Channel_General, "         ",
+			  "Locks %d, Contended %d, WaitTotal %dus",
+			  Local->Acquires, Local->Contended,
+			  Local->WaitTotalUs, 0);
+
+		IPC_TRACE(IPC_Channel_General, "         ",
+			  "WaitMax %dns, HoldMax %dns",
+			  Local->WaitMaxNs, Local->HoldMaxNs, 0, 0);
+	}
+#endif /* UNDER_LINUX */
 }
 
 /**************************************************/
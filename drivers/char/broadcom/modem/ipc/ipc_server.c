@@ -31,6 +31,8 @@
 #include <linux/sched.h>
 #include <linux/wait.h>
 #include <linux/jiffies.h>
+#include <linux/hrtimer.h>
+#include <linux/spinlock.h>
 #ifdef CONFIG_BRCM_FUSE_IPC_CIB
 #include <linux/broadcom/ipcinterface.h>
 #else
@@ -92,6 +94,35 @@ static IPC_PlatformSpecificPowerSavingInfo_T ipc_ps;
 extern int IpcCPCrashCheck(void);
 extern void ProcessCPCrashedDump(struct work_struct *work);
 
+/*
+ * Doorbell coalescing: a doorbell towards the CP for bulk data is held
+ * for up to doorbell_delay_us, or until doorbell_batch buffers are
+ * queued, so a burst of packets costs one CP interrupt. Urgent endpoints
+ * (control, audio) ring at once and take any held doorbell with them.
+ * doorbell_delay_us = 0 rings every doorbell when it is asked for.
+ *
+ * rx_poll_us: after a CP interrupt the C2A interrupt stays masked and the
+ * tasklet keeps polling the FIFOs for that long, so what the CP sends in
+ * the meantime is picked up without an interrupt each.
+ */
+static unsigned int doorbell_delay_us;
+module_param(doorbell_delay_us, uint, S_IRUGO | S_IWUSR);
+static unsigned int doorbell_batch = 8;
+module_param(doorbell_batch, uint, S_IRUGO | S_IWUSR);
+static unsigned int rx_poll_us;
+module_param(rx_poll_us, uint, S_IRUGO | S_IWUSR);
+
+static struct hrtimer doorbell_timer;
+static DEFINE_SPINLOCK(doorbell_lock);
+static bool doorbell_pending;
+static bool rx_irq_masked;
+
+/* under doorbell_lock, except the rx counts which the tasklet owns */
+static u32 doorbell_wanted;	/* without coalescing */
+static u32 doorbell_rung;
+static u32 rx_irqs;
+static u32 rx_polled;		/* FIFO passes found busy while polling */
+
 #if defined(CONFIG_BCM215X_PM) && defined(CONFIG_ARCH_BCM2153)
 extern void pm_ipc_power_saving_init(
 	IPC_PlatformSpecificPowerSavingInfo_T *ipc_ps);
@@ -208,6 +239,96 @@ void ipcs_ipc_reset(void)
 	return;
 }
 
+static int ipcs_get_stats(char *buf, const struct kernel_param *kp)
+{
+	return sprintf(buf, "doorbells %u rung %u rx_irqs %u rx_polled %u\n",
+		       doorbell_wanted, doorbell_rung, rx_irqs, rx_polled);
+}
+module_param_call(stats, NULL, ipcs_get_stats, NULL, S_IRUGO);
+
+void ipcs_doorbell(IPC_Boolean Empty, IPC_U32 Queued, IPC_Boolean Urgent)
+{
+	unsigned long flags;
+	bool ring = false;
+
+	spin_lock_irqsave(&doorbell_lock, flags);
+	if (Empty)
+		doorbell_wanted++;
+	if (doorbell_pending) {
+		if (Urgent || Queued >= doorbell_batch) {
+			hrtimer_try_to_cancel(&doorbell_timer);
+			doorbell_pending = false;
+			ring = true;
+		}
+	} else if (Empty) {
+		if (Urgent || !doorbell_delay_us) {
+			ring = true;
+		} else {
+			doorbell_pending = true;
+			hrtimer_start(&doorbell_timer,
+				      ktime_set(0, doorbell_delay_us *
+						NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		}
+	}
+	if (ring)
+		doorbell_rung++;
+	spin_unlock_irqrestore(&doorbell_lock, flags);
+
+	if (ring)
+		IPC_RaiseDoorbell();
+}
+
+static enum hrtimer_restart ipcs_doorbell_timer(struct hrtimer *timer)
+{
+	unsigned long flags;
+	bool ring;
+
+	spin_lock_irqsave(&doorbell_lock, flags);
+	ring = doorbell_pending;
+	doorbell_pending = false;
+	if (ring)
+		doorbell_rung++;
+	spin_unlock_irqrestore(&doorbell_lock, flags);
+
+	if (ring)
+		IPC_RaiseDoorbell();
+	return HRTIMER_NORESTART;
+}
+
+static void ipcs_clear_interrupt(void)
+{
+	void __iomem *base = (void __iomem *)(KONA_BINTC_BASE_ADDR);
+	int birq = IRQ_TO_BMIRQ(IRQ_IPC_C2A_BINTC);	//55;
+
+	if (birq >= 32)
+		writel(1 << (birq - 32),
+		       base + BINTC_ISWIR1_CLR_OFFSET /*0x34 */ );
+	else
+		writel(1 << (birq), base + BINTC_ISWIR0_CLR_OFFSET /*0x24 */ );
+}
+
+/* keep draining the FIFOs with the CP interrupt masked, then unmask it */
+static void ipcs_rx_poll(void)
+{
+	u64 end = sched_clock() + (u64)rx_poll_us * NSEC_PER_USEC;
+
+	while (sched_clock() < end) {
+		if (IPC_EventsPending()) {
+			rx_polled++;
+			IPC_ProcessEvents();
+		} else {
+			cpu_relax();
+		}
+	}
+
+	/* what the CP signals from here on raises the interrupt again */
+	ipcs_clear_interrupt();
+	IPC_ProcessEvents();
+	rx_irq_masked = false;
+	enable_irq(IRQ_IPC_C2A);
+}
+
 int cp_crashed;
 
 void ipcs_intr_tasklet_handler(unsigned long data)
@@ -224,8 +345,14 @@ void ipcs_intr_tasklet_handler(unsigned long data)
 		queue_work(g_ipc_info.crash_dump_workqueue,
 			   &g_ipc_info.cp_crash_dump_wq);
 		IPC_ProcessEvents();
+		if (rx_irq_masked) {
+			rx_irq_masked = false;
+			enable_irq(IRQ_IPC_C2A);
+		}
 	} else {
 		IPC_ProcessEvents();
+		if (rx_irq_masked)
+			ipcs_rx_poll();
 		wake_unlock(&ipc_wake_lock);
 	}
 }
@@ -233,17 +360,17 @@ void ipcs_intr_tasklet_handler(unsigned long data)
 
 static irqreturn_t ipcs_interrupt(int irq, void *dev_id)
 {
-	void __iomem *base = (void __iomem *)(KONA_BINTC_BASE_ADDR);
-	int birq = IRQ_TO_BMIRQ(IRQ_IPC_C2A_BINTC);	//55;
-
 	/* Clear the interrupt */
-	if (birq >= 32)
-		writel(1 << (birq - 32),
-		       base + BINTC_ISWIR1_CLR_OFFSET /*0x34 */ );
-	else
-		writel(1 << (birq), base + BINTC_ISWIR0_CLR_OFFSET /*0x24 */ );
+	ipcs_clear_interrupt();
 
 	IPC_UpdateIrqStats();
+	rx_irqs++;
+
+	if (rx_poll_us && !rx_irq_masked) {
+		/* the tasklet polls and unmasks */
+		rx_irq_masked = true;
+		disable_irq_nosync(irq);
+	}
 
 	wake_lock(&ipc_wake_lock);
 	tasklet_schedule(&g_ipc_info.intr_tasklet);
@@ -653,6 +780,9 @@ static int __init ipcs_module_init(void)
 
 	tasklet_init(&g_ipc_info.intr_tasklet, ipcs_intr_tasklet_handler, 0);
 
+	hrtimer_init(&doorbell_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	doorbell_timer.function = ipcs_doorbell_timer;
+
 	/**
 	 Make sure this is not cache'd because CP has to know about any changes
 	 we write to this memory immediately.
@@ -706,6 +836,7 @@ out:
 
 static void __exit ipcs_module_exit(void)
 {
+	hrtimer_cancel(&doorbell_timer);
 	tasklet_kill(&g_ipc_info.intr_tasklet);
 	flush_workqueue(g_ipc_info.crash_dump_workqueue);
 	destroy_workqueue(g_ipc_info.crash_dump_workqueue);
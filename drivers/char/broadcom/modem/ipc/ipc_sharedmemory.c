@@ -118,7 +118,23 @@ static void IPC_RaiseInterrupt(void)
 
 
 /**************************************************/
-void IPC_SmFifoWrite(IPC_Fifo Fifo, IPC_Buffer Message)
+#ifdef UNDER_LINUX
+void IPC_RaiseDoorbell(void)
+{
+	RAISE_INTERRUPT;
+}
+
+/**
+ * Bulk data that can wait for a coalesced doorbell; control, audio and
+ * everything else rings the CP at once
+ */
+#define IPC_SM_BULK_ENDPOINT(EpId) \
+	((EpId) == IPC_EP_PsCpData || (EpId) == IPC_EP_EemCP)
+#endif /* UNDER_LINUX */
+
+/**************************************************/
+static void IPC_SmFifoPut(IPC_Fifo Fifo, IPC_Buffer Message,
+			  IPC_Boolean Urgent)
 {
 	CRITICAL_REIGON_SETUP 
 	IPC_U32 OriginalWritePointer;
@@ -151,14 +167,39 @@ void IPC_SmFifoWrite(IPC_Fifo Fifo, IPC_Buffer Message)
 			  Fifo->WriteCount, Fifo->HighWaterMark, 0);
 	}
 
+#ifdef UNDER_LINUX
+	/* the IPC server decides when the doorbell actually rings */
+	ipcs_doorbell(Fifo->ReadIndex == OriginalWritePointer,
+		      IPC_FIFOCOUNT(Fifo), Urgent);
+#else
 	if (Fifo->ReadIndex == OriginalWritePointer) {
 		/* Remote end is not currently reading FIFO */
 		IPC_TRACE(IPC_Channel_Sm, "IPC_SmFifoWrite",
 			  "Interrupting other Cpu", 0, 0, 0, 0);
 		RAISE_INTERRUPT;
 	}
+#endif /* UNDER_LINUX */
 }
 
+/**************************************************/
+void IPC_SmFifoWrite(IPC_Fifo Fifo, IPC_Buffer Message)
+{
+	/* buffer frees: the CP is not waiting on them */
+	IPC_SmFifoPut(Fifo, Message, IPC_FALSE);
+}
+
+/**************************************************/
+#ifdef UNDER_LINUX
+IPC_Boolean IPC_EventsPending(void)
+{
+	IPC_Fifo SendFifo = SmLocalControl.SendFifo;
+	IPC_Fifo FreeFifo = SmLocalControl.FreeFifo;
+
+	return SendFifo->ReadIndex != SendFifo->WriteIndex ||
+	    FreeFifo->ReadIndex != FreeFifo->WriteIndex;
+}
+#endif /* UNDER_LINUX */
+
 /**************************************************/
 /* Only called by the SM HISR, so no critical reigon */
 static IPC_Buffer IPC_SmFifoRead(IPC_Fifo Fifo)
@@ -409,7 +450,12 @@ void IPC_SmSendBuffer(IPC_Buffer Buffer)
 		IPC_Fifo SendFifo =
 		    &SmLocalControl.SmControl->
 		    Fifos[IPC_CPU_ID_INDEX(DestinationCpu)].SendFifo;
+#ifdef UNDER_LINUX
+		IPC_SmFifoPut(SendFifo, Buffer,
+			      !IPC_SM_BULK_ENDPOINT(DestinationEpId));
+#else
 		IPC_SmFifoWrite(SendFifo, Buffer);
+#endif /* UNDER_LINUX */
 	}
 }
 
@@ -260,6 +260,16 @@ IPC_SmPtr IPC_SmPoolAlloc(IPC_U32 PoolOverhead,
 /* Sends a Buffer to the other CPU */
 void IPC_SmSendBuffer(IPC_Buffer Buffer);
 
+#ifdef UNDER_LINUX
+/**************************************************/
+/**
+ * Implemented by the IPC server: a buffer has been put in a FIFO towards
+ * the CP, which now holds Queued buffers. Empty is set when the CP was not
+ * reading the FIFO and needs a doorbell to see it.
+ */
+void ipcs_doorbell(IPC_Boolean Empty, IPC_U32 Queued, IPC_Boolean Urgent);
+#endif /* UNDER_LINUX */
+
 #ifdef __cplusplus
 }
 #endif
@@ -667,6 +667,16 @@ void IPC_Dump(void);
 /****************************************/
 void IPC_UpdateIrqStats(void);
 
+#ifdef UNDER_LINUX
+/****************************************/
+/* Interrupts the CP, for doorbells that were held back */
+void IPC_RaiseDoorbell(void);
+
+/****************************************/
+/* Are there buffers from the CP waiting for IPC_ProcessEvents */
+IPC_Boolean IPC_EventsPending(void);
+#endif
+
 /*============================================================*/
 
 /*============================================================
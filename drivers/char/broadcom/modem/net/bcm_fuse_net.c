@@ -28,6 +28,7 @@
 #include <linux/ip.h>
 #include <linux/tcp.h>
 #include <linux/workqueue.h>
+#include <linux/hrtimer.h>
 #include <linux/proc_fs.h>
 #include <asm/uaccess.h>
 #include <linux/if_arp.h>
@@ -68,6 +69,12 @@ extern unsigned char SYS_GenClientID(void);
 #define BCM_NET_MAX_DATA_LEN       1500	/* bytes */
 #define BCM_NET_MAX_NUM_PKTS       250	/* packets */
 
+/**
+ * Downlink buffers held for NAPI, power of 2 and at least the pool size
+ */
+#define BCM_NET_RX_RING_SIZE       256	/* packets */
+#define BCM_NET_NAPI_WEIGHT        64	/* packets */
+
 #define BCM_DUALSIM_SIMID_NETIOCTL (SIOCDEVPRIVATE + 1)
 #define BCM_MAX_SIM_ID 2
 
@@ -87,19 +94,39 @@ typedef struct {
 	uint8_t sim_id;
 	unsigned long ip_addr;
 	struct net_device_stats stats;
+	/* downlink IPC buffers waiting for bcm_fuse_net_poll */
+	struct napi_struct napi;
+	spinlock_t rx_lock;
+	unsigned int rx_head;
+	unsigned int rx_tail;
+	PACKET_BufHandle_t rx_ring[BCM_NET_RX_RING_SIZE];
 } net_drvr_info_t;
 
 struct net_tx {
 	struct sk_buff_head queue;
 	struct work_struct work;
 	struct workqueue_struct *wq;
+	struct hrtimer timer;		/* bounds the wait for a batch */
+	bool flow_stopped;		/* RPC_FLOW_STOP from the CP */
 	unsigned long high_water_mark;
+	/* uplink rate, from the bytes sent between two RPC_FLOW_STOPs */
+	unsigned long sent_bytes;
+	unsigned long stop_bytes;
+	ktime_t stop_time;
+	ktime_t stopped_since;
+	u64 stopped_ns;
+	unsigned int flow_stops;
+	unsigned int rate;		/* bytes per second, 0 if unknown */
+	/* time from bcm_fuse_net_tx to the CP, us << 3 */
+	unsigned int delay_avg;
+	unsigned int delay_max;
 };
 
 #define GET_NETDEV_IN_SKB_CB(__skb) \
 	((struct net_device *)(*((unsigned long *)&((__skb)->cb[0]))))
 #define PUT_NETDEV_IN_SKB_CB(__skb, dev) \
 	(*((unsigned long *)&((__skb)->cb[0])) = (unsigned long)(dev))
+#define SKB_CB_TX_TIME(__skb)	(*((ktime_t *)&((__skb)->cb[8])))
 #define QUEUE_MAX_SIZE  BCM_NET_MAX_NUM_PKTS
 
 spinlock_t g_dev_lock;
@@ -107,6 +134,29 @@ static net_drvr_info_t g_net_dev_tbl[BCM_NET_MAX_PDP_CNTXS];
 static struct net_tx g_net_tx;
 static unsigned char g_NetClientId = 0;
 
+/*
+ * Uplink packets are held until tx_batch_pkts are queued or tx_batch_us
+ * has passed, then sent back to back: the IPC send FIFO only rings the
+ * CP doorbell when it was empty, so a batch costs one CP wakeup.
+ * tx_batch_us = 0 sends each packet as it comes.
+ */
+static unsigned int tx_batch_pkts = 8;
+module_param(tx_batch_pkts, uint, S_IRUGO | S_IWUSR);
+static unsigned int tx_batch_us = 500;
+module_param(tx_batch_us, uint, S_IRUGO | S_IWUSR);
+
+/*
+ * BQL counts a packet as in flight from bcm_fuse_net_tx until it is
+ * handed to the CP, so only a few are held here and the rest queue in
+ * the qdisc, where fq_codel keeps interactive flows ahead of uploads.
+ * Once the uplink rate is known, the BQL limit is capped at bql_ms of
+ * it. Cycles of flow control longer than RATE_MAX_CYCLE_MS are not from
+ * a saturated link and give no rate.
+ */
+static unsigned int bql_ms = 20;
+module_param(bql_ms, uint, S_IRUGO | S_IWUSR);
+#define RATE_MAX_CYCLE_MS	2000
+
 static void bcm_fuse_net_fc_cb(RPC_FlowCtrlEvent_t event, unsigned char cid);
 static RPC_Result_t bcm_fuse_net_bd_cb(PACKET_InterfaceType_t interfaceType,
 				       unsigned char cid,
@@ -254,6 +304,32 @@ static ssize_t bcm_fuse_net_proc_read(struct file *file, char __user *user_buf,
 		}
 	}
 
+	if (len < count) {
+		len += scnprintf(buf + len, count - len,
+			"\nuplink_kbps %u flow_stops %u stopped_ms %llu\n",
+			g_net_tx.rate / 125, g_net_tx.flow_stops,
+			div_u64(g_net_tx.stopped_ns, NSEC_PER_MSEC));
+		len += scnprintf(buf + len, count - len,
+			"queue_delay_us avg %u max %u queued %u hwm %lu\n",
+			g_net_tx.delay_avg >> 3, g_net_tx.delay_max,
+			skb_queue_len(&g_net_tx.queue),
+			g_net_tx.high_water_mark);
+	}
+#ifdef CONFIG_BQL
+	for (i = 0; i < BCM_NET_MAX_PDP_CNTXS && len < count; i++) {
+		struct dql *dql;
+
+		if (g_net_dev_tbl[i].entry_stat != EInUse)
+			continue;
+		dql = &netdev_get_tx_queue(g_net_dev_tbl[i].dev_ptr, 0)->dql;
+		len += scnprintf(buf + len, count - len,
+				 "%s bql limit %u inflight %u max %u\n",
+				 g_net_dev_tbl[i].dev_ptr->name, dql->limit,
+				 dql->num_queued - dql->num_completed,
+				 dql->limit_max);
+	}
+#endif
+
 	len = simple_read_from_buffer(user_buf, count, ppos, buf, len);
 
 	kfree(buf);
@@ -261,6 +337,63 @@ static ssize_t bcm_fuse_net_proc_read(struct file *file, char __user *user_buf,
 	return len;
 }
 
+/* cap the BQL limit of the open interfaces at bql_ms of the rate */
+static void bcm_fuse_net_bql_limit(void)
+{
+#ifdef CONFIG_BQL
+	unsigned int limit = DQL_MAX_LIMIT;
+	int i;
+
+	if (g_net_tx.rate && bql_ms)
+		limit = max_t(unsigned int, 2 * BCM_NET_MAX_DATA_LEN,
+			      div_u64((u64)g_net_tx.rate * bql_ms,
+				      MSEC_PER_SEC));
+
+	for (i = 0; i < BCM_NET_MAX_PDP_CNTXS; i++)
+		if (g_net_dev_tbl[i].entry_stat == EInUse)
+			netdev_get_tx_queue(g_net_dev_tbl[i].dev_ptr, 0)->
+				dql.limit_max = limit;
+#endif
+}
+
+/*
+ * While the uplink is saturated the CP stops and starts the flow as its
+ * pool fills and drains, so the bytes sent over one stop to stop cycle
+ * are what the link took in that time.
+ */
+static void bcm_fuse_net_rate_update(RPC_FlowCtrlEvent_t event)
+{
+	ktime_t now = ktime_get();
+	unsigned long bytes;
+	s64 ns;
+	u64 rate;
+
+	if (event == RPC_FLOW_START) {
+		if (g_net_tx.flow_stopped)
+			g_net_tx.stopped_ns += ktime_to_ns(ktime_sub(now,
+						g_net_tx.stopped_since));
+		return;
+	}
+	if (g_net_tx.flow_stopped)
+		return;
+
+	g_net_tx.flow_stops++;
+	g_net_tx.stopped_since = now;
+	bytes = ACCESS_ONCE(g_net_tx.sent_bytes) - g_net_tx.stop_bytes;
+	ns = ktime_to_ns(ktime_sub(now, g_net_tx.stop_time));
+	g_net_tx.stop_bytes += bytes;
+	g_net_tx.stop_time = now;
+
+	if (g_net_tx.flow_stops == 1 || ns <= 0 ||
+	    ns > (s64)RATE_MAX_CYCLE_MS * NSEC_PER_MSEC)
+		return;
+	rate = div64_u64((u64)bytes * NSEC_PER_SEC, ns);
+	if (g_net_tx.rate)
+		rate = (7 * (u64)g_net_tx.rate + rate) >> 3;
+	g_net_tx.rate = min_t(u64, rate, UINT_MAX);
+	bcm_fuse_net_bql_limit();
+}
+
 /**
    @fn void bcm_fuse_net_fc_cb(RPC_FlowCtrlEvent_t event, unsigned char8 cid);
  */
@@ -301,6 +434,13 @@ static void bcm_fuse_net_fc_cb(RPC_FlowCtrlEvent_t event, unsigned char cid)
 		return;
 	}
 
+	bcm_fuse_net_rate_update(event);
+
+	/* tx_work holds the queued packets while the CP is flow stopped */
+	g_net_tx.flow_stopped = (event == RPC_FLOW_STOP);
+	if (event == RPC_FLOW_START && skb_queue_len(&g_net_tx.queue))
+		queue_work(g_net_tx.wq, &g_net_tx.work);
+
 	for (i = 0; i < BCM_NET_MAX_PDP_CNTXS; i++) {
 		if (g_net_dev_tbl[i].entry_stat == EInUse) {
 			dev_ptr = g_net_dev_tbl[i].dev_ptr;
@@ -334,17 +474,11 @@ static RPC_Result_t bcm_fuse_net_bd_cb(PACKET_InterfaceType_t interfaceType,
 				       unsigned char cid,
 				       PACKET_BufHandle_t dataBufHandle)
 {
-	unsigned long data_len = 0;
-	struct sk_buff *skb = NULL;
-	unsigned char *data_ptr = NULL;
+	unsigned long flags;
 	net_drvr_info_t *ndrvr_info_ptr = NULL;
 
 	/* BNET_DEBUG(DBG_INFO,"%s: receive packet\n", __FUNCTION__); */
 
-	data_len = RPC_PACKET_GetBufferLength(dataBufHandle);
-
-	/* BNET_DEBUG(DBG_INFO,"%s: RECVD Buffer Delivery on AP Packet channel, cid[%d] size[%d]!!\n", __FUNCTION__, cid, data_len); */
-
 	/* ndrvr_info_ptr = &g_net_dev_tbl[0]; */
 	ndrvr_info_ptr = bcm_fuse_net_device_pdp_lookup(cid);
 	if (ndrvr_info_ptr == NULL) {
@@ -356,23 +490,88 @@ static RPC_Result_t bcm_fuse_net_bd_cb(PACKET_InterfaceType_t interfaceType,
 		return RPC_RESULT_ERROR;
 	}
 
-	skb = dev_alloc_skb(data_len);
+	/*
+	 * Called from the IPC tasklet. The buffer is kept and handed to
+	 * NAPI, which copies it out and frees it from its poll, so the
+	 * stack takes the downlink in batches and through GRO.
+	 */
+	spin_lock_irqsave(&ndrvr_info_ptr->rx_lock, flags);
+	if (ndrvr_info_ptr->rx_head - ndrvr_info_ptr->rx_tail >=
+	    BCM_NET_RX_RING_SIZE) {
+		spin_unlock_irqrestore(&ndrvr_info_ptr->rx_lock, flags);
+		ndrvr_info_ptr->stats.rx_dropped++;
+		return RPC_RESULT_ERROR;
+	}
+	ndrvr_info_ptr->rx_ring[ndrvr_info_ptr->rx_head++ &
+				(BCM_NET_RX_RING_SIZE - 1)] = dataBufHandle;
+	spin_unlock_irqrestore(&ndrvr_info_ptr->rx_lock, flags);
+
+	napi_schedule(&ndrvr_info_ptr->napi);
+
+	return RPC_RESULT_PENDING;
+}
+
+static PACKET_BufHandle_t bcm_fuse_net_rx_pop(net_drvr_info_t *ndrvr_info_ptr)
+{
+	PACKET_BufHandle_t buffer = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ndrvr_info_ptr->rx_lock, flags);
+	if (ndrvr_info_ptr->rx_tail != ndrvr_info_ptr->rx_head)
+		buffer = ndrvr_info_ptr->rx_ring[ndrvr_info_ptr->rx_tail++ &
+						 (BCM_NET_RX_RING_SIZE - 1)];
+	spin_unlock_irqrestore(&ndrvr_info_ptr->rx_lock, flags);
+
+	return buffer;
+}
+
+/* free the downlink buffers NAPI has not taken yet */
+static void bcm_fuse_net_rx_purge(net_drvr_info_t *ndrvr_info_ptr)
+{
+	PACKET_BufHandle_t buffer;
+
+	while ((buffer = bcm_fuse_net_rx_pop(ndrvr_info_ptr)) != NULL) {
+		RPC_PACKET_FreeBuffer(buffer);
+		ndrvr_info_ptr->stats.rx_dropped++;
+	}
+}
+
+static struct sk_buff *bcm_fuse_net_rx_skb(net_drvr_info_t *ndrvr_info_ptr,
+					   PACKET_BufHandle_t dataBufHandle)
+{
+	unsigned long data_len = 0;
+	struct sk_buff *skb = NULL;
+	unsigned char *data_ptr = NULL;
+
+	data_len = RPC_PACKET_GetBufferLength(dataBufHandle);
+
+	/* BNET_DEBUG(DBG_INFO,"%s: RECVD Buffer Delivery on AP Packet channel, size[%d]!!\n", __FUNCTION__, data_len); */
+
+	skb = netdev_alloc_skb(ndrvr_info_ptr->dev_ptr, data_len);
 	if (skb == NULL) {
 		if (printk_ratelimit())
 			BNET_DEBUG(DBG_ERROR,
-				   "%s: dev_alloc_skb() failed - packet dropped\n",
+				   "%s: netdev_alloc_skb() failed - packet dropped\n",
 				   __FUNCTION__);
 
+		RPC_PACKET_FreeBuffer(dataBufHandle);
 		ndrvr_info_ptr->stats.rx_dropped++;
-		return RPC_RESULT_ERROR;
+		return NULL;
 	}
 
+	/*
+	 * The IPC pools are in the uncached shared memory mapping, which
+	 * has no struct page behind it and cannot be attached to the skb
+	 * as a fragment: copy, and give the buffer back to the CP at once.
+	 */
 	data_ptr = (unsigned char *)RPC_PACKET_GetBufferData(dataBufHandle);
 	memcpy(skb_put(skb, data_len), data_ptr, data_len);
+	RPC_PACKET_FreeBuffer(dataBufHandle);
+	data_ptr = skb->data;
 
-	skb->dev = ndrvr_info_ptr->dev_ptr;
 	/*skb->ip_summed = CHECKSUM_UNNECESSARY;*/	/* don't check it */
 	skb->pkt_type = PACKET_HOST;
+	skb_reset_network_header(skb);
 	ndrvr_info_ptr->dev_ptr->last_rx = jiffies;
 
 	ndrvr_info_ptr->stats.rx_packets++;
@@ -392,9 +591,35 @@ static RPC_Result_t bcm_fuse_net_bd_cb(PACKET_InterfaceType_t interfaceType,
 	BNET_DEBUG(DBG_TRACE, "%s: rx_bytes:%ld\n", __FUNCTION__,
 		   ndrvr_info_ptr->stats.rx_bytes);
 
-	netif_rx(skb);
+	return skb;
+}
+
+static int bcm_fuse_net_poll(struct napi_struct *napi, int budget)
+{
+	net_drvr_info_t *ndrvr_info_ptr =
+		container_of(napi, net_drvr_info_t, napi);
+	PACKET_BufHandle_t buffer;
+	struct sk_buff *skb;
+	int done = 0;
+
+	while (done < budget) {
+		buffer = bcm_fuse_net_rx_pop(ndrvr_info_ptr);
+		if (buffer == NULL)
+			break;
+		skb = bcm_fuse_net_rx_skb(ndrvr_info_ptr, buffer);
+		if (skb)
+			napi_gro_receive(napi, skb);
+		done++;
+	}
+
+	if (done < budget) {
+		napi_complete(napi);
+		/* a buffer queued while completing would not reschedule us */
+		if (ndrvr_info_ptr->rx_tail != ndrvr_info_ptr->rx_head)
+			napi_reschedule(napi);
+	}
 
-	return RPC_RESULT_OK;
+	return done;
 }
 
 /* callback for CP silent reset events */
@@ -420,6 +645,8 @@ void bcm_fuse_net_cp_reset_cb(
 			if (g_net_dev_tbl[i].entry_stat == EInUse) {
 				dev_ptr = g_net_dev_tbl[i].dev_ptr;
 				netif_stop_queue(dev_ptr);
+				/* the pools are reset with the CP */
+				bcm_fuse_net_rx_purge(&g_net_dev_tbl[i]);
 				BNET_DEBUG(DBG_INFO,
 					"stopping interface %d\n", i);
 			}
@@ -514,19 +741,44 @@ static int bcm_fuse_net_open(struct net_device *dev)
 		   "%s: BCM_FUSE_NET_ACTIVATE_PDP: rmnet[%d] pdp_info.cid=%d, jin hack 1\n",
 		   __FUNCTION__, idx, g_net_dev_tbl[idx].pdp_context_id);
 
+	napi_enable(&g_net_dev_tbl[idx].napi);
+	netdev_tx_reset_queue(netdev_get_tx_queue(dev, 0));
+	bcm_fuse_net_bql_limit();
 	netif_start_queue(dev);
 
 	return 0;
 }
 
+/* drop the uplink packets of dev still queued for tx_work */
+static void bcm_fuse_net_tx_purge(struct net_device *dev)
+{
+	struct sk_buff *skb, *tmp;
+	struct sk_buff_head drop;
+	unsigned long flags;
+
+	__skb_queue_head_init(&drop);
+	spin_lock_irqsave(&g_net_tx.queue.lock, flags);
+	skb_queue_walk_safe(&g_net_tx.queue, skb, tmp) {
+		if (GET_NETDEV_IN_SKB_CB(skb) != dev)
+			continue;
+		__skb_unlink(skb, &g_net_tx.queue);
+		__skb_queue_tail(&drop, skb);
+	}
+	spin_unlock_irqrestore(&g_net_tx.queue.lock, flags);
+	__skb_queue_purge(&drop);
+}
+
 static int bcm_fuse_net_stop(struct net_device *dev)
 {
 	int i;
 	BNET_DEBUG(DBG_INFO, "%s: <<\n", __FUNCTION__);
 	for (i = 0; i < BCM_NET_MAX_PDP_CNTXS; i++) {
 		if (g_net_dev_tbl[i].dev_ptr == dev) {
+			napi_disable(&g_net_dev_tbl[i].napi);
 			bcm_fuse_net_free_entry(g_net_dev_tbl[i].
 						pdp_context_id);
+			/* no more deliveries once the cid is unmapped */
+			bcm_fuse_net_rx_purge(&g_net_dev_tbl[i]);
 			BNET_DEBUG(DBG_INFO,
 				   "%s: free g_net_dev_tbl[%d].cid:%d\n",
 				   __FUNCTION__, i,
@@ -535,6 +787,11 @@ static int bcm_fuse_net_stop(struct net_device *dev)
 		}
 	}
 	netif_stop_queue(dev);
+
+	/* BQL restarts from nothing queued */
+	bcm_fuse_net_tx_purge(dev);
+	flush_workqueue(g_net_tx.wq);
+	netdev_tx_reset_queue(netdev_get_tx_queue(dev, 0));
 	return 0;
 }
 
@@ -605,7 +862,10 @@ static int __bcm_fuse_net_tx(struct sk_buff *skb, struct net_device *dev)
 		return -ENOBUFS;
 	}
 
-	memset(buff_data_ptr, 0, BCM_NET_MAX_DATA_LEN);
+	/*
+	 * The CP only reads the length set below, so the rest of the
+	 * uncached buffer is left alone.
+	 */
 	memcpy(buff_data_ptr, skb->data, skb->len);
 
 	RPC_PACKET_SetBufferLength(buffer, skb->len);
@@ -628,16 +888,54 @@ static int __bcm_fuse_net_tx(struct sk_buff *skb, struct net_device *dev)
 	return 0;
 }
 
+/* reopen the upper layer once the CP and our queue have room again */
+static void bcm_fuse_net_tx_wake(void)
+{
+	struct net_device *dev_ptr;
+	int i;
+
+	if (g_net_tx.flow_stopped ||
+	    skb_queue_len(&g_net_tx.queue) >= QUEUE_MAX_SIZE / 2)
+		return;
+
+	for (i = 0; i < BCM_NET_MAX_PDP_CNTXS; i++) {
+		if (g_net_dev_tbl[i].entry_stat != EInUse)
+			continue;
+		dev_ptr = g_net_dev_tbl[i].dev_ptr;
+		if (netif_queue_stopped(dev_ptr)) {
+			BNET_DEBUG(DBG_TRACE, "Wake uper layer tx\n");
+			netif_wake_queue(dev_ptr);
+		}
+	}
+}
+
+static void bcm_fuse_net_tx_delay(struct sk_buff *skb)
+{
+	unsigned int us = ktime_us_delta(ktime_get(), SKB_CB_TX_TIME(skb));
+
+	if (!g_net_tx.delay_avg)
+		g_net_tx.delay_avg = us << 3;
+	else
+		g_net_tx.delay_avg += us - (g_net_tx.delay_avg >> 3);
+	if (us > g_net_tx.delay_max)
+		g_net_tx.delay_max = us;
+}
+
 static void tx_work(struct work_struct *work)
 {
 	struct net_device *dev = NULL;
 	struct sk_buff *skb;
-	int i;
+	unsigned int len;
+	int i, ret;
 
-	while ((skb = skb_dequeue(&g_net_tx.queue))) {
+	while (!g_net_tx.flow_stopped &&
+	       (skb = skb_dequeue(&g_net_tx.queue))) {
 		dev = GET_NETDEV_IN_SKB_CB(skb);
+		len = skb->len;
+		bcm_fuse_net_tx_delay(skb);
 		for (i = 0; i < 2; i++) {
-			if (__bcm_fuse_net_tx(skb, dev) == -ENOBUFS) {
+			ret = __bcm_fuse_net_tx(skb, dev);
+			if (ret == -ENOBUFS) {
 				BNET_DEBUG(DBG_ERROR,
 				"No AP-CP shared buffer, try again\n");
 				msleep(32);
@@ -645,12 +943,21 @@ static void tx_work(struct work_struct *work)
 			}
 			break;
 		}
+		/* __bcm_fuse_net_tx only consumes the skb on success */
+		if (ret)
+			dev_kfree_skb(skb);
+		else
+			g_net_tx.sent_bytes += len;
+		netdev_tx_completed_queue(netdev_get_tx_queue(dev, 0), 1, len);
 	}
 
-	if (dev && netif_queue_stopped(dev)) {
-		BNET_DEBUG(DBG_ERROR, "Wake uper layer tx\n");
-		netif_wake_queue(dev);
-	}
+	bcm_fuse_net_tx_wake();
+}
+
+static enum hrtimer_restart tx_batch_timer(struct hrtimer *timer)
+{
+	queue_work(g_net_tx.wq, &g_net_tx.work);
+	return HRTIMER_NORESTART;
 }
 
 static int bcm_fuse_net_tx(struct sk_buff *skb, struct net_device *dev)
@@ -665,6 +972,9 @@ static int bcm_fuse_net_tx(struct sk_buff *skb, struct net_device *dev)
 	}
 
 	PUT_NETDEV_IN_SKB_CB(skb, dev);
+	SKB_CB_TX_TIME(skb) = ktime_get();
+	/* before tx_work can complete it */
+	netdev_tx_sent_queue(netdev_get_tx_queue(dev, 0), skb->len);
 	skb_queue_tail(&g_net_tx.queue, skb);
 	qlen = skb_queue_len(&g_net_tx.queue);
 	if (qlen > g_net_tx.high_water_mark) {
@@ -672,7 +982,16 @@ static int bcm_fuse_net_tx(struct sk_buff *skb, struct net_device *dev)
 		BNET_DEBUG(DBG_ERROR,
 		"Update qlen high water mark: %u\n", qlen);
 	}
-	queue_work(g_net_tx.wq, &g_net_tx.work);
+
+	if (!tx_batch_us || qlen >= tx_batch_pkts) {
+		hrtimer_try_to_cancel(&g_net_tx.timer);
+		queue_work(g_net_tx.wq, &g_net_tx.work);
+	} else if (!hrtimer_active(&g_net_tx.timer)) {
+		/* the first packet of a batch sets its deadline */
+		hrtimer_start(&g_net_tx.timer,
+			      ktime_set(0, tx_batch_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	}
 
 	return NETDEV_TX_OK;
 }
@@ -815,6 +1134,12 @@ static int bcm_fuse_net_attach(unsigned int dev_index)
 
 	spin_unlock_irqrestore(&g_dev_lock, flags);
 
+	spin_lock_init(&g_net_dev_tbl[dev_index].rx_lock);
+	g_net_dev_tbl[dev_index].rx_head = 0;
+	g_net_dev_tbl[dev_index].rx_tail = 0;
+	netif_napi_add(dev_ptr, &g_net_dev_tbl[dev_index].napi,
+		       bcm_fuse_net_poll, BCM_NET_NAPI_WEIGHT);
+
 	ret = register_netdev(dev_ptr);
 	if (ret != 0) {
 		BNET_DEBUG(DBG_ERROR,
@@ -823,9 +1148,7 @@ static int bcm_fuse_net_attach(unsigned int dev_index)
 
 		/*error recovery, do clean up*/
 		spin_lock_irqsave(&g_dev_lock, flags);
-#ifdef FUSE_NET_NAPI
-		netif_napi_del(&(g_net_dev_tbl[dev_index].rx_napi.napiInfo));
-#endif
+		netif_napi_del(&g_net_dev_tbl[dev_index].napi);
 		memset(&g_net_dev_tbl[dev_index], 0, sizeof(net_drvr_info_t));
 		spin_unlock_irqrestore(&g_dev_lock, flags);
 		return -1;
@@ -851,6 +1174,7 @@ static int bcm_fuse_net_deattach(unsigned int dev_index)
 	spin_lock_irqsave(&g_dev_lock, flags);
 
 	unregister_netdev(g_net_dev_tbl[dev_index].dev_ptr);
+	netif_napi_del(&g_net_dev_tbl[dev_index].napi);
 	free_netdev(g_net_dev_tbl[dev_index].dev_ptr);
 
 	/* Reset most entries except for the buffer pool */
@@ -1355,6 +1679,8 @@ static int __init bcm_fuse_net_init_module(void)
 		return -ENOMEM;
 	}
 	INIT_WORK(&g_net_tx.work, tx_work);
+	hrtimer_init(&g_net_tx.timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	g_net_tx.timer.function = tx_batch_timer;
 	skb_queue_head_init(&g_net_tx.queue);
 
 	return 0;
@@ -1381,6 +1707,7 @@ static void __exit bcm_fuse_net_exit_module(void)
 #endif
 #endif
 
+	hrtimer_cancel(&g_net_tx.timer);
 	skb_queue_purge(&g_net_tx.queue);
 	flush_workqueue(g_net_tx.wq);
 	destroy_workqueue(g_net_tx.wq);
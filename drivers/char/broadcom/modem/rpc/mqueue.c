@@ -36,6 +36,7 @@
 #include <linux/fcntl.h>
 #include <asm/system.h>
 #include <linux/kthread.h>
+#include <linux/ktime.h>
 #if defined(CONFIG_HAS_WAKELOCK) && defined(MQUEUE_RPC_WAKELOCK)
 #include <linux/wakelock.h>
 #endif
@@ -60,6 +61,10 @@
 #endif
 
 #define INVALID_HANDLE(a) (!(a) || !(a->valid))
+#define MQ_RING_MASK (MQ_RING_SIZE - 1)
+/* each latency sample weighs 1/8 of the average */
+#define MQ_LAT_SHIFT 3
+
 static int MQueueKthreadFn(void *param);
 
 int MsgQueueInit(MsgQueueHandle_t *mHandle, MsgQueueThreadFn_t fn,
@@ -106,6 +111,11 @@ int MsgQueueInit(MsgQueueHandle_t *mHandle, MsgQueueThreadFn_t fn,
 int MsgQueueAdd(MsgQueueHandle_t *mHandle, void *data)
 {
 	MsgQueueElement_t *elem;
+	MsgQueueSlot_t *slot;
+	unsigned long flags;
+	unsigned int depth;
+	ktime_t now = ktime_get();
+	int wake;
 
 	if (INVALID_HANDLE(mHandle)) {
 		_DBG(MQ_TRACE
@@ -114,30 +124,112 @@ int MsgQueueAdd(MsgQueueHandle_t *mHandle, void *data)
 		return -1;
 	}
 
-	elem = kmalloc(sizeof(MsgQueueElement_t),
-			in_interrupt() ? GFP_ATOMIC : GFP_KERNEL);
-	if (!elem) {
-		_DBG(MQ_TRACE
-		     ("mq: MsgQueueAdd kmalloc failed interrupt_context=%d\n",
-		      (int)in_interrupt()));
-		return -1;
+	spin_lock_irqsave(&mHandle->mLock, flags);
+	depth = mHandle->mTail - mHandle->mHead;
+	if (depth < MQ_RING_SIZE && !mHandle->mOverflowCount) {
+		slot = &mHandle->mRing[mHandle->mTail & MQ_RING_MASK];
+		slot->data = data;
+		slot->t = now;
+		/* the slot is written before the consumers can see it */
+		smp_wmb();
+		mHandle->mTail++;
+	} else {
+		elem = kmalloc(sizeof(MsgQueueElement_t), GFP_ATOMIC);
+		if (!elem) {
+			spin_unlock_irqrestore(&mHandle->mLock, flags);
+			_DBG(MQ_TRACE("mq: MsgQueueAdd kmalloc failed\n"));
+			return -1;
+		}
+		elem->data = data;
+		elem->t = now;
+		list_add_tail(&elem->mList, &mHandle->mList);
+		mHandle->mOverflowCount++;
+		mHandle->mOverflows++;
 	}
-	elem->data = data;
+	depth = mHandle->mTail - mHandle->mHead + mHandle->mOverflowCount;
+	if (depth > mHandle->mHighWater)
+		mHandle->mHighWater = depth;
+	mHandle->mAdded++;
 
-	/*add to queue */
-	spin_lock_bh(&mHandle->mLock);
-	list_add_tail(&elem->mList, &mHandle->mList);
+	/* a consumer that has not found the queue empty needs no wakeup */
+	wake = !mHandle->mAvailData;
 	mHandle->mAvailData = 1;
-	spin_unlock_bh(&mHandle->mLock);
+	if (wake)
+		mHandle->mWakeups++;
+	spin_unlock_irqrestore(&mHandle->mLock, flags);
 
 	_DBG(MQ_TRACE("mq: MsgQueueAdd mHandle=%x, data=%d\n",
 		      (int)mHandle, (int)data));
 
-	wake_up_interruptible(&mHandle->mWaitQ);
+	if (wake)
+		wake_up_interruptible(&mHandle->mWaitQ);
 
 	return 0;
 }
 
+static void MQueueLatency(MsgQueueHandle_t *mHandle, ktime_t t)
+{
+	u32 us = (u32)ktime_us_delta(ktime_get(), t);
+
+	/* not exact when MsgQueueGet races with the kthread */
+	if (us > mHandle->mLatMax)
+		mHandle->mLatMax = us;
+	if (mHandle->mLatAvg)
+		mHandle->mLatAvg += us - (mHandle->mLatAvg >> MQ_LAT_SHIFT);
+	else
+		mHandle->mLatAvg = us << MQ_LAT_SHIFT;
+}
+
+/* Take the oldest element. Returns 0 when the queue is empty, and then
+ * the next MsgQueueAdd wakes up the waiters. */
+static int MQueueTake(MsgQueueHandle_t *mHandle, void **outData)
+{
+	MsgQueueElement_t *elem;
+	MsgQueueSlot_t *slot;
+	unsigned long flags;
+	unsigned int head;
+	void *data;
+	ktime_t t;
+
+	while (1) {
+		head = ACCESS_ONCE(mHandle->mHead);
+		if (head != ACCESS_ONCE(mHandle->mTail)) {
+			smp_rmb();
+			slot = &mHandle->mRing[head & MQ_RING_MASK];
+			data = slot->data;
+			t = slot->t;
+			/* moving head gives the slot back to the producers,
+			 * fails if another consumer took it first */
+			if (cmpxchg(&mHandle->mHead, head, head + 1) != head)
+				continue;
+			MQueueLatency(mHandle, t);
+			*outData = data;
+			return 1;
+		}
+
+		spin_lock_irqsave(&mHandle->mLock, flags);
+		if (mHandle->mHead != mHandle->mTail) {
+			spin_unlock_irqrestore(&mHandle->mLock, flags);
+			continue;
+		}
+		if (list_empty(&mHandle->mList)) {
+			mHandle->mAvailData = 0;
+			spin_unlock_irqrestore(&mHandle->mLock, flags);
+			return 0;
+		}
+		elem = list_first_entry(&mHandle->mList,
+					MsgQueueElement_t, mList);
+		list_del(&elem->mList);
+		mHandle->mOverflowCount--;
+		spin_unlock_irqrestore(&mHandle->mLock, flags);
+
+		MQueueLatency(mHandle, elem->t);
+		*outData = elem->data;
+		kfree(elem);
+		return 1;
+	}
+}
+
 int MsgQueueIsEmpty(MsgQueueHandle_t *mHandle)
 {
 	int isEmpty = 1;
@@ -146,9 +238,8 @@ int MsgQueueIsEmpty(MsgQueueHandle_t *mHandle)
 		_DBG(MQ_TRACE("mq: MsgQueueIsEmpty has Invalid mHandle\n"));
 		return -1;
 	}
-	spin_lock_bh(&mHandle->mLock);
-	isEmpty = (Boolean) list_empty(&mHandle->mList);
-	spin_unlock_bh(&mHandle->mLock);
+	isEmpty = ACCESS_ONCE(mHandle->mHead) == ACCESS_ONCE(mHandle->mTail) &&
+		!ACCESS_ONCE(mHandle->mOverflowCount);
 
 	_DBG(MQ_TRACE("mq: MsgQueueIsEmpty mHandle=%x, isEmpty=%d\n",
 		      (int)mHandle, (int)isEmpty));
@@ -158,10 +249,7 @@ int MsgQueueIsEmpty(MsgQueueHandle_t *mHandle)
 
 int MsgQueueRemove(MsgQueueHandle_t *mHandle, void **outData)
 {
-	struct list_head *entry;
-	MsgQueueElement_t *Item = NULL;
 	void *data = NULL;
-	int isEmpty = 1;
 
 	if (INVALID_HANDLE(mHandle)) {
 		_DBG(MQ_TRACE("mq: MsgQueueRemove has Invalid mHandle\n"));
@@ -175,29 +263,9 @@ int MsgQueueRemove(MsgQueueHandle_t *mHandle, void **outData)
 		return -1;
 	}
 
-	while (1) {
-		spin_lock_bh(&mHandle->mLock);
-		isEmpty = (Boolean)list_empty(&mHandle->mList);
-
-		if (isEmpty) {
-			mHandle->mAvailData = 0;
-			spin_unlock_bh(&mHandle->mLock);
-			wait_event_interruptible(mHandle->mWaitQ,
-						 mHandle->mAvailData);
-		} else {
-			entry = mHandle->mList.next;
-			Item = list_entry(entry, MsgQueueElement_t, mList);
-			data = Item->data;
-
-			list_del(entry);
-			spin_unlock_bh(&mHandle->mLock);
-
-			kfree(Item);
-
-			*outData = data;
-			break;
-		}
-	}
+	while (!MQueueTake(mHandle, &data))
+		wait_event_interruptible(mHandle->mWaitQ, mHandle->mAvailData);
+	*outData = data;
 
 	_DBG(MQ_TRACE("mq: MsgQueueRemove mHandle=%x, data=%d\n",
 		      (int)mHandle, (int)data));
@@ -208,72 +276,67 @@ int MsgQueueRemove(MsgQueueHandle_t *mHandle, void **outData)
 int MsgQueueDebugList(MsgQueueHandle_t *mHandle, RpcOutputContext_t *c)
 {
 	MsgQueueElement_t *Item = NULL;
-	struct list_head *listptr, *pos;
+	unsigned long flags;
+	unsigned int i;
 
 	if (INVALID_HANDLE(mHandle)) {
 		_DBG(MQ_TRACE("mq: MsgQueueDebugList has Invalid mHandle\n"));
 		return 0;
 	}
 
-	spin_lock_bh(&mHandle->mLock);
-
 	RpcDbgDumpStr(c,  "\tkThread: %s tid:%d Rx:%d\n",
 					mHandle->name, mHandle->mThread->pid, mHandle->mAvailData);
 
 	RpcDumpTaskCallStack(c, mHandle->mThread);
 
-	list_for_each_safe(listptr, pos, &mHandle->mList)
-	{
-		Item = list_entry(listptr, MsgQueueElement_t, mList);
+	spin_lock_irqsave(&mHandle->mLock, flags);
+
+	RpcDbgDumpStr(c, "\tadded:%u wakeups:%u high:%u overflow:%u "
+		      "latency avg:%uus max:%uus\n",
+		      mHandle->mAdded, mHandle->mWakeups, mHandle->mHighWater,
+		      mHandle->mOverflows, mHandle->mLatAvg >> MQ_LAT_SHIFT,
+		      mHandle->mLatMax);
+
+	for (i = mHandle->mHead; i != mHandle->mTail; i++)
+		RpcDbgDumpStr(c,  "\tQUEUED pkt:%d\n",
+			      (int)mHandle->mRing[i & MQ_RING_MASK].data);
+
+	list_for_each_entry(Item, &mHandle->mList, mList)
 		RpcDbgDumpStr(c,  "\tQUEUED pkt:%d\n",
 					(int)Item->data);
-	}
 
-	spin_unlock_bh(&mHandle->mLock);
+	spin_unlock_irqrestore(&mHandle->mLock, flags);
 
 	return 0;
 }
 
 int MsgQueueCount(MsgQueueHandle_t *mHandle)
 {
-	int count = 0;
-	struct list_head *pos;
+	int count;
+	unsigned long flags;
+
 	if (INVALID_HANDLE(mHandle)) {
 		_DBG(MQ_TRACE("mq: MsgQueueDebugList has Invalid mHandle\n"));
 		return -1;
 	}
 
-	spin_lock_bh(&mHandle->mLock);
-	list_for_each(pos, &mHandle->mList) count++;
-	spin_unlock_bh(&mHandle->mLock);
+	spin_lock_irqsave(&mHandle->mLock, flags);
+	count = mHandle->mTail - mHandle->mHead + mHandle->mOverflowCount;
+	spin_unlock_irqrestore(&mHandle->mLock, flags);
 	return count;
 }
 
 void *MsgQueueGet(MsgQueueHandle_t *mHandle)
 {
-	struct list_head *entry;
-	MsgQueueElement_t *Item = NULL;
 	void *data = NULL;
-	int isEmpty = 1;
+
 	if (INVALID_HANDLE(mHandle)) {
 		_DBG(MQ_TRACE("mq: MsgQueueGet has Invalid mHandle\n"));
 		return NULL;
 	}
 
-	spin_lock_bh(&mHandle->mLock);
-	isEmpty = (Boolean)list_empty(&mHandle->mList);
-	if (isEmpty) {
-		mHandle->mAvailData = 0;
-		spin_unlock_bh(&mHandle->mLock);
+	if (!MQueueTake(mHandle, &data))
 		return NULL;
-	}
-
-	entry = mHandle->mList.next;
-	Item = list_entry(entry, MsgQueueElement_t, mList);
-	data = Item->data;
-	list_del(entry);
-	spin_unlock_bh(&mHandle->mLock);
-	kfree(Item);
 	_DBG(MQ_TRACE("mq: MsgQueueGet mHandle=%x, data=%d\n",
 		      (int)mHandle, (int)data));
 	return data;
@@ -16,13 +16,28 @@
 #ifndef __MQUEUE_H
 #define __MQUEUE_H
 
+#include <linux/ktime.h>
+
 struct tag_MsgQueueHandle_t;
 #define MAX_NM_LEN 64
+/* elements queued without allocation, a power of 2 */
+#define MQ_RING_SIZE 64
 
 typedef int (*MsgQueueThreadFn_t) (struct tag_MsgQueueHandle_t *mHandle,
 				   void *data);
 
+typedef struct {
+	void *data;
+	ktime_t t;
+} MsgQueueSlot_t;
+
 typedef struct tag_MsgQueueHandle_t {
+	/* filled under mLock, taken lock free; mList is the overflow of a
+	 * full ring, and once used takes the new elements until drained */
+	MsgQueueSlot_t mRing[MQ_RING_SIZE];
+	unsigned int mHead;
+	unsigned int mTail;
+	unsigned int mOverflowCount;
 	struct list_head mList;
 	spinlock_t mLock;
 	wait_queue_head_t mWaitQ;
@@ -31,6 +46,13 @@ typedef struct tag_MsgQueueHandle_t {
 	MsgQueueThreadFn_t mFn;
 	int valid;
 	char name[MAX_NM_LEN+1];
+	/* stats for MsgQueueDebugList */
+	unsigned int mAdded;
+	unsigned int mWakeups;
+	unsigned int mOverflows;
+	unsigned int mHighWater;
+	unsigned int mLatAvg;	/* us << MQ_LAT_SHIFT */
+	unsigned int mLatMax;	/* us */
 #if defined(CONFIG_HAS_WAKELOCK) && defined(MQUEUE_RPC_WAKELOCK)
 	struct wake_lock mq_wake_lock;
 #endif
@@ -39,6 +61,7 @@ typedef struct tag_MsgQueueHandle_t {
 typedef struct {
 	struct list_head mList;
 	void *data;
+	ktime_t t;
 } MsgQueueElement_t;
 
 int MsgQueueInit(MsgQueueHandle_t *mHandle, MsgQueueThreadFn_t fn, char *name,
@@ -31,6 +31,16 @@ the GPL, without Broadcom's express prior written consent.
 #include <linux/mm.h>
 #include <linux/gpio.h>
 #include <linux/delay.h>
+#include <linux/spinlock.h>
+#include <linux/wait.h>
+#include <linux/poll.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
+#include <linux/file.h>
+#ifdef CONFIG_HAWAII_MM
+#include <linux/broadcom/mm_fw_hw_ifc.h>
+#endif
 
 #include <linux/broadcom/unicam.h>
 #include <mach/rdb/brcm_rdb_sysmap.h>
@@ -68,11 +78,62 @@ static struct pi_mgr_dfs_node unicam_dfs_node = {
 };
 static struct pi_mgr_qos_node unicam_qos_node;
 
+/*
+ * Capture queue: buffers queued with UNICAM_IOCTL_QBUF wait in queued[],
+ * one of them is on the receiver (active) and filled ones wait in done[]
+ * for UNICAM_IOCTL_DQBUF. At each frame end the isr moves the active
+ * buffer to done[] and points the receiver at the next queued one, so
+ * user space never has to reprogram the receiver between frames. With
+ * nothing queued the receiver keeps writing the active buffer and the
+ * frame is counted as dropped.
+ */
+struct unicam_ring {
+	unicam_buf_t queued[UNICAM_MAX_BUFFERS];
+	unsigned int q_head;
+	unsigned int q_count;
+	unicam_frame_t done[UNICAM_MAX_BUFFERS];
+	unsigned int d_head;
+	unsigned int d_count;
+	unicam_buf_t active;
+	unsigned int inflight;	/* in the pipeline, counted as owned */
+	unsigned int streaming;
+	unsigned int sequence;
+	unsigned int dropped;
+};
+
+#ifdef CONFIG_HAWAII_MM
+struct unicam_pipe_job {
+	mm_job_type_e type;
+	uint32_t id;
+	uint32_t size;
+	void *data;
+};
+
+/* per buffer index; job data only changes while the slot is not busy */
+struct unicam_pipe_slot {
+	struct unicam *dev;
+	unicam_buf_t buf;
+	struct unicam_pipe_job isp;
+	struct unicam_pipe_job enc;
+	unsigned int busy;
+};
+#endif
+
 struct unicam {
 	struct completion irq_sem;
 	cam_isr_reg_status_st_t unicam_isr_reg_status;
 	unsigned int irq_pending;
 	unsigned int irq_start;
+	spinlock_t lock;	/* protects ring */
+	wait_queue_head_t done_wait;
+	struct unicam_ring ring;
+#ifdef CONFIG_HAWAII_MM
+	/* capture pipeline, see UNICAM_IOCTL_SET_PIPELINE */
+	struct file *isp_file;
+	struct file *enc_file;
+	struct work_struct pipe_work;
+	struct unicam_pipe_slot slots[UNICAM_MAX_BUFFERS];
+#endif
 };
 
 struct unicam_info {
@@ -96,6 +157,350 @@ static inline unsigned int reg_read(void __iomem *, unsigned int reg);
 static inline void reg_write(void __iomem *, unsigned int reg,
 			     unsigned int value);
 
+static void unicam_program_buffer(unicam_buf_t *buf)
+{
+	unsigned int value;
+
+	reg_write(unicam_base, CAM_IBSA_OFFSET, buf->addr);
+	reg_write(unicam_base, CAM_IBEA_OFFSET, buf->addr + buf->size);
+	reg_write(unicam_base, CAM_IBLS_OFFSET, buf->line_stride);
+	/* picked up by the receiver at the next frame start */
+	value = reg_read(unicam_base, CAM_ICTL_OFFSET);
+	reg_write(unicam_base, CAM_ICTL_OFFSET, value | CAM_ICTL_LIP_MASK);
+}
+
+static void unicam_frame_end(struct unicam *dev)
+{
+	struct unicam_ring *r = &dev->ring;
+	unicam_frame_t *frame;
+
+	spin_lock(&dev->lock);
+	if (!r->streaming) {
+		spin_unlock(&dev->lock);
+		return;
+	}
+
+	r->sequence++;
+	if (r->q_count == 0) {
+		r->dropped++;
+		spin_unlock(&dev->lock);
+		return;
+	}
+
+	/* done[] cannot overflow: every buffer in it came from queued[] */
+	frame = &r->done[(r->d_head + r->d_count) % UNICAM_MAX_BUFFERS];
+	frame->index = r->active.index;
+	frame->sequence = r->sequence;
+	frame->dropped = r->dropped;
+	frame->timestamp_ns = ktime_to_ns(ktime_get());
+	r->d_count++;
+	r->dropped = 0;
+
+	r->active = r->queued[r->q_head];
+	r->q_head = (r->q_head + 1) % UNICAM_MAX_BUFFERS;
+	r->q_count--;
+	unicam_program_buffer(&r->active);
+	spin_unlock(&dev->lock);
+
+#ifdef CONFIG_HAWAII_MM
+	if (dev->isp_file) {
+		schedule_work(&dev->pipe_work);
+		return;
+	}
+#endif
+	wake_up_interruptible(&dev->done_wait);
+}
+
+static int unicam_qbuf(struct unicam *dev, unicam_buf_t *buf)
+{
+	struct unicam_ring *r = &dev->ring;
+	unsigned long flags;
+	int ret = 0;
+
+	if (!buf->addr || !buf->size ||
+	    ((buf->addr | buf->size | buf->line_stride) & 0xf))
+		return -EINVAL;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (r->q_count + r->d_count + r->inflight + (r->streaming ? 1 : 0) >=
+	    UNICAM_MAX_BUFFERS) {
+		ret = -EBUSY;
+	} else {
+		r->queued[(r->q_head + r->q_count) % UNICAM_MAX_BUFFERS] =
+		    *buf;
+		r->q_count++;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return ret;
+}
+
+static int unicam_dqbuf(struct unicam *dev, unicam_frame_t *frame,
+			int nonblock)
+{
+	struct unicam_ring *r = &dev->ring;
+	unsigned long flags;
+	int ret;
+
+	for (;;) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (r->d_count) {
+			*frame = r->done[r->d_head];
+			r->d_head = (r->d_head + 1) % UNICAM_MAX_BUFFERS;
+			r->d_count--;
+			spin_unlock_irqrestore(&dev->lock, flags);
+			return 0;
+		}
+		ret = r->streaming ? 0 : -EINVAL;
+		spin_unlock_irqrestore(&dev->lock, flags);
+		if (ret)
+			return ret;
+		if (nonblock)
+			return -EAGAIN;
+		if (wait_event_interruptible(dev->done_wait,
+					     r->d_count || !r->streaming))
+			return -ERESTARTSYS;
+	}
+}
+
+static int unicam_streamon(struct unicam *dev)
+{
+	struct unicam_ring *r = &dev->ring;
+	unsigned long flags;
+	unsigned int value;
+	int ret = 0;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	if (r->streaming) {
+		ret = -EBUSY;
+	} else if (r->q_count == 0) {
+		ret = -EINVAL;
+	} else {
+		r->active = r->queued[r->q_head];
+		r->q_head = (r->q_head + 1) % UNICAM_MAX_BUFFERS;
+		r->q_count--;
+		r->sequence = 0;
+		r->dropped = 0;
+		r->streaming = 1;
+		unicam_program_buffer(&r->active);
+		value = reg_read(unicam_base, CAM_ICTL_OFFSET);
+		reg_write(unicam_base, CAM_ICTL_OFFSET,
+			  value | CAM_ICTL_FEIE_MASK);
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return ret;
+}
+
+static void unicam_streamoff(struct unicam *dev)
+{
+	struct unicam_ring *r = &dev->ring;
+	unsigned long flags;
+#ifdef CONFIG_HAWAII_MM
+	int i;
+
+	if (dev->isp_file) {
+		spin_lock_irqsave(&dev->lock, flags);
+		r->streaming = 0;
+		spin_unlock_irqrestore(&dev->lock, flags);
+		/* let the frames already captured through the isp */
+		flush_work(&dev->pipe_work);
+		vfs_fsync(dev->isp_file, 0);
+		for (i = 0; i < UNICAM_MAX_BUFFERS; i++)
+			dev->slots[i].busy = 0;
+	}
+#endif
+
+	/* every buffer goes back to user space, filled or not */
+	spin_lock_irqsave(&dev->lock, flags);
+	memset(r, 0, sizeof(*r));
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	wake_up_interruptible(&dev->done_wait);
+}
+
+#ifdef CONFIG_HAWAII_MM
+/* the isp has read the buffer, capture into it again */
+static void unicam_pipe_done(void *priv, mm_job_status_e status)
+{
+	struct unicam_pipe_slot *slot = priv;
+	struct unicam *dev = slot->dev;
+	struct unicam_ring *r = &dev->ring;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->lock, flags);
+	r->inflight--;
+	if (r->streaming) {
+		r->queued[(r->q_head + r->q_count) % UNICAM_MAX_BUFFERS] =
+		    slot->buf;
+		r->q_count++;
+	} else {
+		slot->busy = 0;
+	}
+	spin_unlock_irqrestore(&dev->lock, flags);
+}
+
+static int unicam_pipe_post(struct unicam *dev, struct unicam_pipe_slot *slot)
+{
+	int ret;
+
+	ret = mm_fmwk_post_job(dev->isp_file, slot->isp.type, slot->isp.id,
+			       slot->isp.data, slot->isp.size,
+			       unicam_pipe_done, slot);
+	if (ret)
+		return ret;
+	if (!slot->enc.type)
+		return 0;
+
+	/* the encoder job waits on the file for the isp job */
+	ret = mm_fmwk_post_interlock(dev->enc_file, dev->isp_file);
+	if (!ret)
+		ret = mm_fmwk_post_job(dev->enc_file, slot->enc.type,
+				       slot->enc.id, slot->enc.data,
+				       slot->enc.size, NULL, NULL);
+	if (ret)
+		dev_err(unicam_info.dev, "%s: encoder job for buffer %u: %d\n",
+			__func__, slot->buf.index, ret);
+	return 0;
+}
+
+static void unicam_pipe_work(struct work_struct *work)
+{
+	struct unicam *dev = container_of(work, struct unicam, pipe_work);
+	struct unicam_ring *r = &dev->ring;
+	struct unicam_pipe_slot *slot;
+	unsigned long flags;
+	int ret;
+
+	for (;;) {
+		spin_lock_irqsave(&dev->lock, flags);
+		if (!r->d_count) {
+			spin_unlock_irqrestore(&dev->lock, flags);
+			return;
+		}
+		slot = &dev->slots[r->done[r->d_head].index];
+		r->d_head = (r->d_head + 1) % UNICAM_MAX_BUFFERS;
+		r->d_count--;
+		r->inflight++;
+		spin_unlock_irqrestore(&dev->lock, flags);
+
+		ret = unicam_pipe_post(dev, slot);
+		if (ret) {
+			dev_err(unicam_info.dev, "%s: isp job for buffer %u: %d\n",
+				__func__, slot->buf.index, ret);
+			unicam_pipe_done(slot, MM_JOB_STATUS_ERROR);
+		}
+	}
+}
+
+static int unicam_pipe_job_copy(struct unicam_pipe_job *job,
+				unicam_mm_job_t *u)
+{
+	void *data;
+
+	if (!u->type) {
+		job->type = 0;
+		return 0;
+	}
+	if (!u->size || u->size > UNICAM_MAX_PIPE_JOB_SIZE)
+		return -EINVAL;
+
+	data = kmalloc(u->size, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+	if (copy_from_user(data, (void __user *)u->data, u->size)) {
+		kfree(data);
+		return -EFAULT;
+	}
+	kfree(job->data);
+	job->data = data;
+	job->type = u->type;
+	job->id = u->id;
+	job->size = u->size;
+	return 0;
+}
+
+static int unicam_qbuf_pipe(struct unicam *dev, unicam_pipe_buf_t *pb)
+{
+	struct unicam_pipe_slot *slot;
+	int ret;
+
+	if (!dev->isp_file)
+		return -EINVAL;
+	if (pb->buf.index >= UNICAM_MAX_BUFFERS || !pb->isp.type)
+		return -EINVAL;
+
+	slot = &dev->slots[pb->buf.index];
+	if (slot->busy)
+		return -EBUSY;
+
+	ret = unicam_pipe_job_copy(&slot->isp, &pb->isp);
+	if (!ret)
+		ret = unicam_pipe_job_copy(&slot->enc, &pb->enc);
+	if (ret)
+		return ret;
+
+	slot->buf = pb->buf;
+	slot->busy = 1;
+	ret = unicam_qbuf(dev, &pb->buf);
+	if (ret)
+		slot->busy = 0;
+	return ret;
+}
+
+static void unicam_pipe_init(struct unicam *dev)
+{
+	int i;
+
+	INIT_WORK(&dev->pipe_work, unicam_pipe_work);
+	for (i = 0; i < UNICAM_MAX_BUFFERS; i++)
+		dev->slots[i].dev = dev;
+}
+
+static void unicam_pipe_unlink(struct unicam *dev)
+{
+	int i;
+
+	for (i = 0; i < UNICAM_MAX_BUFFERS; i++) {
+		kfree(dev->slots[i].isp.data);
+		kfree(dev->slots[i].enc.data);
+		memset(&dev->slots[i].isp, 0, sizeof(dev->slots[i].isp));
+		memset(&dev->slots[i].enc, 0, sizeof(dev->slots[i].enc));
+	}
+	if (dev->isp_file)
+		fput(dev->isp_file);
+	if (dev->enc_file)
+		fput(dev->enc_file);
+	dev->isp_file = NULL;
+	dev->enc_file = NULL;
+}
+
+static int unicam_set_pipeline(struct unicam *dev, unicam_pipeline_t *p)
+{
+	struct file *isp = NULL, *enc = NULL;
+
+	if (dev->ring.streaming)
+		return -EBUSY;
+
+	if (p->isp_fd >= 0) {
+		isp = mm_fmwk_fget(p->isp_fd);
+		enc = mm_fmwk_fget(p->enc_fd);
+		if (!isp || !enc) {
+			if (isp)
+				fput(isp);
+			if (enc)
+				fput(enc);
+			return -EBADF;
+		}
+	}
+
+	unicam_pipe_unlink(dev);
+	dev->isp_file = isp;
+	dev->enc_file = enc;
+	return 0;
+}
+#endif
+
 static irqreturn_t unicam_isr(int irq, void *dev_id)
 {
 	struct unicam *dev;
@@ -108,6 +513,9 @@ static irqreturn_t unicam_isr(int irq, void *dev_id)
 	reg_write(unicam_base, CAM_ISTA_OFFSET, image_intr);
 	reg_write(unicam_base, CAM_STA_OFFSET, rx_status);
 
+	if (image_intr & CAM_ISTA_FEI_MASK)
+		unicam_frame_end(dev);
+
 	if (dev->irq_start == 1) {
 		if (dev->irq_pending == 0) {
 			dev->unicam_isr_reg_status.rx_status = rx_status;
@@ -133,6 +541,11 @@ static int unicam_open(struct inode *inode, struct file *filp)
 	init_completion(&dev->irq_sem);
 	dev->irq_pending = 0;
 	dev->irq_start = 0;
+	spin_lock_init(&dev->lock);
+	init_waitqueue_head(&dev->done_wait);
+#ifdef CONFIG_HAWAII_MM
+	unicam_pipe_init(dev);
+#endif
 
 	if (pi_mgr_dfs_request_update(&unicam_dfs_node, PI_OPP_TURBO)) {
 		dev_err(unicam_info.dev, "%s:failed to update dfs request for unicam\n",
@@ -178,7 +591,12 @@ static int unicam_release(struct inode *inode, struct file *filp)
 {
 	struct unicam *dev = filp->private_data;
 
+	unicam_streamoff(dev);
 	disable_irq(IRQ_UNICAM);
+#ifdef CONFIG_HAWAII_MM
+	cancel_work_sync(&dev->pipe_work);
+	unicam_pipe_unlink(dev);
+#endif
 	free_irq(IRQ_UNICAM, dev);
 
 	if (unicam_info.reg) {
@@ -234,6 +652,12 @@ static long unicam_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 	int ret = 0;
 	static int interrupt_irq;
 	sensor_ctrl_t sensor_ctrl;
+	unicam_buf_t buf;
+	unicam_frame_t frame;
+#ifdef CONFIG_HAWAII_MM
+	unicam_pipe_buf_t pipe_buf;
+	unicam_pipeline_t pipeline;
+#endif
 
 	if (_IOC_TYPE(cmd) != BCM_UNICAM_MAGIC)
 		return -ENOTTY;
@@ -315,17 +739,84 @@ static long unicam_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		unicam_sensor_control(sensor_ctrl.sensor_id,
 				      sensor_ctrl.enable);
 		break;
+
+	case UNICAM_IOCTL_QBUF:
+#ifdef CONFIG_HAWAII_MM
+		/* pipeline buffers need their jobs, see QBUF_PIPE */
+		if (dev->isp_file)
+			return -EBUSY;
+#endif
+		if (copy_from_user(&buf, (unicam_buf_t *) arg, sizeof(buf)))
+			return -EFAULT;
+		ret = unicam_qbuf(dev, &buf);
+		break;
+
+	case UNICAM_IOCTL_DQBUF:
+#ifdef CONFIG_HAWAII_MM
+		/* frames go to the isp, results come from the encoder */
+		if (dev->isp_file)
+			return -EBUSY;
+#endif
+		ret = unicam_dqbuf(dev, &frame, filp->f_flags & O_NONBLOCK);
+		if (!ret && copy_to_user((unicam_frame_t *) arg, &frame,
+					 sizeof(frame)))
+			ret = -EFAULT;
+		break;
+
+	case UNICAM_IOCTL_STREAMON:
+		dev_dbg(unicam_info.dev, "Stream on\n");
+		ret = unicam_streamon(dev);
+		break;
+
+	case UNICAM_IOCTL_STREAMOFF:
+		dev_dbg(unicam_info.dev, "Stream off\n");
+		unicam_streamoff(dev);
+		break;
+
+#ifdef CONFIG_HAWAII_MM
+	case UNICAM_IOCTL_SET_PIPELINE:
+		if (copy_from_user(&pipeline, (unicam_pipeline_t *) arg,
+				   sizeof(pipeline)))
+			return -EFAULT;
+		ret = unicam_set_pipeline(dev, &pipeline);
+		break;
+
+	case UNICAM_IOCTL_QBUF_PIPE:
+		if (copy_from_user(&pipe_buf, (unicam_pipe_buf_t *) arg,
+				   sizeof(pipe_buf)))
+			return -EFAULT;
+		ret = unicam_qbuf_pipe(dev, &pipe_buf);
+		break;
+#endif
 	default:
 		break;
 	}
 	return ret;
 }
 
+static unsigned int unicam_poll(struct file *filp, poll_table *wait)
+{
+	struct unicam *dev = filp->private_data;
+	unsigned int mask = 0;
+	unsigned long flags;
+
+	poll_wait(filp, &dev->done_wait, wait);
+	spin_lock_irqsave(&dev->lock, flags);
+	if (dev->ring.d_count)
+		mask |= POLLIN | POLLRDNORM;
+	else if (!dev->ring.streaming)
+		mask |= POLLERR;
+	spin_unlock_irqrestore(&dev->lock, flags);
+
+	return mask;
+}
+
 static const struct file_operations unicam_fops = {
 	.open = unicam_open,
 	.release = unicam_release,
 	.mmap = unicam_mmap,
 	.unlocked_ioctl = unicam_ioctl,
+	.poll = unicam_poll,
 };
 
 static inline unsigned int reg_read(void __iomem *base_addr, unsigned int reg)
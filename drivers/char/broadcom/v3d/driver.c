@@ -65,8 +65,11 @@ v3d_driver_t *v3d_driver_create(void)
 			list_add_tail(&instance->job.free_jobs[i].link, &instance->job.free.list);
 		sema_init(&instance->job.free.count, i);
 	}
-	INIT_LIST_HEAD(&instance->job.posted.user);
-	INIT_LIST_HEAD(&instance->job.posted.bin_render);
+	{
+		unsigned int i;
+		for (i = 0 ; i < V3D_PRIORITY_COUNT ; ++i)
+			INIT_LIST_HEAD(&instance->job.posted.active[i]);
+	}
 	INIT_LIST_HEAD(&instance->job.posted.exclusive.user);
 	INIT_LIST_HEAD(&instance->job.posted.exclusive.bin_render);
 	mutex_init(&instance->job.posted.exclusive.lock);
@@ -111,10 +114,23 @@ int v3d_driver_add_session(v3d_driver_t *instance, struct v3d_session_tag *sessi
 void v3d_driver_remove_session(v3d_driver_t *instance, struct v3d_session_tag *session)
 {
 	v3d_session_t **entry = get_session_entry(instance, session);
+	unsigned long   flags;
 	MY_ASSERT(session != NULL);
+	flags = v3d_driver_job_lock(instance);
+	list_del_init(&session->sched.link);
+	v3d_driver_job_unlock(instance, flags);
 	*entry = NULL;
 }
 
+void v3d_driver_set_priority(v3d_driver_t *instance, struct v3d_session_tag *session, unsigned int priority)
+{
+	unsigned long flags = v3d_driver_job_lock(instance);
+	session->sched.priority = priority;
+	if (list_empty(&session->sched.link) == 0)
+		list_move_tail(&session->sched.link, &instance->job.posted.active[priority]);
+	v3d_driver_job_unlock(instance, flags);
+}
+
 
 /* ================================================================ */
 
@@ -128,6 +144,54 @@ static v3d_driver_job_t *remove_head(struct list_head *list)
 	return job;
 }
 
+/* Requires Instance->Job.Posted.Lock to be held */
+static v3d_driver_job_t *session_job_get(v3d_session_t *session, unsigned int required)
+{
+	v3d_driver_job_t *job = NULL;
+	if ((required & V3D_JOB_USER) != 0)
+		job = remove_head(&session->sched.user);
+	if (job == NULL && (required & V3D_JOB_BIN_REND) != 0)
+		job = remove_head(&session->sched.bin_render);
+	return job;
+}
+
+/* Strict priority between classes, deficit round robin between the  */
+/* sessions of a class. A session keeps the head of its class until  */
+/* its deficit, charged with the measured run time of its completed  */
+/* jobs in v3d_session_add_statistics, is used up                    */
+/* Requires Instance->Job.Posted.Lock to be held */
+static v3d_driver_job_t *scheduled_job_get(v3d_driver_t *instance, unsigned int required)
+{
+	unsigned int i;
+	for (i = 0 ; i < V3D_PRIORITY_COUNT ; ++i) {
+		struct list_head *active = &instance->job.posted.active[i];
+		while (list_empty(active) == 0) {
+			v3d_session_t    *session = list_first_entry(active, v3d_session_t, sched.link);
+			v3d_driver_job_t *job;
+			if (session->sched.deficit <= 0) {
+				/* Round over for this session */
+				session->sched.deficit += V3D_SCHED_QUANTUM_US;
+				list_move_tail(&session->sched.link, active);
+				continue;
+			}
+			job = session_job_get(session, required);
+			if (list_empty(&session->sched.user) != 0
+				&& list_empty(&session->sched.bin_render) != 0) {
+				/* Idle sessions don't bank credit */
+				list_del_init(&session->sched.link);
+				if (session->sched.deficit > 0)
+					session->sched.deficit = 0;
+			}
+			if (job != NULL)
+				return job;
+			if (list_empty(&session->sched.link) != 0)
+				continue; /* Its jobs were cancelled before issue */
+			break; /* Only jobs of another type at the head */
+		}
+	}
+	return NULL;
+}
+
 /* Requires Instance->Job.Posted.Lock to be held */
 v3d_driver_job_t *v3d_driver_job_get(v3d_driver_t *instance, unsigned int required)
 {
@@ -140,10 +204,13 @@ v3d_driver_job_t *v3d_driver_job_get(v3d_driver_t *instance, unsigned int requir
 		&& instance->job.posted.exclusive.bin_render_count == 0
 		&& instance->job.posted.exclusive.user_count      == 0;
 
-	if ((required & V3D_JOB_USER) != 0)
-		job = remove_head(exclusive != 0 ? &instance->job.posted.exclusive.user      : &instance->job.posted.user);
-	if (job == NULL && (required & V3D_JOB_BIN_REND) != 0)
-		job = remove_head(exclusive != 0 ? &instance->job.posted.exclusive.bin_render : &instance->job.posted.bin_render);
+	if (exclusive != 0) {
+		if ((required & V3D_JOB_USER) != 0)
+			job = remove_head(&instance->job.posted.exclusive.user);
+		if (job == NULL && (required & V3D_JOB_BIN_REND) != 0)
+			job = remove_head(&instance->job.posted.exclusive.bin_render);
+	} else
+		job = scheduled_job_get(instance, required);
 
 	/* Update counts for switching to exclusive queues */
 	if (job != NULL && instance->job.posted.exclusive.owner != NULL && exclusive == 0) {
@@ -213,9 +280,9 @@ void v3d_driver_exclusive_start(v3d_driver_t *instance, struct v3d_session_tag *
 #if 0
 	{
 		struct list_head *current;
-		list_for_each(current, &instance->job.posted.bin_render)
+		list_for_each(current, &session->sched.bin_render)
 			++instance->job.posted.exclusive.bin_render_count;
-		list_for_each(current, &instance->job.posted.user)
+		list_for_each(current, &session->sched.user)
 			++instance->job.posted.exclusive.user_count;
 	}
 #endif
@@ -264,7 +331,7 @@ int v3d_driver_job_post(
 	if (session == instance->job.posted.exclusive.owner)
 		list = user_job->job_type == V3D_JOB_USER ? &instance->job.posted.exclusive.user : &instance->job.posted.exclusive.bin_render;
 	else
-		list = user_job->job_type == V3D_JOB_USER ? &instance->job.posted.user           : &instance->job.posted.bin_render;
+		list = user_job->job_type == V3D_JOB_USER ? &session->sched.user                 : &session->sched.bin_render;
 
 	if (list_empty(&instance->job.free.list))
 		printk(KERN_ERR "%s: free list empty!\n", __func__);
@@ -299,6 +366,8 @@ int v3d_driver_job_post(
 	/* Queue it */
 	spin_lock_irqsave(&instance->job.posted.lock, flags);
 	list_add_tail(&job->link, list);
+	if (session != instance->job.posted.exclusive.owner && list_empty(&session->sched.link) != 0)
+		list_add_tail(&session->sched.link, &instance->job.posted.active[session->sched.priority]);
 	spin_unlock_irqrestore(&instance->job.posted.lock, flags);
 
 	/* Kick consumer(s) */
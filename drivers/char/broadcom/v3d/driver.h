@@ -87,9 +87,9 @@ typedef struct v3d_driver_tag {
 			struct list_head list;
 		} free;
 		struct {
-			spinlock_t       lock; /* For both lists */
-			struct list_head bin_render;
-			struct list_head user;
+			spinlock_t       lock; /* For all lists */
+			/* Sessions with posted jobs, per priority class */
+			struct list_head active[V3D_PRIORITY_COUNT];
 			struct {
 				struct mutex          lock;
 				struct v3d_session_tag *owner;
@@ -144,6 +144,7 @@ extern int  v3d_driver_job_post(
 
 extern void v3d_driver_exclusive_start(v3d_driver_t *instance, struct v3d_session_tag *session);
 extern int  v3d_driver_exclusive_stop(v3d_driver_t  *instance, struct v3d_session_tag *session);
+extern void v3d_driver_set_priority(v3d_driver_t *instance, struct v3d_session_tag *session, unsigned int priority);
 
 extern void v3d_driver_reset_statistics(v3d_driver_t *instance);
 
@@ -38,6 +38,11 @@ v3d_session_t *v3d_session_create(v3d_driver_t *driver, const char *name)
 	spin_lock_init(&instance->issued.lock);
 	INIT_LIST_HEAD(&instance->issued.list);
 	instance->performance_counter.enables = 0;
+	instance->sched.priority = V3D_PRIORITY_FOREGROUND;
+	instance->sched.deficit  = 0;
+	INIT_LIST_HEAD(&instance->sched.link);
+	INIT_LIST_HEAD(&instance->sched.bin_render);
+	INIT_LIST_HEAD(&instance->sched.user);
 
 	v3d_session_reset_statistics(instance);
 
@@ -80,9 +85,16 @@ void v3d_session_reset_statistics(v3d_session_t *instance)
 	statistics_initialise(&instance->binning_bytes);
 }
 
+/* Requires the driver's job.posted.lock to be held */
 void v3d_session_add_statistics(v3d_session_t *instance, int user, unsigned int queue, unsigned int run, unsigned int binning_bytes)
 {
 	instance->total_run += run;
+
+	/* Charge the scheduler, bounding the debt so a single long job */
+	/* can't lock the session out for many rounds                   */
+	instance->sched.deficit -= run;
+	if (instance->sched.deficit < -4 * V3D_SCHED_QUANTUM_US)
+		instance->sched.deficit = -4 * V3D_SCHED_QUANTUM_US;
 	if (user != 0) {
 		statistics_add(&instance->user.queue, queue);
 		statistics_add(&instance->user.run,   run);
@@ -94,6 +106,15 @@ void v3d_session_add_statistics(v3d_session_t *instance, int user, unsigned int
 }
 
 
+int v3d_session_set_priority(v3d_session_t *instance, uint32_t priority)
+{
+	if (priority >= V3D_PRIORITY_COUNT)
+		return -EINVAL;
+	v3d_driver_set_priority(instance->driver, instance, priority);
+	return 0;
+}
+
+
 /* ================================================================ */
 
 int v3d_session_job_post(
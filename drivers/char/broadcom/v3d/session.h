@@ -22,6 +22,9 @@ the GPL, without Broadcom's express prior written consent.
 
 #define JOB_TIMEOUT_MS 2000
 
+/* GPU time granted to a session per deficit-round-robin round */
+#define V3D_SCHED_QUANTUM_US 4000
+
 
 struct v3d_driver_tag;
 struct v3d_driver_job_tag;
@@ -59,6 +62,15 @@ struct v3d_session_tag {
 		uint32_t enables;
 		uint32_t count[16];
 	} performance_counter;
+
+	/* Protected by the driver's job.posted.lock */
+	struct {
+		unsigned int     priority;
+		int              deficit;    /* us of GPU time left this round */
+		struct list_head link;       /* In driver job.posted.active[] */
+		struct list_head bin_render; /* Posted, not yet issued */
+		struct list_head user;
+	} sched;
 };
 
 extern v3d_session_t *v3d_session_create(struct v3d_driver_tag *driver, const char *name);
@@ -72,6 +84,7 @@ extern void           v3d_session_add_statistics(
 	unsigned int   run,
 	unsigned int   binning_bytes);
 extern void           v3d_session_reset_statistics(v3d_session_t *instance);
+extern int            v3d_session_set_priority(v3d_session_t *instance, uint32_t priority);
 extern void           v3d_session_issued(struct v3d_driver_job_tag *job);
 extern void           v3d_session_complete(struct v3d_driver_job_tag *job, int status);
 
@@ -338,9 +338,9 @@ static unsigned int session_read(char *buffer, unsigned int bytes)
 
 			offset += my_snprintf(
 				buffer + offset, bytes - offset,
-				" Session %-20s load %3u.%01u%%\n",
+				" Session %-20s load %3u.%01u%% prio %u\n",
 				session->name != NULL ? session->name : "unknown",
-				load / 10, load % 10);
+				load / 10, load % 10, session->sched.priority);
 			output_job_statistics("Bin/Render jobs", &calculated_statistics[0], buffer, bytes, &offset, elapsed);
 			if (calculated_statistics[4].samples != 0)
 				offset += statistics_output(
@@ -363,6 +363,17 @@ static long v3d_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 		ret = v3d_driver_exclusive_stop(v3d_state.v3d_driver, dev->session);
 		break;
 
+	case V3D_IOCTL_SET_PRIORITY:
+		{
+			uint32_t priority;
+			if (copy_from_user(&priority, (void *) arg, sizeof(priority))) {
+				KLOG_E("V3D_IOCTL_SET_PRIORITY copy_from_user failed\n");
+				ret = -EPERM;
+			} else
+				ret = v3d_session_set_priority(dev->session, priority);
+		}
+		break;
+
 	case V3D_IOCTL_DVTS_CREATE:
 		{
 			uint32_t id;
@@ -299,9 +299,10 @@ static int __init arch_timer_register(void)
  * was causing a freeze. That is wne the cores come out of dormant and try to
  * update the wall clock using do_timer --> update_wall_time. When I switched
  * to use the timer that is always ON as clock source this SW freeze was
- * fixed.
+ * fixed. Firmware that keeps the counter running enables it again with
+ * CONFIG_KONA_ARCH_COUNTER_CLOCKSOURCE.
  */
-#if 0
+#ifdef CONFIG_KONA_ARCH_COUNTER_CLOCKSOURCE
 	clocksource_register_hz(&clocksource_counter, arch_timer_rate);
 	cyclecounter.mult = clocksource_counter.mult;
 	cyclecounter.shift = clocksource_counter.shift;
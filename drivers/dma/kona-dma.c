@@ -0,0 +1,664 @@
+/*
+ * drivers/dma/kona-dma.c
+ *
+ * dmaengine provider on top of the Kona PL330 channel API
+ * (arch/arm/plat-kona/dma.c).
+ *
+ * A virtual channel takes a plat-kona channel in alloc_chan_resources,
+ * mapped to the dmux peripheral named by the kona_dma_filter_fn
+ * parameter (NULL for memcpy). Every descriptor is a list of xfer
+ * items for dma_setup_transfer_list, set up with DMA_CFG_PREPARED: as
+ * long as the next descriptor asks for the same items with the same
+ * configuration, the request and its PL330 microcode are just started
+ * again. Cyclic descriptors have one item per period and run with
+ * DMA_CFG_CYCLIC, so each period is reported as it completes.
+ *
+ * Setting up a new request allocates with GFP_KERNEL, so it is done
+ * from a work item; a prepared one is restarted right away.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/dmaengine.h>
+#include <linux/dma-mapping.h>
+#include <linux/err.h>
+#include <linux/gcd.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/list.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <mach/dma.h>
+
+#include "virt-dma.h"
+
+#define KONA_DMA_CHANS		8
+
+struct kona_dma_xfer {
+	dma_addr_t src;
+	dma_addr_t dst;
+	unsigned int len;
+};
+
+/* what dma_setup_transfer_list is called with */
+struct kona_dma_prog {
+	int control;
+	int cfg;
+	unsigned int n;
+	struct kona_dma_xfer x[0];
+};
+
+struct kona_dma_desc {
+	struct virt_dma_desc vd;
+	size_t len;
+	size_t period_len;	/* cyclic only */
+	struct kona_dma_prog *prog;
+};
+
+struct kona_dma_chan {
+	struct virt_dma_chan vc;
+	char peri[MAX_CHAN_NAME_LENGTH];	/* empty for memcpy */
+	unsigned int ch;			/* plat-kona channel */
+	struct dma_slave_config cfg;
+
+	/* under vc.lock */
+	struct kona_dma_desc *desc;	/* being set up or running */
+	bool running;
+	bool setup_busy;
+	unsigned int period;		/* cyclic: completed in this pass */
+	struct kona_dma_prog *prog;	/* the plat channel is set up with */
+
+	struct work_struct setup_work;
+};
+
+struct kona_dma_dev {
+	struct dma_device ddev;
+	struct platform_device *pdev;
+	struct workqueue_struct *wq;
+	struct kona_dma_chan chan[KONA_DMA_CHANS];
+};
+
+static struct kona_dma_dev *kona_dma;
+
+static inline struct kona_dma_chan *to_kona_dma_chan(struct dma_chan *c)
+{
+	return container_of(c, struct kona_dma_chan, vc.chan);
+}
+
+static inline struct kona_dma_desc *to_kona_dma_desc(
+	struct dma_async_tx_descriptor *t)
+{
+	return container_of(t, struct kona_dma_desc, vd.tx);
+}
+
+static size_t kona_dma_prog_size(unsigned int n)
+{
+	return sizeof(struct kona_dma_prog) + n * sizeof(struct kona_dma_xfer);
+}
+
+static bool kona_dma_prog_equal(struct kona_dma_prog *a,
+				struct kona_dma_prog *b)
+{
+	return a && b && a->n == b->n && a->control == b->control &&
+	       a->cfg == b->cfg && !memcmp(a->x, b->x, a->n * sizeof(a->x[0]));
+}
+
+static struct kona_dma_desc *kona_dma_desc_alloc(unsigned int n,
+						 int control, int cfg)
+{
+	struct kona_dma_desc *d;
+
+	d = kzalloc(sizeof(*d) + kona_dma_prog_size(n), GFP_NOWAIT);
+	if (!d)
+		return NULL;
+
+	d->prog = (struct kona_dma_prog *)(d + 1);
+	d->prog->control = control;
+	d->prog->cfg = cfg;
+	return d;
+}
+
+static void kona_dma_desc_add(struct kona_dma_desc *d, dma_addr_t src,
+			      dma_addr_t dst, unsigned int len)
+{
+	struct kona_dma_xfer *x = &d->prog->x[d->prog->n++];
+
+	x->src = src;
+	x->dst = dst;
+	x->len = len;
+	d->len += len;
+}
+
+static void kona_dma_desc_free(struct virt_dma_desc *vd)
+{
+	kfree(container_of(vd, struct kona_dma_desc, vd));
+}
+
+/*
+ * DMA_CFG_BURST_* for beats of 'width' bytes: the longest burst up to
+ * 'maxburst' beats, 16 beats and 64 bytes that every xfer length (all
+ * multiples of 'align') is a whole number of.
+ */
+static int kona_dma_burst_cfg(unsigned int width, unsigned int maxburst,
+			      size_t align)
+{
+	int bs;
+
+	switch (width) {
+	case 1:
+		bs = DMA_CFG_BURST_SIZE_1;
+		break;
+	case 2:
+		bs = DMA_CFG_BURST_SIZE_2;
+		break;
+	case 4:
+		bs = DMA_CFG_BURST_SIZE_4;
+		break;
+	case 8:
+		bs = DMA_CFG_BURST_SIZE_8;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (!align || align % width)
+		return -EINVAL;
+
+	maxburst = clamp(maxburst, 1U, min(16U, 64 / width));
+	while (maxburst > 1 && align % (width * maxburst))
+		maxburst--;
+
+	return bs | ((maxburst - 1) << DMA_CFG_BURST_LENGTH_SHIFT);
+}
+
+/* Device side of a slave transfer, from the DMA_SLAVE_CONFIG */
+static int kona_dma_slave_prog(struct kona_dma_chan *c,
+			       enum dma_transfer_direction dir, size_t align,
+			       dma_addr_t *dev_addr, int *control, int *cfg)
+{
+	struct dma_slave_config *sc = &c->cfg;
+	int burst;
+
+	if (!c->peri[0])
+		return -EINVAL;
+
+	if (dir == DMA_MEM_TO_DEV) {
+		*dev_addr = sc->dst_addr;
+		*control = DMA_DIRECTION_MEM_TO_DEV_FLOW_CTRL_DMAC;
+		*cfg = DMA_CFG_SRC_ADDR_INCREMENT | DMA_CFG_DST_ADDR_FIXED;
+		burst = kona_dma_burst_cfg(sc->dst_addr_width,
+					   sc->dst_maxburst, align);
+	} else if (dir == DMA_DEV_TO_MEM) {
+		*dev_addr = sc->src_addr;
+		*control = DMA_DIRECTION_DEV_TO_MEM_FLOW_CTRL_DMAC;
+		*cfg = DMA_CFG_SRC_ADDR_FIXED | DMA_CFG_DST_ADDR_INCREMENT;
+		burst = kona_dma_burst_cfg(sc->src_addr_width,
+					   sc->src_maxburst, align);
+	} else {
+		return -EINVAL;
+	}
+
+	if (burst < 0)
+		return burst;
+	*cfg |= burst;
+	return 0;
+}
+
+/*
+ * Get c->desc, or else the next issued descriptor, going. With vc.lock
+ * held.
+ */
+static void kona_dma_kick(struct kona_dma_chan *c)
+{
+	struct virt_dma_desc *vd;
+	struct kona_dma_desc *d;
+
+	while (!c->running && !c->setup_busy) {
+		if (!c->desc) {
+			vd = vchan_next_desc(&c->vc);
+			if (!vd)
+				return;
+			list_del(&vd->node);
+			c->desc = to_kona_dma_desc(&vd->tx);
+		}
+		d = c->desc;
+
+		/* not what the channel is prepared with: set it up first */
+		if (!kona_dma_prog_equal(c->prog, d->prog)) {
+			queue_work(kona_dma->wq, &c->setup_work);
+			return;
+		}
+
+		c->period = 0;
+		if (dma_start_transfer(c->ch) == 0) {
+			c->running = true;
+			return;
+		}
+
+		dev_err(c->vc.chan.device->dev, "chan %u: start failed\n",
+			c->ch);
+		c->desc = NULL;
+		vchan_cookie_complete(&d->vd);
+	}
+}
+
+static void kona_dma_setup_work(struct work_struct *work)
+{
+	struct kona_dma_chan *c =
+	    container_of(work, struct kona_dma_chan, setup_work);
+	struct dma_transfer_list *lli = NULL;
+	struct kona_dma_prog *p;
+	struct kona_dma_desc *d;
+	dma_cookie_t cookie;
+	unsigned long flags;
+	unsigned int i;
+	LIST_HEAD(head);
+	int ret = -ENOMEM;
+
+	spin_lock_irqsave(&c->vc.lock, flags);
+	d = c->desc;
+	if (!d || c->running || c->setup_busy ||
+	    kona_dma_prog_equal(c->prog, d->prog)) {
+		kona_dma_kick(c);
+		spin_unlock_irqrestore(&c->vc.lock, flags);
+		return;
+	}
+	/* d may be terminated while the lock is dropped: work on a copy */
+	p = kmemdup(d->prog, kona_dma_prog_size(d->prog->n), GFP_ATOMIC);
+	cookie = d->vd.tx.cookie;
+	c->setup_busy = true;
+	spin_unlock_irqrestore(&c->vc.lock, flags);
+
+	if (p)
+		lli = kcalloc(p->n, sizeof(*lli), GFP_KERNEL);
+	if (lli) {
+		for (i = 0; i < p->n; i++) {
+			lli[i].srcaddr = p->x[i].src;
+			lli[i].dstaddr = p->x[i].dst;
+			lli[i].xfer_size = p->x[i].len;
+			list_add_tail(&lli[i].next, &head);
+		}
+
+		/* drop what the channel was prepared with before */
+		dma_release_transfer(c->ch);
+		ret = dma_setup_transfer_list(c->ch, &head, p->control,
+					      p->cfg | DMA_CFG_PREPARED);
+		kfree(lli);
+	}
+
+	spin_lock_irqsave(&c->vc.lock, flags);
+	c->setup_busy = false;
+	kfree(c->prog);
+	c->prog = NULL;
+	if (ret) {
+		kfree(p);
+		dev_err(c->vc.chan.device->dev, "chan %u: setup failed: %d\n",
+			c->ch, ret);
+		/* don't leave the client waiting for it */
+		d = c->desc;
+		if (d && !c->running && d->vd.tx.cookie == cookie) {
+			c->desc = NULL;
+			vchan_cookie_complete(&d->vd);
+		}
+	} else {
+		c->prog = p;
+	}
+	kona_dma_kick(c);
+	spin_unlock_irqrestore(&c->vc.lock, flags);
+}
+
+static void kona_dma_callback(void *data, enum pl330_xfer_status status)
+{
+	struct kona_dma_chan *c = data;
+	struct kona_dma_desc *d;
+	unsigned long flags;
+
+	spin_lock_irqsave(&c->vc.lock, flags);
+	d = c->desc;
+	if (!d || !c->running)
+		goto out;
+
+	if (status != DMA_PL330_XFER_OK)
+		dev_err(c->vc.chan.device->dev, "chan %u: transfer %s\n",
+			c->ch, status == DMA_PL330_XFER_ABORT ?
+			"aborted" : "failed");
+
+	if ((d->prog->cfg & DMA_CFG_CYCLIC) && status == DMA_PL330_XFER_OK) {
+		if (++c->period == d->prog->n)
+			c->period = 0;
+		vchan_cyclic_callback(&d->vd);
+		goto out;
+	}
+
+	/* prepared: stopping keeps the request for the next descriptor */
+	dma_stop_transfer(c->ch);
+	c->running = false;
+	c->desc = NULL;
+	vchan_cookie_complete(&d->vd);
+	kona_dma_kick(c);
+out:
+	spin_unlock_irqrestore(&c->vc.lock, flags);
+}
+
+static int kona_dma_alloc_chan_resources(struct dma_chan *chan)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+	const char *peri = c->peri[0] ? c->peri : NULL;
+
+	if (dma_request_chan(&c->ch, peri)) {
+		dev_err(chan->device->dev, "no channel for %s\n",
+			peri ? peri : "memcpy");
+		return -EBUSY;
+	}
+
+	if (dma_register_callback(c->ch, kona_dma_callback, c)) {
+		dma_free_chan(c->ch);
+		return -EBUSY;
+	}
+
+	return 0;
+}
+
+static int kona_dma_terminate_all(struct kona_dma_chan *c)
+{
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	spin_lock_irqsave(&c->vc.lock, flags);
+
+	if (c->running) {
+		dma_stop_transfer(c->ch);
+		c->running = false;
+	}
+	if (c->desc) {
+		list_add_tail(&c->desc->vd.node, &head);
+		c->desc = NULL;
+	}
+	/* no period callback for a descriptor about to be freed */
+	c->vc.cyclic = NULL;
+
+	vchan_get_all_descriptors(&c->vc, &head);
+	spin_unlock_irqrestore(&c->vc.lock, flags);
+	vchan_dma_desc_free_list(&c->vc, &head);
+
+	return 0;
+}
+
+static void kona_dma_free_chan_resources(struct dma_chan *chan)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+
+	kona_dma_terminate_all(c);
+	cancel_work_sync(&c->setup_work);
+	vchan_free_chan_resources(&c->vc);
+
+	dma_free_callback(c->ch);
+	dma_free_chan(c->ch);
+
+	kfree(c->prog);
+	c->prog = NULL;
+	c->peri[0] = '\0';
+}
+
+static enum dma_status kona_dma_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+	struct virt_dma_desc *vd;
+	struct kona_dma_desc *d;
+	enum dma_status ret;
+	unsigned long flags;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_SUCCESS || !txstate)
+		return ret;
+
+	spin_lock_irqsave(&c->vc.lock, flags);
+	vd = vchan_find_desc(&c->vc, cookie);
+	d = c->desc;
+	if (vd) {
+		txstate->residue = to_kona_dma_desc(&vd->tx)->len;
+	} else if (d && d->vd.tx.cookie == cookie) {
+		/* the position is only known to the period */
+		if (d->prog->cfg & DMA_CFG_CYCLIC)
+			txstate->residue = d->len - c->period * d->period_len;
+		else
+			txstate->residue = d->len;
+	} else {
+		txstate->residue = 0;
+	}
+	spin_unlock_irqrestore(&c->vc.lock, flags);
+
+	return ret;
+}
+
+static void kona_dma_issue_pending(struct dma_chan *chan)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&c->vc.lock, flags);
+	if (vchan_issue_pending(&c->vc))
+		kona_dma_kick(c);
+	spin_unlock_irqrestore(&c->vc.lock, flags);
+}
+
+static struct dma_async_tx_descriptor *kona_dma_prep_slave_sg(
+	struct dma_chan *chan, struct scatterlist *sgl, unsigned int sg_len,
+	enum dma_transfer_direction dir, unsigned long tx_flags, void *context)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+	struct kona_dma_desc *d;
+	struct scatterlist *sg;
+	dma_addr_t dev_addr;
+	size_t align = 0;
+	int control, cfg, i;
+
+	for_each_sg(sgl, sg, sg_len, i)
+		if (sg_dma_len(sg))
+			align = align ? gcd(align, sg_dma_len(sg)) :
+			    sg_dma_len(sg);
+
+	if (kona_dma_slave_prog(c, dir, align, &dev_addr, &control, &cfg)) {
+		dev_err(chan->device->dev, "%s: bad slave config\n", __func__);
+		return NULL;
+	}
+
+	d = kona_dma_desc_alloc(sg_len, control, cfg);
+	if (!d)
+		return NULL;
+
+	for_each_sg(sgl, sg, sg_len, i) {
+		if (!sg_dma_len(sg))
+			continue;
+		if (dir == DMA_MEM_TO_DEV)
+			kona_dma_desc_add(d, sg_dma_address(sg), dev_addr,
+					  sg_dma_len(sg));
+		else
+			kona_dma_desc_add(d, dev_addr, sg_dma_address(sg),
+					  sg_dma_len(sg));
+	}
+
+	return vchan_tx_prep(&c->vc, &d->vd, tx_flags);
+}
+
+static struct dma_async_tx_descriptor *kona_dma_prep_dma_cyclic(
+	struct dma_chan *chan, dma_addr_t buf_addr, size_t buf_len,
+	size_t period_len, enum dma_transfer_direction dir,
+	unsigned long flags, void *context)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+	struct kona_dma_desc *d;
+	dma_addr_t dev_addr, buf;
+	unsigned int i, n;
+	int control, cfg;
+
+	if (!period_len || buf_len % period_len)
+		return NULL;
+	n = buf_len / period_len;
+
+	if (kona_dma_slave_prog(c, dir, period_len, &dev_addr, &control,
+				&cfg)) {
+		dev_err(chan->device->dev, "%s: bad slave config\n", __func__);
+		return NULL;
+	}
+
+	d = kona_dma_desc_alloc(n, control, cfg | DMA_CFG_CYCLIC);
+	if (!d)
+		return NULL;
+	d->period_len = period_len;
+
+	for (i = 0; i < n; i++) {
+		buf = buf_addr + i * period_len;
+		if (dir == DMA_MEM_TO_DEV)
+			kona_dma_desc_add(d, buf, dev_addr, period_len);
+		else
+			kona_dma_desc_add(d, dev_addr, buf, period_len);
+	}
+
+	return vchan_tx_prep(&c->vc, &d->vd, flags);
+}
+
+static struct dma_async_tx_descriptor *kona_dma_prep_dma_memcpy(
+	struct dma_chan *chan, dma_addr_t dst, dma_addr_t src, size_t len,
+	unsigned long flags)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+	struct kona_dma_desc *d;
+	unsigned int width = 8;
+	int burst;
+
+	if (!len)
+		return NULL;
+
+	/* widest beat both addresses and the length are aligned to */
+	while (width > 1 && ((src | dst | len) & (width - 1)))
+		width >>= 1;
+	burst = kona_dma_burst_cfg(width, 16, len);
+	if (burst < 0)
+		return NULL;
+
+	d = kona_dma_desc_alloc(1, DMA_DIRECTION_MEM_TO_MEM,
+				DMA_CFG_SRC_ADDR_INCREMENT |
+				DMA_CFG_DST_ADDR_INCREMENT | burst);
+	if (!d)
+		return NULL;
+	kona_dma_desc_add(d, src, dst, len);
+
+	return vchan_tx_prep(&c->vc, &d->vd, flags);
+}
+
+static int kona_dma_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+			    unsigned long arg)
+{
+	struct kona_dma_chan *c = to_kona_dma_chan(chan);
+
+	switch (cmd) {
+	case DMA_SLAVE_CONFIG:
+		memcpy(&c->cfg, (struct dma_slave_config *)arg,
+		       sizeof(c->cfg));
+		return 0;
+
+	case DMA_TERMINATE_ALL:
+		return kona_dma_terminate_all(c);
+
+	default:
+		return -ENXIO;
+	}
+}
+
+/*
+ * dma_request_channel filter: 'param' is the dmux name of the peripheral
+ * the channel is for, NULL for memcpy.
+ */
+bool kona_dma_filter_fn(struct dma_chan *chan, void *param)
+{
+	struct kona_dma_chan *c;
+
+	if (!kona_dma || chan->device != &kona_dma->ddev)
+		return false;
+
+	c = to_kona_dma_chan(chan);
+	if (param)
+		strlcpy(c->peri, param, MAX_CHAN_NAME_LENGTH);
+	else
+		c->peri[0] = '\0';
+	return true;
+}
+EXPORT_SYMBOL(kona_dma_filter_fn);
+
+static int __init kona_dma_init(void)
+{
+	struct kona_dma_dev *od;
+	struct kona_dma_chan *c;
+	int i, ret;
+
+	od = kzalloc(sizeof(*od), GFP_KERNEL);
+	if (!od)
+		return -ENOMEM;
+
+	od->wq = alloc_workqueue("kona_dma", WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	if (!od->wq) {
+		ret = -ENOMEM;
+		goto err_wq;
+	}
+
+	/* no resources of its own, the channels are plat-kona's */
+	od->pdev = platform_device_register_simple("kona-dmaengine", -1,
+						   NULL, 0);
+	if (IS_ERR(od->pdev)) {
+		ret = PTR_ERR(od->pdev);
+		goto err_pdev;
+	}
+
+	dma_cap_set(DMA_SLAVE, od->ddev.cap_mask);
+	dma_cap_set(DMA_CYCLIC, od->ddev.cap_mask);
+	dma_cap_set(DMA_MEMCPY, od->ddev.cap_mask);
+	/* each channel in use holds a PL330 thread: only on request */
+	dma_cap_set(DMA_PRIVATE, od->ddev.cap_mask);
+	od->ddev.device_alloc_chan_resources = kona_dma_alloc_chan_resources;
+	od->ddev.device_free_chan_resources = kona_dma_free_chan_resources;
+	od->ddev.device_tx_status = kona_dma_tx_status;
+	od->ddev.device_issue_pending = kona_dma_issue_pending;
+	od->ddev.device_prep_slave_sg = kona_dma_prep_slave_sg;
+	od->ddev.device_prep_dma_cyclic = kona_dma_prep_dma_cyclic;
+	od->ddev.device_prep_dma_memcpy = kona_dma_prep_dma_memcpy;
+	od->ddev.device_control = kona_dma_control;
+	od->ddev.dev = &od->pdev->dev;
+	INIT_LIST_HEAD(&od->ddev.channels);
+
+	for (i = 0; i < KONA_DMA_CHANS; i++) {
+		c = &od->chan[i];
+		c->vc.desc_free = kona_dma_desc_free;
+		vchan_init(&c->vc, &od->ddev);
+		INIT_WORK(&c->setup_work, kona_dma_setup_work);
+	}
+
+	kona_dma = od;
+	ret = dma_async_device_register(&od->ddev);
+	if (ret) {
+		pr_err("kona-dma: dma_async_device_register failed: %d\n",
+		       ret);
+		goto err_register;
+	}
+
+	dev_info(&od->pdev->dev, "dmaengine on %d PL330 channels\n",
+		 KONA_DMA_CHANS);
+	return 0;
+
+err_register:
+	kona_dma = NULL;
+	for (i = 0; i < KONA_DMA_CHANS; i++)
+		tasklet_kill(&od->chan[i].vc.task);
+	platform_device_unregister(od->pdev);
+err_pdev:
+	destroy_workqueue(od->wq);
+err_wq:
+	kfree(od);
+	return ret;
+}
+subsys_initcall(kona_dma_init);
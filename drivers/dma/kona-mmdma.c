@@ -0,0 +1,279 @@
+/*
+ * drivers/dma/kona-mmdma.c
+ *
+ * dmaengine memcpy and memset provider on the MM domain VC4lite DMA
+ * (arch/arm/plat-kona/csl/mmdma_drv.c).
+ *
+ * The engine completes on one channel only and its CSL sleeps, so there
+ * is a single dmaengine channel and the descriptors are run one after
+ * the other from a work item, each sleeping until the engine is done.
+ * The channel is not DMA_PRIVATE: async_memcpy and other async_tx
+ * clients find it through dma_find_channel. Only zero fills are done in
+ * hardware; other memset values and copies not aligned to 32 bits are
+ * refused, and the caller falls back to the cpu.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/dmaengine.h>
+#include <linux/err.h>
+#include <linux/init.h>
+#include <linux/interrupt.h>
+#include <linux/list.h>
+#include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/broadcom/mmdma.h>
+
+#include "virt-dma.h"
+
+/* 32-bit beats only */
+#define KONA_MMDMA_ALIGN	2
+
+struct kona_mmdma_desc {
+	struct virt_dma_desc vd;
+	dma_addr_t src;
+	dma_addr_t dst;
+	size_t len;
+	bool zero;
+};
+
+struct kona_mmdma_dev {
+	struct dma_device ddev;
+	struct platform_device *pdev;
+	struct virt_dma_chan vc;
+	struct workqueue_struct *wq;
+	struct work_struct work;
+
+	/* under vc.lock */
+	struct kona_mmdma_desc *desc;	/* on the engine */
+};
+
+static inline struct kona_mmdma_dev *to_kona_mmdma(struct dma_chan *c)
+{
+	return container_of(c, struct kona_mmdma_dev, vc.chan);
+}
+
+static inline struct kona_mmdma_desc *to_kona_mmdma_desc(
+	struct dma_async_tx_descriptor *t)
+{
+	return container_of(t, struct kona_mmdma_desc, vd.tx);
+}
+
+static void kona_mmdma_desc_free(struct virt_dma_desc *vd)
+{
+	kfree(container_of(vd, struct kona_mmdma_desc, vd));
+}
+
+static void kona_mmdma_work(struct work_struct *work)
+{
+	struct kona_mmdma_dev *md = container_of(work, struct kona_mmdma_dev,
+						 work);
+	struct virt_dma_desc *vd;
+	struct kona_mmdma_desc *d;
+	unsigned long flags;
+	int ret;
+
+	for (;;) {
+		spin_lock_irqsave(&md->vc.lock, flags);
+		vd = vchan_next_desc(&md->vc);
+		if (!vd) {
+			spin_unlock_irqrestore(&md->vc.lock, flags);
+			return;
+		}
+		list_del(&vd->node);
+		d = md->desc = to_kona_mmdma_desc(&vd->tx);
+		spin_unlock_irqrestore(&md->vc.lock, flags);
+
+		if (d->zero)
+			ret = mmdma_execute_zero(d->dst, d->len);
+		else
+			ret = mmdma_execute(d->src, d->dst, d->len);
+		if (ret)
+			dev_err(md->ddev.dev, "%s of %zu bytes failed: %d\n",
+				d->zero ? "zero" : "copy", d->len, ret);
+
+		spin_lock_irqsave(&md->vc.lock, flags);
+		md->desc = NULL;
+		vchan_cookie_complete(&d->vd);
+		spin_unlock_irqrestore(&md->vc.lock, flags);
+	}
+}
+
+static int kona_mmdma_alloc_chan_resources(struct dma_chan *chan)
+{
+	return 0;
+}
+
+static int kona_mmdma_terminate_all(struct kona_mmdma_dev *md)
+{
+	unsigned long flags;
+	LIST_HEAD(head);
+
+	/* the descriptor on the engine cannot be stopped, it completes */
+	spin_lock_irqsave(&md->vc.lock, flags);
+	vchan_get_all_descriptors(&md->vc, &head);
+	spin_unlock_irqrestore(&md->vc.lock, flags);
+	vchan_dma_desc_free_list(&md->vc, &head);
+
+	return 0;
+}
+
+static void kona_mmdma_free_chan_resources(struct dma_chan *chan)
+{
+	struct kona_mmdma_dev *md = to_kona_mmdma(chan);
+
+	kona_mmdma_terminate_all(md);
+	flush_work(&md->work);
+	vchan_free_chan_resources(&md->vc);
+}
+
+static enum dma_status kona_mmdma_tx_status(struct dma_chan *chan,
+	dma_cookie_t cookie, struct dma_tx_state *txstate)
+{
+	struct kona_mmdma_dev *md = to_kona_mmdma(chan);
+	struct virt_dma_desc *vd;
+	enum dma_status ret;
+	unsigned long flags;
+
+	ret = dma_cookie_status(chan, cookie, txstate);
+	if (ret == DMA_SUCCESS || !txstate)
+		return ret;
+
+	spin_lock_irqsave(&md->vc.lock, flags);
+	vd = vchan_find_desc(&md->vc, cookie);
+	if (vd)
+		txstate->residue = to_kona_mmdma_desc(&vd->tx)->len;
+	else if (md->desc && md->desc->vd.tx.cookie == cookie)
+		txstate->residue = md->desc->len;
+	else
+		txstate->residue = 0;
+	spin_unlock_irqrestore(&md->vc.lock, flags);
+
+	return ret;
+}
+
+static void kona_mmdma_issue_pending(struct dma_chan *chan)
+{
+	struct kona_mmdma_dev *md = to_kona_mmdma(chan);
+	unsigned long flags;
+
+	spin_lock_irqsave(&md->vc.lock, flags);
+	if (vchan_issue_pending(&md->vc))
+		queue_work(md->wq, &md->work);
+	spin_unlock_irqrestore(&md->vc.lock, flags);
+}
+
+static struct dma_async_tx_descriptor *kona_mmdma_prep(struct dma_chan *chan,
+	dma_addr_t dst, dma_addr_t src, size_t len, bool zero,
+	unsigned long flags)
+{
+	struct kona_mmdma_dev *md = to_kona_mmdma(chan);
+	struct kona_mmdma_desc *d;
+
+	if (!len || ((dst | src | len) & ((1 << KONA_MMDMA_ALIGN) - 1)))
+		return NULL;
+
+	d = kzalloc(sizeof(*d), GFP_NOWAIT);
+	if (!d)
+		return NULL;
+	d->src = src;
+	d->dst = dst;
+	d->len = len;
+	d->zero = zero;
+
+	return vchan_tx_prep(&md->vc, &d->vd, flags);
+}
+
+static struct dma_async_tx_descriptor *kona_mmdma_prep_dma_memcpy(
+	struct dma_chan *chan, dma_addr_t dst, dma_addr_t src, size_t len,
+	unsigned long flags)
+{
+	return kona_mmdma_prep(chan, dst, src, len, false, flags);
+}
+
+static struct dma_async_tx_descriptor *kona_mmdma_prep_dma_memset(
+	struct dma_chan *chan, dma_addr_t dst, int value, size_t len,
+	unsigned long flags)
+{
+	if (value)
+		return NULL;
+	return kona_mmdma_prep(chan, dst, 0, len, true, flags);
+}
+
+static int kona_mmdma_control(struct dma_chan *chan, enum dma_ctrl_cmd cmd,
+			      unsigned long arg)
+{
+	switch (cmd) {
+	case DMA_TERMINATE_ALL:
+		return kona_mmdma_terminate_all(to_kona_mmdma(chan));
+
+	default:
+		return -ENXIO;
+	}
+}
+
+static int __init kona_mmdma_init(void)
+{
+	struct kona_mmdma_dev *md;
+	int ret;
+
+	md = kzalloc(sizeof(*md), GFP_KERNEL);
+	if (!md)
+		return -ENOMEM;
+
+	/* ordered: the engine takes one transfer at a time */
+	md->wq = alloc_ordered_workqueue("kona_mmdma", WQ_MEM_RECLAIM);
+	if (!md->wq) {
+		ret = -ENOMEM;
+		goto err_wq;
+	}
+	INIT_WORK(&md->work, kona_mmdma_work);
+
+	md->pdev = platform_device_register_simple("kona-mmdma", -1, NULL, 0);
+	if (IS_ERR(md->pdev)) {
+		ret = PTR_ERR(md->pdev);
+		goto err_pdev;
+	}
+
+	dma_cap_set(DMA_MEMCPY, md->ddev.cap_mask);
+	dma_cap_set(DMA_MEMSET, md->ddev.cap_mask);
+	md->ddev.copy_align = KONA_MMDMA_ALIGN;
+	md->ddev.fill_align = KONA_MMDMA_ALIGN;
+	md->ddev.device_alloc_chan_resources = kona_mmdma_alloc_chan_resources;
+	md->ddev.device_free_chan_resources = kona_mmdma_free_chan_resources;
+	md->ddev.device_tx_status = kona_mmdma_tx_status;
+	md->ddev.device_issue_pending = kona_mmdma_issue_pending;
+	md->ddev.device_prep_dma_memcpy = kona_mmdma_prep_dma_memcpy;
+	md->ddev.device_prep_dma_memset = kona_mmdma_prep_dma_memset;
+	md->ddev.device_control = kona_mmdma_control;
+	md->ddev.dev = &md->pdev->dev;
+	INIT_LIST_HEAD(&md->ddev.channels);
+
+	md->vc.desc_free = kona_mmdma_desc_free;
+	vchan_init(&md->vc, &md->ddev);
+
+	ret = dma_async_device_register(&md->ddev);
+	if (ret) {
+		pr_err("kona-mmdma: dma_async_device_register failed: %d\n",
+		       ret);
+		goto err_register;
+	}
+
+	dev_info(&md->pdev->dev, "dmaengine memcpy/memset on mmdma\n");
+	return 0;
+
+err_register:
+	tasklet_kill(&md->vc.task);
+	platform_device_unregister(md->pdev);
+err_pdev:
+	destroy_workqueue(md->wq);
+err_wq:
+	kfree(md);
+	return ret;
+}
+/* after init_mmdma has set up the engine */
+late_initcall(kona_mmdma_init);
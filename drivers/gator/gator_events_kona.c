@@ -0,0 +1,375 @@
+/**
+ * Kona power state: power islands on and off with their OPP, CCU clocks
+ * on and off, and the MEMC DFS OPP. The MM DVFS level is the OPP of the
+ * MM island.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#include "gator.h"
+#include <linux/err.h>
+#include <linux/math64.h>
+#include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <plat/clock.h>
+#include <plat/pi_mgr.h>
+#include <plat/pwr_mgr.h>
+#include <trace/events/kona_clk.h>
+#ifdef CONFIG_MEMC_DFS
+#include <trace/events/kona_memc.h>
+#endif
+
+#define KONA_CCU_MAX	(PI_MGR_PI_ID_MAX * MAX_CCU_PER_PI)
+#define KONA_ITEMS_MAX	(PI_MGR_PI_ID_MAX + KONA_CCU_MAX + 1)
+
+enum {
+	KONA_ON = 0,	// time on since the last read, us
+	KONA_OPP,	// current OPP
+	KONA_TRANS,	// transitions since the last read
+	KONA_COUNTERS
+};
+
+static const char *kona_suffix[KONA_COUNTERS] = {
+	"on", "opp", "trans"
+};
+
+struct kona_item {
+	const char *prefix;
+	const char *name;
+	unsigned int counters;	// mask of the counters it has
+	int pi_id;
+	struct clk *clk;
+	// under kona_lock
+	bool on;
+	bool opp_known;
+	u32 opp;
+	u64 since;		// local_clock() at the last change of on
+	u64 on_ns;		// time on up to since
+	u32 trans;
+	// at the last read
+	u64 on_ns_read;
+	u32 trans_read;
+};
+
+static struct kona_item kona_items[KONA_ITEMS_MAX];
+static int kona_count;
+static struct kona_item *kona_pi[PI_MGR_PI_ID_MAX];
+static ulong kona_enabled[KONA_ITEMS_MAX][KONA_COUNTERS];
+static ulong kona_key[KONA_ITEMS_MAX][KONA_COUNTERS];
+static int kona_get[KONA_ITEMS_MAX * KONA_COUNTERS * 2];
+static struct notifier_block kona_dfs_nb[PI_MGR_PI_ID_MAX];
+static struct notifier_block kona_pol_nb[PI_MGR_PI_ID_MAX];
+#ifdef CONFIG_MEMC_DFS
+static struct kona_item *kona_memc;
+#endif
+static DEFINE_SPINLOCK(kona_lock);
+
+static void kona_set_on(struct kona_item *item, bool on)
+{
+	u64 now;
+
+	if (item->on == on)
+		return;
+	now = local_clock();
+	if (item->on)
+		item->on_ns += now - item->since;
+	item->since = now;
+	item->on = on;
+	item->trans++;
+}
+
+static void kona_set_opp(struct kona_item *item, u32 opp)
+{
+	if (item->opp_known && item->opp == opp)
+		return;
+	item->opp = opp;
+	item->opp_known = true;
+	item->trans++;
+}
+
+static int kona_dfs_notify(struct notifier_block *nb, unsigned long event, void *data)
+{
+	struct pi_notify_param *p = data;
+	unsigned long flags;
+
+	if (event != PI_POSTCHANGE) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&kona_lock, flags);
+	kona_set_opp(kona_pi[p->pi_id], p->new_value);
+	spin_unlock_irqrestore(&kona_lock, flags);
+	return 0;
+}
+
+static int kona_pol_notify(struct notifier_block *nb, unsigned long event, void *data)
+{
+	struct pi_notify_param *p = data;
+	unsigned long flags;
+
+	if (event != PI_POSTCHANGE) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&kona_lock, flags);
+	kona_set_on(kona_pi[p->pi_id], IS_ACTIVE_POLICY(p->new_value));
+	spin_unlock_irqrestore(&kona_lock, flags);
+	return 0;
+}
+
+GATOR_DEFINE_PROBE(ccu_clk_enable, TP_PROTO(const char *name, int enable))
+{
+	unsigned long flags;
+	int i;
+
+	// clk->name is what the clock code passes, compare the pointers
+	for (i = 0; i < kona_count; i++) {
+		if (kona_items[i].clk && kona_items[i].clk->name == name) {
+			spin_lock_irqsave(&kona_lock, flags);
+			kona_set_on(&kona_items[i], enable);
+			spin_unlock_irqrestore(&kona_lock, flags);
+			break;
+		}
+	}
+}
+
+#ifdef CONFIG_MEMC_DFS
+GATOR_DEFINE_PROBE(memc_dfs_change, TP_PROTO(u32 old_opp, u32 new_opp))
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&kona_lock, flags);
+	kona_set_opp(kona_memc, new_opp);
+	spin_unlock_irqrestore(&kona_lock, flags);
+}
+#endif
+
+static int gator_events_kona_create_files(struct super_block *sb, struct dentry *root)
+{
+	struct dentry *dir;
+	char buf[40];
+	int i, j;
+
+	for (i = 0; i < kona_count; i++) {
+		for (j = 0; j < KONA_COUNTERS; j++) {
+			if (!(kona_items[i].counters & (1 << j))) {
+				continue;
+			}
+			if (kona_items[i].name) {
+				snprintf(buf, sizeof(buf), "Kona_%s_%s_%s", kona_items[i].prefix, kona_items[i].name, kona_suffix[j]);
+			} else {
+				snprintf(buf, sizeof(buf), "Kona_%s_%s", kona_items[i].prefix, kona_suffix[j]);
+			}
+			dir = gatorfs_mkdir(sb, root, buf);
+			if (!dir) {
+				return -1;
+			}
+			gatorfs_create_ulong(sb, dir, "enabled", &kona_enabled[i][j]);
+			gatorfs_create_ro_ulong(sb, dir, "key", &kona_key[i][j]);
+		}
+	}
+
+	return 0;
+}
+
+static int gator_events_kona_start(void)
+{
+	struct kona_item *item;
+	u64 now = local_clock();
+	int i;
+
+	// nothing is registered yet, no locking needed
+	for (i = 0; i < kona_count; i++) {
+		item = &kona_items[i];
+		item->on_ns = 0;
+		item->since = now;
+		item->trans = 0;
+		item->on_ns_read = 0;
+		item->trans_read = 0;
+		item->opp_known = false;
+		if (item->clk) {
+			item->on = item->clk->use_cnt > 0;
+		} else if (item->pi_id >= 0) {
+			item->on = pi_get_use_count(item->pi_id) > 0;
+			item->opp = pi_get_active_opp(item->pi_id);
+			item->opp_known = true;
+		}
+	}
+
+	for (i = 0; i < PI_MGR_PI_ID_MAX; i++) {
+		if (!kona_pi[i]) {
+			continue;
+		}
+		kona_dfs_nb[i].notifier_call = kona_dfs_notify;
+		kona_pol_nb[i].notifier_call = kona_pol_notify;
+		pi_mgr_register_notifier(i, &kona_dfs_nb[i], PI_NOTIFY_DFS_CHANGE);
+		pi_mgr_register_notifier(i, &kona_pol_nb[i], PI_NOTIFY_POLICY_CHANGE);
+	}
+	if (GATOR_REGISTER_TRACE(ccu_clk_enable)) {
+		goto fail_ccu;
+	}
+#ifdef CONFIG_MEMC_DFS
+	if (GATOR_REGISTER_TRACE(memc_dfs_change)) {
+		goto fail_memc;
+	}
+#endif
+
+	return 0;
+
+#ifdef CONFIG_MEMC_DFS
+fail_memc:
+	GATOR_UNREGISTER_TRACE(ccu_clk_enable);
+#endif
+fail_ccu:
+	for (i = 0; i < PI_MGR_PI_ID_MAX; i++) {
+		if (kona_pi[i]) {
+			pi_mgr_unregister_notifier(i, &kona_dfs_nb[i], PI_NOTIFY_DFS_CHANGE);
+			pi_mgr_unregister_notifier(i, &kona_pol_nb[i], PI_NOTIFY_POLICY_CHANGE);
+		}
+	}
+	pr_err("gator: kona tracepoints failed to activate, please verify that tracepoints are enabled in the linux kernel\n");
+	return -1;
+}
+
+static void gator_events_kona_stop(void)
+{
+	int i;
+
+#ifdef CONFIG_MEMC_DFS
+	GATOR_UNREGISTER_TRACE(memc_dfs_change);
+#endif
+	GATOR_UNREGISTER_TRACE(ccu_clk_enable);
+	for (i = 0; i < PI_MGR_PI_ID_MAX; i++) {
+		if (kona_pi[i]) {
+			pi_mgr_unregister_notifier(i, &kona_dfs_nb[i], PI_NOTIFY_DFS_CHANGE);
+			pi_mgr_unregister_notifier(i, &kona_pol_nb[i], PI_NOTIFY_POLICY_CHANGE);
+		}
+	}
+	memset(kona_enabled, 0, sizeof(kona_enabled));
+}
+
+static int gator_events_kona_read(int **buffer)
+{
+	struct kona_item *item;
+	unsigned long flags;
+	u64 now, on_ns;
+	u32 trans;
+	int len = 0, i;
+
+	if (!on_primary_core()) {
+		return 0;
+	}
+
+	spin_lock_irqsave(&kona_lock, flags);
+	now = local_clock();
+	for (i = 0; i < kona_count; i++) {
+		item = &kona_items[i];
+
+		on_ns = item->on_ns + (item->on ? now - item->since : 0);
+		if (kona_enabled[i][KONA_ON]) {
+			kona_get[len++] = kona_key[i][KONA_ON];
+			kona_get[len++] = (int)div_u64(on_ns - item->on_ns_read, NSEC_PER_USEC);
+		}
+		item->on_ns_read = on_ns;
+
+		if (kona_enabled[i][KONA_OPP] && item->opp_known) {
+			kona_get[len++] = kona_key[i][KONA_OPP];
+			kona_get[len++] = item->opp;
+		}
+
+		trans = item->trans;
+		if (kona_enabled[i][KONA_TRANS]) {
+			kona_get[len++] = kona_key[i][KONA_TRANS];
+			kona_get[len++] = trans - item->trans_read;
+		}
+		item->trans_read = trans;
+	}
+	spin_unlock_irqrestore(&kona_lock, flags);
+
+	if (buffer)
+		*buffer = kona_get;
+
+	return len;
+}
+
+static struct gator_interface gator_events_kona_interface = {
+	.create_files = gator_events_kona_create_files,
+	.start = gator_events_kona_start,
+	.stop = gator_events_kona_stop,
+	.read = gator_events_kona_read,
+};
+
+static struct kona_item *kona_item_add(const char *prefix, const char *name, unsigned int counters)
+{
+	struct kona_item *item = &kona_items[kona_count++];
+
+	item->prefix = prefix;
+	item->name = name;
+	item->counters = counters;
+	item->pi_id = -1;
+	return item;
+}
+
+int gator_events_kona_init(void)
+{
+	struct kona_item *item;
+	struct pi *pi;
+	int i, j, k;
+
+	if (!pi_mgr_initialized()) {
+		return -1;
+	}
+
+	for (i = 0; i < PI_MGR_PI_ID_MAX; i++) {
+		pi = pi_mgr_get(i);
+		if (!pi) {
+			continue;
+		}
+		item = kona_item_add("pi", pi->name, (1 << KONA_ON) | (1 << KONA_OPP) | (1 << KONA_TRANS));
+		item->pi_id = i;
+		kona_pi[i] = item;
+	}
+
+	for (i = 0; i < PI_MGR_PI_ID_MAX; i++) {
+		if (!kona_pi[i]) {
+			continue;
+		}
+		pi = pi_mgr_get(i);
+		for (j = 0; j < pi->num_ccu_id && j < MAX_CCU_PER_PI; j++) {
+			if (IS_ERR_OR_NULL(pi->pi_ccu[j])) {
+				continue;
+			}
+			// a CCU may be in more than one island
+			for (k = 0; k < kona_count; k++) {
+				if (kona_items[k].clk == pi->pi_ccu[j]) {
+					break;
+				}
+			}
+			if (k < kona_count) {
+				continue;
+			}
+			item = kona_item_add("ccu", pi->pi_ccu[j]->name, (1 << KONA_ON) | (1 << KONA_TRANS));
+			item->clk = pi->pi_ccu[j];
+		}
+	}
+
+#ifdef CONFIG_MEMC_DFS
+	kona_memc = kona_item_add("memc", NULL, (1 << KONA_OPP) | (1 << KONA_TRANS));
+#endif
+
+	for (i = 0; i < kona_count; i++) {
+		for (j = 0; j < KONA_COUNTERS; j++) {
+			kona_enabled[i][j] = 0;
+			if (kona_items[i].counters & (1 << j)) {
+				kona_key[i][j] = gator_events_get_key();
+			}
+		}
+	}
+
+	return gator_events_install(&gator_events_kona_interface);
+}
+
+gator_events_init(gator_events_kona_init);
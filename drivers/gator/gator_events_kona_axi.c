@@ -0,0 +1,129 @@
+/**
+ * AXI bandwidth and latency of the Kona masters, from the axitrace
+ * profiler (CONFIG_KONA_AXITRACE_PROF).
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#include "gator.h"
+#include <linux/math64.h>
+#include <mach/axitrace.h>
+
+enum {
+	KONA_AXI_RD = 0,
+	KONA_AXI_WR,
+	KONA_AXI_RDLAT,
+	KONA_AXI_COUNTERS
+};
+
+static const char *kona_axi_suffix[KONA_AXI_COUNTERS] = {
+	"rd", "wr", "rdlat"
+};
+
+static int kona_axi_count;
+static const char *kona_axi_name[AXITRACE_PROF_SOURCES];
+static ulong kona_axi_enabled[AXITRACE_PROF_SOURCES][KONA_AXI_COUNTERS];
+static ulong kona_axi_key[AXITRACE_PROF_SOURCES][KONA_AXI_COUNTERS];
+static u64 kona_axi_prev[AXITRACE_PROF_SOURCES][AXITRACE_PROF_CNTRS];
+static u64 kona_axi_now[AXITRACE_PROF_SOURCES][AXITRACE_PROF_CNTRS];
+static int kona_axi_get[AXITRACE_PROF_SOURCES * KONA_AXI_COUNTERS * 2];
+
+static int gator_events_kona_axi_create_files(struct super_block *sb, struct dentry *root)
+{
+	struct dentry *dir;
+	char buf[40];
+	int i, j;
+
+	for (i = 0; i < kona_axi_count; i++) {
+		for (j = 0; j < KONA_AXI_COUNTERS; j++) {
+			snprintf(buf, sizeof(buf), "Kona_axi_%s_%s", kona_axi_name[i], kona_axi_suffix[j]);
+			dir = gatorfs_mkdir(sb, root, buf);
+			if (!dir) {
+				return -1;
+			}
+			gatorfs_create_ulong(sb, dir, "enabled", &kona_axi_enabled[i][j]);
+			gatorfs_create_ro_ulong(sb, dir, "key", &kona_axi_key[i][j]);
+		}
+	}
+
+	return 0;
+}
+
+static int gator_events_kona_axi_start(void)
+{
+	axitrace_prof_read(kona_axi_prev, kona_axi_count);
+	return 0;
+}
+
+static void gator_events_kona_axi_stop(void)
+{
+	memset(kona_axi_enabled, 0, sizeof(kona_axi_enabled));
+}
+
+static int gator_events_kona_axi_read(int **buffer)
+{
+	u64 d[AXITRACE_PROF_CNTRS];
+	int len = 0, i, j;
+
+	if (!on_primary_core()) {
+		return 0;
+	}
+
+	axitrace_prof_read(kona_axi_now, kona_axi_count);
+	for (i = 0; i < kona_axi_count; i++) {
+		for (j = 0; j < AXITRACE_PROF_CNTRS; j++) {
+			d[j] = kona_axi_now[i][j] - kona_axi_prev[i][j];
+			kona_axi_prev[i][j] = kona_axi_now[i][j];
+		}
+
+		if (kona_axi_enabled[i][KONA_AXI_RD]) {
+			kona_axi_get[len++] = kona_axi_key[i][KONA_AXI_RD];
+			kona_axi_get[len++] = (int)(d[AXITRACE_PROF_RDBEATS] * AXITRACE_BEAT_BYTES);
+		}
+		if (kona_axi_enabled[i][KONA_AXI_WR]) {
+			kona_axi_get[len++] = kona_axi_key[i][KONA_AXI_WR];
+			kona_axi_get[len++] = (int)(d[AXITRACE_PROF_WRBEATS] * AXITRACE_BEAT_BYTES);
+		}
+		// average cycles per read command since the last read
+		if (kona_axi_enabled[i][KONA_AXI_RDLAT] && d[AXITRACE_PROF_RDCMDS]) {
+			kona_axi_get[len++] = kona_axi_key[i][KONA_AXI_RDLAT];
+			kona_axi_get[len++] = (int)div64_u64(d[AXITRACE_PROF_RDLAT], d[AXITRACE_PROF_RDCMDS]);
+		}
+	}
+
+	if (buffer)
+		*buffer = kona_axi_get;
+
+	return len;
+}
+
+static struct gator_interface gator_events_kona_axi_interface = {
+	.create_files = gator_events_kona_axi_create_files,
+	.start = gator_events_kona_axi_start,
+	.stop = gator_events_kona_axi_stop,
+	.read = gator_events_kona_axi_read,
+};
+
+int gator_events_kona_axi_init(void)
+{
+	int i, j;
+
+	kona_axi_count = axitrace_prof_sources(kona_axi_name, AXITRACE_PROF_SOURCES);
+	if (!kona_axi_count) {
+		return -1;
+	}
+
+	for (i = 0; i < kona_axi_count; i++) {
+		for (j = 0; j < KONA_AXI_COUNTERS; j++) {
+			kona_axi_enabled[i][j] = 0;
+			kona_axi_key[i][j] = gator_events_get_key();
+		}
+	}
+
+	return gator_events_install(&gator_events_kona_axi_interface);
+}
+
+gator_events_init(gator_events_kona_axi_init);
@@ -0,0 +1,183 @@
+/**
+ * Kona MM framework cores (job queue depth, busy time, jobs completed)
+ * and the V3D performance counters of the bin/render jobs.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ */
+
+#include "gator.h"
+#include <linux/broadcom/mm_fw_hw_ifc.h>
+
+#define KONA_MM_CORES 16
+
+enum {
+	KONA_MM_QUEUE = 0,
+	KONA_MM_BUSY,
+	KONA_MM_JOBS,
+	KONA_MM_COUNTERS
+};
+
+static const char *kona_mm_suffix[KONA_MM_COUNTERS] = {
+	"queue", "busy", "jobs"
+};
+
+static int kona_mm_count;
+static ulong kona_mm_enabled[KONA_MM_CORES][KONA_MM_COUNTERS];
+static ulong kona_mm_key[KONA_MM_CORES][KONA_MM_COUNTERS];
+static mm_fmwk_core_stats_t kona_mm_prev[KONA_MM_CORES];
+static mm_fmwk_core_stats_t kona_mm_now[KONA_MM_CORES];
+
+static ulong kona_v3d_enabled[V3D_PERF_COUNTERS];
+static ulong kona_v3d_key[V3D_PERF_COUNTERS];
+static ulong kona_v3d_event[V3D_PERF_COUNTERS];
+static int kona_v3d_count;
+static u64 kona_v3d_prev[V3D_PERF_COUNTERS];
+static u64 kona_v3d_now[V3D_PERF_COUNTERS];
+
+static int kona_mm_get[(KONA_MM_CORES * KONA_MM_COUNTERS + V3D_PERF_COUNTERS) * 2];
+
+static int gator_events_kona_mm_create_files(struct super_block *sb, struct dentry *root)
+{
+	struct dentry *dir;
+	char buf[40];
+	char *p;
+	int i, j;
+
+	// a built-in gator may initialise before the MM cores register
+	kona_mm_count = mm_fmwk_core_stats(kona_mm_prev, KONA_MM_CORES);
+	for (i = 0; i < kona_mm_count; i++) {
+		for (j = 0; j < KONA_MM_COUNTERS; j++) {
+			snprintf(buf, sizeof(buf), "Kona_mm_%s_%s", kona_mm_prev[i].name, kona_mm_suffix[j]);
+			// core names are "device:core"
+			for (p = buf; *p; p++) {
+				if (*p == ':') {
+					*p = '_';
+				}
+			}
+			dir = gatorfs_mkdir(sb, root, buf);
+			if (!dir) {
+				return -1;
+			}
+			gatorfs_create_ulong(sb, dir, "enabled", &kona_mm_enabled[i][j]);
+			gatorfs_create_ro_ulong(sb, dir, "key", &kona_mm_key[i][j]);
+		}
+	}
+
+	for (i = 0; i < V3D_PERF_COUNTERS; i++) {
+		snprintf(buf, sizeof(buf), "Kona_v3d_cnt%d", i);
+		dir = gatorfs_mkdir(sb, root, buf);
+		if (!dir) {
+			return -1;
+		}
+		gatorfs_create_ulong(sb, dir, "enabled", &kona_v3d_enabled[i]);
+		gatorfs_create_ulong(sb, dir, "event", &kona_v3d_event[i]);
+		gatorfs_create_ro_ulong(sb, dir, "key", &kona_v3d_key[i]);
+	}
+
+	return 0;
+}
+
+static int gator_events_kona_mm_start(void)
+{
+	u32 events[V3D_PERF_COUNTERS];
+	int i;
+
+	kona_mm_count = mm_fmwk_core_stats(kona_mm_prev, KONA_MM_CORES);
+
+	// the enabled counters are packed into the first V3D counters
+	kona_v3d_count = 0;
+	for (i = 0; i < V3D_PERF_COUNTERS; i++) {
+		if (kona_v3d_enabled[i]) {
+			events[kona_v3d_count++] = kona_v3d_event[i];
+		}
+	}
+	memset(kona_v3d_prev, 0, sizeof(kona_v3d_prev));
+	if (kona_v3d_count) {
+		return v3d_perf_start(events, kona_v3d_count);
+	}
+
+	return 0;
+}
+
+static void gator_events_kona_mm_stop(void)
+{
+	if (kona_v3d_count) {
+		v3d_perf_stop();
+	}
+	kona_v3d_count = 0;
+	memset(kona_mm_enabled, 0, sizeof(kona_mm_enabled));
+	memset(kona_v3d_enabled, 0, sizeof(kona_v3d_enabled));
+}
+
+static int gator_events_kona_mm_read(int **buffer)
+{
+	int len = 0, i, j, n;
+
+	if (!on_primary_core()) {
+		return 0;
+	}
+
+	n = mm_fmwk_core_stats(kona_mm_now, KONA_MM_CORES);
+	for (i = 0; i < n && i < kona_mm_count; i++) {
+		if (kona_mm_enabled[i][KONA_MM_QUEUE]) {
+			kona_mm_get[len++] = kona_mm_key[i][KONA_MM_QUEUE];
+			kona_mm_get[len++] = kona_mm_now[i].queued;
+		}
+		if (kona_mm_enabled[i][KONA_MM_BUSY]) {
+			kona_mm_get[len++] = kona_mm_key[i][KONA_MM_BUSY];
+			kona_mm_get[len++] = kona_mm_now[i].busy_us - kona_mm_prev[i].busy_us;
+		}
+		if (kona_mm_enabled[i][KONA_MM_JOBS]) {
+			kona_mm_get[len++] = kona_mm_key[i][KONA_MM_JOBS];
+			kona_mm_get[len++] = kona_mm_now[i].jobs_done - kona_mm_prev[i].jobs_done;
+		}
+		kona_mm_prev[i] = kona_mm_now[i];
+	}
+
+	n = v3d_perf_read(kona_v3d_now, kona_v3d_count);
+	for (i = 0, j = 0; i < V3D_PERF_COUNTERS && j < n; i++) {
+		if (!kona_v3d_enabled[i]) {
+			continue;
+		}
+		kona_mm_get[len++] = kona_v3d_key[i];
+		kona_mm_get[len++] = (int)(kona_v3d_now[j] - kona_v3d_prev[j]);
+		kona_v3d_prev[j] = kona_v3d_now[j];
+		j++;
+	}
+
+	if (buffer)
+		*buffer = kona_mm_get;
+
+	return len;
+}
+
+static struct gator_interface gator_events_kona_mm_interface = {
+	.create_files = gator_events_kona_mm_create_files,
+	.start = gator_events_kona_mm_start,
+	.stop = gator_events_kona_mm_stop,
+	.read = gator_events_kona_mm_read,
+};
+
+int gator_events_kona_mm_init(void)
+{
+	int i, j;
+
+	for (i = 0; i < KONA_MM_CORES; i++) {
+		for (j = 0; j < KONA_MM_COUNTERS; j++) {
+			kona_mm_enabled[i][j] = 0;
+			kona_mm_key[i][j] = gator_events_get_key();
+		}
+	}
+	for (i = 0; i < V3D_PERF_COUNTERS; i++) {
+		kona_v3d_enabled[i] = 0;
+		kona_v3d_event[i] = 0;
+		kona_v3d_key[i] = gator_events_get_key();
+	}
+
+	return gator_events_install(&gator_events_kona_mm_interface);
+}
+
+gator_events_init(gator_events_kona_mm_init);
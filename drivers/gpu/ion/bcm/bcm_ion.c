@@ -28,9 +28,17 @@
 #include <linux/module.h>
 #include <linux/list.h>
 #include <linux/of_platform.h>
+#include <linux/dma-buf.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #ifdef CONFIG_OF
 #include <linux/of.h>
 #endif /* CONFIG_OF */
+#include <linux/moduleparam.h>
+#include <linux/sizes.h>
+#include <linux/smp.h>
+#include <asm/cacheflush.h>
+#include <asm/outercache.h>
 #include <asm/dma-contiguous.h>
 #include <linux/dma-mapping.h>
 #ifdef CONFIG_IOMMU_API
@@ -99,6 +107,226 @@ unsigned int bcm_ion_map_dma(struct ion_client *client,
 }
 EXPORT_SYMBOL(bcm_ion_map_dma);
 
+/*
+ * Device mapping cache
+ *
+ * Buffers posted to a device with its own iovmm (e.g. the display) keep their
+ * device address once mapped, cycling gralloc rings then hit the cache on
+ * every post. Mappings stay until the buffer is freed or the device runs out
+ * of iova space, in which case the least recently used unpinned ones go.
+ */
+struct bcm_ion_map_dev {
+	struct device *dev;
+	struct list_head node;
+	struct list_head lru;
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long evictions;
+	unsigned int nr_maps;
+};
+
+struct bcm_ion_dev_map {
+	struct bcm_ion_map_dev *mdev;
+	struct ion_buffer *buffer;
+	struct list_head buf_node;
+	struct list_head lru_node;
+	dma_addr_t dma_addr;
+	int pin;
+};
+
+static DEFINE_MUTEX(bcm_map_lock);
+static LIST_HEAD(bcm_map_devs);
+
+static struct bcm_ion_map_dev *bcm_ion_map_dev_get(struct device *dev)
+{
+	struct bcm_ion_map_dev *mdev;
+
+	list_for_each_entry(mdev, &bcm_map_devs, node)
+		if (mdev->dev == dev)
+			return mdev;
+
+	mdev = kzalloc(sizeof(*mdev), GFP_KERNEL);
+	if (!mdev)
+		return NULL;
+	mdev->dev = dev;
+	INIT_LIST_HEAD(&mdev->lru);
+	list_add_tail(&mdev->node, &bcm_map_devs);
+	return mdev;
+}
+
+static void bcm_ion_dev_map_free(struct bcm_ion_dev_map *map)
+{
+#ifdef CONFIG_BCM_IOVMM
+	arm_iommu_unmap(map->mdev->dev, map->dma_addr, map->buffer->size);
+#endif
+	pr_debug("%s: unmap buffer(%p) da(%#x)\n", dev_name(map->mdev->dev),
+			map->buffer, map->dma_addr);
+	map->mdev->nr_maps--;
+	list_del(&map->buf_node);
+	list_del(&map->lru_node);
+	kfree(map);
+}
+
+/* Drop the least recently used unpinned mapping of mdev */
+static int bcm_ion_map_dev_evict(struct bcm_ion_map_dev *mdev)
+{
+	struct bcm_ion_dev_map *map;
+
+	list_for_each_entry(map, &mdev->lru, lru_node) {
+		if (map->pin)
+			continue;
+		bcm_ion_dev_map_free(map);
+		mdev->evictions++;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * bcm_ion_map_dma_dev - get the address of an ion dma-buf for a device
+ * @dev:	device with an iovmm mapping attached
+ * @dmabuf:	dma-buf exported by ion
+ * @dma_addr:	returns the device address of the start of the buffer
+ *
+ * The mapping is pinned until bcm_ion_unmap_dma_dev and then kept cached.
+ * Returns -ENOTTY if dmabuf is not an ion buffer.
+ */
+int bcm_ion_map_dma_dev(struct device *dev, struct dma_buf *dmabuf,
+		dma_addr_t *dma_addr)
+{
+	struct ion_buffer *buffer = ion_dma_buf_to_buffer(dmabuf);
+	struct bcm_ion_map_dev *mdev;
+	struct bcm_ion_dev_map *map;
+	int ret = 0;
+
+	if (!buffer)
+		return -ENOTTY;
+
+	mutex_lock(&bcm_map_lock);
+	mdev = bcm_ion_map_dev_get(dev);
+	if (!mdev) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	list_for_each_entry(map, &buffer->dev_maps, buf_node) {
+		if (map->mdev == mdev) {
+			mdev->hits++;
+			goto found;
+		}
+	}
+	mdev->misses++;
+
+	map = kzalloc(sizeof(*map), GFP_KERNEL);
+	if (!map) {
+		ret = -ENOMEM;
+		goto out;
+	}
+#ifdef CONFIG_BCM_IOVMM
+	do {
+		map->dma_addr = arm_iommu_map_sgt(dev, buffer->sg_table, 0);
+	} while ((map->dma_addr == DMA_ERROR_CODE) &&
+			bcm_ion_map_dev_evict(mdev));
+#else
+	map->dma_addr = buffer->dma_addr;
+#endif
+	if ((map->dma_addr == DMA_ERROR_CODE) ||
+			(map->dma_addr == ION_DMA_ADDR_FAIL)) {
+		pr_err("%s: map buffer(%p) size(%#x) failed\n",
+				dev_name(dev), buffer, buffer->size);
+		kfree(map);
+		ret = -ENOMEM;
+		goto out;
+	}
+	pr_debug("%s: map buffer(%p) da(%#x) size(%#x)\n", dev_name(dev),
+			buffer, map->dma_addr, buffer->size);
+	map->mdev = mdev;
+	map->buffer = buffer;
+	list_add(&map->buf_node, &buffer->dev_maps);
+	INIT_LIST_HEAD(&map->lru_node);
+	mdev->nr_maps++;
+found:
+	map->pin++;
+	list_move_tail(&map->lru_node, &mdev->lru);
+	*dma_addr = map->dma_addr;
+out:
+	mutex_unlock(&bcm_map_lock);
+	return ret;
+}
+EXPORT_SYMBOL(bcm_ion_map_dma_dev);
+
+/**
+ * bcm_ion_unmap_dma_dev - unpin a mapping taken by bcm_ion_map_dma_dev
+ *
+ * The device address stays valid for a later bcm_ion_map_dma_dev until the
+ * buffer is freed or the mapping is evicted.
+ */
+void bcm_ion_unmap_dma_dev(struct device *dev, struct dma_buf *dmabuf)
+{
+	struct ion_buffer *buffer = ion_dma_buf_to_buffer(dmabuf);
+	struct bcm_ion_dev_map *map;
+
+	if (!buffer)
+		return;
+
+	mutex_lock(&bcm_map_lock);
+	list_for_each_entry(map, &buffer->dev_maps, buf_node) {
+		if (map->mdev->dev == dev) {
+			WARN_ON(!map->pin);
+			if (map->pin)
+				map->pin--;
+			break;
+		}
+	}
+	mutex_unlock(&bcm_map_lock);
+}
+EXPORT_SYMBOL(bcm_ion_unmap_dma_dev);
+
+/* Called by ion when the buffer is destroyed */
+void bcm_ion_buffer_unmap_all(struct ion_buffer *buffer)
+{
+	struct bcm_ion_dev_map *map, *tmp;
+
+	mutex_lock(&bcm_map_lock);
+	list_for_each_entry_safe(map, tmp, &buffer->dev_maps, buf_node) {
+		WARN_ON(map->pin);
+		bcm_ion_dev_map_free(map);
+	}
+	mutex_unlock(&bcm_map_lock);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int bcm_ion_map_debug_show(struct seq_file *s, void *unused)
+{
+	struct bcm_ion_map_dev *mdev;
+	unsigned long total;
+
+	seq_printf(s, "%16s %8s %10s %10s %10s %6s\n", "device",
+			"maps", "hits", "misses", "evictions", "hit%");
+	mutex_lock(&bcm_map_lock);
+	list_for_each_entry(mdev, &bcm_map_devs, node) {
+		total = mdev->hits + mdev->misses;
+		seq_printf(s, "%16s %8u %10lu %10lu %10lu %6lu\n",
+				dev_name(mdev->dev), mdev->nr_maps,
+				mdev->hits, mdev->misses, mdev->evictions,
+				total ? (mdev->hits * 100) / total : 0);
+	}
+	mutex_unlock(&bcm_map_lock);
+	return 0;
+}
+
+static int bcm_ion_map_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bcm_ion_map_debug_show, inode->i_private);
+}
+
+static const struct file_operations bcm_ion_map_debug_fops = {
+	.open = bcm_ion_map_debug_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static int bcm_ion_set_prop(struct ion_client *client,
 		struct ion_custom_property *data)
 {
@@ -196,6 +424,107 @@ static int bcm_ion_cache_invalidate(struct ion_client *client,
 	return ret;
 }
 
+/*
+ * Above this many bytes in one ION_IOC_CUSTOM_CACHE_OPS call, a flush of
+ * the whole cache is cheaper than walking the regions line by line.
+ */
+static unsigned int cache_all_threshold = SZ_1M;
+module_param(cache_all_threshold, uint, 0644);
+MODULE_PARM_DESC(cache_all_threshold,
+		"Batched cache op size (bytes) above which whole cache is flushed");
+
+static void bcm_ion_flush_cpu_cache(void *info)
+{
+	flush_cache_all();
+}
+
+/*
+ * Returns the number of bytes of @op that need maintenance, 0 if it can be
+ * skipped or a negative error if the region is not valid.
+ */
+static int bcm_ion_cache_op_check(struct ion_client *client,
+		struct ion_custom_cache_op *op)
+{
+	struct ion_buffer *buffer;
+	int ret = -EINVAL;
+
+	if (!op->op || (op->op & ~(ION_CACHE_OP_CLEAN |
+					ION_CACHE_OP_INVALIDATE)))
+		return -EINVAL;
+
+	buffer = ion_lock_buffer(client, op->handle);
+	if (!buffer)
+		return -EINVAL;
+	if (!bcm_is_region_ok(buffer, op->offset, op->len))
+		goto out;
+
+	ret = 0;
+	/* Uncached buffers are only accessed through non cacheable maps */
+	if (!ion_buffer_cached(buffer))
+		goto out;
+	/*
+	 * A buffer never mapped by the cpu cannot hold dirty lines, so a clean
+	 * is a no-op. Invalidates are still done as speculative fills through
+	 * the linear map would be hit by a later mapping.
+	 */
+	if (!buffer->cpu_mapped)
+		op->op &= ~ION_CACHE_OP_CLEAN;
+	if (op->op)
+		ret = op->len;
+out:
+	ion_unlock_buffer(client, buffer);
+	return ret;
+}
+
+static int bcm_ion_cache_ops(struct ion_client *client,
+		struct ion_custom_cache_op *ops, unsigned int count)
+{
+	struct ion_custom_region_data region;
+	unsigned long total = 0;
+	int i, ret;
+
+	for (i = 0; i < count; i++) {
+		ret = bcm_ion_cache_op_check(client, &ops[i]);
+		if (ret < 0) {
+			pr_err("cache op[%d] handle(%p) off(%u) len(%u) op(%u) invalid\n",
+					i, ops[i].handle, ops[i].offset,
+					ops[i].len, ops[i].op);
+			return ret;
+		}
+		if (!ret)
+			ops[i].op = 0;
+		total += ret;
+	}
+	if (!total)
+		return 0;
+
+	if (total >= cache_all_threshold) {
+		pr_debug("cache ops: flush all for %lu bytes\n", total);
+		on_each_cpu(bcm_ion_flush_cpu_cache, NULL, 1);
+		outer_flush_all();
+		return 0;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!ops[i].op)
+			continue;
+		region.handle = ops[i].handle;
+		region.offset = ops[i].offset;
+		region.len = ops[i].len;
+		if (ops[i].op & ION_CACHE_OP_CLEAN) {
+			ret = bcm_ion_cache_clean(client, &region);
+			if (ret)
+				return ret;
+		}
+		if (ops[i].op & ION_CACHE_OP_INVALIDATE) {
+			ret = bcm_ion_cache_invalidate(client, &region);
+			if (ret)
+				return ret;
+		}
+	}
+	return 0;
+}
+
 unsigned int bcm_ion_get_heapmask(unsigned int flags)
 {
 	struct ion_custom_config_data *data = &bcm_ion_config_data;
@@ -450,6 +779,34 @@ static long bcm_ion_custom_ioctl(struct ion_client *client,
 			return -EFAULT;
 		break;
 	}
+	case ION_IOC_CUSTOM_CACHE_OPS:
+	{
+		struct ion_custom_cache_ops data;
+		struct ion_custom_cache_op *ops;
+		int ret;
+
+		if (copy_from_user(&data, (void __user *)arg, sizeof(data)))
+			return -EFAULT;
+
+		pr_debug("ION_IOC_CUSTOM_CACHE_OPS client(%p) count(%u)\n",
+				client, data.count);
+		if (!data.count || (data.count > ION_CACHE_OPS_MAX))
+			return -EINVAL;
+
+		ops = kmalloc(data.count * sizeof(*ops), GFP_KERNEL);
+		if (!ops)
+			return -ENOMEM;
+		if (copy_from_user(ops, (void __user *)data.ops,
+					data.count * sizeof(*ops))) {
+			kfree(ops);
+			return -EFAULT;
+		}
+		ret = bcm_ion_cache_ops(client, ops, data.count);
+		kfree(ops);
+		if (ret)
+			return -EINVAL;
+		break;
+	}
 	case ION_IOC_CUSTOM_GET_CONFIG:
 	{
 		pr_debug("ION_IOC_CUSTOM_GET_CONFIG client(%p)\n", client);
@@ -597,6 +954,21 @@ static struct ion_platform_heap *bcm_ion_parse_dt(struct device *dev)
 		ION_OF_READ_OPT(lmk_min_score_adj);
 		ION_OF_READ_OPT(lmk_min_free);
 	}
+	if (heap_data->type == ION_HEAP_TYPE_SYSTEM) {
+		struct property *prop = of_find_property(node, "orders", NULL);
+		if (prop) {
+			int n = prop->length / sizeof(u32);
+			if ((n > ION_SYSTEM_HEAP_MAX_ORDERS) ||
+					of_property_read_u32_array(node,
+						"orders", heap_data->orders,
+						n)) {
+				pr_err("%16s: Invalid \"orders\"\n",
+						heap_data->name);
+				goto of_err;
+			}
+			heap_data->num_orders = n;
+		}
+	}
 #ifndef CONFIG_BCM_IOVMM
 	if (heap_data->type == ION_HEAP_TYPE_SYSTEM) {
 		pr_err("%16s: Not supported without iovmm\n",
@@ -896,6 +1268,10 @@ static struct platform_driver ion_driver = {
 static int __init ion_init(void)
 {
 	pr_info("Broadcom ION driver init\n");
+#ifdef CONFIG_DEBUG_FS
+	debugfs_create_file("ion_dev_maps", 0444, NULL, NULL,
+			&bcm_ion_map_debug_fops);
+#endif
 	return platform_driver_register(&ion_driver);
 }
 
@@ -123,6 +123,10 @@ struct ion_handle {
 	unsigned int kmap_cnt;
 };
 
+/* buffers and handles come and go with every allocation from user space */
+static struct kmem_cache *ion_buffer_cachep;
+static struct kmem_cache *ion_handle_cachep;
+
 #ifdef CONFIG_ION_BCM
 /**
  * Memory (in bytes) to be freed asynchronously from this heap
@@ -196,7 +200,7 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	struct scatterlist *sg;
 	int i, ret;
 
-	buffer = kzalloc(sizeof(struct ion_buffer), GFP_KERNEL);
+	buffer = kmem_cache_zalloc(ion_buffer_cachep, GFP_KERNEL);
 	if (!buffer)
 		return ERR_PTR(-ENOMEM);
 
@@ -204,6 +208,7 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	buffer->flags = flags;
 #ifdef CONFIG_ION_BCM
 	buffer->align = align;
+	INIT_LIST_HEAD(&buffer->dev_maps);
 #endif
 	kref_init(&buffer->ref);
 
@@ -226,7 +231,7 @@ static struct ion_buffer *ion_buffer_create(struct ion_heap *heap,
 	table = heap->ops->map_dma(heap, buffer);
 	if (IS_ERR_OR_NULL(table)) {
 		heap->ops->free(buffer);
-		kfree(buffer);
+		kmem_cache_free(ion_buffer_cachep, buffer);
 		return ERR_PTR(PTR_ERR(table));
 	}
 	buffer->sg_table = table;
@@ -269,7 +274,7 @@ err:
 	heap->ops->unmap_dma(heap, buffer);
 	heap->ops->free(buffer);
 err2:
-	kfree(buffer);
+	kmem_cache_free(ion_buffer_cachep, buffer);
 	return ERR_PTR(ret);
 }
 
@@ -282,6 +287,9 @@ static void _ion_buffer_destroy(struct ion_buffer *buffer)
 #endif
 	if (WARN_ON(buffer->kmap_cnt > 0))
 		buffer->heap->ops->unmap_kernel(buffer->heap, buffer);
+#ifdef CONFIG_ION_BCM
+	bcm_ion_buffer_unmap_all(buffer);
+#endif
 	buffer->heap->ops->unmap_dma(buffer->heap, buffer);
 	buffer->heap->ops->free(buffer);
 #ifdef CONFIG_ION_BCM
@@ -295,7 +303,7 @@ static void _ion_buffer_destroy(struct ion_buffer *buffer)
 #endif
 	if (buffer->flags & ION_FLAG_CACHED)
 		kfree(buffer->dirty);
-	kfree(buffer);
+	kmem_cache_free(ion_buffer_cachep, buffer);
 }
 
 static void ion_buffer_destroy(struct kref *kref)
@@ -366,7 +374,7 @@ static struct ion_handle *ion_handle_create(struct ion_client *client,
 {
 	struct ion_handle *handle;
 
-	handle = kzalloc(sizeof(struct ion_handle), GFP_KERNEL);
+	handle = kmem_cache_zalloc(ion_handle_cachep, GFP_KERNEL);
 	if (!handle)
 		return ERR_PTR(-ENOMEM);
 	kref_init(&handle->ref);
@@ -407,7 +415,7 @@ static void ion_handle_destroy(struct kref *kref)
 		buffer->heap->name, buffer->heap->used>>10);
 	ion_buffer_put(buffer);
 
-	kfree(handle);
+	kmem_cache_free(ion_handle_cachep, handle);
 }
 
 struct ion_buffer *ion_handle_buffer(struct ion_handle *handle)
@@ -916,6 +924,9 @@ static void *ion_buffer_kmap_get(struct ion_buffer *buffer)
 		return vaddr;
 	buffer->vaddr = vaddr;
 	buffer->kmap_cnt++;
+#ifdef CONFIG_ION_BCM
+	buffer->cpu_mapped = true;
+#endif
 	return vaddr;
 }
 
@@ -1333,6 +1344,12 @@ static int ion_mmap(struct dma_buf *dmabuf, struct vm_area_struct *vma)
 		return -EINVAL;
 	}
 
+#ifdef CONFIG_ION_BCM
+	mutex_lock(&buffer->lock);
+	buffer->cpu_mapped = true;
+	mutex_unlock(&buffer->lock);
+#endif
+
 	if (ion_buffer_fault_user_mappings(buffer)) {
 		vma->vm_private_data = buffer;
 		vma->vm_ops = &ion_vma_ops;
@@ -1885,6 +1902,13 @@ struct ion_device *ion_device_create(long (*custom_ioctl)
 	struct ion_device *idev;
 	int ret;
 
+	if (!ion_buffer_cachep)
+		ion_buffer_cachep = KMEM_CACHE(ion_buffer, SLAB_HWCACHE_ALIGN);
+	if (!ion_handle_cachep)
+		ion_handle_cachep = KMEM_CACHE(ion_handle, SLAB_HWCACHE_ALIGN);
+	if (!ion_buffer_cachep || !ion_handle_cachep)
+		return ERR_PTR(-ENOMEM);
+
 	idev = kzalloc(sizeof(struct ion_device), GFP_KERNEL);
 	if (!idev)
 		return ERR_PTR(-ENOMEM);
@@ -1989,6 +2013,14 @@ void ion_unlock_buffer(struct ion_client *client,
 	mutex_unlock(&client->lock);
 }
 
+/* Returns the ion buffer behind dmabuf, NULL if it was not exported by ion */
+struct ion_buffer *ion_dma_buf_to_buffer(struct dma_buf *dmabuf)
+{
+	if (dmabuf->ops != &dma_buf_ops)
+		return NULL;
+	return dmabuf->priv;
+}
+
 /* Get the ion client if present for the pid.
  *
  * Note: If multiple clients are present for same process, only the first
@@ -37,6 +37,17 @@
 #include <plat/bcm_iommu.h>
 #endif
 
+#include <linux/ktime.h>
+#include <linux/vmstat.h>
+#ifdef CONFIG_ION_CMA_PREFETCH
+#include <linux/workqueue.h>
+#include <linux/mutex.h>
+#include <linux/shrinker.h>
+#endif
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/ion.h>
+
 /* for ion_heap_ops structure */
 #include "ion_priv.h"
 
@@ -51,6 +62,18 @@ struct ion_cma_heap {
 	int lmk_min_free;
 	struct dentry *lmk_debug_root;
 #endif
+#ifdef CONFIG_ION_CMA_PREFETCH
+	struct list_head prefetch_node;
+	struct mutex prefetch_lock;
+	struct work_struct prefetch_work;
+	struct delayed_work prefetch_release;
+	void *prefetch_addr;
+	dma_addr_t prefetch_handle;
+	size_t prefetch_size;
+	unsigned int prefetch_kb;
+	unsigned int prefetch_hold_ms;
+	unsigned int prefetch_hits;
+#endif
 };
 
 struct ion_cma_buffer_info {
@@ -59,6 +82,197 @@ struct ion_cma_buffer_info {
 	struct sg_table *table;
 };
 
+static unsigned long ion_cma_migrated_pages(void)
+{
+	unsigned long sum = 0;
+#if defined(CONFIG_VM_EVENT_COUNTERS) && defined(CONFIG_MIGRATION)
+	int cpu;
+
+	/* system wide, so also counts compaction running meanwhile */
+	for_each_online_cpu(cpu)
+		sum += per_cpu(vm_event_states, cpu).event[PGMIGRATE_SUCCESS];
+#endif
+	return sum;
+}
+
+/* dma_alloc_coherent wrapped in the ion_cma_alloc tracepoints */
+static void *ion_cma_alloc_traced(struct ion_heap *heap, size_t len,
+		dma_addr_t *handle, bool prefetch)
+{
+	struct ion_cma_heap *cma_heap =
+		container_of(heap, struct ion_cma_heap, heap);
+	unsigned long migrated = ion_cma_migrated_pages();
+	ktime_t start = ktime_get();
+	void *cpu_addr;
+
+	trace_ion_cma_alloc_start(heap->name, len, prefetch);
+	cpu_addr = dma_alloc_coherent(cma_heap->dev, len, handle, 0);
+	trace_ion_cma_alloc_end(heap->name, len, prefetch,
+			ion_cma_migrated_pages() - migrated,
+			ktime_us_delta(ktime_get(), start),
+			cpu_addr ? 0 : -ENOMEM);
+	return cpu_addr;
+}
+
+#ifdef CONFIG_ION_CMA_PREFETCH
+/*
+ * Prefetch
+ *
+ * The block allocated by the prefetch work has had its movable pages
+ * migrated out. Freeing it right before an allocation leaves the start
+ * of the region free, where the first fit of dma_alloc_from_contiguous
+ * finds it again without migrating anything.
+ */
+static LIST_HEAD(ion_cma_prefetch_heaps);
+static DEFINE_MUTEX(ion_cma_prefetch_list_lock);
+static atomic_t ion_cma_prefetch_nr_pages = ATOMIC_INIT(0);
+
+/* Called with prefetch_lock held */
+static void ion_cma_prefetch_drop(struct ion_cma_heap *cma_heap)
+{
+	if (!cma_heap->prefetch_addr)
+		return;
+	dma_free_coherent(cma_heap->dev, cma_heap->prefetch_size,
+			cma_heap->prefetch_addr, cma_heap->prefetch_handle);
+	atomic_sub(cma_heap->prefetch_size >> PAGE_SHIFT,
+			&ion_cma_prefetch_nr_pages);
+	cma_heap->prefetch_addr = NULL;
+	cma_heap->prefetch_size = 0;
+}
+
+static void ion_cma_prefetch_work(struct work_struct *work)
+{
+	struct ion_cma_heap *cma_heap = container_of(work,
+			struct ion_cma_heap, prefetch_work);
+	size_t size = PAGE_ALIGN(cma_heap->prefetch_kb << 10);
+
+	if (!size || (size > (size_t)cma_heap->size))
+		return;
+
+	mutex_lock(&cma_heap->prefetch_lock);
+	if (!cma_heap->prefetch_addr) {
+		cma_heap->prefetch_addr = ion_cma_alloc_traced(&cma_heap->heap,
+				size, &cma_heap->prefetch_handle, true);
+		if (cma_heap->prefetch_addr) {
+			cma_heap->prefetch_size = size;
+			atomic_add(size >> PAGE_SHIFT,
+					&ion_cma_prefetch_nr_pages);
+		}
+	}
+	mutex_unlock(&cma_heap->prefetch_lock);
+	if (cma_heap->prefetch_addr)
+		mod_delayed_work(system_wq, &cma_heap->prefetch_release,
+			msecs_to_jiffies(cma_heap->prefetch_hold_ms));
+}
+
+static void ion_cma_prefetch_release(struct work_struct *work)
+{
+	struct ion_cma_heap *cma_heap = container_of(to_delayed_work(work),
+			struct ion_cma_heap, prefetch_release);
+
+	mutex_lock(&cma_heap->prefetch_lock);
+	ion_cma_prefetch_drop(cma_heap);
+	mutex_unlock(&cma_heap->prefetch_lock);
+}
+
+/* Hand the prefetched block back so the allocation can reuse its range */
+static void ion_cma_prefetch_take(struct ion_cma_heap *cma_heap)
+{
+	mutex_lock(&cma_heap->prefetch_lock);
+	if (cma_heap->prefetch_addr) {
+		cma_heap->prefetch_hits++;
+		ion_cma_prefetch_drop(cma_heap);
+	}
+	mutex_unlock(&cma_heap->prefetch_lock);
+}
+
+/**
+ * ion_cma_prefetch - start migrating pages out of the ion CMA heaps
+ *
+ * Called by multimedia drivers at open, ahead of their buffer allocations.
+ */
+void ion_cma_prefetch(void)
+{
+	struct ion_cma_heap *cma_heap;
+
+	mutex_lock(&ion_cma_prefetch_list_lock);
+	list_for_each_entry(cma_heap, &ion_cma_prefetch_heaps, prefetch_node)
+		if (cma_heap->prefetch_kb)
+			schedule_work(&cma_heap->prefetch_work);
+	mutex_unlock(&ion_cma_prefetch_list_lock);
+}
+EXPORT_SYMBOL(ion_cma_prefetch);
+
+/* Pages held by prefetched blocks, they are not in NR_FREE_CMA_PAGES */
+unsigned long ion_cma_prefetch_pages(void)
+{
+	return atomic_read(&ion_cma_prefetch_nr_pages);
+}
+EXPORT_SYMBOL(ion_cma_prefetch_pages);
+
+static int ion_cma_prefetch_shrink(struct shrinker *shrinker,
+		struct shrink_control *sc)
+{
+	struct ion_cma_heap *cma_heap;
+	int nr_pages = atomic_read(&ion_cma_prefetch_nr_pages);
+
+	if (!sc->nr_to_scan || !nr_pages)
+		return nr_pages;
+
+	/* freeing sleeps on the cma mutex, leave it to the workqueue */
+	mutex_lock(&ion_cma_prefetch_list_lock);
+	list_for_each_entry(cma_heap, &ion_cma_prefetch_heaps, prefetch_node)
+		mod_delayed_work(system_wq, &cma_heap->prefetch_release, 0);
+	mutex_unlock(&ion_cma_prefetch_list_lock);
+	return 0;
+}
+
+static struct shrinker ion_cma_prefetch_shrinker = {
+	.shrink = ion_cma_prefetch_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
+static void ion_cma_prefetch_init(struct ion_cma_heap *cma_heap,
+		const char *name)
+{
+	char debug_name[64];
+	struct dentry *root;
+
+	mutex_init(&cma_heap->prefetch_lock);
+	INIT_WORK(&cma_heap->prefetch_work, ion_cma_prefetch_work);
+	INIT_DELAYED_WORK(&cma_heap->prefetch_release,
+			ion_cma_prefetch_release);
+	cma_heap->prefetch_kb = CONFIG_ION_CMA_PREFETCH_KB;
+	cma_heap->prefetch_hold_ms = 2000;
+
+	mutex_lock(&ion_cma_prefetch_list_lock);
+	if (list_empty(&ion_cma_prefetch_heaps))
+		register_shrinker(&ion_cma_prefetch_shrinker);
+	list_add_tail(&cma_heap->prefetch_node, &ion_cma_prefetch_heaps);
+	mutex_unlock(&ion_cma_prefetch_list_lock);
+
+	snprintf(debug_name, 64, "cma_prefetch_%s", name);
+	root = debugfs_create_dir(debug_name, NULL);
+	debugfs_create_u32("size_kb", (S_IRUGO|S_IWUSR), root,
+			&cma_heap->prefetch_kb);
+	debugfs_create_u32("hold_ms", (S_IRUGO|S_IWUSR), root,
+			&cma_heap->prefetch_hold_ms);
+	debugfs_create_u32("hits", S_IRUGO, root, &cma_heap->prefetch_hits);
+}
+
+static void ion_cma_prefetch_exit(struct ion_cma_heap *cma_heap)
+{
+	mutex_lock(&ion_cma_prefetch_list_lock);
+	list_del(&cma_heap->prefetch_node);
+	if (list_empty(&ion_cma_prefetch_heaps))
+		unregister_shrinker(&ion_cma_prefetch_shrinker);
+	mutex_unlock(&ion_cma_prefetch_list_lock);
+	cancel_work_sync(&cma_heap->prefetch_work);
+	cancel_delayed_work_sync(&cma_heap->prefetch_release);
+	ion_cma_prefetch_release(&cma_heap->prefetch_release.work);
+}
+#endif /* CONFIG_ION_CMA_PREFETCH */
+
 /* ION CMA heap operations functions */
 static int ion_cma_allocate(struct ion_heap *heap, struct ion_buffer *buffer,
 			    unsigned long len, unsigned long align,
@@ -79,7 +293,11 @@ static int ion_cma_allocate(struct ion_heap *heap, struct ion_buffer *buffer,
 		return -ENOMEM;
 	}
 
-	info->cpu_addr = dma_alloc_coherent(dev, len, &(info->handle), 0);
+#ifdef CONFIG_ION_CMA_PREFETCH
+	ion_cma_prefetch_take(cma_heap);
+#endif
+	info->cpu_addr = ion_cma_alloc_traced(heap, len, &(info->handle),
+			false);
 	if (!info->cpu_addr) {
 		goto err;
 	}
@@ -416,11 +634,20 @@ struct ion_heap *ion_cma_heap_create(struct ion_platform_heap *data)
 	heap->lmk_shrink_info = ion_cma_lmk_shrink_info;
 	heap->lmk_debugfs_add = ion_cma_lmk_debugfs_add;
 #endif
+#ifdef CONFIG_ION_CMA_PREFETCH
+	ion_cma_prefetch_init(cma_heap, data->name);
+#endif
 
 	return heap;
 }
 
 void ion_cma_heap_destroy(struct ion_heap *heap)
 {
+#ifdef CONFIG_ION_CMA_PREFETCH
+	struct ion_cma_heap *cma_heap =
+		container_of(heap, struct ion_cma_heap, heap);
+
+	ion_cma_prefetch_exit(cma_heap);
+#endif
 	kfree(heap);
 }
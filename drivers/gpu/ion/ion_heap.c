@@ -25,6 +25,10 @@
 #ifdef CONFIG_ION_BCM
 #include <linux/broadcom/bcm_ion.h>
 #endif
+#ifdef CONFIG_MMDMA
+#include <linux/dma-mapping.h>
+#include <linux/broadcom/mmdma.h>
+#endif
 
 void *ion_heap_map_kernel(struct ion_heap *heap,
 			  struct ion_buffer *buffer)
@@ -108,6 +112,30 @@ int ion_heap_map_user(struct ion_heap *heap, struct ion_buffer *buffer,
 	return 0;
 }
 
+#ifdef CONFIG_MMDMA
+/*
+ * Zero a large physically contiguous chunk with the MM DMA instead of
+ * the cpu. Dirty lines are written back and dropped first so they cannot
+ * land on the zeroes later, and anything fetched meanwhile is dropped
+ * after.
+ */
+static int ion_heap_sg_zero_dma(struct scatterlist *sg)
+{
+	struct page *page = sg_page(sg);
+	unsigned long len = sg_dma_len(sg);
+	dma_addr_t addr = pfn_to_dma(NULL, page_to_pfn(page));
+	int ret;
+
+	if (len < mmdma_offload_min)
+		return -EINVAL;
+
+	arm_dma_ops.sync_single_for_device(NULL, addr, len, DMA_BIDIRECTIONAL);
+	ret = mmdma_execute_zero(page_to_phys(page), len);
+	arm_dma_ops.sync_single_for_cpu(NULL, addr, len, DMA_FROM_DEVICE);
+	return ret;
+}
+#endif
+
 int ion_heap_buffer_zero(struct ion_buffer *buffer)
 {
 	struct sg_table *table = buffer->sg_table;
@@ -129,13 +157,21 @@ int ion_heap_buffer_zero(struct ion_buffer *buffer)
 		struct page *page = sg_page(sg);
 		unsigned long len = sg_dma_len(sg);
 
+#ifdef CONFIG_MMDMA
+		if (!ion_heap_sg_zero_dma(sg))
+			continue;
+#endif
 		for (j = 0; j < len / PAGE_SIZE; j++) {
 			struct page *sub_page = page + j;
 			struct page **pages = &sub_page;
 			ret = map_vm_area(vm_struct, pgprot, &pages);
 			if (ret)
 				goto end;
+#ifdef CONFIG_ARM
+			clear_page_neon(vm_struct->addr);
+#else
 			memset(vm_struct->addr, 0, PAGE_SIZE);
+#endif
 			unmap_kernel_range((unsigned long)vm_struct->addr,
 					   PAGE_SIZE);
 		}
@@ -20,10 +20,14 @@
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
 #include <linux/fs.h>
+#include <linux/freezer.h>
+#include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/module.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/shrinker.h>
+#include <linux/wait.h>
 #include "ion_priv.h"
 
 /* #define DEBUG_PAGE_POOL_SHRINKER */
@@ -36,9 +40,10 @@ struct ion_page_pool_item {
 	struct list_head list;
 };
 
-static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+static void *__ion_page_pool_alloc_pages(struct ion_page_pool *pool,
+					 gfp_t gfp_mask)
 {
-	struct page *page = alloc_pages(pool->gfp_mask, pool->order);
+	struct page *page = alloc_pages(gfp_mask, pool->order);
 
 	if (!page)
 		return NULL;
@@ -52,6 +57,11 @@ static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 	return page;
 }
 
+static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
+{
+	return __ion_page_pool_alloc_pages(pool, pool->gfp_mask);
+}
+
 static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 				     struct page *page)
 {
@@ -102,6 +112,102 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	return page;
 }
 
+#ifdef CONFIG_ION_POOL_PREFILL
+/*
+ * Pool pages are zeroed and clean for dma: new ones by __GFP_ZERO and the
+ * flush in __ion_page_pool_alloc_pages, freed ones by the heap before they
+ * are returned. Topping the pools up from a SCHED_IDLE thread moves that
+ * work off the allocating thread.
+ */
+static struct task_struct *fill_thread;
+static DECLARE_WAIT_QUEUE_HEAD(fill_wait);
+static unsigned long fill_holdoff = INITIAL_JIFFIES;
+
+/* Cleared by userspace in battery saver mode */
+static bool fill_enable = true;
+module_param(fill_enable, bool, 0644);
+MODULE_PARM_DESC(fill_enable, "Refill ion page pools from idle time");
+
+/* Don't fight the shrinker: no refill for a while after it ran */
+#define ION_POOL_FILL_HOLDOFF	(5 * HZ)
+
+static bool ion_page_pool_needs_fill(struct ion_page_pool *pool)
+{
+	return pool->high_count + pool->low_count < pool->low_mark;
+}
+
+static bool ion_page_pool_fill_pending(void)
+{
+	struct ion_page_pool *pool;
+
+	if (!fill_enable || time_before(jiffies, fill_holdoff))
+		return false;
+	plist_for_each_entry(pool, &pools, list)
+		if (ion_page_pool_needs_fill(pool))
+			return true;
+	return false;
+}
+
+static bool ion_page_pool_cpu_busy(void)
+{
+	return nr_running() > num_online_cpus();
+}
+
+static void ion_page_pool_fill(struct ion_page_pool *pool)
+{
+	/* Background fills must neither reclaim nor wake kswapd */
+	gfp_t gfp_mask = (pool->gfp_mask | __GFP_NORETRY | __GFP_NOWARN |
+			  __GFP_NO_KSWAPD) & ~__GFP_WAIT;
+
+	while (fill_enable && ion_page_pool_needs_fill(pool)) {
+		struct page *page;
+
+		if (ion_page_pool_cpu_busy() || kthread_should_stop())
+			return;
+		page = __ion_page_pool_alloc_pages(pool, gfp_mask);
+		if (!page) {
+			fill_holdoff = jiffies + ION_POOL_FILL_HOLDOFF;
+			return;
+		}
+		if (ion_page_pool_add(pool, page)) {
+			ion_page_pool_free_pages(pool, page);
+			return;
+		}
+		cond_resched();
+	}
+}
+
+static int ion_page_pool_fill_thread(void *data)
+{
+	struct sched_param param = { .sched_priority = 0 };
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+	set_freezable();
+	while (!kthread_should_stop()) {
+		struct ion_page_pool *pool;
+
+		wait_event_freezable_timeout(fill_wait,
+				ion_page_pool_fill_pending() ||
+				kthread_should_stop(), HZ);
+		if (!ion_page_pool_fill_pending())
+			continue;
+		plist_for_each_entry(pool, &pools, list)
+			ion_page_pool_fill(pool);
+		if (ion_page_pool_cpu_busy())
+			schedule_timeout_interruptible(HZ / 10);
+	}
+	return 0;
+}
+
+static void ion_page_pool_kick_fill(struct ion_page_pool *pool)
+{
+	if (fill_thread && fill_enable && ion_page_pool_needs_fill(pool))
+		wake_up_interruptible(&fill_wait);
+}
+#else
+static inline void ion_page_pool_kick_fill(struct ion_page_pool *pool) { }
+#endif
+
 void *ion_page_pool_alloc(struct ion_page_pool *pool)
 {
 	struct page *page = NULL;
@@ -117,6 +223,7 @@ void *ion_page_pool_alloc(struct ion_page_pool *pool)
 
 	if (!page)
 		page = ion_page_pool_alloc_pages(pool);
+	ion_page_pool_kick_fill(pool);
 
 	return page;
 }
@@ -130,7 +237,7 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page* page)
 		ion_page_pool_free_pages(pool, page);
 }
 
-#ifdef DEBUG_PAGE_POOL_SHRINKER
+#if defined(DEBUG_PAGE_POOL_SHRINKER) || defined(CONFIG_ION_POOL_PREFILL)
 static int debug_drop_pools_set(void *data, u64 val)
 {
 	struct shrink_control sc;
@@ -165,14 +272,28 @@ static int debug_drop_pools_get(void *data, u64 *val)
 DEFINE_SIMPLE_ATTRIBUTE(debug_drop_pools_fops, debug_drop_pools_get,
 		debug_drop_pools_set, "%llu\n");
 
+/*
+ * Bits 0-7 select the pool order. With CONFIG_ION_POOL_PREFILL a non-zero
+ * value N in the upper bits sets that pool's watermark to N - 1 items,
+ * otherwise the pool grows by one item.
+ */
 static int debug_grow_pools_set(void *data, u64 val)
 {
 	struct ion_page_pool *pool;
 	struct page *page;
+	unsigned int order = val & 0xff;
+	int mark = val >> 8;
 
 	plist_for_each_entry(pool, &pools, list) {
-		if (val != pool->list.prio)
+		if (order != pool->list.prio)
+			continue;
+#ifdef CONFIG_ION_POOL_PREFILL
+		if (mark) {
+			pool->low_mark = mark - 1;
+			ion_page_pool_kick_fill(pool);
 			continue;
+		}
+#endif
 		page = ion_page_pool_alloc_pages(pool);
 		if (page)
 			ion_page_pool_add(pool, page);
@@ -211,6 +332,9 @@ static int ion_page_pool_shrink(struct shrinker *shrinker,
 
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(high);
+#ifdef CONFIG_ION_POOL_PREFILL
+	fill_holdoff = jiffies + ION_POOL_FILL_HOLDOFF;
+#endif
 
 	plist_for_each_entry(pool, &pools, list) {
 	for (i = 0; i < nr_to_scan; i++) {
@@ -247,9 +371,16 @@ struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 	INIT_LIST_HEAD(&pool->high_items);
 	pool->gfp_mask = gfp_mask;
 	pool->order = order;
+	pool->low_mark = 0;
+#ifdef CONFIG_ION_POOL_PREFILL
+	if (order > 4)
+		pool->low_mark = (CONFIG_ION_POOL_PREFILL_KB * 1024) >>
+					(PAGE_SHIFT + order);
+#endif
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
 	plist_add(&pool->list, &pools);
+	ion_page_pool_kick_fill(pool);
 
 	return pool;
 }
@@ -273,7 +404,7 @@ static int __init ion_page_pool_init(void)
 	shrinker.seeks = DEFAULT_SEEKS;
 	shrinker.batch = 0;
 	register_shrinker(&shrinker);
-#ifdef DEBUG_PAGE_POOL_SHRINKER
+#if defined(DEBUG_PAGE_POOL_SHRINKER) || defined(CONFIG_ION_POOL_PREFILL)
 	debugfs_create_file("ion_pools_shrink", 0644, NULL, NULL,
 			    &debug_drop_pools_fops);
 	debugfs_create_file("ion_pools_grow", 0644, NULL, NULL,
@@ -282,12 +413,24 @@ static int __init ion_page_pool_init(void)
 #ifdef CONFIG_ION_BCM
 	ion_page_pool_reg_show_mem.cbk = ion_page_pool_show_mem_cbk;
 	register_show_mem(&ion_page_pool_reg_show_mem);
+#endif
+#ifdef CONFIG_ION_POOL_PREFILL
+	fill_thread = kthread_run(ion_page_pool_fill_thread, NULL,
+				  "ion_pool_fill");
+	if (IS_ERR(fill_thread)) {
+		pr_err("failed to start pool fill thread\n");
+		fill_thread = NULL;
+	}
 #endif
 	return 0;
 }
 
 static void __exit ion_page_pool_exit(void)
 {
+#ifdef CONFIG_ION_POOL_PREFILL
+	if (fill_thread)
+		kthread_stop(fill_thread);
+#endif
 	unregister_shrinker(&shrinker);
 #ifdef CONFIG_ION_BCM
 	unregister_show_mem(&ion_page_pool_reg_show_mem);
@@ -85,6 +85,10 @@ struct ion_buffer {
 	unsigned int custom_flags;
 	int custom_update_count;
 	unsigned int align;
+	/* set once the buffer is mapped to the kernel or userspace */
+	bool cpu_mapped;
+	/* cached device mappings, see bcm_ion_map_dma_dev */
+	struct list_head dev_maps;
 #endif
 };
 
@@ -284,6 +288,9 @@ extern struct ion_client *ion_client_get_from_pid(struct ion_client *client,
 		pid_t pid);
 extern void ion_client_put(struct ion_client *client);
 
+extern struct ion_buffer *ion_dma_buf_to_buffer(struct dma_buf *dmabuf);
+extern void bcm_ion_buffer_unmap_all(struct ion_buffer *buffer);
+
 extern void ion_client_foreach_buffer(struct ion_client *client,
 		void (*process)(struct ion_buffer *buffer, void *arg),
 		void *data);
@@ -333,6 +340,7 @@ int ion_page_pool_total(bool high);
  *			when the shrinker fires
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
+ * @low_mark:		number of items the fill thread keeps in the pool
  * @list:		plist node for list of pools
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
@@ -350,6 +358,7 @@ struct ion_page_pool {
 	void (*free)(struct ion_page_pool *pool, struct page *page);
 	gfp_t gfp_mask;
 	unsigned int order;
+	int low_mark;
 	struct plist_node list;
 };
 
@@ -24,26 +24,127 @@
 #include <linux/ion.h>
 #include <linux/mm.h>
 #include <linux/scatterlist.h>
+#include <linux/sizes.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/mutex.h>
 #include <linux/broadcom/bcm_ion.h>
 #include "ion_priv.h"
 #include <asm/mach/map.h>
+#ifdef CONFIG_ION_SECURE_MEMC
+#include <plat/kona_secure_memc.h>
+#endif
 
 
 #define SECURE_HEAP_IOVA_BASE   (0xFBF00000)
 #define SECURE_HEAP_IOVA_END    (0xFFF00000)
 
+#define SECURE_MEMC_STEP	SZ_1M
+
 
 struct ion_secure_heap {
 	struct ion_heap heap;
 	struct gen_pool *pool;
 	ion_phys_addr_t base;
 	int size;
+#ifdef CONFIG_ION_SECURE_MEMC
+	struct mutex memc_lock;
+	ion_phys_addr_t memc_end;	/* protected below, 0 until known */
+	ion_phys_addr_t memc_min_end;	/* as set up at boot */
+#endif
 };
 
+#ifdef CONFIG_ION_SECURE_MEMC
+/* end of the protected region at the heap base, or of the heap without */
+static ion_phys_addr_t ion_secure_memc_extent(struct ion_secure_heap *sh)
+{
+	u32 *handle = get_secure_memc_handle();
+	struct kona_memc_txn txn;
+	int sec;
+
+	if (!handle || kona_memc_txn_begin(handle, &txn))
+		return sh->base + sh->size;
+	sec = kona_memc_txn_find(&txn, sh->base);
+	if (sec < 0 || txn.region[sec].start_address != sh->base ||
+	    txn.region[sec].mem_type == MEM_TYPE_USR)
+		return sh->base + sh->size;
+	return txn.region[sec].end_address + 1;
+}
+
+/* move the end of the region and the start of the next one together */
+static int ion_secure_memc_resize(struct ion_secure_heap *sh,
+				  ion_phys_addr_t end)
+{
+	u32 *handle = get_secure_memc_handle();
+	struct kona_memc_region_cfg cfg;
+	struct kona_memc_txn txn;
+	int sec, next, ret;
+
+	do {
+		kona_memc_txn_begin(handle, &txn);
+		sec = kona_memc_txn_find(&txn, sh->base);
+		if (sec < 0)
+			return -ENODEV;
+		next = kona_memc_txn_find(&txn,
+				txn.region[sec].end_address + 1);
+		cfg = txn.region[sec];
+		cfg.end_address = end - 1;
+		kona_memc_txn_set(&txn, sec, &cfg);
+		if (next >= 0) {
+			cfg = txn.region[next];
+			if (end > cfg.end_address)
+				return -ENOSPC;
+			cfg.start_address = end;
+			kona_memc_txn_set(&txn, next, &cfg);
+		}
+		ret = kona_memc_txn_commit(&txn);
+	} while (ret == -EAGAIN);
+
+	if (ret)
+		pr_err("memc region to %#lx failed %d\n", end, ret);
+	return ret;
+}
+
+/* called after the allocation of [.., end) from the pool */
+static int ion_secure_memc_grow(struct ion_secure_heap *sh,
+				ion_phys_addr_t end)
+{
+	int ret = 0;
+
+	mutex_lock(&sh->memc_lock);
+	if (!sh->memc_end) {
+		sh->memc_end = ion_secure_memc_extent(sh);
+		sh->memc_min_end = sh->memc_end;
+	}
+	if (end > sh->memc_end) {
+		end = min_t(ion_phys_addr_t, ALIGN(end, SECURE_MEMC_STEP),
+			    sh->base + sh->size);
+		ret = ion_secure_memc_resize(sh, end);
+		if (!ret)
+			sh->memc_end = end;
+	}
+	mutex_unlock(&sh->memc_lock);
+	return ret;
+}
+
+/*
+ * called after a free. The pool is checked under memc_lock, so an
+ * allocation racing with the shrink either keeps the pool from being
+ * empty or sees the smaller memc_end in ion_secure_memc_grow().
+ */
+static void ion_secure_memc_shrink(struct ion_secure_heap *sh)
+{
+	mutex_lock(&sh->memc_lock);
+	if (sh->memc_end > sh->memc_min_end &&
+	    gen_pool_avail(sh->pool) == sh->size &&
+	    !ion_secure_memc_resize(sh, sh->memc_min_end))
+		sh->memc_end = sh->memc_min_end;
+	mutex_unlock(&sh->memc_lock);
+}
+#endif
+
 static ion_phys_addr_t ion_secure_allocate(struct ion_heap *heap,
 				      unsigned long size,
 				      unsigned long align)
@@ -55,6 +156,13 @@ static ion_phys_addr_t ion_secure_allocate(struct ion_heap *heap,
 	if (!offset)
 		return ION_SECURE_ALLOCATE_FAIL;
 
+#ifdef CONFIG_ION_SECURE_MEMC
+	/* an unprotected secure buffer is no buffer */
+	if (ion_secure_memc_grow(secure_heap, offset + size)) {
+		gen_pool_free(secure_heap->pool, offset, size);
+		return ION_SECURE_ALLOCATE_FAIL;
+	}
+#endif
 	return offset;
 }
 
@@ -67,6 +175,9 @@ static void ion_secure_free(struct ion_heap *heap, ion_phys_addr_t addr,
 	if (addr == ION_SECURE_ALLOCATE_FAIL)
 		return;
 	gen_pool_free(secure_heap->pool, addr, size);
+#ifdef CONFIG_ION_SECURE_MEMC
+	ion_secure_memc_shrink(secure_heap);
+#endif
 }
 
 static int ion_secure_heap_phys(struct ion_heap *heap,
@@ -159,6 +270,9 @@ struct ion_heap *ion_secure_heap_create(struct ion_platform_heap *heap_data)
 	secure_heap->heap.ops = &secure_heap_ops;
 	secure_heap->heap.type = ION_HEAP_TYPE_SECURE;
 	secure_heap->size = heap_data->size;
+#ifdef CONFIG_ION_SECURE_MEMC
+	mutex_init(&secure_heap->memc_lock);
+#endif
 
 	return &secure_heap->heap;
 }
@@ -22,6 +22,7 @@
 #include <linux/highmem.h>
 #include <linux/ion.h>
 #include <linux/mm.h>
+#include <linux/percpu.h>
 #include <linux/scatterlist.h>
 #include <linux/seq_file.h>
 #include <linux/slab.h>
@@ -40,17 +41,23 @@ static unsigned int high_order_gfp_flags = (GFP_HIGHUSER | __GFP_ZERO |
 					    __GFP_NO_KSWAPD) & ~__GFP_WAIT;
 static unsigned int low_order_gfp_flags  = (GFP_HIGHUSER | __GFP_ZERO |
 					 __GFP_NOWARN);
-static const unsigned int orders[] = {8, 4, 0};
-static const int num_orders = ARRAY_SIZE(orders);
-static int order_to_index(unsigned int order)
-{
-	int i;
-	for (i = 0; i < num_orders; i++)
-		if (order == orders[i])
-			return i;
-	BUG();
-	return -1;
-}
+static const unsigned int default_orders[] = {8, 4, 2, 0};
+
+/*
+ * Small uncached allocations are served from per-cpu stacks of order-0
+ * and order-2 pages in front of the page pools, so concurrent allocators
+ * don't serialise on the pool mutex. The stacks are only touched with
+ * preemption disabled.
+ */
+#define ION_PCP_SLOTS 2
+#define ION_PCP_MAX_DEPTH 16
+static const unsigned int pcp_order[ION_PCP_SLOTS] = {0, 2};
+static const int pcp_depth[ION_PCP_SLOTS] = {16, 4};
+
+struct ion_pcp_cache {
+	int count[ION_PCP_SLOTS];
+	struct page *pages[ION_PCP_SLOTS][ION_PCP_MAX_DEPTH];
+};
 
 static unsigned int order_to_size(int order)
 {
@@ -60,12 +67,85 @@ static unsigned int order_to_size(int order)
 struct ion_system_heap {
 	struct ion_heap heap;
 	struct ion_page_pool **pools;
+	unsigned int orders[ION_SYSTEM_HEAP_MAX_ORDERS];
+	int num_orders;
+	struct ion_pcp_cache __percpu *pcp;
 #ifdef CONFIG_ION_BCM
 	struct reg_lmk reg_lmk;
 	struct reg_show_mem reg_show_mem;
 #endif
 };
 
+static int order_to_index(struct ion_system_heap *heap, unsigned int order)
+{
+	int i;
+	for (i = 0; i < heap->num_orders; i++)
+		if (order == heap->orders[i])
+			return i;
+	BUG();
+	return -1;
+}
+
+static int order_to_pcp_slot(unsigned int order)
+{
+	int i;
+	for (i = 0; i < ION_PCP_SLOTS; i++)
+		if (order == pcp_order[i])
+			return i;
+	return -1;
+}
+
+static struct page *ion_pcp_alloc(struct ion_system_heap *heap,
+				  unsigned int order)
+{
+	int slot = order_to_pcp_slot(order);
+	struct ion_pcp_cache *pcp;
+	struct page *page = NULL;
+
+	if (slot < 0)
+		return NULL;
+	pcp = get_cpu_ptr(heap->pcp);
+	if (pcp->count[slot])
+		page = pcp->pages[slot][--pcp->count[slot]];
+	put_cpu_ptr(heap->pcp);
+	return page;
+}
+
+static bool ion_pcp_free(struct ion_system_heap *heap, struct page *page,
+			 unsigned int order)
+{
+	int slot = order_to_pcp_slot(order);
+	struct ion_pcp_cache *pcp;
+	bool cached = false;
+
+	if (slot < 0)
+		return false;
+	pcp = get_cpu_ptr(heap->pcp);
+	if (pcp->count[slot] < pcp_depth[slot]) {
+		pcp->pages[slot][pcp->count[slot]++] = page;
+		cached = true;
+	}
+	put_cpu_ptr(heap->pcp);
+	return cached;
+}
+
+static void ion_pcp_drain(struct ion_system_heap *heap)
+{
+	int cpu, slot;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_pcp_cache *pcp = per_cpu_ptr(heap->pcp, cpu);
+		for (slot = 0; slot < ION_PCP_SLOTS; slot++) {
+			while (pcp->count[slot]) {
+				struct page *page =
+					pcp->pages[slot][--pcp->count[slot]];
+				int i = order_to_index(heap, pcp_order[slot]);
+				ion_page_pool_free(heap->pools[i], page);
+			}
+		}
+	}
+}
+
 struct page_info {
 	struct page *page;
 	unsigned int order;
@@ -78,11 +158,13 @@ static struct page *alloc_buffer_page(struct ion_system_heap *heap,
 {
 	bool cached = ion_buffer_cached(buffer);
 	bool split_pages = ion_buffer_fault_user_mappings(buffer);
-	struct ion_page_pool *pool = heap->pools[order_to_index(order)];
+	struct ion_page_pool *pool = heap->pools[order_to_index(heap, order)];
 	struct page *page;
 
 	if (!cached) {
-		page = ion_page_pool_alloc(pool);
+		page = ion_pcp_alloc(heap, order);
+		if (!page)
+			page = ion_page_pool_alloc(pool);
 	} else {
 		gfp_t gfp_flags = low_order_gfp_flags;
 
@@ -112,14 +194,16 @@ static void free_buffer_page(struct ion_system_heap *heap,
 	int i;
 
 	if (!cached) {
-		struct ion_page_pool *pool = heap->pools[order_to_index(order)];
+		struct ion_page_pool *pool =
+			heap->pools[order_to_index(heap, order)];
 #ifdef CONFIG_ION_BCM
 		if (buffer->flags & ION_FLAG_WRITEBACK)
 			arm_dma_ops.sync_single_for_device(NULL,
 					pfn_to_dma(NULL, page_to_pfn(page)),
 					PAGE_SIZE << order, DMA_FROM_DEVICE);
 #endif
-		ion_page_pool_free(pool, page);
+		if (!ion_pcp_free(heap, page, order))
+			ion_page_pool_free(pool, page);
 	} else if (split_pages) {
 		for (i = 0; i < (1 << order); i++)
 			__free_page(page + i);
@@ -128,6 +212,30 @@ static void free_buffer_page(struct ion_system_heap *heap,
 	}
 }
 
+/*
+ * An sg entry may cover several physically adjacent allocations. The
+ * order of each one is kept in page_private of its first page.
+ */
+static void free_buffer_sg(struct ion_system_heap *heap,
+			   struct ion_buffer *buffer, struct scatterlist *sg)
+{
+	struct page *page = sg_page(sg);
+	long remaining = sg_dma_len(sg);
+
+	if (ion_buffer_fault_user_mappings(buffer)) {
+		free_buffer_page(heap, buffer, page, get_order(remaining));
+		return;
+	}
+	while (remaining > 0) {
+		unsigned int order = page_private(page);
+
+		set_page_private(page, 0);
+		free_buffer_page(heap, buffer, page, order);
+		page += 1 << order;
+		remaining -= order_to_size(order);
+	}
+}
+
 
 static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 						 struct ion_buffer *buffer,
@@ -138,19 +246,23 @@ static struct page_info *alloc_largest_available(struct ion_system_heap *heap,
 	struct page_info *info;
 	int i;
 
-	for (i = 0; i < num_orders; i++) {
-		if (size < order_to_size(orders[i]))
+	for (i = 0; i < heap->num_orders; i++) {
+		if (size < order_to_size(heap->orders[i]))
 			continue;
-		if (max_order < orders[i])
+		if (max_order < heap->orders[i])
 			continue;
 
-		page = alloc_buffer_page(heap, buffer, orders[i]);
+		page = alloc_buffer_page(heap, buffer, heap->orders[i]);
 		if (!page)
 			continue;
 
 		info = kmalloc(sizeof(struct page_info), GFP_KERNEL);
+		if (!info) {
+			free_buffer_page(heap, buffer, page, heap->orders[i]);
+			return NULL;
+		}
 		info->page = page;
-		info->order = orders[i];
+		info->order = heap->orders[i];
 		return info;
 	}
 	return NULL;
@@ -165,13 +277,14 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 							struct ion_system_heap,
 							heap);
 	struct sg_table *table;
-	struct scatterlist *sg;
+	struct scatterlist *sg, *last = NULL;
 	int ret;
 	struct list_head pages;
 	struct page_info *info, *tmp_info;
+	struct page *next = NULL;
 	int i = 0;
 	long size_remaining = PAGE_ALIGN(size);
-	unsigned int max_order = orders[0];
+	unsigned int max_order = sys_heap->orders[0];
 	bool split_pages = ion_buffer_fault_user_mappings(buffer);
 
 	INIT_LIST_HEAD(&pages);
@@ -182,7 +295,10 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		list_add_tail(&info->list, &pages);
 		size_remaining -= (1 << info->order) * PAGE_SIZE;
 		max_order = info->order;
-		i++;
+		/* physically adjacent allocations share one sg entry */
+		if (info->page != next)
+			i++;
+		next = info->page + (1 << info->order);
 	}
 
 	table = kmalloc(sizeof(struct sg_table), GFP_KERNEL);
@@ -199,6 +315,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 		goto err1;
 
 	sg = table->sgl;
+	next = NULL;
 	list_for_each_entry_safe(info, tmp_info, &pages, list) {
 		struct page *page = info->page;
 		if (split_pages) {
@@ -207,9 +324,17 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 				sg = sg_next(sg);
 			}
 		} else {
-			sg_set_page(sg, page, (1 << info->order) * PAGE_SIZE,
-				    0);
-			sg = sg_next(sg);
+			set_page_private(page, info->order);
+			if (page == next) {
+				/* extend the previous entry */
+				last->length += order_to_size(info->order);
+			} else {
+				sg_set_page(sg, page,
+					    order_to_size(info->order), 0);
+				last = sg;
+				sg = sg_next(sg);
+			}
+			next = page + (1 << info->order);
 		}
 		list_del(&info->list);
 		kfree(info);
@@ -241,8 +366,7 @@ static int ion_system_heap_allocate(struct ion_heap *heap,
 
 err2:
 	for_each_sg(table->sgl, sg, table->nents, i)
-		free_buffer_page(sys_heap, buffer, sg_page(sg),
-				get_order(sg_dma_len(sg)));
+		free_buffer_sg(sys_heap, buffer, sg);
 	sg_free_table(table);
 err1:
 	kfree(table);
@@ -283,8 +407,7 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 	buffer->dma_addr = ION_DMA_ADDR_FAIL;
 #endif /* CONFIG_ION_BCM */
 	for_each_sg(table->sgl, sg, table->nents, i)
-		free_buffer_page(sys_heap, buffer, sg_page(sg),
-				get_order(sg_dma_len(sg)));
+		free_buffer_sg(sys_heap, buffer, sg);
 	sg_free_table(table);
 	kfree(table);
 }
@@ -393,8 +516,8 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 	struct ion_system_heap *sys_heap = container_of(heap,
 							struct ion_system_heap,
 							heap);
-	int i;
-	for (i = 0; i < num_orders; i++) {
+	int i, cpu;
+	for (i = 0; i < sys_heap->num_orders; i++) {
 		struct ion_page_pool *pool = sys_heap->pools[i];
 		seq_printf(s, "%d order %u highmem pages in pool = %lu total\n",
 			   pool->high_count, pool->order,
@@ -403,6 +526,12 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			   pool->low_count, pool->order,
 			   (1 << pool->order) * PAGE_SIZE * pool->low_count);
 	}
+	for_each_possible_cpu(cpu) {
+		struct ion_pcp_cache *pcp = per_cpu_ptr(sys_heap->pcp, cpu);
+		for (i = 0; i < ION_PCP_SLOTS; i++)
+			seq_printf(s, "cpu%d: %d order %u pages cached\n",
+				   cpu, pcp->count[i], pcp_order[i]);
+	}
 	return 0;
 }
 
@@ -435,7 +564,24 @@ struct ion_system_heap *sys_heap = container_of(reg_show_mem,
 }
 #endif
 
-struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
+#ifdef CONFIG_ION_BCM
+static bool ion_system_heap_orders_valid(const unsigned int *orders, int n)
+{
+	int i;
+	if (n <= 0 || n > ION_SYSTEM_HEAP_MAX_ORDERS)
+		return false;
+	for (i = 0; i < n; i++) {
+		if (orders[i] >= MAX_ORDER)
+			return false;
+		if (i && orders[i] >= orders[i - 1])
+			return false;
+	}
+	/* the smallest order must be 0 so any size can be satisfied */
+	return orders[n - 1] == 0;
+}
+#endif
+
+struct ion_heap *ion_system_heap_create(struct ion_platform_heap *data)
 {
 	struct ion_system_heap *heap;
 	int i;
@@ -443,6 +589,26 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 	heap = kzalloc(sizeof(struct ion_system_heap), GFP_KERNEL);
 	if (!heap)
 		return ERR_PTR(-ENOMEM);
+#ifdef CONFIG_ION_BCM
+	if (data && data->num_orders) {
+		if (ion_system_heap_orders_valid(data->orders,
+						 data->num_orders)) {
+			memcpy(heap->orders, data->orders,
+			       sizeof(data->orders[0]) * data->num_orders);
+			heap->num_orders = data->num_orders;
+		} else {
+			pr_err("%s: invalid page orders, using defaults\n",
+			       data->name);
+		}
+	}
+#endif
+	if (!heap->num_orders) {
+		memcpy(heap->orders, default_orders, sizeof(default_orders));
+		heap->num_orders = ARRAY_SIZE(default_orders);
+	}
+	heap->pcp = alloc_percpu(struct ion_pcp_cache);
+	if (!heap->pcp)
+		goto err_alloc_pcp;
 	heap->heap.ops = &system_heap_ops;
 	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
 	/**
@@ -450,17 +616,17 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 	 * Disabling this feature till it is root-caused.
 	 **/
 	/* heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE; */
-	heap->pools = kzalloc(sizeof(struct ion_page_pool *) * num_orders,
+	heap->pools = kzalloc(sizeof(struct ion_page_pool *) * heap->num_orders,
 			      GFP_KERNEL);
 	if (!heap->pools)
 		goto err_alloc_pools;
-	for (i = 0; i < num_orders; i++) {
+	for (i = 0; i < heap->num_orders; i++) {
 		struct ion_page_pool *pool;
 		gfp_t gfp_flags = low_order_gfp_flags;
 
-		if (orders[i] > 4)
+		if (heap->orders[i] > 4)
 			gfp_flags = high_order_gfp_flags;
-		pool = ion_page_pool_create(gfp_flags, orders[i]);
+		pool = ion_page_pool_create(gfp_flags, heap->orders[i]);
 		if (!pool)
 			goto err_create_pool;
 		heap->pools[i] = pool;
@@ -474,11 +640,13 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 #endif
 	return &heap->heap;
 err_create_pool:
-	for (i = 0; i < num_orders; i++)
+	for (i = 0; i < heap->num_orders; i++)
 		if (heap->pools[i])
 			ion_page_pool_destroy(heap->pools[i]);
 	kfree(heap->pools);
 err_alloc_pools:
+	free_percpu(heap->pcp);
+err_alloc_pcp:
 	kfree(heap);
 	return ERR_PTR(-ENOMEM);
 }
@@ -494,7 +662,9 @@ void ion_system_heap_destroy(struct ion_heap *heap)
 	unregister_lmk(&sys_heap->reg_lmk);
 	unregister_show_mem(&sys_heap->reg_show_mem);
 #endif
-	for (i = 0; i < num_orders; i++)
+	ion_pcp_drain(sys_heap);
+	free_percpu(sys_heap->pcp);
+	for (i = 0; i < sys_heap->num_orders; i++)
 		ion_page_pool_destroy(sys_heap->pools[i]);
 	kfree(sys_heap->pools);
 	kfree(sys_heap);
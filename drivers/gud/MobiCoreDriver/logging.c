@@ -17,9 +17,13 @@
 #include <linux/slab.h>
 #include <linux/mm.h>
 #include <linux/device.h>
+#include <linux/debugfs.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
 
 #include "main.h"
 #include "debug.h"
+#include "fastcall.h"
 #include "ops.h"
 #include "logging.h"
 
@@ -345,3 +349,122 @@ void mobicore_log_free(void)
 
 	kfree(log_line);
 }
+
+/*
+ * Fastcall latency histogram.
+ *
+ * Each fastcall is counted in a power of two bucket of the time from the
+ * caller queueing it on the fastcall cpu until the secure world is back,
+ * by kind of call. N-SIQs served by one already issued are counted as
+ * coalesced. debugfs mobicore_latency lists them, writing to it clears
+ * them.
+ */
+#define LAT_BUCKETS	16
+
+enum {
+	LAT_YIELD,
+	LAT_NSIQ,
+	LAT_INFO,
+	LAT_OTHER,
+	LAT_KINDS,
+};
+
+static const char * const lat_names[LAT_KINDS] = {
+	[LAT_YIELD]	= "yield",
+	[LAT_NSIQ]	= "nsiq",
+	[LAT_INFO]	= "info",
+	[LAT_OTHER]	= "other",
+};
+
+static atomic_t lat_hist[LAT_KINDS][LAT_BUCKETS];
+static atomic_t lat_coalesced;
+static struct dentry *lat_dentry;
+
+void mobicore_log_latency(uint32_t cmd, s64 usecs)
+{
+	int kind, bucket = 0;
+
+	switch (cmd) {
+	case MC_SMC_N_YIELD:
+		kind = LAT_YIELD;
+		break;
+	case MC_SMC_N_SIQ:
+		kind = LAT_NSIQ;
+		break;
+	case MC_FC_INFO:
+		kind = LAT_INFO;
+		break;
+	default:
+		kind = LAT_OTHER;
+		break;
+	}
+
+	/* bucket n holds [2^(n-1), 2^n) us, the last one everything above */
+	if (usecs > 0)
+		bucket = min_t(int, ilog2((unsigned long)usecs) + 1,
+			       LAT_BUCKETS - 1);
+	atomic_inc(&lat_hist[kind][bucket]);
+}
+
+void mobicore_log_coalesced(void)
+{
+	atomic_inc(&lat_coalesced);
+}
+
+static int lat_show(struct seq_file *m, void *v)
+{
+	int kind, i;
+
+	seq_puts(m, "usecs  ");
+	for (kind = 0; kind < LAT_KINDS; kind++)
+		seq_printf(m, " %10s", lat_names[kind]);
+	seq_putc(m, '\n');
+
+	for (i = 0; i < LAT_BUCKETS; i++) {
+		seq_printf(m, "%s%5u", i == LAT_BUCKETS - 1 ? ">=" : "< ",
+			   i == LAT_BUCKETS - 1 ? 1U << (i - 1) : 1U << i);
+		for (kind = 0; kind < LAT_KINDS; kind++)
+			seq_printf(m, " %10u", atomic_read(&lat_hist[kind][i]));
+		seq_putc(m, '\n');
+	}
+	seq_printf(m, "nsiq_coalesced %u\n", atomic_read(&lat_coalesced));
+	return 0;
+}
+
+static int lat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lat_show, NULL);
+}
+
+static ssize_t lat_write(struct file *file, const char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	int kind, i;
+
+	for (kind = 0; kind < LAT_KINDS; kind++)
+		for (i = 0; i < LAT_BUCKETS; i++)
+			atomic_set(&lat_hist[kind][i], 0);
+	atomic_set(&lat_coalesced, 0);
+	return count;
+}
+
+static const struct file_operations lat_fops = {
+	.owner		= THIS_MODULE,
+	.open		= lat_open,
+	.read		= seq_read,
+	.write		= lat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+void mobicore_latency_init(void)
+{
+	/* the histogram is only a debug aid, the driver works without it */
+	lat_dentry = debugfs_create_file("mobicore_latency", S_IRUGO | S_IWUSR,
+					 NULL, NULL, &lat_fops);
+}
+
+void mobicore_latency_free(void)
+{
+	debugfs_remove(lat_dentry);
+}
@@ -25,4 +25,10 @@ void mobicore_log_read(void);
 long mobicore_log_setup(void);
 void mobicore_log_free(void);
 
+/* Fastcall latency histogram, in debugfs mobicore_latency. */
+void mobicore_log_latency(uint32_t cmd, s64 usecs);
+void mobicore_log_coalesced(void);
+void mobicore_latency_init(void);
+void mobicore_latency_free(void);
+
 #endif /* _MC_LOGGING_H_ */
@@ -59,6 +59,14 @@ struct device *mcd = &mcd_debug_subname;
 /* We need 2 devices for admin and user interface*/
 #define MC_DEV_MAX 2
 
+/*
+ * Freed world shared buffers up to this order are kept for the next
+ * MAP_WSM, so a session opened per DRM or keystore call doesn't go back
+ * to the page allocator for its contiguous buffer each time.
+ */
+#define MC_BUF_POOL_ORDER	4
+#define MC_BUF_POOL_MAX		8
+
 /* Need to discover a chrdev region for the driver */
 static dev_t mc_dev_admin, mc_dev_user;
 struct cdev mc_admin_cdev, mc_user_cdev;
@@ -141,11 +149,49 @@ static int free_buffer(struct mc_buffer *buffer, bool unlock)
 
 	list_del(&buffer->list);
 
+	if (buffer->order <= MC_BUF_POOL_ORDER &&
+	    ctx.free_bufs_count < MC_BUF_POOL_MAX) {
+		list_add(&buffer->list, &ctx.free_bufs);
+		ctx.free_bufs_count++;
+		return 0;
+	}
+
 	free_continguous_pages(buffer->addr, buffer->order);
 	kfree(buffer);
 	return 0;
 }
 
+/* A freed buffer of this order, cleared. Needs the bufs_lock. */
+static struct mc_buffer *get_pool_buffer(unsigned int order)
+{
+	struct mc_buffer *buffer;
+
+	list_for_each_entry(buffer, &ctx.free_bufs, list) {
+		if (buffer->order == order) {
+			list_del(&buffer->list);
+			ctx.free_bufs_count--;
+			/* nothing of the previous owner may leak */
+			memset(buffer->addr, 0, PAGE_SIZE << order);
+			return buffer;
+		}
+	}
+	return NULL;
+}
+
+static void free_buffer_pool(void)
+{
+	struct mc_buffer *buffer, *tmp;
+
+	mutex_lock(&ctx.bufs_lock);
+	list_for_each_entry_safe(buffer, tmp, &ctx.free_bufs, list) {
+		list_del(&buffer->list);
+		free_continguous_pages(buffer->addr, buffer->order);
+		kfree(buffer);
+	}
+	ctx.free_bufs_count = 0;
+	mutex_unlock(&ctx.bufs_lock);
+}
+
 static uint32_t mc_find_cont_wsm_addr(struct mc_instance *instance, void *uaddr,
 	uint32_t *addr, uint32_t len)
 {
@@ -393,6 +439,14 @@ int mc_get_buffer(struct mc_instance *instance,
 	if (mutex_lock_interruptible(&instance->lock))
 		return -ERESTARTSYS;
 
+	mutex_lock(&ctx.bufs_lock);
+	cbuffer = get_pool_buffer(order);
+	if (cbuffer) {
+		addr = cbuffer->addr;
+		phys = cbuffer->phys;
+		goto setup;
+	}
+
 	/* allocate a new buffer. */
 	cbuffer = kzalloc(sizeof(struct mc_buffer), GFP_KERNEL);
 
@@ -400,9 +454,8 @@ int mc_get_buffer(struct mc_instance *instance,
 		MCDRV_DBG_WARN(mcd,
 			       "MMAP_WSM request: could not allocate buffer\n");
 		ret = -ENOMEM;
-		goto unlock_instance;
+		goto unlock;
 	}
-	mutex_lock(&ctx.bufs_lock);
 
 	MCDRV_DBG_VERBOSE(mcd, "size %ld -> order %d --> %ld (2^n pages)\n",
 			  len, order, allocated_size);
@@ -415,6 +468,7 @@ int mc_get_buffer(struct mc_instance *instance,
 		goto err;
 	}
 	phys = (void *)virt_to_phys(addr);
+setup:
 	cbuffer->handle = get_unique_id();
 	cbuffer->phys = phys;
 	cbuffer->addr = addr;
@@ -439,7 +493,6 @@ err:
 	kfree(cbuffer);
 unlock:
 	mutex_unlock(&ctx.bufs_lock);
-unlock_instance:
 	mutex_unlock(&instance->lock);
 	return ret;
 }
@@ -1356,11 +1409,14 @@ static int __init mobicore_init(void)
 
 	/* init list for contiguous buffers  */
 	INIT_LIST_HEAD(&ctx.cont_bufs);
+	INIT_LIST_HEAD(&ctx.free_bufs);
+	ctx.free_bufs_count = 0;
 
 	/* init lock for the buffers list */
 	mutex_init(&ctx.bufs_lock);
 
 	memset(&ctx.mci_base, 0, sizeof(ctx.mci_base));
+	mobicore_latency_init();
 	MCDRV_DBG(mcd, "initialized\n");
 	return 0;
 
@@ -1387,6 +1443,8 @@ static void __exit mobicore_exit(void)
 #endif
 
 	mc_release_l2_tables();
+	free_buffer_pool();
+	mobicore_latency_free();
 
 #ifdef MC_PM_RUNTIME
 	mc_pm_free();
@@ -78,6 +78,9 @@ struct mc_context {
 	struct task_struct	*daemon;
 	/* General list of contiguous buffers allocated by the kernel */
 	struct list_head	cont_bufs;
+	/* Freed contiguous buffers kept for reuse, under bufs_lock */
+	struct list_head	free_bufs;
+	unsigned int		free_bufs_count;
 	/* Lock for the list of contiguous buffers */
 	struct mutex		bufs_lock;
 };
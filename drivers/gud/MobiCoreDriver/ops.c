@@ -23,17 +23,29 @@
 #include <linux/device.h>
 #include <linux/workqueue.h>
 #include <linux/cpu.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
 
 #include "main.h"
 #include "fastcall.h"
 #include "ops.h"
 #include "mem.h"
 #include "pm.h"
+#include "logging.h"
 #include "debug.h"
 
 /* MobiCore context data */
 static struct mc_context *ctx;
 
+/*
+ * The secure world handles all the notifications queued in the NQ on each
+ * SIQ, so an N-SIQ issued after a caller queued its notifications serves
+ * that caller too. nsiq_issued counts the N-SIQs started, under nsiq_lock.
+ */
+static DEFINE_MUTEX(nsiq_lock);
+static atomic_t nsiq_issued = ATOMIC_INIT(0);
+static int nsiq_ret;
+
 static inline long smc(union fc_generic *fc)
 {
 	/* If we request sleep yields must be filtered out as they
@@ -78,9 +90,13 @@ void mc_fastcall(void *data)
 		KTHREAD_WORK_INIT(fc_work.work, fastcall_work_func),
 		.data = data,
 	};
+	uint32_t cmd = ((union fc_generic *)data)->as_in.cmd;
+	ktime_t start = ktime_get();
 
 	queue_kthread_work(&fastcall_worker, &fc_work.work);
 	flush_kthread_work(&fc_work.work);
+
+	mobicore_log_latency(cmd, ktime_us_delta(ktime_get(), start));
 }
 
 int mc_fastcall_init(struct mc_context *context)
@@ -140,10 +156,15 @@ void mc_fastcall(void *data)
 	struct fastcall_work_struct work = {
 		.data = data,
 	};
+	uint32_t cmd = ((union fc_generic *)data)->as_in.cmd;
+	ktime_t start = ktime_get();
+
 	INIT_WORK(&work.work, fastcall_work_func);
 	schedule_work_on(0, &work.work);
 
 	flush_work(&work.work);
+
+	mobicore_log_latency(cmd, ktime_us_delta(ktime_get(), start));
 }
 
 int mc_fastcall_init(struct mc_context *context)
@@ -204,17 +225,33 @@ int mc_yield(void)
 	return ret;
 }
 
-/* call common notify */
+/* call common notify, coalesced with an N-SIQ started after the call */
 int mc_nsiq(void)
 {
 	int ret = 0;
+	int issued;
 	union fc_generic nsiq;
 	MCDRV_DBG_VERBOSE(mcd, "enter\n");
 
+	/* the caller's NQ entries are written before this read */
+	smp_mb();
+	issued = atomic_read(&nsiq_issued);
+
+	mutex_lock(&nsiq_lock);
+	if (atomic_read(&nsiq_issued) != issued) {
+		ret = nsiq_ret;
+		mutex_unlock(&nsiq_lock);
+		mobicore_log_coalesced();
+		return ret;
+	}
+	atomic_inc(&nsiq_issued);
+
 	memset(&nsiq, 0, sizeof(nsiq));
 	nsiq.as_in.cmd = MC_SMC_N_SIQ;
 	mc_fastcall(&nsiq);
 	ret = convert_fc_ret(nsiq.as_out.ret);
+	nsiq_ret = ret;
+	mutex_unlock(&nsiq_lock);
 
 	return ret;
 }
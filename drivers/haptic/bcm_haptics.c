@@ -21,12 +21,25 @@
 *
 *  NOTES:
 *
+*     Besides the timed_output on/off pattern, effects from a waveform
+*     library can be played by id. The library is loaded from firmware
+*     at probe, or written to the "effects" sysfs file, as a sequence of
+*     effects, each a little endian u32 sample count followed by that
+*     many s16 samples at HALAUDIO_PORT_HZ. Effect samples are handed to
+*     the audio mixer frame by frame from the getsrc callback, so they
+*     go out with the audio DMA and stay in step with it, with no timer
+*     per effect.
+*
 *****************************************************************************/
 
 #include <linux/module.h>
 #include <linux/platform_device.h>
 #include <linux/err.h>
+#include <linux/firmware.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
 #include <linux/timer.h>
+#include <asm/unaligned.h>
 #include <linux/broadcom/bcm_haptics.h>
 #include <linux/broadcom/amxr.h>
 #include <linux/broadcom/amxr_port.h>
@@ -56,6 +69,34 @@ static AMXR_PORT_CB g_amxr_callback =
 static AMXR_PORT_ID g_hal_port_id;
 static AMXR_PORT_ID g_ept_port_d;
 
+/* Waveform effect library */
+#define HAPTICS_MAX_EFFECTS	32
+#define HAPTICS_MAX_LIB_BYTES	(256 * 1024)
+#define HAPTICS_DEFAULT_FW	"bcm_haptics.bin"
+
+struct haptics_effect {
+	const int16_t *data;
+	unsigned int samples;
+};
+
+struct haptics_lib {
+	const void *blob;
+	unsigned int count;
+	struct haptics_effect effect[HAPTICS_MAX_EFFECTS];
+};
+
+static struct haptics_lib *g_lib;		/* under g_effect_lock */
+static DEFINE_SPINLOCK(g_effect_lock);
+static const struct haptics_effect *g_effect;	/* playing, or NULL */
+static unsigned int g_effect_pos;		/* next sample of g_effect */
+static int16_t g_frame[AMXR_HAPTICS_FRAMESZ_16BITS];
+
+/* effect start latency: from the play request to its first frame */
+static ktime_t g_effect_req;
+static bool g_effect_started;
+static unsigned int g_effect_plays;
+static s64 g_latency_last_us, g_latency_max_us;
+
 static int16_t g_data_on[AMXR_HAPTICS_FRAMESZ_16BITS] = {
 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF, 0x7FFF,
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
@@ -120,6 +161,45 @@ static int16_t g_data_off[AMXR_HAPTICS_FRAMESZ_16BITS] = {
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000};
 
+/****************************************************************************
+*
+*   Fill the next mixer frame from the playing effect. Returns NULL when
+*   no effect is playing. The samples are copied, so the library can be
+*   replaced while the mixer still holds the previous frame.
+*
+****************************************************************************/
+static int16_t *haptics_effect_frame(int bytes)
+{
+	unsigned int n, want;
+	unsigned long flags;
+	int16_t *frame = NULL;
+
+	want = min_t(unsigned int, bytes / sizeof(int16_t),
+		     AMXR_HAPTICS_FRAMESZ_16BITS);
+
+	spin_lock_irqsave(&g_effect_lock, flags);
+	if (!g_effect)
+		goto out;
+
+	if (!g_effect_started) {
+		g_effect_started = true;
+		g_latency_last_us = ktime_us_delta(ktime_get(), g_effect_req);
+		if (g_latency_last_us > g_latency_max_us)
+			g_latency_max_us = g_latency_last_us;
+	}
+
+	n = min(want, g_effect->samples - g_effect_pos);
+	memcpy(g_frame, g_effect->data + g_effect_pos, n * sizeof(int16_t));
+	memset(g_frame + n, 0, (want - n) * sizeof(int16_t));
+	g_effect_pos += n;
+	if (g_effect_pos >= g_effect->samples)
+		g_effect = NULL;
+	frame = g_frame;
+out:
+	spin_unlock_irqrestore(&g_effect_lock, flags);
+	return frame;
+}
+
 /****************************************************************************
 *
 *   Audio Mixer getsrc callback function
@@ -128,8 +208,13 @@ static int16_t g_data_off[AMXR_HAPTICS_FRAMESZ_16BITS] = {
 static int16_t *amxr_getsrc(int bytes, void *privdata)
 {
 	int flag;
+	int16_t *frame;
+
 	if(debug_level >= 2)
 		printk(KERN_DEBUG "%s entry\n", __FUNCTION__);
+	frame = haptics_effect_frame(bytes);
+	if (frame)
+		return frame;
 	flag = atomic_read(&g_haptics_flag);
 	if(debug_level >= 2)
 		printk(KERN_DEBUG "%s flag=%d\n", __FUNCTION__, flag);
@@ -209,6 +294,204 @@ static void on_haptics_timer(unsigned long data)
 		printk(KERN_DEBUG "%s exit\n", __FUNCTION__);
 }
 
+/****************************************************************************
+*
+*   Parse a waveform library and make it the current one. The blob is
+*   copied; any effect playing from the old library is stopped.
+*
+****************************************************************************/
+static int haptics_load_lib(const u8 *data, size_t size)
+{
+	struct haptics_lib *lib, *old;
+	unsigned long flags;
+	unsigned int samples;
+	size_t off = 0;
+	u8 *blob;
+
+	if (!size || size > HAPTICS_MAX_LIB_BYTES)
+		return -EINVAL;
+
+	lib = kzalloc(sizeof(*lib), GFP_KERNEL);
+	blob = kmemdup(data, size, GFP_KERNEL);
+	if (!lib || !blob) {
+		kfree(lib);
+		kfree(blob);
+		return -ENOMEM;
+	}
+	lib->blob = blob;
+
+	while (off + sizeof(u32) <= size) {
+		if (lib->count == HAPTICS_MAX_EFFECTS)
+			goto err_format;
+		samples = get_unaligned_le32(blob + off);
+		off += sizeof(u32);
+		if (!samples || samples > (size - off) / sizeof(int16_t))
+			goto err_format;
+		lib->effect[lib->count].data = (const int16_t *)(blob + off);
+		lib->effect[lib->count].samples = samples;
+		lib->count++;
+		off += samples * sizeof(int16_t);
+	}
+	if (off != size)
+		goto err_format;
+
+	spin_lock_irqsave(&g_effect_lock, flags);
+	old = g_lib;
+	g_lib = lib;
+	g_effect = NULL;
+	spin_unlock_irqrestore(&g_effect_lock, flags);
+
+	if (old) {
+		kfree(old->blob);
+		kfree(old);
+	}
+	printk(KERN_INFO "%s: %u effects loaded\n", __FUNCTION__, lib->count);
+	return 0;
+
+err_format:
+	printk(KERN_ERR "%s: bad effect library at byte %zu\n",
+	       __FUNCTION__, off);
+	kfree(blob);
+	kfree(lib);
+	return -EINVAL;
+}
+
+static void haptics_free_lib(void)
+{
+	struct haptics_lib *old;
+	unsigned long flags;
+
+	spin_lock_irqsave(&g_effect_lock, flags);
+	old = g_lib;
+	g_lib = NULL;
+	g_effect = NULL;
+	spin_unlock_irqrestore(&g_effect_lock, flags);
+
+	if (old) {
+		kfree(old->blob);
+		kfree(old);
+	}
+}
+
+static void haptics_fw_loaded(const struct firmware *fw, void *context)
+{
+	if (!fw) {
+		if (debug_level >= 1)
+			printk(KERN_DEBUG "%s: no effect library\n",
+			       __FUNCTION__);
+		return;
+	}
+	haptics_load_lib(fw->data, fw->size);
+	release_firmware(fw);
+}
+
+/****************************************************************************
+*
+*   Start playing effect id from the library, or stop the playing effect
+*   when id is negative.
+*
+****************************************************************************/
+static int haptics_play_effect(int id)
+{
+	unsigned long flags;
+	int rc = 0;
+
+	spin_lock_irqsave(&g_effect_lock, flags);
+	if (id < 0) {
+		g_effect = NULL;
+	} else if (!g_lib || id >= g_lib->count) {
+		rc = -EINVAL;
+	} else {
+		g_effect = &g_lib->effect[id];
+		g_effect_pos = 0;
+		g_effect_req = ktime_get();
+		g_effect_started = false;
+		g_effect_plays++;
+	}
+	spin_unlock_irqrestore(&g_effect_lock, flags);
+	return rc;
+}
+
+/****************************************************************************
+*
+*   sysfs interface: effects (library upload), effect (play by id, read
+*   back the number of effects) and effect_latency.
+*
+****************************************************************************/
+static ssize_t haptics_effects_write(struct file *filp, struct kobject *kobj,
+				     struct bin_attribute *attr, char *buf,
+				     loff_t off, size_t count)
+{
+	int rc;
+
+	/* the whole library in one write */
+	if (off)
+		return -EINVAL;
+	rc = haptics_load_lib(buf, count);
+	return rc ? rc : count;
+}
+
+static struct bin_attribute haptics_effects_attr = {
+	.attr = { .name = "effects", .mode = S_IWUSR },
+	.size = HAPTICS_MAX_LIB_BYTES,
+	.write = haptics_effects_write,
+};
+
+static ssize_t haptics_effect_show(struct device *dev,
+				   struct device_attribute *attr, char *buf)
+{
+	unsigned long flags;
+	unsigned int count;
+
+	spin_lock_irqsave(&g_effect_lock, flags);
+	count = g_lib ? g_lib->count : 0;
+	spin_unlock_irqrestore(&g_effect_lock, flags);
+	return sprintf(buf, "%u\n", count);
+}
+
+static ssize_t haptics_effect_store(struct device *dev,
+				    struct device_attribute *attr,
+				    const char *buf, size_t count)
+{
+	int id, rc;
+
+	rc = kstrtoint(buf, 0, &id);
+	if (rc)
+		return rc;
+	rc = haptics_play_effect(id);
+	return rc ? rc : count;
+}
+
+static ssize_t haptics_latency_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	unsigned long flags;
+	unsigned int plays;
+	s64 last, max;
+
+	spin_lock_irqsave(&g_effect_lock, flags);
+	plays = g_effect_plays;
+	last = g_latency_last_us;
+	max = g_latency_max_us;
+	spin_unlock_irqrestore(&g_effect_lock, flags);
+	return sprintf(buf, "plays %u last %lld us max %lld us\n",
+		       plays, last, max);
+}
+
+static DEVICE_ATTR(effect, S_IRUGO | S_IWUSR, haptics_effect_show,
+		   haptics_effect_store);
+static DEVICE_ATTR(effect_latency, S_IRUGO, haptics_latency_show, NULL);
+
+static struct attribute *haptics_attrs[] = {
+	&dev_attr_effect.attr,
+	&dev_attr_effect_latency.attr,
+	NULL,
+};
+
+static struct attribute_group haptics_attr_group = {
+	.attrs = haptics_attrs,
+};
+
 /****************************************************************************
 *
 *   Function called to initialize haptics driver.
@@ -278,11 +561,37 @@ static int __init haptics_probe(struct platform_device *pdev)
 		goto do_remove_amxr_port;
 	}
 
+	/* waveform effects */
+	rc = sysfs_create_group(&pdev->dev.kobj, &haptics_attr_group);
+	if(rc) {
+		printk(KERN_ERR "%s: failed to create sysfs group. rc=%i\n", __FUNCTION__, rc);
+		goto do_disconnect_amxr_port;
+	}
+	rc = sysfs_create_bin_file(&pdev->dev.kobj, &haptics_effects_attr);
+	if(rc) {
+		printk(KERN_ERR "%s: failed to create effects file. rc=%i\n", __FUNCTION__, rc);
+		goto do_remove_sysfs_group;
+	}
+	/* the library is optional, effects can also be written later */
+	rc = request_firmware_nowait(THIS_MODULE, FW_ACTION_HOTPLUG,
+			driver_data->effects_fw_name ?: HAPTICS_DEFAULT_FW,
+			&pdev->dev, GFP_KERNEL, NULL, haptics_fw_loaded);
+	if(rc)
+		printk(KERN_ERR "%s: effect library request failed. rc=%i\n", __FUNCTION__, rc);
+
 	if(debug_level >= 1)
 		printk(KERN_DEBUG "%s OK\n", __FUNCTION__);
 
 	return 0;
 
+do_remove_sysfs_group:
+	sysfs_remove_group(&pdev->dev.kobj, &haptics_attr_group);
+
+do_disconnect_amxr_port:
+	rc2 = amxrDisconnect(g_amixer_fd, g_ept_port_d, g_hal_port_id);
+	if(rc2)
+		printk(KERN_ERR "%s: failed to disconnect Audio Mixer port. rc=%i\n", __FUNCTION__, rc2);
+
 do_remove_amxr_port:
 	rc2 = amxrRemovePort(g_ept_port_d);
 	if(rc2)
@@ -312,7 +621,10 @@ static int haptics_remove(struct platform_device *pdev)
 
 	if(debug_level >= 1)
 		printk(KERN_DEBUG "%s\n", __FUNCTION__);
-	
+
+	sysfs_remove_bin_file(&pdev->dev.kobj, &haptics_effects_attr);
+	sysfs_remove_group(&pdev->dev.kobj, &haptics_attr_group);
+
 	rc = amxrDisconnect(g_amixer_fd, g_ept_port_d, g_hal_port_id);
 	if(rc)
 		printk(KERN_ERR "%s: failed to disconnect Audio Mixer port. rc=%i\n", __FUNCTION__, rc);
@@ -326,6 +638,7 @@ static int haptics_remove(struct platform_device *pdev)
 		printk(KERN_ERR "%s: failed to free Audio Mixer client rc=%i\n", __FUNCTION__, rc);
 
 	timed_output_dev_unregister(&haptics_dev);
+	haptics_free_lib();
 	return 0;
 }
 
@@ -360,6 +360,7 @@ static struct platform_driver samsung_pwm_haptic_driver = {
 	.driver = {
 		   .name = "samsung_pwm_haptic",
 		   .owner = THIS_MODULE,
+		   .probe_type = PROBE_AFTER_FIRST_FRAME,
 		   },
 };
 
@@ -47,6 +47,7 @@
 
 #include <linux/timer.h>
 #include <plat/cpu.h>
+#include <plat/clock.h>
 #include "i2c-bsc.h"
 
 #define DEFAULT_I2C_BUS_SPEED    BSC_BUS_SPEED_50K
@@ -69,13 +70,21 @@
 #define PROC_GLOBAL_PARENT_DIR    "i2c"
 #define PROC_ENTRY_DEBUG          "debug"
 #define PROC_ENTRY_RESET          "reset"
-#define PROC_ENTRY_TX_FIFO        "txFIFO"
-#define PROC_ENTRY_RX_FIFO        "rxFIFO"
 
 #define MAX_RETRY_NUMBER        (3-1)
 
+/* about two bytes at 400 kHz */
+#define BSC_SPIN_US             50
+
+/*
+ * Messages of at least this many bytes go through the FIFOs even when the
+ * client did not ask for them, one interrupt per FIFO instead of one per
+ * byte. 0 leaves the FIFOs to the clients that ask.
+ */
+static unsigned int fifo_min_len = 16;
+module_param(fifo_min_len, uint, S_IRUGO | S_IWUSR);
+
 #ifdef CONFIG_DEBUG_FS
-static struct dentry *bsc_dentry, *bsc_speed;
 static int bsc_clk_open(struct inode *inode, struct file *file);
 static ssize_t set_i2c_bus_speed(struct file *file, char const __user *buf,
 			size_t size, loff_t *offset);
@@ -84,6 +93,16 @@ static const struct file_operations default_file_operations = {
 	.read = seq_read,
 	.write = set_i2c_bus_speed,
 };
+static int bsc_stats_open(struct inode *inode, struct file *file);
+static ssize_t bsc_stats_clear(struct file *file, char const __user *buf,
+			size_t size, loff_t *offset);
+static const struct file_operations bsc_stats_fops = {
+	.open = bsc_stats_open,
+	.read = seq_read,
+	.write = bsc_stats_clear,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
 #endif /*CONFIG_DEBUG_FS*/
 
 #ifdef CONFIG_LOCKDEP
@@ -125,6 +144,9 @@ struct bsc_i2c_dev {
 	/* flag for POLLING mode */
 	atomic_t polling_mode;
 
+	/* us to spin for a command or byte before sleeping on the interrupt */
+	unsigned int spin_us;
+
 	/* the 8-bit master code (0000 1XXX, 0x08) used for high speed mode */
 	unsigned char mastercode;
 
@@ -175,6 +197,21 @@ struct bsc_i2c_dev {
 	/* Bit flag to get the interrupt bit set - Use this in the driver to
 	 * check if there was any error when interrupted */
 	unsigned int err_flag;
+
+	/* transfer statistics, under dev_lock */
+	struct {
+		u32 xfers;
+		u32 errors;
+		u32 fifo_msgs;
+		u32 byte_msgs;
+		u64 bytes;
+		u64 total_us;
+		u32 max_us;
+	} stats;
+
+#ifdef CONFIG_DEBUG_FS
+	struct dentry *dentry;
+#endif
 };
 
 static const char gBanner[] =
@@ -335,24 +372,57 @@ static int bsc_poll_for_sesdone(struct bsc_i2c_dev *dev)
 	return 0;
 }
 
+/*
+ * A start, stop or byte takes a few bus clocks, often less than the
+ * interrupt and the wakeup of the waiter. Spin on the session done status
+ * for up to spin_us with the interrupt still disabled; on success the
+ * status is left in err_flag as the ISR would have, otherwise the caller
+ * enables the interrupt and sleeps as before.
+ */
+static bool bsc_spin_for_sesdone(struct bsc_i2c_dev *dev)
+{
+	ktime_t start;
+	uint32_t status;
+
+	if (!dev->spin_us)
+		return false;
+
+	start = ktime_get();
+	do {
+		status = bsc_read_intr_status((uint32_t)dev->virt_base);
+		if (status & I2C_MM_HS_ISR_SES_DONE_MASK) {
+			bsc_clear_intr_status((uint32_t)dev->virt_base,
+					      status);
+			dev->err_flag = status;
+			/* the NAK of the HS master code is expected */
+			if ((status & I2C_MM_HS_ISR_NOACK_MASK) &&
+			    dev->high_speed_mode && dev->is_mastercode) {
+				dev->is_mastercode = false;
+				dev->err_flag = 0;
+			}
+			if (status & I2C_MM_HS_ISR_ERR_MASK)
+				queue_work(dev->reset_wq, &dev->reset_work);
+			return true;
+		}
+		cpu_relax();
+	} while (ktime_us_delta(ktime_get(), start) < dev->spin_us);
+
+	return false;
+}
+
 static int bsc_send_cmd(struct bsc_i2c_dev *dev, BSC_CMD_t cmd)
 {
 	int rc;
-	unsigned long time_left;
+	unsigned long time_left = 1;
 
 	/* make sure the hareware is ready */
 	rc = bsc_wait_cmdbusy(dev);
 	if (rc < 0)
 		return rc;
 
-	if (!(atomic_read(&dev->polling_mode))) {
-		/* enable the session done (SES) interrupt */
-		bsc_enable_intr((uint32_t)dev->virt_base,
-				I2C_MM_HS_IER_I2C_INT_EN_MASK);
-
-		/* mark as incomplete before sending the command */
+	/* mark as incomplete before sending the command */
+	if (!(atomic_read(&dev->polling_mode)))
 		INIT_COMPLETION(dev->ses_done);
-	}
 
 	/* send the command */
 	isl_bsc_send_cmd((uint32_t)dev->virt_base, cmd);
@@ -367,10 +437,15 @@ static int bsc_send_cmd(struct bsc_i2c_dev *dev, BSC_CMD_t cmd)
 		 * Block waiting for the transaction to finish. When it's
 		 * finished we'll be signaled by the interrupt
 		 */
-		time_left = wait_for_completion_timeout(&dev->ses_done,
-							SES_TIMEOUT);
-		bsc_disable_intr((uint32_t)dev->virt_base,
-				 I2C_MM_HS_IER_I2C_INT_EN_MASK);
+		if (!bsc_spin_for_sesdone(dev)) {
+			/* enable the session done (SES) interrupt */
+			bsc_enable_intr((uint32_t)dev->virt_base,
+					I2C_MM_HS_IER_I2C_INT_EN_MASK);
+			time_left = wait_for_completion_timeout(&dev->ses_done,
+								SES_TIMEOUT);
+			bsc_disable_intr((uint32_t)dev->virt_base,
+					 I2C_MM_HS_IER_I2C_INT_EN_MASK);
+		}
 		/* Check if there was a bus error seen */
 		if (time_left == 0 ||
 		   (dev->err_flag & I2C_MM_HS_ISR_ERR_MASK)) {
@@ -564,6 +639,13 @@ static unsigned int bsc_xfer_read_fifo(struct bsc_i2c_dev *dev, uint8_t *buf,
 	return bytes_read;
 }
 
+/* long messages use the FIFOs, unless the client wants polling */
+static bool bsc_auto_fifo(struct bsc_i2c_dev *dev, struct i2c_msg *msg)
+{
+	return fifo_min_len && msg->len >= fifo_min_len &&
+		!atomic_read(&dev->polling_mode);
+}
+
 static unsigned int bsc_xfer_read(struct i2c_adapter *adapter,
 				  struct i2c_msg *msg)
 {
@@ -573,10 +655,14 @@ static unsigned int bsc_xfer_read(struct i2c_adapter *adapter,
 	nak = (msg->flags & I2C_M_NO_RD_ACK) ? 1 : 0;
 
 	/* FIFO mode cannot handle NAK for individual bytes */
-	if (atomic_read(&dev->rx_fifo_support) && !nak)
+	if ((atomic_read(&dev->rx_fifo_support) || bsc_auto_fifo(dev, msg)) &&
+	    !nak) {
+		dev->stats.fifo_msgs++;
 		bytes_read = bsc_xfer_read_fifo(dev, msg->buf, msg->len);
-	else
+	} else {
+		dev->stats.byte_msgs++;
 		bytes_read = bsc_xfer_read_data(dev, nak, msg->buf, msg->len);
+	}
 
 	return bytes_read;
 }
@@ -585,21 +671,16 @@ static int bsc_xfer_write_byte(struct bsc_i2c_dev *dev, unsigned int nak_ok,
 			       uint8_t *data)
 {
 	int rc;
-	unsigned long time_left;
+	unsigned long time_left = 1;
 
 	/* make sure the hareware is ready */
 	rc = bsc_wait_cmdbusy(dev);
 	if (rc < 0)
 		return rc;
 
-	if (!(atomic_read(&dev->polling_mode))) {
-		/* enable the session done (SES) interrupt */
-		bsc_enable_intr((uint32_t)dev->virt_base,
-				I2C_MM_HS_IER_I2C_INT_EN_MASK);
-
-		/* mark as incomplete before sending the command */
+	/* mark as incomplete before sending the command */
+	if (!(atomic_read(&dev->polling_mode)))
 		INIT_COMPLETION(dev->ses_done);
-	}
 
 	/* send data */
 	bsc_write_data((uint32_t)dev->virt_base, data, 1);
@@ -614,10 +695,15 @@ static int bsc_xfer_write_byte(struct bsc_i2c_dev *dev, unsigned int nak_ok,
 		 * Block waiting for the transaction to finish. When it's
 		 * finished we'll be signaled by the interrupt
 		 */
-		time_left = wait_for_completion_timeout(&dev->ses_done,
-							SES_TIMEOUT);
-		bsc_disable_intr((uint32_t)dev->virt_base,
-				 I2C_MM_HS_IER_I2C_INT_EN_MASK);
+		if (!bsc_spin_for_sesdone(dev)) {
+			/* enable the session done (SES) interrupt */
+			bsc_enable_intr((uint32_t)dev->virt_base,
+					I2C_MM_HS_IER_I2C_INT_EN_MASK);
+			time_left = wait_for_completion_timeout(&dev->ses_done,
+								SES_TIMEOUT);
+			bsc_disable_intr((uint32_t)dev->virt_base,
+					 I2C_MM_HS_IER_I2C_INT_EN_MASK);
+		}
 		if (time_left == 0 || dev->err_flag) {
 			/* Check if there was a NACK and it was un-expected */
 			if ((dev->err_flag & I2C_MM_HS_ISR_NOACK_MASK) &&
@@ -786,10 +872,12 @@ static int bsc_xfer_write(struct i2c_adapter *adapter, struct i2c_msg *msg)
 	unsigned int bytes_written = 0;
 	unsigned int nak_ok = msg->flags & I2C_M_IGNORE_NAK;
 
-	if (atomic_read(&dev->tx_fifo_support)) {
+	if (atomic_read(&dev->tx_fifo_support) || bsc_auto_fifo(dev, msg)) {
+		dev->stats.fifo_msgs++;
 		bytes_written = bsc_xfer_write_fifo(dev, nak_ok, msg->buf,
 						    msg->len);
 	} else {
+		dev->stats.byte_msgs++;
 		bytes_written = bsc_xfer_write_data(dev, nak_ok, msg->buf,
 						    msg->len);
 	}
@@ -1223,11 +1311,14 @@ static int bsc_xfer(struct i2c_adapter *adapter, struct i2c_msg msgs[], int num)
 	int rc = 0;
 	unsigned short i, nak_ok;
 	struct bsc_adap_cfg *hw_cfg = NULL;
+	ktime_t start;
+	u32 us;
 #ifdef CONFIG_KONA_PMU_BSC_USE_PMGR_HW_SEM
 	bool rel_hw_sem = false;
 #endif
 
 	mutex_lock(&dev->dev_lock);
+	start = ktime_get();
 #if defined(CONFIG_ARCH_JAVA)
 	pause_nohz();
 #endif
@@ -1381,6 +1472,16 @@ out1:
 #if defined(CONFIG_ARCH_JAVA)
 	resume_nohz();
 #endif
+	us = ktime_us_delta(ktime_get(), start);
+	dev->stats.xfers++;
+	dev->stats.total_us += us;
+	if (us > dev->stats.max_us)
+		dev->stats.max_us = us;
+	if (rc < 0)
+		dev->stats.errors++;
+	else
+		for (i = 0; i < num; i++)
+			dev->stats.bytes += msgs[i].len;
 	mutex_unlock(&dev->dev_lock);
 	return rc;
 }
@@ -1461,100 +1562,80 @@ static int proc_reset_write(struct file *file, const char __user *buffer,
 	return count;
 }
 
-static int proc_tx_fifo_write(struct file *file, const char __user *buffer,
-		   size_t count, loff_t *off)
+static ssize_t tx_fifo_show(struct device *d, struct device_attribute *attr,
+			    char *buf)
 {
-	struct bsc_i2c_dev *dev = (struct bsc_i2c_dev *)file->private_data;
-	int rc;
-	unsigned int enable;
-	unsigned char kbuf[MAX_PROC_BUF_SIZE];
-
-	if (count > MAX_PROC_BUF_SIZE)
-		count = MAX_PROC_BUF_SIZE;
+	struct bsc_i2c_dev *dev = platform_get_drvdata(to_platform_device(d));
 
-	rc = copy_from_user(kbuf, buffer, count);
-	if (rc) {
-		dev_err(dev->device, "copy_from_user failed status=%d", rc);
-		return -EFAULT;
-	}
-
-	if (sscanf(kbuf, "%u", &enable) != 1) {
-		dev_info(dev->device, "echo <enable> > %s\n",
-			 PROC_ENTRY_TX_FIFO);
-		return count;
-	}
+	return sprintf(buf, "%d\n", atomic_read(&dev->tx_fifo_support));
+}
 
-	if (enable)
-		atomic_set(&dev->tx_fifo_support, 1);
-	else
-		atomic_set(&dev->tx_fifo_support, 0);
+static ssize_t tx_fifo_store(struct device *d, struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct bsc_i2c_dev *dev = platform_get_drvdata(to_platform_device(d));
+	unsigned int enable;
 
+	if (kstrtouint(buf, 0, &enable))
+		return -EINVAL;
+	atomic_set(&dev->tx_fifo_support, !!enable);
 	return count;
 }
 
-static int proc_tx_fifo_read(struct file *file, char __user *buffer,
-			size_t count, loff_t *off)
+static ssize_t rx_fifo_show(struct device *d, struct device_attribute *attr,
+			    char *buf)
 {
-	unsigned int len = 0;
-	struct bsc_i2c_dev *dev = (struct bsc_i2c_dev *)file->private_data;
-
-	if (*off > 0)
-		return 0;
+	struct bsc_i2c_dev *dev = platform_get_drvdata(to_platform_device(d));
 
-	len += scnprintf(buffer + len, PAGE_SIZE, "TX FIFO is %s\n",
-		       atomic_read(&dev->tx_fifo_support) ? "enabled" :
-		       "disabled");
-	*off += len;
-	return len;
+	return sprintf(buf, "%d\n", atomic_read(&dev->rx_fifo_support));
 }
 
-static int proc_rx_fifo_write(struct file *file, const char __user *buffer,
-		   size_t count, loff_t *off)
+static ssize_t rx_fifo_store(struct device *d, struct device_attribute *attr,
+			     const char *buf, size_t count)
 {
-	struct bsc_i2c_dev *dev = (struct bsc_i2c_dev *)file->private_data;
-	int rc;
+	struct bsc_i2c_dev *dev = platform_get_drvdata(to_platform_device(d));
 	unsigned int enable;
-	unsigned char kbuf[MAX_PROC_BUF_SIZE];
 
-	if (count > MAX_PROC_BUF_SIZE)
-		count = MAX_PROC_BUF_SIZE;
+	if (kstrtouint(buf, 0, &enable))
+		return -EINVAL;
+	atomic_set(&dev->rx_fifo_support, !!enable);
+	return count;
+}
 
-	rc = copy_from_user(kbuf, buffer, count);
-	if (rc) {
-		dev_err(dev->device, "copy_from_user failed status=%d", rc);
-		return -EFAULT;
-	}
+static ssize_t spin_us_show(struct device *d, struct device_attribute *attr,
+			    char *buf)
+{
+	struct bsc_i2c_dev *dev = platform_get_drvdata(to_platform_device(d));
 
-	if (sscanf(kbuf, "%u", &enable) != 1) {
-		dev_info(dev->device, "echo <enable> > %s\n",
-			 PROC_ENTRY_RX_FIFO);
-		return count;
-	}
+	return sprintf(buf, "%u\n", dev->spin_us);
+}
 
-	if (enable)
-		atomic_set(&dev->rx_fifo_support, 1);
-	else
-		atomic_set(&dev->rx_fifo_support, 0);
+static ssize_t spin_us_store(struct device *d, struct device_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct bsc_i2c_dev *dev = platform_get_drvdata(to_platform_device(d));
+	unsigned int us;
 
+	if (kstrtouint(buf, 0, &us) || us > USEC_PER_MSEC)
+		return -EINVAL;
+	dev->spin_us = us;
 	return count;
 }
 
-static int proc_rx_fifo_read(struct file *file, char __user *buffer,
-			size_t count, loff_t *off)
-{
-	unsigned int len = 0;
-	struct bsc_i2c_dev *dev = (struct bsc_i2c_dev *)file->private_data;
+static DEVICE_ATTR(tx_fifo, 0644, tx_fifo_show, tx_fifo_store);
+static DEVICE_ATTR(rx_fifo, 0644, rx_fifo_show, rx_fifo_store);
+static DEVICE_ATTR(spin_us, 0644, spin_us_show, spin_us_store);
 
-	if (*off > 0)
-		return 0;
-
-	len += scnprintf(buffer + len, PAGE_SIZE, "RX FIFO is %s\n",
-		       atomic_read(&dev->rx_fifo_support) ? "enabled" :
-		       "disabled");
+static struct attribute *bsc_attrs[] = {
+	&dev_attr_tx_fifo.attr,
+	&dev_attr_rx_fifo.attr,
+	&dev_attr_spin_us.attr,
+	NULL,
+};
 
-	*off += len;
-	return len;
-}
+static const struct attribute_group bsc_attr_group = {
+	.attrs = bsc_attrs,
+};
 
 static int proc_debug_show(struct seq_file *m, void *data)
 {
@@ -1589,27 +1670,13 @@ static const struct file_operations proc_reset_fops = {
 	.write	= proc_reset_write,
 };
 
-static const struct file_operations proc_tx_fifo_fops = {
-	.owner	= THIS_MODULE,
-	.open	= proc_open,
-	.read	= proc_tx_fifo_read,
-	.write	= proc_tx_fifo_write,
-};
-
-static const struct file_operations proc_rx_fifo_fops = {
-	.owner	= THIS_MODULE,
-	.open	= proc_open,
-	.read	= proc_rx_fifo_read,
-	.write	= proc_rx_fifo_write,
-};
 
 static int proc_init(struct platform_device *pdev)
 {
 	int rc;
 	struct bsc_i2c_dev *dev = platform_get_drvdata(pdev);
 	struct procfs *proc = &dev->proc;
-	struct proc_dir_entry *proc_debug, *proc_reset, *proc_tx_fifo,
-	    *proc_rx_fifo;
+	struct proc_dir_entry *proc_debug, *proc_reset;
 
 	snprintf(proc->name, sizeof(proc->name), "%s%d",
 		 PROC_GLOBAL_PARENT_DIR, pdev->id);
@@ -1632,25 +1699,12 @@ static int proc_init(struct platform_device *pdev)
 		goto err_del_debug;
 	}
 
-	proc_tx_fifo = proc_create_data(PROC_ENTRY_TX_FIFO, 0644, proc->parent,
-					&proc_tx_fifo_fops, dev);
-
-	if (proc_tx_fifo == NULL) {
-		rc = -ENOMEM;
+	/* the FIFO and spin tunables are in sysfs */
+	rc = sysfs_create_group(&pdev->dev.kobj, &bsc_attr_group);
+	if (rc)
 		goto err_del_reset;
-	}
-
-	proc_rx_fifo = proc_create_data(PROC_ENTRY_RX_FIFO, 0644, proc->parent,
-					&proc_rx_fifo_fops, dev);
-	if (proc_rx_fifo == NULL) {
-		rc = -ENOMEM;
-		goto err_del_tx_fifo;
-	}
 	return 0;
 
- err_del_tx_fifo:
-	remove_proc_entry(PROC_ENTRY_TX_FIFO, proc->parent);
-
  err_del_reset:
 	remove_proc_entry(PROC_ENTRY_RESET, proc->parent);
 
@@ -1667,8 +1721,7 @@ static int proc_term(struct platform_device *pdev)
 	struct bsc_i2c_dev *dev = platform_get_drvdata(pdev);
 	struct procfs *proc = &dev->proc;
 
-	remove_proc_entry(PROC_ENTRY_RX_FIFO, proc->parent);
-	remove_proc_entry(PROC_ENTRY_TX_FIFO, proc->parent);
+	sysfs_remove_group(&pdev->dev.kobj, &bsc_attr_group);
 	remove_proc_entry(PROC_ENTRY_RESET, proc->parent);
 	remove_proc_entry(PROC_ENTRY_DEBUG, proc->parent);
 	remove_proc_entry(proc->name, gProcParent);
@@ -1715,22 +1768,19 @@ static void bsc_put_clk(struct bsc_i2c_dev *dev)
 	}
 }
 
+/* both under one CCU lock and write access, skipping a missing one */
 static int bsc_enable_clk(struct bsc_i2c_dev *dev)
 {
-	int ret = 0;
-	if (dev->bsc_apb_clk)
-		ret |= clk_enable(dev->bsc_apb_clk);
-	if (dev->bsc_clk)
-		ret |= clk_enable(dev->bsc_clk);
-	return ret;
+	struct clk *clks[] = { dev->bsc_apb_clk, dev->bsc_clk };
+
+	return clk_enable_group(clks, ARRAY_SIZE(clks));
 }
 
 static void bsc_disable_clk(struct bsc_i2c_dev *dev)
 {
-	if (dev->bsc_clk)
-		clk_disable(dev->bsc_clk);
-	if (dev->bsc_apb_clk)
-		clk_disable(dev->bsc_apb_clk);
+	struct clk *clks[] = { dev->bsc_clk, dev->bsc_apb_clk };
+
+	clk_disable_group(clks, ARRAY_SIZE(clks));
 }
 
 static void i2c_master_reset(struct work_struct *work)
@@ -1998,6 +2048,7 @@ static int bsc_probe(struct platform_device *pdev)
 
 	/* Initialize the completion flags */
 	init_completion(&dev->ses_done);
+	dev->spin_us = BSC_SPIN_US;
 	init_completion(&dev->rx_ready);
 	init_completion(&dev->tx_fifo_empty);
 
@@ -2180,17 +2231,17 @@ static int bsc_probe(struct platform_device *pdev)
 #ifdef CONFIG_DEBUG_FS
 	/*create debugfs interface for the device*/
 	snprintf(dir_name, sizeof(dir_name), "bsc-i2c%d", pdev->id);
-	bsc_dentry = debugfs_create_dir(dir_name, NULL);
-	if (!bsc_dentry && IS_ERR(bsc_dentry)) {
+	dev->dentry = debugfs_create_dir(dir_name, NULL);
+	if (IS_ERR_OR_NULL(dev->dentry)) {
 		printk(KERN_ERR "Failed to create debugfs directory\n");
-	return PTR_ERR(bsc_dentry);
+		dev->dentry = NULL;
+		return 0;
 	}
-	bsc_speed = debugfs_create_file("speed", 0444, bsc_dentry, adap,
-			&default_file_operations);
-	if (!bsc_speed && IS_ERR(bsc_speed)) {
+	if (!debugfs_create_file("speed", 0444, dev->dentry, adap,
+			&default_file_operations) ||
+	    !debugfs_create_file("stats", 0644, dev->dentry, adap,
+			&bsc_stats_fops))
 		printk(KERN_ERR "Failed to create debugfs file\n");
-		return PTR_ERR(bsc_speed);
-	}
 #endif /*CONFIG_DEBUG_FS*/
 	return 0;
 
@@ -2273,15 +2324,14 @@ static int bsc_remove(struct platform_device *pdev)
 	bsc_disable_clk(dev);
 	bsc_put_clk(dev);
 
+#ifdef CONFIG_DEBUG_FS
+	debugfs_remove_recursive(dev->dentry);
+#endif /*CONFIG_DEBUG_FS*/
+
 	kfree(dev);
 
 	iomem = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	release_mem_region(iomem->start, resource_size(iomem));
-
-#ifdef CONFIG_DEBUG_FS
-	debugfs_remove(bsc_speed);
-	debugfs_remove(bsc_dentry);
-#endif /*CONFIG_DEBUG_FS*/
 	return 0;
 }
 
@@ -2462,6 +2512,44 @@ static int bsc_clk_open(struct inode *inode, struct file *file)
 {
 	return single_open(file, show_i2c_bus_speed, inode->i_private);
 }
+
+static int show_bsc_stats(struct seq_file *m, void *v)
+{
+	struct i2c_adapter *adap = m->private;
+	struct bsc_i2c_dev *dev = i2c_get_adapdata(adap);
+	u64 avg;
+
+	mutex_lock(&dev->dev_lock);
+	avg = dev->stats.total_us;
+	if (dev->stats.xfers)
+		do_div(avg, dev->stats.xfers);
+	seq_printf(m, "xfers %u errors %u bytes %llu\n", dev->stats.xfers,
+		   dev->stats.errors, dev->stats.bytes);
+	seq_printf(m, "fifo_msgs %u byte_msgs %u\n", dev->stats.fifo_msgs,
+		   dev->stats.byte_msgs);
+	seq_printf(m, "total_us %llu avg_us %llu max_us %u\n",
+		   dev->stats.total_us, avg, dev->stats.max_us);
+	mutex_unlock(&dev->dev_lock);
+	return 0;
+}
+
+static int bsc_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_bsc_stats, inode->i_private);
+}
+
+static ssize_t bsc_stats_clear(struct file *file, char const __user *buf,
+			size_t size, loff_t *offset)
+{
+	struct i2c_adapter *adap = ((struct seq_file *)
+				    file->private_data)->private;
+	struct bsc_i2c_dev *dev = i2c_get_adapdata(adap);
+
+	mutex_lock(&dev->dev_lock);
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	mutex_unlock(&dev->dev_lock);
+	return size;
+}
 #endif/*CONFIG_DEBUG_FS*/
 
 MODULE_AUTHOR("Broadcom");
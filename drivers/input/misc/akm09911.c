@@ -440,6 +440,7 @@ static struct i2c_driver akm09911_i2c_driver = {
 	.driver	= {
 		.name	= AKM09911_NAME,
 		.owner	= THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm	= &akm09911_pm,
 		.of_match_table = akm09911_of_match,
 	},
@@ -464,6 +464,7 @@ static struct i2c_driver apds9702_driver = {
 	.driver	 = {
 		.owner = THIS_MODULE,
 		.name = APDS9702_NAME,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 	},
 };
 
@@ -515,6 +515,7 @@ static struct i2c_driver bmg160_driver = {
 	.driver = {
 		.name  = BMG160_NAME,
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm	= &bmg160_pm_ops,
 	},
 	.probe         = bmg160_probe,
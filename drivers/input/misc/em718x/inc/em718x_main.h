@@ -29,6 +29,7 @@
 #include <linux/bitops.h>
 #include <linux/device.h>
 #include <linux/sysfs.h>
+#include <linux/workqueue.h>
 
 #include <em718x_portable.h>
 #include <em718x_registers.h>
@@ -36,13 +37,27 @@
 
 
 #define SENSOR_PATH_MAX		128
-#define SENSOR_NUM_ATTR		2
+#define SENSOR_NUM_ATTR		4
+
+/** samples held per sensor while batching */
+#define SENSOR_BATCH_SAMPLES	256
+/** most input events making up one sample (quaternion x,y,z,w + time) */
+#define SENSOR_SAMPLE_EVENTS	5
 
 /** low-hz sensors track timestamps with host time, rather than device time, 
 	to avoid issues with timestamp multiple-wrapping */
 #define SENSOR_FLAG_LOWHZ				0x00000001
 /** update any listeners with the current value of this sensor on enable */
 #define SENSOR_FLAG_UPDATE_ON_ENABLE	0x00000002
+/** wake the host from suspend for samples of this sensor */
+#define SENSOR_FLAG_WAKEUP				0x00000004
+
+/** one batched sample: the input events it is reported with */
+struct em718x_batch_sample {
+	u8						count;
+	u16						code[SENSOR_SAMPLE_EVENTS];
+	u32						value[SENSOR_SAMPLE_EVENTS];
+};
 
 
 struct em718x_sensor {
@@ -78,10 +93,24 @@ struct em718x_sensor {
 	/** bitmask of SENSOR_FLAG_* */
 	u32						flags;
 
+	/** longest time, in ms, a sample may be held before it is reported.
+	 *  0 reports every sample as it comes */
+	unsigned int			max_latency_ms;
+
+	/** ring of held samples, allocated when batching is first enabled */
+	struct em718x_batch_sample	*batch;
+	unsigned int			batch_head;
+	unsigned int			batch_count;
+
+	/** reports the held samples when the oldest reaches max_latency_ms */
+	struct delayed_work		batch_work;
+
 
 	/** the attributes exposed via sysfs */
 	struct device_attribute attr_rate;
 	struct device_attribute attr_enable;
+	struct device_attribute attr_max_latency;
+	struct device_attribute attr_flush;
 	struct attribute*		attrs[SENSOR_NUM_ATTR+1];
 	struct attribute_group	attrs_group;
 
@@ -99,6 +128,16 @@ struct em718x {
 	u64						timebase;
 
 	struct em718x_sensor  	sensors[DST_NUM_SENSOR_TYPES];
+
+	/** set between suspend and resume */
+	bool					suspended;
+	/** irq armed as a wakeup source for the current suspend */
+	bool					irq_wake;
+
+	/** host wakeup statistics, since stats_start (jiffies) */
+	u64						stats_start;
+	u32						wakeups;
+	u32						batch_flushes;
 };
 
 
@@ -147,7 +147,7 @@
 #define SENSOR_CUST2_NAME			"cust2"
 #define SENSOR_CUST2_DESC			"EM7180 Tilt"
 #define SENSOR_CUST2_VERSION		1
-#define SENSOR_CUST2_FLAGS			0
+#define SENSOR_CUST2_FLAGS			SENSOR_FLAG_WAKEUP
 
 static inline void em718x_lock(struct em718x * emdev)
 {
@@ -331,9 +331,110 @@ static inline void send_event( struct input_dev * input, u32 code, u32 value )
 	input_event(input, INPUT_EVENT_TYPE, code, value);
 }
 
+
+/*********************************************************************
+  Sample Batching
+
+	The EM718x keeps only the latest sample of each sensor, so batching
+	is done on the host: with a max_latency set, the samples of a sensor
+	are held in its ring and only reported, in a burst, when the oldest
+	has been held max_latency_ms, when the ring fills up, or on a flush
+	request. While the host is suspended, samples of sensors without
+	SENSOR_FLAG_WAKEUP stay held and the oldest are dropped when the
+	ring is full. All of this runs under the device mutex.
+
+*********************************************************************/
+
+static void em718x_sensor_flush( struct em718x_sensor * sensor, bool marker )
+{
+	struct input_dev * input = sensor->input;
+	unsigned int i, j, idx;
+
+	cancel_delayed_work(&sensor->batch_work);
+
+	if( sensor->batch_count ) {
+		idx = (sensor->batch_head + SENSOR_BATCH_SAMPLES - sensor->batch_count) % SENSOR_BATCH_SAMPLES;
+		for(i=0; i<sensor->batch_count; i++) {
+			struct em718x_batch_sample * s = &sensor->batch[idx];
+
+			for(j=0; j<s->count; j++)
+				send_event( input, s->code[j], s->value[j] );
+			input_sync( input );
+			idx = (idx + 1) % SENSOR_BATCH_SAMPLES;
+		}
+		sensor->batch_count = 0;
+		sensor->dev->batch_flushes++;
+	}
+
+	if( marker ) {
+		send_event( input, INPUT_EVENT_FLUSH, 0 );
+		input_sync( input );
+	}
+}
+
+static void em718x_batch_work( struct work_struct * work )
+{
+	struct em718x_sensor * sensor = container_of(to_delayed_work(work), struct em718x_sensor, batch_work);
+
+	mutex_lock(&sensor->dev->mutex);
+	em718x_sensor_flush( sensor, FALSE );
+	mutex_unlock(&sensor->dev->mutex);
+}
+
+static inline bool sensor_batching( struct em718x_sensor * sensor )
+{
+	return sensor->max_latency_ms && sensor->batch;
+}
+
+static void sensor_event( struct em718x_sensor * sensor, u32 code, u32 value )
+{
+	struct em718x_batch_sample * s;
+
+	if( !sensor_batching( sensor ) ) {
+		send_event( sensor->input, code, value );
+		return;
+	}
+
+	s = &sensor->batch[sensor->batch_head];
+	if( s->count < SENSOR_SAMPLE_EVENTS ) {
+		s->code[s->count] = code;
+		s->value[s->count] = value;
+		s->count++;
+	}
+}
+
+static void sensor_sync( struct em718x_sensor * sensor )
+{
+	struct em718x * emdev = sensor->dev;
+
+	if( !sensor_batching( sensor ) ) {
+		input_sync( sensor->input );
+		return;
+	}
+
+	/* commit the sample. The slot at batch_head is the one being filled,
+	   so a full ring while suspended reuses, and drops, the oldest */
+	sensor->batch_head = (sensor->batch_head + 1) % SENSOR_BATCH_SAMPLES;
+	if( sensor->batch_count < SENSOR_BATCH_SAMPLES - 1 )
+		sensor->batch_count++;
+	sensor->batch[sensor->batch_head].count = 0;
+
+	if( emdev->suspended && !(sensor->flags & SENSOR_FLAG_WAKEUP) )
+		return;
+
+	if( sensor->batch_count == SENSOR_BATCH_SAMPLES - 1 ||
+		(emdev->suspended && (sensor->flags & SENSOR_FLAG_WAKEUP)) ) {
+		em718x_sensor_flush( sensor, FALSE );
+		return;
+	}
+
+	if( sensor->batch_count == 1 )
+		queue_delayed_work(system_freezable_wq, &sensor->batch_work,
+						   msecs_to_jiffies(sensor->max_latency_ms));
+}
+
 static void _em718x_sensor_3axes_notify( struct em718x_sensor * sensor, DI_3AXIS_INT_DATA_T * d )
 {
-	struct input_dev  * input  	= sensor->input; 
 
 	if(!d->valid)
 		return;
@@ -341,10 +442,10 @@ static void _em718x_sensor_3axes_notify( struct em718x_sensor * sensor, DI_3AXIS
 	if(!_em718x_sensor_ready( sensor, d->t ) )
 		return;
 
-	send_event( input, INPUT_EVENT_XY, (((u32)d->y)<<16) | d->x);
-	send_event( input, INPUT_EVENT_ZW, d->z );
-	send_event( input, INPUT_EVENT_TIME, sensor->timestamp );
-	input_sync( input );
+	sensor_event( sensor, INPUT_EVENT_XY, (((u32)d->y)<<16) | d->x);
+	sensor_event( sensor, INPUT_EVENT_ZW, d->z );
+	sensor_event( sensor, INPUT_EVENT_TIME, sensor->timestamp );
+	sensor_sync( sensor );
 
 	d->valid = FALSE;
 }
@@ -365,7 +466,6 @@ static void _em718x_sensor_gyro_notify( struct em718x_sensor * sensor, DI_SENSOR
 
 static void _em718x_sensor_quat_notify( struct em718x_sensor * sensor, DI_SENSOR_INT_DATA_T* data  )
 {
-	struct input_dev    * input  	= sensor->input; 
 	DI_QUATERNION_INT_T * d 		= &data->quaternion;
 
 	if(!d->valid)
@@ -374,12 +474,12 @@ static void _em718x_sensor_quat_notify( struct em718x_sensor * sensor, DI_SENSOR
 	if(!_em718x_sensor_ready( sensor, d->t ) )
 		return;
 
-	send_event( input, INPUT_EVENT_X, d->x);
-	send_event( input, INPUT_EVENT_Y, d->y);
-	send_event( input, INPUT_EVENT_Z, d->z);
-	send_event( input, INPUT_EVENT_W, d->w);
-	send_event( input, INPUT_EVENT_TIME, sensor->timestamp );
-	input_sync( input );
+	sensor_event( sensor, INPUT_EVENT_X, d->x);
+	sensor_event( sensor, INPUT_EVENT_Y, d->y);
+	sensor_event( sensor, INPUT_EVENT_Z, d->z);
+	sensor_event( sensor, INPUT_EVENT_W, d->w);
+	sensor_event( sensor, INPUT_EVENT_TIME, sensor->timestamp );
+	sensor_sync( sensor );
 
 	d->valid = FALSE;
 }
@@ -395,7 +495,6 @@ static void _em718x_sensor_humid_notify( struct em718x_sensor * sensor, DI_SENSO
 
 static void _em718x_sensor_cust0_notify( struct em718x_sensor * sensor, DI_SENSOR_INT_DATA_T* data  )
 {
-	struct input_dev  * input  	= sensor->input; 
 	DI_FEATURE_DATA_T * d 		= &data->feature[0];
 
 	if(!d->valid)
@@ -404,15 +503,14 @@ static void _em718x_sensor_cust0_notify( struct em718x_sensor * sensor, DI_SENSO
 	if(!_em718x_sensor_ready( sensor, d->t ) )
 		return;
 
-	send_event( input, INPUT_EVENT_XY, d->data);
-	send_event( input, INPUT_EVENT_TIME, sensor->timestamp );
-	input_sync( input );
+	sensor_event( sensor, INPUT_EVENT_XY, d->data);
+	sensor_event( sensor, INPUT_EVENT_TIME, sensor->timestamp );
+	sensor_sync( sensor );
 
 	d->valid = FALSE;
 }
 static void _em718x_sensor_cust1_notify( struct em718x_sensor * sensor, DI_SENSOR_INT_DATA_T* data  )
 {
-	struct input_dev  * input  	= sensor->input; 
 	DI_FEATURE_DATA_T * d 		= &data->feature[1];
 
 	INSANE("sensor:%s valid:%d", sensor->name, d->valid );
@@ -423,15 +521,14 @@ static void _em718x_sensor_cust1_notify( struct em718x_sensor * sensor, DI_SENSO
 	if(!_em718x_sensor_ready( sensor, d->t ) )
 		return;
 
-	send_event( input, INPUT_EVENT_XY, d->data );
-	send_event( input, INPUT_EVENT_TIME, sensor->timestamp );
-	input_sync( input );
+	sensor_event( sensor, INPUT_EVENT_XY, d->data );
+	sensor_event( sensor, INPUT_EVENT_TIME, sensor->timestamp );
+	sensor_sync( sensor );
 
 	d->valid = FALSE;
 }
 static void _em718x_sensor_cust2_notify( struct em718x_sensor * sensor, DI_SENSOR_INT_DATA_T* data  )
 {
-	struct input_dev  * input  	= sensor->input; 
 	DI_FEATURE_DATA_T * d 		= &data->feature[2];
 
 	if(!d->valid)
@@ -440,9 +537,9 @@ static void _em718x_sensor_cust2_notify( struct em718x_sensor * sensor, DI_SENSO
 	if(!_em718x_sensor_ready( sensor, d->t ) )
 		return;
 
-	send_event( input, INPUT_EVENT_XY, d->data);
-	send_event( input, INPUT_EVENT_TIME, sensor->timestamp );
-	input_sync( input );
+	sensor_event( sensor, INPUT_EVENT_XY, d->data);
+	sensor_event( sensor, INPUT_EVENT_TIME, sensor->timestamp );
+	sensor_sync( sensor );
 
 	d->valid = FALSE;
 }
@@ -456,6 +553,10 @@ static irqreturn_t em718x_irq_thread(int irq, void *handle)
 
 	INSANE("irq enter");
 
+	/* only a wakeup sensor keeps the irq armed across suspend */
+	if(emdev->suspended)
+		emdev->wakeups++;
+
 #if 0
 	if(emdev->host_enabled==0) {
 		if( (++emdev->interrupt_errors % 100) == 0) {
@@ -588,6 +689,9 @@ static ssize_t em718x_sensor_enable_store(struct device *dev, struct device_attr
 	if(enabled == enable) 
 		goto unlock; 
 
+	if(!enable)
+		em718x_sensor_flush( sensor, FALSE );
+
 	if(!di_enable_sensor_acquisition(sensor->dev->di, sensor->type, enable))
 		goto unlock;
 
@@ -679,6 +783,91 @@ static ssize_t em718x_sensor_rate_store(struct device *dev, struct device_attrib
 
 
 
+/**
+ * \brief Called by the kernel when userspace reads the "max_latency" sysfs file
+ * \param dev - The device that owns the sysfs file, in this case an input_dev device
+ * \param attr - The attribute being requested
+ * \param buf - The character buffer to format the response into
+ * \return bool - number of characters in buf on success, <1 on error
+ */
+static ssize_t em718x_sensor_max_latency_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct em718x_sensor *sensor = dev_get_drvdata(dev);
+	unsigned int val;
+
+	em718x_lock(sensor->dev);
+	val = sensor->max_latency_ms;
+	em718x_unlock(sensor->dev);
+
+	return sprintf(buf, "%u\n", val );
+}
+
+/**
+ * \brief Called by the kernel when userspace writes the "max_latency" sysfs file.
+ *        The value is the longest time, in ms, a sample may be held before it
+ *        is reported; 0 turns batching off and reports what is held.
+ * \param dev - The device that owns the sysfs file, in this case an input_dev device
+ * \param attr - The attribute being requested
+ * \param buf - The character buffer to read the ascii value from
+ * \param count - The number of bytes in buf
+ * \return bool - number of characters in buf on success, <1 on error
+ */
+static ssize_t em718x_sensor_max_latency_store(struct device *dev, struct device_attribute *attr,
+									  const char *buf, size_t count)
+{
+	struct em718x_sensor *sensor = dev_get_drvdata(dev);
+	unsigned long val;
+	int error;
+
+	error = strict_strtoul(buf, 10, &val);
+	if (error)
+		return error;
+
+	DMSG("set sensor %s max latency %ld ms", sensor->name, val);
+
+	em718x_lock(sensor->dev);
+
+	if(val && !sensor->batch) {
+		sensor->batch = kcalloc(SENSOR_BATCH_SAMPLES, sizeof(*sensor->batch), GFP_KERNEL);
+		if(!sensor->batch) {
+			em718x_unlock(sensor->dev);
+			return -ENOMEM;
+		}
+	}
+
+	/* samples held under the old latency go out now */
+	em718x_sensor_flush( sensor, FALSE );
+	if(sensor->batch)
+		sensor->batch[sensor->batch_head].count = 0;
+	sensor->max_latency_ms = val;
+
+	em718x_unlock(sensor->dev);
+
+	return count;
+}
+
+/**
+ * \brief Called by the kernel when userspace writes the "flush" sysfs file.
+ *        Reports the held samples, followed by an INPUT_EVENT_FLUSH event.
+ * \param dev - The device that owns the sysfs file, in this case an input_dev device
+ * \param attr - The attribute being requested
+ * \param buf - unused
+ * \param count - The number of bytes in buf
+ * \return bool - number of characters in buf on success, <1 on error
+ */
+static ssize_t em718x_sensor_flush_store(struct device *dev, struct device_attribute *attr,
+									  const char *buf, size_t count)
+{
+	struct em718x_sensor *sensor = dev_get_drvdata(dev);
+
+	em718x_lock(sensor->dev);
+	em718x_sensor_flush( sensor, TRUE );
+	em718x_unlock(sensor->dev);
+
+	return count;
+}
+
+
 /**
  * \brief Called by probe() to load firmware onto the SFP
  * \param emdev - The em718x device
@@ -834,6 +1023,29 @@ void em718x_dump_registers(struct seq_file *s)
 	}
 }
 
+/* host wakeups from suspend and batch reports, with their hourly rates */
+void em718x_dump_wakeups(struct seq_file *s)
+{
+	if(emdev) {
+		u64 secs;
+		u32 wakeups, flushes;
+
+		em718x_lock(emdev);
+		secs = div_u64((get_jiffies_64() - emdev->stats_start), HZ);
+		wakeups = emdev->wakeups;
+		flushes = emdev->batch_flushes;
+		em718x_unlock(emdev);
+
+		if(!secs)
+			secs = 1;
+		seq_printf(s, "seconds: %llu\n", secs);
+		seq_printf(s, "wakeups: %u (%llu per hour)\n", wakeups,
+				   div_u64((u64)wakeups * 3600, secs));
+		seq_printf(s, "batch reports: %u (%llu per hour)\n", flushes,
+				   div_u64((u64)flushes * 3600, secs));
+	}
+}
+
 
 static int em718x_debug_show(struct seq_file *s, void *unused)
 {
@@ -867,6 +1079,8 @@ static int em718x_init_debugfs(void)
 
 	debugfs_create_file("registers", S_IRUGO, em718x_debugfs_dir,
 			&em718x_dump_registers, &em718x_debug_fops);
+	debugfs_create_file("wakeups", S_IRUGO, em718x_debugfs_dir,
+			&em718x_dump_wakeups, &em718x_debug_fops);
 
 	return 0;
 }
@@ -932,6 +1146,7 @@ static int em718x_probe(struct i2c_client *client,
 
 
 	mutex_init(&emdev->mutex);
+	emdev->stats_start = get_jiffies_64();
 
 	// allow the load to fail... there may still be eeprom
 	em718x_load_firmware(emdev, id->name);
@@ -942,6 +1157,7 @@ static int em718x_probe(struct i2c_client *client,
 		struct input_dev * input; 
 
 		sensor->dev 		= emdev;
+		INIT_DELAYED_WORK(&sensor->batch_work, em718x_batch_work);
 
 		if(!di_has_sensor( emdev->di, i) )
 			continue;
@@ -970,6 +1186,17 @@ static int em718x_probe(struct i2c_client *client,
 		sensor->attr_enable.store = em718x_sensor_enable_store;		
 		sensor->attrs[0] = &sensor->attr_rate.attr;						
 		sensor->attrs[1] = &sensor->attr_enable.attr;					
+		sysfs_attr_init(&sensor->attr_max_latency);
+		sysfs_attr_init(&sensor->attr_flush);
+		sensor->attr_max_latency.attr.name = "max_latency";
+		sensor->attr_max_latency.attr.mode = 0664;
+		sensor->attr_max_latency.show = em718x_sensor_max_latency_show;
+		sensor->attr_max_latency.store = em718x_sensor_max_latency_store;
+		sensor->attr_flush.attr.name = "flush";
+		sensor->attr_flush.attr.mode = 0220;
+		sensor->attr_flush.store = em718x_sensor_flush_store;
+		sensor->attrs[2] = &sensor->attr_max_latency.attr;
+		sensor->attrs[3] = &sensor->attr_flush.attr;
 		sensor->attrs_group.name = "sensor";							
 		sensor->attrs_group.attrs = sensor->attrs;	
 
@@ -982,6 +1209,8 @@ static int em718x_probe(struct i2c_client *client,
 		input->open	 		= em718x_input_sensor_open;
 		input->close 		= em718x_input_sensor_close;		
 		input_set_drvdata(input,sensor);
+		/* size the evdev buffers (8 packets) for a whole batch burst */
+		input_set_events_per_packet(input, SENSOR_BATCH_SAMPLES * (SENSOR_SAMPLE_EVENTS + 1) / 8);
 
 		switch( i ) {
 
@@ -993,7 +1222,8 @@ static int em718x_probe(struct i2c_client *client,
 					input->name  	= SENSOR_##u##_DESC;			
 
 			#define setup_event_type												\
-					__set_bit( INPUT_EVENT_TYPE, input->evbit );					
+					__set_bit( INPUT_EVENT_TYPE, input->evbit );					\
+					__set_bit( INPUT_EVENT_FLUSH, input->mscbit );
 
 			#define setup_msc_16()													\
 					setup_event_type												\
@@ -1117,8 +1347,10 @@ err_free_input:
 		struct input_dev * input = sensor->input;
 		if( input ) {
 			sysfs_remove_group(&input->dev.kobj, &sensor->attrs_group);
+			cancel_delayed_work_sync(&sensor->batch_work);
 			input_unregister_device(input);
 		}
+		kfree(sensor->batch);
 	}
 
 
@@ -1146,8 +1378,10 @@ static int em718x_remove(struct i2c_client *client)
 		struct input_dev * input = sensor->input;
 		if( input ) {
 			sysfs_remove_group(&input->dev.kobj, &sensor->attrs_group);
+			cancel_delayed_work_sync(&sensor->batch_work);
 			input_unregister_device(input);
 		}
+		kfree(sensor->batch);
 	}
 
 	kfree(emdev);
@@ -1156,15 +1390,55 @@ static int em718x_remove(struct i2c_client *client)
 }
 
 #ifdef CONFIG_PM
+/* the irq stays armed only if a sensor that may wake the host is enabled;
+   otherwise the hub is left running and batched samples stay held */
 static int em718x_suspend(struct device *dev)
 {
-	DMSG("suspend");
+	struct em718x *emdev = dev_get_drvdata(dev);
+	bool wake = FALSE;
+	int i;
+
+	em718x_lock(emdev);
+	emdev->suspended = TRUE;
+	for(i=DST_FIRST; i<DST_NUM_SENSOR_TYPES; i++) {
+		struct em718x_sensor * sensor = &emdev->sensors[i];
+
+		if( sensor->input && (sensor->flags & SENSOR_FLAG_WAKEUP) &&
+			sensor->info->acquisition_enable )
+			wake = TRUE;
+	}
+	em718x_unlock(emdev);
+
+	emdev->irq_wake = wake && !enable_irq_wake(emdev->irq);
+	if(!emdev->irq_wake)
+		disable_irq(emdev->irq);
+
+	DMSG("suspend, wakeup irq %d", emdev->irq_wake);
 
 	return 0;
 }
 
 static int em718x_resume(struct device *dev)
 {
+	struct em718x *emdev = dev_get_drvdata(dev);
+	int i;
+
+	if(emdev->irq_wake)
+		disable_irq_wake(emdev->irq);
+	else
+		enable_irq(emdev->irq);
+
+	/* the host is up anyway: report what was held while it slept */
+	em718x_lock(emdev);
+	emdev->suspended = FALSE;
+	for(i=DST_FIRST; i<DST_NUM_SENSOR_TYPES; i++) {
+		struct em718x_sensor * sensor = &emdev->sensors[i];
+
+		if( sensor->batch_count )
+			mod_delayed_work(system_freezable_wq, &sensor->batch_work, 0);
+	}
+	em718x_unlock(emdev);
+
 	DMSG("resume");
 
 	return 0;
@@ -1186,6 +1460,7 @@ static struct i2c_driver em718x_driver = {
 	.driver = {
 		.name = "em718x",
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.pm = &em718x_pm,
 	},
 	.probe    = em718x_probe,
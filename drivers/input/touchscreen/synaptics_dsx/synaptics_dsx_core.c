@@ -26,8 +26,12 @@
 #include <linux/platform_device.h>
 #include <linux/hrtimer.h>
 #include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/workqueue.h>
 #include <linux/regulator/consumer.h>
 #include <linux/input/synaptics_dsx_new.h>
+#include <video/kona_fb.h>
 #include "synaptics_dsx_core.h"
 #ifdef KERNEL_ABOVE_2_6_38
 #include <linux/input/mt.h>
@@ -49,6 +53,15 @@
 
 #define F12_DATA_15_WORKAROUND
 
+/*
+ * Read all the F12 finger slots in one transfer, skipping the Data15
+ * object present mask, when they are no more than this many bytes.
+ */
+#define F12_BURST_READ_MAX 48
+
+/* longest wait for a vsync before a gesture report is read anyway */
+#define GESTURE_POLL_MS 20
+
 /*
 #define IGNORE_FN_INIT_FAILURE
 */
@@ -147,6 +160,12 @@ static ssize_t synaptics_rmi4_virtual_key_map_show(struct kobject *kobj,
 static ssize_t synaptics_rmi4_poll_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t count);
 
+static ssize_t synaptics_rmi4_vsync_poll_show(struct device *dev,
+		struct device_attribute *attr, char *buf);
+
+static ssize_t synaptics_rmi4_vsync_poll_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count);
+
 static ssize_t synaptics_palm_size_show(struct device *dev,
 		struct device_attribute *attr, char *buf);
 
@@ -546,6 +565,9 @@ static struct device_attribute attrs[] = {
 	__ATTR(poll, S_IWUGO,
 			synaptics_rmi4_show_error,
 			synaptics_rmi4_poll_store),
+	__ATTR(vsync_poll, S_IRUGO | S_IWUSR | S_IWGRP,
+			synaptics_rmi4_vsync_poll_show,
+			synaptics_rmi4_vsync_poll_store),
 	__ATTR(palm_size,  S_IRUGO | S_IWUSR | S_IWGRP,
 			synaptics_palm_size_show,
 			synaptics_palm_size_store),
@@ -896,6 +918,99 @@ static ssize_t synaptics_rmi4_poll_store(struct device *dev,
 	return count;
 }
 
+static ssize_t synaptics_rmi4_vsync_poll_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct synaptics_rmi4_data *rmi4_data = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", rmi4_data->vsync_poll);
+}
+
+static ssize_t synaptics_rmi4_vsync_poll_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	unsigned long t;
+	struct synaptics_rmi4_data *rmi4_data = dev_get_drvdata(dev);
+	int rc;
+
+	rc = kstrtoul(buf, 10, &t);
+	if (rc)
+		return rc;
+	if (t && !rmi4_data->gesture_wq)
+		return -ENOMEM;
+	/* a gesture in progress goes back to interrupts at finger up */
+	rmi4_data->vsync_poll = !!t;
+	return count;
+}
+
+/*
+ * Latency trace: one entry per 2D report, from the attention interrupt
+ * (or the vsync while a gesture is polled) to the end of the bus read
+ * and to input_sync.
+ */
+static void synaptics_rmi4_trace_report(struct synaptics_rmi4_data *rmi4_data,
+		unsigned char fingers)
+{
+	struct synaptics_rmi4_latency *lat;
+	ktime_t now = ktime_get();
+	unsigned long flags;
+
+	if (!ktime_to_ns(rmi4_data->report_start))
+		return;
+
+	spin_lock_irqsave(&rmi4_data->latency_lock, flags);
+	lat = &rmi4_data->latency[rmi4_data->latency_head];
+	lat->start = rmi4_data->report_start;
+	lat->read_us = ktime_us_delta(rmi4_data->report_read, lat->start);
+	lat->sync_us = ktime_us_delta(now, lat->start);
+	lat->fingers = fingers;
+	lat->vsync = rmi4_data->report_vsync;
+	rmi4_data->latency_head = (rmi4_data->latency_head + 1) %
+			LATENCY_TRACE_SIZE;
+	if (rmi4_data->latency_count < LATENCY_TRACE_SIZE)
+		rmi4_data->latency_count++;
+	spin_unlock_irqrestore(&rmi4_data->latency_lock, flags);
+
+	rmi4_data->report_start = ktime_set(0, 0);
+}
+
+static int synaptics_rmi4_latency_show(struct seq_file *s, void *unused)
+{
+	struct synaptics_rmi4_data *rmi4_data = s->private;
+	struct synaptics_rmi4_latency *lat;
+	unsigned int i, first;
+	unsigned long flags;
+
+	seq_puts(s, "start_us source fingers read_us sync_us\n");
+
+	spin_lock_irqsave(&rmi4_data->latency_lock, flags);
+	first = rmi4_data->latency_head + LATENCY_TRACE_SIZE -
+			rmi4_data->latency_count;
+	for (i = 0; i < rmi4_data->latency_count; i++) {
+		lat = &rmi4_data->latency[(first + i) % LATENCY_TRACE_SIZE];
+		seq_printf(s, "%lld %s %u %u %u\n",
+				ktime_to_us(lat->start),
+				lat->vsync ? "vsync" : "irq",
+				lat->fingers, lat->read_us, lat->sync_us);
+	}
+	spin_unlock_irqrestore(&rmi4_data->latency_lock, flags);
+
+	return 0;
+}
+
+static int synaptics_rmi4_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, synaptics_rmi4_latency_show,
+			inode->i_private);
+}
+
+static const struct file_operations synaptics_rmi4_latency_fops = {
+	.open = synaptics_rmi4_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static void wg_timer_cb(unsigned long data)
 {
 	struct synaptics_rmi4_data *rmi4_data =
@@ -1122,7 +1237,10 @@ static int synaptics_rmi4_f11_abs_report(struct synaptics_rmi4_data *rmi4_data,
 		rmi4_data->lo_detected = false;
 	}
 
+	/* the finger data is read as it is reported */
+	rmi4_data->report_read = ktime_get();
 	input_sync(rmi4_data->input_dev);
+	synaptics_rmi4_trace_report(rmi4_data, touch_count);
 
 exit:
 	mutex_unlock(&(rmi4_data->rmi4_report_mutex));
@@ -1177,8 +1295,14 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 		return 0;
 	}
 
-	/* Determine the total number of fingers to process */
-	if (extra_data->data15_size) {
+	/*
+	 * Determine the total number of fingers to process. With few
+	 * enough slots they are all read at once, which saves the Data15
+	 * transfer and its round trip on the bus.
+	 */
+	if (fhandler->data_size <= F12_BURST_READ_MAX) {
+		fingers_to_process = fhandler->num_of_data_points;
+	} else if (extra_data->data15_size) {
 		retval = synaptics_rmi4_reg_read(rmi4_data,
 				data_addr + extra_data->data15_offset,
 				extra_data->data15_data,
@@ -1223,6 +1347,7 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 			fingers_to_process * size_of_2d_data);
 	if (retval < 0)
 		return 0;
+	rmi4_data->report_read = ktime_get();
 
 	data = (struct synaptics_rmi4_f12_finger_data *)fhandler->data;
 
@@ -1321,6 +1446,7 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	}
 
 	input_sync(rmi4_data->input_dev);
+	synaptics_rmi4_trace_report(rmi4_data, touch_count);
 
 	mutex_unlock(&(rmi4_data->rmi4_report_mutex));
 
@@ -1537,6 +1663,96 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 	return;
 }
 
+/*
+ * While fingers are down and vsync_poll is set, the attention interrupt
+ * is left disabled and the reports are read once per display vsync
+ * instead. Reports the controller made in between are coalesced into
+ * the latest one, read just before the frame it can still make.
+ * gesture_timer reads anyway when no vsync comes for GESTURE_POLL_MS,
+ * and at finger up the interrupt is enabled again.
+ */
+static void synaptics_rmi4_gesture_start(struct synaptics_rmi4_data *rmi4_data)
+{
+	mutex_lock(&rmi4_data->gesture_mutex);
+	if (!rmi4_data->gesture_poll) {
+		rmi4_data->gesture_poll = true;
+		/* from the irq thread: the oneshot unmask is skipped */
+		disable_irq_nosync(rmi4_data->irq);
+		hrtimer_start(&rmi4_data->gesture_timer,
+				ktime_set(0, GESTURE_POLL_MS * NSEC_PER_MSEC),
+				HRTIMER_MODE_REL);
+	}
+	mutex_unlock(&rmi4_data->gesture_mutex);
+}
+
+static void synaptics_rmi4_gesture_stop(struct synaptics_rmi4_data *rmi4_data)
+{
+	mutex_lock(&rmi4_data->gesture_mutex);
+	if (rmi4_data->gesture_poll) {
+		rmi4_data->gesture_poll = false;
+		enable_irq(rmi4_data->irq);
+	}
+	mutex_unlock(&rmi4_data->gesture_mutex);
+
+	hrtimer_cancel(&rmi4_data->gesture_timer);
+	cancel_work_sync(&rmi4_data->gesture_work);
+}
+
+static void synaptics_rmi4_gesture_work(struct work_struct *work)
+{
+	struct synaptics_rmi4_data *rmi4_data =
+		container_of(work, struct synaptics_rmi4_data, gesture_work);
+
+	mutex_lock(&rmi4_data->gesture_mutex);
+	if (!rmi4_data->gesture_poll)
+		goto exit;
+
+	rmi4_data->report_start = ktime_get();
+	rmi4_data->report_vsync = true;
+	synaptics_rmi4_sensor_report(rmi4_data);
+
+	if (rmi4_data->fingers_on_2d && rmi4_data->vsync_poll) {
+		hrtimer_start(&rmi4_data->gesture_timer,
+				ktime_set(0, GESTURE_POLL_MS * NSEC_PER_MSEC),
+				HRTIMER_MODE_REL);
+	} else {
+		rmi4_data->gesture_poll = false;
+		enable_irq(rmi4_data->irq);
+	}
+
+exit:
+	mutex_unlock(&rmi4_data->gesture_mutex);
+}
+
+static enum hrtimer_restart synaptics_rmi4_gesture_timer(struct hrtimer *timer)
+{
+	struct synaptics_rmi4_data *rmi4_data =
+		container_of(timer, struct synaptics_rmi4_data, gesture_timer);
+
+	queue_work(rmi4_data->gesture_wq, &rmi4_data->gesture_work);
+	return HRTIMER_NORESTART;
+}
+
+static int synaptics_rmi4_vsync(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct synaptics_rmi4_data *rmi4_data =
+		container_of(nb, struct synaptics_rmi4_data, vsync_nb);
+
+	if (rmi4_data->gesture_poll)
+		queue_work(rmi4_data->gesture_wq, &rmi4_data->gesture_work);
+	return NOTIFY_OK;
+}
+
+static irqreturn_t synaptics_rmi4_hardirq(int irq, void *data)
+{
+	struct synaptics_rmi4_data *rmi4_data = data;
+
+	rmi4_data->report_start = ktime_get();
+	rmi4_data->report_vsync = false;
+	return IRQ_WAKE_THREAD;
+}
+
 static irqreturn_t synaptics_rmi4_irq(int irq, void *data)
 {
 	struct synaptics_rmi4_data *rmi4_data = data;
@@ -1546,8 +1762,11 @@ static irqreturn_t synaptics_rmi4_irq(int irq, void *data)
 	if (gpio_get_value(bdata->irq_gpio) != bdata->irq_on_state)
 		goto exit;
 
-	if (!rmi4_data->poll)
+	if (!rmi4_data->poll) {
 		synaptics_rmi4_sensor_report(rmi4_data);
+		if (rmi4_data->vsync_poll && rmi4_data->fingers_on_2d)
+			synaptics_rmi4_gesture_start(rmi4_data);
+	}
 
 exit:
 	return IRQ_HANDLED;
@@ -1573,6 +1792,9 @@ static void synaptics_rmi4_data_poll(struct work_struct *work)
 	struct synaptics_rmi4_fn *fhandler;
 	struct synaptics_rmi4_device_info *rmi = &(rmi4_data->rmi4_mod_info);
 
+	rmi4_data->report_start = ktime_get();
+	rmi4_data->report_vsync = false;
+
 	if (!list_empty(&rmi->support_fn_list)) {
 		list_for_each_entry(fhandler, &rmi->support_fn_list, link) {
 			if (fhandler->num_of_data_sources) {
@@ -1642,14 +1864,16 @@ static int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 		synaptics_rmi4_sensor_report(rmi4_data);
 
 		if (rmi4_data->enable_wakeup_gesture) {
-			retval = request_threaded_irq(rmi4_data->irq, NULL,
+			retval = request_threaded_irq(rmi4_data->irq,
+				synaptics_rmi4_hardirq,
 				synaptics_rmi4_irq, bdata->irq_flags |
 				IRQF_NO_SUSPEND,
 				PLATFORM_DRIVER_NAME, rmi4_data);
 			if (retval < 0)
 				irq_set_irq_wake(rmi4_data->irq, 1);
 		} else {
-			retval = request_threaded_irq(rmi4_data->irq, NULL,
+			retval = request_threaded_irq(rmi4_data->irq,
+				synaptics_rmi4_hardirq,
 				synaptics_rmi4_irq, bdata->irq_flags,
 				PLATFORM_DRIVER_NAME, rmi4_data);
 		}
@@ -1671,6 +1895,7 @@ static int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 					rmi4_data->ktime, HRTIMER_MODE_REL);
 	} else {
 		if (rmi4_data->irq_enabled) {
+			synaptics_rmi4_gesture_stop(rmi4_data);
 			disable_irq(rmi4_data->irq);
 			free_irq(rmi4_data->irq, rmi4_data);
 			rmi4_data->irq_enabled = false;
@@ -3337,6 +3562,12 @@ static int synaptics_rmi4_probe(struct platform_device *pdev)
 	hrtimer_init(&rmi4_data->hr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	INIT_WORK(&rmi4_data->poll_work, synaptics_rmi4_data_poll);
 	rmi4_data->hr_timer.function = synaptics_rmi4_hrtimer;
+	mutex_init(&rmi4_data->gesture_mutex);
+	INIT_WORK(&rmi4_data->gesture_work, synaptics_rmi4_gesture_work);
+	hrtimer_init(&rmi4_data->gesture_timer, CLOCK_MONOTONIC,
+			HRTIMER_MODE_REL);
+	rmi4_data->gesture_timer.function = synaptics_rmi4_gesture_timer;
+	spin_lock_init(&rmi4_data->latency_lock);
 
 	platform_set_drvdata(pdev, rmi4_data);
 
@@ -3440,6 +3671,16 @@ static int synaptics_rmi4_probe(struct platform_device *pdev)
 		}
 	}
 
+	rmi4_data->gesture_wq = alloc_workqueue("dsx_gesture", WQ_HIGHPRI, 1);
+	/* without the notifier a gesture is read every GESTURE_POLL_MS */
+	rmi4_data->vsync_nb.notifier_call = synaptics_rmi4_vsync;
+	kona_fb_register_vsync_notifier(&rmi4_data->vsync_nb);
+
+	rmi4_data->debugfs_dir = debugfs_create_dir("synaptics_dsx", NULL);
+	if (!IS_ERR_OR_NULL(rmi4_data->debugfs_dir))
+		debugfs_create_file("latency", S_IRUSR, rmi4_data->debugfs_dir,
+				rmi4_data, &synaptics_rmi4_latency_fops);
+
 	exp_data.workqueue = create_singlethread_workqueue("dsx_exp_workqueue");
 	INIT_DELAYED_WORK(&exp_data.work, synaptics_rmi4_exp_fn_work);
 	exp_data.rmi4_data = rmi4_data;
@@ -3507,6 +3748,9 @@ static int synaptics_rmi4_remove(struct platform_device *pdev)
 	flush_workqueue(exp_data.workqueue);
 	destroy_workqueue(exp_data.workqueue);
 
+	debugfs_remove_recursive(rmi4_data->debugfs_dir);
+	kona_fb_unregister_vsync_notifier(&rmi4_data->vsync_nb);
+
 	for (attr_count = 0; attr_count < ARRAY_SIZE(attrs); attr_count++) {
 		sysfs_remove_file(&rmi4_data->input_dev->dev.kobj,
 				&attrs[attr_count].attr);
@@ -3519,6 +3763,8 @@ static int synaptics_rmi4_remove(struct platform_device *pdev)
 	}
 
 	synaptics_rmi4_irq_enable(rmi4_data, false, false);
+	if (rmi4_data->gesture_wq)
+		destroy_workqueue(rmi4_data->gesture_wq);
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
 	unregister_early_suspend(&rmi4_data->early_suspend);
@@ -26,6 +26,8 @@
 
 #include <linux/hrtimer.h>
 #include <linux/ktime.h>
+#include <linux/notifier.h>
+#include <linux/spinlock.h>
 #include <linux/version.h>
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/earlysuspend.h>
@@ -71,6 +73,8 @@
 #define F12_HOVERING_FINGER_STATUS 0x05
 #define F12_GLOVED_FINGER_STATUS 0x06
 
+#define LATENCY_TRACE_SIZE 128
+
 #define MAX_NUMBER_OF_BUTTONS 4
 #define MAX_INTR_REGISTERS 4
 
@@ -191,6 +195,14 @@ struct synaptics_rmi4_fn {
  * @build_id: firmware build ID
  * @support_fn_list: linked list for function handlers
  */
+struct synaptics_rmi4_latency {
+	ktime_t start;		/* attention interrupt or vsync */
+	unsigned int read_us;	/* until the report was read */
+	unsigned int sync_us;	/* until input_sync */
+	unsigned char fingers;
+	bool vsync;
+};
+
 struct synaptics_rmi4_device_info {
 	unsigned int version_major;
 	unsigned int version_minor;
@@ -306,6 +318,21 @@ struct synaptics_rmi4_data {
 	bool has_large_obj_det;
 	unsigned char large_obj_size;
 	bool lo_detected;
+	bool vsync_poll;
+	bool gesture_poll;
+	struct mutex gesture_mutex;
+	struct workqueue_struct *gesture_wq;
+	struct work_struct gesture_work;
+	struct hrtimer gesture_timer;
+	struct notifier_block vsync_nb;
+	ktime_t report_start;
+	ktime_t report_read;
+	bool report_vsync;
+	struct synaptics_rmi4_latency latency[LATENCY_TRACE_SIZE];
+	unsigned int latency_head;
+	unsigned int latency_count;
+	spinlock_t latency_lock;
+	struct dentry *debugfs_dir;
 };
 
 struct synaptics_dsx_bus_access {
@@ -72,6 +72,18 @@ struct gic_chip_data {
 
 static DEFINE_RAW_SPINLOCK(irq_controller_lock);
 
+/*
+ * Bumped whenever the priority, target or configuration registers are
+ * written, so that platform power code saving the distributor across a
+ * power down can tell whether its last copy of them is still valid.
+ */
+static atomic_t gic_config_gen = ATOMIC_INIT(1);
+
+unsigned int gic_config_generation(void)
+{
+	return atomic_read(&gic_config_gen);
+}
+
 /*
  * The GIC mapping of CPU interfaces does not necessarily match
  * the logical CPU numbering.  Let's use a mapping as returned
@@ -223,6 +235,7 @@ static int gic_set_type(struct irq_data *d, unsigned int type)
 	}
 
 	writel_relaxed(val, base + GIC_DIST_CONFIG + confoff);
+	atomic_inc(&gic_config_gen);
 
 	if (enabled)
 		writel_relaxed(enablemask, base + GIC_DIST_ENABLE_SET + enableoff);
@@ -259,6 +272,7 @@ static int gic_set_affinity(struct irq_data *d, const struct cpumask *mask_val,
 	raw_spin_lock(&irq_controller_lock);
 	val = readl_relaxed(reg) & ~mask;
 	writel_relaxed(val | bit, reg);
+	atomic_inc(&gic_config_gen);
 	raw_spin_unlock(&irq_controller_lock);
 
 	return IRQ_SET_MASK_OK;
@@ -413,6 +427,7 @@ static void __init gic_dist_init(struct gic_chip_data *gic)
 	for (i = 32; i < gic_irqs; i += 32)
 		writel_relaxed(0xffffffff, base + GIC_DIST_ENABLE_CLEAR + i * 4 / 32);
 
+	atomic_inc(&gic_config_gen);
 	writel_relaxed(1, base + GIC_DIST_CTRL);
 }
 
@@ -450,6 +465,7 @@ static void __cpuinit gic_cpu_init(struct gic_chip_data *gic)
 	 */
 	for (i = 0; i < 32; i += 4)
 		writel_relaxed(0xa0a0a0a0, dist_base + GIC_DIST_PRI + i * 4 / 4);
+	atomic_inc(&gic_config_gen);
 
 	writel_relaxed(0xf0, base + GIC_CPU_PRIMASK);
 	writel_relaxed(1, base + GIC_CPU_CTRL);
@@ -530,6 +546,7 @@ static void gic_dist_restore(unsigned int gic_nr)
 		writel_relaxed(gic_data[gic_nr].saved_spi_enable[i],
 			dist_base + GIC_DIST_ENABLE_SET + i * 4);
 
+	atomic_inc(&gic_config_gen);
 	writel_relaxed(1, dist_base + GIC_DIST_CTRL);
 }
 
@@ -585,6 +602,7 @@ static void gic_cpu_restore(unsigned int gic_nr)
 
 	for (i = 0; i < DIV_ROUND_UP(32, 4); i++)
 		writel_relaxed(0xa0a0a0a0, dist_base + GIC_DIST_PRI + i * 4);
+	atomic_inc(&gic_config_gen);
 
 	writel_relaxed(0xf0, cpu_base + GIC_CPU_PRIMASK);
 	writel_relaxed(1, cpu_base + GIC_CPU_CTRL);
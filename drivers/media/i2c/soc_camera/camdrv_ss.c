@@ -34,6 +34,8 @@
 #include <media/v4l2-chip-ident.h>
 #include <media/soc_camera.h>
 #include <linux/videodev2_brcm.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
 
 
 /* #define CONFIG_LOAD_FILE */
@@ -1111,6 +1113,201 @@ int camdrv_ss_i2c_write_2_bytes(struct i2c_client *client,
 }
 
 
+#ifndef CONFIG_LOAD_FILE
+/**************************************************************************
+ * Packed tables: on sensors with a burst_subaddr, a register table is
+ * turned once into i2c messages, runs of data register writes becoming
+ * a single message, and kept. Writing the table again is then a few
+ * long transfers. The capture tables are packed in the background when
+ * preview starts, so the capture switch does not pay for it either.
+ * Register values are not cached: these sensors take commands through
+ * the same registers, and identical writes are not redundant.
+ ***************************************************************************/
+#define CAMDRV_SS_PACKED_MAX		32
+#define CAMDRV_SS_PACKED_MSG_MAX	4096
+
+struct camdrv_ss_packed_step {
+	unsigned short len;	/* message bytes, 0 for a delay */
+	unsigned short delay_ms;
+};
+
+struct camdrv_ss_packed_table {
+	const regs_t *regs;
+	int num_of_regs;
+	int num_steps;
+	struct camdrv_ss_packed_step *steps;
+	unsigned char *buf;
+	unsigned long last_used;
+};
+
+static struct camdrv_ss_packed_table camdrv_ss_packed[CAMDRV_SS_PACKED_MAX];
+static unsigned long camdrv_ss_packed_clock;
+static DEFINE_MUTEX(camdrv_ss_packed_lock);
+
+/* called once with steps and buf NULL to size them, then to fill them */
+static int camdrv_ss_pack_regs(const regs_t *regs, int num_of_regs,
+				struct camdrv_ss_packed_step *steps,
+				unsigned char *buf, int *buf_len)
+{
+	unsigned short subaddr, data_value;
+	int i, n = 0, len = 0, run = 0;
+	bool in_burst = false;
+
+	for (i = 0; i < num_of_regs; i++) {
+		subaddr = regs[i] >> 16;
+		data_value = regs[i];
+
+		if (subaddr == sensor.delay_duration) {
+			if (steps) {
+				steps[n].len = 0;
+				steps[n].delay_ms = data_value;
+			}
+			n++;
+			in_burst = false;
+			continue;
+		}
+
+		/* the data register auto increments, append to the run */
+		if (in_burst && subaddr == sensor.burst_subaddr &&
+		    run + 2 <= CAMDRV_SS_PACKED_MSG_MAX) {
+			if (buf) {
+				buf[len] = data_value >> 8;
+				buf[len + 1] = data_value & 0xFF;
+			}
+			run += 2;
+			len += 2;
+			if (steps)
+				steps[n - 1].len = run;
+			continue;
+		}
+
+		if (buf) {
+			buf[len] = subaddr >> 8;
+			buf[len + 1] = subaddr & 0xFF;
+			buf[len + 2] = data_value >> 8;
+			buf[len + 3] = data_value & 0xFF;
+		}
+		if (steps) {
+			steps[n].len = 4;
+			steps[n].delay_ms = 0;
+		}
+		run = 4;
+		len += 4;
+		n++;
+		in_burst = (subaddr == sensor.burst_subaddr);
+	}
+
+	*buf_len = len;
+	return n;
+}
+
+/* with camdrv_ss_packed_lock held */
+static struct camdrv_ss_packed_table *camdrv_ss_pack_table(
+				const regs_t *regs, int num_of_regs)
+{
+	struct camdrv_ss_packed_table *t, *victim = NULL;
+	struct camdrv_ss_packed_step *steps;
+	unsigned char *buf;
+	int i, n, len;
+
+	if (!regs || num_of_regs <= 0)
+		return NULL;
+
+	for (i = 0; i < CAMDRV_SS_PACKED_MAX; i++) {
+		t = &camdrv_ss_packed[i];
+		if (t->regs == regs && t->num_of_regs == num_of_regs) {
+			t->last_used = ++camdrv_ss_packed_clock;
+			return t;
+		}
+		if (!victim || t->last_used < victim->last_used)
+			victim = t;
+	}
+
+	n = camdrv_ss_pack_regs(regs, num_of_regs, NULL, NULL, &len);
+	steps = kmalloc(n * sizeof(*steps), GFP_KERNEL);
+	buf = kmalloc(len ? len : 1, GFP_KERNEL);
+	if (!steps || !buf) {
+		kfree(steps);
+		kfree(buf);
+		return NULL;
+	}
+	camdrv_ss_pack_regs(regs, num_of_regs, steps, buf, &len);
+
+	kfree(victim->steps);
+	kfree(victim->buf);
+	victim->regs = regs;
+	victim->num_of_regs = num_of_regs;
+	victim->num_steps = n;
+	victim->steps = steps;
+	victim->buf = buf;
+	victim->last_used = ++camdrv_ss_packed_clock;
+	return victim;
+}
+
+static int camdrv_ss_i2c_write_packed(struct i2c_client *client,
+				const regs_t *regs, int num_of_regs)
+{
+	struct camdrv_ss_packed_table *t;
+	struct i2c_msg msg = {client->addr, 0, 0, NULL};
+	unsigned char *buf;
+	int i, err = 0;
+
+	mutex_lock(&camdrv_ss_packed_lock);
+	t = camdrv_ss_pack_table(regs, num_of_regs);
+	if (!t) {
+		mutex_unlock(&camdrv_ss_packed_lock);
+		return -ENOMEM;
+	}
+
+	buf = t->buf;
+	for (i = 0; i < t->num_steps; i++) {
+		if (t->steps[i].len == 0) {
+			msleep(t->steps[i].delay_ms);
+			continue;
+		}
+		msg.buf = buf;
+		msg.len = t->steps[i].len;
+		buf += msg.len;
+		if (i2c_transfer(client->adapter, &msg, 1) < 0) {
+			CAM_ERROR_PRINTK("%s %s :i2c transfer failed at step %d !\n", sensor.name, __func__, i);
+			err = -EIO;
+			break;
+		}
+	}
+	mutex_unlock(&camdrv_ss_packed_lock);
+
+	return err;
+}
+
+#define CAMDRV_SS_PRELOAD(name) \
+	camdrv_ss_pack_table(sensor.name, sensor.rows_num_##name)
+
+static void camdrv_ss_preload_func(struct work_struct *work)
+{
+	if (!sensor.burst_subaddr || sensor.register_size != 4)
+		return;
+
+	mutex_lock(&camdrv_ss_packed_lock);
+	CAMDRV_SS_PRELOAD(snapshot_normal_regs);
+	CAMDRV_SS_PRELOAD(snapshot_lowlight_regs);
+	CAMDRV_SS_PRELOAD(snapshot_highlight_regs);
+	CAMDRV_SS_PRELOAD(snapshot_nightmode_regs);
+	CAMDRV_SS_PRELOAD(snapshot_flash_on_regs);
+	CAMDRV_SS_PRELOAD(capture_size_640x480_regs);
+	CAMDRV_SS_PRELOAD(capture_size_800x600_regs);
+	CAMDRV_SS_PRELOAD(capture_size_1024x768_regs);
+	CAMDRV_SS_PRELOAD(capture_size_1280x960_regs);
+	CAMDRV_SS_PRELOAD(capture_size_1600x1200_regs);
+	CAMDRV_SS_PRELOAD(capture_size_2048x1536_regs);
+	CAMDRV_SS_PRELOAD(capture_size_2560x1920_regs);
+	CAMDRV_SS_PRELOAD(preview_camera_regs);
+	mutex_unlock(&camdrv_ss_packed_lock);
+}
+
+static DECLARE_WORK(camdrv_ss_preload_work, camdrv_ss_preload_func);
+#endif /* CONFIG_LOAD_FILE */
+
+
 /**************************************************************************
  * camdrv_ss_i2c_set_config_register: Write (I2C) multiple bytes to the camera sensor
  * @client: pointer to i2c_client
@@ -1131,12 +1328,15 @@ int camdrv_ss_i2c_set_config_register(struct i2c_client *client,
 #ifdef CONFIG_LOAD_FILE
 	err = camdrv_ss_regs_table_write(client, name);
 #else
+	ktime_t start = ktime_get();
 
 	CAM_ERROR_PRINTK("%s : %s : srn : %s\n", sensor.name, __func__, name);
 
 	if ((sensor.i2c_set_data_burst != NULL) && (strcmp(name, "init_regs") == 0)) {
 		CAM_INFO_PRINTK("%s, %s :: Burst mode enable :: name : %s, reg size : %d\n", sensor.name, __func__, name, sensor.register_size);
 		err = sensor.i2c_set_data_burst(client, reg_buffer, num_of_regs, name);
+	} else if (sensor.burst_subaddr && sensor.register_size == 4) {
+		err = camdrv_ss_i2c_write_packed(client, reg_buffer, num_of_regs);
 	} else {
 
 		CAM_INFO_PRINTK("%s, %s :: Burst mode disable :: name : %s reg_size=%d reg num=%d\n", sensor.name, __func__, name, sensor.register_size, num_of_regs);
@@ -1205,6 +1405,9 @@ int camdrv_ss_i2c_set_config_register(struct i2c_client *client,
 		}
 	}
 
+	/* what a mode switch costs, table by table */
+	CAM_INFO_PRINTK("%s %s : %s, %d regs in %lld us\n", sensor.name, __func__,
+		name, num_of_regs, ktime_to_us(ktime_sub(ktime_get(), start)));
 #endif /* CONFIG_LOAD_FILE */
 
 	return err;
@@ -1958,6 +2161,11 @@ static int camdrv_ss_set_preview_start(struct v4l2_subdev *sd)
 	state->camera_flash_fire = 0;
 	state->camera_af_flash_checked = 0;
 
+#ifndef CONFIG_LOAD_FILE
+	/* have the capture tables packed while preview runs */
+	schedule_work(&camdrv_ss_preload_work);
+#endif
+
 	if (state->check_dataline) { /* Output Test Pattern */
 		err = camdrv_ss_set_dataline_onoff(sd, 1);
 		if (err < 0) {
@@ -200,6 +200,9 @@ struct camdrv_ss_sensor_cap {
 	int skip_frames;
 
 	int delay_duration;
+	/* 4 byte register sensors: data register that auto increments,
+	 * e.g. 0x0F12. Set to have the tables packed into burst writes. */
+	int burst_subaddr;
 
 
 /*******************/
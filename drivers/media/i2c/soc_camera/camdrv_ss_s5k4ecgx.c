@@ -3348,6 +3348,7 @@ bool camdrv_ss_sensor_functions_s5k4ecgx(struct camdrv_ss_sensor_cap *sensor)
 	sensor->skip_frames						 = 1;
 
 	sensor->delay_duration				= S5K4ECGX_DELAY_DURATION;
+	sensor->burst_subaddr				= START_BURST_MODE;
 
 	/* sensor dependent functions */
 	
@@ -1553,6 +1553,7 @@ bool camdrv_ss_sensor_init_main(bool bOn, struct camdrv_ss_sensor_cap *sensor)
 	sensor->default_pix_fmt 				   = S5K5CCGX_DEFAULT_PIX_FMT;
 	sensor->default_mbus_pix_fmt			   = S5K5CCGX_DEFAULT_MBUS_PIX_FMT;
 	sensor->register_size 		  			 = S5K5CCGX_REGISTER_SIZE;
+	sensor->burst_subaddr				= START_BURST_MODE;
 	sensor->skip_frames 					 = 0;
 
 	/* sensor dependent functions */
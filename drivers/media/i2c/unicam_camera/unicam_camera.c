@@ -45,6 +45,7 @@
 #include <media/soc_mediabus.h>
 
 #include <linux/broadcom/mobcom_types.h>
+#include <linux/broadcom/bcm_ion.h>
 #include "mm_csi0.h"
 #include <linux/videodev2_brcm.h>
 
@@ -1326,6 +1327,8 @@ static int unicam_camera_add_device(struct soc_camera_device *icd)
 	}
 
 	unicam_dev->icd = icd;
+	/* the camera HAL allocates its ion buffers right after open */
+	ion_cma_prefetch();
 
 	dev_info(icd->parent,
 		 "Unicam Camera driver attached to camera %d\n", icd->devnum);
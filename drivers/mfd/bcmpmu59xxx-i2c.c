@@ -41,6 +41,9 @@
 #define I2C_LOG_BUF_SZ		(SZ_1K)
 #define I2C_LOG_BUF_OFF		0
 
+/* the PMU itself and its companion clients */
+#define I2C_MAPS		(BCMPMU_DUMMY_CLIENTS + 1)
+
 static int debug_mask = BCMPMU_PRINT_INIT |  BCMPMU_PRINT_ERROR;
 #define pr_pmui2c(debug_level, args...) \
 	do { \
@@ -66,6 +69,38 @@ static DEFINE_SPINLOCK(wl_lock);
 static u32 *i2c_log_buf_v;
 static u32 *i2c_log_buf_p;
 
+/*
+ * Registers only the kernel changes: the regulator modes, voltages and
+ * groups. The last value read or written is cached, reads are served
+ * from the cache and writes of the value a register already holds are
+ * dropped. The CSR voltages are not cached, the power manager sequencer
+ * sets them for DVS.
+ */
+static const struct {
+	u32 first;
+	u32 last;
+} i2c_cached[] = {
+	{ PMU_REG_RFLDOPMCTRL1, PMU_REG_VIBLDOCTRL },
+	{ PMU_REG_IOSR1VOUT1, PMU_REG_VSRVOUT3 },
+	{ PMU_REG_LVLDO1PMCTRL1, PMU_REG_LVLDO2CTRL },
+	{ PMU_REG_GPLDO1PMCTRL1, PMU_REG_TCXLDOPMCTRL2 },
+};
+
+struct bcmpmu_i2c_stats {
+	u32 reads;		/* register reads on the bus */
+	u32 writes;		/* register writes on the bus */
+	u32 bulk;		/* bulk transfers, counted in the above too */
+	u32 cached;		/* reads served from the cache */
+	u32 dropped;		/* writes of an unchanged cached value */
+	u32 errors;
+};
+
+/* under the i2c_mutex */
+static u8 i2c_cache[I2C_MAPS][PMU_REG_MAX];
+static DECLARE_BITMAP(i2c_cache_valid, I2C_MAPS * PMU_REG_MAX);
+static struct bcmpmu_i2c_stats i2c_stats[I2C_MAPS];
+static u32 i2c_cache_enable = 1;
+
 /**
  * bcmpmu_i2c_log - log i2c data to un-cached buffer
  *
@@ -136,6 +171,83 @@ static inline void bcmpmu_i2c_unlock(struct bcmpmu59xxx *bcmpmu)
 #endif
 }
 
+static bool bcmpmu_i2c_cacheable(u32 reg)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(i2c_cached); i++)
+		if (DEC_MAP_ADD(reg) == DEC_MAP_ADD(i2c_cached[i].first) &&
+		    DEC_REG_ADD(reg) >= DEC_REG_ADD(i2c_cached[i].first) &&
+		    DEC_REG_ADD(reg) <= DEC_REG_ADD(i2c_cached[i].last))
+			return true;
+	return false;
+}
+
+static inline int bcmpmu_i2c_cache_idx(u32 reg)
+{
+	return DEC_MAP_ADD(reg) * PMU_REG_MAX + DEC_REG_ADD(reg);
+}
+
+/* The cached value of @reg, counting a hit. Under the i2c_mutex */
+static bool bcmpmu_i2c_cache_read(u32 reg, u8 *val)
+{
+	if (!i2c_cache_enable || DEC_MAP_ADD(reg) >= I2C_MAPS ||
+	    !test_bit(bcmpmu_i2c_cache_idx(reg), i2c_cache_valid))
+		return false;
+	*val = i2c_cache[DEC_MAP_ADD(reg)][DEC_REG_ADD(reg)];
+	i2c_stats[DEC_MAP_ADD(reg)].cached++;
+	return true;
+}
+
+/* Whether writing @val to @reg would not change it. Under the i2c_mutex */
+static bool bcmpmu_i2c_cache_same(u32 reg, u8 val)
+{
+	u8 old;
+
+	if (!i2c_cache_enable || DEC_MAP_ADD(reg) >= I2C_MAPS ||
+	    !test_bit(bcmpmu_i2c_cache_idx(reg), i2c_cache_valid))
+		return false;
+	old = i2c_cache[DEC_MAP_ADD(reg)][DEC_REG_ADD(reg)];
+	if (old != val)
+		return false;
+	i2c_stats[DEC_MAP_ADD(reg)].dropped++;
+	return true;
+}
+
+/*
+ * Account a transfer of @len registers from @reg, and keep the cached
+ * ones on success or forget them on error. Under the i2c_mutex
+ */
+static void bcmpmu_i2c_cache_update(u32 reg, const u8 *val, int len,
+				    bool write, int err)
+{
+	struct bcmpmu_i2c_stats *st;
+	int i;
+
+	if (DEC_MAP_ADD(reg) >= I2C_MAPS)
+		return;
+	st = &i2c_stats[DEC_MAP_ADD(reg)];
+	if (write)
+		st->writes += len;
+	else
+		st->reads += len;
+	if (len > 1)
+		st->bulk++;
+	if (err)
+		st->errors++;
+
+	for (i = 0; i < len; i++, reg++) {
+		if (!bcmpmu_i2c_cacheable(reg))
+			continue;
+		if (err || !i2c_cache_enable) {
+			clear_bit(bcmpmu_i2c_cache_idx(reg), i2c_cache_valid);
+			continue;
+		}
+		i2c_cache[DEC_MAP_ADD(reg)][DEC_REG_ADD(reg)] = val[i];
+		set_bit(bcmpmu_i2c_cache_idx(reg), i2c_cache_valid);
+	}
+}
+
 #if defined(CONFIG_MFD_BCM_PWRMGR_SW_SEQUENCER)
 
 int last_trans = I2C_TRANS_NONE;
@@ -278,7 +390,12 @@ static int bcmpmu_i2c_pwrmgr_read(struct bcmpmu59xxx *bcmpmu, u32 reg, u8 * val)
 		return -EINVAL;
 
 	bcmpmu_i2c_lock(bcmpmu);
+	if (bcmpmu_i2c_cache_read(reg, val)) {
+		bcmpmu_i2c_unlock(bcmpmu);
+		return 0;
+	}
 	ret = bcmpmu_i2c_try_read(bcmpmu, reg, val);
+	bcmpmu_i2c_cache_update(reg, val, 1, false, ret);
 	bcmpmu_i2c_unlock(bcmpmu);
 	pr_pmui2c(DATA, "RD done reg %x val %x\n", reg, *val);
 	return ret;
@@ -288,7 +405,12 @@ static int bcmpmu_i2c_pwrmgr_write(struct bcmpmu59xxx *bcmpmu, u32 reg, u8 val)
 {
 	int ret = 0;
 	bcmpmu_i2c_lock(bcmpmu);
+	if (bcmpmu_i2c_cache_same(reg, val)) {
+		bcmpmu_i2c_unlock(bcmpmu);
+		return 0;
+	}
 	ret = bcmpmu_i2c_try_write(bcmpmu, reg, val);
+	bcmpmu_i2c_cache_update(reg, &val, 1, true, ret);
 	bcmpmu_i2c_unlock(bcmpmu);
 	pr_pmui2c(DATA, "WR done reg %x val %x\n", reg, val);
 	return ret;
@@ -308,6 +430,7 @@ static int bcmpmu_i2c_pwrmgr_read_bulk(struct bcmpmu59xxx *bcmpmu,
 			break;
 		val[i] = temp;
 	}
+	bcmpmu_i2c_cache_update(reg, val, err < 0 ? i + 1 : len, false, err);
 	bcmpmu_i2c_unlock(bcmpmu);
 	return err;
 }
@@ -326,6 +449,7 @@ static int bcmpmu_i2c_pwrmgr_write_bulk(struct bcmpmu59xxx *bcmpmu,
 		if (err < 0)
 			break;
 	}
+	bcmpmu_i2c_cache_update(reg, val, err < 0 ? i + 1 : len, true, err);
 	bcmpmu_i2c_unlock(bcmpmu);
 	return err;
 }
@@ -358,11 +482,17 @@ static int bcmpmu_i2c_read_device(struct bcmpmu59xxx *bcmpmu, u32 reg, u8 *val)
 	clt = bcmpmu_get_client(bcmpmu, reg);
 
 	bcmpmu_i2c_lock(bcmpmu);
+	if (bcmpmu_i2c_cache_read(reg, val)) {
+		bcmpmu_i2c_unlock(bcmpmu);
+		return 0;
+	}
 	err = i2c_smbus_read_byte_data(clt, (u8) DEC_REG_ADD(reg));
+	if (err >= 0)
+		*val = err;
+	bcmpmu_i2c_cache_update(reg, val, 1, false, err < 0);
 	bcmpmu_i2c_unlock(bcmpmu);
 	if (err < 0)
 		return err;
-	*val = err;
 	return 0;
 }
 
@@ -378,7 +508,12 @@ static int bcmpmu_i2c_write_device(struct bcmpmu59xxx *bcmpmu, u32 reg,
 	clt = bcmpmu_get_client(bcmpmu, reg);
 
 	bcmpmu_i2c_lock(bcmpmu);
+	if (bcmpmu_i2c_cache_same(reg, value)) {
+		bcmpmu_i2c_unlock(bcmpmu);
+		return 0;
+	}
 	err = i2c_smbus_write_byte_data(clt, (u8) DEC_REG_ADD(reg), value);
+	bcmpmu_i2c_cache_update(reg, &value, 1, true, err < 0);
 	bcmpmu_i2c_unlock(bcmpmu);
 	return (err < 0 ? err : 0);
 }
@@ -396,6 +531,7 @@ static int bcmpmu_i2c_read_device_direct_bulk(struct bcmpmu59xxx *bcmpmu,
 	bcmpmu_i2c_lock(bcmpmu);
 	err =
 	    i2c_smbus_read_i2c_block_data(clt, (u8) DEC_REG_ADD(reg), len, val);
+	bcmpmu_i2c_cache_update(reg, val, len, false, err < 0);
 	bcmpmu_i2c_unlock(bcmpmu);
 	return (err < 0 ? err : 0);
 }
@@ -414,6 +550,7 @@ static int bcmpmu_i2c_write_device_direct_bulk(struct bcmpmu59xxx *bcmpmu,
 	err =
 		i2c_smbus_write_i2c_block_data(clt, (u8) DEC_REG_ADD(reg),
 				len, val);
+	bcmpmu_i2c_cache_update(reg, val, len, true, err < 0);
 	bcmpmu_i2c_unlock(bcmpmu);
 	return (err < 0 ? err : 0);
 }
@@ -428,6 +565,57 @@ static int bcmpmu_i2c_set_dev_mode(struct bcmpmu59xxx *bcmpmu, int poll)
 #endif
 }
 
+#ifdef CONFIG_DEBUG_FS
+static int bcmpmu_i2c_stats_show(struct seq_file *s, void *p)
+{
+	struct bcmpmu59xxx *bcmpmu = s->private;
+	struct bcmpmu_i2c_stats st[I2C_MAPS];
+	int i;
+
+	bcmpmu_i2c_lock(bcmpmu);
+	memcpy(st, i2c_stats, sizeof(st));
+	bcmpmu_i2c_unlock(bcmpmu);
+
+	seq_puts(s, "map slave    reads   writes     bulk   cached  dropped "
+		 "errors\n");
+	for (i = 0; i < I2C_MAPS; i++)
+		seq_printf(s, "%3d  0x%02x %8u %8u %8u %8u %8u %6u\n", i,
+			   i ? bcmpmu->pdata->i2c_companion_info[i - 1].addr :
+			   bcmpmu->pmu_bus->i2c->addr,
+			   st[i].reads, st[i].writes, st[i].bulk,
+			   st[i].cached, st[i].dropped, st[i].errors);
+	return 0;
+}
+
+static int bcmpmu_i2c_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bcmpmu_i2c_stats_show, inode->i_private);
+}
+
+/* clears the counters, and the cache in case the PMU was written behind it */
+static ssize_t bcmpmu_i2c_stats_write(struct file *file,
+				      const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct bcmpmu59xxx *bcmpmu =
+		((struct seq_file *)file->private_data)->private;
+
+	bcmpmu_i2c_lock(bcmpmu);
+	memset(i2c_stats, 0, sizeof(i2c_stats));
+	bitmap_zero(i2c_cache_valid, I2C_MAPS * PMU_REG_MAX);
+	bcmpmu_i2c_unlock(bcmpmu);
+	return count;
+}
+
+static const struct file_operations bcmpmu_i2c_stats_fops = {
+	.open = bcmpmu_i2c_stats_open,
+	.read = seq_read,
+	.write = bcmpmu_i2c_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+#endif
+
 static void bcmpmu59xxx_debug_init(struct bcmpmu59xxx *bcmpmu)
 {
 	if (!bcmpmu->dent_bcmpmu) {
@@ -440,13 +628,21 @@ static void bcmpmu59xxx_debug_init(struct bcmpmu59xxx *bcmpmu)
 	bcmpmu->pmu_bus->dentry  =
 		debugfs_create_dir("i2c", bcmpmu->dent_bcmpmu);
 
-	if (!bcmpmu->pmu_bus->dentry)
+	if (!bcmpmu->pmu_bus->dentry) {
 		pr_err("Failed to setup i2c debugfs\n");
+		return;
+	}
 
 	if (!debugfs_create_u32("dbg_mask", S_IWUSR | S_IRUSR,
 				bcmpmu->pmu_bus->dentry , &debug_mask))
 		debugfs_remove(bcmpmu->pmu_bus->dentry);
 
+	debugfs_create_file("stats", S_IWUSR | S_IRUSR,
+			    bcmpmu->pmu_bus->dentry, bcmpmu,
+			    &bcmpmu_i2c_stats_fops);
+	debugfs_create_u32("cache", S_IWUSR | S_IRUSR,
+			   bcmpmu->pmu_bus->dentry, &i2c_cache_enable);
+
 }
 static int bcmpmu59xxx_i2c_probe(struct i2c_client *i2c,
 				 const struct i2c_device_id *id)
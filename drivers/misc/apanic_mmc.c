@@ -42,6 +42,13 @@
 #include <linux/mmc-poll/mmc_poll.h>
 #include <linux/mmc-poll/mmc_poll_stack.h>
 #include <linux/kmsg_dump.h>
+#include <linux/lz4.h>
+#include <linux/nmi.h>
+#include <linux/vmalloc.h>
+#include <asm/div64.h>
+#ifdef CONFIG_BRCM_SECURE_WATCHDOG
+#include <linux/broadcom/kona_sec_wd.h>
+#endif
 #include "apanic_mmc.h"
 #ifdef CONFIG_FB_BRCM_CP_CRASH_DUMP_IMAGE_SUPPORT
 #include <video/kona_fb_image_dump.h>
@@ -52,18 +59,61 @@
 
 int ap_triggered;
 
+enum {
+	APANIC_CONSOLE,
+	APANIC_THREADS,
+	APANIC_LOGGER,
+	APANIC_SECTIONS,
+};
+
 struct panic_header {
 	u32 magic;
 #define PANIC_MAGIC 0xdeadf00d
 
 	u32 version;
-#define PHDR_VERSION   0x01
+#define PHDR_VERSION_RAW	0x01	/* console and threads, uncompressed */
+#define PHDR_VERSION		0x02
+
+	/* byte offset from the header and length on flash of each section;
+	 * the first two are where version 1 kept console and threads */
+	struct {
+		u32 offset;
+		u32 length;
+	} sect[APANIC_SECTIONS];
+
+	/* version 2 */
+	u32 flags;
+#define PHDR_LZ4		0x01	/* sections are apanic_frame streams */
+#define PHDR_TRUNCATED		0x02	/* out of time or space */
+	u32 raw_length[APANIC_SECTIONS];
+	u32 write_us;			/* panic notifier to header written */
+	u32 dump_length;		/* bytes written, header included */
+};
+
+/*
+ * A compressed section is a run of these, each followed by length bytes:
+ * chunk_size bytes or less of the section LZ4 compressed, or as they
+ * were if that did not make them smaller.
+ */
+struct apanic_frame {
+	u32 length;
+#define APANIC_FRAME_STORED	0x80000000
+	u32 raw_length;
+};
 
-	u32 console_offset;
-	u32 console_length;
+#define APANIC_CHUNK	(32 * 1024)	/* compressed at a time */
+#define APANIC_FLUSH	(64 * 1024)	/* written at a time */
 
-	u32 threads_offset;
-	u32 threads_length;
+/* writer side of one section, in write_bl_len blocks */
+struct apanic_stream {
+	unsigned long start;
+	unsigned long blk;		/* next to write */
+	unsigned long end;
+	size_t in_len;
+	size_t out_len;
+	u32 length;
+	u32 raw_length;
+	int err;
 };
 
 struct apanic_data {
@@ -73,11 +123,30 @@ struct apanic_data {
 	struct mmc *mmc;
 	struct panic_header	curr;
 	void			*bounce;
+	/* reserved at init for the panic time writer */
+	unsigned char		*in;
+	unsigned char		*cbuf;
+	unsigned char		*out;	/* physically contiguous, for sdma */
+	void			*wrkmem;
+	u64			start_ns;
+	/* the previous dump, read back at the trigger */
+	void			*data[APANIC_SECTIONS];
+	size_t			size[APANIC_SECTIONS];
 	struct proc_dir_entry	*apanic_trigger;
-	struct proc_dir_entry	*apanic_console;
-	struct proc_dir_entry	*apanic_threads;
+	struct proc_dir_entry	*apanic_proc[APANIC_SECTIONS];
 };
 
+static const char * const apanic_proc_name[APANIC_SECTIONS] = {
+	"apanic_console", "apanic_threads", "apanic_logger",
+};
+
+/* stop adding to the dump in time for the watchdog */
+static unsigned int budget_ms = 5000;
+module_param(budget_ms, uint, S_IRUGO | S_IWUSR);
+/* task states whose stacks are dumped, 0 for every task */
+static unsigned int threads_filter = TASK_UNINTERRUPTIBLE;
+module_param(threads_filter, uint, S_IRUGO | S_IWUSR);
+
 struct apanic_data drv_ctx;
 static struct work_struct proc_removal_work;
 static struct workqueue_struct *apanic_wq;
@@ -109,125 +178,20 @@ static void mmc_bio_complete(struct bio *bio, int err)
 static ssize_t apanic_proc_read(struct file *file, char __user *buffer,
 				size_t count, loff_t *ppos)
 {
-	int i, index = 0;
-	int err;
-	int start_sect;
-	int end_sect;
-	size_t file_length;
-	off_t file_offset;
 	struct apanic_data *ctx = &drv_ctx;
-	struct block_device *bdev;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct completion complete;
-	struct page *page;
-	off_t offset = *ppos;
-	void *dat = PDE_DATA(file_inode(file));
-
-	if (!count)
-		return 0;
+	int i = (int) PDE_DATA(file_inode(file)) - 1;
+	ssize_t ret;
 
-	mutex_lock(&drv_mutex);
-
-	switch ((int) dat) {
-	case 1:
-		file_length = ctx->curr.console_length;
-		file_offset = ctx->curr.console_offset;
-		break;
-#ifndef CONFIG_CDEBUGGER
-	case 2:
-		file_length = ctx->curr.threads_length;
-		file_offset = ctx->curr.threads_offset;
-		break;
-#endif
-	default:
-		pr_err("bad apanic source (%d)\n", (int) dat);
-		mutex_unlock(&drv_mutex);
+	if (i < 0 || i >= APANIC_SECTIONS) {
+		pr_err("bad apanic source (%d)\n", i + 1);
 		return -EINVAL;
 	}
 
-	/*
-	 * If the requested offset is greater than or is equal to the file
-	 * size, we have already reached the end of file.
-	 */
-	if (offset >= file_length) {
-		mutex_unlock(&drv_mutex);
-		return 0;
-	}
-
-	/*
-	 * The bytes to read request is greater than the actual file size,
-	 * so trim the request.
-	 */
-	if ((offset + count) > file_length)
-		count = file_length - offset;
-
-	bdev = blkdev_get_by_path(ctx->dev_path,
-				  FMODE_READ, apanic_proc_read);
-
-	if (IS_ERR(bdev)) {
-		printk(KERN_ERR DRVNAME
-			"failed to get block device %s (%ld)\n",
-			ctx->dev_path, PTR_ERR(bdev));
-		mutex_unlock(&drv_mutex);
-		return -1;
-	}
-	page = virt_to_page(ctx->bounce);
-
-	start_sect = (file_offset +  offset) / 512;
-	end_sect = (file_offset + offset + count - 1) / 512;
-
-	for (i = start_sect; i <= end_sect; i++) {
-		bio_init(&bio);
-		bio.bi_io_vec = &bio_vec;
-		bio_vec.bv_page = page;
-		bio_vec.bv_len = 512;
-		bio_vec.bv_offset = 0;
-		bio.bi_vcnt = 1;
-		bio.bi_idx = 0;
-		bio.bi_size = 512;
-		bio.bi_bdev = bdev;
-		bio.bi_sector = i;
-		init_completion(&complete);
-		bio.bi_private = &complete;
-		bio.bi_end_io = mmc_bio_complete;
-		submit_bio(READ, &bio);
-		wait_for_completion(&complete);
-		if (!test_bit(BIO_UPTODATE, &bio.bi_flags)) {
-			err = -EIO;
-			goto out_blkdev;
-		}
-
-		if ((i == start_sect) && ((file_offset + offset) % 512 != 0)) {
-			/* first sect, may be the only sect */
-			err = copy_to_user(buffer,
-				ctx->bounce + (file_offset + offset) % 512,
-				min((unsigned long)count,
-				(unsigned long)
-				(512 - (file_offset + offset) % 512)));
-			index += min((unsigned long)count, (unsigned long)
-				(512 - (file_offset + offset) % 512));
-		} else if ((i == end_sect) && ((file_offset + offset + count)
-			% 512 != 0)) {
-			/* last sect */
-			err = copy_to_user(buffer + index, ctx->bounce,
-				(file_offset + offset + count) % 512);
-		} else {
-			/* middle sect */
-			err = copy_to_user(buffer + index, ctx->bounce, 512);
-			index += 512;
-		}
-	}
-
-	*ppos += count;
-
-	err = count;
-
-out_blkdev:
-	blkdev_put(bdev, FMODE_READ);
-
+	mutex_lock(&drv_mutex);
+	ret = simple_read_from_buffer(buffer, count, ppos, ctx->data[i],
+				      ctx->size[i]);
 	mutex_unlock(&drv_mutex);
-	return err;
+	return ret;
 }
 
 static void mmc_panic_erase(void)
@@ -286,16 +250,19 @@ static void apanic_remove_proc_work(struct work_struct *work)
 {
 	struct apanic_data *ctx = &drv_ctx;
 
+	int i;
+
 	mutex_lock(&drv_mutex);
 	mmc_panic_erase();
 	memset(&ctx->curr, 0, sizeof(struct panic_header));
-	if (ctx->apanic_console) {
-		remove_proc_entry("apanic_console", NULL);
-		ctx->apanic_console = NULL;
-	}
-	if (ctx->apanic_threads) {
-		remove_proc_entry("apanic_threads", NULL);
-		ctx->apanic_threads = NULL;
+	for (i = 0; i < APANIC_SECTIONS; i++) {
+		if (ctx->apanic_proc[i]) {
+			remove_proc_entry(apanic_proc_name[i], NULL);
+			ctx->apanic_proc[i] = NULL;
+		}
+		vfree(ctx->data[i]);
+		ctx->data[i] = NULL;
+		ctx->size[i] = 0;
 	}
 	mutex_unlock(&drv_mutex);
 }
@@ -309,134 +276,171 @@ static ssize_t apanic_proc_write(struct file *file, const char __user *buffer,
 
 static int in_panic;
 
-/*
- * Copy a range of characters from the log buffer.
- */
-static int log_buf_copy(char *dest, struct kmsg_dumper *dumper, size_t len)
+static void apanic_stream_begin(struct apanic_stream *s, unsigned long blk)
 {
-	static char buf[1024]; /* static to keep left-overs for next pass */
-	size_t n; /* Number of bytes requested */
-	static size_t r; /* Number of bytes received */
-	int total = 0;
-
-	if (!dest || !dumper || len < 0)
-		return -1;
-
-	do {
-		/* Eat left-overs first */
-		while (r) {
-			n = min(r, len);
-			memcpy(dest, buf, n);
-			dest += n;
-			len -= n;
-			total += n;
-			r -= n;
-			if (!len) {
-				/* Move left-overs (if any) to &buf[0] */
-				if (r)
-					memmove(buf, &buf[n], r);
-				return total;
-			}
-		}
-		/* Get new data into the buffer */
-	} while (kmsg_dump_get_line_nolock(dumper, true, buf, sizeof(buf), &r));
-	return total;
+	memset(s, 0, sizeof(*s));
+	s->start = s->blk = blk;
+	s->end = get_apanic_end_address();
 }
 
-/*
- * Writes the contents of the console to the specified offset in flash.
- * Returns number of bytes written
- */
-static int apanic_write_console_mmc(unsigned long off)
+/* write the whole blocks in out, or all of it padded when "all" */
+static void apanic_stream_flush(struct apanic_stream *s, bool all)
 {
 	struct apanic_data *ctx = &drv_ctx;
-	int saved_oip;
-	int idx = 0;
-	size_t rc;
-	int rc2;
-	unsigned int last_chunk = 0;
-	unsigned long start;
-	unsigned long partition_end = get_apanic_end_address();
-	struct kmsg_dumper dumper = { .active = true };
-
-	start = off;
-	kmsg_dump_rewind_nolock(&dumper);
-	while (!last_chunk) {
-		saved_oip = oops_in_progress;
-		oops_in_progress = 1;
-
-		/*
-		 * bounce buffer is reserved during init time.
-		 * Now copy 'writable' amount of data from __log_buf
-		 * to the bounce buffer
-		 */
-		rc = log_buf_copy(ctx->bounce, &dumper, ctx->mmc->write_bl_len);
-		if (rc < 0)
-			break;
+	unsigned int bl = ctx->mmc->write_bl_len;
+	unsigned long n;
+	size_t len;
+
+	if (all && s->out_len % bl) {
+		len = bl - s->out_len % bl;
+		memset(ctx->out + s->out_len, 0, len);
+		s->out_len += len;
+	}
+	n = s->out_len / bl;
+	if (!n || s->err)
+		return;
 
-		if (rc != ctx->mmc->write_bl_len)
-			last_chunk = rc;
+	if (s->blk + n > s->end) {
+		pr_err("ERROR %s: Write across the partition boundary\n",
+		       __func__);
+		s->err = -ENOSPC;
+		n = s->end - s->blk;
+		if (!n)
+			return;
+	}
 
-		oops_in_progress = saved_oip;
-		if (rc <= 0)
-			break;
-		if (rc != ctx->mmc->write_bl_len)
-			memset(ctx->bounce + rc, 0,
-			       ctx->mmc->write_bl_len - rc);
-
-		if (off >= partition_end) {
-			pr_err("ERROR %s: Write across the partition boundary\n"
-				, __func__);
-			pr_err("off = %lu end = %lu\n", off, partition_end);
-			return -ENOSPC;
-		}
+	/* one multi-block write for the lot */
+	if (ctx->mmc->block_dev.block_write(ctx->mmc_poll_dev_num, s->blk, n,
+					    ctx->out) != n) {
+		printk(KERN_EMERG "apanic: MMC write failed\n");
+		s->err = -EIO;
+		return;
+	}
+	s->blk += n;
+	len = n * bl;
+	s->out_len -= len;
+	memmove(ctx->out, ctx->out + len, s->out_len);
+}
 
-		/* Write the bounce buffer to eMMC */
-		rc2 = ctx->mmc->block_dev.block_write(ctx->mmc_poll_dev_num,
-						      off, 1, ctx->bounce);
-		if (rc2 <= 0) {
-			printk(KERN_EMERG
-			       "apanic: MMC write failed (%d)\n", rc2);
-			return idx;
-		}
+static void apanic_stream_frame(struct apanic_stream *s)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	struct apanic_frame f;
+	size_t clen = lz4_compressbound(APANIC_CHUNK);
+	const unsigned char *src = ctx->cbuf;
+
+	if (lz4_compress(ctx->in, s->in_len, ctx->cbuf, &clen, ctx->wrkmem) ||
+	    clen >= s->in_len) {
+		clen = s->in_len;
+		src = ctx->in;
+		f.length = clen | APANIC_FRAME_STORED;
+	} else {
+		f.length = clen;
+	}
+	f.raw_length = s->in_len;
+
+	memcpy(ctx->out + s->out_len, &f, sizeof(f));
+	memcpy(ctx->out + s->out_len + sizeof(f), src, clen);
+	s->out_len += sizeof(f) + clen;
+	s->length += sizeof(f) + clen;
+	s->raw_length += s->in_len;
+	s->in_len = 0;
+
+	if (s->out_len >= APANIC_FLUSH)
+		apanic_stream_flush(s, false);
+
+	touch_nmi_watchdog();
+	if (!s->err && div_u64(local_clock() - ctx->start_ns, NSEC_PER_MSEC) >=
+	    budget_ms) {
+		pr_err("apanic: out of time, dump truncated\n");
+		s->err = -ETIME;
+	}
+}
 
-		/* idx is a byte offset used to copy from log buf */
-		if (!last_chunk)
-			idx += (rc2 * ctx->mmc->write_bl_len);
-		else
-			idx += last_chunk;
-
-		/*
-		 * off is in terms of block count to tell the mmc driver where
-		 * to start the next write from, while idx is in terms of
-		 * bytes to tell the lob_buf_copy where to start the read
-		 * from. Note that the block_write function of mmc also
-		 * returns the number of blocks written.
-		 */
-		off += rc2;
+static void apanic_stream_write(struct apanic_stream *s, const void *buf,
+				size_t len)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	size_t n;
+
+	while (len && !s->err) {
+		n = min(len, APANIC_CHUNK - s->in_len);
+		memcpy(ctx->in + s->in_len, buf, n);
+		s->in_len += n;
+		buf += n;
+		len -= n;
+		if (s->in_len == APANIC_CHUNK)
+			apanic_stream_frame(s);
 	}
+}
+
+static int apanic_stream_end(struct apanic_stream *s)
+{
+	if (s->in_len && !s->err)
+		apanic_stream_frame(s);
+	apanic_stream_flush(s, true);
+	return s->err;
+}
 
-	pr_debug("%s: wrote %d bytes from %ld returned %ld\r\n",
-		__func__, idx, start, off);
+/* what is left in the log from where the dumper is */
+static void apanic_write_log(struct apanic_stream *s,
+			     struct kmsg_dumper *dumper)
+{
+	static char line[1024];
+	size_t len;
 
-	return idx;
+	while (!s->err &&
+	       kmsg_dump_get_line_nolock(dumper, true, line, sizeof(line),
+					 &len))
+		apanic_stream_write(s, line, len);
+}
+
+#ifdef CONFIG_ANDROID_LOGGER
+static void apanic_write_logger(void *data, const char *name,
+				const unsigned char *a, size_t a_len,
+				const unsigned char *b, size_t b_len)
+{
+	struct apanic_stream *s = data;
+	char tag[64];
+
+	/* the entries of each log follow a line with its name and size */
+	apanic_stream_write(s, tag, scnprintf(tag, sizeof(tag),
+				"--- %s %zu\n", name, a_len + b_len));
+	apanic_stream_write(s, a, a_len);
+	apanic_stream_write(s, b, b_len);
+}
+#endif
+
+/* lay section i down from blk, returns the block after it */
+static unsigned long apanic_write_section(struct panic_header *hdr, int i,
+					  unsigned long hdr_blk,
+					  struct apanic_stream *s)
+{
+	struct apanic_data *ctx = &drv_ctx;
+
+	if (apanic_stream_end(s)) {
+		printk(KERN_EMERG "apanic: %s incomplete (%d)\n",
+		       apanic_proc_name[i], s->err);
+		hdr->flags |= PHDR_TRUNCATED;
+	}
+	if (s->length) {
+		hdr->sect[i].offset = (s->start - hdr_blk) *
+				      ctx->mmc->write_bl_len;
+		hdr->sect[i].length = s->length;
+		hdr->raw_length[i] = s->raw_length;
+	}
+	return s->blk;
 }
 
 static int apanic(struct notifier_block *this, unsigned long event,
 			void *ptr)
 {
 	struct apanic_data *ctx = &drv_ctx;
-	struct panic_header *hdr = (struct panic_header *) ctx->bounce;
-	int console_offset = 0;
-	int console_len = 0;
-	int console_len_bytes = 0;
-#ifndef CONFIG_CDEBUGGER
-	int threads_offset = 0;
-	int threads_len = 0;
-	int threads_len_bytes = 0;
-#endif
+	struct panic_header hdr;
+	struct apanic_stream s;
+	struct kmsg_dumper dumper = { .active = true };
 	int rc;
-	unsigned long blk;
+	unsigned long blk, next;
 	unsigned long partition_end = get_apanic_end_address();
 
 	ap_triggered = 1;
@@ -444,11 +448,15 @@ static int apanic(struct notifier_block *this, unsigned long event,
 	if (in_panic)
 		return NOTIFY_DONE;
 	in_panic = 1;
+	ctx->start_ns = local_clock();
 #ifdef CONFIG_PREEMPT
 	/* Ensure that cond_resched() won't try to preempt anybody */
 	add_preempt_count(PREEMPT_ACTIVE);
 #endif
 	touch_softlockup_watchdog();
+#ifdef CONFIG_BRCM_SECURE_WATCHDOG
+	sec_wd_touch();
+#endif
 
 	blk = get_apanic_start_address();
 	if (blk == 0) {
@@ -466,32 +474,25 @@ static int apanic(struct notifier_block *this, unsigned long event,
 	pr_debug("apanic: MMC device write block size is %d \r\n",
 		 ctx->mmc->write_bl_len);
 
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = PANIC_MAGIC;
+	hdr.version = PHDR_VERSION;
+	hdr.flags = PHDR_LZ4;
+
 	/*
-	 * The first block is reserved for apanic header so copy the log_buf
-	 * from start_block + 1
+	 * The first block is reserved for apanic header, the sections
+	 * follow it one after the other, each from a block boundary.
 	 */
-	console_offset = blk + 1;
-
-	pr_debug("Log Buff is stored from block number %d \r\n",
-		console_offset);
-	console_len_bytes = apanic_write_console_mmc(console_offset);
-	if (console_len_bytes <= 0) {
-		printk(KERN_EMERG "Error writing log but to panic log! (%d)\n",
-			console_len_bytes);
-		console_len_bytes = 0;
-	}
-	console_len = (console_len_bytes+ctx->mmc->write_bl_len-1) /
-		      ctx->mmc->write_bl_len;
+	apanic_stream_begin(&s, blk + 1);
+	kmsg_dump_rewind_nolock(&dumper);
+	apanic_write_log(&s, &dumper);
+	next = apanic_write_section(&hdr, APANIC_CONSOLE, blk, &s);
 
 #ifndef CONFIG_CDEBUGGER
 	/*
-	 * Write out all threads
+	 * Write out the tasks that threads_filter selects. Their stacks go
+	 * to the log, and are taken from where the console section ended.
 	 */
-	threads_offset = console_offset + console_len;
-
-	pr_debug("Thread data is stored from block number %d \r\n",
-		 threads_offset);
-
 	/* Below two functions are removed by Linaro so commented out.
 	* It will generate the compilation errors if ramdump is not enabled.
 	* If ramdump is not supported but need to support APANIC thread info
@@ -500,50 +501,39 @@ static int apanic(struct notifier_block *this, unsigned long event,
 #ifdef CONFIG_ANDROID_RAM_CONSOLE
 	ram_console_enable_console(0);
 	log_buf_clear();
+	kmsg_dump_rewind_nolock(&dumper);
 #endif
-	show_state_filter(0);
+	show_state_filter(threads_filter);
 
-	threads_len_bytes = apanic_write_console_mmc(threads_offset);
-	if (threads_len_bytes <= 0) {
-		printk(KERN_EMERG "Error writing threads to panic log! (%d)\n",
-		       threads_len_bytes);
-		threads_len_bytes = 0;
-	}
-	threads_len = (threads_len_bytes+ctx->mmc->write_bl_len-1) /
-		      ctx->mmc->write_bl_len;
+	apanic_stream_begin(&s, next);
+	apanic_write_log(&s, &dumper);
+	next = apanic_write_section(&hdr, APANIC_THREADS, blk, &s);
+#endif
+
+#ifdef CONFIG_ANDROID_LOGGER
+	apanic_stream_begin(&s, next);
+	logger_panic_walk(apanic_write_logger, &s);
+	next = apanic_write_section(&hdr, APANIC_LOGGER, blk, &s);
 #endif
-	/*
-	 * Finally write the panic header at the first block of the partition
-	 */
-	memset(ctx->bounce, 0, PAGE_SIZE);
-	hdr->magic = PANIC_MAGIC;
-	hdr->version = PHDR_VERSION;
 
 	/*
-	 * blk - Holds the starting block number of the apanic partition
-	 * console_offset - Holds the block number from where console data is
-	 *		     placed
-	 * console_len    - Holds the size of console data stored in terms of
-	 *                   number of blocks
+	 * Finally write the panic header at the first block of the partition
 	 *
-	 * threads_offset, threads_length same as above but for threads info.
-	 * This info is converted into bytes before storing the header, so
-	 * when the application reads this header to go to console or to
-	 * thread info it has to simply 'lseek' as many bytes.
+	 * The offsets in it are in bytes from the header, so when the
+	 * application reads this header to go to a section it has to
+	 * simply 'lseek' as many bytes.
 	 */
-	hdr->console_offset = (console_offset-blk)*ctx->mmc->write_bl_len;
-	hdr->console_length = console_len_bytes;
+	hdr.dump_length = (next - blk) * ctx->mmc->write_bl_len;
+	hdr.write_us = div_u64(local_clock() - ctx->start_ns, NSEC_PER_USEC);
+	memset(ctx->bounce, 0, PAGE_SIZE);
+	memcpy(ctx->bounce, &hdr, sizeof(hdr));
 
-#ifndef CONFIG_CDEBUGGER
-	hdr->threads_offset = (threads_offset-blk)*ctx->mmc->write_bl_len;
-	hdr->threads_length = (threads_len)*ctx->mmc->write_bl_len;
-#endif
 	pr_debug("apanic: writing the header at block %ld\n", blk);
 
 	if (blk >= partition_end) {
 		pr_err("ERROR %s: Write across the partition boundary\n",
 			__func__);
-		return -ENOSPC;
+		goto out;
 	}
 
 	rc = ctx->mmc->block_dev.block_write(ctx->mmc_poll_dev_num,
@@ -589,6 +579,118 @@ static const struct file_operations proc_apanic_fops = {
 	.write		= apanic_proc_write,
 };
 
+/* read len bytes from byte offset off of the partition, both in sectors */
+static int apanic_bdev_read(struct block_device *bdev, u32 off, void *buf,
+			    u32 len)
+{
+	struct apanic_data *ctx = &drv_ctx;
+	struct bio bio;
+	struct bio_vec bio_vec;
+	struct completion complete;
+	u32 n;
+
+	while (len) {
+		n = min_t(u32, len, PAGE_SIZE);
+
+		bio_init(&bio);
+		bio.bi_io_vec = &bio_vec;
+		bio_vec.bv_page = virt_to_page(ctx->bounce);
+		bio_vec.bv_len = ALIGN(n, 512);
+		bio_vec.bv_offset = 0;
+		bio.bi_vcnt = 1;
+		bio.bi_idx = 0;
+		bio.bi_size = ALIGN(n, 512);
+		bio.bi_bdev = bdev;
+		bio.bi_sector = off / 512;
+		init_completion(&complete);
+		bio.bi_private = &complete;
+		bio.bi_end_io = mmc_bio_complete;
+		submit_bio(READ, &bio);
+		wait_for_completion(&complete);
+		if (!test_bit(BIO_UPTODATE, &bio.bi_flags))
+			return -EIO;
+
+		memcpy(buf, ctx->bounce, n);
+		buf += n;
+		off += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/* undo the apanic_frame stream in buf into ctx->data[i] */
+static int apanic_unpack(struct apanic_data *ctx, int i,
+			 const unsigned char *buf, size_t len)
+{
+	const unsigned char *end = buf + len;
+	unsigned char *raw, *p;
+	struct apanic_frame f;
+	size_t clen, rlen;
+
+	raw = vmalloc(max(ctx->curr.raw_length[i], 1U));
+	if (!raw)
+		return -ENOMEM;
+
+	/* a bad frame ends the section, what came before it is kept */
+	for (p = raw; buf + sizeof(f) <= end; buf += sizeof(f) + clen) {
+		memcpy(&f, buf, sizeof(f));
+		clen = f.length & ~APANIC_FRAME_STORED;
+		rlen = f.raw_length;
+		if (clen > (size_t)(end - buf) - sizeof(f) ||
+		    rlen > (size_t)(raw + ctx->curr.raw_length[i] - p))
+			break;
+		if (f.length & APANIC_FRAME_STORED) {
+			if (clen != rlen)
+				break;
+			memcpy(p, buf + sizeof(f), rlen);
+		} else if (lz4_decompress_unknownoutputsize(buf + sizeof(f),
+							    clen, p, &rlen)) {
+			break;
+		}
+		p += rlen;
+	}
+
+	if (p - raw != ctx->curr.raw_length[i])
+		printk(KERN_ERR DRVNAME "%s: %zu of %u bytes recovered\n",
+		       apanic_proc_name[i], (size_t)(p - raw),
+		       ctx->curr.raw_length[i]);
+	ctx->data[i] = raw;
+	ctx->size[i] = p - raw;
+	return 0;
+}
+
+static int apanic_load_section(struct apanic_data *ctx,
+			       struct block_device *bdev, int i)
+{
+	u32 len = ctx->curr.sect[i].length;
+	void *buf;
+	int ret;
+
+	if (!len)
+		return 0;
+
+	buf = vmalloc(len);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = apanic_bdev_read(bdev, ctx->curr.sect[i].offset, buf, len);
+	if (ret) {
+		printk(KERN_ERR DRVNAME "reading %s failed (%d)\n",
+		       apanic_proc_name[i], ret);
+		vfree(buf);
+		return ret;
+	}
+
+	if (!(ctx->curr.flags & PHDR_LZ4)) {
+		ctx->data[i] = buf;
+		ctx->size[i] = len;
+		return 0;
+	}
+	ret = apanic_unpack(ctx, i, buf, len);
+	vfree(buf);
+	return ret;
+}
+
 static ssize_t apanic_trigger_check(struct file *file,
 				    const char __user *devpath,
 				    size_t count, loff_t *ppos)
@@ -602,7 +704,7 @@ static ssize_t apanic_trigger_check(struct file *file,
 	struct page *page;
 	char *copy_devpath;
 	char *user_dev_path = NULL;
-	int ret;
+	int ret, i;
 
 	/* Allocate memory to store the path name passed from user */
 	/* Allocate an extra byte for storing the NULL character */
@@ -680,52 +782,68 @@ static ssize_t apanic_trigger_check(struct file *file,
 	submit_bio(READ, &bio);
 	wait_for_completion(&complete);
 
-	blkdev_put(bdev, FMODE_READ);
 	printk(KERN_ERR DRVNAME "using block device '%s'\n", copy_devpath);
 
 	if (hdr->magic != PANIC_MAGIC) {
 		printk(KERN_INFO DRVNAME "no panic data available\n");
 		ret = -1;
-		goto out;
+		goto out_blkdev;
 	}
 
-	if (hdr->version != PHDR_VERSION) {
+	if (hdr->version != PHDR_VERSION &&
+	    hdr->version != PHDR_VERSION_RAW) {
 		printk(KERN_INFO DRVNAME "version mismatch (%d != %d)\n",
 		       hdr->version, PHDR_VERSION);
 		ret = -1;
-		goto out;
+		goto out_blkdev;
 	}
 
+	mutex_lock(&drv_mutex);
 	memcpy(&ctx->curr, hdr, sizeof(struct panic_header));
-
-	printk(KERN_INFO DRVNAME "c(%u, %u) t(%u, %u)\n",
-	       hdr->console_offset, hdr->console_length,
-	       hdr->threads_offset, hdr->threads_length);
-
-	if (hdr->console_length) {
-		ctx->apanic_console = proc_create_data("apanic_console",
-						      S_IFREG | S_IRUGO, NULL,
-						      &proc_apanic_fops,
-						      (void *)1);
-		if (!ctx->apanic_console)
-			printk(KERN_ERR DRVNAME "failed creating procfile\n");
-		else
-			proc_set_size(ctx->apanic_console, hdr->console_length);
+	if (ctx->curr.version == PHDR_VERSION_RAW) {
+		/* only console and threads, and nothing after them */
+		memset(&ctx->curr.sect[APANIC_THREADS + 1], 0,
+		       sizeof(*ctx->curr.sect) *
+		       (APANIC_SECTIONS - APANIC_THREADS - 1));
+		ctx->curr.flags = 0;
+	} else {
+		printk(KERN_INFO DRVNAME
+		       "dump of %u bytes written in %u ms%s\n",
+		       ctx->curr.dump_length, ctx->curr.write_us / 1000,
+		       ctx->curr.flags & PHDR_TRUNCATED ? ", truncated" : "");
 	}
 
-#ifndef CONFIG_CDEBUGGER
-	if (hdr->threads_length) {
-		ctx->apanic_threads = proc_create_data("apanic_threads",
+	printk(KERN_INFO DRVNAME "c(%u, %u) t(%u, %u) l(%u, %u)\n",
+	       ctx->curr.sect[APANIC_CONSOLE].offset,
+	       ctx->curr.sect[APANIC_CONSOLE].length,
+	       ctx->curr.sect[APANIC_THREADS].offset,
+	       ctx->curr.sect[APANIC_THREADS].length,
+	       ctx->curr.sect[APANIC_LOGGER].offset,
+	       ctx->curr.sect[APANIC_LOGGER].length);
+
+	for (i = 0; i < APANIC_SECTIONS; i++) {
+#ifdef CONFIG_CDEBUGGER
+		if (i == APANIC_THREADS)
+			continue;
+#endif
+		if (ctx->apanic_proc[i] ||
+		    apanic_load_section(ctx, bdev, i) || !ctx->size[i])
+			continue;
+
+		ctx->apanic_proc[i] = proc_create_data(apanic_proc_name[i],
 						       S_IFREG | S_IRUGO, NULL,
 						       &proc_apanic_fops,
-						       (void *)2);
-		if (!ctx->apanic_threads)
+						       (void *)(i + 1));
+		if (!ctx->apanic_proc[i])
 			printk(KERN_ERR DRVNAME "failed creating procfile\n");
 		else
-			proc_set_size(ctx->apanic_threads, hdr->threads_length);
+			proc_set_size(ctx->apanic_proc[i], ctx->size[i]);
 	}
-#endif
+	mutex_unlock(&drv_mutex);
 
+	ret = count;
+out_blkdev:
+	blkdev_put(bdev, FMODE_READ);
 	ret = count;
 out:
 	if (user_dev_path != NULL)
@@ -746,10 +864,22 @@ int __init apanic_init(void)
 		pr_err("%s: Failed to create workqueue\n", __func__);
 		return -ENOMEM;
 	}
-	atomic_notifier_chain_register(&panic_notifier_list, &panic_blk);
-	debugfs_create_file("apanic", 0644, NULL, NULL, &panic_dbg_fops);
 	memset(&drv_ctx, 0, sizeof(drv_ctx));
 	drv_ctx.bounce = (void *) __get_free_page(GFP_KERNEL);
+	drv_ctx.in = kmalloc(APANIC_CHUNK, GFP_KERNEL);
+	drv_ctx.cbuf = kmalloc(lz4_compressbound(APANIC_CHUNK), GFP_KERNEL);
+	drv_ctx.wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	/* a flush leaves less than a block, then a frame and the padding */
+	drv_ctx.out = kmalloc(APANIC_FLUSH + sizeof(struct apanic_frame) +
+			      lz4_compressbound(APANIC_CHUNK) + 512,
+			      GFP_KERNEL);
+	if (!drv_ctx.bounce || !drv_ctx.in || !drv_ctx.cbuf ||
+	    !drv_ctx.wrkmem || !drv_ctx.out) {
+		pr_err("%s: Failed to allocate the dump buffers\n", __func__);
+		return -ENOMEM;
+	}
+	atomic_notifier_chain_register(&panic_notifier_list, &panic_blk);
+	debugfs_create_file("apanic", 0644, NULL, NULL, &panic_dbg_fops);
 	INIT_WORK(&proc_removal_work, apanic_remove_proc_work);
 
 	drv_ctx.apanic_trigger = proc_create("apanic",
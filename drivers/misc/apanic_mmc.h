@@ -35,6 +35,10 @@ extern void ram_console_enable_console(int);
 extern unsigned long get_apanic_start_address(void);
 extern unsigned long get_apanic_end_address(void);
 extern int mmc_poll_stack_init(void **mmc, int dev_num, int *mmc_poll_dev_num);
+extern void logger_panic_walk(void (*fn)(void *data, const char *name,
+					 const unsigned char *a, size_t a_len,
+					 const unsigned char *b, size_t b_len),
+			      void *data);
 
 #ifdef __cplusplus
 }
@@ -30,6 +30,13 @@
 #include <linux/tty.h>
 #include <linux/delay.h>
 #include <linux/pm_wakeup.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/timer.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <asm/unaligned.h>
 
 #include <linux/of.h>
 #include <linux/of_irq.h>
@@ -40,6 +47,7 @@
 #include <mach/io_map.h>
 
 #include <plat/pi_mgr.h>
+#include <plat/clock.h>
 #include <mach/pinmux.h>
 
 #ifndef BCM_BT_LPM_BT_WAKE_ASSERT
@@ -61,11 +69,117 @@
 #define TIO_ASSERT_BT_WAKE	_IO(BCM_SHARED_UART_MAGIC, 3)
 #define TIO_DEASSERT_BT_WAKE	_IO(BCM_SHARED_UART_MAGIC, 4)
 #define TIO_GET_BT_WAKE_STATE	_IO(BCM_SHARED_UART_MAGIC, 5)
+#define TIO_SET_BT_PROFILE	_IO(BCM_SHARED_UART_MAGIC, 6)
+#define TIO_BT_AUDIO_GLITCH	_IO(BCM_SHARED_UART_MAGIC, 7)
+
+/*
+ * HCI traffic based sleep. The ldisc follows the H4 packets written to
+ * and read from the UART. Each packet written asserts BT_WAKE and keeps
+ * it for an idle timeout that depends on the kind of packet: short for
+ * commands and LE links, longer for classic ACL and for A2DP and SCO
+ * streams, so that the next packet of a stream finds the chip awake.
+ * BT_WAKE is dropped once the timeout passed without traffic, and with
+ * HOST_WAKE also deasserted the UART clock is left to the hardware
+ * gating of the CCU. LE links are learned from the connection complete
+ * events read. With lpm_auto=0 the TIO_ASSERT/DEASSERT_BT_WAKE ioctls
+ * alone drive BT_WAKE.
+ */
+enum bt_lpm_kind {
+	BT_LPM_CMD,		/* commands and events */
+	BT_LPM_LE,		/* ACL of LE links */
+	BT_LPM_ACL,		/* ACL of classic links */
+	BT_LPM_A2DP,		/* classic ACL while A2DP is on */
+	BT_LPM_SCO,
+	BT_LPM_KINDS
+};
+
+static const char * const bt_lpm_kind_names[BT_LPM_KINDS] = {
+	[BT_LPM_CMD]	= "cmd",
+	[BT_LPM_LE]	= "le",
+	[BT_LPM_ACL]	= "acl",
+	[BT_LPM_A2DP]	= "a2dp",
+	[BT_LPM_SCO]	= "sco",
+};
+
+static bool lpm_auto = true;
+module_param(lpm_auto, bool, S_IRUGO | S_IWUSR);
+static bool uart_hw_gating = true;
+module_param(uart_hw_gating, bool, S_IRUGO | S_IWUSR);
+
+static unsigned int bt_lpm_idle_ms[BT_LPM_KINDS] = {
+	[BT_LPM_CMD]	= 20,
+	[BT_LPM_LE]	= 10,
+	[BT_LPM_ACL]	= 100,
+	[BT_LPM_A2DP]	= 250,
+	[BT_LPM_SCO]	= 250,
+};
+module_param_named(idle_cmd_ms, bt_lpm_idle_ms[BT_LPM_CMD], uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(idle_le_ms, bt_lpm_idle_ms[BT_LPM_LE], uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(idle_acl_ms, bt_lpm_idle_ms[BT_LPM_ACL], uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(idle_a2dp_ms, bt_lpm_idle_ms[BT_LPM_A2DP], uint,
+		   S_IRUGO | S_IWUSR);
+module_param_named(idle_sco_ms, bt_lpm_idle_ms[BT_LPM_SCO], uint,
+		   S_IRUGO | S_IWUSR);
+
+#define H4_CMD		0x01
+#define H4_ACL		0x02
+#define H4_SCO		0x03
+#define H4_EVT		0x04
+
+#define HCI_EV_CONN_COMPLETE		0x03
+#define HCI_EV_DISCONN_COMPLETE		0x05
+#define HCI_EV_LE_META			0x3e
+#define HCI_EV_LE_CONN_COMPLETE		0x01
+#define HCI_EV_LE_ENH_CONN_COMPLETE	0x0a
+
+#define BT_LPM_HANDLES	0x1000
+
+static const u8 bt_lpm_h4_hdr[] = {
+	[H4_CMD] = 3,
+	[H4_ACL] = 4,
+	[H4_SCO] = 3,
+	[H4_EVT] = 2,
+};
+
+struct bt_lpm_h4 {
+	u8 type;		/* of the packet being parsed, 0 between them */
+	u8 got;			/* bytes in buf */
+	u8 buf[8];		/* header, then the first event parameters */
+	u16 left;		/* payload bytes still to come */
+};
+
+struct bt_lpm_stats {
+	u32 bt_wakes;
+	u32 host_wakes;
+	u32 uart_wakes;
+	u32 tx[BT_LPM_KINDS];
+	u32 rx[BT_LPM_KINDS];
+	u32 resync;		/* bytes skipped between packets */
+	u64 bt_wake_ns;
+	u64 uart_ns;
+};
 
 struct bcm_bt_lpm_struct {
 	spinlock_t bcm_bt_lpm_lock;
 	struct uart_port *uport;
 	int host_irq;
+	struct clk *uart_clk;
+	struct timer_list idle_timer;
+	/* under bcm_bt_lpm_lock */
+	unsigned long idle_until;
+	bool bt_wake_on;
+	bool uart_on;		/* clock held on, else gated by the CCU */
+	ktime_t bt_wake_start;
+	ktime_t uart_start;
+	struct bt_lpm_stats stats;
+	/* tx_h4 under the tty write lock, rx_h4 in receive_buf */
+	struct bt_lpm_h4 tx_h4;
+	struct bt_lpm_h4 rx_h4;
+	DECLARE_BITMAP(le_links, BT_LPM_HANDLES);
+	struct dentry *debugfs;
 };
 
 struct bcm_bt_lpm_entry_struct {
@@ -83,14 +197,266 @@ struct bcm_bt_lpm_entry_struct *priv_g;
 struct bcm_bt_lpm_ldisc_data {
 	int	(*open)(struct tty_struct *);
 	void	(*close)(struct tty_struct *);
+	ssize_t	(*write)(struct tty_struct *, struct file *,
+			 const unsigned char *, size_t);
+	void	(*receive_buf)(struct tty_struct *, const unsigned char *,
+			       char *, int);
 };
 
 static struct tty_ldisc_ops bcm_bt_lpm_ldisc_ops;
 static struct bcm_bt_lpm_ldisc_data bcm_bt_lpm_ldisc_saved;
 static int hostwake_flag = 0;
 
+/* profile hints from the stack, for the Wi-Fi coex settings */
+static BLOCKING_NOTIFIER_HEAD(bt_profile_chain);
+static DEFINE_MUTEX(bt_profile_lock);
+static unsigned int bt_profiles;
+static unsigned long bt_audio_glitches;
+module_param(bt_profiles, uint, S_IRUGO);
+module_param(bt_audio_glitches, ulong, S_IRUGO);
+
+int bcm_bt_lpm_register_profile_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&bt_profile_chain, nb);
+}
+EXPORT_SYMBOL(bcm_bt_lpm_register_profile_notifier);
+
+int bcm_bt_lpm_unregister_profile_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&bt_profile_chain, nb);
+}
+EXPORT_SYMBOL(bcm_bt_lpm_unregister_profile_notifier);
+
+unsigned int bcm_bt_lpm_get_profiles(void)
+{
+	return ACCESS_ONCE(bt_profiles);
+}
+EXPORT_SYMBOL(bcm_bt_lpm_get_profiles);
+
+unsigned long bcm_bt_lpm_get_audio_glitches(void)
+{
+	return ACCESS_ONCE(bt_audio_glitches);
+}
+EXPORT_SYMBOL(bcm_bt_lpm_get_audio_glitches);
+
+static void bcm_bt_lpm_set_profiles(unsigned int profiles)
+{
+	mutex_lock(&bt_profile_lock);
+	if (profiles != bt_profiles) {
+		pr_info("%s: BLUETOOTH: profiles 0x%x -> 0x%x\n",
+			__func__, bt_profiles, profiles);
+		bt_profiles = profiles;
+		blocking_notifier_call_chain(&bt_profile_chain, profiles, NULL);
+	}
+	mutex_unlock(&bt_profile_lock);
+}
+
+/* under bcm_bt_lpm_lock */
+static void bcm_bt_lpm_uart_update(struct bcm_bt_lpm_struct *lpm)
+{
+	bool on = !uart_hw_gating || !lpm->uport || lpm->bt_wake_on ||
+		  hostwake_flag;
+	ktime_t now;
+
+	if (on == lpm->uart_on || IS_ERR_OR_NULL(lpm->uart_clk))
+		return;
+
+	now = ktime_get();
+	if (on) {
+		lpm->stats.uart_wakes++;
+		lpm->uart_start = now;
+	} else {
+		lpm->stats.uart_ns += ktime_to_ns(ktime_sub(now,
+							    lpm->uart_start));
+	}
+	/* hardware gating stops the clock whenever the UART is idle */
+	peri_clk_set_hw_gating_ctrl(lpm->uart_clk,
+				    on ? CLK_GATING_SW : CLK_GATING_AUTO);
+	lpm->uart_on = on;
+}
+
+/* under bcm_bt_lpm_lock */
+static void bcm_bt_lpm_bt_wake_set(struct bcm_bt_lpm_entry_struct *priv,
+				   bool on)
+{
+	struct bcm_bt_lpm_struct *lpm = priv->plpm;
+	ktime_t now;
+
+	if (on == lpm->bt_wake_on)
+		return;
+
+	now = ktime_get();
+	if (on) {
+		__pm_stay_awake(priv->bt_wake_ws);
+		pi_mgr_qos_request_update(&priv->qos_bt_wake, 0);
+		/* the clock runs before the chip wakes up */
+		lpm->bt_wake_on = true;
+		bcm_bt_lpm_uart_update(lpm);
+		gpio_set_value(priv->pdata->bt_wake_gpio,
+			       BCM_BT_LPM_BT_WAKE_ASSERT);
+		lpm->stats.bt_wakes++;
+		lpm->bt_wake_start = now;
+	} else {
+		gpio_set_value(priv->pdata->bt_wake_gpio,
+			       BCM_BT_LPM_BT_WAKE_DEASSERT);
+		__pm_relax(priv->bt_wake_ws);
+		pi_mgr_qos_request_update(&priv->qos_bt_wake,
+					  PI_MGR_QOS_DEFAULT_VALUE);
+		lpm->bt_wake_on = false;
+		lpm->stats.bt_wake_ns += ktime_to_ns(ktime_sub(now,
+							lpm->bt_wake_start));
+		bcm_bt_lpm_uart_update(lpm);
+	}
+}
+
+/* under bcm_bt_lpm_lock, the timeout only ever gets later */
+static void bcm_bt_lpm_idle_extend(struct bcm_bt_lpm_struct *lpm,
+				   unsigned int ms)
+{
+	unsigned long until = jiffies + msecs_to_jiffies(ms);
+
+	if (timer_pending(&lpm->idle_timer) &&
+	    !time_after(until, lpm->idle_until))
+		return;
+	lpm->idle_until = until;
+	mod_timer(&lpm->idle_timer, until);
+}
+
+static void bcm_bt_lpm_idle_timer(unsigned long data)
+{
+	struct bcm_bt_lpm_entry_struct *priv =
+				(struct bcm_bt_lpm_entry_struct *)data;
+	struct bcm_bt_lpm_struct *lpm = priv->plpm;
+	struct uart_port *uport = lpm->uport;
+	unsigned long flags;
+	bool busy = false;
+
+	/* the bytes still in the UART go out before the chip sleeps */
+	if (uport)
+		busy = !uart_circ_empty(&uport->state->xmit) ||
+		       !uport->ops->tx_empty(uport);
+
+	spin_lock_irqsave(&lpm->bcm_bt_lpm_lock, flags);
+	if (busy)
+		bcm_bt_lpm_idle_extend(lpm, bt_lpm_idle_ms[BT_LPM_CMD]);
+	else if (lpm_auto)
+		bcm_bt_lpm_bt_wake_set(priv, false);
+	spin_unlock_irqrestore(&lpm->bcm_bt_lpm_lock, flags);
+}
+
+static enum bt_lpm_kind bcm_bt_lpm_h4_kind(struct bcm_bt_lpm_struct *lpm,
+					   struct bt_lpm_h4 *h)
+{
+	u16 handle;
+
+	switch (h->type) {
+	case H4_ACL:
+		handle = get_unaligned_le16(h->buf) & (BT_LPM_HANDLES - 1);
+		if (test_bit(handle, lpm->le_links))
+			return BT_LPM_LE;
+		if (ACCESS_ONCE(bt_profiles) & BCM_BT_PROFILE_A2DP)
+			return BT_LPM_A2DP;
+		return BT_LPM_ACL;
+	case H4_SCO:
+		return BT_LPM_SCO;
+	default:
+		return BT_LPM_CMD;
+	}
+}
+
+/* e[0] is the event code, e[1] the length, then the parameters */
+static void bcm_bt_lpm_h4_event(struct bcm_bt_lpm_struct *lpm,
+				const u8 *e, int len)
+{
+	u16 handle;
+
+	switch (e[0]) {
+	case HCI_EV_CONN_COMPLETE:
+	case HCI_EV_DISCONN_COMPLETE:
+		if (len < 5 || e[2])
+			break;
+		handle = get_unaligned_le16(e + 3) & (BT_LPM_HANDLES - 1);
+		clear_bit(handle, lpm->le_links);
+		break;
+	case HCI_EV_LE_META:
+		if (len < 6 || e[3] ||
+		    (e[2] != HCI_EV_LE_CONN_COMPLETE &&
+		     e[2] != HCI_EV_LE_ENH_CONN_COMPLETE))
+			break;
+		handle = get_unaligned_le16(e + 4) & (BT_LPM_HANDLES - 1);
+		set_bit(handle, lpm->le_links);
+		break;
+	}
+}
+
+/*
+ * Follows an H4 stream, counts the packets starting in it by kind and
+ * returns the longest idle timeout among them. Bytes that cannot start
+ * a packet are skipped.
+ */
+static unsigned int bcm_bt_lpm_h4_parse(struct bcm_bt_lpm_struct *lpm,
+					struct bt_lpm_h4 *h,
+					const unsigned char *p, int n,
+					u32 *count)
+{
+	unsigned int ms = 0;
+	int hlen, k;
+	enum bt_lpm_kind kind;
+
+	while (n > 0) {
+		if (!h->type) {
+			if (*p >= H4_CMD && *p <= H4_EVT) {
+				h->type = *p;
+				h->got = 0;
+			} else {
+				lpm->stats.resync++;
+			}
+			p++;
+			n--;
+			continue;
+		}
+
+		hlen = bt_lpm_h4_hdr[h->type];
+		if (h->got < hlen) {
+			k = min(n, hlen - h->got);
+			memcpy(h->buf + h->got, p, k);
+			h->got += k;
+			p += k;
+			n -= k;
+			if (h->got < hlen)
+				break;
+			if (h->type == H4_ACL)
+				h->left = get_unaligned_le16(h->buf + 2);
+			else
+				h->left = h->buf[hlen - 1];
+			kind = bcm_bt_lpm_h4_kind(lpm, h);
+			count[kind]++;
+			ms = max(ms, bt_lpm_idle_ms[kind]);
+		}
+
+		k = min_t(int, n, h->left);
+		if (h->type == H4_EVT) {
+			int c = min_t(int, k, sizeof(h->buf) - h->got);
+
+			memcpy(h->buf + h->got, p, c);
+			h->got += c;
+		}
+		h->left -= k;
+		p += k;
+		n -= k;
+		if (!h->left) {
+			if (h->type == H4_EVT)
+				bcm_bt_lpm_h4_event(lpm, h->buf, h->got);
+			h->type = 0;
+		}
+	}
+	return ms;
+}
+
 int bcm_bt_lpm_assert_bt_wake(void)
 {
+	unsigned long flags;
+
 	pr_debug("%s BLUETOOTH: Enter ASSERT BT_WAKE\n", __func__);
 	if (priv_g == NULL) {
 		pr_err(
@@ -100,17 +466,20 @@ int bcm_bt_lpm_assert_bt_wake(void)
 	}
 	if (unlikely((priv_g->pdata->bt_wake_gpio == -1)))
 		return -EFAULT;
-	__pm_stay_awake(priv_g->bt_wake_ws);
-	pi_mgr_qos_request_update(&priv_g->qos_bt_wake, 0);
-
-	gpio_set_value(priv_g->pdata->bt_wake_gpio,
-					BCM_BT_LPM_BT_WAKE_ASSERT);
+	spin_lock_irqsave(&priv_g->plpm->bcm_bt_lpm_lock, flags);
+	bcm_bt_lpm_bt_wake_set(priv_g, true);
+	if (lpm_auto)
+		bcm_bt_lpm_idle_extend(priv_g->plpm,
+				       bt_lpm_idle_ms[BT_LPM_CMD]);
+	spin_unlock_irqrestore(&priv_g->plpm->bcm_bt_lpm_lock, flags);
 	pr_debug("%s BLUETOOTH: Exit ASSERT BT_WAKE\n", __func__);
 	return 0;
 }
 
 int bcm_bt_lpm_deassert_bt_wake(void)
 {
+	unsigned long flags;
+
 	if (priv_g == NULL) {
 		pr_err(
 		"%s BLUETOOTH:data corrupted:cannot de-assert bt_wake\n",
@@ -119,11 +488,13 @@ int bcm_bt_lpm_deassert_bt_wake(void)
 	}
 	if (unlikely((priv_g->pdata->bt_wake_gpio == -1)))
 		return -EFAULT;
-	gpio_set_value(priv_g->pdata->bt_wake_gpio,
-					BCM_BT_LPM_BT_WAKE_DEASSERT);
+	/* the idle timer drops it once the traffic stops */
+	if (lpm_auto)
+		return 0;
+	spin_lock_irqsave(&priv_g->plpm->bcm_bt_lpm_lock, flags);
+	bcm_bt_lpm_bt_wake_set(priv_g, false);
+	spin_unlock_irqrestore(&priv_g->plpm->bcm_bt_lpm_lock, flags);
 	pr_debug("%s: BLUETOOTH: BT_WAKE de-asserted.\n", __func__);
-	__pm_relax(priv_g->bt_wake_ws);
-	pi_mgr_qos_request_update(&priv_g->qos_bt_wake, PI_MGR_QOS_DEFAULT_VALUE);
 	return 0;
 }
 
@@ -242,6 +613,9 @@ static struct pin_config uartb2_config[2] = {
 		__pm_stay_awake(priv->host_wake_ws);
 		hostwake_flag = 1;
 		pi_mgr_qos_request_update(&priv_g->qos_bt_host_wake, 0);
+		priv->plpm->stats.host_wakes++;
+		/* the clock runs before RTS lets the chip send */
+		bcm_bt_lpm_uart_update(priv->plpm);
 		pinmux_set_pin_config(&uartb2_config[1]);
 	}
 	else {
@@ -252,6 +626,7 @@ static struct pin_config uartb2_config[2] = {
 			hostwake_flag = 0;
 		}
 		gpio_direction_output(GPIO_PIN20, 1);
+		bcm_bt_lpm_uart_update(priv->plpm);
 	}
 
 	spin_unlock_irqrestore(&priv->plpm->bcm_bt_lpm_lock, flags);
@@ -407,6 +782,16 @@ static int bcm_bt_lpm_tty_ioctl(struct tty_struct *tty,
 							__func__);
 		break;
 
+	case TIO_SET_BT_PROFILE:
+		bcm_bt_lpm_set_profiles((unsigned int)arg);
+		rc = 0;
+		break;
+
+	case TIO_BT_AUDIO_GLITCH:
+		bt_audio_glitches++;
+		rc = 0;
+		break;
+
 	default:
 		pr_err("%s: BLUETOOTH: switch default. cmd=%d\n",
 						__func__, cmd);
@@ -418,9 +803,50 @@ static int bcm_bt_lpm_tty_ioctl(struct tty_struct *tty,
 	return rc;
 }
 
+static ssize_t bcm_bt_lpm_tty_write(struct tty_struct *tty,
+				    struct file *file,
+				    const unsigned char *buf, size_t nr)
+{
+	struct bcm_bt_lpm_struct *lpm;
+	unsigned long flags;
+	unsigned int ms;
+
+	if (priv_g && priv_g->plpm->uport) {
+		lpm = priv_g->plpm;
+		ms = bcm_bt_lpm_h4_parse(lpm, &lpm->tx_h4, buf, nr,
+					 lpm->stats.tx);
+		/* the rest of a packet keeps at least the command timeout */
+		if (!ms)
+			ms = bt_lpm_idle_ms[BT_LPM_CMD];
+		if (lpm_auto) {
+			spin_lock_irqsave(&lpm->bcm_bt_lpm_lock, flags);
+			bcm_bt_lpm_bt_wake_set(priv_g, true);
+			bcm_bt_lpm_idle_extend(lpm, ms);
+			spin_unlock_irqrestore(&lpm->bcm_bt_lpm_lock, flags);
+		}
+	}
+	return bcm_bt_lpm_ldisc_saved.write(tty, file, buf, nr);
+}
+
+static void bcm_bt_lpm_tty_receive(struct tty_struct *tty,
+				   const unsigned char *cp, char *fp,
+				   int count)
+{
+	struct bcm_bt_lpm_struct *lpm;
+
+	if (priv_g && priv_g->plpm->uport) {
+		lpm = priv_g->plpm;
+		bcm_bt_lpm_h4_parse(lpm, &lpm->rx_h4, cp, count,
+				    lpm->stats.rx);
+	}
+	bcm_bt_lpm_ldisc_saved.receive_buf(tty, cp, fp, count);
+}
+
 static int bcm_bt_lpm_tty_open(struct tty_struct *tty)
 {
 	struct uart_state *state;
+	struct bcm_bt_lpm_struct *lpm;
+	unsigned long flags;
 
 	pr_debug("%s BLUETOOTH: Entering.\n", __func__);
 	state = tty->driver_data;
@@ -429,7 +855,11 @@ static int bcm_bt_lpm_tty_open(struct tty_struct *tty)
 			__func__);
 		return -EFAULT;
 	}
-	priv_g->plpm->uport = state->uart_port;
+	lpm = priv_g->plpm;
+	memset(&lpm->tx_h4, 0, sizeof(lpm->tx_h4));
+	memset(&lpm->rx_h4, 0, sizeof(lpm->rx_h4));
+	bitmap_zero(lpm->le_links, BT_LPM_HANDLES);
+	lpm->uport = state->uart_port;
 
 	bcm_bt_lpm_init_bt_wake(priv_g);
 	bcm_bt_lpm_init_hostwake(priv_g);
@@ -453,6 +883,12 @@ static int bcm_bt_lpm_tty_open(struct tty_struct *tty)
 	}
 
 	bcm_bt_lpm_start();
+
+	/* idle until the first packet */
+	spin_lock_irqsave(&lpm->bcm_bt_lpm_lock, flags);
+	bcm_bt_lpm_uart_update(lpm);
+	spin_unlock_irqrestore(&lpm->bcm_bt_lpm_lock, flags);
+
 	pr_debug("bcm_bt_lpm_tty_open()::open(): x%p",
 				bcm_bt_lpm_ldisc_saved.open);
 
@@ -466,6 +902,7 @@ static void bcm_bt_lpm_tty_close(struct tty_struct *tty)
 {
 	struct uart_state *state;
 	volatile unsigned int pad_ctrl;
+	unsigned long flags;
 
 	pr_debug("%s BLUETOOTH: Entering.\n", __func__);
 	if (!priv_g || !priv_g->plpm) {
@@ -473,7 +910,13 @@ static void bcm_bt_lpm_tty_close(struct tty_struct *tty)
 				__func__, priv_g, priv_g->plpm);
 		return;
 	}
+	del_timer_sync(&priv_g->plpm->idle_timer);
+	/* the UART clock goes back to software control with no port */
+	spin_lock_irqsave(&priv_g->plpm->bcm_bt_lpm_lock, flags);
+	bcm_bt_lpm_bt_wake_set(priv_g, false);
 	priv_g->plpm->uport = 0;
+	bcm_bt_lpm_uart_update(priv_g->plpm);
+	spin_unlock_irqrestore(&priv_g->plpm->bcm_bt_lpm_lock, flags);
 	state = tty->driver_data;
 
 	bcm_bt_lpm_clean_bt_wake(priv_g, false);
@@ -481,6 +924,9 @@ static void bcm_bt_lpm_tty_close(struct tty_struct *tty)
 	wakeup_source_unregister(priv_g->bt_wake_ws);
 	wakeup_source_unregister(priv_g->host_wake_ws);
 
+	/* the stack is gone, so are its links */
+	bcm_bt_lpm_set_profiles(0);
+
 	pad_ctrl = readl(KONA_PAD_CTRL_VA + 0x8C);
 	pad_ctrl |= 0x00000223;
 	writel(pad_ctrl, KONA_PAD_CTRL_VA + 0x8C);
@@ -508,8 +954,12 @@ static int bcm_bt_lpm_tty_init(void)
 	bcm_bt_lpm_ldisc_ops.ioctl = bcm_bt_lpm_tty_ioctl;
 	bcm_bt_lpm_ldisc_saved.open = bcm_bt_lpm_ldisc_ops.open;
 	bcm_bt_lpm_ldisc_saved.close = bcm_bt_lpm_ldisc_ops.close;
+	bcm_bt_lpm_ldisc_saved.write = bcm_bt_lpm_ldisc_ops.write;
+	bcm_bt_lpm_ldisc_saved.receive_buf = bcm_bt_lpm_ldisc_ops.receive_buf;
 	bcm_bt_lpm_ldisc_ops.open = bcm_bt_lpm_tty_open;
 	bcm_bt_lpm_ldisc_ops.close = bcm_bt_lpm_tty_close;
+	bcm_bt_lpm_ldisc_ops.write = bcm_bt_lpm_tty_write;
+	bcm_bt_lpm_ldisc_ops.receive_buf = bcm_bt_lpm_tty_receive;
 
 	err = tty_register_ldisc(N_BRCM_HCI, &bcm_bt_lpm_ldisc_ops);
 	if (err)
@@ -521,6 +971,75 @@ static int bcm_bt_lpm_tty_init(void)
 	return err;
 }
 
+static int bcm_bt_lpm_stats_show(struct seq_file *m, void *v)
+{
+	struct bcm_bt_lpm_struct *lpm = m->private;
+	struct bt_lpm_stats s;
+	unsigned long flags;
+	bool bt_wake, uart;
+	ktime_t now;
+	int i;
+
+	spin_lock_irqsave(&lpm->bcm_bt_lpm_lock, flags);
+	now = ktime_get();
+	s = lpm->stats;
+	bt_wake = lpm->bt_wake_on;
+	uart = lpm->uart_on;
+	if (bt_wake)
+		s.bt_wake_ns += ktime_to_ns(ktime_sub(now,
+						      lpm->bt_wake_start));
+	if (uart)
+		s.uart_ns += ktime_to_ns(ktime_sub(now, lpm->uart_start));
+	spin_unlock_irqrestore(&lpm->bcm_bt_lpm_lock, flags);
+
+	seq_printf(m, "bt_wake %s wakes %u active_ms %llu\n",
+		   bt_wake ? "on" : "off", s.bt_wakes,
+		   div_u64(s.bt_wake_ns, NSEC_PER_MSEC));
+	seq_printf(m, "host_wake %s wakes %u\n",
+		   hostwake_flag ? "on" : "off", s.host_wakes);
+	seq_printf(m, "uart %s wakes %u active_ms %llu\n",
+		   uart ? "on" : "gated", s.uart_wakes,
+		   div_u64(s.uart_ns, NSEC_PER_MSEC));
+	seq_puts(m, "kind       tx       rx idle_ms\n");
+	for (i = 0; i < BT_LPM_KINDS; i++)
+		seq_printf(m, "%-4s %8u %8u %7u\n", bt_lpm_kind_names[i],
+			   s.tx[i], s.rx[i], bt_lpm_idle_ms[i]);
+	seq_printf(m, "resync %u\n", s.resync);
+	return 0;
+}
+
+static int bcm_bt_lpm_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bcm_bt_lpm_stats_show, inode->i_private);
+}
+
+static ssize_t bcm_bt_lpm_stats_write(struct file *file,
+				      const char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct seq_file *m = file->private_data;
+	struct bcm_bt_lpm_struct *lpm = m->private;
+	unsigned long flags;
+	ktime_t now;
+
+	spin_lock_irqsave(&lpm->bcm_bt_lpm_lock, flags);
+	now = ktime_get();
+	memset(&lpm->stats, 0, sizeof(lpm->stats));
+	lpm->bt_wake_start = now;
+	lpm->uart_start = now;
+	spin_unlock_irqrestore(&lpm->bcm_bt_lpm_lock, flags);
+	return count;
+}
+
+static const struct file_operations bcm_bt_lpm_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= bcm_bt_lpm_stats_open,
+	.read		= seq_read,
+	.write		= bcm_bt_lpm_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static const struct of_device_id bcm_bt_lpm_of_match[] = {
 		{ .compatible = "bcm,bcm-bt-lpm",},
 		{ /* Sentinel */ },
@@ -582,6 +1101,15 @@ static int bcm_bt_lpm_probe(struct platform_device *pdev)
 		return -ENOMEM;
 
 	spin_lock_init(&priv_g->plpm->bcm_bt_lpm_lock);
+	setup_timer(&priv_g->plpm->idle_timer, bcm_bt_lpm_idle_timer,
+		    (unsigned long)priv_g);
+	/* held on until the ldisc is opened */
+	priv_g->plpm->uart_on = true;
+	priv_g->plpm->uart_start = ktime_get();
+	priv_g->plpm->uart_clk = clk_get(NULL, UARTB2_PERI_CLK_NAME_STR);
+	if (IS_ERR(priv_g->plpm->uart_clk))
+		pr_info("%s: no %s, UART clock not gated\n", __func__,
+			UARTB2_PERI_CLK_NAME_STR);
 
 	pi_mgr_qos_add_request(&priv_g->qos_bt_host_wake,
 					"bt_host_wake",
@@ -643,6 +1171,10 @@ static int bcm_bt_lpm_probe(struct platform_device *pdev)
 		__func__, priv_g->pdata->bt_wake_gpio,
 		priv_g->pdata->host_wake_gpio);
 
+	priv_g->plpm->debugfs = debugfs_create_file("bcm_bt_lpm",
+			S_IRUGO | S_IWUSR, NULL, priv_g->plpm,
+			&bcm_bt_lpm_stats_fops);
+
 	/* register line discipline driver */
 	rc = bcm_bt_lpm_tty_init();
 
@@ -666,6 +1198,12 @@ static int bcm_bt_lpm_remove(struct platform_device *pdev)
 	if (priv_g == NULL)
 		return 0;
 
+	if (priv_g->plpm) {
+		debugfs_remove(priv_g->plpm->debugfs);
+		del_timer_sync(&priv_g->plpm->idle_timer);
+		if (!IS_ERR(priv_g->plpm->uart_clk))
+			clk_put(priv_g->plpm->uart_clk);
+	}
 	if (priv_g->pdata) {
 		bcm_bt_lpm_clean_bt_wake(priv_g, true);
 		bcm_bt_lpm_clean_host_wake(priv_g);
@@ -789,6 +789,7 @@ static struct i2c_driver bh1721fvc_driver = {
 	.driver = {
 		.name = BH1721FVC_DRV_NAME,
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 		.of_match_table = bh1721fvc_of_match,
 	},
 	.probe = bh1721fvc_probe,
@@ -26,6 +26,7 @@
 #include <linux/mutex.h>
 #include <linux/interrupt.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include <linux/fs.h>
 #include <linux/uaccess.h>
 #ifdef CONFIG_HAS_EARLYSUSPEND
@@ -67,6 +68,10 @@
 #define ORIENT_INTERRUPT			ABS_PRESSURE
 #define FLAT_INTERRUPT				ABS_DISTANCE
 #define SLOW_NO_MOTION_INTERRUPT		REL_Y
+/* per sample time, in us of the monotonic clock */
+#define SAMPLE_TIME_EVENT			MSC_TIMESTAMP
+/* flush complete marker */
+#define FLUSH_COMPLETE_EVENT			MSC_RAW
 
 #define HIGH_G_INTERRUPT_X_HAPPENED			1
 #define HIGH_G_INTERRUPT_Y_HAPPENED			2
@@ -1227,6 +1232,8 @@
 
 #define MAX_FIFO_F_LEVEL 32
 #define MAX_FIFO_F_BYTES 6
+/* frames a batch drain is due at, short of the fifo wrapping around */
+#define BMA2X2_FIFO_WM_FRAMES	24
 #define BMA_MAX_RETRY_I2C_XFER (100)
 
 #define CALIBRATION_FILE_PATH	"/efs/calibration_data"
@@ -1269,6 +1276,13 @@ struct bma2x2_data {
 #endif
 	int IRQ;
 
+	/* fifo batching, changed under enable_mutex with the work stopped */
+	unsigned int batch_ms;		/* max report latency, 0 when off */
+	unsigned char batch_bw;		/* bandwidth to restore afterwards */
+	unsigned int odr_us;		/* fifo sample period */
+	ktime_t fifo_ts;		/* when the fifo was last drained */
+	unsigned int fifo_overruns;
+
 #ifdef CONFIG_BMA_USE_PLATFORM_DATA
 	struct bosch_sensor_specific *bst_pd;
 #endif
@@ -4538,6 +4552,133 @@ static int bma2x2_read_accel_xyz(struct i2c_client *client,
 	return comres;
 }
 
+/*
+ * FIFO batching.
+ *
+ * While a max report latency is set in "batch", the chip collects the
+ * samples in its 32 frame FIFO, running in stream mode at the lowest
+ * bandwidth whose output rate keeps up with "delay". The poll work then
+ * runs only when the latency is due, or before the FIFO would wrap, and
+ * drains the FIFO in one burst read. The FIFO keeps no time, so the
+ * samples of a drain are spread evenly over the time since the previous
+ * one and each is reported with its own SAMPLE_TIME_EVENT.
+ */
+static const unsigned char bma2x2_resolution[] = { 12, 10, 8, 14 };
+
+static unsigned int bma2x2_bw_odr_us(unsigned char bw)
+{
+	/* the output rate is twice the bandwidth: 15.63Hz at 7.81Hz */
+	return 64000 >> (bw - BMA2X2_BW_7_81HZ);
+}
+
+static unsigned int bma2x2_batch_period(struct bma2x2_data *bma2x2)
+{
+	return min(bma2x2->batch_ms,
+		   BMA2X2_FIFO_WM_FRAMES * bma2x2->odr_us / 1000);
+}
+
+static void bma2x2_fifo_start(struct bma2x2_data *bma2x2)
+{
+	struct i2c_client *client = bma2x2->bma2x2_client;
+	unsigned int delay_us = atomic_read(&bma2x2->delay) * 1000;
+	unsigned char bw;
+
+	for (bw = BMA2X2_BW_7_81HZ; bw < BMA2X2_BW_1000HZ; bw++)
+		if (bma2x2_bw_odr_us(bw) <= delay_us)
+			break;
+	bma2x2->odr_us = bma2x2_bw_odr_us(bw);
+
+	bma2x2_set_bandwidth(client, bw);
+	bma2x2_set_fifo_data_sel(client, 0);	/* x, y and z */
+	/* writing the fifo configuration also clears the fifo */
+	bma2x2_set_fifo_mode(client, 2);	/* stream */
+	bma2x2->fifo_ts = ktime_get();
+}
+
+static void bma2x2_fifo_stop(struct bma2x2_data *bma2x2)
+{
+	bma2x2_set_fifo_mode(bma2x2->bma2x2_client, 0);	/* bypass */
+	bma2x2_set_bandwidth(bma2x2->bma2x2_client, bma2x2->batch_bw);
+}
+
+static void bma2x2_fifo_drain(struct bma2x2_data *bma2x2)
+{
+	unsigned char fifo[MAX_FIFO_F_LEVEL * MAX_FIFO_F_BYTES];
+	unsigned char status, count, res, *f;
+	struct bma2x2acc acc = { 0 };
+	s64 span_us, step_us;
+	ktime_t now;
+	int i;
+
+	if (bma2x2_smbus_read_byte(bma2x2->bma2x2_client,
+				BMA2X2_STATUS_FIFO_REG, &status) < 0)
+		return;
+	count = BMA2X2_GET_BITSLICE(status, BMA2X2_FIFO_FRAME_COUNTER_S);
+	if (BMA2X2_GET_BITSLICE(status, BMA2X2_FIFO_OVERRUN_S))
+		bma2x2->fifo_overruns++;
+	count = min_t(unsigned char, count, MAX_FIFO_F_LEVEL);
+	if (!count)
+		return;
+
+	if (bma_i2c_burst_read(bma2x2->bma2x2_client,
+				BMA2X2_FIFO_DATA_OUTPUT_REG, fifo,
+				count * MAX_FIFO_F_BYTES) < 0)
+		return;
+	now = ktime_get();
+
+	/* samples lost to an overrun are not in the span */
+	span_us = min_t(s64, ktime_us_delta(now, bma2x2->fifo_ts),
+			(s64)count * bma2x2->odr_us);
+	step_us = div_s64(span_us, count);
+	bma2x2->fifo_ts = now;
+
+	res = bma2x2_resolution[bma2x2->sensor_type & 3];
+	for (i = 0, f = fifo; i < count; i++, f += MAX_FIFO_F_BYTES) {
+		/* same layout as the data registers, left aligned */
+		acc.x = (s16)((f[1] << 8) | f[0]) >> (16 - res);
+		acc.y = (s16)((f[3] << 8) | f[2]) >> (16 - res);
+		acc.z = (s16)((f[5] << 8) | f[4]) >> (16 - res);
+		bma2x2_remap_sensor_data(&acc, bma2x2);
+
+		input_report_abs(bma2x2->input, ABS_X, acc.x);
+		input_report_abs(bma2x2->input, ABS_Y, acc.y);
+		input_report_abs(bma2x2->input, ABS_Z, acc.z);
+		input_event(bma2x2->input, EV_MSC, SAMPLE_TIME_EVENT,
+			(u32)(ktime_to_us(now) - (count - 1 - i) * step_us));
+		input_sync(bma2x2->input);
+	}
+
+	mutex_lock(&bma2x2->value_mutex);
+	bma2x2->value = acc;
+	mutex_unlock(&bma2x2->value_mutex);
+}
+
+/* called under enable_mutex */
+static void bma2x2_batch_update(struct bma2x2_data *bma2x2,
+		unsigned int batch_ms)
+{
+	bool enabled = atomic_read(&bma2x2->enable);
+
+	if (enabled) {
+		cancel_delayed_work_sync(&bma2x2->work);
+		if (bma2x2->batch_ms) {
+			bma2x2_fifo_drain(bma2x2);
+			bma2x2_fifo_stop(bma2x2);
+		}
+	}
+
+	if (batch_ms && !bma2x2->batch_ms)
+		bma2x2_get_bandwidth(bma2x2->bma2x2_client,
+				&bma2x2->batch_bw);
+	bma2x2->batch_ms = batch_ms;
+
+	if (enabled) {
+		if (batch_ms)
+			bma2x2_fifo_start(bma2x2);
+		schedule_delayed_work(&bma2x2->work, 0);
+	}
+}
+
 static void bma2x2_work_func(struct work_struct *work)
 {
 	struct bma2x2_data *bma2x2 = container_of((struct delayed_work *)work,
@@ -4545,8 +4686,17 @@ static void bma2x2_work_func(struct work_struct *work)
 	static struct bma2x2acc acc;
 	unsigned long delay = msecs_to_jiffies(atomic_read(&bma2x2->delay));
 
+	if (bma2x2->batch_ms) {
+		bma2x2_fifo_drain(bma2x2);
+		schedule_delayed_work(&bma2x2->work,
+				msecs_to_jiffies(bma2x2_batch_period(bma2x2)));
+		return;
+	}
+
 	bma2x2_read_accel_xyz(bma2x2->bma2x2_client, bma2x2->sensor_type,
 									 &acc);
+	input_event(bma2x2->input, EV_MSC, SAMPLE_TIME_EVENT,
+			(u32)ktime_to_us(ktime_get()));
 	input_report_abs(bma2x2->input, ABS_X, acc.x);
 	input_report_abs(bma2x2->input, ABS_Y, acc.y);
 	input_report_abs(bma2x2->input, ABS_Z, acc.z);
@@ -4764,6 +4914,58 @@ static ssize_t bma2x2_delay_show(struct device *dev,
 
 }
 
+static ssize_t bma2x2_batch_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct i2c_client *client = to_i2c_client(dev);
+	struct bma2x2_data *bma2x2 = i2c_get_clientdata(client);
+
+	return sprintf(buf, "%u %u\n", bma2x2->batch_ms,
+			bma2x2->fifo_overruns);
+}
+
+static ssize_t bma2x2_batch_store(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	unsigned long data;
+	int error;
+	struct i2c_client *client = to_i2c_client(dev);
+	struct bma2x2_data *bma2x2 = i2c_get_clientdata(client);
+
+	error = strict_strtoul(buf, 10, &data);
+	if (error)
+		return error;
+
+	mutex_lock(&bma2x2->enable_mutex);
+	if (data != bma2x2->batch_ms)
+		bma2x2_batch_update(bma2x2, (unsigned int) data);
+	mutex_unlock(&bma2x2->enable_mutex);
+
+	return count;
+}
+
+static ssize_t bma2x2_flush_store(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct i2c_client *client = to_i2c_client(dev);
+	struct bma2x2_data *bma2x2 = i2c_get_clientdata(client);
+
+	mutex_lock(&bma2x2->enable_mutex);
+	if (atomic_read(&bma2x2->enable) && bma2x2->batch_ms) {
+		cancel_delayed_work_sync(&bma2x2->work);
+		bma2x2_fifo_drain(bma2x2);
+		schedule_delayed_work(&bma2x2->work,
+				msecs_to_jiffies(bma2x2_batch_period(bma2x2)));
+	}
+	input_event(bma2x2->input, EV_MSC, FLUSH_COMPLETE_EVENT, 0);
+	input_sync(bma2x2->input);
+	mutex_unlock(&bma2x2->enable_mutex);
+
+	return count;
+}
+
 static ssize_t bma2x2_chip_id_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
@@ -4807,7 +5009,12 @@ static ssize_t bma2x2_delay_store(struct device *dev,
 		return error;
 	if (data > BMA2X2_MAX_DELAY)
 		data = BMA2X2_MAX_DELAY;
+	mutex_lock(&bma2x2->enable_mutex);
 	atomic_set(&bma2x2->delay, (unsigned int) data);
+	/* the fifo rate follows the delay */
+	if (bma2x2->batch_ms)
+		bma2x2_batch_update(bma2x2, bma2x2->batch_ms);
+	mutex_unlock(&bma2x2->enable_mutex);
 
 	return count;
 }
@@ -4837,6 +5044,8 @@ static void bma2x2_set_enable(struct device *dev, int enable)
 		if (pre_enable == 0) {
 			bma2x2_set_mode(bma2x2->bma2x2_client,
 					BMA2X2_MODE_NORMAL);
+			if (bma2x2->batch_ms)
+				bma2x2_fifo_start(bma2x2);
 			schedule_delayed_work(&bma2x2->work,
 				msecs_to_jiffies(atomic_read(&bma2x2->delay)));
 			atomic_set(&bma2x2->enable, 1);
@@ -4847,6 +5056,11 @@ static void bma2x2_set_enable(struct device *dev, int enable)
 
 	} else {
 		if (pre_enable == 1) {
+			if (bma2x2->batch_ms) {
+				cancel_delayed_work_sync(&bma2x2->work);
+				bma2x2_fifo_drain(bma2x2);
+				bma2x2_fifo_stop(bma2x2);
+			}
 			bma2x2_set_mode(bma2x2->bma2x2_client, BMA2X2_MODE_SUSPEND);
 			cancel_delayed_work_sync(&bma2x2->work);
 			atomic_set(&bma2x2->enable, 0);
@@ -5721,6 +5935,10 @@ static DEVICE_ATTR(delay, S_IRUGO|S_IWUSR|S_IWGRP,
 		bma2x2_delay_show, bma2x2_delay_store);
 static DEVICE_ATTR(enable, S_IRUGO|S_IWUSR|S_IWGRP,
 		bma2x2_enable_show, bma2x2_enable_store);
+static DEVICE_ATTR(batch, S_IRUGO|S_IWUSR|S_IWGRP,
+		bma2x2_batch_show, bma2x2_batch_store);
+static DEVICE_ATTR(flush, S_IWUSR|S_IWGRP,
+		NULL, bma2x2_flush_store);
 static DEVICE_ATTR(SleepDur, S_IRUGO|S_IWUSR|S_IWGRP,
 		bma2x2_SleepDur_show, bma2x2_SleepDur_store);
 static DEVICE_ATTR(fast_calibration_x, S_IRUGO|S_IWUSR|S_IWGRP,
@@ -5827,6 +6045,8 @@ static struct attribute  *bma2x2_attributes[] = {
 	&dev_attr_value.attr,
 	&dev_attr_delay.attr,
 	&dev_attr_enable.attr,
+	&dev_attr_batch.attr,
+	&dev_attr_flush.attr,
 	&dev_attr_SleepDur.attr,
 	&dev_attr_reg.attr,
 	&dev_attr_fast_calibration_x.attr,
@@ -6301,6 +6521,10 @@ static int bma2x2_probe(struct i2c_client *client,
 	input_set_abs_params(dev, ABS_X, ABSMIN, ABSMAX, 0, 0);
 	input_set_abs_params(dev, ABS_Y, ABSMIN, ABSMAX, 0, 0);
 	input_set_abs_params(dev, ABS_Z, ABSMIN, ABSMAX, 0, 0);
+	input_set_capability(dev, EV_MSC, SAMPLE_TIME_EVENT);
+	input_set_capability(dev, EV_MSC, FLUSH_COMPLETE_EVENT);
+	/* a fifo drain is up to MAX_FIFO_F_LEVEL packets in a row */
+	input_set_events_per_packet(dev, MAX_FIFO_F_LEVEL);
 
 	input_set_drvdata(dev, data);
 
@@ -19,6 +19,7 @@
 #include <linux/mutex.h>
 #include <linux/slab.h>
 #include <linux/delay.h>
+#include <linux/ktime.h>
 #include "sensors_head.h"
 
 #ifdef CONFIG_HAS_EARLYSUSPEND
@@ -410,6 +411,7 @@ static void bmm_work_func(struct work_struct *work)
 	struct i2c_client *client = client_data->client;
 	unsigned long delay =
 		msecs_to_jiffies(atomic_read(&client_data->delay));
+	u32 ts;
 
 	mutex_lock(&client_data->mutex_value);
 
@@ -420,11 +422,13 @@ static void bmm_work_func(struct work_struct *work)
 	mutex_unlock(&client_data->mutex_op_mode);
 
 	BMM_CALL_API(read_mdataXYZ_s32)(&client_data->value);
+	ts = (u32)ktime_to_us(ktime_get());
 	bmm_remap_sensor_data(&client_data->value, client_data);
 
 	input_report_abs(client_data->input, ABS_X, client_data->value.datax);
 	input_report_abs(client_data->input, ABS_Y, client_data->value.datay);
 	input_report_abs(client_data->input, ABS_Z, client_data->value.dataz);
+	input_event(client_data->input, EV_MSC, MSC_TIMESTAMP, ts);
 	mutex_unlock(&client_data->mutex_value);
 
 	input_sync(client_data->input);
@@ -1314,6 +1318,8 @@ static int bmm_input_init(struct bmm_client_data *client_data)
 	input_set_abs_params(dev, ABS_X, MAG_VALUE_MIN, MAG_VALUE_MAX, 0, 0);
 	input_set_abs_params(dev, ABS_Y, MAG_VALUE_MIN, MAG_VALUE_MAX, 0, 0);
 	input_set_abs_params(dev, ABS_Z, MAG_VALUE_MIN, MAG_VALUE_MAX, 0, 0);
+	/* time of each sample, in us of the monotonic clock */
+	input_set_capability(dev, EV_MSC, MSC_TIMESTAMP);
 	input_set_drvdata(dev, client_data);
 
 	err = input_register_device(dev);
@@ -259,6 +259,7 @@ static struct i2c_driver bmp18x_i2c_driver =
 	{
 		.owner	= THIS_MODULE,
 		.name	= BMP18X_NAME,
+		.probe_type = PROBE_AFTER_FIRST_FRAME,
 #ifdef CONFIG_PM
 		.pm	= &bmp18x_i2c_pm_ops,
 		.of_match_table = bmp18x_of_match,
@@ -54,7 +54,11 @@
  * SUCH DAMAGE.
  */
 
+#include <linux/kernel.h>
 #include <linux/string.h>
+#include <linux/err.h>
+#include <linux/mutex.h>
+#include <crypto/hash.h>
 
 #include "hmac_sha2.h"
 
@@ -134,7 +138,7 @@ void hmac_sha256_final(struct hmac_sha256_ctx *ctx, unsigned char *mac,
 	memcpy(mac, mac_temp, mac_size);
 }
 
-void hmac_sha256(const unsigned char *key, unsigned int key_size,
+void hmac_sha256_sw(const unsigned char *key, unsigned int key_size,
 		  const unsigned char *message, unsigned int message_len,
 		  unsigned char *mac, unsigned mac_size)
 {
@@ -144,3 +148,94 @@ void hmac_sha256(const unsigned char *key, unsigned int key_size,
 	hmac_sha256_update(&ctx, message, message_len);
 	hmac_sha256_final(&ctx, mac, mac_size);
 }
+
+#ifdef CONFIG_BRCM_EMMC_RPMB_CRYPTO_API
+/*
+ * One "hmac(sha256)" transform for all RPMB frames, allocated on first
+ * use. The key is nearly always the same, so it is only set again when
+ * it changes.
+ */
+static struct crypto_shash *rpmb_hmac_tfm;
+static unsigned char rpmb_hmac_key[SHA256_BLOCK_SIZE];
+static unsigned int rpmb_hmac_key_size;
+static bool rpmb_hmac_unavailable;
+static DEFINE_MUTEX(rpmb_hmac_lock);
+
+static int hmac_sha256_crypto(const unsigned char *key, unsigned int key_size,
+		  const unsigned char *message, unsigned int message_len,
+		  unsigned char *mac, unsigned mac_size)
+{
+	unsigned char digest[SHA256_DIGEST_SIZE];
+	int ret;
+
+	if (rpmb_hmac_unavailable || key_size > sizeof(rpmb_hmac_key))
+		return -ENOENT;
+
+	mutex_lock(&rpmb_hmac_lock);
+	if (!rpmb_hmac_tfm) {
+		struct crypto_shash *tfm;
+
+		tfm = crypto_alloc_shash("hmac(sha256)", 0, 0);
+		if (IS_ERR(tfm)) {
+			pr_info("%s: no hmac(sha256), using sha2.c\n",
+				__func__);
+			rpmb_hmac_unavailable = true;
+			ret = -ENOENT;
+			goto out;
+		}
+		pr_info("%s: using %s\n", __func__,
+			crypto_tfm_alg_driver_name(crypto_shash_tfm(tfm)));
+		rpmb_hmac_tfm = tfm;
+	}
+
+	if (key_size != rpmb_hmac_key_size ||
+	    memcmp(key, rpmb_hmac_key, key_size)) {
+		ret = crypto_shash_setkey(rpmb_hmac_tfm, key, key_size);
+		if (ret) {
+			rpmb_hmac_key_size = 0;
+			goto out;
+		}
+		memcpy(rpmb_hmac_key, key, key_size);
+		rpmb_hmac_key_size = key_size;
+	}
+
+	{
+		struct {
+			struct shash_desc shash;
+			char ctx[crypto_shash_descsize(rpmb_hmac_tfm)];
+		} desc;
+
+		desc.shash.tfm = rpmb_hmac_tfm;
+		desc.shash.flags = 0;
+		ret = crypto_shash_digest(&desc.shash, message, message_len,
+					  digest);
+	}
+	if (!ret)
+		memcpy(mac, digest, min_t(unsigned, mac_size, sizeof(digest)));
+out:
+	mutex_unlock(&rpmb_hmac_lock);
+	return ret;
+}
+#else
+static inline int hmac_sha256_crypto(const unsigned char *key,
+		  unsigned int key_size, const unsigned char *message,
+		  unsigned int message_len, unsigned char *mac,
+		  unsigned mac_size)
+{
+	return -ENOENT;
+}
+#endif
+
+/*
+ * The crypto API picks the fastest registered implementation; sha2.c is
+ * the fallback when it has none.
+ */
+void hmac_sha256(const unsigned char *key, unsigned int key_size,
+		  const unsigned char *message, unsigned int message_len,
+		  unsigned char *mac, unsigned mac_size)
+{
+	if (hmac_sha256_crypto(key, key_size, message, message_len,
+			       mac, mac_size))
+		hmac_sha256_sw(key, key_size, message, message_len,
+			       mac, mac_size);
+}
@@ -85,6 +85,10 @@ void hmac_sha256_final(struct hmac_sha256_ctx *ctx, unsigned char *mac,
 void hmac_sha256(const unsigned char *key, unsigned int key_size,
 			const unsigned char *message, unsigned int message_len,
 			unsigned char *mac, unsigned mac_size);
+/* always the sha2.c implementation */
+void hmac_sha256_sw(const unsigned char *key, unsigned int key_size,
+			const unsigned char *message, unsigned int message_len,
+			unsigned char *mac, unsigned mac_size);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,78 @@
+#ifndef _IDD_HIST_H
+#define _IDD_HIST_H
+
+/*
+ * Log2 latency histograms for Idd kernel probes
+ *
+ * Copyright (C) 2014 Sony Mobile Communications AB.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2, as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/bitops.h>
+#include <linux/percpu.h>
+
+/*
+ * Bucket 0 counts 0 us, bucket n counts [2^(n-1), 2^n) us and the last
+ * bucket everything above. Each cpu counts in its own copy, so the
+ * probes take no lock; the sysfs read sums the cpus.
+ */
+#define IDD_HIST_ROWS		10
+#define IDD_HIST_BUCKETS	32
+
+struct idd_hist {
+	unsigned long n[IDD_HIST_ROWS][IDD_HIST_BUCKETS];
+};
+
+static DEFINE_PER_CPU(struct idd_hist, idd_hist);
+static const char * const *idd_hist_names;
+static int idd_hist_rows;
+
+static void idd_hist_init(const char * const *names, int rows)
+{
+	idd_hist_names = names;
+	idd_hist_rows = min(rows, IDD_HIST_ROWS);
+}
+
+static void idd_hist_add(int row, u64 usecs)
+{
+	int bucket = usecs >> 32 ? IDD_HIST_BUCKETS - 1 : fls((u32)usecs);
+
+	if (row < 0 || row >= idd_hist_rows)
+		return;
+	if (bucket >= IDD_HIST_BUCKETS)
+		bucket = IDD_HIST_BUCKETS - 1;
+	this_cpu_inc(idd_hist.n[row][bucket]);
+}
+
+static ssize_t idd_hist_show(char *buf)
+{
+	ssize_t len = 0;
+	int row, i, cpu;
+
+	for (row = 0; row < idd_hist_rows; row++) {
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s",
+				 idd_hist_names[row]);
+		for (i = 0; i < IDD_HIST_BUCKETS; i++) {
+			unsigned long sum = 0;
+
+			for_each_possible_cpu(cpu)
+				sum += per_cpu(idd_hist, cpu).n[row][i];
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %lu",
+					 sum);
+		}
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+
+	return len;
+}
+
+#endif /* _IDD_HIST_H */
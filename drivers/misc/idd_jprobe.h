@@ -18,17 +18,24 @@
  *
  */
 
+#include <linux/tracepoint.h>
 #include "circular_buffer.h"
 #include "idd_jprobe_sysfs.h"
 
-static struct jprobe idd_jprobe;
+/*
+ * The probes are attached to static tracepoints, not jprobes: a
+ * disabled tracepoint costs a branch and an enabled one a call, where
+ * a jprobe traps on every hit.
+ */
+static void (*idd_probe_unregister)(void);
 
-static int idd_jprobe_init(char *symbol_name, void *entry, char *sysfs_name)
+static int idd_jprobe_init(int (*reg)(void), void (*unreg)(void),
+			   char *sysfs_name, const char * const *hist_names,
+			   int hist_rows)
 {
 	int retval = 0;
 
-	idd_jprobe.entry = entry;
-	idd_jprobe.kp.symbol_name = symbol_name;
+	idd_hist_init(hist_names, hist_rows);
 
 /* Initialize circular buffer */
 	retval = probe_cb_init();
@@ -38,11 +45,11 @@ static int idd_jprobe_init(char *symbol_name, void *entry, char *sysfs_name)
 	retval = jprobe_sysfs_attr_init(sysfs_name);
 	if (retval)
 		goto fail;
-	retval = register_jprobe(&idd_jprobe);
+	retval = reg();
 	if (retval < 0)
 		goto fail2;
-	printk(KERN_INFO "Planted %s jprobe at %p, handler addr %p\n",
-	       idd_jprobe.kp.symbol_name, idd_jprobe.kp.addr, idd_jprobe.entry);
+	idd_probe_unregister = unreg;
+	printk(KERN_INFO "Attached %s probe\n", sysfs_name);
 
 	return retval;
 
@@ -56,10 +63,11 @@ fail:
 
 static void idd_jprobe_free(void)
 {
+	idd_probe_unregister();
+	/* no probe may still run on the buffer */
+	tracepoint_synchronize_unregister();
 	jprobe_sysfs_attr_free();
-	kfree(cbuf);
-	unregister_jprobe(&idd_jprobe);
-	printk(KERN_WARNING "idd jprobe at %p unregistered\n",
-	       idd_jprobe.kp.addr);
+	probe_cb_free();
+	printk(KERN_WARNING "idd probe unregistered\n");
 }
 #endif /* _IDD_JPROBE_H */
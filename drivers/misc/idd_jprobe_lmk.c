@@ -24,25 +24,50 @@
 #include <linux/mm.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
-#include <linux/kprobes.h>
 #include <linux/sysfs.h>
 #include <linux/delay.h>
+#include <trace/events/almk.h>
 #include "idd_jprobe.h"
 
-#define SYMBOL_NAME "idd_jprobe_lmk_hook"
 #define SYSFS_NAME "idd_jprobe_lmk"
 
-/* Prototype must be the same as tracked routine has */
-static void jroutine(char *buf)
+enum {
+	HIST_KILL,	/* LMK run to SIGKILL */
+	HIST_FREE,	/* LMK run to the victim's memory freed */
+};
+
+static const char * const hist_names[] = {
+	"kill_us", "free_us",
+};
+
+/* almk_kill_stat, when the victim's memory is freed */
+static void probe_kill(void *ignore, const struct lmk_kill_record *rec)
 {
-	probe_cb_insert_data(buf); /* Don't touch this */
+	char buf[MAX_LINE_SIZE];
+
+	scnprintf(buf, MAX_LINE_SIZE, "%d \"%s\" %d %u %u %u",
+		  rec->pid, rec->comm, rec->oom_score_adj, rec->tasksize,
+		  rec->kill_us, rec->free_us);
+	probe_cb_insert_data(buf);
+
+	idd_hist_add(HIST_KILL, rec->kill_us);
+	idd_hist_add(HIST_FREE, rec->free_us);
+}
 
-	jprobe_return(); /* Required by jprobe framework */
+static int probe_register(void)
+{
+	return register_trace_almk_kill_stat(probe_kill, NULL);
+}
+
+static void probe_unregister(void)
+{
+	unregister_trace_almk_kill_stat(probe_kill, NULL);
 }
 
 static int __init probe_init(void)
 {
-	return idd_jprobe_init(SYMBOL_NAME, jroutine, SYSFS_NAME);
+	return idd_jprobe_init(probe_register, probe_unregister, SYSFS_NAME,
+			       hist_names, ARRAY_SIZE(hist_names));
 }
 
 static void __exit probe_exit(void)
@@ -23,15 +23,44 @@
 #include <linux/slab.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
-#include <linux/kprobes.h>
 #include <linux/sysfs.h>
 #include <linux/delay.h>
 #include <linux/pm.h>
+#include <trace/events/power.h>
 #include "idd_jprobe.h"
 
-#define SYMBOL_NAME "dpm_show_time"
 #define SYSFS_NAME "idd_jprobe_pm"
 
+/* one histogram row per PM event, the last for unknown events */
+static const char * const hist_names[] = {
+	"suspend_us", "resume_us", "freeze_us", "quiesce_us",
+	"hibernate_us", "thaw_us", "restore_us", "recover_us", "other_us",
+};
+
+static int pm_row(int event)
+{
+	switch (event) {
+	case PM_EVENT_SUSPEND:
+		return 0;
+	case PM_EVENT_RESUME:
+		return 1;
+	case PM_EVENT_FREEZE:
+		return 2;
+	case PM_EVENT_QUIESCE:
+		return 3;
+	case PM_EVENT_HIBERNATE:
+		return 4;
+	case PM_EVENT_THAW:
+		return 5;
+	case PM_EVENT_RESTORE:
+		return 6;
+	case PM_EVENT_RECOVER:
+		return 7;
+	default:
+		return 8;
+	}
+}
+
 static char *pm_verb(int event)
 {
 	switch (event) {
@@ -56,27 +85,33 @@ static char *pm_verb(int event)
 	}
 }
 
-/* Prototype must be the same as tracked routine has */
-static void jroutine(ktime_t starttime, pm_message_t state, char *info)
+/* dpm_show_time(), at the end of each phase */
+static void probe_phase(void *ignore, const char *info, int event, u64 ns)
 {
-	u64 usecs64;
-	ktime_t calltime;
-
 	char buf[MAX_LINE_SIZE];
 
-	calltime = ktime_get();
-	usecs64 = ktime_to_ns(ktime_sub(calltime, starttime));
 	scnprintf(buf, MAX_LINE_SIZE, "%s %s %llu",
-		  info ?: "sys", pm_verb(state.event), usecs64);
+		  info ?: "sys", pm_verb(event), ns);
+	probe_cb_insert_data(buf);
 
-	probe_cb_insert_data(buf); /* Don't touch this */
+	do_div(ns, NSEC_PER_USEC);
+	idd_hist_add(pm_row(event), ns);
+}
 
-	jprobe_return(); /* Required by jprobe framework */
+static int probe_register(void)
+{
+	return register_trace_device_pm_phase_time(probe_phase, NULL);
+}
+
+static void probe_unregister(void)
+{
+	unregister_trace_device_pm_phase_time(probe_phase, NULL);
 }
 
 static int __init probe_init(void)
 {
-	return idd_jprobe_init(SYMBOL_NAME, jroutine, SYSFS_NAME);
+	return idd_jprobe_init(probe_register, probe_unregister, SYSFS_NAME,
+			       hist_names, ARRAY_SIZE(hist_names));
 }
 
 static void __exit probe_exit(void)
@@ -24,25 +24,50 @@
 #include <linux/mm.h>
 #include <linux/spinlock.h>
 #include <linux/string.h>
-#include <linux/kprobes.h>
 #include <linux/sysfs.h>
 #include <linux/delay.h>
+#include <trace/events/power.h>
 #include "idd_jprobe.h"
 
-#define SYMBOL_NAME "idd_jprobe_suspend_hook"
 #define SYSFS_NAME "idd_jprobe_suspend"
 
-/* Prototype must be the same as tracked routine has */
-static void jroutine(char *buf)
+enum {
+	HIST_AWAKE,	/* resume to the next suspend */
+	HIST_SUSPENDED,	/* suspend to resume */
+};
+
+static const char * const hist_names[] = {
+	"awake_us", "suspended_us",
+};
+
+static void probe_period(void *ignore, int resumed, long period_ms,
+			 long total_suspended_ms, long total_resumed_ms)
 {
-	probe_cb_insert_data(buf); /* Don't touch this */
+	char buf[MAX_LINE_SIZE];
+
+	scnprintf(buf, MAX_LINE_SIZE, "%s %ld %ld %ld",
+		  resumed ? "resumed" : "suspended", period_ms,
+		  total_suspended_ms, total_resumed_ms);
+	probe_cb_insert_data(buf);
+
+	idd_hist_add(resumed ? HIST_SUSPENDED : HIST_AWAKE,
+		     (u64)period_ms * USEC_PER_MSEC);
+}
 
-	jprobe_return(); /* Required by jprobe framework */
+static int probe_register(void)
+{
+	return register_trace_machine_suspend_period(probe_period, NULL);
+}
+
+static void probe_unregister(void)
+{
+	unregister_trace_machine_suspend_period(probe_period, NULL);
 }
 
 static int __init probe_init(void)
 {
-	return idd_jprobe_init(SYMBOL_NAME, jroutine, SYSFS_NAME);
+	return idd_jprobe_init(probe_register, probe_unregister, SYSFS_NAME,
+			       hist_names, ARRAY_SIZE(hist_names));
 }
 
 static void __exit probe_exit(void)
@@ -19,6 +19,7 @@
  */
 
 #include "circular_buffer.h"
+#include "idd_hist.h"
 
 static struct kobject *jprobe_kobj;
 
@@ -48,11 +49,21 @@ static ssize_t jprobe_attr_show(struct kobject *kobj,
 	return retval;
 }
 
+static ssize_t jprobe_hist_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return idd_hist_show(buf);
+}
+
 static struct kobj_attribute jprobe_attribute =
 	__ATTR(probe, 0444, jprobe_attr_show, NULL);
 
+static struct kobj_attribute jprobe_hist_attribute =
+	__ATTR(histogram, 0444, jprobe_hist_show, NULL);
+
 static struct attribute *attrs[] = {
 	&jprobe_attribute.attr,
+	&jprobe_hist_attribute.attr,
 	NULL,
 };
 
@@ -74,6 +74,7 @@ static unsigned int kona_get_base_clock_freq(void __iomem *reg_offset)
 }
 
 static dma_addr_t buff_dma_addr;
+static enum dma_data_direction buff_dma_dir;
 
 static void mmc_prepare_data(struct mmc_host *host, struct mmc_data *data,
 			     int cmd)
@@ -84,10 +85,13 @@ static void mmc_prepare_data(struct mmc_host *host, struct mmc_data *data,
 	    cmd == MMC_CMD_WRITE_SINGLE_BLOCK ||
 	    cmd == MMC_CMD_READ_MULTIPLE_BLOCK ||
 	    cmd == MMC_CMD_READ_SINGLE_BLOCK) {
+		/* multi-block transfers run as one sdma transfer */
+		buff_dma_dir = data->flags & MMC_DATA_READ ?
+			DMA_FROM_DEVICE : DMA_TO_DEVICE;
 		buff_dma_addr =
 		    dma_map_single(NULL, data->dest,
 				   data->blocksize * data->blocks,
-				   DMA_TO_DEVICE);
+				   buff_dma_dir);
 		iowrite32(buff_dma_addr, &host->reg->sysad);
 		debug("Using DMA transfer data->dest: %08x phys 0x%x "
 		      "sysad 0x%x \r\n",
@@ -455,7 +459,7 @@ static int kona_mmc_send_cmd(struct mmc *mmc, struct mmc_cmd *cmd,
 			iowrite32(mask, &host->reg->norintsts);
 			dma_unmap_single(NULL, buff_dma_addr,
 					 data->blocksize * data->blocks,
-					 DMA_TO_DEVICE);
+					 buff_dma_dir);
 
 		} else {
 			kona_transfer_pio(host, data);
@@ -34,6 +34,8 @@
 #include <linux/delay.h>
 #include <linux/capability.h>
 #include <linux/compat.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/mmc.h>
@@ -90,6 +92,29 @@ static int max_devices;
 static DECLARE_BITMAP(dev_use, 256);
 static DECLARE_BITMAP(name_use, 256);
 
+/*
+ * Transfers are counted by direction, packed writes on their own, and
+ * by size: bucket i holds transfers of up to 4KB << i, the last one
+ * everything larger.
+ */
+enum {
+	MMC_BLK_STATS_READ,
+	MMC_BLK_STATS_WRITE,
+	MMC_BLK_STATS_PACKED,
+	MMC_BLK_STATS_DIRS,
+};
+#define MMC_BLK_STATS_SIZES	8
+
+struct mmc_blk_size_stats {
+	u32	count;
+	u64	sectors;
+	u64	ns;
+};
+
+/* defaults for the packed write policy */
+#define MMC_BLK_PACKED_SMALL_KB	64
+#define MMC_BLK_PACKED_MAX_US	10000
+
 /*
  * There is one mmc_blk_data per slot.
  */
@@ -123,6 +148,16 @@ struct mmc_blk_data {
 	struct device_attribute force_ro;
 	struct device_attribute power_ro_lock;
 	int	area_type;
+
+	/* packed write policy, see mmc_blk_prep_packed_list() */
+	unsigned int	packed_small_sectors;
+	unsigned int	packed_max_us;
+	u32		packed_ns_per_sect;	/* moving average */
+
+	/* per request size statistics, under stats_lock */
+	spinlock_t	stats_lock;
+	struct mmc_blk_size_stats stats[MMC_BLK_STATS_DIRS]
+					[MMC_BLK_STATS_SIZES];
 };
 
 static DEFINE_MUTEX(open_lock);
@@ -384,6 +419,143 @@ out:
 	return ret;
 }
 
+static ssize_t io_stats_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	static const char * const dir_name[MMC_BLK_STATS_DIRS] = {
+		"read", "write", "packed",
+	};
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	struct mmc_blk_size_stats (*st)[MMC_BLK_STATS_SIZES];
+	unsigned long flags;
+	int dir, i, n = 0;
+
+	st = kmalloc(sizeof(md->stats), GFP_KERNEL);
+	if (!st) {
+		mmc_blk_put(md);
+		return -ENOMEM;
+	}
+	spin_lock_irqsave(&md->stats_lock, flags);
+	memcpy(st, md->stats, sizeof(md->stats));
+	spin_unlock_irqrestore(&md->stats_lock, flags);
+
+	/* count, KB/s and average latency in us per direction and size */
+	n += scnprintf(buf + n, PAGE_SIZE - n, "size");
+	for (dir = 0; dir < MMC_BLK_STATS_DIRS; dir++)
+		n += scnprintf(buf + n, PAGE_SIZE - n, " %8s %8s %8s",
+			       dir_name[dir], "KB/s", "us");
+	n += scnprintf(buf + n, PAGE_SIZE - n, "\n");
+	for (i = 0; i < MMC_BLK_STATS_SIZES; i++) {
+		n += scnprintf(buf + n, PAGE_SIZE - n,
+			       i < MMC_BLK_STATS_SIZES - 1 ? "%3uK" : ">%2uK",
+			       i < MMC_BLK_STATS_SIZES - 1 ?
+			       4 << i : 4 << (i - 1));
+		for (dir = 0; dir < MMC_BLK_STATS_DIRS; dir++) {
+			struct mmc_blk_size_stats *b = &st[dir][i];
+			u64 kbps = 0, us = 0;
+
+			if (b->ns) {
+				kbps = div64_u64(b->sectors * NSEC_PER_SEC / 2,
+						 b->ns);
+				us = div_u64(b->ns, b->count * NSEC_PER_USEC);
+			}
+			n += scnprintf(buf + n, PAGE_SIZE - n,
+				       " %8u %8llu %8llu", b->count, kbps, us);
+		}
+		n += scnprintf(buf + n, PAGE_SIZE - n, "\n");
+	}
+	n += scnprintf(buf + n, PAGE_SIZE - n, "packed ns/sector %u\n",
+		       md->packed_ns_per_sect);
+
+	kfree(st);
+	mmc_blk_put(md);
+	return n;
+}
+
+static ssize_t io_stats_store(struct device *dev,
+			      struct device_attribute *attr,
+			      const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	unsigned long flags;
+
+	spin_lock_irqsave(&md->stats_lock, flags);
+	memset(md->stats, 0, sizeof(md->stats));
+	spin_unlock_irqrestore(&md->stats_lock, flags);
+	mmc_blk_put(md);
+	return count;
+}
+
+static ssize_t packed_small_kb_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->packed_small_sectors / 2);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t packed_small_kb_store(struct device *dev,
+				     struct device_attribute *attr,
+				     const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	unsigned int kb;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &kb);
+	if (!ret)
+		md->packed_small_sectors = kb * 2;
+	mmc_blk_put(md);
+	return ret ? ret : count;
+}
+
+static ssize_t packed_max_us_show(struct device *dev,
+				  struct device_attribute *attr, char *buf)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	int ret;
+
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", md->packed_max_us);
+	mmc_blk_put(md);
+	return ret;
+}
+
+static ssize_t packed_max_us_store(struct device *dev,
+				   struct device_attribute *attr,
+				   const char *buf, size_t count)
+{
+	struct mmc_blk_data *md = mmc_blk_get(dev_to_disk(dev));
+	unsigned int us;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &us);
+	if (!ret)
+		md->packed_max_us = us;
+	mmc_blk_put(md);
+	return ret ? ret : count;
+}
+
+static DEVICE_ATTR(io_stats, S_IRUGO | S_IWUSR, io_stats_show,
+		   io_stats_store);
+static DEVICE_ATTR(packed_small_kb, S_IRUGO | S_IWUSR, packed_small_kb_show,
+		   packed_small_kb_store);
+static DEVICE_ATTR(packed_max_us, S_IRUGO | S_IWUSR, packed_max_us_show,
+		   packed_max_us_store);
+
+static struct attribute *mmc_blk_policy_attrs[] = {
+	&dev_attr_io_stats.attr,
+	&dev_attr_packed_small_kb.attr,
+	&dev_attr_packed_max_us.attr,
+	NULL,
+};
+
+static const struct attribute_group mmc_blk_policy_group = {
+	.attrs = mmc_blk_policy_attrs,
+};
+
 static int mmc_blk_open(struct block_device *bdev, fmode_t mode)
 {
 	struct mmc_blk_data *md = mmc_blk_get(bdev->bd_disk);
@@ -1597,6 +1769,58 @@ static inline u8 mmc_calc_packed_hdr_segs(struct request_queue *q,
 	return nr_segs;
 }
 
+/*
+ * Account a transfer that has completed without error. mq_rq->issue_ns
+ * is when the host started it, so the time does not include waiting for
+ * the request ahead of it.
+ */
+static void mmc_blk_account(struct mmc_blk_data *md,
+			    struct mmc_queue_req *mq_rq)
+{
+	struct mmc_blk_size_stats *b;
+	unsigned int sectors, kb;
+	unsigned long flags;
+	int dir, i = 0;
+	u64 ns;
+
+	if (!mq_rq->issue_ns)
+		return;
+	ns = local_clock() - mq_rq->issue_ns;
+	mq_rq->issue_ns = 0;
+
+	if (mmc_packed_cmd(mq_rq->cmd_type)) {
+		u32 per;
+
+		dir = MMC_BLK_STATS_PACKED;
+		sectors = mq_rq->packed->blocks;
+		/* the cost of a packed sector, for the latency bound */
+		per = (u32)min_t(u64, div_u64(ns, max(sectors, 1U)), U32_MAX);
+		md->packed_ns_per_sect = md->packed_ns_per_sect ?
+			(md->packed_ns_per_sect * 7 + per) / 8 : per;
+	} else {
+		dir = rq_data_dir(mq_rq->req) == READ ?
+			MMC_BLK_STATS_READ : MMC_BLK_STATS_WRITE;
+		sectors = mq_rq->brq.data.bytes_xfered >> 9;
+	}
+
+	kb = sectors / 2;
+	while (i < MMC_BLK_STATS_SIZES - 1 && kb > 4U << i)
+		i++;
+
+	spin_lock_irqsave(&md->stats_lock, flags);
+	b = &md->stats[dir][i];
+	b->count++;
+	b->sectors += sectors;
+	b->ns += ns;
+	spin_unlock_irqrestore(&md->stats_lock, flags);
+}
+
+/*
+ * Pack writes of at most packed_small_sectors, as long as the packed
+ * group would take no longer than packed_max_us at the rate measured for
+ * earlier packed writes. Larger writes already go out efficiently as one
+ * command, and an unbounded group delays the reads queued behind it.
+ */
 static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 {
 	struct request_queue *q = mq->queue;
@@ -1621,6 +1845,10 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 	if (max_packed_rw == 0)
 		goto no_packed;
 
+	if (md->packed_small_sectors &&
+	    blk_rq_sectors(cur) > md->packed_small_sectors)
+		goto no_packed;
+
 	if (mmc_req_rel_wr(cur) &&
 	    (md->flags & MMC_BLK_REL_WR) && !en_rel_wr)
 		goto no_packed;
@@ -1674,10 +1902,19 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		    (md->flags & MMC_BLK_REL_WR) && !en_rel_wr)
 			break;
 
+		if (md->packed_small_sectors &&
+		    blk_rq_sectors(next) > md->packed_small_sectors)
+			break;
+
 		req_sectors += blk_rq_sectors(next);
 		if (req_sectors > max_blk_count)
 			break;
 
+		if (md->packed_max_us && md->packed_ns_per_sect &&
+		    (u64)req_sectors * md->packed_ns_per_sect >
+		    (u64)md->packed_max_us * NSEC_PER_USEC)
+			break;
+
 		phys_segments +=  next->nr_phys_segments;
 		if (phys_segments > max_phys_segs)
 			break;
@@ -1932,6 +2169,8 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		} else
 			areq = NULL;
 		areq = mmc_start_req(card->host, areq, (int *) &status);
+		if (rqc)
+			mq->mqrq_cur->issue_ns = local_clock();
 		if (!areq) {
 			if (status == MMC_BLK_NEW_REQUEST)
 				mq->flags |= MMC_QUEUE_NEW_REQUEST;
@@ -1954,6 +2193,8 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			 * A block was successfully transferred.
 			 */
 			mmc_blk_reset_success(md, type);
+			if (status == MMC_BLK_SUCCESS)
+				mmc_blk_account(md, mq_rq);
 
 			if (mmc_packed_cmd(mq_rq->cmd_type)) {
 				ret = mmc_blk_end_packed_req(mq_rq);
@@ -2226,8 +2467,11 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 	}
 
 	spin_lock_init(&md->lock);
+	spin_lock_init(&md->stats_lock);
 	INIT_LIST_HEAD(&md->part);
 	md->usage = 1;
+	md->packed_small_sectors = MMC_BLK_PACKED_SMALL_KB * 2;
+	md->packed_max_us = MMC_BLK_PACKED_MAX_US;
 
 	ret = mmc_init_queue(&md->queue, card, &md->lock, subname);
 	if (ret)
@@ -2391,6 +2635,8 @@ static void mmc_blk_remove_req(struct mmc_blk_data *md)
 		card = md->queue.card;
 		if (md->disk->flags & GENHD_FL_UP) {
 			device_remove_file(disk_to_dev(md->disk), &md->force_ro);
+			sysfs_remove_group(&disk_to_dev(md->disk)->kobj,
+					   &mmc_blk_policy_group);
 			index = md->disk->first_minor
 					>> (CONFIG_MMC_BLOCK_MINORS - 1);
 			mutex_lock(&mmcpart_table_mutex);
@@ -2452,6 +2698,11 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	if (ret)
 		goto force_ro_fail;
 
+	ret = sysfs_create_group(&disk_to_dev(md->disk)->kobj,
+				 &mmc_blk_policy_group);
+	if (ret)
+		goto policy_fail;
+
 	if ((md->area_type & MMC_BLK_DATA_AREA_BOOT) &&
 	     card->ext_csd.boot_ro_lockable) {
 		umode_t mode;
@@ -2475,6 +2726,9 @@ static int mmc_add_disk(struct mmc_blk_data *md)
 	return ret;
 
 power_ro_lock_fail:
+	sysfs_remove_group(&disk_to_dev(md->disk)->kobj,
+			   &mmc_blk_policy_group);
+policy_fail:
 	device_remove_file(disk_to_dev(md->disk), &md->force_ro);
 force_ro_fail:
 	del_gendisk(md->disk);
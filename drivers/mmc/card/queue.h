@@ -41,6 +41,7 @@ struct mmc_queue_req {
 	struct mmc_async_req	mmc_active;
 	enum mmc_packed_type	cmd_type;
 	struct mmc_packed	*packed;
+	u64			issue_ns;	/* local_clock() when started */
 };
 
 struct mmc_queue {
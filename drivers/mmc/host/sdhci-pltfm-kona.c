@@ -42,6 +42,8 @@
 #include <linux/slab.h>
 #include <linux/of_gpio.h>
 #include <linux/tick.h>
+#include <linux/sched.h>
+#include <linux/math64.h>
 
 #ifdef CONFIG_APANIC_ON_MMC
 #include <linux/mmc-poll/mmc_poll_stack.h>
@@ -89,6 +91,14 @@
 #define KONA_MMC_AUTOSUSPEND_DELAY	(200)
 #define KONA_MMC_WIFI_AUTOSUSPEND_DELAY	(250)
 
+/*
+ * Bounds of the adaptive autosuspend delay, and the shortest runtime
+ * suspend that pays for gating the clocks and bringing them back.
+ */
+#define KONA_MMC_AUTOSUSPEND_MIN	(50)
+#define KONA_MMC_AUTOSUSPEND_MAX	(1600)
+#define KONA_MMC_RPM_BREAKEVEN_MS	(100)
+
 /* Enable this quirk if regulators are always ON
  * but the regulator framework is not funtional.
  * In such a case, we dont want our probe to fail.
@@ -117,6 +127,16 @@ struct sdio_dev {
 	struct mutex regulator_lock;
 	int sdio_regulator_enable;
 	unsigned char *cd_int_wake_lock_name;
+
+	/* adaptive autosuspend, see sdhci_pltfm_rpm_adapt() */
+	struct work_struct rpm_delay_work;
+	int rpm_adaptive;
+	int rpm_delay_ms;
+	u64 rpm_suspend_ns;	/* local_clock() at the last runtime suspend */
+	u32 rpm_resumes;
+	u32 rpm_quick_resumes;
+	u64 rpm_resume_ns;
+	u32 rpm_resume_max_ns;
 };
 
 #ifdef CONFIG_MACH_BCM2850_FPGA
@@ -508,14 +528,52 @@ static int sdhci_pltfm_runtime_suspend(struct device *device)
 		sdhci_runtime_resume_host(host);
 		return -EAGAIN;
 	}
+	dev->rpm_suspend_ns = local_clock();
 
 	return 0;
 }
 
+/*
+ * Adapt the autosuspend delay to the gaps between requests. A runtime
+ * suspend that ends within KONA_MMC_RPM_BREAKEVEN_MS saved less than the
+ * resume cost and delayed the request that ended it, so the delay is
+ * doubled; a suspend lasting ten times the delay shows the bursts are
+ * over, and the delay steps back down. During app launch this keeps the
+ * clocks on across the short gaps, while an idle controller is still
+ * gated after KONA_MMC_AUTOSUSPEND_MIN.
+ */
+static void sdhci_pltfm_rpm_adapt(struct sdio_dev *dev, u64 slept_ns)
+{
+	int delay = dev->rpm_delay_ms;
+
+	if (slept_ns < KONA_MMC_RPM_BREAKEVEN_MS * NSEC_PER_MSEC) {
+		dev->rpm_quick_resumes++;
+		delay = min(delay * 2, KONA_MMC_AUTOSUSPEND_MAX);
+	} else if (slept_ns > (u64)delay * 10 * NSEC_PER_MSEC) {
+		delay = max(delay - delay / 4, KONA_MMC_AUTOSUSPEND_MIN);
+	}
+
+	if (dev->rpm_adaptive && delay != dev->rpm_delay_ms) {
+		dev->rpm_delay_ms = delay;
+		/* this runs with interrupts off, under the rpm callback */
+		schedule_work(&dev->rpm_delay_work);
+	}
+}
+
+static void sdhci_pltfm_rpm_delay_work(struct work_struct *work)
+{
+	struct sdio_dev *dev =
+		container_of(work, struct sdio_dev, rpm_delay_work);
+
+	pm_runtime_set_autosuspend_delay(dev->dev,
+					 ACCESS_ONCE(dev->rpm_delay_ms));
+}
+
 static int sdhci_pltfm_runtime_resume(struct device *device)
 {
 	int ret = 0;
 	unsigned long flags;
+	u64 t0, ns;
 	struct sdio_dev *dev =
 		platform_get_drvdata(to_platform_device(device));
 	struct sdhci_host *host = dev->host;
@@ -527,6 +585,7 @@ static int sdhci_pltfm_runtime_resume(struct device *device)
 		return 0;
 	}
 
+	t0 = local_clock();
 	spin_lock_irqsave(&host->lock, flags);
 	host->runtime_suspended = false;
 	spin_unlock_irqrestore(&host->lock, flags);
@@ -538,6 +597,14 @@ static int sdhci_pltfm_runtime_resume(struct device *device)
 		return -EAGAIN;
 	}
 
+	ns = local_clock() - t0;
+	dev->rpm_resumes++;
+	dev->rpm_resume_ns += ns;
+	if (ns > dev->rpm_resume_max_ns)
+		dev->rpm_resume_max_ns = (u32)min_t(u64, ns, U32_MAX);
+	if (dev->rpm_suspend_ns && dev->devtype != SDIO_DEV_TYPE_WIFI)
+		sdhci_pltfm_rpm_adapt(dev, t0 - dev->rpm_suspend_ns);
+
 	return 0;
 }
 
@@ -555,6 +622,77 @@ static int sdhci_pltfm_runtime_idle(struct device *device)
 	return 0;
 }
 
+static ssize_t rpm_stats_show(struct device *device,
+			      struct device_attribute *attr, char *buf)
+{
+	struct sdio_dev *dev = dev_get_drvdata(device);
+	u32 resumes = dev->rpm_resumes;
+
+	return scnprintf(buf, PAGE_SIZE,
+			"delay_ms %d\nresumes %u\nquick_resumes %u\n"
+			"resume_avg_us %llu\nresume_max_us %u\n",
+			dev->rpm_delay_ms, resumes, dev->rpm_quick_resumes,
+			resumes ? div64_u64(dev->rpm_resume_ns,
+					    (u64)resumes * NSEC_PER_USEC) : 0ULL,
+			dev->rpm_resume_max_ns / NSEC_PER_USEC);
+}
+
+static ssize_t rpm_stats_store(struct device *device,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct sdio_dev *dev = dev_get_drvdata(device);
+
+	dev->rpm_resumes = 0;
+	dev->rpm_quick_resumes = 0;
+	dev->rpm_resume_ns = 0;
+	dev->rpm_resume_max_ns = 0;
+	return count;
+}
+
+static ssize_t rpm_adaptive_show(struct device *device,
+				 struct device_attribute *attr, char *buf)
+{
+	struct sdio_dev *dev = dev_get_drvdata(device);
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", dev->rpm_adaptive);
+}
+
+/* 0 goes back to the fixed delay */
+static ssize_t rpm_adaptive_store(struct device *device,
+				  struct device_attribute *attr,
+				  const char *buf, size_t count)
+{
+	struct sdio_dev *dev = dev_get_drvdata(device);
+	int adaptive;
+
+	if (sscanf(buf, "%d", &adaptive) != 1)
+		return -EINVAL;
+
+	dev->rpm_adaptive = !!adaptive;
+	if (!adaptive) {
+		dev->rpm_delay_ms = dev->devtype == SDIO_DEV_TYPE_WIFI ?
+			KONA_MMC_WIFI_AUTOSUSPEND_DELAY :
+			KONA_MMC_AUTOSUSPEND_DELAY;
+		pm_runtime_set_autosuspend_delay(device, dev->rpm_delay_ms);
+	}
+	return count;
+}
+
+static DEVICE_ATTR(rpm_stats, 0644, rpm_stats_show, rpm_stats_store);
+static DEVICE_ATTR(rpm_adaptive, 0644, rpm_adaptive_show,
+		   rpm_adaptive_store);
+
+static struct attribute *sdhci_pltfm_rpm_attrs[] = {
+	&dev_attr_rpm_stats.attr,
+	&dev_attr_rpm_adaptive.attr,
+	NULL,
+};
+
+static const struct attribute_group sdhci_pltfm_rpm_group = {
+	.attrs = sdhci_pltfm_rpm_attrs,
+};
+
 static void sdhci_pltfm_runtime_pm_init(struct device *device)
 {
 	struct sdio_dev *dev =
@@ -566,14 +704,19 @@ static void sdhci_pltfm_runtime_pm_init(struct device *device)
 	pm_runtime_irq_safe(device);
 	pm_runtime_enable(device);
 
-	if (dev->devtype == SDIO_DEV_TYPE_WIFI)
-		pm_runtime_set_autosuspend_delay(device,
-				KONA_MMC_WIFI_AUTOSUSPEND_DELAY);
-	else
-		pm_runtime_set_autosuspend_delay(device,
-				KONA_MMC_AUTOSUSPEND_DELAY);
+	INIT_WORK(&dev->rpm_delay_work, sdhci_pltfm_rpm_delay_work);
+	if (dev->devtype == SDIO_DEV_TYPE_WIFI) {
+		dev->rpm_delay_ms = KONA_MMC_WIFI_AUTOSUSPEND_DELAY;
+	} else {
+		dev->rpm_delay_ms = KONA_MMC_AUTOSUSPEND_DELAY;
+		dev->rpm_adaptive = 1;
+	}
+	pm_runtime_set_autosuspend_delay(device, dev->rpm_delay_ms);
 
 	pm_runtime_use_autosuspend(device);
+
+	if (sysfs_create_group(&device->kobj, &sdhci_pltfm_rpm_group))
+		dev_warn(device, "failed to create rpm attributes\n");
 }
 
 static void sdhci_pltfm_runtime_pm_forbid(struct device *device)
@@ -584,6 +727,9 @@ static void sdhci_pltfm_runtime_pm_forbid(struct device *device)
 	if (!sdhci_pltfm_rpm_enabled(dev))
 		return;
 
+	sysfs_remove_group(&device->kobj, &sdhci_pltfm_rpm_group);
+	cancel_work_sync(&dev->rpm_delay_work);
+
 	pm_runtime_forbid(device);
 	pm_runtime_get_noresume(device);
 	pm_runtime_disable(device);
@@ -977,6 +1123,16 @@ static int sdhci_pltfm_probe(struct platform_device *pdev)
 		host->mmc->caps |= MMC_CAP_1_8V_DDR;
 #endif
 
+#ifdef CONFIG_MMC_SDHCI_KONA_PACKED_CMD
+	/*
+	 * Let the e.MMC take packed commands. The core only turns them on
+	 * when the card reports enough packed entries, and the block
+	 * driver then groups small writes into one CMD23/CMD25 transfer.
+	 */
+	if (dev->devtype == SDIO_DEV_TYPE_EMMC)
+		host->mmc->caps2 |= MMC_CAP2_PACKED_CMD;
+#endif
+
 	dev->runtime_pm_enabled = hw_cfg->flags & KONA_SDIO_FLAGS_DEVICE_RPM_EN;
 	sdhci_pltfm_runtime_pm_init(dev->dev);
 
@@ -1220,6 +1376,20 @@ static int sdhci_pltfm_remove(struct platform_device *pdev)
 }
 
 #ifdef CONFIG_PM
+/*
+ * An empty slot, or a WLAN chip that is powered off, has nothing to save or
+ * restore while the host is runtime suspended: leave it alone over system
+ * suspend. A card inserted meanwhile comes in through the CD gpio irq.
+ */
+static int sdhci_pltfm_prepare(struct device *device)
+{
+	struct sdio_dev *dev =
+		platform_get_drvdata(to_platform_device(device));
+
+	return sdhci_pltfm_rpm_enabled(dev) && !dev->host->mmc->card &&
+		!device_may_wakeup(device) && pm_runtime_suspended(device);
+}
+
 static int sdhci_pltfm_suspend(struct device *device)
 {
 	struct sdio_dev *dev =
@@ -1306,6 +1476,7 @@ static int sdhci_pltfm_resume(struct device *device)
 	return 0;
 }
 #else
+#define sdhci_pltfm_prepare NULL
 #define sdhci_pltfm_suspend NULL
 #define sdhci_pltfm_resume NULL
 #endif /* CONFIG_PM */
@@ -1326,6 +1497,7 @@ static const struct dev_pm_ops sdhci_pltfm_pm_ops = {
 	.runtime_suspend = sdhci_pltfm_runtime_suspend,
 	.runtime_resume = sdhci_pltfm_runtime_resume,
 	.runtime_idle = sdhci_pltfm_runtime_idle,
+	.prepare = sdhci_pltfm_prepare,
 	.suspend = sdhci_pltfm_suspend,
 	.resume = sdhci_pltfm_resume,
 };
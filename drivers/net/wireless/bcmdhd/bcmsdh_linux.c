@@ -680,6 +680,15 @@ void bcmsdh_set_irq(int flag)
 	}
 }
 
+/* Route the OOB interrupt to one cpu, or back to any with cpu < 0 */
+int bcmsdh_oob_intr_set_affinity(int cpu)
+{
+	if (!sdhcinfo || !sdhcinfo->oob_irq_registered)
+		return -ENODEV;
+	return irq_set_affinity(sdhcinfo->oob_irq,
+		(cpu >= 0) ? cpumask_of(cpu) : cpu_online_mask);
+}
+
 void bcmsdh_unregister_oob_intr(void)
 {
 	SDLX_MSG(("%s: Enter\n", __FUNCTION__));
@@ -36,6 +36,7 @@
 
 #include <linux/mmc/core.h>
 #include <linux/mmc/card.h>
+#include <linux/mmc/host.h>
 #include <linux/mmc/sdio_func.h>
 #include <linux/mmc/sdio_ids.h>
 
@@ -76,6 +77,9 @@ uint sd_clock = 1;		/* Default to SD Clock turned ON */
 uint sd_hiok = FALSE;	/* Don't use hi-speed mode by default */
 uint sd_msglevel = 0x01;
 uint sd_use_dma = TRUE;
+#ifdef BCMSDIOH_TXGLOM
+uint sd_txglom = TRUE;
+#endif /* BCMSDIOH_TXGLOM */
 DHD_PM_RESUME_WAIT_INIT(sdioh_request_byte_wait);
 DHD_PM_RESUME_WAIT_INIT(sdioh_request_word_wait);
 DHD_PM_RESUME_WAIT_INIT(sdioh_request_packet_wait);
@@ -154,7 +158,14 @@ sdioh_attach(osl_t *osh, void *bar0, uint irq)
 	sd->sd_blockmode = TRUE;
 	sd->use_client_ints = TRUE;
 	sd->client_block_size[0] = 64;
+#ifdef CUSTOM_RXCHAIN
+	sd->use_rxchain = CUSTOM_RXCHAIN;
+#else
 	sd->use_rxchain = FALSE;
+#endif /* CUSTOM_RXCHAIN */
+#ifdef BCMSDIOH_TXGLOM
+	sd->txglom_mode = SDPCM_DEFGLOM_MODE;
+#endif /* BCMSDIOH_TXGLOM */
 
 	gInstance->sd = sd;
 
@@ -964,6 +975,153 @@ sdioh_request_word(sdioh_info_t *sd, uint cmd_type, uint rw, uint func, uint add
 	return ((err_ret == 0) ? SDIOH_API_RC_SUCCESS : SDIOH_API_RC_FAIL);
 }
 
+#ifdef BCMSDIOH_TXGLOM
+void
+sdioh_glom_post(sdioh_info_t *sd, uint8 *frame, void *pkt, uint len)
+{
+	BCM_REFERENCE(frame);
+	BCM_REFERENCE(len);
+
+	ASSERT(!PKTNEXT(sd->osh, pkt));
+	if (!sd->glom_info.glom_pkt_head)
+		sd->glom_info.glom_pkt_head = pkt;
+	else
+		PKTSETNEXT(sd->osh, sd->glom_info.glom_pkt_tail, pkt);
+	sd->glom_info.glom_pkt_tail = pkt;
+	sd->glom_info.count++;
+}
+
+void
+sdioh_glom_clear(sdioh_info_t *sd)
+{
+	void *pnow, *pnext;
+
+	pnext = sd->glom_info.glom_pkt_head;
+	if (!pnext) {
+		sd_err(("%s: no first packet to clear!\n", __FUNCTION__));
+		return;
+	}
+
+	while (pnext) {
+		pnow = pnext;
+		pnext = PKTNEXT(sd->osh, pnow);
+		PKTSETNEXT(sd->osh, pnow, NULL);
+		sd->glom_info.count--;
+	}
+
+	sd->glom_info.glom_pkt_head = NULL;
+	sd->glom_info.glom_pkt_tail = NULL;
+	if (sd->glom_info.count != 0) {
+		sd_err(("%s: glom count mismatch!\n", __FUNCTION__));
+		sd->glom_info.count = 0;
+	}
+}
+
+uint
+sdioh_set_mode(sdioh_info_t *sd, uint mode)
+{
+	if (mode == SDPCM_TXGLOM_CPY || mode == SDPCM_TXGLOM_MDESC)
+		sd->txglom_mode = mode;
+
+	return (sd->txglom_mode);
+}
+
+bool
+sdioh_glom_enabled(void)
+{
+	return sd_txglom;
+}
+#endif /* BCMSDIOH_TXGLOM */
+
+/* Bytes of the chain, from skip bytes into pkt, that max_segs sg entries cover */
+static uint
+sdioh_sg_span(sdioh_info_t *sd, void *pkt, uint skip, uint max_segs)
+{
+	uint len = 0;
+
+	for (; pkt && max_segs; pkt = PKTNEXT(sd->osh, pkt), max_segs--) {
+		len += PKTLEN(sd->osh, pkt) - skip;
+		skip = 0;
+	}
+
+	return len;
+}
+
+/*
+ * Map len bytes of the chain, from *pskip bytes into *ppkt, onto sd->sg_list
+ * and move *ppkt and *pskip past them. Returns the number of entries used.
+ */
+static uint
+sdioh_sg_map(sdioh_info_t *sd, void **ppkt, uint *pskip, uint len)
+{
+	void *pnext = *ppkt;
+	uint skip = *pskip;
+	uint SGCount = 0;
+	uint pkt_len;
+
+	sg_init_table(sd->sg_list, SDIOH_SDMMC_MAX_SG_ENTRIES);
+	while (len) {
+		pkt_len = MIN(PKTLEN(sd->osh, pnext) - skip, len);
+		if (pkt_len)
+			sg_set_buf(&sd->sg_list[SGCount++],
+				(uint8 *)PKTDATA(sd->osh, pnext) + skip, pkt_len);
+		len -= pkt_len;
+		skip += pkt_len;
+		if (skip == PKTLEN(sd->osh, pnext)) {
+			pnext = PKTNEXT(sd->osh, pnext);
+			skip = 0;
+		}
+	}
+	sg_mark_end(&sd->sg_list[SGCount - 1]);
+
+	*ppkt = pnext;
+	*pskip = skip;
+	return SGCount;
+}
+
+/*
+ * One CMD53 over sd->sg_list: blk_num blocks, or len bytes in byte mode when
+ * blk_num is 0. The caller holds the host.
+ */
+static int
+sdioh_sg_cmd53(sdioh_info_t *sd, uint write, uint func, uint addr, bool fifo,
+               uint SGCount, uint blk_num, uint len)
+{
+	struct sdio_func *sdio_func = gInstance->func[func];
+	struct mmc_request mmc_req;
+	struct mmc_command mmc_cmd;
+	struct mmc_data mmc_dat;
+
+	memset(&mmc_req, 0, sizeof(struct mmc_request));
+	memset(&mmc_cmd, 0, sizeof(struct mmc_command));
+	memset(&mmc_dat, 0, sizeof(struct mmc_data));
+
+	mmc_dat.sg = sd->sg_list;
+	mmc_dat.sg_len = SGCount;
+	mmc_dat.blksz = blk_num ? sd->client_block_size[func] : len;
+	mmc_dat.blocks = blk_num ? blk_num : 1;
+	mmc_dat.flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
+
+	mmc_cmd.opcode = 53;		/* SD_IO_RW_EXTENDED */
+	mmc_cmd.arg = write ? 1<<31 : 0;
+	mmc_cmd.arg |= (func & 0x7) << 28;
+	mmc_cmd.arg |= fifo ? 0 : 1<<26;
+	mmc_cmd.arg |= (addr & 0x1FFFF) << 9;
+	if (blk_num)
+		mmc_cmd.arg |= 1<<27 | (blk_num & 0x1FF);
+	else
+		mmc_cmd.arg |= (len == 512) ? 0 : len;
+	mmc_cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
+
+	mmc_req.cmd = &mmc_cmd;
+	mmc_req.data = &mmc_dat;
+
+	mmc_set_data_timeout(&mmc_dat, sdio_func->card);
+	mmc_wait_for_req(sdio_func->card->host, &mmc_req);
+
+	return mmc_cmd.error ? mmc_cmd.error : mmc_dat.error;
+}
+
 static SDIOH_API_RC
 sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
                      uint addr, void *pkt)
@@ -971,13 +1129,10 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 	bool fifo = (fix_inc == SDIOH_DATA_FIX);
 	uint32	SGCount = 0;
 	int err_ret = 0;
-	void *pnext, *pprev;
-	uint ttl_len, dma_len, lft_len, xfred_len, pkt_len;
+	void *pnext;
+	uint ttl_len, lft_len, xfred_len, pkt_len;
 	uint blk_num;
 	int blk_size;
-	struct mmc_request mmc_req;
-	struct mmc_command mmc_cmd;
-	struct mmc_data mmc_dat;
 
 	sd_trace(("%s: Enter\n", __FUNCTION__));
 
@@ -991,74 +1146,53 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 		ttl_len += PKTLEN(sd->osh, pnext);
 
 	blk_size = sd->client_block_size[func];
-	if (!sd->use_rxchain || ttl_len <= blk_size) {
-		blk_num = 0;
-		dma_len = 0;
-	} else {
-		blk_num = ttl_len / blk_size;
-		dma_len = blk_num * blk_size;
-	}
-	lft_len = ttl_len - dma_len;
+	lft_len = ttl_len;
 
-	sd_trace(("%s: %s %dB to func%d:%08x, %d blks with DMA, %dB leftover\n",
+	sd_trace(("%s: %s %dB to func%d:%08x, %s\n",
 		__FUNCTION__, write ? "W" : "R",
-		ttl_len, func, addr, blk_num, lft_len));
-
-	if (0 != dma_len) {
-		memset(&mmc_req, 0, sizeof(struct mmc_request));
-		memset(&mmc_cmd, 0, sizeof(struct mmc_command));
-		memset(&mmc_dat, 0, sizeof(struct mmc_data));
-
-		/* Set up DMA descriptors */
-		pprev = pkt;
-		for (pnext = pkt;
-		     pnext && dma_len;
-		     pnext = PKTNEXT(sd->osh, pnext)) {
-			pkt_len = PKTLEN(sd->osh, pnext);
+		ttl_len, func, addr, sd->use_rxchain ? "sg" : "pio"));
 
-			if (dma_len > pkt_len)
-				dma_len -= pkt_len;
-			else {
-				pkt_len = xfred_len = dma_len;
-				dma_len = 0;
-				pkt = pnext;
-			}
+	/*
+	 * Scatter-gather: the chain goes out in as few CMD53s as the host
+	 * allows, whole blocks first and the tail in byte mode, with no copy.
+	 */
+	if (sd->use_rxchain) {
+		struct mmc_host *host = gInstance->func[func]->card->host;
+		uint max_segs = MIN(SDIOH_SDMMC_MAX_SG_ENTRIES, host->max_segs);
+		uint max_blks = MIN(host->max_blk_count, 0x1FF);
+		uint sg_addr = addr, skip = 0, len;
+		void *pcur = pkt;
 
-			sg_set_buf(&sd->sg_list[SGCount++],
-				(uint8*)PKTDATA(sd->osh, pnext),
-				pkt_len);
+		max_blks = MAX(MIN(max_blks, host->max_req_size / blk_size), 1);
 
-			if (SGCount >= SDIOH_SDMMC_MAX_SG_ENTRIES) {
-				sd_err(("%s: sg list entries exceed limit\n",
-					__FUNCTION__));
-				return (SDIOH_API_RC_FAIL);
+		sdio_claim_host(gInstance->func[func]);
+		while (lft_len) {
+			len = MIN(lft_len, sdioh_sg_span(sd, pcur, skip, max_segs));
+			if (len >= blk_size) {
+				blk_num = MIN(len / blk_size, max_blks);
+				len = blk_num * blk_size;
+			} else {
+				blk_num = 0;
 			}
-		}
 
-		mmc_dat.sg = sd->sg_list;
-		mmc_dat.sg_len = SGCount;
-		mmc_dat.blksz = blk_size;
-		mmc_dat.blocks = blk_num;
-		mmc_dat.flags = write ? MMC_DATA_WRITE : MMC_DATA_READ;
+			SGCount = sdioh_sg_map(sd, &pcur, &skip, len);
+			lft_len -= len;
 
-		mmc_cmd.opcode = 53;		/* SD_IO_RW_EXTENDED */
-		mmc_cmd.arg = write ? 1<<31 : 0;
-		mmc_cmd.arg |= (func & 0x7) << 28;
-		mmc_cmd.arg |= 1<<27;
-		mmc_cmd.arg |= fifo ? 0 : 1<<26;
-		mmc_cmd.arg |= (addr & 0x1FFFF) << 9;
-		mmc_cmd.arg |= blk_num & 0x1FF;
-		mmc_cmd.flags = MMC_RSP_SPI_R5 | MMC_RSP_R5 | MMC_CMD_ADTC;
-
-		mmc_req.cmd = &mmc_cmd;
-		mmc_req.data = &mmc_dat;
+			/* byte mode tail of the chain: 4 byte multiple, as with PIO */
+			if (!blk_num && !pcur && (len & 3)) {
+				sd->sg_list[SGCount - 1].length += 4 - (len & 3);
+				len = (len + 3) & ~3;
+			}
 
-		sdio_claim_host(gInstance->func[func]);
-		mmc_set_data_timeout(&mmc_dat, gInstance->func[func]->card);
-		mmc_wait_for_req(gInstance->func[func]->card->host, &mmc_req);
+			err_ret = sdioh_sg_cmd53(sd, write, func, sg_addr, fifo,
+				SGCount, blk_num, len);
+			if (err_ret)
+				break;
+			if (!fifo)
+				sg_addr += len;
+		}
 		sdio_release_host(gInstance->func[func]);
 
-		err_ret = mmc_cmd.error? mmc_cmd.error : mmc_dat.error;
 		if (0 != err_ret) {
 			sd_err(("%s:CMD53 %s failed with code %d\n",
 			       __FUNCTION__,
@@ -1067,10 +1201,8 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 			sd_err(("%s:Disabling rxchain and fire it with PIO\n",
 			       __FUNCTION__));
 			sd->use_rxchain = FALSE;
-			pkt = pprev;
 			lft_len = ttl_len;
-		} else if (!fifo) {
-			addr = addr + ttl_len - lft_len - dma_len;
+			err_ret = 0;
 		}
 	}
 
@@ -1147,6 +1279,37 @@ sdioh_request_packet(sdioh_info_t *sd, uint fix_inc, uint write, uint func,
 }
 
 
+#ifdef BCMSDIOH_TXGLOM
+/* Copy mode glom: the posted frames go out from one flat packet */
+static SDIOH_API_RC
+sdioh_glom_copy(sdioh_info_t *sd, uint fix_inc, uint func, uint addr)
+{
+	SDIOH_API_RC Status;
+	void *mypkt, *pnext;
+	uint8 *buf;
+	uint len = 0;
+
+	for (pnext = sd->glom_info.glom_pkt_head; pnext; pnext = PKTNEXT(sd->osh, pnext))
+		len += PKTLEN(sd->osh, pnext);
+
+	if (!(mypkt = PKTGET(sd->osh, len, TRUE))) {
+		sd_err(("%s: PKTGET failed: len %d\n", __FUNCTION__, len));
+		return SDIOH_API_RC_FAIL;
+	}
+
+	buf = PKTDATA(sd->osh, mypkt);
+	for (pnext = sd->glom_info.glom_pkt_head; pnext; pnext = PKTNEXT(sd->osh, pnext)) {
+		bcopy(PKTDATA(sd->osh, pnext), buf, PKTLEN(sd->osh, pnext));
+		buf += PKTLEN(sd->osh, pnext);
+	}
+
+	Status = sdioh_request_packet(sd, fix_inc, SDIOH_WRITE, func, addr, mypkt);
+	PKTFREE(sd->osh, mypkt, TRUE);
+
+	return Status;
+}
+#endif /* BCMSDIOH_TXGLOM */
+
 /*
  * This function takes a buffer or packet, and fixes everything up so that in the
  * end, a DMA-able packet is created.
@@ -1169,6 +1332,16 @@ sdioh_request_buffer(sdioh_info_t *sd, uint pio_dma, uint fix_inc, uint write, u
 
 	DHD_PM_RESUME_WAIT(sdioh_request_buffer_wait);
 	DHD_PM_RESUME_RETURN_ERROR(SDIOH_API_RC_FAIL);
+#ifdef BCMSDIOH_TXGLOM
+	/* A glommed write: pkt is the last frame posted, send the whole chain */
+	if (write && pkt && sd->glom_info.glom_pkt_head) {
+		ASSERT(pkt == sd->glom_info.glom_pkt_tail);
+		if (sd->txglom_mode == SDPCM_TXGLOM_MDESC)
+			return sdioh_request_packet(sd, fix_inc, write, func, addr,
+				sd->glom_info.glom_pkt_head);
+		return sdioh_glom_copy(sd, fix_inc, func, addr);
+	}
+#endif /* BCMSDIOH_TXGLOM */
 	/* Case 1: we don't have a packet. */
 	if (pkt == NULL) {
 		sd_data(("%s: Creating new %s Packet, len=%d\n",
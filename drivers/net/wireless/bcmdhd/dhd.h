@@ -211,7 +211,7 @@ typedef struct reorder_info {
 } reorder_info_t;
 
 #ifdef DHDTCPACK_SUPPRESS
-#define MAXTCPSTREAMS 4	/* Keep this to be power of 2 */
+#define MAXTCPSTREAMS 8	/* Keep this to be power of 2 */
 typedef struct tcp_ack_info {
 	void *p_tcpackinqueue;
 	uint32 tcpack_number;
@@ -221,8 +221,36 @@ typedef struct tcp_ack_info {
 } tcp_ack_info_t;
 
 void dhd_onoff_tcpack_sup(void *pub, bool on);
+extern void dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt);
 #endif /* DHDTCPACK_SUPPRESS */
 
+#ifdef DHD_RXWAKE_CLASS
+/* Wake packet classes, each with its own rx wakelock timeout */
+enum {
+	DHD_RXWAKE_UCAST,	/* directed unicast */
+	DHD_RXWAKE_MCAST,	/* multicast and broadcast */
+	DHD_RXWAKE_ARP,
+	DHD_RXWAKE_ICMP,	/* ICMP and ICMPv6 */
+	DHD_RXWAKE_MAX
+};
+#endif /* DHD_RXWAKE_CLASS */
+
+#ifdef DHD_FWDL_FAST
+/* Stages of bringing the dongle up, timed in ton_ms */
+enum {
+	DHD_TON_FW,		/* firmware image download */
+	DHD_TON_NVRAM,		/* nvram download */
+	DHD_TON_BUSINIT,	/* clocks, F2 and the OOB interrupt */
+	DHD_TON_PROTINIT,	/* dongle sync and preinit ioctls */
+	DHD_TON_MAX
+};
+#endif /* DHD_FWDL_FAST */
+
+#ifdef DHD_TX_MQ
+/* One netdev tx queue per WMM access category, in wlfc fifo order */
+#define DHD_TX_QUEUES	4
+#endif /* DHD_TX_MQ */
+
 /* Common structure for module and instance linkage */
 typedef struct dhd_pub {
 	/* Linkage ponters */
@@ -287,6 +315,13 @@ typedef struct dhd_pub {
 	int early_suspended;	/* Early suspend status */
 	int dhcp_in_progress;	/* DHCP period */
 #endif
+#ifdef DHD_RXWAKE_CLASS
+	ulong rxwake_cnt[DHD_RXWAKE_MAX];	/* Frames sent up while suspended, per class */
+	uint rxwake_filters;	/* Rx filters taken down for suspend */
+#endif /* DHD_RXWAKE_CLASS */
+#ifdef DHD_FWDL_FAST
+	uint32 ton_ms[DHD_TON_MAX];	/* Last turn on, per stage */
+#endif /* DHD_FWDL_FAST */
 
 	/* Pkt filter defination */
 	char * pktfilter[100];
@@ -348,6 +383,10 @@ typedef struct dhd_pub {
 #ifdef DHDTCPACK_SUPPRESS
 	int tcp_ack_info_cnt;
 	tcp_ack_info_t tcp_ack_info_tbl[MAXTCPSTREAMS];
+	uint32 tcpack_replaced;		/* ACKs folded into a queued one of their flow */
+	uint32 tcpack_queued;		/* pure ACKs that went on the queue */
+	uint32 tcpack_unpure;		/* flows forgotten on data, FIN, SACK... */
+	uint32 tcpack_tbl_full;		/* pure ACKs with no room in the flow table */
 #endif /* DHDTCPACK_SUPPRESS */
 	uint32 arp_version;
 } dhd_pub_t;
@@ -521,6 +560,13 @@ extern void dhd_free(dhd_pub_t *dhdp);
 
 /* Indication from bus module to change flow-control state */
 extern void dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool on);
+#ifdef DHD_TX_MQ
+extern void dhd_txflowcontrol_ac(dhd_pub_t *dhdp, int ifidx, int ac, bool on);
+#endif /* DHD_TX_MQ */
+#ifdef DHD_THREAD_TUNE
+/* Run time of the DPC, RXF and watchdog threads into a bcmstrbuf */
+extern void dhd_os_thread_stats(dhd_pub_t *dhdp, void *strbuf);
+#endif /* DHD_THREAD_TUNE */
 
 /* Store the status of a connection attempt for later retrieval by an iovar */
 extern void dhd_store_conn_status(uint32 event, uint32 status, uint32 reason);
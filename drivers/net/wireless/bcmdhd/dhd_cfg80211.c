@@ -51,8 +51,14 @@ static int dhd_dongle_up = FALSE;
 #include <dhdioctl.h>
 #include <wlioctl.h>
 #include <dhd_cfg80211.h>
+#ifdef WL_BTCOEX_PROFILE
+#include <linux/broadcom/bcm-bt-lpm.h>
+#endif /* WL_BTCOEX_PROFILE */
 
 static s32 wl_dongle_up(struct net_device *ndev, u32 up);
+#ifdef WL_BTCOEX_PROFILE
+static void wl_cfg80211_bt_profile_resync(struct wl_priv *wl);
+#endif /* WL_BTCOEX_PROFILE */
 
 /**
  * Function implementations
@@ -144,6 +150,10 @@ s32 dhd_config_dongle(struct wl_priv *wl, bool need_lock)
 		goto default_conf_out;
 	}
 	dhd_dongle_up = true;
+#ifdef WL_BTCOEX_PROFILE
+	/* fresh firmware, its defaults and the current profiles again */
+	wl_cfg80211_bt_profile_resync(wl);
+#endif /* WL_BTCOEX_PROFILE */
 
 default_conf_out:
 	if (need_lock)
@@ -510,11 +520,155 @@ btc_coex_idle:
 	net_os_wake_unlock(btcx_inf->dev);
 }
 
+#ifdef WL_BTCOEX_PROFILE
+/*
+ * Wi-Fi settings while Bluetooth profiles are active, the first entry
+ * that has an active profile wins. -1 leaves the firmware default.
+ */
+struct wl_btc_profile {
+	u32 profiles;
+	s32 ampdu_mpdu;		/* shorter aggregates fit the BT slots */
+	s32 pm2_sleep_ret;	/* ms awake after traffic before PM_FAST sleeps */
+	s32 btc_mode;
+};
+
+static const struct wl_btc_profile wl_btc_profiles[] = {
+	{ BCM_BT_PROFILE_SCO, 4, 20, WL_BTC_PREMPT },
+	{ BCM_BT_PROFILE_A2DP, 8, 40, -1 },
+	{ BCM_BT_PROFILE_HID | BCM_BT_PROFILE_BULK, 16, -1, -1 },
+};
+
+#define WL_BTC_AUDIO	(BCM_BT_PROFILE_SCO | BCM_BT_PROFILE_A2DP)
+
+/* Wi-Fi bytes moved since the last call, counted while BT audio is up */
+static void
+wl_cfg80211_bt_account(struct btcoex_info *btco_inf)
+{
+	struct rtnl_link_stats64 stats;
+	u64 bytes;
+	u32 now = OSL_SYSUPTIME();
+
+	dev_get_stats(btco_inf->dev, &stats);
+	bytes = stats.tx_bytes + stats.rx_bytes;
+	if (btco_inf->bt_cur && (btco_inf->bt_cur->profiles & WL_BTC_AUDIO)) {
+		btco_inf->bt_audio_bytes += bytes - btco_inf->bt_last_bytes;
+		btco_inf->bt_audio_ms += now - btco_inf->bt_last_ms;
+	}
+	btco_inf->bt_last_bytes = bytes;
+	btco_inf->bt_last_ms = now;
+}
+
+static s32
+wl_cfg80211_bt_setint(struct btcoex_info *btco_inf, s8 *iovar, s32 val)
+{
+	s32 err;
+
+	if (val < 0)
+		return 0;
+	err = wldev_iovar_setint(btco_inf->dev, iovar, val);
+	if (err) {
+		WL_ERR(("%s %d failed %d\n", iovar, val, err));
+		btco_inf->bt_errors++;
+	}
+	return err;
+}
+
+static void
+wl_cfg80211_bt_profile_work(struct work_struct *work)
+{
+	struct btcoex_info *btco_inf = container_of(work, struct btcoex_info,
+		bt_profile_work);
+	const struct wl_btc_profile *p = NULL;
+	u32 profiles = ACCESS_ONCE(btco_inf->bt_profiles);
+	int i;
+
+	if (!dhd_dongle_up)
+		return;
+
+	for (i = 0; i < ARRAYSIZE(wl_btc_profiles); i++) {
+		if (profiles & wl_btc_profiles[i].profiles) {
+			p = &wl_btc_profiles[i];
+			break;
+		}
+	}
+
+	wl_cfg80211_bt_account(btco_inf);
+	if (p == btco_inf->bt_cur && btco_inf->bt_saved)
+		return;
+
+	if (!btco_inf->bt_saved) {
+		if (wldev_iovar_getint(btco_inf->dev, "ampdu_mpdu", &btco_inf->def_ampdu_mpdu))
+			btco_inf->def_ampdu_mpdu = -1;
+		if (wldev_iovar_getint(btco_inf->dev, "pm2_sleep_ret",
+			&btco_inf->def_pm2_sleep_ret))
+			btco_inf->def_pm2_sleep_ret = -1;
+		if (wldev_iovar_getint(btco_inf->dev, "btc_mode", &btco_inf->def_btc_mode))
+			btco_inf->def_btc_mode = -1;
+		btco_inf->bt_saved = TRUE;
+	}
+
+	WL_DBG(("bt profiles 0x%x, ampdu_mpdu %d\n", profiles,
+		p ? p->ampdu_mpdu : btco_inf->def_ampdu_mpdu));
+	/* an entry's -1 is the firmware default, which may have been overridden */
+	wl_cfg80211_bt_setint(btco_inf, "ampdu_mpdu",
+		(p && p->ampdu_mpdu >= 0) ? p->ampdu_mpdu : btco_inf->def_ampdu_mpdu);
+	wl_cfg80211_bt_setint(btco_inf, "pm2_sleep_ret",
+		(p && p->pm2_sleep_ret >= 0) ? p->pm2_sleep_ret : btco_inf->def_pm2_sleep_ret);
+	wl_cfg80211_bt_setint(btco_inf, "btc_mode",
+		(p && p->btc_mode >= 0) ? p->btc_mode : btco_inf->def_btc_mode);
+
+	btco_inf->bt_cur = p;
+	btco_inf->bt_changes++;
+}
+
+static int
+wl_cfg80211_bt_profile_notify(struct notifier_block *nb, unsigned long profiles, void *unused)
+{
+	struct btcoex_info *btco_inf = container_of(nb, struct btcoex_info, bt_nb);
+
+	btco_inf->bt_profiles = (u32)profiles;
+	schedule_work(&btco_inf->bt_profile_work);
+	return NOTIFY_OK;
+}
+
+static void
+wl_cfg80211_bt_profile_resync(struct wl_priv *wl)
+{
+	struct btcoex_info *btco_inf = wl->btcoex_info;
+
+	if (!btco_inf)
+		return;
+	cancel_work_sync(&btco_inf->bt_profile_work);
+	btco_inf->bt_saved = FALSE;
+	btco_inf->bt_cur = NULL;
+	btco_inf->bt_profiles = bcm_bt_lpm_get_profiles();
+	schedule_work(&btco_inf->bt_profile_work);
+}
+
+int
+wl_cfg80211_btcoex_stats(struct net_device *dev, char *command, int total_len)
+{
+	struct wl_priv *wl = wlcfg_drv_priv;
+	struct btcoex_info *btco_inf = wl->btcoex_info;
+	u32 kbps = 0;
+
+	if (!btco_inf)
+		return -ENODEV;
+
+	if (btco_inf->bt_audio_ms)
+		kbps = (u32)div_u64(btco_inf->bt_audio_bytes * 8, btco_inf->bt_audio_ms);
+	return snprintf(command, total_len,
+		"profiles 0x%x changes %u errors %u audio_ms %u audio_kbps %u glitches %lu",
+		btco_inf->bt_profiles, btco_inf->bt_changes, btco_inf->bt_errors,
+		btco_inf->bt_audio_ms, kbps, bcm_bt_lpm_get_audio_glitches());
+}
+#endif /* WL_BTCOEX_PROFILE */
+
 int wl_cfg80211_btcoex_init(struct wl_priv *wl)
 {
 	struct btcoex_info *btco_inf = NULL;
 
-	btco_inf = kmalloc(sizeof(struct btcoex_info), GFP_KERNEL);
+	btco_inf = kzalloc(sizeof(struct btcoex_info), GFP_KERNEL);
 	if (!btco_inf)
 		return -ENOMEM;
 
@@ -531,6 +685,13 @@ int wl_cfg80211_btcoex_init(struct wl_priv *wl)
 
 	INIT_WORK(&btco_inf->work, wl_cfg80211_bt_handler);
 
+#ifdef WL_BTCOEX_PROFILE
+	INIT_WORK(&btco_inf->bt_profile_work, wl_cfg80211_bt_profile_work);
+	btco_inf->bt_nb.notifier_call = wl_cfg80211_bt_profile_notify;
+	if (bcm_bt_lpm_register_profile_notifier(&btco_inf->bt_nb))
+		WL_ERR(("no bluetooth profile hints\n"));
+#endif /* WL_BTCOEX_PROFILE */
+
 	wl->btcoex_info = btco_inf;
 	return 0;
 }
@@ -546,6 +707,10 @@ void wl_cfg80211_btcoex_deinit(struct wl_priv *wl)
 	}
 
 	cancel_work_sync(&wl->btcoex_info->work);
+#ifdef WL_BTCOEX_PROFILE
+	bcm_bt_lpm_unregister_profile_notifier(&wl->btcoex_info->bt_nb);
+	cancel_work_sync(&wl->btcoex_info->bt_profile_work);
+#endif /* WL_BTCOEX_PROFILE */
 
 	kfree(wl->btcoex_info);
 	wl->btcoex_info = NULL;
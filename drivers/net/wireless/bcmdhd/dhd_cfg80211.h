@@ -49,5 +49,8 @@ static inline int dhd_cfg80211_testmode_cmd(struct wiphy *wiphy, void *data, int
 
 int wl_cfg80211_btcoex_init(struct wl_priv *wl);
 void wl_cfg80211_btcoex_deinit(struct wl_priv *wl);
+#ifdef WL_BTCOEX_PROFILE
+int wl_cfg80211_btcoex_stats(struct net_device *dev, char *command, int total_len);
+#endif /* WL_BTCOEX_PROFILE */
 
 #endif /* __DHD_CFG80211__ */
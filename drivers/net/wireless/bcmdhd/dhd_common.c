@@ -262,6 +262,27 @@ dhd_dump(dhd_pub_t *dhdp, char *buf, int buflen)
 	            dhdp->rx_ctlpkts, dhdp->rx_ctlerrs, dhdp->rx_dropped);
 	bcm_bprintf(strbuf, "rx_readahead_cnt %lu tx_realloc %lu\n",
 	            dhdp->rx_readahead_cnt, dhdp->tx_realloc);
+#ifdef DHD_RXWAKE_CLASS
+	bcm_bprintf(strbuf, "rxwake ucast %lu mcast %lu arp %lu icmp %lu\n",
+	            dhdp->rxwake_cnt[DHD_RXWAKE_UCAST], dhdp->rxwake_cnt[DHD_RXWAKE_MCAST],
+	            dhdp->rxwake_cnt[DHD_RXWAKE_ARP], dhdp->rxwake_cnt[DHD_RXWAKE_ICMP]);
+#endif /* DHD_RXWAKE_CLASS */
+#ifdef DHD_RXPOOL
+	osl_rxpool_stats(dhdp->osh, strbuf);
+#endif /* DHD_RXPOOL */
+#ifdef DHD_THREAD_TUNE
+	dhd_os_thread_stats(dhdp, strbuf);
+#endif /* DHD_THREAD_TUNE */
+#ifdef DHD_FWDL_FAST
+	bcm_bprintf(strbuf, "turn on ms: firmware %u nvram %u bus %u dongle %u\n",
+	            dhdp->ton_ms[DHD_TON_FW], dhdp->ton_ms[DHD_TON_NVRAM],
+	            dhdp->ton_ms[DHD_TON_BUSINIT], dhdp->ton_ms[DHD_TON_PROTINIT]);
+#endif /* DHD_FWDL_FAST */
+#ifdef DHDTCPACK_SUPPRESS
+	bcm_bprintf(strbuf, "tcpack replaced %u queued %u unpure %u tbl_full %u flows %d\n",
+	            dhdp->tcpack_replaced, dhdp->tcpack_queued, dhdp->tcpack_unpure,
+	            dhdp->tcpack_tbl_full, dhdp->tcp_ack_info_cnt);
+#endif /* DHDTCPACK_SUPPRESS */
 	bcm_bprintf(strbuf, "\n");
 
 	/* Add any prot info */
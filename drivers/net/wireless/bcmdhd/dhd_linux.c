@@ -43,10 +43,18 @@
 #include <linux/fcntl.h>
 #include <linux/fs.h>
 #include <linux/ip.h>
+#include <linux/ipv6.h>
 #include <net/addrconf.h>
+#ifdef DHD_RXPOOL
+#include <linux/of.h>
+#endif /* DHD_RXPOOL */
 #ifdef ENABLE_ADAPTIVE_SCHED
 #include <linux/cpufreq.h>
 #endif /* ENABLE_ADAPTIVE_SCHED */
+#ifdef DHD_FWDL_FAST
+#include <linux/vmalloc.h>
+#include <linux/zlib.h>
+#endif /* DHD_FWDL_FAST */
 
 #include <asm/uaccess.h>
 #include <asm/unaligned.h>
@@ -169,6 +177,9 @@ DECLARE_WAIT_QUEUE_HEAD(dhd_dpc_wait);
 
 #if defined(OOB_INTR_ONLY)
 extern void dhd_enable_oob_intr(struct dhd_bus *bus, bool enable);
+#ifdef DHD_THREAD_TUNE
+extern int bcmsdh_oob_intr_set_affinity(int cpu);
+#endif /* DHD_THREAD_TUNE */
 #endif 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && (1)
 static void dhd_hang_process(struct work_struct *work);
@@ -267,6 +278,10 @@ typedef struct dhd_if {
 	struct list_head ipv6_list;
 	spinlock_t		ipv6_lock;
 	bool			event2cfg80211;	/* To determine if pass event to cfg80211 */
+#ifdef DHD_TX_MQ
+	uint8			ac_fc;		/* Tx queues stopped by per AC flow control */
+	uint16			bql_gen;	/* Bumped when the BQL state is reset */
+#endif /* DHD_TX_MQ */
 } dhd_if_t;
 
 #ifdef WLMEDIA_HTSF
@@ -297,6 +312,32 @@ static uint32 maxdelay = 0, tspktcnt = 0, maxdelaypktno = 0;
 
 #endif  /* WLMEDIA_HTSF */
 
+#ifdef DHD_THREAD_TUNE
+/* Threads whose placement and scheduling can be changed at run time */
+enum {
+	DHD_THR_DPC,
+	DHD_THR_RXF,
+	DHD_THR_WDT,
+	DHD_THR_MAX
+};
+
+#define DHD_THR_CPU_UNSET	-2
+
+typedef struct dhd_thr_state {
+	/* last applied, parameter changes are picked up on the next wakeup */
+	int cpu;
+	int policy;
+	int rtprio;
+	/* run time statistics */
+	ulong wakeups;
+	u64 busy_ns;		/* wakeup to back asleep */
+	uint busy_max_us;
+	u64 exec_ns;		/* cpu time of the thread */
+	ulong nivcsw;		/* preempted while runnable */
+	int last_cpu;
+} dhd_thr_state_t;
+#endif /* DHD_THREAD_TUNE */
+
 /* Local private structure (extension of pub) */
 typedef struct dhd_info {
 #if defined(WL_WIRELESS_EXT)
@@ -335,7 +376,18 @@ typedef struct dhd_info {
 	tsk_ctl_t	thr_rxf_ctl;
 	spinlock_t	rxf_lock;
 #endif /* RXFRAME_THREAD */
+#ifdef DHD_THREAD_TUNE
+	dhd_thr_state_t	thr_state[DHD_THR_MAX];
+	int		oob_cpu;	/* OOB interrupt affinity, -1 for the default */
+#endif /* DHD_THREAD_TUNE */
 #endif /* DHDTHREAD */
+#ifdef DHD_NAPI
+	/* GRO receive, one NAPI context for all interfaces */
+	struct net_device napi_dev;
+	struct napi_struct napi;
+	struct sk_buff_head napi_q;
+	bool napi_on;
+#endif /* DHD_NAPI */
 	bool dhd_tasklet_create;
 	tsk_ctl_t	thr_sysioc_ctl;
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27))
@@ -358,12 +410,18 @@ typedef struct dhd_info {
 	struct mutex dhd_suspend_mutex;
 #endif
 	spinlock_t wakelock_spinlock;
+#ifdef DHD_TX_MQ
+	spinlock_t bql_lock;	/* BQL accounting of all interfaces */
+#endif /* DHD_TX_MQ */
 	uint32 wakelock_counter;
 	bool waive_wakelock;
 	uint32 wakelock_before_waive;
 	int wakelock_wd_counter;
 	int wakelock_rx_timeout_enable;
 	int wakelock_ctrl_timeout_enable;
+#ifdef DHD_RXWAKE_CLASS
+	unsigned long wakelock_rx_until;	/* jiffies the rx wakelock runs to */
+#endif /* DHD_RXWAKE_CLASS */
 
 	/* Thread to issue ioctl for multicast */
 	unsigned char set_macaddress;
@@ -490,6 +548,82 @@ int dhd_rxf_prio = CUSTOM_RXF_PRIO_SETTING;
 module_param(dhd_rxf_prio, int, 0);
 #endif /* RXFRAME_THREAD */
 
+#ifdef DHD_THREAD_TUNE
+/* CPU for the DPC, RXF and watchdog threads, -1 to leave it to the scheduler */
+#ifdef CUSTOM_DPC_CPUCORE
+int dhd_thr_cpu[DHD_THR_MAX] = { CUSTOM_DPC_CPUCORE, -1, -1 };
+#else
+int dhd_thr_cpu[DHD_THR_MAX] = { -1, -1, -1 };
+#endif /* CUSTOM_DPC_CPUCORE */
+module_param_array(dhd_thr_cpu, int, NULL, S_IRUGO | S_IWUSR);
+
+/* Scheduling policy of the same threads (SCHED_NORMAL, SCHED_FIFO or
+ * SCHED_RR), -1 for the one their priority parameter gives at start
+ */
+int dhd_thr_policy[DHD_THR_MAX] = { -1, -1, -1 };
+module_param_array(dhd_thr_policy, int, NULL, S_IRUGO | S_IWUSR);
+
+/* Real time priority for dhd_thr_policy, 0 to keep the priority parameter */
+int dhd_thr_rtprio[DHD_THR_MAX] = { 0, 0, 0 };
+module_param_array(dhd_thr_rtprio, int, NULL, S_IRUGO | S_IWUSR);
+
+/* Pin all three threads and the OOB interrupt to one CPU, -1 for off */
+int dhd_thr_pin_cpu = -1;
+module_param(dhd_thr_pin_cpu, int, S_IRUGO | S_IWUSR);
+#endif /* DHD_THREAD_TUNE */
+
+#ifdef DHD_NAPI
+/* Deliver received frames through NAPI/GRO instead of netif_rx */
+uint dhd_napi = TRUE;
+module_param(dhd_napi, uint, 0);
+
+/* Frames handed to the stack per NAPI poll */
+int dhd_napi_weight = 64;
+module_param(dhd_napi_weight, int, 0);
+#endif /* DHD_NAPI */
+
+#ifdef PNO_SUPPORT
+/* Scans the firmware batches up before reporting, when the caller gives none */
+uint dhd_pno_batch_mscan = DEFAULT_BATCH_MSCAN;
+module_param(dhd_pno_batch_mscan, uint, 0644);
+#endif /* PNO_SUPPORT */
+
+#ifdef DHD_RXWAKE_CLASS
+/* Rx wakelock timeout in ms per wake class: unicast, multicast, ARP, ICMP */
+uint dhd_rxwake_tout[DHD_RXWAKE_MAX] = {
+	DHD_PACKET_TIMEOUT_MS, 100, 200, 200
+};
+module_param_array(dhd_rxwake_tout, uint, NULL, 0644);
+
+/* Rx filters (1 << DHD_xxx_FILTER_NUM) taken down while suspended */
+uint dhd_rxwake_suspend_filters = (1 << DHD_MULTICAST4_FILTER_NUM) |
+	(1 << DHD_MULTICAST6_FILTER_NUM);
+module_param(dhd_rxwake_suspend_filters, uint, 0644);
+#endif /* DHD_RXWAKE_CLASS */
+
+#ifdef DHD_RXPOOL
+/* Receive skbs kept per cpu, "rx-skb-pool" in the bcm,bcm_wifi node wins */
+uint dhd_rxpool_size = 32;
+module_param(dhd_rxpool_size, uint, 0);
+
+static uint
+dhd_rxpool_get_size(void)
+{
+#ifdef CONFIG_OF
+	struct device_node *np;
+	u32 val;
+
+	np = of_find_compatible_node(NULL, NULL, "bcm,bcm_wifi");
+	if (np) {
+		if (!of_property_read_u32(np, "rx-skb-pool", &val))
+			dhd_rxpool_size = val;
+		of_node_put(np);
+	}
+#endif /* CONFIG_OF */
+	return dhd_rxpool_size;
+}
+#endif /* DHD_RXPOOL */
+
 /* DPC thread priority, -1 to use tasklet */
 extern int dhd_dongle_ramsize;
 module_param(dhd_dongle_ramsize, int, 0);
@@ -767,6 +901,33 @@ exit:
 }
 #endif /* PKT_FILTER_SUPPORT && !GAN_LITE_NAT_KEEPALIVE_FILTER */
 
+#if defined(DHD_RXWAKE_CLASS) && defined(PKT_FILTER_SUPPORT)
+/* Take the broadcast/multicast rx filters in dhd_rxwake_suspend_filters down
+ * for suspend so that traffic no longer wakes the host, and put back on
+ * resume the ones that were up.
+ */
+static void
+dhd_rxwake_set_filters(dhd_pub_t *dhd, bool suspend)
+{
+	struct net_device *net = dhd_idx2net(dhd, 0);
+	int num;
+
+	if (!net)
+		return;
+
+	for (num = DHD_BROADCAST_FILTER_NUM; num <= DHD_MULTICAST6_FILTER_NUM; num++) {
+		if (suspend) {
+			if (!(dhd_rxwake_suspend_filters & (1 << num)) ||
+			    !dhd->pktfilter[num])
+				continue;
+			net_os_rxfilter_add_remove(net, FALSE, num);
+			dhd->rxwake_filters |= 1 << num;
+		} else if (dhd->rxwake_filters & (1 << num)) {
+			net_os_rxfilter_add_remove(net, TRUE, num);
+		}
+	}
+}
+#endif /* DHD_RXWAKE_CLASS && PKT_FILTER_SUPPORT */
 
 void dhd_set_packet_filter(dhd_pub_t *dhd)
 {
@@ -846,6 +1007,9 @@ static int dhd_set_suspend(int value, dhd_pub_t *dhd)
 				                 sizeof(power_mode), TRUE, 0);
 #endif /* SUPPORT_PM2_ONLY */
 
+#if defined(DHD_RXWAKE_CLASS) && defined(PKT_FILTER_SUPPORT)
+				dhd_rxwake_set_filters(dhd, TRUE);
+#endif /* DHD_RXWAKE_CLASS && PKT_FILTER_SUPPORT */
 				/* Enable packet filter, only allow unicast packet to send up */
 				dhd_enable_packet_filter(1, dhd);
 
@@ -892,6 +1056,9 @@ static int dhd_set_suspend(int value, dhd_pub_t *dhd)
 #ifdef PKT_FILTER_SUPPORT
 				/* disable pkt filter */
 				dhd_enable_packet_filter(0, dhd);
+#ifdef DHD_RXWAKE_CLASS
+				dhd_rxwake_set_filters(dhd, FALSE);
+#endif /* DHD_RXWAKE_CLASS */
 #endif /* PKT_FILTER_SUPPORT */
 
 				/* restore pre-suspend setting for dtim_skip */
@@ -1309,12 +1476,16 @@ dhd_op_if(dhd_if_t *ifp)
 		if (ifp->net != NULL) {
 			DHD_ERROR(("%s: ERROR: netdev:%s already exists, try free & unregister \n",
 			 __FUNCTION__, ifp->net->name));
-			netif_stop_queue(ifp->net);
+			netif_tx_stop_all_queues(ifp->net);
 			unregister_netdev(ifp->net);
 			free_netdev(ifp->net);
 		}
 		/* Allocate etherdev, including space for private structure */
+#ifdef DHD_TX_MQ
+		if (!(ifp->net = alloc_etherdev_mq(sizeof(dhd), DHD_TX_QUEUES))) {
+#else
 		if (!(ifp->net = alloc_etherdev(sizeof(dhd)))) {
+#endif /* DHD_TX_MQ */
 			DHD_ERROR(("%s: OOM - alloc_etherdev(%d)\n", __FUNCTION__, sizeof(dhd)));
 			ret = -ENOMEM;
 		}
@@ -1360,7 +1531,7 @@ dhd_op_if(dhd_if_t *ifp)
 		ifp->state = DHD_IF_DELETING;
 		if (ifp->net != NULL) {
 			DHD_TRACE(("\n%s: got 'DHD_IF_DEL' state\n", __FUNCTION__));
-			netif_stop_queue(ifp->net);
+			netif_tx_stop_all_queues(ifp->net);
 #ifdef WL_CFG80211
 			if (dhd->dhd_state & DHD_ATTACH_STATE_CFG80211) {
 				wl_cfg80211_ifdel_ops(ifp->net);
@@ -1578,6 +1749,111 @@ uint8 prio2fifo[8] = { 1, 0, 0, 1, 2, 2, 3, 3 };
 #define WME_PRIO2AC(prio)	wme_fifo2ac[prio2fifo[(prio)]]
 
 #endif /* PROP_TXSTATUS */
+
+#ifdef DHD_TX_MQ
+/* Tx queue of each 802.1d priority, numbered as the wlfc fifos: BK, BE, VI, VO */
+static const uint8 dhd_prio2txq[8] = { 1, 0, 0, 1, 2, 2, 3, 3 };
+
+/* Kept in skb->cb past the pkttag from dhd_start_xmit until the packet is freed */
+typedef struct dhd_bql_tag {
+	uint32 magic;
+	uint32 gen;	/* bql_gen of the interface when the packet was queued */
+	uint32 len;
+} dhd_bql_tag_t;
+#define DHD_BQL_MAGIC		0xb91c0de5
+#define DHD_BQL_TAG(skb)	((dhd_bql_tag_t *)&((struct sk_buff *)(skb))->cb[OSL_PKTTAG_SZ])
+
+static u16
+dhd_select_queue(struct net_device *net, struct sk_buff *skb)
+{
+	/* the priority dhd_sendpkt would give it, so that the queue is its fifo */
+	if (skb->len < ETHER_HDR_LEN)
+		return dhd_prio2txq[0];
+#ifndef PKTPRIO_OVERRIDE
+	if (PKTPRIO(skb) == 0)
+#endif
+		pktsetprio(skb, FALSE);
+	return dhd_prio2txq[PKTPRIO(skb) & 7];
+}
+
+static void
+dhd_bql_sent(dhd_info_t *dhd, dhd_if_t *ifp, struct sk_buff *skb)
+{
+	dhd_bql_tag_t *tag = DHD_BQL_TAG(skb);
+	unsigned long flags;
+
+	spin_lock_irqsave(&dhd->bql_lock, flags);
+	tag->magic = DHD_BQL_MAGIC;
+	tag->gen = ifp->bql_gen;
+	tag->len = skb->len;
+	netdev_tx_sent_queue(netdev_get_tx_queue(ifp->net, skb_get_queue_mapping(skb)),
+		skb->len);
+	spin_unlock_irqrestore(&dhd->bql_lock, flags);
+}
+
+/* PKTFREESETCB callback: a packet dhd_start_xmit queued has left the driver */
+static void
+dhd_bql_txfree(void *ctx, void *pkt, unsigned int status)
+{
+	dhd_info_t *dhd = (dhd_info_t *)ctx;
+	struct sk_buff *skb = (struct sk_buff *)pkt;
+	dhd_bql_tag_t *tag = DHD_BQL_TAG(skb);
+	unsigned long flags;
+	int ifidx;
+
+	if (tag->magic != DHD_BQL_MAGIC)
+		return;
+	tag->magic = 0;
+
+	spin_lock_irqsave(&dhd->bql_lock, flags);
+	ifidx = dhd_net2idx(dhd, skb->dev);
+	if (ifidx != DHD_BAD_IF && dhd->iflist[ifidx]->bql_gen == tag->gen)
+		netdev_tx_completed_queue(netdev_get_tx_queue(skb->dev,
+			skb_get_queue_mapping(skb)), 1, tag->len);
+	spin_unlock_irqrestore(&dhd->bql_lock, flags);
+}
+
+/* Forget the packets in flight on an interface, they no longer complete */
+static void
+dhd_bql_reset(dhd_info_t *dhd, dhd_if_t *ifp)
+{
+	unsigned long flags;
+	int q;
+
+	spin_lock_irqsave(&dhd->bql_lock, flags);
+	ifp->bql_gen++;
+	for (q = 0; q < ifp->net->real_num_tx_queues; q++)
+		netdev_tx_reset_queue(netdev_get_tx_queue(ifp->net, q));
+	spin_unlock_irqrestore(&dhd->bql_lock, flags);
+}
+
+/* Wake the tx queues of an interface but those held by per AC flow control */
+static void
+dhd_tx_wake_queues(dhd_if_t *ifp)
+{
+	int q;
+
+	for (q = 0; q < ifp->net->real_num_tx_queues; q++) {
+		if (!(ifp->ac_fc & (1 << q)))
+			netif_wake_subqueue(ifp->net, q);
+	}
+}
+#endif /* DHD_TX_MQ */
+#if defined(DHD_TX_MQ) || defined(DHDTCPACK_SUPPRESS)
+/* PKTFREESETCB callback: a tx packet has been sent or dropped */
+static void
+dhd_txfree(void *ctx, void *pkt, unsigned int status)
+{
+	dhd_info_t *dhd = (dhd_info_t *)ctx;
+
+#ifdef DHDTCPACK_SUPPRESS
+	dhd_tcpack_check_xmit(&dhd->pub, pkt);
+#endif /* DHDTCPACK_SUPPRESS */
+#ifdef DHD_TX_MQ
+	dhd_bql_txfree(dhd, pkt, status);
+#endif /* DHD_TX_MQ */
+}
+#endif /* DHD_TX_MQ || DHDTCPACK_SUPPRESS */
 int
 dhd_sendpkt(dhd_pub_t *dhdp, int ifidx, void *pktbuf)
 {
@@ -1691,7 +1967,7 @@ dhd_start_xmit(struct sk_buff *skb, struct net_device *net)
 	if (dhd->pub.busstate == DHD_BUS_DOWN || dhd->pub.hang_was_sent) {
 		DHD_ERROR(("%s: xmit rejected pub.up=%d busstate=%d \n",
 			__FUNCTION__, dhd->pub.up, dhd->pub.busstate));
-		netif_stop_queue(net);
+		netif_tx_stop_all_queues(net);
 		/* Send Event when bus down detected during data session */
 		if (dhd->pub.up) {
 			DHD_ERROR(("%s: Event HANG sent up\n", __FUNCTION__));
@@ -1708,7 +1984,7 @@ dhd_start_xmit(struct sk_buff *skb, struct net_device *net)
 	ifidx = dhd_net2idx(dhd, net);
 	if (ifidx == DHD_BAD_IF) {
 		DHD_ERROR(("%s: bad ifidx %d\n", __FUNCTION__, ifidx));
-		netif_stop_queue(net);
+		netif_tx_stop_all_queues(net);
 		DHD_OS_WAKE_UNLOCK(&dhd->pub);
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 20))
 		return -ENODEV;
@@ -1772,6 +2048,9 @@ dhd_start_xmit(struct sk_buff *skb, struct net_device *net)
 	}
 #endif
 
+#ifdef DHD_TX_MQ
+	dhd_bql_sent(dhd, ifp, skb);
+#endif /* DHD_TX_MQ */
 	ret = dhd_sendpkt(&dhd->pub, ifidx, pktbuf);
 
 done:
@@ -1812,9 +2091,13 @@ dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool state)
 			if (dhd->iflist[i]) {
 				net = dhd->iflist[i]->net;
 				if (state == ON)
-					netif_stop_queue(net);
+					netif_tx_stop_all_queues(net);
 				else
-					netif_wake_queue(net);
+#ifdef DHD_TX_MQ
+					dhd_tx_wake_queues(dhd->iflist[i]);
+#else
+					netif_tx_wake_all_queues(net);
+#endif /* DHD_TX_MQ */
 			}
 		}
 	}
@@ -1822,13 +2105,42 @@ dhd_txflowcontrol(dhd_pub_t *dhdp, int ifidx, bool state)
 		if (dhd->iflist[ifidx]) {
 			net = dhd->iflist[ifidx]->net;
 			if (state == ON)
-				netif_stop_queue(net);
+				netif_tx_stop_all_queues(net);
 			else
-				netif_wake_queue(net);
+#ifdef DHD_TX_MQ
+				dhd_tx_wake_queues(dhd->iflist[ifidx]);
+#else
+				netif_tx_wake_all_queues(net);
+#endif /* DHD_TX_MQ */
 		}
 	}
 }
 
+#ifdef DHD_TX_MQ
+/* Flow control of one AC tx queue of an interface, the others keep going */
+void
+dhd_txflowcontrol_ac(dhd_pub_t *dhdp, int ifidx, int ac, bool state)
+{
+	dhd_info_t *dhd = dhdp->info;
+	dhd_if_t *ifp;
+
+	if (ifidx < 0 || ifidx >= DHD_MAX_IFS || ac >= DHD_TX_QUEUES)
+		return;
+	ifp = dhd->iflist[ifidx];
+	if (!ifp || !ifp->net)
+		return;
+
+	if (state == ON) {
+		ifp->ac_fc |= 1 << ac;
+		netif_stop_subqueue(ifp->net, ac);
+	} else {
+		ifp->ac_fc &= ~(1 << ac);
+		if (!dhdp->txoff)
+			netif_wake_subqueue(ifp->net, ac);
+	}
+}
+#endif /* DHD_TX_MQ */
+
 #ifdef DHD_RX_DUMP
 typedef struct {
 	uint16 type;
@@ -1859,6 +2171,79 @@ static const char *_get_packet_type_str(uint16 type)
 }
 #endif /* DHD_RX_DUMP */
 
+#ifdef DHD_NAPI
+static int
+dhd_napi_poll(struct napi_struct *napi, int budget)
+{
+	dhd_info_t *dhd = container_of(napi, dhd_info_t, napi);
+	struct sk_buff *skb;
+	int work = 0;
+
+	while (work < budget && (skb = skb_dequeue(&dhd->napi_q)) != NULL) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* frames queued after the queue ran dry found NAPI scheduled */
+		if (!skb_queue_empty(&dhd->napi_q))
+			napi_schedule(napi);
+	}
+
+	return work;
+}
+
+/* Hand a batch from dhd_rx_frame to NAPI */
+static void
+dhd_sched_napi(dhd_info_t *dhd, struct sk_buff_head *rxq)
+{
+	unsigned long flags;
+	uint32 dropped = 0;
+
+	spin_lock_irqsave(&dhd->napi_q.lock, flags);
+	/* same backlog limit as netif_rx */
+	if (skb_queue_len(&dhd->napi_q) + skb_queue_len(rxq) <= netdev_max_backlog)
+		skb_queue_splice_tail_init(rxq, &dhd->napi_q);
+	spin_unlock_irqrestore(&dhd->napi_q.lock, flags);
+
+	if (!skb_queue_empty(rxq)) {
+		dropped = skb_queue_len(rxq);
+		__skb_queue_purge(rxq);
+		dhd->pub.rx_dropped += dropped;
+	}
+
+	/* in the dpc thread the softirq runs on local_bh_enable */
+	local_bh_disable();
+	napi_schedule(&dhd->napi);
+	local_bh_enable();
+}
+#endif /* DHD_NAPI */
+
+#ifdef DHD_RXWAKE_CLASS
+/* Wake class of a frame eth_type_trans has been run on, data at the L3 header */
+static int
+dhd_rxwake_class(struct sk_buff *skb)
+{
+	switch (skb->protocol) {
+	case htons(ETH_P_ARP):
+		return DHD_RXWAKE_ARP;
+	case htons(ETH_P_IP):
+		if (skb->len >= sizeof(struct iphdr) &&
+		    ((struct iphdr *)skb->data)->protocol == IPPROTO_ICMP)
+			return DHD_RXWAKE_ICMP;
+		break;
+	case htons(ETH_P_IPV6):
+		if (skb->len >= sizeof(struct ipv6hdr) &&
+		    ((struct ipv6hdr *)skb->data)->nexthdr == IPPROTO_ICMPV6)
+			return DHD_RXWAKE_ICMP;
+		break;
+	}
+
+	return skb->pkt_type == PACKET_HOST ? DHD_RXWAKE_UCAST : DHD_RXWAKE_MCAST;
+}
+#endif /* DHD_RXWAKE_CLASS */
+
 void
 dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 {
@@ -1876,6 +2261,12 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	void *skbhead = NULL;
 	void *skbprev = NULL;
 #endif /* defined(DHDTHREAD) && defined(RXFRAME_THREAD) */
+#ifdef DHD_NAPI
+	struct sk_buff_head napiq;
+#endif /* DHD_NAPI */
+#ifdef DHD_RXWAKE_CLASS
+	int wake;
+#endif /* DHD_RXWAKE_CLASS */
 #if defined(DHD_RX_DUMP) || defined(DHD_8021X_DUMP)
 	char *dump_data;
 	uint16 protocol;
@@ -1883,6 +2274,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 
 	DHD_TRACE(("%s: Enter\n", __FUNCTION__));
 
+#ifdef DHD_NAPI
+	__skb_queue_head_init(&napiq);
+#endif /* DHD_NAPI */
+
 	for (i = 0; pktbuf && i < numpkt; i++, pktbuf = pnext) {
 		struct ether_header *eh;
 
@@ -2027,7 +2422,16 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			continue;
 #endif /* DHD_DONOT_FORWARD_BCMEVENT_AS_NETWORK_PKT */
 		} else {
+#ifdef DHD_RXWAKE_CLASS
+			/* the batch is held for its longest class */
+			wake = dhd_rxwake_class(skb);
+			if (dhdp->in_suspend)
+				dhdp->rxwake_cnt[wake]++;
+			if ((int)dhd_rxwake_tout[wake] > tout_rx)
+				tout_rx = dhd_rxwake_tout[wake];
+#else
 			tout_rx = DHD_PACKET_TIMEOUT_MS;
+#endif /* DHD_RXWAKE_CLASS */
 		}
 
 		ASSERT(ifidx < DHD_MAX_IFS && dhd->iflist[ifidx]);
@@ -2049,6 +2453,12 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 			}
 		}
 #endif /* DHD_TCP_WINSIZE_ADJUST */
+#ifdef DHD_NAPI
+		if (dhd->napi_on) {
+			__skb_queue_tail(&napiq, skb);
+			continue;
+		}
+#endif /* DHD_NAPI */
 		if (in_interrupt()) {
 			netif_rx(skb);
 		} else {
@@ -2081,6 +2491,10 @@ dhd_rx_frame(dhd_pub_t *dhdp, int ifidx, void *pktbuf, int numpkt, uint8 chan)
 	if (skbhead)
 		dhd_sched_rxf(dhdp, skbhead);
 #endif
+#ifdef DHD_NAPI
+	if (!skb_queue_empty(&napiq))
+		dhd_sched_napi(dhd, &napiq);
+#endif /* DHD_NAPI */
 	DHD_OS_WAKE_LOCK_RX_TIMEOUT_ENABLE(dhdp, tout_rx);
 	DHD_OS_WAKE_LOCK_CTRL_TIMEOUT_ENABLE(dhdp, tout_ctrl);
 }
@@ -2147,6 +2561,94 @@ dhd_get_stats(struct net_device *net)
 }
 
 #ifdef DHDTHREAD
+#ifdef DHD_THREAD_TUNE
+static void
+dhd_thr_tune(dhd_info_t *dhd, int thr, int prio)
+{
+	dhd_thr_state_t *st = &dhd->thr_state[thr];
+	int cpu = (dhd_thr_pin_cpu >= 0) ? dhd_thr_pin_cpu : dhd_thr_cpu[thr];
+	int policy = dhd_thr_policy[thr];
+	int rtprio = (dhd_thr_rtprio[thr] > 0) ? dhd_thr_rtprio[thr] : prio;
+	struct sched_param param;
+
+	if (cpu != st->cpu) {
+		st->cpu = cpu;
+		if (cpu < 0)
+			set_cpus_allowed_ptr(current, cpu_all_mask);
+		else if (cpu < nr_cpu_ids && cpu_online(cpu))
+			set_cpus_allowed_ptr(current, cpumask_of(cpu));
+		else
+			DHD_ERROR(("%s: thread %d, cpu %d not online\n", __FUNCTION__, thr, cpu));
+	}
+
+	if (policy != st->policy || rtprio != st->rtprio) {
+		st->policy = policy;
+		st->rtprio = rtprio;
+		/* -1 is the start up setting: real time at a positive priority */
+		if (policy < 0)
+			policy = (prio > 0) ? SCHED_FIFO : SCHED_NORMAL;
+		if (policy == SCHED_FIFO || policy == SCHED_RR) {
+			param.sched_priority = (rtprio > 0) ? MIN(rtprio, MAX_RT_PRIO - 1) : 1;
+		} else {
+			policy = SCHED_NORMAL;
+			param.sched_priority = 0;
+		}
+		setScheduler(current, policy, &param);
+	}
+
+	/* the DPC follows the OOB interrupt, so it moves the interrupt too */
+	if (thr == DHD_THR_DPC && dhd_thr_pin_cpu != dhd->oob_cpu) {
+		dhd->oob_cpu = dhd_thr_pin_cpu;
+#if defined(OOB_INTR_ONLY)
+		if (bcmsdh_oob_intr_set_affinity(dhd->oob_cpu))
+			DHD_ERROR(("%s: OOB interrupt not moved to cpu %d\n",
+				__FUNCTION__, dhd->oob_cpu));
+#endif /* OOB_INTR_ONLY */
+	}
+}
+
+static void
+dhd_thr_account(dhd_info_t *dhd, int thr, u64 start)
+{
+	dhd_thr_state_t *st = &dhd->thr_state[thr];
+	u64 ns = local_clock() - start;
+	uint us = (uint)div_u64(ns, NSEC_PER_USEC);
+
+	st->wakeups++;
+	st->busy_ns += ns;
+	if (us > st->busy_max_us)
+		st->busy_max_us = us;
+	st->exec_ns = current->se.sum_exec_runtime;
+	st->nivcsw = current->nivcsw;
+	st->last_cpu = raw_smp_processor_id();
+}
+
+void
+dhd_os_thread_stats(dhd_pub_t *dhdp, void *b)
+{
+	static const char *names[DHD_THR_MAX] = { "dpc", "rxf", "wdt" };
+	struct bcmstrbuf *strbuf = b;
+	dhd_info_t *dhd = dhdp->info;
+	dhd_thr_state_t *st;
+	int thr;
+
+	for (thr = 0; thr < DHD_THR_MAX; thr++) {
+		st = &dhd->thr_state[thr];
+		if (!st->wakeups)
+			continue;
+		bcm_bprintf(strbuf, "thread %s cpu %d last %d: wakeups %lu busy %llu us "
+			"max %u us exec %llu us preempted %lu\n", names[thr], st->cpu,
+			st->last_cpu, st->wakeups,
+			(unsigned long long)div_u64(st->busy_ns, NSEC_PER_USEC),
+			st->busy_max_us,
+			(unsigned long long)div_u64(st->exec_ns, NSEC_PER_USEC),
+			st->nivcsw);
+	}
+	bcm_bprintf(strbuf, "thread pin cpu %d oob irq cpu %d\n",
+		dhd_thr_pin_cpu, dhd->oob_cpu);
+}
+#endif /* DHD_THREAD_TUNE */
+
 static int
 dhd_watchdog_thread(void *data)
 {
@@ -2167,11 +2669,17 @@ dhd_watchdog_thread(void *data)
 			unsigned long flags;
 			unsigned long jiffies_at_start = jiffies;
 			unsigned long time_lapse;
+#ifdef DHD_THREAD_TUNE
+			u64 start = local_clock();
+#endif /* DHD_THREAD_TUNE */
 
 			SMP_RD_BARRIER_DEPENDS();
 			if (tsk->terminated) {
 				break;
 			}
+#ifdef DHD_THREAD_TUNE
+			dhd_thr_tune(dhd, DHD_THR_WDT, dhd_watchdog_prio);
+#endif /* DHD_THREAD_TUNE */
 
 			dhd_os_sdlock(&dhd->pub);
 			if (dhd->pub.dongle_reset == FALSE) {
@@ -2194,6 +2702,13 @@ dhd_watchdog_thread(void *data)
 				dhd_os_spin_unlock(&dhd->pub, flags);
 			}
 			dhd_os_sdunlock(&dhd->pub);
+#ifdef DHD_RXPOOL
+			/* top up the rx pool outside the dpc, where it may sleep */
+			osl_rxpool_refill(dhd->pub.osh);
+#endif /* DHD_RXPOOL */
+#ifdef DHD_THREAD_TUNE
+			dhd_thr_account(dhd, DHD_THR_WDT, start);
+#endif /* DHD_THREAD_TUNE */
 		} else {
 			break;
 	}
@@ -2273,13 +2788,22 @@ dhd_dpc_thread(void *data)
 	/* Run until signal received */
 	while (1) {
 		if (!binary_sema_down(tsk)) {
+#ifdef DHD_THREAD_TUNE
+			u64 start = local_clock();
+#endif /* DHD_THREAD_TUNE */
 #ifdef ENABLE_ADAPTIVE_SCHED
+#ifdef DHD_THREAD_TUNE
+			if (dhd_thr_policy[DHD_THR_DPC] < 0)
+#endif /* DHD_THREAD_TUNE */
 			dhd_sched_policy(dhd_dpc_prio);
 #endif /* ENABLE_ADAPTIVE_SCHED */
 			SMP_RD_BARRIER_DEPENDS();
 			if (tsk->terminated) {
 				break;
 			}
+#ifdef DHD_THREAD_TUNE
+			dhd_thr_tune(dhd, DHD_THR_DPC, dhd_dpc_prio);
+#endif /* DHD_THREAD_TUNE */
 
 			/* Call bus dpc unless it indicated down (then clean stop) */
 			if (dhd->pub.busstate != DHD_BUS_DOWN) {
@@ -2294,6 +2818,9 @@ dhd_dpc_thread(void *data)
 					dhd_bus_stop(dhd->pub.bus, TRUE);
 				DHD_OS_WAKE_UNLOCK(&dhd->pub);
 			}
+#ifdef DHD_THREAD_TUNE
+			dhd_thr_account(dhd, DHD_THR_DPC, start);
+#endif /* DHD_THREAD_TUNE */
 		}
 		else
 			break;
@@ -2336,7 +2863,13 @@ dhd_rxf_thread(void *data)
 #if LINUX_VERSION_CODE < KERNEL_VERSION(2, 6, 0)
 			ulong flags;
 #endif
+#ifdef DHD_THREAD_TUNE
+			u64 start = local_clock();
+#endif /* DHD_THREAD_TUNE */
 #ifdef ENABLE_ADAPTIVE_SCHED
+#ifdef DHD_THREAD_TUNE
+			if (dhd_thr_policy[DHD_THR_RXF] < 0)
+#endif /* DHD_THREAD_TUNE */
 			dhd_sched_policy(dhd_rxf_prio);
 #endif /* ENABLE_ADAPTIVE_SCHED */
 
@@ -2345,6 +2878,9 @@ dhd_rxf_thread(void *data)
 			if (tsk->terminated) {
 				break;
 			}
+#ifdef DHD_THREAD_TUNE
+			dhd_thr_tune(dhd, DHD_THR_RXF, dhd_rxf_prio);
+#endif /* DHD_THREAD_TUNE */
 			skb = dhd_rxf_dequeue(pub);
 
 			if (skb == NULL) {
@@ -2371,6 +2907,9 @@ dhd_rxf_thread(void *data)
 				watchdogTime = OSL_SYSUPTIME();
 			}
 #endif
+#ifdef DHD_THREAD_TUNE
+			dhd_thr_account(dhd, DHD_THR_RXF, start);
+#endif /* DHD_THREAD_TUNE */
 			DHD_OS_WAKE_UNLOCK(pub);
 		}
 		else
@@ -2974,7 +3513,11 @@ dhd_stop(struct net_device *net)
 	BCM_REFERENCE(ifidx);
 
 	/* Set state and stop OS transmissions */
-	netif_stop_queue(net);
+	netif_tx_stop_all_queues(net);
+#ifdef DHD_TX_MQ
+	if (ifidx != DHD_BAD_IF && dhd->iflist[ifidx])
+		dhd_bql_reset(dhd, dhd->iflist[ifidx]);
+#endif /* DHD_TX_MQ */
 	dhd->pub.up = 0;
 
 #ifdef WL_CFG80211
@@ -3125,7 +3668,11 @@ dhd_open(struct net_device *net)
 	}
 
 	/* Allow transmit calls */
-	netif_start_queue(net);
+#ifdef DHD_TX_MQ
+	if (ifidx != DHD_BAD_IF && dhd->iflist[ifidx])
+		dhd->iflist[ifidx]->ac_fc = 0;
+#endif /* DHD_TX_MQ */
+	netif_tx_start_all_queues(net);
 	dhd->pub.up = 1;
 
 #ifdef BCMDBGFS
@@ -3206,7 +3753,7 @@ dhd_add_if(dhd_info_t *dhd, int ifidx, void *handle, char *name,
 	ifp = dhd->iflist[ifidx];
 	if (ifp != NULL) {
 		if (ifp->net != NULL) {
-			netif_stop_queue(ifp->net);
+			netif_tx_stop_all_queues(ifp->net);
 			unregister_netdev(ifp->net);
 			free_netdev(ifp->net);
 		}
@@ -3270,6 +3817,9 @@ static struct net_device_ops dhd_ops_pri = {
 	.ndo_get_stats = dhd_get_stats,
 	.ndo_do_ioctl = dhd_ioctl_entry,
 	.ndo_start_xmit = dhd_start_xmit,
+#ifdef DHD_TX_MQ
+	.ndo_select_queue = dhd_select_queue,
+#endif /* DHD_TX_MQ */
 	.ndo_set_mac_address = dhd_set_mac_address,
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 2, 0))
 	.ndo_set_rx_mode = dhd_set_multicast_list,
@@ -3282,6 +3832,9 @@ static struct net_device_ops dhd_ops_virt = {
 	.ndo_get_stats = dhd_get_stats,
 	.ndo_do_ioctl = dhd_ioctl_entry,
 	.ndo_start_xmit = dhd_start_xmit,
+#ifdef DHD_TX_MQ
+	.ndo_select_queue = dhd_select_queue,
+#endif /* DHD_TX_MQ */
 	.ndo_set_mac_address = dhd_set_mac_address,
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 2, 0))
 	.ndo_set_rx_mode = dhd_set_multicast_list,
@@ -3311,7 +3864,11 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	}
 
 	/* Allocate etherdev, including space for private structure */
+#ifdef DHD_TX_MQ
+	if (!(net = alloc_etherdev_mq(sizeof(dhd), DHD_TX_QUEUES))) {
+#else
 	if (!(net = alloc_etherdev(sizeof(dhd)))) {
+#endif /* DHD_TX_MQ */
 		DHD_ERROR(("%s: OOM - alloc_etherdev\n", __FUNCTION__));
 		goto fail;
 	}
@@ -3409,6 +3966,15 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 
 	/* Initialize Wakelock stuff */
 	spin_lock_init(&dhd->wakelock_spinlock);
+#ifdef DHD_TX_MQ
+	spin_lock_init(&dhd->bql_lock);
+#endif /* DHD_TX_MQ */
+#if defined(DHD_TX_MQ) || defined(DHDTCPACK_SUPPRESS)
+	/* every tx packet is freed with PKTFREE(osh, p, TRUE), completing it for BQL
+	 * and taking it out of the TCP ACK suppression table
+	 */
+	PKTFREESETCB(osh, dhd_txfree, dhd);
+#endif /* DHD_TX_MQ || DHDTCPACK_SUPPRESS */
 	dhd->wakelock_counter = 0;
 	dhd->wakelock_wd_counter = 0;
 	dhd->wakelock_rx_timeout_enable = 0;
@@ -3454,15 +4020,50 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 #endif /* defined(WL_WIRELESS_EXT) */
 
 
-	/* Set up the watchdog timer */
-	init_timer(&dhd->timer);
+	/* Set up the watchdog timer, deferrable: the dongle interrupts
+	 * wake the host for anything urgent
+	 */
+	init_timer_deferrable(&dhd->timer);
 	dhd->timer.data = (ulong)dhd;
 	dhd->timer.function = dhd_watchdog;
 	dhd->default_wd_interval = dhd_watchdog_ms;
 
+#ifdef DHD_RXPOOL
+	if (osl_rxpool_init(osh, dhd_rxpool_get_size(), PKTBUFSZ))
+		DHD_ERROR(("%s: rx skb pool not allocated\n", __FUNCTION__));
+#endif /* DHD_RXPOOL */
+
+#ifdef DHD_NAPI
+	skb_queue_head_init(&dhd->napi_q);
+	if (dhd_napi) {
+		init_dummy_netdev(&dhd->napi_dev);
+		netif_napi_add(&dhd->napi_dev, &dhd->napi, dhd_napi_poll,
+			dhd_napi_weight);
+		napi_enable(&dhd->napi);
+		dhd->napi_on = TRUE;
+	}
+#endif /* DHD_NAPI */
+
 #ifdef DHDTHREAD
 	/* Initialize thread based operation and lock */
 	sema_init(&dhd->sdsem, 1);
+#ifdef DHD_THREAD_TUNE
+	{
+		int thr;
+
+		/* the threads start as their priority parameters say */
+		for (thr = 0; thr < DHD_THR_MAX; thr++) {
+			dhd->thr_state[thr].cpu = DHD_THR_CPU_UNSET;
+			dhd->thr_state[thr].policy = -1;
+		}
+		dhd->thr_state[DHD_THR_DPC].rtprio = dhd_dpc_prio;
+#ifdef RXFRAME_THREAD
+		dhd->thr_state[DHD_THR_RXF].rtprio = dhd_rxf_prio;
+#endif /* RXFRAME_THREAD */
+		dhd->thr_state[DHD_THR_WDT].rtprio = dhd_watchdog_prio;
+		dhd->oob_cpu = -1;
+	}
+#endif /* DHD_THREAD_TUNE */
 	if ((dhd_watchdog_prio >= 0) && (dhd_dpc_prio >= 0)) {
 		dhd->threads_only = TRUE;
 	}
@@ -3489,6 +4090,12 @@ dhd_attach(osl_t *osh, struct dhd_bus *bus, uint bus_hdrlen)
 	}
 #ifdef RXFRAME_THREAD
 	bzero(&dhd->pub.skbbuf[0], sizeof(void *) * MAXSKBPEND);
+#ifdef DHD_NAPI
+	/* NAPI takes the frames, no RXF thread */
+	if (dhd->napi_on)
+		dhd->thr_rxf_ctl.thr_pid = -1;
+	else
+#endif /* DHD_NAPI */
 	/* Initialize RXF thread */
 	PROC_START(dhd_rxf_thread, dhd, &dhd->thr_rxf_ctl, 0, "dhd_rxf");
 #endif
@@ -3564,6 +4171,9 @@ dhd_bus_start(dhd_pub_t *dhdp)
 	int ret = -1;
 	dhd_info_t *dhd = (dhd_info_t*)dhdp->info;
 	unsigned long flags;
+#ifdef DHD_FWDL_FAST
+	uint32 stage;
+#endif /* DHD_FWDL_FAST */
 
 	ASSERT(dhd);
 
@@ -3574,6 +4184,9 @@ dhd_bus_start(dhd_pub_t *dhdp)
 		dhd_os_sdlock(dhdp);
 #endif /* DHDTHREAD */
 
+#ifdef DHD_FWDL_FAST
+	bzero(dhdp->ton_ms, sizeof(dhdp->ton_ms));
+#endif /* DHD_FWDL_FAST */
 
 	/* try to download image and nvram to the dongle */
 	if  ((dhd->pub.busstate == DHD_BUS_DOWN) &&
@@ -3615,6 +4228,9 @@ dhd_bus_start(dhd_pub_t *dhdp)
 	dhd_os_wd_timer(&dhd->pub, dhd_watchdog_ms);
 
 	/* Bring up the bus */
+#ifdef DHD_FWDL_FAST
+	stage = OSL_SYSUPTIME();
+#endif /* DHD_FWDL_FAST */
 	if ((ret = dhd_bus_init(&dhd->pub, FALSE)) != 0) {
 
 		DHD_ERROR(("%s, dhd_bus_init failed %d\n", __FUNCTION__, ret));
@@ -3646,6 +4262,9 @@ dhd_bus_start(dhd_pub_t *dhdp)
 	/* Enable oob at firmware */
 	dhd_enable_oob_intr(dhd->pub.bus, TRUE);
 #endif 
+#ifdef DHD_FWDL_FAST
+	dhdp->ton_ms[DHD_TON_BUSINIT] = OSL_SYSUPTIME() - stage;
+#endif /* DHD_FWDL_FAST */
 
 	/* If bus is not ready, can't come up */
 	if (dhd->pub.busstate != DHD_BUS_DATA) {
@@ -3670,8 +4289,17 @@ dhd_bus_start(dhd_pub_t *dhdp)
 	dhd_process_cid_mac(dhdp, TRUE);
 
 	/* Bus is ready, do any protocol initialization */
+#ifdef DHD_FWDL_FAST
+	stage = OSL_SYSUPTIME();
+#endif /* DHD_FWDL_FAST */
 	if ((ret = dhd_prot_init(&dhd->pub)) < 0)
 		return ret;
+#ifdef DHD_FWDL_FAST
+	dhdp->ton_ms[DHD_TON_PROTINIT] = OSL_SYSUPTIME() - stage;
+	DHD_ERROR(("%s: turn on firmware %u nvram %u bus %u dongle %u ms\n", __FUNCTION__,
+		dhdp->ton_ms[DHD_TON_FW], dhdp->ton_ms[DHD_TON_NVRAM],
+		dhdp->ton_ms[DHD_TON_BUSINIT], dhdp->ton_ms[DHD_TON_PROTINIT]));
+#endif /* DHD_FWDL_FAST */
 
 	dhd_process_cid_mac(dhdp, FALSE);
 	dhd_process_cid_mac(dhdp, TRUE);
@@ -4764,6 +5392,8 @@ dhd_net_attach(dhd_pub_t *dhdp, int ifidx)
 	}
 
 	net->hard_header_len = ETH_HLEN + dhd->pub.hdrlen;
+	/* room to align the frame for SDIO DMA without reallocating it */
+	net->needed_headroom = DHD_SDALIGN;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24)
 	net->ethtool_ops = &dhd_ethtool_ops;
 #endif /* LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 24) */
@@ -4861,6 +5491,9 @@ void dhd_detach(dhd_pub_t *dhdp)
 	unregister_inetaddr_notifier(&dhd_notifier);
 #endif /* ARP_OFFLOAD_SUPPORT */
 	unregister_inet6addr_notifier(&dhd_notifier_ipv6);
+#if defined(DHD_TX_MQ) || defined(DHDTCPACK_SUPPRESS)
+	PKTFREESETCB(dhdp->osh, NULL, NULL);
+#endif /* DHD_TX_MQ || DHDTCPACK_SUPPRESS */
 
 	dhd->pub.up = 0;
 	if (!(dhd->dhd_state & DHD_ATTACH_STATE_DONE)) {
@@ -4959,6 +5592,15 @@ void dhd_detach(dhd_pub_t *dhdp)
 		else
 #endif /* DHDTHREAD */
 		tasklet_kill(&dhd->tasklet);
+#ifdef DHD_NAPI
+		/* nothing schedules NAPI once the dpc is stopped */
+		if (dhd->napi_on) {
+			napi_disable(&dhd->napi);
+			netif_napi_del(&dhd->napi);
+			dhd->napi_on = FALSE;
+		}
+		skb_queue_purge(&dhd->napi_q);
+#endif /* DHD_NAPI */
 	}
 #ifdef WL_CFG80211
 	if (dhd->dhd_state & DHD_ATTACH_STATE_CFG80211) {
@@ -4989,6 +5631,10 @@ void dhd_detach(dhd_pub_t *dhdp)
 		wake_lock_destroy(&dhd->wl_wdwake);
 #endif /* CONFIG_HAS_WAKELOCK */
 	}
+
+#ifdef DHD_RXPOOL
+	osl_rxpool_cleanup(dhdp->osh);
+#endif /* DHD_RXPOOL */
 }
 
 
@@ -5338,10 +5984,106 @@ dhd_os_wd_timer(void *bus, uint wdtick)
 	dhd_os_spin_unlock(pub, flags);
 }
 
+#ifdef DHD_FWDL_FAST
+/* Images may be gzip compressed, they are inflated as they are read */
+#define DHD_IMAGE_ZBUF	4096
+
+#define GZ_FHCRC	0x02
+#define GZ_FEXTRA	0x04
+#define GZ_FNAME	0x08
+#define GZ_FCOMMENT	0x10
+
+typedef struct dhd_image {
+	struct file *fp;
+	bool gz;
+	bool gz_end;
+	z_stream zs;
+	uint8 *zbuf;		/* compressed input */
+} dhd_image_t;
+
+static int
+dhd_os_image_read(struct file *fp, char *buf, int len)
+{
+	int rdlen = kernel_read(fp, fp->f_pos, buf, len);
+
+	if (rdlen > 0)
+		fp->f_pos += rdlen;
+	return rdlen;
+}
+
+/* Length of the gzip header at the start of buf, 0 if it is not one */
+static int
+dhd_os_image_gzhdr(uint8 *buf, int len)
+{
+	int pos = 10;
+	uint8 flags;
+
+	/* deflate is the only method */
+	if (len < pos || buf[0] != 0x1f || buf[1] != 0x8b || buf[2] != 8)
+		return 0;
+	flags = buf[3];
+	if (flags & GZ_FEXTRA) {
+		if (pos + 2 > len)
+			return 0;
+		pos += 2 + (buf[pos] | (buf[pos + 1] << 8));
+	}
+	if (flags & GZ_FNAME) {
+		while (pos < len && buf[pos])
+			pos++;
+		pos++;
+	}
+	if (flags & GZ_FCOMMENT) {
+		while (pos < len && buf[pos])
+			pos++;
+		pos++;
+	}
+	if (flags & GZ_FHCRC)
+		pos += 2;
+
+	return (pos < len) ? pos : 0;
+}
+
+static int
+dhd_os_image_gzopen(dhd_image_t *img)
+{
+	int rdlen, hdr;
+
+	img->zbuf = kmalloc(DHD_IMAGE_ZBUF, GFP_KERNEL);
+	if (!img->zbuf)
+		return -ENOMEM;
+
+	rdlen = dhd_os_image_read(img->fp, img->zbuf, DHD_IMAGE_ZBUF);
+	hdr = dhd_os_image_gzhdr(img->zbuf, rdlen);
+	if (!hdr) {
+		/* not compressed, read it from the start */
+		img->fp->f_pos = 0;
+		return 0;
+	}
+
+	img->zs.workspace = vmalloc(zlib_inflate_workspacesize());
+	if (!img->zs.workspace)
+		return -ENOMEM;
+	/* raw deflate, the gzip header is already skipped */
+	if (zlib_inflateInit2(&img->zs, -MAX_WBITS) != Z_OK) {
+		vfree(img->zs.workspace);
+		img->zs.workspace = NULL;
+		return -EINVAL;
+	}
+	img->zs.next_in = img->zbuf + hdr;
+	img->zs.avail_in = rdlen - hdr;
+	img->gz = TRUE;
+
+	return 0;
+}
+#endif /* DHD_FWDL_FAST */
+
 void *
 dhd_os_open_image(char *filename)
 {
 	struct file *fp;
+#ifdef DHD_FWDL_FAST
+	dhd_image_t *img;
+#endif /* DHD_FWDL_FAST */
 
 	fp = filp_open(filename, O_RDONLY, 0);
 	/*
@@ -5353,12 +6095,67 @@ dhd_os_open_image(char *filename)
 	 if (IS_ERR(fp))
 		 fp = NULL;
 
+#ifdef DHD_FWDL_FAST
+	if (!fp)
+		return NULL;
+
+	img = kzalloc(sizeof(*img), GFP_KERNEL);
+	if (!img) {
+		filp_close(fp, NULL);
+		return NULL;
+	}
+	img->fp = fp;
+	if (dhd_os_image_gzopen(img)) {
+		DHD_ERROR(("%s: cannot inflate %s\n", __FUNCTION__, filename));
+		dhd_os_close_image(img);
+		return NULL;
+	}
+	if (img->gz)
+		DHD_INFO(("%s: %s is gzip compressed\n", __FUNCTION__, filename));
+
+	return img;
+#else
 	 return fp;
+#endif /* DHD_FWDL_FAST */
 }
 
 int
 dhd_os_get_image_block(char *buf, int len, void *image)
 {
+#ifdef DHD_FWDL_FAST
+	dhd_image_t *img = (dhd_image_t *)image;
+	int rdlen, ret;
+
+	if (!image)
+		return 0;
+
+	if (!img->gz)
+		return dhd_os_image_read(img->fp, buf, len);
+
+	/* fill the block unless the stream ends, callers expect full blocks */
+	img->zs.next_out = (uint8 *)buf;
+	img->zs.avail_out = len;
+	while (img->zs.avail_out && !img->gz_end) {
+		if (!img->zs.avail_in) {
+			rdlen = dhd_os_image_read(img->fp, img->zbuf, DHD_IMAGE_ZBUF);
+			if (rdlen <= 0) {
+				DHD_ERROR(("%s: compressed image truncated\n", __FUNCTION__));
+				return -EIO;
+			}
+			img->zs.next_in = img->zbuf;
+			img->zs.avail_in = rdlen;
+		}
+		ret = zlib_inflate(&img->zs, Z_SYNC_FLUSH);
+		if (ret == Z_STREAM_END)
+			img->gz_end = TRUE;
+		else if (ret != Z_OK) {
+			DHD_ERROR(("%s: inflate failed %d\n", __FUNCTION__, ret));
+			return -EIO;
+		}
+	}
+
+	return len - img->zs.avail_out;
+#else
 	struct file *fp = (struct file *)image;
 	int rdlen;
 
@@ -5370,13 +6167,28 @@ dhd_os_get_image_block(char *buf, int len, void *image)
 		fp->f_pos += rdlen;
 
 	return rdlen;
+#endif /* DHD_FWDL_FAST */
 }
 
 void
 dhd_os_close_image(void *image)
 {
+#ifdef DHD_FWDL_FAST
+	dhd_image_t *img = (dhd_image_t *)image;
+
+	if (!image)
+		return;
+	if (img->gz)
+		zlib_inflateEnd(&img->zs);
+	if (img->zs.workspace)
+		vfree(img->zs.workspace);
+	kfree(img->zbuf);
+	filp_close(img->fp, NULL);
+	kfree(img);
+#else
 	if (image)
 		filp_close((struct file *)image, NULL);
+#endif /* DHD_FWDL_FAST */
 }
 
 
@@ -5709,6 +6521,10 @@ int net_os_rxfilter_add_remove(struct net_device *dev, int add_remove, int num)
 		return ret;
 	if (num >= dhd->pub.pktfilter_count)
 		return -EINVAL;
+#ifdef DHD_RXWAKE_CLASS
+	/* an explicit add or remove overrides what suspend took down */
+	dhd->pub.rxwake_filters &= ~(1 << num);
+#endif /* DHD_RXWAKE_CLASS */
 	switch (num) {
 		case DHD_BROADCAST_FILTER_NUM:
 			filterp = "101 0 0 0 0xFFFFFFFFFFFF 0xFFFFFFFFFFFF";
@@ -5842,6 +6658,13 @@ dhd_dev_pno_get_for_batch(struct net_device *dev, char *buf, int bufsize)
 	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
 	return (dhd_pno_get_for_batch(&dhd->pub, buf, bufsize, PNO_STATUS_NORMAL));
 }
+/* Linux wrapper to call common dhd_pno_set_batch_cb */
+int
+dhd_dev_pno_set_batch_cb(struct net_device *dev, dhd_pno_batch_cb_t cb)
+{
+	dhd_info_t *dhd = *(dhd_info_t **)netdev_priv(dev);
+	return (dhd_pno_set_batch_cb(&dhd->pub, dev, cb));
+}
 #endif /* PNO_SUPPORT */
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(2, 6, 27)) && (1)
@@ -6069,9 +6892,24 @@ int dhd_os_wake_lock_timeout(dhd_pub_t *pub)
 		ret = dhd->wakelock_rx_timeout_enable > dhd->wakelock_ctrl_timeout_enable ?
 			dhd->wakelock_rx_timeout_enable : dhd->wakelock_ctrl_timeout_enable;
 #ifdef CONFIG_HAS_WAKELOCK
+#ifdef DHD_RXWAKE_CLASS
+		/* a short class arriving under a longer hold does not cut it short */
+		if (dhd->wakelock_rx_timeout_enable) {
+			unsigned long until = jiffies +
+				msecs_to_jiffies(dhd->wakelock_rx_timeout_enable);
+
+			if (!wake_lock_active(&dhd->wl_rxwake) ||
+			    time_after(until, dhd->wakelock_rx_until)) {
+				wake_lock_timeout(&dhd->wl_rxwake,
+					msecs_to_jiffies(dhd->wakelock_rx_timeout_enable));
+				dhd->wakelock_rx_until = until;
+			}
+		}
+#else
 		if (dhd->wakelock_rx_timeout_enable)
 			wake_lock_timeout(&dhd->wl_rxwake,
 				msecs_to_jiffies(dhd->wakelock_rx_timeout_enable));
+#endif /* DHD_RXWAKE_CLASS */
 		if (dhd->wakelock_ctrl_timeout_enable)
 			wake_lock_timeout(&dhd->wl_ctrlwake,
 				msecs_to_jiffies(dhd->wakelock_ctrl_timeout_enable));
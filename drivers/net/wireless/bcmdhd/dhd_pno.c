@@ -1010,7 +1010,7 @@ dhd_pno_set_for_batch(dhd_pub_t *dhd, struct dhd_pno_batch_params *batch_params)
 	_params->params_batch.scan_fr = batch_params->scan_fr;
 	_params->params_batch.bestn = batch_params->bestn;
 	_params->params_batch.mscan = (batch_params->mscan)?
-		batch_params->mscan : DEFAULT_BATCH_MSCAN;
+		batch_params->mscan : MIN(dhd_pno_batch_mscan, MSCAN_MAX);
 	_params->params_batch.nchan = batch_params->nchan;
 	memcpy(_params->params_batch.chan_list, batch_params->chan_list,
 		sizeof(_params->params_batch.chan_list));
@@ -1130,6 +1130,39 @@ exit:
 	return err;
 }
 
+/* Copy the networks of one fetch into a flat array for the batch consumer */
+static dhd_pno_batch_bss_t *
+_dhd_pno_flatten_batch(dhd_pub_t *dhd, dhd_pno_scan_results_t *pscan_results, int *count)
+{
+	dhd_pno_best_header_t *phead;
+	dhd_pno_bestnet_entry_t *iter;
+	dhd_pno_batch_bss_t *bss;
+	int n = 0;
+
+	*count = 0;
+	for (phead = pscan_results->bestnetheader; phead; phead = phead->next)
+		n += phead->tot_cnt;
+	if (n == 0)
+		return NULL;
+	bss = (dhd_pno_batch_bss_t *)MALLOC(dhd->osh, n * sizeof(*bss));
+	if (bss == NULL) {
+		DHD_ERROR(("%s : failed to allocate %d batch entries\n", __FUNCTION__, n));
+		return NULL;
+	}
+	for (phead = pscan_results->bestnetheader; phead; phead = phead->next) {
+		list_for_each_entry(iter, &phead->entry_list, list) {
+			memcpy(&bss[*count].BSSID, &iter->BSSID, ETHER_ADDR_LEN);
+			bss[*count].SSID_len = iter->SSID_len;
+			memcpy(bss[*count].SSID, iter->SSID, iter->SSID_len);
+			bss[*count].RSSI = iter->RSSI;
+			bss[*count].channel = iter->channel;
+			bss[*count].timestamp = iter->timestamp;
+			(*count)++;
+		}
+	}
+	return bss;
+}
+
 static int
 _dhd_pno_get_for_batch(dhd_pub_t *dhd, char *buf, int bufsize, int reason)
 {
@@ -1144,6 +1177,10 @@ _dhd_pno_get_for_batch(dhd_pub_t *dhd, char *buf, int bufsize, int reason)
 	dhd_pno_best_header_t *pbestnetheader = NULL;
 	dhd_pno_scan_results_t *pscan_results = NULL, *siter, *snext;
 	bool allocate_header = FALSE;
+	dhd_pno_batch_bss_t *batch_bss = NULL;
+	dhd_pno_batch_cb_t batch_cb = NULL;
+	struct net_device *batch_dev = NULL;
+	int batch_cnt = 0;
 	NULL_CHECK(dhd, "dhd is NULL", err);
 	NULL_CHECK(dhd->pno_state, "pno_state is NULL", err);
 	if (!dhd_support_sta_mode(dhd)) {
@@ -1326,6 +1363,12 @@ _dhd_pno_get_for_batch(dhd_pub_t *dhd, char *buf, int bufsize, int reason)
 			plnetinfo++;
 		}
 	}
+	/* a batch the firmware reported goes to the binary consumer as is */
+	if (!buf && _pno_state->batch_cb && pscan_results->cnt_header) {
+		batch_bss = _dhd_pno_flatten_batch(dhd, pscan_results, &batch_cnt);
+		batch_cb = _pno_state->batch_cb;
+		batch_dev = _pno_state->batch_dev;
+	}
 	if (pscan_results->cnt_header == 0) {
 		/* In case that we didn't get any data from the firmware
 		 * Remove the current scan_result list from get_bach.scan_results_list.
@@ -1371,6 +1414,10 @@ exit:
 	mutex_unlock(&_pno_state->pno_mutex);
 	if (waitqueue_active(&_pno_state->get_batch_done.wait))
 		complete(&_pno_state->get_batch_done);
+	if (batch_bss) {
+		batch_cb(batch_dev, batch_bss, batch_cnt);
+		MFREE(dhd->osh, batch_bss, batch_cnt * sizeof(*batch_bss));
+	}
 	return err;
 }
 static void
@@ -1433,6 +1480,22 @@ exit:
 	return err;
 }
 
+int
+dhd_pno_set_batch_cb(dhd_pub_t *dhd, struct net_device *dev, dhd_pno_batch_cb_t cb)
+{
+	int err = BCME_OK;
+	dhd_pno_status_info_t *_pno_state;
+	NULL_CHECK(dhd, "dhd is NULL", err);
+	NULL_CHECK(dhd->pno_state, "pno_state is NULL", err);
+	DHD_PNO(("%s enter\n", __FUNCTION__));
+	_pno_state = PNO_GET_PNOSTATE(dhd);
+	mutex_lock(&_pno_state->pno_mutex);
+	_pno_state->batch_cb = cb;
+	_pno_state->batch_dev = dev;
+	mutex_unlock(&_pno_state->pno_mutex);
+	return err;
+}
+
 int
 dhd_pno_stop_for_batch(dhd_pub_t *dhd)
 {
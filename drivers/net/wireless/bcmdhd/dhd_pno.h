@@ -144,6 +144,22 @@ typedef struct dhd_pno_scan_results {
 } dhd_pno_scan_results_t;
 #define SCAN_RESULTS_SIZE (sizeof(dhd_pno_scan_results_t))
 
+/* One best network of a batch, in the flat array handed to the batch consumer */
+typedef struct dhd_pno_batch_bss {
+	struct ether_addr BSSID;
+	uint8	SSID_len;
+	uint8	SSID[DOT11_MAX_SSID_LEN];
+	int8	RSSI;
+	uint8	channel;
+	uint32	timestamp;
+} dhd_pno_batch_bss_t;
+
+/* Called from the batch work, without pno_mutex, for every batch the firmware
+ * reports with WLC_E_PFN_BEST_BATCHING
+ */
+typedef void (*dhd_pno_batch_cb_t)(struct net_device *dev, dhd_pno_batch_bss_t *bss,
+	int count);
+
 struct dhd_pno_get_batch_info {
 	/* info related to get batch */
 	char *buf;
@@ -199,8 +215,13 @@ typedef struct dhd_pno_status_info {
 	enum dhd_pno_mode pno_mode;
 	dhd_pno_params_t pno_params_arr[INDEX_MODE_MAX];
 	struct list_head head_list;
+	dhd_pno_batch_cb_t batch_cb;	/* binary consumer of batches, under pno_mutex */
+	struct net_device *batch_dev;
 } dhd_pno_status_info_t;
 
+/* scans the firmware keeps before WLC_E_PFN_BEST_BATCHING when none is asked for */
+extern uint dhd_pno_batch_mscan;
+
 /* wrapper functions */
 extern int
 dhd_dev_pno_enable(struct net_device *dev, int enable);
@@ -222,6 +243,9 @@ dhd_dev_pno_get_for_batch(struct net_device *dev, char *buf, int bufsize);
 extern int
 dhd_dev_pno_stop_for_batch(struct net_device *dev);
 
+extern int
+dhd_dev_pno_set_batch_cb(struct net_device *dev, dhd_pno_batch_cb_t cb);
+
 extern int
 dhd_dev_pno_set_for_hotlist(struct net_device *dev, wl_pfn_bssid_t *p_pfn_bssid,
 	struct dhd_pno_hotlist_params *hotlist_params);
@@ -239,6 +263,9 @@ extern int dhd_pno_get_for_batch(dhd_pub_t *dhd, char *buf, int bufsize, int rea
 
 extern int dhd_pno_stop_for_batch(dhd_pub_t *dhd);
 
+extern int dhd_pno_set_batch_cb(dhd_pub_t *dhd, struct net_device *dev,
+	dhd_pno_batch_cb_t cb);
+
 extern int dhd_pno_set_for_hotlist(dhd_pub_t *dhd, wl_pfn_bssid_t *p_pfn_bssid,
 	struct dhd_pno_hotlist_params *hotlist_params);
 
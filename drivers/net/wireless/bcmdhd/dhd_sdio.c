@@ -92,6 +92,9 @@ extern bool  bcmsdh_fatal_error(void *sdh);
 #define DHD_TXMINMAX	1	/* Max tx frames if rx still pending */
 
 #define MEMBLOCK	2048		/* Block size used for downloading of dongle image */
+#ifdef DHD_FWDL_FAST
+#define FWDL_MEMBLOCK	(16 * 1024)	/* Larger CMD53s for the image, MEMBLOCK as fallback */
+#endif /* DHD_FWDL_FAST */
 #define MAX_NVRAMBUF_SIZE	4096	/* max nvram buf size */
 #define MAX_DATA_BUF	(32 * 1024)	/* Must be large enough to hold biggest possible glom */
 
@@ -1522,6 +1525,13 @@ dhd_enable_oob_intr(struct dhd_bus *bus, bool enable)
 #ifdef DHDTCPACK_SUPPRESS
 extern bool dhd_use_tcpack_suppress;
 
+#define TCPACK_TCP_HDRLEN_MIN	20
+#define TCPACK_TCP_FLAG_ACK	0x10
+#define TCPACK_TCP_OPT_EOL	0
+#define TCPACK_TCP_OPT_NOP	1
+#define TCPACK_TCP_OPT_TS	8
+#define TCPACK_IP_FRAG_MASK	0x3fff	/* MF and fragment offset */
+
 /* Please be sure this function is called under dhd_os_tcpacklock() */
 void dhd_onoff_tcpack_sup(void *pub, bool on)
 {
@@ -1540,38 +1550,73 @@ void dhd_onoff_tcpack_sup(void *pub, bool on)
 	return;
 }
 
-inline void dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt)
+/* Please be sure this function is called under dhd_os_tcpacklock() */
+static void dhd_tcpack_info_del(dhd_pub_t *dhdp, int i)
+{
+	int tbl_cnt = dhdp->tcp_ack_info_cnt;
+
+	/* compact the array unless the last element */
+	if (i < tbl_cnt-1) {
+		memmove(&dhdp->tcp_ack_info_tbl[i],
+			&dhdp->tcp_ack_info_tbl[i+1],
+			sizeof(struct tcp_ack_info)*(tbl_cnt - (i+1)));
+	}
+	bzero(&dhdp->tcp_ack_info_tbl[tbl_cnt-1], sizeof(struct tcp_ack_info));
+	if (--dhdp->tcp_ack_info_cnt < 0) {
+		DHD_ERROR(("dhd_tcpack_info_del:(ERROR) tcp_ack_info_cnt %d"
+		" Stop using tcpack_suppress\n", dhdp->tcp_ack_info_cnt));
+		dhd_onoff_tcpack_sup(dhdp, FALSE);
+	}
+}
+
+/* The pkt is being transmitted or freed, no later ACK may be copied into it.
+ * Also called for every tx packet PKTFREE() releases, so that packets dropped
+ * from the bus or wlfc queues do not stay in the table.
+ */
+void dhd_tcpack_check_xmit(dhd_pub_t *dhdp, void *pkt)
 {
 	uint8 i;
-	tcp_ack_info_t *tcp_ack_info = NULL;
-	int tbl_cnt;
+
+	if (!dhdp->tcp_ack_info_cnt)
+		return;
 
 	dhd_os_tcpacklock(dhdp);
-	tbl_cnt = dhdp->tcp_ack_info_cnt;
-	for (i = 0; i < tbl_cnt; i++) {
-		tcp_ack_info = &dhdp->tcp_ack_info_tbl[i];
-		if (tcp_ack_info->p_tcpackinqueue == pkt) {
-			/* This pkt is being transmitted so remove the tcp_ack_info of it.
-			* compact the array unless the last element,
-			* then the pkt's array is removed.
-			*/
-			if (i < tbl_cnt-1) {
-				memmove(&dhdp->tcp_ack_info_tbl[i],
-					&dhdp->tcp_ack_info_tbl[i+1],
-					sizeof(struct tcp_ack_info)*(tbl_cnt - (i+1)));
-			}
-			bzero(&dhdp->tcp_ack_info_tbl[tbl_cnt-1], sizeof(struct tcp_ack_info));
-			if (--dhdp->tcp_ack_info_cnt < 0) {
-				DHD_ERROR(("dhdsdio_sendfromq:(ERROR) tcp_ack_info_cnt %d"
-				" Stop using tcpack_suppress\n", dhdp->tcp_ack_info_cnt));
-				dhd_onoff_tcpack_sup(dhdp, FALSE);
-			}
+	for (i = 0; i < dhdp->tcp_ack_info_cnt; i++) {
+		if (dhdp->tcp_ack_info_tbl[i].p_tcpackinqueue == pkt) {
+			dhd_tcpack_info_del(dhdp, i);
 			break;
 		}
 	}
 	dhd_os_tcpackunlock(dhdp);
 }
 
+/* An ACK that may stand in for an older one of its flow: no flag but ACK
+ * (no FIN, SYN, RST, PSH, URG or ECN) and no option but timestamps, since
+ * each SACK block has to reach the sender.
+ */
+static bool
+dhd_tcpack_pure(uint8 *tcp_header, uint32 tcp_hdr_len)
+{
+	uint32 i = TCPACK_TCP_HDRLEN_MIN;
+
+	if (tcp_header[13] != TCPACK_TCP_FLAG_ACK)
+		return FALSE;
+
+	while (i < tcp_hdr_len) {
+		if (tcp_header[i] == TCPACK_TCP_OPT_EOL)
+			break;
+		if (tcp_header[i] == TCPACK_TCP_OPT_NOP) {
+			i++;
+			continue;
+		}
+		if (tcp_header[i] != TCPACK_TCP_OPT_TS || i + 1 >= tcp_hdr_len ||
+			tcp_header[i+1] < 2)
+			return FALSE;
+		i += tcp_header[i+1];
+	}
+	return TRUE;
+}
+
 bool
 dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 {
@@ -1580,10 +1625,16 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 	uint8 *ip_header;
 	uint8 *tcp_header;
 	uint32 ip_hdr_len;
+	uint32 tcp_hdr_len;
 	uint32 cur_framelen;
+	uint32 tcp_ack_num;
+	uint16 ip_tcp_ttllen;
 	uint8 bdc_hdr_len = BDC_HEADER_LEN;
 	uint8 wlfc_hdr_len = 0;
 	uint8 *data = PKTDATA(dhdp->osh, pkt);
+	tcp_ack_info_t *tcp_ack_info = NULL;
+	bool pure, replaced = FALSE;
+	int i;
 	cur_framelen = PKTLEN(dhdp->osh, pkt);
 
 #ifdef PROP_TXSTATUS
@@ -1619,7 +1670,7 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 		return FALSE;
 	}
 
-	if (cur_framelen < ip_hdr_len) {
+	if (cur_framelen < ip_hdr_len + TCPACK_TCP_HDRLEN_MIN) {
 		DHD_ERROR(("dhd_tcpack_suppress: IP packet length %d wrong!\n", cur_framelen));
 		return FALSE;
 	}
@@ -1630,128 +1681,128 @@ dhd_tcpack_suppress(dhd_pub_t *dhdp, void *pkt)
 		return FALSE;
 	}
 
+	/* fragments do not carry a TCP header of their own */
+	if ((ip_header[6] << 8 | ip_header[7]) & TCPACK_IP_FRAG_MASK) {
+		DHD_TRACE(("dhd_tcpack_suppress: IP fragment\n"));
+		return FALSE;
+	}
+
 	DHD_TRACE(("dhd_tcpack_suppress: TCP pkt!\n"));
 
 	tcp_header = ip_header + ip_hdr_len;
+	tcp_hdr_len = 4*((tcp_header[12] & 0xf0) >> 4);
+	if (tcp_hdr_len < TCPACK_TCP_HDRLEN_MIN || cur_framelen < ip_hdr_len + tcp_hdr_len) {
+		DHD_TRACE(("dhd_tcpack_suppress: TCP header length %d wrong\n", tcp_hdr_len));
+		return FALSE;
+	}
 
-	/* is it an ack ? */
-	if (tcp_header[13] == 0x10) {
-#if defined(DHD_DEBUG)
-		uint32 tcp_seq_num = tcp_header[4] << 24 | tcp_header[5] << 16 |
-			tcp_header[6] << 8 | tcp_header[7];
-#endif 
-		uint32 tcp_ack_num = tcp_header[8] << 24 | tcp_header[9] << 16 |
-			tcp_header[10] << 8 | tcp_header[11];
-		uint16 ip_tcp_ttllen =  (ip_header[3] & 0xff) + (ip_header[2] << 8);
-		uint32 tcp_hdr_len = 4*((tcp_header[12] & 0xf0) >> 4);
-		DHD_TRACE(("dhd_tcpack_suppress: TCP ACK seq %ud ack %ud\n",
-			tcp_seq_num, tcp_ack_num));
-
-
-		/* zero length ? */
-		if (ip_tcp_ttllen ==  ip_hdr_len + tcp_hdr_len) {
-			int i;
-			tcp_ack_info_t *tcp_ack_info = NULL;
-			DHD_TRACE(("dhd_tcpack_suppress: TCP ACK zero length\n"));
-			/* Look for tcp_ack_info that has the same
-			* ip src/dst addrs and tcp src/dst ports
-			*/
-			dhd_os_tcpacklock(dhdp);
-			for (i = 0; i < dhdp->tcp_ack_info_cnt; i++) {
-				if (dhdp->tcp_ack_info_tbl[i].p_tcpackinqueue &&
-				!memcmp(&ip_header[12], dhdp->tcp_ack_info_tbl[i].ipaddrs, 8) &&
-				!memcmp(tcp_header, dhdp->tcp_ack_info_tbl[i].tcpports, 4)) {
-					tcp_ack_info = &dhdp->tcp_ack_info_tbl[i];
-					break;
-				}
-			}
-
-			if (i == dhdp->tcp_ack_info_cnt && i < MAXTCPSTREAMS)
-				tcp_ack_info = &dhdp->tcp_ack_info_tbl[dhdp->tcp_ack_info_cnt++];
-
-			if (!tcp_ack_info) {
-				DHD_TRACE(("dhd_tcpack_suppress: No empty tcp ack info"
-					"%d %d %d %d, %d %d %d %d\n",
-					tcp_header[0], tcp_header[1], tcp_header[2], tcp_header[3],
-					dhdp->tcp_ack_info_tbl[i].tcpports[0],
-					dhdp->tcp_ack_info_tbl[i].tcpports[1],
-					dhdp->tcp_ack_info_tbl[i].tcpports[2],
-					dhdp->tcp_ack_info_tbl[i].tcpports[3]));
-				dhd_os_tcpackunlock(dhdp);
-				return FALSE;
-			}
+	ip_tcp_ttllen = (ip_header[3] & 0xff) + (ip_header[2] << 8);
+	tcp_ack_num = tcp_header[8] << 24 | tcp_header[9] << 16 |
+		tcp_header[10] << 8 | tcp_header[11];
+	/* zero length ack with nothing else to tell */
+	pure = ip_tcp_ttllen == ip_hdr_len + tcp_hdr_len &&
+		dhd_tcpack_pure(tcp_header, tcp_hdr_len);
 
-			if (tcp_ack_info->p_tcpackinqueue) {
-				if (tcp_ack_num > tcp_ack_info->tcpack_number) {
-					void *prevpkt = tcp_ack_info->p_tcpackinqueue;
-					uint8 pushed_len = SDPCM_HDRLEN +
-						(BDC_HEADER_LEN - bdc_hdr_len) + wlfc_hdr_len;
-#ifdef PROP_TXSTATUS
-					/* In case the prev pkt is delayenqueued
-					* but not delayedequeued yet, it may not have
-					* any additional header yet.
-					*/
-					dhd_os_wlfc_block(dhdp);
-					if (dhdp->wlfc_state &&	(PKTLEN(dhdp->osh, prevpkt) ==
-						tcp_ack_info->ip_tcp_ttllen + ETHER_HDR_LEN))
-						pushed_len = 0;
-#endif
-					if ((ip_tcp_ttllen == tcp_ack_info->ip_tcp_ttllen) &&
-						(PKTLEN(dhdp->osh, pkt) ==
-						PKTLEN(dhdp->osh, prevpkt) - pushed_len)) {
-						bcopy(PKTDATA(dhdp->osh, pkt),
-							PKTDATA(dhdp->osh, prevpkt) + pushed_len,
-							PKTLEN(dhdp->osh, pkt));
-						PKTFREE(dhdp->osh, pkt, FALSE);
-						DHD_TRACE(("dhd_tcpack_suppress: pkt 0x%p"
-							" TCP ACK replace %ud -> %ud\n", prevpkt,
-							tcp_ack_info->tcpack_number, tcp_ack_num));
-						tcp_ack_info->tcpack_number = tcp_ack_num;
+	/* Take the wlfc lock ahead of the tcpack lock: PKTFREE() looks the
+	 * packets it frees up in the table, and wlfc frees under its lock.
+	 */
 #ifdef PROP_TXSTATUS
-						dhd_os_wlfc_unblock(dhdp);
+	dhd_os_wlfc_block(dhdp);
 #endif
-						dhd_os_tcpackunlock(dhdp);
-						return TRUE;
-					} else
-						DHD_TRACE(("dhd_tcpack_suppress: len mismatch"
-							" %d(%d) %d(%d)\n",
-							PKTLEN(dhdp->osh, pkt), ip_tcp_ttllen,
-							PKTLEN(dhdp->osh, prevpkt),
-							tcp_ack_info->ip_tcp_ttllen));
+	dhd_os_tcpacklock(dhdp);
+
+	/* Look for tcp_ack_info that has the same
+	* ip src/dst addrs and tcp src/dst ports
+	*/
+	for (i = 0; i < dhdp->tcp_ack_info_cnt; i++) {
+		if (!memcmp(&ip_header[12], dhdp->tcp_ack_info_tbl[i].ipaddrs, 8) &&
+		!memcmp(tcp_header, dhdp->tcp_ack_info_tbl[i].tcpports, 4)) {
+			tcp_ack_info = &dhdp->tcp_ack_info_tbl[i];
+			break;
+		}
+	}
+
+	if (!pure) {
+		/* Data, FIN, RST or SACK: a later ACK of the flow must not be
+		 * folded into one queued ahead of this segment.
+		 */
+		if (tcp_ack_info) {
+			DHD_TRACE(("dhd_tcpack_suppress: flow %d forgotten, flags 0x%x len %d\n",
+				i, tcp_header[13], ip_tcp_ttllen - ip_hdr_len - tcp_hdr_len));
+			dhd_tcpack_info_del(dhdp, i);
+			dhdp->tcpack_unpure++;
+		}
+		goto done;
+	}
+
+	if (!tcp_ack_info) {
+		if (dhdp->tcp_ack_info_cnt >= MAXTCPSTREAMS) {
+			DHD_TRACE(("dhd_tcpack_suppress: No empty tcp ack info"
+				" %d %d %d %d\n",
+				tcp_header[0], tcp_header[1], tcp_header[2], tcp_header[3]));
+			dhdp->tcpack_tbl_full++;
+			goto done;
+		}
+		tcp_ack_info = &dhdp->tcp_ack_info_tbl[dhdp->tcp_ack_info_cnt++];
+		bcopy(&ip_header[12], tcp_ack_info->ipaddrs, 8);
+		bcopy(tcp_header, tcp_ack_info->tcpports, 4);
+	} else if ((int32)(tcp_ack_num - tcp_ack_info->tcpack_number) > 0) {
+		/* Only an ACK that moves the flow forward replaces the queued
+		 * one; duplicate ACKs and window updates all go out.
+		 */
+		void *prevpkt = tcp_ack_info->p_tcpackinqueue;
+		uint8 pushed_len = SDPCM_HDRLEN +
+			(BDC_HEADER_LEN - bdc_hdr_len) + wlfc_hdr_len;
 #ifdef PROP_TXSTATUS
-							dhd_os_wlfc_unblock(dhdp);
+		/* In case the prev pkt is delayenqueued
+		* but not delayedequeued yet, it may not have
+		* any additional header yet.
+		*/
+		if (dhdp->wlfc_state &&	(PKTLEN(dhdp->osh, prevpkt) ==
+			tcp_ack_info->ip_tcp_ttllen + ETHER_HDR_LEN))
+			pushed_len = 0;
 #endif
+		if ((ip_tcp_ttllen == tcp_ack_info->ip_tcp_ttllen) &&
+			(PKTLEN(dhdp->osh, pkt) ==
+			PKTLEN(dhdp->osh, prevpkt) - pushed_len)) {
+			bcopy(PKTDATA(dhdp->osh, pkt),
+				PKTDATA(dhdp->osh, prevpkt) + pushed_len,
+				PKTLEN(dhdp->osh, pkt));
+			DHD_TRACE(("dhd_tcpack_suppress: pkt 0x%p"
+				" TCP ACK replace %ud -> %ud\n", prevpkt,
+				tcp_ack_info->tcpack_number, tcp_ack_num));
+			tcp_ack_info->tcpack_number = tcp_ack_num;
+			dhdp->tcpack_replaced++;
+			replaced = TRUE;
+			goto done;
+		}
+		DHD_TRACE(("dhd_tcpack_suppress: len mismatch"
+			" %d(%d) %d(%d)\n",
+			PKTLEN(dhdp->osh, pkt), ip_tcp_ttllen,
+			PKTLEN(dhdp->osh, prevpkt),
+			tcp_ack_info->ip_tcp_ttllen));
+	} else
+		DHD_TRACE(("dhd_tcpack_suppress: TCP ACK number not forward"
+			" prev %ud (0x%p) new %ud (0x%p)\n",
+			tcp_ack_info->tcpack_number,
+			tcp_ack_info->p_tcpackinqueue,
+			tcp_ack_num, pkt));
+
+	/* This pkt goes on the queue, later ACKs of the flow fold into it */
+	tcp_ack_info->p_tcpackinqueue = pkt;
+	tcp_ack_info->tcpack_number = tcp_ack_num;
+	tcp_ack_info->ip_tcp_ttllen = ip_tcp_ttllen;
+	dhdp->tcpack_queued++;
 
-				} else {
-#ifdef TCPACK_TEST
-					void *prevpkt = tcp_ack_info->p_tcpackinqueue;
-#endif
-					DHD_TRACE(("dhd_tcpack_suppress: TCP ACK number reverse"
-							" prev %ud (0x%p) new %ud (0x%p)\n",
-							tcp_ack_info->tcpack_number,
-							tcp_ack_info->p_tcpackinqueue,
-							tcp_ack_num, pkt));
-#ifdef TCPACK_TEST
-					if (PKTLEN(dhdp->osh, pkt) == PKTLEN(dhdp->osh, prevpkt)) {
-						PKTFREE(dhdp->osh, pkt, FALSE);
-						dhd_os_tcpackunlock(dhdp);
-						return TRUE;
-					}
+done:
+	dhd_os_tcpackunlock(dhdp);
+#ifdef PROP_TXSTATUS
+	dhd_os_wlfc_unblock(dhdp);
 #endif
-				}
-			} else {
-				tcp_ack_info->p_tcpackinqueue = pkt;
-				tcp_ack_info->tcpack_number = tcp_ack_num;
-				tcp_ack_info->ip_tcp_ttllen = ip_tcp_ttllen;
-				bcopy(&ip_header[12], tcp_ack_info->ipaddrs, 8);
-				bcopy(tcp_header, tcp_ack_info->tcpports, 4);
-			}
-			dhd_os_tcpackunlock(dhdp);
-		} else
-			DHD_TRACE(("dhd_tcpack_suppress: TCP ACK with DATA len %d\n",
-				ip_tcp_ttllen - ip_hdr_len - tcp_hdr_len));
-	}
-	return FALSE;
+	/* freed as sent, for BQL and the table lookup in PKTFREE() */
+	if (replaced)
+		PKTFREE(dhdp->osh, pkt, TRUE);
+	return replaced;
 }
 #endif /* DHDTCPACK_SUPPRESS */
 /* Writes a HW/SW header into the packet and sends it. */
@@ -7807,6 +7858,7 @@ dhdsdio_download_code_file(struct dhd_bus *bus, char *pfw_path)
 	int len;
 	void *image = NULL;
 	uint8 *memblock = NULL, *memptr;
+	uint blksz = MEMBLOCK;
 
 	DHD_INFO(("%s: download firmware %s\n", __FUNCTION__, pfw_path));
 
@@ -7814,16 +7866,23 @@ dhdsdio_download_code_file(struct dhd_bus *bus, char *pfw_path)
 	if (image == NULL)
 		goto err;
 
-	memptr = memblock = MALLOC(bus->dhd->osh, MEMBLOCK + DHD_SDALIGN);
+#ifdef DHD_FWDL_FAST
+	blksz = FWDL_MEMBLOCK;
+	if (!(memblock = MALLOC(bus->dhd->osh, blksz + DHD_SDALIGN)))
+		blksz = MEMBLOCK;
+#endif /* DHD_FWDL_FAST */
+	if (memblock == NULL)
+		memblock = MALLOC(bus->dhd->osh, blksz + DHD_SDALIGN);
+	memptr = memblock;
 	if (memblock == NULL) {
-		DHD_ERROR(("%s: Failed to allocate memory %d bytes\n", __FUNCTION__, MEMBLOCK));
+		DHD_ERROR(("%s: Failed to allocate memory %d bytes\n", __FUNCTION__, blksz));
 		goto err;
 	}
 	if ((uint32)(uintptr)memblock % DHD_SDALIGN)
 		memptr += (DHD_SDALIGN - ((uint32)(uintptr)memblock % DHD_SDALIGN));
 
 	/* Download image */
-	while ((len = dhd_os_get_image_block((char*)memptr, MEMBLOCK, image))) {
+	while ((len = dhd_os_get_image_block((char*)memptr, blksz, image))) {
 		if (len < 0) {
 			DHD_ERROR(("%s: dhd_os_get_image_block failed (%d)\n", __FUNCTION__, len));
 			bcmerror = BCME_ERROR;
@@ -7843,16 +7902,16 @@ dhdsdio_download_code_file(struct dhd_bus *bus, char *pfw_path)
 		bcmerror = dhdsdio_membytes(bus, TRUE, offset, memptr, len);
 		if (bcmerror) {
 			DHD_ERROR(("%s: error %d on writing %d membytes at 0x%08x\n",
-			        __FUNCTION__, bcmerror, MEMBLOCK, offset));
+			        __FUNCTION__, bcmerror, blksz, offset));
 			goto err;
 		}
 
-		offset += MEMBLOCK;
+		offset += blksz;
 	}
 
 err:
 	if (memblock)
-		MFREE(bus->dhd->osh, memblock, MEMBLOCK + DHD_SDALIGN);
+		MFREE(bus->dhd->osh, memblock, blksz + DHD_SDALIGN);
 
 	if (image)
 		dhd_os_close_image(image);
@@ -7958,6 +8017,9 @@ _dhdsdio_download_firmware(struct dhd_bus *bus)
 
 	bool embed = FALSE;	/* download embedded firmware */
 	bool dlok = FALSE;	/* download firmware succeeded */
+#ifdef DHD_FWDL_FAST
+	uint32 stage = OSL_SYSUPTIME();
+#endif /* DHD_FWDL_FAST */
 
 	/* Out immediately if no image to download */
 	if ((bus->fw_path == NULL) || (bus->fw_path[0] == '\0')) {
@@ -8007,6 +8069,10 @@ _dhdsdio_download_firmware(struct dhd_bus *bus)
 		DHD_ERROR(("%s: dongle image download failed\n", __FUNCTION__));
 		goto err;
 	}
+#ifdef DHD_FWDL_FAST
+	bus->dhd->ton_ms[DHD_TON_FW] = OSL_SYSUPTIME() - stage;
+	stage = OSL_SYSUPTIME();
+#endif /* DHD_FWDL_FAST */
 
 	/* EXAMPLE: nvram_array */
 	/* If a valid nvram_arry is specified as above, it can be passed down to dongle */
@@ -8017,6 +8083,9 @@ _dhdsdio_download_firmware(struct dhd_bus *bus)
 		DHD_ERROR(("%s: dongle nvram file download failed\n", __FUNCTION__));
 		goto err;
 	}
+#ifdef DHD_FWDL_FAST
+	bus->dhd->ton_ms[DHD_TON_NVRAM] = OSL_SYSUPTIME() - stage;
+#endif /* DHD_FWDL_FAST */
 
 	/* Take arm out of reset */
 	if (dhdsdio_download_state(bus, FALSE)) {
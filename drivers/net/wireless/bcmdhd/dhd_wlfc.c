@@ -712,6 +712,26 @@ _dhd_wlfc_flow_control_check(athost_wl_status_info_t* ctx, struct pktq* pq, uint
 		ctx->toggle_host_if = 1;
 	}
 
+#ifdef DHD_TX_MQ
+	{
+		int ac, len;
+
+		/* an AC out of fifo credits piles up in its two precedences */
+		for (ac = 0; ac < AC_COUNT; ac++) {
+			len = pktq_plen(pq, ac * 2) + pktq_plen(pq, ac * 2 + 1);
+			if ((len >= WLFC_AC_FLOWCONTROL_HIWATER) &&
+				!(ctx->hostif_ac_flow_state[if_id] & (1 << ac))) {
+				ctx->hostif_ac_flow_state[if_id] |= (1 << ac);
+				dhd_txflowcontrol_ac(ctx->dhdp, if_id, ac, ON);
+			} else if ((len <= WLFC_AC_FLOWCONTROL_LOWATER) &&
+				(ctx->hostif_ac_flow_state[if_id] & (1 << ac))) {
+				ctx->hostif_ac_flow_state[if_id] &= ~(1 << ac);
+				dhd_txflowcontrol_ac(ctx->dhdp, if_id, ac, OFF);
+			}
+		}
+	}
+#endif /* DHD_TX_MQ */
+
 	return;
 }
 
@@ -104,6 +104,10 @@ typedef struct wlfc_hanger {
 #define WLFC_FLOWCONTROL_HIWATER	(2048 - 256)
 #define WLFC_FLOWCONTROL_LOWATER	256
 
+/* per AC share of the delay queue before that AC's netdev queue is stopped */
+#define WLFC_AC_FLOWCONTROL_HIWATER	(WLFC_FLOWCONTROL_HIWATER / AC_COUNT)
+#define WLFC_AC_FLOWCONTROL_LOWATER	(WLFC_FLOWCONTROL_LOWATER / AC_COUNT)
+
 typedef struct wlfc_mac_descriptor {
 	uint8 occupied;
 	uint8 interface_id;
@@ -259,6 +263,10 @@ typedef struct athost_wl_status_info {
 	uint8   token_pos[AC_COUNT+1];
 	/* ON/OFF state for flow control to the host network interface */
 	uint8	hostif_flow_state[WLFC_MAX_IFNUM];
+#ifdef DHD_TX_MQ
+	/* per interface bitmap of the ACs flow controlled to the host */
+	uint8	hostif_ac_flow_state[WLFC_MAX_IFNUM];
+#endif /* DHD_TX_MQ */
 	uint8	host_ifidx;
 	/* to flow control an OS interface */
 	uint8	toggle_host_if;
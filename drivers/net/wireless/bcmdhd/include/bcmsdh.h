@@ -216,6 +216,7 @@ extern int bcmsdh_register_oob_intr(void * dhdp);
 extern void bcmsdh_unregister_oob_intr(void);
 extern void bcmsdh_oob_intr_set(bool enable);
 extern bool bcmsdh_is_oob_intr_registered(void);
+extern int bcmsdh_oob_intr_set_affinity(int cpu);
 #endif 
 
 /* Function to pass device-status bits to DHD. */
@@ -386,6 +386,24 @@ extern void osl_ctfpool_stats(osl_t *osh, void *b);
 #define	PKTISFAST(osh, skb)	(FALSE)
 #endif /* CTFPOOL */
 
+#ifdef DHD_RXPOOL
+typedef struct osl_rxpool {
+	struct sk_buff_head __percpu *q;
+	uint		size;		/* skbs per cpu */
+	uint		obj_size;
+	uint		hwm;		/* most taken from one cpu between refills */
+	uint		refill_fails;
+	atomic_t	hits;
+	atomic_t	misses;
+	atomic_t	recycled;
+} osl_rxpool_t;
+
+extern int32 osl_rxpool_init(osl_t *osh, uint size, uint obj_size);
+extern void osl_rxpool_cleanup(osl_t *osh);
+extern void osl_rxpool_refill(osl_t *osh);
+extern void osl_rxpool_stats(osl_t *osh, void *b);
+#endif /* DHD_RXPOOL */
+
 #define	PKTSETCTF(osh, skb)
 #define	PKTCLRCTF(osh, skb)
 #define	PKTISCTF(osh, skb)	(FALSE)
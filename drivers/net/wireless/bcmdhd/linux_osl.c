@@ -38,6 +38,9 @@
 
 
 #include <linux/fs.h>
+#ifdef DHD_RXPOOL
+#include <linux/percpu.h>
+#endif /* DHD_RXPOOL */
 
 #define PCI_CFG_RETRY 		10
 
@@ -98,6 +101,9 @@ struct osl_info {
 #ifdef CTFPOOL
 	ctfpool_t *ctfpool;
 #endif /* CTFPOOL */
+#ifdef DHD_RXPOOL
+	osl_rxpool_t *rxpool;
+#endif /* DHD_RXPOOL */
 	uint magic;
 	void *pdev;
 	atomic_t malloced;
@@ -331,6 +337,184 @@ static struct sk_buff *osl_alloc_skb(osl_t *osh, unsigned int len)
 	return skb;
 }
 
+#ifdef DHD_RXPOOL
+/*
+ * Receive skb pool: PKTGET takes buffers of up to obj_size from a per cpu
+ * queue that the watchdog thread tops up with GFP_KERNEL, instead of
+ * allocating each one in the dpc. PKTFREE puts plain, unshared buffers of
+ * the right size back. An empty queue falls back to the allocator.
+ */
+int32
+osl_rxpool_init(osl_t *osh, uint size, uint obj_size)
+{
+	osl_rxpool_t *pool;
+	int cpu;
+
+	if (!size)
+		return 0;
+
+	pool = kzalloc(sizeof(osl_rxpool_t), GFP_KERNEL);
+	if (!pool)
+		return -1;
+
+	pool->q = alloc_percpu(struct sk_buff_head);
+	if (!pool->q) {
+		kfree(pool);
+		return -1;
+	}
+	for_each_possible_cpu(cpu)
+		skb_queue_head_init(per_cpu_ptr(pool->q, cpu));
+
+	pool->size = size;
+	pool->obj_size = obj_size;
+	osh->rxpool = pool;
+
+	osl_rxpool_refill(osh);
+	return 0;
+}
+
+void
+osl_rxpool_cleanup(osl_t *osh)
+{
+	osl_rxpool_t *pool;
+	int cpu;
+
+	if ((osh == NULL) || (osh->rxpool == NULL))
+		return;
+
+	pool = osh->rxpool;
+	osh->rxpool = NULL;
+	for_each_possible_cpu(cpu)
+		skb_queue_purge(per_cpu_ptr(pool->q, cpu));
+	free_percpu(pool->q);
+	kfree(pool);
+}
+
+/* Top each cpu's queue up to size; called from the watchdog thread */
+void
+osl_rxpool_refill(osl_t *osh)
+{
+	osl_rxpool_t *pool;
+	struct sk_buff_head *q;
+	struct sk_buff *skb;
+	uint deficit;
+	int cpu;
+
+	if ((osh == NULL) || (osh->rxpool == NULL))
+		return;
+
+	pool = osh->rxpool;
+	for_each_online_cpu(cpu) {
+		q = per_cpu_ptr(pool->q, cpu);
+		if (skb_queue_len(q) >= pool->size)
+			continue;
+
+		/* most buffers taken from one cpu between two refills */
+		deficit = pool->size - skb_queue_len(q);
+		if (deficit > pool->hwm)
+			pool->hwm = deficit;
+
+		while (skb_queue_len(q) < pool->size) {
+			if (!(skb = osl_alloc_skb(osh, pool->obj_size))) {
+				pool->refill_fails++;
+				break;
+			}
+			skb_queue_tail(q, skb);
+		}
+	}
+}
+
+static struct sk_buff *
+osl_rxpool_get(osl_t *osh, uint len)
+{
+	osl_rxpool_t *pool = osh->rxpool;
+	struct sk_buff *skb;
+
+	if (pool == NULL || len > pool->obj_size)
+		return NULL;
+
+	/* the queue lock covers a migration to another cpu */
+	skb = skb_dequeue(per_cpu_ptr(pool->q, raw_smp_processor_id()));
+	if (skb)
+		atomic_inc(&pool->hits);
+	else
+		atomic_inc(&pool->misses);
+
+	return skb;
+}
+
+/* Put a freed skb back in the pool if it is plain and big enough */
+static bool
+osl_rxpool_put(osl_t *osh, struct sk_buff *skb)
+{
+	osl_rxpool_t *pool = osh->rxpool;
+	struct skb_shared_info *shinfo;
+	struct sk_buff_head *q;
+	uint size;
+
+	if (pool == NULL || in_irq() || irqs_disabled())
+		return FALSE;
+
+	if (skb->destructor || skb->sk || skb_dst(skb) || skb_is_nonlinear(skb) ||
+	    skb_shared(skb) || skb_cloned(skb) ||
+	    skb->fclone != SKB_FCLONE_UNAVAILABLE || skb->pfmemalloc)
+		return FALSE;
+#if defined(CONFIG_NF_CONNTRACK) || defined(CONFIG_NF_CONNTRACK_MODULE)
+	if (skb->nfct)
+		return FALSE;
+#endif
+#ifdef CONFIG_XFRM
+	if (skb->sp)
+		return FALSE;
+#endif
+
+	/* no larger buffers either, they would sit in the pool */
+	size = SKB_DATA_ALIGN(pool->obj_size + NET_SKB_PAD);
+	if (skb_end_offset(skb) < size || skb_end_offset(skb) >= 2 * size)
+		return FALSE;
+
+	q = per_cpu_ptr(pool->q, raw_smp_processor_id());
+	if (skb_queue_len(q) >= pool->size)
+		return FALSE;
+
+	/* back to the state __alloc_skb leaves it in */
+	shinfo = skb_shinfo(skb);
+	memset(shinfo, 0, offsetof(struct skb_shared_info, dataref));
+	atomic_set(&shinfo->dataref, 1);
+	memset(skb, 0, offsetof(struct sk_buff, tail));
+	skb->data = skb->head + NET_SKB_PAD;
+	skb_reset_tail_pointer(skb);
+
+	skb_queue_tail(q, skb);
+	atomic_inc(&pool->recycled);
+	return TRUE;
+}
+
+void
+osl_rxpool_stats(osl_t *osh, void *b)
+{
+	struct bcmstrbuf *bb = b;
+	osl_rxpool_t *pool;
+	uint hits, misses, avail = 0;
+	int cpu;
+
+	if ((osh == NULL) || (osh->rxpool == NULL))
+		return;
+
+	pool = osh->rxpool;
+	for_each_online_cpu(cpu)
+		avail += skb_queue_len(per_cpu_ptr(pool->q, cpu));
+	hits = atomic_read(&pool->hits);
+	misses = atomic_read(&pool->misses);
+
+	bcm_bprintf(bb, "rxpool: size %u/cpu obj_size %u avail %u hwm %u refill_fails %u\n",
+	            pool->size, pool->obj_size, avail, pool->hwm, pool->refill_fails);
+	bcm_bprintf(bb, "rxpool: hits %u misses %u hit rate %u%% recycled %u\n",
+	            hits, misses, (hits + misses) ? hits * 100 / (hits + misses) : 0,
+	            atomic_read(&pool->recycled));
+}
+#endif /* DHD_RXPOOL */
+
 #ifdef CTFPOOL
 
 #ifdef CTFPOOL_SPINLOCK
@@ -641,6 +825,9 @@ osl_pktget(osl_t *osh, uint len)
 	/* Allocate from local pool */
 	skb = osl_pktfastget(osh, len);
 	if ((skb != NULL) || ((skb = osl_alloc_skb(osh, len)) != NULL)) {
+#elif defined(DHD_RXPOOL)
+	skb = osl_rxpool_get(osh, len);
+	if ((skb != NULL) || ((skb = osl_alloc_skb(osh, len)) != NULL)) {
 #else /* CTFPOOL */
 	if ((skb = osl_alloc_skb(osh, len))) {
 #endif /* CTFPOOL */
@@ -740,6 +927,9 @@ osl_pktfree(osl_t *osh, void *p, bool send)
 			osl_pktfastfree(osh, skb);
 		} else
 #endif
+#ifdef DHD_RXPOOL
+		if (!osl_rxpool_put(osh, skb))
+#endif /* DHD_RXPOOL */
 		{
 			if (skb->destructor)
 				/* cannot kfree_skb() on hard IRQ (net/core/skbuff.c) if
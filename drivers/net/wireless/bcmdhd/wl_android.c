@@ -73,6 +73,7 @@
 #define CMD_BTCOEXSCAN_START	"BTCOEXSCAN-START"
 #define CMD_BTCOEXSCAN_STOP	"BTCOEXSCAN-STOP"
 #define CMD_BTCOEXMODE		"BTCOEXMODE"
+#define CMD_BTCOEXSTATS		"BTCOEXSTATS"
 #define CMD_SETSUSPENDOPT	"SETSUSPENDOPT"
 #define CMD_SETSUSPENDMODE      "SETSUSPENDMODE"
 #define CMD_P2P_DEV_ADDR	"P2P_DEV_ADDR"
@@ -219,6 +220,9 @@ int dhd_dev_init_ioctl(struct net_device *dev);
 #ifdef WL_CFG80211
 int wl_cfg80211_get_p2p_dev_addr(struct net_device *net, struct ether_addr *p2pdev_addr);
 int wl_cfg80211_set_btcoex_dhcp(struct net_device *dev, char *command);
+#ifdef WL_BTCOEX_PROFILE
+int wl_cfg80211_btcoex_stats(struct net_device *dev, char *command, int total_len);
+#endif /* WL_BTCOEX_PROFILE */
 int wl_cfg80211_get_ioctl_version(void);
 #else
 int wl_cfg80211_get_p2p_dev_addr(struct net_device *net, struct ether_addr *p2pdev_addr)
@@ -1306,6 +1310,11 @@ int wl_android_priv_cmd(struct net_device *net, struct ifreq *ifr, int cmd)
 #endif /* PKT_FILTER_SUPPORT */
 #endif /* WL_CFG80211 */
 	}
+#if defined(WL_CFG80211) && defined(WL_BTCOEX_PROFILE)
+	else if (strnicmp(command, CMD_BTCOEXSTATS, strlen(CMD_BTCOEXSTATS)) == 0) {
+		bytes_written = wl_cfg80211_btcoex_stats(net, command, priv_cmd.total_len);
+	}
+#endif /* WL_CFG80211 && WL_BTCOEX_PROFILE */
 	else if (strnicmp(command, CMD_SETSUSPENDOPT, strlen(CMD_SETSUSPENDOPT)) == 0) {
 		bytes_written = wl_android_set_suspendopt(net, command, priv_cmd.total_len);
 	}
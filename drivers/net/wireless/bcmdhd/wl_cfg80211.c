@@ -7286,6 +7286,82 @@ fail:
 #define PNO_TIME		30
 #define PNO_REPEAT		4
 #define PNO_FREQ_EXPO_MAX	2
+
+/* A batch of PNO best networks goes straight into the bss table, and the
+ * supplicant hears about it once per batch rather than once per network.
+ */
+static void
+wl_cfg80211_pno_batch_results(struct net_device *ndev, dhd_pno_batch_bss_t *bss, int count)
+{
+	struct wl_priv *wl = wlcfg_drv_priv;
+	struct wiphy *wiphy;
+	struct ieee80211_channel *channel;
+	struct cfg80211_bss *cbss;
+	u8 ie[2 + DOT11_MAX_SSID_LEN];
+	u32 freq;
+	int i;
+
+	if (!wl || !wl->sched_scan_batch)
+		return;
+	wiphy = wl_to_wiphy(wl);
+	WL_PNO((">>> PNO batch of %d networks\n", count));
+
+	for (i = 0; i < count; i++) {
+		freq = ieee80211_channel_to_frequency(bss[i].channel,
+			(bss[i].channel <= CH_MAX_2G_CHANNEL) ?
+			IEEE80211_BAND_2GHZ : IEEE80211_BAND_5GHZ);
+		channel = ieee80211_get_channel(wiphy, freq);
+		if (!channel)
+			continue;
+		ie[0] = WLAN_EID_SSID;
+		ie[1] = bss[i].SSID_len;
+		memcpy(&ie[2], bss[i].SSID, bss[i].SSID_len);
+		cbss = cfg80211_inform_bss(wiphy, channel, bss[i].BSSID.octet,
+			(u64)bss[i].timestamp * 1000, WLAN_CAPABILITY_ESS, 100,
+			ie, 2 + bss[i].SSID_len, bss[i].RSSI * 100, GFP_KERNEL);
+		if (cbss)
+#if (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 9, 0))
+			cfg80211_put_bss(wiphy, cbss);
+#else
+			cfg80211_put_bss(cbss);
+#endif /* (LINUX_VERSION_CODE >= KERNEL_VERSION(3, 9, 0) */
+	}
+	cfg80211_sched_scan_results(wiphy);
+}
+
+/* No SSID to match: let the firmware collect every network it sees and
+ * report them in batches of dhd_pno_batch_mscan scans.
+ */
+static int
+wl_cfg80211_sched_scan_batch(struct wl_priv *wl, struct net_device *dev,
+	struct cfg80211_sched_scan_request *request)
+{
+	struct dhd_pno_batch_params batch_params;
+	int i;
+	int ret;
+
+	memset(&batch_params, 0, sizeof(batch_params));
+	batch_params.scan_fr = MAX(request->interval / 1000, 1);
+	batch_params.bestn = BESTN_MAX;
+	batch_params.band = WLC_BAND_AUTO;
+	for (i = 0; i < request->n_channels && i < WL_NUMCHANNELS; i++)
+		batch_params.chan_list[batch_params.nchan++] =
+			ieee80211_frequency_to_channel(request->channels[i]->center_freq);
+
+	dhd_dev_pno_set_batch_cb(dev, wl_cfg80211_pno_batch_results);
+	wl->sched_scan_batch = TRUE;
+	if ((ret = dhd_dev_pno_set_for_batch(dev, &batch_params)) < 0) {
+		WL_ERR(("PNO batch setup failed!! ret=%d \n", ret));
+		wl->sched_scan_batch = FALSE;
+		dhd_dev_pno_set_batch_cb(dev, NULL);
+		return -EINVAL;
+	}
+	WL_PNO((">>> PNO batching every %d s, %d scans per batch\n",
+		batch_params.scan_fr, ret));
+	wl->sched_scan_req = request;
+	return 0;
+}
+
 static int
 wl_cfg80211_sched_scan_start(struct wiphy *wiphy,
                              struct net_device *dev,
@@ -7309,6 +7385,9 @@ wl_cfg80211_sched_scan_start(struct wiphy *wiphy,
 		request->n_ssids, pno_time, pno_repeat, pno_freq_expo_max));
 
 
+	if (request && !request->n_match_sets)
+		return wl_cfg80211_sched_scan_batch(wl, dev, request);
+
 	if (!request || !request->n_ssids || !request->n_match_sets) {
 		WL_ERR(("Invalid sched scan req!! n_ssids:%d \n", request->n_ssids));
 		return -EINVAL;
@@ -7359,7 +7438,12 @@ wl_cfg80211_sched_scan_stop(struct wiphy *wiphy, struct net_device *dev)
 	WL_DBG(("Enter \n"));
 	WL_PNO((">>> SCHED SCAN STOP\n"));
 
-	if (dhd_dev_pno_stop_for_ssid(dev) < 0)
+	if (wl->sched_scan_batch) {
+		wl->sched_scan_batch = FALSE;
+		dhd_dev_pno_set_batch_cb(dev, NULL);
+		if (dhd_dev_pno_stop_for_batch(dev) < 0)
+			WL_ERR(("PNO Stop for batch failed"));
+	} else if (dhd_dev_pno_stop_for_ssid(dev) < 0)
 		WL_ERR(("PNO Stop for SSID failed"));
 
 	if (wl->scan_request && wl->sched_scan_running) {
@@ -447,6 +447,24 @@ struct btcoex_info {
 	s32 bt_state;
 	struct work_struct work;
 	struct net_device *dev;
+#ifdef WL_BTCOEX_PROFILE
+	/* settings that follow the active Bluetooth profiles */
+	struct notifier_block bt_nb;
+	struct work_struct bt_profile_work;
+	u32 bt_profiles;	/* last hint from the bluetooth driver */
+	const struct wl_btc_profile *bt_cur;	/* applied, NULL for defaults */
+	bool bt_saved;		/* firmware defaults below are valid */
+	s32 def_ampdu_mpdu;
+	s32 def_pm2_sleep_ret;
+	s32 def_btc_mode;
+	/* statistics */
+	u32 bt_changes;
+	u32 bt_errors;
+	u64 bt_audio_bytes;	/* Wi-Fi traffic while BT audio was up */
+	u32 bt_audio_ms;
+	u64 bt_last_bytes;
+	u32 bt_last_ms;
+#endif /* WL_BTCOEX_PROFILE */
 };
 
 struct sta_info {
@@ -644,6 +662,7 @@ struct wl_priv {
 	bool sched_scan_running;	/* scheduled scan req status */
 #ifdef WL_SCHED_SCAN
 	struct cfg80211_sched_scan_request *sched_scan_req;	/* scheduled scan req */
+	bool sched_scan_batch;	/* sched scan runs as PNO batching */
 #endif /* WL_SCHED_SCAN */
 	bool scan_suppressed;
 	struct timer_list scan_supp_timer;
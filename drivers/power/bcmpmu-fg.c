@@ -86,12 +86,28 @@
 #define CRIT_BATT_POLL_TIME_MS		(2000)
 #define FAKE_BATT_POLL_TIME_MS		(60000)
 
+/**
+ * While discharging above the low battery level, the polling interval
+ * doubles on every run that finds the display off, the current samples
+ * within FG_ADAPT_CURR_SPREAD of each other, their mean below
+ * FG_ADAPT_IDLE_CURR and the capacity down by at most 1%, up to
+ * FG_ADAPT_MAX_SCALE times the default. Any other run resets it.
+ */
+#define FG_ADAPT_IDLE_CURR		20	/* mA */
+#define FG_ADAPT_CURR_SPREAD		10	/* mA */
+#define FG_ADAPT_MAX_SCALE		4
+/* the alarm may be late by 1/FG_ALARM_SLACK_DIV of its timeout */
+#define FG_ALARM_SLACK_DIV		4
+
 #define FG_SETTLING_TIME (bcmpmu_fg_sample_rate_to_time\
 			(fg->sample_rate) * 5)
 
 #define INTERPOLATE_LINEAR(X, Xa, Ya, Xb, Yb) \
 	(Ya + (((Yb - Ya) * (X - Xa))/(Xb - Xa)))
 
+/* slopes of the OCV table are per mV, in 1/1024 */
+#define FG_SLOPE_SHIFT			10
+
 #define CAPACITY_PERCENTAGE_FULL	100
 #define CAPACITY_PERCENTAGE_EMPTY	0
 #define CAPACITY_ZERO_ALIAS		0xFF
@@ -325,6 +341,18 @@ struct fg_probes {
 /**
  * FG private data
  */
+/**
+ * An entry of the battery volt_cap_cpt_lut with the slopes towards the
+ * entry before it, the next higher voltage, computed at probe
+ */
+struct bcmpmu_fg_ocv_seg {
+	int volt;
+	int cap;
+	int cpt;
+	int cap_slope;
+	int cpt_slope;
+};
+
 struct bcmpmu_fg_data {
 	struct bcmpmu59xxx *bcmpmu;
 	struct mutex mutex;
@@ -368,6 +396,7 @@ struct bcmpmu_fg_data {
 
 	enum bcmpmu_chrgr_type_t chrgr_type;
 	struct bcmpmu_battery_data *bdata;
+	struct bcmpmu_fg_ocv_seg *ocv_lut;
 	int eoc_adj_fct;
 	int eoc_cap_delta;
 	int eoc_current;
@@ -396,6 +425,9 @@ struct bcmpmu_fg_data {
 	int sleep_current_ua[2]; /* 0 = in use, 1 = in pending */
 	bool used_init_cap;
 	bool acld_enabled;
+	bool display_on;
+	int poll_scale;
+	int poll_scale_cap;
 	int init_notifier;
 	int prev_ocv;
 	int ibat_avg;
@@ -450,45 +482,47 @@ static int bcmpmu_fg_get_temp_factor(struct bcmpmu_fg_data *fg);
 /**
  * Math - Utility functions
  */
-static unsigned int factorial(unsigned int n)
-{
-	unsigned int res = 1;
-	unsigned int prev;
 
-	while (n > 1) {
-		prev = res;
-		res *= n;
-		BUG_ON(prev >= res);
-		n--;
-	}
+/* e^(-k/32) and e^(-n) in Q15 */
+static const u16 exp_frac_q15[33] = {
+	32768, 31760, 30783, 29836, 28918, 28028, 27166, 26330,
+	25520, 24735, 23974, 23236, 22521, 21828, 21157, 20506,
+	19875, 19263, 18671, 18096, 17539, 17000, 16477, 15970,
+	15479, 15002, 14541, 14093, 13660, 13239, 12832, 12437,
+	12055,
+};
 
-	return res;
-}
+static const u16 exp_int_q15[] = {
+	32768, 12055, 4435, 1631, 600, 221, 81, 30, 11, 4, 1,
+};
 
-long long power(long int num, int pow)
+/* e^(-x/1000) in Q15, interpolated between the 1/32 steps of the table */
+static unsigned int exp_neg_q15(unsigned int x)
 {
-	long long res = 1;
-
-	while (pow--)
-		res *= num;
+	unsigned int n = x / 1000;
+	unsigned int pos = (x % 1000) * 32;
+	unsigned int k = pos / 1000;
+	unsigned int rem = pos % 1000;
+	unsigned int frac;
 
-	return res;
+	if (n >= ARRAY_SIZE(exp_int_q15))
+		return 0;
 
+	frac = exp_frac_q15[k] -
+		(exp_frac_q15[k] - exp_frac_q15[k + 1]) * rem / 1000;
+	return (exp_int_q15[n] * frac) >> 15;
 }
 
-/* Using Taylors Theorem */
-long long exponential(int x)
+/* e^(x/1000) * 1000, without 64 bit divisions */
+static long long exponential(int x)
 {
-	long long sum = 1000;
-	long long den = 1;
-	int i;
+	unsigned int e;
 
-	for (i = 1; i < 9; i++) {
-		sum += div64_s64(power(x, i), (factorial(i)*den));
-		den *= 1000;
-	}
+	if (x <= 0)
+		return (exp_neg_q15(0U - x) * 1000 + (1 << 14)) >> 15;
 
-	return sum;
+	e = exp_neg_q15(x);
+	return DIV_ROUND_CLOSEST(1000U << 15, e ? e : 1);
 }
 
 /**
@@ -566,12 +600,14 @@ static void bcmpmu_fg_program_alarm(struct bcmpmu_fg_data *fg,
 		long seconds)
 {
 	ktime_t interval = ktime_set(seconds, 0);
+	ktime_t slack = ktime_set(seconds / FG_ALARM_SLACK_DIV, 0);
 	ktime_t next;
 
 	pr_fg(VERBOSE, "set timeout %ld s.\n", seconds);
 	next = ktime_add(ktime_get_real(), interval);
 
-	alarm_start(&fg->alarm, next);
+	/* wake up with the first other alarm in the slack */
+	alarm_start_range(&fg->alarm, next, slack);
 }
 
 static enum alarmtimer_restart bcmpmu_fg_alarm_callback(
@@ -875,27 +911,34 @@ static int bcmpmu_fg_freeze_read(struct bcmpmu_fg_data *fg)
 	return ret;
 }
 
-static int bcmpmu_fg_volt_to_cap(struct bcmpmu_fg_data *fg, int volt)
+/**
+ * Index of the first OCV table entry at or below @volt, the table going
+ * down from the full battery voltage. lut_sz if @volt is below them all
+ */
+static int bcmpmu_fg_ocv_idx(struct bcmpmu_fg_data *fg, int volt)
 {
-	struct batt_volt_cap_cpt_map *lut;
-	u32 lut_sz;
-	int cap_percentage = 0;
+	u32 lut_sz = fg->bdata->batt_prop->volt_cap_cpt_lut_sz;
 	int idx;
 
-	lut = fg->bdata->batt_prop->volt_cap_cpt_lut;
-	lut_sz = fg->bdata->batt_prop->volt_cap_cpt_lut_sz;
-
 	for (idx = 0; idx < lut_sz; idx++) {
-		if (volt >= lut[idx].volt)
+		if (volt >= fg->ocv_lut[idx].volt)
 			break;
 	}
-	if ((idx > 0) && (idx < lut_sz)) {
-		cap_percentage = INTERPOLATE_LINEAR(volt,
-				lut[idx].volt,
-				lut[idx].cap,
-				lut[idx - 1].volt,
-				lut[idx - 1].cap);
+	return idx;
+}
+
+static int bcmpmu_fg_volt_to_cap(struct bcmpmu_fg_data *fg, int volt)
+{
+	u32 lut_sz = fg->bdata->batt_prop->volt_cap_cpt_lut_sz;
+	struct bcmpmu_fg_ocv_seg *seg;
+	int cap_percentage = 0;
+	int idx;
 
+	idx = bcmpmu_fg_ocv_idx(fg, volt);
+	if ((idx > 0) && (idx < lut_sz)) {
+		seg = &fg->ocv_lut[idx];
+		cap_percentage = seg->cap + (((volt - seg->volt) *
+				seg->cap_slope) >> FG_SLOPE_SHIFT);
 	} else if (idx == 0)
 		cap_percentage = 100; /* full capacity */
 
@@ -1077,28 +1120,18 @@ static int bcmpmu_fg_get_esr_from_ocv(int ocv, int offset, int slope,
 
 static int bcmpmu_fg_get_capacitance(struct bcmpmu_fg_data *fg, int volt)
 {
-	struct batt_volt_cap_cpt_map *lut;
-	u32 lut_sz;
+	u32 lut_sz = fg->bdata->batt_prop->volt_cap_cpt_lut_sz;
+	struct bcmpmu_fg_ocv_seg *seg;
 	int capacitance = 0;
 	int idx;
 
-	lut = fg->bdata->batt_prop->volt_cap_cpt_lut;
-	lut_sz = fg->bdata->batt_prop->volt_cap_cpt_lut_sz;
-
-	for (idx = 0; idx < lut_sz; idx++) {
-		if (volt >= lut[idx].volt)
-			break;
-	}
+	idx = bcmpmu_fg_ocv_idx(fg, volt);
 	if ((idx > 0) && (idx < lut_sz)) {
-		capacitance = INTERPOLATE_LINEAR(volt,
-			(int)lut[idx].volt,
-			(int)lut[idx].cpt,
-			(int)lut[idx - 1].volt,
-			(int)lut[idx - 1].cpt);
-
-
+		seg = &fg->ocv_lut[idx];
+		capacitance = seg->cpt + (((volt - seg->volt) *
+				seg->cpt_slope) >> FG_SLOPE_SHIFT);
 	} else if (idx == 0)
-		capacitance = lut[idx].cpt; /* capacitance at Max Voltage */
+		capacitance = fg->ocv_lut[idx].cpt; /* at Max Voltage */
 
 	return capacitance;
 }
@@ -2423,7 +2456,10 @@ static int display_event_handler(struct notifier_block *nb,
 
 	switch (event) {
 	case FB_EVENT_BLANK:
-		if (*(int *)(evt->data) == FB_BLANK_UNBLANK)
+		fg->display_on = *(int *)(evt->data) == FB_BLANK_UNBLANK;
+		if (!fg->pdata->enable_selective_sleep_current)
+			break;
+		if (fg->display_on)
 			fg->sleep_current_ua[1] =
 			fg->pdata->sleep_current_ua[SLEEP_DISPLAY_AMBIENT];
 		else
@@ -3227,6 +3263,42 @@ static bool bcmpmu_fg_ntc_update(struct bcmpmu_fg_data *fg)
 	return	update_psy;
 }
 
+/**
+ * Scale of the discharging poll interval, see FG_ADAPT_MAX_SCALE
+ */
+static int bcmpmu_fg_adapt_poll_scale(struct bcmpmu_fg_data *fg)
+{
+	int curr[AVG_SAMPLES];
+	int cap = fg->capacity_info.percentage;
+	int curr_min;
+	int curr_max;
+	int i;
+
+	/* interquartile_mean() sorts, keep the sample ring in order */
+	memcpy(curr, fg->avg_sample.curr, sizeof(curr));
+	curr_min = curr[0];
+	curr_max = curr[0];
+	for (i = 1; i < AVG_SAMPLES; i++) {
+		curr_min = min(curr_min, curr[i]);
+		curr_max = max(curr_max, curr[i]);
+	}
+
+	if (!fg->display_on && fg->poll_scale &&
+			(curr_max - curr_min) <= FG_ADAPT_CURR_SPREAD &&
+			abs(interquartile_mean(curr, AVG_SAMPLES)) <=
+				FG_ADAPT_IDLE_CURR &&
+			(fg->poll_scale_cap - cap) <= 1 &&
+			cap <= fg->poll_scale_cap)
+		fg->poll_scale = min(fg->poll_scale * 2, FG_ADAPT_MAX_SCALE);
+	else
+		fg->poll_scale = 1;
+	fg->poll_scale_cap = cap;
+
+	pr_fg(VERBOSE, "poll scale %d, curr %d..%d mA\n", fg->poll_scale,
+			curr_min, curr_max);
+	return fg->poll_scale;
+}
+
 static void bcmpmu_fg_charging_algo(struct bcmpmu_fg_data *fg)
 {
 	int poll_time = CHARG_ALGO_POLL_TIME_MS;
@@ -3234,6 +3306,9 @@ static void bcmpmu_fg_charging_algo(struct bcmpmu_fg_data *fg)
 
 	pr_fg(FLOW, "%s\n", __func__);
 
+	/* the discharging interval starts over from the default */
+	fg->poll_scale = 0;
+
 
 	if (fg->discharge_state != DISCHARG_STATE_HIGH_BATT) {
 #ifdef CONFIG_WD_TAPPER
@@ -3301,6 +3376,7 @@ static void bcmpmu_fg_discharging_algo(struct bcmpmu_fg_data *fg)
 	int cap_per;
 	int cap_cutoff;
 	int poll_time = DISCHARGE_ALGO_POLL_TIME_MS;
+	int poll_scale = 1;
 #ifdef CONFIG_WD_TAPPER
 	int ret = 0;
 #endif
@@ -3422,6 +3498,12 @@ static void bcmpmu_fg_discharging_algo(struct bcmpmu_fg_data *fg)
 		BUG();
 	}
 
+	if (fg->discharge_state == DISCHARG_STATE_HIGH_BATT) {
+		poll_scale = bcmpmu_fg_adapt_poll_scale(fg);
+		poll_time *= poll_scale;
+	} else
+		fg->poll_scale = 0;
+
 	if (fg->capacity_info.first_boot_init_cap_flat) {
 		int usable_cap = bcmpmu_fg_get_usable_cap_from_ocv_cap(
 			fg->capacity_info.ocv_cap,
@@ -3456,7 +3538,7 @@ static void bcmpmu_fg_discharging_algo(struct bcmpmu_fg_data *fg)
 	if (config_tapper)
 		fg->alarm_timeout = poll_time / 1000;
 	else
-		fg->alarm_timeout = ALARM_DEFAULT_TIMEOUT;
+		fg->alarm_timeout = ALARM_DEFAULT_TIMEOUT * poll_scale;
 	pr_fg(VERBOSE, "set poll(wakeup) timeout to %d\n",
 				fg->alarm_timeout);
 
@@ -3855,12 +3937,11 @@ static int bcmpmu_fg_register_notifiers(struct bcmpmu_fg_data *fg)
 	if (ret)
 		goto unreg_acld_nb;
 
-	if (fg->pdata->enable_selective_sleep_current) {
-		fg->display_nb.notifier_call = display_event_handler;
-		ret = fb_register_client(&fg->display_nb);
-		if (ret)
-			goto unreg_display_nb;
-	}
+	/* for the poll interval, and the sleep current if selective */
+	fg->display_nb.notifier_call = display_event_handler;
+	ret = fb_register_client(&fg->display_nb);
+	if (ret)
+		goto unreg_display_nb;
 
 	fg->init_notifier = 1;
 
@@ -3884,12 +3965,54 @@ unreg_usb_det_nb:
 	return ret;
 }
 
+/**
+ * Copy the voltage to capacity and capacitance table of the battery with
+ * the slope of each segment, so that the FG updates interpolate it with
+ * a multiply and a shift
+ */
+static int bcmpmu_fg_build_ocv_lut(struct bcmpmu_fg_data *fg,
+		struct bcmpmu_batt_property *prop)
+{
+	struct batt_volt_cap_cpt_map *lut = prop->volt_cap_cpt_lut;
+	struct bcmpmu_fg_ocv_seg *seg;
+	int dv;
+	int idx;
+
+	fg->ocv_lut = kcalloc(prop->volt_cap_cpt_lut_sz, sizeof(*fg->ocv_lut),
+			GFP_KERNEL);
+	if (!fg->ocv_lut)
+		return -ENOMEM;
+
+	for (idx = 0; idx < prop->volt_cap_cpt_lut_sz; idx++) {
+		seg = &fg->ocv_lut[idx];
+		seg->volt = lut[idx].volt;
+		seg->cap = lut[idx].cap;
+		seg->cpt = lut[idx].cpt;
+		if (!idx)
+			continue;
+		dv = (int)lut[idx - 1].volt - (int)lut[idx].volt;
+		if (dv <= 0) {
+			pr_fg(ERROR, "volt_cap_cpt_lut not descending at %d\n",
+					idx);
+			kfree(fg->ocv_lut);
+			fg->ocv_lut = NULL;
+			return -EINVAL;
+		}
+		seg->cap_slope = (((int)lut[idx - 1].cap - seg->cap) <<
+				FG_SLOPE_SHIFT) / dv;
+		seg->cpt_slope = (((int)lut[idx - 1].cpt - seg->cpt) <<
+				FG_SLOPE_SHIFT) / dv;
+	}
+	return 0;
+}
+
 static int bcmpmu_fg_set_platform_data(struct bcmpmu_fg_data *fg,
 		struct bcmpmu_fg_pdata *pdata)
 {
 	struct bcmpmu_batt_property *prop;
 	struct bcmpmu_battery_data *bdata;
 	enum battery_type batt_type;
+	int ret;
 
 	if (!pdata || !pdata->batt_data)
 		return -EINVAL;
@@ -3911,6 +4034,9 @@ static int bcmpmu_fg_set_platform_data(struct bcmpmu_fg_data *fg,
 	if ((prop->full_cap == 0) || (!prop->volt_cap_cpt_lut) ||
 			(!prop->esr_temp_lut))
 		return -EINVAL;
+	ret = bcmpmu_fg_build_ocv_lut(fg, prop);
+	if (ret)
+		return ret;
 	if (!bdata->eoc_current)
 		bdata->eoc_current = FG_EOC_CURRENT;
 	fg->eoc_current = bdata->eoc_current;
@@ -4543,8 +4669,7 @@ static int bcmpmu_fg_remove(struct platform_device *pdev)
 	fg->bcmpmu->unregister_irq(fg->bcmpmu, PMU_IRQ_MBTEMPHIGH);
 	fg->bcmpmu->unregister_irq(fg->bcmpmu, PMU_IRQ_MBTEMPLOW);
 
-	if (fg->pdata->enable_selective_sleep_current)
-		fb_unregister_client(&fg->display_nb);
+	fb_unregister_client(&fg->display_nb);
 
 	sysfs_remove_attrs(fg->psy.dev);
 
@@ -4552,6 +4677,7 @@ static int bcmpmu_fg_remove(struct platform_device *pdev)
 	bcmpmu_fg_enable(fg, false);
 	if (!(fg->bcmpmu->flags & BCMPMU_SPA_EN))
 		power_supply_unregister(&fg->psy);
+	kfree(fg->ocv_lut);
 	kfree(fg);
 	return 0;
 }
@@ -4606,7 +4732,8 @@ static int bcmpmu_fg_probe(struct platform_device *pdev)
 	/**
 	 * Dont want to keep CPU busy with this work when CPU is idle
 	 */
-	INIT_DELAYED_WORK(&fg->fg_periodic_work, bcmpmu_fg_periodic_work);
+	/* samples carry their own time stamps, a late one is fine */
+	INIT_DEFERRABLE_WORK(&fg->fg_periodic_work, bcmpmu_fg_periodic_work);
 	INIT_WORK(&fg->low_batt_irq_work, bcmpmu_fg_low_batt_irq_work);
 
 	mutex_init(&fg->mutex);
@@ -4638,6 +4765,7 @@ static int bcmpmu_fg_probe(struct platform_device *pdev)
 	fg->ibat_avg = FAKE_IBAT_INTIAL_AVG;
 	fg->flags.cv_entered = false;
 	fg->cal_eoc_point = FG_CAL_EOC_POINT;
+	fg->display_on = true;
 
 	if (bcmpmu_fg_is_batt_present(fg)) {
 		pr_fg(INIT, "main battery present\n");
@@ -4725,6 +4853,7 @@ static int bcmpmu_fg_probe(struct platform_device *pdev)
 destroy_workq:
 	destroy_workqueue(fg->fg_wq);
 free_dev:
+	kfree(fg->ocv_lut);
 	kfree(fg);
 	pr_fg(ERROR, "%s: failed!!\n", __func__);
 	return ret;
@@ -34,7 +34,6 @@
 #include <linux/device.h>
 #include <linux/dma-mapping.h>
 #include <linux/spi/spi.h>
-#include <linux/workqueue.h>
 #include <linux/errno.h>
 #include <linux/delay.h>
 #include <linux/clk.h>
@@ -63,6 +62,13 @@
 /* Timeout(ms) for wait_for_completion */
 #define SSPI_WFC_TIME_OUT	200
 #define MAX_LOCAL_BUF_SIZE	32
+/* transfers of a message that go as one task and one DMA descriptor list */
+#define SSPI_MAX_CHAIN		16
+
+/* up to this many bytes, a transfer goes through the FIFO without DMA */
+static int pio_max = SSPI_FIFO_SIZE;
+module_param(pio_max, int, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(pio_max, "Longest transfer done without DMA, in bytes");
 
 #ifndef CONFIG_MACH_BCM_FPGA
 extern void csl_caph_ControlHWClock(Boolean eanble);
@@ -105,22 +111,25 @@ struct spi_kona_data {
 	void __iomem *base;	/* SPI virtual base address */
 	struct clk *ssp_clk;	/* SSPI bus clock */
 	unsigned long spi_clk;	/* SPI controller clock speed */
+	uint32_t speed_hz;	/* SPI clock set up, 0 if none */
 
-	struct workqueue_struct *workqueue;	/* Driver message queue */
-	struct work_struct work;	/* Message work */
 	struct completion xfer_done;	/* Used to signal completion of xfer */
 	struct completion tx_dma_evt;	/* Used to signal Tx DMA completion */
 	struct completion rx_dma_evt;	/* Used to signal Rx DMA completion */
 
-	spinlock_t lock;
-	struct list_head queue;
-	u8 busy;
 	u8 use_dma;
 	u32 tx_dma_chan;
 	u32 rx_dma_chan;
 	u8 flags;		/* extra spi->mode support */
 	int irq;
 	int enable_dma;
+#ifdef CONFIG_DMAC_PL330
+	/* descriptor lists of the current chain of transfers */
+	struct list_head tx_list;
+	struct list_head rx_list;
+	struct dma_transfer_list tx_lli[SSPI_MAX_CHAIN];
+	struct dma_transfer_list rx_lli[SSPI_MAX_CHAIN];
+#endif
 
 	/* Current Transfer details */
 	int32_t count;
@@ -251,6 +260,9 @@ static int spi_kona_config_clk(struct spi_kona_data *spi_kona,
 
 	if (clk_rate < (12000))
 		return -EINVAL;
+	/* every transfer asks for its speed, mostly the one already set */
+	if (clk_rate == spi_kona->speed_hz)
+		return 0;
 	clk_src *= clk_rate % (12000) ? 52 : 48;
 	clk_disable(spi_kona->ssp_clk);
 	do {
@@ -263,6 +275,7 @@ static int spi_kona_config_clk(struct spi_kona_data *spi_kona,
 	chal_sspi_set_clk_divider(chandle, SSPI_CLK_DIVIDER0, clk_pdiv);
 	chal_sspi_set_clk_divider(chandle, SSPI_CLK_REF_DIVIDER, clk_pdiv);
 	clk_enable(spi_kona->ssp_clk);
+	spi_kona->speed_hz = clk_rate;
 #endif
 	return 0;
 }
@@ -376,7 +389,7 @@ static int spi_kona_setupxfer(struct spi_device *spi, struct spi_transfer *t)
 }
 
 static int spi_kona_config_task(struct spi_device *spi,
-				struct spi_transfer *transfer)
+				struct spi_transfer *transfer, unsigned len)
 {
 	struct spi_kona_data *spi_kona = spi_master_get_devdata(spi->master);
 	CHAL_HANDLE chandle = spi_kona->chandle;
@@ -402,8 +415,7 @@ static int spi_kona_config_task(struct spi_device *spi,
 	task_conf.div_sel = SSPI_CLK_DIVIDER0;
 	task_conf.seq_ptr = 0;
 
-	task_conf.loop_cnt = (transfer->len >>
-			      (spi_kona->bytes_per_word >> 1)) - 1;
+	task_conf.loop_cnt = (len >> (spi_kona->bytes_per_word >> 1)) - 1;
 
 	if (task_conf.loop_cnt > SSPI_MAX_TASK_LOOP) {
 		/* Care needs to be taken to stop this sequence */
@@ -465,158 +477,94 @@ static void spi_dma_callback(void *priv, enum pl330_xfer_status status)
 {
 	struct completion *c = (struct completion *)priv;
 
-	if (status == DMA_PL330_XFER_OK)
-		pr_info("DMA transfer status ok\n");
-	else if (status == DMA_PL330_XFER_ERR)
+	if (status == DMA_PL330_XFER_ERR)
 		pr_err("DMA transfer error\n");
 	else if (status == DMA_PL330_XFER_ABORT)
 		pr_err("DMA transfer aborted\n");
-	else
+	else if (status != DMA_PL330_XFER_OK)
 		pr_err("DMA transfer Invalid status!!!\n");
 
 	/* If process waiting for completion */
-	if (c) {
-		pr_info("spi_dma_callback complete\n");
+	if (c)
 		complete(c);
-	} else {
+	else
 		pr_err("NULL pointer passed to %s!!!!\n", __func__);
-	}
 }
 
-static int spi_kona_dma_xfer_rx(struct spi_kona_data *spi_kona)
+static bool spi_kona_dma_aligned(struct spi_transfer *t)
 {
-	dma_addr_t dma_rx_buf = 0;
-	u32 rx_fifo, cfg_rx;
-	CHAL_HANDLE chandle = spi_kona->chandle;
-	int ret = -EIO;
-
-#ifdef DMA_BURST_CONFIG_16_BYTES
-	/* bs = 4, bl = 4, 16 bytes xfer per request */
-	cfg_rx = DMA_CFG_SRC_ADDR_FIXED | DMA_CFG_DST_ADDR_INCREMENT |
-	    DMA_CFG_BURST_SIZE_4 | DMA_CFG_BURST_LENGTH_4;
-#else /* Burst = 64 Bytes */
-	cfg_rx = DMA_CFG_SRC_ADDR_FIXED | DMA_CFG_DST_ADDR_INCREMENT |
-	    DMA_CFG_BURST_SIZE_4 | DMA_CFG_BURST_LENGTH_16;
-#endif
-
-	rx_fifo = SSP0_BASE_ADDR + chal_sspi_rx0_get_dma_port_addr_offset();
-
-	/* Get DMA'ble address */
-	dma_rx_buf = dma_map_single(NULL, (void *)spi_kona->rx_buf,
-				    spi_kona->count, DMA_FROM_DEVICE);
-	if (!dma_rx_buf)
-		goto err;
-
-	/* Setup RX DMA */
-	if (dma_setup_transfer(spi_kona->rx_dma_chan, rx_fifo,
-			       dma_rx_buf, spi_kona->count,
-			       DMA_DIRECTION_DEV_TO_MEM_FLOW_CTRL_PERI,
-			       cfg_rx) != 0) {
-		pr_err("dma_setup_transfer(RX) failed\n");
-		goto err1;
-	}
-
-	/* Start RX DMA channel first */
-	if (dma_start_transfer(spi_kona->rx_dma_chan) != 0) {
-		pr_err("dma_start_transfer failed on RX chan\n");
-		goto err1;
-	}
-
-	/* Enable Overrun interrupt */
-	chal_sspi_enable_intr(chandle,
-		SSPIL_INTERRUPT_ENABLE_FIFO_OVERRUN_INTERRUPT_ENB_MASK);
-
-	/* Trigger RX FIFO DMA */
-	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_RX0,
-			     SSPI_FIFO_ID_RX0, 1);
-
-	/* Wait for RX DMA completion */
-	if ((wait_for_completion_interruptible_timeout
-	     (&spi_kona->rx_dma_evt, msecs_to_jiffies(SSPI_WFC_TIME_OUT))) == 0)
-		pr_err("SPI Rx DMA Transfer timed out/interrupted\n");
-	else
-		ret = spi_kona->count;
-
-	/* Disable DMA for RX/TX FIFO */
-	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_RX0,
-			     SSPI_FIFO_ID_RX0, 0);
-
-	dma_stop_transfer(spi_kona->rx_dma_chan);
-err1:
-	dma_unmap_single(NULL, dma_rx_buf, spi_kona->count, DMA_FROM_DEVICE);
-err:
-	return ret;
+	/* the PL330 bursts need 8-byte aligned buffers */
+	if (t->rx_buf != NULL && ((int)(t->rx_buf) % 8) != 0)
+		return false;
+	if (t->tx_buf != NULL && ((int)(t->tx_buf) % 8) != 0)
+		return false;
+	return true;
 }
 
-static int spi_kona_dma_xfer_tx(struct spi_kona_data *spi_kona)
+/*
+ * Map n transfers from t on, all but the last tail bytes, and build one
+ * descriptor per transfer and direction.
+ */
+static void spi_kona_dma_map(struct spi_kona_data *spi_kona,
+			     struct spi_transfer *t, int n, int tail)
 {
-	dma_addr_t dma_tx_buf = 0;
-	u32 tx_fifo, cfg_tx;
-	CHAL_HANDLE chandle = spi_kona->chandle;
-	int ret = -EIO;
-
-#ifdef DMA_BURST_CONFIG_16_BYTES
-	/* bs = 4, bl = 4, 16 bytes xfer per request */
-	cfg_tx = DMA_CFG_SRC_ADDR_INCREMENT | DMA_CFG_DST_ADDR_FIXED |
-	    DMA_CFG_BURST_SIZE_4 | DMA_CFG_BURST_LENGTH_4;
-#else /* Burst = 64 Bytes */
-	cfg_tx = DMA_CFG_SRC_ADDR_INCREMENT | DMA_CFG_DST_ADDR_FIXED |
-	    DMA_CFG_BURST_SIZE_4 | DMA_CFG_BURST_LENGTH_16;
-#endif
-
-	tx_fifo = SSP0_BASE_ADDR + chal_sspi_tx0_get_dma_port_addr_offset();
-
-	/* Get DMA'ble address */
-	dma_tx_buf = dma_map_single(NULL, (void *)spi_kona->tx_buf,
-				    spi_kona->count, DMA_TO_DEVICE);
-	if (!dma_tx_buf)
-		goto err;
-	/* Setup TX DMA */
-	if (dma_setup_transfer(spi_kona->tx_dma_chan, dma_tx_buf,
-			       tx_fifo, spi_kona->count,
-			       DMA_DIRECTION_MEM_TO_DEV_FLOW_CTRL_PERI,
-			       cfg_tx) != 0) {
-		pr_err("dma_setup_transfer(TX) failed\n");
-		goto err1;
-	}
-
-	/* Start TX DMA channel */
-	if (dma_start_transfer(spi_kona->tx_dma_chan) != 0) {
-		pr_err("dma_start_transfer failed on TX chan\n");
-		goto err1;
-	}
+	struct spi_master *master = spi_kona->master;
+	struct dma_transfer_list *lli;
+	u32 tx_fifo, rx_fifo, size;
+	int i;
 
-	/* Trigger TX FIFO DMA */
-	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_TX0,
-			     SSPI_FIFO_ID_TX0, 1);
+	tx_fifo =
+	    dma_fifo_base[master->bus_num] +
+	    chal_sspi_tx0_get_dma_port_addr_offset();
+	rx_fifo =
+	    dma_fifo_base[master->bus_num] +
+	    chal_sspi_rx0_get_dma_port_addr_offset();
 
-	/* Wait for TX DMA completion */
-	if ((wait_for_completion_interruptible_timeout
-	     (&spi_kona->tx_dma_evt,
-	      msecs_to_jiffies(SSPI_WFC_TIME_OUT))) == 0) {
-		pr_err("SPI Tx DMA Transfer timed out/interrupted\n");
-	} else {
-		ret = spi_kona->count;
+	INIT_LIST_HEAD(&spi_kona->tx_list);
+	INIT_LIST_HEAD(&spi_kona->rx_list);
+	for (i = 0; i < n; i++) {
+		size = t->len - (i == n - 1 ? tail : 0);
+		if (t->tx_buf != NULL) {
+			lli = &spi_kona->tx_lli[i];
+			lli->srcaddr = dma_map_single(NULL, (void *)t->tx_buf,
+						      size, DMA_TO_DEVICE);
+			lli->dstaddr = tx_fifo;
+			lli->xfer_size = size;
+			list_add_tail(&lli->next, &spi_kona->tx_list);
+		}
+		if (t->rx_buf != NULL) {
+			lli = &spi_kona->rx_lli[i];
+			lli->srcaddr = rx_fifo;
+			lli->dstaddr = dma_map_single(NULL, t->rx_buf,
+						      size, DMA_FROM_DEVICE);
+			lli->xfer_size = size;
+			list_add_tail(&lli->next, &spi_kona->rx_list);
+		}
+		t = list_entry(t->transfer_list.next, struct spi_transfer,
+			       transfer_list);
 	}
-	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_TX0,
-			     SSPI_FIFO_ID_TX0, 0);
-
-	/* Disable all Interrupt */
-	dma_stop_transfer(spi_kona->tx_dma_chan);
+}
 
-err1:
-	dma_unmap_single(NULL, dma_tx_buf, spi_kona->count, DMA_TO_DEVICE);
-err:
-	return ret;
+static void spi_kona_dma_unmap(struct spi_kona_data *spi_kona)
+{
+	struct dma_transfer_list *lli;
+
+	list_for_each_entry(lli, &spi_kona->tx_list, next)
+		dma_unmap_single(NULL, lli->srcaddr, lli->xfer_size,
+				 DMA_TO_DEVICE);
+	list_for_each_entry(lli, &spi_kona->rx_list, next)
+		dma_unmap_single(NULL, lli->dstaddr, lli->xfer_size,
+				 DMA_FROM_DEVICE);
 }
 
+/* Run the descriptor lists built by spi_kona_dma_map */
 static int spi_kona_dma_xfer(struct spi_kona_data *spi_kona)
 {
-	dma_addr_t dma_rx_buf = 0, dma_tx_buf = 0;
-	u32 tx_fifo, rx_fifo, cfg_rx, cfg_tx;
+	u32 cfg_rx, cfg_tx;
 	CHAL_HANDLE chandle = spi_kona->chandle;
+	bool tx = !list_empty(&spi_kona->tx_list);
+	bool rx = !list_empty(&spi_kona->rx_list);
 	int ret = -EIO;
-	struct spi_master *master = spi_kona->master;
 
 #ifdef DMA_BURST_CONFIG_16_BYTES
 	/* bs = 4, bl = 4, 16 bytes xfer per request */
@@ -631,80 +579,61 @@ static int spi_kona_dma_xfer(struct spi_kona_data *spi_kona)
 	    DMA_CFG_BURST_SIZE_4 | DMA_CFG_BURST_LENGTH_16;
 #endif
 
-	tx_fifo =
-	    dma_fifo_base[master->bus_num] +
-	    chal_sspi_tx0_get_dma_port_addr_offset();
-	rx_fifo =
-	    dma_fifo_base[master->bus_num] +
-	    chal_sspi_rx0_get_dma_port_addr_offset();
-
-	/* Get DMA'ble address */
-	if (spi_kona->tx_buf != NULL) {
-		dma_tx_buf = dma_map_single(NULL, (void *)spi_kona->tx_buf,
-					    spi_kona->count, DMA_TO_DEVICE);
-		if (!dma_tx_buf)
-			return ret;
-	}
-	if (spi_kona->rx_buf != NULL) {
-		dma_rx_buf = dma_map_single(NULL, (void *)spi_kona->rx_buf,
-					    spi_kona->count, DMA_FROM_DEVICE);
-		if (!dma_rx_buf)
-			goto err;
-	}
 	/* Setup TX DMA */
-	if (dma_setup_transfer(spi_kona->tx_dma_chan, dma_tx_buf,
-			       tx_fifo, spi_kona->count,
-			       DMA_DIRECTION_MEM_TO_DEV_FLOW_CTRL_PERI,
-			       cfg_tx) != 0) {
-		pr_err("dma_setup_transfer(TX) failed\n");
-		goto err1;
+	if (tx && dma_setup_transfer_list(spi_kona->tx_dma_chan,
+			&spi_kona->tx_list,
+			DMA_DIRECTION_MEM_TO_DEV_FLOW_CTRL_PERI, cfg_tx) != 0) {
+		pr_err("dma_setup_transfer_list(TX) failed\n");
+		return ret;
 	}
 
 	/* Setup RX DMA */
-	if (dma_setup_transfer(spi_kona->rx_dma_chan, rx_fifo,
-			       dma_rx_buf, spi_kona->count,
-			       DMA_DIRECTION_DEV_TO_MEM_FLOW_CTRL_PERI,
-			       cfg_rx) != 0) {
-		pr_err("dma_setup_transfer(RX) failed\n");
-		goto err1;
+	if (rx && dma_setup_transfer_list(spi_kona->rx_dma_chan,
+			&spi_kona->rx_list,
+			DMA_DIRECTION_DEV_TO_MEM_FLOW_CTRL_PERI, cfg_rx) != 0) {
+		pr_err("dma_setup_transfer_list(RX) failed\n");
+		goto err;
 	}
 
 	/* Start RX DMA channel first */
-	if (dma_start_transfer(spi_kona->rx_dma_chan) != 0) {
+	if (rx && dma_start_transfer(spi_kona->rx_dma_chan) != 0) {
 		pr_err("dma_start_transfer failed on RX chan\n");
 		goto err1;
 	}
 
 	/* Start TX DMA channel */
-	if (dma_start_transfer(spi_kona->tx_dma_chan) != 0) {
+	if (tx && dma_start_transfer(spi_kona->tx_dma_chan) != 0) {
 		pr_err("dma_start_transfer failed on TX chan\n");
 		goto err2;
 	}
 
-	/* Enable Overrun interrupt */
-	chal_sspi_enable_intr(chandle,
-		SSPIL_INTERRUPT_ENABLE_FIFO_OVERRUN_INTERRUPT_ENB_MASK);
+	if (rx) {
+		/* Enable Overrun interrupt */
+		chal_sspi_enable_intr(chandle,
+			SSPIL_INTERRUPT_ENABLE_FIFO_OVERRUN_INTERRUPT_ENB_MASK);
 
-	/* Trigger RX FIFO DMA */
-	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_RX0,
-			     SSPI_FIFO_ID_RX0, 1);
+		/* Trigger RX FIFO DMA */
+		chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_RX0,
+				     SSPI_FIFO_ID_RX0, 1);
+	}
 
 	/* Trigger TX FIFO DMA */
-	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_TX0,
-			     SSPI_FIFO_ID_TX0, 1);
+	if (tx)
+		chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_TX0,
+				     SSPI_FIFO_ID_TX0, 1);
 
 	/* Wait for TX DMA completion */
-	if ((wait_for_completion_interruptible_timeout
-	     (&spi_kona->tx_dma_evt,
-	      msecs_to_jiffies(SSPI_WFC_TIME_OUT))) == 0) {
+	if (tx && (wait_for_completion_interruptible_timeout
+		   (&spi_kona->tx_dma_evt,
+		    msecs_to_jiffies(SSPI_WFC_TIME_OUT))) == 0) {
 		pr_err(" %s SPI Tx DMA Transfer timed out/interrupted\n",
 		       __func__);
 	}
 
 	/* Wait for RX DMA completion */
-	else if ((wait_for_completion_interruptible_timeout
-		  (&spi_kona->rx_dma_evt,
-		   msecs_to_jiffies(SSPI_WFC_TIME_OUT))) == 0) {
+	else if (rx && (wait_for_completion_interruptible_timeout
+			(&spi_kona->rx_dma_evt,
+			 msecs_to_jiffies(SSPI_WFC_TIME_OUT))) == 0) {
 		pr_err("SPI Rx DMA Transfer timed out/interrupted\n");
 	} else
 		ret = spi_kona->count;
@@ -716,26 +645,36 @@ static int spi_kona_dma_xfer(struct spi_kona_data *spi_kona)
 	chal_sspi_enable_dma(chandle, SSPI_DMA_CHAN_SEL_CHAN_TX0,
 			     SSPI_FIFO_ID_TX0, 0);
 
-	/* Disable all Interrupt */
-	dma_stop_transfer(spi_kona->tx_dma_chan);
+	if (tx)
+		dma_stop_transfer(spi_kona->tx_dma_chan);
+	if (rx)
+		dma_stop_transfer(spi_kona->rx_dma_chan);
+	return ret;
 
 err2:
 	dma_stop_transfer(spi_kona->rx_dma_chan);
+	rx = false;
 err1:
-	dma_unmap_single(NULL, dma_rx_buf, spi_kona->count, DMA_FROM_DEVICE);
+	if (rx)
+		dma_release_transfer(spi_kona->rx_dma_chan);
 err:
-	dma_unmap_single(NULL, dma_tx_buf, spi_kona->count, DMA_TO_DEVICE);
+	if (tx)
+		dma_release_transfer(spi_kona->tx_dma_chan);
 	return ret;
 }
 #else
-static int spi_kona_dma_xfer_tx(struct spi_kona_data *spi_kona)
+static bool spi_kona_dma_aligned(struct spi_transfer *t)
 {
-	return 0;
+	return true;
 }
 
-static int spi_kona_dma_xfer_rx(struct spi_kona_data *spi_kona)
+static void spi_kona_dma_map(struct spi_kona_data *spi_kona,
+			     struct spi_transfer *t, int n, int tail)
+{
+}
+
+static void spi_kona_dma_unmap(struct spi_kona_data *spi_kona)
 {
-	return 0;
 }
 
 static int spi_kona_dma_xfer(struct spi_kona_data *spi_kona)
@@ -744,54 +683,63 @@ static int spi_kona_dma_xfer(struct spi_kona_data *spi_kona)
 }
 #endif
 
+static int spi_kona_use_dma(struct spi_kona_data *spi_kona, unsigned len)
+{
+	/* the PIO path fills the FIFO in one go, it cannot take more */
+	return spi_kona->enable_dma &&
+	    len > min_t(unsigned, max(pio_max, 0), SSPI_FIFO_SIZE);
+}
+
+/*
+ * Transfer n transfers from transfer on, of len bytes in all, as one task
+ * of the scheduler. A chain of more than one is only built for DMA, and
+ * all but its last transfer are whole DMA bursts.
+ */
 static int spi_kona_txrxfer_bufs(struct spi_device *spi,
-				 struct spi_transfer *transfer)
+				 struct spi_transfer *transfer, int n,
+				 unsigned len)
 {
 	struct spi_kona_data *spi_kona = spi_master_get_devdata(spi->master);
 	CHAL_HANDLE chandle = spi_kona->chandle;
+	struct spi_transfer *last = transfer;
 	int32_t unaligned, xfer_len = 0;
 	int status;
-	int ret;
-	unsigned temp_length;
+	int ret, i;
 
-	if (transfer->len % spi_kona->bytes_per_word)
+	if (len % spi_kona->bytes_per_word)
 		return -EINVAL;
 
 	/* Set default FIFO threshold */
 	ret = chal_sspi_set_fifo_threshold(chandle, SSPI_FIFO_ID_TX0,
-					   min((int)transfer->len,
-					       SSPI_FIFO_THRESHOLD));
+					   min((int)len, SSPI_FIFO_THRESHOLD));
 	if (ret < 0)
 		return ret;
 
 	ret = chal_sspi_set_fifo_threshold(chandle, SSPI_FIFO_ID_RX0,
-					   min((int)transfer->len,
-					       SSPI_FIFO_THRESHOLD));
+					   min((int)len, SSPI_FIFO_THRESHOLD));
 	if (ret < 0)
 		return ret;
 	spi_kona->rx_buf = transfer->rx_buf;
 	spi_kona->tx_buf = transfer->tx_buf;
 
-	/* bytes to be transfered in PIO */
-	unaligned = transfer->len % FIFO_BURST_ALIGNMENT;
+	for (i = 1; i < n; i++)
+		last = list_entry(last->transfer_list.next,
+				  struct spi_transfer, transfer_list);
+
+	/* bytes to be transfered in PIO, all from the last transfer */
+	unaligned = len % FIFO_BURST_ALIGNMENT;
 	init_completion(&spi_kona->xfer_done);
-	spi_kona->count = transfer->len - unaligned;
+	spi_kona->count = len - unaligned;
 
-	spi_kona_config_task(spi, transfer);
+	spi_kona_config_task(spi, transfer, len);
 
 	/* Use DMA mode transfer */
-	if (spi_kona->enable_dma && spi_kona->count) {
+	if (spi_kona_use_dma(spi_kona, len) && spi_kona->count) {
 		/* Check if 8-byte unalligned address buffer was passed */
-		if (transfer->rx_buf != NULL &&
-				((int)(transfer->rx_buf) % 8) != 0) {
-			pr_err("8-byte unalligned access seen for RX buffer\n");
+		if (!spi_kona_dma_aligned(transfer)) {
+			pr_err("8-byte unalligned RX/TX buffer\n");
 			return -EINVAL;
 		}
-
-	if (transfer->tx_buf != NULL && ((int)(transfer->tx_buf) % 8) != 0) {
-		pr_err("8-byte unalligned access seen for TX buffer\n");
-		return -EINVAL;
-	}
 		/* Setup completion events */
 		init_completion(&spi_kona->tx_dma_evt);
 		init_completion(&spi_kona->rx_dma_evt);
@@ -819,36 +767,29 @@ static int spi_kona_txrxfer_bufs(struct spi_device *spi,
 					    CHAL_SSPI_DMA_BURSTSIZE_64BYTES);
 #endif
 
-		if (spi_kona->rx_buf != NULL && spi_kona->tx_buf != NULL) {
-			xfer_len = spi_kona_dma_xfer(spi_kona);
-			spi_kona->rx_buf = transfer->rx_buf + spi_kona->count;
-			spi_kona->tx_buf = transfer->tx_buf + spi_kona->count;
-		} else {
-			if (spi_kona->rx_buf != NULL) {
-				xfer_len = spi_kona_dma_xfer_rx(spi_kona);
-				spi_kona->rx_buf =
-				    transfer->rx_buf + spi_kona->count;
-			}
-			if (spi_kona->tx_buf != NULL) {
-				xfer_len = spi_kona_dma_xfer_tx(spi_kona);
-				spi_kona->tx_buf =
-				    transfer->tx_buf + spi_kona->count;
-			}
-		}
+		spi_kona_dma_map(spi_kona, transfer, n, unaligned);
+		xfer_len = spi_kona_dma_xfer(spi_kona);
+		spi_kona_dma_unmap(spi_kona);
+
+		/* the PIO remainder is the tail of the last transfer */
+		if (last->rx_buf != NULL)
+			spi_kona->rx_buf = last->rx_buf + last->len - unaligned;
+		if (last->tx_buf != NULL)
+			spi_kona->tx_buf = last->tx_buf + last->len - unaligned;
 
 		if (xfer_len == spi_kona->count)
 			spi_kona->count = unaligned;	/* DMA Success */
 		else
 			spi_kona->count = 0;	/* DMA failed, no PIO */
 	} else
-		spi_kona->count = transfer->len;
+		spi_kona->count = len;
 
 	if (spi_kona->count) {	/* PIO mode with Interrupts */
 		xfer_len += spi_kona->count;
 
 		/* If the remainder bits needs to be transferred
 		 * through PIO after DMA, reconfigure */
-		if (spi_kona->count != transfer->len) {
+		if (spi_kona->count != len) {
 			ret = chal_sspi_set_fifo_threshold(chandle,
 							 SSPI_FIFO_ID_RX0,
 							 spi_kona->count);
@@ -860,12 +801,9 @@ static int spi_kona_txrxfer_bufs(struct spi_device *spi,
 			if (ret < 0)
 				return ret;
 
-			/* transfer length set to the bytes
+			/* task length set to the bytes
 			 * to be trasferred by PIO */
-			temp_length = transfer->len;
-			transfer->len = spi_kona->count;
-			spi_kona_config_task(spi, transfer);
-			transfer->len = temp_length;
+			spi_kona_config_task(spi, transfer, spi_kona->count);
 		}
 
 		/* Reconfigure FIFO Pack and Read/Write Data Size if DMA mode */
@@ -921,13 +859,60 @@ static void spi_kona_chipselect(struct spi_device *spi, int is_active)
 	return;
 }
 
+/*
+ * Number of transfers from t on that can go as one task and one DMA
+ * descriptor list, with their length in *len: same setup and direction,
+ * no chip select change or delay in between, and all but the last whole
+ * DMA bursts. The chip select then stays active across them, as the
+ * core expects without cs_change.
+ */
+static int spi_kona_chain(struct spi_kona_data *spi_kona,
+			  struct spi_message *m, struct spi_transfer *t,
+			  unsigned *len)
+{
+	struct spi_transfer *first = t, *next;
+	int n = 1;
+
+	*len = t->len;
+	if (!spi_kona_dma_aligned(t))
+		return 1;
+	while (n < SSPI_MAX_CHAIN && t->len && !t->cs_change &&
+	       !t->delay_usecs && !(t->len % FIFO_BURST_ALIGNMENT) &&
+	       t->transfer_list.next != &m->transfers) {
+		next = list_entry(t->transfer_list.next, struct spi_transfer,
+				  transfer_list);
+		if (!next->len || next->speed_hz != t->speed_hz ||
+		    next->bits_per_word != t->bits_per_word ||
+		    !next->tx_buf != !t->tx_buf ||
+		    !next->rx_buf != !t->rx_buf ||
+		    !spi_kona_dma_aligned(next))
+			break;
+		*len += next->len;
+		t = next;
+		n++;
+	}
+
+	/* a chain is only worth it, and only contiguous enough, for DMA */
+	if (n > 1 && !spi_kona_use_dma(spi_kona, *len)) {
+		*len = first->len;
+		n = 1;
+	}
+	return n;
+}
+
 static int spi_kona_do_transfer(struct spi_message *m, struct spi_device *spi,
-				struct spi_transfer *t)
+				struct spi_transfer *t, int n, unsigned len)
 {
 
 	int status = 0;
 	struct spi_kona_data *spi_kona;
+	struct spi_transfer *last = t;
+	int i;
+
 	spi_kona = spi_master_get_devdata(spi->master);
+	for (i = 1; i < n; i++)
+		last = list_entry(last->transfer_list.next,
+				  struct spi_transfer, transfer_list);
 
 	/* override speed or wordsize? */
 	if (t->speed_hz || t->bits_per_word)
@@ -942,21 +927,21 @@ static int spi_kona_do_transfer(struct spi_message *m, struct spi_device *spi,
 
 	if (spi_kona->cs_change)
 		spi_kona_chipselect(spi, CS_ACTIVE);
-	spi_kona->cs_change = t->cs_change;
+	spi_kona->cs_change = last->cs_change;
 
-	if (!t->tx_buf && !t->rx_buf && t->len) {
+	if (!t->tx_buf && !t->rx_buf && len) {
 		status = -EINVAL;
 		goto transfer_err;
 	}
 
-	if (t->len) {
+	if (len) {
 		if (!m->is_dma_mapped)
 			t->rx_dma = t->tx_dma = 0;
-		status = spi_kona_txrxfer_bufs(spi, t);
+		status = spi_kona_txrxfer_bufs(spi, t, n, len);
 	}
 	if (status > 0)
 		m->actual_length += status;
-	if (status != t->len) {
+	if (status != len) {
 		/* always report some kind of error */
 		if (status >= 0)
 			status = -EREMOTEIO;
@@ -965,8 +950,8 @@ static int spi_kona_do_transfer(struct spi_message *m, struct spi_device *spi,
 	status = 0;
 
 	/*protocol tweaks before next transfer */
-	if (t->delay_usecs)
-		udelay(t->delay_usecs);
+	if (last->delay_usecs)
+		udelay(last->delay_usecs);
 transfer_err:
 	return status;
 }
@@ -1010,7 +995,8 @@ static int spi_kona_cmd_transfer(struct spi_message *m, struct spi_device *spi)
 	local_trans->tx_buf = local_buf;
 	local_trans->rx_buf = local_buf + tx_n;
 	local_trans->len = rx_n + tx_n;
-	status = spi_kona_do_transfer(m, spi, local_trans);
+	status = spi_kona_do_transfer(m, spi, local_trans, 1,
+				      local_trans->len);
 	if (status < 0)
 		goto error1;
 	list_for_each_entry(t, &m->transfers, transfer_list) {
@@ -1029,129 +1015,112 @@ error1:
 
 }
 
-/*
- * This costs a task context per controller, running the queue by
- * performing each transfer in sequence.
- */
-static void spi_kona_work(struct work_struct *work)
+static int spi_kona_prepare_hw(struct spi_master *master)
 {
-	struct spi_kona_data *spi_kona =
-	    container_of(work, struct spi_kona_data, work);
-	unsigned long flags;
-	unsigned int no_of_trans = 0;
-	struct spi_master *master = spi_kona->master;
+	struct spi_kona_data *spi_kona = spi_master_get_devdata(master);
 
-	spin_lock(&spi_kona->lock);
-	spi_kona->busy = 1;
-	spi_kona->do_setup = -1;
-	spin_unlock(&spi_kona->lock);
-	while (!list_empty(&spi_kona->queue)) {
-		struct spi_message *m;
-		struct spi_device *spi;
-		struct spi_transfer *t = NULL;
-		int status;
-
-		m = container_of(spi_kona->queue.next, struct spi_message,
-				 queue);
-
-		spin_lock_irqsave(&spi_kona->lock, flags);
-		list_del_init(&m->queue);
-		spin_unlock_irqrestore(&spi_kona->lock, flags);
-
-		spi = m->spi;
-		spi_kona->cs_change = 1;
-		status = 0;
-		spi_kona->spi_mode = spi->mode;
-		if (spi->mode == SPI_LOOP)
-			spi_kona->spi_mode &= SPI_MODE_1;
-		if (master->bus_num != 0) {
+	if (master->bus_num != 0) {
 #if !defined(CONFIG_MACH_BCM_FPGA) && defined(CONFIG_BCM_ALSA_SOUND)
-			/*turn on caph clock for ssp1 and ssp2 */
-			csl_caph_ControlHWClock(TRUE);
+		/*turn on caph clock for ssp1 and ssp2 */
+		csl_caph_ControlHWClock(TRUE);
 #endif
-		}
+	}
 #ifndef CONFIG_MACH_BCM_FPGA
-		clk_enable(spi_kona->ssp_clk);
+	clk_enable(spi_kona->ssp_clk);
 #endif
+	spi_kona->do_setup = -1;
+	spi_kona->speed_hz = 0;
+	return 0;
+}
 
-		/* One byte command transfer */
-		list_for_each_entry(t, &m->transfers, transfer_list) {
-			no_of_trans++;
-		}
-		if (no_of_trans >= 2 && spi_kona->spi_mode != SPI_LOOP) {
-			status = spi_kona_cmd_transfer(m, spi);
-		} else {
-			list_for_each_entry(t, &m->transfers, transfer_list) {
-				status = spi_kona_do_transfer(m, spi, t);
-				if (status < 0)
-					break;
-				if (!spi_kona->cs_change)
-					continue;
-				if (t->transfer_list.next == &m->transfers)
-					break;
-
-			/* sometimes a short mid-message deselect of the chip
-			 * may be needed to terminate a mode or command
-			 */
-				spi_kona_chipselect(spi, CS_INACTIVE);
-			}
-		}
-		m->status = status;
-		no_of_trans = 0;
-		m->complete(m->context);
-
-		/* restore speed and wordsize if it was overridden */
-		if (spi_kona->do_setup == 1) {
-			status = spi_kona_setupxfer(spi, NULL);
-			if (status < 0)
-				break;
-		}
-		spi_kona->do_setup = 0;
-
-		/* normally deactivate chipselect ... unless no error and
-		 * cs_change has hinted that the next message will probably
-		 * be for this chip too.
-		 */
-		if (!(status == 0 && spi_kona->cs_change))
-			spi_kona_chipselect(spi, CS_INACTIVE);
+static int spi_kona_unprepare_hw(struct spi_master *master)
+{
+	struct spi_kona_data *spi_kona = spi_master_get_devdata(master);
 
 #ifndef CONFIG_MACH_BCM_FPGA
-		clk_disable(spi_kona->ssp_clk);
+	clk_disable(spi_kona->ssp_clk);
 #endif
-		if (master->bus_num != 0) {
+	if (master->bus_num != 0) {
 #if !defined(CONFIG_MACH_BCM_FPGA) && defined(CONFIG_BCM_ALSA_SOUND)
-			/*turn on caph clock for ssp1 and ssp2 */
-			csl_caph_ControlHWClock(FALSE);
+		/*turn off caph clock for ssp1 and ssp2 */
+		csl_caph_ControlHWClock(FALSE);
 #endif
-		}
-
 	}
-	spin_lock(&spi_kona->lock);
-	spi_kona->busy = 0;
-	spin_unlock(&spi_kona->lock);
+	return 0;
 }
 
-static int spi_kona_transfer(struct spi_device *spi, struct spi_message *m)
+/*
+ * Called from the realtime queue pump of the SPI core, with the clocks
+ * on from spi_kona_prepare_hw for as long as the queue is busy.
+ */
+static int spi_kona_transfer_one_message(struct spi_master *master,
+					 struct spi_message *m)
 {
-	struct spi_kona_data *spi_kona;
-	unsigned long flags;
-	int status = 0;
+	struct spi_kona_data *spi_kona = spi_master_get_devdata(master);
+	struct spi_device *spi = m->spi;
+	struct spi_transfer *t = NULL;
+	unsigned int no_of_trans = 0, len = 0;
+	int status = 0, n, i;
+
+	if (!spi->max_speed_hz) {
+		m->status = -ENETDOWN;
+		spi_finalize_current_message(master);
+		return 0;
+	}
 
-	m->actual_length = 0;
-	m->status = -EINPROGRESS;
+	spi_kona->cs_change = 1;
+	spi_kona->spi_mode = spi->mode;
+	if (spi->mode == SPI_LOOP)
+		spi_kona->spi_mode &= SPI_MODE_1;
 
-	spi_kona = spi_master_get_devdata(spi->master);
+	/* One byte command transfer */
+	list_for_each_entry(t, &m->transfers, transfer_list) {
+		no_of_trans++;
+		len += t->len;
+	}
+	if (no_of_trans >= 2 && spi_kona->spi_mode != SPI_LOOP &&
+	    len <= MAX_LOCAL_BUF_SIZE) {
+		status = spi_kona_cmd_transfer(m, spi);
+	} else {
+		t = list_first_entry(&m->transfers, struct spi_transfer,
+				     transfer_list);
+		while (&t->transfer_list != &m->transfers) {
+			n = spi_kona_chain(spi_kona, m, t, &len);
+			status = spi_kona_do_transfer(m, spi, t, n, len);
+			if (status < 0)
+				break;
+			for (i = 1; i < n; i++)
+				t = list_entry(t->transfer_list.next,
+					       struct spi_transfer,
+					       transfer_list);
+			if (t->transfer_list.next == &m->transfers)
+				break;
 
-	spin_lock_irqsave(&spi_kona->lock, flags);
-	if (!spi->max_speed_hz)
-		status = -ENETDOWN;
-	else {
-		list_add_tail(&m->queue, &spi_kona->queue);
-		queue_work(spi_kona->workqueue, &spi_kona->work);
+			/* sometimes a short mid-message deselect of the chip
+			 * may be needed to terminate a mode or command
+			 */
+			if (spi_kona->cs_change)
+				spi_kona_chipselect(spi, CS_INACTIVE);
+			t = list_entry(t->transfer_list.next,
+				       struct spi_transfer, transfer_list);
+		}
 	}
-	spin_unlock_irqrestore(&spi_kona->lock, flags);
+	m->status = status;
 
-	return status;
+	/* restore speed and wordsize if it was overridden */
+	if (spi_kona->do_setup == 1)
+		status = spi_kona_setupxfer(spi, NULL);
+	spi_kona->do_setup = 0;
+
+	/* normally deactivate chipselect ... unless no error and
+	 * cs_change has hinted that the next message will probably
+	 * be for this chip too.
+	 */
+	if (!(status == 0 && spi_kona->cs_change))
+		spi_kona_chipselect(spi, CS_INACTIVE);
+
+	spi_finalize_current_message(master);
+	return 0;
 }
 
 static int spi_kona_setup(struct spi_device *spi)
@@ -1335,7 +1304,11 @@ static int spi_kona_probe(struct platform_device *pdev)
 
 	master->setup = spi_kona_setup;
 	master->cleanup = spi_kona_cleanup;
-	master->transfer = spi_kona_transfer;
+	master->prepare_transfer_hardware = spi_kona_prepare_hw;
+	master->transfer_one_message = spi_kona_transfer_one_message;
+	master->unprepare_transfer_hardware = spi_kona_unprepare_hw;
+	/* back-to-back messages, e.g. of a display, must not wait on others */
+	master->rt = true;
 
 	res = platform_get_resource(pdev, IORESOURCE_MEM, 0);
 	if (!res) {
@@ -1390,25 +1363,10 @@ static int spi_kona_probe(struct platform_device *pdev)
 		goto out_clk_put;
 	}
 
-	INIT_WORK(&spi_kona->work, spi_kona_work);
-	spin_lock_init(&spi_kona->lock);
-	INIT_LIST_HEAD(&spi_kona->queue);
-
-	/* this task is the only thing to touch the SPI bits */
-	spi_kona->busy = 0;
-	spi_kona->workqueue =
-	    create_singlethread_workqueue(dev_name
-					  (spi_kona->master->dev.parent));
-	if (spi_kona->workqueue == NULL) {
-		status = -EBUSY;
-		goto out_clk_put;
-	}
-
-	/* Register with the SPI framework */
+	/* Register with the SPI framework, its queue pump does the rest */
 	status = spi_register_master(master);
 	if (status != 0) {
 		dev_err(&pdev->dev, "problem registering spi master\n");
-		destroy_workqueue(spi_kona->workqueue);
 		goto out_clk_put;
 	}
 
@@ -1454,8 +1412,6 @@ static int spi_kona_remove(struct platform_device *pdev)
 	if (!spi_kona)
 		return 0;
 
-	WARN_ON(!list_empty(&spi_kona->queue));
-	destroy_workqueue(spi_kona->workqueue);
 	spi_unregister_master(master);
 
 	status = chal_sspi_deinit(spi_kona->chandle);
@@ -1489,12 +1445,12 @@ static void spi_kona_shutdown(struct platform_device *pdev)
 #ifdef CONFIG_PM
 static int spi_kona_suspend(struct platform_device *pdev, pm_message_t state)
 {
-	return 0;
+	return spi_master_suspend(platform_get_drvdata(pdev));
 }
 
 static int spi_kona_resume(struct platform_device *pdev)
 {
-	return 0;
+	return spi_master_resume(platform_get_drvdata(pdev));
 }
 #else
 #define spi_kona_suspend     NULL
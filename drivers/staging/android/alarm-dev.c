@@ -56,6 +56,7 @@ struct devalarm {
 		struct alarm alrm;
 	} u;
 	enum android_alarm_type type;
+	ktime_t window;		/* under alarm_slock */
 };
 
 static struct devalarm alarms[ANDROID_ALARM_TYPE_COUNT];
@@ -71,9 +72,11 @@ static int is_wakeup(enum android_alarm_type type)
 static void devalarm_start(struct devalarm *alrm, ktime_t exp)
 {
 	if (is_wakeup(alrm->type))
-		alarm_start(&alrm->u.alrm, exp);
+		alarm_start_range(&alrm->u.alrm, exp, alrm->window);
 	else
-		hrtimer_start(&alrm->u.hrt, exp, HRTIMER_MODE_ABS);
+		hrtimer_start_range_ns(&alrm->u.hrt, exp,
+				       ktime_to_ns(alrm->window),
+				       HRTIMER_MODE_ABS);
 }
 
 
@@ -144,6 +147,22 @@ static void alarm_set(enum android_alarm_type alarm_type,
 
 }
 
+static int alarm_set_window(enum android_alarm_type alarm_type,
+			    struct timespec *ts)
+{
+	unsigned long flags;
+
+	if (!timespec_valid(ts))
+		return -EINVAL;
+
+	spin_lock_irqsave(&alarm_slock, flags);
+	alarm_dbg(IO, "alarm %d window %ld.%09ld\n",
+			alarm_type, ts->tv_sec, ts->tv_nsec);
+	alarms[alarm_type].window = timespec_to_ktime(*ts);
+	spin_unlock_irqrestore(&alarm_slock, flags);
+	return 0;
+}
+
 static int alarm_wait(void)
 {
 	unsigned long flags;
@@ -261,6 +280,9 @@ static long alarm_do_ioctl(struct file *file, unsigned int cmd,
 	case ANDROID_ALARM_SET_RTC:
 		rv = alarm_set_rtc(ts);
 		break;
+	case ANDROID_ALARM_SET_WINDOW(0):
+		rv = alarm_set_window(alarm_type, ts);
+		break;
 	case ANDROID_ALARM_GET_TIME(0):
 		rv = alarm_get_time(alarm_type, ts);
 		break;
@@ -281,6 +303,7 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case ANDROID_ALARM_SET_AND_WAIT(0):
 	case ANDROID_ALARM_SET(0):
 	case ANDROID_ALARM_SET_RTC:
+	case ANDROID_ALARM_SET_WINDOW(0):
 		if (copy_from_user(&ts, (void __user *)arg, sizeof(ts)))
 			return -EFAULT;
 		break;
@@ -311,6 +334,7 @@ static long alarm_compat_ioctl(struct file *file, unsigned int cmd,
 	case ANDROID_ALARM_SET_AND_WAIT_COMPAT(0):
 	case ANDROID_ALARM_SET_COMPAT(0):
 	case ANDROID_ALARM_SET_RTC_COMPAT:
+	case ANDROID_ALARM_SET_WINDOW_COMPAT(0):
 		if (compat_get_timespec(&ts, (void __user *)arg))
 			return -EFAULT;
 		/* fall through */
@@ -356,6 +380,7 @@ static int alarm_release(struct inode *inode, struct file *file)
 					  !!(alarm_pending & alarm_type_mask));
 				alarm_enabled &= ~alarm_type_mask;
 			}
+			alarms[i].window = ktime_set(0, 0);
 			spin_unlock_irqrestore(&alarm_slock, flags);
 #ifdef CONFIG_BCM_RTC_ALARM_BOOT
 			if (alarms[i].type == ANDROID_ALARM_RTC_POWERON)
@@ -30,6 +30,8 @@
 							struct compat_timespec)
 #define ANDROID_ALARM_SET_RTC_COMPAT		_IOW('a', 5, \
 							struct compat_timespec)
+#define ANDROID_ALARM_SET_WINDOW_COMPAT(type)	ALARM_IOW(6, type, \
+							struct compat_timespec)
 #define ANDROID_ALARM_IOCTL_NR(cmd)		(_IOC_NR(cmd) & ((1<<4)-1))
 #define ANDROID_ALARM_COMPAT_TO_NORM(cmd)  \
 				ALARM_IOW(ANDROID_ALARM_IOCTL_NR(cmd), \
@@ -22,6 +22,7 @@
 #include <linux/file.h>
 #include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/miscdevice.h>
 #include <linux/mm.h>
@@ -32,6 +33,7 @@
 #include <linux/debugfs.h>
 #include <linux/rbtree.h>
 #include <linux/sched.h>
+#include <linux/sched/rt.h>
 #include <linux/seq_file.h>
 #include <linux/uaccess.h>
 #include <linux/vmalloc.h>
@@ -57,6 +59,8 @@ static struct binder_node *binder_context_mgr_node;
 static kuid_t binder_context_mgr_uid = INVALID_UID;
 static int binder_last_id;
 static struct workqueue_struct *binder_deferred_workqueue;
+static struct kmem_cache *binder_transaction_cachep;
+static struct kmem_cache *binder_work_cachep;
 
 #define BINDER_DEBUG_ENTRY(name) \
 static int binder_##name##_open(struct inode *inode, struct file *file) \
@@ -128,6 +132,10 @@ static int binder_set_stop_on_user_error(const char *val,
 module_param_call(stop_on_user_error, binder_set_stop_on_user_error,
 	param_get_int, &binder_stop_on_user_error, S_IWUSR | S_IRUGO);
 
+/* freed buffer pages each proc keeps mapped for the next allocation */
+static int binder_warm_pages = 4;
+module_param_named(warm_pages, binder_warm_pages, int, S_IWUSR | S_IRUGO);
+
 #define binder_debug(mask, x...) \
 	do { \
 		if (binder_debug_mask & mask) \
@@ -162,6 +170,20 @@ struct binder_stats {
 
 static struct binder_stats binder_stats;
 
+/* transaction buffer allocation latency, bucket n counts [2^(n-1), 2^n) us */
+#define BINDER_ALLOC_LAT_BUCKETS 16
+static atomic_t binder_alloc_lat[BINDER_ALLOC_LAT_BUCKETS];
+
+static inline void binder_alloc_lat_add(ktime_t start)
+{
+	s64 us = ktime_us_delta(ktime_get(), start);
+	int bucket = us > 0 ? fls64(us) : 0;
+
+	if (bucket >= BINDER_ALLOC_LAT_BUCKETS)
+		bucket = BINDER_ALLOC_LAT_BUCKETS - 1;
+	atomic_inc(&binder_alloc_lat[bucket]);
+}
+
 static inline void binder_stats_deleted(enum binder_stat_types type)
 {
 	binder_stats.obj_deleted[type]++;
@@ -218,6 +240,16 @@ struct binder_work {
 	} type;
 };
 
+/*
+ * A scheduling policy and a priority on the task->prio scale: 0 to
+ * MAX_RT_PRIO - 1 for SCHED_FIFO and SCHED_RR, then the nice values.
+ * Lower is more important.
+ */
+struct binder_priority {
+	unsigned int sched_policy;
+	int prio;
+};
+
 struct binder_node {
 	int debug_id;
 	struct binder_work work;
@@ -238,7 +270,8 @@ struct binder_node {
 	unsigned pending_weak_ref:1;
 	unsigned has_async_transaction:1;
 	unsigned accept_fds:1;
-	unsigned min_priority:8;
+	unsigned sched_policy:2;
+	int min_priority;	/* on the task->prio scale */
 	struct list_head async_todo;
 };
 
@@ -271,7 +304,8 @@ struct binder_buffer {
 	unsigned free:1;
 	unsigned allow_user_free:1;
 	unsigned async_transaction:1;
-	unsigned debug_id:29;
+	unsigned in_flight:1;	/* allocated, transaction not queued yet */
+	unsigned debug_id:28;
 
 	struct binder_transaction *transaction;
 
@@ -303,12 +337,19 @@ struct binder_proc {
 	void *buffer;
 	ptrdiff_t user_buffer_offset;
 
+	/*
+	 * alloc_lock protects the buffer allocator: buffers, free_buffers,
+	 * allocated_buffers, free_async_space and the page array. It nests
+	 * inside binder_main_lock and outside mmap_sem.
+	 */
+	struct mutex alloc_lock;
 	struct list_head buffers;
 	struct rb_root free_buffers;
 	struct rb_root allocated_buffers;
 	size_t free_async_space;
 
 	struct page **pages;
+	int warm_pages;		/* mapped pages not backing any buffer */
 	size_t buffer_size;
 	uint32_t buffer_free;
 	struct list_head todo;
@@ -319,8 +360,11 @@ struct binder_proc {
 	int requested_threads;
 	int requested_threads_started;
 	int ready_threads;
-	long default_priority;
+	struct binder_priority default_priority;
 	struct dentry *debugfs_entry;
+	/* in-flight transactions into this proc, plus one for the file */
+	int tmp_ref;
+	bool is_dead;
 };
 
 enum {
@@ -361,8 +405,8 @@ struct binder_transaction {
 	struct binder_buffer *buffer;
 	unsigned int	code;
 	unsigned int	flags;
-	long	priority;
-	long	saved_priority;
+	struct binder_priority	priority;
+	struct binder_priority	saved_priority;
 	kuid_t	sender_euid;
 };
 
@@ -431,6 +475,26 @@ static inline void binder_unlock(const char *tag)
 	mutex_unlock(&binder_main_lock);
 }
 
+/*
+ * Buffer allocation, page mapping and the copies of the transaction
+ * payload only need the target's alloc_lock, so binder_main_lock is
+ * dropped around them unless the global lock fallback is selected.
+ */
+#ifdef CONFIG_ANDROID_BINDER_IPC_GLOBAL_LOCK
+static inline void binder_lock_transaction(const char *tag) { }
+static inline void binder_unlock_transaction(const char *tag) { }
+#else
+static inline void binder_lock_transaction(const char *tag)
+{
+	binder_lock(tag);
+}
+
+static inline void binder_unlock_transaction(const char *tag)
+{
+	binder_unlock(tag);
+}
+#endif
+
 static void binder_set_nice(long nice)
 {
 	long min_nice;
@@ -448,6 +512,103 @@ static void binder_set_nice(long nice)
 	binder_user_error("%d RLIMIT_NICE not set\n", current->pid);
 }
 
+#define BINDER_NICE_TO_PRIO(nice)	(MAX_RT_PRIO + (nice) + 20)
+#define BINDER_PRIO_TO_NICE(prio)	((prio) - MAX_RT_PRIO - 20)
+
+static inline bool binder_is_rt_policy(unsigned int policy)
+{
+	return policy == SCHED_FIFO || policy == SCHED_RR;
+}
+
+static struct binder_priority binder_get_priority(struct task_struct *task)
+{
+	struct binder_priority p;
+
+	p.sched_policy = task->policy;
+	if (binder_is_rt_policy(p.sched_policy))
+		p.prio = MAX_RT_PRIO - 1 - task->rt_priority;
+	else
+		p.prio = BINDER_NICE_TO_PRIO(task_nice(task));
+	return p;
+}
+
+/*
+ * Move current to @desired. Real-time policies are applied without the
+ * RLIMIT_RTPRIO check: they are inherited from a real-time caller or
+ * from a node whose owner may use them, and are undone on reply.
+ */
+static void binder_set_priority(struct binder_priority desired)
+{
+	struct binder_priority cur = binder_get_priority(current);
+	struct sched_param param = { .sched_priority = 0 };
+
+	if (cur.sched_policy == desired.sched_policy &&
+	    cur.prio == desired.prio)
+		return;
+
+	trace_binder_set_priority(current->tgid, current->pid,
+				  cur.sched_policy, cur.prio,
+				  desired.sched_policy, desired.prio);
+
+	if (binder_is_rt_policy(desired.sched_policy)) {
+		param.sched_priority = MAX_RT_PRIO - 1 - desired.prio;
+		sched_setscheduler_nocheck(current, desired.sched_policy,
+					   &param);
+		return;
+	}
+	if (cur.sched_policy != desired.sched_policy)
+		sched_setscheduler_nocheck(current, desired.sched_policy,
+					   &param);
+	binder_set_nice(BINDER_PRIO_TO_NICE(desired.prio));
+}
+
+/*
+ * Called by the thread picking up @t for @node. A synchronous call runs
+ * at the caller's policy and priority, a one-way call keeps the
+ * thread's own; either is raised to the node's minimum.
+ */
+static void binder_transaction_priority(struct binder_transaction *t,
+					struct binder_node *node)
+{
+	struct binder_priority desired;
+
+	t->saved_priority = binder_get_priority(current);
+	if (t->flags & TF_ONE_WAY)
+		desired = t->saved_priority;
+	else
+		desired = t->priority;
+
+	if (node->min_priority < desired.prio) {
+		desired.sched_policy = node->sched_policy;
+		desired.prio = node->min_priority;
+	}
+	binder_set_priority(desired);
+}
+
+/*
+ * The node's minimum priority comes from the flags of the object that
+ * created it. A real-time minimum is only honoured for an owner that
+ * could run real-time itself.
+ */
+static void binder_node_set_min_priority(struct binder_node *node,
+					 __u32 flags)
+{
+	unsigned int policy = (flags & FLAT_BINDER_FLAG_SCHED_POLICY_MASK) >>
+				FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT;
+	int prio = flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
+
+	if (binder_is_rt_policy(policy) && capable(CAP_SYS_NICE)) {
+		prio = clamp(prio, 1, MAX_USER_RT_PRIO - 1);
+		node->sched_policy = policy;
+		node->min_priority = MAX_RT_PRIO - 1 - prio;
+		return;
+	}
+	/* a nice value, -20..19 */
+	prio = clamp((int)(s8)prio, -20, 19);
+	node->sched_policy = policy == SCHED_BATCH ? SCHED_BATCH : SCHED_NORMAL;
+	node->min_priority = BINDER_NICE_TO_PRIO(prio);
+}
+
 static size_t binder_buffer_size(struct binder_proc *proc,
 				 struct binder_buffer *buffer)
 {
@@ -559,6 +720,17 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 
 	trace_binder_update_page_range(proc, allocate, start, end);
 
+	/* all warm: nothing to allocate or map, and no need for mmap_sem */
+	if (allocate && !vma) {
+		for (page_addr = start; page_addr < end; page_addr += PAGE_SIZE)
+			if (!proc->pages[(page_addr - proc->buffer) / PAGE_SIZE])
+				break;
+		if (page_addr >= end) {
+			proc->warm_pages -= (end - start) / PAGE_SIZE;
+			return 0;
+		}
+	}
+
 	if (vma)
 		mm = NULL;
 	else
@@ -588,7 +760,11 @@ static int binder_update_page_range(struct binder_proc *proc, int allocate,
 		struct page **page_array_ptr;
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
 
-		BUG_ON(*page);
+		if (*page) {
+			/* left mapped by an earlier free */
+			proc->warm_pages--;
+			continue;
+		}
 		*page = alloc_page(GFP_KERNEL | __GFP_HIGHMEM | __GFP_ZERO);
 		if (*page == NULL) {
 			pr_err("%d: binder_alloc_buf failed for page at %p\n",
@@ -624,6 +800,10 @@ free_range:
 	for (page_addr = end - PAGE_SIZE; page_addr >= start;
 	     page_addr -= PAGE_SIZE) {
 		page = &proc->pages[(page_addr - proc->buffer) / PAGE_SIZE];
+		if (vma && proc->warm_pages < binder_warm_pages) {
+			proc->warm_pages++;
+			continue;
+		}
 		if (vma)
 			zap_page_range(vma, (uintptr_t)page_addr +
 				proc->user_buffer_offset, PAGE_SIZE, NULL);
@@ -857,6 +1037,53 @@ static void binder_free_buf(struct binder_proc *proc,
 	binder_insert_free_buffer(proc, buffer);
 }
 
+static void binder_free_proc(struct binder_proc *proc)
+{
+	int page_count = 0;
+
+	BUG_ON(!RB_EMPTY_ROOT(&proc->allocated_buffers));
+
+	if (proc->pages) {
+		int i;
+
+		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
+			void *page_addr;
+
+			if (!proc->pages[i])
+				continue;
+
+			page_addr = proc->buffer + i * PAGE_SIZE;
+			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
+				     "%s: %d: page %d at %p not freed\n",
+				     __func__, proc->pid, i, page_addr);
+			unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
+			__free_page(proc->pages[i]);
+			page_count++;
+		}
+		kfree(proc->pages);
+		vfree(proc->buffer);
+	}
+
+	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
+		     "%s: %d pages %d\n", __func__, proc->pid, page_count);
+
+	put_task_struct(proc->tsk);
+	binder_stats_deleted(BINDER_STAT_PROC);
+	kfree(proc);
+}
+
+/*
+ * A transaction holds a reference on its target proc while it runs
+ * without binder_main_lock, so that a concurrent release cannot free
+ * the buffer area under it. Called with binder_main_lock held.
+ */
+static void binder_proc_dec_tmpref(struct binder_proc *proc)
+{
+	BUG_ON(proc->tmp_ref <= 0);
+	if (--proc->tmp_ref == 0)
+		binder_free_proc(proc);
+}
+
 static struct binder_node *binder_get_node(struct binder_proc *proc,
 					   binder_uintptr_t ptr)
 {
@@ -903,6 +1130,8 @@ static struct binder_node *binder_new_node(struct binder_proc *proc,
 	rb_link_node(&node->rb_node, parent, p);
 	rb_insert_color(&node->rb_node, &proc->nodes);
 	node->debug_id = ++binder_last_id;
+	node->sched_policy = SCHED_NORMAL;
+	node->min_priority = BINDER_NICE_TO_PRIO(0);
 	node->proc = proc;
 	node->ptr = ptr;
 	node->cookie = cookie;
@@ -1171,7 +1400,7 @@ static void binder_pop_transaction(struct binder_thread *target_thread,
 	t->need_reply = 0;
 	if (t->buffer)
 		t->buffer->transaction = NULL;
-	kfree(t);
+	kmem_cache_free(binder_transaction_cachep, t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 }
 
@@ -1300,6 +1529,56 @@ static void binder_transaction_buffer_release(struct binder_proc *proc,
 	}
 }
 
+/*
+ * Allocate the target buffer and copy the payload into it. Runs
+ * without binder_main_lock; the buffer stays in_flight, invisible to
+ * release and to BC_FREE_BUFFER, until the transaction is queued.
+ */
+static int binder_transaction_copy(struct binder_proc *proc,
+				   struct binder_thread *thread,
+				   struct binder_proc *target_proc,
+				   struct binder_node *target_node,
+				   struct binder_transaction *t,
+				   struct binder_transaction_data *tr,
+				   int reply)
+{
+	binder_size_t *offp;
+	ktime_t start = ktime_get();
+
+	mutex_lock(&target_proc->alloc_lock);
+	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
+		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
+	binder_alloc_lat_add(start);
+	if (t->buffer) {
+		t->buffer->allow_user_free = 0;
+		t->buffer->in_flight = 1;
+		t->buffer->debug_id = t->debug_id;
+		t->buffer->transaction = NULL;
+		t->buffer->target_node = target_node;
+	}
+	mutex_unlock(&target_proc->alloc_lock);
+	if (t->buffer == NULL)
+		return -ENOMEM;
+	trace_binder_transaction_alloc_buf(t->buffer);
+
+	offp = (binder_size_t *)(t->buffer->data +
+				 ALIGN(tr->data_size, sizeof(void *)));
+
+	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
+			   tr->data.ptr.buffer, tr->data_size)) {
+		binder_user_error("%d:%d got transaction with invalid data ptr\n",
+				proc->pid, thread->pid);
+		return -EFAULT;
+	}
+	if (copy_from_user(offp, (const void __user *)(uintptr_t)
+			   tr->data.ptr.offsets, tr->offsets_size)) {
+		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
+				proc->pid, thread->pid);
+		return -EFAULT;
+	}
+	return 0;
+}
+
 static void binder_transaction(struct binder_proc *proc,
 			       struct binder_thread *thread,
 			       struct binder_transaction_data *tr, int reply)
@@ -1316,6 +1595,7 @@ static void binder_transaction(struct binder_proc *proc,
 	struct binder_transaction *in_reply_to = NULL;
 	struct binder_transaction_log_entry *e;
 	uint32_t return_error;
+	int ret;
 
 	e = binder_transaction_log_add(&binder_transaction_log);
 	e->call_type = reply ? 2 : !!(tr->flags & TF_ONE_WAY);
@@ -1333,7 +1613,7 @@ static void binder_transaction(struct binder_proc *proc,
 			return_error = BR_FAILED_REPLY;
 			goto err_empty_call_stack;
 		}
-		binder_set_nice(in_reply_to->saved_priority);
+		binder_set_priority(in_reply_to->saved_priority);
 		if (in_reply_to->to_thread != thread) {
 			binder_user_error("%d:%d got reply transaction with bad transaction stack, transaction %d has target %d:%d\n",
 				proc->pid, thread->pid, in_reply_to->debug_id,
@@ -1421,14 +1701,14 @@ static void binder_transaction(struct binder_proc *proc,
 	e->to_proc = target_proc->pid;
 
 	/* TODO: reuse incoming transaction for reply */
-	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	t = kmem_cache_zalloc(binder_transaction_cachep, GFP_KERNEL);
 	if (t == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_alloc_t_failed;
 	}
 	binder_stats_created(BINDER_STAT_TRANSACTION);
 
-	tcomplete = kzalloc(sizeof(*tcomplete), GFP_KERNEL);
+	tcomplete = kmem_cache_zalloc(binder_work_cachep, GFP_KERNEL);
 	if (tcomplete == NULL) {
 		return_error = BR_FAILED_REPLY;
 		goto err_alloc_tcomplete_failed;
@@ -1464,41 +1744,62 @@ static void binder_transaction(struct binder_proc *proc,
 	t->to_thread = target_thread;
 	t->code = tr->code;
 	t->flags = tr->flags;
-	t->priority = task_nice(current);
+	t->priority = binder_get_priority(current);
 
 	trace_binder_transaction(reply, t, target_node);
 
-	t->buffer = binder_alloc_buf(target_proc, tr->data_size,
-		tr->offsets_size, !reply && (t->flags & TF_ONE_WAY));
-	if (t->buffer == NULL) {
-		return_error = BR_FAILED_REPLY;
-		goto err_binder_alloc_buf_failed;
-	}
-	t->buffer->allow_user_free = 0;
-	t->buffer->debug_id = t->debug_id;
-	t->buffer->transaction = t;
-	t->buffer->target_node = target_node;
-	trace_binder_transaction_alloc_buf(t->buffer);
 	if (target_node)
 		binder_inc_node(target_node, 1, 0, NULL);
+	target_proc->tmp_ref++;
 
-	offp = (binder_size_t *)(t->buffer->data +
-				 ALIGN(tr->data_size, sizeof(void *)));
+	binder_unlock_transaction(__func__);
+	ret = binder_transaction_copy(proc, thread, target_proc, target_node,
+				      t, tr, reply);
+	binder_lock_transaction(__func__);
 
-	if (copy_from_user(t->buffer->data, (const void __user *)(uintptr_t)
-			   tr->data.ptr.buffer, tr->data_size)) {
-		binder_user_error("%d:%d got transaction with invalid data ptr\n",
-				proc->pid, thread->pid);
+	if (ret == -ENOMEM) {
 		return_error = BR_FAILED_REPLY;
-		goto err_copy_data_failed;
+		goto err_binder_alloc_buf_failed;
 	}
-	if (copy_from_user(offp, (const void __user *)(uintptr_t)
-			   tr->data.ptr.offsets, tr->offsets_size)) {
-		binder_user_error("%d:%d got transaction with invalid offsets ptr\n",
-				proc->pid, thread->pid);
+	offp = (binder_size_t *)(t->buffer->data +
+				 ALIGN(tr->data_size, sizeof(void *)));
+	if (ret) {
 		return_error = BR_FAILED_REPLY;
 		goto err_copy_data_failed;
 	}
+
+	/*
+	 * The target may have gone away while the lock was dropped: the
+	 * proc released, the thread waiting for our reply exited, or the
+	 * thread picked from the call stack exited.
+	 */
+	if (target_proc->is_dead ||
+	    (reply && in_reply_to->from != target_thread)) {
+		return_error = BR_DEAD_REPLY;
+		goto err_dead_target;
+	}
+	if (!reply && target_thread) {
+		struct binder_transaction *tmp;
+
+		target_thread = NULL;
+		for (tmp = thread->transaction_stack; tmp;
+		     tmp = tmp->from_parent)
+			if (tmp->from && tmp->from->proc == target_proc)
+				target_thread = tmp->from;
+		t->to_thread = target_thread;
+		if (target_thread) {
+			target_list = &target_thread->todo;
+			target_wait = &target_thread->wait;
+		} else {
+			target_list = &target_proc->todo;
+			target_wait = &target_proc->wait;
+		}
+	}
+	mutex_lock(&target_proc->alloc_lock);
+	t->buffer->in_flight = 0;
+	t->buffer->transaction = t;
+	mutex_unlock(&target_proc->alloc_lock);
+
 	if (!IS_ALIGNED(tr->offsets_size, sizeof(binder_size_t))) {
 		binder_user_error("%d:%d got transaction with invalid offsets size, %lld\n",
 				proc->pid, thread->pid, (u64)tr->offsets_size);
@@ -1534,7 +1835,7 @@ static void binder_transaction(struct binder_proc *proc,
 					return_error = BR_FAILED_REPLY;
 					goto err_binder_new_node_failed;
 				}
-				node->min_priority = fp->flags & FLAT_BINDER_FLAG_PRIORITY_MASK;
+				binder_node_set_min_priority(node, fp->flags);
 				node->accept_fds = !!(fp->flags & FLAT_BINDER_FLAG_ACCEPTS_FDS);
 			}
 			if (fp->cookie != node->cookie) {
@@ -1686,6 +1987,7 @@ static void binder_transaction(struct binder_proc *proc,
 	list_add_tail(&tcomplete->entry, &thread->todo);
 	if (target_wait)
 		wake_up_interruptible(target_wait);
+	binder_proc_dec_tmpref(target_proc);
 	return;
 
 err_get_unused_fd_failed:
@@ -1696,16 +1998,24 @@ err_binder_get_ref_failed:
 err_binder_new_node_failed:
 err_bad_object_type:
 err_bad_offset:
+err_dead_target:
 err_copy_data_failed:
 	trace_binder_transaction_failed_buffer_release(t->buffer);
 	binder_transaction_buffer_release(target_proc, t->buffer, offp);
 	t->buffer->transaction = NULL;
+	mutex_lock(&target_proc->alloc_lock);
 	binder_free_buf(target_proc, t->buffer);
+	mutex_unlock(&target_proc->alloc_lock);
+	goto err_put_target_proc;
 err_binder_alloc_buf_failed:
-	kfree(tcomplete);
+	if (target_node)
+		binder_dec_node(target_node, 1, 0);
+err_put_target_proc:
+	binder_proc_dec_tmpref(target_proc);
+	kmem_cache_free(binder_work_cachep, tcomplete);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 err_alloc_tcomplete_failed:
-	kfree(t);
+	kmem_cache_free(binder_transaction_cachep, t);
 	binder_stats_deleted(BINDER_STAT_TRANSACTION);
 err_alloc_t_failed:
 err_bad_call_stack:
@@ -1875,17 +2185,23 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 				return -EFAULT;
 			ptr += sizeof(binder_uintptr_t);
 
+			mutex_lock(&proc->alloc_lock);
 			buffer = binder_buffer_lookup(proc, data_ptr);
 			if (buffer == NULL) {
+				mutex_unlock(&proc->alloc_lock);
 				binder_user_error("%d:%d BC_FREE_BUFFER u%016llx no match\n",
 					proc->pid, thread->pid, (u64)data_ptr);
 				break;
 			}
 			if (!buffer->allow_user_free) {
+				mutex_unlock(&proc->alloc_lock);
 				binder_user_error("%d:%d BC_FREE_BUFFER u%016llx matched unreturned buffer\n",
 					proc->pid, thread->pid, (u64)data_ptr);
 				break;
 			}
+			/* claimed: a second BC_FREE_BUFFER will not match */
+			buffer->allow_user_free = 0;
+			mutex_unlock(&proc->alloc_lock);
 			binder_debug(BINDER_DEBUG_FREE_BUFFER,
 				     "%d:%d BC_FREE_BUFFER u%016llx found buffer %d for %s transaction\n",
 				     proc->pid, thread->pid, (u64)data_ptr, buffer->debug_id,
@@ -1904,7 +2220,12 @@ int binder_thread_write(struct binder_proc *proc, struct binder_thread *thread,
 			}
 			trace_binder_transaction_buffer_release(buffer);
 			binder_transaction_buffer_release(proc, buffer, NULL);
+
+			binder_unlock_transaction(__func__);
+			mutex_lock(&proc->alloc_lock);
 			binder_free_buf(proc, buffer);
+			mutex_unlock(&proc->alloc_lock);
+			binder_lock_transaction(__func__);
 			break;
 		}
 
@@ -2171,7 +2492,7 @@ retry:
 			wait_event_interruptible(binder_user_error_wait,
 						 binder_stop_on_user_error < 2);
 		}
-		binder_set_nice(proc->default_priority);
+		binder_set_priority(proc->default_priority);
 		if (non_block) {
 			if (!binder_has_proc_work(proc, thread))
 				ret = -EAGAIN;
@@ -2229,7 +2550,7 @@ retry:
 				     proc->pid, thread->pid);
 
 			list_del(&w->entry);
-			kfree(w);
+			kmem_cache_free(binder_work_cachep, w);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 		} break;
 		case BINDER_WORK_NODE: {
@@ -2342,13 +2663,7 @@ retry:
 			struct binder_node *target_node = t->buffer->target_node;
 			tr.target.ptr = target_node->ptr;
 			tr.cookie =  target_node->cookie;
-			t->saved_priority = task_nice(current);
-			if (t->priority < target_node->min_priority &&
-			    !(t->flags & TF_ONE_WAY))
-				binder_set_nice(t->priority);
-			else if (!(t->flags & TF_ONE_WAY) ||
-				 t->saved_priority > target_node->min_priority)
-				binder_set_nice(target_node->min_priority);
+			binder_transaction_priority(t, target_node);
 			cmd = BR_TRANSACTION;
 		} else {
 			tr.target.ptr = 0;
@@ -2403,7 +2718,7 @@ retry:
 			thread->transaction_stack = t;
 		} else {
 			t->buffer->transaction = NULL;
-			kfree(t);
+			kmem_cache_free(binder_transaction_cachep, t);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION);
 		}
 		break;
@@ -2447,14 +2762,14 @@ static void binder_release_work(struct list_head *list)
 					"undelivered transaction %d\n",
 					t->debug_id);
 				t->buffer->transaction = NULL;
-				kfree(t);
+				kmem_cache_free(binder_transaction_cachep, t);
 				binder_stats_deleted(BINDER_STAT_TRANSACTION);
 			}
 		} break;
 		case BINDER_WORK_TRANSACTION_COMPLETE: {
 			binder_debug(BINDER_DEBUG_DEAD_TRANSACTION,
 				"undelivered TRANSACTION_COMPLETE\n");
-			kfree(w);
+			kmem_cache_free(binder_work_cachep, w);
 			binder_stats_deleted(BINDER_STAT_TRANSACTION_COMPLETE);
 		} break;
 		case BINDER_WORK_DEAD_BINDER_AND_CLEAR:
@@ -2870,9 +3185,11 @@ static int binder_open(struct inode *nodp, struct file *filp)
 		return -ENOMEM;
 	get_task_struct(current);
 	proc->tsk = current;
+	mutex_init(&proc->alloc_lock);
+	proc->tmp_ref = 1;
 	INIT_LIST_HEAD(&proc->todo);
 	init_waitqueue_head(&proc->wait);
-	proc->default_priority = task_nice(current);
+	proc->default_priority = binder_get_priority(current);
 
 	binder_lock(__func__);
 
@@ -2980,12 +3297,13 @@ static void binder_deferred_release(struct binder_proc *proc)
 	struct binder_transaction *t;
 	struct rb_node *n;
 	int threads, nodes, incoming_refs, outgoing_refs, buffers,
-		active_transactions, page_count;
+		active_transactions;
 
 	BUG_ON(proc->vma);
 	BUG_ON(proc->files);
 
 	hlist_del(&proc->proc_node);
+	proc->is_dead = true;
 
 	if (binder_context_mgr_node && binder_context_mgr_node->proc == proc) {
 		binder_debug(BINDER_DEBUG_DEAD_BINDER,
@@ -3027,11 +3345,17 @@ static void binder_deferred_release(struct binder_proc *proc)
 	binder_release_work(&proc->todo);
 	binder_release_work(&proc->delivered_death);
 
+	/* in-flight buffers are freed by their transaction when it fails */
+	mutex_lock(&proc->alloc_lock);
 	buffers = 0;
-	while ((n = rb_first(&proc->allocated_buffers))) {
+	n = rb_first(&proc->allocated_buffers);
+	while (n) {
 		struct binder_buffer *buffer;
 
 		buffer = rb_entry(n, struct binder_buffer, rb_node);
+		n = rb_next(n);
+		if (buffer->in_flight)
+			continue;
 
 		t = buffer->transaction;
 		if (t) {
@@ -3045,39 +3369,14 @@ static void binder_deferred_release(struct binder_proc *proc)
 		binder_free_buf(proc, buffer);
 		buffers++;
 	}
-
-	binder_stats_deleted(BINDER_STAT_PROC);
-
-	page_count = 0;
-	if (proc->pages) {
-		int i;
-
-		for (i = 0; i < proc->buffer_size / PAGE_SIZE; i++) {
-			void *page_addr;
-
-			if (!proc->pages[i])
-				continue;
-
-			page_addr = proc->buffer + i * PAGE_SIZE;
-			binder_debug(BINDER_DEBUG_BUFFER_ALLOC,
-				     "%s: %d: page %d at %p not freed\n",
-				     __func__, proc->pid, i, page_addr);
-			unmap_kernel_range((unsigned long)page_addr, PAGE_SIZE);
-			__free_page(proc->pages[i]);
-			page_count++;
-		}
-		kfree(proc->pages);
-		vfree(proc->buffer);
-	}
-
-	put_task_struct(proc->tsk);
+	mutex_unlock(&proc->alloc_lock);
 
 	binder_debug(BINDER_DEBUG_OPEN_CLOSE,
-		     "%s: %d threads %d, nodes %d (ref %d), refs %d, active transactions %d, buffers %d, pages %d\n",
+		     "%s: %d threads %d, nodes %d (ref %d), refs %d, active transactions %d, buffers %d\n",
 		     __func__, proc->pid, threads, nodes, incoming_refs,
-		     outgoing_refs, active_transactions, buffers, page_count);
+		     outgoing_refs, active_transactions, buffers);
 
-	kfree(proc);
+	binder_proc_dec_tmpref(proc);
 }
 
 static void binder_deferred_func(struct work_struct *work)
@@ -3138,13 +3437,14 @@ static void print_binder_transaction(struct seq_file *m, const char *prefix,
 				     struct binder_transaction *t)
 {
 	seq_printf(m,
-		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %ld r%d",
+		   "%s %d: %p from %d:%d to %d:%d code %x flags %x pri %u:%d r%d",
 		   prefix, t->debug_id, t,
 		   t->from ? t->from->proc->pid : 0,
 		   t->from ? t->from->pid : 0,
 		   t->to_proc ? t->to_proc->pid : 0,
 		   t->to_thread ? t->to_thread->pid : 0,
-		   t->code, t->flags, t->priority, t->need_reply);
+		   t->code, t->flags, t->priority.sched_policy,
+		   t->priority.prio, t->need_reply);
 	if (t->buffer == NULL) {
 		seq_puts(m, " buffer free\n");
 		return;
@@ -3295,9 +3595,13 @@ static void print_binder_proc(struct seq_file *m,
 			print_binder_ref(m, rb_entry(n, struct binder_ref,
 						     rb_node_desc));
 	}
+	if (!binder_debug_no_lock)
+		mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		print_binder_buffer(m, "  buffer",
 				    rb_entry(n, struct binder_buffer, rb_node));
+	if (!binder_debug_no_lock)
+		mutex_unlock(&proc->alloc_lock);
 	list_for_each_entry(w, &proc->todo, entry)
 		print_binder_work(m, "  ", "  pending transaction", w);
 	list_for_each_entry(w, &proc->delivered_death, entry) {
@@ -3427,9 +3731,14 @@ static void print_binder_proc_stats(struct seq_file *m,
 	seq_printf(m, "  refs: %d s %d w %d\n", count, strong, weak);
 
 	count = 0;
+	if (!binder_debug_no_lock)
+		mutex_lock(&proc->alloc_lock);
 	for (n = rb_first(&proc->allocated_buffers); n != NULL; n = rb_next(n))
 		count++;
+	if (!binder_debug_no_lock)
+		mutex_unlock(&proc->alloc_lock);
 	seq_printf(m, "  buffers: %d\n", count);
+	seq_printf(m, "  warm pages: %d\n", proc->warm_pages);
 
 	count = 0;
 	list_for_each_entry(w, &proc->todo, entry) {
@@ -3519,6 +3828,20 @@ static int binder_proc_show(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static int binder_alloc_latency_show(struct seq_file *m, void *unused)
+{
+	int i;
+
+	seq_puts(m, "binder buffer allocation latency:\n");
+	seq_printf(m, "  <1us: %d\n", atomic_read(&binder_alloc_lat[0]));
+	for (i = 1; i < BINDER_ALLOC_LAT_BUCKETS - 1; i++)
+		seq_printf(m, "  %uus-%uus: %d\n", 1U << (i - 1), 1U << i,
+			   atomic_read(&binder_alloc_lat[i]));
+	seq_printf(m, "  >=%uus: %d\n", 1U << (i - 1),
+		   atomic_read(&binder_alloc_lat[i]));
+	return 0;
+}
+
 static void print_binder_transaction_log_entry(struct seq_file *m,
 					struct binder_transaction_log_entry *e)
 {
@@ -3565,11 +3888,19 @@ BINDER_DEBUG_ENTRY(state);
 BINDER_DEBUG_ENTRY(stats);
 BINDER_DEBUG_ENTRY(transactions);
 BINDER_DEBUG_ENTRY(transaction_log);
+BINDER_DEBUG_ENTRY(alloc_latency);
 
 static int __init binder_init(void)
 {
 	int ret;
 
+	/* the two objects of every transaction, off the kmalloc caches */
+	binder_transaction_cachep = KMEM_CACHE(binder_transaction,
+					       SLAB_HWCACHE_ALIGN);
+	binder_work_cachep = KMEM_CACHE(binder_work, 0);
+	if (!binder_transaction_cachep || !binder_work_cachep)
+		return -ENOMEM;
+
 	binder_deferred_workqueue = create_singlethread_workqueue("binder");
 	if (!binder_deferred_workqueue)
 		return -ENOMEM;
@@ -3605,6 +3936,11 @@ static int __init binder_init(void)
 				    binder_debugfs_dir_entry_root,
 				    &binder_transaction_log_failed,
 				    &binder_transaction_log_fops);
+		debugfs_create_file("alloc_latency",
+				    S_IRUGO,
+				    binder_debugfs_dir_entry_root,
+				    NULL,
+				    &binder_alloc_latency_fops);
 	}
 	return ret;
 }
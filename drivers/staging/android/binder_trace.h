@@ -131,6 +131,33 @@ TRACE_EVENT(binder_transaction,
 		  __entry->reply, __entry->flags, __entry->code)
 );
 
+TRACE_EVENT(binder_set_priority,
+	TP_PROTO(int proc, int thread, unsigned int old_policy, int old_prio,
+		 unsigned int new_policy, int new_prio),
+	TP_ARGS(proc, thread, old_policy, old_prio, new_policy, new_prio),
+
+	TP_STRUCT__entry(
+		__field(int, proc)
+		__field(int, thread)
+		__field(unsigned int, old_policy)
+		__field(int, old_prio)
+		__field(unsigned int, new_policy)
+		__field(int, new_prio)
+	),
+	TP_fast_assign(
+		__entry->proc = proc;
+		__entry->thread = thread;
+		__entry->old_policy = old_policy;
+		__entry->old_prio = old_prio;
+		__entry->new_policy = new_policy;
+		__entry->new_prio = new_prio;
+	),
+	TP_printk("proc=%d thread=%d old=%u:%d => new=%u:%d",
+		  __entry->proc, __entry->thread,
+		  __entry->old_policy, __entry->old_prio,
+		  __entry->new_policy, __entry->new_prio)
+);
+
 TRACE_EVENT(binder_transaction_received,
 	TP_PROTO(struct binder_transaction *t),
 	TP_ARGS(t),
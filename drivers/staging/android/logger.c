@@ -29,10 +29,27 @@
 #include <linux/time.h>
 #include <linux/vmalloc.h>
 #include <linux/aio.h>
+#include <linux/percpu.h>
+#include <linux/timer.h>
+#include <linux/hash.h>
 #include "logger.h"
 
 #include <asm/ioctls.h>
 
+#define LOGGER_UID_HINT_BITS	4
+
+/**
+ * struct logger_uid_hint - where the newest entry of one writer uid is
+ * @euid:	The writer's effective UID
+ * @off:	Offset of its newest entry in the buffer
+ * @valid:	The slot has been written
+ */
+struct logger_uid_hint {
+	kuid_t			euid;
+	size_t			off;
+	bool			valid;
+};
+
 /**
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  * @buffer:	The actual ring buffer
@@ -44,6 +61,8 @@
  * @head:	The head, or location that readers start reading at.
  * @size:	The size of the log
  * @logs:	The list of log channels
+ * @wake_timer:	Delivers the coalesced wakeup of @wq
+ * @uid_hint:	Newest entry per writer uid, hashed, for filtered readers
  *
  * This structure lives from module insertion until module removal, so it does
  * not need additional reference counting. The structure is protected by the
@@ -59,10 +78,34 @@ struct logger_log {
 	size_t			head;
 	size_t			size;
 	struct list_head	logs;
+	struct timer_list	wake_timer;
+	struct logger_uid_hint	uid_hint[1 << LOGGER_UID_HINT_BITS];
 };
 
 static LIST_HEAD(log_list);
 
+/**
+ * struct logger_stage - per-CPU staging area for one entry's payload
+ * @mutex:	Held by the writer filling @buf
+ * @buf:	The payload, copied in from user space
+ *
+ * Writers copy their payload here, taking any page faults, before they
+ * take log->mutex; under it they only memcpy into the ring.
+ */
+struct logger_stage {
+	struct mutex		mutex;
+	unsigned char		buf[LOGGER_ENTRY_MAX_PAYLOAD];
+};
+
+static struct logger_stage __percpu *logger_stages;
+
+/*
+ * Readers are woken at most once per wake_delay_ms rather than once
+ * per entry; 0 wakes them on every write.
+ */
+static unsigned int logger_wake_delay_ms = 10;
+module_param_named(wake_delay_ms, logger_wake_delay_ms, uint, 0644);
+
 
 /**
  * struct logger_reader - a logging device open for reading
@@ -237,13 +280,38 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	return count + get_user_hdr_len(reader->r_ver);
 }
 
+static struct logger_uid_hint *get_uid_hint(struct logger_log *log,
+					     kuid_t euid)
+{
+	return &log->uid_hint[hash_32(__kuid_val(euid),
+				      LOGGER_UID_HINT_BITS)];
+}
+
+/*
+ * in_window - is 'from' <= 'c' < 'to', accounting for wrapping
+ */
+static inline int in_window(struct logger_log *log, size_t from, size_t to,
+			    size_t c)
+{
+	return logger_offset(log, c - from) < logger_offset(log, to - from);
+}
+
 /*
  * get_next_entry_by_uid - Starting at 'off', returns an offset into
  * 'log->buffer' which contains the first entry readable by 'euid'
+ *
+ * If the newest entry 'euid' wrote is not after 'off', there is none
+ * to find and the walk is skipped.
  */
 static size_t get_next_entry_by_uid(struct logger_log *log,
 		size_t off, kuid_t euid)
 {
+	struct logger_uid_hint *hint = get_uid_hint(log, euid);
+
+	if (hint->valid && uid_eq(hint->euid, euid) &&
+	    !in_window(log, off, log->w_off, hint->off))
+		return log->w_off;
+
 	while (off != log->w_off) {
 		struct logger_entry *entry;
 		struct logger_entry scratch;
@@ -429,57 +497,51 @@ static void do_write_log(struct logger_log *log, const void *buf, size_t count)
 }
 
 /*
- * do_write_log_user - writes 'len' bytes from the user-space buffer 'buf' to
- * the log 'log'
- *
- * The caller needs to hold log->mutex.
- *
- * Returns 'count' on success, negative error code on failure.
+ * logger_wake_readers - wake the readers of 'log', right away or once
+ * the coalescing delay has passed
  */
-static ssize_t do_write_log_from_user(struct logger_log *log,
-				      const void __user *buf, size_t count)
+static void logger_wake_readers(struct logger_log *log)
 {
-	size_t len;
+	unsigned int delay = ACCESS_ONCE(logger_wake_delay_ms);
 
-	len = min(count, log->size - log->w_off);
-	if (len && copy_from_user(log->buffer + log->w_off, buf, len))
-		return -EFAULT;
+	if (!waitqueue_active(&log->wq))
+		return;
 
-	if (count != len)
-		if (copy_from_user(log->buffer, buf + len, count - len))
-			/*
-			 * Note that by not updating w_off, this abandons the
-			 * portion of the new entry that *was* successfully
-			 * copied, just above.  This is intentional to avoid
-			 * message corruption from missing fragments.
-			 */
-			return -EFAULT;
+	if (!delay)
+		wake_up_interruptible(&log->wq);
+	else if (!timer_pending(&log->wake_timer))
+		mod_timer(&log->wake_timer, jiffies + msecs_to_jiffies(delay));
+}
 
-	log->w_off = logger_offset(log, log->w_off + count);
+static void logger_wake_timer_fn(unsigned long data)
+{
+	struct logger_log *log = (struct logger_log *) data;
 
-	return count;
+	wake_up_interruptible(&log->wq);
 }
 
 /*
  * logger_aio_write - our write method, implementing support for write(),
  * writev(), and aio_write(). Writes are our fast path, and we try to optimize
  * them above all else.
+ *
+ * The payload is gathered from user space into this CPU's staging area
+ * first, so log->mutex is only held to timestamp the entry and copy it
+ * into the ring; entries land in the log in timestamp order.
  */
 static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
+	struct logger_stage *stage;
+	struct logger_uid_hint *hint;
 	size_t orig;
 	struct logger_entry header;
 	struct timespec now;
 	ssize_t ret = 0;
 
-	now = current_kernel_time();
-
 	header.pid = current->tgid;
 	header.tid = current->pid;
-	header.sec = now.tv_sec;
-	header.nsec = now.tv_nsec;
 	header.euid = current_euid();
 	header.len = min_t(size_t, iocb->ki_left, LOGGER_ENTRY_MAX_PAYLOAD);
 	header.hdr_size = sizeof(struct logger_entry);
@@ -488,43 +550,50 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 	if (unlikely(!header.len))
 		return 0;
 
+	stage = per_cpu_ptr(logger_stages, raw_smp_processor_id());
+	mutex_lock(&stage->mutex);
+
+	while (nr_segs-- > 0 && ret < header.len) {
+		/* figure out how much of this vector we can keep */
+		size_t len = min_t(size_t, iov->iov_len, header.len - ret);
+
+		if (len && copy_from_user(stage->buf + ret, iov->iov_base,
+					  len)) {
+			mutex_unlock(&stage->mutex);
+			return -EFAULT;
+		}
+
+		iov++;
+		ret += len;
+	}
+	header.len = ret;
+
 	mutex_lock(&log->mutex);
 
+	now = current_kernel_time();
+	header.sec = now.tv_sec;
+	header.nsec = now.tv_nsec;
+
 	orig = log->w_off;
 
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
-	 * entry after (what will be) the new write offset. We do this now
-	 * because if we partially fail, we can end up with clobbered log
-	 * entries that encroach on readable buffer.
+	 * entry after (what will be) the new write offset.
 	 */
 	fix_up_readers(log, sizeof(struct logger_entry) + header.len);
 
 	do_write_log(log, &header, sizeof(struct logger_entry));
+	do_write_log(log, stage->buf, header.len);
 
-	while (nr_segs-- > 0) {
-		size_t len;
-		ssize_t nr;
-
-		/* figure out how much of this vector we can keep */
-		len = min_t(size_t, iov->iov_len, header.len - ret);
-
-		/* write out this segment's payload */
-		nr = do_write_log_from_user(log, iov->iov_base, len);
-		if (unlikely(nr < 0)) {
-			log->w_off = orig;
-			mutex_unlock(&log->mutex);
-			return nr;
-		}
-
-		iov++;
-		ret += nr;
-	}
+	hint = get_uid_hint(log, header.euid);
+	hint->euid = header.euid;
+	hint->off = orig;
+	hint->valid = true;
 
 	mutex_unlock(&log->mutex);
+	mutex_unlock(&stage->mutex);
 
-	/* wake up any blocked readers */
-	wake_up_interruptible(&log->wq);
+	logger_wake_readers(log);
 
 	return ret;
 }
@@ -774,6 +843,8 @@ static int __init create_log(char *log_name, int size)
 	log->misc.parent = NULL;
 
 	init_waitqueue_head(&log->wq);
+	setup_timer(&log->wake_timer, logger_wake_timer_fn,
+		    (unsigned long) log);
 	INIT_LIST_HEAD(&log->readers);
 	mutex_init(&log->mutex);
 	log->w_off = 0;
@@ -844,9 +915,38 @@ unsigned char *get_system_log_buf_addr(void)
 	return NULL;
 }
 
+/*
+ * For crash dumps: hand each log to fn, oldest entry first, as the ring
+ * up to its end and the part wrapped around to its start. Only called
+ * with everything else stopped, so log->mutex is not taken.
+ */
+void logger_panic_walk(void (*fn)(void *data, const char *name,
+				  const unsigned char *a, size_t a_len,
+				  const unsigned char *b, size_t b_len),
+		       void *data)
+{
+	struct logger_log *log;
+
+	list_for_each_entry(log, &log_list, logs) {
+		if (log->head <= log->w_off)
+			fn(data, log->misc.name, log->buffer + log->head,
+			   log->w_off - log->head, NULL, 0);
+		else
+			fn(data, log->misc.name, log->buffer + log->head,
+			   log->size - log->head, log->buffer, log->w_off);
+	}
+}
+
 static int __init logger_init(void)
 {
 	int ret;
+	int cpu;
+
+	logger_stages = alloc_percpu(struct logger_stage);
+	if (!logger_stages)
+		return -ENOMEM;
+	for_each_possible_cpu(cpu)
+		mutex_init(&per_cpu_ptr(logger_stages, cpu)->mutex);
 
 	ret = create_log(LOGGER_LOG_MAIN, 256*1024);
 	if (unlikely(ret))
@@ -875,11 +975,13 @@ static void __exit logger_exit(void)
 	list_for_each_entry_safe(current_log, next_log, &log_list, logs) {
 		/* we have to delete all the entry inside log_list */
 		misc_deregister(&current_log->misc);
+		del_timer_sync(&current_log->wake_timer);
 		vfree(current_log->buffer);
 		kfree(current_log->misc.name);
 		list_del(&current_log->logs);
 		kfree(current_log);
 	}
+	free_percpu(logger_stages);
 }
 
 
@@ -53,6 +53,18 @@
  * and processes may not get killed until the normal oom killer is triggered.
  *
  * LMK kill count is exported via debugfs ([debugfs]/almk/stat).
+ * With CONFIG_ANDROID_LMK_KILL_STATS every kill is also recorded as a
+ * struct lmk_kill_record, read in binary from [debugfs]/almk/kills and
+ * emitted as the almk_kill_stat tracepoint, once the victim's memory is
+ * freed.
+ *
+ * With CONFIG_ANDROID_LMK_VMPRESSURE the kills are triggered by global
+ * vmpressure notifications instead of the shrinker, while
+ * /sys/module/lowmemorykiller/parameters/vmpressure_mode is set. The
+ * minfree/adj thresholds are checked on every event at or above
+ * vmpressure_level (0 low, 1 medium, 2 critical), and the victim is
+ * taken from a list of processes kept sorted by oom_score_adj on fork,
+ * exit and oom_score_adj changes rather than from a walk of all tasks.
  *
  * Copyright (C) 2007-2008 Google, Inc.
  * Copyright (C) 2014 Sony Mobile Communications AB.
@@ -75,6 +87,7 @@
 #include <linux/module.h>
 #include <linux/kernel.h>
 #include <linux/mm.h>
+#include <linux/memcontrol.h>
 #include <linux/oom.h>
 #include <linux/sched.h>
 #include <linux/swap.h>
@@ -85,6 +98,12 @@
 #include <linux/sort.h>
 #include <linux/lowmemorykiller.h>
 #include <linux/string.h>
+#include <linux/vmpressure.h>
+#include <linux/ktime.h>
+#include <linux/uaccess.h>
+#ifdef CONFIG_ION_CMA_PREFETCH
+#include <linux/broadcom/bcm_ion.h>
+#endif
 
 /*
  * See Documentation/trace/postprocess/trace-almk-postprocess.pl
@@ -93,6 +112,8 @@
 #define CREATE_TRACE_POINTS
 #include <trace/events/almk.h>
 
+EXPORT_TRACEPOINT_SYMBOL_GPL(almk_kill_stat);
+
 static uint32_t lowmem_debug_level = 1;
 static short lowmem_adj[6] = {
 	0,
@@ -136,9 +157,64 @@ struct selected_task {
 
 static unsigned long lowmem_deathpending_timeout;
 
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+static bool vmpressure_mode = true;
+static int vmpressure_min_level = VMPRESSURE_MEDIUM;
+
+/* user processes, highest oom_score_adj first */
+static LIST_HEAD(lowmem_candidates);
+static DEFINE_SPINLOCK(lowmem_candidates_lock);
+/* last process killed from a vmpressure event, until it is released */
+static struct signal_struct *lowmem_victim;
+
+/* candidates looked at for one vmpressure kill */
+#define LOWMEM_SCAN_MAX	8
+
+static inline bool lowmem_vmpressure_mode(void)
+{
+	return vmpressure_mode;
+}
+#else
+static inline bool lowmem_vmpressure_mode(void)
+{
+	return false;
+}
+#endif
+
 static LIST_HEAD(lmk_reg_list);
 static DECLARE_RWSEM(lmk_reg_rwsem);
 
+/*
+ * Give the registered allocators a chance to free nr pages before a
+ * process is killed, returns the number of pages they freed.
+ */
+static int lowmem_reclaim_others(int nr)
+{
+	struct reg_lmk *reg_lmk;
+	int freed = 0;
+
+	if (nr <= 0)
+		return 0;
+
+	down_read(&lmk_reg_rwsem);
+	list_for_each_entry(reg_lmk, &lmk_reg_list, list) {
+		struct lmk_op op = {
+			.op = LMK_OP_RECLAIM,
+			.nr = nr - freed,
+		};
+		int ret;
+
+		ret = reg_lmk->cbk(reg_lmk, &op);
+		if (ret > 0)
+			freed += ret;
+		if (freed >= nr)
+			break;
+	}
+	up_read(&lmk_reg_rwsem);
+
+	return freed;
+}
+
 static struct dentry *lmk_debug_dir;
 
 /* Light weight accounting of LMK stats. */
@@ -151,6 +227,26 @@ struct lmk_stat {
 
 DEFINE_PER_CPU(struct lmk_stat, lmk_stats);
 
+#ifdef CONFIG_ANDROID_LMK_KILL_STATS
+/* victims whose mm is still to be torn down */
+#define LMK_PENDING_MAX		16
+#define LMK_PENDING_TIMEOUT	(5 * HZ)
+/* completed records, a power of 2 */
+#define LMK_RING_SIZE		256
+
+struct lmk_pending {
+	struct mm_struct *mm;
+	ktime_t trigger;
+	unsigned long expires;
+	struct lmk_kill_record rec;
+};
+
+static struct lmk_pending lmk_pending[LMK_PENDING_MAX];
+static struct lmk_kill_record lmk_ring[LMK_RING_SIZE];
+static u64 lmk_ring_seq;
+static DEFINE_SPINLOCK(lmk_record_lock);
+#endif
+
 #define lowmem_print(level, x...)			\
 	do {						\
 		if (lowmem_debug_level >= (level))	\
@@ -199,46 +295,16 @@ int selected_cmp(const void *a, const void *b)
 }
 #endif
 
-#ifdef CONFIG_SONY_JPROBE_LMK_HOOK
-#define JPROBE_LINE_SZ 80
-static char jprobe_buf[JPROBE_LINE_SZ];
-noinline void idd_jprobe_lmk_hook(char *buf)
-{
-	asm("");
-}
-#endif
-
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+/*
+ * Pages that are free, and file pages that are cheap to reclaim, as
+ * LMK sees them.
+ */
+static void lowmem_other_pages(int *other_free, int *other_file,
+				int *cma_free, int *cma_file)
 {
-	struct task_struct *tsk;
-#ifndef CONFIG_ADAPTIVE_LMK
-	struct task_struct *selected = NULL;
-#else
-	struct selected_task selected[MAX_KILL_PER_RUN] = {{0, 0, 0},};
-#endif
-	struct reg_lmk *reg_lmk;
-	int rem = 0;
-	int active_anon;
-	int inactive_anon;
-	int active_file;
-	int inactive_file;
-	int tasksize;
-	int i;
-	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
-	int minfree = 0;
-	int cma_free = 0;
-	int cma_file = 0;
-#ifndef CONFIG_ADAPTIVE_LMK
-	int selected_tasksize = 0;
-	int selected_oom_score_adj;
-#else
-	int select_index = 0;
-	int session_kill_count = 0;
-#endif
-	int anon_other = 0;
-	int array_size = ARRAY_SIZE(lowmem_adj);
 	int nr_swap_pages = get_nr_swap_pages();
-	int other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages + nr_swap_pages;
+
+	*other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages + nr_swap_pages;
 	/*
 	 * Swap cached pages are accounted as
 	 * FILE pages by the kernel. But as
@@ -246,7 +312,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	 * runs, we should not consider them
 	 * as reclaimable pages.
 	 */
-	int other_file = global_page_state(NR_FILE_PAGES) -
+	*other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM) -
 						total_swapcache_pages();
 
@@ -281,24 +347,205 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	 * Tests show that this works well when the CMA
 	 * size is not huge compared to available memory.
 	 */
-	cma_free = global_page_state(NR_FREE_CMA_PAGES);
-	cma_file = global_page_state(NR_CMA_INACTIVE_FILE)
+	*cma_free = global_page_state(NR_FREE_CMA_PAGES);
+	*cma_file = global_page_state(NR_CMA_INACTIVE_FILE)
 		+ global_page_state(NR_CMA_ACTIVE_FILE);
-	other_free -= cma_free;
-	other_file -= cma_file;
+	*other_free -= *cma_free;
+	*other_file -= *cma_file;
+#ifdef CONFIG_ION_CMA_PREFETCH
+	/*
+	 * CMA pages held by an ion prefetch are given back on the next ion
+	 * allocation or by the ion shrinker. They are out of NR_FREE_PAGES
+	 * already, so count them as free CMA without taking them off
+	 * other_free a second time.
+	 */
+	*cma_free += ion_cma_prefetch_pages();
+#endif
 #endif
+}
+
+/*
+ * The lowest oom_score_adj to kill for, OOM_SCORE_ADJ_MAX + 1 if memory
+ * is not low. *minfree is set to the threshold that was crossed.
+ */
+static short lowmem_min_score_adj(int other_free, int other_file,
+				int *minfree)
+{
+	int array_size = ARRAY_SIZE(lowmem_adj);
+	int i;
 
 	if (lowmem_adj_size < array_size)
 		array_size = lowmem_adj_size;
 	if (lowmem_minfree_size < array_size)
 		array_size = lowmem_minfree_size;
 	for (i = 0; i < array_size; i++) {
-		minfree = lowmem_minfree[i];
-		if (other_free < minfree && other_file < minfree) {
-			min_score_adj = lowmem_adj[i];
+		*minfree = lowmem_minfree[i];
+		if (other_free < *minfree && other_file < *minfree)
+			return lowmem_adj[i];
+	}
+
+	return OOM_SCORE_ADJ_MAX + 1;
+}
+
+#ifdef CONFIG_ANDROID_LMK_KILL_STATS
+/* lmk_record_lock held */
+static void lmk_record_push(struct lmk_pending *pending)
+{
+	lmk_ring[lmk_ring_seq & (LMK_RING_SIZE - 1)] = pending->rec;
+	lmk_ring_seq++;
+	trace_almk_kill_stat(&pending->rec);
+	pending->mm = NULL;
+}
+
+/*
+ * Start the record of a kill, and flag the victim's mm so that
+ * lowmem_exit_mmap() completes it. Called before the SIGKILL is sent.
+ */
+static void lmk_record_kill(struct task_struct *tsk, ktime_t trigger,
+			int tasksize, short oom_score_adj, short min_score_adj,
+			int other_free, int other_file, int index, int count)
+{
+	struct lmk_pending *pending = NULL;
+	struct task_struct *p;
+	int i;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return;
+
+	spin_lock(&lmk_record_lock);
+	for (i = 0; i < LMK_PENDING_MAX; i++) {
+		if (lmk_pending[i].mm &&
+		    time_after(jiffies, lmk_pending[i].expires))
+			lmk_record_push(&lmk_pending[i]);
+		if (!lmk_pending[i].mm && !pending)
+			pending = &lmk_pending[i];
+	}
+	if (pending && !lowmem_mm_victim(p->mm)) {
+		memset(&pending->rec, 0, sizeof(pending->rec));
+		pending->mm = p->mm;
+		pending->trigger = trigger;
+		pending->expires = jiffies + LMK_PENDING_TIMEOUT;
+		pending->rec.trigger_ns = ktime_to_ns(trigger);
+		pending->rec.kill_us = ktime_us_delta(ktime_get(), trigger);
+		pending->rec.tasksize = tasksize;
+		pending->rec.pid = p->pid;
+		pending->rec.oom_score_adj = oom_score_adj;
+		pending->rec.min_score_adj = min_score_adj;
+		pending->rec.other_free = other_free;
+		pending->rec.other_file = other_file;
+		pending->rec.kill_index = index;
+		pending->rec.kill_count = count;
+		strlcpy(pending->rec.comm, p->comm, sizeof(pending->rec.comm));
+		set_bit(MMF_LMK_VICTIM, &p->mm->flags);
+	}
+	spin_unlock(&lmk_record_lock);
+	task_unlock(p);
+}
+
+/* Called from mmput() instead of exit_mmap() for a flagged mm */
+void lowmem_exit_mmap(struct mm_struct *mm)
+{
+	unsigned long rss = get_mm_rss(mm);
+	ktime_t now;
+	int i;
+
+	exit_mmap(mm);
+	now = ktime_get();
+
+	spin_lock(&lmk_record_lock);
+	for (i = 0; i < LMK_PENDING_MAX; i++) {
+		if (lmk_pending[i].mm != mm)
+			continue;
+		lmk_pending[i].rec.freed = rss;
+		lmk_pending[i].rec.free_us =
+			ktime_us_delta(now, lmk_pending[i].trigger);
+		lmk_record_push(&lmk_pending[i]);
+		break;
+	}
+	spin_unlock(&lmk_record_lock);
+}
+
+/* The file position counts records, in bytes, since boot */
+static ssize_t lmk_kills_read(struct file *file, char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	const size_t size = sizeof(struct lmk_kill_record);
+	struct lmk_kill_record rec;
+	ssize_t copied = 0;
+	u64 seq = *ppos;
+
+	do_div(seq, size);
+	while (count - copied >= size) {
+		spin_lock(&lmk_record_lock);
+		if (seq + LMK_RING_SIZE < lmk_ring_seq)
+			seq = lmk_ring_seq - LMK_RING_SIZE;
+		if (seq >= lmk_ring_seq) {
+			spin_unlock(&lmk_record_lock);
 			break;
 		}
+		rec = lmk_ring[seq & (LMK_RING_SIZE - 1)];
+		spin_unlock(&lmk_record_lock);
+
+		if (copy_to_user(buf + copied, &rec, size))
+			return copied ? copied : -EFAULT;
+		copied += size;
+		seq++;
 	}
+
+	*ppos = seq * size;
+	return copied;
+}
+
+static const struct file_operations lmk_kills_fops = {
+	.open           = simple_open,
+	.read           = lmk_kills_read,
+	.llseek         = default_llseek,
+};
+#else
+static inline void lmk_record_kill(struct task_struct *tsk, ktime_t trigger,
+			int tasksize, short oom_score_adj, short min_score_adj,
+			int other_free, int other_file, int index, int count)
+{
+}
+#endif
+
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	struct task_struct *tsk;
+#ifndef CONFIG_ADAPTIVE_LMK
+	struct task_struct *selected = NULL;
+#else
+	struct selected_task selected[MAX_KILL_PER_RUN] = {{0, 0, 0},};
+#endif
+	struct reg_lmk *reg_lmk;
+	int rem = 0;
+	int active_anon;
+	int inactive_anon;
+	int active_file;
+	int inactive_file;
+	int tasksize;
+	short min_score_adj;
+	int minfree = 0;
+	int cma_free = 0;
+	int cma_file = 0;
+#ifndef CONFIG_ADAPTIVE_LMK
+	int selected_tasksize = 0;
+	int selected_oom_score_adj;
+	bool selected_over = false;
+#else
+	int select_index = 0;
+	int session_kill_count = 0;
+#endif
+	int anon_other = 0;
+	int other_free, other_file;
+	ktime_t trigger;
+
+	if (lowmem_vmpressure_mode())
+		return 0;
+
+	lowmem_other_pages(&other_free, &other_file, &cma_free, &cma_file);
+	min_score_adj = lowmem_min_score_adj(other_free, other_file, &minfree);
 	if (sc->nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %hd\n",
 				sc->nr_to_scan, sc->gfp_mask, other_free,
@@ -313,7 +560,7 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	list_for_each_entry(reg_lmk, &lmk_reg_list, list) {
 		int ret;
 		struct lmk_op op = {
-			.op = 0,
+			.op = LMK_OP_PAGES,
 		};
 
 		ret = reg_lmk->cbk(reg_lmk, &op);
@@ -334,6 +581,15 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     sc->nr_to_scan, sc->gfp_mask, rem);
 		return rem;
 	}
+	trigger = ktime_get();
+	if (lowmem_reclaim_others(minfree - other_free) >=
+	    minfree - other_free) {
+		lowmem_print(3, "lowmem_shrink reclaimed %d pages, no kill\n",
+			     minfree - other_free);
+		trace_almk_end(-1, 0, current->comm, minfree, other_free,
+				other_file, cma_free, cma_file, sc->gfp_mask);
+		return rem;
+	}
 #ifndef CONFIG_ADAPTIVE_LMK
 	selected_oom_score_adj = min_score_adj;
 #endif
@@ -346,6 +602,9 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	for_each_process(tsk) {
 		struct task_struct *p;
 		short oom_score_adj;
+#ifndef CONFIG_ADAPTIVE_LMK
+		bool over;
+#endif
 
 		if (tsk->flags & PF_KTHREAD)
 			continue;
@@ -374,18 +633,27 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			continue;
 
 #ifndef CONFIG_ADAPTIVE_LMK
+		/*
+		 * Of the same adj, tasks of memory cgroups over their soft
+		 * limit go first: those are the groups under pressure.
+		 */
+		over = mem_cgroup_task_over_soft_limit(p);
 		if (selected) {
 			if (oom_score_adj < selected_oom_score_adj)
 				continue;
 			if (oom_score_adj == selected_oom_score_adj &&
-				tasksize <= selected_tasksize)
+				(over < selected_over ||
+				 (over == selected_over &&
+				  tasksize <= selected_tasksize)))
 				continue;
 		}
 		selected = p;
 		selected_tasksize = tasksize;
 		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
+		selected_over = over;
+		lowmem_print(2, "select '%s' (%d), adj %hd, size %d%s, to kill\n",
+			     p->comm, p->pid, oom_score_adj, tasksize,
+			     over ? ", over soft limit" : "");
 #else
 		if (select_index == session_kill_count) {
 			if (session_kill_count != 1)
@@ -440,16 +708,9 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 			     (long)(PAGE_SIZE / 1024),
 			     anon_other * (long)(PAGE_SIZE / 1024));
 		lowmem_deathpending_timeout = jiffies + HZ;
-#ifdef CONFIG_SONY_JPROBE_LMK_HOOK
-		scnprintf(jprobe_buf, JPROBE_LINE_SZ, "%d \"%s\" %d \"%s\" %d %d %d %d %d %d",
-			current->pid, current->comm, selected->pid,
-			selected->comm, selected_oom_score_adj,
-			selected_tasksize,
-			other_free,
-			other_file,
-			cma_free,
-			cma_file);
-#endif
+		lmk_record_kill(selected, trigger, selected_tasksize,
+				selected_oom_score_adj, min_score_adj,
+				other_free, other_file, 0, 1);
 		send_sig(SIGKILL, selected, 0);
 		this_cpu_inc(lmk_stats.kill_count);
 		set_tsk_thread_flag(selected, TIF_MEMDIE);
@@ -458,9 +719,6 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 				current->comm, minfree, other_free,
 				other_file, cma_free,
 				cma_file, sc->gfp_mask);
-#ifdef CONFIG_SONY_JPROBE_LMK_HOOK
-		idd_jprobe_lmk_hook(jprobe_buf);
-#endif
 	} else {
 		trace_almk_end(-1, 0, current->comm, minfree,
 				other_free, other_file,
@@ -493,13 +751,12 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 				anon_other * (long)(PAGE_SIZE / 1024));
 
 			lowmem_deathpending_timeout = jiffies + HZ;
+			lmk_record_kill(selected[i].task, trigger,
+					selected[i].tasksize,
+					selected[i].oom_score_adj,
+					min_score_adj, other_free, other_file,
+					i, select_index);
 			send_sig(SIGKILL, selected[i].task, 0);
-#ifdef CONFIG_SONY_JPROBE_LMK_HOOK
-			scnprintf(jprobe_buf, JPROBE_LINE_SZ, "%d \"%s\" %d \"%s\" %d %d",
-				current->pid, current->comm, selected->pid,
-				selected->comm, selected_oom_score_adj,
-				selected_tasksize);
-#endif
 			this_cpu_inc(lmk_stats.kill_count);
 			set_tsk_thread_flag(selected[i].task, TIF_MEMDIE);
 			rem -= selected[i].tasksize;
@@ -508,9 +765,6 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 				current->comm, minfree, other_free,
 				other_file, cma_free,
 				cma_file, sc->gfp_mask);
-#ifdef CONFIG_SONY_JPROBE_LMK_HOOK
-			idd_jprobe_lmk_hook(jprobe_buf);
-#endif
 		}
 	} else {
 		trace_almk_end(-1, 0, current->comm, minfree,
@@ -529,6 +783,169 @@ static struct shrinker lowmem_shrinker = {
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+void lowmem_adj_update(struct task_struct *tsk)
+{
+	struct signal_struct *sig = tsk->signal;
+	struct signal_struct *pos;
+	short oom_score_adj = sig->oom_score_adj;
+	unsigned long flags;
+
+	if (tsk->flags & PF_KTHREAD)
+		return;
+
+	/* callers hold irq-safe locks (siglock, tasklist_lock) */
+	spin_lock_irqsave(&lowmem_candidates_lock, flags);
+	list_del_init(&sig->lmk_node);
+	list_for_each_entry(pos, &lowmem_candidates, lmk_node) {
+		if (pos->oom_score_adj < oom_score_adj)
+			break;
+	}
+	list_add_tail(&sig->lmk_node, &pos->lmk_node);
+	spin_unlock_irqrestore(&lowmem_candidates_lock, flags);
+}
+
+void lowmem_adj_remove(struct signal_struct *sig)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&lowmem_candidates_lock, flags);
+	list_del_init(&sig->lmk_node);
+	if (lowmem_victim == sig)
+		lowmem_victim = NULL;
+	spin_unlock_irqrestore(&lowmem_candidates_lock, flags);
+}
+
+static void lowmem_vmpressure_kill(unsigned long level)
+{
+	struct task_struct *scan[LOWMEM_SCAN_MAX];
+	struct task_struct *selected = NULL;
+	struct signal_struct *sig;
+	int other_free, other_file;
+	int cma_free = 0;
+	int cma_file = 0;
+	int minfree = 0;
+	int tasksize;
+	int selected_tasksize = 0;
+	short min_score_adj;
+	short selected_oom_score_adj = 0;
+	int nr_scan = 0;
+	int i;
+	ktime_t trigger = ktime_get();
+
+	lowmem_other_pages(&other_free, &other_file, &cma_free, &cma_file);
+	min_score_adj = lowmem_min_score_adj(other_free, other_file, &minfree);
+	lowmem_print(3, "vmpressure level %lu, ofree %d %d, ma %hd\n",
+		     level, other_free, other_file, min_score_adj);
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1)
+		return;
+
+	/*
+	 * Only the head of the list can hold processes at or above
+	 * min_score_adj. Take references and look at their mm once the
+	 * list lock is dropped: task_lock nests outside of it.
+	 */
+	spin_lock_irq(&lowmem_candidates_lock);
+	if (lowmem_victim &&
+	    time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		spin_unlock_irq(&lowmem_candidates_lock);
+		trace_almk_end(-2, 0, current->comm, minfree, other_free,
+				other_file, cma_free, cma_file, 0);
+		return;
+	}
+	rcu_read_lock();
+	list_for_each_entry(sig, &lowmem_candidates, lmk_node) {
+		if (sig->oom_score_adj < min_score_adj ||
+		    nr_scan == LOWMEM_SCAN_MAX)
+			break;
+		scan[nr_scan] = sig->curr_target;
+		get_task_struct(scan[nr_scan++]);
+	}
+	rcu_read_unlock();
+	spin_unlock_irq(&lowmem_candidates_lock);
+
+	for (i = 0; i < nr_scan; i++) {
+		struct task_struct *p;
+		short oom_score_adj;
+
+		p = find_lock_task_mm(scan[i]);
+		if (!p)
+			continue;
+
+		oom_score_adj = p->signal->oom_score_adj;
+		tasksize = get_mm_rss(p->mm);
+		task_unlock(p);
+		if (tasksize <= 0 || oom_score_adj < min_score_adj)
+			continue;
+
+		if (selected) {
+			if (oom_score_adj < selected_oom_score_adj)
+				continue;
+			if (oom_score_adj == selected_oom_score_adj &&
+				tasksize <= selected_tasksize)
+				continue;
+		}
+		selected = scan[i];
+		selected_tasksize = tasksize;
+		selected_oom_score_adj = oom_score_adj;
+	}
+
+	if (selected) {
+		lowmem_print(1, "Killing '%s' (%d), adj %hd,\n" \
+				"   to free %ldkB on vmpressure level %lu because\n" \
+				"   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n" \
+				"   Free memory is %ldkB above reserved\n" \
+				"   cma free: %ldkB, cma file: %ldkB\n",
+			     selected->comm, selected->pid,
+			     selected_oom_score_adj,
+			     selected_tasksize * (long)(PAGE_SIZE / 1024),
+			     level,
+			     other_file * (long)(PAGE_SIZE / 1024),
+			     minfree * (long)(PAGE_SIZE / 1024),
+			     min_score_adj,
+			     other_free * (long)(PAGE_SIZE / 1024),
+			     cma_free * (long)(PAGE_SIZE / 1024),
+			     cma_file * (long)(PAGE_SIZE / 1024));
+		lowmem_deathpending_timeout = jiffies + HZ;
+		lmk_record_kill(selected, trigger, selected_tasksize,
+				selected_oom_score_adj, min_score_adj,
+				other_free, other_file, 0, 1);
+		send_sig(SIGKILL, selected, 0);
+		this_cpu_inc(lmk_stats.kill_count);
+		set_tsk_thread_flag(selected, TIF_MEMDIE);
+
+		spin_lock_irq(&lowmem_candidates_lock);
+		if (!list_empty(&selected->signal->lmk_node))
+			lowmem_victim = selected->signal;
+		spin_unlock_irq(&lowmem_candidates_lock);
+
+		trace_almk_end(selected_oom_score_adj, selected_tasksize,
+				current->comm, minfree, other_free,
+				other_file, cma_free, cma_file, 0);
+	} else {
+		trace_almk_end(-1, 0, current->comm, minfree,
+				other_free, other_file,
+				cma_free, cma_file, 0);
+	}
+
+	for (i = 0; i < nr_scan; i++)
+		put_task_struct(scan[i]);
+}
+
+static int lowmem_vmpressure_notify(struct notifier_block *nb,
+				unsigned long level, void *data)
+{
+	if (vmpressure_mode && level >= vmpressure_min_level)
+		lowmem_vmpressure_kill(level);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call = lowmem_vmpressure_notify,
+};
+#endif
+
 static int lmk_stat_show(struct seq_file *m, void *v)
 {
 	int cpu;
@@ -579,13 +996,26 @@ static int __init lowmem_init(void)
 			&lmk_stat_fops);
 	if (!fentry)
 		pr_err("almk: failed to create debugfs file\n");
+#ifdef CONFIG_ANDROID_LMK_KILL_STATS
+	fentry = debugfs_create_file("kills", S_IRUSR,
+			lmk_debug_dir, NULL,
+			&lmk_kills_fops);
+	if (!fentry)
+		pr_err("almk: failed to create debugfs file\n");
+#endif
 skip:
 	register_shrinker(&lowmem_shrinker);
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+	vmpressure_register_notifier(&lowmem_vmpressure_nb);
+#endif
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+	vmpressure_unregister_notifier(&lowmem_vmpressure_nb);
+#endif
 	unregister_shrinker(&lowmem_shrinker);
 }
 
@@ -753,6 +1183,11 @@ module_param_array_named(adj, lowmem_adj, short, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+module_param_named(vmpressure_mode, vmpressure_mode, bool, S_IRUGO | S_IWUSR);
+module_param_named(vmpressure_level, vmpressure_min_level, int,
+		   S_IRUGO | S_IWUSR);
+#endif
 
 #ifdef CONFIG_ADAPTIVE_LMK
 module_param_array_named(anon_pcnt, anon_percent, int, &anon_percent_size,
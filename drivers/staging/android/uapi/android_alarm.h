@@ -59,6 +59,12 @@ enum android_alarm_return_flags {
 #define ANDROID_ALARM_SET_AND_WAIT(type)    ALARM_IOW(3, type, struct timespec)
 #define ANDROID_ALARM_GET_TIME(type)        ALARM_IOW(4, type, struct timespec)
 #define ANDROID_ALARM_SET_RTC               _IOW('a', 5, struct timespec)
+/*
+ * How much later than the time given to the following sets the alarm may
+ * run, so that it can share the wakeup of another one. 0, the default, is
+ * an exact alarm.
+ */
+#define ANDROID_ALARM_SET_WINDOW(type)      ALARM_IOW(6, type, struct timespec)
 #define ANDROID_ALARM_BASE_CMD(cmd)         (cmd & ~(_IOC(0, 0, 0xf0, 0)))
 #define ANDROID_ALARM_IOCTL_TO_TYPE(cmd)    (_IOC_NR(cmd) >> 4)
 
@@ -31,6 +31,12 @@ struct ashmem_pin {
 	__u32 len;	/* length forward from offset, in bytes, page-aligned */
 };
 
+struct ashmem_pin_batch {
+	__u64 pins;	/* user pointer to an array of struct ashmem_pin */
+	__u32 count;	/* number of entries in the array */
+	__u32 pad;
+};
+
 #define __ASHMEMIOC		0x77
 
 #define ASHMEM_SET_NAME		_IOW(__ASHMEMIOC, 1, char[ASHMEM_NAME_LEN])
@@ -43,5 +49,6 @@ struct ashmem_pin {
 #define ASHMEM_UNPIN		_IOW(__ASHMEMIOC, 8, struct ashmem_pin)
 #define ASHMEM_GET_PIN_STATUS	_IO(__ASHMEMIOC, 9)
 #define ASHMEM_PURGE_ALL_CACHES	_IO(__ASHMEMIOC, 10)
+#define ASHMEM_UNPIN_BATCH	_IOW(__ASHMEMIOC, 11, struct ashmem_pin_batch)
 
 #endif	/* _UAPI_LINUX_ASHMEM_H */
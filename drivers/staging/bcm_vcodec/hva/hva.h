@@ -104,6 +104,14 @@ void hva_close(struct hva *hva);
 /* Set/clear VCE bit in video codec interrupt mask */
 void hva_set_vcintmask_vce(struct hva *hva, int value);
 
+/*
+ * Save the codec registers that carry over from one slice to the next,
+ * before the block is powered off, and write them back once it is on
+ * again. A restore without a save does nothing.
+ */
+void hva_save_context(struct hva *hva);
+void hva_restore_context(struct hva *hva);
+
 /* Perform HVA operations for the start of a slice decode */
 void hva_dec_slice(struct hva *hva, struct hva_dec_info *dec);
 
@@ -34,6 +34,7 @@ struct hva *hva_open(void __iomem *base, size_t size)
 
 	hva->base = base;
 	hva->size = size;
+	hva->ctx_valid = false;
 	return hva;
 }
 
@@ -52,6 +53,51 @@ void hva_set_vcintmask_vce(struct hva *hva, int value)
 		HVA_REG_WT(hva, VCINTMASK0, old_value & ~HVA_VCSIGNAL0_VCE_SET);
 }
 
+/*
+ * Registers the slice operations read back or only partly rewrite. The
+ * bits written count goes last, restored with the entropy coder stopped.
+ */
+static const u32 hva_ctx_regs[HVA_CTX_NR_REGS] = {
+	HVA_REG_FRAMESIZE_OFFSET,
+	HVA_REG_SINT_VEC_REFPIC_OFFSET,
+	HVA_REG_ENC_SINT_VEC_REFPIC_OFFSET,
+	HVA_DECSD_REGSDPARAM_OFFSET,
+	HVA_VCINTMASK0_OFFSET,
+	HVA_ENCICL_ENCIFRAMECTL_OFFSET,
+	HVA_ENCSN_ENCSE2BINBUFADDR_OFFSET,
+	HVA_ENCSN_ENCSE2BINBUFSTARTADDR_OFFSET,
+	HVA_ENCSN_ENCSE2BINBUFENDADDR_OFFSET,
+	HVA_ENCSN_ENCSE2BINBUFMARKADDR_OFFSET,
+	HVA_ENCSN_ENCSE2BINBUFBITSWRITTEN_OFFSET,
+};
+
+void hva_save_context(struct hva *hva)
+{
+	unsigned int i;
+
+	for (i = 0; i < HVA_CTX_NR_REGS; i++)
+		hva->ctx[i] = hva_readl(hva, hva_ctx_regs[i]);
+	hva->ctx_valid = true;
+}
+
+void hva_restore_context(struct hva *hva)
+{
+	unsigned int i;
+	u32 status;
+
+	if (!hva->ctx_valid)
+		return;
+
+	for (i = 0; i < HVA_CTX_NR_REGS - 1; i++)
+		hva_writel(hva, hva->ctx[i], hva_ctx_regs[i]);
+
+	status = HVA_REG_RD(hva, ENCSN_ENCSE2BINSTATUS);
+	HVA_REG_WT(hva, ENCSN_ENCSE2BINSTATUS, 0);
+	HVA_REG_WT(hva, ENCSN_ENCSE2BINBUFBITSWRITTEN, hva->ctx[i]);
+	HVA_REG_WT(hva, ENCSN_ENCSE2BINSTATUS, status);
+	hva->ctx_valid = false;
+}
+
 /*
  * Is the register operation 'reg' a read operation on the specified offset?
  */
@@ -57,9 +57,13 @@
 	HVA_REG_WT(hva, reg, (((val) << HVA_FIELD_SHIFT(reg, field)) & \
 			      HVA_FIELD_MASK(reg, field)))
 
+#define HVA_CTX_NR_REGS		11
+
 struct hva {
 	unsigned char __iomem *base;
 	size_t size;
+	u32 ctx[HVA_CTX_NR_REGS];	/* see hva_save_context() */
+	bool ctx_valid;
 };
 
 static inline void hva_writel(struct hva *hva, u32 value, u32 reg)
@@ -13,12 +13,14 @@
 #include <linux/bcm_pdm_mm.h>
 #include <linux/bitops.h>
 #include <linux/cdev.h>
+#include <linux/debugfs.h>
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
 #include <linux/kernel.h>
 #include <linux/kref.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/module.h>
@@ -27,6 +29,7 @@
 #include <linux/platform_device.h>
 #include <linux/plist.h>
 #include <linux/poll.h>
+#include <linux/seq_file.h>
 #include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/timer.h>
@@ -40,6 +43,12 @@
 
 #define VCE_TIMER_MS 100
 #define VCE_TIMEOUT_MS 1000
+/* Power stays on this long after the last job, keeping the code resident */
+#define VCE_IDLE_OFF_MS 500
+/* Gating model: averages are us << VCE_AVG_SHIFT, a sample weighs 1/8 */
+#define VCE_AVG_SHIFT 3
+#define VCE_GATE_MIN_SAMPLES 8
+#define VCE_GAP_MAX_US 1000000
 #define VCE_NO_SEMAPHORE 0xc0000000
 #define VCE_STOP_SYM_RESET_INNER 0x5
 #define VCE_RESET_TRIES 500
@@ -110,6 +119,7 @@ struct vce_client {
 	int prio;
 	bool readable;
 	wait_queue_head_t queue;
+	ktime_t t_open;		      /* Zeroed when the first job completes */
 	size_t nr_progs;
 	struct vce_prog *progs[VCE_MAX_PROGS_PER_CLIENT];
 	struct list_head write_head;  /* List of pending + active jobs */
@@ -151,11 +161,25 @@ struct vce_device {
 	struct workqueue_struct *wq;
 	struct work_struct job_scheduler;
 	unsigned long expiry;	     /* Jiffies timeout on current job */
+	unsigned long idle_expiry;   /* Jiffies to power off when idle */
+	u32 resident_prog;	     /* ID of the program in VCE memory, or 0 */
 	struct timer_list dev_timer; /* Timer to periodically prod work queue */
 	struct plist_head job_list;
 	struct vce_job *current_job;
 	u32 end_code;
 	struct bcm_pdm_mm_qos_req *pwr_req;
+	/* Power gating between frames, see vce_gate_idle() */
+	ktime_t idle_start;	     /* No job since, 0 while busy */
+	ktime_t t_wake;		     /* Start of the last power on */
+	u32 wake_us;		     /* Power on + context restore */
+	bool cold;		     /* Code not reloaded since power on */
+	u32 gap_avg;		     /* Idle gaps between jobs */
+	u32 gap_samples;
+	u32 restore_avg;	     /* Power on to code reloaded */
+	u32 restore_samples;
+	u32 gated;		     /* Power offs ahead of VCE_IDLE_OFF_MS */
+	u32 wakes;
+	struct dentry *debugfs;
 };
 
 static void vce_pr_regs(struct vce_device *vce);
@@ -208,6 +232,10 @@ static const u32 vce_postrun_code[] = {
 static struct class *vce_class;
 static unsigned long vce_timer_jiffies;
 static unsigned long vce_timeout_jiffies;
+static unsigned long vce_idle_off_jiffies;
+/* Gate when the predicted idle gap exceeds gate_ratio restore costs */
+static unsigned int vce_gate_ratio = 4;
+module_param_named(gate_ratio, vce_gate_ratio, uint, 0644);
 static atomic_t vce_num_vce_devices;
 static atomic_t vce_next_prog_id;
 static atomic_t vce_next_job_id;
@@ -508,6 +536,12 @@ static void vce_job_completion(struct vce_job *job)
 	if (job->state < VCE_JOB_STATE_COMPLETE)
 		job->state = VCE_JOB_STATE_ERROR;
 
+	if (client->t_open.tv64) {
+		pr_debug("client %p first job after %lld us", client,
+			 ktime_us_delta(ktime_get(), client->t_open));
+		client->t_open.tv64 = 0;
+	}
+
 	/* Remove from client's write (pending/active) queue */
 	list_del_init(&job->client_list);
 
@@ -563,6 +597,29 @@ static void vce_release_jobs(struct vce_client *client)
 	mutex_unlock(&vce->mutex);
 }
 
+static inline u32 vce_avg(u32 avg, u32 samples, u32 us)
+{
+	if (!samples)
+		return us << VCE_AVG_SHIFT;
+	return avg - (avg >> VCE_AVG_SHIFT) + us;
+}
+
+/*
+ * Break-even model for powering off as soon as the VCE is idle. Power
+ * on costs the measured restore time, from the power request to the
+ * program code copied back into VCE memory, and leakage is only saved
+ * for the rest of the gap. Gating pays off when the gaps between jobs,
+ * e.g. the idle part of each frame period, are gate_ratio times longer.
+ */
+static bool vce_gate_idle(struct vce_device *vce)
+{
+	if (!vce_gate_ratio || vce->gap_samples < VCE_GATE_MIN_SAMPLES ||
+	    !vce->restore_samples)
+		return false;
+	return (vce->gap_avg >> VCE_AVG_SHIFT) >
+	       vce_gate_ratio * (vce->restore_avg >> VCE_AVG_SHIFT);
+}
+
 /*
  * Job scheduler routine, to be run from a VCE work queue.
  * Takes the associated vce mutex.
@@ -579,12 +636,37 @@ static void vce_process_jobs(struct work_struct *work)
 	/* Get currently running job, or first pending job */
 	job = vce->current_job;
 	if (!job) {
-		if (plist_head_empty(&vce->job_list))
+		if (plist_head_empty(&vce->job_list)) {
+			/*
+			 * Power off once idle for VCE_IDLE_OFF_MS, or at once
+			 * when the next job is not expected soon
+			 */
+			if (!vce->enabled)
+				goto end;
+			if (!vce->idle_start.tv64)
+				vce->idle_start = ktime_get();
+			if (vce_gate_idle(vce)) {
+				vce->gated++;
+				vce_disable(vce);
+			} else if (time_is_before_eq_jiffies(vce->idle_expiry))
+				vce_disable(vce);
+			else
+				mod_timer(&vce->dev_timer, vce->idle_expiry);
 			goto end;
+		}
 
 		job = plist_first_entry(&vce->job_list, struct vce_job,
 					vce_list);
 		vce->current_job = job;
+		if (vce->idle_start.tv64) {
+			s64 us = ktime_us_delta(ktime_get(), vce->idle_start);
+
+			us = min_t(s64, us, VCE_GAP_MAX_US);
+			vce->gap_avg = vce_avg(vce->gap_avg, vce->gap_samples,
+					       us);
+			vce->gap_samples++;
+			vce->idle_start.tv64 = 0;
+		}
 	}
 
 	if (vce_enable(vce) != 0)
@@ -598,6 +680,7 @@ static void vce_process_jobs(struct work_struct *work)
 			vce_pr_regs(vce);
 			vce_reset(vce);
 			vce->idle = true;
+			vce->resident_prog = 0;
 			hw_is_busy = false;
 
 			if (vce_job_is_active(job))
@@ -618,7 +701,7 @@ static void vce_process_jobs(struct work_struct *work)
 	if (hw_is_busy) {
 		mod_timer(&vce->dev_timer, jiffies + vce_timer_jiffies);
 	} else {
-		vce_disable(vce);
+		vce->idle_expiry = jiffies + vce_idle_off_jiffies;
 		vce_queue_work(vce);
 	}
 
@@ -748,11 +831,13 @@ static int vce_enable(struct vce_device *vce)
 	int rc = 0;
 
 	if (!vce->enabled) {
+		vce->t_wake = ktime_get();
 		rc = vce_power_on(vce);
 		if (rc)
 			goto failed_power;
 
 		vce_reset(vce);
+		hva_restore_context(vce->hva);
 
 		/* Request interrupt */
 		rc = request_irq(vce->irq, vce_isr, IRQF_SHARED, "vce", vce);
@@ -767,6 +852,9 @@ static int vce_enable(struct vce_device *vce)
 		setup_timer(&vce->dev_timer, vce_dev_timer_callback,
 			    (unsigned long)vce);
 		vce->enabled = true;
+		vce->wake_us = ktime_us_delta(ktime_get(), vce->t_wake);
+		vce->cold = true;
+		vce->wakes++;
 	}
 
 	return rc;
@@ -791,8 +879,12 @@ static void vce_disable(struct vce_device *vce)
 		pr_debug("irq off");
 
 		vce_reset(vce);
+		hva_save_context(vce->hva);
 		vce_power_off(vce);
 		vce->enabled = false;
+
+		/* VCE memory is not kept while powered off */
+		vce->resident_prog = 0;
 	}
 }
 
@@ -840,6 +932,7 @@ static void vce_run_start(struct vce_device *vce, u32 start_addr,
 static void vce_run_job(struct vce_device *vce, struct vce_job *job)
 {
 	struct vce_prog *prog = job->prog;
+	ktime_t copy_start;
 	void *mask;
 	size_t bit;
 	u32 i;
@@ -879,12 +972,36 @@ static void vce_run_job(struct vce_device *vce, struct vce_job *job)
 
 	case VCE_JOB_STATE_PRERUN:
 		vce_reset(vce);
+		copy_start = ktime_get();
+
+		/*
+		 * Copy code beyond VCE DMA limit. If the program is still
+		 * resident only the part the prerun code was loaded over
+		 * needs to be copied again. Program IDs are never reused, so
+		 * a changed image is always copied in full.
+		 */
+		if (prog->code_hi_size) {
+			size_t size = prog->code_hi_size;
 
-		/* Copy code beyond VCE DMA limit */
-		if (prog->code_hi_size)
+			if (vce->resident_prog == prog->id)
+				size = min(size, sizeof(vce_prerun_code));
 			vce_writesl(vce,
 				    VCE_PMEM_ACCESS_OFFSET + VCE_PMEM_DMA_SIZE,
-				    prog->code_hi, prog->code_hi_size);
+				    prog->code_hi, size);
+		}
+		vce->resident_prog = prog->id;
+
+		/* The copy is the rest of the cost of the power on */
+		if (vce->cold) {
+			u32 us = vce->wake_us;
+
+			if (prog->code_hi_size)
+				us += ktime_us_delta(ktime_get(), copy_start);
+			vce->restore_avg = vce_avg(vce->restore_avg,
+						   vce->restore_samples, us);
+			vce->restore_samples++;
+			vce->cold = false;
+		}
 
 		/* Set VCE registers to client-supplied values */
 		mask = &job->regset.changed_mask;
@@ -977,6 +1094,7 @@ static int vce_open(struct inode *inode, struct file *filp)
 	client->prio = current->prio;
 	client->readable = ((filp->f_mode & FMODE_READ) == FMODE_READ);
 	init_waitqueue_head(&client->queue);
+	client->t_open = ktime_get();
 	client->nr_progs = 0;
 	INIT_LIST_HEAD(&client->write_head);
 	INIT_LIST_HEAD(&client->read_head);
@@ -1339,6 +1457,33 @@ static const struct file_operations vce_fops = {
 	.fsync = vce_fsync
 };
 
+static int vce_gate_show(struct seq_file *m, void *v)
+{
+	struct vce_device *vce = m->private;
+
+	mutex_lock(&vce->mutex);
+	seq_printf(m, "enabled: %d\ngap_us: %u (%u)\nrestore_us: %u (%u)\n"
+		   "gate: %d\ngated: %u\nwakes: %u\n", vce->enabled,
+		   vce->gap_avg >> VCE_AVG_SHIFT, vce->gap_samples,
+		   vce->restore_avg >> VCE_AVG_SHIFT, vce->restore_samples,
+		   vce_gate_idle(vce), vce->gated, vce->wakes);
+	mutex_unlock(&vce->mutex);
+	return 0;
+}
+
+static int vce_gate_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, vce_gate_show, inode->i_private);
+}
+
+static const struct file_operations vce_gate_fops = {
+	.owner = THIS_MODULE,
+	.open = vce_gate_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 
 /* ~~~~~~~~~~~~~~~~~~~~~~~~~~~ module ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~ */
 
@@ -1485,6 +1630,8 @@ static int vce_probe(struct platform_device *pdev)
 	vce->idle = true;
 	vce->enabled = false;
 	vce->current_job = NULL;
+	vce->debugfs = debugfs_create_file("vce_gate", S_IRUGO, NULL, vce,
+					   &vce_gate_fops);
 
 	pr_info("%s: mem 0x%lx-0x%lx (0x%lx-0x%lx) irq %d", dev_name(device),
 		(unsigned long)res0->start,
@@ -1518,6 +1665,7 @@ static int vce_remove(struct platform_device *pdev)
 
 	vce = platform_get_drvdata(pdev);
 	if (vce) {
+		debugfs_remove(vce->debugfs);
 		vce_disable(vce);
 		bcm_pdm_mm_qos_req_destroy(vce->pwr_req);
 		mutex_destroy(&vce->mutex);
@@ -1566,6 +1714,7 @@ static int __init vce_init(void)
 	/* Pre-calculate */
 	vce_timer_jiffies = msecs_to_jiffies(VCE_TIMER_MS);
 	vce_timeout_jiffies = msecs_to_jiffies(VCE_TIMEOUT_MS);
+	vce_idle_off_jiffies = msecs_to_jiffies(VCE_IDLE_OFF_MS);
 
 	return 0;
 
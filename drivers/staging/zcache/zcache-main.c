@@ -30,6 +30,7 @@
 
 #include <linux/cleancache.h>
 #include <linux/frontswap.h>
+#include <linux/zpolicy.h>
 #include "tmem.h"
 #include "zcache.h"
 #include "zbud.h"
@@ -331,10 +332,16 @@ static struct tmem_hostops zcache_hostops = {
 
 static struct page *zcache_alloc_page(void)
 {
-	struct page *page = alloc_page(ZCACHE_GFP_MASK);
+	struct page *page;
 
+	/* over the shared budget: callers fall back to evicting via LRU */
+	if (!zpolicy_charge(ZPOLICY_FILE, 1))
+		return NULL;
+	page = alloc_page(ZCACHE_GFP_MASK);
 	if (page != NULL)
 		inc_zcache_pageframes_alloced();
+	else
+		zpolicy_uncharge(ZPOLICY_FILE, 1);
 	return page;
 }
 
@@ -346,6 +353,7 @@ static void zcache_free_page(struct page *page)
 	if (page == NULL)
 		BUG();
 	__free_page(page);
+	zpolicy_uncharge(ZPOLICY_FILE, 1);
 	inc_zcache_pageframes_freed();
 	curr_pageframes = curr_pageframes_count();
 	if (curr_pageframes > max_pageframes)
@@ -1216,6 +1224,36 @@ static struct shrinker zcache_shrinker = {
 	.seeks = DEFAULT_SEEKS,
 };
 
+#ifdef CONFIG_ZPOLICY
+/*
+ * Called by zpolicy when zram needs room in the shared budget, or by the
+ * LMK before it kills: ephemeral pageframes go oldest first.
+ */
+static unsigned long zcache_zpolicy_evict(struct zpolicy_client *client,
+					  unsigned long nr)
+{
+	unsigned long freed = 0;
+	struct page *page;
+
+	if (zcache_freeze)
+		return 0;
+	while (freed < nr) {
+		page = zcache_evict_eph_pageframe();
+		if (page == NULL)
+			break;
+		zcache_free_page(page);
+		freed++;
+	}
+	return freed;
+}
+
+static struct zpolicy_client zcache_zpolicy_client = {
+	.name = "zcache",
+	.class = ZPOLICY_FILE,
+	.evict = zcache_zpolicy_evict,
+};
+#endif
+
 /*
  * zcache shims between cleancache/frontswap ops and tmem
  */
@@ -1885,6 +1923,9 @@ static int zcache_init(void)
 		struct cleancache_ops *old_ops;
 
 		register_shrinker(&zcache_shrinker);
+#ifdef CONFIG_ZPOLICY
+		zpolicy_register(&zcache_zpolicy_client);
+#endif
 		old_ops = zcache_cleancache_register_ops();
 		pr_info("%s: cleancache enabled using kernel transcendent "
 			"memory and compression buddies\n", namestr);
@@ -1895,6 +1936,13 @@ static int zcache_init(void)
 		if (old_ops != NULL)
 			pr_warn("%s: cleancache_ops overridden\n", namestr);
 	}
+#ifdef CONFIG_ZPOLICY
+	/* anonymous pages are left to zram, which shares the budget */
+	if (zcache_enabled && !disable_frontswap) {
+		pr_info("%s: frontswap disabled, swap goes to zram\n", namestr);
+		disable_frontswap = true;
+	}
+#endif
 	if (zcache_enabled && !disable_frontswap) {
 		struct frontswap_ops *old_ops;
 
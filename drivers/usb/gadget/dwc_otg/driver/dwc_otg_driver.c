@@ -184,7 +184,11 @@ static struct dwc_otg_driver_module_params dwc_otg_module_params = {
 	.otg_cap = 2,		/* Not capable of SRP and HNP */
 #endif
 	.dma_enable = 1,
+#ifdef CONFIG_USB_DWC_OTG_DESC_DMA
+	.dma_desc_enable = 1,
+#else
 	.dma_desc_enable = 0,
+#endif
 	.dev_out_nak_enable = -1,
 	.dma_burst_size = -1,
 	.speed = -1,
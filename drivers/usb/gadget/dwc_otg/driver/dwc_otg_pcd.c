@@ -76,16 +76,14 @@ static dwc_otg_pcd_ep_t *get_ep_from_handle(dwc_otg_pcd_t *pcd, void *handle)
 }
 
 /**
- * This function completes a request.  It call's the request call back.
+ * This function calls the call back of a request already taken off the
+ * EP queue, and frees it.
  */
-void dwc_otg_request_done(dwc_otg_pcd_ep_t *ep, dwc_otg_pcd_request_t *req,
-			  int32_t status)
+void dwc_otg_request_giveback(dwc_otg_pcd_ep_t *ep,
+			      dwc_otg_pcd_request_t *req, int32_t status)
 {
 	unsigned stopped = ep->stopped;
 
-	DWC_DEBUGPL(DBG_PCDV, "%s(%p)\n", __func__, ep);
-	DWC_CIRCLEQ_REMOVE_INIT(&ep->queue, req, queue_entry);
-
 	/* don't modify queue heads during completion callback */
 	ep->stopped = 1;
 	DWC_SPINUNLOCK(ep->pcd->lock);
@@ -100,6 +98,17 @@ void dwc_otg_request_done(dwc_otg_pcd_ep_t *ep, dwc_otg_pcd_request_t *req,
 	dwc_free(req);
 }
 
+/**
+ * This function completes a request.  It call's the request call back.
+ */
+void dwc_otg_request_done(dwc_otg_pcd_ep_t *ep, dwc_otg_pcd_request_t *req,
+			  int32_t status)
+{
+	DWC_DEBUGPL(DBG_PCDV, "%s(%p)\n", __func__, ep);
+	DWC_CIRCLEQ_REMOVE_INIT(&ep->queue, req, queue_entry);
+	dwc_otg_request_giveback(ep, req, status);
+}
+
 /**
  * This function terminates all the requsts in the EP request queue.
  */
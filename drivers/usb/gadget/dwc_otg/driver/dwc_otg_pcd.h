@@ -250,6 +250,9 @@ struct dwc_otg_pcd {
 extern void dwc_otg_request_nuke(dwc_otg_pcd_ep_t *ep);
 extern void dwc_otg_request_done(dwc_otg_pcd_ep_t *ep,
 				 dwc_otg_pcd_request_t *req, int32_t status);
+extern void dwc_otg_request_giveback(dwc_otg_pcd_ep_t *ep,
+				     dwc_otg_pcd_request_t *req,
+				     int32_t status);
 
 void dwc_otg_iso_buffer_done(dwc_otg_pcd_t *pcd, dwc_otg_pcd_ep_t *ep,
 			     void *req_handle);
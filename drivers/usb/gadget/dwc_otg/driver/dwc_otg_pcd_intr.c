@@ -2345,6 +2345,8 @@ static void complete_ep(dwc_otg_pcd_ep_t *ep)
 
 	/* Complete the request */
 	if (is_last) {
+		int armed;
+
 #ifdef DWC_UTE_CFI
 		if (ep->dwc_ep.buff_mode != BM_STANDARD) {
 			req->actual = ep->dwc_ep.cfi_req_len - byte_count;
@@ -2355,14 +2357,23 @@ static void complete_ep(dwc_otg_pcd_ep_t *ep)
 		}
 #endif
 
-		dwc_otg_request_done(ep, req, 0);
-
 		ep->dwc_ep.start_xfer_buff = 0;
 		ep->dwc_ep.xfer_buff = 0;
 		ep->dwc_ep.xfer_count = 0;
 
-		/* If there is a request in the queue start it. */
+		/*
+		 * Start the next queued request before the call back, so
+		 * the endpoint stays armed while the function driver
+		 * handles this one. Requests queued from the call back
+		 * only wait in the queue, start them if the endpoint
+		 * went idle.
+		 */
+		DWC_CIRCLEQ_REMOVE_INIT(&ep->queue, req, queue_entry);
+		armed = !DWC_CIRCLEQ_EMPTY(&ep->queue);
 		start_next_request(ep);
+		dwc_otg_request_giveback(ep, req, 0);
+		if (!armed)
+			start_next_request(ep);
 	}
 }
 
@@ -794,7 +794,7 @@ first_try:
 
 		/* Allocate & copy */
 		if (!halt && !data) {
-			data = kzalloc(len, GFP_KERNEL);
+			data = kmalloc(len, GFP_KERNEL);
 			if (unlikely(!data))
 				return -ENOMEM;
 
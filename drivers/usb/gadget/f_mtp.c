@@ -30,6 +30,11 @@
 #include <linux/file.h>
 #include <linux/device.h>
 #include <linux/miscdevice.h>
+#include <linux/debugfs.h>
+#include <linux/ktime.h>
+#include <linux/seq_file.h>
+#include <linux/backing-dev.h>
+#include <linux/sched.h>
 
 #include <linux/usb.h>
 #include <linux/usb_usual.h>
@@ -51,9 +56,22 @@
 
 /* number of tx and rx requests to allocate */
 #define TX_REQ_MAX 4
-#define RX_REQ_MAX 2
+#define RX_REQ_MAX 4
 #define INTR_REQ_MAX 5
 
+/*
+ * Bulk request sizes and the number of tx requests, taken at bind time.
+ * Larger requests are one descriptor chain and one interrupt each on
+ * controllers that chain them; if they cannot be allocated the driver
+ * falls back to TX_REQ_MAX requests of MTP_BULK_BUFFER_SIZE.
+ */
+static unsigned int mtp_tx_req_len = 65536;
+module_param(mtp_tx_req_len, uint, S_IRUGO | S_IWUSR);
+static unsigned int mtp_rx_req_len = 65536;
+module_param(mtp_rx_req_len, uint, S_IRUGO | S_IWUSR);
+static unsigned int mtp_tx_reqs = 8;
+module_param(mtp_tx_reqs, uint, S_IRUGO | S_IWUSR);
+
 /* ID for Microsoft MTP OS String */
 #define MTP_OS_STRING_ID   0xEE
 
@@ -92,7 +110,9 @@ struct mtp_dev {
 	wait_queue_head_t write_wq;
 	wait_queue_head_t intr_wq;
 	struct usb_request *rx_req[RX_REQ_MAX];
-	int rx_done;
+	int rx_done;		/* completed rx requests */
+	unsigned tx_req_len;
+	unsigned rx_req_len;
 
 	/* for processing MTP_SEND_FILE, MTP_RECEIVE_FILE and
 	 * MTP_SEND_FILE_WITH_HEADER ioctls on a work queue
@@ -107,6 +127,18 @@ struct mtp_dev {
 	uint16_t xfer_command;
 	uint32_t xfer_transaction_id;
 	int xfer_result;
+	int64_t xfer_bytes;
+	u64 xfer_cpu_ns;	/* of the work, copies and completions */
+
+	/* file transfers, [0] send and [1] receive, in debugfs usb_mtp */
+	struct mtp_xfer_stats {
+		unsigned files;
+		unsigned errors;
+		u64 bytes;
+		u64 usecs;
+		u64 cpu_ns;
+	} stats[2];
+	struct dentry *debugfs;
 };
 
 static struct usb_interface_descriptor mtp_interface_desc = {
@@ -372,8 +404,9 @@ static void mtp_complete_out(struct usb_ep *ep, struct usb_request *req)
 {
 	struct mtp_dev *dev = _mtp_dev;
 
-	dev->rx_done = 1;
-	if (req->status != 0)
+	dev->rx_done++;
+	/* reads dequeued after a short packet or a cancel */
+	if (req->status != 0 && req->status != -ECONNRESET)
 		dev->state = STATE_ERROR;
 
 	wake_up(&dev->read_wq);
@@ -399,6 +432,7 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	struct usb_composite_dev *cdev = dev->cdev;
 	struct usb_request *req;
 	struct usb_ep *ep;
+	unsigned reqs;
 	int i;
 
 	DBG(cdev, "create_bulk_endpoints dev: %p\n", dev);
@@ -431,17 +465,38 @@ static int mtp_create_bulk_endpoints(struct mtp_dev *dev,
 	dev->ep_intr = ep;
 
 	/* now allocate requests for our endpoints */
-	for (i = 0; i < TX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_in, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+	dev->tx_req_len = max(mtp_tx_req_len, (unsigned)MTP_BULK_BUFFER_SIZE);
+	reqs = max(mtp_tx_reqs, 1U);
+retry_tx_alloc:
+	for (i = 0; i < reqs; i++) {
+		req = mtp_request_new(dev->ep_in, dev->tx_req_len);
+		if (!req) {
+			if (dev->tx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while ((req = mtp_req_get(dev, &dev->tx_idle)))
+				mtp_request_free(req, dev->ep_in);
+			dev->tx_req_len = MTP_BULK_BUFFER_SIZE;
+			reqs = TX_REQ_MAX;
+			goto retry_tx_alloc;
+		}
 		req->complete = mtp_complete_in;
 		mtp_req_put(dev, &dev->tx_idle, req);
 	}
+
+	dev->rx_req_len = max(mtp_rx_req_len, (unsigned)MTP_BULK_BUFFER_SIZE);
+retry_rx_alloc:
 	for (i = 0; i < RX_REQ_MAX; i++) {
-		req = mtp_request_new(dev->ep_out, MTP_BULK_BUFFER_SIZE);
-		if (!req)
-			goto fail;
+		req = mtp_request_new(dev->ep_out, dev->rx_req_len);
+		if (!req) {
+			if (dev->rx_req_len == MTP_BULK_BUFFER_SIZE)
+				goto fail;
+			while (i--) {
+				mtp_request_free(dev->rx_req[i], dev->ep_out);
+				dev->rx_req[i] = NULL;
+			}
+			dev->rx_req_len = MTP_BULK_BUFFER_SIZE;
+			goto retry_rx_alloc;
+		}
 		req->complete = mtp_complete_out;
 		dev->rx_req[i] = req;
 	}
@@ -472,7 +527,7 @@ static ssize_t mtp_read(struct file *fp, char __user *buf,
 
 	DBG(cdev, "mtp_read(%zu)\n", count);
 
-	if (count > MTP_BULK_BUFFER_SIZE)
+	if (count > dev->rx_req_len)
 		return -EINVAL;
 
 	/* we will block until we're online */
@@ -602,8 +657,8 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 		if (xfer && copy_from_user(req->buf, buf, xfer)) {
@@ -640,6 +695,25 @@ static ssize_t mtp_write(struct file *fp, const char __user *buf,
 	return r;
 }
 
+/*
+ * The request buffers are handed to the controller as one physically
+ * contiguous block (dwc_otg takes virt_to_phys of req->buf, no sg lists),
+ * so page cache pages cannot be queued in place: vfs_read and vfs_write
+ * copy straight between the page cache and the request, which is the
+ * only copy. Reading ahead a whole request or more keeps that copy from
+ * waiting on the disk.
+ */
+static void mtp_file_sequential(struct mtp_dev *dev, struct file *filp)
+{
+	struct backing_dev_info *bdi = filp->f_mapping->backing_dev_info;
+
+	filp->f_ra.ra_pages = max_t(unsigned long, bdi->ra_pages * 2,
+			DIV_ROUND_UP(2 * dev->tx_req_len, PAGE_SIZE));
+	spin_lock(&filp->f_lock);
+	filp->f_mode &= ~FMODE_RANDOM;
+	spin_unlock(&filp->f_lock);
+}
+
 /* read from a local file and write to USB */
 static void send_file_work(struct work_struct *data)
 {
@@ -654,6 +728,7 @@ static void send_file_work(struct work_struct *data)
 	int xfer, ret, hdr_size;
 	int r = 0;
 	int sendZLP = 0;
+	u64 cpu;
 
 	/* read our parameters */
 	smp_rmb();
@@ -662,6 +737,9 @@ static void send_file_work(struct work_struct *data)
 	count = dev->xfer_file_length;
 
 	DBG(cdev, "send_file_work(%lld %lld)\n", offset, count);
+	dev->xfer_bytes = 0;
+	cpu = current->se.sum_exec_runtime;
+	mtp_file_sequential(dev, filp);
 
 	if (dev->xfer_send_header) {
 		hdr_size = sizeof(struct mtp_data_header);
@@ -695,8 +773,8 @@ static void send_file_work(struct work_struct *data)
 			break;
 		}
 
-		if (count > MTP_BULK_BUFFER_SIZE)
-			xfer = MTP_BULK_BUFFER_SIZE;
+		if (count > dev->tx_req_len)
+			xfer = dev->tx_req_len;
 		else
 			xfer = count;
 
@@ -730,6 +808,7 @@ static void send_file_work(struct work_struct *data)
 		}
 
 		count -= xfer;
+		dev->xfer_bytes += xfer;
 
 		/* zero this so we don't try to free it on error exit */
 		req = 0;
@@ -740,6 +819,7 @@ static void send_file_work(struct work_struct *data)
 
 	DBG(cdev, "send_file_work returning %d\n", r);
 	/* write the result */
+	dev->xfer_cpu_ns = current->se.sum_exec_runtime - cpu;
 	dev->xfer_result = r;
 	smp_wmb();
 }
@@ -750,12 +830,13 @@ static void receive_file_work(struct work_struct *data)
 	struct mtp_dev *dev = container_of(data, struct mtp_dev,
 						receive_file_work);
 	struct usb_composite_dev *cdev = dev->cdev;
-	struct usb_request *read_req = NULL, *write_req = NULL;
+	struct usb_request *read_req, *write_req = NULL;
 	struct file *filp;
 	loff_t offset;
-	int64_t count;
-	int ret, cur_buf = 0;
+	int64_t count, to_queue;
+	int ret, depth, queued = 0, done = 0;
 	int r = 0;
+	u64 cpu;
 
 	/* read our parameters */
 	smp_rmb();
@@ -764,23 +845,35 @@ static void receive_file_work(struct work_struct *data)
 	count = dev->xfer_file_length;
 
 	DBG(cdev, "receive_file_work(%lld)\n", count);
-
-	while (count > 0 || write_req) {
-		if (count > 0) {
-			/* queue a request */
-			read_req = dev->rx_req[cur_buf];
-			cur_buf = (cur_buf + 1) % RX_REQ_MAX;
-
-			read_req->length = (count > MTP_BULK_BUFFER_SIZE
-					? MTP_BULK_BUFFER_SIZE : count);
-			dev->rx_done = 0;
+	dev->xfer_bytes = 0;
+	dev->rx_done = 0;
+	cpu = current->se.sum_exec_runtime;
+
+	/*
+	 * Up to all but the request being written to the file are queued,
+	 * so the endpoint stays armed while we write. If xfer_file_length
+	 * is 0xFFFFFFFF, then we read until we get a short packet and a
+	 * read queued ahead could take the next container: only queue the
+	 * next one once the last was full.
+	 */
+	depth = count == 0xFFFFFFFF ? 1 : RX_REQ_MAX - 1;
+	to_queue = count;
+
+	while (to_queue > 0 || queued != done || write_req) {
+		while (to_queue > 0 && queued - done < depth) {
+			read_req = dev->rx_req[queued % RX_REQ_MAX];
+			read_req->length = min_t(int64_t, to_queue,
+						 dev->rx_req_len);
 			ret = usb_ep_queue(dev->ep_out, read_req, GFP_KERNEL);
 			if (ret < 0) {
 				r = -EIO;
 				if (dev->state != STATE_OFFLINE)
 					dev->state = STATE_ERROR;
-				break;
+				goto out;
 			}
+			queued++;
+			if (count != 0xFFFFFFFF)
+				to_queue -= read_req->length;
 		}
 
 		if (write_req) {
@@ -794,40 +887,47 @@ static void receive_file_work(struct work_struct *data)
 					dev->state = STATE_ERROR;
 				break;
 			}
+			dev->xfer_bytes += ret;
 			write_req = NULL;
 		}
 
-		if (read_req) {
-			/* wait for our last read to complete */
+		if (queued != done) {
+			/* wait for the oldest read to complete */
+			read_req = dev->rx_req[done % RX_REQ_MAX];
 			ret = wait_event_interruptible(dev->read_wq,
-				dev->rx_done || dev->state != STATE_BUSY);
+				dev->rx_done > done ||
+				dev->state != STATE_BUSY);
 			if (dev->state == STATE_CANCELED) {
 				r = -ECANCELED;
-				if (!dev->rx_done)
-					usb_ep_dequeue(dev->ep_out, read_req);
 				break;
 			}
-			/* if xfer_file_length is 0xFFFFFFFF, then we read until
-			 * we get a zero length packet
-			 */
-			if (count != 0xFFFFFFFF)
-				count -= read_req->actual;
+			if (dev->rx_done <= done) {
+				r = ret < 0 ? ret : -EIO;
+				break;
+			}
+			done++;
 			if (read_req->actual < read_req->length) {
 				/*
 				 * short packet is used to signal EOF for
 				 * sizes > 4 gig
 				 */
 				DBG(cdev, "got short packet\n");
-				count = 0;
+				to_queue = 0;
 			}
 
 			write_req = read_req;
-			read_req = NULL;
 		}
 	}
+out:
+	/* reads still in flight after an error, a cancel or a short packet,
+	 * newest first so the controller does not start the next one
+	 */
+	while (queued != done)
+		usb_ep_dequeue(dev->ep_out, dev->rx_req[--queued % RX_REQ_MAX]);
 
 	DBG(cdev, "receive_file_work returning %d\n", r);
 	/* write the result */
+	dev->xfer_cpu_ns = current->se.sum_exec_runtime - cpu;
 	dev->xfer_result = r;
 	smp_wmb();
 }
@@ -879,6 +979,8 @@ static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 	{
 		struct mtp_file_range	mfr;
 		struct work_struct *work;
+		struct mtp_xfer_stats *st;
+		ktime_t start;
 
 		spin_lock_irq(&dev->lock);
 		if (dev->state == STATE_CANCELED) {
@@ -929,6 +1031,7 @@ static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 		 * in kernel context, which is necessary for vfs_read and
 		 * vfs_write to use our buffers in the kernel address space.
 		 */
+		start = ktime_get();
 		queue_work(dev->wq, work);
 		/* wait for operation to complete */
 		flush_workqueue(dev->wq);
@@ -937,6 +1040,14 @@ static long mtp_ioctl(struct file *fp, unsigned code, unsigned long value)
 		/* read the result */
 		smp_rmb();
 		ret = dev->xfer_result;
+
+		st = &dev->stats[work == &dev->receive_file_work];
+		st->files++;
+		if (ret < 0)
+			st->errors++;
+		st->bytes += dev->xfer_bytes;
+		st->usecs += ktime_us_delta(ktime_get(), start);
+		st->cpu_ns += dev->xfer_cpu_ns;
 		break;
 	}
 	case MTP_SEND_EVENT:
@@ -1243,6 +1354,58 @@ static int mtp_bind_config(struct usb_configuration *c, bool ptp_config)
 	return usb_add_function(c, &dev->function);
 }
 
+#ifdef CONFIG_DEBUG_FS
+
+static int mtp_debugfs_show(struct seq_file *m, void *v)
+{
+	static const char * const dir[] = { "send", "receive" };
+	struct mtp_dev *dev = m->private;
+	struct mtp_xfer_stats *st;
+	int i;
+
+	seq_puts(m, "dir     files errors        bytes       ms   KB/s"
+		 "   cpu_ms cpu_us/MB\n");
+	for (i = 0; i < ARRAY_SIZE(dev->stats); i++) {
+		st = &dev->stats[i];
+		seq_printf(m, "%-7s %5u %6u %12llu %8llu %6llu %8llu %9llu\n",
+			   dir[i], st->files, st->errors, st->bytes,
+			   div_u64(st->usecs, USEC_PER_MSEC),
+			   st->usecs ? div64_u64((st->bytes >> 10) *
+						 USEC_PER_SEC, st->usecs) : 0,
+			   div_u64(st->cpu_ns, NSEC_PER_MSEC),
+			   st->bytes >> 20 ? div64_u64(st->cpu_ns,
+				(st->bytes >> 20) * NSEC_PER_USEC) : 0);
+	}
+	seq_printf(m, "tx_req_len %u rx_req_len %u\n", dev->tx_req_len,
+		   dev->rx_req_len);
+	return 0;
+}
+
+static int mtp_debugfs_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mtp_debugfs_show, inode->i_private);
+}
+
+static ssize_t mtp_debugfs_write(struct file *file, const char __user *buf,
+				 size_t count, loff_t *ppos)
+{
+	struct mtp_dev *dev = ((struct seq_file *)file->private_data)->private;
+
+	memset(dev->stats, 0, sizeof(dev->stats));
+	return count;
+}
+
+static const struct file_operations mtp_debugfs_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mtp_debugfs_open,
+	.read		= seq_read,
+	.write		= mtp_debugfs_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
 static int mtp_setup(void)
 {
 	struct mtp_dev *dev;
@@ -1275,6 +1438,10 @@ static int mtp_setup(void)
 	if (ret)
 		goto err2;
 
+#ifdef CONFIG_DEBUG_FS
+	dev->debugfs = debugfs_create_file("usb_mtp", S_IRUGO | S_IWUSR, NULL,
+					   dev, &mtp_debugfs_fops);
+#endif
 	return 0;
 
 err2:
@@ -1293,6 +1460,7 @@ static void mtp_cleanup(void)
 	if (!dev)
 		return;
 
+	debugfs_remove(dev->debugfs);
 	misc_deregister(&mtp_device);
 	destroy_workqueue(dev->wq);
 	_mtp_dev = NULL;
@@ -60,6 +60,12 @@ struct f_ncm {
 	bool				is_crc;
 	u32				ndp_sign;
 
+	/* the NTB being filled, its datagrams and NDP kept apart */
+	struct net_device		*netdev;
+	struct sk_buff			*skb_tx_data;
+	struct sk_buff			*skb_tx_ndp;
+	u16				ndp_dgram_count;
+
 	/*
 	 * for notification, it is accessed from both
 	 * callback and ethernet open/close
@@ -84,20 +90,15 @@ static inline unsigned ncm_bitrate(struct usb_gadget *g)
 /*-------------------------------------------------------------------------*/
 
 /*
- * We cannot group frames so use just the minimal size which ok to put
- * one max-size ethernet frame.
- * If the host can group frames, allow it to do that, 16K is selected,
- * because it's used by default by the current linux host driver
+ * Frames are grouped in NTBs of up to 16K both ways, the size used by
+ * default by the current linux host driver. The host may ask for
+ * smaller IN NTBs with SET_NTB_INPUT_SIZE.
  */
-#define NTB_DEFAULT_IN_SIZE	USB_CDC_NCM_NTB_MIN_IN_SIZE
+#define NTB_DEFAULT_IN_SIZE	16384
 #define NTB_OUT_SIZE		16384
 
-/*
- * skbs of size less than that will not be aligned
- * to NCM's dwNtbInMaxSize to save bus bandwidth
- */
-
-#define	MAX_TX_NONFIXED		(512 * 3)
+/* datagram pointer entries of an IN NTB, with the closing zero entry */
+#define TX_MAX_NUM_DPE		32
 
 #define FORMATS_SUPPORTED	(USB_CDC_NCM_NTB16_SUPPORTED |	\
 				 USB_CDC_NCM_NTB32_SUPPORTED)
@@ -801,6 +802,7 @@ static int ncm_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		if (ncm->port.in_ep->driver_data) {
 			DBG(cdev, "reset ncm\n");
 			gether_disconnect(&ncm->port);
+			ncm_free_tx(ncm);
 			ncm_reset_values(ncm);
 		}
 
@@ -836,6 +838,7 @@ static int ncm_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 			net = gether_connect(&ncm->port);
 			if (IS_ERR(net))
 				return PTR_ERR(net);
+			ncm->netdev = net;
 		}
 
 		spin_lock(&ncm->lock);
@@ -862,95 +865,142 @@ static int ncm_get_alt(struct usb_function *f, unsigned intf)
 	return ncm->port.in_ep->driver_data ? 1 : 0;
 }
 
+static void ncm_free_tx(struct f_ncm *ncm)
+{
+	if (ncm->skb_tx_data)
+		dev_kfree_skb_any(ncm->skb_tx_data);
+	ncm->skb_tx_data = NULL;
+	if (ncm->skb_tx_ndp)
+		dev_kfree_skb_any(ncm->skb_tx_ndp);
+	ncm->skb_tx_ndp = NULL;
+	ncm->ndp_dgram_count = 0;
+}
+
+/* completes the NTB being filled: NDP after the datagrams */
+static struct sk_buff *ncm_package_ntb(struct f_ncm *ncm)
+{
+	const struct ndp_parser_opts *opts = ncm->parser_opts;
+	struct sk_buff	*skb = ncm->skb_tx_data;
+	struct sk_buff	*ndp = ncm->skb_tx_ndp;
+	int		ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	unsigned	dpe_len = 2 * 2 * opts->dgram_item_len;
+	unsigned	ndp_pad, ndp_index;
+	__le16		*tmp;
+
+	ndp_pad = ALIGN(skb->len, ndp_align) - skb->len;
+	ndp_index = skb->len + ndp_pad;
+
+	/* (d)wBlockLength and (d)wFpIndex, after signature and sequence */
+	tmp = (void *)skb->data + 8;
+	put_ncm(&tmp, opts->block_length, ndp_index + ndp->len + dpe_len);
+	put_ncm(&tmp, opts->fp_index, ndp_index);
+
+	/* NDP wLength, with the zero datagram entry */
+	tmp = (void *)ndp->data + 4;
+	put_unaligned_le16(ndp->len + dpe_len, tmp);
+
+	memset(skb_put(skb, ndp_pad), 0, ndp_pad);
+	memcpy(skb_put(skb, ndp->len), ndp->data, ndp->len);
+	/* (d)wDatagramIndex[n] and (d)wDatagramLength[n] */
+	memset(skb_put(skb, dpe_len), 0, dpe_len);
+
+	dev_kfree_skb_any(ndp);
+	ncm->skb_tx_data = NULL;
+	ncm->skb_tx_ndp = NULL;
+	ncm->ndp_dgram_count = 0;
+	return skb;
+}
+
+/*
+ * Datagrams are gathered in one NTB until the next one does not fit, or
+ * u_ether asks for it with a NULL skb; the NTB is returned then, and the
+ * datagram that did not fit starts the next one.
+ */
 static struct sk_buff *ncm_wrap_ntb(struct gether *port,
 				    struct sk_buff *skb)
 {
 	struct f_ncm	*ncm = func_to_ncm(&port->func);
-	struct sk_buff	*skb2;
-	int		ncb_len = 0;
+	struct sk_buff	*skb2 = NULL;
 	__le16		*tmp;
 	int		div;
 	int		rem;
 	int		pad;
 	int		ndp_align;
-	int		ndp_pad;
+	unsigned	dpe_len;
 	unsigned	max_size = ncm->port.fixed_in_len;
 	const struct ndp_parser_opts *opts = ncm->parser_opts;
 	unsigned	crc_len = ncm->is_crc ? sizeof(uint32_t) : 0;
 
+	if (!skb)
+		return ncm->skb_tx_data ? ncm_package_ntb(ncm) : NULL;
+
 	div = le16_to_cpu(ntb_parameters.wNdpInDivisor);
 	rem = le16_to_cpu(ntb_parameters.wNdpInPayloadRemainder);
 	ndp_align = le16_to_cpu(ntb_parameters.wNdpInAlignment);
+	dpe_len = 2 * 2 * opts->dgram_item_len;
+
+	/* alone in an NTB, with the worst paddings */
+	if (opts->nth_size + div + rem + skb->len + crc_len + ndp_align +
+	    opts->ndp_size + 2 * dpe_len > max_size)
+		goto drop;
+
+	if (ncm->skb_tx_data &&
+	    (ncm->ndp_dgram_count + 1 >= TX_MAX_NUM_DPE ||
+	     ncm->skb_tx_data->len + div + rem + skb->len + crc_len +
+	     ndp_align + ncm->skb_tx_ndp->len + 2 * dpe_len > max_size))
+		skb2 = ncm_package_ntb(ncm);
+
+	if (!ncm->skb_tx_data) {
+		ncm->skb_tx_data = alloc_skb(max_size, GFP_ATOMIC);
+		ncm->skb_tx_ndp = alloc_skb(opts->ndp_size +
+					    TX_MAX_NUM_DPE * dpe_len,
+					    GFP_ATOMIC);
+		if (!ncm->skb_tx_data || !ncm->skb_tx_ndp) {
+			ncm_free_tx(ncm);
+			goto drop;
+		}
 
-	ncb_len += opts->nth_size;
-	ndp_pad = ALIGN(ncb_len, ndp_align) - ncb_len;
-	ncb_len += ndp_pad;
-	ncb_len += opts->ndp_size;
-	ncb_len += 2 * 2 * opts->dgram_item_len; /* Datagram entry */
-	ncb_len += 2 * 2 * opts->dgram_item_len; /* Zero datagram entry */
-	pad = ALIGN(ncb_len, div) + rem - ncb_len;
-	ncb_len += pad;
-
-	if (ncb_len + skb->len + crc_len > max_size) {
-		dev_kfree_skb_any(skb);
-		return NULL;
+		/* NTH, lengths and NDP index filled in ncm_package_ntb */
+		tmp = (void *)skb_put(ncm->skb_tx_data, opts->nth_size);
+		memset(tmp, 0, opts->nth_size);
+		put_unaligned_le32(opts->nth_sign, tmp); /* dwSignature */
+		tmp += 2;
+		/* wHeaderLength */
+		put_unaligned_le16(opts->nth_size, tmp++);
+
+		tmp = (void *)skb_put(ncm->skb_tx_ndp, opts->ndp_size);
+		memset(tmp, 0, opts->ndp_size);
+		put_unaligned_le32(ncm->ndp_sign, tmp); /* dwSignature */
 	}
 
-	skb2 = skb_copy_expand(skb, ncb_len,
-			       max_size - skb->len - ncb_len - crc_len,
-			       GFP_ATOMIC);
-	dev_kfree_skb_any(skb);
-	if (!skb2)
-		return NULL;
-
-	skb = skb2;
-
-	tmp = (void *) skb_push(skb, ncb_len);
-	memset(tmp, 0, ncb_len);
-
-	put_unaligned_le32(opts->nth_sign, tmp); /* dwSignature */
-	tmp += 2;
-	/* wHeaderLength */
-	put_unaligned_le16(opts->nth_size, tmp++);
-	tmp++; /* skip wSequence */
-	put_ncm(&tmp, opts->block_length, skb->len); /* (d)wBlockLength */
-	/* (d)wFpIndex */
-	/* the first pointer is right after the NTH + align */
-	put_ncm(&tmp, opts->fp_index, opts->nth_size + ndp_pad);
-
-	tmp = (void *)tmp + ndp_pad;
-
-	/* NDP */
-	put_unaligned_le32(ncm->ndp_sign, tmp); /* dwSignature */
-	tmp += 2;
-	/* wLength */
-	put_unaligned_le16(ncb_len - opts->nth_size - pad, tmp++);
-
-	tmp += opts->reserved1;
-	tmp += opts->next_fp_index; /* skip reserved (d)wNextFpIndex */
-	tmp += opts->reserved2;
-
+	pad = ALIGN(ncm->skb_tx_data->len, div) + rem -
+	      ncm->skb_tx_data->len;
+	tmp = (void *)skb_put(ncm->skb_tx_ndp, dpe_len);
+	/* (d)wDatagramIndex */
+	put_ncm(&tmp, opts->dgram_item_len, ncm->skb_tx_data->len + pad);
+	/* (d)wDatagramLength */
+	put_ncm(&tmp, opts->dgram_item_len, skb->len + crc_len);
+	ncm->ndp_dgram_count++;
+
+	memset(skb_put(ncm->skb_tx_data, pad), 0, pad);
+	skb_copy_bits(skb, 0, skb_put(ncm->skb_tx_data, skb->len), skb->len);
 	if (ncm->is_crc) {
 		uint32_t crc;
 
 		crc = ~crc32_le(~0,
-				skb->data + ncb_len,
-				skb->len - ncb_len);
-		put_unaligned_le32(crc, skb->data + skb->len);
-		skb_put(skb, crc_len);
+				ncm->skb_tx_data->data +
+				ncm->skb_tx_data->len - skb->len,
+				skb->len);
+		put_unaligned_le32(crc, skb_put(ncm->skb_tx_data, crc_len));
 	}
+	dev_kfree_skb_any(skb);
+	return skb2;
 
-	/* (d)wDatagramIndex[0] */
-	put_ncm(&tmp, opts->dgram_item_len, ncb_len);
-	/* (d)wDatagramLength[0] */
-	put_ncm(&tmp, opts->dgram_item_len, skb->len - ncb_len);
-	/* (d)wDatagramIndex[1] and  (d)wDatagramLength[1] already zeroed */
-
-	if (skb->len > MAX_TX_NONFIXED)
-		memset(skb_put(skb, max_size - skb->len),
-		       0, max_size - skb->len);
-
-	return skb;
+drop:
+	if (ncm->netdev)
+		ncm->netdev->stats.tx_dropped++;
+	dev_kfree_skb_any(skb);
+	return skb2;
 }
 
 static int ncm_unwrap_ntb(struct gether *port,
@@ -1094,8 +1144,10 @@ static void ncm_disable(struct usb_function *f)
 
 	DBG(cdev, "ncm deactivated\n");
 
-	if (ncm->port.in_ep->driver_data)
+	if (ncm->port.in_ep->driver_data) {
 		gether_disconnect(&ncm->port);
+		ncm_free_tx(ncm);
+	}
 
 	if (ncm->notify->driver_data) {
 		usb_ep_disable(ncm->notify);
@@ -1338,6 +1390,7 @@ int __init ncm_bind_config(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 	ncm_reset_values(ncm);
 	ncm->port.ioport = dev;
 	ncm->port.is_fixed = true;
+	ncm->port.supports_multi_frame = true;
 
 	ncm->port.func.name = "cdc_network";
 	ncm->port.func.strings = ncm_strings;
@@ -78,6 +78,8 @@ struct f_rndis {
 	struct usb_ep			*notify;
 	struct usb_request		*notify_req;
 	atomic_t			notify_count;
+
+	struct sk_buff			*tx_skb;	/* messages kept */
 };
 
 static inline struct f_rndis *func_to_rndis(struct usb_function *f)
@@ -368,13 +370,70 @@ static struct usb_gadget_strings *rndis_strings[] = {
 #define DMA_ALIGN_ROOM 4
 #endif
 
+/*
+ * Frames to the host are sent as several REMOTE_NDIS_PACKET_MSGs one after
+ * the other in a transfer, of up to the MaxTransferSize the host gave in
+ * its INITIALIZE and rndis_dl_max_xfer. Each message is padded to
+ * RNDIS_PACKET_ALIGN, the padding is part of its MessageLength.
+ */
+#define RNDIS_PACKET_ALIGN	8
+
+static unsigned int rndis_dl_max_xfer = 16384;
+module_param(rndis_dl_max_xfer, uint, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(rndis_dl_max_xfer, "largest multi packet IN transfer");
+
 /*-------------------------------------------------------------------------*/
 
+static void rndis_free_tx(struct f_rndis *rndis)
+{
+	if (rndis->tx_skb)
+		dev_kfree_skb_any(rndis->tx_skb);
+	rndis->tx_skb = NULL;
+}
+
 static struct sk_buff *rndis_add_header(struct gether *port,
 					struct sk_buff *skb)
 {
-	struct sk_buff *skb2;
+	struct f_rndis *rndis = func_to_rndis(&port->func);
+	struct rndis_packet_msg_type *header;
+	struct sk_buff *skb2 = NULL;
+	unsigned max_xfer, len;
+
+	/* u_ether flushing what is kept */
+	if (!skb) {
+		swap(skb2, rndis->tx_skb);
+		return skb2;
+	}
+
+	max_xfer = min(rndis_dl_max_xfer, rndis_host_max_xfer(rndis->config));
+	len = ALIGN(sizeof(*header) + skb->len, RNDIS_PACKET_ALIGN);
+
+	/* no room for a second message, sent alone */
+	if (!rndis->tx_skb && len > max_xfer / 2)
+		goto single;
+
+	if (rndis->tx_skb && rndis->tx_skb->len + len > max_xfer)
+		swap(skb2, rndis->tx_skb);
+	if (!rndis->tx_skb) {
+		rndis->tx_skb = alloc_skb(max(max_xfer, len), GFP_ATOMIC);
+		if (!rndis->tx_skb) {
+			dev_kfree_skb_any(skb);
+			return skb2;
+		}
+	}
+
+	header = (void *)skb_put(rndis->tx_skb, len);
+	memset(header, 0, len);
+	header->MessageType = cpu_to_le32(RNDIS_MSG_PACKET);
+	header->MessageLength = cpu_to_le32(len);
+	header->DataOffset = cpu_to_le32(36);
+	header->DataLength = cpu_to_le32(skb->len);
+	skb_copy_bits(skb, 0, header + 1, skb->len);
+
+	dev_kfree_skb_any(skb);
+	return skb2;
 
+single:
 	skb2 = skb_realloc_headroom(skb, sizeof(struct rndis_packet_msg_type)
 #ifdef CONFIG_USB_ETH_SKB_ALLOC_OPTIMIZATION
 		+ DMA_ALIGN_ROOM
@@ -585,6 +644,7 @@ static int rndis_set_alt(struct usb_function *f, unsigned intf, unsigned alt)
 		if (rndis->port.in_ep->driver_data) {
 			DBG(cdev, "reset rndis\n");
 			gether_disconnect(&rndis->port);
+			rndis_free_tx(rndis);
 		}
 
 		if (!rndis->port.in_ep->desc || !rndis->port.out_ep->desc) {
@@ -643,6 +703,7 @@ static void rndis_disable(struct usb_function *f)
 
 	rndis_uninit(rndis->config);
 	gether_disconnect(&rndis->port);
+	rndis_free_tx(rndis);
 
 	usb_ep_disable(rndis->notify);
 	rndis->notify->driver_data = NULL;
@@ -877,6 +938,7 @@ rndis_bind_config_vendor(struct usb_configuration *c, u8 ethaddr[ETH_ALEN],
 
 	/* RNDIS has special (and complex) framing */
 	rndis->port.header_len = sizeof(struct rndis_packet_msg_type);
+	rndis->port.supports_multi_frame = true;
 	rndis->port.wrap = rndis_add_header;
 	rndis->port.unwrap = rndis_rm_hdr;
 
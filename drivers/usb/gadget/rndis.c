@@ -576,6 +576,7 @@ static int rndis_init_response(int configNr, rndis_init_msg_type *buf)
 	if (!r)
 		return -ENOMEM;
 	resp = (rndis_init_cmplt_type *)r->buf;
+	params->host_max_xfer = le32_to_cpu(buf->MaxTransferSize);
 
 	resp->MessageType = cpu_to_le32(RNDIS_MSG_INIT_C);
 	resp->MessageLength = cpu_to_le32(52);
@@ -770,6 +771,14 @@ int rndis_signal_disconnect(int configNr)
 					  RNDIS_STATUS_MEDIA_DISCONNECT);
 }
 
+/* the largest transfer the host takes, 0 before it initialized us */
+u32 rndis_host_max_xfer(int configNr)
+{
+	if (configNr >= RNDIS_MAX_CONFIGS)
+		return 0;
+	return rndis_per_dev_params[configNr].host_max_xfer;
+}
+
 void rndis_uninit(int configNr)
 {
 	u8 *buf;
@@ -778,6 +787,7 @@ void rndis_uninit(int configNr)
 	if (configNr >= RNDIS_MAX_CONFIGS)
 		return;
 	rndis_per_dev_params[configNr].state = RNDIS_UNINITIALIZED;
+	rndis_per_dev_params[configNr].host_max_xfer = 0;
 
 	/* drain the response queue */
 	while ((buf = rndis_get_next_response(configNr, &length)))
@@ -183,6 +183,7 @@ typedef struct rndis_params
 	u32			medium;
 	u32			speed;
 	u32			media_state;
+	u32			host_max_xfer;	/* from REMOTE_NDIS_INITIALIZE */
 
 	const u8		*host_mac;
 	u16			*filter;
@@ -214,6 +215,7 @@ void rndis_uninit (int configNr);
 int  rndis_signal_connect (int configNr);
 int  rndis_signal_disconnect (int configNr);
 int  rndis_state (int configNr);
+u32  rndis_host_max_xfer(int configNr);
 extern void rndis_set_host_mac (int configNr, const u8 *addr);
 
 int rndis_init(void);
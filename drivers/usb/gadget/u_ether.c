@@ -22,6 +22,10 @@
 #include <linux/ethtool.h>
 #include <linux/if_vlan.h>
 #include <linux/brcm_console.h>
+#include <linux/debugfs.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/seq_file.h>
 
 #include "u_ether.h"
 
@@ -45,6 +49,13 @@
  * responsible for ensuring that each configuration includes at most one
  * instance of is network link.  (The network layer provides ways for
  * this single "physical" link to be used by multiple virtual links.)
+ *
+ * Functions with multi frame framing (NCM, RNDIS) may keep tx frames to
+ * send them in one transfer; what they keep is flushed tx_flush_us after
+ * the first one, or once a tx request is free if none was at the time.
+ * Received frames go through NAPI and GRO. Transfers and frames in both
+ * directions are counted in debugfs u_ether_<netdev>, writing to it
+ * clears the counters.
  */
 
 #define UETH__VERSION	"29-May-2008"
@@ -169,6 +180,26 @@ struct eth_dev {
 #endif
 	bool			zlp;
 	u8			host_mac[ETH_ALEN];
+
+	/* frames kept by a multi frame wrap */
+	struct hrtimer		tx_flush_timer;
+	struct tasklet_struct	tx_flush_tasklet;
+	bool			tx_flush_pending;	/* under req_lock */
+
+	struct napi_struct	napi;
+	struct sk_buff_head	rx_napi_frames;
+
+	struct ueth_stats {
+		u32		tx_xfers;
+		u32		tx_frames;
+		u32		tx_flushes;
+		u32		rx_xfers;
+		u32		rx_frames;
+		u64		tx_bytes;
+		u64		rx_bytes;
+		ktime_t		since;
+	} stats;
+	struct dentry		*debugfs;
 };
 
 #ifdef CONFIG_BRCM_NETCONSOLE
@@ -324,6 +355,10 @@ static unsigned qmult = 5;
 module_param(qmult, uint, S_IRUGO|S_IWUSR);
 MODULE_PARM_DESC(qmult, "queue length multiplier at high/super speed");
 
+static unsigned tx_flush_us = 300;
+module_param(tx_flush_us, uint, S_IRUGO|S_IWUSR);
+MODULE_PARM_DESC(tx_flush_us, "longest wait of a tx frame kept for more");
+
 /* for dual-speed hardware, use deeper queues at high/super speed */
 static inline int qlen(struct usb_gadget *gadget)
 {
@@ -567,6 +602,8 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 	/* normal completion */
 	case 0:
 		skb_put(skb, req->actual);
+		dev->stats.rx_xfers++;
+		dev->stats.rx_bytes += req->actual;
 
 		if (dev->unwrap) {
 			unsigned long	flags;
@@ -600,14 +637,16 @@ static void rx_complete(struct usb_ep *ep, struct usb_request *req)
 			skb2->protocol = eth_type_trans(skb2, dev->net);
 			dev->net->stats.rx_packets++;
 			dev->net->stats.rx_bytes += skb2->len;
+			dev->stats.rx_frames++;
 
 			/* no buffer copies needed, unless hardware can't
 			 * use skb buffers.
 			 */
-			status = netif_rx(skb2);
+			skb_queue_tail(&dev->rx_napi_frames, skb2);
 next_frame:
 			skb2 = skb_dequeue(&dev->rx_frames);
 		}
+		napi_schedule(&dev->napi);
 		break;
 
 	/* software-driven interface shutdown */
@@ -649,6 +688,28 @@ clean:
 		rx_submit(dev, req, GFP_ATOMIC);
 }
 
+/* received frames to GRO, in softirq context */
+static int eth_rx_poll(struct napi_struct *napi, int budget)
+{
+	struct eth_dev	*dev = container_of(napi, struct eth_dev, napi);
+	struct sk_buff	*skb;
+	int		work = 0;
+
+	while (work < budget &&
+	       (skb = skb_dequeue(&dev->rx_napi_frames)) != NULL) {
+		napi_gro_receive(napi, skb);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		/* queued by rx_complete between the dequeue and here */
+		if (!skb_queue_empty(&dev->rx_napi_frames))
+			napi_schedule(napi);
+	}
+	return work;
+}
+
 static int prealloc(struct list_head *list, struct usb_ep *ep, unsigned n)
 {
 	unsigned		i;
@@ -828,11 +889,18 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 		break;
 	case 0:
 		dev->net->stats.tx_bytes += skb->len;
+		dev->stats.tx_bytes += skb->len;
 	}
 	dev->net->stats.tx_packets++;
+	dev->stats.tx_xfers++;
 
 	spin_lock(&dev->req_lock);
 	list_add(&req->list, &dev->tx_reqs);
+	/* a flush found no request, what was kept can go now */
+	if (dev->tx_flush_pending) {
+		dev->tx_flush_pending = false;
+		tasklet_schedule(&dev->tx_flush_tasklet);
+	}
 	spin_unlock(&dev->req_lock);
 	dev_kfree_skb_any(skb);
 
@@ -841,6 +909,38 @@ static void tx_complete(struct usb_ep *ep, struct usb_request *req)
 		netif_wake_queue(dev->net);
 }
 
+static void eth_tx_flush_arm(struct eth_dev *dev)
+{
+	if (!hrtimer_active(&dev->tx_flush_timer))
+		hrtimer_start(&dev->tx_flush_timer,
+			      ns_to_ktime((u64)tx_flush_us * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+}
+
+static enum hrtimer_restart eth_tx_flush_timer(struct hrtimer *timer)
+{
+	struct eth_dev	*dev = container_of(timer, struct eth_dev,
+					    tx_flush_timer);
+
+	tasklet_schedule(&dev->tx_flush_tasklet);
+	return HRTIMER_NORESTART;
+}
+
+static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
+					struct net_device *net);
+
+/* sends the frames a multi frame wrap kept, as the stack would xmit */
+static void eth_tx_flush(unsigned long data)
+{
+	struct eth_dev		*dev = (void *)data;
+	struct netdev_queue	*txq = netdev_get_tx_queue(dev->net, 0);
+
+	__netif_tx_lock_bh(txq);
+	dev->stats.tx_flushes++;
+	eth_start_xmit(NULL, dev->net);
+	__netif_tx_unlock_bh(txq);
+}
+
 static inline int is_promisc(u16 cdc_filter)
 {
 	return cdc_filter & USB_CDC_PACKET_TYPE_PROMISCUOUS;
@@ -856,24 +956,29 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	unsigned long		flags;
 	struct usb_ep		*in;
 	u16			cdc_filter;
+	bool			multi_frame;
 
 	spin_lock_irqsave(&dev->lock, flags);
 	if (dev->port_usb) {
 		in = dev->port_usb->in_ep;
 		cdc_filter = dev->port_usb->cdc_filter;
+		multi_frame = dev->port_usb->supports_multi_frame;
 	} else {
 		in = NULL;
 		cdc_filter = 0;
+		multi_frame = false;
 	}
 	spin_unlock_irqrestore(&dev->lock, flags);
 
-	if (!in) {
-		dev_kfree_skb_any(skb);
+	/* a NULL skb is eth_tx_flush() asking for the kept frames */
+	if (!in || (!skb && !multi_frame)) {
+		if (skb)
+			dev_kfree_skb_any(skb);
 		return NETDEV_TX_OK;
 	}
 
 	/* apply outgoing CDC or RNDIS filters */
-	if (!is_promisc(cdc_filter)) {
+	if (skb && !is_promisc(cdc_filter)) {
 		u8		*dest = skb->data;
 
 		if (is_multicast_ether_addr(dest)) {
@@ -901,6 +1006,8 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	 * network stack decided to xmit but before we got the spinlock.
 	 */
 	if (list_empty(&dev->tx_reqs)) {
+		if (!skb)
+			dev->tx_flush_pending = true;
 		spin_unlock_irqrestore(&dev->req_lock, flags);
 		return NETDEV_TX_BUSY;
 	}
@@ -917,16 +1024,25 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 	 * or the hardware can't use skb buffers.
 	 * or there's not enough space for extra headers we need
 	 */
-	if (skb->signature != SKB_NETPOLL_SIGNATURE) {
+	if (skb)
+		dev->stats.tx_frames++;
+	if (!skb || skb->signature != SKB_NETPOLL_SIGNATURE) {
 		if (dev->wrap) {
 			unsigned long	flags;
+			bool		frame = skb != NULL;
 
 			spin_lock_irqsave(&dev->lock, flags);
 			if (dev->port_usb)
 				skb = dev->wrap(dev->port_usb, skb);
 			spin_unlock_irqrestore(&dev->lock, flags);
-			if (!skb)
-				goto drop;
+			if (!skb) {
+				if (!multi_frame)
+					goto drop;
+				/* not dropped, kept for a later transfer */
+				if (frame)
+					eth_tx_flush_arm(dev);
+				goto multiframe;
+			}
 #ifdef CONFIG_USB_ETH_SKB_ALLOC_OPTIMIZATION
 			/* The following is to eliminate to malloc for
 				the unaligned memory*/
@@ -944,6 +1060,9 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 #endif
 		}
 	}
+	/* the link went away before the flush got to the wrap */
+	if (!skb)
+		goto multiframe;
 	length = skb->len;
 
 	req->buf = skb->data;
@@ -996,6 +1115,7 @@ static netdev_tx_t eth_start_xmit(struct sk_buff *skb,
 		dev_kfree_skb_any(skb);
 drop:
 		dev->net->stats.tx_dropped++;
+multiframe:
 		spin_lock_irqsave(&dev->req_lock, flags);
 		if (list_empty(&dev->tx_reqs))
 			netif_start_queue(net);
@@ -1029,6 +1149,8 @@ static int eth_open(struct net_device *net)
 	struct gether	*link;
 
 	DBG(dev, "%s\n", __func__);
+	skb_queue_purge(&dev->rx_napi_frames);
+	napi_enable(&dev->napi);
 	if (netif_carrier_ok(dev->net))
 		eth_start(dev, GFP_KERNEL);
 
@@ -1048,6 +1170,8 @@ static int eth_stop(struct net_device *net)
 
 	VDBG(dev, "%s\n", __func__);
 	netif_stop_queue(net);
+	napi_disable(&dev->napi);
+	skb_queue_purge(&dev->rx_napi_frames);
 
 	DBG(dev, "stop stats: rx/tx %ld/%ld, errs %ld/%ld\n",
 		dev->net->stats.rx_packets, dev->net->stats.tx_packets,
@@ -1141,6 +1265,70 @@ static struct device_type gadget_type = {
 	.name	= "gadget",
 };
 
+#ifdef CONFIG_DEBUG_FS
+
+static int ueth_stats_show(struct seq_file *m, void *v)
+{
+	struct eth_dev		*dev = m->private;
+	struct ueth_stats	s = dev->stats;
+	s64			us = ktime_us_delta(ktime_get(), s.since);
+
+	seq_printf(m, "tx %u xfers %u frames %u.%02u frames/xfer %u flushes "
+		   "%llu bytes %llu KB/s\n", s.tx_xfers, s.tx_frames,
+		   s.tx_xfers ? s.tx_frames / s.tx_xfers : 0,
+		   s.tx_xfers ? s.tx_frames % s.tx_xfers * 100 / s.tx_xfers : 0,
+		   s.tx_flushes, s.tx_bytes,
+		   us > 0 ? div64_u64((s.tx_bytes >> 10) * USEC_PER_SEC, us)
+			  : 0);
+	seq_printf(m, "rx %u xfers %u frames %u.%02u frames/xfer "
+		   "%llu bytes %llu KB/s\n", s.rx_xfers, s.rx_frames,
+		   s.rx_xfers ? s.rx_frames / s.rx_xfers : 0,
+		   s.rx_xfers ? s.rx_frames % s.rx_xfers * 100 / s.rx_xfers : 0,
+		   s.rx_bytes,
+		   us > 0 ? div64_u64((s.rx_bytes >> 10) * USEC_PER_SEC, us)
+			  : 0);
+	return 0;
+}
+
+static int ueth_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ueth_stats_show, inode->i_private);
+}
+
+static ssize_t ueth_stats_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct eth_dev	*dev = ((struct seq_file *)file->private_data)->private;
+
+	memset(&dev->stats, 0, sizeof(dev->stats));
+	dev->stats.since = ktime_get();
+	return count;
+}
+
+static const struct file_operations ueth_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= ueth_stats_open,
+	.read		= seq_read,
+	.write		= ueth_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void ueth_debugfs_init(struct eth_dev *dev)
+{
+	char	name[IFNAMSIZ + 8];
+
+	snprintf(name, sizeof(name), "u_ether_%s", dev->net->name);
+	dev->debugfs = debugfs_create_file(name, S_IRUGO | S_IWUSR, NULL, dev,
+					   &ueth_stats_fops);
+}
+
+#else
+
+static inline void ueth_debugfs_init(struct eth_dev *dev) { }
+
+#endif
+
 /**
  * gether_setup_name - initialize one ethernet-over-usb link
  * @g: gadget to associated with these links
@@ -1173,6 +1361,11 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	INIT_LIST_HEAD(&dev->tx_reqs);
 	INIT_LIST_HEAD(&dev->rx_reqs);
 	skb_queue_head_init(&dev->rx_frames);
+	skb_queue_head_init(&dev->rx_napi_frames);
+	hrtimer_init(&dev->tx_flush_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dev->tx_flush_timer.function = eth_tx_flush_timer;
+	tasklet_init(&dev->tx_flush_tasklet, eth_tx_flush, (unsigned long)dev);
+	dev->stats.since = ktime_get();
 
 #ifdef CONFIG_USB_ETH_SKB_ALLOC_OPTIMIZATION
 	spin_lock_init(&dev->req_rx_lock);
@@ -1217,6 +1410,7 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 		memcpy(ethaddr, dev->host_mac, ETH_ALEN);
 
 	net->netdev_ops = &eth_netdev_ops;
+	netif_napi_add(net, &dev->napi, eth_rx_poll, NAPI_POLL_WEIGHT);
 
 	SET_ETHTOOL_OPS(net, &ops);
 
@@ -1232,6 +1426,7 @@ struct eth_dev *gether_setup_name(struct usb_gadget *g, u8 ethaddr[ETH_ALEN],
 	} else {
 		INFO(dev, "MAC %pM\n", net->dev_addr);
 		INFO(dev, "HOST MAC %pM\n", dev->host_mac);
+		ueth_debugfs_init(dev);
 
 		/* two kinds of host-initiated state changes:
 		 *  - iff DATA transfer is active, carrier is "on"
@@ -1256,8 +1451,12 @@ void gether_cleanup(struct eth_dev *dev)
 	if (!dev)
 		return;
 
+	debugfs_remove(dev->debugfs);
 	unregister_netdev(dev->net);
 	flush_work(&dev->work);
+	hrtimer_cancel(&dev->tx_flush_timer);
+	tasklet_kill(&dev->tx_flush_tasklet);
+	skb_queue_purge(&dev->rx_napi_frames);
 #ifdef CONFIG_USB_ETH_SKB_ALLOC_OPTIMIZATION
 	flush_workqueue(dev->rx_workqueue);
 	destroy_workqueue(dev->rx_workqueue);
@@ -1387,6 +1586,8 @@ void gether_disconnect(struct gether *link)
 
 	netif_stop_queue(dev->net);
 	netif_carrier_off(dev->net);
+	/* the function drops what its wrap kept, once port_usb is gone */
+	hrtimer_cancel(&dev->tx_flush_timer);
 
 	/* disable endpoints, forcing (synchronous) completion
 	 * of all pending i/o.  then free the request objects
@@ -54,6 +54,13 @@ struct gether {
 	bool				is_fixed;
 	u32				fixed_out_len;
 	u32				fixed_in_len;
+	/*
+	 * A multi frame wrap may keep frames to send several in one
+	 * transfer, returning NULL or an earlier transfer. It is then
+	 * called with a NULL skb to hand over what it keeps, at most
+	 * u_ether's tx_flush_us after it kept the first one.
+	 */
+	bool				supports_multi_frame;
 	struct sk_buff			*(*wrap)(struct gether *port,
 						struct sk_buff *skb);
 	int				(*unwrap)(struct gether *port,
@@ -29,6 +29,7 @@
 
 #include <plat/reg_axipv.h>
 #include <plat/axipv.h>
+#include <linux/broadcom/frame_timeline.h>
 
 #ifdef AXIPV_HAS_CLK
 #include <linux/clk.h>
@@ -70,6 +71,8 @@ static irqreturn_t axipv_isr(int err, void *dev_id);
 static bool g_axipv_init;
 static volatile u32 g_nxt, g_curr;
 static DEFINE_SPINLOCK(lock);
+/* line buffer and frame underflows seen, see axipv_get_underruns() */
+static u32 g_underruns;
 
 struct axipv_buff {
 	u32 addr;
@@ -93,9 +96,12 @@ struct axipv_dev {
 	struct clk *clk;
 #endif
 	struct axipv_buff buff[AXIPV_MAX_DISP_BUFF_SUPP];
+	/* Posts waiting for the NXT_FRAME slot, oldest at q_head */
+	u32 queue[AXIPV_QUEUE_DEPTH];
+	u8 q_head;
+	u8 q_cnt;
 	struct axipv_config_t config;
 	struct work_struct irq_work;
-	struct work_struct release_work;
 	void (*irq_cb)(int err);
 	void (*release_cb)(u32 free_buf);
 	void (*vsync_cb)(void);
@@ -220,27 +226,51 @@ static void process_irq(struct work_struct *work)
 	dev->irq_cb(irq_stat);
 }
 
-static void process_release(struct work_struct *work)
+/* Must be called with lock held */
+static void axipv_release(struct axipv_dev *dev, u32 addr)
 {
-	int i, err;
-	struct axipv_dev *dev = container_of(work, struct axipv_dev,
-						release_work);
-	struct axipv_buff *buff =  dev->buff;
-	unsigned long flags;
+	int err;
 
-	spin_lock_irqsave(&lock, flags);
-	for (i = 0; i < AXIPV_MAX_DISP_BUFF_SUPP; i++) {
-		if (AXIPV_BUFF_TXFERED == buff[i].status) {
-			axipv_debug("releasing %p\n", (void *) buff[i].addr);
-			err = axipv_set_buff_status(buff, buff[i].addr,
-						AXIPV_BUFF_AVAILABLE);
-			dev->release_cb(buff[i].addr);
-			if (err)
-				axipv_err("couldn't set buff status err=%d\n",
-					err);
-		}
+	err = axipv_set_buff_status(dev->buff, addr, AXIPV_BUFF_AVAILABLE);
+	if (err) {
+		axipv_debug("couldn't release 0x%x err=%d\n", addr, err);
+		return;
 	}
-	spin_unlock_irqrestore(&lock, flags);
+	axipv_debug("releasing %p\n", (void *) addr);
+	dev->release_cb(addr);
+}
+
+/* Must be called with lock held */
+static inline bool axipv_queue_has(struct axipv_dev *dev, u32 addr)
+{
+	int i;
+	for (i = 0; i < dev->q_cnt; i++) {
+		if (addr == dev->queue[(dev->q_head + i) % AXIPV_QUEUE_DEPTH])
+			return true;
+	}
+	return false;
+}
+
+/* Must be called with lock held */
+static inline u32 axipv_queue_pop(struct axipv_dev *dev)
+{
+	u32 addr;
+
+	if (!dev->q_cnt)
+		return 0;
+	addr = dev->queue[dev->q_head];
+	dev->q_head = (dev->q_head + 1) % AXIPV_QUEUE_DEPTH;
+	dev->q_cnt--;
+	return addr;
+}
+
+/* Must be called with lock held */
+static void axipv_queue_flush(struct axipv_dev *dev)
+{
+	u32 addr;
+
+	while ((addr = axipv_queue_pop(dev)))
+		axipv_release(dev, addr);
 }
 
 
@@ -312,7 +342,6 @@ int axipv_init(struct axipv_init_t *init, struct axipv_config_t **config)
 	dev->release_cb = init->release_cb;
 	dev->vsync_cb = init->vsync_cb;
 	INIT_WORK(&dev->irq_work, process_irq);
-	INIT_WORK(&dev->release_work, process_release);
 	for (i = 0; i < AXIPV_MAX_DISP_BUFF_SUPP; i++)
 		dev->buff[i].status = AXIPV_BUFF_AVAILABLE;
 	if (!g_display_enabled) {
@@ -385,6 +414,8 @@ static inline int axipv_config(struct axipv_config_t *config)
 	axipv_debug("posting %p\n", (void *) buff->addr);
 	g_nxt = buff->addr;
 	g_curr = buff->addr;
+	dev->q_head = 0;
+	dev->q_cnt = 0;
 	buff_index = axipv_get_free_buff_index(dev->buff);
 	if (buff_index >= AXIPV_MAX_DISP_BUFF_SUPP)
 		axipv_err("Couldn't get free buff index\n");
@@ -451,13 +482,7 @@ static inline int axipv_config(struct axipv_config_t *config)
 	return 0;
 }
 
-#define axipv_release_buff(addr) \
-	do { \
-		u32 err = axipv_set_buff_status(dev->buff, addr,\
-		AXIPV_BUFF_TXFERED); \
-		if (!err)\
-			schedule_work(&dev->release_work);\
-	} while (0)
+#define axipv_release_buff(addr) axipv_release(dev, addr)
 
 static bool __is_fifo_draining_eof(struct axipv_dev *dev)
 {
@@ -496,6 +521,8 @@ static irqreturn_t axipv_isr(int err, void *dev_id)
 		readl(axipv_base + REG_CTRL));
 		disable_clk = true;
 	}
+	if (irq_stat & (FRAME_UNDFL_INT | LINE_BUF_UNDFL_INT))
+		g_underruns++;
 	if ((irq_stat & PV_START_THRESH_INT) && (dev->config.cmd)) {
 		/* Change PV_START_THRESH_INT to (WC - 1) where
 		 * WC = WordCount or packetsize chosen in DSI.
@@ -545,6 +572,13 @@ static irqreturn_t axipv_isr(int err, void *dev_id)
 			if (AXIPV_STOPPING == dev->state)
 				dev->state = AXIPV_STOPPED;
 		}
+		/* NXT_FRAME has been latched, hand the oldest queued post
+		 * to the hardware */
+		if ((g_curr == g_nxt) && dev->q_cnt
+			&& (AXIPV_ENABLED == dev->state)) {
+			g_nxt = axipv_queue_pop(dev);
+			writel(g_nxt, axipv_base + REG_NXT_FRAME);
+		}
 		writel(FRAME_END_INT, axipv_base + REG_INTR_CLR);
 		if (AXIPV_STOPPED != dev->state)
 			irq_stat = irq_stat & ~FRAME_END_INT;
@@ -559,6 +593,7 @@ static irqreturn_t axipv_isr(int err, void *dev_id)
 			axipv_release_buff(g_nxt);
 			g_nxt = 0;
 		}
+		axipv_queue_flush(dev);
 		disable_axipv = true;
 		disable_clk = true;
 		/* Client needs to be informed of the disabled state */
@@ -606,50 +641,85 @@ static irqreturn_t axipv_isr(int err, void *dev_id)
 
 static inline int post_async(struct axipv_config_t *config)
 {
-	u32 curr_reg_val;
+	u32 curr_reg_val, addr;
 	struct axipv_dev *dev;
 	u32 axipv_base;
 	int buff_index;
+	unsigned long flags;
 
 	dev = container_of(config, struct axipv_dev, config);
 	axipv_base = dev->base_addr;
+	addr = config->buff.async;
 
-	axipv_debug("new buff posted 0x%x\n", config->buff.async);
+	axipv_debug("new buff posted 0x%x\n", addr);
 
+	spin_lock_irqsave(&lock, flags);
 	/* Handle the unusal case by bypassing the hardware since the hardware
 	 * is transferring the same buffer */
-	if ((config->buff.async == g_curr) || (config->buff.async == g_nxt)) {
+	if ((addr == g_curr) || (addr == g_nxt)
+		|| axipv_queue_has(dev, addr)) {
 		axipv_err("Likely tearing on screen posted:0x%x curr= 0x%x nxt=0x%x\n",
-		config->buff.async, g_curr, g_nxt);
+		addr, g_curr, g_nxt);
 		axipv_dump_buff_status(dev->buff);
-		dev->release_cb(config->buff.async);
+		dev->release_cb(addr);
+		spin_unlock_irqrestore(&lock, flags);
 		return 0;
 	}
 
-	writel(config->buff.async, axipv_base + REG_NXT_FRAME);
 	curr_reg_val = readl(axipv_base + REG_CUR_FRAME);
+	/* When the previous post is yet to be latched and the queue is full,
+	 * the oldest waiting post is dropped to make room */
+	if ((curr_reg_val != g_nxt) && (AXIPV_QUEUE_DEPTH == dev->q_cnt)) {
+		u32 skipped = axipv_queue_pop(dev);
+		axipv_debug("skipped buff=0x%x\n", skipped);
+		axipv_release_buff(skipped);
+	}
+
 	buff_index = axipv_get_free_buff_index(dev->buff);
 	if (buff_index >= AXIPV_MAX_DISP_BUFF_SUPP) {
 		axipv_err("Couldn't get free buff index\n");
 	} else {
-		axipv_add_new_buff_info(dev->buff, buff_index,
-					config->buff.async);
+		axipv_add_new_buff_info(dev->buff, buff_index, addr);
 	}
-	/* if ((curr_reg_val == g_curr)
-		|| (curr_reg_val == config->buff.async)) {*/
-	if (curr_reg_val != g_nxt) {
-		/* Skipped buffer has to be released*/
-		if (g_nxt) {
-			axipv_debug("skipped buff=0x%x\n", g_nxt);
-			axipv_release_buff(g_nxt);
-			g_nxt = 0;
-		}
+
+	if (curr_reg_val == g_nxt) {
+		/* NXT_FRAME slot is free, program it right away */
+		writel(addr, axipv_base + REG_NXT_FRAME);
+		g_nxt = addr;
+	} else {
+		/* Let axipv_isr program it at the next frame end */
+		dev->queue[(dev->q_head + dev->q_cnt) % AXIPV_QUEUE_DEPTH] =
+									addr;
+		dev->q_cnt++;
 	}
-	g_nxt = config->buff.async;
+	spin_unlock_irqrestore(&lock, flags);
 
 	return 0;
 }
 
+#ifdef CONFIG_AXIPV_SYNC_POST
+/* Bring-up aid: queue the buffer and wait for AXIPV to latch it */
+static inline int post_async_wait(struct axipv_config_t *config)
+{
+	struct axipv_dev *dev;
+	u32 addr = config->buff.async;
+	int ret, tries = 50;
+
+	dev = container_of(config, struct axipv_dev, config);
+	ret = post_async(config);
+	while (!ret && (g_curr != addr) && tries--) {
+		if (AXIPV_ENABLED != dev->state)
+			return -ENODEV;
+		usleep_range(1000, 1100);
+	}
+	if (g_curr != addr) {
+		axipv_err("0x%x not latched\n", addr);
+		ret = -ETIMEDOUT;
+	}
+	return ret;
+}
+#endif
+
 static inline int post_sync(struct axipv_config_t *config)
 {
 	int buff_index;
@@ -734,8 +804,13 @@ int axipv_post(struct axipv_config_t *config)
 	if (AXIPV_ENABLED != dev->state)
 		return -ENODEV;
 
+	frame_tl_stamp(FRAME_TL_POST);
 	if (dev->config.async)
+#ifdef CONFIG_AXIPV_SYNC_POST
+		return post_async_wait(config);
+#else
 		return post_async(config);
+#endif
 	else
 		return post_sync(config);
 }
@@ -908,6 +983,7 @@ int axipv_change_state(u32 event, struct axipv_config_t *config)
 						AXIPV_BUFF_AVAILABLE);
 				dev->release_cb(g_nxt);
 			}
+			axipv_queue_flush(dev);
 			g_curr = 0;
 			g_nxt = 0;
 			dump_debug_info(dev);
@@ -946,10 +1022,10 @@ int axipv_change_state(u32 event, struct axipv_config_t *config)
 				axipv_release_buff(g_curr);
 			if (g_nxt && (g_nxt != g_curr))
 				axipv_release_buff(g_nxt);
+			axipv_queue_flush(dev);
 			g_curr = 0;
 			g_nxt = 0;
 			spin_unlock_irqrestore(&lock, flags);
-			process_release(&dev->release_work);
 		}
 		axipv_clk_disable(dev);
 		break;
@@ -974,13 +1050,18 @@ int axipv_get_state(struct axipv_config_t *config)
 	return dev->state;
 }
 
+u32 axipv_get_underruns(void)
+{
+	return ACCESS_ONCE(g_underruns);
+}
+
 int axipv_check_completion(u32 event, struct axipv_config_t *config)
 {
 	/*
 	 * 1. Interrupt is disabled on the core which is supposed to
 	 *	service axipv_isr => Read INT_STATUS and ack
-	 * 2. Workqueue doesn't run. process_release and if
-	 *	dev->irq_stat is valid, then process_irq
+	 * 2. Workqueue doesn't run. If dev->irq_stat is valid,
+	 *	then process_irq
 	 * 3. Unknown case -> Halt AXIPV immediately
 	 */
 	u32 ret = -1, axipv_base;
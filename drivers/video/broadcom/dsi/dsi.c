@@ -20,6 +20,8 @@
 #include <linux/gpio.h>
 #include <linux/kobject.h>
 #include <linux/platform_device.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
 #include <plat/osabstract/osinterrupt.h>
 #include <plat/osabstract/ostask.h>
 #include <plat/csl/csl_dma_vc4lite.h>
@@ -52,6 +54,19 @@
 #define DSI_DBG(fmt, args...)
 #endif
 
+/* fixed DISPCTRL lists of the panel with their packets built at init */
+#define DSI_SEQ_MAX	12
+/* packets of a run time list built on the stack */
+#define DSI_SEQ_STACK	8
+/* not a DSI data type, msgLen is the sleep in ms */
+#define DSI_SEQ_SLEEP	0x100
+
+typedef struct {
+	char *src;
+	CSL_DSI_CMND_t *cmnd;
+	int count;
+} DSI_SEQ_t;
+
 typedef struct {
 	CSL_LCD_HANDLE clientH;
 	CSL_LCD_HANDLE dsiCmVcHandle;
@@ -72,6 +87,8 @@ typedef struct {
 	UInt8 maxRetPktSize;
 	bool send_first_frame_event;
 	struct platform_device *pdev;
+	DSI_SEQ_t seq[DSI_SEQ_MAX];
+	int seq_count;
 } DispDrv_PANEL_t;
 
 #if 0
@@ -91,6 +108,8 @@ static Int32 DSI_Open(DISPDRV_HANDLE_T drvH);
 static Int32 DSI_Close(DISPDRV_HANDLE_T drvH);
 
 static void DSI_ExecCmndList(DispDrv_PANEL_t *pPanel, char *buff);
+static void DSI_PrepareCmndList(DispDrv_PANEL_t *pPanel, char *buff);
+static void DSI_FreeCmndLists(DispDrv_PANEL_t *pPanel);
 
 static Int32 DSI_SuspendLink(DISPDRV_HANDLE_T drvH);
 
@@ -582,6 +601,22 @@ static Int32 DSI_Init(DISPDRV_INFO_T *info, DISPDRV_HANDLE_T *handle, struct pla
 
 		pPanel->disp_info = info;
 		pPanel->isTE = info->vmode ? false : info->te_ctrl;
+
+		/* the lists of unblank, blank and CABC, parsed only once */
+		DSI_PrepareCmndList(pPanel, info->init_seq);
+		DSI_PrepareCmndList(pPanel, info->slp_in_seq);
+		DSI_PrepareCmndList(pPanel, info->slp_out_seq);
+		DSI_PrepareCmndList(pPanel, info->scrn_on_seq);
+		DSI_PrepareCmndList(pPanel, info->scrn_off_seq);
+		if (info->cabc_enabled) {
+			DSI_PrepareCmndList(pPanel, info->cabc_init_seq);
+			DSI_PrepareCmndList(pPanel, info->cabc_on_seq);
+			DSI_PrepareCmndList(pPanel, info->cabc_off_seq);
+		}
+		if (info->special_mode_panel) {
+			DSI_PrepareCmndList(pPanel, info->special_mode_on_seq);
+			DSI_PrepareCmndList(pPanel, info->special_mode_off_seq);
+		}
 		pPanel->maxRetPktSize = 0;
 
 		/* get TE pin configuration */
@@ -617,6 +652,7 @@ static Int32 DSI_Exit(DISPDRV_HANDLE_T drvH)
 	DispDrv_PANEL_t *pPanel;
 
 	pPanel = (DispDrv_PANEL_t *) drvH;
+	DSI_FreeCmndLists(pPanel);
 	pPanel->drvState = DRV_STATE_OFF;
 	return 0;
 }
@@ -863,21 +899,23 @@ void panel_read(UInt8 reg, UInt8 *rxBuff, UInt8 buffLen)
 }
 
 DEFINE_MUTEX(cmnd_mutex);
+
 /*
  *
- *   Function Name:   DSI_ExecCmndList
+ *   Function Name:   DSI_BuildCmndList
  *
- *   Description:
+ *   Description:  Turn a DISPCTRL list into DSI packets, with the sleeps
+ *		   as DSI_SEQ_SLEEP entries. Only counts them if cmnd is
+ *		   NULL, returns the count or -1 on a bad packet size.
  *
  */
-static void DSI_ExecCmndList(DispDrv_PANEL_t *pPanel, char *buff)
+static int DSI_BuildCmndList(DispDrv_PANEL_t *pPanel, char *buff,
+			     CSL_DSI_CMND_t *cmnd)
 {
 	CSL_DSI_CMND_t msg;
-	int res = 0;
 	Boolean generic;
-	/* To avoid race condition, when multiple
-	   threads try to execute send commands concurrently*/
-	mutex_lock(&cmnd_mutex);
+	int count = 0;
+
 	msg.vc = pPanel->cmnd_mode->vc;
 	msg.isLP = pPanel->disp_info->cmnd_LP;
 	msg.endWithBta = FALSE;
@@ -886,7 +924,10 @@ static void DSI_ExecCmndList(DispDrv_PANEL_t *pPanel, char *buff)
 	while (*buff) {
 		uint8_t len = *buff++;
 		if (len == DISPCTRL_TAG_SLEEP) {
-			msleep(*buff++);
+			msg.dsiCmnd = DSI_SEQ_SLEEP;
+			msg.msg = NULL;
+			msg.msgLen = *buff++;
+			msg.isLong = FALSE;
 		} else {
 			if (len == DISPCTRL_TAG_GEN_WR) {
 				/* (~0 -1) was used as generic cmd tag */
@@ -896,8 +937,8 @@ static void DSI_ExecCmndList(DispDrv_PANEL_t *pPanel, char *buff)
 				generic = FALSE;
 			switch (len) {
 			case 0:
-				res = -1;
-				break;
+				DSI_ERR("Packet size err %d\n", len);
+				return -1;
 			case 1:
 				msg.dsiCmnd = generic ?
 					DSI_DT_SH_GEN_WR_P1 :
@@ -909,34 +950,130 @@ static void DSI_ExecCmndList(DispDrv_PANEL_t *pPanel, char *buff)
 					DSI_DT_SH_DCS_WR_P1;
 				break;
 			default:
-				if (len <= CSL_DSI_GetMaxTxMsgSize())
-					msg.dsiCmnd = generic ?
-						DSI_DT_LG_GEN_WR :
-						DSI_DT_LG_DCS_WR;
-				else
-					res = -1;
+				if (len > CSL_DSI_GetMaxTxMsgSize()) {
+					DSI_ERR("Packet size err %d\n", len);
+					return -1;
+				}
+				msg.dsiCmnd = generic ?
+					DSI_DT_LG_GEN_WR :
+					DSI_DT_LG_DCS_WR;
 				break;
 			}
-			if (res) {
-				DSI_ERR("Packet size err %d\n", res);
-				goto err_size;
-			}
 			msg.isLong = len > 2;
 			msg.msg = buff;
 			msg.msgLen = len;
+			buff += len;
+		}
+		if (cmnd)
+			cmnd[count] = msg;
+		count++;
+	}
+	return count;
+}
 
-			if (panel[0].drvState != DRV_STATE_OPEN) {
-				pr_err("driver not in OPEN state\n");
-				__WARN();
-				goto err_state;
-			}
+/*
+ *
+ *   Function Name:   DSI_PrepareCmndList
+ *
+ *   Description:  Build the packets of a fixed DISPCTRL list once, for
+ *		   DSI_ExecCmndList to send without parsing it again
+ *
+ */
+static void DSI_PrepareCmndList(DispDrv_PANEL_t *pPanel, char *buff)
+{
+	DSI_SEQ_t *seq;
+	int count;
+
+	if (!buff || pPanel->seq_count == DSI_SEQ_MAX)
+		return;
+	count = DSI_BuildCmndList(pPanel, buff, NULL);
+	if (count <= 0)
+		return;
+
+	seq = &pPanel->seq[pPanel->seq_count];
+	seq->cmnd = kmalloc(count * sizeof(*seq->cmnd), GFP_KERNEL);
+	if (!seq->cmnd)
+		return;
+	seq->src = buff;
+	seq->count = DSI_BuildCmndList(pPanel, buff, seq->cmnd);
+	pPanel->seq_count++;
+}
 
-			res = CSL_DSI_SendPacket(pPanel->clientH, &msg, FALSE);
-			buff += len;
+static void DSI_FreeCmndLists(DispDrv_PANEL_t *pPanel)
+{
+	int i;
+
+	for (i = 0; i < pPanel->seq_count; i++)
+		kfree(pPanel->seq[i].cmnd);
+	pPanel->seq_count = 0;
+}
+
+/* send the packets between the sleeps as one list each, all without BTA */
+static void DSI_SendCmndList(DispDrv_PANEL_t *pPanel, CSL_DSI_CMND_t *cmnd,
+			     int count)
+{
+	int res, i, j;
+
+	for (i = 0; i < count; i = j + 1) {
+		for (j = i; j < count && cmnd[j].dsiCmnd != DSI_SEQ_SLEEP; j++)
+			;
+		if (j > i) {
+			res = CSL_DSI_SendPacketList(pPanel->clientH,
+						     &cmnd[i], j - i);
+			if (res)
+				DSI_ERR("Error while sending packet %d\n",
+					res);
 		}
-		if (res)
-			DSI_ERR("Error while sending packet %d\n", res);
+		if (j < count)
+			msleep(cmnd[j].msgLen);
 	}
+}
+
+/*
+ *
+ *   Function Name:   DSI_ExecCmndList
+ *
+ *   Description:  Send a DISPCTRL list, from its prepared packets if it
+ *		   is one of the panel's fixed lists
+ *
+ */
+static void DSI_ExecCmndList(DispDrv_PANEL_t *pPanel, char *buff)
+{
+	CSL_DSI_CMND_t stack_cmnd[DSI_SEQ_STACK];
+	CSL_DSI_CMND_t *cmnd = stack_cmnd;
+	int count, i;
+
+	/* To avoid race condition, when multiple
+	   threads try to execute send commands concurrently*/
+	mutex_lock(&cmnd_mutex);
+	if (panel[0].drvState != DRV_STATE_OPEN) {
+		pr_err("driver not in OPEN state\n");
+		__WARN();
+		goto err_state;
+	}
+
+	for (i = 0; i < pPanel->seq_count; i++) {
+		if (pPanel->seq[i].src == buff) {
+			DSI_SendCmndList(pPanel, pPanel->seq[i].cmnd,
+					 pPanel->seq[i].count);
+			goto done;
+		}
+	}
+
+	/* lists written at run time, like the window or the brightness */
+	count = DSI_BuildCmndList(pPanel, buff, NULL);
+	if (count <= 0)
+		goto err_size;
+	if (count > DSI_SEQ_STACK) {
+		cmnd = kmalloc(count * sizeof(*cmnd), GFP_KERNEL);
+		if (!cmnd)
+			goto err_size;
+	}
+	DSI_BuildCmndList(pPanel, buff, cmnd);
+	DSI_SendCmndList(pPanel, cmnd, count);
+	if (cmnd != stack_cmnd)
+		kfree(cmnd);
+done:
 err_state:
 err_size:
 	mutex_unlock(&cmnd_mutex);
@@ -1052,6 +1189,7 @@ static Int32 DSI_PowerControl(
 	Int32  res = 0;
 	DispDrv_PANEL_t *pPanel = (DispDrv_PANEL_t *)drvH;
 	DISPDRV_INFO_T *info = pPanel->disp_info;
+	ktime_t start = ktime_get();
 
 	DSI_INFO("state %d pwrState %d\n", state, pPanel->pwrState);
 	switch (state) {
@@ -1082,7 +1220,8 @@ static Int32 DSI_PowerControl(
 			DSI_ExecCmndList(pPanel, info->init_seq);
 			DSI_WinSet(drvH, TRUE, &pPanel->win_dim);
 			pPanel->pwrState = STATE_SCREEN_OFF;
-			DSI_INFO("INIT-SEQ\n");
+			DSI_INFO("INIT-SEQ %lld us\n",
+				 ktime_us_delta(ktime_get(), start));
 			break;
 		default:
 			DSI_ERR("POWER ON req While Not In POWER DOWN State\n");
@@ -1136,7 +1275,8 @@ static Int32 DSI_PowerControl(
 		case STATE_SLEEP:
 			DSI_ExecCmndList(pPanel, info->slp_out_seq);
 			pPanel->pwrState = STATE_SCREEN_OFF;
-			DSI_INFO("SLEEP-OUT\n");
+			DSI_INFO("SLEEP-OUT %lld us\n",
+				 ktime_us_delta(ktime_get(), start));
 			break;
 		default:
 			DSI_ERR("SLEEP-OUT Req While Not In SLEEP State\n");
@@ -1157,7 +1297,8 @@ static Int32 DSI_PowerControl(
 				DSI_ExecCmndList(pPanel, info->scrn_on_seq);
 
 			pPanel->pwrState = STATE_SCREEN_ON;
-			DSI_INFO("SCREEN ON\n");
+			DSI_INFO("SCREEN ON %lld us\n",
+				 ktime_us_delta(ktime_get(), start));
 			break;
 		default:
 			DSI_ERR("SCRN ON Req While Not In SCRN OFF State\n");
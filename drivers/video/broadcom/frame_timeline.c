@@ -0,0 +1,367 @@
+/*
+ * drivers/video/broadcom/frame_timeline.c
+ *
+ * Per-frame timestamps through the display pipeline, see
+ * <linux/broadcom/frame_timeline.h>.
+ *
+ * A frame starts at kona_fb pan display and takes the time of the last
+ * V3D job done before it. It is posted by axipv and is finished on the
+ * first vsync after the post; frames panned but replaced before
+ * their post are dropped. A vsync seen while the oldest frame in
+ * flight is not posted yet is a missed vsync for that frame. When no
+ * frame is in flight the display is idle, and nothing is missed. If
+ * more frames are panned than the pipeline holds, the oldest is
+ * dropped too.
+ *
+ * /dev/frame_timeline reads the finished records, starting with the
+ * oldest still in the ring, or maps the ring read only. The counters
+ * are in the ring header and in debugfs frame_timeline.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/miscdevice.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/notifier.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/wait.h>
+#include <linux/broadcom/frame_timeline.h>
+
+/* frames between pan display and vsync, above the axipv queue depth */
+#define FRAME_TL_INFLIGHT	4
+
+#define FRAME_TL_SIZE	PAGE_ALIGN(sizeof(struct frame_tl_hdr) + \
+				   FRAME_TL_RECORDS * \
+				   sizeof(struct frame_tl_rec))
+
+static DEFINE_SPINLOCK(frame_tl_lock);
+static DECLARE_WAIT_QUEUE_HEAD(frame_tl_wait);
+static ATOMIC_NOTIFIER_HEAD(frame_tl_jank_chain);
+
+/* under frame_tl_lock */
+static struct frame_tl_hdr *frame_tl_hdr;
+static struct frame_tl_rec *frame_tl_ring;
+static struct frame_tl_rec frame_tl_inflight[FRAME_TL_INFLIGHT];
+static int frame_tl_first, frame_tl_count;
+static u32 frame_tl_seq;
+static u64 frame_tl_v3d_ns;
+static u64 frame_tl_vsync_ns;
+
+static inline struct frame_tl_rec *frame_tl_nth(int n)
+{
+	return &frame_tl_inflight[(frame_tl_first + n) % FRAME_TL_INFLIGHT];
+}
+
+static void frame_tl_retire(u64 vsync_ns)
+{
+	struct frame_tl_rec *f = frame_tl_nth(0);
+	struct frame_tl_hdr *h = frame_tl_hdr;
+
+	f->vsync_ns = vsync_ns;
+	h->frames++;
+	if (!vsync_ns)
+		h->dropped++;
+	if (f->missed) {
+		h->janky++;
+		h->missed += f->missed;
+		atomic_notifier_call_chain(&frame_tl_jank_chain, f->missed, f);
+	}
+	frame_tl_ring[h->head % FRAME_TL_RECORDS] = *f;
+	/* the record before the head, for the mmap readers */
+	smp_wmb();
+	h->head++;
+
+	frame_tl_first = (frame_tl_first + 1) % FRAME_TL_INFLIGHT;
+	frame_tl_count--;
+	wake_up_interruptible(&frame_tl_wait);
+}
+
+int frame_tl_register_jank_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&frame_tl_jank_chain, nb);
+}
+EXPORT_SYMBOL(frame_tl_register_jank_notifier);
+
+int frame_tl_unregister_jank_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&frame_tl_jank_chain, nb);
+}
+EXPORT_SYMBOL(frame_tl_unregister_jank_notifier);
+
+static void frame_tl_vsync(u64 now)
+{
+	struct frame_tl_rec *f;
+	u64 delta = now - frame_tl_vsync_ns;
+	u32 period = frame_tl_hdr->vsync_period_ns;
+
+	/* average of the intervals that are close to one frame */
+	if (frame_tl_vsync_ns && delta < NSEC_PER_SEC / 10) {
+		if (!period)
+			period = delta;
+		else if (delta < period + period / 2)
+			period = (7 * (u64)period + delta) >> 3;
+		frame_tl_hdr->vsync_period_ns = period;
+	}
+	frame_tl_vsync_ns = now;
+
+	if (!frame_tl_count)
+		return;
+	f = frame_tl_nth(0);
+	if (f->post_ns)
+		frame_tl_retire(now);
+	else
+		f->missed++;
+}
+
+void frame_tl_stamp(enum frame_tl_stage stage)
+{
+	struct frame_tl_rec *f;
+	unsigned long flags;
+	u64 now = ktime_to_ns(ktime_get());
+
+	spin_lock_irqsave(&frame_tl_lock, flags);
+	if (!frame_tl_hdr)
+		goto out;
+
+	switch (stage) {
+	case FRAME_TL_V3D_DONE:
+		frame_tl_v3d_ns = now;
+		break;
+
+	case FRAME_TL_PAN:
+		if (frame_tl_count == FRAME_TL_INFLIGHT)
+			frame_tl_retire(0);
+		f = frame_tl_nth(frame_tl_count++);
+		memset(f, 0, sizeof(*f));
+		f->seq = frame_tl_seq++;
+		f->v3d_ns = frame_tl_v3d_ns;
+		f->pan_ns = now;
+		frame_tl_v3d_ns = 0;
+		break;
+
+	case FRAME_TL_POST:
+		/* the newest frame, a repost of the same buffer is ignored */
+		if (!frame_tl_count)
+			break;
+		f = frame_tl_nth(frame_tl_count - 1);
+		if (!f->post_ns)
+			f->post_ns = now;
+		/* older frames never posted were replaced by this one */
+		while (frame_tl_count > 1 && !frame_tl_nth(0)->post_ns)
+			frame_tl_retire(0);
+		break;
+
+	case FRAME_TL_VSYNC:
+		frame_tl_vsync(now);
+		break;
+	}
+out:
+	spin_unlock_irqrestore(&frame_tl_lock, flags);
+}
+EXPORT_SYMBOL(frame_tl_stamp);
+
+/* for kernel users: the header, and the record at *pos, moving pos on */
+int frame_tl_get_hdr(struct frame_tl_hdr *h)
+{
+	unsigned long flags;
+
+	if (!frame_tl_hdr)
+		return -ENODEV;
+	spin_lock_irqsave(&frame_tl_lock, flags);
+	*h = *frame_tl_hdr;
+	spin_unlock_irqrestore(&frame_tl_lock, flags);
+	return 0;
+}
+EXPORT_SYMBOL(frame_tl_get_hdr);
+
+int frame_tl_get_rec(u32 *pos, struct frame_tl_rec *rec)
+{
+	unsigned long flags;
+	u32 head;
+	int ret = 0;
+
+	if (!frame_tl_hdr)
+		return -ENODEV;
+	spin_lock_irqsave(&frame_tl_lock, flags);
+	head = frame_tl_hdr->head;
+	if (head - *pos > FRAME_TL_RECORDS)
+		*pos = head - FRAME_TL_RECORDS;
+	if (*pos == head)
+		ret = -EAGAIN;
+	else
+		*rec = frame_tl_ring[(*pos)++ % FRAME_TL_RECORDS];
+	spin_unlock_irqrestore(&frame_tl_lock, flags);
+	return ret;
+}
+EXPORT_SYMBOL(frame_tl_get_rec);
+
+static ssize_t frame_tl_read(struct file *file, char __user *buf,
+			     size_t count, loff_t *ppos)
+{
+	struct frame_tl_rec rec;
+	unsigned long flags;
+	size_t done = 0;
+	u32 n, head;
+	int ret;
+
+	/* *ppos counts records, from the first one written */
+	if (file->f_flags & O_NONBLOCK) {
+		if (*ppos == frame_tl_hdr->head)
+			return -EAGAIN;
+	} else {
+		ret = wait_event_interruptible(frame_tl_wait,
+					       *ppos != frame_tl_hdr->head);
+		if (ret)
+			return ret;
+	}
+
+	while (count - done >= sizeof(rec)) {
+		spin_lock_irqsave(&frame_tl_lock, flags);
+		head = frame_tl_hdr->head;
+		n = (u32)*ppos;
+		/* overwritten, skip to the oldest one in the ring */
+		if (head - n > FRAME_TL_RECORDS)
+			n = head - FRAME_TL_RECORDS;
+		if (n == head) {
+			spin_unlock_irqrestore(&frame_tl_lock, flags);
+			break;
+		}
+		rec = frame_tl_ring[n % FRAME_TL_RECORDS];
+		spin_unlock_irqrestore(&frame_tl_lock, flags);
+
+		if (copy_to_user(buf + done, &rec, sizeof(rec)))
+			return done ? done : -EFAULT;
+		done += sizeof(rec);
+		*ppos = n + 1;
+	}
+
+	return done;
+}
+
+static loff_t frame_tl_llseek(struct file *file, loff_t offset, int whence)
+{
+	/* only rewinding to the oldest record, or to the head */
+	switch (whence) {
+	case SEEK_SET:
+		file->f_pos = 0;
+		break;
+	case SEEK_END:
+		file->f_pos = frame_tl_hdr->head;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return file->f_pos;
+}
+
+static int frame_tl_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, frame_tl_hdr, vma->vm_pgoff);
+}
+
+static long frame_tl_ioctl(struct file *file, unsigned int cmd,
+			   unsigned long arg)
+{
+	unsigned long flags;
+
+	switch (cmd) {
+	case FRAME_TL_IOC_RESET:
+		spin_lock_irqsave(&frame_tl_lock, flags);
+		frame_tl_hdr->frames = 0;
+		frame_tl_hdr->janky = 0;
+		frame_tl_hdr->missed = 0;
+		frame_tl_hdr->dropped = 0;
+		spin_unlock_irqrestore(&frame_tl_lock, flags);
+		return 0;
+
+	default:
+		return -ENOTTY;
+	}
+}
+
+static const struct file_operations frame_tl_fops = {
+	.owner		= THIS_MODULE,
+	.read		= frame_tl_read,
+	.llseek		= frame_tl_llseek,
+	.mmap		= frame_tl_mmap,
+	.unlocked_ioctl	= frame_tl_ioctl,
+};
+
+static struct miscdevice frame_tl_misc = {
+	.minor	= MISC_DYNAMIC_MINOR,
+	.name	= "frame_timeline",
+	.fops	= &frame_tl_fops,
+};
+
+static int frame_tl_stats_show(struct seq_file *m, void *v)
+{
+	struct frame_tl_hdr h;
+	unsigned long flags;
+
+	spin_lock_irqsave(&frame_tl_lock, flags);
+	h = *frame_tl_hdr;
+	spin_unlock_irqrestore(&frame_tl_lock, flags);
+
+	seq_printf(m, "vsync_period_ns %u\n", h.vsync_period_ns);
+	seq_printf(m, "frames %u\n", h.frames);
+	seq_printf(m, "janky %u\n", h.janky);
+	seq_printf(m, "missed_vsyncs %u\n", h.missed);
+	seq_printf(m, "dropped %u\n", h.dropped);
+	seq_printf(m, "records %u\n", h.head);
+	return 0;
+}
+
+static int frame_tl_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, frame_tl_stats_show, NULL);
+}
+
+static const struct file_operations frame_tl_stats_fops = {
+	.owner		= THIS_MODULE,
+	.open		= frame_tl_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init frame_tl_init(void)
+{
+	struct frame_tl_hdr *h;
+	unsigned long flags;
+	int ret;
+
+	h = vmalloc_user(FRAME_TL_SIZE);
+	if (!h)
+		return -ENOMEM;
+	h->records = FRAME_TL_RECORDS;
+
+	ret = misc_register(&frame_tl_misc);
+	if (ret) {
+		pr_err("frame_timeline: misc_register failed: %d\n", ret);
+		vfree(h);
+		return ret;
+	}
+	debugfs_create_file("frame_timeline", S_IRUGO, NULL, NULL,
+			    &frame_tl_stats_fops);
+
+	spin_lock_irqsave(&frame_tl_lock, flags);
+	frame_tl_ring = (struct frame_tl_rec *)(h + 1);
+	frame_tl_hdr = h;
+	spin_unlock_irqrestore(&frame_tl_lock, flags);
+
+	return 0;
+}
+module_init(frame_tl_init);
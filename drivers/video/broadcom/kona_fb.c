@@ -43,6 +43,7 @@
 #include <mach/memory.h>
 #include <mach/io_map.h>
 #include <plat/reg_axipv.h>
+#include <mach/atag_dt.h>
 #include <asm/io.h>
 #ifdef CONFIG_FRAMEBUFFER_FPS
 #include <linux/fb_fps.h>
@@ -62,6 +63,7 @@
 #include <linux/of_platform.h>
 #include <linux/of_gpio.h>
 #include <linux/wakelock.h>
+#include <linux/broadcom/frame_timeline.h>
 
 #ifdef CONFIG_DEBUG_FS
 #include <linux/debugfs.h>
@@ -70,6 +72,15 @@
 #include <linux/ctype.h>
 #endif /*  CONFIG_DEBUG_FS */
 
+#ifdef CONFIG_FB_BRCM_KONA_BENCH
+#include <linux/kernel_stat.h>
+#include <linux/sort.h>
+#include <plat/axipv.h>
+#ifdef CONFIG_KONA_AXITRACE
+#include <mach/axitrace.h>
+#endif
+#endif
+
 #ifdef CONFIG_FB_BRCM_CP_CRASH_DUMP_IMAGE_SUPPORT
 #include <video/kona_fb_image_dump.h>
 #include "lcd/dump_start_img.h"
@@ -83,6 +94,21 @@
 #include <linux/iommu.h>
 #include <plat/bcm_iommu.h>
 #endif
+#if defined(CONFIG_BCM_IOVMM) && defined(CONFIG_DMA_SHARED_BUFFER)
+#include <linux/dma-buf.h>
+#include <linux/file.h>
+#define KONA_FB_DMABUF
+#ifdef CONFIG_ION_BCM
+#include <linux/broadcom/bcm_ion.h>
+#endif
+#ifdef CONFIG_SW_SYNC
+#include <linux/sw_sync.h>
+#endif
+#ifdef CONFIG_MMDMA
+#include <linux/broadcom/mmdma.h>
+#define KONA_FB_OVERLAY
+#endif
+#endif
 
 #ifdef CONFIG_DEBUG_FS
 #define DBGFS_MAX_BUFF_SIZE 200
@@ -93,6 +119,77 @@
 
 #define KONA_IOCTL_SET_BUFFER_AND_UPDATE	_IO('F', 0x80)
 #define KONA_IOCTL_GET_FB_IOVA			_IOR('F', 0x81, u32)
+#define KONA_IOCTL_UPDATE_DIRTY		_IOW('F', 0x82, struct kona_fb_dirty)
+
+/* KONA_IOCTL_UPDATE_DIRTY: push only these rectangles of buffer buff_idx
+ * (0 or 1, as selected by yoffset) to a command mode panel */
+#define KONA_FB_MAX_DIRTY_RECTS	4
+struct kona_fb_dirty_rect {
+	u16 x;
+	u16 y;
+	u16 w;
+	u16 h;
+};
+
+struct kona_fb_dirty {
+	u32 buff_idx;
+	u32 num_rects;
+	struct kona_fb_dirty_rect rect[KONA_FB_MAX_DIRTY_RECTS];
+};
+
+#ifdef KONA_FB_DMABUF
+/* KONA_IOCTL_POST_DMABUF: scan out a dma-buf (e.g. an ION buffer) directly.
+ * acquire_fence is waited for before the post (-1 for none).
+ * release_fence returns a fence that signals once the buffer is no longer
+ * read by the display, -1 without CONFIG_SW_SYNC. */
+#define KONA_IOCTL_POST_DMABUF	_IOWR('F', 0x83, struct kona_fb_post_dmabuf)
+
+struct kona_fb_post_dmabuf {
+	int fd;
+	u32 offset;
+	int acquire_fence;
+	int release_fence;
+};
+
+#ifdef KONA_FB_OVERLAY
+/* KONA_IOCTL_POST_OVERLAY: show framebuffer screen bg_idx with an opaque
+ * w x h layer from dma-buf fd (same format as the framebuffer, pitch bytes
+ * per line) placed at x, y. PV has a single plane, so the layer is blitted
+ * by mmdma into the other screen, which is then posted. Only the layer
+ * rectangles are copied and sent unless KONA_FB_OVERLAY_BG_DIRTY is set.
+ * Returns -EOPNOTSUPP when the frame has to be composed and posted in
+ * full instead (video mode, alpha < 255, scattered buffer...). */
+#define KONA_IOCTL_POST_OVERLAY	_IOW('F', 0x84, struct kona_fb_overlay)
+
+#define KONA_FB_OVERLAY_BG_DIRTY	(1 << 0)
+
+struct kona_fb_overlay {
+	u32 bg_idx;
+	int fd;
+	u32 offset;
+	u32 pitch;
+	u16 x;
+	u16 y;
+	u16 w;
+	u16 h;
+	u8 alpha;
+	u8 reserved[3];
+	u32 flags;
+};
+#endif
+
+/* dma-bufs kept mapped in the display IOVA space */
+#define KONA_FB_IMPORT_CACHE	4
+
+struct kona_fb_import {
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	dma_addr_t dma_addr;
+	unsigned long last_use;
+	bool ion;	/* mapping owned by the ion device mapping cache */
+};
+#endif
 
 #define SUSPEND_LINK_DELAY_MS 100
 
@@ -163,9 +260,58 @@ struct kona_fb {
 	struct delayed_work link_work;
 	struct wake_lock wlock;
 
+	/* ambient: link suspended after ambient_idle_ms without updates,
+	 * command mode only. Protected by update_sem */
+	struct delayed_work ambient_work;
+	unsigned int ambient_idle_ms;
+	bool ambient;
+	unsigned long ambient_entries;
+	unsigned long ambient_exits;
+	unsigned long ambient_since;
+	unsigned long ambient_residency;
+
+	/* warm blank: panel in sleep with the link kept configured, torn
+	 * down only after warm_blank_ms, command mode only. Wake times
+	 * are [0] for cold and [1] for warm unblanks, from the unblank to
+	 * the end of it and to the first frame after it. Protected by
+	 * update_sem */
+	struct delayed_work warm_work;
+	unsigned int warm_blank_ms;
+	bool warm;
+	bool wake_warm;
+	ktime_t wake_start;	/* 0 once the first frame is posted */
+	unsigned long wakes[2];
+	u32 wake_unblank_us[2];
+	u32 wake_frame_us[2];
+
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *dbgfs_dir;
 #endif
+#ifdef CONFIG_FB_BRCM_KONA_BENCH
+	/* command mode transfers, from the update to its done callback,
+	 * cleared by the benchmark under update_sem */
+	ktime_t xfer_start;
+	u32 xfer_count;
+	u32 xfer_max_us;
+	u64 xfer_us;
+#endif
+#ifdef KONA_FB_DMABUF
+	/* protected by update_sem */
+	struct kona_fb_import import[KONA_FB_IMPORT_CACHE];
+	struct kona_fb_import *import_cur;
+	unsigned long import_seq;
+#ifdef CONFIG_SW_SYNC
+	struct sw_sync_timeline *timeline;
+	u32 timeline_max;
+#endif
+#endif
+#ifdef KONA_FB_OVERLAY
+	/* screen ovl_bg_idx plus layer ovl_rect are in the other screen,
+	 * protected by update_sem */
+	bool ovl_valid;
+	u32 ovl_bg_idx;
+	struct kona_fb_dirty_rect ovl_rect;
+#endif
 };
 
 static struct completion vsync_event;
@@ -184,6 +330,7 @@ static int kona_fb_die_cb(struct notifier_block *, unsigned long, void *);
 static int lcd_boot_mode(char *);
 static int lcd_panel_setup(char *);
 static int kona_fb_blank(int blank_mode, struct fb_info *info);
+static void kona_fb_warm_off(struct kona_fb *fb);
 
 static int need_page_alignment = 1;
 static char g_disp_str[DISPDRV_NAME_SZ];
@@ -342,6 +489,16 @@ static inline void kona_clock_stop(struct kona_fb *fb)
 	fb->display_ops->stop(fb->display_hdl, &fb->dfs_node);
 }
 
+/*
+ * The first frame of user space. The display left the bootloader's
+ * splash at probe, so its memory goes back to the kernel.
+ */
+static inline void kona_fb_graphics_started(struct kona_fb *fb)
+{
+	if (!atomic_xchg(&fb->is_graphics_started, 1))
+		kona_splash_release();
+}
+
 static void fb_suspend_link_work(struct work_struct *work)
 {
 	struct delayed_work *dw = container_of(work, struct delayed_work, work);
@@ -370,6 +527,78 @@ static void fb_suspend_link_work(struct work_struct *work)
 	wake_unlock(&fb->wlock);
 }
 
+static void kona_fb_ambient_work(struct work_struct *work)
+{
+	struct kona_fb *fb = container_of(to_delayed_work(work),
+					struct kona_fb, ambient_work);
+
+	if (!mutex_trylock(&fb->update_sem)) {
+		schedule_delayed_work(&fb->ambient_work,
+				msecs_to_jiffies(fb->ambient_idle_ms));
+		return;
+	}
+	/* special mode and blank own the link themselves */
+	if (fb->ambient || fb->link_suspended || fb->suspend_link ||
+		fb->g_stop_drawing || (fb->blank_state != KONA_FB_UNBLANK) ||
+		!completion_done(&fb->prev_buf_done_sem))
+		goto out;
+
+	if (fb->fb_data->esdcheck)
+		cancel_delayed_work(&fb->esd_check_work);
+	kona_clock_start(fb);
+	fb->display_ops->suspend_link(fb->display_hdl);
+	kona_clock_stop(fb);
+	pi_mgr_qos_request_update(&g_mm_qos_node, PI_MGR_QOS_DEFAULT_VALUE);
+	fb->link_suspended = true;
+	fb->ambient = true;
+	fb->ambient_entries++;
+	fb->ambient_since = jiffies;
+	konafb_debug("ambient on\n");
+out:
+	mutex_unlock(&fb->update_sem);
+}
+
+/* Called with update_sem held once the link is back */
+static void kona_fb_ambient_exit(struct kona_fb *fb)
+{
+	fb->ambient = false;
+	fb->ambient_exits++;
+	fb->ambient_residency += jiffies - fb->ambient_since;
+	schedule_work(&fb->vsync_smart);
+	if (fb->fb_data->esdcheck)
+		queue_delayed_work(fb->esd_check_wq, &fb->esd_check_work,
+			msecs_to_jiffies(fb->fb_data->esdcheck_period_ms));
+	konafb_debug("ambient off\n");
+}
+
+/* Restart the idle timer after an update of a command mode panel */
+static inline void kona_fb_ambient_arm(struct kona_fb *fb)
+{
+	if (fb->ambient_idle_ms && !fb->display_info->vmode &&
+		!fb->suspend_link)
+		mod_delayed_work(system_wq, &fb->ambient_work,
+				msecs_to_jiffies(fb->ambient_idle_ms));
+}
+
+/* Called with update_sem held when a frame is posted */
+static inline void kona_fb_wake_frame(struct kona_fb *fb)
+{
+	if (!fb->wake_start.tv64)
+		return;
+	fb->wake_frame_us[fb->wake_warm] =
+		ktime_us_delta(ktime_get(), fb->wake_start);
+	fb->wake_start.tv64 = 0;
+}
+
+/* a full post may come from a screen the compositor redrew, the next
+ * overlay post has to start over from its background */
+static inline void kona_fb_overlay_reset(struct kona_fb *fb)
+{
+#ifdef KONA_FB_OVERLAY
+	fb->ovl_valid = false;
+#endif
+}
+
 static void link_control(struct kona_fb *fb, enum link_ctrl link_ctrl)
 {
 	if (link_ctrl == RESUME_LINK) {
@@ -386,6 +615,8 @@ static void link_control(struct kona_fb *fb, enum link_ctrl link_ctrl)
 		if (!fb->display_info->vmode)
 			kona_clock_stop(fb);
 		fb->link_suspended = false;
+		if (fb->ambient)
+			kona_fb_ambient_exit(fb);
 	} else {
 		cancel_delayed_work_sync(&fb->link_work);
 		wake_lock(&fb->wlock);
@@ -540,6 +771,127 @@ static int kona_fb_iovmm_unmap(struct kona_fb *fb,
 	pr_info("%s succ\n", __func__);
 	return 0;
 }
+
+#ifdef KONA_FB_DMABUF
+static void kona_fb_import_unmap(struct kona_fb *fb,
+				struct kona_fb_import *imp)
+{
+	if (!imp->dmabuf)
+		return;
+#ifdef CONFIG_ION_BCM
+	if (imp->ion) {
+		bcm_ion_unmap_dma_dev(&fb->pdev->dev, imp->dmabuf);
+		dma_buf_put(imp->dmabuf);
+		imp->dmabuf = NULL;
+		return;
+	}
+#endif
+	arm_iommu_unmap(&fb->pdev->dev, imp->dma_addr, imp->dmabuf->size);
+	dma_buf_unmap_attachment(imp->attach, imp->sgt, DMA_TO_DEVICE);
+	dma_buf_detach(imp->dmabuf, imp->attach);
+	dma_buf_put(imp->dmabuf);
+	imp->dmabuf = NULL;
+}
+
+/* Find the mapping of dma-buf fd, mapping it through the framebuffer's
+ * iovmm in place of the least recently posted buffer on a miss */
+static struct kona_fb_import *kona_fb_import_get(struct kona_fb *fb, int fd)
+{
+	struct kona_fb_import *imp, *victim = NULL;
+	struct dma_buf *dmabuf;
+	int i, dma_addr;
+
+	dmabuf = dma_buf_get(fd);
+	if (IS_ERR(dmabuf))
+		return ERR_CAST(dmabuf);
+
+	for (i = 0; i < KONA_FB_IMPORT_CACHE; i++) {
+		imp = &fb->import[i];
+		if (imp->dmabuf == dmabuf) {
+			dma_buf_put(dmabuf);
+			goto found;
+		}
+		if (imp == fb->import_cur)
+			continue;
+		if (!victim || !imp->dmabuf ||
+			(victim->dmabuf && (imp->last_use < victim->last_use)))
+			victim = imp;
+	}
+
+	imp = victim;
+	kona_fb_import_unmap(fb, imp);
+#ifdef CONFIG_ION_BCM
+	/* ion keeps the mapping past this slot for buffers coming back */
+	if (!bcm_ion_map_dma_dev(&fb->pdev->dev, dmabuf, &imp->dma_addr)) {
+		imp->ion = true;
+		imp->dmabuf = dmabuf;
+		goto found;
+	}
+#endif
+	imp->ion = false;
+	imp->attach = dma_buf_attach(dmabuf, &fb->pdev->dev);
+	if (IS_ERR(imp->attach)) {
+		pr_err("%s: dma_buf_attach failed\n", __func__);
+		goto fail_attach;
+	}
+	imp->sgt = dma_buf_map_attachment(imp->attach, DMA_TO_DEVICE);
+	if (IS_ERR_OR_NULL(imp->sgt)) {
+		pr_err("%s: dma_buf_map_attachment failed\n", __func__);
+		goto fail_map;
+	}
+	dma_addr = arm_iommu_map_sgt(&fb->pdev->dev, imp->sgt, 0);
+	if (dma_addr == DMA_ERROR_CODE) {
+		pr_err("%s: iommu map of size(%#x) failed\n", __func__,
+				dmabuf->size);
+		goto fail_iommu;
+	}
+	imp->dma_addr = dma_addr;
+	imp->dmabuf = dmabuf;
+found:
+	imp->last_use = ++fb->import_seq;
+	return imp;
+
+fail_iommu:
+	dma_buf_unmap_attachment(imp->attach, imp->sgt, DMA_TO_DEVICE);
+fail_map:
+	dma_buf_detach(dmabuf, imp->attach);
+fail_attach:
+	dma_buf_put(dmabuf);
+	return ERR_PTR(-ENOMEM);
+}
+
+static void kona_fb_import_flush(struct kona_fb *fb)
+{
+	int i;
+
+	for (i = 0; i < KONA_FB_IMPORT_CACHE; i++)
+		kona_fb_import_unmap(fb, &fb->import[i]);
+	fb->import_cur = NULL;
+#ifdef CONFIG_SW_SYNC
+	if (fb->timeline)
+		sync_timeline_destroy(&fb->timeline->obj);
+	fb->timeline = NULL;
+#endif
+}
+
+/* The display has moved on from all posted buffers but the last one,
+ * or from all of them when the own framebuffer is shown again */
+static void kona_fb_import_release(struct kona_fb *fb, bool all)
+{
+#ifdef CONFIG_SW_SYNC
+	u32 target;
+
+	if (!fb->timeline)
+		return;
+	target = all ? fb->timeline_max : fb->timeline_max - 1;
+	if (fb->timeline->value < target)
+		sw_sync_timeline_inc(fb->timeline,
+					target - fb->timeline->value);
+#endif
+	if (all)
+		fb->import_cur = NULL;
+}
+#endif /* KONA_FB_DMABUF */
 #endif
 #endif
 
@@ -724,21 +1076,60 @@ err_idx:
 }
 #endif
 
+#ifdef CONFIG_FB_BRCM_KONA_BENCH
+static inline void kona_fb_xfer_start(struct kona_fb *fb)
+{
+	fb->xfer_start = ktime_get();
+}
+
+static inline void kona_fb_xfer_done(struct kona_fb *fb)
+{
+	u32 us = ktime_us_delta(ktime_get(), fb->xfer_start);
+
+	fb->xfer_count++;
+	fb->xfer_us += us;
+	fb->xfer_max_us = max(fb->xfer_max_us, us);
+}
+#else
+static inline void kona_fb_xfer_start(struct kona_fb *fb)
+{
+}
+
+static inline void kona_fb_xfer_done(struct kona_fb *fb)
+{
+}
+#endif
+
 static void kona_display_done_cb(int status)
 {
 	(void)status;
-	if (!g_kona_fb->display_info->vmode)
+	if (!g_kona_fb->display_info->vmode) {
+		kona_fb_xfer_done(g_kona_fb);
 		kona_clock_stop(g_kona_fb);
+	}
 	konafb_debug("kona_fb release called\n");
 	complete(&g_kona_fb->prev_buf_done_sem);
 }
 
+#if IS_BUILTIN(CONFIG_FB_BRCM_KONA) && defined(CONFIG_KERNEL_MODE_NEON)
+#include <asm/neon.h>
+#define KONA_FB_NEON_ROTATE
+/* kona_fb_rotate_neon.S: swap and pixel reverse 64 byte blocks from both
+ * ends of [top, end) */
+asmlinkage void kona_fb_rotate16_neon(void *top, void *end,
+					unsigned int blocks);
+asmlinkage void kona_fb_rotate32_neon(void *top, void *end,
+					unsigned int blocks);
+#endif
+
 /* This function peforms the in-place rotation of the buffer */
 int kona_fb_rotate_buffer(void *buffer, int deg, unsigned width,
 				unsigned height, unsigned char bytes_per_pixel)
 {
 	int i = 0;
 	unsigned int total_num_pixels = width * height;
+	/* pixels already swapped at each end by the NEON path */
+	unsigned int done = 0;
 	unsigned short *Bottom_2Bpp;
 	unsigned short *Top_2Bpp;
 	unsigned short temp_2Bpp;
@@ -746,13 +1137,33 @@ int kona_fb_rotate_buffer(void *buffer, int deg, unsigned width,
 	unsigned int *Top_4Bpp;
 	unsigned int temp_4Bpp;
 
+#ifdef KONA_FB_NEON_ROTATE
+	if (cpu_has_neon()) {
+		unsigned int size = total_num_pixels * bytes_per_pixel;
+		unsigned int blocks = size / 128;
+
+		if (blocks) {
+			kernel_neon_begin();
+			if (bytes_per_pixel == 2)
+				kona_fb_rotate16_neon(buffer, buffer + size,
+							blocks);
+			else
+				kona_fb_rotate32_neon(buffer, buffer + size,
+							blocks);
+			kernel_neon_end();
+			done = blocks * 64 / bytes_per_pixel;
+		}
+	}
+#endif
+
 	if (bytes_per_pixel == 2) {
 		/* point to the first pixel */
-		Top_2Bpp = buffer;
+		Top_2Bpp = (unsigned short *)buffer + done;
 		/* point to the last pixel */
-		Bottom_2Bpp = Top_2Bpp + (width * height) - 1;
+		Bottom_2Bpp = (unsigned short *)buffer + (width * height) - 1
+				- done;
 
-		for (i = 0; i < total_num_pixels / 2; ++i) {
+		for (i = done; i < total_num_pixels / 2; ++i) {
 			/* swap pixels from top-left in forward direction
 			   to pixels in bottom-right in reverse direction */
 			temp_2Bpp = *Top_2Bpp;
@@ -762,11 +1173,12 @@ int kona_fb_rotate_buffer(void *buffer, int deg, unsigned width,
 	} else {
 	/* if Bpp = 4 */
 		/* point to the first pixel */
-		Top_4Bpp = buffer;
+		Top_4Bpp = (unsigned int *)buffer + done;
 		/* point to the last pixel */
-		Bottom_4Bpp = Top_4Bpp + (width * height) - 1;
+		Bottom_4Bpp = (unsigned int *)buffer + (width * height) - 1
+				- done;
 
-		for (i = 0; i < total_num_pixels / 2; ++i) {
+		for (i = done; i < total_num_pixels / 2; ++i) {
 			/* swap pixels from top-left in forward direction
 			   to pixels in bottom-right in reverse direction */
 			temp_4Bpp = *Top_4Bpp;
@@ -789,6 +1201,7 @@ static int kona_fb_pan_display(struct fb_var_screeninfo *var,
 #endif
 	DISPDRV_WIN_t region, *p_region;
 
+	frame_tl_stamp(FRAME_TL_PAN);
 	buff_idx = var->yoffset ? 1 : 0;
 
 	if (var->rotate == FB_ROTATE_UD) {
@@ -840,7 +1253,7 @@ static int kona_fb_pan_display(struct fb_var_screeninfo *var,
 		if (!fb->display_info->vmode)
 			kona_clock_stop(fb);
 	} else {
-		atomic_set(&fb->is_graphics_started, 1);
+		kona_fb_graphics_started(fb);
 		if (var->reserved[0] == 0x54445055) {
 			region.t = var->reserved[1] >> 16;
 			region.l = (u16) var->reserved[1];
@@ -885,6 +1298,8 @@ static int kona_fb_pan_display(struct fb_var_screeninfo *var,
 					fb->display_info->Bpp);
 			fb->display_info->fb_converted_to_special_mode = true;
 		}
+		if (!fb->display_info->vmode)
+			kona_fb_xfer_start(fb);
 		ret =
 		    fb->display_ops->update(fb->display_hdl,
 					buff_idx ? fb->buff1 : fb->buff0,
@@ -899,10 +1314,19 @@ static int kona_fb_pan_display(struct fb_var_screeninfo *var,
 				pr_err("%s:%d timed out waiting for completion",
 					__func__, __LINE__);
 		}
+#ifdef KONA_FB_DMABUF
+		/* back on the framebuffer, imported buffers are free */
+		kona_fb_import_release(fb, true);
+#endif
+		kona_fb_overlay_reset(fb);
+		/* the first frame from user space, late drivers can probe */
+		driver_first_frame_done();
 	}
 
 	if (fb->suspend_link)
 		link_control(fb, SUSPEND_LINK);
+	kona_fb_wake_frame(fb);
+	kona_fb_ambient_arm(fb);
 
 skip_drawing:
 	mutex_unlock(&fb->update_sem);
@@ -919,14 +1343,38 @@ static int kona_fb_sync(struct fb_info *info)
 #else
 static int kona_fb_sync(struct fb_info *info)
 {
+	struct kona_fb *fb = container_of(info, struct kona_fb, fb);
+
+	/* the vsync work is stopped in ambient, just pace the caller */
+	if (fb->ambient) {
+		usleep_range(16000, 16010);
+		return 0;
+	}
 	wait_for_completion_interruptible(&vsync_event);
 	return 0;
 }
 #endif
+static ATOMIC_NOTIFIER_HEAD(kona_fb_vsync_chain);
+
+int kona_fb_register_vsync_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&kona_fb_vsync_chain, nb);
+}
+EXPORT_SYMBOL(kona_fb_register_vsync_notifier);
+
+int kona_fb_unregister_vsync_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&kona_fb_vsync_chain, nb);
+}
+EXPORT_SYMBOL(kona_fb_unregister_vsync_notifier);
+
 static void konafb_vsync_cb(void)
 {
-	if (g_kona_fb && g_kona_fb->display_info->vmode)
+	if (g_kona_fb && g_kona_fb->display_info->vmode) {
+		frame_tl_stamp(FRAME_TL_VSYNC);
 		complete(&vsync_event);
+		atomic_notifier_call_chain(&kona_fb_vsync_chain, 0, NULL);
+	}
 }
 
 static void vsync_work_smart(struct work_struct *work)
@@ -934,9 +1382,14 @@ static void vsync_work_smart(struct work_struct *work)
 	struct kona_fb *fb = container_of(work, struct kona_fb,
 						vsync_smart);
 
+	frame_tl_stamp(FRAME_TL_VSYNC);
 	complete(&vsync_event);
+	atomic_notifier_call_chain(&kona_fb_vsync_chain, 0, NULL);
 	/* 16ms ~ 60HZ */
 	usleep_range(16000, 16010);
+	/* restarted by kona_fb_ambient_exit */
+	if (fb->ambient)
+		return;
 	schedule_work(&fb->vsync_smart);
 }
 
@@ -1113,6 +1566,112 @@ exit:
 	return ret;
 }
 
+static ssize_t kona_fb_ambient_idle_ms_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct kona_fb *fb = dev_get_drvdata(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", fb->ambient_idle_ms);
+}
+
+static ssize_t kona_fb_ambient_idle_ms_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kona_fb *fb = dev_get_drvdata(dev);
+	uint32_t val;
+
+	if (fb->display_info->vmode) {
+		konafb_error("Only command mode supported\n");
+		return -EOPNOTSUPP;
+	}
+	if (sscanf(buf, "%u", &val) != 1) {
+		konafb_error("Error, buf = %s\n", buf);
+		return -EINVAL;
+	}
+
+	mutex_lock(&fb->update_sem);
+	fb->ambient_idle_ms = val;
+	if (val)
+		kona_fb_ambient_arm(fb);
+	else
+		cancel_delayed_work(&fb->ambient_work);
+	mutex_unlock(&fb->update_sem);
+	return count;
+}
+
+static ssize_t kona_fb_ambient_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct kona_fb *fb = dev_get_drvdata(dev);
+	unsigned long residency;
+
+	mutex_lock(&fb->update_sem);
+	residency = fb->ambient_residency;
+	if (fb->ambient)
+		residency += jiffies - fb->ambient_since;
+	mutex_unlock(&fb->update_sem);
+
+	return scnprintf(buf, PAGE_SIZE,
+			"active: %d\nentries: %lu\nexits: %lu\nresidency_ms: %u\n",
+			fb->ambient, fb->ambient_entries, fb->ambient_exits,
+			jiffies_to_msecs(residency));
+}
+
+static ssize_t kona_fb_warm_blank_ms_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct kona_fb *fb = dev_get_drvdata(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", fb->warm_blank_ms);
+}
+
+static ssize_t kona_fb_warm_blank_ms_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct kona_fb *fb = dev_get_drvdata(dev);
+	uint32_t val;
+
+	if (fb->display_info->vmode) {
+		konafb_error("Only command mode supported\n");
+		return -EOPNOTSUPP;
+	}
+	if (sscanf(buf, "%u", &val) != 1) {
+		konafb_error("Error, buf = %s\n", buf);
+		return -EINVAL;
+	}
+
+	mutex_lock(&fb->update_sem);
+	fb->warm_blank_ms = val;
+	/* a blank in progress keeps its timeout, unless turned off */
+	if (!val) {
+		cancel_delayed_work(&fb->warm_work);
+		kona_fb_warm_off(fb);
+	}
+	mutex_unlock(&fb->update_sem);
+	return count;
+}
+
+static ssize_t kona_fb_wake_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct kona_fb *fb = dev_get_drvdata(dev);
+	ssize_t ret;
+
+	mutex_lock(&fb->update_sem);
+	ret = scnprintf(buf, PAGE_SIZE,
+			"warm: %d\n"
+			"        count unblank_us frame_us\n"
+			"cold %8lu %10u %8u\n"
+			"warm %8lu %10u %8u\n",
+			fb->warm,
+			fb->wakes[0], fb->wake_unblank_us[0],
+			fb->wake_frame_us[0],
+			fb->wakes[1], fb->wake_unblank_us[1],
+			fb->wake_frame_us[1]);
+	mutex_unlock(&fb->update_sem);
+	return ret;
+}
+
 static ssize_t kona_fb_backlight_brightness_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t count)
 {
@@ -1143,6 +1702,14 @@ static struct device_attribute panel_attributes[] = {
 	__ATTR(panel_mode, S_IRUGO|S_IWUSR|S_IWGRP,
 					kona_fb_panel_mode_show,
 					kona_fb_panel_mode_store),
+	__ATTR(ambient_idle_ms, S_IRUGO|S_IWUSR|S_IWGRP,
+					kona_fb_ambient_idle_ms_show,
+					kona_fb_ambient_idle_ms_store),
+	__ATTR(ambient_stats, S_IRUGO, kona_fb_ambient_stats_show, NULL),
+	__ATTR(warm_blank_ms, S_IRUGO|S_IWUSR|S_IWGRP,
+					kona_fb_warm_blank_ms_show,
+					kona_fb_warm_blank_ms_store),
+	__ATTR(wake_stats, S_IRUGO, kona_fb_wake_stats_show, NULL),
 	__ATTR(backlight_brightness, S_IWUSR|S_IWGRP, NULL,
 					kona_fb_backlight_brightness_store),
 
@@ -1469,6 +2036,238 @@ static const struct file_operations dbgfs_cabc_fops = {
 	.release		= single_release,
 };
 
+#ifdef CONFIG_FB_BRCM_KONA_BENCH
+/*
+ * Display benchmark. Writing "<case> <fps> <frames>" to debugfs bench,
+ * case full, partial, rotated or all, pans <frames> frames of synthetic
+ * content through kona_fb_pan_display() at <fps>, as user space would.
+ * Partial frames update the centre quarter of the screen, rotated ones
+ * are turned by 180 degrees in pan display. Stop user space drawing
+ * first. Reading bench gives one key=value line per case:
+ *
+ *	case= fps= frames= late= us= post_te_avg_us= post_te_p99_us=
+ *	post_te_max_us= missed= dropped= underruns= xfers= xfer_avg_us=
+ *	xfer_max_us= cpu_us= ddr_mbps=
+ *
+ * late counts the frames the pacing could not post on time. Post to TE
+ * and missed vsyncs come from the frame timeline; on command mode panels
+ * its vsync is the 16 ms tick. Transfers are those of command mode, from
+ * the update to its done callback. cpu_us is the busy time of all cores,
+ * filling the frames included, and ddr_mbps the AXI trace DDR traffic of
+ * the whole system over the run.
+ */
+enum {
+	BENCH_FULL,
+	BENCH_PARTIAL,
+	BENCH_ROTATED,
+	BENCH_CASES
+};
+
+static const char * const bench_cases[BENCH_CASES] = {
+	[BENCH_FULL]	= "full",
+	[BENCH_PARTIAL]	= "partial",
+	[BENCH_ROTATED]	= "rotated",
+};
+
+static DEFINE_MUTEX(bench_mutex);
+static char bench_report[PAGE_SIZE];
+static size_t bench_len;
+static u32 bench_lat[FRAME_TL_RECORDS];
+
+static u64 bench_cpu_busy(void)
+{
+	u64 busy = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *s = kcpustat_cpu(cpu).cpustat;
+
+		busy += s[CPUTIME_USER] + s[CPUTIME_NICE] + s[CPUTIME_SYSTEM] +
+			s[CPUTIME_IRQ] + s[CPUTIME_SOFTIRQ];
+	}
+	return busy;
+}
+
+static u64 bench_ddr_beats(void)
+{
+	u64 beats = 0;
+
+#ifdef CONFIG_KONA_AXITRACE
+	axitrace_get_ddr_beats_total(&beats);
+#endif
+	return beats;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_fill(struct kona_fb *fb, int idx, u32 n, DISPDRV_WIN_t *r)
+{
+	u32 bpp = fb->fb.var.bits_per_pixel / 8;
+	u32 line = fb->fb.fix.line_length;
+	u8 *base = fb->fb.screen_base + (idx ? fb->buff1 - fb->buff0 : 0);
+	int y;
+
+	for (y = r->t; y <= r->b; y++)
+		memset(base + y * line + r->l * bpp, (n * 37) & 0xff,
+		       r->w * bpp);
+}
+
+static void bench_run(struct kona_fb *fb, int c, u32 fps, u32 frames)
+{
+	struct fb_var_screeninfo var = fb->fb.var;
+	struct frame_tl_hdr h0, h1;
+	struct frame_tl_rec rec;
+	DISPDRV_WIN_t r;
+	ktime_t start, next, now;
+	u64 cpu, beats, xfer_us, lat_sum = 0;
+	u32 underruns, xfers, xfer_max, pos, late = 0, n = 0, i, us;
+	s64 wait;
+
+	r.l = c == BENCH_PARTIAL ? var.xres / 4 : 0;
+	r.t = c == BENCH_PARTIAL ? var.yres / 4 : 0;
+	r.w = c == BENCH_PARTIAL ? var.xres / 2 : var.xres;
+	r.h = c == BENCH_PARTIAL ? var.yres / 2 : var.yres;
+	r.r = r.l + r.w - 1;
+	r.b = r.t + r.h - 1;
+	r.mode = 0;
+	var.rotate = c == BENCH_ROTATED ? FB_ROTATE_UD : FB_ROTATE_UR;
+	var.reserved[0] = 0;
+	if (c == BENCH_PARTIAL) {
+		var.reserved[0] = 0x54445055;
+		var.reserved[1] = (r.t << 16) | r.l;
+		var.reserved[2] = ((r.b + 1) << 16) | (r.r + 1);
+	}
+
+	memset(&h0, 0, sizeof(h0));
+	frame_tl_get_hdr(&h0);
+	pos = h0.head;
+	mutex_lock(&fb->update_sem);
+	fb->xfer_count = 0;
+	fb->xfer_us = 0;
+	fb->xfer_max_us = 0;
+	mutex_unlock(&fb->update_sem);
+	underruns = axipv_get_underruns();
+	cpu = bench_cpu_busy();
+	beats = bench_ddr_beats();
+
+	start = ktime_get();
+	for (i = 0; i < frames; i++) {
+		next = ktime_add_ns(start, div_u64((u64)i * NSEC_PER_SEC, fps));
+		now = ktime_get();
+		wait = ktime_us_delta(next, now);
+		if (wait > 0)
+			usleep_range(wait, wait + 100);
+		else if (i && wait < -(s64)(USEC_PER_SEC / fps))
+			late++;
+
+		var.yoffset = (i & 1) ? var.yres : 0;
+		bench_fill(fb, i & 1, i, &r);
+		if (kona_fb_pan_display(&var, &fb->fb))
+			break;
+	}
+	us = ktime_us_delta(ktime_get(), start);
+	/* the last frames reach the panel on the next vsyncs */
+	msleep(100);
+
+	while (!frame_tl_get_rec(&pos, &rec))
+		if (rec.post_ns && rec.vsync_ns && n < ARRAY_SIZE(bench_lat)) {
+			bench_lat[n] = div_u64(rec.vsync_ns - rec.post_ns,
+					       NSEC_PER_USEC);
+			lat_sum += bench_lat[n++];
+		}
+	if (n)
+		sort(bench_lat, n, sizeof(*bench_lat), bench_cmp, NULL);
+	memset(&h1, 0, sizeof(h1));
+	frame_tl_get_hdr(&h1);
+
+	mutex_lock(&fb->update_sem);
+	xfers = fb->xfer_count;
+	xfer_us = fb->xfer_us;
+	xfer_max = fb->xfer_max_us;
+	mutex_unlock(&fb->update_sem);
+	cpu = bench_cpu_busy() - cpu;
+	beats = (bench_ddr_beats() - beats) * AXITRACE_BEAT_BYTES;
+
+	bench_len += scnprintf(bench_report + bench_len,
+		sizeof(bench_report) - bench_len,
+		"case=%s fps=%u frames=%u late=%u us=%u post_te_avg_us=%llu "
+		"post_te_p99_us=%u post_te_max_us=%u missed=%u dropped=%u "
+		"underruns=%u xfers=%u xfer_avg_us=%llu xfer_max_us=%u "
+		"cpu_us=%u ddr_mbps=%llu\n",
+		bench_cases[c], fps, i, late, us,
+		n ? div_u64(lat_sum, n) : 0,
+		n ? bench_lat[(n - 1) * 99 / 100] : 0, n ? bench_lat[n - 1] : 0,
+		h1.missed - h0.missed, h1.dropped - h0.dropped,
+		axipv_get_underruns() - underruns, xfers,
+		xfers ? div_u64(xfer_us, xfers) : 0, xfer_max,
+		jiffies_to_usecs(cputime64_to_jiffies64(cpu)),
+		div_u64(beats, us ? us : 1));
+}
+
+static ssize_t dbgfs_bench_write(struct file *file, const char __user *ubuf,
+				 size_t count, loff_t *ppos)
+{
+	struct kona_fb *fb = ((struct seq_file *)file->private_data)->private;
+	char buf[48], name[16];
+	u32 fps, frames;
+	int c;
+
+	if (count >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, count))
+		return -EFAULT;
+	buf[count] = '\0';
+	if (sscanf(buf, "%15s %u %u", name, &fps, &frames) != 3 ||
+	    !fps || fps > 240 || !frames)
+		return -EINVAL;
+	for (c = 0; c < BENCH_CASES; c++)
+		if (!strcmp(name, bench_cases[c]))
+			break;
+	if (c == BENCH_CASES && strcmp(name, "all"))
+		return -EINVAL;
+	if (fb->blank_state != KONA_FB_UNBLANK ||
+	    !atomic_read(&fb->is_fb_registered))
+		return -EBUSY;
+
+	mutex_lock(&bench_mutex);
+	bench_len = 0;
+	if (c < BENCH_CASES) {
+		bench_run(fb, c, fps, frames);
+	} else {
+		for (c = 0; c < BENCH_CASES; c++)
+			bench_run(fb, c, fps, frames);
+	}
+	mutex_unlock(&bench_mutex);
+	return count;
+}
+
+static int dbgfs_bench_show(struct seq_file *s, void *unused)
+{
+	mutex_lock(&bench_mutex);
+	seq_write(s, bench_report, bench_len);
+	mutex_unlock(&bench_mutex);
+	return 0;
+}
+
+static int dbgfs_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, dbgfs_bench_show, inode->i_private);
+}
+
+static const struct file_operations dbgfs_bench_fops = {
+	.open			= dbgfs_bench_open,
+	.read			= seq_read,
+	.write			= dbgfs_bench_write,
+	.llseek			= seq_lseek,
+	.release		= single_release,
+};
+#endif /* CONFIG_FB_BRCM_KONA_BENCH */
+
 void __init kona_fb_create_debugfs(struct platform_device *pdev)
 {
 	struct kona_fb *fb;
@@ -1513,6 +2312,14 @@ void __init kona_fb_create_debugfs(struct platform_device *pdev)
 								__func__);
 			return;
 		}
+#ifdef CONFIG_FB_BRCM_KONA_BENCH
+		if (!debugfs_create_file("bench", S_IRUSR | S_IWUSR,
+					fb->dbgfs_dir, fb, &dbgfs_bench_fops)) {
+			dev_err(dev, "%s: failed to create dbgfs bench file\n",
+								__func__);
+			return;
+		}
+#endif
 	}
 }
 
@@ -1602,9 +2409,397 @@ static int disable_display(struct kona_fb *fb)
 	return ret;
 }
 
+static void dirty_rect_to_win(struct kona_fb_dirty_rect *rect,
+				DISPDRV_WIN_t *win)
+{
+	win->l = rect->x;
+	win->t = rect->y;
+	win->r = rect->x + rect->w - 1;
+	win->b = rect->y + rect->h - 1;
+	win->w = rect->w;
+	win->h = rect->h;
+	win->mode = 0;
+}
+
+static int kona_fb_update_dirty(struct kona_fb *fb, struct kona_fb_dirty *dirty)
+{
+	DISPDRV_WIN_t win[KONA_FB_MAX_DIRTY_RECTS];
+	struct kona_fb_dirty_rect bbox;
+	u32 area = 0, bbox_area, num_win, i;
+	u16 x2 = 0, y2 = 0;
+	int ret = 0;
+
+	/* video mode panels are refreshed continuously and rotated buffers
+	 * are only fixed up in pan_display, post full frames there */
+	if (fb->display_info->vmode || (fb->fb.var.rotate == FB_ROTATE_UD))
+		return -EOPNOTSUPP;
+	if ((dirty->buff_idx > 1) || (dirty->num_rects == 0) ||
+		(dirty->num_rects > KONA_FB_MAX_DIRTY_RECTS))
+		return -EINVAL;
+
+	bbox.x = fb->fb.var.xres;
+	bbox.y = fb->fb.var.yres;
+	for (i = 0; i < dirty->num_rects; i++) {
+		struct kona_fb_dirty_rect *r = &dirty->rect[i];
+
+		if (!r->w || !r->h || (r->x + r->w > fb->fb.var.xres) ||
+			(r->y + r->h > fb->fb.var.yres))
+			return -EINVAL;
+		area += r->w * r->h;
+		bbox.x = min(bbox.x, r->x);
+		bbox.y = min(bbox.y, r->y);
+		x2 = max_t(u16, x2, r->x + r->w);
+		y2 = max_t(u16, y2, r->y + r->h);
+	}
+	bbox.w = x2 - bbox.x;
+	bbox.h = y2 - bbox.y;
+	bbox_area = bbox.w * bbox.h;
+
+	/* every window costs a column/page address command sequence and a
+	 * TE wait, so only split when the bounding box is mostly clean */
+	if (bbox_area <= 2 * area) {
+		dirty_rect_to_win(&bbox, &win[0]);
+		num_win = 1;
+	} else {
+		for (i = 0; i < dirty->num_rects; i++)
+			dirty_rect_to_win(&dirty->rect[i], &win[i]);
+		num_win = dirty->num_rects;
+	}
+
+	if (mutex_lock_killable(&fb->update_sem))
+		return -EINTR;
+
+	if ((1 == fb->g_stop_drawing) ||
+		!atomic_read(&fb->is_fb_registered)) {
+		konafb_debug("not drawing, skip dirty update\n");
+		goto skip_drawing;
+	}
+
+	atomic_set(&fb->buff_idx, dirty->buff_idx);
+	kona_fb_overlay_reset(fb);
+	if (fb->link_suspended)
+		link_control(fb, RESUME_LINK);
+	kona_fb_graphics_started(fb);
+
+	for (i = 0; i < num_win; i++) {
+		if (wait_for_completion_timeout(&fb->prev_buf_done_sem,
+					msecs_to_jiffies(10000)) <= 0)
+			pr_err("%s:%d timed out waiting for completion",
+				__func__, __LINE__);
+		kona_clock_start(fb);
+		kona_fb_xfer_start(fb);
+		ret = fb->display_ops->update(fb->display_hdl,
+				dirty->buff_idx ? fb->buff1 : fb->buff0,
+				&win[i], (DISPDRV_CB_T)kona_display_done_cb);
+		if (ret)
+			break;
+	}
+
+	if (fb->suspend_link)
+		link_control(fb, SUSPEND_LINK);
+	kona_fb_wake_frame(fb);
+	kona_fb_ambient_arm(fb);
+
+skip_drawing:
+	mutex_unlock(&fb->update_sem);
+	return ret;
+}
+
+#ifdef KONA_FB_DMABUF
+#ifdef CONFIG_SW_SYNC
+static struct sync_fence *kona_fb_release_fence(struct kona_fb *fb)
+{
+	struct sync_pt *pt;
+	struct sync_fence *fence;
+
+	if (!fb->timeline) {
+		fb->timeline = sw_sync_timeline_create("kona_fb");
+		if (!fb->timeline)
+			return ERR_PTR(-ENOMEM);
+		fb->timeline_max = 0;
+	}
+
+	pt = sw_sync_pt_create(fb->timeline, fb->timeline_max + 1);
+	if (!pt)
+		return ERR_PTR(-ENOMEM);
+	fence = sync_fence_create("kona_fb", pt);
+	if (!fence) {
+		sync_pt_free(pt);
+		return ERR_PTR(-ENOMEM);
+	}
+	fb->timeline_max++;
+	return fence;
+}
+#endif
+
+static int kona_fb_post_dmabuf(struct kona_fb *fb,
+				struct kona_fb_post_dmabuf *post)
+{
+	struct kona_fb_import *imp;
+	size_t framesize = fb->fb.var.xres * fb->fb.var.yres *
+				(fb->fb.var.bits_per_pixel / 8);
+#ifdef CONFIG_SW_SYNC
+	struct sync_fence *fence;
+#endif
+	int ret = 0;
+
+	post->release_fence = -1;
+#ifdef CONFIG_SW_SYNC
+	if (post->acquire_fence >= 0) {
+		fence = sync_fence_fdget(post->acquire_fence);
+		if (!fence)
+			return -EINVAL;
+		ret = sync_fence_wait(fence, 1000);
+		sync_fence_put(fence);
+		if (ret < 0)
+			return ret;
+	}
+#endif
+
+	if (mutex_lock_killable(&fb->update_sem))
+		return -EINTR;
+
+	imp = kona_fb_import_get(fb, post->fd);
+	if (IS_ERR(imp)) {
+		ret = PTR_ERR(imp);
+		goto out;
+	}
+	if (post->offset + framesize > imp->dmabuf->size) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+#ifdef CONFIG_SW_SYNC
+	post->release_fence = get_unused_fd();
+	if (post->release_fence < 0) {
+		ret = post->release_fence;
+		goto out;
+	}
+	fence = kona_fb_release_fence(fb);
+	if (IS_ERR(fence)) {
+		put_unused_fd(post->release_fence);
+		post->release_fence = -1;
+		ret = PTR_ERR(fence);
+		goto out;
+	}
+	sync_fence_install(fence, post->release_fence);
+#endif
+
+	if ((1 == fb->g_stop_drawing) ||
+		!atomic_read(&fb->is_fb_registered)) {
+		konafb_debug("not drawing, skip dmabuf post\n");
+		/* nothing reads the buffer, don't hold it back */
+		kona_fb_import_release(fb, true);
+		goto out;
+	}
+
+	if (fb->link_suspended)
+		link_control(fb, RESUME_LINK);
+	kona_fb_graphics_started(fb);
+
+	if (!fb->display_info->vmode) {
+		if (wait_for_completion_timeout(&fb->prev_buf_done_sem,
+					msecs_to_jiffies(10000)) <= 0)
+			pr_err("%s:%d timed out waiting for completion",
+				__func__, __LINE__);
+		kona_clock_start(fb);
+	}
+	fb->import_cur = imp;
+	kona_fb_overlay_reset(fb);
+	ret = fb->display_ops->update(fb->display_hdl,
+			(void *)(imp->dma_addr + post->offset), NULL,
+			(DISPDRV_CB_T)kona_display_done_cb);
+	if (fb->display_info->vmode) {
+		if (wait_for_completion_timeout(&fb->prev_buf_done_sem,
+					msecs_to_jiffies(10000)) <= 0)
+			pr_err("%s:%d timed out waiting for completion",
+				__func__, __LINE__);
+	}
+	kona_fb_import_release(fb, false);
+
+	if (fb->suspend_link)
+		link_control(fb, SUSPEND_LINK);
+	kona_fb_wake_frame(fb);
+	kona_fb_ambient_arm(fb);
+out:
+	mutex_unlock(&fb->update_sem);
+	return ret;
+}
+#endif
+
+#ifdef KONA_FB_OVERLAY
+static inline u32 kona_fb_screen_phys(struct kona_fb *fb, u32 idx)
+{
+	return fb->fb.fix.smem_start + idx * (fb->buff1 - fb->buff0);
+}
+
+/* copy rectangle r from src (src_pitch bytes per line) to the same place
+ * of screen dst_idx */
+static int kona_fb_blit(struct kona_fb *fb, u32 src, u32 src_pitch,
+			u32 dst_idx, struct kona_fb_dirty_rect *r)
+{
+	u32 bpp = fb->fb.var.bits_per_pixel / 8;
+	u32 line = fb->fb.fix.line_length;
+	u32 dst = kona_fb_screen_phys(fb, dst_idx) + r->y * line + r->x * bpp;
+
+	return mmdma_execute_2d(src, dst, r->w * bpp, r->h,
+			src_pitch - r->w * bpp, line - r->w * bpp);
+}
+
+static int kona_fb_post_overlay(struct kona_fb *fb,
+				struct kona_fb_overlay *ovl)
+{
+	struct kona_fb_dirty_rect rect, *old = &fb->ovl_rect;
+	struct dma_buf *dmabuf;
+	struct dma_buf_attachment *attach;
+	struct sg_table *sgt;
+	DISPDRV_WIN_t win, *p_win = NULL;
+	u32 bpp = fb->fb.var.bits_per_pixel / 8;
+	u32 line = fb->fb.fix.line_length;
+	u32 out_idx, bg, src;
+	u16 x2, y2;
+	int ret = 0;
+
+	/* video mode scans out continuously from one buffer address, there
+	 * is no window to hide the blits in */
+	if (fb->display_info->vmode || (fb->fb.var.rotate == FB_ROTATE_UD) ||
+		fb->display_info->special_mode_on)
+		return -EOPNOTSUPP;
+	/* no blending in PV or the dma, only opaque layers */
+	if (ovl->alpha != 0xff)
+		return -EOPNOTSUPP;
+	if ((ovl->bg_idx > 1) || !ovl->w || !ovl->h ||
+		(ovl->x + ovl->w > fb->fb.var.xres) ||
+		(ovl->y + ovl->h > fb->fb.var.yres) ||
+		(ovl->pitch < ovl->w * bpp))
+		return -EINVAL;
+	if ((ovl->pitch - ovl->w * bpp > 0xffff) ||
+		(line - ovl->w * bpp > 0xffff))
+		return -EOPNOTSUPP;
+
+	dmabuf = dma_buf_get(ovl->fd);
+	if (IS_ERR(dmabuf))
+		return PTR_ERR(dmabuf);
+	if (ovl->offset + (ovl->h - 1) * ovl->pitch + ovl->w * bpp >
+			dmabuf->size) {
+		ret = -EINVAL;
+		goto put;
+	}
+	attach = dma_buf_attach(dmabuf, &fb->pdev->dev);
+	if (IS_ERR(attach)) {
+		ret = PTR_ERR(attach);
+		goto put;
+	}
+	sgt = dma_buf_map_attachment(attach, DMA_TO_DEVICE);
+	if (IS_ERR_OR_NULL(sgt)) {
+		ret = sgt ? PTR_ERR(sgt) : -ENOMEM;
+		goto detach;
+	}
+	/* mmdma works on physical addresses */
+	if (sgt->nents != 1) {
+		ret = -EOPNOTSUPP;
+		goto unmap;
+	}
+	src = sg_phys(sgt->sgl) + ovl->offset;
+
+	rect.x = ovl->x;
+	rect.y = ovl->y;
+	rect.w = ovl->w;
+	rect.h = ovl->h;
+	bg = ovl->bg_idx;
+	out_idx = 1 - bg;
+
+	if (mutex_lock_killable(&fb->update_sem)) {
+		ret = -EINTR;
+		goto unmap;
+	}
+
+	if ((1 == fb->g_stop_drawing) ||
+		!atomic_read(&fb->is_fb_registered)) {
+		konafb_debug("not drawing, skip overlay post\n");
+		goto skip_drawing;
+	}
+
+	if (fb->link_suspended)
+		link_control(fb, RESUME_LINK);
+	kona_fb_graphics_started(fb);
+
+	/* the panel may still be reading the output screen */
+	if (wait_for_completion_timeout(&fb->prev_buf_done_sem,
+				msecs_to_jiffies(10000)) <= 0)
+		pr_err("%s:%d timed out waiting for completion",
+			__func__, __LINE__);
+
+	if (!fb->ovl_valid || (fb->ovl_bg_idx != bg) ||
+		(ovl->flags & KONA_FB_OVERLAY_BG_DIRTY)) {
+		fb->ovl_valid = false;
+		ret = mmdma_execute(kona_fb_screen_phys(fb, bg),
+				kona_fb_screen_phys(fb, out_idx),
+				line * fb->fb.var.yres);
+	} else {
+		/* put the background back where the layer was */
+		ret = kona_fb_blit(fb, kona_fb_screen_phys(fb, bg) +
+				old->y * line + old->x * bpp, line,
+				out_idx, old);
+		x2 = max_t(u16, old->x + old->w, rect.x + rect.w);
+		y2 = max_t(u16, old->y + old->h, rect.y + rect.h);
+		win.l = min(old->x, rect.x);
+		win.t = min(old->y, rect.y);
+		win.r = x2 - 1;
+		win.b = y2 - 1;
+		win.w = x2 - win.l;
+		win.h = y2 - win.t;
+		win.mode = 0;
+		p_win = &win;
+	}
+	if (!ret)
+		ret = kona_fb_blit(fb, src, ovl->pitch, out_idx, &rect);
+	if (ret) {
+		pr_err("%s: mmdma blit failed %d\n", __func__, ret);
+		fb->ovl_valid = false;
+		complete(&fb->prev_buf_done_sem);
+		goto suspend_link;
+	}
+
+	atomic_set(&fb->buff_idx, out_idx);
+	kona_clock_start(fb);
+	ret = fb->display_ops->update(fb->display_hdl,
+			out_idx ? fb->buff1 : fb->buff0, p_win,
+			(DISPDRV_CB_T)kona_display_done_cb);
+	/* back on the framebuffer, imported buffers are free */
+	kona_fb_import_release(fb, true);
+
+	fb->ovl_valid = !ret;
+	fb->ovl_bg_idx = bg;
+	fb->ovl_rect = rect;
+
+suspend_link:
+	if (fb->suspend_link)
+		link_control(fb, SUSPEND_LINK);
+	kona_fb_wake_frame(fb);
+	kona_fb_ambient_arm(fb);
+skip_drawing:
+	mutex_unlock(&fb->update_sem);
+unmap:
+	dma_buf_unmap_attachment(attach, sgt, DMA_TO_DEVICE);
+detach:
+	dma_buf_detach(dmabuf, attach);
+put:
+	dma_buf_put(dmabuf);
+	return ret;
+}
+#endif
+
 static int kona_fb_ioctl(struct fb_info *info, unsigned int cmd,
 			 unsigned long arg)
 {
+	struct kona_fb_dirty dirty;
+#ifdef KONA_FB_DMABUF
+	struct kona_fb_post_dmabuf post;
+#endif
+#ifdef KONA_FB_OVERLAY
+	struct kona_fb_overlay ovl;
+#endif
 	void *ptr = NULL;
 	int ret = 0;
 	struct kona_fb *fb = container_of(info, struct kona_fb, fb);
@@ -1658,6 +2853,32 @@ static int kona_fb_ioctl(struct fb_info *info, unsigned int cmd,
 			pr_err("copy2user failed ret=%d\n", ret);
 		break;
 
+	case KONA_IOCTL_UPDATE_DIRTY:
+		if (copy_from_user(&dirty, (void __user *)arg,
+					sizeof(dirty)))
+			return -EFAULT;
+		ret = kona_fb_update_dirty(fb, &dirty);
+		break;
+
+#ifdef KONA_FB_DMABUF
+	case KONA_IOCTL_POST_DMABUF:
+		if (copy_from_user(&post, (void __user *)arg, sizeof(post)))
+			return -EFAULT;
+		ret = kona_fb_post_dmabuf(fb, &post);
+		if (copy_to_user(&((struct kona_fb_post_dmabuf __user *)arg)->
+			release_fence, &post.release_fence, sizeof(int)))
+			ret = -EFAULT;
+		break;
+#endif
+
+#ifdef KONA_FB_OVERLAY
+	case KONA_IOCTL_POST_OVERLAY:
+		if (copy_from_user(&ovl, (void __user *)arg, sizeof(ovl)))
+			return -EFAULT;
+		ret = kona_fb_post_overlay(fb, &ovl);
+		break;
+#endif
+
 	default:
 		konafb_error("Wrong ioctl cmd\n");
 		ret = -ENOTTY;
@@ -1706,6 +2927,68 @@ static int clear_panel_ram(struct kona_fb *fb)
 	return ret;
 }
 
+/* Blank of a command mode panel that is likely to be unblanked soon:
+ * sleep in and stop the link but keep it configured, so the unblank
+ * only needs the sleep out and display on commands. Called with
+ * update_sem held, after the screen off */
+static void kona_fb_warm_blank(struct kona_fb *fb)
+{
+	cancel_work_sync(&fb->vsync_smart);
+	kona_clock_start(fb);
+	if (fb->display_ops->power_control(fb->display_hdl, CTRL_SLEEP_IN))
+		konafb_error("Failed to sleep in this display device!\n");
+	fb->display_ops->suspend_link(fb->display_hdl);
+	kona_clock_stop(fb);
+	fb->link_suspended = true;
+	fb->warm = true;
+	schedule_delayed_work(&fb->warm_work,
+			msecs_to_jiffies(fb->warm_blank_ms));
+}
+
+/* The blank lasted, finish the teardown. Called with update_sem held */
+static void kona_fb_warm_off(struct kona_fb *fb)
+{
+	if (!fb->warm)
+		return;
+	fb->warm = false;
+	link_control(fb, RESUME_LINK);
+	disable_display(fb);
+	pi_mgr_qos_request_update(&g_mm_qos_node, PI_MGR_QOS_DEFAULT_VALUE);
+	konafb_debug("warm blank over\n");
+}
+
+static void kona_fb_warm_work(struct work_struct *work)
+{
+	struct kona_fb *fb = container_of(to_delayed_work(work),
+					struct kona_fb, warm_work);
+
+	mutex_lock(&fb->update_sem);
+	kona_fb_warm_off(fb);
+	mutex_unlock(&fb->update_sem);
+}
+
+/* Called with update_sem held */
+static int kona_fb_warm_unblank(struct kona_fb *fb)
+{
+	int ret;
+
+	/* the work finds warm cleared if it is already running */
+	cancel_delayed_work(&fb->warm_work);
+	fb->warm = false;
+	link_control(fb, RESUME_LINK);
+	kona_clock_start(fb);
+	ret = fb->display_ops->power_control(fb->display_hdl, CTRL_SLEEP_OUT);
+	if (ret) {
+		konafb_error("Failed to sleep out, reinit the display\n");
+		kona_clock_stop(fb);
+		disable_display(fb);
+		return enable_display(fb);
+	}
+	schedule_work(&fb->vsync_smart);
+	kona_clock_stop(fb);
+	return 0;
+}
+
 static int kona_fb_blank(int blank_mode, struct fb_info *info)
 {
 	struct kona_fb *fb = container_of(info, struct kona_fb, fb);
@@ -1754,7 +3037,10 @@ static int kona_fb_blank(int blank_mode, struct fb_info *info)
 		}
 
 		/* screen goes to sleep mode */
-		disable_display(fb);
+		if (fb->warm_blank_ms && !fb->display_info->vmode)
+			kona_fb_warm_blank(fb);
+		else
+			disable_display(fb);
 
 		/* Ok for MM going to shutdown state */
 		pi_mgr_qos_request_update(&g_mm_qos_node,
@@ -1773,10 +3059,12 @@ static int kona_fb_blank(int blank_mode, struct fb_info *info)
 			break;
 		}
 
+		fb->wake_start = ktime_get();
+		fb->wake_warm = fb->warm;
 		/* Ok for MM going to retention but not shutdown state */
 		pi_mgr_qos_request_update(&g_mm_qos_node, 10);
 		/* screen comes out of sleep */
-		if (enable_display(fb))
+		if (fb->warm ? kona_fb_warm_unblank(fb) : enable_display(fb))
 			konafb_error("Failed to enable this display device\n");
 
 		if (!fb->display_info->vmode) {
@@ -1841,6 +3129,10 @@ static int kona_fb_blank(int blank_mode, struct fb_info *info)
 			link_control(fb, SUSPEND_LINK);
 
 		fb->blank_state = KONA_FB_UNBLANK;
+		fb->wakes[fb->wake_warm]++;
+		fb->wake_unblank_us[fb->wake_warm] =
+			ktime_us_delta(ktime_get(), fb->wake_start);
+		kona_fb_ambient_arm(fb);
 		mutex_unlock(&fb->update_sem);
 		break;
 
@@ -1929,6 +3221,23 @@ void free_platform_data(struct device *dev)
 		kfree(dev->platform_data);
 }
 
+/*
+ * A splash from the bootloader means the panel, DSI link and AXIPV are
+ * running: probe adopts them as lcd_panel= would have, without a reset,
+ * and keeps the splash on screen by copying it into the framebuffer.
+ */
+static int __init kona_fb_splash_setup(void)
+{
+	const struct kona_splash *splash = kona_get_splash();
+
+	if (splash) {
+		strlcpy(g_disp_str, splash->panel, sizeof(g_disp_str));
+		g_display_enabled = 1;
+	}
+	return 0;
+}
+early_initcall(kona_fb_splash_setup);
+
 static int __init lcd_panel_setup(char *panel)
 {
 	if (panel && strlen(panel)) {
@@ -2483,9 +3792,10 @@ static int __ref kona_fb_probe(struct platform_device *pdev)
 #ifdef CONFIG_LOGO
 	int logo_rotate;
 #endif
-	uint32_t uboot_phys;
+	uint32_t uboot_phys, uboot_size = 0;
 	void *uboot_kvirt = NULL;
 	int need_map_switch = 0;
+	const struct kona_splash *splash;
 
 	konafb_info("start\n");
 	if (g_kona_fb && (g_kona_fb->is_display_found == 1)) {
@@ -2535,6 +3845,8 @@ static int __ref kona_fb_probe(struct platform_device *pdev)
 
 	pr_err("Initialising in %s mode\n", fb->display_info->vmode ?
 						"VIDEO" : "COMMAND");
+	/* clear_panel_ram has turned the handoff off by now */
+	splash = g_display_enabled ? kona_get_splash() : NULL;
 	fb->display_ops = (DISPDRV_T *)DISP_DRV_GetFuncTable();
 
 	spin_lock_init(&fb->lock);
@@ -2551,6 +3863,8 @@ static int __ref kona_fb_probe(struct platform_device *pdev)
 	complete(&fb->prev_buf_done_sem);
 	atomic_set(&fb->is_graphics_started, 0);
 	INIT_DELAYED_WORK(&fb->link_work, fb_suspend_link_work);
+	INIT_DELAYED_WORK(&fb->ambient_work, kona_fb_ambient_work);
+	INIT_DELAYED_WORK(&fb->warm_work, kona_fb_warm_work);
 	wake_lock_init(&fb->wlock, WAKE_LOCK_SUSPEND, "dsi_link_wakelock");
 
 	ret = enable_display(fb);
@@ -2703,33 +4017,49 @@ static int __ref kona_fb_probe(struct platform_device *pdev)
 		goto err_set_var_failed;
 	}
 
-	if (need_map_switch) {
-		uboot_phys = readl(KONA_AXIPV_VA + REG_CUR_FRAME);
-		uboot_kvirt = ioremap_nocache(uboot_phys, framesize / 2);
+	/*
+	 * Take over the frame on screen in buff1, which is what gets shown
+	 * below. On command mode panels it only keeps the framebuffer in
+	 * line with the panel ram, for partial updates.
+	 */
+	if (need_map_switch || splash) {
+		uboot_phys = splash ? splash->base :
+				readl(KONA_AXIPV_VA + REG_CUR_FRAME);
+		uboot_size = splash ? min_t(u32, splash->size, framesize / 2) :
+				framesize / 2;
+		uboot_kvirt = ioremap_nocache(uboot_phys, uboot_size);
 		pr_info("Copy uboot logo to fb, phys 0x%x kvirt 0x%x\n",
 				uboot_phys, (uint32_t)uboot_kvirt);
-		if (uboot_kvirt) {
-			/* memcopy uboot buffer to kernel's buff1 */
+	}
+	if (uboot_kvirt) {
+		/* copy uboot buffer to kernel's buff1, with mmdma
+		 * rather than uncached cpu reads where it can */
+#ifdef CONFIG_MMDMA
+		if (uboot_size < mmdma_offload_min ||
+		    mmdma_execute(uboot_phys, phys_fbbase + framesize / 2,
+				  uboot_size))
+#endif
 			memcpy(fb->fb.screen_base + (framesize / 2),
-				uboot_kvirt, framesize / 2);
-			iounmap(uboot_kvirt);
-			/* update display with 1:1 map */
-			if (!fb->display_info->vmode)
-				kona_clock_start(fb);
-			if (fb->display_info->clear_panel_ram)
-				(void)clear_panel_ram(fb);
-			ret = fb->display_ops->update(fb->display_hdl,
-				(void *)phys_fbbase +
-				(framesize / 2), NULL, NULL);
-			if (!fb->display_info->vmode)
-				kona_clock_stop(fb);
-			if (ret) {
-				konafb_error("Can not enable the LCD!\n");
-				goto err_fb_register_failed;
-			}
-			/* Wait new buffer. TODO: checking frame end */
-			usleep_range(16666, 16668);
+				uboot_kvirt, uboot_size);
+		iounmap(uboot_kvirt);
+	}
+	if (uboot_kvirt && need_map_switch) {
+		/* update display with 1:1 map */
+		if (!fb->display_info->vmode)
+			kona_clock_start(fb);
+		if (fb->display_info->clear_panel_ram)
+			(void)clear_panel_ram(fb);
+		ret = fb->display_ops->update(fb->display_hdl,
+			(void *)phys_fbbase +
+			(framesize / 2), NULL, NULL);
+		if (!fb->display_info->vmode)
+			kona_clock_stop(fb);
+		if (ret) {
+			konafb_error("Can not enable the LCD!\n");
+			goto err_fb_register_failed;
 		}
+		/* Wait new buffer. TODO: checking frame end */
+		usleep_range(16666, 16668);
 	}
 
 #ifdef CONFIG_IOMMU_API
@@ -2821,7 +4151,8 @@ static int __ref kona_fb_probe(struct platform_device *pdev)
 
 		fb->esd_check_wq =
 			create_singlethread_workqueue("lcd_esd_check");
-		INIT_DELAYED_WORK(&fb->esd_check_work, kona_fb_esd_check);
+		/* no need to wake an idle cpu just to poll the panel */
+		INIT_DEFERRABLE_WORK(&fb->esd_check_work, kona_fb_esd_check);
 		queue_delayed_work(fb->esd_check_wq, &fb->esd_check_work,
 			msecs_to_jiffies(fb->fb_data->esdcheck_period_ms));
 	}
@@ -2944,9 +4275,18 @@ static int kona_fb_remove(struct platform_device *pdev)
 	fb_fps_unregister(fb->fps_info);
 #endif
 	unregister_framebuffer(&fb->fb);
+	cancel_delayed_work_sync(&fb->ambient_work);
+	cancel_delayed_work_sync(&fb->warm_work);
+	if (fb->warm) {
+		fb->warm = false;
+		link_control(fb, RESUME_LINK);
+	}
 	disable_display(fb);
 #ifdef CONFIG_IOMMU_API
 #ifdef CONFIG_BCM_IOVMM
+#ifdef KONA_FB_DMABUF
+	kona_fb_import_flush(fb);
+#endif
 	kona_fb_iovmm_unmap(fb, fb->framesize_alloc, (dma_addr_t)fb->buff0);
 #else
 	kona_fb_direct_unmap(fb, fb->framesize_alloc, (dma_addr_t)fb->buff0);
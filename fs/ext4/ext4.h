@@ -1014,6 +1014,7 @@ struct ext4_inode_info {
 #define EXT4_MOUNT_DIOREAD_NOLOCK	0x400000 /* Enable support for dio read nolocking */
 #define EXT4_MOUNT_JOURNAL_CHECKSUM	0x800000 /* Journal checksums */
 #define EXT4_MOUNT_JOURNAL_ASYNC_COMMIT	0x1000000 /* Journal Async Commit */
+#define EXT4_MOUNT_DEFERRED_DISCARD	0x2000000 /* Discard when idle */
 #define EXT4_MOUNT_DELALLOC		0x8000000 /* Delalloc support */
 #define EXT4_MOUNT_DATA_ERR_ABORT	0x10000000 /* Abort on file data write */
 #define EXT4_MOUNT_BLOCK_VALIDITY	0x20000000 /* Block validity checking */
@@ -1348,6 +1349,18 @@ struct ext4_sb_info {
 	/* record the last minlen when FITRIM is called. */
 	atomic_t s_last_trim_minblks;
 
+	/* deferred discard, see ext4_mb_discard_work() */
+	struct delayed_work s_discard_work;
+	atomic_t s_discard_pending;	/* clusters freed, not discarded */
+	ext4_group_t s_discard_group;	/* where the last run stopped */
+	unsigned long s_discard_reads;	/* device reads at the last look */
+	unsigned long s_last_fg_write;	/* jiffies */
+	unsigned int s_discard_idle_secs;
+	unsigned int s_discard_min_kb;
+	unsigned int s_discard_issued_kb;
+	unsigned int s_write_lat_avg_us;
+	unsigned int s_write_lat_max_us;
+
 	/* Reference to checksum algorithm driver via cryptoapi */
 	struct crypto_shash *s_chksum_driver;
 
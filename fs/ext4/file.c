@@ -162,11 +162,28 @@ ext4_file_dio_write(struct kiocb *iocb, const struct iovec *iov,
 	return ret;
 }
 
+/*
+ * Foreground write latency, the average over the last 8 or so and the
+ * worst since it was cleared, as they are seen by the discards deferred
+ * to idle time; the last write also tells when the fs was last busy.
+ */
+static void ext4_file_write_account(struct super_block *sb, ktime_t start)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	unsigned int us = ktime_to_us(ktime_sub(ktime_get(), start));
+
+	sbi->s_last_fg_write = jiffies;
+	sbi->s_write_lat_avg_us += (int)(us - sbi->s_write_lat_avg_us) / 8;
+	if (us > sbi->s_write_lat_max_us)
+		sbi->s_write_lat_max_us = us;
+}
+
 static ssize_t
 ext4_file_write(struct kiocb *iocb, const struct iovec *iov,
 		unsigned long nr_segs, loff_t pos)
 {
 	struct inode *inode = file_inode(iocb->ki_filp);
+	ktime_t start = ktime_get();
 	ssize_t ret;
 	int overwrite = 0;
 
@@ -195,6 +212,7 @@ ext4_file_write(struct kiocb *iocb, const struct iovec *iov,
 	else
 		ret = generic_file_aio_write(iocb, iov, nr_segs, pos);
 
+	ext4_file_write_account(inode->i_sb, start);
 	return ret;
 }
 
@@ -25,7 +25,12 @@
 #include "mballoc.h"
 #include <linux/log2.h>
 #include <linux/module.h>
+#include <linux/power_supply.h>
 #include <linux/slab.h>
+#include <linux/suspend.h>
+#ifdef CONFIG_HAS_EARLYSUSPEND
+#include <linux/earlysuspend.h>
+#endif
 #include <trace/events/ext4.h>
 
 #ifdef CONFIG_EXT4_DEBUG
@@ -368,6 +373,11 @@ static void ext4_mb_generate_from_freelist(struct super_block *sb, void *bitmap,
 						ext4_group_t group);
 static void ext4_free_data_callback(struct super_block *sb,
 				struct ext4_journal_cb_entry *jce, int rc);
+static void ext4_mb_discard_work(struct work_struct *work);
+static void ext4_mb_discard_defer(struct super_block *sb, int count);
+static ext4_grpblk_t ext4_trim_all_free(struct super_block *sb,
+		ext4_group_t group, ext4_grpblk_t start, ext4_grpblk_t max,
+		ext4_grpblk_t minblocks);
 
 static inline void *mb_correct_addr_and_bit(int *bit, void *addr)
 {
@@ -2560,6 +2570,9 @@ int ext4_mb_init(struct super_block *sb)
 	sbi->s_mb_stats = MB_DEFAULT_STATS;
 	sbi->s_mb_stream_request = MB_DEFAULT_STREAM_THRESHOLD;
 	sbi->s_mb_order2_reqs = MB_DEFAULT_ORDER2_REQS;
+	sbi->s_discard_idle_secs = MB_DEFAULT_DISCARD_IDLE_SECS;
+	sbi->s_discard_min_kb = MB_DEFAULT_DISCARD_MIN_KB;
+	INIT_DEFERRABLE_WORK(&sbi->s_discard_work, ext4_mb_discard_work);
 	/*
 	 * The default group preallocation is 512, which for 4k block
 	 * sizes translates to 2 megabytes.  However for bigalloc file
@@ -2652,6 +2665,7 @@ int ext4_mb_release(struct super_block *sb)
 	struct ext4_sb_info *sbi = EXT4_SB(sb);
 	struct kmem_cache *cachep = get_groupinfo_cache(sb->s_blocksize_bits);
 
+	cancel_delayed_work_sync(&sbi->s_discard_work);
 	if (sbi->s_proc)
 		remove_proc_entry("mb_groups", sbi->s_proc);
 
@@ -2778,12 +2792,167 @@ static void ext4_free_data_callback(struct super_block *sb,
 		page_cache_release(e4b.bd_bitmap_page);
 	}
 	ext4_unlock_group(sb, entry->efd_group);
+	if (!test_opt(sb, DISCARD) && test_opt(sb, DEFERRED_DISCARD))
+		ext4_mb_discard_defer(sb, entry->efd_count);
 	kmem_cache_free(ext4_free_data_cachep, entry);
 	ext4_mb_unload_buddy(&e4b);
 
 	mb_debug(1, "freed %u blocks in %u structures\n", count, count2);
 }
 
+/*
+ * Deferred discard, -o deferred_discard. The clusters a commit frees are
+ * not discarded then, in the write path; they clear the trimmed flag of
+ * their group and count as pending. Once nothing used the device for
+ * s_discard_idle_secs, on a charger and with the screen off, the worker
+ * trims the groups not trimmed since as FITRIM does, with the freed
+ * ranges merged by the buddy into free extents and only those of at
+ * least s_discard_min_kb sent down. It goes a group at a time, looks
+ * again between groups and goes on from there on its next run.
+ */
+static bool ext4_discard_screen_off = !IS_ENABLED(CONFIG_HAS_EARLYSUSPEND);
+static bool ext4_discard_suspending;
+
+static void ext4_mb_discard_queue(struct ext4_sb_info *sbi)
+{
+	queue_delayed_work(system_freezable_wq, &sbi->s_discard_work,
+			   max(sbi->s_discard_idle_secs, 1U) * HZ);
+}
+
+/* called with freed clusters of a group that was not discarded */
+static void ext4_mb_discard_defer(struct super_block *sb, int count)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+
+	atomic_add(count, &sbi->s_discard_pending);
+	ext4_mb_discard_queue(sbi);
+}
+
+static bool ext4_mb_discard_idle(struct super_block *sb)
+{
+	struct ext4_sb_info *sbi = EXT4_SB(sb);
+	struct hd_struct *part0 = &sb->s_bdev->bd_disk->part0;
+	unsigned long reads;
+
+	if (ext4_discard_suspending || !ext4_discard_screen_off)
+		return false;
+	/* a power supply class that cannot tell (-ENOSYS) is a charger */
+	if (!power_supply_is_system_supplied())
+		return false;
+	if (!time_after(jiffies, sbi->s_last_fg_write +
+			sbi->s_discard_idle_secs * HZ))
+		return false;
+
+	/*
+	 * The whole device, other partitions too. Discards count as
+	 * writes, so other users only show as reads or as requests in
+	 * flight; ours are done by the time we look.
+	 */
+	reads = part_stat_read(part0, ios[READ]);
+	if (reads != sbi->s_discard_reads || part_in_flight(part0)) {
+		sbi->s_discard_reads = reads;
+		return false;
+	}
+	return true;
+}
+
+static void ext4_mb_discard_work(struct work_struct *work)
+{
+	struct ext4_sb_info *sbi = container_of(to_delayed_work(work),
+					struct ext4_sb_info, s_discard_work);
+	struct super_block *sb = sbi->s_sb;
+	ext4_group_t ngroups = ext4_get_groups_count(sb);
+	ext4_group_t group, n;
+	ext4_grpblk_t minblks, last, max;
+	struct ext4_group_info *grp;
+	int todo, done = 0, cnt;
+
+	if (!test_opt(sb, DEFERRED_DISCARD) || (sb->s_flags & MS_RDONLY))
+		return;
+	todo = atomic_read(&sbi->s_discard_pending);
+	if (!todo)
+		return;
+	if (!ext4_mb_discard_idle(sb))
+		goto out;
+
+	minblks = EXT4_NUM_B2C(sbi, ((u64)sbi->s_discard_min_kb << 10) >>
+			       sb->s_blocksize_bits);
+	minblks = clamp_t(ext4_grpblk_t, minblks, 1,
+			  EXT4_CLUSTERS_PER_GROUP(sb));
+	/* a later FITRIM with a smaller minlen must not skip these groups */
+	if (minblks > atomic_read(&sbi->s_last_trim_minblks))
+		atomic_set(&sbi->s_last_trim_minblks, minblks);
+	ext4_get_group_no_and_offset(sb, ext4_blocks_count(sbi->s_es) - 1,
+				     &group, &last);
+
+	for (n = 0; n < ngroups; n++) {
+		group = sbi->s_discard_group;
+		if (group >= ngroups)
+			group = 0;
+		sbi->s_discard_group = group + 1;
+
+		/* a group not loaded had nothing freed since the mount */
+		grp = ext4_get_group_info(sb, group);
+		if (EXT4_MB_GRP_NEED_INIT(grp) ||
+		    EXT4_MB_GRP_WAS_TRIMMED(grp) || grp->bb_free < minblks)
+			continue;
+
+		max = group == ngroups - 1 ? last :
+			EXT4_CLUSTERS_PER_GROUP(sb) - 1;
+		cnt = ext4_trim_all_free(sb, group, 0, max, minblks);
+		if (cnt < 0)
+			break;
+		done += cnt;
+		sbi->s_discard_issued_kb += EXT4_C2B(sbi, cnt) <<
+					    (sb->s_blocksize_bits - 10);
+		if (!ext4_mb_discard_idle(sb))
+			break;
+	}
+
+	/* after a full round all that was pending has been looked at */
+	atomic_sub(n == ngroups ? todo : min(done, todo),
+		   &sbi->s_discard_pending);
+out:
+	if (atomic_read(&sbi->s_discard_pending))
+		ext4_mb_discard_queue(sbi);
+}
+
+static int ext4_mb_discard_pm_notify(struct notifier_block *nb,
+				     unsigned long event, void *unused)
+{
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		ext4_discard_suspending = true;
+		break;
+	case PM_POST_SUSPEND:
+		ext4_discard_suspending = false;
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ext4_mb_discard_pm_nb = {
+	.notifier_call = ext4_mb_discard_pm_notify,
+};
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void ext4_mb_discard_early_suspend(struct early_suspend *h)
+{
+	ext4_discard_screen_off = true;
+}
+
+static void ext4_mb_discard_late_resume(struct early_suspend *h)
+{
+	ext4_discard_screen_off = false;
+}
+
+static struct early_suspend ext4_mb_discard_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN,
+	.suspend = ext4_mb_discard_early_suspend,
+	.resume = ext4_mb_discard_late_resume,
+};
+#endif
+
 int __init ext4_init_mballoc(void)
 {
 	ext4_pspace_cachep = KMEM_CACHE(ext4_prealloc_space,
@@ -2805,6 +2974,11 @@ int __init ext4_init_mballoc(void)
 		kmem_cache_destroy(ext4_ac_cachep);
 		return -ENOMEM;
 	}
+
+	register_pm_notifier(&ext4_mb_discard_pm_nb);
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&ext4_mb_discard_early_suspend_desc);
+#endif
 	return 0;
 }
 
@@ -2815,6 +2989,10 @@ void ext4_exit_mballoc(void)
 	 * before destroying the slab cache.
 	 */
 	rcu_barrier();
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	unregister_early_suspend(&ext4_mb_discard_early_suspend_desc);
+#endif
+	unregister_pm_notifier(&ext4_mb_discard_pm_nb);
 	kmem_cache_destroy(ext4_pspace_cachep);
 	kmem_cache_destroy(ext4_ac_cachep);
 	kmem_cache_destroy(ext4_free_data_cachep);
@@ -4790,8 +4968,11 @@ do_more:
 					 " group:%d block:%d count:%lu failed"
 					 " with %d", block_group, bit, count,
 					 err);
-		} else
+		} else {
 			EXT4_MB_GRP_CLEAR_TRIMMED(e4b.bd_info);
+			if (test_opt(sb, DEFERRED_DISCARD))
+				ext4_mb_discard_defer(sb, count_clusters);
+		}
 
 		ext4_lock_group(sb, block_group);
 		mb_clear_bits(bitmap_bh->b_data, bit, count_clusters);
@@ -89,6 +89,13 @@ extern ushort ext4_mballoc_debug;
  */
 #define MB_DEFAULT_GROUP_PREALLOC	512
 
+/*
+ * with -o deferred_discard, freed space is discarded once the device is
+ * idle that long, in free extents of at least that size
+ */
+#define MB_DEFAULT_DISCARD_IDLE_SECS	30
+#define MB_DEFAULT_DISCARD_MIN_KB	1024	/* an eMMC erase group */
+
 
 struct ext4_free_data {
 	/* MUST be the first member */
@@ -1138,6 +1138,7 @@ enum {
 	Opt_inode_readahead_blks, Opt_journal_ioprio,
 	Opt_dioread_nolock, Opt_dioread_lock,
 	Opt_discard, Opt_nodiscard, Opt_init_itable, Opt_noinit_itable,
+	Opt_deferred_discard, Opt_nodeferred_discard,
 	Opt_max_dir_size_kb,
 };
 
@@ -1209,6 +1210,8 @@ static const match_table_t tokens = {
 	{Opt_dioread_lock, "dioread_lock"},
 	{Opt_discard, "discard"},
 	{Opt_nodiscard, "nodiscard"},
+	{Opt_deferred_discard, "deferred_discard"},
+	{Opt_nodeferred_discard, "nodeferred_discard"},
 	{Opt_init_itable, "init_itable=%u"},
 	{Opt_init_itable, "init_itable"},
 	{Opt_noinit_itable, "noinit_itable"},
@@ -1347,6 +1350,10 @@ static const struct mount_opts {
 	 MOPT_EXT4_ONLY | MOPT_CLEAR},
 	{Opt_discard, EXT4_MOUNT_DISCARD, MOPT_SET},
 	{Opt_nodiscard, EXT4_MOUNT_DISCARD, MOPT_CLEAR},
+	{Opt_deferred_discard, EXT4_MOUNT_DEFERRED_DISCARD,
+	 MOPT_EXT4_ONLY | MOPT_SET},
+	{Opt_nodeferred_discard, EXT4_MOUNT_DEFERRED_DISCARD,
+	 MOPT_EXT4_ONLY | MOPT_CLEAR},
 	{Opt_delalloc, EXT4_MOUNT_DELALLOC,
 	 MOPT_EXT4_ONLY | MOPT_SET | MOPT_EXPLICIT},
 	{Opt_nodelalloc, EXT4_MOUNT_DELALLOC,
@@ -2423,6 +2430,18 @@ static ssize_t lifetime_write_kbytes_show(struct ext4_attr *a,
 			  EXT4_SB(sb)->s_sectors_written_start) >> 1)));
 }
 
+static ssize_t deferred_discard_pending_kb_show(struct ext4_attr *a,
+					       struct ext4_sb_info *sbi,
+					       char *buf)
+{
+	struct super_block *sb = sbi->s_buddy_cache->i_sb;
+
+	return snprintf(buf, PAGE_SIZE, "%llu\n",
+			(unsigned long long)EXT4_C2B(sbi,
+			atomic_read(&sbi->s_discard_pending)) <<
+			(sb->s_blocksize_bits - 10));
+}
+
 static ssize_t inode_readahead_blks_store(struct ext4_attr *a,
 					  struct ext4_sb_info *sbi,
 					  const char *buf, size_t count)
@@ -2522,6 +2541,11 @@ static struct ext4_attr ext4_attr_##name = __ATTR(name, mode, show, store)
 EXT4_RO_ATTR(delayed_allocation_blocks);
 EXT4_RO_ATTR(session_write_kbytes);
 EXT4_RO_ATTR(lifetime_write_kbytes);
+EXT4_RO_ATTR(deferred_discard_pending_kb);
+EXT4_ATTR_OFFSET(deferred_discard_issued_kb, 0444, sbi_ui_show, NULL,
+		 s_discard_issued_kb);
+EXT4_ATTR_OFFSET(write_latency_avg_us, 0444, sbi_ui_show, NULL,
+		 s_write_lat_avg_us);
 EXT4_RW_ATTR(reserved_clusters);
 EXT4_ATTR_OFFSET(inode_readahead_blks, 0644, sbi_ui_show,
 		 inode_readahead_blks_store, s_inode_readahead_blks);
@@ -2534,6 +2558,9 @@ EXT4_RW_ATTR_SBI_UI(mb_stream_req, s_mb_stream_request);
 EXT4_RW_ATTR_SBI_UI(mb_group_prealloc, s_mb_group_prealloc);
 EXT4_RW_ATTR_SBI_UI(max_writeback_mb_bump, s_max_writeback_mb_bump);
 EXT4_RW_ATTR_SBI_UI(extent_max_zeroout_kb, s_extent_max_zeroout_kb);
+EXT4_RW_ATTR_SBI_UI(deferred_discard_idle_secs, s_discard_idle_secs);
+EXT4_RW_ATTR_SBI_UI(deferred_discard_min_kb, s_discard_min_kb);
+EXT4_RW_ATTR_SBI_UI(write_latency_max_us, s_write_lat_max_us);
 EXT4_ATTR(trigger_fs_error, 0200, NULL, trigger_test_error);
 
 static struct attribute *ext4_attrs[] = {
@@ -2551,6 +2578,12 @@ static struct attribute *ext4_attrs[] = {
 	ATTR_LIST(mb_group_prealloc),
 	ATTR_LIST(max_writeback_mb_bump),
 	ATTR_LIST(extent_max_zeroout_kb),
+	ATTR_LIST(deferred_discard_pending_kb),
+	ATTR_LIST(deferred_discard_issued_kb),
+	ATTR_LIST(deferred_discard_idle_secs),
+	ATTR_LIST(deferred_discard_min_kb),
+	ATTR_LIST(write_latency_avg_us),
+	ATTR_LIST(write_latency_max_us),
 	ATTR_LIST(trigger_fs_error),
 	NULL,
 };
@@ -4049,12 +4082,14 @@ no_journal:
 	} else
 		descr = "out journal";
 
-	if (test_opt(sb, DISCARD)) {
+	if (test_opt(sb, DISCARD) || test_opt(sb, DEFERRED_DISCARD)) {
 		struct request_queue *q = bdev_get_queue(sb->s_bdev);
 		if (!blk_queue_discard(q))
 			ext4_msg(sb, KERN_WARNING,
-				 "mounting with \"discard\" option, but "
-				 "the device does not support discard");
+				 "mounting with \"%s\" option, but "
+				 "the device does not support discard",
+				 test_opt(sb, DISCARD) ? "discard" :
+				 "deferred_discard");
 	}
 
 	ext4_msg(sb, KERN_INFO, "mounted filesystem with%s. "
@@ -17,6 +17,8 @@
 #include <linux/slab.h>
 #include <linux/crc32.h>
 #include <linux/magic.h>
+#include <linux/kobject.h>
+#include <linux/completion.h>
 
 /*
  * For mount options
@@ -28,6 +30,7 @@
 #define F2FS_MOUNT_XATTR_USER		0x00000010
 #define F2FS_MOUNT_POSIX_ACL		0x00000020
 #define F2FS_MOUNT_DISABLE_EXT_IDENTIFY	0x00000040
+#define F2FS_MOUNT_BG_GC_IDLE		0x00000080
 
 #define clear_opt(sbi, option)	(sbi->mount_opt.opt &= ~F2FS_MOUNT_##option)
 #define set_opt(sbi, option)	(sbi->mount_opt.opt |= F2FS_MOUNT_##option)
@@ -401,6 +404,18 @@ struct f2fs_sb_info {
 	struct mutex gc_mutex;			/* mutex for GC */
 	struct f2fs_gc_kthread	*gc_thread;	/* GC thread */
 	unsigned int cur_victim_sec;		/* current victim section num */
+	unsigned long last_fg_write;		/* jiffies, last balanced op */
+	unsigned int gc_idle_ms;		/* quiet time for idle bg gc */
+	unsigned int ipu_free_segs;		/* in-place update below this */
+
+	/* foreground gc cost, the first two under stat_lock */
+	u64 fg_gc_time;				/* ns spent in foreground gc */
+	unsigned int fg_gc_calls;		/* foreground gc calls */
+	unsigned long fg_writes;		/* balanced ops */
+
+	/* for sysfs */
+	struct kobject s_kobj;
+	struct completion s_kobj_unregister;
 
 	/*
 	 * for stat information.
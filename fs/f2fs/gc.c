@@ -17,6 +17,8 @@
 #include <linux/delay.h>
 #include <linux/freezer.h>
 #include <linux/blkdev.h>
+#include <linux/power_supply.h>
+#include <linux/suspend.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -26,6 +28,40 @@
 
 static struct kmem_cache *winode_slab;
 
+/*
+ * background_gc_idle: clean only on a charger, with no suspend on the
+ * way and no fs writes for gc_idle_ms. A power supply class that cannot
+ * tell (-ENOSYS) counts as a charger.
+ */
+static bool gc_idle_ok(struct f2fs_sb_info *sbi)
+{
+	if (sbi->gc_thread->suspending)
+		return false;
+	if (!power_supply_is_system_supplied())
+		return false;
+	return time_after(jiffies, sbi->last_fg_write +
+			  msecs_to_jiffies(sbi->gc_idle_ms));
+}
+
+static int gc_pm_notify(struct notifier_block *nb, unsigned long event,
+			void *unused)
+{
+	struct f2fs_gc_kthread *gc_th = container_of(nb,
+					struct f2fs_gc_kthread, pm_nb);
+
+	switch (event) {
+	case PM_SUSPEND_PREPARE:
+		gc_th->suspending = true;
+		break;
+	case PM_POST_SUSPEND:
+		gc_th->suspending = false;
+		/* awake on a charger: a chance to clean while idle */
+		wake_up(&gc_th->gc_wait_queue_head);
+		break;
+	}
+	return NOTIFY_DONE;
+}
+
 static int gc_thread_func(void *data)
 {
 	struct f2fs_sb_info *sbi = data;
@@ -33,6 +69,7 @@ static int gc_thread_func(void *data)
 	long wait_ms;
 
 	wait_ms = GC_THREAD_MIN_SLEEP_TIME;
+	set_freezable();
 
 	do {
 		if (try_to_freeze())
@@ -49,6 +86,11 @@ static int gc_thread_func(void *data)
 			continue;
 		}
 
+		if (test_opt(sbi, BG_GC_IDLE) && !gc_idle_ok(sbi)) {
+			wait_ms = GC_THREAD_MIN_SLEEP_TIME;
+			continue;
+		}
+
 		/*
 		 * [GC triggering condition]
 		 * 0. GC is not conducted currently.
@@ -98,9 +140,13 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
+	gc_th->suspending = false;
+	gc_th->pm_nb.notifier_call = gc_pm_notify;
+	register_pm_notifier(&gc_th->pm_nb);
 	sbi->gc_thread->f2fs_gc_task = kthread_run(gc_thread_func, sbi,
 			"f2fs_gc-%u:%u", MAJOR(dev), MINOR(dev));
 	if (IS_ERR(gc_th->f2fs_gc_task)) {
+		unregister_pm_notifier(&gc_th->pm_nb);
 		kfree(gc_th);
 		sbi->gc_thread = NULL;
 		return -ENOMEM;
@@ -113,6 +159,7 @@ void stop_gc_thread(struct f2fs_sb_info *sbi)
 	struct f2fs_gc_kthread *gc_th = sbi->gc_thread;
 	if (!gc_th)
 		return;
+	unregister_pm_notifier(&gc_th->pm_nb);
 	kthread_stop(gc_th->f2fs_gc_task);
 	kfree(gc_th);
 	sbi->gc_thread = NULL;
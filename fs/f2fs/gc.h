@@ -16,6 +16,10 @@
 #define GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define GC_THREAD_MAX_SLEEP_TIME	60000
 #define GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define GC_THREAD_IDLE_TIME		30000	/*
+						 * background_gc_idle: no fs
+						 * writes for this long is idle
+						 */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -25,6 +29,8 @@
 struct f2fs_gc_kthread {
 	struct task_struct *f2fs_gc_task;
 	wait_queue_head_t gc_wait_queue_head;
+	struct notifier_block pm_nb;
+	bool suspending;
 };
 
 struct inode_entry {
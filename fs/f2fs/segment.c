@@ -14,6 +14,7 @@
 #include <linux/blkdev.h>
 #include <linux/prefetch.h>
 #include <linux/vmalloc.h>
+#include <linux/ktime.h>
 
 #include "f2fs.h"
 #include "segment.h"
@@ -26,13 +27,27 @@
  */
 void f2fs_balance_fs(struct f2fs_sb_info *sbi)
 {
+	ktime_t start;
+	u64 ns;
+
+	/* keeps idle background gc away while the fs is in use */
+	sbi->last_fg_write = jiffies;
+	sbi->fg_writes++;		/* a statistic, not worth a lock */
+
 	/*
 	 * We should do GC or end up with checkpoint, if there are so many dirty
 	 * dir/node pages without enough free segments.
 	 */
 	if (has_not_enough_free_secs(sbi, 0)) {
 		mutex_lock(&sbi->gc_mutex);
+		start = ktime_get();
 		f2fs_gc(sbi);
+		ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+		spin_lock(&sbi->stat_lock);
+		sbi->fg_gc_time += ns;
+		sbi->fg_gc_calls++;
+		spin_unlock(&sbi->stat_lock);
 	}
 }
 
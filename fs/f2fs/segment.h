@@ -479,6 +479,10 @@ static inline int utilization(struct f2fs_sb_info *sbi)
  * data in the original place likewise other traditional file systems.
  * But, currently set 100 in percentage, which means it is disabled.
  * See below need_inplace_update().
+ *
+ * It also does so once the free segments drop below ipu_free_segs
+ * (twice the overprovision by default, tunable in sysfs), so that a
+ * nearly full partition stops creating more segments to clean.
  */
 #define MIN_IPU_UTIL		100
 static inline bool need_inplace_update(struct inode *inode)
@@ -486,6 +490,8 @@ static inline bool need_inplace_update(struct inode *inode)
 	struct f2fs_sb_info *sbi = F2FS_SB(inode->i_sb);
 	if (S_ISDIR(inode->i_mode))
 		return false;
+	if (free_segments(sbi) < sbi->ipu_free_segs)
+		return true;
 	if (need_SSR(sbi) && utilization(sbi) > MIN_IPU_UTIL)
 		return true;
 	return false;
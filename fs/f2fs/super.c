@@ -22,11 +22,14 @@
 #include <linux/exportfs.h>
 #include <linux/blkdev.h>
 #include <linux/f2fs_fs.h>
+#include <linux/sysfs.h>
+#include <asm/div64.h>
 
 #include "f2fs.h"
 #include "node.h"
 #include "segment.h"
 #include "xattr.h"
+#include "gc.h"
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/f2fs.h>
@@ -35,6 +38,7 @@ static struct kmem_cache *f2fs_inode_cachep;
 
 enum {
 	Opt_gc_background_off,
+	Opt_gc_background_idle,
 	Opt_disable_roll_forward,
 	Opt_discard,
 	Opt_noheap,
@@ -47,6 +51,7 @@ enum {
 
 static match_table_t f2fs_tokens = {
 	{Opt_gc_background_off, "background_gc_off"},
+	{Opt_gc_background_idle, "background_gc_idle"},
 	{Opt_disable_roll_forward, "disable_roll_forward"},
 	{Opt_discard, "discard"},
 	{Opt_noheap, "no_heap"},
@@ -127,6 +132,10 @@ static void f2fs_put_super(struct super_block *sb)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(sb);
 
+	kobject_del(&sbi->s_kobj);
+	kobject_put(&sbi->s_kobj);
+	wait_for_completion(&sbi->s_kobj_unregister);
+
 	f2fs_destroy_stats(sbi);
 	stop_gc_thread(sbi);
 
@@ -210,11 +219,185 @@ static int f2fs_statfs(struct dentry *dentry, struct kstatfs *buf)
 	return 0;
 }
 
+/*
+ * /sys/fs/f2fs/<dev>: the gc and in-place update tunables, and what
+ * foreground gc costs the writers.
+ */
+static struct kset *f2fs_kset;
+
+struct f2fs_attr {
+	struct attribute attr;
+	ssize_t (*show)(struct f2fs_attr *, struct f2fs_sb_info *, char *);
+	ssize_t (*store)(struct f2fs_attr *, struct f2fs_sb_info *,
+			 const char *, size_t);
+	int offset;
+};
+
+static ssize_t f2fs_sbi_show(struct f2fs_attr *a, struct f2fs_sb_info *sbi,
+			     char *buf)
+{
+	unsigned int *ui = (unsigned int *)((char *)sbi + a->offset);
+
+	return snprintf(buf, PAGE_SIZE, "%u\n", *ui);
+}
+
+static ssize_t f2fs_sbi_store(struct f2fs_attr *a, struct f2fs_sb_info *sbi,
+			      const char *buf, size_t count)
+{
+	unsigned int *ui = (unsigned int *)((char *)sbi + a->offset);
+	unsigned int t;
+	int ret;
+
+	ret = kstrtouint(skip_spaces(buf), 0, &t);
+	if (ret)
+		return ret;
+	*ui = t;
+	return count;
+}
+
+static ssize_t gc_idle_show(struct f2fs_attr *a, struct f2fs_sb_info *sbi,
+			    char *buf)
+{
+	return snprintf(buf, PAGE_SIZE, "%d\n", !!test_opt(sbi, BG_GC_IDLE));
+}
+
+static ssize_t gc_idle_store(struct f2fs_attr *a, struct f2fs_sb_info *sbi,
+			     const char *buf, size_t count)
+{
+	unsigned int t;
+	int ret;
+
+	ret = kstrtouint(skip_spaces(buf), 0, &t);
+	if (ret)
+		return ret;
+	if (t)
+		set_opt(sbi, BG_GC_IDLE);
+	else
+		clear_opt(sbi, BG_GC_IDLE);
+	return count;
+}
+
+enum {
+	FG_GC_CALLS,
+	FG_GC_TIME_US,
+	FG_WRITES,
+	FG_GC_US_PER_WRITE,
+};
+
+static ssize_t fg_gc_show(struct f2fs_attr *a, struct f2fs_sb_info *sbi,
+			  char *buf)
+{
+	unsigned long long val;
+	unsigned long writes = sbi->fg_writes;
+	unsigned int calls;
+	u64 us;
+
+	spin_lock(&sbi->stat_lock);
+	us = sbi->fg_gc_time;
+	calls = sbi->fg_gc_calls;
+	spin_unlock(&sbi->stat_lock);
+	do_div(us, NSEC_PER_USEC);
+
+	switch (a->offset) {
+	case FG_GC_CALLS:
+		val = calls;
+		break;
+	case FG_GC_TIME_US:
+		val = us;
+		break;
+	case FG_WRITES:
+		val = writes;
+		break;
+	default:
+		val = us;
+		if (writes)
+			do_div(val, writes);
+		else
+			val = 0;
+		break;
+	}
+	return snprintf(buf, PAGE_SIZE, "%llu\n", val);
+}
+
+#define F2FS_ATTR(_name, _mode, _show, _store, _offset)			\
+static struct f2fs_attr f2fs_attr_##_name = {				\
+	.attr = { .name = __stringify(_name), .mode = _mode },		\
+	.show = _show,							\
+	.store = _store,						\
+	.offset = _offset,						\
+}
+
+#define F2FS_RW_ATTR(name)						\
+	F2FS_ATTR(name, 0644, f2fs_sbi_show, f2fs_sbi_store,		\
+		  offsetof(struct f2fs_sb_info, name))
+
+#define F2FS_FG_ATTR(name, which)					\
+	F2FS_ATTR(name, 0444, fg_gc_show, NULL, which)
+
+F2FS_RW_ATTR(gc_idle_ms);
+F2FS_RW_ATTR(ipu_free_segs);
+F2FS_ATTR(gc_idle, 0644, gc_idle_show, gc_idle_store, 0);
+F2FS_FG_ATTR(fg_gc_calls, FG_GC_CALLS);
+F2FS_FG_ATTR(fg_gc_time_us, FG_GC_TIME_US);
+F2FS_FG_ATTR(fg_writes, FG_WRITES);
+F2FS_FG_ATTR(fg_gc_us_per_write, FG_GC_US_PER_WRITE);
+
+static struct attribute *f2fs_attrs[] = {
+	&f2fs_attr_gc_idle_ms.attr,
+	&f2fs_attr_ipu_free_segs.attr,
+	&f2fs_attr_gc_idle.attr,
+	&f2fs_attr_fg_gc_calls.attr,
+	&f2fs_attr_fg_gc_time_us.attr,
+	&f2fs_attr_fg_writes.attr,
+	&f2fs_attr_fg_gc_us_per_write.attr,
+	NULL,
+};
+
+static ssize_t f2fs_attr_show(struct kobject *kobj, struct attribute *attr,
+			      char *buf)
+{
+	struct f2fs_sb_info *sbi = container_of(kobj, struct f2fs_sb_info,
+						s_kobj);
+	struct f2fs_attr *a = container_of(attr, struct f2fs_attr, attr);
+
+	return a->show ? a->show(a, sbi, buf) : 0;
+}
+
+static ssize_t f2fs_attr_store(struct kobject *kobj, struct attribute *attr,
+			       const char *buf, size_t len)
+{
+	struct f2fs_sb_info *sbi = container_of(kobj, struct f2fs_sb_info,
+						s_kobj);
+	struct f2fs_attr *a = container_of(attr, struct f2fs_attr, attr);
+
+	return a->store ? a->store(a, sbi, buf, len) : -EPERM;
+}
+
+static void f2fs_sb_release(struct kobject *kobj)
+{
+	struct f2fs_sb_info *sbi = container_of(kobj, struct f2fs_sb_info,
+						s_kobj);
+	complete(&sbi->s_kobj_unregister);
+}
+
+static const struct sysfs_ops f2fs_attr_ops = {
+	.show	= f2fs_attr_show,
+	.store	= f2fs_attr_store,
+};
+
+static struct kobj_type f2fs_ktype = {
+	.default_attrs	= f2fs_attrs,
+	.sysfs_ops	= &f2fs_attr_ops,
+	.release	= f2fs_sb_release,
+};
+
 static int f2fs_show_options(struct seq_file *seq, struct dentry *root)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(root->d_sb);
 
-	if (test_opt(sbi, BG_GC))
+	if (test_opt(sbi, BG_GC_IDLE))
+		seq_puts(seq, ",background_gc_idle");
+	else if (test_opt(sbi, BG_GC))
 		seq_puts(seq, ",background_gc_on");
 	else
 		seq_puts(seq, ",background_gc_off");
@@ -328,6 +511,10 @@ static int parse_options(struct super_block *sb, struct f2fs_sb_info *sbi,
 		case Opt_gc_background_off:
 			clear_opt(sbi, BG_GC);
 			break;
+		case Opt_gc_background_idle:
+			set_opt(sbi, BG_GC);
+			set_opt(sbi, BG_GC_IDLE);
+			break;
 		case Opt_disable_roll_forward:
 			set_opt(sbi, DISABLE_ROLL_FORWARD);
 			break;
@@ -637,6 +824,10 @@ static int f2fs_fill_super(struct super_block *sb, void *data, int silent)
 
 	build_gc_manager(sbi);
 
+	sbi->last_fg_write = jiffies;
+	sbi->gc_idle_ms = GC_THREAD_IDLE_TIME;
+	sbi->ipu_free_segs = 2 * overprovision_segments(sbi);
+
 	/* get an inode for node space */
 	sbi->node_inode = f2fs_iget(sb, F2FS_NODE_INO(sbi));
 	if (IS_ERR(sbi->node_inode)) {
@@ -683,6 +874,17 @@ static int f2fs_fill_super(struct super_block *sb, void *data, int silent)
 	if (err)
 		goto fail;
 
+	sbi->s_kobj.kset = f2fs_kset;
+	init_completion(&sbi->s_kobj_unregister);
+	err = kobject_init_and_add(&sbi->s_kobj, &f2fs_ktype, NULL,
+				   "%s", sb->s_id);
+	if (err) {
+		kobject_put(&sbi->s_kobj);
+		wait_for_completion(&sbi->s_kobj_unregister);
+		f2fs_destroy_stats(sbi);
+		goto fail;
+	}
+
 	if (test_opt(sbi, DISCARD)) {
 		struct request_queue *q = bdev_get_queue(sb->s_bdev);
 		if (!blk_queue_discard(q))
@@ -765,9 +967,16 @@ static int __init init_f2fs_fs(void)
 	err = create_checkpoint_caches();
 	if (err)
 		goto fail;
+	f2fs_kset = kset_create_and_add("f2fs", NULL, fs_kobj);
+	if (!f2fs_kset) {
+		err = -ENOMEM;
+		goto fail;
+	}
 	err = register_filesystem(&f2fs_fs_type);
-	if (err)
+	if (err) {
+		kset_unregister(f2fs_kset);
 		goto fail;
+	}
 	f2fs_create_root_stats();
 fail:
 	return err;
@@ -777,6 +986,7 @@ static void __exit exit_f2fs_fs(void)
 {
 	f2fs_destroy_root_stats();
 	unregister_filesystem(&f2fs_fs_type);
+	kset_unregister(f2fs_kset);
 	destroy_checkpoint_caches();
 	destroy_gc_caches();
 	destroy_node_manager_caches();
@@ -0,0 +1,138 @@
+/*
+  FUSE: Filesystem in Userspace
+  Copyright (C) 2001-2008  Miklos Szeredi <miklos@szeredi.hu>
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+/*
+ * Passthrough of read, write and mmap to a lower file.
+ *
+ * A daemon that negotiated FUSE_PASSTHROUGH can answer OPEN or CREATE
+ * with FOPEN_PASSTHROUGH and, in passthrough_fd, a file it opened on
+ * the lower filesystem. The reply is written by the daemon, so the fd
+ * is looked up in its file table then. From there on the data of the
+ * open file goes straight to the lower file, without a request to the
+ * daemon; everything else, attributes included, still goes through it.
+ */
+
+#include "fuse_i.h"
+
+#include <linux/aio.h>
+#include <linux/file.h>
+#include <linux/fs_stack.h>
+#include <linux/fsnotify.h>
+#include <linux/uio.h>
+
+void fuse_setup_passthrough(struct fuse_conn *fc, struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	struct file *lower;
+
+	if (!fc->passthrough || req->out.h.error ||
+	    (req->in.h.opcode != FUSE_OPEN &&
+	     req->in.h.opcode != FUSE_CREATE))
+		return;
+
+	/* the open reply is the last argument of both */
+	outarg = req->out.args[req->out.numargs - 1].value;
+	if (!(outarg->open_flags & FOPEN_PASSTHROUGH) ||
+	    (outarg->open_flags & FOPEN_DIRECT_IO))
+		return;
+
+	lower = fget(outarg->passthrough_fd);
+	if (!lower)
+		return;
+	/* no chains of fuse mounts passing through to each other */
+	if (!S_ISREG(file_inode(lower)->i_mode) ||
+	    !lower->f_op || !lower->f_op->aio_read ||
+	    !lower->f_op->aio_write ||
+	    file_inode(lower)->i_sb->s_magic == FUSE_SUPER_MAGIC) {
+		fput(lower);
+		return;
+	}
+	req->passthrough_filp = lower;
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = file_inode(file);
+	size_t len = iov_length(iov, nr_segs);
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	/* the daemon may have opened the lower file with less access */
+	if (!(lower->f_mode & (rw == WRITE ? FMODE_WRITE : FMODE_READ)))
+		return -EBADF;
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = len;
+	kiocb.ki_nbytes = len;
+
+	if (rw == WRITE) {
+		file_start_write(lower);
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	} else {
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	}
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	if (rw == WRITE)
+		file_end_write(lower);
+	iocb->ki_pos = kiocb.ki_pos;
+
+	if (ret <= 0)
+		return ret;
+	if (rw == WRITE) {
+		fsnotify_modify(lower);
+		fsstack_copy_inode_size(inode, file_inode(lower));
+		/* pages cached by other opens of the file are stale now */
+		invalidate_mapping_pages(inode->i_mapping,
+					 pos >> PAGE_CACHE_SHIFT,
+					 (pos + ret - 1) >> PAGE_CACHE_SHIFT);
+		fuse_invalidate_attr(inode);
+	} else {
+		fsnotify_access(lower);
+	}
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb,
+				   const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+}
+
+/* The mapping is the lower file's, the vma takes a reference to it */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = get_file(lower);
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+	return ret;
+}
@@ -1230,20 +1230,28 @@ cont:
 		if (!page)
 			continue;
 
+		/* leave the pages other processes still use, shared libs */
+		if (page_mapcount(page) != 1)
+			continue;
+
 		if (isolate_lru_page(page))
 			continue;
 
 		list_add(&page->lru, &page_list);
 		inc_zone_page_state(page, NR_ISOLATED_ANON +
 				page_is_file_cache(page));
-		isolated++;
-		if (isolated >= SWAP_CLUSTER_MAX)
+		if (++isolated >= SWAP_CLUSTER_MAX) {
+			pte++;
+			addr += PAGE_SIZE;
 			break;
+		}
 	}
 	pte_unmap_unlock(pte - 1, ptl);
 	reclaim_pages_from_list(&page_list);
-	if (addr != end)
+	if (addr != end) {
+		cond_resched();
 		goto cont;
+	}
 
 	cond_resched();
 	return 0;
@@ -1253,18 +1261,22 @@ enum reclaim_type {
 	RECLAIM_FILE,
 	RECLAIM_ANON,
 	RECLAIM_ALL,
-	RECLAIM_RANGE,
 };
 
+/*
+ * "<file|anon|all> [<start> <size>]", the range limits the reclaim to the
+ * pages of the process from start, both in bytes.
+ */
 static ssize_t reclaim_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *ppos)
 {
 	struct task_struct *task;
-	char buffer[PROC_NUMBUF];
+	char buffer[64];
 	struct mm_struct *mm;
 	struct vm_area_struct *vma;
 	enum reclaim_type type;
-	char *type_buf;
+	char *type_buf, *range_buf;
+	unsigned long start = 0, end = TASK_SIZE, size;
 
 	memset(buffer, 0, sizeof(buffer));
 	if (count > sizeof(buffer) - 1)
@@ -1273,7 +1285,17 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 	if (copy_from_user(buffer, buf, count))
 		return -EFAULT;
 
-	type_buf = strstrip(buffer);
+	range_buf = strstrip(buffer);
+	type_buf = strsep(&range_buf, " ");
+	if (range_buf) {
+		if (sscanf(range_buf, "%lx %lu", &start, &size) != 2 ||
+		    !size || start >= TASK_SIZE)
+			return -EINVAL;
+		start &= PAGE_MASK;
+		end = size > TASK_SIZE - start ? TASK_SIZE :
+			PAGE_ALIGN(start + size);
+	}
+
 	if (!strcmp(type_buf, "file"))
 		type = RECLAIM_FILE;
 	else if (!strcmp(type_buf, "anon"))
@@ -1295,7 +1317,8 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 		};
 
 		down_read(&mm->mmap_sem);
-		for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		for (vma = find_vma(mm, start); vma && vma->vm_start < end;
+		     vma = vma->vm_next) {
 			reclaim_walk.private = vma;
 
 			if (is_vm_hugetlb_page(vma))
@@ -1306,8 +1329,12 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 			if (type == RECLAIM_FILE && !vma->vm_file)
 				continue;
 
-			walk_page_range(vma->vm_start, vma->vm_end,
-					&reclaim_walk);
+			walk_page_range(max(vma->vm_start, start),
+					min(vma->vm_end, end), &reclaim_walk);
+			/* the caller gave up, or the process is being killed */
+			if (fatal_signal_pending(current) ||
+			    fatal_signal_pending(task))
+				break;
 		}
 		flush_tlb_mm(mm);
 		up_read(&mm->mmap_sem);
@@ -33,6 +33,10 @@
 #include <linux/platform_device.h>
 #include <linux/slab.h>
 #include <linux/compiler.h>
+#include <linux/crc32.h>
+#include <linux/lz4.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
 #include <linux/pstore_ram.h>
 
 #define RAMOOPS_KERNMSG_HDR "===="
@@ -96,8 +100,19 @@ struct ramoops_context {
 	unsigned int console_read_cnt;
 	unsigned int ftrace_read_cnt;
 	struct pstore_info pstore;
+#ifdef CONFIG_PSTORE_RAM_CONSOLE_LZ4
+	struct persistent_ram_zone *czprz;
+	struct delayed_work lz4_work;
+	struct mutex lz4_mutex;
+	size_t lz4_flushed;
+	unsigned char *lz4_raw;
+	unsigned char *lz4_comp;
+	void *lz4_wrkmem;
+#endif
 };
 
+static bool ramoops_lz4_erase(struct ramoops_context *cxt);
+
 static struct platform_device *dummy;
 static struct ramoops_platform_data *dummy_data;
 
@@ -270,6 +285,8 @@ static int ramoops_pstore_erase(enum pstore_type_id type, u64 id, int count,
 		prz = cxt->przs[id];
 		break;
 	case PSTORE_TYPE_CONSOLE:
+		if (ramoops_lz4_erase(cxt))
+			return 0;
 		prz = cxt->cprz;
 		break;
 	case PSTORE_TYPE_FTRACE:
@@ -384,6 +401,228 @@ static int ramoops_init_prz(struct device *dev, struct ramoops_context *cxt,
 	return 0;
 }
 
+#ifdef CONFIG_PSTORE_RAM_CONSOLE_LZ4
+
+/*
+ * Compressed console
+ *
+ * The console zone is split in a plain ring that the console writes go
+ * to, a quarter of it, and a ring of lz4 compressed blocks of the plain
+ * ring in the rest.  Every RAMOOPS_LZ4_PERIOD a deferrable work takes
+ * each RAMOOPS_LZ4_BLOCK written to the plain ring since the last one
+ * and appends it compressed as a record, which ends with the plain ring
+ * offset after it.  On the next boot the console log is the records
+ * still whole, in order, followed by what the plain ring has after the
+ * last one.  Console output faster than a plain ring per period wraps
+ * it before it is compressed, and is lost from the records.
+ */
+#define RAMOOPS_LZ4_BLOCK	4096
+#define RAMOOPS_LZ4_PERIOD	HZ
+#define RAMOOPS_LZ4_MAGIC	0x42345a4c	/* LZ4B */
+
+struct ramoops_lz4_hdr {
+	u32 magic;
+	u16 comp_len;
+	u16 raw_len;
+	u32 end;	/* plain ring offset after the block */
+	u32 crc;	/* of the compressed data */
+};
+
+static void ramoops_lz4_work(struct work_struct *work)
+{
+	struct ramoops_context *cxt = container_of(to_delayed_work(work),
+					struct ramoops_context, lz4_work);
+	struct persistent_ram_zone *prz = cxt->cprz;
+	struct ramoops_lz4_hdr *hdr = (struct ramoops_lz4_hdr *)cxt->lz4_comp;
+	size_t pos, len;
+
+	mutex_lock(&cxt->lz4_mutex);
+	pos = persistent_ram_pos(prz);
+	while ((pos + prz->buffer_size - cxt->lz4_flushed) %
+	       prz->buffer_size >= RAMOOPS_LZ4_BLOCK) {
+		persistent_ram_copy(prz, cxt->lz4_raw, cxt->lz4_flushed,
+				    RAMOOPS_LZ4_BLOCK);
+		if (lz4_compress(cxt->lz4_raw, RAMOOPS_LZ4_BLOCK,
+				 (unsigned char *)(hdr + 1), &len,
+				 cxt->lz4_wrkmem))
+			break;
+		cxt->lz4_flushed = (cxt->lz4_flushed + RAMOOPS_LZ4_BLOCK) %
+				   prz->buffer_size;
+
+		hdr->magic = RAMOOPS_LZ4_MAGIC;
+		hdr->comp_len = len;
+		hdr->raw_len = RAMOOPS_LZ4_BLOCK;
+		hdr->end = cxt->lz4_flushed;
+		hdr->crc = crc32(0, (unsigned char *)(hdr + 1), len);
+		persistent_ram_write(cxt->czprz, hdr, sizeof(*hdr) + len);
+	}
+	mutex_unlock(&cxt->lz4_mutex);
+
+	schedule_delayed_work(&cxt->lz4_work, RAMOOPS_LZ4_PERIOD);
+}
+
+/*
+ * Decompress the whole records of an old compressed ring into out, or
+ * only count their bytes when out is NULL.  The ring may have wrapped
+ * in the middle of a record, so the start of each one is searched for.
+ */
+static size_t ramoops_lz4_parse(const char *log, size_t n, char *out,
+				size_t *end)
+{
+	struct ramoops_lz4_hdr hdr;
+	size_t i = 0, total = 0, raw_len;
+	const unsigned char *data;
+
+	while (i + sizeof(hdr) <= n) {
+		memcpy(&hdr, log + i, sizeof(hdr));
+		data = (const unsigned char *)log + i + sizeof(hdr);
+		if (hdr.magic != RAMOOPS_LZ4_MAGIC ||
+		    hdr.raw_len > RAMOOPS_LZ4_BLOCK ||
+		    hdr.comp_len > n - i - sizeof(hdr) ||
+		    crc32(0, data, hdr.comp_len) != hdr.crc) {
+			i++;
+			continue;
+		}
+
+		raw_len = hdr.raw_len;
+		if (out && (lz4_decompress_unknownoutputsize(data,
+				hdr.comp_len, (unsigned char *)out + total,
+				&raw_len) ||
+			    raw_len != hdr.raw_len)) {
+			i++;
+			continue;
+		}
+		total += hdr.raw_len;
+		*end = hdr.end;
+		i += sizeof(hdr) + hdr.comp_len;
+	}
+
+	return total;
+}
+
+/* put the log of the last boot together as the console old log */
+static void ramoops_lz4_recover(struct ramoops_context *cxt)
+{
+	struct persistent_ram_zone *prz = cxt->cprz;
+	struct persistent_ram_zone *zprz = cxt->czprz;
+	size_t size, tail, end = 0;
+	char *log;
+
+	if (!persistent_ram_old_size(zprz))
+		return;
+
+	size = ramoops_lz4_parse(zprz->old_log, zprz->old_log_size, NULL,
+				 &end);
+	if (!size)
+		goto out;
+
+	/* what the plain ring got after the last record */
+	tail = (prz->old_log_start + prz->buffer_size - end) %
+	       prz->buffer_size;
+	tail = min(tail, prz->old_log_size);
+
+	log = kmalloc(size + tail, GFP_KERNEL);
+	if (!log) {
+		pr_err("cannot allocate compressed console log\n");
+		goto out;
+	}
+	size = ramoops_lz4_parse(zprz->old_log, zprz->old_log_size, log,
+				 &end);
+	if (tail)
+		memcpy(log + size, prz->old_log + prz->old_log_size - tail,
+		       tail);
+
+	kfree(prz->old_log);
+	prz->old_log = log;
+	prz->old_log_size = size + tail;
+out:
+	persistent_ram_free_old(zprz);
+}
+
+/* the plain ring, all of the console zone when too small to split */
+static size_t ramoops_lz4_staging(struct ramoops_context *cxt)
+{
+	size_t staging = cxt->console_size / 4;
+
+	return staging < 2 * RAMOOPS_LZ4_BLOCK ? cxt->console_size : staging;
+}
+
+static void ramoops_lz4_init(struct device *dev, struct ramoops_context *cxt,
+			     phys_addr_t *paddr)
+{
+	size_t sz = cxt->console_size - ramoops_lz4_staging(cxt);
+	phys_addr_t addr = *paddr;
+
+	if (!sz)
+		return;
+	/* the ftrace zone stays where it is without compression */
+	*paddr += sz;
+	if (!cxt->cprz)
+		return;
+
+	if (ramoops_init_prz(dev, cxt, &cxt->czprz, &addr, sz,
+			     RAMOOPS_LZ4_MAGIC)) {
+		cxt->czprz = NULL;
+		return;
+	}
+
+	cxt->lz4_raw = kmalloc(RAMOOPS_LZ4_BLOCK, GFP_KERNEL);
+	cxt->lz4_comp = kmalloc(sizeof(struct ramoops_lz4_hdr) +
+				lz4_compressbound(RAMOOPS_LZ4_BLOCK),
+				GFP_KERNEL);
+	cxt->lz4_wrkmem = kmalloc(LZ4_MEM_COMPRESS, GFP_KERNEL);
+	if (!cxt->lz4_raw || !cxt->lz4_comp || !cxt->lz4_wrkmem) {
+		pr_err("cannot allocate console compression buffers\n");
+		kfree(cxt->lz4_raw);
+		kfree(cxt->lz4_comp);
+		kfree(cxt->lz4_wrkmem);
+		persistent_ram_free(cxt->czprz);
+		cxt->czprz = NULL;
+		return;
+	}
+
+	ramoops_lz4_recover(cxt);
+
+	mutex_init(&cxt->lz4_mutex);
+	INIT_DEFERRABLE_WORK(&cxt->lz4_work, ramoops_lz4_work);
+	schedule_delayed_work(&cxt->lz4_work, RAMOOPS_LZ4_PERIOD);
+}
+
+static bool ramoops_lz4_erase(struct ramoops_context *cxt)
+{
+	if (!cxt->czprz)
+		return false;
+
+	mutex_lock(&cxt->lz4_mutex);
+	persistent_ram_free_old(cxt->cprz);
+	persistent_ram_zap(cxt->cprz);
+	persistent_ram_zap(cxt->czprz);
+	cxt->lz4_flushed = 0;
+	mutex_unlock(&cxt->lz4_mutex);
+
+	return true;
+}
+
+#else
+
+static inline size_t ramoops_lz4_staging(struct ramoops_context *cxt)
+{
+	return cxt->console_size;
+}
+
+static inline void ramoops_lz4_init(struct device *dev,
+				    struct ramoops_context *cxt,
+				    phys_addr_t *paddr)
+{
+}
+
+static inline bool ramoops_lz4_erase(struct ramoops_context *cxt)
+{
+	return false;
+}
+
+#endif
+
 void notrace ramoops_console_write_buf(const char *buf, size_t size)
 {
 	struct ramoops_context *cxt = &oops_cxt;
@@ -439,9 +678,10 @@ static int ramoops_probe(struct platform_device *pdev)
 		goto fail_out;
 
 	err = ramoops_init_prz(dev, cxt, &cxt->cprz, &paddr,
-			       cxt->console_size, 0);
+			       ramoops_lz4_staging(cxt), 0);
 	if (err)
 		goto fail_init_cprz;
+	ramoops_lz4_init(dev, cxt, &paddr);
 
 	err = ramoops_init_prz(dev, cxt, &cxt->fprz, &paddr, cxt->ftrace_size,
 			       LINUX_VERSION_CODE);
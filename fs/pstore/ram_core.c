@@ -275,6 +275,7 @@ void persistent_ram_save_old(struct persistent_ram_zone *prz)
 	}
 
 	prz->old_log_size = size;
+	prz->old_log_start = start;
 	memcpy(prz->old_log, &buffer->data[start], size - start);
 	memcpy(prz->old_log + size - start, &buffer->data[0], start);
 }
@@ -309,6 +310,28 @@ int notrace persistent_ram_write(struct persistent_ram_zone *prz,
 	return count;
 }
 
+/* where the next write goes */
+size_t persistent_ram_pos(struct persistent_ram_zone *prz)
+{
+	return buffer_start(prz);
+}
+
+/* copy count bytes of the ring from pos on, wrapping at its end */
+void persistent_ram_copy(struct persistent_ram_zone *prz, void *dst,
+	size_t pos, size_t count)
+{
+	struct persistent_ram_buffer *buffer = prz->buffer;
+	size_t rem = prz->buffer_size - pos;
+
+	if (rem < count) {
+		memcpy(dst, &buffer->data[pos], rem);
+		dst += rem;
+		count -= rem;
+		pos = 0;
+	}
+	memcpy(dst, &buffer->data[pos], count);
+}
+
 size_t persistent_ram_old_size(struct persistent_ram_zone *prz)
 {
 	return prz->old_log_size;
@@ -324,6 +347,7 @@ void persistent_ram_free_old(struct persistent_ram_zone *prz)
 	kfree(prz->old_log);
 	prz->old_log = NULL;
 	prz->old_log_size = 0;
+	prz->old_log_start = 0;
 }
 
 void persistent_ram_zap(struct persistent_ram_zone *prz)
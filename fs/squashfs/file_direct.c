@@ -0,0 +1,119 @@
+/*
+ * Squashfs - a compressed read only filesystem for Linux
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2,
+ * or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * file_direct.c
+ */
+
+/*
+ * This file decompresses datablocks straight into the page cache
+ * pages they cover, instead of into the read_page cache and copying.
+ * That needs every page of the block: when one of them is already
+ * uptodate or cannot be grabbed without waiting, the caller falls back
+ * to the cache.  The pages are mapped together with vm_map_ram, so
+ * the decompressors see them as consecutive buffers.
+ */
+
+#include <linux/fs.h>
+#include <linux/vfs.h>
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/pagemap.h>
+#include <linux/vmalloc.h>
+#include <asm/cacheflush.h>
+
+#include "squashfs_fs.h"
+#include "squashfs_fs_sb.h"
+#include "squashfs_fs_i.h"
+#include "squashfs.h"
+
+/*
+ * Read the datablock holding target_page.  Returns 0 when the pages
+ * were filled and target_page is unlocked, 1 when nothing was done and
+ * the datablock has to be read through the cache, or a negative error
+ * with target_page still locked.
+ */
+int squashfs_readpage_block(struct page *target_page, u64 block, int bsize)
+{
+	struct inode *inode = target_page->mapping->host;
+	struct squashfs_sb_info *msblk = inode->i_sb->s_fs_info;
+	int file_end = (i_size_read(inode) - 1) >> PAGE_CACHE_SHIFT;
+	int mask = (1 << (msblk->block_log - PAGE_CACHE_SHIFT)) - 1;
+	int start_index = target_page->index & ~mask;
+	int end_index = min(start_index | mask, file_end);
+	int pages = end_index - start_index + 1;
+	int i, n, res = 1;
+	struct page **page;
+	void **buffer;
+	void *addr = NULL;
+
+	page = kmalloc(pages * (sizeof(*page) + sizeof(*buffer)), GFP_KERNEL);
+	if (page == NULL)
+		return 1;
+	buffer = (void **) (page + pages);
+
+	for (i = 0, n = start_index; i < pages; i++, n++) {
+		page[i] = (n == target_page->index) ? target_page :
+			grab_cache_page_nowait(target_page->mapping, n);
+		if (page[i] == NULL)
+			goto release;
+		if (page[i] != target_page && PageUptodate(page[i])) {
+			unlock_page(page[i]);
+			page_cache_release(page[i]);
+			page[i] = NULL;
+			goto release;
+		}
+	}
+
+	addr = vm_map_ram(page, pages, -1, PAGE_KERNEL);
+	if (addr == NULL)
+		goto release;
+	for (i = 0; i < pages; i++)
+		buffer[i] = addr + (i << PAGE_CACHE_SHIFT);
+
+	res = squashfs_read_data(inode->i_sb, buffer, block, bsize, NULL,
+		pages << PAGE_CACHE_SHIFT, pages);
+	if (res < 0) {
+		ERROR("Unable to read page, block %llx, size %x\n", block,
+			bsize);
+		goto release;
+	}
+
+	/* the last block of the file ends inside its last page */
+	memset(addr + res, 0, (pages << PAGE_CACHE_SHIFT) - res);
+	flush_kernel_vmap_range(addr, pages << PAGE_CACHE_SHIFT);
+	res = 0;
+
+release:
+	if (addr)
+		vm_unmap_ram(addr, pages);
+	for (n = i, i = 0; i < n; i++) {
+		if (res == 0) {
+			flush_dcache_page(page[i]);
+			SetPageUptodate(page[i]);
+		}
+		if (page[i] == target_page) {
+			if (res == 0)
+				unlock_page(page[i]);
+			continue;
+		}
+		unlock_page(page[i]);
+		page_cache_release(page[i]);
+	}
+	kfree(page);
+	return res;
+}
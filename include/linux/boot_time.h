@@ -0,0 +1,47 @@
+/*
+ * include/linux/boot_time.h
+ *
+ * Initcall and driver probe times of the boot, listed in debugfs
+ * boot_time.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _LINUX_BOOT_TIME_H
+#define _LINUX_BOOT_TIME_H
+
+#include <linux/init.h>
+#include <linux/ktime.h>
+
+struct device;
+struct device_driver;
+
+#ifdef CONFIG_BOOT_TIME_REPORT
+/* false once the records are full, so callers can skip the timing */
+bool boot_time_recording(void);
+void boot_time_initcall(initcall_t fn, int ret, ktime_t start, ktime_t end);
+void boot_time_probe(struct device *dev, struct device_driver *drv, int ret,
+		     ktime_t start, ktime_t end);
+void boot_time_mark(const char *what);
+#else
+static inline bool boot_time_recording(void)
+{
+	return false;
+}
+static inline void boot_time_initcall(initcall_t fn, int ret,
+				      ktime_t start, ktime_t end)
+{
+}
+static inline void boot_time_probe(struct device *dev,
+				   struct device_driver *drv, int ret,
+				   ktime_t start, ktime_t end)
+{
+}
+static inline void boot_time_mark(const char *what)
+{
+}
+#endif
+
+#endif
@@ -25,4 +25,32 @@ struct bcm_bt_lpm_platform_data {
 	int host_wake_gpio;
 };
 
+/*
+ * Active Bluetooth profiles, set by the stack with TIO_SET_BT_PROFILE.
+ * Changes are passed to the profile notifier chain with the new mask
+ * as the event; the Wi-Fi driver uses them for its coex settings.
+ */
+#define BCM_BT_PROFILE_A2DP	(1 << 0)	/* audio streaming */
+#define BCM_BT_PROFILE_SCO	(1 << 1)	/* voice, SCO or eSCO */
+#define BCM_BT_PROFILE_HID	(1 << 2)	/* keyboards, remotes */
+#define BCM_BT_PROFILE_BULK	(1 << 3)	/* OPP, FTP, PAN transfers */
+
+struct notifier_block;
+
+#ifdef CONFIG_BCM_BT_LPM
+extern int bcm_bt_lpm_register_profile_notifier(struct notifier_block *nb);
+extern int bcm_bt_lpm_unregister_profile_notifier(struct notifier_block *nb);
+extern unsigned int bcm_bt_lpm_get_profiles(void);
+extern unsigned long bcm_bt_lpm_get_audio_glitches(void);
+#else
+#include <linux/errno.h>
+
+static inline int bcm_bt_lpm_register_profile_notifier(
+	struct notifier_block *nb) { return -ENODEV; }
+static inline int bcm_bt_lpm_unregister_profile_notifier(
+	struct notifier_block *nb) { return 0; }
+static inline unsigned int bcm_bt_lpm_get_profiles(void) { return 0; }
+static inline unsigned long bcm_bt_lpm_get_audio_glitches(void) { return 0; }
+#endif
+
 #endif /* BCM_BT_LPM_SETTINGS_H */
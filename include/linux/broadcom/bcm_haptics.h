@@ -19,6 +19,7 @@ struct bcm_haptics_data
 {
 	const char *halaudio_port_name;
 	const char *ept_port_name;
+	const char *effects_fw_name;	/* effect library, NULL for default */
 };
 
 #define BCM_HAPTICS_DRIVER_NAME    "bcm_haptics"
@@ -35,6 +35,19 @@ extern struct ion_device *idev;
 extern unsigned int bcm_ion_map_dma(struct ion_client *client,
 		struct ion_handle *handle);
 
+struct dma_buf;
+extern int bcm_ion_map_dma_dev(struct device *dev, struct dma_buf *dmabuf,
+		dma_addr_t *dma_addr);
+extern void bcm_ion_unmap_dma_dev(struct device *dev, struct dma_buf *dmabuf);
+
+#ifdef CONFIG_ION_CMA_PREFETCH
+extern void ion_cma_prefetch(void);
+extern unsigned long ion_cma_prefetch_pages(void);
+#else
+static inline void ion_cma_prefetch(void) { }
+static inline unsigned long ion_cma_prefetch_pages(void) { return 0; }
+#endif
+
 /**
  * struct bcm_ion_heap_reserve_data - defines the set of parameters used by
  * platform file to search for carveout or cma nodes in DT file.
@@ -216,6 +229,37 @@ struct ion_custom_region_data {
 	unsigned int len;
 };
 
+/* Cache operations for struct ion_custom_cache_op, may be or'ed */
+#define ION_CACHE_OP_CLEAN		(1 << 0)
+#define ION_CACHE_OP_INVALIDATE		(1 << 1)
+
+/* Maximum number of regions in one ION_IOC_CUSTOM_CACHE_OPS call */
+#define ION_CACHE_OPS_MAX		(64)
+
+/**
+ * struct ion_custom_cache_op - one region of a batched cache operation
+ * @handle:	a handle
+ * @offset: offset from start of buffer
+ * @len: size in bytes to be maintained
+ * @op: ION_CACHE_OP_* bitmask, clean is done before invalidate
+ */
+struct ion_custom_cache_op {
+	struct ion_handle *handle;
+	unsigned int offset;
+	unsigned int len;
+	unsigned int op;
+};
+
+/**
+ * struct ion_custom_cache_ops - array of regions passed to the kernel
+ * @ops:	pointer to an array of struct ion_custom_cache_op
+ * @count:	number of entries in @ops, at most ION_CACHE_OPS_MAX
+ */
+struct ion_custom_cache_ops {
+	struct ion_custom_cache_op *ops;
+	unsigned int count;
+};
+
 /**
  * struct ion_custom_config_data - metadata to be filled by kernel and
  *	passed to userspace for getting interface version and heap
@@ -367,6 +411,18 @@ struct ion_custom_mt_get_mem {
  */
 #define ION_IOC_CUSTOM_MT_GET_MEM	(10)
 
+/**
+ * DOC: ION_IOC_CUSTOM_CACHE_OPS - Arm Cache clean/invalidate several regions
+ *
+ * Takes an ion_custom_cache_ops struct pointing to an array of regions, each
+ * with a valid opaque handle and the operation to be done. All handles are
+ * validated before any maintenance is done. Regions of uncached buffers and
+ * cleans of buffers never mapped by the cpu are skipped. If the remaining
+ * size crosses the cache_all_threshold module parameter the whole cache is
+ * flushed once instead of walking each region.
+ */
+#define ION_IOC_CUSTOM_CACHE_OPS	(11)
+
 /**
  * DOC: ION_IOC_CUSTOM_TP - Do a kernel print - to trace the code
  *
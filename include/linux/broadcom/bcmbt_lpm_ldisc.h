@@ -47,5 +47,13 @@ struct bcmbt_lpm_ldisc_data {
 #ifndef TIO_GET_BT_WAKE_STATE
 #define TIO_GET_BT_WAKE_STATE   0x8005
 #endif
+/* arg is the BCM_BT_PROFILE_* mask of the active profiles */
+#ifndef TIO_SET_BT_PROFILE
+#define TIO_SET_BT_PROFILE      0x8006
+#endif
+/* the stack saw an audio underrun or a dropped SCO frame */
+#ifndef TIO_BT_AUDIO_GLITCH
+#define TIO_BT_AUDIO_GLITCH     0x8007
+#endif
 
 #endif
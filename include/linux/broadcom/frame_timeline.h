@@ -0,0 +1,75 @@
+/*
+ * include/linux/broadcom/frame_timeline.h
+ *
+ * Per-frame timestamps through the Kona display pipeline: the last V3D
+ * job done before the frame, kona_fb pan display, axipv post and the
+ * vsync the frame was first shown on. Finished frames are kept in a
+ * ring that /dev/frame_timeline reads and maps.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _FRAME_TIMELINE_H_
+#define _FRAME_TIMELINE_H_
+
+#include <linux/types.h>
+#include <linux/ioctl.h>
+
+#define FRAME_TL_RECORDS	256	/* power of 2 */
+
+enum frame_tl_stage {
+	FRAME_TL_V3D_DONE = 0,
+	FRAME_TL_PAN,
+	FRAME_TL_POST,
+	FRAME_TL_VSYNC,
+};
+
+/* one finished frame, times in ns of the monotonic clock */
+struct frame_tl_rec {
+	__u32 seq;
+	__u32 missed;		/* vsyncs passed between post and display */
+	__u64 v3d_ns;		/* 0 if no V3D job since the last frame */
+	__u64 pan_ns;
+	__u64 post_ns;		/* 0 if never posted */
+	__u64 vsync_ns;		/* 0 if dropped before display */
+};
+
+/*
+ * Start of the mmap of /dev/frame_timeline, followed by the ring of
+ * FRAME_TL_RECORDS records. Record n is at rec[n % FRAME_TL_RECORDS];
+ * head is the number of records written so far.
+ */
+struct frame_tl_hdr {
+	__u32 head;
+	__u32 records;
+	__u32 vsync_period_ns;
+	__u32 frames;
+	__u32 janky;		/* frames with missed vsyncs */
+	__u32 missed;		/* vsyncs missed in total */
+	__u32 dropped;
+	__u32 reserved;
+};
+
+#define FRAME_TL_IOC_RESET	_IO('F', 0x70)
+
+#ifdef __KERNEL__
+#ifdef CONFIG_KONA_FRAME_TIMELINE
+struct notifier_block;
+
+void frame_tl_stamp(enum frame_tl_stage stage);
+/* called with the missed vsyncs and the record of a janky frame */
+int frame_tl_register_jank_notifier(struct notifier_block *nb);
+int frame_tl_unregister_jank_notifier(struct notifier_block *nb);
+/* for kernel users, -EAGAIN when there is no record at *pos yet */
+int frame_tl_get_hdr(struct frame_tl_hdr *h);
+int frame_tl_get_rec(u32 *pos, struct frame_tl_rec *rec);
+#else
+static inline void frame_tl_stamp(enum frame_tl_stage stage)
+{
+}
+#endif
+#endif
+
+#endif
@@ -34,6 +34,21 @@ extern "C" {
 #define IOW_GPS_PASSTHROUGH_MODE_OFF  _IO(GPS_DRIVER_MAGIC, 5)
 #define IOR_GET_SERIAL_PORT_INFO      _IOR(GPS_DRIVER_MAGIC, 19 , unsigned long)
 
+	/*
+	 * Reader wakeups of /dev/gps_irq: once wake_bytes are buffered, or
+	 * the oldest data waited wake_ms (0 for no limit). With batch set
+	 * the AP may suspend with data still buffered. All 0 on open, which
+	 * wakes the reader for every chunk.
+	 */
+	struct gps_irq_batch {
+		__u32 wake_bytes;
+		__u32 wake_ms;
+		__u32 batch;
+	};
+
+#define IOW_GPS_IRQ_SET_BATCH  _IOW(GPS_DRIVER_MAGIC, 20, struct gps_irq_batch)
+#define IOR_GPS_IRQ_GET_BATCH  _IOR(GPS_DRIVER_MAGIC, 21, struct gps_irq_batch)
+
 	struct gps_platform_data {
 		struct i2c_slave_platform_data i2c_pdata;
 		int gpio_reset;
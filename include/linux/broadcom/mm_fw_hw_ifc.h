@@ -146,6 +146,13 @@ struct mm_core_hw_ifc {
 	int (*mm_abort)(void *device_id, mm_job_post_t *job);
 	int (*mm_get_regs)(void *device_id, MM_REG_VALUE *ptr, int max);
 	int (*mm_get_prof)(void *device_id, unsigned int *ptr);
+	/* Optional. Stage the job queued behind the running one; return 0
+	 * if it was accepted. The driver may then launch it from its
+	 * completion IRQ, once it has latched the results of the running
+	 * job, and must set job->status to MM_JOB_STATUS_RUNNING when it
+	 * does. Called with NULL to drop the staged job, serialised
+	 * against the driver's IRQ. */
+	int (*mm_prepare_job)(void *device_id, mm_job_post_t *job);
 #if defined(CONFIG_MM_SECURE_DRIVER)
 	int (*mm_secure_job_wait)(void *device_id,
 			mm_secure_job_ptr p_secure_job);
@@ -164,6 +171,50 @@ void *mm_fmwk_register(const char *name, const char *clk_name,
 
 void mm_fmwk_unregister(void *handle);
 
+/* In-kernel posting on an MM device file opened by user space, so that
+ * another driver (e.g. unicam at frame end) can feed a device without a
+ * round trip through user space. mm_fmwk_fget() takes a reference on
+ * the file of fd, or returns NULL if it is not an MM device file; drop
+ * it with fput() once the jobs posted on it are done (vfs_fsync() waits
+ * for them). done, if set, is called from the framework's work queue
+ * when the job completes or is aborted; it must not sleep and must not
+ * post jobs directly. mm_fmwk_open() opens /dev/<name> for a kernel
+ * client that has no fd, drop it with filp_close(). */
+typedef void (*mm_fmwk_job_done_t)(void *priv, mm_job_status_e status);
+
+struct file *mm_fmwk_fget(unsigned int fd);
+struct file *mm_fmwk_open(const char *name);
+int mm_fmwk_post_job(struct file *filp, mm_job_type_e type, uint32_t id,
+			const void *data, size_t size,
+			mm_fmwk_job_done_t done, void *priv);
+int mm_fmwk_post_interlock(struct file *filp, struct file *input);
+
+/* Statistics of each registered core, for profilers such as gator.
+ * busy_us is the run time of the completed jobs, clk_on_us the time the
+ * core was powered and cache_us the time spent cleaning the CPU caches
+ * for its jobs; they and jobs_done wrap, users take differences.
+ * Returns the number of cores filled in; safe from any context. */
+typedef struct {
+	const char *name;	/* "device:core" */
+	u32 queued;		/* jobs on the core, running included */
+	u32 busy_us;
+	u32 jobs_done;
+	u32 clk_on_us;
+	u32 cache_us;
+} mm_fmwk_core_stats_t;
+
+int mm_fmwk_core_stats(mm_fmwk_core_stats_t *stats, int max);
+
+/* V3D performance counters over the bin/render jobs. events[] are the
+ * PCTRS source numbers of the counters, programmed at the start of each
+ * job and accumulated into 64-bit totals when it completes. Changing
+ * the events restarts the totals. */
+#define V3D_PERF_COUNTERS 16
+
+int v3d_perf_start(const u32 *events, int n);
+void v3d_perf_stop(void);
+int v3d_perf_read(u64 *totals, int n);
+
 
 static inline void mm_write_reg(void *base_addr, u32 reg, u32 value)
 {
@@ -19,6 +19,12 @@ the GPL, without Broadcom's express prior written consent.
 enum {
 	MM_CLEAN_JOB = 0x00000000,
 	MM_DIRTY_JOB = 0x00000100,
+	/* Or-ed into the type: the job goes to its core only once the job
+	 * written before it on the same file has completed. Jobs without
+	 * it are handed to their core right away, so with one file per
+	 * stream the CABAC job of slice N+1 can run while the VCE job of
+	 * slice N, ordered after the CABAC job of slice N, waits. */
+	MM_ORDERED_JOB = 0x00000200,
 
 	INTERLOCK_INVALID_JOB = 0x64000000,
 	INTERLOCK_WAITING_JOB,
@@ -27,6 +33,7 @@ enum {
 
 	ISP_INVALID_JOB = 0x65000000,
 	ISP_CSC_JOB,
+	ISP_MULTI_JOB,
 	ISP_LAST_JOB,
 
 	V3D_INVALID_JOB = 0x66000000,
@@ -42,6 +49,7 @@ enum {
 	H264_SECURE_JOB_OFFSET = 0x00080000,
 	H264_CME_INVALID_JOB = H264_JOB_BASE,
 	H264_CME_EST_JOB,
+	H264_CME_MULTI_EST_JOB,
 	H264_CME_LAST_JOB,
 
 	H264_MCIN_INVALID_JOB = 0x67010000,
@@ -93,6 +101,7 @@ enum {
 	/*JPEG */
 	JPEG_INVALID_JOB = 0x68000000,
 	JPEG_ENC_JOB,
+	JPEG_ENC_BATCH_JOB,
 	JPEG_LAST_JOB
 };
 #define mm_job_type_e unsigned int
@@ -133,6 +142,102 @@ struct MM_DEV_SPL_DATA_T {
 
 #define mm_dev_spl_data_t struct MM_DEV_SPL_DATA_T
 
+#define MM_MAX_CACHE_RANGES 8
+
+enum {
+	MM_CACHE_CLEAN = 0,	/* clean before the job runs */
+	MM_CACHE_INVALIDATE,	/* invalidate before and after the job runs */
+	MM_CACHE_FLUSH,		/* clean before, invalidate after */
+	MM_CACHE_LAST
+};
+
+struct MM_CACHE_RANGE_T {
+	uint32_t addr;	/* physical address */
+	uint32_t size;
+	uint32_t op;
+};
+
+struct MM_CACHE_RANGES_T {
+	uint32_t num_ranges;
+	struct MM_CACHE_RANGE_T range[MM_MAX_CACHE_RANGES];
+};
+#define mm_cache_ranges_t struct MM_CACHE_RANGES_T
+
+#define MM_MAX_BATCH_JOBS 64
+
+/* One entry of MM_IOCTL_POST_JOBS / MM_IOCTL_READ_JOBS.
+ * Post: type, id, size and data as for write(). A type of
+ * INTERLOCK_WAITING_JOB interlocks with the file descriptor in id,
+ * as lseek() does.
+ * Read: data/size give the result buffer; status, id and size are
+ * filled in on return. */
+struct MM_JOB_DESC_T {
+	mm_job_type_e type;
+	uint32_t id;
+	mm_job_status_e status;
+	uint32_t size;
+	void *data;
+};
+#define mm_job_desc_t struct MM_JOB_DESC_T
+
+struct MM_JOB_BATCH_T {
+	uint32_t num_jobs;	/* in: entries, out: entries processed */
+	mm_job_desc_t *jobs;
+};
+#define mm_job_batch_t struct MM_JOB_BATCH_T
+
+/* Applies to the next job written on the file descriptor.
+ * deadline_us is relative to the write, cycles is the expected
+ * number of MM clock cycles the job needs. A zero deadline clears
+ * the hint. */
+struct MM_JOB_HINT_T {
+	uint32_t deadline_us;
+	uint32_t cycles;
+};
+#define mm_job_hint_t struct MM_JOB_HINT_T
+
+/* Applies to the next job written on the file descriptor.
+ * in_fence is a sync fence the job waits for before it is handed to
+ * its core, -1 for none. out_fence returns a sync fence that signals
+ * once the job has completed, in error if it failed or was dropped. */
+struct MM_JOB_FENCE_T {
+	int32_t in_fence;
+	int32_t out_fence;
+};
+#define mm_job_fence_t struct MM_JOB_FENCE_T
+
+/* Job trace ring, mmap()ed read-only from <debugfs>/<device>/<core>/trace.
+ * The header is followed at rec_offset by num_recs (a power of two)
+ * records. Record n lives in slot n & (num_recs - 1) and is complete
+ * once its seq reads n + 1; head is the number of records written.
+ * Timestamps are sched_clock() nanoseconds, 0 when not seen. */
+#define MM_TRACE_MAGIC 0x4d4d5452
+#define MM_TRACE_VERSION 1
+
+struct MM_TRACE_HDR_T {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t rec_size;
+	uint32_t rec_offset;
+	uint32_t num_recs;
+	uint32_t head;
+};
+#define mm_trace_hdr_t struct MM_TRACE_HDR_T
+
+struct MM_TRACE_REC_T {
+	uint32_t seq;
+	mm_job_type_e type;
+	uint32_t id;
+	mm_job_status_e status;
+	uint64_t t_add;		/* queued to the core */
+	uint64_t t_start;	/* handed to the hardware */
+	uint64_t t_irq;		/* last completion interrupt */
+	uint64_t t_done;	/* retired */
+	uint32_t clk_on_ns;	/* power up latency paid by this job */
+	uint32_t reserved[3];
+};
+#define mm_trace_rec_t struct MM_TRACE_REC_T
+
 #define mm_job_post_t struct MM_JOB_POST_T
 
 #define INTERLOCK_DEV_NAME	"mm_interlock"
@@ -160,6 +265,11 @@ enum {
 	MM_CMD_GET_BUFFER_STATUS,
 	MM_CMD_MEMC_SET,
 	MM_CMD_MEMC_RESET,
+	MM_CMD_SET_CACHE_RANGES,
+	MM_CMD_POST_JOBS,
+	MM_CMD_READ_JOBS,
+	MM_CMD_SET_JOB_HINT,
+	MM_CMD_SET_JOB_FENCE,
 	MM_CMD_LAST
 };
 
@@ -225,4 +335,20 @@ struct mm_secure_job_t_ {
 
 #define MM_IOCTL_MEMC_RESET _IOWR(MM_DEV_MAGIC, MM_CMD_MEMC_RESET, int)
 
+/* Buffer ranges touched by the next MM_DIRTY_JOB written on this file */
+#define MM_IOCTL_SET_CACHE_RANGES _IOW(MM_DEV_MAGIC, \
+		MM_CMD_SET_CACHE_RANGES, mm_cache_ranges_t)
+
+#define MM_IOCTL_POST_JOBS _IOWR(MM_DEV_MAGIC, MM_CMD_POST_JOBS, \
+		mm_job_batch_t)
+
+#define MM_IOCTL_READ_JOBS _IOWR(MM_DEV_MAGIC, MM_CMD_READ_JOBS, \
+		mm_job_batch_t)
+
+#define MM_IOCTL_SET_JOB_HINT _IOW(MM_DEV_MAGIC, MM_CMD_SET_JOB_HINT, \
+		mm_job_hint_t)
+
+#define MM_IOCTL_SET_JOB_FENCE _IOWR(MM_DEV_MAGIC, MM_CMD_SET_JOB_FENCE, \
+		mm_job_fence_t)
+
 #endif
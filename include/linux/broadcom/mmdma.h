@@ -35,4 +35,19 @@ enum
 
 #define MMDMA_IOCTL_XFER		_IOR(BCM_MMDMA_MAGIC, MMDMA_CMD_XFER, mmdma_params)
 
+#ifdef __KERNEL__
+int mmdma_execute(unsigned int srcAddr, unsigned int dstAddr,
+		unsigned int size);
+/* copy height lines of width bytes, the strides are the bytes skipped
+ * between the end of one line and the start of the next */
+int mmdma_execute_2d(unsigned int srcAddr, unsigned int dstAddr,
+		unsigned int width, unsigned int height,
+		unsigned int srcStride, unsigned int dstStride);
+/* zero size bytes at dstAddr, both a multiple of 4 */
+int mmdma_execute_zero(unsigned int dstAddr, unsigned int size);
+
+/* copies shorter than this are left to the cpu */
+extern unsigned int mmdma_offload_min;
+#endif
+
 #endif // __MMDMA__H__
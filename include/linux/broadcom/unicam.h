@@ -34,6 +34,52 @@ typedef struct {
     unsigned int dropped_frames;
 } cam_isr_reg_status_st_t;	
 
+/* capture buffer handed to the driver with UNICAM_IOCTL_QBUF */
+typedef struct {
+    unsigned int index;       // returned by UNICAM_IOCTL_DQBUF
+    unsigned int addr;        // physical address, 16 byte aligned
+    unsigned int size;        // multiple of 16
+    unsigned int line_stride; // multiple of 16
+} unicam_buf_t;
+
+/* filled frame returned by UNICAM_IOCTL_DQBUF */
+typedef struct {
+    unsigned int index;
+    unsigned int sequence;    // frame count since UNICAM_IOCTL_STREAMON
+    unsigned int dropped;     // frames lost since the previous one
+    unsigned long long timestamp_ns; // CLOCK_MONOTONIC at frame end
+} unicam_frame_t;
+
+/* MM framework job posted for a frame by the capture pipeline */
+typedef struct {
+    unsigned int type;        // mm_job_type_e, 0 for none
+    unsigned int id;
+    unsigned int size;
+    void *data;               // copied at UNICAM_IOCTL_QBUF_PIPE
+} unicam_mm_job_t;
+
+/*
+ * Capture buffer with the ISP job that reads it and the encoder job that
+ * reads the ISP output. In pipeline mode the driver posts both at frame
+ * end, interlocked, and queues the buffer again once the ISP job is
+ * done; only the encoder's results reach user space, through its file.
+ * buf.index must be below UNICAM_MAX_BUFFERS.
+ */
+typedef struct {
+    unicam_buf_t buf;
+    unicam_mm_job_t isp;
+    unicam_mm_job_t enc;
+} unicam_pipe_buf_t;
+
+/* MM device files to post on, -1 in isp_fd unlinks the pipeline */
+typedef struct {
+    int isp_fd;               // opened write only
+    int enc_fd;
+} unicam_pipeline_t;
+
+#define UNICAM_MAX_BUFFERS        8
+#define UNICAM_MAX_PIPE_JOB_SIZE  4096
+
 enum {
     UNICAM_CMD_WAIT_IRQ = 0x80,
     UNICAM_CMD_OPEN_CSI0,	
@@ -42,6 +88,12 @@ enum {
     UNICAM_CMD_CLOSE_CSI1,
     UNICAM_CMD_CONFIG_SENSOR,
 	UNICAM_CMD_RETURN_IRQ,	
+    UNICAM_CMD_QBUF,
+    UNICAM_CMD_DQBUF,
+    UNICAM_CMD_STREAMON,
+    UNICAM_CMD_STREAMOFF,
+    UNICAM_CMD_SET_PIPELINE,
+    UNICAM_CMD_QBUF_PIPE,
     UNICAM_CMD_LAST
 };
 
@@ -52,4 +104,10 @@ enum {
 #define UNICAM_IOCTL_CLOSE_CSI1	     _IOR(BCM_UNICAM_MAGIC, UNICAM_CMD_CLOSE_CSI1, unsigned int)
 #define UNICAM_IOCTL_CONFIG_SENSOR   _IOR(BCM_UNICAM_MAGIC, UNICAM_CMD_CONFIG_SENSOR, unsigned int)
 #define UNICAM_IOCTL_RETURN_IRQ		 _IOR(BCM_UNICAM_MAGIC, UNICAM_CMD_RETURN_IRQ, unsigned int)
+#define UNICAM_IOCTL_QBUF            _IOW(BCM_UNICAM_MAGIC, UNICAM_CMD_QBUF, unicam_buf_t)
+#define UNICAM_IOCTL_DQBUF           _IOR(BCM_UNICAM_MAGIC, UNICAM_CMD_DQBUF, unicam_frame_t)
+#define UNICAM_IOCTL_STREAMON        _IO(BCM_UNICAM_MAGIC, UNICAM_CMD_STREAMON)
+#define UNICAM_IOCTL_STREAMOFF       _IO(BCM_UNICAM_MAGIC, UNICAM_CMD_STREAMOFF)
+#define UNICAM_IOCTL_SET_PIPELINE    _IOW(BCM_UNICAM_MAGIC, UNICAM_CMD_SET_PIPELINE, unicam_pipeline_t)
+#define UNICAM_IOCTL_QBUF_PIPE       _IOW(BCM_UNICAM_MAGIC, UNICAM_CMD_QBUF_PIPE, unicam_pipe_buf_t)
 #endif
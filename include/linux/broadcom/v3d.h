@@ -92,6 +92,12 @@ typedef struct {
 	int32_t timeout;
 } v3d_job_status_t;
 
+/* Scheduling class of a session, lower values are served first */
+#define V3D_PRIORITY_COMPOSITOR 0
+#define V3D_PRIORITY_FOREGROUND 1
+#define V3D_PRIORITY_BACKGROUND 2
+#define V3D_PRIORITY_COUNT      3
+
 enum {
 	V3D_CMD_GET_MEMPOOL = 0x80,
 	V3D_CMD_WAIT_IRQ,
@@ -124,6 +130,9 @@ enum {
 	V3D_CMD_ACQUIRE_EXCLUSIVE,
 	V3D_CMD_RELEASE_EXCLUSIVE,
 
+	/* Scheduling class of the jobs posted on this file handle */
+	V3D_CMD_SET_PRIORITY,
+
 	V3D_CMD_LAST
 };
 
@@ -157,5 +166,6 @@ enum {
 
 #define V3D_IOCTL_ACQUIRE_EXCLUSIVE		_IO(BCM_V3D_MAGIC, V3D_CMD_ACQUIRE_EXCLUSIVE)
 #define V3D_IOCTL_RELEASE_EXCLUSIVE		_IO(BCM_V3D_MAGIC, V3D_CMD_RELEASE_EXCLUSIVE)
+#define V3D_IOCTL_SET_PRIORITY			_IOW(BCM_V3D_MAGIC, V3D_CMD_SET_PRIORITY, uint32_t)
 
 #endif
@@ -178,6 +178,24 @@ extern int bus_unregister_notifier(struct bus_type *bus,
 extern struct kset *bus_get_kset(struct bus_type *bus);
 extern struct klist *bus_get_device_klist(struct bus_type *bus);
 
+/**
+ * enum probe_type - Device driver probe type to try
+ * @PROBE_DEFAULT_STRATEGY: Probe synchronously while the driver registers.
+ * @PROBE_PREFER_ASYNCHRONOUS: Attach the devices present when the driver
+ *	registers from an async worker, so slow probes on I2C or SDIO
+ *	overlap with the rest of the boot.
+ * @PROBE_AFTER_FIRST_FRAME: Defer the probe until the display showed its
+ *	first frame, for devices that are not needed to get there.
+ *
+ * Dependencies are still sorted with -EPROBE_DEFER, and
+ * wait_for_device_probe() waits for the async probes too.
+ */
+enum probe_type {
+	PROBE_DEFAULT_STRATEGY,
+	PROBE_PREFER_ASYNCHRONOUS,
+	PROBE_AFTER_FIRST_FRAME,
+};
+
 /**
  * struct device_driver - The basic device driver structure
  * @name:	Name of the device driver.
@@ -185,6 +203,7 @@ extern struct klist *bus_get_device_klist(struct bus_type *bus);
  * @owner:	The module owner.
  * @mod_name:	Used for built-in modules.
  * @suppress_bind_attrs: Disables bind/unbind via sysfs.
+ * @probe_type:	Type of the probe (synchronous, asynchronous or late).
  * @of_match_table: The open firmware table.
  * @acpi_match_table: The ACPI match table.
  * @probe:	Called to query the existence of a specific device,
@@ -218,6 +237,7 @@ struct device_driver {
 	const char		*mod_name;	/* used for built-in modules */
 
 	bool suppress_bind_attrs;	/* disables bind/unbind via sysfs */
+	enum probe_type probe_type;
 
 	const struct of_device_id	*of_match_table;
 	const struct acpi_device_id	*acpi_match_table;
@@ -242,6 +262,7 @@ extern struct device_driver *driver_find(const char *name,
 					 struct bus_type *bus);
 extern int driver_probe_done(void);
 extern void wait_for_device_probe(void);
+extern void driver_first_frame_done(void);
 
 
 /* sysfs interface for exporting driver attributes */
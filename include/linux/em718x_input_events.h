@@ -45,5 +45,9 @@
 /** event code sent when a timestamp changes */
 #define INPUT_EVENT_TIME	MSC_SCAN
 
+/** event code sent, value 0, once the samples held for a flush request
+ *  have all been sent */
+#define INPUT_EVENT_FLUSH	MSC_TIMESTAMP
+
 
 #endif
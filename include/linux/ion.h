@@ -74,6 +74,8 @@ struct ion_buffer;
    do not accept phys_addr_t's that would have to */
 #define ion_phys_addr_t unsigned long
 
+#define ION_SYSTEM_HEAP_MAX_ORDERS 6
+
 /**
  * struct ion_platform_heap - defines a heap in the given platform
  * @type:	type of the heap from ion_heap_type enum
@@ -85,6 +87,8 @@ struct ion_buffer;
  * @size:	size of the heap in bytes if applicable
  * @align:	required alignment in physical memory if applicable
  * @priv:	private info passed from the board file
+ * @orders:	page orders used by the system heap, largest first
+ * @num_orders:	number of valid entries in @orders, 0 for the default
  *
  * Provided by the board file.
  */
@@ -107,6 +111,10 @@ struct ion_platform_heap {
 #ifdef CONFIG_IOMMU_API
 	struct device *device;
 #endif
+#ifdef CONFIG_ION_BCM
+	unsigned int orders[ION_SYSTEM_HEAP_MAX_ORDERS];
+	int num_orders;
+#endif
 };
 
 /**
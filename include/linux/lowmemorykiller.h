@@ -29,14 +29,23 @@
 #ifndef _LOWMEMORYKILLER_H
 #define _LOWMEMORYKILLER_H
 
+#include <linux/types.h>
+#include <linux/sched.h>
+
+#define LMK_OP_PAGES	0
+#define LMK_OP_RECLAIM	1
+
 struct lmk_op {
 	int op;
+	int nr;
 };
 /*
  * Register callback to LMK to report various statistics,
  * to be considered in the LMK operation.
- * 'op' will be passed as '0', to get the number of pages,
- * currently used by others through the allocator.
+ * 'op' will be passed as LMK_OP_PAGES, to get the number of pages,
+ * currently used by others through the allocator, and as
+ * LMK_OP_RECLAIM, to free up to 'nr' pages before a process is
+ * killed; the callback returns the number of pages freed.
  */
 struct reg_lmk {
 	int (*cbk)(struct reg_lmk *reg_lmk, struct lmk_op *op);
@@ -46,4 +55,64 @@ struct reg_lmk {
 };
 extern void register_lmk(struct reg_lmk *);
 extern void unregister_lmk(struct reg_lmk *);
+
+struct task_struct;
+struct signal_struct;
+
+/*
+ * Keep the candidate list of the vmpressure driven LMK in sync: called
+ * when a process is forked or its oom_score_adj changes (with its
+ * siglock held), and when the last thread of the process is released.
+ */
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+extern void lowmem_adj_update(struct task_struct *tsk);
+extern void lowmem_adj_remove(struct signal_struct *sig);
+#else
+static inline void lowmem_adj_update(struct task_struct *tsk)
+{
+}
+
+static inline void lowmem_adj_remove(struct signal_struct *sig)
+{
+}
+#endif
+
+/*
+ * One LMK kill, as read from [debugfs]/almk/kills. Times are relative
+ * to the LMK run that selected the victim; free_us is 0 when the
+ * victim's mm was not torn down within a few seconds.
+ */
+struct lmk_kill_record {
+	__u64 trigger_ns;	/* ktime of the LMK run */
+	__u32 kill_us;		/* until SIGKILL was sent */
+	__u32 free_us;		/* until the victim's mm was torn down */
+	__u32 tasksize;		/* rss when selected, in pages */
+	__u32 freed;		/* rss when the mm was torn down, in pages */
+	__s32 pid;
+	__s16 oom_score_adj;
+	__s16 min_score_adj;
+	__s32 other_free;	/* pages, at trigger time */
+	__s32 other_file;
+	__u16 kill_index;	/* position in a multi kill run */
+	__u16 kill_count;	/* tasks killed by the run */
+	char comm[16];
+};
+
+#ifdef CONFIG_ANDROID_LMK_KILL_STATS
+extern void lowmem_exit_mmap(struct mm_struct *mm);
+
+static inline bool lowmem_mm_victim(struct mm_struct *mm)
+{
+	return unlikely(test_bit(MMF_LMK_VICTIM, &mm->flags));
+}
+#else
+static inline void lowmem_exit_mmap(struct mm_struct *mm)
+{
+}
+
+static inline bool lowmem_mm_victim(struct mm_struct *mm)
+{
+	return false;
+}
+#endif
 #endif
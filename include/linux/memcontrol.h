@@ -81,6 +81,7 @@ int task_in_mem_cgroup(struct task_struct *task, const struct mem_cgroup *memcg)
 
 extern struct mem_cgroup *try_get_mem_cgroup_from_page(struct page *page);
 extern struct mem_cgroup *mem_cgroup_from_task(struct task_struct *p);
+extern bool mem_cgroup_task_over_soft_limit(struct task_struct *p);
 extern struct mem_cgroup *try_get_mem_cgroup_from_mm(struct mm_struct *mm);
 
 extern struct mem_cgroup *parent_mem_cgroup(struct mem_cgroup *memcg);
@@ -414,8 +415,28 @@ static inline void mem_cgroup_replace_page_cache(struct page *oldpage,
 				struct page *newpage)
 {
 }
+
+static inline bool mem_cgroup_task_over_soft_limit(struct task_struct *p)
+{
+	return false;
+}
 #endif /* CONFIG_MEMCG */
 
+#ifdef CONFIG_ZRAM_MEMCG
+unsigned short mem_cgroup_zram_charge(struct page *page, long bytes);
+void mem_cgroup_zram_uncharge(unsigned short id, long bytes);
+#else
+static inline unsigned short mem_cgroup_zram_charge(struct page *page,
+						    long bytes)
+{
+	return 0;
+}
+
+static inline void mem_cgroup_zram_uncharge(unsigned short id, long bytes)
+{
+}
+#endif
+
 #if !defined(CONFIG_MEMCG) || !defined(CONFIG_DEBUG_VM)
 static inline bool
 mem_cgroup_bad_page_check(struct page *page)
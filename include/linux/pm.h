@@ -103,6 +103,13 @@ typedef struct pm_message {
  *	substantial amounts of memory from @prepare() in the GFP_KERNEL mode.
  *	[To work around these limitations, drivers may register suspend and
  *	hibernation notifiers to be executed before the freezing of tasks.]
+ *	A positive return value from @prepare() of a suspend transition tells
+ *	the PM core that the device is fine as it is when runtime suspended.
+ *	If it still is runtime suspended at its turn to suspend, and so are
+ *	all of its descendants, the suspend and resume callbacks of all
+ *	phases are then skipped for it, and it stays runtime suspended until
+ *	it is next used.  Only @complete() is executed.  Devices without any
+ *	PM callbacks are handled as if @prepare() had returned a positive value.
  *
  * @complete: Undo the changes made by @prepare().  This method is executed for
  *	all kinds of resume transitions, following one of the resume callbacks:
@@ -530,6 +537,7 @@ struct dev_pm_info {
 	struct wakeup_source	*wakeup;
 	bool			wakeup_path:1;
 	bool			syscore:1;
+	bool			direct_complete:1;	/* Owned by the PM core */
 #else
 	unsigned int		should_wakeup:1;
 #endif
@@ -645,6 +653,9 @@ extern int dpm_suspend(pm_message_t state);
 extern int dpm_prepare(pm_message_t state);
 
 extern void __suspend_report_result(const char *function, void *fn, int ret);
+extern void pm_callback_timed(struct device *dev, pm_message_t state,
+			      const char *info, u64 ns, int error);
+extern void pm_callback_skipped(struct device *dev, pm_message_t state);
 
 #define suspend_report_result(fn, ret)					\
 	do {								\
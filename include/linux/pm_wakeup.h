@@ -41,6 +41,7 @@
  * @expire_count: Number of times the wakeup source's timeout has expired.
  * @wakeup_count: Number of times the wakeup source might abort suspend.
  * @active: Status of the wakeup source.
+ * @prof_id: Entry of the wakeup source in the hold time profile, plus one.
  * @has_timeout: The wakeup source has been activated with a timeout.
  */
 struct wakeup_source {
@@ -61,6 +62,9 @@ struct wakeup_source {
 	unsigned long		wakeup_count;
 	bool			active:1;
 	bool			autosleep_enabled:1;
+#ifdef CONFIG_PM_WAKELOCKS_PROFILE
+	unsigned short		prof_id;
+#endif
 };
 
 #ifdef CONFIG_PM_SLEEP
@@ -50,6 +50,7 @@ struct persistent_ram_zone {
 
 	char *old_log;
 	size_t old_log_size;
+	size_t old_log_start;	/* write position when it was saved */
 };
 
 struct persistent_ram_zone *persistent_ram_new(phys_addr_t start, size_t size,
@@ -61,6 +62,10 @@ void persistent_ram_zap(struct persistent_ram_zone *prz);
 int persistent_ram_write(struct persistent_ram_zone *prz, const void *s,
 	unsigned int count);
 
+size_t persistent_ram_pos(struct persistent_ram_zone *prz);
+void persistent_ram_copy(struct persistent_ram_zone *prz, void *dst,
+	size_t pos, size_t count);
+
 void persistent_ram_save_old(struct persistent_ram_zone *prz);
 size_t persistent_ram_old_size(struct persistent_ram_zone *prz);
 void *persistent_ram_old(struct persistent_ram_zone *prz);
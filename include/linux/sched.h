@@ -115,6 +115,20 @@ extern unsigned long this_cpu_load(void);
 
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
+#ifdef CONFIG_SCHED_PACKING_TASKS
+extern bool sched_packing_active(void);
+extern unsigned int sched_packing_cpus(void);
+#else
+static inline bool sched_packing_active(void)
+{
+	return false;
+}
+
+static inline unsigned int sched_packing_cpus(void)
+{
+	return num_online_cpus();
+}
+#endif
 
 extern void calc_global_load(unsigned long ticks);
 extern void update_cpu_load_nohz(void);
@@ -385,6 +399,7 @@ extern int get_dumpable(struct mm_struct *mm);
 
 #define MMF_HAS_UPROBES		19	/* has uprobes */
 #define MMF_RECALC_UPROBES	20	/* MMF_HAS_UPROBES can be wrong */
+#define MMF_LMK_VICTIM		21	/* killed by lowmemorykiller, stats pending */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -630,6 +645,10 @@ struct signal_struct {
 	short oom_score_adj;		/* OOM kill score adjustment */
 	short oom_score_adj_min;	/* OOM kill score adjustment min value.
 					 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LMK_VMPRESSURE
+	struct list_head lmk_node;	/* lowmemorykiller candidates, sorted
+					 * by oom_score_adj */
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -46,6 +46,7 @@ extern enum sched_tunable_scaling sysctl_sched_tunable_scaling;
 
 #ifdef CONFIG_SCHED_PACKING_TASKS
 extern int  __read_mostly sysctl_sched_packing_level;
+extern int  __read_mostly sysctl_sched_packing_small_task;
 
 int sched_proc_update_packing(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
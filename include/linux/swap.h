@@ -198,6 +198,10 @@ struct swap_info_struct {
 	struct block_device *bdev;	/* swap device or bdev of swap file */
 	struct file *swap_file;		/* seldom referenced */
 	unsigned int old_block_size;	/* seldom referenced */
+	/* adaptive readahead of SWP_SOLIDSTATE, see swapin_nr_pages() */
+	atomic_t ra_hits;		/* readahead used since last fault */
+	unsigned int ra_win;		/* pages of the last readahead */
+	unsigned long ra_offset;	/* of the last fault */
 #ifdef CONFIG_FRONTSWAP
 	unsigned long *frontswap_map;	/* frontswap in-use, one bit per page */
 	atomic_t frontswap_pages;	/* frontswap pages in-use counter */
@@ -0,0 +1,90 @@
+/*
+ * include/linux/wakelock_profile.h
+ *
+ * Hold time profile of the wakeup sources, user space wakelocks and
+ * kernel ones alike. /proc/wakelock_profile reads as
+ *
+ *	struct wlp_hdr
+ *	struct wlp_source	[nr_sources]
+ *	struct wlp_event	[nr_events], oldest first
+ *
+ * Sources are profiled by name, so a wakelock that is garbage collected
+ * and created again keeps its numbers. Source 0 is "(other)", for the
+ * names that came after the table was full. The time a source was the only
+ * active one is the time it alone kept the system from suspending; the
+ * rest of its hold time overlapped with other sources and was redundant.
+ * Times are in ns of the monotonic clock.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef _WAKELOCK_PROFILE_H_
+#define _WAKELOCK_PROFILE_H_
+
+#include <linux/types.h>
+
+#define WLP_MAGIC		0x46504c57	/* "WLPF" */
+#define WLP_VERSION		1
+#define WLP_NAME_LEN		32
+
+/* holds < 1 ms, then [2^(i - 1), 2^i) ms, the last one is longer */
+#define WLP_BUCKETS		16
+
+struct wlp_hdr {
+	__u32 magic;
+	__u16 version;
+	__u16 buckets;
+	__u32 nr_sources;
+	__u32 nr_events;
+	__u64 now_ns;
+	__u64 awake_ns;		/* any source active */
+	__u32 events;		/* written since the reset, some overwritten */
+	__u32 reserved;
+};
+
+struct wlp_source {
+	char name[WLP_NAME_LEN];
+	__u16 id;		/* of the events */
+	__u16 active;		/* sources of the name active now */
+	__u32 count;		/* finished holds */
+	__u64 total_ns;		/* of the finished holds */
+	__u64 sole_ns;		/* the only one active */
+	__u32 hist[WLP_BUCKETS];
+};
+
+#define WLP_EV_ACQUIRE		0x1
+#define WLP_EV_IRQ		0x2	/* from interrupt context, no pid */
+
+struct wlp_event {
+	__u64 ns;
+	__u32 pid;		/* tgid of the caller */
+	__u16 id;
+	__u16 flags;
+};
+
+#ifdef __KERNEL__
+#include <linux/ktime.h>
+
+struct wakeup_source;
+
+#ifdef CONFIG_PM_WAKELOCKS_PROFILE
+/* called under ws->lock */
+void pm_wakelock_profile_activate(struct wakeup_source *ws, ktime_t now);
+void pm_wakelock_profile_deactivate(struct wakeup_source *ws, ktime_t now,
+				    ktime_t held);
+#else
+static inline void pm_wakelock_profile_activate(struct wakeup_source *ws,
+						ktime_t now)
+{
+}
+
+static inline void pm_wakelock_profile_deactivate(struct wakeup_source *ws,
+						  ktime_t now, ktime_t held)
+{
+}
+#endif
+#endif
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef _LINUX_ZPOLICY_H
+#define _LINUX_ZPOLICY_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+/*
+ * Shared budget for the compressed memory backends: file backed
+ * (cleancache) pages are kept by zcache, anonymous pages by zram, and
+ * both charge the backing pageframes they use against one cap.
+ */
+enum zpolicy_class {
+	ZPOLICY_FILE,
+	ZPOLICY_ANON,
+	NR_ZPOLICY_CLASSES,
+};
+
+struct zpolicy_client {
+	const char *name;
+	enum zpolicy_class class;
+	/* drop up to nr backing pageframes, coldest first; returns freed */
+	unsigned long (*evict)(struct zpolicy_client *client,
+			       unsigned long nr);
+
+	/* Only to be used by zpolicy */
+	struct list_head list;
+};
+
+#ifdef CONFIG_ZPOLICY
+extern void zpolicy_register(struct zpolicy_client *client);
+extern void zpolicy_unregister(struct zpolicy_client *client);
+extern bool zpolicy_charge(enum zpolicy_class class, unsigned long nr);
+extern void zpolicy_uncharge(enum zpolicy_class class, unsigned long nr);
+extern unsigned long zpolicy_pages(enum zpolicy_class class);
+extern unsigned long zpolicy_evict(enum zpolicy_class class,
+				   unsigned long nr);
+#else
+static inline void zpolicy_register(struct zpolicy_client *client) { }
+static inline void zpolicy_unregister(struct zpolicy_client *client) { }
+static inline bool zpolicy_charge(enum zpolicy_class class, unsigned long nr)
+{
+	return true;
+}
+static inline void zpolicy_uncharge(enum zpolicy_class class,
+				    unsigned long nr) { }
+static inline unsigned long zpolicy_pages(enum zpolicy_class class)
+{
+	return 0;
+}
+static inline unsigned long zpolicy_evict(enum zpolicy_class class,
+					  unsigned long nr)
+{
+	return 0;
+}
+#endif
+
+#endif /* _LINUX_ZPOLICY_H */
@@ -273,6 +273,7 @@ struct cg_proto;
   *	@sk_send_head: front of stuff to transmit
   *	@sk_security: used by security modules
   *	@sk_mark: generic packet mark
+  *	@sk_qtaguid: xt_qtaguid accounting of the last packet
   *	@sk_classid: this socket's cgroup classid
   *	@sk_cgrp: this socket's cgroup-specific proto data
   *	@sk_write_pending: a write to stream socket waits to start
@@ -392,6 +393,16 @@ struct sock {
 	void			*sk_security;
 #endif
 	__u32			sk_mark;
+#if IS_ENABLED(CONFIG_NETFILTER_XT_MATCH_QTAGUID)
+	struct sk_qtaguid_cache {
+		u32		gen;
+		uid_t		uid;
+		int		set;
+		void		*stat;
+		/* copied along by sk_clone_lock() */
+		const struct sock *owner;
+	}			sk_qtaguid;
+#endif
 	u32			sk_classid;
 	struct cg_proto		*sk_cgrp;
 	void			(*sk_state_change)(struct sock *sk);
@@ -7,6 +7,7 @@
 #include <linux/tracepoint.h>
 #include <linux/types.h>
 #include <linux/sched.h>
+#include <linux/lowmemorykiller.h>
 
 TRACE_EVENT(almk_start,
 
@@ -127,6 +128,46 @@ TRACE_EVENT(almk_end,
 			__entry->cma_file)
 );
 
+TRACE_EVENT(almk_kill_stat,
+
+	TP_PROTO(const struct lmk_kill_record *rec),
+
+	TP_ARGS(rec),
+
+	TP_STRUCT__entry(
+		__array(char, comm, TASK_COMM_LEN)
+		__field(int, pid)
+		__field(int, oom_score_adj)
+		__field(int, min_score_adj)
+		__field(unsigned int, kill_us)
+		__field(unsigned int, free_us)
+		__field(unsigned int, tasksize)
+		__field(unsigned int, freed)
+		__field(unsigned int, kill_index)
+		__field(unsigned int, kill_count)
+	),
+
+	TP_fast_assign(
+		strlcpy(__entry->comm, rec->comm, TASK_COMM_LEN);
+		__entry->pid		= rec->pid;
+		__entry->oom_score_adj	= rec->oom_score_adj;
+		__entry->min_score_adj	= rec->min_score_adj;
+		__entry->kill_us	= rec->kill_us;
+		__entry->free_us	= rec->free_us;
+		__entry->tasksize	= rec->tasksize;
+		__entry->freed		= rec->freed;
+		__entry->kill_index	= rec->kill_index;
+		__entry->kill_count	= rec->kill_count;
+	),
+
+	TP_printk("%s:%d:%d:%d:%u:%u:%u:%u:%u/%u",
+			__entry->comm, __entry->pid,
+			__entry->oom_score_adj, __entry->min_score_adj,
+			__entry->kill_us, __entry->free_us,
+			__entry->tasksize, __entry->freed,
+			__entry->kill_index, __entry->kill_count)
+);
+
 #endif
 
 #include <trace/define_trace.h>
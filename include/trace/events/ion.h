@@ -0,0 +1,65 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ion
+
+#if !defined(_TRACE_EVENT_ION_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EVENT_ION_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+TRACE_EVENT(ion_cma_alloc_start,
+
+	TP_PROTO(const char *heap, unsigned long len, bool prefetch),
+
+	TP_ARGS(heap, len, prefetch),
+
+	TP_STRUCT__entry(
+		__string(heap, heap)
+		__field(unsigned long, len)
+		__field(bool, prefetch)
+	),
+
+	TP_fast_assign(
+		__assign_str(heap, heap);
+		__entry->len		= len;
+		__entry->prefetch	= prefetch;
+	),
+
+	TP_printk("heap=%s len=%lu prefetch=%d",
+		__get_str(heap), __entry->len, __entry->prefetch)
+);
+
+TRACE_EVENT(ion_cma_alloc_end,
+
+	TP_PROTO(const char *heap, unsigned long len, bool prefetch,
+		unsigned long migrated, unsigned long time_us, int ret),
+
+	TP_ARGS(heap, len, prefetch, migrated, time_us, ret),
+
+	TP_STRUCT__entry(
+		__string(heap, heap)
+		__field(unsigned long, len)
+		__field(bool, prefetch)
+		__field(unsigned long, migrated)
+		__field(unsigned long, time_us)
+		__field(int, ret)
+	),
+
+	TP_fast_assign(
+		__assign_str(heap, heap);
+		__entry->len		= len;
+		__entry->prefetch	= prefetch;
+		__entry->migrated	= migrated;
+		__entry->time_us	= time_us;
+		__entry->ret		= ret;
+	),
+
+	TP_printk("heap=%s len=%lu prefetch=%d migrated=%lu time_us=%lu ret=%d",
+		__get_str(heap), __entry->len, __entry->prefetch,
+		__entry->migrated, __entry->time_us, __entry->ret)
+);
+
+#endif /* _TRACE_EVENT_ION_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
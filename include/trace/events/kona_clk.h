@@ -0,0 +1,54 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kona_clk
+
+#if !defined(_TRACE_EVENT_KONA_CLK_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EVENT_KONA_CLK_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/* A CCU clock turned on by its first user or off by its last */
+TRACE_EVENT(ccu_clk_enable,
+
+	TP_PROTO(const char *name, int enable),
+
+	TP_ARGS(name, enable),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(int, enable)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->enable = enable;
+	),
+
+	TP_printk("ccu=%s %s", __get_str(name),
+		__entry->enable ? "on" : "off")
+);
+
+/* A clock lock released, held for ns; ccu is "gen" for the global lock */
+TRACE_EVENT(clk_lock_held,
+
+	TP_PROTO(const char *name, u32 ns),
+
+	TP_ARGS(name, ns),
+
+	TP_STRUCT__entry(
+		__string(name, name)
+		__field(u32, ns)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, name);
+		__entry->ns = ns;
+	),
+
+	TP_printk("ccu=%s held=%u ns", __get_str(name), __entry->ns)
+);
+
+#endif /* _TRACE_EVENT_KONA_CLK_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,33 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kona_memc
+
+#if !defined(_TRACE_EVENT_KONA_MEMC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EVENT_KONA_MEMC_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/* The MEMC DFS OPP changed, after the DDR PLL was set */
+TRACE_EVENT(memc_dfs_change,
+
+	TP_PROTO(u32 old_opp, u32 new_opp),
+
+	TP_ARGS(old_opp, new_opp),
+
+	TP_STRUCT__entry(
+		__field(u32, old_opp)
+		__field(u32, new_opp)
+	),
+
+	TP_fast_assign(
+		__entry->old_opp = old_opp;
+		__entry->new_opp = new_opp;
+	),
+
+	TP_printk("opp=%u->%u", __entry->old_opp, __entry->new_opp)
+);
+
+#endif /* _TRACE_EVENT_KONA_MEMC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
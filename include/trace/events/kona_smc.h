@@ -0,0 +1,42 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM kona_smc
+
+#if !defined(_TRACE_EVENT_KONA_SMC_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EVENT_KONA_SMC_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/*
+ * A secure monitor call returned, after ns in the secure world. batch is
+ * the number of calls issued in the same cross call to CPU 0.
+ */
+TRACE_EVENT(kona_smc,
+
+	TP_PROTO(u32 service_id, u32 ret, u32 batch, u64 ns),
+
+	TP_ARGS(service_id, ret, batch, ns),
+
+	TP_STRUCT__entry(
+		__field(u32, service_id)
+		__field(u32, ret)
+		__field(u32, batch)
+		__field(u64, ns)
+	),
+
+	TP_fast_assign(
+		__entry->service_id = service_id;
+		__entry->ret = ret;
+		__entry->batch = batch;
+		__entry->ns = ns;
+	),
+
+	TP_printk("service=0x%08x ret=0x%x batch=%u ns=%llu",
+		  __entry->service_id, __entry->ret, __entry->batch,
+		  (unsigned long long)__entry->ns)
+);
+
+#endif /* _TRACE_EVENT_KONA_SMC_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -0,0 +1,73 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM pi_mgr
+
+#if !defined(_TRACE_EVENT_PI_MGR_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_EVENT_PI_MGR_H
+
+#include <linux/tracepoint.h>
+#include <linux/types.h>
+
+/* One DFS transition of a PI, with the time spent in each step */
+TRACE_EVENT(pi_dfs_change,
+
+	TP_PROTO(int pi_id, u32 old_opp, u32 new_opp,
+		u64 pre_ns, u64 set_ns, u64 post_ns),
+
+	TP_ARGS(pi_id, old_opp, new_opp, pre_ns, set_ns, post_ns),
+
+	TP_STRUCT__entry(
+		__field(int, pi_id)
+		__field(u32, old_opp)
+		__field(u32, new_opp)
+		__field(u64, pre_ns)
+		__field(u64, set_ns)
+		__field(u64, post_ns)
+	),
+
+	TP_fast_assign(
+		__entry->pi_id = pi_id;
+		__entry->old_opp = old_opp;
+		__entry->new_opp = new_opp;
+		__entry->pre_ns = pre_ns;
+		__entry->set_ns = set_ns;
+		__entry->post_ns = post_ns;
+	),
+
+	TP_printk("pi=%d opp=%u->%u prechange=%llu set=%llu postchange=%llu ns",
+		__entry->pi_id, __entry->old_opp, __entry->new_opp,
+		__entry->pre_ns, __entry->set_ns, __entry->post_ns)
+);
+
+/* Deferred DFS listeners called for a batch of transitions */
+TRACE_EVENT(pi_dfs_deferred_notify,
+
+	TP_PROTO(int pi_id, u32 old_opp, u32 new_opp, u32 batched,
+		u64 notify_ns),
+
+	TP_ARGS(pi_id, old_opp, new_opp, batched, notify_ns),
+
+	TP_STRUCT__entry(
+		__field(int, pi_id)
+		__field(u32, old_opp)
+		__field(u32, new_opp)
+		__field(u32, batched)
+		__field(u64, notify_ns)
+	),
+
+	TP_fast_assign(
+		__entry->pi_id = pi_id;
+		__entry->old_opp = old_opp;
+		__entry->new_opp = new_opp;
+		__entry->batched = batched;
+		__entry->notify_ns = notify_ns;
+	),
+
+	TP_printk("pi=%d opp=%u->%u batched=%u notify=%llu ns",
+		__entry->pi_id, __entry->old_opp, __entry->new_opp,
+		__entry->batched, __entry->notify_ns)
+);
+
+#endif /* _TRACE_EVENT_PI_MGR_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -65,6 +65,57 @@ TRACE_EVENT(machine_suspend,
 	TP_printk("state=%lu", (unsigned long)__entry->state)
 );
 
+/* time awake before a suspend, or suspended before a resume */
+TRACE_EVENT(machine_suspend_period,
+
+	TP_PROTO(int resumed, long period_ms, long total_suspended_ms,
+		 long total_resumed_ms),
+
+	TP_ARGS(resumed, period_ms, total_suspended_ms, total_resumed_ms),
+
+	TP_STRUCT__entry(
+		__field(	int,		resumed			)
+		__field(	long,		period_ms		)
+		__field(	long,		total_suspended_ms	)
+		__field(	long,		total_resumed_ms	)
+	),
+
+	TP_fast_assign(
+		__entry->resumed = resumed;
+		__entry->period_ms = period_ms;
+		__entry->total_suspended_ms = total_suspended_ms;
+		__entry->total_resumed_ms = total_resumed_ms;
+	),
+
+	TP_printk("%s period_ms=%ld suspended_ms=%ld resumed_ms=%ld",
+		  __entry->resumed ? "resumed" : "suspended",
+		  __entry->period_ms, __entry->total_suspended_ms,
+		  __entry->total_resumed_ms)
+);
+
+/* one phase of the device suspend or resume of the system */
+TRACE_EVENT(device_pm_phase_time,
+
+	TP_PROTO(const char *info, int event, u64 ns),
+
+	TP_ARGS(info, event, ns),
+
+	TP_STRUCT__entry(
+		__string(	info,		info ?: "sys"		)
+		__field(	int,		event			)
+		__field(	u64,		ns			)
+	),
+
+	TP_fast_assign(
+		__assign_str(info, info ?: "sys");
+		__entry->event = event;
+		__entry->ns = ns;
+	),
+
+	TP_printk("%s event=0x%x ns=%llu", __get_str(info), __entry->event,
+		  (unsigned long long)__entry->ns)
+);
+
 DECLARE_EVENT_CLASS(wakeup_source,
 
 	TP_PROTO(const char *name, unsigned int state),
@@ -14,6 +14,9 @@
 #ifndef KONA_FB_H_
 #define KONA_FB_H_
 
+#include <linux/errno.h>
+#include <linux/notifier.h>
+
 #define DISPDRV_NAME_SZ 20
 #define REG_NAME_SZ DISPDRV_NAME_SZ
 
@@ -63,4 +66,23 @@ struct kona_fb_platform_data {
 	uint32_t tectl_gpio;
 };
 
+/*
+ * Notified on each vsync of the panel, or on each 16ms tick that stands
+ * in for it on command mode panels, in atomic context.
+ */
+#if defined(CONFIG_FB_BRCM_KONA) || \
+	(defined(CONFIG_FB_BRCM_KONA_MODULE) && defined(MODULE))
+extern int kona_fb_register_vsync_notifier(struct notifier_block *nb);
+extern int kona_fb_unregister_vsync_notifier(struct notifier_block *nb);
+#else
+static inline int kona_fb_register_vsync_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+static inline int kona_fb_unregister_vsync_notifier(struct notifier_block *nb)
+{
+	return -ENODEV;
+}
+#endif
+
 #endif /* KONA_FB_H_ */
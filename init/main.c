@@ -22,6 +22,7 @@
 #include <linux/delay.h>
 #include <linux/ioport.h>
 #include <linux/init.h>
+#include <linux/boot_time.h>
 #include <linux/initrd.h>
 #include <linux/bootmem.h>
 #include <linux/acpi.h>
@@ -668,6 +669,7 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 	calltime = ktime_get();
 	ret = fn();
 	rettime = ktime_get();
+	boot_time_initcall(fn, ret, calltime, rettime);
 	delta = ktime_sub(rettime, calltime);
 	duration = (unsigned long long) ktime_to_ns(delta) >> 10;
 	pr_debug("initcall %pF returned %d after %lld usecs\n",
@@ -676,6 +678,18 @@ static int __init_or_module do_one_initcall_debug(initcall_t fn)
 	return ret;
 }
 
+static int __init_or_module do_one_initcall_timed(initcall_t fn)
+{
+	ktime_t calltime;
+	int ret;
+
+	calltime = ktime_get();
+	ret = fn();
+	boot_time_initcall(fn, ret, calltime, ktime_get());
+
+	return ret;
+}
+
 int __init_or_module do_one_initcall(initcall_t fn)
 {
 	int count = preempt_count();
@@ -683,6 +697,8 @@ int __init_or_module do_one_initcall(initcall_t fn)
 
 	if (initcall_debug)
 		ret = do_one_initcall_debug(fn);
+	else if (boot_time_recording())
+		ret = do_one_initcall_timed(fn);
 	else
 		ret = fn();
 
@@ -0,0 +1,176 @@
+/*
+ * kernel/boot_time.c
+ *
+ * Initcall and driver probe times of the boot, see <linux/boot_time.h>.
+ *
+ * do_one_initcall() and really_probe() record the start and duration of
+ * each call, marks like the first frame go in between. Only the first
+ * BOOT_TIME_RECORDS calls are kept, later ones are not timed at all.
+ * Probes of async drivers overlap, so the durations do not add up to
+ * the boot time. debugfs boot_time lists the records in the order they
+ * finished:
+ *
+ *	start_us usecs ret kind name
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/boot_time.h>
+#include <linux/debugfs.h>
+#include <linux/device.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+
+#define BOOT_TIME_RECORDS	1024
+
+enum boot_time_kind {
+	BOOT_TIME_INITCALL,
+	BOOT_TIME_PROBE,
+	BOOT_TIME_MARK,
+};
+
+static const char * const boot_time_kinds[] = {
+	[BOOT_TIME_INITCALL]	= "initcall",
+	[BOOT_TIME_PROBE]	= "probe",
+	[BOOT_TIME_MARK]	= "mark",
+};
+
+struct boot_time_rec {
+	u32 start_us;
+	u32 usecs;
+	int ret;
+	int kind;
+	char name[48];
+};
+
+static DEFINE_SPINLOCK(boot_time_lock);
+static struct boot_time_rec boot_time_recs[BOOT_TIME_RECORDS];
+static unsigned int boot_time_count;
+
+bool boot_time_recording(void)
+{
+	return boot_time_count < BOOT_TIME_RECORDS;
+}
+
+/* the slot to fill, or NULL when full; returns with the lock held */
+static struct boot_time_rec *boot_time_get(int kind, int ret,
+					   ktime_t start, ktime_t end,
+					   unsigned long *flags)
+{
+	struct boot_time_rec *r;
+
+	spin_lock_irqsave(&boot_time_lock, *flags);
+	if (boot_time_count >= BOOT_TIME_RECORDS) {
+		spin_unlock_irqrestore(&boot_time_lock, *flags);
+		return NULL;
+	}
+	r = &boot_time_recs[boot_time_count++];
+	r->start_us = ktime_to_us(start);
+	r->usecs = ktime_us_delta(end, start);
+	r->ret = ret;
+	r->kind = kind;
+	return r;
+}
+
+void boot_time_initcall(initcall_t fn, int ret, ktime_t start, ktime_t end)
+{
+	struct boot_time_rec *r;
+	unsigned long flags;
+
+	r = boot_time_get(BOOT_TIME_INITCALL, ret, start, end, &flags);
+	if (!r)
+		return;
+	/* module init code is freed, keep the symbol */
+	snprintf(r->name, sizeof(r->name), "%pf", fn);
+	spin_unlock_irqrestore(&boot_time_lock, flags);
+}
+
+void boot_time_probe(struct device *dev, struct device_driver *drv, int ret,
+		     ktime_t start, ktime_t end)
+{
+	struct boot_time_rec *r;
+	unsigned long flags;
+
+	r = boot_time_get(BOOT_TIME_PROBE, ret, start, end, &flags);
+	if (!r)
+		return;
+	snprintf(r->name, sizeof(r->name), "%s%s %s", drv->name,
+		 drv->probe_type == PROBE_PREFER_ASYNCHRONOUS ? "(async)" : "",
+		 dev_name(dev));
+	spin_unlock_irqrestore(&boot_time_lock, flags);
+}
+
+void boot_time_mark(const char *what)
+{
+	struct boot_time_rec *r;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+
+	r = boot_time_get(BOOT_TIME_MARK, 0, now, now, &flags);
+	if (!r)
+		return;
+	strlcpy(r->name, what, sizeof(r->name));
+	spin_unlock_irqrestore(&boot_time_lock, flags);
+}
+
+static void *boot_time_start(struct seq_file *m, loff_t *pos)
+{
+	if (*pos >= ACCESS_ONCE(boot_time_count))
+		return NULL;
+	return &boot_time_recs[*pos];
+}
+
+static void *boot_time_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return boot_time_start(m, pos);
+}
+
+static void boot_time_stop(struct seq_file *m, void *v)
+{
+}
+
+static int boot_time_show(struct seq_file *m, void *v)
+{
+	struct boot_time_rec r;
+	unsigned long flags;
+
+	spin_lock_irqsave(&boot_time_lock, flags);
+	r = *(struct boot_time_rec *)v;
+	spin_unlock_irqrestore(&boot_time_lock, flags);
+
+	seq_printf(m, "%10u %8u %5d %-8s %s\n", r.start_us, r.usecs, r.ret,
+		   boot_time_kinds[r.kind], r.name);
+	return 0;
+}
+
+static const struct seq_operations boot_time_seq_ops = {
+	.start	= boot_time_start,
+	.next	= boot_time_next,
+	.stop	= boot_time_stop,
+	.show	= boot_time_show,
+};
+
+static int boot_time_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &boot_time_seq_ops);
+}
+
+static const struct file_operations boot_time_fops = {
+	.open		= boot_time_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init boot_time_init(void)
+{
+	if (!debugfs_create_file("boot_time", S_IRUGO, NULL, NULL,
+				 &boot_time_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(boot_time_init);
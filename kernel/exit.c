@@ -51,6 +51,7 @@
 #include <trace/events/sched.h>
 #include <linux/hw_breakpoint.h>
 #include <linux/oom.h>
+#include <linux/lowmemorykiller.h>
 #include <linux/writeback.h>
 #include <linux/shm.h>
 
@@ -155,6 +156,7 @@ static void __exit_signal(struct task_struct *tsk)
 	if (group_dead) {
 		flush_sigqueue(&sig->shared_pending);
 		tty_kref_put(tty);
+		lowmem_adj_remove(sig);
 	}
 }
 
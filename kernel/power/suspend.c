@@ -240,15 +240,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 }
 
 #ifdef CONFIG_SONY_JPROBE_SUSPEND_HOOK
-#define JPROBE_LINE_SZ  80
-static char jprobe_buf[JPROBE_LINE_SZ];
 static struct timespec jprobe_ts;
 static long int jprobe_total_suspended_ms = 0;
 static long int jprobe_total_resumed_ms = 0;
-noinline void idd_jprobe_suspend_hook(char *buf)
-{
-	asm("");
-}
 #endif
 
 /**
@@ -292,9 +286,8 @@ int suspend_devices_and_enter(suspend_state_t state)
 		jprobe_ts = now;
 		delta_ms = delta.tv_sec * 1000 + delta.tv_nsec / 1000000;
 		jprobe_total_resumed_ms += delta_ms;
-		scnprintf(jprobe_buf, JPROBE_LINE_SZ, "suspended %ld %ld %ld",
-			delta_ms, jprobe_total_suspended_ms, jprobe_total_resumed_ms);
-		idd_jprobe_suspend_hook(jprobe_buf);
+		trace_machine_suspend_period(0, delta_ms,
+			jprobe_total_suspended_ms, jprobe_total_resumed_ms);
 	}
 #endif
 
@@ -318,9 +311,8 @@ int suspend_devices_and_enter(suspend_state_t state)
 		jprobe_ts = now;
 		delta_ms = delta.tv_sec * 1000 + delta.tv_nsec / 1000000;
 		jprobe_total_suspended_ms += delta_ms;
-		scnprintf(jprobe_buf, JPROBE_LINE_SZ, "resumed %ld %ld %ld",
-			delta_ms, jprobe_total_suspended_ms, jprobe_total_resumed_ms);
-		idd_jprobe_suspend_hook(jprobe_buf);
+		trace_machine_suspend_period(1, delta_ms,
+			jprobe_total_suspended_ms, jprobe_total_resumed_ms);
 	}
 #endif
 	ftrace_start();
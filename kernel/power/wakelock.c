@@ -7,16 +7,26 @@
  *
  * This code is based on the analogous interface allowing user space to
  * manipulate wakelocks on Android.
+ *
+ * With CONFIG_PM_WAKELOCKS_PROFILE this also keeps the hold time profile
+ * of all wakeup sources, see <linux/wakelock_profile.h>.
  */
 
 #include <linux/capability.h>
 #include <linux/ctype.h>
 #include <linux/device.h>
 #include <linux/err.h>
+#include <linux/fs.h>
 #include <linux/hrtimer.h>
+#include <linux/init.h>
 #include <linux/list.h>
+#include <linux/proc_fs.h>
 #include <linux/rbtree.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/vmalloc.h>
+#include <linux/wakelock_profile.h>
 
 static DEFINE_MUTEX(wakelocks_lock);
 
@@ -264,3 +274,233 @@ int pm_wake_unlock(const char *buf)
 	mutex_unlock(&wakelocks_lock);
 	return ret;
 }
+
+#ifdef CONFIG_PM_WAKELOCKS_PROFILE
+#define WLP_SOURCES	128
+#define WLP_EVENTS	512	/* power of 2 */
+
+struct wlp_entry {
+	struct wlp_source s;
+	struct list_head active;	/* on wlp_active while s.active */
+};
+
+static DEFINE_SPINLOCK(wlp_lock);
+/* under wlp_lock, the first entry takes the names that do not fit */
+static struct wlp_entry wlp_entries[WLP_SOURCES] = {
+	[0].s.name = "(other)",
+};
+static unsigned int wlp_nr = 1;
+static LIST_HEAD(wlp_active);
+static struct wlp_entry *wlp_sole;
+static ktime_t wlp_sole_start;
+static ktime_t wlp_awake_start;
+static u64 wlp_awake_ns;
+static struct wlp_event wlp_ring[WLP_EVENTS];
+static u32 wlp_events;
+
+/* ws->prof_id is the entry index plus one, 0 until first activated */
+static struct wlp_entry *wlp_entry(struct wakeup_source *ws)
+{
+	const char *name = ws->name ? ws->name : "unnamed";
+	struct wlp_entry *e;
+	unsigned int i;
+
+	if (ws->prof_id)
+		return &wlp_entries[ws->prof_id - 1];
+
+	for (i = 0; i < wlp_nr; i++)
+		if (!strncmp(wlp_entries[i].s.name, name, WLP_NAME_LEN - 1))
+			break;
+	if (i == WLP_SOURCES) {
+		i = 0;
+	} else if (i == wlp_nr) {
+		wlp_nr++;
+		strlcpy(wlp_entries[i].s.name, name, WLP_NAME_LEN);
+		wlp_entries[i].s.id = i;
+	}
+	e = &wlp_entries[i];
+	ws->prof_id = i + 1;
+	return e;
+}
+
+static void wlp_event(struct wlp_entry *e, ktime_t now, u16 flags)
+{
+	struct wlp_event *ev = &wlp_ring[wlp_events++ % WLP_EVENTS];
+
+	ev->ns = ktime_to_ns(now);
+	ev->id = e->s.id;
+	ev->flags = flags;
+	if (in_interrupt()) {
+		ev->flags |= WLP_EV_IRQ;
+		ev->pid = 0;
+	} else {
+		ev->pid = task_tgid_nr(current);
+	}
+}
+
+/* close the intervals that ended with the last change of wlp_active */
+static void wlp_update(ktime_t now, bool was_awake)
+{
+	struct wlp_entry *sole = NULL;
+
+	if (list_is_singular(&wlp_active))
+		sole = list_first_entry(&wlp_active, struct wlp_entry, active);
+	if (sole != wlp_sole) {
+		if (wlp_sole)
+			wlp_sole->s.sole_ns +=
+				ktime_to_ns(ktime_sub(now, wlp_sole_start));
+		wlp_sole = sole;
+		wlp_sole_start = now;
+	}
+
+	if (!was_awake)
+		wlp_awake_start = now;
+	else if (list_empty(&wlp_active))
+		wlp_awake_ns += ktime_to_ns(ktime_sub(now, wlp_awake_start));
+}
+
+void pm_wakelock_profile_activate(struct wakeup_source *ws, ktime_t now)
+{
+	struct wlp_entry *e;
+	bool was_awake;
+
+	spin_lock(&wlp_lock);
+	e = wlp_entry(ws);
+	wlp_event(e, now, WLP_EV_ACQUIRE);
+	if (!e->s.active++) {
+		was_awake = !list_empty(&wlp_active);
+		list_add(&e->active, &wlp_active);
+		wlp_update(now, was_awake);
+	}
+	spin_unlock(&wlp_lock);
+}
+
+void pm_wakelock_profile_deactivate(struct wakeup_source *ws, ktime_t now,
+				    ktime_t held)
+{
+	u64 ms = ktime_to_ms(held);
+	struct wlp_entry *e;
+
+	spin_lock(&wlp_lock);
+	e = wlp_entry(ws);
+	wlp_event(e, now, 0);
+	e->s.count++;
+	e->s.total_ns += ktime_to_ns(held);
+	e->s.hist[ms ? min_t(int, fls64(ms), WLP_BUCKETS - 1) : 0]++;
+	if (e->s.active && !--e->s.active) {
+		list_del(&e->active);
+		wlp_update(now, true);
+	}
+	spin_unlock(&wlp_lock);
+}
+
+/* the hdr, then the sources and the events */
+struct wlp_snap {
+	size_t len;
+	struct wlp_hdr hdr;
+};
+
+static int wlp_open(struct inode *inode, struct file *file)
+{
+	struct wlp_snap *snap;
+	struct wlp_hdr *h;
+	struct wlp_source *s;
+	struct wlp_event *ev;
+	unsigned long flags;
+	unsigned int i, n;
+	ktime_t now;
+
+	snap = vzalloc(sizeof(*snap) + WLP_SOURCES * sizeof(*s) +
+		       WLP_EVENTS * sizeof(*ev));
+	if (!snap)
+		return -ENOMEM;
+	h = &snap->hdr;
+	s = (struct wlp_source *)(h + 1);
+
+	spin_lock_irqsave(&wlp_lock, flags);
+	now = ktime_get();
+	h->magic = WLP_MAGIC;
+	h->version = WLP_VERSION;
+	h->buckets = WLP_BUCKETS;
+	h->now_ns = ktime_to_ns(now);
+	h->awake_ns = wlp_awake_ns;
+	if (!list_empty(&wlp_active))
+		h->awake_ns += ktime_to_ns(ktime_sub(now, wlp_awake_start));
+	h->events = wlp_events;
+
+	h->nr_sources = wlp_nr;
+	for (i = 0; i < wlp_nr; i++)
+		s[i] = wlp_entries[i].s;
+	if (wlp_sole)
+		s[wlp_sole->s.id].sole_ns +=
+			ktime_to_ns(ktime_sub(now, wlp_sole_start));
+
+	ev = (struct wlp_event *)(s + wlp_nr);
+	h->nr_events = n = min_t(u32, wlp_events, WLP_EVENTS);
+	for (i = 0; i < n; i++)
+		ev[i] = wlp_ring[(wlp_events - n + i) % WLP_EVENTS];
+	spin_unlock_irqrestore(&wlp_lock, flags);
+
+	snap->len = (char *)(ev + n) - (char *)h;
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t wlp_read(struct file *file, char __user *buf, size_t count,
+			loff_t *ppos)
+{
+	struct wlp_snap *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, &snap->hdr,
+				       snap->len);
+}
+
+/* any write clears the numbers, the names and what is active stay */
+static ssize_t wlp_write(struct file *file, const char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	unsigned long flags;
+	unsigned int i;
+	ktime_t now;
+
+	spin_lock_irqsave(&wlp_lock, flags);
+	now = ktime_get();
+	for (i = 0; i < WLP_SOURCES; i++) {
+		struct wlp_source *s = &wlp_entries[i].s;
+
+		s->count = 0;
+		s->total_ns = 0;
+		s->sole_ns = 0;
+		memset(s->hist, 0, sizeof(s->hist));
+	}
+	wlp_sole_start = now;
+	wlp_awake_start = now;
+	wlp_awake_ns = 0;
+	wlp_events = 0;
+	spin_unlock_irqrestore(&wlp_lock, flags);
+	return count;
+}
+
+static int wlp_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations wlp_fops = {
+	.open		= wlp_open,
+	.read		= wlp_read,
+	.write		= wlp_write,
+	.llseek		= default_llseek,
+	.release	= wlp_release,
+};
+
+static int __init wakelock_profile_init(void)
+{
+	if (!proc_create("wakelock_profile", S_IRUSR | S_IWUSR, NULL,
+			 &wlp_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(wakelock_profile_init);
+#endif /* CONFIG_PM_WAKELOCKS_PROFILE */
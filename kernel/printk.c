@@ -44,6 +44,7 @@
 #include <linux/rculist.h>
 #include <linux/poll.h>
 #include <linux/irq_work.h>
+#include <linux/kthread.h>
 #include <linux/dma-mapping.h>
 #include <trace/stm.h>
 #include <linux/utsname.h>
@@ -1484,6 +1485,77 @@ static int console_trylock_for_printk(unsigned int cpu)
 	return retval;
 }
 
+#ifdef CONFIG_PRINTK_ASYNC
+static bool printk_async = true;
+module_param_named(async, printk_async, bool, S_IRUGO | S_IWUSR);
+
+static struct task_struct *printk_kthread;
+static int printk_output_pending;
+
+/* woken from irq_work, printk may be called under the runqueue lock */
+static void printk_async_wake(struct irq_work *work)
+{
+	struct task_struct *t = ACCESS_ONCE(printk_kthread);
+
+	if (t)
+		wake_up_process(t);
+}
+
+static DEFINE_PER_CPU(struct irq_work, printk_async_work) = {
+	.func = printk_async_wake,
+};
+
+static bool printk_async_defer(void)
+{
+	return printk_async && printk_kthread && !oops_in_progress &&
+	       system_state == SYSTEM_RUNNING;
+}
+
+static void printk_async_queue(void)
+{
+	ACCESS_ONCE(printk_output_pending) = 1;
+	irq_work_queue(&__get_cpu_var(printk_async_work));
+}
+
+static int printk_kthread_func(void *unused)
+{
+	set_user_nice(current, 10);
+	for (;;) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!xchg(&printk_output_pending, 0)) {
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+		/* the unlock writes out everything stored so far */
+		console_lock();
+		console_unlock();
+	}
+	return 0;
+}
+
+static int __init printk_kthread_init(void)
+{
+	struct task_struct *t;
+
+	t = kthread_run(printk_kthread_func, NULL, "printk");
+	if (IS_ERR(t))
+		return PTR_ERR(t);
+	printk_kthread = t;
+	return 0;
+}
+early_initcall(printk_kthread_init);
+#else
+static inline bool printk_async_defer(void)
+{
+	return false;
+}
+
+static inline void printk_async_queue(void)
+{
+}
+#endif
+
 static int recursion_bug;
 
 int printk_delay_msec __read_mostly;
@@ -1824,8 +1896,14 @@ asmlinkage int vprintk_emit(int facility, int level,
 	 *
 	 * The console_trylock_for_printk() function will release 'logbuf_lock'
 	 * regardless of whether it actually gets the console semaphore or not.
+	 *
+	 * With async printk the printk kthread does that instead.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (printk_async_defer()) {
+		logbuf_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+		printk_async_queue();
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
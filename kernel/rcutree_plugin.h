@@ -42,6 +42,8 @@
 static cpumask_var_t rcu_nocb_mask; /* CPUs to have callbacks offloaded. */
 static bool have_rcu_nocb_mask;	    /* Was rcu_nocb_mask allocated? */
 static bool __read_mostly rcu_nocb_poll;    /* Offload kthread are to poll. */
+static int rcu_nocb_lazy_delay = HZ;	    /* Max wait for a lazy batch. */
+module_param(rcu_nocb_lazy_delay, int, 0644);
 static char __initdata nocb_buf[NR_CPUS * 5];
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU */
 
@@ -99,6 +101,11 @@ static void __init rcu_bootup_announce_oddness(void)
 	pr_info("\tExperimental no-CBs for all CPUs\n");
 	cpumask_setall(rcu_nocb_mask);
 #endif /* #ifdef CONFIG_RCU_NOCB_CPU_ALL */
+#ifdef CONFIG_RCU_NOCB_CPU_SECONDARY
+	pr_info("\tExperimental no-CBs for all CPUs but CPU 0\n");
+	cpumask_setall(rcu_nocb_mask);
+	cpumask_clear_cpu(0, rcu_nocb_mask);
+#endif /* #ifdef CONFIG_RCU_NOCB_CPU_SECONDARY */
 #endif /* #ifndef CONFIG_RCU_NOCB_CPU_NONE */
 	if (have_rcu_nocb_mask) {
 		cpulist_scnprintf(nocb_buf, sizeof(nocb_buf), rcu_nocb_mask);
@@ -2077,7 +2084,11 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 	struct rcu_head **old_rhpp;
 	struct task_struct *t;
 
+	bool was_lazy;
+
 	/* Enqueue the callback on the nocb list and update counts. */
+	was_lazy = atomic_long_read(&rdp->nocb_q_count) ==
+		   atomic_long_read(&rdp->nocb_q_count_lazy);
 	old_rhpp = xchg(&rdp->nocb_tail, rhtp);
 	ACCESS_ONCE(*old_rhpp) = rhp;
 	atomic_long_add(rhcount, &rdp->nocb_q_count);
@@ -2094,6 +2105,8 @@ static void __call_rcu_nocb_enqueue(struct rcu_data *rdp,
 	} else if (len > rdp->qlen_last_fqs_check + qhimark) {
 		wake_up_process(t); /* ... or if many callbacks queued. */
 		rdp->qlen_last_fqs_check = LONG_MAX / 2;
+	} else if (was_lazy && rhcount_lazy < rhcount) {
+		wake_up(&rdp->nocb_wq); /* ... or to end a lazy wait. */
 	}
 	return;
 }
@@ -2191,6 +2204,18 @@ static void rcu_nocb_wait_gp(struct rcu_data *rdp)
 	smp_mb(); /* Ensure that CB invocation happens after GP end. */
 }
 
+/*
+ * Are only lazy callbacks queued, and not many of them?  Those only free
+ * memory, so they can wait for the next batch.
+ */
+static bool rcu_nocb_lazy_hold(struct rcu_data *rdp)
+{
+	long len = atomic_long_read(&rdp->nocb_q_count);
+
+	return len == atomic_long_read(&rdp->nocb_q_count_lazy) &&
+	       len <= qhimark;
+}
+
 /*
  * Per-rcu_data kthread, but only for no-CBs CPUs.  Each kthread invokes
  * callbacks queued by the corresponding no-CBs CPU.
@@ -2206,8 +2231,13 @@ static int rcu_nocb_kthread(void *arg)
 	/* Each pass through this loop invokes one batch of callbacks */
 	for (;;) {
 		/* If not polling, wait for next batch of callbacks. */
-		if (!rcu_nocb_poll)
+		if (!rcu_nocb_poll) {
 			wait_event_interruptible(rdp->nocb_wq, rdp->nocb_head);
+			if (rcu_nocb_lazy_delay > 0 && rcu_nocb_lazy_hold(rdp))
+				wait_event_interruptible_timeout(rdp->nocb_wq,
+					!rcu_nocb_lazy_hold(rdp),
+					rcu_nocb_lazy_delay);
+		}
 		list = ACCESS_ONCE(rdp->nocb_head);
 		if (!list) {
 			schedule_timeout_interruptible(1);
@@ -2266,16 +2296,26 @@ static void __init rcu_spawn_nocb_kthreads(struct rcu_state *rsp)
 	int cpu;
 	struct rcu_data *rdp;
 	struct task_struct *t;
+	cpumask_var_t cm;
+	bool affine;
 
 	if (rcu_nocb_mask == NULL)
 		return;
+
+	/* Keep the kthreads off the CPUs they offload, where possible. */
+	affine = zalloc_cpumask_var(&cm, GFP_KERNEL) &&
+		 cpumask_andnot(cm, cpu_possible_mask, rcu_nocb_mask);
 	for_each_cpu(cpu, rcu_nocb_mask) {
 		rdp = per_cpu_ptr(rsp->rda, cpu);
-		t = kthread_run(rcu_nocb_kthread, rdp,
-				"rcuo%c/%d", rsp->abbr, cpu);
+		t = kthread_create(rcu_nocb_kthread, rdp,
+				   "rcuo%c/%d", rsp->abbr, cpu);
 		BUG_ON(IS_ERR(t));
+		if (affine)
+			set_cpus_allowed_ptr(t, cm);
 		ACCESS_ONCE(rdp->nocb_kthread) = t;
+		wake_up_process(t);
 	}
+	free_cpumask_var(cm);
 }
 
 /* Prevent __call_rcu() from enqueuing callbacks on no-CBs CPUs */
@@ -196,6 +196,14 @@ int __read_mostly sysctl_sched_packing_level = DEFAULT_PACKING_LEVEL;
 
 unsigned int sd_pack_threshold = (100 * 1024) / DEFAULT_PACKING_LEVEL;
 
+/*
+ * Tasks runnable for more than this % of the time are not small: they are
+ * not moved to the buddy on wakeup and may wake an idle non packing CPU.
+ * 100 packs every task.
+ */
+#define DEFAULT_PACKING_SMALL_TASK 25
+int __read_mostly sysctl_sched_packing_small_task = DEFAULT_PACKING_SMALL_TASK;
+
 static inline int get_buddy(int cpu)
 {
 	return per_cpu(sd_pack_buddy, cpu).my_buddy;
@@ -226,6 +234,32 @@ static inline bool is_packing_cpu(int cpu)
 	return (my_buddy == -1) || (cpu == my_buddy);
 }
 
+static inline bool is_small_task(struct task_struct *p)
+{
+	struct sched_avg *sa = &p->se.avg;
+
+	return sa->runnable_avg_sum * 100 <=
+		sa->runnable_avg_period * sysctl_sched_packing_small_task;
+}
+
+bool sched_packing_active(void)
+{
+	return sysctl_sched_packing_level != 0;
+}
+EXPORT_SYMBOL_GPL(sched_packing_active);
+
+/* online CPUs the packing currently lets tasks run on */
+unsigned int sched_packing_cpus(void)
+{
+	unsigned int cpu, n = 0;
+
+	for_each_online_cpu(cpu)
+		if (is_packing_cpu(cpu))
+			n++;
+	return n;
+}
+EXPORT_SYMBOL_GPL(sched_packing_cpus);
+
 static inline bool is_leader_cpu(int cpu, struct sched_domain *sd)
 {
 	if (sd != per_cpu(sd_pack_buddy, cpu).domain)
@@ -395,6 +429,11 @@ static inline bool is_packing_cpu(int cpu)
 	return 1;
 }
 
+static inline bool is_small_task(struct task_struct *p)
+{
+	return 1;
+}
+
 static inline bool is_leader_cpu(int cpu, struct sched_domain *sd)
 {
 	return 1;
@@ -3686,10 +3725,12 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 
 	if (affine_sd) {
 		if (cpu != prev_cpu && (wake_affine(affine_sd, p, sync)
-					|| !is_packing_cpu(prev_cpu)))
+					|| (!is_packing_cpu(prev_cpu)
+					&& is_small_task(p))))
 			prev_cpu = cpu;
 
-		if (!is_packing_cpu(prev_cpu))
+		/* only small tasks are kept off the idle CPUs */
+		if (!is_packing_cpu(prev_cpu) && is_small_task(p))
 			prev_cpu =  get_buddy(prev_cpu);
 
 		new_cpu = select_idle_sibling(p, prev_cpu);
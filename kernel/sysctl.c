@@ -304,6 +304,15 @@ static struct ctl_table kern_table[] = {
 		.extra1		= &min_sched_packing_level,
 		.extra2		= &max_sched_packing_level,
 	},
+	{
+		.procname	= "sched_packing_small_task",
+		.data		= &sysctl_sched_packing_small_task,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &min_sched_packing_level,
+		.extra2		= &max_sched_packing_level,
+	},
 #endif
 #ifdef CONFIG_SCHED_DEBUG
 	{
@@ -1301,6 +1310,30 @@ static struct ctl_table vm_table[] = {
 		.extra1		= &min_extfrag_threshold,
 		.extra2		= &max_extfrag_threshold,
 	},
+	{
+		.procname	= "compact_order4_blocks",
+		.data		= &sysctl_compact_order4_blocks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_compact_proactive_handler,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "compact_order8_blocks",
+		.data		= &sysctl_compact_order8_blocks,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= sysctl_compact_proactive_handler,
+		.extra1		= &zero,
+	},
+	{
+		.procname	= "compact_proactive_ms",
+		.data		= &sysctl_compact_proactive_ms,
+		.maxlen		= sizeof(int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one_hundred,
+	},
 
 #endif /* CONFIG_COMPACTION */
 	{
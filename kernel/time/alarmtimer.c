@@ -26,6 +26,9 @@
 #include <linux/workqueue.h>
 #include <linux/freezer.h>
 #include <linux/module.h>
+#include <linux/debugfs.h>
+#include <linux/math64.h>
+#include <linux/seq_file.h>
 
 #define ALARM_PRINT_ERROR (1U << 0)
 #define ALARM_PRINT_INIT (1U << 1)
@@ -67,6 +70,16 @@ static DEFINE_SPINLOCK(freezer_delta_lock);
 
 static struct wakeup_source *ws;
 
+/*
+ * Alarms run before their latest time rode along with another wakeup,
+ * one less wakeup of their own; rtc_wakeups are the suspends that set
+ * the rtc for an alarm.
+ */
+static atomic_t alarm_fired_count = ATOMIC_INIT(0);
+static atomic_t alarm_coalesced_count = ATOMIC_INIT(0);
+static atomic_t alarm_rtc_wakeups = ATOMIC_INIT(0);
+static ktime_t alarm_stats_start;
+
 #ifdef CONFIG_RTC_CLASS
 /* rtc timer and device for setting alarm wakeups at suspend */
 static struct rtc_timer		rtctimer;
@@ -221,13 +234,18 @@ static enum hrtimer_restart alarmtimer_fired(struct hrtimer *timer)
 	unsigned long flags;
 	int ret = HRTIMER_NORESTART;
 	int restart = ALARMTIMER_NORESTART;
+	ktime_t now = base->gettime();
+
+	atomic_inc(&alarm_fired_count);
+	if (now.tv64 < alarm->node.expires.tv64)
+		atomic_inc(&alarm_coalesced_count);
 
 	spin_lock_irqsave(&base->lock, flags);
 	alarmtimer_dequeue(base, alarm);
 	spin_unlock_irqrestore(&base->lock, flags);
 
 	if (alarm->function)
-		restart = alarm->function(alarm, base->gettime());
+		restart = alarm->function(alarm, now);
 
 	spin_lock_irqsave(&base->lock, flags);
 	if (restart != ALARMTIMER_NORESTART) {
@@ -277,7 +295,11 @@ static int alarmtimer_suspend(struct device *dev)
 	if (!rtc)
 		return 0;
 
-	/* Find the soonest timer to expire*/
+	/*
+	 * Find the soonest timer to expire. That is the latest time of an
+	 * alarm with a window, so every alarm whose window has opened by
+	 * then runs with the same wakeup.
+	 */
 	for (i = 0; i < ALARM_NUMTYPE; i++) {
 		struct alarm_base *base = &alarm_bases[i];
 		struct timerqueue_node *next;
@@ -310,6 +332,8 @@ static int alarmtimer_suspend(struct device *dev)
 	ret = rtc_timer_start(rtc, &rtctimer, now, ktime_set(0, 0));
 	if (ret < 0)
 		__pm_wakeup_event(ws, MSEC_PER_SEC);
+	else
+		atomic_inc(&alarm_rtc_wakeups);
 	return ret;
 }
 #else
@@ -423,6 +447,32 @@ int alarm_start(struct alarm *alarm, ktime_t start)
 	return ret;
 }
 
+/**
+ * alarm_start_range - Sets an absolute alarm to fire within a window
+ * @alarm: ptr to alarm to set
+ * @start: earliest time to run the alarm
+ * @slack: how much later than @start the alarm may run
+ *
+ * The alarm runs with the first other timer that expires after @start,
+ * and at @start + @slack at the latest. Only that latest time wakes the
+ * system from suspend, so a periodic alarm can ride along with the
+ * wakeups of others.
+ */
+int alarm_start_range(struct alarm *alarm, ktime_t start, ktime_t slack)
+{
+	struct alarm_base *base = &alarm_bases[alarm->type];
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&base->lock, flags);
+	alarm->node.expires = ktime_add(start, slack);
+	alarmtimer_enqueue(base, alarm);
+	ret = hrtimer_start_range_ns(&alarm->timer, start,
+				     ktime_to_ns(slack), HRTIMER_MODE_ABS);
+	spin_unlock_irqrestore(&base->lock, flags);
+	return ret;
+}
+
 /**
  * alarm_start_relative - Sets a relative alarm to fire
  * @alarm: ptr to alarm to set
@@ -927,6 +977,7 @@ static int __init alarmtimer_init(void)
 		goto out_drv;
 	}
 	ws = wakeup_source_register("alarmtimer");
+	alarm_stats_start = ktime_get_boottime();
 	pr_alarm(INFO, "alarmtimer initialized.\n");
 
 	return 0;
@@ -938,3 +989,55 @@ out_if:
 	return error;
 }
 device_initcall(alarmtimer_init);
+
+#ifdef CONFIG_DEBUG_FS
+static int alarmtimer_stats_show(struct seq_file *m, void *v)
+{
+	u64 secs = ktime_divns(ktime_sub(ktime_get_boottime(),
+					 alarm_stats_start), NSEC_PER_SEC);
+	u64 saved = atomic_read(&alarm_coalesced_count);
+	u32 frac;
+
+	/* in hundredths, over the boottime including suspend */
+	saved = div64_u64(saved * 3600 * 100, max_t(u64, secs, 1));
+	frac = do_div(saved, 100);
+	seq_printf(m, "fired %d\n", atomic_read(&alarm_fired_count));
+	seq_printf(m, "coalesced %d\n", atomic_read(&alarm_coalesced_count));
+	seq_printf(m, "rtc_wakeups %d\n", atomic_read(&alarm_rtc_wakeups));
+	seq_printf(m, "saved_per_hour %llu.%02u\n", saved, frac);
+	return 0;
+}
+
+static int alarmtimer_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, alarmtimer_stats_show, NULL);
+}
+
+static ssize_t alarmtimer_stats_write(struct file *file,
+				      const char __user *buf, size_t count,
+				      loff_t *ppos)
+{
+	atomic_set(&alarm_fired_count, 0);
+	atomic_set(&alarm_coalesced_count, 0);
+	atomic_set(&alarm_rtc_wakeups, 0);
+	alarm_stats_start = ktime_get_boottime();
+	return count;
+}
+
+static const struct file_operations alarmtimer_stats_fops = {
+	.open		= alarmtimer_stats_open,
+	.read		= seq_read,
+	.write		= alarmtimer_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init alarmtimer_debugfs_init(void)
+{
+	if (!debugfs_create_file("alarmtimer", S_IRUGO | S_IWUSR, NULL, NULL,
+				 &alarmtimer_stats_fops))
+		return -ENOMEM;
+	return 0;
+}
+late_initcall(alarmtimer_debugfs_init);
+#endif
@@ -14,4 +14,6 @@
 #include <trace/events/power.h>
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_idle);
+EXPORT_TRACEPOINT_SYMBOL_GPL(machine_suspend_period);
+EXPORT_TRACEPOINT_SYMBOL_GPL(device_pm_phase_time);
 
@@ -0,0 +1,333 @@
+/*
+ * Boot readahead profile
+ *
+ * While recording, every page cache readahead that went to the disk is
+ * noted as a range of pages of a file, ranges continuing the last one of
+ * the same file are merged. /proc/boot_readahead lists them as
+ *
+ *	<first page> <pages> <path>
+ *
+ * in the order they were first read. User space saves the list once the
+ * boot is done, and writes it back to /proc/boot_readahead early on the
+ * following boots: each line is then read into the page cache with
+ * force_page_cache_readahead(), in large reads instead of the small
+ * faults of the cold start. Writing a list also stops the recording, as
+ * do the commands "stop", and "drop" which frees the recorded list.
+ *
+ * Reads that do not go through readahead, with the readahead window off,
+ * are not recorded.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/fs.h>
+#include <linux/hash.h>
+#include <linux/init.h>
+#include <linux/mm.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/proc_fs.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include "internal.h"
+
+#define BRA_RANGES		8192
+#define BRA_HASH_BITS		8
+
+struct bra_file {
+	struct hlist_node node;
+	struct super_block *sb;
+	unsigned long ino;
+	unsigned int last;		/* index of its newest range */
+	char *name;
+};
+
+struct bra_range {
+	struct bra_file *file;
+	pgoff_t start;
+	unsigned long nr;
+};
+
+static bool bra_record = true;
+module_param_named(record, bra_record, bool, 0444);
+
+static DEFINE_SPINLOCK(bra_lock);
+static DEFINE_MUTEX(bra_write_mutex);
+static struct hlist_head bra_hash[1 << BRA_HASH_BITS];
+/* under bra_lock */
+static struct bra_range *bra_ranges;
+static unsigned int bra_count;
+static bool bra_recording __read_mostly;
+
+static struct bra_file *bra_find(struct inode *inode)
+{
+	struct bra_file *f;
+
+	hlist_for_each_entry(f, &bra_hash[hash_ptr(inode, BRA_HASH_BITS)],
+			     node)
+		if (f->sb == inode->i_sb && f->ino == inode->i_ino)
+			return f;
+	return NULL;
+}
+
+static void bra_add(struct bra_file *f, pgoff_t start, unsigned long nr)
+{
+	struct bra_range *r = &bra_ranges[f->last];
+
+	if (f->last < bra_count && r->file == f && r->start + r->nr == start) {
+		r->nr += nr;
+		return;
+	}
+	if (bra_count == BRA_RANGES) {
+		bra_recording = false;
+		return;
+	}
+	f->last = bra_count++;
+	r = &bra_ranges[f->last];
+	r->file = f;
+	r->start = start;
+	r->nr = nr;
+}
+
+/* a new file, named outside the lock as d_path can take its time */
+static struct bra_file *bra_new(struct file *filp)
+{
+	struct inode *inode = file_inode(filp);
+	struct bra_file *f;
+	char *buf, *name;
+
+	buf = kmalloc(PATH_MAX, GFP_NOFS);
+	if (!buf)
+		return NULL;
+	name = d_path(&filp->f_path, buf, PATH_MAX);
+	f = IS_ERR(name) ? NULL : kzalloc(sizeof(*f), GFP_NOFS);
+	if (f) {
+		f->name = kstrdup(name, GFP_NOFS);
+		if (!f->name) {
+			kfree(f);
+			f = NULL;
+		}
+	}
+	kfree(buf);
+	if (!f)
+		return NULL;
+
+	f->sb = inode->i_sb;
+	f->ino = inode->i_ino;
+	f->last = BRA_RANGES;
+	return f;
+}
+
+void boot_readahead_record(struct file *filp, pgoff_t start,
+			   unsigned long nr)
+{
+	struct inode *inode;
+	struct bra_file *f, *new = NULL;
+
+	if (!bra_recording || !filp)
+		return;
+	inode = file_inode(filp);
+
+	spin_lock(&bra_lock);
+	f = bra_find(inode);
+	if (!f) {
+		spin_unlock(&bra_lock);
+		new = bra_new(filp);
+		if (!new)
+			return;
+		spin_lock(&bra_lock);
+		f = bra_find(inode);
+		if (!f && bra_recording) {
+			f = new;
+			new = NULL;
+			hlist_add_head(&f->node,
+				&bra_hash[hash_ptr(inode, BRA_HASH_BITS)]);
+		}
+	}
+	if (f && bra_recording)
+		bra_add(f, start, nr);
+	spin_unlock(&bra_lock);
+
+	if (new) {
+		kfree(new->name);
+		kfree(new);
+	}
+}
+
+static void bra_drop(void)
+{
+	struct bra_range *ranges;
+	struct bra_file *f;
+	struct hlist_node *tmp;
+	HLIST_HEAD(files);
+	int i;
+
+	spin_lock(&bra_lock);
+	bra_recording = false;
+	ranges = bra_ranges;
+	bra_ranges = NULL;
+	bra_count = 0;
+	for (i = 0; i < ARRAY_SIZE(bra_hash); i++)
+		hlist_for_each_entry_safe(f, tmp, &bra_hash[i], node) {
+			hlist_del(&f->node);
+			hlist_add_head(&f->node, &files);
+		}
+	spin_unlock(&bra_lock);
+
+	hlist_for_each_entry_safe(f, tmp, &files, node) {
+		kfree(f->name);
+		kfree(f);
+	}
+	vfree(ranges);
+}
+
+static void bra_prefetch(char *line)
+{
+	unsigned long start, nr;
+	struct file *filp;
+	int n = 0;
+
+	if (sscanf(line, "%lu %lu %n", &start, &nr, &n) != 2 || !n)
+		return;
+	filp = filp_open(line + n, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(filp))
+		return;
+	force_page_cache_readahead(filp->f_mapping, filp, start, nr);
+	filp_close(filp, NULL);
+}
+
+static void bra_command(char *line)
+{
+	line = strim(line);
+	if (!*line)
+		return;
+	if (!strcmp(line, "drop")) {
+		bra_drop();
+		return;
+	}
+	/* the list read back from a file is not a boot to record */
+	bra_recording = false;
+	if (strcmp(line, "stop"))
+		bra_prefetch(line);
+}
+
+static ssize_t bra_write(struct file *file, const char __user *ubuf,
+			 size_t count, loff_t *ppos)
+{
+	char *buf, *line, *end;
+	size_t len = min_t(size_t, count, PAGE_SIZE - 1);
+	ssize_t ret;
+
+	buf = (char *)__get_free_page(GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+	if (copy_from_user(buf, ubuf, len)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	buf[len] = '\0';
+
+	/* whole lines only, the rest comes with the next write */
+	end = strrchr(buf, '\n');
+	if (!end) {
+		if (len < count) {
+			ret = -EINVAL;
+			goto out;
+		}
+		end = buf + len;
+	}
+	*end = '\0';
+	ret = end - buf + (len > end - buf);
+
+	mutex_lock(&bra_write_mutex);
+	for (line = buf; line; )
+		bra_command(strsep(&line, "\n"));
+	mutex_unlock(&bra_write_mutex);
+out:
+	free_page((unsigned long)buf);
+	return ret;
+}
+
+static void *bra_start(struct seq_file *m, loff_t *pos)
+{
+	return *pos < ACCESS_ONCE(bra_count) ? pos : NULL;
+}
+
+static void *bra_next(struct seq_file *m, void *v, loff_t *pos)
+{
+	++*pos;
+	return bra_start(m, pos);
+}
+
+static void bra_stop(struct seq_file *m, void *v)
+{
+}
+
+static int bra_show(struct seq_file *m, void *v)
+{
+	loff_t n = *(loff_t *)v;
+	struct bra_range r = { };
+
+	spin_lock(&bra_lock);
+	if (n < bra_count)
+		r = bra_ranges[n];
+	/* the name stays until drop, which takes bra_write_mutex */
+	spin_unlock(&bra_lock);
+
+	if (r.file)
+		seq_printf(m, "%lu %lu %s\n", r.start, r.nr, r.file->name);
+	return 0;
+}
+
+static const struct seq_operations bra_seq_ops = {
+	.start	= bra_start,
+	.next	= bra_next,
+	.stop	= bra_stop,
+	.show	= bra_show,
+};
+
+static int bra_open(struct inode *inode, struct file *file)
+{
+	return seq_open(file, &bra_seq_ops);
+}
+
+static ssize_t bra_read(struct file *file, char __user *buf, size_t count,
+			loff_t *ppos)
+{
+	ssize_t ret;
+
+	mutex_lock(&bra_write_mutex);
+	ret = seq_read(file, buf, count, ppos);
+	mutex_unlock(&bra_write_mutex);
+	return ret;
+}
+
+static const struct file_operations bra_fops = {
+	.open		= bra_open,
+	.read		= bra_read,
+	.write		= bra_write,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
+static int __init boot_readahead_init(void)
+{
+	if (!proc_create("boot_readahead", S_IRUSR | S_IWUSR, NULL,
+			 &bra_fops))
+		return -ENOMEM;
+	if (!bra_record)
+		return 0;
+
+	bra_ranges = vmalloc(BRA_RANGES * sizeof(*bra_ranges));
+	if (!bra_ranges)
+		return -ENOMEM;
+	bra_recording = true;
+	return 0;
+}
+core_initcall(boot_readahead_init);
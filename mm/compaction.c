@@ -12,6 +12,8 @@
 #include <linux/compaction.h>
 #include <linux/mm_inline.h>
 #include <linux/backing-dev.h>
+#include <linux/freezer.h>
+#include <linux/kthread.h>
 #include <linux/sysctl.h>
 #include <linux/sysfs.h>
 #include <linux/balloon_compaction.h>
@@ -835,6 +837,8 @@ static isolate_migrate_t isolate_migratepages(struct zone *zone,
 	return ISOLATE_SUCCESS;
 }
 
+static bool compact_proactive_met(void);
+
 static int compact_finished(struct zone *zone,
 			    struct compact_control *cc)
 {
@@ -858,6 +862,10 @@ static int compact_finished(struct zone *zone,
 		return COMPACT_COMPLETE;
 	}
 
+	/* kcompactd compacts whole zones, but only up to its targets */
+	if (cc->proactive && compact_proactive_met())
+		return COMPACT_PARTIAL;
+
 	/*
 	 * order == -1 is expected when compacting via
 	 * /proc/sys/vm/compact_memory
@@ -1200,6 +1208,160 @@ int sysctl_extfrag_handler(struct ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * Proactive compaction. The allocations that want order 8 and order 4
+ * pages but can do with smaller ones, the ION system heap's, neither
+ * wait nor compact, so once memory is fragmented they fall back to
+ * order 0 for good. kcompactd runs at SCHED_IDLE, on otherwise idle
+ * cpus only, and compacts zones asynchronously until there are at
+ * least compact_order8_blocks free order 8 blocks and
+ * compact_order4_blocks free order 4 ones, the larger blocks counted
+ * in. A failed allocation of order 4 or more wakes it; while it makes
+ * progress but has not met the targets it goes on every
+ * compact_proactive_ms. A target of 0 is no target.
+ */
+#define COMPACT_PROACTIVE_MIN_ORDER	4
+
+int sysctl_compact_order4_blocks = 128;
+int sysctl_compact_order8_blocks = 4;
+int sysctl_compact_proactive_ms = 10000;
+
+static struct task_struct *kcompactd;
+static DECLARE_WAIT_QUEUE_HEAD(kcompactd_wait);
+static bool kcompactd_kicked;
+static unsigned long kcompactd_last;	/* jiffies, end of the last run */
+
+/* free blocks of the order, the larger blocks split into them */
+static unsigned long compact_free_blocks(unsigned int order)
+{
+	unsigned long blocks = 0;
+	struct zone *zone;
+	unsigned int o;
+
+	for_each_populated_zone(zone)
+		for (o = order; o < MAX_ORDER; o++)
+			blocks += zone->free_area[o].nr_free << (o - order);
+	return blocks;
+}
+
+/* the highest order short of its target, -1 if none is */
+static int compact_proactive_order(void)
+{
+	if (sysctl_compact_order8_blocks > 0 &&
+	    compact_free_blocks(8) < sysctl_compact_order8_blocks)
+		return 8;
+	if (sysctl_compact_order4_blocks > 0 &&
+	    compact_free_blocks(4) < sysctl_compact_order4_blocks)
+		return 4;
+	return -1;
+}
+
+static bool compact_proactive_met(void)
+{
+	return compact_proactive_order() < 0;
+}
+
+/* whether to look again later: short of a target, but getting there */
+static bool kcompactd_run(void)
+{
+	unsigned long before = compact_free_blocks(COMPACT_PROACTIVE_MIN_ORDER);
+	struct zone *zone;
+	int order;
+
+	for_each_populated_zone(zone) {
+		struct compact_control cc = {
+			.order = -1,
+			.sync = false,
+			.proactive = true,
+			.zone = zone,
+		};
+
+		order = compact_proactive_order();
+		if (order < 0)
+			break;
+		/* too little free memory, reclaim has to come first */
+		if (compaction_suitable(zone, order) == COMPACT_SKIPPED)
+			continue;
+
+		INIT_LIST_HEAD(&cc.freepages);
+		INIT_LIST_HEAD(&cc.migratepages);
+		count_compact_event(COMPACTPROACTIVE);
+		compact_zone(zone, &cc);
+		VM_BUG_ON(!list_empty(&cc.freepages));
+		VM_BUG_ON(!list_empty(&cc.migratepages));
+	}
+
+	if (compact_proactive_met()) {
+		count_compact_event(COMPACTPROACTIVE_MET);
+		return false;
+	}
+	return compact_free_blocks(COMPACT_PROACTIVE_MIN_ORDER) > before;
+}
+
+static int kcompactd_fn(void *unused)
+{
+	struct sched_param param = { .sched_priority = 0 };
+	long timeout = 0;
+
+	sched_setscheduler(current, SCHED_IDLE, &param);
+	set_freezable();
+
+	while (!kthread_should_stop()) {
+		wait_event_freezable_timeout(kcompactd_wait,
+				kcompactd_kicked || kthread_should_stop(),
+				timeout);
+		kcompactd_kicked = false;
+		if (kcompactd_run())
+			timeout = msecs_to_jiffies(sysctl_compact_proactive_ms);
+		else
+			timeout = MAX_SCHEDULE_TIMEOUT;
+		kcompactd_last = jiffies;
+	}
+	return 0;
+}
+
+/*
+ * From the allocator, a high order allocation failed. Not again within
+ * compact_proactive_ms of a run, one that did not get anywhere would
+ * be repeated for every allocation.
+ */
+void compact_proactive_kick(unsigned int order)
+{
+	if (order < COMPACT_PROACTIVE_MIN_ORDER || !kcompactd ||
+	    kcompactd_kicked || !waitqueue_active(&kcompactd_wait))
+		return;
+	if (time_before(jiffies, kcompactd_last +
+			msecs_to_jiffies(sysctl_compact_proactive_ms)))
+		return;
+	kcompactd_kicked = true;
+	wake_up_interruptible(&kcompactd_wait);
+}
+
+int sysctl_compact_proactive_handler(struct ctl_table *table, int write,
+			void __user *buffer, size_t *length, loff_t *ppos)
+{
+	int ret;
+
+	ret = proc_dointvec_minmax(table, write, buffer, length, ppos);
+	if (!ret && write && kcompactd) {
+		kcompactd_kicked = true;
+		wake_up_interruptible(&kcompactd_wait);
+	}
+	return ret;
+}
+
+static int __init kcompactd_init(void)
+{
+	kcompactd = kthread_run(kcompactd_fn, NULL, "kcompactd");
+	if (IS_ERR(kcompactd)) {
+		pr_err("kcompactd: failed to start (%ld)\n",
+		       PTR_ERR(kcompactd));
+		kcompactd = NULL;
+	}
+	return 0;
+}
+module_init(kcompactd_init)
+
 #if defined(CONFIG_SYSFS) && defined(CONFIG_NUMA)
 ssize_t sysfs_compact_node(struct device *dev,
 			struct device_attribute *attr,
@@ -130,6 +130,7 @@ struct compact_control {
 					 * no longer being updated
 					 */
 	bool finished_update_migrate;
+	bool proactive;			/* kcompactd, stop at its targets */
 
 	int order;			/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
@@ -360,6 +361,16 @@ extern unsigned long vm_mmap_pgoff(struct file *, unsigned long,
 extern void set_pageblock_order(void);
 unsigned long reclaim_clean_pages_from_list(struct zone *zone,
 					    struct list_head *page_list);
+#ifdef CONFIG_BOOT_READAHEAD
+void boot_readahead_record(struct file *filp, pgoff_t start,
+			   unsigned long nr);
+#else
+static inline void boot_readahead_record(struct file *filp, pgoff_t start,
+					 unsigned long nr)
+{
+}
+#endif
+
 /* The ALLOC_WMARK bits are used as an index to zone->watermark */
 #define ALLOC_WMARK_MIN		WMARK_MIN
 #define ALLOC_WMARK_LOW		WMARK_LOW
@@ -310,6 +310,11 @@ struct mem_cgroup {
 	/* OOM-Killer disable */
 	int		oom_kill_disable;
 
+#ifdef CONFIG_ZRAM_MEMCG
+	/* compressed size of the pages of the group stored in zram */
+	atomic_long_t	zram_bytes;
+#endif
+
 	/* set when res.limit == memsw.limit */
 	bool		memsw_is_minimum;
 
@@ -1525,10 +1530,8 @@ static unsigned long mem_cgroup_margin(struct mem_cgroup *memcg)
 
 int mem_cgroup_swappiness(struct mem_cgroup *memcg)
 {
-	struct cgroup *cgrp = memcg->css.cgroup;
-
-	/* root ? */
-	if (cgrp->parent == NULL)
+	/* disabled, or root ? */
+	if (mem_cgroup_disabled() || !memcg->css.cgroup->parent)
 		return vm_swappiness;
 
 	return memcg->swappiness;
@@ -2891,6 +2894,68 @@ struct mem_cgroup *try_get_mem_cgroup_from_page(struct page *page)
 	return memcg;
 }
 
+#ifdef CONFIG_ZRAM_MEMCG
+/**
+ * mem_cgroup_zram_charge - account a page stored in zram to its group
+ * @page: the swap cache page being written out
+ * @bytes: its compressed size
+ *
+ * Returns the css id to pass to mem_cgroup_zram_uncharge() when the
+ * slot is freed, 0 if the page has no group. Like a swap entry, the
+ * charge keeps the group, and its id, until then.
+ */
+unsigned short mem_cgroup_zram_charge(struct page *page, long bytes)
+{
+	struct mem_cgroup *memcg = NULL;
+	struct page_cgroup *pc;
+
+	if (mem_cgroup_disabled())
+		return 0;
+
+	/* the page is no longer locked under writeback */
+	pc = lookup_page_cgroup(page);
+	lock_page_cgroup(pc);
+	if (PageCgroupUsed(pc) && pc->mem_cgroup) {
+		memcg = pc->mem_cgroup;
+		mem_cgroup_get(memcg);
+	}
+	unlock_page_cgroup(pc);
+	if (!memcg)
+		return 0;
+
+	atomic_long_add(bytes, &memcg->zram_bytes);
+	return css_id(&memcg->css);
+}
+
+void mem_cgroup_zram_uncharge(unsigned short id, long bytes)
+{
+	struct mem_cgroup *memcg;
+
+	rcu_read_lock();
+	memcg = mem_cgroup_lookup(id);
+	if (memcg) {
+		atomic_long_sub(bytes, &memcg->zram_bytes);
+		mem_cgroup_put(memcg);
+	}
+	rcu_read_unlock();
+}
+#endif
+
+/**
+ * mem_cgroup_task_over_soft_limit - whether the group of @p is over its
+ * soft limit, for the low memory killer to pick its victims there first
+ * @p: the task, under rcu_read_lock()
+ */
+bool mem_cgroup_task_over_soft_limit(struct task_struct *p)
+{
+	struct mem_cgroup *memcg;
+
+	if (mem_cgroup_disabled())
+		return false;
+	memcg = mem_cgroup_from_task(p);
+	return memcg && res_counter_soft_limit_excess(&memcg->res);
+}
+
 static void __mem_cgroup_commit_charge(struct mem_cgroup *memcg,
 				       struct page *page,
 				       unsigned int nr_pages,
@@ -5447,6 +5512,9 @@ static int memcg_stat_show(struct cgroup *cont, struct cftype *cft,
 	for (i = 0; i < NR_LRU_LISTS; i++)
 		seq_printf(m, "%s %lu\n", mem_cgroup_lru_names[i],
 			   mem_cgroup_nr_lru_pages(memcg, BIT(i)) * PAGE_SIZE);
+#ifdef CONFIG_ZRAM_MEMCG
+	seq_printf(m, "zram %ld\n", atomic_long_read(&memcg->zram_bytes));
+#endif
 
 	/* Hierarchical information */
 	{
@@ -5484,6 +5552,15 @@ static int memcg_stat_show(struct cgroup *cont, struct cftype *cft,
 			val += mem_cgroup_nr_lru_pages(mi, BIT(i)) * PAGE_SIZE;
 		seq_printf(m, "total_%s %llu\n", mem_cgroup_lru_names[i], val);
 	}
+#ifdef CONFIG_ZRAM_MEMCG
+	{
+		long val = 0;
+
+		for_each_mem_cgroup_tree(mi, memcg)
+			val += atomic_long_read(&mi->zram_bytes);
+		seq_printf(m, "total_zram %ld\n", val);
+	}
+#endif
 
 #ifdef CONFIG_DEBUG_VM
 	{
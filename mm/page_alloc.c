@@ -2222,6 +2222,8 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 	bool *contended_compaction, bool *deferred_compaction,
 	unsigned long *did_some_progress)
 {
+	u64 start;
+
 	if (!order)
 		return NULL;
 
@@ -2230,11 +2232,14 @@ __alloc_pages_direct_compact(gfp_t gfp_mask, unsigned int order,
 		return NULL;
 	}
 
+	start = local_clock();
 	current->flags |= PF_MEMALLOC;
 	*did_some_progress = try_to_compact_pages(zonelist, order, gfp_mask,
 						nodemask, sync_migration,
 						contended_compaction);
 	current->flags &= ~PF_MEMALLOC;
+	count_vm_events(COMPACTSTALL_US,
+			div_u64(local_clock() - start, NSEC_PER_USEC));
 
 	if (*did_some_progress != COMPACT_SKIPPED) {
 		struct page *page;
@@ -2642,6 +2647,7 @@ rebalance:
 	}
 
 nopage:
+	compact_proactive_kick(order);
 	warn_alloc_failed(gfp_mask, order, NULL);
 	return page;
 got_pg:
@@ -25,6 +25,7 @@
 #include <linux/cpuset.h>
 #include <linux/mempolicy.h>
 #include <linux/ctype.h>
+#include <linux/debugfs.h>
 #include <linux/debugobjects.h>
 #include <linux/kallsyms.h>
 #include <linux/memory.h>
@@ -5269,6 +5270,91 @@ static int __init slab_sysfs_init(void)
 __initcall(slab_sysfs_init);
 #endif /* CONFIG_SYSFS */
 
+#if defined(CONFIG_SLUB_STATS) && defined(CONFIG_DEBUG_FS)
+/*
+ * debugfs slub_stats, one line for each cache that allocated: objects
+ * allocated and freed, the share of the allocations served by the cpu
+ * slab and by the cpu partial list, the slabs taken from the page
+ * allocator, and the objects(slabs) on the cpu and node partial lists
+ * now. Rates come from two reads and the ms of the header. Caches that
+ * SLUB merged share a line, slub_nomerge keeps them apart.
+ */
+static unsigned long slub_stat_sum(struct kmem_cache *s, enum stat_item si)
+{
+	unsigned long sum = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		sum += per_cpu_ptr(s->cpu_slab, cpu)->stat[si];
+	return sum;
+}
+
+static int slub_stats_show(struct seq_file *m, void *v)
+{
+	unsigned long allocs, fast, partial, nr_partial;
+	struct kmem_cache_cpu *c;
+	struct kmem_cache *s;
+	struct page *page;
+	int cpu, node, objects, pages;
+
+	seq_printf(m, "ms %u\n", jiffies_to_msecs(jiffies - INITIAL_JIFFIES));
+	seq_puts(m, "name                     size     allocs      frees"
+		 " fast%% cpup%%   slabs cpu_partial node_partial\n");
+	mutex_lock(&slab_mutex);
+	list_for_each_entry(s, &slab_caches, list) {
+		fast = slub_stat_sum(s, ALLOC_FASTPATH);
+		allocs = fast + slub_stat_sum(s, ALLOC_SLOWPATH);
+		if (!allocs)
+			continue;
+		partial = slub_stat_sum(s, CPU_PARTIAL_ALLOC);
+
+		objects = pages = 0;
+		for_each_online_cpu(cpu) {
+			c = per_cpu_ptr(s->cpu_slab, cpu);
+			page = ACCESS_ONCE(c->partial);
+			if (page) {
+				pages += page->pages;
+				objects += page->pobjects;
+			}
+		}
+		nr_partial = 0;
+		for_each_node_state(node, N_NORMAL_MEMORY)
+			if (get_node(s, node))
+				nr_partial += get_node(s, node)->nr_partial;
+
+		seq_printf(m, "%-20s %8d %10lu %10lu %5lu %5lu %7lu",
+			   s->name, s->object_size, allocs,
+			   slub_stat_sum(s, FREE_FASTPATH) +
+			   slub_stat_sum(s, FREE_SLOWPATH),
+			   fast * 100 / allocs, partial * 100 / allocs,
+			   slub_stat_sum(s, ALLOC_SLAB));
+		seq_printf(m, " %6d(%d) %12lu\n", objects, pages, nr_partial);
+	}
+	mutex_unlock(&slab_mutex);
+	return 0;
+}
+
+static int slub_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, slub_stats_show, NULL);
+}
+
+static const struct file_operations slub_stats_fops = {
+	.open		= slub_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init slub_stats_init(void)
+{
+	debugfs_create_file("slub_stats", S_IRUSR, NULL, NULL,
+			    &slub_stats_fops);
+	return 0;
+}
+late_initcall(slub_stats_init);
+#endif /* CONFIG_SLUB_STATS && CONFIG_DEBUG_FS */
+
 /*
  * The /proc/slabinfo ABI
  */
@@ -18,6 +18,7 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/swapfile.h>
 
 #include <asm/pgtable.h>
 
@@ -148,6 +149,9 @@ void __delete_from_swap_cache(struct page *page)
 	radix_tree_delete(&address_space->page_tree, page_private(page));
 	set_page_private(page, 0);
 	ClearPageSwapCache(page);
+	/* read ahead and never looked up */
+	if (TestClearPageReadahead(page))
+		__count_vm_event(SWAP_RA_MISS);
 	address_space->nrpages--;
 	__dec_zone_page_state(page, NR_FILE_PAGES);
 	INC_CACHE_INFO(del_total);
@@ -286,21 +290,28 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(swap_address_space(entry), entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			count_vm_event(SWAP_RA_HIT);
+			atomic_inc(&swap_info[swp_type(entry)]->ra_hits);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
 }
 
-/* 
+/*
  * Locate a page of swap in physical memory, reserving swap cache space
- * and reading the disk if it is not already cached.
+ * and reading the disk if it is not already cached. A page read for
+ * readahead is marked PageReadahead until lookup_swap_cache() finds it.
  * A failure return means that either the page allocation failed or that
  * the swap entry is no longer in use.
  */
-struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
-			struct vm_area_struct *vma, unsigned long addr)
+static struct page *__read_swap_cache_async(swp_entry_t entry,
+			gfp_t gfp_mask, struct vm_area_struct *vma,
+			unsigned long addr, bool readahead)
 {
 	struct page *found_page, *new_page = NULL;
 	int err;
@@ -367,6 +378,10 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 		err = __add_to_swap_cache(new_page, entry);
 		if (likely(!err)) {
 			radix_tree_preload_end();
+			if (readahead) {
+				SetPageReadahead(new_page);
+				count_vm_event(SWAP_RA);
+			}
 			/*
 			 * Initiate read into locked page and return.
 			 */
@@ -389,6 +404,45 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
 	return found_page;
 }
 
+struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	return __read_swap_cache_async(entry, gfp_mask, vma, addr, false);
+}
+
+/*
+ * Readahead window of a solid state device, zram above all, where a page
+ * read ahead in vain is time spent decompressing it and memory taken from
+ * the working set. The window grows with the readahead pages used since
+ * the last fault, and without any shrinks to the faulting page alone
+ * unless the faults are sequential. It at most halves per fault, so that
+ * one fault between hits does not close a window that works. Rotating
+ * devices keep the page_cluster window, which costs them no seek.
+ */
+static unsigned long swapin_nr_pages(struct swap_info_struct *si,
+				     unsigned long offset)
+{
+	unsigned int max_pages = 1 << ACCESS_ONCE(page_cluster);
+	unsigned int hits, pages, last;
+
+	if (max_pages <= 1 || !(si->flags & SWP_SOLIDSTATE))
+		return max_pages;
+
+	hits = atomic_xchg(&si->ra_hits, 0);
+	if (hits)
+		pages = roundup_pow_of_two(hits + 2);
+	else if (offset == si->ra_offset + 1 || offset + 1 == si->ra_offset)
+		pages = 2;
+	else
+		pages = 1;
+	si->ra_offset = offset;
+
+	last = ACCESS_ONCE(si->ra_win) / 2;
+	pages = clamp(pages, last, max_pages);
+	si->ra_win = pages;
+	return pages;
+}
+
 /**
  * swapin_readahead - swap in pages in hope we need them soon
  * @entry: swap entry of this memory
@@ -402,6 +456,8 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * (1 << page_cluster) entries in the swap area. This method is chosen
  * because it doesn't cost us any seek time.  We also make sure to queue
  * the 'original' request together with the readahead ones...
+ * On solid state devices the block is sized by how many of the pages
+ * read ahead get used, see swapin_nr_pages().
  *
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
@@ -412,12 +468,17 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
-	unsigned long offset = swp_offset(entry);
+	unsigned long entry_offset = swp_offset(entry);
+	unsigned long offset = entry_offset;
 	unsigned long start_offset, end_offset;
-	unsigned long mask = (1UL << page_cluster) - 1;
+	unsigned long mask;
 	struct blk_plug plug;
 
-	/* Read a page_cluster sized and aligned cluster around offset. */
+	mask = swapin_nr_pages(swap_info[swp_type(entry)], offset) - 1;
+	if (!mask)
+		goto skip;
+
+	/* Read a window sized and aligned cluster around offset. */
 	start_offset = offset & ~mask;
 	end_offset = offset | mask;
 	if (!start_offset)	/* First page is swap header. */
@@ -426,8 +487,9 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	blk_start_plug(&plug);
 	for (offset = start_offset; offset <= end_offset ; offset++) {
 		/* Ok, do the async read-ahead now */
-		page = read_swap_cache_async(swp_entry(swp_type(entry), offset),
-						gfp_mask, vma, addr);
+		page = __read_swap_cache_async(
+				swp_entry(swp_type(entry), offset),
+				gfp_mask, vma, addr, offset != entry_offset);
 		if (!page)
 			continue;
 		page_cache_release(page);
@@ -435,5 +497,6 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 	blk_finish_plug(&plug);
 
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
@@ -69,6 +69,18 @@
 #include <linux/gcd.h>
 #include <linux/freezer.h>
 #include <linux/sradix-tree.h>
+#ifdef CONFIG_UKSM_POWER_THROTTLE
+#include <linux/cpufreq.h>
+#include <linux/vmpressure.h>
+#include <linux/earlysuspend.h>
+#endif
+#ifdef CONFIG_UKSM_NEON
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/ktime.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+#endif
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -573,6 +585,25 @@ static unsigned int uksm_run = 1;
 static DECLARE_WAIT_QUEUE_HEAD(uksm_thread_wait);
 static DEFINE_MUTEX(uksm_thread_mutex);
 
+#ifdef CONFIG_UKSM_POWER_THROTTLE
+/*
+ * Only scan while the cpu is at the lowest frequency its policy allows
+ * or the other cpus are idle, and not at all with the screen off,
+ * unless reclaim reports memory pressure.
+ */
+static unsigned int uksm_power_throttle = 1;
+static bool uksm_screen_off;
+/* jiffies until which memory pressure overrides the throttling */
+static unsigned long uksm_pressure_expires;
+#define UKSM_PRESSURE_HOLD	(5 * HZ)
+
+/* Active power of a core running uksmd, for pages_per_joule */
+static unsigned int uksm_scan_power_mw = 100;
+static u64 uksm_scan_cpu_ns;
+static unsigned long uksm_scan_pages_merged;
+static unsigned long long uksm_throttled_times;
+#endif
+
 /*
  * List vma_slot_new is for newly created vma_slot waiting to be added by
  * ksmd. If one cannot be added(e.g. due to it's too small), it's moved to
@@ -1353,6 +1384,42 @@ static inline u32 page_hash(struct page *page, unsigned long hash_strength,
 	return val;
 }
 
+#ifdef CONFIG_UKSM_NEON
+/* Set at boot when the cpu has NEON, see uksm_neon_init() */
+static bool uksm_use_neon __read_mostly;
+
+static inline int uksm_page_cmp(const void *s1, const void *s2)
+{
+	int ret;
+
+	if (!uksm_use_neon || in_interrupt())
+		return memcmp(s1, s2, PAGE_SIZE);
+
+	kernel_neon_begin();
+	ret = uksm_neon_pages_differ(s1, s2);
+	kernel_neon_end();
+
+	return ret;
+}
+
+static inline int uksm_page_zero(const void *s1)
+{
+	int ret;
+
+	if (!uksm_use_neon || in_interrupt())
+		return is_full_zero((void *)s1, PAGE_SIZE);
+
+	kernel_neon_begin();
+	ret = uksm_neon_page_zero(s1);
+	kernel_neon_end();
+
+	return ret;
+}
+#else
+#define uksm_page_cmp(s1, s2)	memcmp(s1, s2, PAGE_SIZE)
+#define uksm_page_zero(s1)	is_full_zero(s1, PAGE_SIZE)
+#endif
+
 static int memcmp_pages(struct page *page1, struct page *page2,
 			int cost_accounting)
 {
@@ -1361,7 +1428,7 @@ static int memcmp_pages(struct page *page1, struct page *page2,
 
 	addr1 = kmap_atomic(page1);
 	addr2 = kmap_atomic(page2);
-	ret = memcmp(addr1, addr2, PAGE_SIZE);
+	ret = uksm_page_cmp(addr1, addr2);
 	kunmap_atomic(addr2);
 	kunmap_atomic(addr1);
 
@@ -1382,7 +1449,7 @@ static inline int is_page_full_zero(struct page *page)
 	int ret;
 
 	addr = kmap_atomic(page);
-	ret = is_full_zero(addr, PAGE_SIZE);
+	ret = uksm_page_zero(addr);
 	kunmap_atomic(addr);
 
 	return ret;
@@ -4594,6 +4661,130 @@ static int ksmd_should_run(void)
 	return uksm_run & UKSM_RUN_MERGE;
 }
 
+#ifdef CONFIG_UKSM_POWER_THROTTLE
+static inline bool uksm_under_pressure(void)
+{
+	return time_before(jiffies, uksm_pressure_expires);
+}
+
+/* Nothing to do until the screen is back on or memory gets tight */
+static bool uksm_power_parked(void)
+{
+	return uksm_power_throttle && uksm_screen_off &&
+		!uksm_under_pressure();
+}
+
+static bool uksm_cpu_at_min_opp(void)
+{
+	struct cpufreq_policy *policy;
+	bool ret = true;
+
+	policy = cpufreq_cpu_get(raw_smp_processor_id());
+	if (policy) {
+		ret = policy->cur <= policy->min;
+		cpufreq_cpu_put(policy);
+	}
+
+	return ret;
+}
+
+static bool uksm_other_cpus_idle(void)
+{
+	int this_cpu = raw_smp_processor_id();
+	int cpu;
+
+	for_each_online_cpu(cpu) {
+		if (cpu != this_cpu && !idle_cpu(cpu))
+			return false;
+	}
+
+	return true;
+}
+
+static bool uksm_power_allows_scan(void)
+{
+	if (!uksm_power_throttle || uksm_under_pressure())
+		return true;
+
+	return uksm_cpu_at_min_opp() || uksm_other_cpus_idle();
+}
+
+static void uksm_power_do_scan(void)
+{
+	unsigned long long runtime;
+	unsigned long sharing = uksm_pages_sharing;
+
+	if (!uksm_power_allows_scan()) {
+		uksm_throttled_times++;
+		return;
+	}
+
+	runtime = task_sched_runtime(current);
+	uksm_do_scan();
+	uksm_scan_cpu_ns += task_sched_runtime(current) - runtime;
+	if (uksm_pages_sharing > sharing)
+		uksm_scan_pages_merged += uksm_pages_sharing - sharing;
+}
+
+static int uksm_vmpressure_notify(struct notifier_block *nb,
+				  unsigned long level, void *data)
+{
+	if (level < VMPRESSURE_MEDIUM)
+		return NOTIFY_OK;
+
+	uksm_pressure_expires = jiffies + UKSM_PRESSURE_HOLD;
+	if (uksm_screen_off)
+		wake_up_interruptible(&uksm_thread_wait);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block uksm_vmpressure_nb = {
+	.notifier_call = uksm_vmpressure_notify,
+};
+
+#ifdef CONFIG_HAS_EARLYSUSPEND
+static void uksm_early_suspend(struct early_suspend *h)
+{
+	uksm_screen_off = true;
+}
+
+static void uksm_late_resume(struct early_suspend *h)
+{
+	uksm_screen_off = false;
+	wake_up_interruptible(&uksm_thread_wait);
+}
+
+static struct early_suspend uksm_early_suspend_desc = {
+	.level = EARLY_SUSPEND_LEVEL_BLANK_SCREEN,
+	.suspend = uksm_early_suspend,
+	.resume = uksm_late_resume,
+};
+#endif
+
+static void __init uksm_power_init(void)
+{
+	vmpressure_register_notifier(&uksm_vmpressure_nb);
+#ifdef CONFIG_HAS_EARLYSUSPEND
+	register_early_suspend(&uksm_early_suspend_desc);
+#endif
+}
+#else
+static inline bool uksm_power_parked(void)
+{
+	return false;
+}
+
+static inline void uksm_power_do_scan(void)
+{
+	uksm_do_scan();
+}
+
+static inline void uksm_power_init(void)
+{
+}
+#endif
+
 static int uksm_scan_thread(void *nothing)
 {
 	long timeout = 60 * HZ;
@@ -4614,8 +4805,13 @@ static int uksm_scan_thread(void *nothing)
 			continue;
 		}
 
-		if (likely(ksmd_should_run())) {
-			uksm_do_scan();
+		if (unlikely(uksm_power_parked())) {
+			mutex_unlock(&uksm_thread_mutex);
+			wait_event_freezable(uksm_thread_wait,
+				!uksm_power_parked() || kthread_should_stop());
+			timeout = uksm_sleep_jiffies;
+		} else if (likely(ksmd_should_run())) {
+			uksm_power_do_scan();
 			mutex_unlock(&uksm_thread_mutex);
 			timeout = uksm_sleep_jiffies - jiffies % uksm_sleep_jiffies;
 			uksm_sleep_times++;
@@ -5382,6 +5578,92 @@ static ssize_t sleep_times_show(struct kobject *kobj,
 }
 UKSM_ATTR_RO(sleep_times);
 
+#ifdef CONFIG_UKSM_POWER_THROTTLE
+static ssize_t power_throttle_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", uksm_power_throttle);
+}
+
+static ssize_t power_throttle_store(struct kobject *kobj,
+				    struct kobj_attribute *attr,
+				    const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || val > 1)
+		return -EINVAL;
+
+	uksm_power_throttle = val;
+	wake_up_interruptible(&uksm_thread_wait);
+
+	return count;
+}
+UKSM_ATTR(power_throttle);
+
+static ssize_t scan_power_mw_show(struct kobject *kobj,
+				  struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", uksm_scan_power_mw);
+}
+
+static ssize_t scan_power_mw_store(struct kobject *kobj,
+				   struct kobj_attribute *attr,
+				   const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = strict_strtoul(buf, 10, &val);
+	if (err || !val || val > UINT_MAX)
+		return -EINVAL;
+
+	uksm_scan_power_mw = val;
+
+	return count;
+}
+UKSM_ATTR(scan_power_mw);
+
+static ssize_t scan_cpu_msecs_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n",
+		       div_u64(uksm_scan_cpu_ns, NSEC_PER_MSEC));
+}
+UKSM_ATTR_RO(scan_cpu_msecs);
+
+static ssize_t scan_pages_merged_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", uksm_scan_pages_merged);
+}
+UKSM_ATTR_RO(scan_pages_merged);
+
+/* merged / (cpu_ns * mW * 1e-12 J) */
+static ssize_t pages_per_joule_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	u64 uj = div_u64(uksm_scan_cpu_ns * uksm_scan_power_mw,
+			 NSEC_PER_MSEC);
+
+	if (!uj)
+		return sprintf(buf, "0\n");
+
+	return sprintf(buf, "%llu\n",
+		div64_u64((u64)uksm_scan_pages_merged * USEC_PER_SEC, uj));
+}
+UKSM_ATTR_RO(pages_per_joule);
+
+static ssize_t throttled_times_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%llu\n", uksm_throttled_times);
+}
+UKSM_ATTR_RO(throttled_times);
+#endif
+
 
 static struct attribute *uksm_attrs[] = {
 	&max_cpu_percentage_attr.attr,
@@ -5401,6 +5683,14 @@ static struct attribute *uksm_attrs[] = {
 	&cpu_ratios_attr.attr,
 	&cpu_scales_attr.attr,
 	&eval_intervals_attr.attr,
+#ifdef CONFIG_UKSM_POWER_THROTTLE
+	&power_throttle_attr.attr,
+	&scan_power_mw_attr.attr,
+	&scan_cpu_msecs_attr.attr,
+	&scan_pages_merged_attr.attr,
+	&pages_per_joule_attr.attr,
+	&throttled_times_attr.attr,
+#endif
 	NULL,
 };
 
@@ -5695,6 +5985,120 @@ struct page *ksm_might_need_to_copy(struct page *page,
 	return new_page;
 }
 
+#ifdef CONFIG_UKSM_NEON
+#ifdef CONFIG_DEBUG_FS
+#define UKSM_NEON_BENCH_LOOPS	1024
+
+static u64 uksm_neon_bench_one(int neon, int zero, void *a, void *b)
+{
+	int i, ret = 0;
+	ktime_t start;
+	u64 ns;
+
+	start = ktime_get();
+	if (neon)
+		kernel_neon_begin();
+	for (i = 0; i < UKSM_NEON_BENCH_LOOPS; i++) {
+		if (neon)
+			ret |= zero ? !uksm_neon_page_zero(a) :
+				uksm_neon_pages_differ(a, b);
+		else
+			ret |= zero ? !is_full_zero(a, PAGE_SIZE) :
+				memcmp(a, b, PAGE_SIZE);
+	}
+	if (neon)
+		kernel_neon_end();
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	/* identical and zero pages: any mismatch means a broken path */
+	WARN_ON_ONCE(ret);
+
+	return div_u64(ns, UKSM_NEON_BENCH_LOOPS);
+}
+
+static int uksm_neon_bench_show(struct seq_file *m, void *v)
+{
+	void *a, *b, *z;
+	u32 hash = 0;
+	u64 ns;
+	int i;
+
+	a = (void *)__get_free_page(GFP_KERNEL);
+	b = (void *)__get_free_page(GFP_KERNEL);
+	z = (void *)get_zeroed_page(GFP_KERNEL);
+	if (!a || !b || !z)
+		goto out;
+
+	get_random_bytes(a, PAGE_SIZE);
+	memcpy(b, a, PAGE_SIZE);
+
+	seq_printf(m, "neon: %s\n", uksm_use_neon ? "on" : "off");
+	if (elf_hwcap & HWCAP_NEON) {
+		seq_printf(m, "compare scalar: %llu ns/page\n",
+			   uksm_neon_bench_one(0, 0, a, b));
+		seq_printf(m, "compare neon:   %llu ns/page\n",
+			   uksm_neon_bench_one(1, 0, a, b));
+		seq_printf(m, "zero scalar:    %llu ns/page\n",
+			   uksm_neon_bench_one(0, 1, z, NULL));
+		seq_printf(m, "zero neon:      %llu ns/page\n",
+			   uksm_neon_bench_one(1, 1, z, NULL));
+	}
+
+	/* the hash has no NEON path, shown as the cost the compare saves */
+	ns = ktime_to_ns(ktime_get());
+	for (i = 0; i < UKSM_NEON_BENCH_LOOPS; i++)
+		hash += random_sample_hash(a, HASH_STRENGTH_FULL);
+	ns = ktime_to_ns(ktime_get()) - ns;
+	seq_printf(m, "hash full:      %llu ns/page (%08x)\n",
+		   div_u64(ns, UKSM_NEON_BENCH_LOOPS), hash);
+out:
+	free_page((unsigned long)z);
+	free_page((unsigned long)b);
+	free_page((unsigned long)a);
+	return 0;
+}
+
+static int uksm_neon_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uksm_neon_bench_show, NULL);
+}
+
+static const struct file_operations uksm_neon_bench_fops = {
+	.open		= uksm_neon_bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init uksm_neon_bench_init(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("uksm", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return -ENOMEM;
+	if (!debugfs_create_file("neon_bench", S_IRUSR, dir, NULL,
+				 &uksm_neon_bench_fops)) {
+		debugfs_remove(dir);
+		return -ENOMEM;
+	}
+	return 0;
+}
+#else
+static inline int uksm_neon_bench_init(void) { return 0; }
+#endif
+
+static void __init uksm_neon_init(void)
+{
+	uksm_use_neon = !!(elf_hwcap & HWCAP_NEON);
+	printk(KERN_INFO "uksm: page compare uses %s\n",
+	       uksm_use_neon ? "neon" : "scalar code");
+	uksm_neon_bench_init();
+}
+#else
+static inline void uksm_neon_init(void) { }
+#endif
+
 static int __init uksm_init(void)
 {
 	struct task_struct *uksm_thread;
@@ -5747,6 +6151,8 @@ static int __init uksm_init(void)
 	 */
 	hotplug_memory_notifier(uksm_memory_callback, 100);
 #endif
+	uksm_power_init();
+	uksm_neon_init();
 	return 0;
 
 out_free:
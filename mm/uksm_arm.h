@@ -96,4 +96,10 @@ static inline int is_full_zero(void *s1, size_t n)
 	return !n;
 }
 
+#ifdef CONFIG_UKSM_NEON
+/* mm/uksm_neon.c, call between kernel_neon_begin() and kernel_neon_end() */
+extern int uksm_neon_pages_differ(const void *s1, const void *s2);
+extern int uksm_neon_page_zero(const void *s1);
+#endif
+
 #endif
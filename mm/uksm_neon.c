@@ -0,0 +1,106 @@
+/*
+ * NEON page compare and zero check for UKSM
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Callers must hold kernel_neon_begin(). Only equality is reported: UKSM
+ * orders its trees by hash and uses the compare to confirm a match.
+ */
+
+#include <linux/types.h>
+#include <asm/page.h>
+#include "uksm_arm.h"
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+/*
+ * 128 bytes are folded per iteration, so that the NEON to core register
+ * transfer, which stalls the pipeline, is paid once per two cache lines.
+ */
+#define UKSM_NEON_STEP	128
+
+int uksm_neon_pages_differ(const void *s1, const void *s2)
+{
+	unsigned long n = PAGE_SIZE / UKSM_NEON_STEP;
+	unsigned long lo, hi;
+
+	asm volatile(
+	"1:	pld	[%2, #256]\n"
+	"	pld	[%3, #256]\n"
+	"	vld1.8	{d0-d3}, [%2]!\n"
+	"	vld1.8	{d4-d7}, [%2]!\n"
+	"	vld1.8	{d16-d19}, [%3]!\n"
+	"	vld1.8	{d20-d23}, [%3]!\n"
+	"	veor	q0, q0, q8\n"
+	"	veor	q1, q1, q9\n"
+	"	veor	q2, q2, q10\n"
+	"	veor	q3, q3, q11\n"
+	"	vorr	q12, q0, q1\n"
+	"	vorr	q13, q2, q3\n"
+	"	vld1.8	{d0-d3}, [%2]!\n"
+	"	vld1.8	{d4-d7}, [%2]!\n"
+	"	vld1.8	{d16-d19}, [%3]!\n"
+	"	vld1.8	{d20-d23}, [%3]!\n"
+	"	veor	q0, q0, q8\n"
+	"	veor	q1, q1, q9\n"
+	"	veor	q2, q2, q10\n"
+	"	veor	q3, q3, q11\n"
+	"	vorr	q0, q0, q1\n"
+	"	vorr	q2, q2, q3\n"
+	"	vorr	q12, q12, q13\n"
+	"	vorr	q0, q0, q2\n"
+	"	vorr	q0, q0, q12\n"
+	"	vorr	d0, d0, d1\n"
+	"	vmov	%0, %1, d0\n"
+	"	orrs	%0, %0, %1\n"
+	"	bne	2f\n"
+	"	subs	%4, %4, #1\n"
+	"	bne	1b\n"
+	"2:\n"
+	: "=&r" (lo), "=&r" (hi), "+r" (s1), "+r" (s2), "+r" (n)
+	:
+	: "cc", "memory",
+	  "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+	  "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23",
+	  "d24", "d25", "d26", "d27");
+
+	return lo != 0;
+}
+
+int uksm_neon_page_zero(const void *s1)
+{
+	unsigned long n = PAGE_SIZE / UKSM_NEON_STEP;
+	unsigned long lo, hi;
+
+	asm volatile(
+	"1:	pld	[%2, #256]\n"
+	"	vld1.8	{d0-d3}, [%2]!\n"
+	"	vld1.8	{d4-d7}, [%2]!\n"
+	"	vld1.8	{d16-d19}, [%2]!\n"
+	"	vld1.8	{d20-d23}, [%2]!\n"
+	"	vorr	q0, q0, q1\n"
+	"	vorr	q2, q2, q3\n"
+	"	vorr	q8, q8, q9\n"
+	"	vorr	q10, q10, q11\n"
+	"	vorr	q0, q0, q2\n"
+	"	vorr	q8, q8, q10\n"
+	"	vorr	q0, q0, q8\n"
+	"	vorr	d0, d0, d1\n"
+	"	vmov	%0, %1, d0\n"
+	"	orrs	%0, %0, %1\n"
+	"	bne	2f\n"
+	"	subs	%3, %3, #1\n"
+	"	bne	1b\n"
+	"2:\n"
+	: "=&r" (lo), "=&r" (hi), "+r" (s1), "+r" (n)
+	:
+	: "cc", "memory",
+	  "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7",
+	  "d16", "d17", "d18", "d19", "d20", "d21", "d22", "d23");
+
+	return !lo;
+}
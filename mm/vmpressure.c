@@ -21,6 +21,7 @@
 #include <linux/eventfd.h>
 #include <linux/swap.h>
 #include <linux/printk.h>
+#include <linux/notifier.h>
 #include <linux/vmpressure.h>
 
 /*
@@ -74,6 +75,7 @@ static struct vmpressure *work_to_vmpressure(struct work_struct *work)
 	return container_of(work, struct vmpressure, work);
 }
 
+#ifdef CONFIG_MEMCG
 static struct vmpressure *cg_to_vmpressure(struct cgroup *cg)
 {
 	return css_to_vmpressure(cgroup_subsys_state(cg, mem_cgroup_subsys_id));
@@ -90,12 +92,7 @@ static struct vmpressure *vmpressure_parent(struct vmpressure *vmpr)
 	return memcg_to_vmpressure(memcg);
 }
 
-enum vmpressure_levels {
-	VMPRESSURE_LOW = 0,
-	VMPRESSURE_MEDIUM,
-	VMPRESSURE_CRITICAL,
-	VMPRESSURE_NUM_LEVELS,
-};
+#endif
 
 static const char * const vmpressure_str_levels[] = {
 	[VMPRESSURE_LOW] = "low",
@@ -140,6 +137,32 @@ struct vmpressure_event {
 	struct list_head node;
 };
 
+static bool vmpressure_take_window(struct vmpressure *vmpr,
+				   unsigned long *scanned,
+				   unsigned long *reclaimed)
+{
+	/*
+	 * Several contexts might be calling vmpressure(), so it is
+	 * possible that the work was rescheduled again before the old
+	 * work context cleared the counters. In that case we will run
+	 * just after the old work returns, but then scanned might be zero
+	 * here. No need for any locks here since we don't care if
+	 * vmpr->reclaimed is in sync.
+	 */
+	if (!vmpr->scanned)
+		return false;
+
+	mutex_lock(&vmpr->sr_lock);
+	*scanned = vmpr->scanned;
+	*reclaimed = vmpr->reclaimed;
+	vmpr->scanned = 0;
+	vmpr->reclaimed = 0;
+	mutex_unlock(&vmpr->sr_lock);
+
+	return true;
+}
+
+#ifdef CONFIG_MEMCG
 static bool vmpressure_event(struct vmpressure *vmpr,
 			     unsigned long scanned, unsigned long reclaimed)
 {
@@ -169,24 +192,9 @@ static void vmpressure_work_fn(struct work_struct *work)
 	unsigned long scanned;
 	unsigned long reclaimed;
 
-	/*
-	 * Several contexts might be calling vmpressure(), so it is
-	 * possible that the work was rescheduled again before the old
-	 * work context cleared the counters. In that case we will run
-	 * just after the old work returns, but then scanned might be zero
-	 * here. No need for any locks here since we don't care if
-	 * vmpr->reclaimed is in sync.
-	 */
-	if (!vmpr->scanned)
+	if (!vmpressure_take_window(vmpr, &scanned, &reclaimed))
 		return;
 
-	mutex_lock(&vmpr->sr_lock);
-	scanned = vmpr->scanned;
-	reclaimed = vmpr->reclaimed;
-	vmpr->scanned = 0;
-	vmpr->reclaimed = 0;
-	mutex_unlock(&vmpr->sr_lock);
-
 	do {
 		if (vmpressure_event(vmpr, scanned, reclaimed))
 			break;
@@ -196,6 +204,71 @@ static void vmpressure_work_fn(struct work_struct *work)
 		 */
 	} while ((vmpr = vmpressure_parent(vmpr)));
 }
+#endif
+
+#ifdef CONFIG_VMPRESSURE_NOTIFIER
+/*
+ * Pressure of the global (non-memcg) reclaim, reported to in-kernel
+ * listeners such as the lowmemorykiller.
+ */
+static struct vmpressure global_vmpressure;
+static BLOCKING_NOTIFIER_HEAD(vmpressure_notifier);
+
+static void vmpressure_global_work_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = work_to_vmpressure(work);
+	unsigned long scanned;
+	unsigned long reclaimed;
+
+	if (!vmpressure_take_window(vmpr, &scanned, &reclaimed))
+		return;
+
+	blocking_notifier_call_chain(&vmpressure_notifier,
+				vmpressure_calc_level(scanned, reclaimed),
+				NULL);
+}
+
+/**
+ * vmpressure_register_notifier() - Get global memory pressure levels
+ * @nb:		notifier block, called with the enum vmpressure_levels value
+ *		as the action once per window of global reclaim
+ *
+ * The callbacks run from a workqueue and may sleep.
+ */
+int vmpressure_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(vmpressure_register_notifier);
+
+int vmpressure_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(vmpressure_unregister_notifier);
+
+static int __init vmpressure_global_init(void)
+{
+	vmpressure_init(&global_vmpressure);
+	INIT_WORK(&global_vmpressure.work, vmpressure_global_work_fn);
+	return 0;
+}
+core_initcall(vmpressure_global_init);
+#endif
+
+static void vmpressure_account(struct vmpressure *vmpr,
+			       unsigned long scanned, unsigned long reclaimed)
+{
+	mutex_lock(&vmpr->sr_lock);
+	vmpr->scanned += scanned;
+	vmpr->reclaimed += reclaimed;
+	scanned = vmpr->scanned;
+	mutex_unlock(&vmpr->sr_lock);
+
+	if (scanned < vmpressure_win || work_pending(&vmpr->work))
+		return;
+	schedule_work(&vmpr->work);
+}
 
 /**
  * vmpressure() - Account memory pressure through scanned/reclaimed ratio
@@ -213,8 +286,6 @@ static void vmpressure_work_fn(struct work_struct *work)
 void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
 		unsigned long scanned, unsigned long reclaimed)
 {
-	struct vmpressure *vmpr = memcg_to_vmpressure(memcg);
-
 	/*
 	 * Here we only want to account pressure that userland is able to
 	 * help us with. For example, suppose that DMA zone is under
@@ -240,15 +311,13 @@ void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
 	if (!scanned)
 		return;
 
-	mutex_lock(&vmpr->sr_lock);
-	vmpr->scanned += scanned;
-	vmpr->reclaimed += reclaimed;
-	scanned = vmpr->scanned;
-	mutex_unlock(&vmpr->sr_lock);
-
-	if (scanned < vmpressure_win || work_pending(&vmpr->work))
-		return;
-	schedule_work(&vmpr->work);
+#ifdef CONFIG_MEMCG
+	vmpressure_account(memcg_to_vmpressure(memcg), scanned, reclaimed);
+#endif
+#ifdef CONFIG_VMPRESSURE_NOTIFIER
+	if (!memcg)
+		vmpressure_account(&global_vmpressure, scanned, reclaimed);
+#endif
 }
 
 /**
@@ -281,6 +350,7 @@ void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
 	vmpressure(gfp, memcg, vmpressure_win, 0);
 }
 
+#ifdef CONFIG_MEMCG
 /**
  * vmpressure_register_event() - Bind vmpressure notifications to an eventfd
  * @cg:		cgroup that is interested in vmpressure notifications
@@ -358,6 +428,8 @@ void vmpressure_unregister_event(struct cgroup *cg, struct cftype *cft,
 	mutex_unlock(&vmpr->events_lock);
 }
 
+#endif
+
 /**
  * vmpressure_init() - Initialize vmpressure control structure
  * @vmpr:	Structure to be initialized
@@ -370,5 +442,7 @@ void vmpressure_init(struct vmpressure *vmpr)
 	mutex_init(&vmpr->sr_lock);
 	mutex_init(&vmpr->events_lock);
 	INIT_LIST_HEAD(&vmpr->events);
+#ifdef CONFIG_MEMCG
 	INIT_WORK(&vmpr->work, vmpressure_work_fn);
+#endif
 }
@@ -786,6 +786,10 @@ const char * const vmstat_text[] = {
 
 	"pgrotated",
 
+	"swap_ra",
+	"swap_ra_hit",
+	"swap_ra_miss",
+
 #ifdef CONFIG_NUMA_BALANCING
 	"numa_pte_updates",
 	"numa_huge_pte_updates",
@@ -804,6 +808,9 @@ const char * const vmstat_text[] = {
 	"compact_stall",
 	"compact_fail",
 	"compact_success",
+	"compact_stall_us",
+	"compact_proactive",
+	"compact_proactive_met",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -0,0 +1,224 @@
+/*
+ * Shared budget for the compressed memory backends
+ *
+ * zcache keeps clean page cache pages (cleancache) and zram keeps
+ * anonymous pages; each charges the pageframes backing its compressed
+ * data here, against a cap of max_percent of RAM. An anonymous charge
+ * that does not fit evicts compressed file pages first: they are clean
+ * and can be read back from disk, while an anonymous page that cannot
+ * be stored ends in a low memory kill. File charges are never allowed
+ * to push out anonymous data.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU General Public License version 2 as published
+ * by the Free Software Foundation.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/mm.h>
+#include <linux/swap.h>
+#include <linux/rwsem.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/lowmemorykiller.h>
+#include <linux/zpolicy.h>
+
+static LIST_HEAD(zpolicy_clients);
+static DECLARE_RWSEM(zpolicy_rwsem);
+
+static atomic_long_t zpolicy_charged[NR_ZPOLICY_CLASSES];
+static atomic_long_t zpolicy_evicted[NR_ZPOLICY_CLASSES];
+static atomic_long_t zpolicy_rejected[NR_ZPOLICY_CLASSES];
+
+/* cap on all compressed backing pageframes, in percent of RAM; 0 is off */
+static unsigned int zpolicy_max_percent __read_mostly = 25;
+
+static unsigned long zpolicy_limit(void)
+{
+	return totalram_pages / 100 * ACCESS_ONCE(zpolicy_max_percent);
+}
+
+static unsigned long zpolicy_total(void)
+{
+	unsigned long total = 0;
+	int i;
+
+	for (i = 0; i < NR_ZPOLICY_CLASSES; i++)
+		total += atomic_long_read(&zpolicy_charged[i]);
+	return total;
+}
+
+void zpolicy_register(struct zpolicy_client *client)
+{
+	down_write(&zpolicy_rwsem);
+	list_add_tail(&client->list, &zpolicy_clients);
+	up_write(&zpolicy_rwsem);
+}
+EXPORT_SYMBOL_GPL(zpolicy_register);
+
+void zpolicy_unregister(struct zpolicy_client *client)
+{
+	down_write(&zpolicy_rwsem);
+	list_del(&client->list);
+	up_write(&zpolicy_rwsem);
+}
+EXPORT_SYMBOL_GPL(zpolicy_unregister);
+
+unsigned long zpolicy_pages(enum zpolicy_class class)
+{
+	return atomic_long_read(&zpolicy_charged[class]);
+}
+EXPORT_SYMBOL_GPL(zpolicy_pages);
+
+/*
+ * Ask the clients of @class to drop up to @nr pageframes. The freed
+ * pageframes are uncharged by the clients themselves.
+ */
+unsigned long zpolicy_evict(enum zpolicy_class class, unsigned long nr)
+{
+	struct zpolicy_client *client;
+	unsigned long freed = 0;
+
+	if (!down_read_trylock(&zpolicy_rwsem))
+		return 0;
+	list_for_each_entry(client, &zpolicy_clients, list) {
+		if (freed >= nr)
+			break;
+		if (client->class != class || !client->evict)
+			continue;
+		freed += client->evict(client, nr - freed);
+	}
+	up_read(&zpolicy_rwsem);
+
+	atomic_long_add(freed, &zpolicy_evicted[class]);
+	return freed;
+}
+EXPORT_SYMBOL_GPL(zpolicy_evict);
+
+/*
+ * Charge @nr backing pageframes to @class. Returns false, charging
+ * nothing, when they do not fit in the budget; the caller then has to
+ * give up on storing the page.
+ */
+bool zpolicy_charge(enum zpolicy_class class, unsigned long nr)
+{
+	unsigned long limit = zpolicy_limit();
+	unsigned long total;
+
+	if (!limit)
+		goto charge;
+
+	total = zpolicy_total() + nr;
+	if (total <= limit)
+		goto charge;
+
+	if (class == ZPOLICY_ANON) {
+		zpolicy_evict(ZPOLICY_FILE, total - limit);
+		if (zpolicy_total() + nr <= limit)
+			goto charge;
+	}
+
+	atomic_long_inc(&zpolicy_rejected[class]);
+	return false;
+
+charge:
+	atomic_long_add(nr, &zpolicy_charged[class]);
+	return true;
+}
+EXPORT_SYMBOL_GPL(zpolicy_charge);
+
+void zpolicy_uncharge(enum zpolicy_class class, unsigned long nr)
+{
+	atomic_long_sub(nr, &zpolicy_charged[class]);
+}
+EXPORT_SYMBOL_GPL(zpolicy_uncharge);
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+/*
+ * Compressed file pages count as reclaimable for the LMK, and are
+ * dropped before it picks a process to kill.
+ */
+static int zpolicy_lmk_cbk(struct reg_lmk *reg_lmk, struct lmk_op *op)
+{
+	switch (op->op) {
+	case LMK_OP_PAGES:
+		return zpolicy_pages(ZPOLICY_FILE);
+	case LMK_OP_RECLAIM:
+		return zpolicy_evict(ZPOLICY_FILE, op->nr);
+	}
+	return 0;
+}
+
+static struct reg_lmk zpolicy_reg_lmk = {
+	.cbk = zpolicy_lmk_cbk,
+};
+#endif
+
+#ifdef CONFIG_SYSFS
+static ssize_t max_percent_show(struct kobject *kobj,
+				struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", zpolicy_max_percent);
+}
+
+static ssize_t max_percent_store(struct kobject *kobj,
+				 struct kobj_attribute *attr,
+				 const char *buf, size_t count)
+{
+	unsigned long val;
+	int err;
+
+	err = kstrtoul(buf, 10, &val);
+	if (err || val > 100)
+		return -EINVAL;
+
+	zpolicy_max_percent = val;
+	return count;
+}
+static struct kobj_attribute max_percent_attr =
+	__ATTR(max_percent, 0644, max_percent_show, max_percent_store);
+
+#define ZPOLICY_CLASS_ATTR(_name, _array, _class)			\
+static ssize_t _name##_show(struct kobject *kobj,			\
+			    struct kobj_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%ld\n",					\
+		       atomic_long_read(&_array[_class]));		\
+}									\
+static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+
+ZPOLICY_CLASS_ATTR(file_pages, zpolicy_charged, ZPOLICY_FILE);
+ZPOLICY_CLASS_ATTR(anon_pages, zpolicy_charged, ZPOLICY_ANON);
+ZPOLICY_CLASS_ATTR(file_evicted, zpolicy_evicted, ZPOLICY_FILE);
+ZPOLICY_CLASS_ATTR(file_rejected, zpolicy_rejected, ZPOLICY_FILE);
+ZPOLICY_CLASS_ATTR(anon_rejected, zpolicy_rejected, ZPOLICY_ANON);
+
+static struct attribute *zpolicy_attrs[] = {
+	&max_percent_attr.attr,
+	&file_pages_attr.attr,
+	&anon_pages_attr.attr,
+	&file_evicted_attr.attr,
+	&file_rejected_attr.attr,
+	&anon_rejected_attr.attr,
+	NULL,
+};
+
+static struct attribute_group zpolicy_attr_group = {
+	.attrs = zpolicy_attrs,
+	.name = "zpolicy",
+};
+#endif /* CONFIG_SYSFS */
+
+static int __init zpolicy_init(void)
+{
+#ifdef CONFIG_SYSFS
+	if (sysfs_create_group(mm_kobj, &zpolicy_attr_group))
+		pr_err("zpolicy: register sysfs failed\n");
+#endif
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+	register_lmk(&zpolicy_reg_lmk);
+#endif
+	return 0;
+}
+late_initcall(zpolicy_init);
@@ -20,6 +20,7 @@
 #include <linux/netfilter/x_tables.h>
 #include <linux/netfilter/xt_qtaguid.h>
 #include <linux/ratelimit.h>
+#include <linux/rculist.h>
 #include <linux/seq_file.h>
 #include <linux/skbuff.h>
 #include <linux/workqueue.h>
@@ -140,6 +141,15 @@ static struct rb_root proc_qtu_data_tree = RB_ROOT;
 /* No proc_qtu_data_tree_lock; use uid_tag_data_tree_lock */
 
 static struct qtaguid_event_counts qtu_events;
+
+/*
+ * Each socket caches the tag_stat and counter set of its last packet in
+ * sk->sk_qtaguid. Anything that could change them bumps qtu_sk_gen,
+ * which drops all the caches at once. A cache being written holds
+ * QTU_SK_BUSY, 0 is an empty one; qtu_sk_gen skips both.
+ */
+#define QTU_SK_BUSY ((u32)-1)
+static atomic_t qtu_sk_gen = ATOMIC_INIT(1);
 /*----------------------------------------------*/
 static bool can_manipulate_uids(void)
 {
@@ -163,6 +173,55 @@ static bool can_read_other_uid_stats(uid_t uid)
 		|| unlikely(current_fsuid() == xt_qtaguid_ctrl_file->uid);
 }
 
+static void qtu_sk_cache_invalidate(void)
+{
+	u32 gen;
+
+	do {
+		gen = atomic_inc_return(&qtu_sk_gen);
+	} while (!gen || gen == QTU_SK_BUSY);
+}
+
+/* Called under rcu_read_lock(), which keeps the cached tag_stat alive */
+static struct tag_stat *qtu_sk_cache_get(const struct sock *sk,
+					 struct iface_stat *iface_entry,
+					 uid_t uid, int *active_set)
+{
+	const struct sk_qtaguid_cache *c = &sk->sk_qtaguid;
+	struct tag_stat *ts;
+	u32 gen = ACCESS_ONCE(c->gen);
+
+	if (gen != (u32)atomic_read(&qtu_sk_gen))
+		return NULL;
+	smp_rmb();
+	ts = ACCESS_ONCE(c->stat);
+	if (c->owner != sk || c->uid != uid)
+		return NULL;
+	*active_set = c->set;
+	smp_rmb();
+	if (ACCESS_ONCE(c->gen) != gen || ts->iface != iface_entry)
+		return NULL;
+	return ts;
+}
+
+/* gen is qtu_sk_gen from before the lookups that found ts */
+static void qtu_sk_cache_set(const struct sock *sk, u32 gen,
+			     struct tag_stat *ts, uid_t uid, int active_set)
+{
+	struct sk_qtaguid_cache *c = &((struct sock *)sk)->sk_qtaguid;
+	u32 old = ACCESS_ONCE(c->gen);
+
+	/* another cpu is writing it */
+	if (old == QTU_SK_BUSY || cmpxchg(&c->gen, old, QTU_SK_BUSY) != old)
+		return;
+	c->stat = ts;
+	c->owner = sk;
+	c->uid = uid;
+	c->set = active_set;
+	smp_wmb();
+	c->gen = gen;
+}
+
 static inline void dc_add_byte_packets(struct data_counters *counters, int set,
 				  enum ifs_tx_rx direction,
 				  enum ifs_proto ifs_proto,
@@ -636,7 +695,7 @@ static int get_active_counter_set(tag_t tag)
 
 /*
  * Find the entry for tracking the specified interface.
- * Caller must hold iface_stat_list_lock
+ * Caller must hold iface_stat_list_lock or rcu_read_lock()
  */
 static struct iface_stat *get_iface_entry(const char *ifname)
 {
@@ -649,7 +708,7 @@ static struct iface_stat *get_iface_entry(const char *ifname)
 	}
 
 	/* Iterate over interfaces */
-	list_for_each_entry(iface_entry, &iface_stat_list, list) {
+	list_for_each_entry_rcu(iface_entry, &iface_stat_list, list) {
 		if (!strcmp(ifname, iface_entry->ifname))
 			goto done;
 	}
@@ -677,9 +736,10 @@ static void pp_iface_stat_header(struct seq_file *m)
 static void pp_iface_stat_line(struct seq_file *m,
 			       struct iface_stat *iface_entry)
 {
-	struct data_counters *cnts;
+	struct data_counters sum, *cnts = &sum;
 	int cnt_set = 0;   /* We only use one set for the device */
-	cnts = &iface_entry->totals_via_skb;
+
+	dc_fold(cnts, iface_entry->totals_via_skb);
 	seq_printf(m, "%s %llu %llu %llu %llu %llu %llu %llu %llu "
 		   "%llu %llu %llu %llu %llu %llu %llu %llu\n",
 		   iface_entry->ifname,
@@ -860,10 +920,15 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		       "iface_stat alloc failed\n", net_dev->name);
 		return NULL;
 	}
+	new_iface->totals_via_skb = kcalloc(nr_cpu_ids,
+					    sizeof(*new_iface->totals_via_skb),
+					    GFP_ATOMIC);
 	new_iface->ifname = kstrdup(net_dev->name, GFP_ATOMIC);
-	if (new_iface->ifname == NULL) {
+	if (new_iface->ifname == NULL || !new_iface->totals_via_skb) {
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "ifname alloc failed\n", net_dev->name);
+		kfree(new_iface->totals_via_skb);
+		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
 	}
@@ -880,6 +945,7 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 		pr_err("qtaguid: iface_stat: create(%s): "
 		       "work alloc failed\n", new_iface->ifname);
 		_iface_stat_set_active(new_iface, net_dev, false);
+		kfree(new_iface->totals_via_skb);
 		kfree(new_iface->ifname);
 		kfree(new_iface);
 		return NULL;
@@ -887,7 +953,8 @@ static struct iface_stat *iface_alloc(struct net_device *net_dev)
 	isw->iface_entry = new_iface;
 	INIT_WORK(&isw->iface_work, iface_create_proc_worker);
 	schedule_work(&isw->iface_work);
-	list_add(&new_iface->list, &iface_stat_list);
+	/* iface_stats are never freed, readers only need rcu_read_lock() */
+	list_add_rcu(&new_iface->list, &iface_stat_list);
 	return new_iface;
 }
 
@@ -1102,9 +1169,16 @@ static int ipx_proto(const struct sk_buff *skb,
 }
 
 static void
-data_counters_update(struct data_counters *dc, int set,
+data_counters_update(struct data_counters_pcpu *pc, int set,
 		     enum ifs_tx_rx direction, int proto, int bytes)
 {
+	struct data_counters_pcpu *p;
+	struct data_counters *dc;
+
+	local_bh_disable();
+	p = &pc[smp_processor_id()];
+	dc = &p->dc;
+	u64_stats_update_begin(&p->syncp);
 	switch (proto) {
 	case IPPROTO_TCP:
 		dc_add_byte_packets(dc, set, direction, IFS_TCP, bytes, 1);
@@ -1118,6 +1192,8 @@ data_counters_update(struct data_counters *dc, int set,
 				    1);
 		break;
 	}
+	u64_stats_update_end(&p->syncp);
+	local_bh_enable();
 }
 
 /*
@@ -1219,33 +1295,31 @@ static void iface_stat_update_from_skb(const struct sk_buff *skb,
 			 par->family, proto);
 	}
 
-	spin_lock_bh(&iface_stat_list_lock);
+	rcu_read_lock();
 	entry = get_iface_entry(el_dev->name);
 	if (entry == NULL) {
 		IF_DEBUG("qtaguid: iface_stat: %s(%s): not tracked\n",
 			 __func__, el_dev->name);
-		spin_unlock_bh(&iface_stat_list_lock);
+		rcu_read_unlock();
 		return;
 	}
 
 	IF_DEBUG("qtaguid: %s(%s): entry=%p\n", __func__,
 		 el_dev->name, entry);
 
-	data_counters_update(&entry->totals_via_skb, 0, direction, proto,
+	data_counters_update(entry->totals_via_skb, 0, direction, proto,
 			     bytes);
-	spin_unlock_bh(&iface_stat_list_lock);
+	rcu_read_unlock();
 }
 
-static void tag_stat_update(struct tag_stat *tag_entry,
+static void tag_stat_update(struct tag_stat *tag_entry, int active_set,
 			enum ifs_tx_rx direction, int proto, int bytes)
 {
-	int active_set;
-	active_set = get_active_counter_set(tag_entry->tn.tag);
 	MT_DEBUG("qtaguid: tag_stat_update(tag=0x%llx (uid=%u) set=%d "
 		 "dir=%d proto=%d bytes=%d)\n",
 		 tag_entry->tn.tag, get_uid_from_tag(tag_entry->tn.tag),
 		 active_set, direction, proto, bytes);
-	data_counters_update(&tag_entry->counters, active_set, direction,
+	data_counters_update(tag_entry->counters, active_set, direction,
 			     proto, bytes);
 	if (tag_entry->parent_counters)
 		data_counters_update(tag_entry->parent_counters, active_set,
@@ -1257,6 +1331,14 @@ static void tag_stat_update(struct tag_stat *tag_entry,
  * the interface.
  * iface_entry->tag_stat_list_lock should be held.
  */
+static void tag_stat_free_rcu(struct rcu_head *head)
+{
+	struct tag_stat *ts = container_of(head, struct tag_stat, rcu);
+
+	kfree(ts->counters);
+	kfree(ts);
+}
+
 static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 					   tag_t tag)
 {
@@ -1265,11 +1347,17 @@ static struct tag_stat *create_if_tag_stat(struct iface_stat *iface_entry,
 		 " (uid=%u)\n", __func__,
 		 iface_entry, tag, get_uid_from_tag(tag));
 	new_tag_stat_entry = kzalloc(sizeof(*new_tag_stat_entry), GFP_ATOMIC);
-	if (!new_tag_stat_entry) {
+	if (new_tag_stat_entry)
+		new_tag_stat_entry->counters = kcalloc(nr_cpu_ids,
+			sizeof(*new_tag_stat_entry->counters), GFP_ATOMIC);
+	if (!new_tag_stat_entry || !new_tag_stat_entry->counters) {
 		pr_err("qtaguid: iface_stat: tag stat alloc failed\n");
+		kfree(new_tag_stat_entry);
+		new_tag_stat_entry = NULL;
 		goto done;
 	}
 	new_tag_stat_entry->tn.tag = tag;
+	new_tag_stat_entry->iface = iface_entry;
 	tag_stat_tree_insert(new_tag_stat_entry, &iface_entry->tag_stat_tree);
 done:
 	return new_tag_stat_entry;
@@ -1282,26 +1370,43 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 	struct tag_stat *tag_stat_entry;
 	tag_t tag, acct_tag;
 	tag_t uid_tag;
-	struct data_counters *uid_tag_counters = NULL;
+	struct data_counters_pcpu *uid_tag_counters = NULL;
 	struct sock_tag *sock_tag_entry;
 	struct iface_stat *iface_entry;
 	struct tag_stat *new_tag_stat = NULL;
+	int active_set;
+	u32 gen;
+	/* a timewait sock has no room for the cache */
+	bool cache = sk && sk->sk_state != TCP_TIME_WAIT;
 	MT_DEBUG("qtaguid: if_tag_stat_update(ifname=%s "
 		"uid=%u sk=%p dir=%d proto=%d bytes=%d)\n",
 		 ifname, uid, sk, direction, proto, bytes);
 
-
+	rcu_read_lock();
 	iface_entry = get_iface_entry(ifname);
 	if (!iface_entry) {
 		pr_err_ratelimited("qtaguid: iface_stat: stat_update() "
 				   "%s not found\n", ifname);
-		return;
+		goto done;
 	}
 	/* It is ok to process data when an iface_entry is inactive */
 
 	MT_DEBUG("qtaguid: iface_stat: stat_update() dev=%s entry=%p\n",
 		 ifname, iface_entry);
 
+	/* Same tag and iface as the last packet of the socket */
+	if (cache) {
+		tag_stat_entry = qtu_sk_cache_get(sk, iface_entry, uid,
+						  &active_set);
+		if (tag_stat_entry) {
+			tag_stat_update(tag_stat_entry, active_set, direction,
+					proto, bytes);
+			goto done;
+		}
+	}
+	gen = atomic_read(&qtu_sk_gen);
+	smp_rmb();
+
 	/*
 	 * Look for a tagged sock.
 	 * It will have an acct_uid.
@@ -1316,6 +1421,7 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		tag = combine_atag_with_uid(acct_tag, uid);
 		uid_tag = make_tag_from_uid(uid);
 	}
+	active_set = get_active_counter_set(tag);
 	MT_DEBUG("qtaguid: iface_stat: stat_update(): "
 		 " looking for tag=0x%llx (uid=%u) in ife=%p\n",
 		 tag, get_uid_from_tag(tag), iface_entry);
@@ -1329,9 +1435,8 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 * Updating the {acct_tag, uid_tag} entry handles both stats:
 		 * {0, uid_tag} will also get updated.
 		 */
-		tag_stat_update(tag_stat_entry, direction, proto, bytes);
-		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
-		return;
+		new_tag_stat = tag_stat_entry;
+		goto update;
 	}
 
 	/* Loop over tag list under this interface for {0,uid_tag} */
@@ -1346,9 +1451,9 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		new_tag_stat = create_if_tag_stat(iface_entry, uid_tag);
 		if (!new_tag_stat)
 			goto unlock;
-		uid_tag_counters = &new_tag_stat->counters;
+		uid_tag_counters = new_tag_stat->counters;
 	} else {
-		uid_tag_counters = &tag_stat_entry->counters;
+		uid_tag_counters = tag_stat_entry->counters;
 	}
 
 	if (acct_tag) {
@@ -1368,10 +1473,14 @@ static void if_tag_stat_update(const char *ifname, uid_t uid,
 		 */
 		BUG_ON(!new_tag_stat);
 	}
-	if (new_tag_stat)
-		tag_stat_update(new_tag_stat, direction, proto, bytes);
+update:
+	tag_stat_update(new_tag_stat, active_set, direction, proto, bytes);
+	if (cache)
+		qtu_sk_cache_set(sk, gen, new_tag_stat, uid, active_set);
 unlock:
 	spin_unlock_bh(&iface_entry->tag_stat_list_lock);
+done:
+	rcu_read_unlock();
 }
 
 static int iface_netdev_event_handler(struct notifier_block *nb,
@@ -1987,7 +2096,8 @@ static int ctrl_cmd_delete(const char *input)
 	struct rb_node *node;
 	struct sock_tag *st_entry;
 	struct rb_root st_to_free_tree = RB_ROOT;
-	struct tag_stat *ts_entry;
+	struct tag_stat *ts_entry, *ts_next;
+	LIST_HEAD(ts_to_free_list);
 	struct tag_counter_set *tcs_entry;
 	struct tag_ref *tr_entry;
 	struct uid_tag_data *utd_entry;
@@ -2098,13 +2208,20 @@ static int ctrl_cmd_delete(const char *input)
 					 entry_uid);
 				rb_erase(&ts_entry->tn.node,
 					 &iface_entry->tag_stat_tree);
-				kfree(ts_entry);
+				list_add(&ts_entry->free_list,
+					 &ts_to_free_list);
 			}
 		}
 		spin_unlock_bh(&iface_entry->tag_stat_list_lock);
 	}
 	spin_unlock_bh(&iface_stat_list_lock);
 
+	/* No new socket cache can find them, drop the old ones */
+	qtu_sk_cache_invalidate();
+	list_for_each_entry_safe(ts_entry, ts_next, &ts_to_free_list,
+				 free_list)
+		call_rcu(&ts_entry->rcu, tag_stat_free_rcu);
+
 	/* Cleanup the uid_tag_data */
 	spin_lock_bh(&uid_tag_data_tree_lock);
 	node = rb_first(&uid_tag_data_tree);
@@ -2187,6 +2304,7 @@ static int ctrl_cmd_counter_set(const char *input)
 	}
 	tcs->active_set = counter_set;
 	spin_unlock_bh(&tag_counter_set_list_lock);
+	qtu_sk_cache_invalidate();
 	atomic64_inc(&qtu_events.counter_set_changes);
 	res = 0;
 
@@ -2325,6 +2443,7 @@ static int ctrl_cmd_tag(const char *input)
 		atomic64_inc(&qtu_events.sockets_tagged);
 	}
 	spin_unlock_bh(&sock_tag_list_lock);
+	qtu_sk_cache_invalidate();
 	/* We keep the ref to the socket (file) until it is untagged */
 	CT_DEBUG("qtaguid: ctrl_tag(%s): done st@%p ...->f_count=%ld\n",
 		 input, sock_tag_entry,
@@ -2414,6 +2533,7 @@ static int ctrl_cmd_untag(const char *input)
 	 */
 	tag_ref_entry->num_sock_tags--;
 	spin_unlock_bh(&sock_tag_list_lock);
+	qtu_sk_cache_invalidate();
 	/*
 	 * Release the sock_fd that was grabbed at tag time,
 	 * and once more for the sockfd_lookup() here.
@@ -2524,7 +2644,7 @@ static int pp_stats_line(struct seq_file *m, struct tag_stat *ts_entry,
 			 int cnt_set)
 {
 	int ret;
-	struct data_counters *cnts;
+	struct data_counters sum, *cnts = &sum;
 	tag_t tag = ts_entry->tn.tag;
 	uid_t stat_uid = get_uid_from_tag(tag);
 	struct proc_print_info *ppi = m->private;
@@ -2540,7 +2660,7 @@ static int pp_stats_line(struct seq_file *m, struct tag_stat *ts_entry,
 		return 0;
 	}
 	ppi->item_index++;
-	cnts = &ts_entry->counters;
+	dc_fold(cnts, ts_entry->counters);
 	ret = seq_printf(m, "%d %s 0x%llx %u %u "
 		"%llu %llu "
 		"%llu %llu "
@@ -2864,7 +2984,7 @@ static int qtudev_release(struct inode *inode, struct file *file)
 
 	spin_unlock_bh(&uid_tag_data_tree_lock);
 	spin_unlock_bh(&sock_tag_list_lock);
-
+	qtu_sk_cache_invalidate();
 
 	sock_tag_tree_erase(&st_to_free_tree);
 
@@ -11,8 +11,12 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
+#include <linux/rcupdate.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -197,6 +201,38 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * The counters of one cpu, only updated from that cpu with BH off.
+ * Readers fold them with dc_fold().
+ */
+struct data_counters_pcpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
+static inline void dc_fold(struct data_counters *dc,
+			   struct data_counters_pcpu *pc)
+{
+	struct byte_packet_counters *sum = &dc->bpc[0][0][0];
+	struct byte_packet_counters *v;
+	struct data_counters tmp;
+	unsigned int start;
+	int cpu, i;
+
+	memset(dc, 0, sizeof(*dc));
+	for_each_possible_cpu(cpu) {
+		do {
+			start = u64_stats_fetch_begin_bh(&pc[cpu].syncp);
+			tmp = pc[cpu].dc;
+		} while (u64_stats_fetch_retry_bh(&pc[cpu].syncp, start));
+		v = &tmp.bpc[0][0][0];
+		for (i = 0; i < sizeof(*dc) / sizeof(*v); i++) {
+			sum[i].bytes += v[i].bytes;
+			sum[i].packets += v[i].packets;
+		}
+	}
+}
+
 
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
@@ -206,23 +242,31 @@ struct tag_node {
 
 struct tag_stat {
 	struct tag_node tn;
-	struct data_counters counters;
+	struct iface_stat *iface;
+	/* nr_cpu_ids of them */
+	struct data_counters_pcpu *counters;
 	/*
 	 * If this tag is acct_tag based, we need to count against the
 	 * matching parent uid_tag.
 	 */
-	struct data_counters *parent_counters;
+	struct data_counters_pcpu *parent_counters;
+	union {
+		/* once out of the tree, until the socket caches are dropped */
+		struct list_head free_list;
+		/* packets from the socket caches may still be counting */
+		struct rcu_head rcu;
+	};
 };
 
 struct iface_stat {
-	struct list_head list;  /* in iface_stat_list */
+	struct list_head list;  /* in iface_stat_list, RCU for readers */
 	char *ifname;
 	bool active;
 	/* net_dev is only valid for active iface_stat */
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	struct data_counters_pcpu *totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -155,6 +155,7 @@ char *pp_tag_stat(struct tag_stat *ts)
 	char *counters_str;
 	char *parent_counters_str;
 	char *res;
+	struct data_counters cnts;
 
 	if (!ts) {
 		res = kasprintf(GFP_ATOMIC, "tag_stat@null{}");
@@ -162,8 +163,11 @@ char *pp_tag_stat(struct tag_stat *ts)
 		return res;
 	}
 	tn_str = pp_tag_node(&ts->tn);
-	counters_str = pp_data_counters(&ts->counters, true);
-	parent_counters_str = pp_data_counters(ts->parent_counters, false);
+	dc_fold(&cnts, ts->counters);
+	counters_str = pp_data_counters(&cnts, true);
+	/* only the address is shown for the parent */
+	parent_counters_str = pp_data_counters(
+		ts->parent_counters ? &ts->parent_counters->dc : NULL, false);
 	res = kasprintf(GFP_ATOMIC,
 			"tag_stat@%p{%s, counters=%s, parent_counters=%s}",
 			ts, tn_str, counters_str, parent_counters_str);
@@ -180,7 +184,9 @@ char *pp_iface_stat(struct iface_stat *is)
 	if (!is) {
 		res = kasprintf(GFP_ATOMIC, "iface_stat@null{}");
 	} else {
-		struct data_counters *cnts = &is->totals_via_skb;
+		struct data_counters sum, *cnts = &sum;
+
+		dc_fold(cnts, is->totals_via_skb);
 		res = kasprintf(GFP_ATOMIC, "iface_stat@%p{"
 				"list=list_head{...}, "
 				"ifname=%s, "
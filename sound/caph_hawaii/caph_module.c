@@ -237,22 +237,23 @@ static int DriverRemove(struct platform_device *pdev)
 	return 0;
 }
 
-static int DriverSuspend(struct platform_device *pdev, pm_message_t state)
-{
-	return 0;
-}
-
 /**
- *  DriverResume: 'resume' call back function
- * @pdev: platform device
+ *  DriverPrepare: 'prepare' call back function
+ * @dev: device
  *
- * Returns 0 for success.
+ * The audio paths are powered down by their own users, there is nothing
+ * to do over system suspend: returns 1 to have the PM core skip the
+ * device.
  */
-static int DriverResume(struct platform_device *pdev)
+static int DriverPrepare(struct device *dev)
 {
-	return 0;
+	return 1;
 }
 
+static const struct dev_pm_ops sgDriverPmOps = {
+	.prepare = DriverPrepare,
+};
+
 /*
  * File operations for audio logging
  */
@@ -968,11 +969,10 @@ static struct platform_driver __refdata sgPlatformDriver = {
 	 */
 	/*	.probe = DriverProbe, */
 	.remove = DriverRemove,
-	.suspend = DriverSuspend,
-	.resume = DriverResume,
 	.driver = {
 		   .name = "brcm_caph_device",
 		   .owner = THIS_MODULE,
+		   .pm = &sgDriverPmOps,
 		   },
 };
 
@@ -35,7 +35,10 @@
 #include <linux/clk.h>
 #include <linux/err.h>
 #include <linux/io.h>
+#include <linux/ktime.h>
+#include <linux/mutex.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 #include "resultcode.h"
 #include "mobcom_types.h"
 #include "msconsts.h"
@@ -215,6 +218,37 @@ static int rec_pre_call;
 static int dsp_path;
 static Boolean cp_reset = FALSE;
 
+/*
+ * Block lists picked for memory streams, keyed by the stream format, so
+ * that a stream start does not walk the whole routing table again. The
+ * CAPH clocks are kept on for path_idle_ms after the last path is
+ * disabled, so a short sound that follows does not pay for bringing
+ * them back up.
+ */
+#define PATH_CACHE_NUM	8
+
+struct caph_path_cache {
+	CSL_CAPH_DEVICE_e source;
+	CSL_CAPH_DEVICE_e sink;
+	AUDIO_SAMPLING_RATE_t src_sampleRate;
+	AUDIO_SAMPLING_RATE_t snk_sampleRate;
+	AUDIO_NUM_OF_CHANNEL_t chnlNum;
+	AUDIO_BITS_PER_SAMPLE_t bitPerSample;
+	BT_MODE_t bt_mode;
+	CAPH_LIST_t list;
+};
+
+static struct caph_path_cache path_cache[PATH_CACHE_NUM];
+static int path_cache_num, path_cache_next;
+static u32 path_idle_ms = 3000;
+static u32 path_cache_hit, path_cache_miss;
+static u32 path_setup_count, path_setup_last_us, path_setup_max_us;
+static u64 path_setup_total_us;
+static Boolean sClkIdle = FALSE;	/* clocks on only for the grace */
+static DEFINE_MUTEX(sClkLock);
+static void csl_caph_hwctrl_idle_work(struct work_struct *work);
+static DECLARE_DELAYED_WORK(sClkIdleWork, csl_caph_hwctrl_idle_work);
+
 static CAPH_BLOCK_t caph_block_list[LIST_NUM][MAX_PATH_LEN] = {
 	/*the order must match CAPH_LIST_t*/
 	{CAPH_NONE}, /*LIST_NONE*/
@@ -3086,12 +3120,13 @@ void csl_ControlHWClock_156m(Boolean enable)
 }
 
 /*
- * Function Name: void csl_caph_ControlHWClock(Boolean enable)
+ * Function Name: void csl_caph_hwctrl_clock(Boolean enable)
  * Description: This is to enable/disable the audio HW clocks
  *			KHUB_CAPH_SRCMIXER_CLK
  *			KHUB_AUDIOH_APB_CLK
+ *		Called with sClkLock held.
  */
-void csl_caph_ControlHWClock(Boolean enable)
+static void csl_caph_hwctrl_clock(Boolean enable)
 {
 	if (enable == TRUE) {
 		if (sClkCurEnabled == FALSE) {
@@ -3208,6 +3243,54 @@ err_get_26m_clk:
 	clkIDCAPH[CLK_SRCMIXER] = ERR_PTR(-ENODEV);
 }
 
+/*
+ * Function Name: void csl_caph_ControlHWClock(Boolean enable)
+ * Description: This is to enable/disable the audio HW clocks.
+ *		Any request ends a grace period left by DisablePath.
+ */
+void csl_caph_ControlHWClock(Boolean enable)
+{
+	mutex_lock(&sClkLock);
+	sClkIdle = FALSE;
+	csl_caph_hwctrl_clock(enable);
+	mutex_unlock(&sClkLock);
+}
+
+/*
+ * Function Name: void csl_caph_hwctrl_idle_work(struct work_struct *work)
+ * Description: Switch the CAPH clocks off at the end of the grace period,
+ *		unless a path or a clock request came in the meantime.
+ */
+static void csl_caph_hwctrl_idle_work(struct work_struct *work)
+{
+	mutex_lock(&sClkLock);
+	if (sClkIdle && csl_caph_hwctrl_allPathsDisabled() == TRUE &&
+		(!csl_caph_TuningFlag())) {
+		aTrace(LOG_AUDIO_CSL, "%s: clocks off\n", __func__);
+		csl_caph_hwctrl_clock(FALSE);
+	}
+	sClkIdle = FALSE;
+	mutex_unlock(&sClkLock);
+}
+
+/*
+ * Function Name: void csl_caph_hwctrl_idle_clock(void)
+ * Description: The last path is gone: keep the CAPH clocks on for
+ *		path_idle_ms, then switch them off.
+ */
+static void csl_caph_hwctrl_idle_clock(void)
+{
+	if (!path_idle_ms) {
+		csl_caph_ControlHWClock(FALSE);
+		return;
+	}
+	mutex_lock(&sClkLock);
+	sClkIdle = TRUE;
+	mutex_unlock(&sClkLock);
+	mod_delayed_work(system_wq, &sClkIdleWork,
+		msecs_to_jiffies(path_idle_ms));
+}
+
 /****************************************************************************
 *  Function Name: CSL_CAPH_PathID csl_caph_hwctrl_AddPathInTable
 *  (CSL_CAPH_HWCTRL_CONFIG_t config)
@@ -3951,6 +4034,9 @@ void csl_caph_hwctrl_deinit(void)
 {
 	aTrace(LOG_AUDIO_CSL, "csl_caph_hwctrl_deinit::\n");
 
+	/*end a pending grace period before the path table goes away*/
+	if (cancel_delayed_work_sync(&sClkIdleWork))
+		csl_caph_ControlHWClock(FALSE);
 	if (HWConfig_Table != NULL) {
 		kfree(HWConfig_Table);
 		HWConfig_Table = NULL;
@@ -4032,6 +4118,67 @@ void csl_caph_hwctrl_toggle_caphclk(void)
 		__func__);
 }
 
+/****************************************************************************
+*  Function Name: CAPH_LIST_t csl_caph_hwctrl_cached_list
+*  Description: Look up the block list picked before for a memory stream
+*		of the same format. LIST_NUM if there is none.
+****************************************************************************/
+static CAPH_LIST_t csl_caph_hwctrl_cached_list(CSL_CAPH_HWConfig_Table_t
+		*path, int sinkNo)
+{
+	struct caph_path_cache *c;
+	int i;
+
+	if (path->source != CSL_CAPH_DEV_MEMORY &&
+		path->sink[sinkNo] != CSL_CAPH_DEV_MEMORY)
+		return LIST_NUM;
+
+	for (i = 0; i < path_cache_num; i++) {
+		c = &path_cache[i];
+		if (c->source == path->source &&
+			c->sink == path->sink[sinkNo] &&
+			c->src_sampleRate == path->src_sampleRate &&
+			c->snk_sampleRate == path->snk_sampleRate &&
+			c->chnlNum == path->chnlNum &&
+			c->bitPerSample == path->bitPerSample &&
+			c->bt_mode == bt_mode) {
+			path_cache_hit++;
+			return c->list;
+		}
+	}
+	path_cache_miss++;
+	return LIST_NUM;
+}
+
+/****************************************************************************
+*  Function Name: void csl_caph_hwctrl_cache_list
+*  Description: Remember the block list picked for a memory stream,
+*		replacing the oldest entry when the cache is full.
+****************************************************************************/
+static void csl_caph_hwctrl_cache_list(CSL_CAPH_HWConfig_Table_t *path,
+		int sinkNo, CAPH_LIST_t list)
+{
+	struct caph_path_cache *c;
+
+	if (list == LIST_NUM || (path->source != CSL_CAPH_DEV_MEMORY &&
+		path->sink[sinkNo] != CSL_CAPH_DEV_MEMORY))
+		return;
+
+	c = &path_cache[path_cache_next];
+	path_cache_next = (path_cache_next + 1) % PATH_CACHE_NUM;
+	if (path_cache_num < PATH_CACHE_NUM)
+		path_cache_num++;
+
+	c->source = path->source;
+	c->sink = path->sink[sinkNo];
+	c->src_sampleRate = path->src_sampleRate;
+	c->snk_sampleRate = path->snk_sampleRate;
+	c->chnlNum = path->chnlNum;
+	c->bitPerSample = path->bitPerSample;
+	c->bt_mode = bt_mode;
+	c->list = list;
+}
+
 /****************************************************************************
 *  Function Name:Result_t csl_caph_hwctrl_SetupPath
 *  Description: Set up a HW path with block list
@@ -4053,7 +4200,13 @@ CSL_CAPH_PathID csl_caph_hwctrl_SetupPath(CSL_CAPH_HWCTRL_CONFIG_t config,
 	/*after this, don't change structure config, and just use it.*/
 	path = &HWConfig_Table[pathID-1];
 
-	list = LIST_NUM;
+	list = csl_caph_hwctrl_cached_list(path, sinkNo);
+	if (list != LIST_NUM) {
+		if (path->sink[sinkNo] == CSL_CAPH_DEV_DSP_throughMEM)
+			path->arm2sp_path = list;
+		goto list_found;
+	}
+
 	if ((path->source == CSL_CAPH_DEV_MEMORY)
 	&& ((path->sink[sinkNo] == CSL_CAPH_DEV_EP)
 	|| (path->sink[sinkNo] == CSL_CAPH_DEV_HS)
@@ -4269,7 +4422,9 @@ CSL_CAPH_PathID csl_caph_hwctrl_SetupPath(CSL_CAPH_HWCTRL_CONFIG_t config,
 #endif
 		path->arm2sp_path = list;
 	}
+	csl_caph_hwctrl_cache_list(path, sinkNo, list);
 
+list_found:
 	if (list != LIST_NUM) {
 		int j, offset = 0;
 		memcpy(path->block[sinkNo], caph_block_list[list],
@@ -4369,6 +4524,8 @@ CSL_CAPH_PathID csl_caph_hwctrl_EnablePath(CSL_CAPH_HWCTRL_CONFIG_t config)
 {
 	CSL_CAPH_PathID pathID = config.pathID;
 	CSL_CAPH_HWConfig_Table_t *path;
+	ktime_t start = ktime_get();
+	u32 us;
 
 	/*try to enable caph audio clock first*/
 	csl_caph_ControlHWClock(TRUE);
@@ -4414,6 +4571,13 @@ CSL_CAPH_PathID csl_caph_hwctrl_EnablePath(CSL_CAPH_HWCTRL_CONFIG_t config)
 		csl_caph_hwctrl_StartPath(config.pathID);
 	}
 
+	us = (u32)ktime_us_delta(ktime_get(), start);
+	path_setup_count++;
+	path_setup_total_us += us;
+	path_setup_last_us = us;
+	if (us > path_setup_max_us)
+		path_setup_max_us = us;
+
 	return config.pathID;
 }
 
@@ -4491,12 +4655,14 @@ Result_t csl_caph_hwctrl_DisablePath(CSL_CAPH_HWCTRL_CONFIG_t config)
 	}
 	csl_caph_hwctrl_RemovePathInTable(path->pathID);
 
-	/*shutdown all audio clock if no audio activity, at last*/
+	/*shutdown all audio clock if no audio activity, at last.
+	 *CAPH clocks stay on for a grace period, for the next start.
+	 */
 	if (csl_caph_hwctrl_allPathsDisabled() == TRUE &&
 		(!csl_caph_TuningFlag())) {
 		csl_ControlHWClock_2p4m(FALSE);
 		csl_ControlHWClock_156m(FALSE);
-		csl_caph_ControlHWClock(FALSE);
+		csl_caph_hwctrl_idle_clock();
 	}
 
 	return RESULT_OK;
@@ -6240,4 +6406,50 @@ static int __init chal_audio_vibra_dbgfs(void)
 	return 0;
 }
 subsys_initcall(chal_audio_vibra_dbgfs);
+
+static int path_stats_show(struct seq_file *s, void *unused)
+{
+	u32 avg = path_setup_count ?
+		(u32)div_u64(path_setup_total_us, path_setup_count) : 0;
+
+	seq_printf(s, "cache: %u hits, %u misses, %d entries\n",
+		path_cache_hit, path_cache_miss, path_cache_num);
+	seq_printf(s, "setup: %u paths, last %u us, avg %u us, max %u us\n",
+		path_setup_count, path_setup_last_us, avg, path_setup_max_us);
+	seq_printf(s, "clocks: %s\n", !sClkCurEnabled ? "off" :
+		(sClkIdle ? "idle" : "on"));
+	return 0;
+}
+
+static int path_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, path_stats_show, NULL);
+}
+
+static const struct file_operations path_stats_fops = {
+	.open = path_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init csl_caph_path_dbgfs(void)
+{
+	struct dentry *dent;
+
+	dent = debugfs_create_dir("caph_path", NULL);
+	if (!dent) {
+		pr_err("%s: Failed to initialize debugfs\n", __func__);
+		return -EACCES;
+	}
+	if (!debugfs_create_u32("idle_ms", S_IWUSR | S_IRUSR, dent,
+				&path_idle_ms) ||
+		!debugfs_create_file("stats", S_IRUSR, dent, NULL,
+				&path_stats_fops)) {
+		pr_err("%s: Failed to create caph_path debugfs\n", __func__);
+		return -EACCES;
+	}
+	return 0;
+}
+subsys_initcall(csl_caph_path_dbgfs);
 #endif
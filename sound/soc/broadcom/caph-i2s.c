@@ -75,38 +75,27 @@
 
 static struct clk *clkIDSSP;
 
-static void caph_i2s_start(struct snd_pcm_substream *substream,
-				struct caph_i2s *i2s);
-static void caph_i2s_stop(struct snd_pcm_substream *substream,
-				struct caph_i2s *i2s);
 static int caph_i2s_configure(struct snd_pcm_substream
 					*substream, struct snd_soc_dai *dai);
 /*****************************************************************************
 *
-*Function Name: static struct int caph_i2s_configure
-*		(struct snd_pcm_substream *substream, struct snd_soc_dai *dai)
+*Function Name: int caph_i2s_path_configure(struct caph_i2s *i2s,
+*		struct caph_pcm_config *pcm_config, int stream)
 *
-*Description: This is to configure cfifo, switch and i2s port
+*Description: This is to configure cfifo, switch and i2s port for the
+*		DMA, cfifo and switch channel in pcm_config
 *
 *****************************************************************************/
-static int caph_i2s_configure(struct snd_pcm_substream
-					*substream, struct snd_soc_dai *dai)
+int caph_i2s_path_configure(struct caph_i2s *i2s,
+			    struct caph_pcm_config *pcm_config, int stream)
 {
-	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(dai);
 	CSL_CAPH_CFIFO_FIFO_e fifo = CSL_CAPH_CFIFO_NONE;
 	CSL_CAPH_CFIFO_DIRECTION_e direction = CSL_CAPH_CFIFO_IN;
 	UInt16 threshold = 0;
-	struct caph_pcm_config *pcm_config = snd_soc_dai_get_dma_data(dai,
-								substream);
 	CSL_CAPH_SWITCH_CONFIG_t swCfg;
 
-	pr_info("caph_i2s_configure: stream %d", substream->stream);
-	if (!pcm_config) {
-		pr_info("caph_i2s_configure: could not get dma_data\n");
-		return -1;
-	}
 	fifo = pcm_config->fifo;
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		swCfg.FIFO_srcAddr = csl_caph_cfifo_get_fifo_addr(fifo);
 		swCfg.trigger = i2s->fmTxTrigger;
 		swCfg.dataFmt = CSL_CAPH_16BIT_STEREO;
@@ -164,26 +153,47 @@ static int caph_i2s_configure(struct snd_pcm_substream
 
 /*****************************************************************************
 *
-*Function Name:void caph_i2s_start(struct snd_pcm_substream *substream,
-*					struct caph_i2s *i2s)
+*Function Name: static struct int caph_i2s_configure
+*		(struct snd_pcm_substream *substream, struct snd_soc_dai *dai)
+*
+*Description: This is to configure cfifo, switch and i2s port
+*
+*****************************************************************************/
+static int caph_i2s_configure(struct snd_pcm_substream
+					*substream, struct snd_soc_dai *dai)
+{
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+	struct caph_pcm_config *pcm_config = snd_soc_dai_get_dma_data(dai,
+								substream);
+
+	pr_info("caph_i2s_configure: stream %d", substream->stream);
+	if (!pcm_config) {
+		pr_info("caph_i2s_configure: could not get dma_data\n");
+		return -1;
+	}
+	return caph_i2s_path_configure(i2s, pcm_config, substream->stream);
+}
+
+/*****************************************************************************
+*
+*Function Name:void caph_i2s_path_start(struct caph_i2s *i2s, int stream)
 *
 *Description: This is to start for i2s dai
 *
 *****************************************************************************/
-static void caph_i2s_start(struct snd_pcm_substream *substream,
-				struct caph_i2s *i2s)
+void caph_i2s_path_start(struct caph_i2s *i2s, int stream)
 {
 	struct caph_pcm_config *pcm_config;
 
-	pr_info("caph_i2s_start stream %d", substream->stream);
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+	pr_info("caph_i2s_start stream %d", stream);
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		pcm_config = &i2s->pcm_config_playback;
 		/* start cfifo */
 		csl_caph_cfifo_start_fifo(pcm_config->fifo);
 
 		/* start switch */
 		csl_caph_switch_start_transfer(pcm_config->sw);
-	} else if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
+	} else if (stream == SNDRV_PCM_STREAM_CAPTURE) {
 		pcm_config = &i2s->pcm_config_capture;
 		/* start switch */
 		csl_caph_switch_start_transfer(pcm_config->sw);
@@ -195,13 +205,13 @@ static void caph_i2s_start(struct snd_pcm_substream *substream,
 	/* start DMA */
 	csl_caph_dma_start_transfer(pcm_config->dmaCH);
 	/* start i2s */
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		if (!i2s->fmTxRunning) {
 			csl_sspi_enable_scheduler(i2s->fmHandleSSP, 1);
 			csl_i2s_start_tx(i2s->fmHandleSSP, &i2s->fmCfg);
 			i2s->fmTxRunning = TRUE;
 		}
-	} else if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
+	} else if (stream == SNDRV_PCM_STREAM_CAPTURE) {
 		if (!i2s->fmRxRunning) {
 			csl_sspi_enable_scheduler(i2s->fmHandleSSP, 1);
 			csl_i2s_start_rx(i2s->fmHandleSSP, &i2s->fmCfg);
@@ -212,19 +222,17 @@ static void caph_i2s_start(struct snd_pcm_substream *substream,
 
 /*****************************************************************************
 *
-*Function Name:void caph_i2s_stopt(struct snd_pcm_substream *substream,
-*					struct caph_i2s *i2s)
+*Function Name:void caph_i2s_path_stop(struct caph_i2s *i2s, int stream)
 *
 *Description: This is to stop for i2s dai
 *
 *****************************************************************************/
-static void caph_i2s_stop(struct snd_pcm_substream *substream,
-				struct caph_i2s *i2s)
+void caph_i2s_path_stop(struct caph_i2s *i2s, int stream)
 {
 	struct caph_pcm_config *pcm_config;
 
-	pr_info("caph-i2s: caph_i2s_stop stream %d", substream->stream);
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+	pr_info("caph-i2s: caph_i2s_stop stream %d", stream);
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK)
 		pcm_config = &i2s->pcm_config_playback;
 	else
 		pcm_config = &i2s->pcm_config_capture;
@@ -238,7 +246,7 @@ static void caph_i2s_stop(struct snd_pcm_substream *substream,
 	csl_caph_switch_release_channel(pcm_config->sw);
 
 	/* stop i2s */
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+	if (stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		if (i2s->fmTxRunning == TRUE) {
 			csl_i2s_stop_tx(i2s->fmHandleSSP);
 			i2s->fmTxRunning = FALSE;
@@ -299,12 +307,40 @@ static inline void caph_i2s_write(const struct caph_i2s *i2s,
 static int caph_i2s_startup(struct snd_pcm_substream *substream,
 			    struct snd_soc_dai *dai)
 {
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+
+	/* the deep buffer stream has the playback cfifo and i2s tx */
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+		if (i2s->fmTxDeep)
+			return -EBUSY;
+		i2s->fmTxPcm = TRUE;
+		return 0;
+	}
+
+	/* and the voice trigger stream shares the capture ones */
+	if (dai->driver->id == CAPH_I2S_DAI_VT) {
+		if (i2s->fmRxPcm)
+			return -EBUSY;
+		i2s->fmRxVt = TRUE;
+	} else {
+		if (i2s->fmRxVt)
+			return -EBUSY;
+		i2s->fmRxPcm = TRUE;
+	}
 	return 0;
 }
 
 static void caph_i2s_shutdown(struct snd_pcm_substream *substream,
 			      struct snd_soc_dai *dai)
 {
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+		i2s->fmTxPcm = FALSE;
+	else if (dai->driver->id == CAPH_I2S_DAI_VT)
+		i2s->fmRxVt = FALSE;
+	else
+		i2s->fmRxPcm = FALSE;
 }
 
 /*****************************************************************************
@@ -323,12 +359,12 @@ static int caph_i2s_trigger(struct snd_pcm_substream *substream, int cmd,
 	case SNDRV_PCM_TRIGGER_START:
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
-		caph_i2s_start(substream, i2s);
+		caph_i2s_path_start(i2s, substream->stream);
 		break;
 	case SNDRV_PCM_TRIGGER_STOP:
 	case SNDRV_PCM_TRIGGER_SUSPEND:
 	case SNDRV_PCM_TRIGGER_PAUSE_PUSH:
-		caph_i2s_stop(substream, i2s);
+		caph_i2s_path_stop(i2s, substream->stream);
 		break;
 	default:
 		return -EINVAL;
@@ -408,7 +444,9 @@ static struct snd_soc_dai_ops caph_i2s_dai_ops = {
 	.prepare = caph_i2s_prepare,
 };
 
-static struct snd_soc_dai_driver caph_i2s_dai = {
+static struct snd_soc_dai_driver caph_i2s_dai[] = {
+	{
+	.name = "caph-i2s.0",
 	.probe = caph_i2s_dai_probe,
 	.remove = caph_i2s_dai_remove,
 	.playback = {
@@ -427,6 +465,42 @@ static struct snd_soc_dai_driver caph_i2s_dai = {
 	.ops = &caph_i2s_dai_ops,
 	.suspend = caph_i2s_suspend,
 	.resume = caph_i2s_resume,
+	},
+#ifdef CONFIG_SND_BCM_SOC_DEEP_BUFFER
+	{
+	/* deep buffer music playback through the compress API; the
+	 * platform (caph-pcm) drives the cfifo, switch and i2s itself
+	 */
+	.name = "caph-i2s-deep",
+	.compress_dai = 1,
+	.playback = {
+		     .channels_min = 2,
+		     .channels_max = 2,
+		     .rates = SNDRV_PCM_RATE_48000,
+		     .formats = SNDRV_PCM_FMTBIT_S16_LE,
+		     },
+	},
+#endif
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	{
+	/* always-on voice trigger capture; the platform keeps the DMA on
+	 * its own ring and hands audio over only once it hears something
+	 */
+	.name = "caph-i2s-vt",
+	.id = CAPH_I2S_DAI_VT,
+	.capture = {
+		    .channels_min = 2,
+		    .channels_max = 2,
+		    .rates = SNDRV_PCM_RATE_48000,
+		    .formats = SNDRV_PCM_FMTBIT_S16_LE,
+		    },
+	.ops = &caph_i2s_dai_ops,
+	},
+#endif
+};
+
+static const struct snd_soc_component_driver caph_i2s_component = {
+	.name = "caph-i2s",
 };
 
 static int __devinit caph_i2s_dev_probe(struct platform_device *pdev)
@@ -448,7 +522,8 @@ static int __devinit caph_i2s_dev_probe(struct platform_device *pdev)
 	i2s->fmRxRunning = 0;
 
 	platform_set_drvdata(pdev, i2s);
-	ret = snd_soc_register_dai(&pdev->dev, &caph_i2s_dai);
+	ret = snd_soc_register_component(&pdev->dev, &caph_i2s_component,
+					 caph_i2s_dai, ARRAY_SIZE(caph_i2s_dai));
 
 	if (ret) {
 		dev_err(&pdev->dev, "Failed to register DAI\n");
@@ -468,7 +543,7 @@ static int __devexit caph_i2s_dev_remove(struct platform_device *pdev)
 	struct caph_i2s *i2s = platform_get_drvdata(pdev);
 
 	csl_caph_hwctrl_deinit();
-	snd_soc_unregister_dai(&pdev->dev);
+	snd_soc_unregister_component(&pdev->dev);
 
 	iounmap(i2s->base);
 	release_mem_region(i2s->mem->start, resource_size(i2s->mem));
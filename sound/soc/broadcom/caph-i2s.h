@@ -41,6 +41,9 @@
 #include "caph-pcm.h"
 #include "csl_caph_switch.h"
 
+/* id of the voice trigger capture dai, the platform runs its own ring */
+#define CAPH_I2S_DAI_VT	2
+
 /* cpu_dai(i2s_dai) private driver data structure*/
 struct caph_i2s {
 	struct resource *mem;
@@ -56,6 +59,10 @@ struct caph_i2s {
 	CSL_I2S_CONFIG_t fmCfg;
 	Boolean fmTxRunning;
 	Boolean fmRxRunning;
+	Boolean fmTxPcm;	/* PCM playback open */
+	Boolean fmTxDeep;	/* deep buffer playback open */
+	Boolean fmRxPcm;	/* PCM capture open */
+	Boolean fmRxVt;		/* voice trigger capture open */
 
 	struct caph_pcm_config pcm_config_playback;
 	struct caph_pcm_config pcm_config_capture;
@@ -69,4 +76,9 @@ struct caph_i2s {
 *
 *****************************************************************************/
 void ssp_ControlHWClock(Boolean);
+
+int caph_i2s_path_configure(struct caph_i2s *i2s,
+			    struct caph_pcm_config *pcm_config, int stream);
+void caph_i2s_path_start(struct caph_i2s *i2s, int stream);
+void caph_i2s_path_stop(struct caph_i2s *i2s, int stream);
 #endif
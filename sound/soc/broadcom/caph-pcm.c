@@ -34,10 +34,14 @@
 #include <linux/init.h>
 #include <linux/interrupt.h>
 #include <linux/kernel.h>
+#include <linux/ktime.h>
 #include <linux/module.h>
 #include <linux/platform_device.h>
+#include <linux/pm_wakeup.h>
 #include <linux/slab.h>
 #include <linux/dma-mapping.h>
+#include <linux/tick.h>
+#include <linux/uaccess.h>
 
 #include <sound/core.h>
 #include <sound/pcm.h>
@@ -56,6 +60,12 @@ static void playback_callback(CSL_CAPH_DMA_CHNL_e chnl);
 /*Callback function for capture DMA interrupt*/
 static void record_callback(CSL_CAPH_DMA_CHNL_e chnl);
 
+/* Given DMA channel for mmap streams (0: any free one). Not one of
+ * CSL_CAPH_DMA_CH12..16, those are tied to the DSP cfifos.
+ */
+static int lowlat_dma_ch;
+module_param(lowlat_dma_ch, int, S_IRUGO | S_IWUSR);
+
 /* snd_pcm_runtime private data structure*/
 struct caph_runtime_data {
 	CSL_CAPH_DMA_CHNL_e dmaCH;
@@ -66,6 +76,18 @@ struct caph_runtime_data {
 	dma_addr_t dma_start;
 	dma_addr_t dma_pos;
 	dma_addr_t dma_end;
+	/* mmap access: no copy() to hand periods back to the DMA, the
+	 * period interrupt does it and the DMA runs round the buffer
+	 */
+	bool free_run;
+	/* period interrupt timing, logged when the stream stops */
+	ktime_t start_time;
+	ktime_t last_irq;
+	u32 first_irq_us;
+	u32 irq_min_us;
+	u32 irq_max_us;
+	u32 periods;
+	u32 underruns;
 };
 
 /* identify hardware playback capabilities */
@@ -142,7 +164,12 @@ static void caph_pcm_configure(struct snd_pcm_substream *substream,
 		config = &i2s->pcm_config_playback;
 	}
 
-	dmaCfg.dma_ch = csl_caph_dma_obtain_channel();
+	dmaCfg.dma_ch = CSL_CAPH_DMA_NONE;
+	if (prtd->free_run && lowlat_dma_ch > CSL_CAPH_DMA_NONE &&
+	    lowlat_dma_ch <= CSL_CAPH_DMA_CH16)
+		dmaCfg.dma_ch = csl_caph_dma_obtain_given_channel(lowlat_dma_ch);
+	if (dmaCfg.dma_ch == CSL_CAPH_DMA_NONE)
+		dmaCfg.dma_ch = csl_caph_dma_obtain_channel();
 	dmaCfg.Tsize = CSL_AADMAC_TSIZE;
 	dmaCfg.mem_addr = (void *)buf->addr;
 	dmaCfg.dma_buf_size = prtd->dma_period;
@@ -171,6 +198,13 @@ static void caph_pcm_start_transfer(struct caph_runtime_data *prtd,
 				    struct snd_pcm_substream *substream)
 {
 /*No need to start DMA again, it is already start in i2s_dai trigger function*/
+	prtd->start_time = ktime_get();
+	prtd->last_irq = ktime_set(0, 0);
+	prtd->first_irq_us = 0;
+	prtd->irq_min_us = UINT_MAX;
+	prtd->irq_max_us = 0;
+	prtd->periods = 0;
+	prtd->underruns = 0;
 }
 
 /*****************************************************************************
@@ -186,6 +220,14 @@ static void caph_pcm_stop_transfer(struct caph_runtime_data *prtd,
 {
 	CSL_CAPH_ARM_DSP_e owner = CSL_CAPH_ARM;
 	pr_info("caph-pcm: caph_pcm_stop_transfer");
+	if (prtd->periods)
+		pr_info("caph-pcm: stream %d %s dma %d period %lu bytes: "
+			"first irq %u us, irq interval %u..%u us, "
+			"%u periods, %u underruns\n",
+			substream->stream, prtd->free_run ? "mmap" : "copy",
+			prtd->dmaCH, prtd->dma_period, prtd->first_irq_us,
+			prtd->irq_min_us, prtd->irq_max_us, prtd->periods,
+			prtd->underruns);
 	csl_caph_dma_clear_intr(prtd->dmaCH, owner);
 	csl_caph_dma_disable_intr(prtd->dmaCH, owner);
 	csl_caph_dma_stop_transfer(prtd->dmaCH);
@@ -206,12 +248,42 @@ static void caph_pcm_dma_transfer_done(void *dev_id)
 	struct snd_pcm_substream *substream = dev_id;
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct caph_runtime_data *prtd = runtime->private_data;
+	ktime_t now = ktime_get();
+	u32 us;
+
+	if (!prtd->periods++) {
+		prtd->first_irq_us = ktime_us_delta(now, prtd->start_time);
+	} else {
+		us = ktime_us_delta(now, prtd->last_irq);
+		prtd->irq_min_us = min(prtd->irq_min_us, us);
+		prtd->irq_max_us = max(prtd->irq_max_us, us);
+	}
+	prtd->last_irq = now;
+
 	prtd->dma_pos += runtime->period_size;
 	if (prtd->dma_pos >= runtime->buffer_size)
 		prtd->dma_pos = 0;
 	snd_pcm_period_elapsed(substream);
 }
 
+/*****************************************************************************
+*
+* Function Name: static void caph_pcm_rearm(struct caph_runtime_data *prtd,
+*				CSL_CAPH_DMA_CHNL_e chnl)
+*
+* Description: In mmap mode, give the buffer just reprogrammed back to the
+*		DMA right away, as caph_pcm_copy does for the other mode
+*
+*****************************************************************************/
+static void caph_pcm_rearm(struct caph_runtime_data *prtd,
+			   CSL_CAPH_DMA_CHNL_e chnl)
+{
+	if (!prtd->free_run)
+		return;
+	csl_caph_dma_set_ddrfifo_status(chnl, prtd->status);
+	prtd->status = CSL_CAPH_READY_NONE;
+}
+
 /*****************************************************************************
 *
 * Function Name: static void playback_callback(CSL_CAPH_DMA_CHNL_e chnl)
@@ -232,12 +304,17 @@ static void playback_callback(CSL_CAPH_DMA_CHNL_e chnl)
 
 		prtd->status = CSL_CAPH_READY_HIGH;
 		if (fifo_sataus == CSL_CAPH_READY_NONE) {
-			pr_info("underrun condition\n");
+			pr_info_ratelimited("underrun condition\n");
+			prtd->underruns++;
 			prtd->status = CSL_CAPH_READY_HIGHLOW;
 			dmaCfg.mem_addr = (void *)(buf->addr +
 					(prtd->block_index*prtd->dma_period));
-			memset(phys_to_virt((UInt32)dmaCfg.mem_addr), 0,
-						prtd->dma_period);
+			/* in mmap mode the period may hold what the
+			 * application wrote ahead, leave it
+			 */
+			if (!prtd->free_run)
+				memset(phys_to_virt((UInt32)dmaCfg.mem_addr),
+					0, prtd->dma_period);
 			csl_caph_dma_set_lobuffer_address(chnl,
 							dmaCfg.mem_addr);
 		}
@@ -250,6 +327,7 @@ static void playback_callback(CSL_CAPH_DMA_CHNL_e chnl)
 		dmaCfg.mem_addr = (void *)(buf->addr +
 					(prtd->block_index*prtd->dma_period));
 		csl_caph_dma_set_hibuffer_address(chnl, dmaCfg.mem_addr);
+		caph_pcm_rearm(prtd, chnl);
 
 	} else if ((fifo_sataus & CSL_CAPH_READY_LOW) == CSL_CAPH_READY_NONE) {
 
@@ -262,6 +340,7 @@ static void playback_callback(CSL_CAPH_DMA_CHNL_e chnl)
 		dmaCfg.mem_addr = (void *)(buf->addr +
 					(prtd->block_index*prtd->dma_period));
 		csl_caph_dma_set_lobuffer_address(chnl, dmaCfg.mem_addr);
+		caph_pcm_rearm(prtd, chnl);
 
 	}
 }
@@ -291,6 +370,7 @@ static void record_callback(CSL_CAPH_DMA_CHNL_e chnl)
 		dmaCfg.mem_addr = (void *)(buf->addr +
 					(prtd->block_index*prtd->dma_period));
 		csl_caph_dma_set_lobuffer_address(chnl, dmaCfg.mem_addr);
+		caph_pcm_rearm(prtd, chnl);
 
 	} else if ((fifo_sataus & CSL_CAPH_READY_HIGH) == CSL_CAPH_READY_NONE) {
 
@@ -301,11 +381,512 @@ static void record_callback(CSL_CAPH_DMA_CHNL_e chnl)
 		dmaCfg.mem_addr = (void *)(buf->addr +
 					(prtd->block_index*prtd->dma_period));
 		csl_caph_dma_set_hibuffer_address(chnl, dmaCfg.mem_addr);
+		caph_pcm_rearm(prtd, chnl);
 
 	}
 	caph_pcm_dma_transfer_done(substream_record);
 }
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+/*
+ * Always-on voice trigger capture, 48kHz 16 bit stereo from the i2s.
+ *
+ * The DMA runs round a private ring of CAPH_VT_SEGS segments, moving on
+ * to the next segment at each half interrupt as record_callback does. No
+ * period reaches the reader until the level of a whole segment goes over
+ * vt_level, so the cpus sleep between the CAPH_VT_SEG_MS interrupts and
+ * a blocking read() waits for the trigger. The level is worked out in a
+ * tasklet, not the DMA interrupt, as the ring is uncached. From then on
+ * the reader gets up to vt_preroll_ms of what came before the trigger,
+ * then the live capture, a segment behind. The ALSA buffer is only a
+ * window on the ring, so there is no mmap and copy() reads out of the
+ * ring. The two segments the DMA has been given are never handed out;
+ * when the reader falls so far behind that they would be, the stream
+ * overruns.
+ */
+#define CAPH_VT_FRAME_BYTES	4
+#define CAPH_VT_BYTES_PER_MS	(48 * CAPH_VT_FRAME_BYTES)
+#define CAPH_VT_SEG_MS		320
+#define CAPH_VT_SEG_BYTES	(CAPH_VT_SEG_MS * CAPH_VT_BYTES_PER_MS)
+#define CAPH_VT_SEGS		10
+#define CAPH_VT_RING_BYTES	(CAPH_VT_SEGS * CAPH_VT_SEG_BYTES)
+/* what is not being written by the DMA */
+#define CAPH_VT_SAFE_BYTES	((CAPH_VT_SEGS - 2) * CAPH_VT_SEG_BYTES)
+#define CAPH_VT_MAX_BUF_BYTES	(2 * CAPH_VT_SEG_BYTES)
+/* level of a segment from one sample in CAPH_VT_STRIDE */
+#define CAPH_VT_STRIDE		8
+
+/* mean absolute sample value that triggers, and for how many segments */
+static unsigned int vt_level = 800;
+module_param(vt_level, uint, S_IRUGO | S_IWUSR);
+static unsigned int vt_hits = 1;
+module_param(vt_hits, uint, S_IRUGO | S_IWUSR);
+static unsigned int vt_preroll_ms = 1500;
+module_param(vt_preroll_ms, uint, S_IRUGO | S_IWUSR);
+/* how long a trigger keeps the system awake for the reader */
+static unsigned int vt_wake_ms = 2000;
+module_param(vt_wake_ms, uint, S_IRUGO | S_IWUSR);
+
+static const struct snd_pcm_hardware caph_vt_hardware = {
+	.info = (SNDRV_PCM_INFO_INTERLEAVED | SNDRV_PCM_INFO_BLOCK_TRANSFER),
+	.formats = SNDRV_PCM_FMTBIT_S16_LE,
+	.rates = SNDRV_PCM_RATE_48000,
+	.rate_min = 48000,
+	.rate_max = 48000,
+	.channels_min = 2,
+	.channels_max = 2,
+	.buffer_bytes_max = CAPH_VT_MAX_BUF_BYTES,
+	.period_bytes_min = PCM_MIN_CAPTURE_PERIOD_BYTES,
+	.period_bytes_max = CAPH_VT_SEG_BYTES,
+	.periods_min = 2,
+	.periods_max = 32,
+};
+
+struct caph_vt_data {
+	struct snd_pcm_substream *substream;
+	CSL_CAPH_DMA_CHNL_e dmaCH;
+	CSL_CAPH_DMA_CHNL_FIFO_STATUS_e status;
+	unsigned int block_index;	/* segment last given to the DMA */
+	struct tasklet_struct deliver;
+	struct wakeup_source ws;
+
+	spinlock_t lock;
+	bool running;
+	bool triggered;
+	u32 segs;		/* segments filled since start */
+	u32 checked;		/* segments whose level has been looked at */
+	unsigned int hits;
+	u32 roff;		/* ring offset of the next byte to hand out */
+	u32 ravail;		/* bytes from roff on not handed out yet */
+	snd_pcm_uframes_t hw;	/* ALSA position, at roff */
+
+	/* statistics */
+	ktime_t start_time;
+	u32 triggers;
+	u32 overruns;
+	unsigned int peak;
+};
+
+static struct caph_vt_data *vt_stream;
+
+static inline bool caph_vt_substream(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+
+	return rtd->cpu_dai->driver->id == CAPH_I2S_DAI_VT;
+}
+
+/*****************************************************************************
+*
+*  Function Name: static unsigned int caph_vt_level(const s16 *seg)
+*
+*  Description: Mean absolute value of the left channel of a segment,
+*		from one frame in four
+*
+*****************************************************************************/
+static unsigned int caph_vt_level(const s16 *seg)
+{
+	u32 sum = 0;
+	int i;
+
+	for (i = 0; i < CAPH_VT_SEG_BYTES / 2; i += CAPH_VT_STRIDE)
+		sum += abs(seg[i]);
+	return sum / (CAPH_VT_SEG_BYTES / 2 / CAPH_VT_STRIDE);
+}
+
+static void caph_vt_hit(struct caph_vt_data *vt, unsigned int seg,
+			unsigned int level);
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_vt_deliver(unsigned long data)
+*
+*  Description: Until the trigger, check the level of the segments filled
+*		since last time. After it, move the ALSA position on by the
+*		whole periods the ring has and the reader has room for,
+*		leaving a period free so the stream does not stop on a full
+*		buffer. Run as a tasklet from the DMA interrupt and from ack,
+*		so only one context at a time moves the position and
+*		period_elapsed always sees it a period or more on.
+*
+*****************************************************************************/
+static void caph_vt_deliver(unsigned long data)
+{
+	struct caph_vt_data *vt = (struct caph_vt_data *)data;
+	struct snd_pcm_substream *substream = vt->substream;
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	snd_pcm_uframes_t avail, room, frames = 0;
+	unsigned int seg, level;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vt->lock, flags);
+	while (!vt->triggered && vt->running && vt->checked != vt->segs) {
+		/* a segment the DMA has moved on from stays put for as long
+		 * as it takes to get here, less than CAPH_VT_SEGS - 2 of them
+		 */
+		if (vt->segs - vt->checked > CAPH_VT_SEGS - 2)
+			vt->checked = vt->segs - 1;
+		seg = vt->checked++ % CAPH_VT_SEGS;
+		spin_unlock_irqrestore(&vt->lock, flags);
+
+		level = caph_vt_level((s16 *)(substream->dma_buffer.area +
+					      seg * CAPH_VT_SEG_BYTES));
+
+		spin_lock_irqsave(&vt->lock, flags);
+		vt->peak = max(vt->peak, level);
+		if (level < vt_level)
+			vt->hits = 0;
+		else if (++vt->hits >= vt_hits && vt->running)
+			caph_vt_hit(vt, seg, level);
+	}
+	spin_unlock_irqrestore(&vt->lock, flags);
+	if (!vt->triggered)
+		return;
+
+	snd_pcm_stream_lock_irqsave(substream, flags);
+	if (snd_pcm_running(substream)) {
+		avail = snd_pcm_capture_avail(runtime);
+		room = runtime->buffer_size - runtime->period_size;
+		room = avail < room ? room - avail : 0;
+
+		spin_lock(&vt->lock);
+		frames = min(bytes_to_frames(runtime, vt->ravail), room);
+		frames -= frames % runtime->period_size;
+		vt->ravail -= frames_to_bytes(runtime, frames);
+		vt->roff = (vt->roff + frames_to_bytes(runtime, frames)) %
+			   CAPH_VT_RING_BYTES;
+		vt->hw = (vt->hw + frames) % runtime->buffer_size;
+		spin_unlock(&vt->lock);
+	}
+	snd_pcm_stream_unlock_irqrestore(substream, flags);
+
+	if (frames)
+		snd_pcm_period_elapsed(substream);
+}
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_vt_hit(struct caph_vt_data *vt,
+*					unsigned int seg, unsigned int level)
+*
+*  Description: Start handing the ring out, from vt_preroll_ms before the
+*		end of segment seg. Called with vt->lock held.
+*
+*****************************************************************************/
+static void caph_vt_hit(struct caph_vt_data *vt, unsigned int seg,
+			unsigned int level)
+{
+	struct snd_pcm_runtime *runtime = vt->substream->runtime;
+	u32 pre, since, end;
+
+	/* and whatever has been filled since */
+	since = (vt->segs - vt->checked) * CAPH_VT_SEG_BYTES;
+	pre = min_t(u32, vt_preroll_ms * CAPH_VT_BYTES_PER_MS,
+		    vt->checked * CAPH_VT_SEG_BYTES);
+	pre = min_t(u32, pre, CAPH_VT_SAFE_BYTES - since -
+		    frames_to_bytes(runtime, runtime->buffer_size));
+	pre -= pre % CAPH_VT_FRAME_BYTES;
+
+	end = ((seg + 1) % CAPH_VT_SEGS) * CAPH_VT_SEG_BYTES;
+	vt->roff = (end + CAPH_VT_RING_BYTES - pre) % CAPH_VT_RING_BYTES;
+	vt->ravail = pre + since;
+	vt->triggered = true;
+	vt->triggers++;
+	__pm_wakeup_event(&vt->ws, vt_wake_ms);
+	pr_info("caph-pcm: voice trigger at level %u, %u ms pre-roll\n",
+		level, pre / CAPH_VT_BYTES_PER_MS);
+}
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_vt_callback(CSL_CAPH_DMA_CHNL_e chnl)
+*
+*  Description: Callback function for the voice trigger DMA interrupt,
+*		once per segment: give the DMA the next segment and leave
+*		the one just filled to caph_vt_deliver
+*
+*****************************************************************************/
+static void caph_vt_callback(CSL_CAPH_DMA_CHNL_e chnl)
+{
+	struct caph_vt_data *vt = vt_stream;
+	struct snd_pcm_substream *substream;
+	CSL_CAPH_DMA_CHNL_FIFO_STATUS_e fifo_status;
+	unsigned long flags;
+	bool overrun = false;
+	u8 *addr;
+
+	if (!vt)
+		return;
+	substream = vt->substream;
+
+	fifo_status = csl_caph_dma_read_ddrfifo_sw_status(chnl);
+	if ((fifo_status & CSL_CAPH_READY_LOW) == CSL_CAPH_READY_NONE)
+		vt->status = CSL_CAPH_READY_LOW;
+	else if ((fifo_status & CSL_CAPH_READY_HIGH) == CSL_CAPH_READY_NONE)
+		vt->status = CSL_CAPH_READY_HIGH;
+	else
+		return;
+
+	vt->block_index = (vt->block_index + 1) % CAPH_VT_SEGS;
+	addr = (u8 *)(substream->dma_buffer.addr +
+		      vt->block_index * CAPH_VT_SEG_BYTES);
+	if (vt->status == CSL_CAPH_READY_LOW)
+		csl_caph_dma_set_lobuffer_address(chnl, addr);
+	else
+		csl_caph_dma_set_hibuffer_address(chnl, addr);
+	csl_caph_dma_set_ddrfifo_status(chnl, vt->status);
+	vt->status = CSL_CAPH_READY_NONE;
+
+	spin_lock_irqsave(&vt->lock, flags);
+	if (!vt->running) {
+		spin_unlock_irqrestore(&vt->lock, flags);
+		return;
+	}
+	vt->segs++;
+	if (vt->triggered) {
+		vt->ravail += CAPH_VT_SEG_BYTES;
+		overrun = vt->ravail + snd_pcm_lib_buffer_bytes(substream) >
+			  CAPH_VT_SAFE_BYTES;
+	}
+	spin_unlock_irqrestore(&vt->lock, flags);
+
+	if (overrun) {
+		vt->overruns++;
+		snd_pcm_stream_lock_irqsave(substream, flags);
+		if (snd_pcm_running(substream))
+			snd_pcm_stop(substream, SNDRV_PCM_STATE_XRUN);
+		snd_pcm_stream_unlock_irqrestore(substream, flags);
+		return;
+	}
+	tasklet_schedule(&vt->deliver);
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_open
+*
+*  Description: Open the voice trigger stream
+*
+*****************************************************************************/
+static int caph_vt_open(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct caph_vt_data *vt;
+	int ret;
+
+	if (substream->dma_buffer.bytes < CAPH_VT_RING_BYTES)
+		return -ENOMEM;
+
+	vt = kzalloc(sizeof(*vt), GFP_KERNEL);
+	if (!vt)
+		return -ENOMEM;
+
+	snd_soc_set_runtime_hwparams(substream, &caph_vt_hardware);
+	/* the ALSA buffer maps whole periods onto the ring */
+	ret = snd_pcm_hw_constraint_integer(runtime,
+					    SNDRV_PCM_HW_PARAM_PERIODS);
+	if (ret < 0) {
+		kfree(vt);
+		return ret;
+	}
+
+	vt->substream = substream;
+	vt->dmaCH = CSL_CAPH_DMA_NONE;
+	spin_lock_init(&vt->lock);
+	tasklet_init(&vt->deliver, caph_vt_deliver, (unsigned long)vt);
+	wakeup_source_init(&vt->ws, "caph-vt");
+	runtime->private_data = vt;
+	vt_stream = vt;
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_close
+*
+*  Description: Close the voice trigger stream
+*
+*****************************************************************************/
+static int caph_vt_close(struct snd_pcm_substream *substream)
+{
+	struct caph_vt_data *vt = substream->runtime->private_data;
+
+	vt_stream = NULL;
+	tasklet_kill(&vt->deliver);
+	wakeup_source_trash(&vt->ws);
+	kfree(vt);
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_prepare
+*
+*  Description: Set the DMA up on the first two segments of the ring
+*
+*****************************************************************************/
+static int caph_vt_prepare(struct snd_pcm_substream *substream)
+{
+	struct snd_soc_pcm_runtime *rtd = substream->private_data;
+	struct snd_soc_dai *dai = rtd->cpu_dai;
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(dai);
+	struct caph_vt_data *vt = substream->runtime->private_data;
+	struct caph_pcm_config *config = &i2s->pcm_config_capture;
+	CSL_CAPH_DMA_CONFIG_t dmaCfg;
+	unsigned long flags;
+
+	/* prepared again without a stop in between */
+	if (vt->dmaCH != CSL_CAPH_DMA_NONE)
+		return 0;
+
+	dmaCfg.dma_ch = csl_caph_dma_obtain_channel();
+	if (dmaCfg.dma_ch == CSL_CAPH_DMA_NONE)
+		return -EBUSY;
+	dmaCfg.direction = CSL_CAPH_DMA_OUT;
+	dmaCfg.dmaCB = caph_vt_callback;
+	dmaCfg.fifo = CSL_CAPH_CFIFO_FIFO2;
+	dmaCfg.Tsize = CSL_AADMAC_TSIZE;
+	dmaCfg.mem_addr = (void *)substream->dma_buffer.addr;
+	dmaCfg.dma_buf_size = CAPH_VT_SEG_BYTES;
+	dmaCfg.n_dma_buf = 2;
+	dmaCfg.mem_size = 2 * CAPH_VT_SEG_BYTES;
+
+	csl_caph_dma_config_channel(dmaCfg);
+	csl_caph_dma_enable_intr(dmaCfg.dma_ch, CSL_CAPH_ARM);
+
+	config->dmaCH = dmaCfg.dma_ch;
+	config->fifo = dmaCfg.fifo;
+	config->sw = csl_caph_switch_obtain_channel();
+	snd_soc_dai_set_dma_data(dai, substream, config);
+
+	spin_lock_irqsave(&vt->lock, flags);
+	vt->dmaCH = dmaCfg.dma_ch;
+	vt->status = CSL_CAPH_READY_NONE;
+	vt->block_index = 1;
+	vt->segs = 0;
+	vt->checked = 0;
+	vt->hits = 0;
+	vt->triggered = false;
+	vt->roff = 0;
+	vt->ravail = 0;
+	vt->hw = 0;
+	spin_unlock_irqrestore(&vt->lock, flags);
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_trigger
+*
+*  Description: Start listening, or stop the DMA; the i2s dai starts and
+*		stops the path
+*
+*****************************************************************************/
+static int caph_vt_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct caph_vt_data *vt = substream->runtime->private_data;
+	CSL_CAPH_ARM_DSP_e owner = CSL_CAPH_ARM;
+
+	pr_info("caph-pcm: caph_vt_trigger() cmd: %d", cmd);
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+		spin_lock(&vt->lock);
+		vt->start_time = ktime_get();
+		vt->triggers = 0;
+		vt->overruns = 0;
+		vt->peak = 0;
+		vt->running = true;
+		spin_unlock(&vt->lock);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+	case SNDRV_PCM_TRIGGER_SUSPEND:
+		spin_lock(&vt->lock);
+		vt->running = false;
+		spin_unlock(&vt->lock);
+		if (vt->dmaCH == CSL_CAPH_DMA_NONE)
+			break;
+		csl_caph_dma_clear_intr(vt->dmaCH, owner);
+		csl_caph_dma_disable_intr(vt->dmaCH, owner);
+		csl_caph_dma_stop_transfer(vt->dmaCH);
+		csl_caph_dma_release_channel(vt->dmaCH);
+		vt->dmaCH = CSL_CAPH_DMA_NONE;
+		pr_info("caph-pcm: voice trigger %u ms: %u segments, "
+			"peak level %u, %u triggers, %u overruns\n",
+			(u32)ktime_to_ms(ktime_sub(ktime_get(),
+						   vt->start_time)),
+			vt->segs, vt->peak, vt->triggers, vt->overruns);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_pointer
+*
+*  Description: The ALSA position, as moved on by caph_vt_deliver
+*
+*****************************************************************************/
+static snd_pcm_uframes_t caph_vt_pointer(struct snd_pcm_substream *substream)
+{
+	struct caph_vt_data *vt = substream->runtime->private_data;
+
+	return vt->hw;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_copy
+*
+*  Description: Copy to user from the part of the ring that is at pos in
+*		the ALSA buffer, which is behind the position by less than
+*		the buffer
+*
+*****************************************************************************/
+static int caph_vt_copy(struct snd_pcm_substream *substream, int channel,
+	    snd_pcm_uframes_t pos, void __user *buf, snd_pcm_uframes_t count)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct caph_vt_data *vt = runtime->private_data;
+	char *ring = substream->dma_buffer.area;
+	u32 bytes = frames_to_bytes(runtime, count);
+	u32 back, off, n;
+	unsigned long flags;
+
+	spin_lock_irqsave(&vt->lock, flags);
+	back = frames_to_bytes(runtime, (vt->hw + runtime->buffer_size - pos) %
+			       runtime->buffer_size);
+	off = (vt->roff + CAPH_VT_RING_BYTES - back) % CAPH_VT_RING_BYTES;
+	spin_unlock_irqrestore(&vt->lock, flags);
+
+	n = min_t(u32, bytes, CAPH_VT_RING_BYTES - off);
+	if (copy_to_user(buf, ring + off, n))
+		return -EFAULT;
+	if (n < bytes && copy_to_user(buf + n, ring, bytes - n))
+		return -EFAULT;
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_vt_ack
+*
+*  Description: The reader took some: hand out more of the ring now rather
+*		than at the next segment
+*
+*****************************************************************************/
+static int caph_vt_ack(struct snd_pcm_substream *substream)
+{
+	struct caph_vt_data *vt = substream->runtime->private_data;
+
+	if (caph_vt_substream(substream) && vt->triggered)
+		tasklet_schedule(&vt->deliver);
+	return 0;
+}
+#endif
+
 /*****************************************************************************
 *
 *  Function Name: caph_pcm_hw_params
@@ -321,6 +902,10 @@ static int caph_pcm_hw_params(struct snd_pcm_substream *substream,
 
 	snd_pcm_set_runtime_buffer(substream, &substream->dma_buffer);
 	runtime->dma_bytes = params_buffer_bytes(params);
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return 0;
+#endif
 
 	prtd->dma_period = params_period_bytes(params);
 	prtd->num_block = 2;
@@ -328,6 +913,8 @@ static int caph_pcm_hw_params(struct snd_pcm_substream *substream,
 	prtd->dma_start = runtime->dma_addr;
 	prtd->dma_pos = prtd->dma_start;
 	prtd->dma_end = prtd->dma_start + runtime->dma_bytes;
+	prtd->free_run = (params_access(params) ==
+			  SNDRV_PCM_ACCESS_MMAP_INTERLEAVED);
 
 	return 0;
 }
@@ -356,6 +943,10 @@ static int caph_pcm_prepare(struct snd_pcm_substream *substream)
 {
 	struct caph_runtime_data *prtd = substream->runtime->private_data;
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return caph_vt_prepare(substream);
+#endif
 	caph_pcm_configure(substream, prtd);
 	prtd->dma_pos = 0;
 	return 0;
@@ -371,6 +962,10 @@ static int caph_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct caph_runtime_data *prtd = runtime->private_data;
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return caph_vt_trigger(substream, cmd);
+#endif
 	pr_info("caph-pcm: caph_pcm_trigger() cmd: %d", cmd);
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
@@ -404,6 +999,10 @@ static snd_pcm_uframes_t caph_pcm_pointer(struct snd_pcm_substream *substream)
 	struct caph_runtime_data *prtd = runtime->private_data;
 	snd_pcm_uframes_t offset;
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return caph_vt_pointer(substream);
+#endif
 	offset = prtd->dma_pos + bytes_to_frames(runtime, 0);
 	return offset;
 }
@@ -420,6 +1019,10 @@ static int caph_pcm_open(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct caph_runtime_data *prtd;
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return caph_vt_open(substream);
+#endif
 	prtd = kzalloc(sizeof(struct caph_runtime_data), GFP_KERNEL);
 	if (prtd == NULL)
 		return -ENOMEM;
@@ -447,6 +1050,10 @@ static int caph_pcm_close(struct snd_pcm_substream *substream)
 	struct snd_pcm_runtime *runtime = substream->runtime;
 	struct caph_runtime_data *prtd = runtime->private_data;
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return caph_vt_close(substream);
+#endif
 	kfree(prtd);
 
 	return 0;
@@ -455,9 +1062,14 @@ static int caph_pcm_close(struct snd_pcm_substream *substream)
 static int caph_pcm_mmap(struct snd_pcm_substream *substream,
 			 struct vm_area_struct *vma)
 {
-	return remap_pfn_range(vma, vma->vm_start,
-			       substream->dma_buffer.addr >> PAGE_SHIFT,
-			       vma->vm_end - vma->vm_start, vma->vm_page_prot);
+	struct snd_pcm_runtime *runtime = substream->runtime;
+
+	/* write combined like the kernel mapping, or the DMA reads stale
+	 * lines of what the application wrote
+	 */
+	return dma_mmap_writecombine(substream->pcm->card->dev, vma,
+				     runtime->dma_area, runtime->dma_addr,
+				     runtime->dma_bytes);
 }
 
 /*****************************************************************************
@@ -481,6 +1093,10 @@ static int caph_pcm_copy(struct snd_pcm_substream *substream, int channel,
 	char *new_hwbuf = NULL;
 	int periods_copied;
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	if (caph_vt_substream(substream))
+		return caph_vt_copy(substream, channel, pos, buf, count);
+#endif
 	if (substream == substream_playback)
 		not_copied = copy_from_user(hwbuf, buf, bytes_to_copy);
 	else if (substream == substream_record)
@@ -521,6 +1137,9 @@ static struct snd_pcm_ops caph_pcm_ops = {
 	.pointer = caph_pcm_pointer,
 	.mmap = caph_pcm_mmap,
 	.copy = caph_pcm_copy,
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	.ack = caph_vt_ack,
+#endif
 };
 
 /*****************************************************************************
@@ -530,20 +1149,16 @@ static struct snd_pcm_ops caph_pcm_ops = {
 *  Parameters:
 *  @pcm: snd_pcm handle
 *  @stream: PLAYBACK or CAPTURE stream
+*  @size: bytes to allocate
 *
 *  Description: allocate DMA buffer area, addr, bytes for stream
 *
 *****************************************************************************/
-static int caph_pcm_preallocate_dma_buffer(struct snd_pcm *pcm, int stream)
+static int caph_pcm_preallocate_dma_buffer(struct snd_pcm *pcm, int stream,
+					   size_t size)
 {
 	struct snd_pcm_substream *substream = pcm->streams[stream].substream;
 	struct snd_dma_buffer *buf = &substream->dma_buffer;
-	size_t size;
-
-	if (stream == SNDRV_PCM_STREAM_PLAYBACK)
-		size = caph_pcm_hardware_playback.buffer_bytes_max;
-	else
-		size = caph_pcm_hardware_capture.buffer_bytes_max;
 
 	buf->dev.type = SNDRV_DMA_TYPE_DEV;
 	buf->dev.dev = pcm->card->dev;
@@ -603,6 +1218,7 @@ int caph_pcm_new(struct snd_soc_pcm_runtime *rtd)
 	int ret = 0;
 	struct snd_card *card = rtd->card->snd_card;
 	struct snd_pcm *pcm = rtd->pcm;
+	size_t capture_size = caph_pcm_hardware_capture.buffer_bytes_max;
 
 	if (!card->dev->dma_mask)
 		card->dev->dma_mask = &caph_pcm_dmamask;
@@ -612,14 +1228,21 @@ int caph_pcm_new(struct snd_soc_pcm_runtime *rtd)
 
 	if (pcm->streams[SNDRV_PCM_STREAM_PLAYBACK].substream) {
 		ret = caph_pcm_preallocate_dma_buffer(pcm,
-			SNDRV_PCM_STREAM_PLAYBACK);
+			SNDRV_PCM_STREAM_PLAYBACK,
+			caph_pcm_hardware_playback.buffer_bytes_max);
 		if (ret)
 			goto err;
 	}
 
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	/* the voice trigger ring */
+	if (rtd->cpu_dai->driver->id == CAPH_I2S_DAI_VT)
+		capture_size = CAPH_VT_RING_BYTES;
+#endif
 	if (pcm->streams[SNDRV_PCM_STREAM_CAPTURE].substream) {
 		ret = caph_pcm_preallocate_dma_buffer(pcm,
-						      SNDRV_PCM_STREAM_CAPTURE);
+						      SNDRV_PCM_STREAM_CAPTURE,
+						      capture_size);
 		if (ret)
 			goto err;
 	}
@@ -628,8 +1251,560 @@ err:
 	return ret;
 }
 
+#ifdef CONFIG_SND_BCM_SOC_DEEP_BUFFER
+/*
+ * Deep buffer music playback through the compress API, 48kHz 16 bit
+ * stereo PCM only.
+ *
+ * The whole ring, up to CAPH_DEEP_MAX_BUF_BYTES, is one ping-pong DMA
+ * transfer on one of the channels that wrap over more than 64KB, so the
+ * DMA interrupts once per half of it: with the largest ring the cpu is
+ * woken every five seconds or so instead of every period. A half is
+ * handed to the DMA once the writer has filled it; when the writer
+ * falls behind, or drains, the rest of the half is filled with silence
+ * so the DMA never stalls on it.
+ */
+#define CAPH_DEEP_RATE			48000
+#define CAPH_DEEP_CHANNELS		2
+#define CAPH_DEEP_FRAME_BYTES		4
+#define CAPH_DEEP_MIN_FRAGMENT_BYTES	(4*1024)
+#define CAPH_DEEP_MAX_FRAGMENT_BYTES	(512*1024)
+#define CAPH_DEEP_MIN_FRAGMENTS		2
+#define CAPH_DEEP_MAX_FRAGMENTS		64
+/* about 10s of 48kHz stereo */
+#define CAPH_DEEP_MAX_BUF_BYTES		(2*1024*1024)
+
+struct caph_deep_data {
+	struct snd_compr_stream *cstream;
+	struct caph_i2s *i2s;
+	struct device *dev;
+	CSL_CAPH_DMA_CHNL_e dmaCH;
+	char *area;
+	dma_addr_t addr;
+	u32 bytes;		/* the ring, two halves */
+	u32 half;
+
+	spinlock_t lock;
+	/* positions in the ring, counting the silence filled in */
+	u64 wpos;		/* written */
+	u64 ready;		/* handed to the DMA */
+	u64 cpos;		/* played */
+	u64 drain_end;
+	u32 woff;		/* wpos in the ring */
+	int ready_idx;		/* next half to hand over, 0 low 1 high */
+	int play_idx;		/* half the DMA is on */
+	u32 half_app[2];	/* bytes of each half from the writer */
+	u32 app_done;		/* bytes from the writer played */
+	bool running;
+	bool draining;
+	bool copying;
+	bool starved;		/* ran dry during a copy */
+
+	/* statistics */
+	ktime_t start_time;
+	u32 irqs;
+	u32 underruns;
+	u64 idle_us[NR_CPUS];
+};
+
+static struct caph_deep_data *deep_stream;
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_deep_feed(struct caph_deep_data *dd,
+*					bool pad)
+*
+*  Description: Hand the DMA every half the writer has filled. With pad,
+*		also the half being written, its tail filled with silence.
+*		Called with dd->lock held.
+*
+*****************************************************************************/
+static void caph_deep_feed(struct caph_deep_data *dd, bool pad)
+{
+	u32 fill, gap;
+
+	while (dd->ready - dd->cpos < dd->bytes) {
+		fill = dd->wpos - dd->ready;
+		if (fill >= dd->half) {
+			fill = dd->half;
+		} else if (pad) {
+			gap = dd->half - fill;
+			memset(dd->area + dd->woff, 0, gap);
+			dd->woff += gap;
+			if (dd->woff == dd->bytes)
+				dd->woff = 0;
+			dd->wpos += gap;
+			pad = false;
+		} else {
+			break;
+		}
+		dd->half_app[dd->ready_idx] = fill;
+		csl_caph_dma_set_ddrfifo_status(dd->dmaCH, dd->ready_idx ?
+				CSL_CAPH_READY_HIGH : CSL_CAPH_READY_LOW);
+		dd->ready_idx ^= 1;
+		dd->ready += dd->half;
+	}
+}
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_deep_callback(CSL_CAPH_DMA_CHNL_e chnl)
+*
+*  Description: Callback function for the deep buffer DMA interrupt, once
+*		per half played
+*
+*****************************************************************************/
+static void caph_deep_callback(CSL_CAPH_DMA_CHNL_e chnl)
+{
+	struct caph_deep_data *dd = deep_stream;
+	struct snd_compr_runtime *runtime;
+	CSL_CAPH_DMA_CHNL_FIFO_STATUS_e status;
+	bool drained = false;
+
+	if (!dd)
+		return;
+	runtime = dd->cstream->runtime;
+
+	spin_lock(&dd->lock);
+	status = csl_caph_dma_read_ddrfifo_sw_status(chnl);
+	if (!dd->running || dd->ready == dd->cpos ||
+	    (status & (dd->play_idx ? CSL_CAPH_READY_HIGH :
+		       CSL_CAPH_READY_LOW))) {
+		/* not the end of the half in play */
+		spin_unlock(&dd->lock);
+		return;
+	}
+
+	dd->irqs++;
+	dd->cpos += dd->half;
+	dd->app_done += dd->half_app[dd->play_idx];
+	dd->play_idx ^= 1;
+
+	if (dd->ready == dd->cpos) {
+		if (!dd->draining && runtime->state == SNDRV_PCM_STATE_RUNNING) {
+			pr_info_ratelimited("caph-pcm: deep buffer underrun\n");
+			dd->underruns++;
+		}
+		/* caph_deep_copy feeds it when done with the ring */
+		if (dd->copying)
+			dd->starved = true;
+		else
+			caph_deep_feed(dd, true);
+	}
+
+	/* the core only waits for the drain after the trigger */
+	if (dd->draining && dd->cpos >= dd->drain_end &&
+	    runtime->state == SNDRV_PCM_STATE_DRAINING) {
+		dd->draining = false;
+		drained = true;
+	}
+	spin_unlock(&dd->lock);
+
+	if (drained)
+		snd_compr_drain_notify(dd->cstream);
+	else
+		snd_compr_fragment_elapsed(dd->cstream);
+}
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_deep_report(struct caph_deep_data *dd)
+*
+*  Description: Log how often the stream woke the cpu and how long each
+*		cpu was idle while it played
+*
+*****************************************************************************/
+static void caph_deep_report(struct caph_deep_data *dd)
+{
+	u32 ms = ktime_to_ms(ktime_sub(ktime_get(), dd->start_time));
+	u64 idle;
+	int cpu;
+
+	if (!ms)
+		return;
+	pr_info("caph-pcm: deep buffer %u bytes dma %d: %u ms, %u wakeups "
+		"(%u per minute), %u underruns\n", dd->bytes, dd->dmaCH, ms,
+		dd->irqs, (u32)div_u64((u64)dd->irqs * 60000, ms),
+		dd->underruns);
+
+	for_each_online_cpu(cpu) {
+		idle = get_cpu_idle_time_us(cpu, NULL);
+		if (idle == -1ULL || dd->idle_us[cpu] == -1ULL)
+			continue;
+		pr_info("caph-pcm: deep buffer cpu%d idle %u%%\n", cpu,
+			(u32)div_u64((idle - dd->idle_us[cpu]) / 10, ms));
+	}
+}
+
+/*****************************************************************************
+*
+*  Function Name: static int caph_deep_start(struct caph_deep_data *dd)
+*
+*  Description: Configure the DMA and the i2s path and start playing
+*
+*****************************************************************************/
+static int caph_deep_start(struct caph_deep_data *dd)
+{
+	struct caph_pcm_config *config = &dd->i2s->pcm_config_playback;
+	CSL_CAPH_DMA_CONFIG_t dmaCfg;
+	unsigned long flags;
+	int cpu;
+
+	if (!dd->area)
+		return -EINVAL;
+
+	/* only CH1 and CH2 wrap over more than 64KB */
+	dmaCfg.dma_ch = csl_caph_dma_obtain_given_channel(CSL_CAPH_DMA_CH1);
+	if (dmaCfg.dma_ch == CSL_CAPH_DMA_NONE)
+		dmaCfg.dma_ch =
+			csl_caph_dma_obtain_given_channel(CSL_CAPH_DMA_CH2);
+	if (dmaCfg.dma_ch == CSL_CAPH_DMA_NONE) {
+		pr_info("caph-pcm: no long wrap dma channel for deep buffer\n");
+		return -EBUSY;
+	}
+	dmaCfg.direction = CSL_CAPH_DMA_IN;
+	dmaCfg.dmaCB = caph_deep_callback;
+	dmaCfg.fifo = CSL_CAPH_CFIFO_FIFO1;
+	dmaCfg.Tsize = CSL_AADMAC_TSIZE;
+	dmaCfg.mem_addr = (void *)dd->addr;
+	dmaCfg.dma_buf_size = dd->half;
+	dmaCfg.n_dma_buf = 2;
+	dmaCfg.mem_size = dd->bytes;
+
+	csl_caph_dma_config_channel(dmaCfg);
+	/* both halves are marked ready, they are handed over as they fill */
+	csl_caph_dma_clear_ddrfifo_status(dmaCfg.dma_ch);
+	csl_caph_dma_enable_intr(dmaCfg.dma_ch, CSL_CAPH_ARM);
+
+	config->dmaCH = dmaCfg.dma_ch;
+	config->fifo = dmaCfg.fifo;
+	config->sw = csl_caph_switch_obtain_channel();
+	caph_i2s_path_configure(dd->i2s, config, SNDRV_PCM_STREAM_PLAYBACK);
+
+	dd->start_time = ktime_get();
+	dd->irqs = 0;
+	dd->underruns = 0;
+	for_each_possible_cpu(cpu)
+		dd->idle_us[cpu] = get_cpu_idle_time_us(cpu, NULL);
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->dmaCH = dmaCfg.dma_ch;
+	dd->running = true;
+	/* start on what was written, even if short of a half */
+	caph_deep_feed(dd, dd->wpos - dd->ready < dd->half);
+	spin_unlock_irqrestore(&dd->lock, flags);
+
+	caph_i2s_path_start(dd->i2s, SNDRV_PCM_STREAM_PLAYBACK);
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: static void caph_deep_stop(struct caph_deep_data *dd)
+*
+*  Description: Stop the i2s path and the DMA and drop what is queued
+*
+*****************************************************************************/
+static void caph_deep_stop(struct caph_deep_data *dd)
+{
+	CSL_CAPH_ARM_DSP_e owner = CSL_CAPH_ARM;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->running = false;
+	spin_unlock_irqrestore(&dd->lock, flags);
+
+	caph_i2s_path_stop(dd->i2s, SNDRV_PCM_STREAM_PLAYBACK);
+	csl_caph_dma_clear_intr(dd->dmaCH, owner);
+	csl_caph_dma_disable_intr(dd->dmaCH, owner);
+	csl_caph_dma_stop_transfer(dd->dmaCH);
+	csl_caph_dma_release_channel(dd->dmaCH);
+	caph_deep_report(dd);
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->dmaCH = CSL_CAPH_DMA_NONE;
+	dd->wpos = dd->ready = dd->cpos = 0;
+	dd->woff = 0;
+	dd->ready_idx = dd->play_idx = 0;
+	dd->app_done = 0;
+	dd->draining = false;
+	dd->starved = false;
+	spin_unlock_irqrestore(&dd->lock, flags);
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_deep_open
+*
+*  Description: Open the deep buffer stream; it has the playback cfifo and
+*		i2s tx, so it excludes PCM playback
+*
+*****************************************************************************/
+static int caph_deep_open(struct snd_compr_stream *cstream)
+{
+	struct snd_soc_pcm_runtime *rtd = cstream->private_data;
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(rtd->cpu_dai);
+	struct caph_deep_data *dd;
+
+	if (i2s->fmTxPcm || i2s->fmTxDeep)
+		return -EBUSY;
+
+	dd = kzalloc(sizeof(*dd), GFP_KERNEL);
+	if (!dd)
+		return -ENOMEM;
+	spin_lock_init(&dd->lock);
+	dd->cstream = cstream;
+	dd->i2s = i2s;
+	dd->dev = rtd->card->snd_card->dev;
+	dd->dmaCH = CSL_CAPH_DMA_NONE;
+
+	i2s->fmTxDeep = TRUE;
+	cstream->runtime->private_data = dd;
+	deep_stream = dd;
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_deep_free
+*
+*  Description: Close the deep buffer stream, stopping it if still playing
+*
+*****************************************************************************/
+static int caph_deep_free(struct snd_compr_stream *cstream)
+{
+	struct caph_deep_data *dd = cstream->runtime->private_data;
+
+	if (dd->running)
+		caph_deep_stop(dd);
+	deep_stream = NULL;
+	if (dd->area)
+		dma_free_writecombine(dd->dev, dd->bytes, dd->area, dd->addr);
+	dd->i2s->fmTxDeep = FALSE;
+	kfree(dd);
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_deep_set_params
+*
+*  Description: Check the format and allocate the ring
+*
+*****************************************************************************/
+static int caph_deep_set_params(struct snd_compr_stream *cstream,
+				struct snd_compr_params *params)
+{
+	struct caph_deep_data *dd = cstream->runtime->private_data;
+	u32 frag = params->buffer.fragment_size;
+	u32 nfrag = params->buffer.fragments;
+	u32 bytes;
+
+	if (params->codec.id != SND_AUDIOCODEC_PCM ||
+	    params->codec.ch_in != CAPH_DEEP_CHANNELS ||
+	    (params->codec.sample_rate != CAPH_DEEP_RATE &&
+	     params->codec.sample_rate != SNDRV_PCM_RATE_48000))
+		return -EINVAL;
+
+	/* an even number of fragments, so the halves hold whole frames */
+	if (frag < CAPH_DEEP_MIN_FRAGMENT_BYTES ||
+	    frag > CAPH_DEEP_MAX_FRAGMENT_BYTES ||
+	    frag % CAPH_DEEP_FRAME_BYTES ||
+	    nfrag < CAPH_DEEP_MIN_FRAGMENTS ||
+	    nfrag > CAPH_DEEP_MAX_FRAGMENTS || nfrag & 1)
+		return -EINVAL;
+	bytes = frag * nfrag;
+	if (bytes > CAPH_DEEP_MAX_BUF_BYTES)
+		return -EINVAL;
+	if (dd->running)
+		return -EBUSY;
+
+	if (dd->area)
+		dma_free_writecombine(dd->dev, dd->bytes, dd->area, dd->addr);
+	dd->area = dma_alloc_writecombine(dd->dev, bytes, &dd->addr,
+					  GFP_KERNEL);
+	if (!dd->area)
+		return -ENOMEM;
+	memset(dd->area, 0, bytes);
+	dd->bytes = bytes;
+	dd->half = bytes / 2;
+	pr_info("caph-pcm: deep buffer %u x %u bytes\n", nfrag, frag);
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_deep_trigger
+*
+*  Description: Start, stop and drain. A start after a drain picks up
+*		where it left off, the DMA having played silence meanwhile.
+*		There is no pause.
+*
+*****************************************************************************/
+static int caph_deep_trigger(struct snd_compr_stream *cstream, int cmd)
+{
+	struct caph_deep_data *dd = cstream->runtime->private_data;
+	unsigned long flags;
+
+	pr_info("caph-pcm: caph_deep_trigger() cmd: %d", cmd);
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+		if (!dd->running)
+			return caph_deep_start(dd);
+		spin_lock_irqsave(&dd->lock, flags);
+		dd->draining = false;
+		caph_deep_feed(dd, false);
+		spin_unlock_irqrestore(&dd->lock, flags);
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+		if (dd->running)
+			caph_deep_stop(dd);
+		break;
+	case SND_COMPR_TRIGGER_DRAIN:
+		spin_lock_irqsave(&dd->lock, flags);
+		if (dd->wpos != dd->ready)
+			caph_deep_feed(dd, true);
+		dd->drain_end = dd->wpos;
+		dd->draining = true;
+		spin_unlock_irqrestore(&dd->lock, flags);
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_deep_pointer
+*
+*  Description: Report how much of what was written has been played
+*
+*****************************************************************************/
+static int caph_deep_pointer(struct snd_compr_stream *cstream,
+			     struct snd_compr_tstamp *tstamp)
+{
+	struct caph_deep_data *dd = cstream->runtime->private_data;
+	unsigned long flags;
+
+	spin_lock_irqsave(&dd->lock, flags);
+	tstamp->byte_offset = dd->play_idx * dd->half;
+	tstamp->copied_total = dd->app_done;
+	tstamp->pcm_io_frames = dd->app_done / CAPH_DEEP_FRAME_BYTES;
+	tstamp->sampling_rate = CAPH_DEEP_RATE;
+	spin_unlock_irqrestore(&dd->lock, flags);
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: caph_deep_copy
+*
+*  Description: Copy from user into the ring, handing over each half as it
+*		fills. The room is worked out here: silence filled in on an
+*		underrun takes ring space the core does not know about.
+*
+*****************************************************************************/
+static int caph_deep_copy(struct snd_compr_stream *cstream,
+			  char __user *buf, size_t count)
+{
+	struct caph_deep_data *dd = cstream->runtime->private_data;
+	unsigned long flags;
+	u32 n, woff;
+	int copied = 0;
+
+	if (!dd->area)
+		return -EINVAL;
+
+	while (count) {
+		spin_lock_irqsave(&dd->lock, flags);
+		n = dd->bytes - (u32)(dd->wpos - dd->cpos);
+		n = min_t(u32, n, dd->bytes - dd->woff);
+		n = min_t(size_t, n, count);
+		woff = dd->woff;
+		dd->copying = true;
+		spin_unlock_irqrestore(&dd->lock, flags);
+		if (!n)
+			break;
+
+		if (copy_from_user(dd->area + woff, buf, n)) {
+			spin_lock_irqsave(&dd->lock, flags);
+			dd->copying = false;
+			if (dd->starved) {
+				dd->starved = false;
+				caph_deep_feed(dd, true);
+			}
+			spin_unlock_irqrestore(&dd->lock, flags);
+			return copied ? copied : -EFAULT;
+		}
+
+		spin_lock_irqsave(&dd->lock, flags);
+		dd->woff = woff + n;
+		if (dd->woff == dd->bytes)
+			dd->woff = 0;
+		dd->wpos += n;
+		dd->copying = false;
+		if (dd->running)
+			caph_deep_feed(dd, dd->starved);
+		dd->starved = false;
+		spin_unlock_irqrestore(&dd->lock, flags);
+
+		buf += n;
+		count -= n;
+		copied += n;
+	}
+
+	spin_lock_irqsave(&dd->lock, flags);
+	dd->copying = false;
+	spin_unlock_irqrestore(&dd->lock, flags);
+	return copied;
+}
+
+static int caph_deep_get_caps(struct snd_compr_stream *cstream,
+			      struct snd_compr_caps *caps)
+{
+	caps->num_codecs = 1;
+	caps->codecs[0] = SND_AUDIOCODEC_PCM;
+	caps->direction = SND_COMPRESS_PLAYBACK;
+	caps->min_fragment_size = CAPH_DEEP_MIN_FRAGMENT_BYTES;
+	caps->max_fragment_size = CAPH_DEEP_MAX_FRAGMENT_BYTES;
+	caps->min_fragments = CAPH_DEEP_MIN_FRAGMENTS;
+	caps->max_fragments = CAPH_DEEP_MAX_FRAGMENTS;
+	return 0;
+}
+
+static int caph_deep_get_codec_caps(struct snd_compr_stream *cstream,
+				    struct snd_compr_codec_caps *codec)
+{
+	if (codec->codec != SND_AUDIOCODEC_PCM)
+		return -EINVAL;
+	codec->num_descriptors = 1;
+	codec->descriptor[0].max_ch = CAPH_DEEP_CHANNELS;
+	codec->descriptor[0].sample_rates = SNDRV_PCM_RATE_48000;
+	codec->descriptor[0].formats = SNDRV_PCM_FMTBIT_S16_LE;
+	codec->descriptor[0].min_buffer = CAPH_DEEP_MIN_FRAGMENT_BYTES *
+					  CAPH_DEEP_MIN_FRAGMENTS;
+	return 0;
+}
+
+/*compress device operations*/
+static struct snd_compr_ops caph_compr_ops = {
+	.open = caph_deep_open,
+	.free = caph_deep_free,
+	.set_params = caph_deep_set_params,
+	.trigger = caph_deep_trigger,
+	.pointer = caph_deep_pointer,
+	.copy = caph_deep_copy,
+	.get_caps = caph_deep_get_caps,
+	.get_codec_caps = caph_deep_get_codec_caps,
+};
+#endif
+
 static struct snd_soc_platform_driver caph_soc_platform = {
 	.ops = &caph_pcm_ops,
+#ifdef CONFIG_SND_BCM_SOC_DEEP_BUFFER
+	.compr_ops = &caph_compr_ops,
+#endif
 	.pcm_new = caph_pcm_new,
 	.pcm_free = caph_pcm_free,
 };
@@ -39,7 +39,8 @@
 #include "csl_caph_dma.h"
 
 #define	PCM_MAX_PLAYBACK_BUF_BYTES			(32*1024)
-#define	PCM_MIN_PLAYBACK_PERIOD_BYTES		(256)
+/* 1ms of 48kHz stereo, for the mmap (low latency) mode */
+#define	PCM_MIN_PLAYBACK_PERIOD_BYTES		(192)
 #define	PCM_MAX_PLAYBACK_PERIOD_BYTES		(PCM_MAX_PLAYBACK_BUF_BYTES/2)
 
 #define	PCM_MAX_CAPTURE_BUF_BYTES			(32*1024)
@@ -41,6 +41,13 @@ Copyright 2009, 2010 Broadcom Corporation.  All rights reserved.          */
 */
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#ifdef CONFIG_SND_BCM_SOC_NEON
+#include <linux/hardirq.h>
+#include <linux/init.h>
+#include <linux/random.h>
+#include <asm/hwcap.h>
+#include <asm/neon.h>
+#endif
 #include "mobcom_types.h"
 #include "audio_consts.h"
 
@@ -53,80 +60,339 @@ static UInt16 i_hack;
 /*static UInt16 i_hack = 0; */
 #endif
 
-static void AUDQUE_MemCpyInterleave(UInt8 *dest,
-				    UInt8 *source,
-				    UInt8 *source2,
-				    UInt32 size,
-				    AUDIO_BITS_PER_SAMPLE_t bitPerSample);
+#ifdef CONFIG_SND_BCM_SOC_NEON
+/* Set at boot when the cpu has NEON and the self-test passed */
+static bool audque_use_neon __read_mostly;
+
+/* below this many samples per channel, kernel_neon_begin costs more */
+#define AUDQUE_NEON_MIN_SAMPLES	64
+
+static inline bool AUDQUE_NeonOk(UInt32 samples, bool neon)
+{
+	return neon && samples >= AUDQUE_NEON_MIN_SAMPLES && !in_interrupt();
+}
+#endif
+
 /*
- * Function Name: AUDQUE_MemCpyInterleave
+ * Function Name: AUDQUE_DoInterleave
  *
- * Description: Copy data from two buffers as interleaved into the dest buffer
+ * Description: Interleave samples of width bytes from two buffers,
+ *		samples per buffer; NEON for the bulk when neon is set
 */
 
-static void AUDQUE_MemCpyInterleave(UInt8 *dest,
-				    UInt8 *source,
-				    UInt8 *source2,
-				    UInt32 size,
-				    AUDIO_BITS_PER_SAMPLE_t bitPerSample)
+static void AUDQUE_DoInterleave(void *dest, const void *source,
+				const void *source2, UInt32 samples,
+				int width, bool neon)
 {
 	UInt32 i = 0;
-#if 0
-	UInt32 j = 0;
-	UInt32 step = 0;
 
-	if (bitPerSample == 16)
-		step = 2;
-	else if (bitPerSample == 32)
-		step = 4;
-	else
-		audio_xassert(0, bitPerSample);
+#ifdef CONFIG_SND_BCM_SOC_NEON
+	if (AUDQUE_NeonOk(samples, neon)) {
+		i = samples & ~(AUDQUE_NEON_BLOCK - 1);
+		kernel_neon_begin();
+		if (width == 2)
+			AUDQUE_NeonInterleave16(dest, source, source2,
+						i / AUDQUE_NEON_BLOCK);
+		else
+			AUDQUE_NeonInterleave32(dest, source, source2,
+						i / AUDQUE_NEON_BLOCK);
+		kernel_neon_end();
+	}
+#endif
+
+	if (width == 2) {
+		UInt16 *dest16 = dest;
+		const UInt16 *src_16 = source;
+		const UInt16 *src2_16 = source2;
 
-	while (i < size) {
-		for (j = 0; j < step; j++)
-			*(dest + j) = *(source + j);
+		for (; i < samples; i++) {
+			dest16[2 * i] = src_16[i];
+			dest16[2 * i + 1] = src2_16[i];
 		}
-/*        memcpy(dest, source, step); */
-		dest = dest + step;
-		for (j = 0; j < step; j++)
-			*(dest + j) = *(source2 + j);
+	} else {
+		UInt32 *dest32 = dest;
+		const UInt32 *src_32 = source;
+		const UInt32 *src2_32 = source2;
 
-/*        memcpy(dest, source2, step); */
+		for (; i < samples; i++) {
+			dest32[2 * i] = src_32[i];
+			dest32[2 * i + 1] = src2_32[i];
+		}
+	}
+}
 
-		source2 = source2 + step;
-		source = source + step;
-		dest = dest + step;
-		i++;
+/*
+ * Function Name: AUDQUE_DoDeinterleave
+ *
+ * Description: Split interleaved samples of width bytes into two buffers
+*/
+
+static void AUDQUE_DoDeinterleave(void *dest, void *dest2,
+				  const void *source, UInt32 samples,
+				  int width, bool neon)
+{
+	UInt32 i = 0;
+
+#ifdef CONFIG_SND_BCM_SOC_NEON
+	if (AUDQUE_NeonOk(samples, neon)) {
+		i = samples & ~(AUDQUE_NEON_BLOCK - 1);
+		kernel_neon_begin();
+		if (width == 2)
+			AUDQUE_NeonDeinterleave16(dest, dest2, source,
+						  i / AUDQUE_NEON_BLOCK);
+		else
+			AUDQUE_NeonDeinterleave32(dest, dest2, source,
+						  i / AUDQUE_NEON_BLOCK);
+		kernel_neon_end();
 	}
+#endif
 
-#else
+	if (width == 2) {
+		UInt16 *dest16 = dest;
+		UInt16 *dest2_16 = dest2;
+		const UInt16 *src_16 = source;
 
-	if (bitPerSample == 16) {
-		UInt16 *dest16 = (void *)dest;
-		UInt16 *src_16 = (void *)source;
-		UInt16 *src2_16 = (void *)source2;
-		for (i = 0; i < size / 2; i++) {
-			*dest16++ = *src_16++;
-			*dest16++ = *src2_16++;
-		}
-	} else
-	    if (bitPerSample > 16
-		&& bitPerSample <= 32) {
-		UInt32 *dest32 = (void *)dest;
-		UInt32 *src_32 = (void *)source;
-		UInt32 *src2_32 = (void *)source2;
-		for (i = 0; i < size / 4; i++) {
-			*dest32++ = *src_32++;
-			*dest32++ = *src2_32++;
+		for (; i < samples; i++) {
+			dest16[i] = src_16[2 * i];
+			dest2_16[i] = src_16[2 * i + 1];
 		}
 	} else {
-		audio_xassert(0, bitPerSample);
+		UInt32 *dest32 = dest;
+		UInt32 *dest2_32 = dest2;
+		const UInt32 *src_32 = source;
+
+		for (; i < samples; i++) {
+			dest32[i] = src_32[2 * i];
+			dest2_32[i] = src_32[2 * i + 1];
+		}
+	}
+}
+
+/*
+ * Function Name: AUDQUE_DoExpand16
+ *
+ * Description: Widen 16 bit samples to 24 (right justified, sign
+ *		extended) or 32 bit
+*/
+
+static void AUDQUE_DoExpand16(UInt32 *dest, const UInt16 *source,
+			      UInt32 samples, int shift, bool neon)
+{
+	UInt32 i = 0;
+
+#ifdef CONFIG_SND_BCM_SOC_NEON
+	if (AUDQUE_NeonOk(samples, neon)) {
+		i = samples & ~(AUDQUE_NEON_BLOCK - 1);
+		kernel_neon_begin();
+		AUDQUE_NeonExpand16(dest, source, i / AUDQUE_NEON_BLOCK, shift);
+		kernel_neon_end();
 	}
+#endif
+
+	for (; i < samples; i++)
+		dest[i] = (UInt32)(Int32)(Int16)source[i] << shift;
+}
+
+/*
+ * Function Name: AUDQUE_DoShrink16
+ *
+ * Description: Narrow 24 or 32 bit samples to 16 bit, dropping the low
+ *		bits
+*/
+
+static void AUDQUE_DoShrink16(UInt16 *dest, const UInt32 *source,
+			      UInt32 samples, int shift, bool neon)
+{
+	UInt32 i = 0;
 
+#ifdef CONFIG_SND_BCM_SOC_NEON
+	if (AUDQUE_NeonOk(samples, neon)) {
+		i = samples & ~(AUDQUE_NEON_BLOCK - 1);
+		kernel_neon_begin();
+		AUDQUE_NeonShrink16(dest, source, i / AUDQUE_NEON_BLOCK, shift);
+		kernel_neon_end();
+	}
 #endif
-	return;
+
+	for (; i < samples; i++)
+		dest[i] = (UInt16)((Int32)source[i] >> shift);
+}
+
+static int AUDQUE_SampleWidth(AUDIO_BITS_PER_SAMPLE_t bitPerSample)
+{
+	if (bitPerSample == 16)
+		return 2;
+	if (bitPerSample > 16 && bitPerSample <= 32)
+		return 4;
+	audio_xassert(0, bitPerSample);
+	return 0;
+}
+
+static bool AUDQUE_UseNeon(void)
+{
+#ifdef CONFIG_SND_BCM_SOC_NEON
+	return audque_use_neon;
+#else
+	return false;
+#endif
+}
+
+/*
+ * Function Name: AUDQUE_Interleave
+ *
+ * Description: Copy data from two buffers as interleaved into the dest
+ *		buffer. size is the number of bytes written to dest, half
+ *		of it from each source.
+*/
+
+void AUDQUE_Interleave(UInt8 *dest, UInt8 *source, UInt8 *source2,
+		       UInt32 size, AUDIO_BITS_PER_SAMPLE_t bitPerSample)
+{
+	int width = AUDQUE_SampleWidth(bitPerSample);
+
+	if (width)
+		AUDQUE_DoInterleave(dest, source, source2,
+				    size / (2 * width), width,
+				    AUDQUE_UseNeon());
+}
+
+/*
+ * Function Name: AUDQUE_Deinterleave
+ *
+ * Description: Split interleaved data into two buffers. size is the
+ *		number of bytes read from source, half going to each dest.
+*/
+
+void AUDQUE_Deinterleave(UInt8 *dest, UInt8 *dest2, UInt8 *source,
+			 UInt32 size, AUDIO_BITS_PER_SAMPLE_t bitPerSample)
+{
+	int width = AUDQUE_SampleWidth(bitPerSample);
+
+	if (width)
+		AUDQUE_DoDeinterleave(dest, dest2, source,
+				      size / (2 * width), width,
+				      AUDQUE_UseNeon());
+}
+
+/*
+ * Function Name: AUDQUE_Expand16
+ *
+ * Description: Convert 16 bit samples to 24 or 32 bit ones
+*/
+
+void AUDQUE_Expand16(UInt32 *dest, UInt16 *source, UInt32 samples,
+		     AUDIO_BITS_PER_SAMPLE_t bitPerSample)
+{
+	AUDQUE_DoExpand16(dest, source, samples, bitPerSample - 16,
+			  AUDQUE_UseNeon());
+}
+
+/*
+ * Function Name: AUDQUE_Shrink16
+ *
+ * Description: Convert 24 or 32 bit samples to 16 bit ones
+*/
+
+void AUDQUE_Shrink16(UInt16 *dest, UInt32 *source, UInt32 samples,
+		     AUDIO_BITS_PER_SAMPLE_t bitPerSample)
+{
+	AUDQUE_DoShrink16(dest, source, samples, bitPerSample - 16,
+			  AUDQUE_UseNeon());
 }
 
+#ifdef CONFIG_SND_BCM_SOC_NEON
+/*
+ * Function Name: AUDQUE_NeonSelfTest
+ *
+ * Description: Check every NEON routine is bit exact with the C loops,
+ *		on random data and on lengths with and without a tail
+*/
+
+static int __init AUDQUE_NeonSelfTest(void)
+{
+	static const UInt32 lengths[] = {
+		AUDQUE_NEON_MIN_SAMPLES, AUDQUE_NEON_MIN_SAMPLES + 1,
+		AUDQUE_NEON_MIN_SAMPLES + AUDQUE_NEON_BLOCK - 1, 1000, 1024,
+	};
+	const UInt32 max = 1024;
+	UInt8 *a, *c, *d, *e;
+	int i, width, shift, ret = -ENOMEM;
+	UInt32 n;
+
+	a = kmalloc(max * 8, GFP_KERNEL);
+	c = kmalloc(max * 8, GFP_KERNEL);
+	d = kmalloc(max * 8, GFP_KERNEL);
+	e = kmalloc(max * 8, GFP_KERNEL);
+	if (!a || !c || !d || !e)
+		goto out;
+
+	ret = -EIO;
+	get_random_bytes(a, max * 8);
+	for (i = 0; i < ARRAY_SIZE(lengths); i++) {
+		n = lengths[i];
+		for (width = 2; width <= 4; width += 2) {
+			/* a and a + half as sources, c and d the results */
+			memset(c, 0, max * 8);
+			memset(d, 0xa5, max * 8);
+			AUDQUE_DoInterleave(c, a, a + max * 4, n, width, false);
+			AUDQUE_DoInterleave(d, a, a + max * 4, n, width, true);
+			if (memcmp(c, d, 2 * n * width))
+				goto out;
+
+			memset(c, 0, max * 8);
+			memset(d, 0xa5, max * 8);
+			AUDQUE_DoDeinterleave(c, c + max * 4, a, n, width,
+					      false);
+			AUDQUE_DoDeinterleave(d, d + max * 4, a, n, width,
+					      true);
+			if (memcmp(c, d, n * width) ||
+			    memcmp(c + max * 4, d + max * 4, n * width))
+				goto out;
+		}
+		for (shift = 8; shift <= 16; shift += 8) {
+			AUDQUE_DoExpand16((UInt32 *)c, (UInt16 *)a, n, shift,
+					  false);
+			AUDQUE_DoExpand16((UInt32 *)d, (UInt16 *)a, n, shift,
+					  true);
+			if (memcmp(c, d, n * 4))
+				goto out;
+
+			AUDQUE_DoShrink16((UInt16 *)c, (UInt32 *)a, n, shift,
+					  false);
+			AUDQUE_DoShrink16((UInt16 *)e, (UInt32 *)a, n, shift,
+					  true);
+			if (memcmp(c, e, n * 2))
+				goto out;
+		}
+	}
+	ret = 0;
+out:
+	kfree(e);
+	kfree(d);
+	kfree(c);
+	kfree(a);
+	return ret;
+}
+
+static int __init AUDQUE_NeonInit(void)
+{
+	int ret;
+
+	if (!(elf_hwcap & HWCAP_NEON))
+		return 0;
+
+	ret = AUDQUE_NeonSelfTest();
+	if (ret) {
+		aError("AUDQUE: NEON self-test failed (%d), using C\n", ret);
+		return 0;
+	}
+	audque_use_neon = true;
+	aTrace(LOG_AUDIO_CSL, "AUDQUE: NEON interleave and conversion\n");
+	return 0;
+}
+late_initcall(AUDQUE_NeonInit);
+#endif
+
 /*
  * Function Name: AUDQUE_Create
  *
@@ -283,14 +549,14 @@ UInt32 AUDQUE_WriteInterleave(AUDQUE_Queue_t *aq,
 	if (aq->writePtr < aq->readPtr) {
 		if (aq->writePtr + size < aq->readPtr) {
 			/* copy all */
-			AUDQUE_MemCpyInterleave(aq->writePtr,
+			AUDQUE_Interleave(aq->writePtr,
 				buf, buf2, size, bitPerSample);
 			copied = size;
 		} else {
 		/* no space to write all, just copy part,
 		 * don't wite to readPrt, leave AUDQUE_MARGIN byte
 		 */
-			AUDQUE_MemCpyInterleave(aq->writePtr,
+			AUDQUE_Interleave(aq->writePtr,
 						buf,
 						buf2,
 						(aq->readPtr - aq->writePtr -
@@ -301,21 +567,22 @@ UInt32 AUDQUE_WriteInterleave(AUDQUE_Queue_t *aq,
 
 		if (aq->writePtr + size < aq->bottom) {
 			/* copy all */
-			AUDQUE_MemCpyInterleave(aq->writePtr,
+			AUDQUE_Interleave(aq->writePtr,
 						buf, buf2, size, bitPerSample);
 			copied = size;
 		} else {
 			if (aq->base + (aq->writePtr + size - aq->bottom) <
 			    aq->readPtr) {
 				/* copy all, but need 2 steps */
-				AUDQUE_MemCpyInterleave(aq->writePtr,
+				AUDQUE_Interleave(aq->writePtr,
 							buf,
 							buf2,
 							aq->bottom -
 							aq->writePtr,
 							bitPerSample);
-				buf += aq->bottom - aq->writePtr;
-				AUDQUE_MemCpyInterleave(aq->base,
+				buf += (aq->bottom - aq->writePtr) / 2;
+				buf2 += (aq->bottom - aq->writePtr) / 2;
+				AUDQUE_Interleave(aq->base,
 							buf,
 							buf2,
 							aq->writePtr + size -
@@ -327,14 +594,15 @@ UInt32 AUDQUE_WriteInterleave(AUDQUE_Queue_t *aq,
 			 * , leave AUDQUE_MARGIN byte
 			 */
 				if (aq->readPtr > aq->base) {
-					AUDQUE_MemCpyInterleave(aq->writePtr,
+					AUDQUE_Interleave(aq->writePtr,
 								buf,
 								buf2,
 								aq->bottom -
 								aq->writePtr,
 								bitPerSample);
-					buf += aq->bottom - aq->writePtr;
-					AUDQUE_MemCpyInterleave(aq->base,
+					buf += (aq->bottom - aq->writePtr) / 2;
+					buf2 += (aq->bottom - aq->writePtr) / 2;
+					AUDQUE_Interleave(aq->base,
 								buf,
 								buf2,
 								aq->readPtr -
@@ -348,7 +616,7 @@ UInt32 AUDQUE_WriteInterleave(AUDQUE_Queue_t *aq,
 				} else { /* aq->readPtr == aq->base */
 
 					/* don't write base */
-					AUDQUE_MemCpyInterleave(aq->writePtr,
+					AUDQUE_Interleave(aq->writePtr,
 								buf,
 								buf2,
 								aq->bottom -
@@ -717,3 +985,83 @@ UInt32 AUDQUE_GetSizeWritePtrToBottom(AUDQUE_Queue_t *aq)
 
 	return aq->bottom - aq->writePtr;
 }
+
+/*
+ * Function Name: AUDQUE_ReadReserve
+ *
+ * Description: Get the contiguous readable region at the read pointer,
+ *
+ * so a consumer can use the queue memory in place instead of AUDQUE_Read
+ * copying it out. Data that wraps past the bottom is left for the next
+ * reserve, after AUDQUE_ReadCommit has moved the read pointer to base.
+ *
+ */
+
+UInt32 AUDQUE_ReadReserve(AUDQUE_Queue_t *aq, UInt8 **ptr)
+{
+	*ptr = aq->readPtr;
+
+	if (aq->readPtr <= aq->writePtr)
+		return aq->writePtr - aq->readPtr;
+
+	return aq->bottom - aq->readPtr;
+}
+
+/*
+ * Function Name: AUDQUE_ReadCommit
+ *
+ * Description: Release size bytes of a region got from AUDQUE_ReadReserve
+ *
+ */
+
+void AUDQUE_ReadCommit(AUDQUE_Queue_t *aq, UInt32 size)
+{
+	audio_xassert(size <= (aq->readPtr <= aq->writePtr ?
+			       aq->writePtr - aq->readPtr :
+			       aq->bottom - aq->readPtr), size);
+
+	AUDQUE_UpdateReadPtrWithSize(aq, size);
+}
+
+/*
+ * Function Name: AUDQUE_WriteReserve
+ *
+ * Description: Get the contiguous writable region at the write pointer,
+ *
+ * so a producer (a DMA or a copy_from_user) can fill the queue memory in
+ * place. As in AUDQUE_Write, AUDQUE_MARGIN bytes are kept free in front
+ * of the read pointer, so a full queue is never taken for an empty one.
+ *
+ */
+
+UInt32 AUDQUE_WriteReserve(AUDQUE_Queue_t *aq, UInt8 **ptr)
+{
+	*ptr = aq->writePtr;
+
+	if (aq->writePtr < aq->readPtr)
+		return aq->readPtr - aq->writePtr - AUDQUE_MARGIN;
+
+	/* don't write up to the bottom when that would wrap onto readPtr */
+	if (aq->readPtr == aq->base)
+		return aq->bottom - aq->writePtr - AUDQUE_MARGIN;
+
+	return aq->bottom - aq->writePtr;
+}
+
+/*
+ * Function Name: AUDQUE_WriteCommit
+ *
+ * Description: Publish size bytes written to a region got from
+ *
+ * AUDQUE_WriteReserve
+ *
+ */
+
+void AUDQUE_WriteCommit(AUDQUE_Queue_t *aq, UInt32 size)
+{
+	UInt8 *ptr;
+
+	audio_xassert(size <= AUDQUE_WriteReserve(aq, &ptr), size);
+
+	AUDQUE_UpdateWritePtrWithSize(aq, size);
+}
@@ -129,6 +129,91 @@ UInt32 AUDQUE_WriteInterleave(AUDQUE_Queue_t *aq,
 		UInt32 size,
 		AUDIO_BITS_PER_SAMPLE_t bitPerSample);
 
+/**
+*
+*  Interleave two buffers of 16 or 32 bit samples.
+*
+*  @param  *dest        The interleaved output
+*  @param  *source      The first channel
+*  @param  *source2     The second channel
+*  @param  size         The number of bytes written to dest
+*  @param  bitPerSample The format of the data
+*
+*  @note   Uses NEON when the cpu has it, outside interrupt context
+*****************************************************************************/
+void AUDQUE_Interleave(UInt8 *dest,
+		UInt8 *source,
+		UInt8 *source2,
+		UInt32 size,
+		AUDIO_BITS_PER_SAMPLE_t bitPerSample);
+
+/**
+*
+*  Split interleaved 16 or 32 bit samples into two buffers.
+*
+*  @param  *dest        The first channel
+*  @param  *dest2       The second channel
+*  @param  *source      The interleaved input
+*  @param  size         The number of bytes read from source
+*  @param  bitPerSample The format of the data
+*
+*  @note   Uses NEON when the cpu has it, outside interrupt context
+*****************************************************************************/
+void AUDQUE_Deinterleave(UInt8 *dest,
+		UInt8 *dest2,
+		UInt8 *source,
+		UInt32 size,
+		AUDIO_BITS_PER_SAMPLE_t bitPerSample);
+
+/**
+*
+*  Convert 16 bit samples to 24 bit (right justified, sign extended) or
+*  32 bit ones.
+*
+*  @param  *dest        The 24 or 32 bit samples
+*  @param  *source      The 16 bit samples
+*  @param  samples      The number of samples
+*  @param  bitPerSample 24 or 32
+*****************************************************************************/
+void AUDQUE_Expand16(UInt32 *dest,
+		UInt16 *source,
+		UInt32 samples,
+		AUDIO_BITS_PER_SAMPLE_t bitPerSample);
+
+/**
+*
+*  Convert 24 or 32 bit samples to 16 bit ones, dropping the low bits.
+*
+*  @param  *dest        The 16 bit samples
+*  @param  *source      The 24 or 32 bit samples
+*  @param  samples      The number of samples
+*  @param  bitPerSample 24 or 32
+*****************************************************************************/
+void AUDQUE_Shrink16(UInt16 *dest,
+		UInt32 *source,
+		UInt32 samples,
+		AUDIO_BITS_PER_SAMPLE_t bitPerSample);
+
+#ifdef CONFIG_SND_BCM_SOC_NEON
+/* csl_aud_queue_neon.c, blocks of AUDQUE_NEON_BLOCK samples per channel,
+ * call between kernel_neon_begin() and kernel_neon_end()
+ */
+#define AUDQUE_NEON_BLOCK	8
+
+void AUDQUE_NeonInterleave16(UInt16 *dest, const UInt16 *src,
+			     const UInt16 *src2, UInt32 blocks);
+void AUDQUE_NeonInterleave32(UInt32 *dest, const UInt32 *src,
+			     const UInt32 *src2, UInt32 blocks);
+void AUDQUE_NeonDeinterleave16(UInt16 *dest, UInt16 *dest2,
+			       const UInt16 *src, UInt32 blocks);
+void AUDQUE_NeonDeinterleave32(UInt32 *dest, UInt32 *dest2,
+			       const UInt32 *src, UInt32 blocks);
+void AUDQUE_NeonExpand16(UInt32 *dest, const UInt16 *src, UInt32 blocks,
+			 int shift);
+void AUDQUE_NeonShrink16(UInt16 *dest, const UInt32 *src, UInt32 blocks,
+			 int shift);
+#endif
+
 /**
  *
  *  Write data to an audio queue without checking overflow
@@ -310,4 +395,50 @@ UInt32 AUDQUE_GetSizeReadPtrToBottom(AUDQUE_Queue_t *aq);
  */
 UInt32 AUDQUE_GetSizeWritePtrToBottom(AUDQUE_Queue_t *aq);
 
+/**
+ *
+ * Get the contiguous region that can be read in place at the read pointer
+ *  @param *aq  The audio queue reference
+ *  @param **ptr        Returns the start of the region
+ *
+ *  @return     UInt32  The size of the region, 0 if the queue is empty
+ *
+ *  @note       Release what was used with AUDQUE_ReadCommit. When the data
+ *              wraps, a second reserve after the commit returns the rest.
+ */
+UInt32 AUDQUE_ReadReserve(AUDQUE_Queue_t *aq, UInt8 **ptr);
+
+/**
+ *
+ * Move the read pointer past data used from AUDQUE_ReadReserve
+ *  @param *aq  The audio queue reference
+ *  @param size The bytes used, at most the reserved size
+ *
+ *  @return     void
+ */
+void AUDQUE_ReadCommit(AUDQUE_Queue_t *aq, UInt32 size);
+
+/**
+ *
+ * Get the contiguous region that can be written in place at the write
+ * pointer
+ *  @param *aq  The audio queue reference
+ *  @param **ptr        Returns the start of the region
+ *
+ *  @return     UInt32  The size of the region, 0 if the queue is full
+ *
+ *  @note       Publish what was written with AUDQUE_WriteCommit.
+ */
+UInt32 AUDQUE_WriteReserve(AUDQUE_Queue_t *aq, UInt8 **ptr);
+
+/**
+ *
+ * Move the write pointer past data written to AUDQUE_WriteReserve
+ *  @param *aq  The audio queue reference
+ *  @param size The bytes written, at most the reserved size
+ *
+ *  @return     void
+ */
+void AUDQUE_WriteCommit(AUDQUE_Queue_t *aq, UInt32 size);
+
 #endif /*__CSL_AUD_QUE_H__ */
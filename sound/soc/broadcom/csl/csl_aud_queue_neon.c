@@ -0,0 +1,147 @@
+/**************************************************************************
+Copyright 2009, 2010 Broadcom Corporation.  All rights reserved.          */
+/*									  */
+/*     Unless you and Broadcom execute a separate written software license*/
+/*     agreement governing use of this software, this software is licensed*/
+/*     to you under the terms of the GNU General Public License version 2 */
+/*     (the GPL), available at						  */
+/*                                                                        */
+/*     http://www.broadcom.com/licenses/GPLv2.php                         */
+/*                                                                        */
+/*     with the following added to such license:                          */
+/*                                                                        */
+/*     As a special exception, the copyright holders of this software give*/
+/*     you permission to link this software with independent modules, and */
+/*     to copy and distribute the resulting executable under terms of your*/
+/*     choice, provided that you also meet, for each linked		*/
+/*     independent module, the terms and conditions of the license of that*/
+/*     module.An independent module is a module which is not derived from */
+/*     this software.  The special exception does not apply to any	  */
+/*     modifications of the software.					  */
+/*                                                                        */
+/*     Notwithstanding the above, under no circumstances may you combine  */
+/*     this software in any way with any other Broadcom software provided */
+/*     under a license other than the GPL,				  */
+/*     without Broadcom's express prior written consent.                  */
+/*                                                                        */
+/**************************************************************************/
+
+/**
+*
+*   @file   csl_aud_queue_neon.c
+*
+*   @brief  NEON interleave, deinterleave and sample size conversion for
+*           the audio queue. Each call handles blocks of
+*           AUDQUE_NEON_BLOCK samples per channel, at least one; callers
+*           hold kernel_neon_begin() and do the tail in C.
+*
+***************************************************************************/
+
+#include <linux/types.h>
+#include "mobcom_types.h"
+#include "audio_consts.h"
+#include "csl_aud_queue.h"
+
+#ifndef __ARM_NEON__
+#error You should compile this file with '-mfloat-abi=softfp -mfpu=neon'
+#endif
+
+void AUDQUE_NeonInterleave16(UInt16 *dest, const UInt16 *src,
+			     const UInt16 *src2, UInt32 blocks)
+{
+	asm volatile(
+	"1:	vld1.16	{d0-d1}, [%1]!\n"
+	"	vld1.16	{d2-d3}, [%2]!\n"
+	"	subs	%3, %3, #1\n"
+	"	vst2.16	{d0-d3}, [%0]!\n"
+	"	bne	1b\n"
+	: "+r" (dest), "+r" (src), "+r" (src2), "+r" (blocks)
+	:
+	: "cc", "memory", "d0", "d1", "d2", "d3");
+}
+
+void AUDQUE_NeonInterleave32(UInt32 *dest, const UInt32 *src,
+			     const UInt32 *src2, UInt32 blocks)
+{
+	asm volatile(
+	"1:	vld1.32	{d0-d1}, [%1]!\n"
+	"	vld1.32	{d4-d5}, [%1]!\n"
+	"	vld1.32	{d2-d3}, [%2]!\n"
+	"	vld1.32	{d6-d7}, [%2]!\n"
+	"	subs	%3, %3, #1\n"
+	"	vst2.32	{d0-d3}, [%0]!\n"
+	"	vst2.32	{d4-d7}, [%0]!\n"
+	"	bne	1b\n"
+	: "+r" (dest), "+r" (src), "+r" (src2), "+r" (blocks)
+	:
+	: "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7");
+}
+
+void AUDQUE_NeonDeinterleave16(UInt16 *dest, UInt16 *dest2,
+			       const UInt16 *src, UInt32 blocks)
+{
+	asm volatile(
+	"1:	vld2.16	{d0-d3}, [%2]!\n"
+	"	subs	%3, %3, #1\n"
+	"	vst1.16	{d0-d1}, [%0]!\n"
+	"	vst1.16	{d2-d3}, [%1]!\n"
+	"	bne	1b\n"
+	: "+r" (dest), "+r" (dest2), "+r" (src), "+r" (blocks)
+	:
+	: "cc", "memory", "d0", "d1", "d2", "d3");
+}
+
+void AUDQUE_NeonDeinterleave32(UInt32 *dest, UInt32 *dest2,
+			       const UInt32 *src, UInt32 blocks)
+{
+	asm volatile(
+	"1:	vld2.32	{d0-d3}, [%2]!\n"
+	"	vld2.32	{d4-d7}, [%2]!\n"
+	"	subs	%3, %3, #1\n"
+	"	vst1.32	{d0-d1}, [%0]!\n"
+	"	vst1.32	{d4-d5}, [%0]!\n"
+	"	vst1.32	{d2-d3}, [%1]!\n"
+	"	vst1.32	{d6-d7}, [%1]!\n"
+	"	bne	1b\n"
+	: "+r" (dest), "+r" (dest2), "+r" (src), "+r" (blocks)
+	:
+	: "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7");
+}
+
+/* sign extend and shift left: 8 for 24 bit, 16 for 32 bit */
+void AUDQUE_NeonExpand16(UInt32 *dest, const UInt16 *src, UInt32 blocks,
+			 int shift)
+{
+	asm volatile(
+	"	vdup.32	q15, %3\n"
+	"1:	vld1.16	{d0-d1}, [%1]!\n"
+	"	vmovl.s16 q1, d0\n"
+	"	vmovl.s16 q2, d1\n"
+	"	vshl.s32 q1, q1, q15\n"
+	"	vshl.s32 q2, q2, q15\n"
+	"	subs	%2, %2, #1\n"
+	"	vst1.32	{d2-d5}, [%0]!\n"
+	"	bne	1b\n"
+	: "+r" (dest), "+r" (src), "+r" (blocks)
+	: "r" (shift)
+	: "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d30", "d31");
+}
+
+/* arithmetic shift right by 8 or 16 and keep the low 16 bits */
+void AUDQUE_NeonShrink16(UInt16 *dest, const UInt32 *src, UInt32 blocks,
+			 int shift)
+{
+	asm volatile(
+	"	vdup.32	q15, %3\n"
+	"1:	vld1.32	{d0-d3}, [%1]!\n"
+	"	vshl.s32 q0, q0, q15\n"
+	"	vshl.s32 q1, q1, q15\n"
+	"	vmovn.i32 d4, q0\n"
+	"	vmovn.i32 d5, q1\n"
+	"	subs	%2, %2, #1\n"
+	"	vst1.16	{d4-d5}, [%0]!\n"
+	"	bne	1b\n"
+	: "+r" (dest), "+r" (src), "+r" (blocks)
+	: "r" (-shift)
+	: "cc", "memory", "d0", "d1", "d2", "d3", "d4", "d5", "d30", "d31");
+}
@@ -127,7 +127,8 @@ static int hawaii_hw_free(struct snd_pcm_substream *substream)
 	struct snd_soc_dai *cpu_dai = rtd->cpu_dai;
 	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(cpu_dai);
 
-	if (i2s->fmTxRunning == 0 && i2s->fmRxRunning == 0 && useclk) {
+	if (i2s->fmTxRunning == 0 && i2s->fmRxRunning == 0 &&
+	    !i2s->fmTxDeep && useclk) {
 		ssp_ControlHWClock(FALSE);
 		csl_caph_ControlHWClock(FALSE);
 		useclk = FALSE;
@@ -141,7 +142,62 @@ static struct snd_soc_ops hawaii_ops = {
 	.hw_free = hawaii_hw_free,
 };
 
-static struct snd_soc_dai_link hawaii_dai = {
+#ifdef CONFIG_SND_BCM_SOC_DEEP_BUFFER
+/*****************************************************************************
+*
+*  Function Name: hawaii_compr_startup
+*
+*  Description: Enable clocks for the deep buffer stream
+*
+*****************************************************************************/
+static int hawaii_compr_startup(struct snd_compr_stream *cstream)
+{
+	struct snd_soc_pcm_runtime *rtd = cstream->private_data;
+	struct snd_soc_dai *cpu_dai = rtd->cpu_dai;
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(cpu_dai);
+
+	if (i2s->fmTxRunning == 0 && i2s->fmRxRunning == 0 && !useclk) {
+		csl_caph_ControlHWClock(TRUE);
+		ssp_ControlHWClock(TRUE);
+		useclk = TRUE;
+	}
+	return 0;
+}
+
+/*****************************************************************************
+*
+*  Function Name: hawaii_compr_shutdown
+*
+*  Description: Dissable clocks, if both playback and capture is finished.
+*		The platform is freed after this, so a stream closed while
+*		playing is stopped here, with the clocks still on.
+*
+*****************************************************************************/
+static void hawaii_compr_shutdown(struct snd_compr_stream *cstream)
+{
+	struct snd_soc_pcm_runtime *rtd = cstream->private_data;
+	struct snd_soc_dai *cpu_dai = rtd->cpu_dai;
+	struct caph_i2s *i2s = snd_soc_dai_get_drvdata(cpu_dai);
+	const struct snd_compr_ops *ops = rtd->platform->driver->compr_ops;
+
+	if (ops && ops->trigger)
+		ops->trigger(cstream, SNDRV_PCM_TRIGGER_STOP);
+
+	if (i2s->fmTxRunning == 0 && i2s->fmRxRunning == 0 && useclk) {
+		ssp_ControlHWClock(FALSE);
+		csl_caph_ControlHWClock(FALSE);
+		useclk = FALSE;
+	}
+}
+
+static struct snd_soc_compr_ops hawaii_compr_ops = {
+	.startup = hawaii_compr_startup,
+	.shutdown = hawaii_compr_shutdown,
+};
+#endif
+
+static struct snd_soc_dai_link hawaii_dai[] = {
+	{
 	.name = "caph",
 	.stream_name = "caph",
 	.cpu_dai_name = "caph-i2s.0",
@@ -150,13 +206,38 @@ static struct snd_soc_dai_link hawaii_dai = {
 	.codec_name = "spdif-dit.0",
 	.init = caph_soc_init,
 	.ops = &hawaii_ops,
+	},
+#ifdef CONFIG_SND_BCM_SOC_DEEP_BUFFER
+	{
+	.name = "caph-deep",
+	.stream_name = "caph-deep",
+	.cpu_dai_name = "caph-i2s-deep",
+	.platform_name = "caph-pcm-audio.0",
+	.codec_dai_name = "dit-hifi",
+	.codec_name = "spdif-dit.0",
+	.compr_ops = &hawaii_compr_ops,
+	},
+#endif
+#ifdef CONFIG_SND_BCM_SOC_VOICE_TRIGGER
+	{
+	.name = "caph-vt",
+	.stream_name = "caph-vt",
+	.cpu_dai_name = "caph-i2s-vt",
+	.platform_name = "caph-pcm-audio.0",
+	.codec_dai_name = "dit-hifi",
+	.codec_name = "spdif-dit.0",
+	.ops = &hawaii_ops,
+	/* keeps listening across system suspend */
+	.ignore_suspend = 1,
+	},
+#endif
 };
 
 static struct snd_soc_card hawaii = {
 	.name = "hawaii",
 	.owner = THIS_MODULE,
-	.dai_link = &hawaii_dai,
-	.num_links = 1,
+	.dai_link = hawaii_dai,
+	.num_links = ARRAY_SIZE(hawaii_dai),
 };
 
 static int __devinit hawaii_probe(struct platform_device *pdev)
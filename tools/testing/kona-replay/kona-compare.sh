@@ -0,0 +1,47 @@
+#!/bin/sh
+#
+# kona-compare.sh - compare two kona-replay reports.
+#
+# usage: kona-compare.sh baseline report [tolerance%]
+#
+# Prints each metric of both reports with its change. A metric where
+# lower is better (energy, power, busy time, wakeups, interrupts, jank,
+# I/O latency, faults, stalls, kills) that grew by more than the
+# tolerance, 5% by default, is a regression; the exit status is 1 when
+# there is one.
+
+if [ $# -lt 2 ]; then
+	echo "usage: $0 baseline report [tolerance%]" >&2
+	exit 2
+fi
+
+awk -v tol=${3:-5} '
+	BEGIN {
+		lower = "(busy_pct|_per_s|_per_min|energy|power_mw|jank_pct|"
+		lower = lower "missed_vsyncs|dropped|lat_us|majflt|allocstall|"
+		lower = lower "stall_us|lmk_kills)$"
+	}
+	FNR == NR { base[$1] = $2; next }
+	!($1 in base) { printf "%-36s %12s %12.2f   new\n", $1, "-", $2; next }
+	{
+		key = $1
+		old = base[key]
+		dv = $2 - old
+		rel = old ? 100 * dv / old : (dv ? 100 : 0)
+		tag = ""
+		if (key ~ lower) {
+			if (rel > tol && dv > 0.05) {
+				tag = "REGRESSED"
+				bad++
+			} else if (rel < -tol && dv < -0.05) {
+				tag = "better"
+			}
+		}
+		printf "%-36s %12.2f %12.2f %+8.1f%% %s\n", key, old, $2,
+			rel, tag
+	}
+	END {
+		if (bad)
+			printf "%d regression(s) over %s%%\n", bad, tol
+		exit bad ? 1 : 0
+	}' "$1" "$2"
@@ -0,0 +1,166 @@
+#
+# kona-replay-lib.sh - helpers for the phases of a kona-replay workload.
+#
+# Sourced by the shell that runs a phase. The phase is over when the
+# file KR_RUN is gone: the helpers that loop or wait look for it at least
+# once a second, so a phase longer than its real work waits in kr_sleep,
+# not sleep. What a device does to turn GPS on, or to route audio to a
+# headset, is up to its software stack; those helpers run the commands
+# in the KR_* variables of the environment when they are set and say so
+# when they are not.
+
+kr_running()
+{
+	[ -e "$KR_RUN" ]
+}
+
+# kr_sleep <seconds>: sleep, up to the end of the phase
+kr_sleep()
+{
+	local i=0
+
+	while [ $i -lt $1 ] && kr_running; do
+		sleep 1
+		i=$((i + 1))
+	done
+}
+
+# kr_screen on|off
+kr_screen()
+{
+	local b
+
+	if command -v input >/dev/null; then
+		if [ "$1" = on ]; then
+			input keyevent KEYCODE_WAKEUP
+		else
+			input keyevent KEYCODE_SLEEP
+		fi
+		return
+	fi
+	for b in /sys/class/backlight/*; do
+		[ -w $b/brightness ] || continue
+		if [ "$1" = on ]; then
+			cat $b/max_brightness > $b/brightness
+		else
+			echo 0 > $b/brightness
+		fi
+	done
+}
+
+# kr_every <seconds> <command...>: run the command every so often, in
+# the background until the phase ends
+kr_every()
+{
+	local period=$1
+
+	shift
+	while kr_running; do
+		"$@"
+		kr_sleep $period
+	done &
+}
+
+# kr_busy <seconds>: keep one cpu busy
+kr_busy()
+{
+	local pid
+
+	( while kr_running; do :; done ) &
+	pid=$!
+	kr_sleep $1
+	kill $pid 2>/dev/null
+}
+
+# kr_vibrate <ms>
+kr_vibrate()
+{
+	local v=/sys/class/timed_output/vibrator/enable
+
+	[ -w $v ] && echo $1 > $v
+}
+
+# kr_notify: what a notification does, a buzz and the screen for 5s
+kr_notify()
+{
+	kr_vibrate 200
+	kr_screen on
+	kr_busy 1
+	kr_sleep 4
+	kr_screen off
+}
+
+# kr_touch <count>: taps in the middle of the screen, 300ms apart
+kr_touch()
+{
+	local i=0
+
+	command -v input >/dev/null || return
+	while [ $i -lt $1 ] && kr_running; do
+		input tap 160 160
+		sleep 0.3
+		i=$((i + 1))
+	done
+}
+
+# kr_sensor <input device name> on|off
+kr_sensor()
+{
+	local d v=0
+
+	[ "$2" = on ] && v=1
+	for d in /sys/class/input/input*; do
+		grep -qx "$1" $d/name 2>/dev/null || continue
+		[ -w $d/enable ] && echo $v > $d/enable
+	done
+}
+
+# kr_hook <variable>: run the command in it, or tell there is none
+kr_hook()
+{
+	local cmd
+
+	eval cmd=\$$1
+	if [ -n "$cmd" ]; then
+		sh -c "$cmd"
+	else
+		echo "kona-replay: $1 not set, skipped" >&2
+	fi
+}
+
+kr_gps()
+{
+	if [ "$1" = on ]; then
+		kr_hook KR_GPS_ON
+	else
+		kr_hook KR_GPS_OFF
+	fi
+}
+
+# kr_music <seconds>: audio out, over BT with KR_BT_ON/KR_BT_OFF set
+kr_music()
+{
+	local pid
+
+	kr_hook KR_BT_ON
+	if [ -n "$KR_MUSIC" ] && command -v tinyplay >/dev/null; then
+		tinyplay "$KR_MUSIC" >/dev/null &
+		pid=$!
+		kr_sleep $1
+		kill $pid 2>/dev/null
+	else
+		echo "kona-replay: KR_MUSIC not set or no tinyplay" >&2
+		kr_sleep $1
+	fi
+	kr_hook KR_BT_OFF
+}
+
+# kr_write <MB>: a burst of file writes, synced, as a sync of app data
+kr_write()
+{
+	local f=${KR_SCRATCH:-/data/local/tmp}/kona-replay.dat
+
+	dd if=/dev/zero of=$f bs=64k count=$(($1 * 16)) 2>/dev/null
+	sync
+	rm -f $f
+}
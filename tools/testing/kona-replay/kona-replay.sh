@@ -0,0 +1,128 @@
+#!/bin/sh
+#
+# kona-replay.sh - replay a scripted workload phase by phase and record
+# the Kona counters around each phase.
+#
+# usage: kona-replay.sh [-o dir] [-b baseline] workload
+#
+# A workload file is a list of phases, each a header line
+#
+#	phase <name> <seconds>
+#
+# followed by shell commands run in the background for that long, with
+# the helpers of kona-replay-lib.sh at hand; a phase waits for the end of
+# its commands before the next one starts. Phase names are unique words.
+# Around each phase the user space counters (cpufreq time in state,
+# /proc/stat, vmstat, block stats, LMK kills) are saved to
+# <dir>/<name>.pre and <name>.post, and the phase is marked in debugfs
+# kona_phase (CONFIG_KONA_PHASE_STATS) for the kernel ones. At the end
+# kona-report.sh writes <dir>/report; with -b the report is compared to
+# a baseline report by kona-compare.sh, and the exit status is that of
+# the comparison.
+
+KR_DIR=$(cd "$(dirname "$0")" && pwd)
+DBG=/sys/kernel/debug
+CPUFREQ=/sys/devices/system/cpu/cpu0/cpufreq
+
+out=
+base=
+while getopts o:b: opt; do
+	case $opt in
+	o) out=$OPTARG ;;
+	b) base=$OPTARG ;;
+	*) echo "usage: $0 [-o dir] [-b baseline] workload" >&2; exit 2 ;;
+	esac
+done
+shift $((OPTIND - 1))
+wl=$1
+if [ ! -r "$wl" ]; then
+	echo "usage: $0 [-o dir] [-b baseline] workload" >&2
+	exit 2
+fi
+if [ -z "$out" ]; then
+	if [ -d /data/local/tmp ]; then
+		out=/data/local/tmp/kona-replay
+	else
+		out=/tmp/kona-replay
+	fi
+fi
+
+mark()
+{
+	[ -w $DBG/kona_phase/mark ] && echo "$1" > $DBG/kona_phase/mark
+}
+
+snap()
+{
+	awk '{ print "freq." $1, $2 }' $CPUFREQ/stats/time_in_state \
+		2>/dev/null
+	awk '$1 ~ /^cpu[0-9]+$/ {
+		print "stat." $1 ".busy", $2 + $3 + $4 + $7 + $8
+		print "stat." $1 ".total", $2 + $3 + $4 + $5 + $6 + $7 + $8
+	}' /proc/stat
+	awk '{ print "vm." $1, $2 }' /proc/vmstat
+	for d in /sys/block/mmcblk[0-9]; do
+		[ -r $d/stat ] || continue
+		awk -v d=${d##*/} '{
+			print "blk." d ".rd_ios", $1
+			print "blk." d ".rd_ms", $4
+			print "blk." d ".wr_ios", $5
+			print "blk." d ".wr_ms", $8
+		}' $d/stat
+	done
+	if [ -r $DBG/almk/stat ]; then
+		echo "lmk.kills $(tail -n 1 $DBG/almk/stat)"
+	fi
+}
+
+mkdir -p "$out" || exit 1
+rm -f "$out"/*.pre "$out"/*.post "$out"/*.sh "$out"/phases
+[ -d $DBG/kona_phase ] || \
+	echo "no debugfs kona_phase, kernel counters are left out" >&2
+mark reset
+cat $CPUFREQ/energy_table > "$out/energy_table" 2>/dev/null
+uname -a > "$out/kernel_version"
+
+# split the workload into one script per phase
+awk -v out="$out" '
+	/^[ \t]*#/ || /^[ \t]*$/ { next }
+	$1 == "phase" {
+		if (NF != 3 || $2 !~ /^[A-Za-z0-9_-]+$/ || seen[$2]++) {
+			print "bad phase line: " $0 > "/dev/stderr"
+			exit 1
+		}
+		sh = out "/" $2 ".sh"
+		print $2, $3 > (out "/phases")
+		printf "" > sh
+		next
+	}
+	sh == "" { print "commands before the first phase" > "/dev/stderr"
+		   exit 1 }
+	{ print > sh }
+' "$wl" || exit 1
+
+export KR_RUN="$out/running"
+while read name secs; do
+	echo "phase $name, ${secs}s"
+	snap > "$out/$name.pre"
+	touch "$KR_RUN"
+	mark "$name"
+	(
+		. "$KR_DIR/kona-replay-lib.sh"
+		. "$out/$name.sh"
+		wait
+	) </dev/null &
+	pid=$!
+	sleep "$secs"
+	rm -f "$KR_RUN"
+	mark end
+	snap > "$out/$name.post"
+	# the helpers notice within a second, the rest gets what is left
+	wait $pid
+done < "$out/phases"
+
+cat $DBG/kona_phase/report > "$out/kernel" 2>/dev/null
+"$KR_DIR/kona-report.sh" "$out" > "$out/report" || exit 1
+cat "$out/report"
+[ -n "$base" ] || exit 0
+"$KR_DIR/kona-compare.sh" "$base" "$out/report"
@@ -0,0 +1,145 @@
+#!/bin/sh
+#
+# kona-report.sh - the metrics of each phase of a kona-replay run.
+#
+# usage: kona-report.sh dir
+#
+# Prints "<phase>.<metric> <value>" lines from the counters kona-replay.sh
+# saved in dir. The cpu energy is the busy time of the cpus spread over
+# the OPPs as the cpufreq time in state has it, at the power of each OPP
+# in the cpufreq energy_table, plus their C state time at its idle power.
+# With a measured table it is in mJ; an estimated one (C * V^2 * f) only
+# gives cpu_energy_rel, to compare runs on the same silicon.
+
+dir=$1
+if [ ! -r "$dir/phases" ]; then
+	echo "usage: $0 dir" >&2
+	exit 2
+fi
+touch "$dir/energy_table" "$dir/kernel"
+
+while read name secs; do
+	awk -v p="$name" -v etab="$dir/energy_table" \
+	    -v pre="$dir/$name.pre" -v post="$dir/$name.post" \
+	    -v kern="$dir/kernel" '
+	function out(key, v) { printf "%s.%s %.2f\n", p, key, v }
+	function d(key) { return b[key] - a[key] }
+
+	FILENAME == etab {
+		if ($1 == "idle")
+			pidle = $2
+		else if ($1 ~ /^[0-9]+$/) {
+			pw[$1] = $2
+			npw++
+		}
+		if ($0 ~ /estimated/)
+			est = 1
+		next
+	}
+	FILENAME == pre { a[$1] = $2; next }
+	FILENAME == post { b[$1] = $2; next }
+	FILENAME == kern {
+		n = length(p) + 1
+		if (substr($1, 1, n) == p ".")
+			k[substr($1, n + 1)] = $2
+		next
+	}
+
+	END {
+		# wall time from the kernel if it has the phase, else ours
+		t = k["time_us"] / 1e6
+		if (!t) {
+			for (key in b)
+				if (key ~ /^stat\.cpu0\.total$/)
+					t = d(key) / 100
+		}
+		if (!t)
+			exit 0
+		out("time_s", t)
+		susp = k["suspended_us"] / 1e6
+		out("suspended_pct", 100 * susp / t)
+		out("resumes_per_min", 60 * k["suspends"] / t)
+		out("wakeup_events", k["wakeup_events"])
+		out("irqs_per_s", k["irqs"] / t)
+		out("ctxsw_per_s", k["ctxsw"] / t)
+
+		# /proc/stat is in USER_HZ
+		for (key in b) {
+			if (key !~ /^stat\.cpu[0-9]+\.busy$/ || !(key in a))
+				continue
+			split(key, f, ".")
+			tot = d("stat." f[2] ".total")
+			busy_s += d(key) / 100
+			online_s += tot / 100
+			if (tot)
+				out(f[2] ".busy_pct", 100 * d(key) / tot)
+		}
+
+		for (key in k) {
+			if (key ~ /^cpu[0-9]+\.c[0-9]+_us$/) {
+				split(key, f, ".")
+				sub(/_us$/, "", f[2])
+				cs[f[2]] += k[key] / 1e6
+				idle_s += k[key] / 1e6
+			} else if (key ~ /^cpu[0-9]+\.c[0-9]+_n$/) {
+				exits += k[key]
+			}
+		}
+		for (st in cs)
+			if (online_s)
+				out(st "_pct", 100 * cs[st] / online_s)
+		if (t > susp)
+			out("idle_exits_per_s", exits / (t - susp))
+
+		out("frames", k["frames"])
+		jank = k["frames"] ? 100 * k["janky"] / k["frames"] : 0
+		out("jank_pct", jank)
+		out("missed_vsyncs", k["missed_vsyncs"])
+		out("dropped", k["dropped"])
+
+		for (key in b) {
+			if (key !~ /^blk\..*\.rd_ios$/)
+				continue
+			split(key, f, ".")
+			dev = "blk." f[2]
+			rd = d(dev ".rd_ios")
+			wr = d(dev ".wr_ios")
+			out(f[2] ".rd_ios", rd)
+			out(f[2] ".wr_ios", wr)
+			if (rd)
+				out(f[2] ".rd_lat_us",
+				    1000 * d(dev ".rd_ms") / rd)
+			if (wr)
+				out(f[2] ".wr_lat_us",
+				    1000 * d(dev ".wr_ms") / wr)
+		}
+
+		out("majflt", d("vm.pgmajfault"))
+		out("allocstall", d("vm.allocstall"))
+		out("compact_stall_us", d("vm.compact_stall_us"))
+		out("pswpin", d("vm.pswpin"))
+		out("pswpout", d("vm.pswpout"))
+		out("lmk_kills", d("lmk.kills"))
+
+		# uW * s, the freq time in state is in 10ms
+		for (key in b) {
+			if (key !~ /^freq\./)
+				continue
+			split(key, f, ".")
+			tf[f[2]] = d(key)
+			tall += d(key)
+		}
+		if (!tall || !npw)
+			exit 0
+		for (fr in tf)
+			e += pw[fr] * busy_s * tf[fr] / tall
+		e += pidle * idle_s
+		if (est) {
+			out("cpu_energy_rel", e / 1000)
+		} else {
+			out("cpu_energy_mj", e / 1000)
+			out("cpu_power_mw", e / 1000 / t)
+		}
+	}' "$dir/energy_table" "$dir/$name.pre" "$dir/$name.post" \
+		"$dir/kernel"
+done < "$dir/phases"
@@ -0,0 +1,42 @@
+# A day of a watch, shortened: each phase is one kind of use, long enough
+# for its counters to settle. Hooks for what the helpers cannot do on
+# their own: KR_GPS_ON/KR_GPS_OFF, KR_BT_ON/KR_BT_OFF, KR_MUSIC (a wav).
+
+# screen off, the watch face updated once a minute
+phase ambient 300
+kr_screen off
+kr_every 60 kr_busy 1
+
+# the face on, looked at and flicked through
+phase watchface 120
+kr_screen on
+kr_every 10 kr_touch 3
+
+# screen off, a notification every 30s
+phase notifications 300
+kr_screen off
+kr_every 30 kr_notify
+
+# a run: GPS and the motion sensors on, the screen on now and then
+phase workout 600
+kr_gps on
+kr_sensor bmg160 on
+kr_sensor bma2x2 on
+kr_every 60 kr_notify
+kr_every 120 kr_write 1
+kr_sleep 600
+kr_sensor bmg160 off
+kr_sensor bma2x2 off
+kr_gps off
+
+# music over BT, screen off
+phase music 600
+kr_screen off
+kr_music 600
+
+# back to the face, and an app sync
+phase sync 120
+kr_screen on
+kr_write 16
+kr_busy 10
+kr_screen off